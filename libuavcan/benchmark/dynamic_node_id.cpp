@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <uavcan/node/node.hpp>
+#include <uavcan/protocol/dynamic_node_id_client.hpp>
+#include <uavcan/protocol/dynamic_node_id_server/centralized.hpp>
+#include "virtual_bus.hpp"
+
+namespace
+{
+
+class MemoryStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
+{
+    std::map<String, String> container_;
+
+public:
+    virtual String get(const String& key) const
+    {
+        const std::map<String, String>::const_iterator it = container_.find(key);
+        return (it == container_.end()) ? String() : it->second;
+    }
+
+    virtual void set(const String& key, const String& value) { container_[key] = value; }
+};
+
+class NullEventTracer : public uavcan::dynamic_node_id_server::IEventTracer
+{
+public:
+    virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode, uavcan::int64_t) { }
+};
+
+typedef uavcan::Node<16384> BenchmarkNode;
+
+/**
+ * A centralized allocator and a number of nodes that request dynamic node ID at the same time, all attached to
+ * an otherwise idle virtual bus.
+ */
+struct AllocationFixture
+{
+    static const uint8_t ServerNodeID = 1;
+
+    BenchmarkClock clock;
+    VirtualBus bus;
+    MemoryStorageBackend storage;
+    NullEventTracer tracer;
+    BenchmarkNode server_node;
+    uavcan::dynamic_node_id_server::CentralizedServer server;
+    std::vector<std::unique_ptr<BenchmarkNode> > client_nodes;
+    std::vector<std::unique_ptr<uavcan::DynamicNodeIDClient> > clients;
+
+    AllocationFixture()
+        : bus(0, uavcan::NodeID(), std::vector<TrafficStream>(), clock.monotonic)
+        , server_node(bus.addPort(), clock)
+        , server(server_node, storage, tracer)
+    { }
+
+    int init(unsigned num_clients, bool adaptive_pacing)
+    {
+        server_node.setNodeID(ServerNodeID);
+        server_node.setName("org.uavcan.benchmark.allocator");
+        int res = server_node.start();
+        if (res < 0)
+        {
+            return res;
+        }
+
+        uavcan::dynamic_node_id_server::UniqueID server_unique_id;
+        server_unique_id[0] = 0xFF;
+        res = server.init(server_unique_id);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        for (unsigned i = 0; i < num_clients; i++)
+        {
+            client_nodes.push_back(std::unique_ptr<BenchmarkNode>(new BenchmarkNode(bus.addPort(), clock)));
+            client_nodes.back()->setName("org.uavcan.benchmark.allocatee");
+            res = client_nodes.back()->start();
+            if (res < 0)
+            {
+                return res;
+            }
+
+            uavcan::protocol::HardwareVersion hwver;
+            for (uavcan::uint8_t k = 0; k < hwver.unique_id.size(); k++)
+            {
+                // coverity[dont_call]
+                hwver.unique_id[k] = uint8_t(std::rand());
+            }
+            hwver.unique_id[hwver.unique_id.size() - 1] = uint8_t(i);
+
+            clients.push_back(std::unique_ptr<uavcan::DynamicNodeIDClient>(
+                new uavcan::DynamicNodeIDClient(*client_nodes.back())));
+            clients.back()->setAdaptivePacing(adaptive_pacing);
+            res = clients.back()->start(hwver);
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        return 0;
+    }
+
+    unsigned getNumAllocatedNodes() const
+    {
+        unsigned result = 0;
+        for (unsigned i = 0; i < clients.size(); i++)
+        {
+            result += clients[i]->isAllocationComplete() ? 1U : 0U;
+        }
+        return result;
+    }
+
+    int spinOnce()
+    {
+        int res = server_node.spinOnce();
+        for (unsigned i = 0; (i < client_nodes.size()) && (res >= 0); i++)
+        {
+            res = client_nodes[i]->spinOnce();
+        }
+        return res;
+    }
+};
+
+}
+
+/**
+ * Time from the power-up of a number of nodes until all of them have received their node IDs from the
+ * centralized allocator, in virtual time. The nodes are spun every millisecond; every iteration starts over
+ * with a fresh set of nodes and a different random seed. The reported time is the virtual time.
+ *
+ * Arguments: number of allocatees, adaptive request pacing on/off.
+ */
+static void BM_DynamicNodeIDAllocation(benchmark::State& state)
+{
+    const unsigned num_clients = unsigned(state.range(0));
+    const bool adaptive_pacing = state.range(1) != 0;
+    const uint64_t StepUSec = 1000;
+    const uint64_t TimeoutUSec = 600 * 1000000ULL;
+
+    unsigned seed = 1;
+    uint64_t total_frames = 0;
+    double total_seconds = 0;
+
+    for (auto _ : state)
+    {
+        std::srand(seed++);
+        std::unique_ptr<AllocationFixture> fixture(new AllocationFixture());
+        if (fixture->init(num_clients, adaptive_pacing) < 0)
+        {
+            state.SkipWithError("Init failure");
+            break;
+        }
+
+        const uint64_t started_at = fixture->bus.getTimeUSec();
+        uint64_t now = started_at;
+        bool failed = false;
+        while ((fixture->getNumAllocatedNodes() < num_clients) && !failed)
+        {
+            now += StepUSec;
+            fixture->bus.advance(now);
+            fixture->clock.monotonic = fixture->bus.getTimeUSec();
+            failed = (fixture->spinOnce() < 0) || ((now - started_at) > TimeoutUSec);
+        }
+        if (failed)
+        {
+            state.SkipWithError("Allocation did not complete");
+            break;
+        }
+
+        const double seconds = double(now - started_at) * 1e-6;
+        state.SetIterationTime(seconds);
+        total_seconds += seconds;
+        total_frames += fixture->bus.getStatistics().frames;
+    }
+
+    if (state.iterations() > 0)
+    {
+        state.counters["alloc_time_s"] = total_seconds / double(state.iterations());
+        state.counters["per_node_s"] = total_seconds / double(state.iterations() * num_clients);
+        state.counters["frames"] = double(total_frames) / double(state.iterations());
+    }
+}
+BENCHMARK(BM_DynamicNodeIDAllocation)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(8)
+    ->Args({1, 0})->Args({1, 1})
+    ->Args({4, 0})->Args({4, 1})
+    ->Args({16, 0})->Args({16, 1})
+    ->Args({48, 0})->Args({48, 1});
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/data_type.hpp>
+
+/**
+ * Manually driven clock, so that the benchmarks don't measure the system clock.
+ */
+class BenchmarkClock : public uavcan::ISystemClock
+{
+public:
+    mutable uint64_t monotonic;
+
+    explicit BenchmarkClock(uint64_t initial = 1000000)
+        : monotonic(initial)
+    { }
+
+    void advance(uint64_t usec) { monotonic += usec; }
+
+    virtual uavcan::MonotonicTime getMonotonic() const { return uavcan::MonotonicTime::fromUSec(monotonic); }
+    virtual uavcan::UtcTime getUtc() const { return uavcan::UtcTime::fromUSec(monotonic); }
+    virtual void adjustUtc(uavcan::UtcDuration) { }
+};
+
+/**
+ * CAN driver that accepts every frame and never receives anything.
+ */
+class NullCanDriver : public uavcan::ICanDriver, public uavcan::ICanIface
+{
+public:
+    virtual int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags) { return 1; }
+
+    virtual int16_t receive(uavcan::CanFrame&, uavcan::MonotonicTime&, uavcan::UtcTime&, uavcan::CanIOFlags&)
+    {
+        return 0;
+    }
+
+    virtual int16_t configureFilters(const uavcan::CanFilterConfig*, uint16_t) { return 0; }
+    virtual uint16_t getNumFilters() const { return 0; }
+    virtual uint64_t getErrorCount() const { return 0; }
+
+    virtual uavcan::ICanIface* getIface(uint8_t iface_index) { return (iface_index == 0) ? this : NULL; }
+    virtual uint8_t getNumIfaces() const { return 1; }
+
+    virtual int16_t select(uavcan::CanSelectMasks& inout_masks, const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                           uavcan::MonotonicTime)
+    {
+        inout_masks.read = 0;
+        inout_masks.write = 1;
+        return 1;
+    }
+};
+
+inline uavcan::DataTypeDescriptor makeBenchmarkDataType(uint16_t id = 1000)
+{
+    return uavcan::DataTypeDescriptor(uavcan::DataTypeKindMessage, id, uavcan::DataTypeSignature(0x0123456789ABCDEFULL),
+                                      "benchmark.Message");
+}
+
+/**
+ * Splits the payload into the frames of a broadcast transfer, prepending the transfer CRC if needed.
+ */
+inline std::vector<uavcan::Frame> makeTransferFrames(const uavcan::DataTypeDescriptor& data_type,
+                                                     uavcan::NodeID src_node_id, uavcan::TransferID transfer_id,
+                                                     const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> raw_payload;
+    if (payload.size() > (sizeof(uavcan::CanFrame::data) - 1))
+    {
+        uavcan::TransferCRC crc = data_type.getSignature().toTransferCRC();
+        crc.add(&payload[0], unsigned(payload.size()));
+        raw_payload.push_back(uint8_t(crc.get() & 0xFF));
+        raw_payload.push_back(uint8_t(crc.get() >> 8));
+    }
+    raw_payload.insert(raw_payload.end(), payload.begin(), payload.end());
+
+    std::vector<uavcan::Frame> frames;
+    uavcan::Frame frame(data_type.getID(), uavcan::TransferTypeMessageBroadcast, src_node_id,
+                        uavcan::NodeID::Broadcast, transfer_id);
+    frame.setStartOfTransfer(true);
+    unsigned offset = 0;
+    while (true)
+    {
+        const unsigned bytes_left = unsigned(raw_payload.size()) - offset;
+        offset += frame.setPayload(&raw_payload[0] + offset, bytes_left);
+        frame.setEndOfTransfer(offset == raw_payload.size());
+        frames.push_back(frame);
+        if (frame.isEndOfTransfer())
+        {
+            break;
+        }
+        frame.setStartOfTransfer(false);
+        frame.flipToggle();
+    }
+    return frames;
+}
+
+/**
+ * Reads and counts the received transfers.
+ */
+class CountingListener : public uavcan::TransferListener<64, 1, 1>
+{
+public:
+    uint64_t num_transfers;
+
+    CountingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                     uavcan::IPoolAllocator& allocator)
+        : uavcan::TransferListener<64, 1, 1>(perf, data_type, allocator)
+        , num_transfers(0)
+    { }
+
+    virtual void handleIncomingTransfer(uavcan::IncomingTransfer& transfer)
+    {
+        uint8_t buf[64];
+        benchmark::DoNotOptimize(transfer.read(0, buf, sizeof(buf)));
+        num_transfers++;
+    }
+};
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <uavcan/node/scheduler.hpp>
+#include <uavcan/transport/transfer_sender.hpp>
+#include <uavcan/transport/outgoing_transfer_registry.hpp>
+#include "virtual_bus.hpp"
+
+/**
+ * Node under test attached to the virtual bus: it receives the whole traffic mix of all simulated nodes and
+ * publishes a multi-frame message periodically.
+ */
+struct VirtualBusFixture
+{
+    static const uint8_t LocalNodeID = 127;
+
+    BenchmarkClock clock;
+    VirtualBus bus;
+    VirtualBus::Port& port;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 1024, uavcan::MemPoolBlockSize> pool;
+    uavcan::OutgoingTransferRegistry<8> otr;
+    uavcan::Scheduler scheduler;
+    std::vector<TrafficStream> mix;
+    std::vector<CountingListener*> listeners;
+    const uavcan::DataTypeDescriptor tx_data_type;
+    uavcan::TransferSender sender;
+
+    explicit VirtualBusFixture(unsigned num_nodes)
+        : bus(num_nodes, LocalNodeID, makeDefaultTrafficMix(), clock.monotonic)
+        , port(bus.addPort())
+        , otr(pool)
+        , scheduler(port, pool, clock, otr)
+        , mix(makeDefaultTrafficMix())
+        , tx_data_type(makeBenchmarkDataType(2000))
+        , sender(scheduler.getDispatcher(), tx_data_type, uavcan::CanTxQueue::Volatile)
+    {
+        (void)scheduler.getDispatcher().setNodeID(LocalNodeID);
+        for (unsigned i = 0; i < mix.size(); i++)
+        {
+            listeners.push_back(new CountingListener(scheduler.getDispatcher().getTransferPerfCounter(),
+                                                     mix[i].data_type, pool));
+            (void)scheduler.getDispatcher().registerMessageListener(listeners.back());
+        }
+        sender.setPriority(16);
+    }
+
+    ~VirtualBusFixture()
+    {
+        for (unsigned i = 0; i < listeners.size(); i++)
+        {
+            scheduler.getDispatcher().unregisterMessageListener(listeners[i]);
+            delete listeners[i];
+        }
+    }
+
+    uint64_t getNumReceivedTransfers() const
+    {
+        uint64_t result = 0;
+        for (unsigned i = 0; i < listeners.size(); i++)
+        {
+            result += listeners[i]->num_transfers;
+        }
+        return result;
+    }
+};
+
+/**
+ * A node that receives the default traffic mix from a varying number of nodes on a 1 Mbit/s bus and spins
+ * periodically with a varying period. Only the time spent by the node under test is measured; the benchmark
+ * reports the CPU load it would have on this host, the bus load, the RX frames lost due to the FIFO overflow,
+ * the latency of the published transfers (from the publication until the last frame leaves the bus), and the
+ * memory pool usage. The node is saturated when either the CPU load exceeds 1 or the RX FIFO overflows.
+ *
+ * Arguments: number of simulated nodes, spin period in microseconds.
+ */
+static void BM_VirtualBusNodeUnderLoad(benchmark::State& state)
+{
+    const unsigned num_nodes = unsigned(state.range(0));
+    const uint64_t spin_period_usec = uint64_t(state.range(1));
+    const uint64_t SimulatedUSecPerIteration = 100000;
+    const uint64_t PublicationPeriodUSec = 10000;
+
+    std::unique_ptr<VirtualBusFixture> fixture(new VirtualBusFixture(num_nodes));
+
+    uint64_t publication_ts[uavcan::TransferID::Max + 1] = {};
+    std::vector<uint64_t> latencies;
+    fixture->bus.setTxObserver([&publication_ts, &latencies](const uavcan::CanFrame& can_frame, uint64_t ts)
+    {
+        uavcan::Frame frame;
+        if (frame.parse(can_frame) && frame.isEndOfTransfer())
+        {
+            latencies.push_back(ts - publication_ts[frame.getTransferID().get()]);
+        }
+    });
+
+    const std::vector<uint8_t> payload(12, 0x42);
+    uint8_t tid = 0;
+    uint64_t num_published = 0;
+    const uint64_t started_at = fixture->bus.getTimeUSec();
+    uint64_t spin_at = started_at;
+    uint64_t publish_at = started_at;
+    double cpu_seconds = 0;
+    bool failed = false;
+
+    for (auto _ : state)
+    {
+        double iteration_seconds = 0;
+        const uint64_t end = spin_at + SimulatedUSecPerIteration;
+        while ((spin_at < end) && !failed)
+        {
+            spin_at += spin_period_usec;
+            fixture->bus.advance(spin_at);
+            fixture->clock.monotonic = fixture->bus.getTimeUSec();
+
+            const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+            while (publish_at <= fixture->clock.monotonic)
+            {
+                publication_ts[tid] = fixture->clock.monotonic;
+                (void)fixture->sender.send(&payload[0], unsigned(payload.size()),
+                                           fixture->clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100),
+                                           uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                                           uavcan::NodeID::Broadcast, tid);
+                tid = uint8_t((tid + 1U) & uavcan::TransferID::Max);
+                publish_at += PublicationPeriodUSec;
+                num_published++;
+            }
+            failed = fixture->scheduler.spinOnce() < 0;
+            iteration_seconds +=
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        }
+        state.SetIterationTime(iteration_seconds);
+        cpu_seconds += iteration_seconds;
+        if (failed)
+        {
+            state.SkipWithError("Spin failure");
+            break;
+        }
+    }
+
+    const VirtualBus::Statistics& stats = fixture->bus.getStatistics();
+    const double simulated_seconds = double(fixture->bus.getTimeUSec() - started_at) * 1e-6;
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double p)
+    {
+        return latencies.empty() ? 0.0 : double(latencies[std::size_t(p * double(latencies.size() - 1))]);
+    };
+
+    state.SetItemsProcessed(int64_t(stats.rx_frames));
+    state.counters["bus_load"] = double(stats.busy_nsec) * 1e-9 / simulated_seconds;
+    state.counters["cpu_load"] = cpu_seconds / simulated_seconds;
+    state.counters["rx_fps"] = double(stats.rx_frames) / simulated_seconds;
+    state.counters["rx_transfers"] = double(fixture->getNumReceivedTransfers());
+    state.counters["rx_overflows"] = double(stats.rx_overflows);
+    state.counters["remote_drops"] = double(stats.remote_tx_drops);
+    state.counters["tx_timeouts"] = double(stats.tx_timeouts);
+    state.counters["tx_lost"] = double(num_published - latencies.size());
+    state.counters["tx_lat_p50_us"] = percentile(0.5);
+    state.counters["tx_lat_p99_us"] = percentile(0.99);
+    state.counters["tx_lat_max_us"] = percentile(1.0);
+    state.counters["pool_peak"] = double(fixture->pool.getPeakNumUsedBlocks());
+    state.counters["pool_headroom"] = double(fixture->pool.getNumBlocks() - fixture->pool.getPeakNumUsedBlocks());
+}
+BENCHMARK(BM_VirtualBusNodeUnderLoad)
+    ->UseManualTime()
+    ->Args({1, 1000})->Args({8, 1000})->Args({16, 1000})->Args({24, 1000})->Args({32, 1000})
+    ->Args({8, 10000})->Args({16, 10000})->Args({24, 10000})->Args({32, 10000});
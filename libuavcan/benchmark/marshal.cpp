@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/marshal/types.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+#include "helpers.hpp"
+
+/**
+ * Typical payload of the equipment messages - covariance matrices and vectors of float16.
+ */
+typedef uavcan::Array<uavcan::FloatSpec<16, uavcan::CastModeSaturate>, uavcan::ArrayModeDynamic, 16> Float16Array;
+
+static uavcan::protocol::NodeStatus makeNodeStatus()
+{
+    uavcan::protocol::NodeStatus msg;
+    msg.uptime_sec = 123456;
+    msg.health = uavcan::protocol::NodeStatus::HEALTH_WARNING;
+    msg.mode = uavcan::protocol::NodeStatus::MODE_OPERATIONAL;
+    msg.vendor_specific_status_code = 0xBEEF;
+    return msg;
+}
+
+static uavcan::protocol::debug::KeyValue makeKeyValue()
+{
+    uavcan::protocol::debug::KeyValue msg;
+    msg.key = "benchmark.key.value";
+    msg.value = 3.14159F;
+    return msg;
+}
+
+static Float16Array makeFloat16Array()
+{
+    Float16Array arr;
+    for (unsigned i = 0; i < arr.capacity(); i++)
+    {
+        arr.push_back(float(i) * 0.1F - 0.5F);
+    }
+    return arr;
+}
+
+/**
+ * Encoding and decoding of the integers of all sizes, either byte aligned or shifted by a one-bit field in front
+ * (the argument), which is the case for most fields of the real messages.
+ */
+static void BM_ScalarCodecRoundTrip(benchmark::State& state)
+{
+    const bool unaligned = state.range(0) != 0;
+    uavcan::StaticTransferBuffer<64> buf;
+    uint64_t checksum = 0;
+    unsigned iter = 0;
+    for (auto _ : state)
+    {
+        buf.reset();
+        {
+            uavcan::BitStream bitstream(buf);
+            uavcan::ScalarCodec codec(bitstream);
+            if (unaligned)
+            {
+                (void)codec.encode<1>(uint8_t(1));
+            }
+            for (unsigned i = 0; i < 4; i++)
+            {
+                (void)codec.encode<8>(uint8_t(iter + i));
+                (void)codec.encode<16>(uint16_t(iter * i));
+                (void)codec.encode<32>(uint32_t(iter ^ i));
+                (void)codec.encode<64>(uint64_t(iter) << i);
+            }
+        }
+        {
+            uavcan::BitStream bitstream(buf);
+            uavcan::ScalarCodec codec(bitstream);
+            uint8_t u8 = 0;
+            uint16_t u16 = 0;
+            uint32_t u32 = 0;
+            uint64_t u64 = 0;
+            if (unaligned)
+            {
+                (void)codec.decode<1>(u8);
+            }
+            for (unsigned i = 0; i < 4; i++)
+            {
+                (void)codec.decode<8>(u8);
+                (void)codec.decode<16>(u16);
+                (void)codec.decode<32>(u32);
+                (void)codec.decode<64>(u64);
+                checksum += u8 + u16 + u32 + u64;
+            }
+        }
+        iter++;
+    }
+    benchmark::DoNotOptimize(checksum);
+}
+BENCHMARK(BM_ScalarCodecRoundTrip)->Arg(0)->Arg(1);
+
+/**
+ * Typical 6x6 AHRS-style covariance matrices; the argument selects a diagonal or a full symmetric one.
+ */
+static void makeCovarianceMatrix(bool symmetric, float (&out)[36])
+{
+    for (int row = 0; row < 6; row++)
+    {
+        for (int col = 0; col < 6; col++)
+        {
+            out[row * 6 + col] = symmetric ? (0.001F * float((row + 1) * (col + 1))) :
+                                 ((row == col) ? (0.01F * float(row + 1)) : 0.0F);
+        }
+    }
+}
+
+static void BM_SquareMatrixPackingModeDetection(benchmark::State& state)
+{
+    float matrix[36];
+    makeCovarianceMatrix(state.range(0) != 0, matrix);
+    const uavcan::SquareMatrixAnalyzer<const float*, 36> analyzer(matrix);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(analyzer.detectOptimalPackingMode());
+    }
+}
+BENCHMARK(BM_SquareMatrixPackingModeDetection)->Arg(0)->Arg(1);
+
+/**
+ * Complete pack/unpack round trip of a covariance matrix through a float16 array.
+ */
+static void BM_SquareMatrixPackUnpack(benchmark::State& state)
+{
+    float matrix[36];
+    makeCovarianceMatrix(state.range(0) != 0, matrix);
+    uavcan::Array<uavcan::FloatSpec<16, uavcan::CastModeSaturate>, uavcan::ArrayModeDynamic, 36> packed;
+    float unpacked[36];
+    for (auto _ : state)
+    {
+        packed.packSquareMatrix(matrix);
+        packed.unpackSquareMatrix(unpacked);
+        benchmark::DoNotOptimize(unpacked);
+    }
+}
+BENCHMARK(BM_SquareMatrixPackUnpack)->Arg(0)->Arg(1);
+
+template <typename Spec, typename Value, Value (*Factory)()>
+static void BM_Encode(benchmark::State& state)
+{
+    const Value value = Factory();
+    uavcan::StaticTransferBuffer<256> buf;
+    for (auto _ : state)
+    {
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        benchmark::DoNotOptimize(Spec::encode(value, codec, uavcan::TailArrayOptEnabled));
+    }
+}
+
+template <typename Spec, typename Value, Value (*Factory)()>
+static void BM_Decode(benchmark::State& state)
+{
+    uavcan::StaticTransferBuffer<256> buf;
+    {
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        if (Spec::encode(Factory(), codec, uavcan::TailArrayOptEnabled) <= 0)
+        {
+            state.SkipWithError("Encoding failed");
+            return;
+        }
+    }
+    Value value;
+    for (auto _ : state)
+    {
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        benchmark::DoNotOptimize(Spec::decode(value, codec, uavcan::TailArrayOptEnabled));
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Encode, uavcan::protocol::NodeStatus, uavcan::protocol::NodeStatus, &makeNodeStatus);
+BENCHMARK_TEMPLATE(BM_Decode, uavcan::protocol::NodeStatus, uavcan::protocol::NodeStatus, &makeNodeStatus);
+
+BENCHMARK_TEMPLATE(BM_Encode, uavcan::protocol::debug::KeyValue, uavcan::protocol::debug::KeyValue, &makeKeyValue);
+BENCHMARK_TEMPLATE(BM_Decode, uavcan::protocol::debug::KeyValue, uavcan::protocol::debug::KeyValue, &makeKeyValue);
+
+BENCHMARK_TEMPLATE(BM_Encode, Float16Array, Float16Array, &makeFloat16Array);
+BENCHMARK_TEMPLATE(BM_Decode, Float16Array, Float16Array, &makeFloat16Array);
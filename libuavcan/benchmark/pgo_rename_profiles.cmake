@@ -0,0 +1,26 @@
+#
+# Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+#
+# GCC names the profile of each object file after the path of the object file, so the profiles collected from
+# the instrumented library can't be found by the optimized library that is built from the same sources in another
+# target directory. This script renames the profiles as if they were collected from the optimized library.
+#
+# Usage: cmake -DPROFILE_DIR=<dir> -DFROM=<instrumented target>.dir -DTO=<optimized target>.dir -P <this script>
+#
+
+file(GLOB_RECURSE profiles RELATIVE "${PROFILE_DIR}" "${PROFILE_DIR}/*.gcda")
+list(LENGTH profiles num_profiles)
+if (num_profiles EQUAL 0)
+    message(FATAL_ERROR "No profiles found in ${PROFILE_DIR}, the training run did not produce any")
+endif ()
+
+foreach (profile ${profiles})
+    string(REPLACE "${FROM}" "${TO}" renamed "${profile}")
+    if (NOT renamed STREQUAL profile)
+        get_filename_component(renamed_dir "${PROFILE_DIR}/${renamed}" DIRECTORY)
+        file(MAKE_DIRECTORY "${renamed_dir}")
+        file(RENAME "${PROFILE_DIR}/${profile}" "${PROFILE_DIR}/${renamed}")
+    endif ()
+endforeach ()
+
+message(STATUS "${num_profiles} profiles prepared for ${TO}")
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <memory>
+#include <uavcan/node/scheduler.hpp>
+#include <uavcan/transport/outgoing_transfer_registry.hpp>
+#include "helpers.hpp"
+
+/**
+ * Periodic handler that restarts itself from the callback, like the node status publisher or the timers.
+ */
+class PeriodicHandler : public uavcan::DeadlineHandler
+{
+    const uavcan::MonotonicDuration period_;
+
+public:
+    uint64_t num_calls;
+
+    PeriodicHandler(uavcan::Scheduler& scheduler, uavcan::MonotonicDuration period)
+        : uavcan::DeadlineHandler(scheduler)
+        , period_(period)
+        , num_calls(0)
+    { }
+
+    virtual void handleDeadline(uavcan::MonotonicTime current)
+    {
+        num_calls++;
+        startWithDeadline(current + period_);
+    }
+};
+
+struct SchedulerFixture
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 64, uavcan::MemPoolBlockSize> pool;
+    NullCanDriver driver;
+    BenchmarkClock clock;
+    uavcan::OutgoingTransferRegistry<2> otr;
+    uavcan::Scheduler scheduler;
+    std::vector<PeriodicHandler*> handlers;
+
+    explicit SchedulerFixture(unsigned num_handlers)
+        : otr(pool)
+        , scheduler(driver, pool, clock, otr)
+    {
+        uint32_t lcg = 1;
+        for (unsigned i = 0; i < num_handlers; i++)
+        {
+            lcg = lcg * 1103515245U + 12345U;
+            handlers.push_back(new PeriodicHandler(scheduler,
+                                                   uavcan::MonotonicDuration::fromUSec(1000 + (lcg >> 16) % 100000)));
+            handlers.back()->startWithDelay(uavcan::MonotonicDuration::fromUSec((lcg >> 8) % 100000));
+        }
+    }
+
+    ~SchedulerFixture()
+    {
+        for (unsigned i = 0; i < handlers.size(); i++)
+        {
+            delete handlers[i];
+        }
+    }
+};
+
+/**
+ * Rescheduling of a random handler while a varying number of handlers is registered.
+ */
+static void BM_DeadlineSchedulerRestart(benchmark::State& state)
+{
+    std::unique_ptr<SchedulerFixture> fixture(new SchedulerFixture(unsigned(state.range(0))));
+
+    uint32_t lcg = 1;
+    for (auto _ : state)
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        PeriodicHandler* const handler = fixture->handlers[(lcg >> 16) % fixture->handlers.size()];
+        handler->startWithDelay(uavcan::MonotonicDuration::fromUSec(lcg % 100000));
+    }
+}
+BENCHMARK(BM_DeadlineSchedulerRestart)->Arg(1)->Arg(8)->Arg(32)->Arg(128)->Arg(512);
+
+/**
+ * Expiration of one handler per poll, which then restarts itself.
+ */
+static void BM_DeadlineSchedulerPoll(benchmark::State& state)
+{
+    std::unique_ptr<SchedulerFixture> fixture(new SchedulerFixture(unsigned(state.range(0))));
+    uavcan::DeadlineScheduler& ds = fixture->scheduler.getDeadlineScheduler();
+
+    uint64_t num_calls = 0;
+    for (auto _ : state)
+    {
+        fixture->clock.monotonic = ds.getEarliestDeadline().toUSec();
+        benchmark::DoNotOptimize(ds.pollAndGetMonotonicTime(fixture->clock));
+    }
+
+    for (unsigned i = 0; i < fixture->handlers.size(); i++)
+    {
+        num_calls += fixture->handlers[i]->num_calls;
+    }
+    state.counters["calls_per_poll"] = double(num_calls) / double(state.iterations());
+}
+BENCHMARK(BM_DeadlineSchedulerPoll)->Arg(1)->Arg(8)->Arg(32)->Arg(128)->Arg(512);
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdlib>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/transport/can_io.hpp>
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/outgoing_transfer_registry.hpp>
+#include <uavcan/transport/transfer_sender.hpp>
+#include "helpers.hpp"
+
+
+static void BM_FrameCompile(benchmark::State& state)
+{
+    const std::vector<uint8_t> payload(100, 0x55);
+    const uavcan::Frame frame = makeTransferFrames(makeBenchmarkDataType(), 42, 7, payload).at(1);
+    uavcan::CanFrame can_frame;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame.compile(can_frame));
+        benchmark::DoNotOptimize(can_frame);
+    }
+}
+BENCHMARK(BM_FrameCompile);
+
+static void BM_FrameParse(benchmark::State& state)
+{
+    const std::vector<uint8_t> payload(100, 0x55);
+    uavcan::CanFrame can_frame;
+    (void)makeTransferFrames(makeBenchmarkDataType(), 42, 7, payload).at(1).compile(can_frame);
+    uavcan::Frame frame;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame.parse(can_frame));
+        benchmark::DoNotOptimize(frame);
+    }
+}
+BENCHMARK(BM_FrameParse);
+
+/**
+ * Frames of all kinds in a random order, as on a real bus, so that the branch predictor cannot learn the sequence:
+ * messages, anonymous messages, service requests and responses, and some malformed frames.
+ */
+static void BM_FrameParseMix(benchmark::State& state)
+{
+    std::srand(1);
+    std::vector<uavcan::CanFrame> can_frames(1024);
+    for (unsigned i = 0; i < can_frames.size(); i++)
+    {
+        uavcan::CanFrame& f = can_frames[i];
+        f.id = uavcan::CanFrame::FlagEFF | ((uint32_t(std::rand()) << 16) ^ uint32_t(std::rand()));
+        if ((i % 4) == 0)
+        {
+            f.id &= ~0x7FU;                                     // Anonymous or invalid
+        }
+        f.dlc = uint8_t(1 + std::rand() % 8);
+        for (unsigned k = 0; k < sizeof(f.data); k++)
+        {
+            f.data[k] = uint8_t(std::rand());
+        }
+        f.data[f.dlc - 1] = uint8_t((f.data[f.dlc - 1] & 0x1F) | 0xC0); // Mostly single-frame transfers
+    }
+
+    uavcan::Frame frame;
+    unsigned i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame.parse(can_frames[i++ & 1023U]));
+        benchmark::DoNotOptimize(frame);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_FrameParseMix);
+
+static void BM_TransferCRC(benchmark::State& state)
+{
+    const std::vector<uint8_t> data(std::size_t(state.range(0)), 0xA5);
+    for (auto _ : state)
+    {
+        uavcan::TransferCRC crc;
+        crc.add(&data[0], unsigned(data.size()));
+        benchmark::DoNotOptimize(crc.get());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(BM_TransferCRC)->Arg(8)->Arg(64)->Arg(256)->Arg(1024);
+
+/**
+ * Byte by byte update through add(uint8_t), for comparison with the table driven bulk path of BM_TransferCRC.
+ */
+static void BM_TransferCRCBytewise(benchmark::State& state)
+{
+    const std::vector<uint8_t> data(std::size_t(state.range(0)), 0xA5);
+    for (auto _ : state)
+    {
+        uavcan::TransferCRC crc;
+        for (unsigned i = 0; i < data.size(); i++)
+        {
+            crc.add(data[i]);
+        }
+        benchmark::DoNotOptimize(crc.get());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(data.size()));
+}
+BENCHMARK(BM_TransferCRCBytewise)->Arg(8)->Arg(64)->Arg(256)->Arg(1024);
+
+/**
+ * Multi-frame transfers of the same data type from a varying number of nodes; the frames of different
+ * nodes are interleaved, as they would be on a busy bus.
+ */
+static void BM_TransferListenerReassembly(benchmark::State& state)
+{
+    const unsigned num_nodes = unsigned(state.range(0));
+    const unsigned num_tids = uavcan::TransferID::Max + 1U;
+
+    static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 1024, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    const uavcan::DataTypeDescriptor data_type = makeBenchmarkDataType();
+    CountingListener listener(perf, data_type, pool);
+
+    // frames[transfer_id][node_index] - all transfers have the same number of frames
+    const std::vector<uint8_t> payload(40, 0x42);
+    std::vector<std::vector<std::vector<uavcan::Frame> > > frames(num_tids);
+    for (unsigned tid = 0; tid < num_tids; tid++)
+    {
+        for (unsigned node = 0; node < num_nodes; node++)
+        {
+            frames[tid].push_back(makeTransferFrames(data_type, uint8_t(node + 1), uint8_t(tid), payload));
+        }
+    }
+    const unsigned frames_per_transfer = unsigned(frames[0][0].size());
+
+    uint64_t ts_usec = 1000000;
+    unsigned tid = 0;
+    for (auto _ : state)
+    {
+        for (unsigned i = 0; i < frames_per_transfer; i++)
+        {
+            for (unsigned node = 0; node < num_nodes; node++)
+            {
+                const uavcan::RxFrame rx_frame(frames[tid][node][i], uavcan::MonotonicTime::fromUSec(ts_usec++),
+                                               uavcan::UtcTime(), 0);
+                listener.handleFrame(rx_frame);
+            }
+        }
+        tid = (tid + 1) % num_tids;
+    }
+
+    if (listener.num_transfers != uint64_t(state.iterations()) * num_nodes)
+    {
+        state.SkipWithError("Lost transfers");
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * num_nodes);
+    state.counters["frames"] = double(frames_per_transfer * num_nodes);
+}
+BENCHMARK(BM_TransferListenerReassembly)->Arg(1)->Arg(8)->Arg(32)->Arg(100);
+
+/**
+ * Push and pop of one frame while the queue holds a varying number of frames of random priorities.
+ */
+static void BM_CanTxQueuePushPop(benchmark::State& state)
+{
+    const unsigned depth = unsigned(state.range(0));
+
+    static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 1100, uavcan::MemPoolBlockSize> pool;
+    BenchmarkClock clock;
+    uavcan::CanTxQueue queue(pool, clock, 1100);
+
+    const uavcan::MonotonicTime deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(1000000);
+    uint32_t lcg = 12345;
+    uavcan::CanFrame frame;
+    frame.dlc = 8;
+    for (unsigned i = 0; i < depth; i++)
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        frame.id = (lcg & uavcan::CanFrame::MaskExtID) | uavcan::CanFrame::FlagEFF;
+        queue.push(frame, deadline, uavcan::CanTxQueue::Volatile, uavcan::CanIOFlags());
+    }
+
+    for (auto _ : state)
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        frame.id = (lcg & uavcan::CanFrame::MaskExtID) | uavcan::CanFrame::FlagEFF;
+        queue.push(frame, deadline, uavcan::CanTxQueue::Volatile, uavcan::CanIOFlags());
+        uavcan::CanTxQueue::Entry* entry = queue.peek(0);
+        benchmark::DoNotOptimize(entry);
+        queue.remove(entry, 0);
+    }
+
+    if (queue.getRejectedFrameCount() > 0)
+    {
+        state.SkipWithError("Frames rejected");
+    }
+}
+BENCHMARK(BM_CanTxQueuePushPop)->Arg(0)->Arg(16)->Arg(64)->Arg(256)->Arg(1024);
+
+/**
+ * Sending of single-frame and multi-frame transfers (the first argument is the payload length) straight to the
+ * driver. If the second argument is nonzero, the priority alternates between the transfers, so that the CAN ID
+ * of every frame has to be computed anew.
+ */
+static void BM_TransferSenderSend(benchmark::State& state)
+{
+    const std::vector<uint8_t> payload(std::size_t(state.range(0)), 0x55);
+    const bool alternate_priority = state.range(1) != 0;
+
+    static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 64, uavcan::MemPoolBlockSize> pool;
+    NullCanDriver driver;
+    BenchmarkClock clock;
+    uavcan::OutgoingTransferRegistry<8> otr(pool);
+    uavcan::Dispatcher dispatcher(driver, pool, clock, otr);
+    if (!dispatcher.setNodeID(64))
+    {
+        state.SkipWithError("Invalid node ID");
+        return;
+    }
+    uavcan::TransferSender sender(dispatcher, makeBenchmarkDataType(), uavcan::CanTxQueue::Volatile);
+
+    const uavcan::MonotonicTime tx_deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(1000);
+    uint8_t tid = 0;
+    for (auto _ : state)
+    {
+        if (alternate_priority)
+        {
+            sender.setPriority(uint8_t((tid & 1U) ? 20 : 16));
+        }
+        benchmark::DoNotOptimize(sender.send(&payload[0], unsigned(payload.size()), tx_deadline,
+                                             uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                                             uavcan::NodeID::Broadcast, uavcan::TransferID(tid)));
+        tid = uint8_t((tid + 1U) % (uavcan::TransferID::Max + 1U));
+    }
+
+    if (dispatcher.getTransferPerfCounter().getErrorCount() > 0)
+    {
+        state.SkipWithError("Send errors");
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TransferSenderSend)->Args({7, 0})->Args({7, 1})->Args({60, 0})->Args({60, 1});
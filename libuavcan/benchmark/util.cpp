@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/util/map.hpp>
+#include <uavcan/util/flat_map.hpp>
+#include <uavcan/util/multiset.hpp>
+#include <uavcan/transport/transfer.hpp>
+#include "helpers.hpp"
+
+static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 512, uavcan::MemPoolBlockSize> pool;
+
+typedef uavcan::Map<uavcan::NodeID, uint32_t, 4> BenchmarkMap;
+typedef uavcan::FlatMap<uavcan::NodeID, uint32_t, 4> BenchmarkFlatMap;
+
+/**
+ * Lookup of a random node ID in a map of a varying size, e.g. the receivers of a transfer listener.
+ */
+template <typename MapType>
+static void BM_MapAccess(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    MapType map(pool);
+    for (unsigned i = 0; i < size; i++)
+    {
+        if (map.insert(uavcan::NodeID(uint8_t(i + 1)), i) == NULL)
+        {
+            state.SkipWithError("Out of memory");
+            return;
+        }
+    }
+
+    uint32_t lcg = 1;
+    for (auto _ : state)
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        benchmark::DoNotOptimize(map.access(uavcan::NodeID(uint8_t((lcg >> 16) % size + 1))));
+    }
+}
+BENCHMARK_TEMPLATE(BM_MapAccess, BenchmarkMap)->Arg(1)->Arg(8)->Arg(32)->Arg(127);
+BENCHMARK_TEMPLATE(BM_MapAccess, BenchmarkFlatMap)->Arg(1)->Arg(8)->Arg(32)->Arg(127);
+
+struct MultisetItem
+{
+    uint32_t key;
+    uint32_t payload[3];
+
+    explicit MultisetItem(uint32_t arg_key = 0)
+        : key(arg_key)
+    {
+        payload[0] = payload[1] = payload[2] = 0;
+    }
+
+    struct KeyPredicate
+    {
+        const uint32_t key;
+        explicit KeyPredicate(uint32_t arg_key) : key(arg_key) { }
+        bool operator()(const MultisetItem& item) const { return item.key == key; }
+    };
+};
+
+typedef uavcan::Multiset<MultisetItem, 4> BenchmarkMultiset;
+
+/// Multisets of up to 1000 items need more blocks than the other benchmarks
+static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8192, uavcan::MemPoolBlockSize> multiset_pool;
+
+static bool fillMultiset(BenchmarkMultiset& multiset, unsigned size)
+{
+    for (unsigned i = 0; i < size; i++)
+    {
+        if (multiset.emplace<uint32_t>(i) == NULL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct MultisetKeySumOperator
+{
+    uint32_t sum;
+    MultisetKeySumOperator() : sum(0) { }
+    void operator()(const MultisetItem& item) { sum += item.key; }
+};
+
+struct MultisetSparsePredicate
+{
+    bool operator()(const MultisetItem& item) const { return (item.key % 8U) != 0; }
+};
+
+/**
+ * Search in a multiset of a varying size, e.g. the pending calls of a service client.
+ */
+static void BM_MultisetFind(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    BenchmarkMultiset multiset(multiset_pool);
+    if (!fillMultiset(multiset, size))
+    {
+        state.SkipWithError("Out of memory");
+        return;
+    }
+
+    uint32_t lcg = 1;
+    for (auto _ : state)
+    {
+        lcg = lcg * 1103515245U + 12345U;
+        benchmark::DoNotOptimize(multiset.find(MultisetItem::KeyPredicate((lcg >> 16) % size)));
+    }
+}
+BENCHMARK(BM_MultisetFind)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * Insertion and removal of one item into a multiset of a varying size, e.g. a new service call.
+ * Half of the items have been removed, so the free slots are scattered over the chunks.
+ */
+static void BM_MultisetEmplaceRemove(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    BenchmarkMultiset multiset(multiset_pool);
+    if (!fillMultiset(multiset, size * 2))
+    {
+        state.SkipWithError("Out of memory");
+        return;
+    }
+    for (unsigned i = 0; i < size * 2; i += 2)
+    {
+        multiset.removeFirstWhere(MultisetItem::KeyPredicate(i));
+    }
+
+    const uint32_t key = 0xFFFFFFFFU;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(multiset.emplace<uint32_t>(key));
+        multiset.removeFirstWhere(MultisetItem::KeyPredicate(key));
+    }
+}
+BENCHMARK(BM_MultisetEmplaceRemove)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * Iteration over a sparse multiset of a varying size: only every 8th item is left, the rest of the chunks is empty.
+ */
+static void BM_MultisetForEachSparse(benchmark::State& state)
+{
+    const unsigned size = unsigned(state.range(0));
+    BenchmarkMultiset multiset(multiset_pool);
+    if (!fillMultiset(multiset, size * 8))
+    {
+        state.SkipWithError("Out of memory");
+        return;
+    }
+    multiset.removeAllWhere(MultisetSparsePredicate());
+
+    for (auto _ : state)
+    {
+        MultisetKeySumOperator oper;
+        multiset.forEach<MultisetKeySumOperator&>(oper);
+        benchmark::DoNotOptimize(oper.sum);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK(BM_MultisetForEachSparse)->Arg(10)->Arg(100)->Arg(1000);
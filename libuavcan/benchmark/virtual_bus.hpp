@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "helpers.hpp"
+
+/**
+ * Periodic broadcast transfer published by every simulated node.
+ * The data types are not generated from DSDL; only the payload length matters to the receiving side.
+ */
+struct TrafficStream
+{
+    uavcan::DataTypeDescriptor data_type;
+    unsigned payload_len;
+    uint32_t period_usec;
+    uint8_t priority;
+
+    TrafficStream(const uavcan::DataTypeDescriptor& arg_data_type, unsigned arg_payload_len,
+                  uint32_t arg_period_usec, uint8_t arg_priority)
+        : data_type(arg_data_type)
+        , payload_len(arg_payload_len)
+        , period_usec(arg_period_usec)
+        , priority(arg_priority)
+    { }
+};
+
+/**
+ * Typical traffic of a vehicle node: node status, a medium rate multi-frame status and a high rate sensor feed.
+ * This is about 260 frames per second per node, i.e. about 3.5% of a 1 Mbit/s bus.
+ */
+inline std::vector<TrafficStream> makeDefaultTrafficMix()
+{
+    std::vector<TrafficStream> mix;
+    mix.push_back(TrafficStream(uavcan::DataTypeDescriptor(uavcan::DataTypeKindMessage, 550,
+                                                           uavcan::DataTypeSignature(0x0F0868D0C1A7C6F1ULL),
+                                                           "benchmark.NodeStatus"), 7, 500000, 30));
+    mix.push_back(TrafficStream(uavcan::DataTypeDescriptor(uavcan::DataTypeKindMessage, 1034,
+                                                           uavcan::DataTypeSignature(0xA9AF28AEA2FBB254ULL),
+                                                           "benchmark.EscStatus"), 14, 50000, 16));
+    mix.push_back(TrafficStream(uavcan::DataTypeDescriptor(uavcan::DataTypeKindMessage, 1060,
+                                                           uavcan::DataTypeSignature(0x8280632C40E574B5ULL),
+                                                           "benchmark.ImuSample"), 24, 20000, 8));
+    return mix;
+}
+
+/**
+ * Number of bits the frame occupies on the bus, including the stuff bits and the interframe space.
+ * The stuff bits are computed from the actual bit stream rather than estimated, so the timing is exact.
+ */
+inline unsigned computeCanFrameBitLength(const uavcan::CanFrame& frame)
+{
+    std::vector<bool> bits;
+    const auto push = [&bits](uint32_t value, unsigned width)
+    {
+        for (unsigned i = width; i > 0; i--)
+        {
+            bits.push_back(((value >> (i - 1U)) & 1U) != 0);
+        }
+    };
+
+    push(0, 1);                                                 // SOF
+    if (frame.isExtended())
+    {
+        push((frame.id & uavcan::CanFrame::MaskExtID) >> 18, 11);
+        push(3, 2);                                             // SRR, IDE
+        push(frame.id & 0x3FFFFU, 18);
+        push(frame.isRemoteTransmissionRequest() ? 1 : 0, 1);
+        push(0, 2);                                             // r1, r0
+    }
+    else
+    {
+        push(frame.id & uavcan::CanFrame::MaskStdID, 11);
+        push(frame.isRemoteTransmissionRequest() ? 1 : 0, 1);
+        push(0, 2);                                             // IDE, r0
+    }
+    push(frame.dlc, 4);
+    if (!frame.isRemoteTransmissionRequest())
+    {
+        for (unsigned i = 0; i < frame.dlc; i++)
+        {
+            push(frame.data[i], 8);
+        }
+    }
+
+    uint16_t crc = 0;
+    for (unsigned i = 0; i < bits.size(); i++)
+    {
+        const bool crc_next = bits[i] != (((crc >> 14) & 1U) != 0);
+        crc = uint16_t((crc << 1) & 0x7FFFU);
+        if (crc_next)
+        {
+            crc ^= 0x4599U;
+        }
+    }
+    push(crc, 15);
+
+    unsigned num_stuff_bits = 0;
+    unsigned run_length = 0;
+    bool last_bit = false;
+    for (unsigned i = 0; i < bits.size(); i++)
+    {
+        if ((i > 0) && (bits[i] == last_bit))
+        {
+            run_length++;
+        }
+        else
+        {
+            run_length = 1;
+        }
+        last_bit = bits[i];
+        if (run_length == 5)
+        {
+            num_stuff_bits++;                                   // The stuff bit starts a new run
+            last_bit = !last_bit;
+            run_length = 1;
+        }
+    }
+
+    // CRC delimiter, ACK slot, ACK delimiter, EOF, interframe space
+    return unsigned(bits.size()) + num_stuff_bits + 1 + 2 + 7 + 3;
+}
+
+/**
+ * Deterministic in-process simulation of a CAN bus for the integration benchmarks.
+ *
+ * The bus is shared by a number of simulated nodes that publish the configured traffic mix, and by the nodes
+ * under test, each of which is attached via its own port implementing the ICanDriver interface. The simulation
+ * runs in virtual time: the transmission of every frame takes exactly as long as it would on a real bus with
+ * the configured bit rate, and the frames compete for the bus by the CAN arbitration rules (lowest ID wins,
+ * frames of equal ID are transmitted in the order of submission).
+ *
+ * Every port is modelled as a controller with a limited number of TX mailboxes and an RX FIFO of limited depth;
+ * the frames that arrive while the FIFO is full are lost, like on the real hardware.
+ * The frame timestamps and the clock are the virtual time, so the results are reproducible.
+ */
+class VirtualBus : uavcan::Noncopyable
+{
+public:
+    struct Config
+    {
+        uint32_t bitrate;
+        unsigned rx_fifo_depth;
+        unsigned tx_mailboxes;
+        unsigned remote_tx_queue_depth;     ///< Frames in excess are dropped by the simulated nodes
+        uint32_t seed;
+
+        Config()
+            : bitrate(1000000)
+            , rx_fifo_depth(64)
+            , tx_mailboxes(3)
+            , remote_tx_queue_depth(64)
+            , seed(1)
+        { }
+    };
+
+    struct Statistics
+    {
+        uint64_t frames;                    ///< All frames transmitted on the bus
+        uint64_t busy_nsec;
+        uint64_t rx_frames;                 ///< Frames delivered to the nodes under test
+        uint64_t rx_overflows;              ///< Frames lost because the RX FIFO of a node under test was full
+        uint64_t tx_frames;                 ///< Frames transmitted by the nodes under test
+        uint64_t tx_timeouts;               ///< Frames of the nodes under test dropped from the mailboxes
+        uint64_t remote_tx_drops;           ///< Frames dropped by the simulated nodes because the bus was saturated
+
+        Statistics()
+            : frames(0)
+            , busy_nsec(0)
+            , rx_frames(0)
+            , rx_overflows(0)
+            , tx_frames(0)
+            , tx_timeouts(0)
+            , remote_tx_drops(0)
+        { }
+    };
+
+    /**
+     * Invoked when a frame of a node under test has been transmitted; the argument is the virtual time in
+     * microseconds when the transmission was completed.
+     */
+    typedef std::function<void (const uavcan::CanFrame&, uint64_t)> TxObserver;
+
+private:
+    struct PendingFrame
+    {
+        uavcan::CanFrame frame;
+        uint64_t deadline_usec;             ///< Zero if none
+        uavcan::CanIOFlags flags;
+    };
+
+    struct RxEntry
+    {
+        uavcan::CanFrame frame;
+        uint64_t ts_usec;
+        uavcan::CanIOFlags flags;
+    };
+
+public:
+    /**
+     * Attachment point of a node under test.
+     */
+    class Port : public uavcan::ICanDriver, public uavcan::ICanIface, uavcan::Noncopyable
+    {
+        friend class VirtualBus;
+
+        VirtualBus& bus_;
+        std::deque<PendingFrame> mailboxes_;
+        std::deque<RxEntry> rx_fifo_;
+
+        void dropExpiredMailboxes()
+        {
+            const uint64_t now_usec = bus_.getTimeUSec();
+            for (std::deque<PendingFrame>::iterator it = mailboxes_.begin(); it != mailboxes_.end();)
+            {
+                if ((it->deadline_usec != 0) && (it->deadline_usec < now_usec))
+                {
+                    bus_.stats_.tx_timeouts++;
+                    it = mailboxes_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        void pushRx(const uavcan::CanFrame& frame, uavcan::CanIOFlags flags)
+        {
+            if (rx_fifo_.size() >= bus_.config_.rx_fifo_depth)
+            {
+                bus_.stats_.rx_overflows++;
+                return;
+            }
+            RxEntry e;
+            e.frame = frame;
+            e.ts_usec = bus_.getTimeUSec();
+            e.flags = flags;
+            rx_fifo_.push_back(e);
+            bus_.stats_.rx_frames++;
+        }
+
+    public:
+        explicit Port(VirtualBus& bus) : bus_(bus) { }
+
+        /*
+         * ICanIface
+         */
+        virtual int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                             uavcan::CanIOFlags flags)
+        {
+            if (mailboxes_.size() >= bus_.config_.tx_mailboxes)
+            {
+                return 0;
+            }
+            PendingFrame pf;
+            pf.frame = frame;
+            pf.deadline_usec = tx_deadline.toUSec();
+            pf.flags = flags;
+            mailboxes_.push_back(pf);
+            return 1;
+        }
+
+        virtual int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+        {
+            if (rx_fifo_.empty())
+            {
+                return 0;
+            }
+            const RxEntry& e = rx_fifo_.front();
+            out_frame = e.frame;
+            out_ts_monotonic = uavcan::MonotonicTime::fromUSec(e.ts_usec);
+            out_ts_utc = uavcan::UtcTime::fromUSec(e.ts_usec);
+            out_flags = e.flags;
+            rx_fifo_.pop_front();
+            return 1;
+        }
+
+        virtual int16_t configureFilters(const uavcan::CanFilterConfig*, uint16_t) { return 0; }
+        virtual uint16_t getNumFilters() const { return 0; }
+        virtual uint64_t getErrorCount() const { return bus_.stats_.rx_overflows; }
+
+        /*
+         * ICanDriver
+         */
+        virtual uavcan::ICanIface* getIface(uint8_t iface_index) { return (iface_index == 0) ? this : NULL; }
+        virtual uint8_t getNumIfaces() const { return 1; }
+
+        /**
+         * Never blocks: the virtual time only advances in @ref VirtualBus::advance().
+         */
+        virtual int16_t select(uavcan::CanSelectMasks& inout_masks, const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                               uavcan::MonotonicTime)
+        {
+            inout_masks.read = rx_fifo_.empty() ? 0 : 1;
+            inout_masks.write = (mailboxes_.size() < bus_.config_.tx_mailboxes) ? 1 : 0;
+            return int16_t(inout_masks.read + inout_masks.write);
+        }
+    };
+
+private:
+    struct StreamState
+    {
+        const TrafficStream* stream;
+        uint64_t next_release_nsec;
+        uint8_t transfer_id;
+    };
+
+    struct SimulatedNode
+    {
+        uavcan::NodeID node_id;
+        std::vector<StreamState> streams;
+        std::deque<PendingFrame> tx_queue;
+    };
+
+    const Config config_;
+    const std::vector<TrafficStream> mix_;
+    std::vector<SimulatedNode> nodes_;
+    std::vector<std::unique_ptr<Port> > ports_;
+    uint64_t now_nsec_;
+    Statistics stats_;
+    TxObserver tx_observer_;
+
+    static const unsigned NoWinner = ~0U;
+
+    void releaseDueTransfers()
+    {
+        for (unsigned n = 0; n < nodes_.size(); n++)
+        {
+            SimulatedNode& node = nodes_[n];
+            for (unsigned s = 0; s < node.streams.size(); s++)
+            {
+                StreamState& st = node.streams[s];
+                while (st.next_release_nsec <= now_nsec_)
+                {
+                    const std::vector<uint8_t> payload(st.stream->payload_len, uint8_t(st.transfer_id));
+                    std::vector<uavcan::Frame> frames =
+                        makeTransferFrames(st.stream->data_type, node.node_id, st.transfer_id, payload);
+                    for (unsigned i = 0; i < frames.size(); i++)
+                    {
+                        if (node.tx_queue.size() >= config_.remote_tx_queue_depth)
+                        {
+                            stats_.remote_tx_drops++;
+                            continue;
+                        }
+                        frames[i].setPriority(st.stream->priority);
+                        PendingFrame pf = PendingFrame();
+                        (void)frames[i].compile(pf.frame);
+                        node.tx_queue.push_back(pf);
+                    }
+                    st.transfer_id = uint8_t((st.transfer_id + 1U) & uavcan::TransferID::Max);
+                    st.next_release_nsec += uint64_t(st.stream->period_usec) * 1000U;
+                }
+            }
+        }
+    }
+
+    uint64_t getNextReleaseTime() const
+    {
+        uint64_t result = ~uint64_t(0);
+        for (unsigned n = 0; n < nodes_.size(); n++)
+        {
+            for (unsigned s = 0; s < nodes_[n].streams.size(); s++)
+            {
+                result = std::min(result, nodes_[n].streams[s].next_release_nsec);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Returns the index of the frame with the lowest ID in the queue, or NoWinner if the queue is empty.
+     * The first one is selected if there are several frames with the same ID.
+     */
+    static unsigned findHighestPriority(const std::deque<PendingFrame>& queue)
+    {
+        unsigned best = NoWinner;
+        for (unsigned i = 0; i < queue.size(); i++)
+        {
+            if ((best == NoWinner) || queue[i].frame.priorityHigherThan(queue[best].frame))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Runs one round of arbitration and transmits the winner. Returns false if the bus is idle.
+     * The ports take part in the arbitration before the simulated nodes, so they win the ties.
+     */
+    bool transmitNextFrame()
+    {
+        std::deque<PendingFrame>* winner_queue = NULL;
+        unsigned winner_index = 0;
+        Port* winner_port = NULL;
+
+        for (unsigned p = 0; p < ports_.size(); p++)
+        {
+            ports_[p]->dropExpiredMailboxes();
+            const unsigned index = findHighestPriority(ports_[p]->mailboxes_);
+            if ((index != NoWinner) &&
+                ((winner_queue == NULL) ||
+                 ports_[p]->mailboxes_[index].frame.priorityHigherThan((*winner_queue)[winner_index].frame)))
+            {
+                winner_queue = &ports_[p]->mailboxes_;
+                winner_index = index;
+                winner_port = ports_[p].get();
+            }
+        }
+        for (unsigned n = 0; n < nodes_.size(); n++)
+        {
+            const unsigned index = findHighestPriority(nodes_[n].tx_queue);
+            if ((index != NoWinner) &&
+                ((winner_queue == NULL) ||
+                 nodes_[n].tx_queue[index].frame.priorityHigherThan((*winner_queue)[winner_index].frame)))
+            {
+                winner_queue = &nodes_[n].tx_queue;
+                winner_index = index;
+                winner_port = NULL;
+            }
+        }
+        if (winner_queue == NULL)
+        {
+            return false;
+        }
+
+        const PendingFrame pf = (*winner_queue)[winner_index];
+        winner_queue->erase(winner_queue->begin() + winner_index);
+
+        const uint64_t duration_nsec =
+            (uint64_t(computeCanFrameBitLength(pf.frame)) * 1000000000ULL) / config_.bitrate;
+        now_nsec_ += duration_nsec;
+        stats_.busy_nsec += duration_nsec;
+        stats_.frames++;
+
+        for (unsigned p = 0; p < ports_.size(); p++)
+        {
+            if (ports_[p].get() != winner_port)
+            {
+                ports_[p]->pushRx(pf.frame, 0);
+            }
+        }
+        if (winner_port != NULL)
+        {
+            stats_.tx_frames++;
+            if (pf.flags & uavcan::CanIOFlagLoopback)
+            {
+                winner_port->pushRx(pf.frame, uavcan::CanIOFlagLoopback);
+            }
+            if (tx_observer_)
+            {
+                tx_observer_(pf.frame, now_nsec_ / 1000U);
+            }
+        }
+        return true;
+    }
+
+public:
+    /**
+     * The simulated nodes are assigned Node ID 1, 2, ..., skipping the specified Node ID, which is supposed to be
+     * used by a node under test. The phases of the streams are randomized deterministically by the seed.
+     * The bus has no ports initially; see @ref addPort().
+     */
+    VirtualBus(unsigned num_nodes, uavcan::NodeID reserved_node_id, const std::vector<TrafficStream>& mix,
+               uint64_t start_usec, const Config& config = Config())
+        : config_(config)
+        , mix_(mix)
+        , now_nsec_(start_usec * 1000U)
+    {
+        uint32_t lcg = config_.seed;
+        uint8_t nid = 1;
+        for (unsigned n = 0; n < num_nodes; n++)
+        {
+            if (nid == reserved_node_id.get())
+            {
+                nid++;
+            }
+            SimulatedNode node;
+            node.node_id = nid++;
+            for (unsigned s = 0; s < mix_.size(); s++)
+            {
+                lcg = lcg * 1103515245U + 12345U;
+                StreamState st;
+                st.stream = &mix_[s];
+                st.next_release_nsec = now_nsec_ + (uint64_t((lcg >> 8) % mix_[s].period_usec) * 1000U);
+                st.transfer_id = 0;
+                node.streams.push_back(st);
+            }
+            nodes_.push_back(node);
+        }
+    }
+
+    /**
+     * Attaches a new node under test to the bus. The returned reference stays valid until the bus is destroyed.
+     */
+    Port& addPort()
+    {
+        ports_.push_back(std::unique_ptr<Port>(new Port(*this)));
+        return *ports_.back();
+    }
+
+    /**
+     * Simulates the bus until the specified virtual time. The transmission that is in progress at that time is
+     * completed, so the bus may run slightly past the specified time.
+     */
+    void advance(uint64_t until_usec)
+    {
+        const uint64_t until_nsec = until_usec * 1000U;
+        while (now_nsec_ < until_nsec)
+        {
+            releaseDueTransfers();
+            if (!transmitNextFrame())
+            {
+                now_nsec_ = std::max(now_nsec_, std::min(getNextReleaseTime(), until_nsec));
+            }
+        }
+    }
+
+    uint64_t getTimeUSec() const { return now_nsec_ / 1000U; }
+
+    const Statistics& getStatistics() const { return stats_; }
+
+    void setTxObserver(const TxObserver& observer) { tx_observer_ = observer; }
+};
@@ -12,7 +12,7 @@ It is based on the DSDL parsing package from pyuavcan.
 '''
 
 from __future__ import division, absolute_import, print_function, unicode_literals
-import sys, os, logging, errno, re
+import sys, os, logging, errno, re, json, hashlib, multiprocessing
 from .pyratemp import Template
 from uavcan import dsdl
 
@@ -23,8 +23,15 @@ except NameError:
     pass
 
 OUTPUT_FILE_EXTENSION = 'hpp'
+STREAM_OUTPUT_FILE_SUFFIX = '_stream'
 OUTPUT_FILE_PERMISSIONS = 0o444  # Read only for all
 TEMPLATE_FILENAME = os.path.join(os.path.dirname(__file__), 'data_type_template.tmpl')
+STREAM_TEMPLATE_FILENAME = os.path.join(os.path.dirname(__file__), 'data_type_stream_template.tmpl')
+STREAM_HEADER_TEMPLATE_FILENAME = os.path.join(os.path.dirname(__file__), 'data_type_stream_header_template.tmpl')
+TABLE_TEMPLATE_FILENAME = os.path.join(os.path.dirname(__file__), 'data_type_table_template.tmpl')
+MAX_FLAT_PREFIX_BITLEN = 512     # Size of the temporary buffer used by the generated code, see flatten_fixed_layout
+CACHE_FILENAME = '.libuavcan_dsdlc_cache.json'
+CACHE_VERSION = 2
 
 __all__ = ['run', 'logger', 'DsdlCompilerException']
 
@@ -33,7 +40,8 @@ class DsdlCompilerException(Exception):
 
 logger = logging.getLogger(__name__)
 
-def run(source_dirs, include_dirs, output_dir):
+def run(source_dirs, include_dirs, output_dir, flatten_fixed_layout=False, data_type_table=None, jobs=0,
+        slim=False):
     '''
     This function takes a list of root namespace directories (containing DSDL definition files to parse), a
     possibly empty list of search directories (containing DSDL definition files that can be referenced from the types
@@ -49,6 +57,20 @@ def run(source_dirs, include_dirs, output_dir):
         include_dirs   List of root namespace directories with referenced types (possibly empty). This list is
                        automaitcally extended with source_dirs.
         output_dir     Output directory path. Will be created if doesn't exist.
+        flatten_fixed_layout  If True, the leading primitive fields of every type will be encoded/decoded at once,
+                       with the bit offsets computed by the compiler rather than tracked at run time.
+        data_type_table  If set, the table of all types with default data type ID will be written into this file,
+                       relative to the output directory; see GlobalDataTypeRegistry::adoptDataTypeTable().
+        jobs           Number of worker processes that render the types; zero means one per CPU, one disables
+                       the workers.
+        slim           If True, the type headers will contain only the data structures, the codec, and the
+                       constants; the YAML streaming code (operator<<) will be generated into a separate header
+                       next to each type header, e.g. uavcan/protocol/NodeStatus_stream.hpp. Otherwise the
+                       streaming code is defined in the type header, and the stream header just includes it.
+
+    The output directory also keeps a cache that maps the hash of each type's definition (including the types it
+    depends on, the templates, and the options) to the hash of its generated header. The types whose definitions
+    and headers didn't change since the previous run are not rendered again.
     '''
     assert isinstance(source_dirs, list)
     assert isinstance(include_dirs, list)
@@ -59,7 +81,9 @@ def run(source_dirs, include_dirs, output_dir):
         die('No type definitions were found')
 
     logger.info('%d types total', len(types))
-    run_generator(types, output_dir)
+    run_generator(types, output_dir, flatten_fixed_layout, slim, jobs)
+    if data_type_table:
+        run_table_generator(types, output_dir, data_type_table)
 
 # -----------------
 
@@ -75,6 +99,10 @@ def type_output_filename(t):
     assert t.category == t.CATEGORY_COMPOUND
     return t.full_name.replace('.', os.path.sep) + '.' + OUTPUT_FILE_EXTENSION
 
+def type_stream_output_filename(t):
+    assert t.category == t.CATEGORY_COMPOUND
+    return t.full_name.replace('.', os.path.sep) + STREAM_OUTPUT_FILE_SUFFIX + '.' + OUTPUT_FILE_EXTENSION
+
 def makedirs(path):
     try:
         try:
@@ -96,20 +124,207 @@ def run_parser(source_dirs, search_dirs):
         die(ex)
     return types
 
-def run_generator(types, dest_dir):
+def run_generator(types, dest_dir, flatten_fixed_layout, slim=False, jobs=1):
     try:
-        template_expander = make_template_expander(TEMPLATE_FILENAME)
         dest_dir = os.path.abspath(dest_dir)  # Removing '..'
         makedirs(dest_dir)
+
+        cache_filename = os.path.join(dest_dir, CACHE_FILENAME)
+        cache = read_cache(cache_filename)
+        new_cache = {}
+        keys = compute_type_keys(types, flatten_fixed_layout, slim)
+
+        def is_up_to_date(t):
+            entry = cache.get(t.full_name)
+            if not keys.get(t.full_name) or not entry or entry.get('key') != keys[t.full_name]:
+                return False
+            outputs = entry.get('outputs', {})
+            for name in (type_output_filename(t), type_stream_output_filename(t)):
+                if name not in outputs or outputs[name] != hash_file(os.path.join(dest_dir, name)):
+                    return False
+            return True
+
+        outdated = []
         for t in types:
-            logger.info('Generating type %s', t.full_name)
-            filename = os.path.join(dest_dir, type_output_filename(t))
-            text = generate_one_type(template_expander, t)
-            write_generated_data(filename, text)
+            if is_up_to_date(t):
+                logger.info('Up to date [%s]', t.full_name)
+                new_cache[t.full_name] = cache[t.full_name]
+            else:
+                outdated.append(t)
+
+        logger.info('%d types to generate', len(outdated))
+        for t, files in zip(outdated, generate_types(outdated, flatten_fixed_layout, slim, jobs)):
+            for name, text in files:
+                write_generated_data(os.path.join(dest_dir, name), text)
+            if keys.get(t.full_name):
+                outputs = dict((name, hash_text(text)) for name, text in files)
+                new_cache[t.full_name] = {'key': keys[t.full_name], 'outputs': outputs}
+
+        if new_cache != cache:
+            write_cache(cache_filename, new_cache)
     except Exception as ex:
         logger.info('Generator failure', exc_info=True)
         die(ex)
 
+def generate_types(types, flatten_fixed_layout, slim, jobs):
+    '''
+    Renders the types, possibly in worker processes; returns the lists of output files in the same order,
+    see generate_one_type().
+    Falls back to rendering in this process if the workers can't be used.
+    '''
+    if jobs <= 0:
+        try:
+            jobs = multiprocessing.cpu_count()
+        except NotImplementedError:
+            jobs = 1
+    jobs = min(jobs, len(types))
+    if jobs > 1:
+        pool = make_worker_pool(jobs, flatten_fixed_layout, slim)
+        if pool is not None:
+            try:
+                return pool.map(generate_one_type_in_worker, types, chunksize=max(1, len(types) // (jobs * 4)))
+            except Exception as ex:     # E.g. the types can't be pickled with this version of the parser
+                logger.warning('Worker processes failed, generating serially: %s', ex)
+            finally:
+                pool.terminate()
+    template_expanders = make_type_template_expanders()
+    out = []
+    for t in types:
+        logger.info('Generating type %s', t.full_name)
+        out.append(generate_one_type(template_expanders, t, flatten_fixed_layout, slim))
+    return out
+
+_worker_state = {}
+
+def init_worker(flatten_fixed_layout, slim):
+    _worker_state['template_expanders'] = make_type_template_expanders()
+    _worker_state['flatten_fixed_layout'] = flatten_fixed_layout
+    _worker_state['slim'] = slim
+
+def generate_one_type_in_worker(t):
+    return generate_one_type(_worker_state['template_expanders'], t, _worker_state['flatten_fixed_layout'],
+                             _worker_state['slim'])
+
+def make_worker_pool(jobs, flatten_fixed_layout, slim):
+    # The workers must be forked: a spawned worker would re-execute the compiler script that imported this module
+    try:
+        context = multiprocessing.get_context('fork')
+    except ValueError:
+        return None
+    except AttributeError:          # Python 2.7 forks on POSIX
+        if os.name != 'posix':
+            return None
+        context = multiprocessing
+    try:
+        return context.Pool(jobs, initializer=init_worker, initargs=(flatten_fixed_layout, slim))
+    except (OSError, ImportError) as ex:
+        logger.warning('Could not start worker processes: %s', ex)
+        return None
+
+def hash_text(text):
+    return hashlib.sha1(text.encode('utf8')).hexdigest()
+
+def hash_file(filename):
+    try:
+        with open(filename, 'rb') as f:
+            return hashlib.sha1(f.read()).hexdigest()
+    except (OSError, IOError):
+        return None
+
+def read_cache(filename):
+    try:
+        with open(filename) as f:
+            cache = json.load(f)
+        if cache.get('version') == CACHE_VERSION:
+            return cache.get('types', {})
+        logger.info('Cache version mismatch, ignoring [%s]', pretty_filename(filename))
+    except (OSError, IOError, ValueError, AttributeError):
+        pass
+    return {}
+
+def write_cache(filename, types):
+    try:
+        with open(filename, 'w') as f:
+            json.dump({'version': CACHE_VERSION, 'types': types}, f, indent=1, sort_keys=True)
+    except (OSError, IOError) as ex:
+        logger.warning('Failed to write the cache %s: %s', pretty_filename(filename), ex)
+
+def read_type_source(t):
+    text = getattr(t, 'source_text', None)
+    if text is None:
+        try:
+            with open(t.source_file) as f:
+                text = f.read()
+        except (AttributeError, OSError, IOError):
+            return None
+    return text
+
+def compute_type_keys(types, flatten_fixed_layout, slim):
+    '''
+    Returns a dict that maps the full name of each type to the hash of everything its generated header depends on:
+    the definition of the type and of all the types it refers to, the compiler itself, and the options.
+    The types whose definitions are not available from the parser are not included.
+    '''
+    compiler = hashlib.sha1()
+    compiler.update(str(CACHE_VERSION).encode('utf8'))
+    compiler.update(str(bool(flatten_fixed_layout)).encode('utf8'))
+    compiler.update(str(bool(slim)).encode('utf8'))
+    for filename in (TEMPLATE_FILENAME, STREAM_TEMPLATE_FILENAME, STREAM_HEADER_TEMPLATE_FILENAME,
+                     os.path.splitext(__file__)[0] + '.py',
+                     os.path.join(os.path.dirname(__file__), 'pyratemp.py')):
+        compiler.update((hash_file(filename) or '').encode('utf8'))
+
+    def nested_types(t):
+        fields = t.fields if t.kind == t.KIND_MESSAGE else (t.request_fields + t.response_fields)
+        out = []
+        for a in fields:
+            x = a.type
+            while x.category == x.CATEGORY_ARRAY:
+                x = x.value_type
+            if x.category == x.CATEGORY_COMPOUND:
+                out.append(x)
+        return out
+
+    keys = {}
+    def compute(t, visiting):
+        if t.full_name in keys:
+            return keys[t.full_name]
+        source = read_type_source(t)
+        if source is None or t.full_name in visiting:
+            return None
+        visiting.add(t.full_name)
+        h = compiler.copy()
+        h.update(t.full_name.encode('utf8'))
+        h.update(str(t.default_dtid).encode('utf8'))
+        h.update(source.encode('utf8'))
+        for x in sorted(nested_types(t), key=lambda x: x.full_name):
+            nested_key = compute(x, visiting)
+            if nested_key is None:
+                visiting.discard(t.full_name)
+                return None
+            h.update(nested_key.encode('utf8'))
+        visiting.discard(t.full_name)
+        keys[t.full_name] = h.hexdigest()
+        return keys[t.full_name]
+
+    for t in types:
+        compute(t, set())
+    return keys
+
+def run_table_generator(types, dest_dir, table_filename):
+    try:
+        template_expander = make_template_expander(TABLE_TEMPLATE_FILENAME)
+        dest_dir = os.path.abspath(dest_dir)
+        filename = os.path.join(dest_dir, table_filename)
+        text = generate_data_type_table(template_expander, types, table_filename)
+        if text is None:
+            logger.warning('No types with default data type ID, the data type table will not be generated')
+            return
+        write_generated_data(filename, text)
+    except Exception as ex:
+        logger.info('Table generator failure', exc_info=True)
+        die(ex)
+
 def write_generated_data(filename, data):
     dirname = os.path.dirname(filename)
     makedirs(dirname)
@@ -163,25 +378,62 @@ def type_to_cpp_type(t):
     else:
         raise DsdlCompilerException('Unknown type category: %s' % t.category)
 
-def generate_one_type(template_expander, t):
+def find_flat_prefix(fields, union):
+    '''
+    Returns the leading fields of a struct that have fixed offsets, i.e. primitives and void fields, along with
+    the total length of the prefix in bits. Each returned field is assigned the attribute flat_bit_offset.
+    Prefixes of less than two fields are not worth flattening, so they are not reported.
+    '''
+    if union:
+        return [], 0
+    prefix, bitlen = [], 0
+    for a in fields:
+        if a.type.category not in (a.type.CATEGORY_PRIMITIVE, a.type.CATEGORY_VOID):
+            break
+        if bitlen + a.type.bitlen > MAX_FLAT_PREFIX_BITLEN:
+            break
+        a.flat_bit_offset = bitlen
+        bitlen += a.type.bitlen
+        prefix.append(a)
+    if len(prefix) < 2:
+        return [], 0
+    return prefix, bitlen
+
+def make_type_template_expanders():
+    return (make_template_expander(TEMPLATE_FILENAME),
+            make_template_expander(STREAM_TEMPLATE_FILENAME),
+            make_template_expander(STREAM_HEADER_TEMPLATE_FILENAME))
+
+def generate_one_type(template_expanders, t, flatten_fixed_layout=False, slim=False):
+    '''
+    Returns the list of output files of the type as pairs (file name relative to the output directory, text):
+    the type header and the stream header.
+    '''
+    template_expander, stream_template_expander, stream_header_template_expander = template_expanders
     t.short_name = t.full_name.split('.')[-1]
     t.cpp_type_name = t.short_name + '_'
     t.cpp_full_type_name = '::' + t.full_name.replace('.', '::')
     t.include_guard = t.full_name.replace('.', '_').upper() + '_HPP_INCLUDED'
+    t.stream_include_guard = t.full_name.replace('.', '_').upper() + '_STREAM_HPP_INCLUDED'
+    t.cpp_own_include = type_output_filename(t).replace(os.path.sep, '/')
+    t.slim = slim
 
     # Dependencies (no duplicates)
-    def fields_includes(fields):
+    def fields_includes(fields, output_filename=type_output_filename):
         def detect_include(t):
             if t.category == t.CATEGORY_COMPOUND:
-                return type_output_filename(t)
+                return output_filename(t)
             if t.category == t.CATEGORY_ARRAY:
                 return detect_include(t.value_type)
         return list(sorted(set(filter(None, [detect_include(x.type) for x in fields]))))
 
     if t.kind == t.KIND_MESSAGE:
         t.cpp_includes = fields_includes(t.fields)
+        t.cpp_stream_includes = fields_includes(t.fields, type_stream_output_filename) if slim else []
     else:
         t.cpp_includes = fields_includes(t.request_fields + t.response_fields)
+        t.cpp_stream_includes = fields_includes(t.request_fields + t.response_fields,
+                                                type_stream_output_filename) if slim else []
 
     t.cpp_namespace_components = t.full_name.split('.')[:-1]
     t.has_default_dtid = t.default_dtid is not None
@@ -211,6 +463,16 @@ def generate_one_type(template_expander, t):
         t.request_union = t.request_union and len(t.request_fields)
         t.response_union = t.response_union and len(t.response_fields)
 
+    # Fixed layout prefixes
+    if t.kind == t.KIND_MESSAGE:
+        t.flat_prefix, t.flat_prefix_bitlen = \
+            find_flat_prefix(t.fields, t.union) if flatten_fixed_layout else ([], 0)
+    else:
+        t.request_flat_prefix, t.request_flat_prefix_bitlen = \
+            find_flat_prefix(t.request_fields, t.request_union) if flatten_fixed_layout else ([], 0)
+        t.response_flat_prefix, t.response_flat_prefix_bitlen = \
+            find_flat_prefix(t.response_fields, t.response_union) if flatten_fixed_layout else ([], 0)
+
     # Constant properties
     def inject_constant_info(constants):
         for c in constants:
@@ -236,11 +498,57 @@ def generate_one_type(template_expander, t):
     }[t.kind]
 
     # Generation
-    text = template_expander(t=t)  # t for Type
+    def postprocess(text):
+        text = '\n'.join(x.rstrip() for x in text.splitlines())
+        text = text.replace('\n\n\n\n\n', '\n\n').replace('\n\n\n\n', '\n\n').replace('\n\n\n', '\n\n')
+        return text.replace('{\n\n ', '{\n ')
+
+    # In the slim mode the streaming code goes into the stream header, otherwise it is appended to the type header
+    stream_code = stream_template_expander(t=t).strip()
+    t.stream_code = '' if slim else stream_code
+    text = postprocess(template_expander(t=t))  # t for Type
+    stream_text = postprocess(stream_header_template_expander(t=t, stream_code=stream_code if slim else ''))
+    return [(type_output_filename(t), text), (type_stream_output_filename(t), stream_text)]
+
+def generate_data_type_table(template_expander, types, table_filename):
+    '''
+    Generates the table of types with default data type ID, ordered by kind then ID, as expected by
+    GlobalDataTypeRegistry::adoptDataTypeTable(). Returns None if there are no such types.
+    '''
+    def kind_order(t):     # Same as the order of uavcan::DataTypeKind
+        return 0 if t.kind == t.KIND_SERVICE else 1
+
+    table_types = [t for t in types if t.default_dtid is not None]
+    if not table_types:
+        return None
+    table_types.sort(key=lambda t: (kind_order(t), t.default_dtid))
+
+    includes = []
+    for t in table_types:
+        t.cpp_kind = {
+            t.KIND_MESSAGE: '::uavcan::DataTypeKindMessage',
+            t.KIND_SERVICE: '::uavcan::DataTypeKindService',
+        }[t.kind]
+        # The aggregate signature includes the signatures of the nested types; older versions of the DSDL parser
+        # can't compute it, in which case it is computed at run time by the generated type itself
+        try:
+            signature = t.get_data_type_signature()
+        except AttributeError:
+            signature = None
+        if signature is not None:
+            t.cpp_signature_expression = '::uavcan::DataTypeSignature(0x%016XULL)' % signature
+        else:
+            t.cpp_signature_expression = '::' + t.full_name.replace('.', '::') + '::getDataTypeSignature()'
+            includes.append(type_output_filename(t))
+
+    base_name = os.path.splitext(table_filename)[0]
+    namespace = re.sub(r'[^a-zA-Z0-9_]', '_', base_name)
+    include_guard = namespace.upper() + '_HPP_INCLUDED'
+
+    text = template_expander(types=table_types, includes=includes, namespace=namespace, include_guard=include_guard)
     text = '\n'.join(x.rstrip() for x in text.splitlines())
-    text = text.replace('\n\n\n\n\n', '\n\n').replace('\n\n\n\n', '\n\n').replace('\n\n\n', '\n\n')
-    text = text.replace('{\n\n ', '{\n ')
-    return text
+    text = text.replace('\n\n\n\n', '\n\n').replace('\n\n\n', '\n\n')
+    return text + '\n'
 
 def make_template_expander(filename):
     '''
@@ -7,7 +7,9 @@ args = dict(
     version='0.1',
     description='UAVCAN DSDL compiler for libuavcan',
     packages=['libuavcan_dsdl_compiler'],
-    package_data={'libuavcan_dsdl_compiler': ['data_type_template.tmpl']},
+    package_data={'libuavcan_dsdl_compiler': ['data_type_template.tmpl', 'data_type_stream_template.tmpl',
+                                                'data_type_stream_header_template.tmpl',
+                                                'data_type_table_template.tmpl']},
     scripts=['libuavcan_dsdlc'],
     requires=['uavcan'],
     author='Pavel Kirienko',
@@ -136,6 +136,214 @@
 # define UAVCAN_USE_EXTERNAL_SNPRINTF   0
 #endif
 
+/**
+ * Transfer CRC implementation.
+ * UAVCAN_CRC_SLICING_BY_4 enables a faster table-driven algorithm that processes four bytes per iteration at the
+ * expense of 1.5 KB of extra lookup tables. It is enabled by default for general-purpose targets, where 1.5 KB of
+ * read-only data is negligible; on microcontrollers it would compete with the flash budget of the application.
+ * UAVCAN_USE_EXTERNAL_CRC allows the user's application to provide a custom implementation of block CRC computation,
+ * which is useful if the target has a hardware CRC unit; see uavcan::computeTransferCrcExternally().
+ */
+#ifndef UAVCAN_CRC_SLICING_BY_4
+# define UAVCAN_CRC_SLICING_BY_4 (UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY)
+#endif
+
+#ifndef UAVCAN_USE_EXTERNAL_CRC
+# define UAVCAN_USE_EXTERNAL_CRC 0
+#endif
+
+#if UAVCAN_CRC_SLICING_BY_4 && UAVCAN_TINY
+# error UAVCAN_CRC_SLICING_BY_4 is not available in tiny mode
+#endif
+
+/**
+ * Compact monotonic time, for tiny builds on targets where 64-bit arithmetic is expensive.
+ * If enabled, uavcan::MonotonicTime is a wrapping 32-bit counter of ticks and uavcan::MonotonicDuration is a saturating
+ * 32-bit number of ticks, where the tick is UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC microseconds long (1000 or
+ * 10). This halves the size of every timestamp and deadline and makes the comparisons in the hot path single-word.
+ * Limitations:
+ *  - Two time points can only be compared if they are less than half of the wrap period apart, which is 24.8 days
+ *    with 1 ms resolution and 5.9 hours with 10 us resolution; durations are limited to the same range.
+ *  - Intervals shorter than one tick are truncated.
+ *  - With 10 us resolution, the 32-bit millisecond timestamps of the transfer receivers and the node status monitor
+ *    are not continuous across the wrap, so that a timeout may be misdetected once per wrap period (11.9 hours).
+ * The UTC time is not affected. Requires UAVCAN_TINY. Disabled by default.
+ */
+#ifndef UAVCAN_COMPACT_MONOTONIC_TIME
+# define UAVCAN_COMPACT_MONOTONIC_TIME 0
+#endif
+
+#ifndef UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC
+# define UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC 1000
+#endif
+
+#if UAVCAN_COMPACT_MONOTONIC_TIME && !UAVCAN_TINY
+# error UAVCAN_COMPACT_MONOTONIC_TIME is only available in tiny mode
+#endif
+
+#if (UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC != 1000) && (UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC != 10)
+# error UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC must be either 1000 or 10
+#endif
+
+/**
+ * Dynamic transfer buffer allocation strategy.
+ * If enabled, a dynamic transfer buffer first requests the whole remaining capacity from the pool as one
+ * contiguous span, and falls back to regular pool blocks if the allocator can't serve the request. This makes sense
+ * with allocators that have large block size classes, such as uavcan::MultiSizePoolAllocator; other allocators
+ * will simply refuse the large requests. The cost is two bytes less payload per regular block.
+ * Enabled by default for general-purpose targets, where the pool is large enough for the two bytes not to matter
+ * and the allocators with large size classes are typically used.
+ */
+#ifndef UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+# define UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS (UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY)
+#endif
+
+/**
+ * Deadline scheduler implementation.
+ * By default, deadline handlers (timers, service call timeouts, etc.) are kept in a sorted linked list, which makes
+ * every start/stop operation O(N) of the number of running handlers. If UAVCAN_DEADLINE_SCHEDULER_HEAP is enabled,
+ * an intrusive pairing heap is used instead: start and stop are O(1) and O(log N) amortized, at the cost of three
+ * extra words per handler. The behavior is identical in both cases, including the order of handlers with equal
+ * deadlines. Enabled by default for general-purpose targets, whose nodes often run hundreds of timers and pending
+ * service calls; for the handful of handlers of a typical embedded node the list is just as fast and smaller.
+ */
+#ifndef UAVCAN_DEADLINE_SCHEDULER_HEAP
+# define UAVCAN_DEADLINE_SCHEDULER_HEAP (UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY)
+#endif
+
+/**
+ * Containers where the nodes are removed often - the TX queue, the transfer listener and loopback listener registries,
+ * and the deadline scheduler if it's not configured to use the heap - are singly-linked lists by default, where every
+ * removal has to search the list from the beginning. If UAVCAN_DOUBLY_LINKED_LISTS is enabled, doubly-linked lists
+ * are used instead, which makes removal O(1) at the cost of one extra pointer per entry.
+ * Enabled by default for general-purpose targets, where gateways and monitoring tools keep long TX queues and
+ * create and destroy many subscribers at run time.
+ */
+#ifndef UAVCAN_DOUBLY_LINKED_LISTS
+# define UAVCAN_DOUBLY_LINKED_LISTS (UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY)
+#endif
+
+/**
+ * CAN FD support: the frames carry up to 64 bytes of data, so that large transfers need several times fewer frames.
+ * The transfers are sent over CAN FD only by the publishers and service clients that enable it explicitly, refer to
+ * TransferSender::setCanFD(); everything else keeps using classic CAN frames, so a CAN FD node can communicate with
+ * classic CAN nodes. The price is the larger size of CanFrame and of the CAN TX queue entries, so the default memory
+ * pool block size is increased to 128 bytes as well, refer to UAVCAN_MEM_POOL_BLOCK_SIZE.
+ * Requires the driver to support CAN FD. Disabled by default.
+ */
+#ifndef UAVCAN_SUPPORT_CANFD
+# define UAVCAN_SUPPORT_CANFD 0
+#endif
+
+/**
+ * Float16 values are converted with the hardware instructions if the target supports them: F16C on x86 (-mf16c),
+ * or the IEEE half precision format on ARM, e.g. VCVTB/VCVTT on Cortex-M4F/M7 (-mfp16-format=ieee) and FCVT on
+ * ARMv8. Otherwise a portable implementation is used. NaN is always encoded as 0x7FFF, as by the portable code;
+ * the only difference is that the hardware rounds the exact ties to even rather than away from zero.
+ * Detected automatically; define as zero to force the portable implementation.
+ */
+#ifndef UAVCAN_HARDWARE_FLOAT16
+# if defined(__F16C__) || (defined(__ARM_FP16_FORMAT_IEEE) && defined(__ARM_FP) && (__ARM_FP & 2))
+#  define UAVCAN_HARDWARE_FLOAT16 1
+# else
+#  define UAVCAN_HARDWARE_FLOAT16 0
+# endif
+#endif
+
+/**
+ * Publishers of data types whose maximum encoded size exceeds this number of bytes encode the transfers directly
+ * into CAN frames, instead of encoding them into a buffer allocated on the stack for the worst case and copying
+ * the buffer into the frames afterwards. The price is that multi frame transfers are encoded twice, because
+ * the transfer CRC has to be known before the first frame can be sent.
+ */
+#ifndef UAVCAN_STREAMING_ENCODER_THRESHOLD
+# define UAVCAN_STREAMING_ENCODER_THRESHOLD 128
+#endif
+
+/**
+ * Dynamic arrays whose inline storage would exceed this number of bytes allocate their elements from
+ * uavcan::DynamicArrayAllocator on demand instead, see uavcan::PooledArrayImpl. This reduces the memory footprint
+ * of the decoded data structures that are mostly shorter than their maximum size, such as the ones kept by every
+ * subscriber and service client, at the cost of an allocation per decoded array. Zero disables the pooling.
+ */
+#ifndef UAVCAN_DYNAMIC_ARRAY_POOL_THRESHOLD
+# define UAVCAN_DYNAMIC_ARRAY_POOL_THRESHOLD 0
+#endif
+
+/**
+ * Number of hash buckets in the outgoing transfer registry of the node classes; must be zero or a power of two.
+ * If zero, the registry is a map searched linearly on every transfer, which is the most memory efficient option
+ * for nodes with few publishers and service clients. Nodes that send requests to many destinations, such as
+ * gateways, should set this to use uavcan::IndexedOutgoingTransferRegistry instead.
+ */
+#ifndef UAVCAN_OUTGOING_TRANSFER_REGISTRY_BUCKETS
+# define UAVCAN_OUTGOING_TRANSFER_REGISTRY_BUCKETS 0
+#endif
+
+/**
+ * Capacity of the emergency TX lane of the CAN IO manager, in frames; see uavcan::CanEmergencyTxLane.
+ * Frames sent with uavcan::CanIOFlagEmergency are queued there rather than in the regular TX queue, so that they are
+ * transmitted first and can't be rejected because the memory pool is exhausted by the bulk traffic.
+ * Every slot costs about 32 bytes of static memory, more if CAN FD is enabled.
+ */
+#ifndef UAVCAN_CAN_EMERGENCY_TX_LANE_CAPACITY
+# define UAVCAN_CAN_EMERGENCY_TX_LANE_CAPACITY 4
+#endif
+
+/**
+ * Latency histograms, see uavcan::LatencyHistogram.
+ * If enabled, the CAN IO manager tracks the time the frames spend in the TX queue, and every subscriber (including
+ * service servers and clients) tracks the delay from the reception of the last frame of a transfer to the
+ * invocation of the callback. This costs one clock reading per transfer or queued frame, 4 bytes per TX queue entry
+ * and 68 bytes per subscriber. Enabled by default for general-purpose targets, where reading the clock is cheap
+ * and the latency is worth watching because the node shares the CPU with other processes.
+ */
+#ifndef UAVCAN_LATENCY_HISTOGRAMS
+# define UAVCAN_LATENCY_HISTOGRAMS (UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY)
+#endif
+
+/**
+ * Binary event tracing of the hot paths of the library, see uavcan/util/event_trace.hpp.
+ * The trace points expand to nothing unless this option is enabled. If enabled, every trace point records
+ * a timestamp, an event ID and a 16-bit argument into a ring buffer of UAVCAN_EVENT_TRACE_BUFFER_SIZE records;
+ * the timestamp source can be overridden with UAVCAN_EVENT_TRACE_TIMESTAMP().
+ */
+#ifndef UAVCAN_EVENT_TRACE
+# define UAVCAN_EVENT_TRACE 0
+#endif
+
+/**
+ * Static registration of the generated data types.
+ * By default, every generated data type header registers its type with the global data type registry before main(),
+ * see uavcan::DefaultDataTypeRegistrator. If this option is enabled, the generated headers don't do that; instead,
+ * the application must adopt the table of data types generated by the DSDL compiler (option --data-type-table)
+ * via uavcan::GlobalDataTypeRegistry::adoptDataTypeTable() before the first node is started. This saves the startup
+ * time and the static constructors of every translation unit that includes generated headers.
+ * The option must be the same for all translation units.
+ */
+#ifndef UAVCAN_NO_STATIC_DATA_TYPE_REGISTRATION
+# define UAVCAN_NO_STATIC_DATA_TYPE_REGISTRATION 0
+#endif
+
+/**
+ * Static driver binding, see uavcan/driver/static_binding.hpp.
+ * By default the library invokes the platform drivers via the abstract interfaces ICanDriver, ICanIface and
+ * ISystemClock. An application that uses exactly one driver can name its concrete types, so that the per-frame
+ * calls on the IO path are non-virtual and can be inlined by the compiler or LTO:
+ *  - UAVCAN_STATIC_DRIVER_HEADER       - header that defines the types below, e.g. <uavcan_stm32/uavcan_stm32.hpp>
+ *  - UAVCAN_STATIC_CAN_DRIVER_TYPE     - ICanDriver implementation, e.g. uavcan_stm32::CanDriver
+ *  - UAVCAN_STATIC_CAN_IFACE_TYPE      - ICanIface implementation, e.g. uavcan_stm32::CanIface
+ *  - UAVCAN_STATIC_SYSTEM_CLOCK_TYPE   - ISystemClock implementation, e.g. uavcan_stm32::SystemClock
+ * Each type is optional. The methods of the interface must be public in the concrete type, or the type must befriend
+ * uavcan::DriverBinding. Every object passed to the library must be of exactly that type, not of a subclass.
+ * The options must be the same for the library and the application.
+ */
+#ifdef UAVCAN_STATIC_DRIVER_HEADER
+# define UAVCAN_STATIC_DRIVER_BINDING 1
+#else
+# define UAVCAN_STATIC_DRIVER_BINDING 0
+#endif
+
 /**
  * Run time checks.
  * Resolves to the standard assert() by default.
@@ -171,6 +379,9 @@ namespace uavcan
 #ifdef UAVCAN_MEM_POOL_BLOCK_SIZE
 /// Explicitly specified by the user.
 static const unsigned MemPoolBlockSize = UAVCAN_MEM_POOL_BLOCK_SIZE;
+#elif UAVCAN_SUPPORT_CANFD
+/// CAN TX queue entries contain CAN FD frames of up to 64 bytes.
+static const unsigned MemPoolBlockSize = 128;
 #elif defined(__BIGGEST_ALIGNMENT__) && (__BIGGEST_ALIGNMENT__ <= 8)
 /// Convenient default for GCC-like compilers - if alignment allows, pool block size can be safely reduced.
 static const unsigned MemPoolBlockSize = 56;
@@ -219,6 +430,9 @@ static const unsigned FloatComparisonEpsilonMult = 10;
 #ifdef UAVCAN_MAX_CAN_ACCEPTANCE_FILTERS
 /// Explicitly specified by the user.
 static const unsigned MaxCanAcceptanceFilters = UAVCAN_MAX_CAN_ACCEPTANCE_FILTERS;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM
+/// Filters are implemented in software (e.g. SocketCAN), so the limit is high enough to keep them exact.
+static const unsigned MaxCanAcceptanceFilters = 255;
 #else
 /// Default that should be OK for any platform.
 static const unsigned MaxCanAcceptanceFilters = 32;
@@ -242,6 +456,166 @@ static const unsigned MaxNetworkSizeHint = UAVCAN_MAX_NETWORK_SIZE_HINT;
 static const unsigned MaxNetworkSizeHint = 64;  ///< Rest will go into the dynamic memory
 #endif
 
+/**
+ * Number of entries in the data type ID index of each dispatcher listener registry (messages, service requests,
+ * service responses). The index is a direct-mapped table keyed by data type ID; it allows to find the listeners
+ * of an incoming frame in constant time, instead of traversing the whole list of listeners.
+ *
+ * Each entry takes a pointer and a 32-bit word, and there are three registries per node. Zero disables the index,
+ * in which case the dispatcher falls back to linear search. The value must be a power of two.
+ *
+ * The index is disabled by default on embedded targets, where the number of listeners is typically small.
+ */
+#ifdef UAVCAN_DISPATCHER_LISTENER_INDEX_SIZE
+static const unsigned DispatcherListenerIndexSize = UAVCAN_DISPATCHER_LISTENER_INDEX_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned DispatcherListenerIndexSize = 64;
+#else
+static const unsigned DispatcherListenerIndexSize = 0;
+#endif
+
+typedef char _power_of_two_check_for_DISPATCHER_LISTENER_INDEX_SIZE[
+    ((DispatcherListenerIndexSize & (DispatcherListenerIndexSize - 1)) == 0) ? 1 : -1];
+
+/**
+ * Number of entries in the receiver index of each transfer listener. The index is a direct-mapped table of
+ * pointers to the transfer receivers keyed by source node ID, which allows to find the receiver of an incoming
+ * frame in constant time, instead of searching through the receiver map (which is O(N) of the number of sources).
+ *
+ * Each entry takes a pointer and a 2-byte key; every transfer listener (subscriber, server, caller)
+ * has its own index. Zero disables the index. The value must be a power of two; values above 128 make no sense
+ * because there are at most 127 source node IDs.
+ *
+ * The index is disabled by default on embedded targets.
+ */
+#ifdef UAVCAN_TRANSFER_LISTENER_RECEIVER_INDEX_SIZE
+static const unsigned TransferListenerReceiverIndexSize = UAVCAN_TRANSFER_LISTENER_RECEIVER_INDEX_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned TransferListenerReceiverIndexSize = 128;
+#else
+static const unsigned TransferListenerReceiverIndexSize = 0;
+#endif
+
+typedef char _power_of_two_check_for_TRANSFER_LISTENER_RECEIVER_INDEX_SIZE[
+    ((TransferListenerReceiverIndexSize & (TransferListenerReceiverIndexSize - 1)) == 0) ? 1 : -1];
+
+/**
+ * Number of per-source slots of each single-frame-only transfer listener (a subscriber or a server of a data type
+ * that always fits one CAN frame, e.g. NodeStatus). The slots are a direct-mapped table keyed by source node ID;
+ * the transfers from the sources that own a slot are validated and delivered straight from the received frame,
+ * without the receiver map, the transfer buffers, or the memory pool. Sources that collide with an active slot
+ * owner fall back to the regular receivers.
+ *
+ * Each slot takes 8 bytes. The value must be a power of two; values above 128 make no sense. Zero disables
+ * the table.
+ */
+#ifdef UAVCAN_TRANSFER_LISTENER_SINGLE_FRAME_TABLE_SIZE
+static const unsigned TransferListenerSingleFrameTableSize = UAVCAN_TRANSFER_LISTENER_SINGLE_FRAME_TABLE_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned TransferListenerSingleFrameTableSize = 128;
+#else
+static const unsigned TransferListenerSingleFrameTableSize = 8;
+#endif
+
+typedef char _power_of_two_check_for_TRANSFER_LISTENER_SINGLE_FRAME_TABLE_SIZE[
+    ((TransferListenerSingleFrameTableSize & (TransferListenerSingleFrameTableSize - 1)) == 0) ? 1 : -1];
+
+/**
+ * Maximum number of CAN frames the dispatcher fetches from the driver at once, see @ref ICanIface::receiveBatch().
+ * The frames are stored on the stack during the spin call, each takes about 40 bytes.
+ *
+ * Batching is disabled by default on embedded targets in order to keep the stack usage low.
+ */
+#ifdef UAVCAN_DISPATCHER_RX_BATCH_SIZE
+static const unsigned DispatcherRxBatchSize = UAVCAN_DISPATCHER_RX_BATCH_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned DispatcherRxBatchSize = 16;
+#else
+static const unsigned DispatcherRxBatchSize = 1;
+#endif
+
+typedef char _range_check_for_DISPATCHER_RX_BATCH_SIZE[(DispatcherRxBatchSize > 0) ? 1 : -1];
+
+/**
+ * Maximum number of data types whose transport statistics (frames, transfers, bytes, reassembly errors and
+ * timings) are tracked by the dispatcher, see @ref DataTypeStatsTable. Each entry takes about 44 bytes.
+ * Zero disables the statistics, so that they don't cost any memory or CPU time.
+ *
+ * The statistics are disabled by default on embedded targets.
+ */
+#ifdef UAVCAN_DATA_TYPE_STATS_SIZE
+static const unsigned DataTypeStatsTableSize = UAVCAN_DATA_TYPE_STATS_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned DataTypeStatsTableSize = 32;
+#else
+static const unsigned DataTypeStatsTableSize = 0;
+#endif
+
+/**
+ * Number of hash buckets in the pending call registry of each service client. The calls are hashed by server
+ * node ID, so that the response frames are matched in constant time even if the client has calls pending to
+ * many servers at once. Each bucket takes one pointer. The value must be a power of two; one turns the registry
+ * into a plain list, and values above 128 make no sense because there are at most 127 server node IDs.
+ *
+ * The index is reduced to a single bucket by default on embedded targets.
+ */
+#ifdef UAVCAN_SERVICE_CLIENT_CALL_INDEX_SIZE
+static const unsigned ServiceClientCallIndexSize = UAVCAN_SERVICE_CLIENT_CALL_INDEX_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned ServiceClientCallIndexSize = 32;
+#else
+static const unsigned ServiceClientCallIndexSize = 1;
+#endif
+
+typedef char _power_of_two_check_for_SERVICE_CLIENT_CALL_INDEX_SIZE[
+    ((ServiceClientCallIndexSize > 0) && ((ServiceClientCallIndexSize & (ServiceClientCallIndexSize - 1)) == 0)) ?
+    1 : -1];
+
+/**
+ * Maximum number of data types of each kind (messages, services) that can be indexed by the global data type
+ * registry once it's frozen. The index consists of two sorted arrays, by data type ID and by name hash, which makes
+ * every lookup O(log N) instead of a linear search with string comparisons. Each entry of the index takes two
+ * pointers and a 32-bit word. If more data types are registered, the registry falls back to linear search.
+ * Zero disables the index.
+ *
+ * The index is disabled by default on embedded targets.
+ */
+#ifdef UAVCAN_DATA_TYPE_REGISTRY_INDEX_SIZE
+static const unsigned DataTypeRegistryIndexSize = UAVCAN_DATA_TYPE_REGISTRY_INDEX_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned DataTypeRegistryIndexSize = 256;
+#else
+static const unsigned DataTypeRegistryIndexSize = 0;
+#endif
+
+/**
+ * Number of unique IDs the dynamic node ID allocation request manager remembers in order to serve repeated
+ * allocation requests without the full unique ID exchange; see AllocationRequestManager. Each entry takes 24 bytes.
+ */
+#ifdef UAVCAN_DYNAMIC_NODE_ID_SERVER_UNIQUE_ID_CACHE_SIZE
+static const unsigned DynamicNodeIDServerUniqueIDCacheSize = UAVCAN_DYNAMIC_NODE_ID_SERVER_UNIQUE_ID_CACHE_SIZE;
+#elif UAVCAN_GENERAL_PURPOSE_PLATFORM && !UAVCAN_TINY
+static const unsigned DynamicNodeIDServerUniqueIDCacheSize = 128;
+#else
+static const unsigned DynamicNodeIDServerUniqueIDCacheSize = 8;
+#endif
+
+typedef char _positive_check_for_DYNAMIC_NODE_ID_SERVER_UNIQUE_ID_CACHE_SIZE[
+    (DynamicNodeIDServerUniqueIDCacheSize > 0) ? 1 : -1];
+
+/**
+ * Number of records in the event trace buffer, see UAVCAN_EVENT_TRACE. Each record takes 8 bytes.
+ * The value must be a power of two.
+ */
+#ifdef UAVCAN_EVENT_TRACE_BUFFER_SIZE
+static const unsigned EventTraceBufferSize = UAVCAN_EVENT_TRACE_BUFFER_SIZE;
+#else
+static const unsigned EventTraceBufferSize = 256;
+#endif
+
+typedef char _power_of_two_check_for_EVENT_TRACE_BUFFER_SIZE[
+    ((EventTraceBufferSize > 0) && ((EventTraceBufferSize & (EventTraceBufferSize - 1)) == 0)) ? 1 : -1];
+
 }
 
 #endif // UAVCAN_BUILD_CONFIG_HPP_INCLUDED
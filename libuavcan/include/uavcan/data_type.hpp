@@ -10,12 +10,11 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/transfer.hpp>
+#include <uavcan/transport/crc.hpp>
 
 namespace uavcan
 {
 
-class UAVCAN_EXPORT TransferCRC;
-
 enum DataTypeKind
 {
     DataTypeKindService,
@@ -125,6 +124,8 @@ public:
 
 /**
  * This class contains complete description of a data type.
+ * The transfer CRC seeded with the signature is computed once on construction, so that the multi-frame
+ * transfers don't have to process the signature again.
  */
 class UAVCAN_EXPORT DataTypeDescriptor
 {
@@ -132,20 +133,23 @@ class UAVCAN_EXPORT DataTypeDescriptor
     const char* full_name_;
     DataTypeKind kind_;
     DataTypeID id_;
+    TransferCRC transfer_crc_base_;     ///< Derived from the signature, thus not compared
 
 public:
     static const unsigned MaxFullNameLen = 80;
 
     DataTypeDescriptor() :
         full_name_(""),
-        kind_(DataTypeKind(0))
+        kind_(DataTypeKind(0)),
+        transfer_crc_base_(signature_.toTransferCRC())
     { }
 
     DataTypeDescriptor(DataTypeKind kind, DataTypeID id, const DataTypeSignature& signature, const char* name) :
         signature_(signature),
         full_name_(name),
         kind_(kind),
-        id_(id)
+        id_(id),
+        transfer_crc_base_(signature.toTransferCRC())
     {
         UAVCAN_ASSERT(kind < NumDataTypeKinds);
         UAVCAN_ASSERT(name);
@@ -159,6 +163,11 @@ public:
     const DataTypeSignature& getSignature() const { return signature_; }
     const char* getFullName() const { return full_name_; }
 
+    /**
+     * Same as getSignature().toTransferCRC(), but precomputed.
+     */
+    const TransferCRC& getTransferCRCBase() const { return transfer_crc_base_; }
+
     bool match(DataTypeKind kind, const char* name) const;
     bool match(DataTypeKind kind, DataTypeID id) const;
 
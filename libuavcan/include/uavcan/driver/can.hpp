@@ -20,6 +20,11 @@ enum { MaxCanIfaces = 3 };
 
 /**
  * Raw CAN frame, as passed to/from the CAN driver.
+ *
+ * If CAN FD is supported (refer to UAVCAN_SUPPORT_CANFD), the frame can carry up to 64 bytes; the frames that are
+ * marked as CAN FD must be transmitted in the CAN FD format even if they are not longer than 8 bytes, and the driver
+ * must mark the received CAN FD frames accordingly. The data length of a CAN FD frame must be one of the values
+ * that can be represented by a DLC, refer to @ref dlcToDataLength().
  */
 struct UAVCAN_EXPORT CanFrame
 {
@@ -29,15 +34,26 @@ struct UAVCAN_EXPORT CanFrame
     static const uint32_t FlagRTR = 1U << 30;                  ///< Remote transmission request
     static const uint32_t FlagERR = 1U << 29;                  ///< Error frame
 
-    static const uint8_t MaxDataLen = 8;
+    static const uint8_t MaxClassicDataLen = 8;
+#if UAVCAN_SUPPORT_CANFD
+    static const uint8_t MaxDataLen = 64;
+#else
+    static const uint8_t MaxDataLen = MaxClassicDataLen;
+#endif
 
     uint32_t id;                ///< CAN ID with flags (above)
     uint8_t data[MaxDataLen];
-    uint8_t dlc;                ///< Data Length Code
+    uint8_t dlc;                ///< Data length in bytes, despite the name; not the raw DLC for CAN FD frames
+#if UAVCAN_SUPPORT_CANFD
+    bool canfd;                 ///< CAN FD frame format
+#endif
 
     CanFrame() :
         id(0),
         dlc(0)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd(false)
+#endif
     {
         fill(data, data + MaxDataLen, uint8_t(0));
     }
@@ -45,6 +61,9 @@ struct UAVCAN_EXPORT CanFrame
     CanFrame(uint32_t can_id, const uint8_t* can_data, uint8_t data_len) :
         id(can_id),
         dlc((data_len > MaxDataLen) ? MaxDataLen : data_len)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd(data_len > MaxClassicDataLen)
+#endif
     {
         UAVCAN_ASSERT(can_data != NULL);
         UAVCAN_ASSERT(data_len == dlc);
@@ -54,12 +73,30 @@ struct UAVCAN_EXPORT CanFrame
     bool operator!=(const CanFrame& rhs) const { return !operator==(rhs); }
     bool operator==(const CanFrame& rhs) const
     {
-        return (id == rhs.id) && (dlc == rhs.dlc) && equal(data, data + dlc, rhs.data);
+        return (id == rhs.id) && (dlc == rhs.dlc) && (isCanFD() == rhs.isCanFD()) &&
+               equal(data, data + dlc, rhs.data);
     }
 
     bool isExtended()                  const { return id & FlagEFF; }
     bool isRemoteTransmissionRequest() const { return id & FlagRTR; }
     bool isErrorFrame()                const { return id & FlagERR; }
+#if UAVCAN_SUPPORT_CANFD
+    bool isCanFD()                     const { return canfd; }
+#else
+    bool isCanFD()                     const { return false; }
+#endif
+
+    /**
+     * Mapping between the 4-bit DLC and the data length in bytes; they are the same for up to 8 bytes.
+     * CAN FD frames can be 0 to 8, 12, 16, 20, 24, 32, 48 or 64 bytes long.
+     */
+    static uint8_t dlcToDataLength(uint8_t dlc);
+    static uint8_t dataLengthToDlc(uint8_t data_length);     ///< Rounds up to the nearest valid length
+
+    /**
+     * Nearest valid CAN FD data length that is not less than the argument, which must not exceed 64.
+     */
+    static uint8_t roundUpDataLength(uint8_t data_length) { return dlcToDataLength(dataLengthToDlc(data_length)); }
 
 #if UAVCAN_TOSTRING
     enum StringRepresentation
@@ -126,10 +163,51 @@ struct UAVCAN_EXPORT CanSelectMasks
  *                                affect the case of arbitration loss, in which case the retransmission will work
  *                                as usual. This flag is used together with anonymous messages which allows to
  *                                implement CSMA bus access. Read the spec for details.
+ *
+ * @ref CanIOFlagCoalesce       - Handled by the library, never passed to the driver. If the frame has to be queued,
+ *                                it replaces the not yet transmitted frame with the same CAN ID that was queued with
+ *                                this flag too, instead of being appended to the TX queue.
+ *
+ * @ref CanIOFlagEmergency      - Handled by the library, never passed to the driver. If the frame has to be queued,
+ *                                it goes to the emergency TX lane, which is serviced before the regular TX queue and
+ *                                does not use the memory pool, see @ref CanEmergencyTxLane.
  */
 typedef uint16_t CanIOFlags;
 static const CanIOFlags CanIOFlagLoopback = 1;
 static const CanIOFlags CanIOFlagAbortOnError = 2;
+static const CanIOFlags CanIOFlagCoalesce = 4;
+static const CanIOFlags CanIOFlagEmergency = 8;
+
+/**
+ * Fault confinement state of a CAN controller, see @ref ICanIface::getBusState().
+ * An error passive controller can still transmit, but it has to wait longer before every transmission;
+ * a bus off controller can't transmit until it has recovered.
+ */
+enum CanBusState
+{
+    CanBusStateUnknown,
+    CanBusStateErrorActive,
+    CanBusStateErrorPassive,
+    CanBusStateBusOff
+};
+
+/**
+ * CAN frame with the reception metadata, see @ref ICanIface::receiveBatch().
+ */
+struct UAVCAN_EXPORT CanRxFrame : public CanFrame
+{
+    MonotonicTime ts_mono;
+    UtcTime ts_utc;
+    uint8_t iface_index;
+
+    CanRxFrame()
+        : iface_index(0)
+    { }
+
+#if UAVCAN_TOSTRING
+    std::string toString(StringRepresentation mode = StrTight) const;
+#endif
+};
 
 /**
  * Single non-blocking CAN interface.
@@ -172,6 +250,40 @@ public:
     virtual int16_t receive(CanFrame& out_frame, MonotonicTime& out_ts_monotonic, UtcTime& out_ts_utc,
                             CanIOFlags& out_flags) = 0;
 
+    /**
+     * Non-blocking reception of up to max_frames frames at once.
+     *
+     * The drivers that can fetch several frames at a lower cost than one by one (e.g. with one system call)
+     * should override this method. The default implementation calls @ref receive() until the RX buffer is empty
+     * or the output arrays are full. The field iface_index of the output frames is not used.
+     *
+     * @param [out] out_frames       Array of at least max_frames elements.
+     * @param [out] out_flags        Array of at least max_frames elements.
+     * @param [in]  max_frames       Capacity of the output arrays.
+     * @return Number of received frames, 0 = RX buffer empty, negative for error.
+     */
+    virtual int16_t receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, uint16_t max_frames)
+    {
+        UAVCAN_ASSERT((out_frames != NULL) && (out_flags != NULL));
+        int16_t num_received = 0;
+        while (uint16_t(num_received) < max_frames)
+        {
+            CanRxFrame& frame = out_frames[num_received];
+            out_flags[num_received] = CanIOFlags();
+            const int16_t res = receive(frame, frame.ts_mono, frame.ts_utc, out_flags[num_received]);
+            if (res < 0)
+            {
+                return (num_received > 0) ? num_received : res;     // The error will be reported with the next call
+            }
+            if (res == 0)
+            {
+                break;
+            }
+            num_received++;
+        }
+        return num_received;
+    }
+
     /**
      * Configure the hardware CAN filters. @ref CanFilterConfig.
      *
@@ -189,6 +301,14 @@ public:
      * Arbitration lost should not be treated as a hardware error.
      */
     virtual uint64_t getErrorCount() const = 0;
+
+    /**
+     * Current fault confinement state of the controller, which is used by the library to stop queueing frames
+     * for an interface that can't transmit them.
+     * The drivers that can read it from the hardware should override this method. The default implementation
+     * returns CanBusStateUnknown, in which case the library infers the state from the error count.
+     */
+    virtual CanBusState getBusState() const { return CanBusStateUnknown; }
 };
 
 /**
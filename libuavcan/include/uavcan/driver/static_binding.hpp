@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_DRIVER_STATIC_BINDING_HPP_INCLUDED
+#define UAVCAN_DRIVER_STATIC_BINDING_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+
+#if UAVCAN_STATIC_DRIVER_BINDING
+# include UAVCAN_STATIC_DRIVER_HEADER
+#endif
+
+namespace uavcan
+{
+/**
+ * Calls into the platform drivers on the per-frame IO path of the library.
+ * If the concrete driver types are configured (see UAVCAN_STATIC_DRIVER_BINDING), the methods are called by their
+ * qualified names, which bypasses the virtual dispatch; otherwise this is a plain virtual call.
+ *
+ * This header is included by the library sources only, since the driver headers depend on the library headers.
+ */
+struct UAVCAN_EXPORT DriverBinding
+{
+    static int16_t select(ICanDriver& driver, CanSelectMasks& inout_masks,
+                          const CanFrame* (& pending_tx)[MaxCanIfaces], MonotonicTime blocking_deadline)
+    {
+#ifdef UAVCAN_STATIC_CAN_DRIVER_TYPE
+        typedef UAVCAN_STATIC_CAN_DRIVER_TYPE DriverType;
+        return static_cast<DriverType&>(driver).DriverType::select(inout_masks, pending_tx, blocking_deadline);
+#else
+        return driver.select(inout_masks, pending_tx, blocking_deadline);
+#endif
+    }
+
+    static ICanIface* getIface(ICanDriver& driver, uint8_t iface_index)
+    {
+#ifdef UAVCAN_STATIC_CAN_DRIVER_TYPE
+        typedef UAVCAN_STATIC_CAN_DRIVER_TYPE DriverType;
+        return static_cast<DriverType&>(driver).DriverType::getIface(iface_index);
+#else
+        return driver.getIface(iface_index);
+#endif
+    }
+
+    static int16_t send(ICanIface& iface, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+    {
+#ifdef UAVCAN_STATIC_CAN_IFACE_TYPE
+        typedef UAVCAN_STATIC_CAN_IFACE_TYPE IfaceType;
+        return static_cast<IfaceType&>(iface).IfaceType::send(frame, tx_deadline, flags);
+#else
+        return iface.send(frame, tx_deadline, flags);
+#endif
+    }
+
+    static int16_t receive(ICanIface& iface, CanFrame& out_frame, MonotonicTime& out_ts_monotonic,
+                           UtcTime& out_ts_utc, CanIOFlags& out_flags)
+    {
+#ifdef UAVCAN_STATIC_CAN_IFACE_TYPE
+        typedef UAVCAN_STATIC_CAN_IFACE_TYPE IfaceType;
+        return static_cast<IfaceType&>(iface).IfaceType::receive(out_frame, out_ts_monotonic, out_ts_utc, out_flags);
+#else
+        return iface.receive(out_frame, out_ts_monotonic, out_ts_utc, out_flags);
+#endif
+    }
+
+    static int16_t receiveBatch(ICanIface& iface, CanRxFrame* out_frames, CanIOFlags* out_flags,
+                                uint16_t max_frames)
+    {
+#ifdef UAVCAN_STATIC_CAN_IFACE_TYPE
+        typedef UAVCAN_STATIC_CAN_IFACE_TYPE IfaceType;
+        return static_cast<IfaceType&>(iface).IfaceType::receiveBatch(out_frames, out_flags, max_frames);
+#else
+        return iface.receiveBatch(out_frames, out_flags, max_frames);
+#endif
+    }
+
+    static MonotonicTime getMonotonic(const ISystemClock& clock)
+    {
+#ifdef UAVCAN_STATIC_SYSTEM_CLOCK_TYPE
+        typedef UAVCAN_STATIC_SYSTEM_CLOCK_TYPE ClockType;
+        return static_cast<const ClockType&>(clock).ClockType::getMonotonic();
+#else
+        return clock.getMonotonic();
+#endif
+    }
+};
+
+}
+
+#endif // UAVCAN_DRIVER_STATIC_BINDING_HPP_INCLUDED
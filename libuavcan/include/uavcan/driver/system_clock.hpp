@@ -12,6 +12,11 @@
 
 namespace uavcan
 {
+/**
+ * Drivers with non-public interface methods befriend this to support UAVCAN_STATIC_DRIVER_BINDING;
+ * see uavcan/driver/static_binding.hpp.
+ */
+struct DriverBinding;
 
 /**
  * System clock interface - monotonic and UTC.
@@ -75,6 +75,147 @@ public:
     uint16_t getPeakNumUsedBlocks() const { return max_used_; }
 };
 
+/**
+ * Segregated-fit pool allocator with several size classes.
+ * Every allocation request is served from the smallest size class that can fit it; if that size class is
+ * exhausted, the request spills over to the next larger one. This allows to keep small objects (e.g. TX queue
+ * entries) in small blocks, reducing the total amount of memory needed for the pool.
+ * This class contains the implementation; see @ref MultiSizePoolAllocator<> for the configurable front-end.
+ */
+class UAVCAN_EXPORT MultiSizePoolAllocatorBase : public IPoolAllocator, Noncopyable
+{
+public:
+    enum { MaxSizeClasses = 4 };
+
+    /**
+     * Usage statistics of one size class.
+     */
+    struct SizeClassUsage
+    {
+        uint16_t block_size;
+        uint16_t num_blocks;
+        uint16_t num_used_blocks;
+        uint16_t peak_num_used_blocks;
+        uint32_t num_spillovers;    ///< Requests that fit this class but were served by a larger one
+        uint32_t num_failures;      ///< Requests that fit this class but could not be served at all
+
+        SizeClassUsage()
+            : block_size(0)
+            , num_blocks(0)
+            , num_used_blocks(0)
+            , peak_num_used_blocks(0)
+            , num_spillovers(0)
+            , num_failures(0)
+        { }
+    };
+
+private:
+    struct Node
+    {
+        Node* next;
+    };
+
+    struct SizeClass
+    {
+        Node* free_list;
+        const uint8_t* begin;
+        const uint8_t* end;
+        SizeClassUsage usage;
+
+        SizeClass()
+            : free_list(NULL)
+            , begin(NULL)
+            , end(NULL)
+        { }
+    };
+
+    SizeClass classes_[MaxSizeClasses];
+    uint8_t num_classes_;
+    uint16_t num_blocks_;
+
+    void* allocateFrom(SizeClass& cls);
+
+protected:
+    MultiSizePoolAllocatorBase()
+        : num_classes_(0)
+        , num_blocks_(0)
+    { }
+
+    /**
+     * Size classes must be added in ascending order of block size.
+     * Storage must be aligned and large enough to accommodate num_blocks blocks of block_size bytes.
+     */
+    void addSizeClass(uint8_t* storage, uint8_t block_size, uint16_t num_blocks);
+
+public:
+    virtual void* allocate(std::size_t size);
+    virtual void deallocate(const void* ptr);
+
+    /**
+     * Total number of blocks in all size classes.
+     */
+    virtual uint16_t getNumBlocks() const { return num_blocks_; }
+
+    /**
+     * Total number of blocks that are currently allocated/unallocated, in all size classes.
+     */
+    uint16_t getNumUsedBlocks() const;
+    uint16_t getNumFreeBlocks() const { return static_cast<uint16_t>(num_blocks_ - getNumUsedBlocks()); }
+
+    /**
+     * Size classes are indexed in ascending order of block size.
+     * Returns default constructed (zero) statistics if the index is out of range.
+     */
+    unsigned getNumSizeClasses() const { return num_classes_; }
+    SizeClassUsage getSizeClassUsage(unsigned index) const;
+};
+
+/**
+ * Configurable segregated-fit pool allocator with up to four size classes, see @ref MultiSizePoolAllocatorBase.
+ * Each size class is defined by the amount of memory it occupies and its block size; unused size classes must
+ * have zero pool size. Block sizes must be strictly ascending and multiples of @ref MemPoolAlignment.
+ *
+ * Note that the stock Node<> and SubNode<> classes use the single-sized @ref PoolAllocator<>; in order to use
+ * this allocator, implement a custom INode.
+ */
+template <std::size_t PoolSize0, uint8_t BlockSize0,
+          std::size_t PoolSize1 = 0, uint8_t BlockSize1 = 0,
+          std::size_t PoolSize2 = 0, uint8_t BlockSize2 = 0,
+          std::size_t PoolSize3 = 0, uint8_t BlockSize3 = 0>
+class UAVCAN_EXPORT MultiSizePoolAllocator : public MultiSizePoolAllocatorBase
+{
+    template <std::size_t PoolSize, uint8_t BlockSize>
+    struct SizeClassTraits
+    {
+        enum { NumBlocks = (BlockSize > 0) ? (PoolSize / ((BlockSize > 0) ? BlockSize : 1)) : 0 };
+        enum { NumBytes = NumBlocks * BlockSize };
+
+        static void check()
+        {
+            StaticAssert<((BlockSize % MemPoolAlignment) == 0)>::check();
+            StaticAssert<(BlockSize == 0 || BlockSize >= sizeof(void*))>::check();
+        }
+    };
+
+    typedef SizeClassTraits<PoolSize0, BlockSize0> Traits0;
+    typedef SizeClassTraits<PoolSize1, BlockSize1> Traits1;
+    typedef SizeClassTraits<PoolSize2, BlockSize2> Traits2;
+    typedef SizeClassTraits<PoolSize3, BlockSize3> Traits3;
+
+    enum { TotalNumBytes = Traits0::NumBytes + Traits1::NumBytes + Traits2::NumBytes + Traits3::NumBytes };
+
+    union
+    {
+         uint8_t bytes[TotalNumBytes];
+         long double _aligner1;
+         long long _aligner2;
+         void* _aligner3;
+    } pool_;
+
+public:
+    MultiSizePoolAllocator();
+};
+
 /**
  * Limits the maximum number of blocks that can be allocated in a given allocator.
  */
@@ -99,6 +240,103 @@ public:
     virtual uint16_t getNumBlocks() const;
 };
 
+/**
+ * Allocator proxy that keeps usage statistics of one consumer of a shared allocator.
+ * Optionally, it can limit the number of blocks the consumer can allocate, like @ref LimitedPoolAllocator.
+ * Every block is accounted for, regardless of its size.
+ */
+class UAVCAN_EXPORT InstrumentedPoolAllocator : public IPoolAllocator
+{
+    IPoolAllocator& allocator_;
+    uint16_t max_blocks_;
+    uint16_t num_used_blocks_;
+    uint16_t peak_num_used_blocks_;
+    uint32_t num_failures_;
+
+public:
+    explicit InstrumentedPoolAllocator(IPoolAllocator& allocator)
+        : allocator_(allocator)
+        , max_blocks_(0xFFFFU)
+        , num_used_blocks_(0)
+        , peak_num_used_blocks_(0)
+        , num_failures_(0)
+    { }
+
+    virtual void* allocate(std::size_t size);
+    virtual void deallocate(const void* ptr);
+
+    virtual uint16_t getNumBlocks() const { return min(max_blocks_, allocator_.getNumBlocks()); }
+
+    /**
+     * Maximum number of blocks this consumer is allowed to allocate; unlimited by default.
+     * If the quota is set below the current usage, new allocations will fail until the usage drops below it.
+     */
+    void setQuota(std::size_t max_blocks)
+    {
+        max_blocks_ = static_cast<uint16_t>(min<std::size_t>(max_blocks, 0xFFFFU));
+    }
+    uint16_t getQuota() const { return max_blocks_; }
+
+    /**
+     * Number of blocks that are currently allocated by this consumer.
+     */
+    uint16_t getNumUsedBlocks() const { return num_used_blocks_; }
+
+    /**
+     * Maximum number of blocks that were allocated by this consumer at the same time.
+     */
+    uint16_t getPeakNumUsedBlocks() const { return peak_num_used_blocks_; }
+
+    /**
+     * Number of allocation requests that were rejected, either due to the quota or by the underlying allocator.
+     * Rejected requests larger than MemPoolBlockSize are not counted: the transfer buffers use them to probe for
+     * a contiguous block and fall back to regular blocks, see UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS.
+     */
+    uint32_t getNumFailures() const { return num_failures_; }
+};
+
+/**
+ * Subsystems whose memory usage can be tracked separately, see INode::getAllocatorFor().
+ */
+enum MemoryConsumer
+{
+    MemoryConsumerCanTxQueue,                   ///< CAN TX queues of all interfaces
+    MemoryConsumerTransferReceivers,            ///< Transfer receivers and reassembly buffers of all listeners
+    MemoryConsumerOutgoingTransferRegistry,     ///< Transfer ID tracking for publishers and service clients
+    MemoryConsumerServiceCalls,                 ///< Pending call registries of service clients
+    MemoryConsumerOther,                        ///< Everything else, e.g. containers of the protocol helpers
+    NumMemoryConsumers
+};
+
+#if !UAVCAN_TINY
+/**
+ * Set of instrumented proxies over one allocator, one per memory consumer.
+ */
+class UAVCAN_EXPORT MemoryUsageTracker : Noncopyable
+{
+    InstrumentedPoolAllocator can_tx_queue_;
+    InstrumentedPoolAllocator transfer_receivers_;
+    InstrumentedPoolAllocator outgoing_transfer_registry_;
+    InstrumentedPoolAllocator service_calls_;
+    InstrumentedPoolAllocator other_;
+
+public:
+    explicit MemoryUsageTracker(IPoolAllocator& allocator)
+        : can_tx_queue_(allocator)
+        , transfer_receivers_(allocator)
+        , outgoing_transfer_registry_(allocator)
+        , service_calls_(allocator)
+        , other_(allocator)
+    { }
+
+    InstrumentedPoolAllocator& get(MemoryConsumer consumer);
+    const InstrumentedPoolAllocator& get(MemoryConsumer consumer) const
+    {
+        return const_cast<MemoryUsageTracker*>(this)->get(consumer);
+    }
+};
+#endif
+
 // ----------------------------------------------------------------------------
 
 /*
@@ -164,6 +402,50 @@ void PoolAllocator<PoolSize, BlockSize>::deallocate(const void* ptr)
     used_--;
 }
 
+/*
+ * MultiSizePoolAllocator<>
+ */
+template <std::size_t PoolSize0, uint8_t BlockSize0, std::size_t PoolSize1, uint8_t BlockSize1,
+          std::size_t PoolSize2, uint8_t BlockSize2, std::size_t PoolSize3, uint8_t BlockSize3>
+MultiSizePoolAllocator<PoolSize0, BlockSize0, PoolSize1, BlockSize1, PoolSize2, BlockSize2, PoolSize3, BlockSize3>::
+MultiSizePoolAllocator()
+{
+    Traits0::check();
+    Traits1::check();
+    Traits2::check();
+    Traits3::check();
+
+    // The first size class is mandatory; the remaining ones must be sorted by block size
+    StaticAssert<(Traits0::NumBlocks > 0)>::check();
+    StaticAssert<(Traits1::NumBlocks == 0 || BlockSize1 > BlockSize0)>::check();
+    StaticAssert<(Traits2::NumBlocks == 0 || (Traits1::NumBlocks > 0 && BlockSize2 > BlockSize1))>::check();
+    StaticAssert<(Traits3::NumBlocks == 0 || (Traits2::NumBlocks > 0 && BlockSize3 > BlockSize2))>::check();
+
+    // The limit is imposed by the width of the pool usage tracking variables.
+    StaticAssert<((Traits0::NumBlocks + Traits1::NumBlocks + Traits2::NumBlocks + Traits3::NumBlocks)
+                  <= 0xFFFFU)>::check();
+
+    (void)std::memset(pool_.bytes, 0, TotalNumBytes);
+
+    uint8_t* ptr = pool_.bytes;
+    addSizeClass(ptr, BlockSize0, Traits0::NumBlocks);
+    ptr += Traits0::NumBytes;
+    if (Traits1::NumBlocks > 0)
+    {
+        addSizeClass(ptr, BlockSize1, Traits1::NumBlocks);
+        ptr += Traits1::NumBytes;
+    }
+    if (Traits2::NumBlocks > 0)
+    {
+        addSizeClass(ptr, BlockSize2, Traits2::NumBlocks);
+        ptr += Traits2::NumBytes;
+    }
+    if (Traits3::NumBlocks > 0)
+    {
+        addSizeClass(ptr, BlockSize3, Traits3::NumBlocks);
+    }
+}
+
 }
 
 #endif // UAVCAN_DYNAMIC_MEMORY_HPP_INCLUDED
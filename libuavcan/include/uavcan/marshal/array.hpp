@@ -10,11 +10,13 @@
 #include <cstring>
 #include <cmath>
 #include <uavcan/error.hpp>
+#include <uavcan/dynamic_memory.hpp>
 #include <uavcan/util/bitset.hpp>
 #include <uavcan/util/templates.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/type_util.hpp>
 #include <uavcan/marshal/integer_spec.hpp>
+#include <uavcan/marshal/float_spec.hpp>
 #include <uavcan/std.hpp>
 
 #ifndef UAVCAN_CPP_VERSION
@@ -128,13 +130,12 @@ public:
 
     bool isSymmetric() const
     {
+        // Only the upper triangle is compared against the lower one; on diagonal comparison is pointless
         for (int i = 0; i < Traits::NumRowsCols; ++i)
         {
-            for (int k = 0; k < Traits::NumRowsCols; ++k)
+            for (int k = i + 1; k < Traits::NumRowsCols; ++k)
             {
-                // On diagonal comparison is pointless
-                if ((i != k) &&
-                    !areClose(*accessElementAtRowCol(i, k),
+                if (!areClose(*accessElementAtRowCol(i, k),
                               *accessElementAtRowCol(k, i)))
                 {
                     return false;
@@ -144,25 +145,50 @@ public:
         return true;
     }
 
+    /**
+     * Equivalent to checking areAllElementsNan(), isScalar(), isDiagonal() and isSymmetric() in that order,
+     * but the emptiness, scalarness and diagonality are established in a single pass that visits every element
+     * at most once, and stops as soon as the matrix is known to be neither empty nor diagonal.
+     */
     PackingMode detectOptimalPackingMode() const
     {
-        if (areAllElementsNan())
-        {
-            return PackingModeEmpty;
-        }
-        if (isScalar())
+        bool all_nan = true;
+        bool diagonal = true;
+        bool scalar = true;
+
+        ElementIterator it = first_;
+        for (int row = 0; (row < Traits::NumRowsCols) && (all_nan || diagonal); ++row)
         {
-            return PackingModeScalar;
+            for (int col = 0; col < Traits::NumRowsCols; ++col, ++it)
+            {
+                if (all_nan && !isNaN(*it))
+                {
+                    all_nan = false;
+                }
+                if (row == col)
+                {
+                    scalar = scalar && areClose(*it, *first_);
+                }
+                else if (diagonal && !isCloseToZero(*it))
+                {
+                    diagonal = false;
+                    if (!all_nan)
+                    {
+                        break;
+                    }
+                }
+            }
         }
-        if (isDiagonal())
+
+        if (all_nan)
         {
-            return PackingModeDiagonal;
+            return PackingModeEmpty;
         }
-        if (isSymmetric())
+        if (diagonal)
         {
-            return PackingModeSymmetric;
+            return scalar ? PackingModeScalar : PackingModeDiagonal;
         }
-        return PackingModeFull;
+        return isSymmetric() ? PackingModeSymmetric : PackingModeFull;
     }
 };
 
@@ -314,6 +340,12 @@ public:
 
     ArrayImpl() { initialize<ValueType>(0); }
 
+    /**
+     * The inline buffer always has room for all elements.
+     */
+    bool reserve(unsigned) { return true; }
+    unsigned getAllocatedCapacity() const { return MaxSize; }
+
     /**
      * Returns zero-terminated string, same as std::string::c_str().
      * This method will compile only if the array can be interpreted as 8-bit string (ASCII of UTF8).
@@ -403,6 +435,318 @@ public:
      */
     Reference operator[](SizeType pos)  { return at(pos); }
     bool operator[](SizeType pos) const { return at(pos); }
+
+    bool reserve(unsigned) { return true; }
+};
+
+/**
+ * Allocator of the element storage of the dynamic arrays that use @ref PooledArrayImpl.
+ * It can be the node's pool allocator, or a caller-provided arena that implements @ref IPoolAllocator, such as
+ * @ref MultiSizePoolAllocator; note that the allocator must be able to serve blocks large enough for the longest
+ * arrays. If no allocator is set, the pooled arrays can't hold any elements.
+ * The allocator must outlive all the arrays that use it. This class is not thread safe.
+ */
+class UAVCAN_EXPORT DynamicArrayAllocator
+{
+    DynamicArrayAllocator();
+
+public:
+    static IPoolAllocator* getAllocator();
+    static void setAllocator(IPoolAllocator* allocator);
+
+    /**
+     * Number of allocation requests that could not be served.
+     */
+    static uint32_t getNumFailures();
+
+    static void* allocate(std::size_t size);
+    static void deallocate(const void* ptr);
+};
+
+/**
+ * Dynamic array storage that allocates the elements from @ref DynamicArrayAllocator on demand, instead of
+ * reserving the maximum number of elements inline. The allocated capacity grows geometrically up to the maximum
+ * size and is released when the array is destroyed, so a short array uses only a small block of the pool, and
+ * copying the array copies only its actual elements.
+ *
+ * If the memory can't be allocated, the array doesn't grow: push_back() has no effect and the decoding fails
+ * with -ErrMemory. Copying an array that can't be allocated yields an empty array.
+ *
+ * The dynamic arrays that occupy more than UAVCAN_DYNAMIC_ARRAY_POOL_THRESHOLD bytes use this storage; specific
+ * array types can be opted in by specializing @ref ArrayStorageSelector.
+ */
+template <typename T, unsigned MaxSize>
+class UAVCAN_EXPORT PooledArrayImpl : public DynamicArrayBase<MaxSize>
+{
+    typedef DynamicArrayBase<MaxSize> Base;
+
+public:
+    enum
+    {
+        IsStringLike = IsIntegerSpec<T>::Result && (T::MaxBitLen == 8 || T::MaxBitLen == 7)
+    };
+
+    typedef typename StorageType<T>::Type ValueType;
+    typedef typename Base::SizeType SizeType;
+
+private:
+    enum { MinCapacity = 8 };
+
+    ValueType* data_;
+    unsigned allocated_;                ///< Number of elements, excluding the string terminator
+
+    static void destroy(ValueType* data, unsigned num_elements)
+    {
+        for (unsigned i = 0; i < num_elements; i++)
+        {
+            data[i].~ValueType();
+        }
+        DynamicArrayAllocator::deallocate(data);
+    }
+
+    void release()
+    {
+        if (data_ != NULL)
+        {
+            destroy(data_, allocated_ + (IsStringLike ? 1U : 0U));
+            data_ = NULL;
+            allocated_ = 0;
+        }
+    }
+
+    void copyFrom(const PooledArrayImpl& rhs)
+    {
+        Base::clear();
+        if ((rhs.size() > 0) && reserve(rhs.size()))
+        {
+            (void)::uavcan::copy(rhs.data_, rhs.data_ + rhs.size(), data_);
+            Base::operator=(rhs);
+        }
+    }
+
+    ValueType& accessElement(SizeType pos) const
+    {
+        static ValueType dummy = ValueType();   // Only if the range errors are neither fatal nor thrown
+        const SizeType index = Base::validateRange(pos);
+        return (data_ != NULL) ? data_[index] : dummy;
+    }
+
+protected:
+    ~PooledArrayImpl() { release(); }
+
+public:
+    using Base::size;
+    using Base::capacity;
+
+    PooledArrayImpl()
+        : data_(NULL)
+        , allocated_(0)
+    { }
+
+    PooledArrayImpl(const PooledArrayImpl& rhs)
+        : Base()
+        , data_(NULL)
+        , allocated_(0)
+    {
+        copyFrom(rhs);
+    }
+
+    PooledArrayImpl& operator=(const PooledArrayImpl& rhs)
+    {
+        if (this != &rhs)
+        {
+            copyFrom(rhs);
+        }
+        return *this;
+    }
+
+    /**
+     * Makes sure that the storage can accommodate the specified number of elements, up to the maximum size.
+     * Returns false if the memory could not be allocated.
+     */
+    bool reserve(unsigned num_elements)
+    {
+        num_elements = min(num_elements, unsigned(MaxSize));
+        if (num_elements <= allocated_)
+        {
+            return true;
+        }
+
+        const unsigned new_allocated = min(unsigned(MaxSize),
+                                           max(num_elements, max(allocated_ * 2U, unsigned(MinCapacity))));
+        const unsigned new_num_elements = new_allocated + (IsStringLike ? 1U : 0U);
+
+        void* const mem = DynamicArrayAllocator::allocate(new_num_elements * sizeof(ValueType));
+        if (mem == NULL)
+        {
+            return false;
+        }
+
+        ValueType* const new_data = static_cast<ValueType*>(mem);
+        for (unsigned i = 0; i < new_num_elements; i++)
+        {
+            new (new_data + i) ValueType();
+        }
+        if (data_ != NULL)
+        {
+            (void)::uavcan::copy(data_, data_ + size(), new_data);
+        }
+
+        release();
+        data_ = new_data;
+        allocated_ = new_allocated;
+        return true;
+    }
+
+    /**
+     * Number of elements the allocated storage can accommodate; unlike capacity(), this is not the maximum size.
+     */
+    unsigned getAllocatedCapacity() const { return allocated_; }
+
+    /**
+     * Releases the storage if the array is empty.
+     */
+    void shrink_to_fit()
+    {
+        if (size() == 0)
+        {
+            release();
+        }
+    }
+
+    /**
+     * @ref ArrayImpl::c_str()
+     */
+    const char* c_str() const
+    {
+        StaticAssert<IsStringLike>::check();
+        if (data_ == NULL)
+        {
+            return "";
+        }
+        UAVCAN_ASSERT(size() <= allocated_);
+        data_[size()] = 0;      // Ad-hoc string termination
+        return reinterpret_cast<const char*>(data_);
+    }
+
+    /**
+     * @ref ArrayImpl::at()
+     */
+    ValueType& at(SizeType pos)             { return accessElement(pos); }
+    const ValueType& at(SizeType pos) const { return accessElement(pos); }
+
+    ValueType& operator[](SizeType pos)             { return at(pos); }
+    const ValueType& operator[](SizeType pos) const { return at(pos); }
+
+    ValueType* begin()             { return data_; }
+    const ValueType* begin() const { return data_; }
+    ValueType* end()               { return data_ + size(); }
+    const ValueType* end()   const { return data_ + size(); }
+    ValueType& front()             { return at(0U); }
+    const ValueType& front() const { return at(0U); }
+    ValueType& back()              { return at((size() == 0U) ? 0U : SizeType(size() - 1U)); }
+    const ValueType& back()  const { return at((size() == 0U) ? 0U : SizeType(size() - 1U)); }
+
+    template <typename R>
+    bool operator<(const R& rhs) const
+    {
+        return ::uavcan::lexicographical_compare(begin(), end(), rhs.begin(), rhs.end());
+    }
+
+    typedef ValueType* iterator;
+    typedef const ValueType* const_iterator;
+
+protected:
+    void grow()
+    {
+        if ((size() >= MaxSize) || reserve(unsigned(size()) + 1U))
+        {
+            Base::grow();       // Reports the overflow, if any
+        }
+    }
+};
+
+/**
+ * Bit arrays are packed into a bitset, so they are never pooled.
+ */
+template <typename T>
+struct UAVCAN_EXPORT IsBitArrayElement
+{
+    enum { Result = 0 };
+};
+
+template <CastMode CastMode>
+struct UAVCAN_EXPORT IsBitArrayElement<IntegerSpec<1, SignednessUnsigned, CastMode> >
+{
+    enum { Result = 1 };
+};
+
+/**
+ * Selects the storage of the array elements: inline (@ref ArrayImpl) or pooled (@ref PooledArrayImpl).
+ * The application can specialize this template in order to move specific array types into the pool, e.g.:
+ *
+ *     namespace uavcan {
+ *     template <>
+ *     struct ArrayStorageSelector<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 256>
+ *     {
+ *         typedef PooledArrayImpl<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, 256> Result;
+ *     };
+ *     }
+ */
+template <typename T, ArrayMode ArrayMode, unsigned MaxSize>
+struct UAVCAN_EXPORT ArrayStorageSelector
+{
+    enum
+    {
+        UsePool = (ArrayMode == ArrayModeDynamic) && !IsBitArrayElement<T>::Result &&
+                  (UAVCAN_DYNAMIC_ARRAY_POOL_THRESHOLD > 0) &&
+                  ((sizeof(typename StorageType<T>::Type) * MaxSize) > UAVCAN_DYNAMIC_ARRAY_POOL_THRESHOLD)
+    };
+
+    typedef typename Select<UsePool, PooledArrayImpl<T, MaxSize>, ArrayImpl<T, ArrayMode, MaxSize> >::Result Result;
+};
+
+/**
+ * Arrays of these types can be encoded/decoded all at once rather than element by element,
+ * because the elements are whole bytes wide and stored exactly as they are encoded.
+ * See ScalarCodec::encodeArray().
+ */
+template <typename T>
+struct UAVCAN_EXPORT IsBulkCodable
+{
+    enum { Result = 0 };
+};
+
+template <unsigned BitLen, Signedness Signedness, CastMode CastMode>
+struct UAVCAN_EXPORT IsBulkCodable<IntegerSpec<BitLen, Signedness, CastMode> >
+{
+    enum
+    {
+        Result = ((BitLen % 8) == 0) &&
+                 ((sizeof(typename IntegerSpec<BitLen, Signedness, CastMode>::StorageType) * 8) == BitLen)
+    };
+};
+
+template <unsigned BitLen, CastMode CastMode>
+struct UAVCAN_EXPORT IsBulkCodable<FloatSpec<BitLen, CastMode> >
+{
+    enum { Result = FloatSpec<BitLen, CastMode>::IsExactRepresentation };
+};
+
+/**
+ * Arrays of these types are converted in chunks and then encoded/decoded all at once.
+ * See FloatSpec::encodeArray().
+ */
+template <typename T>
+struct UAVCAN_EXPORT IsBulkConvertible
+{
+    enum { Result = 0 };
+};
+
+template <CastMode CastMode>
+struct UAVCAN_EXPORT IsBulkConvertible<FloatSpec<16, CastMode> >
+{
+    enum { Result = 1 };
 };
 
 /**
@@ -414,16 +758,16 @@ template <typename T, ArrayMode ArrayMode> class ArrayImpl<T, ArrayMode, 0>;
  * Generic array implementation.
  * This class is compatible with most standard library functions operating on containers (e.g. std::sort(),
  * std::lexicographical_compare(), etc.).
- * No dynamic memory is used.
+ * No dynamic memory is used, unless the array is pooled, refer to @ref PooledArrayImpl.
  * All functions that can modify the array or access elements are range checking. If the range error occurs:
  * - if exceptions are enabled, std::out_of_range will be thrown;
  * - if UAVCAN_ASSERT() is enabled, program will be terminated on UAVCAN_ASSERT(0);
  * - otherwise the index value will be constrained to the closest valid value.
  */
 template <typename T, ArrayMode ArrayMode, unsigned MaxSize_>
-class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
+class UAVCAN_EXPORT Array : public ArrayStorageSelector<T, ArrayMode, MaxSize_>::Result
 {
-    typedef ArrayImpl<T, ArrayMode, MaxSize_> Base;
+    typedef typename ArrayStorageSelector<T, ArrayMode, MaxSize_>::Result Base;
     typedef Array<T, ArrayMode, MaxSize_> SelfType;
 
     static bool isOptimizedTailArray(TailArrayOptimizationMode tao_mode)
@@ -434,6 +778,24 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     int encodeImpl(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType) const  /// Static
     {
         UAVCAN_ASSERT(size() > 0);
+        return encodeElements(codec, tao_mode, BooleanType<IsBulkCodable<T>::Result>(),
+                              BooleanType<IsBulkConvertible<T>::Result>());
+    }
+
+    template <typename Convertible>
+    int encodeElements(ScalarCodec& codec, TailArrayOptimizationMode, TrueType, Convertible) const  /// All at once
+    {
+        return codec.encodeArray<RawValueType::BitLen>(Base::begin(), unsigned(size()));
+    }
+
+    int encodeElements(ScalarCodec& codec, TailArrayOptimizationMode, FalseType, TrueType) const   /// In chunks
+    {
+        return RawValueType::encodeArray(Base::begin(), unsigned(size()), codec);
+    }
+
+    int encodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode,               /// One by one
+                       FalseType, FalseType) const
+    {
         for (SizeType i = 0; i < size(); i++)
         {
             const bool last_item = i == (size() - 1);
@@ -470,6 +832,24 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
     int decodeImpl(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode, FalseType)  /// Static
     {
         UAVCAN_ASSERT(size() > 0);
+        return decodeElements(codec, tao_mode, BooleanType<IsBulkCodable<T>::Result>(),
+                              BooleanType<IsBulkConvertible<T>::Result>());
+    }
+
+    template <typename Convertible>
+    int decodeElements(ScalarCodec& codec, TailArrayOptimizationMode, TrueType, Convertible)        /// All at once
+    {
+        return codec.decodeArray<RawValueType::BitLen>(Base::begin(), unsigned(size()));
+    }
+
+    int decodeElements(ScalarCodec& codec, TailArrayOptimizationMode, FalseType, TrueType)         /// In chunks
+    {
+        return RawValueType::decodeArray(Base::begin(), unsigned(size()), codec);
+    }
+
+    int decodeElements(ScalarCodec& codec, const TailArrayOptimizationMode tao_mode,               /// One by one
+                       FalseType, FalseType)
+    {
         for (SizeType i = 0; i < size(); i++)
         {
             const bool last_item = i == (size() - 1);
@@ -510,7 +890,12 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
                 {
                     return -ErrInvalidMarshalData;
                 }
+                const SizeType prev_size = size();
                 push_back(value);
+                if (size() == prev_size)
+                {
+                    return -ErrMemory;    // Pooled storage could not be allocated
+                }
             }
         }
         else
@@ -526,6 +911,10 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
                 return -ErrInvalidMarshalData;
             }
             resize(sz);
+            if (size() != sz)
+            {
+                return -ErrMemory;        // Pooled storage could not be allocated
+            }
             if (sz == 0)
             {
                 return 1;
@@ -606,16 +995,18 @@ class UAVCAN_EXPORT Array : public ArrayImpl<T, ArrayMode, MaxSize_>
         if (this->size() == Traits::NumRowsCols || this->size() == 1)   // Scalar or diagonal
         {
             OutputIter it = dst_row_major;
-            for (unsigned index = 0; index < MaxSize; index++)
+            for (int row = 0; row < Traits::NumRowsCols; row++)
             {
-                if (Traits::isIndexOnDiagonal(index))
-                {
-                    const SizeType source_index = SizeType((this->size() == 1) ? 0 : (index / Traits::NumRowsCols));
-                    *it++ = ScalarType(this->at(source_index));
-                }
-                else
+                for (int col = 0; col < Traits::NumRowsCols; col++)
                 {
-                    *it++ = ScalarType(0);
+                    if (row == col)
+                    {
+                        *it++ = ScalarType(this->at(SizeType((this->size() == 1) ? 0 : row)));
+                    }
+                    else
+                    {
+                        *it++ = ScalarType(0);
+                    }
                 }
             }
         }
@@ -716,6 +1107,10 @@ public:
     void pop_back() { Base::shrink(); }
     void push_back(const ValueType& value)
     {
+        if (!Base::reserve(unsigned(size()) + 1U))
+        {
+            return;                     // Out of memory, refer to PooledArrayImpl
+        }
         Base::grow();
         Base::at(SizeType(size() - 1)) = value;
     }
@@ -727,6 +1122,10 @@ public:
     {
         if (new_size > size())
         {
+            if (!Base::reserve(new_size))
+            {
+                return;                 // Out of memory, refer to PooledArrayImpl
+            }
             SizeType cnt = SizeType(new_size - size());
             while (cnt-- > 0)
             {
@@ -898,9 +1297,19 @@ public:
         }
         // Add some hardcore runtime checks for the format string correctness?
 
+        if (!Base::reserve(capacity()))
+        {
+            // Pooled storage can't be grown to the maximum size, so it is grown only as much as needed
+            const int len = snprintf(NULL, 0, format, value);
+            if ((len < 0) || !Base::reserve(unsigned(size()) + unsigned(len)))
+            {
+                return;                 // Out of memory, refer to PooledArrayImpl
+            }
+        }
+
         ValueType* const ptr = Base::end();
-        UAVCAN_ASSERT(capacity() >= size());
-        const SizeType max_size = SizeType(capacity() - size());
+        UAVCAN_ASSERT(Base::getAllocatedCapacity() >= size());
+        const SizeType max_size = SizeType(Base::getAllocatedCapacity() - size());
 
         // We have one extra byte for the null terminator, hence +1
         const int ret = snprintf(reinterpret_cast<char*>(ptr), SizeType(max_size + 1U), format, value);
@@ -48,8 +48,21 @@ class UAVCAN_EXPORT BitStream
     unsigned bit_offset_;
     uint8_t byte_cache_;
 
+    /*
+     * Contiguous chunk of the buffer that was used by the last read, see ITransferBuffer::getContiguousSpan().
+     * Reads that fall within the span decode directly from the buffer memory.
+     */
+    const uint8_t* span_data_;
+    unsigned span_offset_;
+    unsigned span_len_;
+
     static inline unsigned bitlenToBytelen(unsigned bits) { return (bits + 7) / 8; }
 
+    bool isWithinSpan(unsigned byte_offset, unsigned bytelen) const
+    {
+        return (byte_offset >= span_offset_) && ((byte_offset + bytelen) <= (span_offset_ + span_len_));
+    }
+
 #if UAVCAN_TINY
     static inline void copyBitArrayAlignedToUnaligned(const uint8_t* src_org, unsigned src_len,
                                                       uint8_t* dst_org, unsigned dst_offset)
@@ -93,6 +106,9 @@ public:
         : buf_(buf)
         , bit_offset_(0)
         , byte_cache_(0)
+        , span_data_(NULL)
+        , span_offset_(0)
+        , span_len_(0)
     {
         StaticAssert<sizeof(uint8_t) == 1>::check();
     }
@@ -111,6 +127,21 @@ public:
     int write(const uint8_t* bytes, const unsigned bitlen);
     int read(uint8_t* bytes, const unsigned bitlen);
 
+    /**
+     * Fast path for whole bytes at a byte-aligned offset, which bypasses bit array copying.
+     * Can be used only if @ref isByteAligned() returns true. Return values are the same as for write()/read().
+     */
+    int writeAlignedBytes(const uint8_t* bytes, const unsigned bytelen);
+    int readAlignedBytes(uint8_t* bytes, const unsigned bytelen);
+
+    bool isByteAligned() const { return (bit_offset_ % 8) == 0; }
+
+    /**
+     * Moves the read position to the specified bit; this allows to read a field without decoding the preceding ones.
+     * Must not be used for writing.
+     */
+    void seek(unsigned bit_offset) { bit_offset_ = bit_offset; }
+
 #if UAVCAN_TOSTRING
     std::string toString() const;
 #endif
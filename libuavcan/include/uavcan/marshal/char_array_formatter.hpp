@@ -14,6 +14,8 @@
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 # include <type_traits>
+# include <limits>
+# include <cmath>
 #endif
 
 namespace uavcan
@@ -21,16 +23,220 @@ namespace uavcan
 
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
+/**
+ * Type-safe formatter: every format specifier (a percent sign followed by any character) is replaced with the next
+ * argument, rendered according to its type; the specifier character itself is ignored.
+ * The arguments are converted to text directly, without snprintf(); floating point values are rendered like %g.
+ * The output is truncated when the array is full.
+ */
 template <typename ArrayType_>
 class UAVCAN_EXPORT CharArrayFormatter
 {
     ArrayType_& array_;
 
+    enum { FloatPrecision = 6 };                ///< Significant digits, same as %g
+
+    void appendChar(char c)
+    {
+        if (array_.size() != array_.capacity())
+        {
+            array_.push_back(typename ArrayType_::ValueType(c));
+        }
+    }
+
+    void appendString(const char* str)
+    {
+        while (*str != '\0' && array_.size() != array_.capacity())
+        {
+            array_.push_back(typename ArrayType_::ValueType(*str++));
+        }
+    }
+
+    void appendUnsigned(unsigned long long value, unsigned base = 10, unsigned min_digits = 1)
+    {
+        char buf[24];                           // Enough for 2^64 in decimal
+        unsigned len = 0;
+        while ((value > 0) || (len < min_digits))
+        {
+            const unsigned digit = unsigned(value % base);
+            buf[len++] = char((digit < 10) ? ('0' + digit) : ('a' + digit - 10));
+            value /= base;
+        }
+        while (len > 0)
+        {
+            appendChar(buf[--len]);
+        }
+    }
+
+    /**
+     * Returns x * 10^exp. The powers up to 10^15 are exact, so for such exponents the result is correctly rounded,
+     * and out_error_sign receives the sign of the rounding error (exact result minus returned value), computed with
+     * FMA. This is what allows to round the decimal digits the same way printf() does, e.g. 1000.015 is actually
+     * slightly less than that and must be rendered as 1000.01.
+     */
+    static double scaleByPowerOf10(double x, int exp, double& out_error_sign)
+    {
+        static const double Pow10[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+        };
+        while (exp >= 16)
+        {
+            x *= 1e16;
+            exp -= 16;
+        }
+        while (exp <= -16)
+        {
+            x /= 1e16;
+            exp += 16;
+        }
+        if (exp >= 0)
+        {
+            const double product = x * Pow10[exp];
+            out_error_sign = std::fma(x, Pow10[exp], -product);
+            return product;
+        }
+        else
+        {
+            const double quotient = x / Pow10[-exp];
+            out_error_sign = std::fma(-quotient, Pow10[-exp], x);
+            return quotient;
+        }
+    }
+
+    /**
+     * Same output as printf("%g").
+     */
+    void appendFloat(double value)
+    {
+        if (std::signbit(value))
+        {
+            appendChar('-');
+            value = -value;
+        }
+        if (isNaN(value))
+        {
+            appendString("nan");
+            return;
+        }
+        if (value > std::numeric_limits<double>::max())
+        {
+            appendString("inf");
+            return;
+        }
+        if (!(value > 0))                       // Zero, the sign is already removed
+        {
+            appendChar('0');
+            return;
+        }
+
+        /*
+         * Finding the decimal exponent and the significant digits
+         */
+        static const unsigned long long MinMantissa = 100000ULL;            // 10^(FloatPrecision - 1)
+        static const unsigned long long MaxMantissa = MinMantissa * 10ULL;
+
+        int exp10 = 0;
+        for (double x = value; x >= 10.0; x /= 10.0)
+        {
+            exp10++;
+        }
+        for (double x = value; x < 1.0; x *= 10.0)
+        {
+            exp10--;
+        }
+
+        unsigned long long mantissa = 0;
+        for (int i = 0; i < 3; i++)             // The estimate may be off by one because of the rounding
+        {
+            double error_sign = 0;
+            const double scaled = scaleByPowerOf10(value, FloatPrecision - 1 - exp10, error_sign);
+            mantissa = static_cast<unsigned long long>(scaled);
+            const double fraction = scaled - double(mantissa);
+            const bool tie = !(fraction < 0.5) && !(fraction > 0.5);
+            const bool exact = !(error_sign < 0) && !(error_sign > 0);
+            if ((fraction > 0.5) || (tie && ((error_sign > 0) || (exact && ((mantissa & 1U) != 0)))))
+            {
+                mantissa++;                     // Ties are rounded to even
+            }
+            if (mantissa >= MaxMantissa)
+            {
+                exp10++;
+            }
+            else if (mantissa < MinMantissa)
+            {
+                exp10--;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        char digits[FloatPrecision];
+        for (int i = FloatPrecision - 1; i >= 0; i--)
+        {
+            digits[i] = char('0' + unsigned(mantissa % 10ULL));
+            mantissa /= 10ULL;
+        }
+        int num_digits = FloatPrecision;
+        while ((num_digits > 1) && (digits[num_digits - 1] == '0'))
+        {
+            num_digits--;                       // Trailing zeros are removed
+        }
+
+        /*
+         * Rendering
+         */
+        if ((exp10 < -4) || (exp10 >= FloatPrecision))
+        {
+            appendChar(digits[0]);
+            if (num_digits > 1)
+            {
+                appendChar('.');
+                for (int i = 1; i < num_digits; i++)
+                {
+                    appendChar(digits[i]);
+                }
+            }
+            appendChar('e');
+            appendChar((exp10 < 0) ? '-' : '+');
+            appendUnsigned(static_cast<unsigned long long>((exp10 < 0) ? -exp10 : exp10), 10, 2);
+        }
+        else if (exp10 < 0)
+        {
+            appendString("0.");
+            for (int i = -1; i > exp10; i--)
+            {
+                appendChar('0');
+            }
+            for (int i = 0; i < num_digits; i++)
+            {
+                appendChar(digits[i]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i <= exp10; i++)
+            {
+                appendChar(digits[i]);
+            }
+            if (num_digits > (exp10 + 1))
+            {
+                appendChar('.');
+                for (int i = exp10 + 1; i < num_digits; i++)
+                {
+                    appendChar(digits[i]);
+                }
+            }
+        }
+    }
+
     template <typename T>
     typename std::enable_if<std::is_floating_point<T>::value>::type
     writeValue(T value)
     {
-        array_.template appendFormatted<double>("%g", double(value));
+        appendFloat(double(value));
     }
 
     template <typename T>
@@ -39,18 +245,17 @@ class UAVCAN_EXPORT CharArrayFormatter
     {
         if (std::is_same<T, char>())
         {
-            if (array_.size() != array_.capacity())
-            {
-                array_.push_back(typename ArrayType_::ValueType(value));
-            }
+            appendChar(char(value));
         }
-        else if (std::is_signed<T>())
+        else if (std::is_signed<T>() && (value < T(0)))
         {
-            array_.template appendFormatted<long long>("%lli", static_cast<long long>(value));
+            appendChar('-');
+            // Negating after the conversion to avoid overflow on the minimal value
+            appendUnsigned(0ULL - static_cast<unsigned long long>(static_cast<long long>(value)));
         }
         else
         {
-            array_.template appendFormatted<unsigned long long>("%llu", static_cast<unsigned long long>(value));
+            appendUnsigned(static_cast<unsigned long long>(value));
         }
     }
 
@@ -58,12 +263,13 @@ class UAVCAN_EXPORT CharArrayFormatter
     typename std::enable_if<std::is_pointer<T>::value && !std::is_same<T, const char*>::value>::type
     writeValue(T value)
     {
-        array_.template appendFormatted<const void*>("%p", static_cast<const void*>(value));
+        appendString("0x");
+        appendUnsigned(reinterpret_cast<unsigned long long>(static_cast<const void*>(value)), 16);
     }
 
     void writeValue(const char* value)
     {
-        array_.template appendFormatted<const char*>("%s", value);
+        appendString((value == NULL) ? "(null)" : value);
     }
 
 public:
@@ -75,6 +75,13 @@ public:
         u.i = value;
         return u.f;
     }
+
+    /**
+     * Same as toIeee<16>()/toNative<16>() for many values at once; the vector instructions are used if available
+     * (see UAVCAN_HARDWARE_FLOAT16).
+     */
+    static void toHalfArray(const float* values, uint16_t* out_halfs, unsigned count);
+    static void fromHalfArray(const uint16_t* halfs, float* out_values, unsigned count);
 };
 template <>
 inline typename IntegerSpec<16, SignednessUnsigned, CastModeTruncate>::StorageType
@@ -138,15 +145,7 @@ public:
 
     static int encode(StorageType value, ScalarCodec& codec, TailArrayOptimizationMode)
     {
-        // cppcheck-suppress duplicateExpression
-        if (CastMode == CastModeSaturate)
-        {
-            saturate(value);
-        }
-        else
-        {
-            truncate(value);
-        }
+        applyCastMode(value);
         return codec.encode<BitLen>(IEEE754Converter::toIeee<BitLen>(value));
     }
 
@@ -162,9 +161,87 @@ public:
         return res;
     }
 
+    /**
+     * Same as encode()/decode(), but the value is placed into a buffer at a fixed offset.
+     * See @ref ScalarCodec::pack().
+     */
+    template <unsigned BitOffset>
+    static void pack(StorageType value, uint8_t* buffer)
+    {
+        applyCastMode(value);
+        ScalarCodec::pack<BitOffset, BitLen>(buffer, IEEE754Converter::toIeee<BitLen>(value));
+    }
+
+    template <unsigned BitOffset>
+    static void unpack(StorageType& out_value, const uint8_t* buffer)
+    {
+        typename IntegerSpec<BitLen, SignednessUnsigned, CastModeTruncate>::StorageType ieee = 0;
+        ScalarCodec::unpack<BitOffset, BitLen>(buffer, ieee);
+        out_value = IEEE754Converter::toNative<BitLen>(ieee);
+    }
+
+    /**
+     * Encodes/decodes many values at once, which is faster than one by one only for float16, because the values
+     * are converted in chunks (see @ref IEEE754Converter::toHalfArray()). Used by the arrays of float16.
+     */
+    static int encodeArray(const StorageType* values, unsigned count, ScalarCodec& codec)
+    {
+        StaticAssert<BitLen == 16>::check();
+        StorageType chunk[ArrayChunkSize];
+        uint16_t halfs[ArrayChunkSize];
+        for (unsigned offset = 0; offset < count; offset += ArrayChunkSize)
+        {
+            const unsigned chunk_size = min(unsigned(ArrayChunkSize), count - offset);
+            for (unsigned i = 0; i < chunk_size; i++)
+            {
+                chunk[i] = values[offset + i];
+                applyCastMode(chunk[i]);
+            }
+            IEEE754Converter::toHalfArray(chunk, halfs, chunk_size);
+            const int res = codec.encodeArray<BitLen>(halfs, chunk_size);
+            if (res <= 0)
+            {
+                return res;
+            }
+        }
+        return 1;
+    }
+
+    static int decodeArray(StorageType* out_values, unsigned count, ScalarCodec& codec)
+    {
+        StaticAssert<BitLen == 16>::check();
+        uint16_t halfs[ArrayChunkSize];
+        for (unsigned offset = 0; offset < count; offset += ArrayChunkSize)
+        {
+            const unsigned chunk_size = min(unsigned(ArrayChunkSize), count - offset);
+            const int res = codec.decodeArray<BitLen>(halfs, chunk_size);
+            if (res <= 0)
+            {
+                return res;
+            }
+            IEEE754Converter::fromHalfArray(halfs, out_values + offset, chunk_size);
+        }
+        return 1;
+    }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 
 private:
+    enum { ArrayChunkSize = 16 };
+
+    static inline void applyCastMode(StorageType& value)
+    {
+        // cppcheck-suppress duplicateExpression
+        if (CastMode == CastModeSaturate)
+        {
+            saturate(value);
+        }
+        else
+        {
+            truncate(value);
+        }
+    }
+
     static inline void saturate(StorageType& value)
     {
         if ((IsExactRepresentation == 0) && isFinite(value))
@@ -93,6 +93,19 @@ private:
 
     static void truncate(StorageType& value) { value = value & StorageType(mask()); }
 
+    static void applyCastMode(StorageType& value)
+    {
+        // cppcheck-suppress duplicateExpression
+        if (CastMode == CastModeSaturate)
+        {
+            saturate(value);
+        }
+        else
+        {
+            truncate(value);
+        }
+    }
+
     static void validate()
     {
         StaticAssert<(BitLen <= (sizeof(StorageType) * 8))>::check();
@@ -110,15 +123,7 @@ public:
     static int encode(StorageType value, ScalarCodec& codec, TailArrayOptimizationMode)
     {
         validate();
-        // cppcheck-suppress duplicateExpression
-        if (CastMode == CastModeSaturate)
-        {
-            saturate(value);
-        }
-        else
-        {
-            truncate(value);
-        }
+        applyCastMode(value);
         return codec.encode<BitLen>(value);
     }
 
@@ -128,6 +133,25 @@ public:
         return codec.decode<BitLen>(out_value);
     }
 
+    /**
+     * Same as encode()/decode(), but the value is placed into a buffer at a fixed offset.
+     * See @ref ScalarCodec::pack().
+     */
+    template <unsigned BitOffset>
+    static void pack(StorageType value, uint8_t* buffer)
+    {
+        validate();
+        applyCastMode(value);
+        ScalarCodec::pack<BitOffset, BitLen>(buffer, value);
+    }
+
+    template <unsigned BitOffset>
+    static void unpack(StorageType& out_value, const uint8_t* buffer)
+    {
+        validate();
+        ScalarCodec::unpack<BitOffset, BitLen>(buffer, out_value);
+    }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 };
 
@@ -165,6 +189,18 @@ public:
         return codec.decode<BitLen>(out_value);
     }
 
+    template <unsigned BitOffset>
+    static void pack(StorageType value, uint8_t* buffer)
+    {
+        ScalarCodec::pack<BitOffset, BitLen>(buffer, value);
+    }
+
+    template <unsigned BitOffset>
+    static void unpack(StorageType& out_value, const uint8_t* buffer)
+    {
+        ScalarCodec::unpack<BitOffset, BitLen>(buffer, out_value);
+    }
+
     static void extendDataTypeSignature(DataTypeSignature&) { }
 };
 
@@ -23,9 +23,7 @@ class UAVCAN_EXPORT ScalarCodec
 
     static void swapByteOrder(uint8_t* bytes, unsigned len);
 
-    template <unsigned BitLen, unsigned Size>
-    static typename EnableIf<(BitLen > 8)>::Type
-    convertByteOrder(uint8_t (&bytes)[Size])
+    static bool isBigEndian()
     {
 #if defined(BYTE_ORDER) && defined(BIG_ENDIAN)
         static const bool big_endian = BYTE_ORDER == BIG_ENDIAN;
@@ -34,6 +32,14 @@ class UAVCAN_EXPORT ScalarCodec
         u.l = 1;
         const bool big_endian = u.c[sizeof(long int) - 1] == 1;
 #endif
+        return big_endian;
+    }
+
+    template <unsigned BitLen, unsigned Size>
+    static typename EnableIf<(BitLen > 8)>::Type
+    convertByteOrder(uint8_t (&bytes)[Size])
+    {
+        const bool big_endian = isBigEndian();
         /*
          * I didn't have any big endian machine nearby, so big endian support wasn't tested yet.
          * It is likely to be OK anyway, so feel free to remove this UAVCAN_ASSERT() as needed.
@@ -76,7 +82,7 @@ class UAVCAN_EXPORT ScalarCodec
     clearExtraBits(T&) { }
 
     template <unsigned BitLen, typename T>
-    void validate()
+    static void validate()
     {
         StaticAssert<((sizeof(T) * 8) >= BitLen)>::check();
         StaticAssert<(BitLen <= BitStream::MaxBitsPerRW)>::check();
@@ -86,6 +92,36 @@ class UAVCAN_EXPORT ScalarCodec
     int encodeBytesImpl(uint8_t* bytes, unsigned bitlen);
     int decodeBytesImpl(uint8_t* bytes, unsigned bitlen);
 
+
+    /*
+     * Fields that consist of whole bytes are copied directly if the stream is byte-aligned.
+     */
+    template <unsigned BitLen>
+    typename EnableIf<((BitLen % 8) == 0), int>::Type encodeBytes(uint8_t* bytes)
+    {
+        return stream_.isByteAligned() ? stream_.writeAlignedBytes(bytes, BitLen / 8) :
+                                         encodeBytesImpl(bytes, BitLen);
+    }
+
+    template <unsigned BitLen>
+    typename EnableIf<((BitLen % 8) != 0), int>::Type encodeBytes(uint8_t* bytes)
+    {
+        return encodeBytesImpl(bytes, BitLen);
+    }
+
+    template <unsigned BitLen>
+    typename EnableIf<((BitLen % 8) == 0), int>::Type decodeBytes(uint8_t* bytes)
+    {
+        return stream_.isByteAligned() ? stream_.readAlignedBytes(bytes, BitLen / 8) :
+                                         decodeBytesImpl(bytes, BitLen);
+    }
+
+    template <unsigned BitLen>
+    typename EnableIf<((BitLen % 8) != 0), int>::Type decodeBytes(uint8_t* bytes)
+    {
+        return decodeBytesImpl(bytes, BitLen);
+    }
+
 public:
     explicit ScalarCodec(BitStream& stream)
         : stream_(stream)
@@ -96,6 +132,37 @@ public:
 
     template <unsigned BitLen, typename T>
     int decode(T& value);
+
+    /**
+     * Encodes/decodes a number of consecutive values at once.
+     * The values must be whole bytes wide and the native representation must have the same width as the encoded one,
+     * so no range checks or sign extension are needed; e.g. uint8, int16, float32.
+     * On a little endian platform the values are copied directly, otherwise they are processed one by one.
+     * Return values are the same as for encode()/decode().
+     */
+    template <unsigned BitLen, typename T>
+    int encodeArray(const T* values, unsigned count);
+
+    template <unsigned BitLen, typename T>
+    int decodeArray(T* values, unsigned count);
+
+    /**
+     * Writes/reads a bit array of arbitrary length, in the same format as @ref BitStream::write()/read().
+     * Return values are the same as for encode()/decode().
+     */
+    int encodeBitArray(const uint8_t* bytes, unsigned bitlen);
+    int decodeBitArray(uint8_t* bytes, unsigned bitlen);
+
+    /**
+     * Places the value into the zero-initialized buffer at the given bit offset, exactly as encode() would write it
+     * into the stream; unpack() does the opposite. The buffer can be then written with encodeBitArray().
+     * This allows to serialize fixed layout structures with the offsets known at compile time.
+     */
+    template <unsigned BitOffset, unsigned BitLen, typename T>
+    static void pack(uint8_t* buffer, const T value);
+
+    template <unsigned BitOffset, unsigned BitLen, typename T>
+    static void unpack(const uint8_t* buffer, T& value);
 };
 
 // ----------------------------------------------------------------------------
@@ -112,7 +179,7 @@ int ScalarCodec::encode(const T value)
     byte_union.value = value;
     clearExtraBits<BitLen, T>(byte_union.value);
     convertByteOrder<BitLen>(byte_union.bytes);
-    return encodeBytesImpl(byte_union.bytes, BitLen);
+    return encodeBytes<BitLen>(byte_union.bytes);
 }
 
 template <unsigned BitLen, typename T>
@@ -125,7 +192,7 @@ int ScalarCodec::decode(T& value)
         uint8_t bytes[sizeof(T)];
     } byte_union;
     byte_union.value = T();
-    const int read_res = decodeBytesImpl(byte_union.bytes, BitLen);
+    const int read_res = decodeBytes<BitLen>(byte_union.bytes);
     if (read_res > 0)
     {
         convertByteOrder<BitLen>(byte_union.bytes);
@@ -135,6 +202,98 @@ int ScalarCodec::decode(T& value)
     return read_res;
 }
 
+template <unsigned BitLen, typename T>
+int ScalarCodec::encodeArray(const T* values, unsigned count)
+{
+    StaticAssert<((BitLen % 8) == 0) && ((sizeof(T) * 8) == BitLen)>::check();
+    UAVCAN_ASSERT(values);
+    if (isBigEndian())
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            const int res = encode<BitLen>(values[i]);
+            if (res <= 0)
+            {
+                return res;
+            }
+        }
+        return BitStream::ResultOk;
+    }
+    return encodeBitArray(reinterpret_cast<const uint8_t*>(values), count * unsigned(sizeof(T)) * 8U);
+}
+
+template <unsigned BitLen, typename T>
+int ScalarCodec::decodeArray(T* values, unsigned count)
+{
+    StaticAssert<((BitLen % 8) == 0) && ((sizeof(T) * 8) == BitLen)>::check();
+    UAVCAN_ASSERT(values);
+    if (isBigEndian())
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            const int res = decode<BitLen>(values[i]);
+            if (res <= 0)
+            {
+                return res;
+            }
+        }
+        return BitStream::ResultOk;
+    }
+    return decodeBitArray(reinterpret_cast<uint8_t*>(values), count * unsigned(sizeof(T)) * 8U);
+}
+
+template <unsigned BitOffset, unsigned BitLen, typename T>
+void ScalarCodec::pack(uint8_t* const buffer, const T value)
+{
+    validate<BitLen, T>();
+    union ByteUnion
+    {
+        T value;
+        uint8_t bytes[sizeof(T)];
+    } byte_union;
+    byte_union.value = value;
+    clearExtraBits<BitLen, T>(byte_union.value);
+    convertByteOrder<BitLen>(byte_union.bytes);
+    // The bounds are known at compile time, so this loop is expected to be unrolled
+    for (unsigned i = 0; i < ((BitLen + 7U) / 8U); i++)
+    {
+        const unsigned pos = BitOffset + i * 8U;
+        const unsigned len = min(8U, BitLen - i * 8U);
+        const uint8_t chunk = uint8_t(byte_union.bytes[i] << (8U - len));  // Same as in encodeBytesImpl()
+        buffer[pos / 8U] = uint8_t(buffer[pos / 8U] | (chunk >> (pos % 8U)));
+        if (((pos % 8U) + len) > 8U)
+        {
+            buffer[pos / 8U + 1U] = uint8_t(buffer[pos / 8U + 1U] | (chunk << (8U - (pos % 8U))));
+        }
+    }
+}
+
+template <unsigned BitOffset, unsigned BitLen, typename T>
+void ScalarCodec::unpack(const uint8_t* const buffer, T& value)
+{
+    validate<BitLen, T>();
+    union ByteUnion
+    {
+        T value;
+        uint8_t bytes[sizeof(T)];
+    } byte_union;
+    byte_union.value = T();
+    for (unsigned i = 0; i < ((BitLen + 7U) / 8U); i++)
+    {
+        const unsigned pos = BitOffset + i * 8U;
+        const unsigned len = min(8U, BitLen - i * 8U);
+        uint8_t chunk = uint8_t(buffer[pos / 8U] << (pos % 8U));
+        if (((pos % 8U) + len) > 8U)
+        {
+            chunk = uint8_t(chunk | (buffer[pos / 8U + 1U] >> (8U - (pos % 8U))));
+        }
+        byte_union.bytes[i] = uint8_t(chunk >> (8U - len));
+    }
+    convertByteOrder<BitLen>(byte_union.bytes);
+    fixTwosComplement<BitLen, T>(byte_union.value);
+    value = byte_union.value;
+}
+
 }
 
 #endif // UAVCAN_MARSHAL_SCALAR_CODEC_HPP_INCLUDED
@@ -6,6 +6,7 @@
 #define UAVCAN_NODE_ABSTRACT_NODE_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
 #include <uavcan/dynamic_memory.hpp>
 #include <uavcan/node/scheduler.hpp>
 
@@ -21,6 +22,28 @@ class UAVCAN_EXPORT INode
 public:
     virtual ~INode() { }
     virtual IPoolAllocator& getAllocator() = 0;
+
+    /**
+     * Returns the allocator that shall be used by the specified subsystem.
+     * Node implementations can return individually instrumented allocators here in order to attribute
+     * memory usage to subsystems; see @ref getMemoryUsage(). By default all subsystems share the same allocator.
+     */
+    virtual IPoolAllocator& getAllocatorFor(MemoryConsumer) { return getAllocator(); }
+
+    /**
+     * Returns the memory usage statistics of the specified subsystem, or NULL if the node doesn't track it.
+     */
+    virtual const InstrumentedPoolAllocator* getMemoryUsage(MemoryConsumer) const { return NULL; }
+
+    /**
+     * Limits the number of memory blocks the specified subsystem can allocate from the pool.
+     * This allows to make sure that one subsystem can't starve the others; e.g. a flood of incoming multi-frame
+     * transfers can't exhaust the memory needed by the TX queue if the transfer receivers have a quota.
+     * The quota should be configured before the node is started.
+     * Returns negative error code if the node doesn't track memory usage per subsystem.
+     */
+    virtual int setMemoryQuota(MemoryConsumer, uint16_t) { return -ErrLogic; }
+
     virtual Scheduler& getScheduler() = 0;
     virtual const Scheduler& getScheduler() const = 0;
     virtual void registerInternalFailure(const char* msg) = 0;
@@ -88,6 +111,17 @@ public:
         return getScheduler().spinOnce();
     }
 
+    /**
+     * This method is designed for the applications that run the node from an existing loop, e.g. an RTOS task,
+     * and need a predictable cost per iteration: at most max_frames CAN frames are processed per call, the rest
+     * is left for the next call. The deadline limits only the wait for the first frame; by default it never blocks.
+     * This method returns the number of processed frames, or a negative error code (see error.hpp).
+     */
+    int spinBudget(unsigned max_frames, MonotonicTime deadline = MonotonicTime())
+    {
+        return getScheduler().spinBudget(max_frames, deadline);
+    }
+
     /**
      * This method allows to directly transmit a raw CAN frame circumventing the whole UAVCAN stack.
      * Mandatory parameters:
@@ -23,6 +23,17 @@ class GenericPublisherBase : Noncopyable
     TransferSender sender_;
     MonotonicDuration tx_timeout_;
     INode& node_;
+#if !UAVCAN_TINY
+    MonotonicDuration max_silence_interval_;    ///< Zero if the publish-on-change mode is disabled
+    MonotonicTime last_publication_ts_;         ///< Zero if the payload hash is not valid
+    uint64_t last_payload_hash_;
+
+    /**
+     * Returns true if the publication shall be suppressed; otherwise the hash is to be registered once published.
+     */
+    bool isPublicationRedundant(TransferType transfer_type, uint64_t payload_hash) const;
+    void registerPublication(TransferType transfer_type, uint64_t payload_hash, int publish_res);
+#endif
 
 protected:
     GenericPublisherBase(INode& node, MonotonicDuration tx_timeout,
@@ -30,6 +41,9 @@ protected:
         : sender_(node.getDispatcher(), max_transfer_interval)
         , tx_timeout_(tx_timeout)
         , node_(node)
+#if !UAVCAN_TINY
+        , last_payload_hash_(0)
+#endif
     {
         setTxTimeout(tx_timeout);
 #if UAVCAN_DEBUG
@@ -48,11 +62,25 @@ protected:
     int genericPublish(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
                        NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
 
+    int genericPublish(const ITransferPayloadEncoder& encoder, TransferType transfer_type,
+                       NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
+
+    int genericPublish(const StaticTransferBufferImpl& buffer, uint16_t payload_crc, TransferType transfer_type,
+                       NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
+
     TransferSender& getTransferSender() { return sender_; }
     const TransferSender& getTransferSender() const { return sender_; }
 
+    TailArrayOptimizationMode getTailArrayOptimizationMode() const
+    {
+        return sender_.isCanFD() ? TailArrayOptDisabled : TailArrayOptEnabled;
+    }
+
 public:
-    static MonotonicDuration getMinTxTimeout() { return MonotonicDuration::fromUSec(200); }
+    static MonotonicDuration getMinTxTimeout()
+    {
+        return max(MonotonicDuration::fromUSec(200), MonotonicDuration::getResolution());
+    }
     static MonotonicDuration getMaxTxTimeout() { return MonotonicDuration::fromMSec(60000); }
 
     MonotonicDuration getTxTimeout() const { return tx_timeout_; }
@@ -67,12 +95,56 @@ public:
         sender_.allowAnonymousTransfers();
     }
 
+    /**
+     * In latest-value-only mode, a new transfer replaces the queued transfer of the same data type that
+     * has not been transmitted yet, instead of being queued after it. This bounds the TX queue depth and the
+     * latency of messages that are published faster than the bus can deliver them, e.g. sensor readings.
+     * Only single frame transfers are affected; this must not be used with service transfers.
+     * Disabled by default.
+     */
+    bool isLatestValueOnly() const { return (sender_.getCanIOFlags() & CanIOFlagCoalesce) != 0; }
+    void setLatestValueOnly(bool latest_value_only)
+    {
+        sender_.setCanIOFlags(latest_value_only ? CanIOFlags(sender_.getCanIOFlags() | CanIOFlagCoalesce) :
+                                                  CanIOFlags(sender_.getCanIOFlags() & ~CanIOFlagCoalesce));
+    }
+
     /**
      * Priority of outgoing transfers.
      */
     TransferPriority getPriority() const { return sender_.getPriority(); }
     void setPriority(const TransferPriority prio) { sender_.setPriority(prio); }
 
+#if !UAVCAN_TINY
+    /**
+     * In publish-on-change mode, a message broadcast is suppressed if its encoded payload is the same as that of
+     * the last broadcast, unless the last one was longer than the max silence interval ago; the suppressed
+     * publications return zero. The payloads are compared by their 64-bit CRC, so no copy of the last message is
+     * kept; large messages that are encoded directly into the CAN frames are encoded once more to compute the CRC.
+     * Use an infinite interval to send only the changes. Zero interval disables the mode, which is the default.
+     */
+    void setPublishOnChange(MonotonicDuration max_silence_interval);
+    bool isPublishOnChange() const { return max_silence_interval_.isPositive(); }
+
+    /**
+     * Limits the CAN frame rate of this publisher; publications that exceed it fail with @ref ErrRateLimited.
+     * Refer to @ref TransferSender::setFrameRateLimit(). Not limited by default.
+     */
+    void setRateLimit(unsigned max_frames_per_sec, uint16_t burst)
+    {
+        sender_.setFrameRateLimit(max_frames_per_sec, burst);
+    }
+#endif
+
+    /**
+     * Send the transfers in CAN FD frames; only the nodes that support CAN FD will be able to receive them.
+     * Refer to TransferSender::setCanFD(). Always disabled if CAN FD is not supported.
+     */
+#if UAVCAN_SUPPORT_CANFD
+    void setCanFD(bool enabled) { sender_.setCanFD(enabled); }
+#endif
+    bool isCanFD() const { return sender_.isCanFD(); }
+
     INode& getNode() const { return node_; }
 };
 
@@ -93,6 +165,60 @@ class UAVCAN_EXPORT GenericPublisher : public GenericPublisherBase
                             ZeroTransferBuffer,
                             StaticTransferBuffer<BitLenToByteLen<DataStruct::MaxBitLen>::Result> >::Result Buffer;
 
+public:
+    /**
+     * Encoded message and its transfer CRC, kept between publications of a message whose contents rarely change.
+     * The message is encoded on the first publication and every time after @ref markDirty() was called;
+     * otherwise the stored bytes are sent as is. The object takes as much memory as the largest encoded message.
+     * It must be used with one publisher only, because the CRC depends on the data type; it is re-encoded
+     * automatically if the CAN FD mode of the publisher has changed.
+     */
+    class PreEncodedPayload : ::uavcan::Noncopyable
+    {
+        friend class GenericPublisher;
+
+        Buffer buffer_;
+        uint16_t crc_;
+        bool dirty_;
+#if UAVCAN_SUPPORT_CANFD
+        bool canfd_;
+#endif
+
+    public:
+        PreEncodedPayload()
+            : crc_(0)
+            , dirty_(true)
+#if UAVCAN_SUPPORT_CANFD
+            , canfd_(false)
+#endif
+        { }
+
+        /**
+         * Must be called after the message has been modified.
+         */
+        void markDirty() { dirty_ = true; }
+        bool isDirty() const { return dirty_; }
+    };
+
+private:
+
+    class Encoder : public ITransferPayloadEncoder
+    {
+        const DataStruct& message_;
+        const TailArrayOptimizationMode tao_mode_;
+    public:
+        Encoder(const DataStruct& message, TailArrayOptimizationMode tao_mode)
+            : message_(message)
+            , tao_mode_(tao_mode)
+        { }
+        virtual int encode(ITransferBuffer& buffer) const;
+    };
+
+    enum
+    {
+        UseStreamingEncoder = BitLenToByteLen<DataStruct::MaxBitLen>::Result > UAVCAN_STREAMING_ENCODER_THRESHOLD
+    };
+
     enum
     {
         Qos = (DataTypeKind(DataSpec::DataTypeKind) == DataTypeKindMessage) ?
@@ -106,6 +232,16 @@ class UAVCAN_EXPORT GenericPublisher : public GenericPublisherBase
     int genericPublish(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
                        TransferID* tid, MonotonicTime blocking_deadline);
 
+    int doPublish(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
+                  TransferID* tid, MonotonicTime blocking_deadline, FalseType);
+    int doPublish(const DataStruct& message, TransferType transfer_type, NodeID dst_node_id,
+                  TransferID* tid, MonotonicTime blocking_deadline, TrueType);
+
+    int updatePreEncodedPayload(const DataStruct& message, PreEncodedPayload& payload);
+
+    int genericPublish(const DataStruct& message, PreEncodedPayload& payload, TransferType transfer_type,
+                       NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline);
+
 public:
     /**
      * @param max_transfer_interval     Maximum expected time interval between subsequent publications. Leave default.
@@ -146,6 +282,21 @@ public:
     {
         return genericPublish(message, transfer_type, dst_node_id, &tid, blocking_deadline);
     }
+
+    /**
+     * Same as above, but the message is encoded only if the pre-encoded payload is dirty.
+     */
+    int publish(const DataStruct& message, PreEncodedPayload& payload, TransferType transfer_type,
+                NodeID dst_node_id, MonotonicTime blocking_deadline = MonotonicTime())
+    {
+        return genericPublish(message, payload, transfer_type, dst_node_id, NULL, blocking_deadline);
+    }
+
+    int publish(const DataStruct& message, PreEncodedPayload& payload, TransferType transfer_type,
+                NodeID dst_node_id, TransferID tid, MonotonicTime blocking_deadline = MonotonicTime())
+    {
+        return genericPublish(message, payload, transfer_type, dst_node_id, &tid, blocking_deadline);
+    }
 };
 
 // ----------------------------------------------------------------------------
@@ -165,7 +316,7 @@ int GenericPublisher<DataSpec, DataStruct>::doEncode(const DataStruct& message,
 {
     BitStream bitstream(buffer);
     ScalarCodec codec(bitstream);
-    const int encode_res = DataStruct::encode(message, codec);
+    const int encode_res = DataStruct::encode(message, codec, getTailArrayOptimizationMode());
     if (encode_res <= 0)
     {
         UAVCAN_ASSERT(0);   // Impossible, internal error
@@ -174,6 +325,19 @@ int GenericPublisher<DataSpec, DataStruct>::doEncode(const DataStruct& message,
     return encode_res;
 }
 
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::Encoder::encode(ITransferBuffer& buffer) const
+{
+    BitStream bitstream(buffer);
+    ScalarCodec codec(bitstream);
+    const int encode_res = DataStruct::encode(message_, codec, tao_mode_);
+    if (encode_res <= 0)
+    {
+        return (encode_res < 0) ? encode_res : -ErrInvalidMarshalData;
+    }
+    return encode_res;
+}
+
 template <typename DataSpec, typename DataStruct>
 int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& message, TransferType transfer_type,
                                                            NodeID dst_node_id, TransferID* tid,
@@ -184,7 +348,15 @@ int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& mes
     {
         return res;
     }
+    return doPublish(message, transfer_type, dst_node_id, tid, blocking_deadline,
+                     BooleanType<bool(UseStreamingEncoder)>());
+}
 
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::doPublish(const DataStruct& message, TransferType transfer_type,
+                                                      NodeID dst_node_id, TransferID* tid,
+                                                      MonotonicTime blocking_deadline, FalseType)
+{
     Buffer buffer;
 
     const int encode_res = doEncode(message, buffer);
@@ -196,6 +368,62 @@ int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& mes
     return GenericPublisherBase::genericPublish(buffer, transfer_type, dst_node_id, tid, blocking_deadline);
 }
 
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::doPublish(const DataStruct& message, TransferType transfer_type,
+                                                      NodeID dst_node_id, TransferID* tid,
+                                                      MonotonicTime blocking_deadline, TrueType)
+{
+    return GenericPublisherBase::genericPublish(Encoder(message, getTailArrayOptimizationMode()), transfer_type,
+                                                dst_node_id, tid, blocking_deadline);
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::updatePreEncodedPayload(const DataStruct& message,
+                                                                    PreEncodedPayload& payload)
+{
+    payload.buffer_.reset();
+    const int encode_res = doEncode(message, payload.buffer_);
+    if (encode_res < 0)
+    {
+        return encode_res;
+    }
+    payload.crc_ = getTransferSender().computeTransferCRC(payload.buffer_.getRawPtr(),
+                                                          payload.buffer_.getMaxWritePos());
+    payload.dirty_ = false;
+#if UAVCAN_SUPPORT_CANFD
+    payload.canfd_ = isCanFD();
+#endif
+    return 0;
+}
+
+template <typename DataSpec, typename DataStruct>
+int GenericPublisher<DataSpec, DataStruct>::genericPublish(const DataStruct& message, PreEncodedPayload& payload,
+                                                           TransferType transfer_type, NodeID dst_node_id,
+                                                           TransferID* tid, MonotonicTime blocking_deadline)
+{
+    int res = checkInit();
+    if (res < 0)
+    {
+        return res;
+    }
+#if UAVCAN_SUPPORT_CANFD
+    if (payload.canfd_ != isCanFD())
+    {
+        payload.markDirty();
+    }
+#endif
+    if (payload.isDirty())
+    {
+        res = updatePreEncodedPayload(message, payload);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+    return GenericPublisherBase::genericPublish(payload.buffer_, payload.crc_, transfer_type, dst_node_id, tid,
+                                                blocking_deadline);
+}
+
 }
 
 #endif // UAVCAN_NODE_GENERIC_PUBLISHER_HPP_INCLUDED
@@ -12,6 +12,8 @@
 #include <uavcan/util/templates.hpp>
 #include <uavcan/util/lazy_constructor.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/util/event_trace.hpp>
+#include <uavcan/util/latency_histogram.hpp>
 #include <uavcan/transport/transfer_listener.hpp>
 #include <uavcan/marshal/scalar_codec.hpp>
 #include <uavcan/marshal/types.hpp>
@@ -70,6 +72,7 @@ public:
     NodeID getSrcNodeID()            const { return safeget<NodeID, &IncomingTransfer::getSrcNodeID>(); }
     uint8_t getIfaceIndex()          const { return safeget<uint8_t, &IncomingTransfer::getIfaceIndex>(); }
     bool isAnonymousTransfer()       const { return safeget<bool, &IncomingTransfer::isAnonymousTransfer>(); }
+    bool isCanFD()                   const { return safeget<bool, &IncomingTransfer::isCanFD>(); }
 };
 
 /**
@@ -86,12 +89,77 @@ static Stream& operator<<(Stream& s, const ReceivedDataStructure<DataType>& rds)
     return s;
 }
 
+/**
+ * This class gives access to a received transfer that has not been decoded yet, see @ref LazySubscriber<>.
+ * The transport layer information is the same as in @ref ReceivedDataStructure<>.
+ *
+ * The whole structure can be decoded with @ref decode(); alternatively, the individual fields can be decoded with
+ * @ref decodeField<>() directly from the transfer payload, which is much cheaper for large structures if only a few
+ * fields are needed. The bit offset of a field is defined by the DSDL definition; note that it is fixed only for the
+ * fields that are not preceded by dynamic arrays.
+ *
+ * The object refers to the transfer payload, so it must not be used after the callback returns.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT LazyReceivedDataStructure : Noncopyable
+{
+    IncomingTransfer& transfer_;
+
+public:
+    typedef DataType_ DataType;
+
+    explicit LazyReceivedDataStructure(IncomingTransfer& transfer)
+        : transfer_(transfer)
+    { }
+
+    /**
+     * Decodes the whole structure.
+     * @return Positive on success, zero if the payload is too short, negative error code otherwise.
+     */
+    int decode(DataType& out_struct) const
+    {
+        BitStream bitstream(transfer_);
+        ScalarCodec codec(bitstream);
+        return DataType::decode(out_struct, codec,
+                                transfer_.isCanFD() ? TailArrayOptDisabled : TailArrayOptEnabled);
+    }
+
+    /**
+     * Decodes one field located at the specified bit offset.
+     * The field type is the DSDL field type, e.g. IntegerSpec<7, SignednessUnsigned, CastModeSaturate>,
+     * or the field's own type (such as a nested structure type).
+     * @return Positive on success, zero if the payload is too short, negative error code otherwise.
+     */
+    template <typename FieldType>
+    int decodeField(unsigned bit_offset, typename StorageType<FieldType>::Type& out_value,
+                    TailArrayOptimizationMode tao_mode = TailArrayOptDisabled) const
+    {
+        BitStream bitstream(transfer_);
+        bitstream.seek(bit_offset);
+        ScalarCodec codec(bitstream);
+        return FieldType::decode(out_value, codec, tao_mode);
+    }
+
+    MonotonicTime getMonotonicTimestamp() const { return transfer_.getMonotonicTimestamp(); }
+    UtcTime getUtcTimestamp()             const { return transfer_.getUtcTimestamp(); }
+    TransferPriority getPriority()        const { return transfer_.getPriority(); }
+    TransferType getTransferType()        const { return transfer_.getTransferType(); }
+    TransferID getTransferID()            const { return transfer_.getTransferID(); }
+    NodeID getSrcNodeID()                 const { return transfer_.getSrcNodeID(); }
+    uint8_t getIfaceIndex()               const { return transfer_.getIfaceIndex(); }
+    bool isAnonymousTransfer()            const { return transfer_.isAnonymousTransfer(); }
+    bool isCanFD()                        const { return transfer_.isCanFD(); }
+};
+
 
 class GenericSubscriberBase : Noncopyable
 {
 protected:
     INode& node_;
     uint32_t failure_count_;
+#if UAVCAN_LATENCY_HISTOGRAMS
+    LatencyHistogram rx_latency_;
+#endif
 
     explicit GenericSubscriberBase(INode& node)
         : node_(node)
@@ -104,6 +172,24 @@ protected:
 
     void stop(TransferListenerBase* listener);
 
+    /**
+     * Accounts a received transfer that could not be decoded. If the transfer was deferred (see
+     * @ref ITransferHandoff), this may be invoked outside of the thread that spins the node, so the failure is only
+     * recorded in the result of the deferred processing and accounted later by @ref commitDeferredResult().
+     */
+    void registerDecodingFailure(const TransferListenerBase* listener);
+
+#if UAVCAN_LATENCY_HISTOGRAMS
+    /**
+     * Same as @ref registerDecodingFailure(), for the delay before the callback invocation.
+     */
+    void registerRxLatency(const TransferListenerBase* listener, MonotonicDuration latency);
+#endif
+
+#if !UAVCAN_TINY
+    void commitDeferredResult(const DeferredTransferResult& result);
+#endif
+
 public:
     /**
      * Returns the number of failed attempts to decode received message. Generally, a failed attempt means either:
@@ -112,6 +198,16 @@ public:
      */
     uint32_t getFailureCount() const { return failure_count_; }
 
+#if UAVCAN_LATENCY_HISTOGRAMS
+    /**
+     * Delay from the reception of the last frame of a transfer to the invocation of the callback, which includes
+     * the time the frame spent in the driver RX queue (if the driver timestamps frames on arrival), dispatching
+     * and decoding.
+     */
+    const LatencyHistogram& getRxLatencyHistogram() const { return rx_latency_; }
+    LatencyHistogram& getRxLatencyHistogram()             { return rx_latency_; }
+#endif
+
     INode& getNode() const { return node_; }
 };
 
@@ -125,8 +221,9 @@ template <typename DataStruct_,
          >
 class UAVCAN_EXPORT TransferListenerInstantiationHelper
 {
+public:
     enum { DataTypeMaxByteLen = BitLenToByteLen<DataStruct_::MaxBitLen>::Result };
-    enum { NeedsBuffer = int(DataTypeMaxByteLen) > int(GuaranteedPayloadLenPerFrame) };
+    enum { NeedsBuffer = DataStruct_::IsSingleFrame == 0 };    // Single-frame types need neither buffers nor MFT
     enum { BufferSize = NeedsBuffer ? DataTypeMaxByteLen : 0 };
 #if UAVCAN_TINY
     enum { NumStaticBufs = 0 };
@@ -136,7 +233,6 @@ class UAVCAN_EXPORT TransferListenerInstantiationHelper
     enum { NumStaticReceivers = NumStaticReceivers_ };
 #endif
 
-public:
     typedef TransferListenerTemplate<BufferSize, NumStaticBufs, NumStaticReceivers> Type;
 };
 
@@ -159,6 +255,14 @@ class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
             obj_.handleIncomingTransfer(transfer);
         }
 
+#if !UAVCAN_TINY
+        virtual void commitDeferredTransfer(const DeferredTransferResult& result)
+        {
+            TransferListenerType::commitDeferredTransfer(result);
+            obj_.commitDeferredResult(result);
+        }
+#endif
+
     public:
         TransferForwarder(SelfType& obj, const DataTypeDescriptor& data_type, IPoolAllocator& allocator)
             : TransferListenerType(obj.node_.getDispatcher().getTransferPerfCounter(), data_type, allocator)
@@ -170,8 +274,6 @@ class UAVCAN_EXPORT GenericSubscriber : public GenericSubscriberBase
 
     int checkInit();
 
-    void handleIncomingTransfer(IncomingTransfer& transfer);
-
     int genericStart(bool (Dispatcher::*registration_method)(TransferListenerBase*));
 
 protected:
@@ -192,6 +294,12 @@ protected:
 
     virtual void handleReceivedDataStruct(ReceivedDataStructure<DataStruct>&) = 0;
 
+    /**
+     * Decodes the transfer and passes it to @ref handleReceivedDataStruct().
+     * Can be overridden by the subscribers that do not need the transfer decoded.
+     */
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer);
+
     int startAsMessageListener()
     {
         UAVCAN_TRACE("GenericSubscriber", "Start as message listener; dtname=%s", DataSpec::getDataTypeFullName());
@@ -221,6 +329,91 @@ protected:
         forwarder_->allowAnonymousTransfers();
     }
 
+    /**
+     * Transfers rejected by the prefilter are discarded before reassembly and decoding, so that the callback
+     * is not invoked for them; refer to @ref ITransferPrefilter. Returns negative error code.
+     */
+    int setTransferPrefilter(ITransferPrefilter* prefilter)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        forwarder_->setTransferPrefilter(prefilter);
+        return 0;
+    }
+
+    /**
+     * With redundant interfaces, deliver every message via whichever interface brings it first instead of
+     * sticking to one interface; refer to @ref TransferListenerBase::setEarliestArrivalMode().
+     * Returns negative error code.
+     */
+    int setEarliestArrivalMode(bool enabled)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        forwarder_->setEarliestArrivalMode(enabled);
+        return 0;
+    }
+
+    /**
+     * Limits the time the reassembly state of a silent publisher is kept;
+     * refer to @ref TransferListenerBase::setReceiverRetention(). Returns negative error code.
+     */
+    int setReceiverRetention(MonotonicDuration max_retention)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        forwarder_->setReceiverRetention(max_retention);
+        return 0;
+    }
+
+#if !UAVCAN_TINY
+    /**
+     * Decoding and callbacks will be performed wherever the handoff object feeds the transfers back,
+     * e.g. in a worker thread; refer to @ref ITransferHandoff. Returns negative error code.
+     */
+    int setTransferHandoff(ITransferHandoff* handoff)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        forwarder_->setTransferHandoff(handoff);
+        return 0;
+    }
+
+    /**
+     * Sizes the static capacity of the subscription at run time; only available if the transfer listener is
+     * @ref RuntimeCapacityTransferListener, refer to RuntimeCapacityTransferListener::setCapacity().
+     * The storage block must be at least @ref getListenerStorageSize() bytes large.
+     * Must be called before the subscription receives anything. Returns negative error code.
+     */
+    int setListenerCapacity(unsigned expected_publishers, unsigned max_concurrent_transfers,
+                            void* storage, unsigned storage_size)
+    {
+        const int res = checkInit();
+        if (res < 0)
+        {
+            return res;
+        }
+        return forwarder_->setCapacity(expected_publishers, max_concurrent_transfers, storage, storage_size);
+    }
+
+    static unsigned getListenerStorageSize(unsigned expected_publishers, unsigned max_concurrent_transfers)
+    {
+        return TransferListenerType::getStorageSize(expected_publishers, max_concurrent_transfers);
+    }
+#endif
+
     /**
      * Terminate the subscription.
      * Dispatcher core will remove this instance from the subscribers list.
@@ -257,7 +450,7 @@ int GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::checkInit()
     }
 
     forwarder_.template construct<SelfType&, const DataTypeDescriptor&, IPoolAllocator&>
-        (*this, *descr, node_.getAllocator());
+        (*this, *descr, node_.getAllocatorFor(MemoryConsumerTransferReceivers));
 
     return 0;
 }
@@ -273,7 +466,9 @@ void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::handleIncomi
     BitStream bitstream(transfer);
     ScalarCodec codec(bitstream);
 
-    const int decode_res = DataStruct::decode(rx_struct, codec);
+    // CAN FD transfers are padded, so the tail array length can't be deduced from the payload length
+    const int decode_res = DataStruct::decode(rx_struct, codec,
+                                              transfer.isCanFD() ? TailArrayOptDisabled : TailArrayOptEnabled);
 
     // We don't need the data anymore, the memory can be reused from the callback:
     transfer.release();
@@ -282,14 +477,17 @@ void GenericSubscriber<DataSpec, DataStruct, TransferListenerType>::handleIncomi
     {
         UAVCAN_TRACE("GenericSubscriber", "Unable to decode the message [%i] [%s]",
                      decode_res, DataSpec::getDataTypeFullName());
-        failure_count_++;
-        node_.getDispatcher().getTransferPerfCounter().addError();
+        registerDecodingFailure(forwarder_);
         return;
     }
 
     /*
      * Invoking the callback
      */
+#if UAVCAN_LATENCY_HISTOGRAMS
+    registerRxLatency(forwarder_, node_.getMonotonicTime() - transfer.getLastFrameMonotonicTimestamp());
+#endif
+    UAVCAN_EVENT_TRACE_SCOPE(EventTraceSubscriberCallbackBegin, forwarder_->getDataTypeDescriptor().getID().get());
     handleReceivedDataStruct(rx_struct);
 }
 
@@ -74,13 +74,63 @@ public:
 
 private:
     typedef LinkedListRoot<Entry> List;
+
+    struct NameIndexItem
+    {
+        uint32_t name_hash;
+        const DataTypeDescriptor* descriptor;
+    };
+
+    /**
+     * Built by freeze(); see DataTypeRegistryIndexSize.
+     */
+    struct Index
+    {
+        enum { Capacity = (DataTypeRegistryIndexSize > 0) ? DataTypeRegistryIndexSize : 1 };
+
+        const DataTypeDescriptor* by_id[Capacity];      ///< Sorted by data type ID
+        NameIndexItem by_name[Capacity];                ///< Sorted by name hash
+        uint16_t size;
+        bool valid;
+
+        Index() : size(0), valid(false) { }
+
+        void build(const GlobalDataTypeRegistry& registry, DataTypeKind kind);
+
+        const DataTypeDescriptor* find(DataTypeID dtid) const;
+        const DataTypeDescriptor* find(const char* name) const;
+    };
+
     mutable List msgs_;
     mutable List srvs_;
+    Index msg_index_;
+    Index srv_index_;
+    const DataTypeDescriptor* table_;           ///< See adoptDataTypeTable()
+    uint16_t table_size_;
     bool frozen_;
 
-    GlobalDataTypeRegistry() : frozen_(false) { }
+    GlobalDataTypeRegistry()
+        : table_(NULL)
+        , table_size_(0)
+        , frozen_(false)
+    { }
 
     List* selectList(DataTypeKind kind) const;
+    const Index* selectIndex(DataTypeKind kind) const;
+
+    static uint32_t computeNameHash(const char* name);
+
+    const DataTypeDescriptor* findInList(DataTypeKind kind, const char* name) const;
+    const DataTypeDescriptor* findInList(DataTypeKind kind, DataTypeID dtid) const;
+    const DataTypeDescriptor* findInTable(DataTypeKind kind, const char* name) const;
+    const DataTypeDescriptor* findInTable(DataTypeKind kind, DataTypeID dtid) const;
+
+    /**
+     * Whether the table entry has been superseded by a data type of the same name registered at run time.
+     */
+    bool isOverridden(const DataTypeDescriptor& table_entry) const;
+
+    unsigned getNumTypes(DataTypeKind kind) const;
 
     RegistrationResult remove(Entry* dtd);
     RegistrationResult registImpl(Entry* dtd);
@@ -104,6 +154,21 @@ public:
     template <typename Type>
     RegistrationResult registerDataType(DataTypeID id);
 
+    /**
+     * Adopts the table of data types generated by the DSDL compiler (refer to its option --data-type-table),
+     * in constant time. This is an alternative to the registration of every data type before main(), which can be
+     * disabled by defining UAVCAN_NO_STATIC_DATA_TYPE_REGISTRATION=1 for all translation units; in that case the
+     * application must adopt the table before the first node is started.
+     *
+     * The table is not copied, so it must outlive the registry. It must be ordered by data type kind, then by
+     * data type ID, and the names and data type IDs must be unique within each kind. The data types registered
+     * with @ref registerDataType() take precedence over the table entries of the same name.
+     *
+     * Only one table can be adopted; adopting the same table again has no effect.
+     * This method will fail if the data type registry is frozen.
+     */
+    RegistrationResult adoptDataTypeTable(const DataTypeDescriptor* table, unsigned size);
+
     /**
      * Data Type registry needs to be frozen before a node instance can use it in
      * order to prevent accidental change in data type configuration on a running
@@ -113,7 +178,8 @@ public:
      * the user does not need to call it from the application manually. Subsequent
      * calls will not have any effect.
      *
-     * Once frozen, data type registry can't be unfrozen.
+     * Once frozen, data type registry can't be unfrozen. Freezing builds the lookup index of the registry,
+     * see DataTypeRegistryIndexSize.
      */
     void freeze();
     bool isFrozen() const { return frozen_; }
@@ -148,12 +214,12 @@ public:
     /**
      * Returns the number of registered message types.
      */
-    unsigned getNumMessageTypes() const { return msgs_.getLength(); }
+    unsigned getNumMessageTypes() const { return getNumTypes(DataTypeKindMessage); }
 
     /**
      * Returns the number of registered service types.
      */
-    unsigned getNumServiceTypes() const { return srvs_.getLength(); }
+    unsigned getNumServiceTypes() const { return getNumTypes(DataTypeKindService); }
 
 #if UAVCAN_DEBUG
     /// Required for unit testing
@@ -162,6 +228,10 @@ public:
         UAVCAN_TRACE("GlobalDataTypeRegistry", "Reset; was frozen: %i, num msgs: %u, num srvs: %u",
                      int(frozen_), getNumMessageTypes(), getNumServiceTypes());
         frozen_ = false;
+        msg_index_.valid = false;
+        srv_index_.valid = false;
+        table_ = NULL;
+        table_size_ = 0;
         while (msgs_.get())
         {
             msgs_.remove(msgs_.get());
@@ -181,6 +251,7 @@ public:
  * unit of the application, the data type will not be registered.
  *
  * Data type needs to have a default ID to be registrable by this class.
+ * The generated headers don't use this class if UAVCAN_NO_STATIC_DATA_TYPE_REGISTRATION is enabled.
  */
 template <typename Type>
 struct UAVCAN_EXPORT DefaultDataTypeRegistrator
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_LAZY_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_LAZY_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+/**
+ * Same as @ref Subscriber<>, except that the received messages are not decoded: the callback receives
+ * @ref LazyReceivedDataStructure<>, which allows to decode either the whole message or only the fields the
+ * application is interested in. This saves the decoding of large messages (such as the ones with big dynamic
+ * arrays) that the application is going to discard after looking at one or two fields, and the subscriber
+ * does not need the storage for the decoded message.
+ *
+ * Decoding failures are not detected by the subscriber, so @ref getFailureCount() only counts the messages
+ * the application has reported as malformed via @ref registerFailure().
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam Callback_        Type of the callback; the argument type is const LazyReceivedDataStructure<DataType_>&.
+ *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ *
+ * Refer to @ref Subscriber<> for the other template arguments.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const LazyReceivedDataStructure<DataType_>&)>,
+#else
+          typename Callback_ = void (*)(const LazyReceivedDataStructure<DataType_>&),
+#endif
+#if UAVCAN_TINY
+          unsigned NumStaticReceivers = 0,
+          unsigned NumStaticBufs = 0,
+#else
+          unsigned NumStaticReceivers = 2,
+          unsigned NumStaticBufs = 1,
+#endif
+          template <unsigned, unsigned, unsigned> class TransferListenerTemplate_ = TransferListener
+          >
+class UAVCAN_EXPORT LazySubscriber
+    : public GenericSubscriber<DataType_, DataType_,
+                               typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers,
+                                                                            NumStaticBufs,
+                                                                            TransferListenerTemplate_>::Type>
+{
+public:
+    typedef Callback_ Callback;
+
+private:
+    typedef typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers, NumStaticBufs,
+                                                         TransferListenerTemplate_>::Type TransferListenerType;
+    typedef GenericSubscriber<DataType_, DataType_, TransferListenerType> BaseType;
+
+    Callback callback_;
+
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            const LazyReceivedDataStructure<DataType_> lazy_struct(transfer);
+            callback_(lazy_struct);
+        }
+        else
+        {
+            handleFatalError("Sub clbk");
+        }
+    }
+
+    /// Never invoked, since the transfers are not decoded
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<DataType_>&) { }
+
+public:
+    typedef DataType_ DataType;
+
+    explicit LazySubscriber(INode& node)
+        : BaseType(node)
+        , callback_()
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+    }
+
+    /**
+     * Begin receiving messages.
+     * Each message will be passed to the application via the callback.
+     * Returns negative error code.
+     */
+    int start(const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("LazySubscriber", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        return BaseType::startAsMessageListener();
+    }
+
+    /**
+     * The application can call this from the callback if the message turned out to be malformed.
+     */
+    void registerFailure()
+    {
+        BaseType::registerDecodingFailure(BaseType::getTransferListener());
+    }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::setTransferPrefilter;
+    using BaseType::setEarliestArrivalMode;
+    using BaseType::setReceiverRetention;
+#if !UAVCAN_TINY
+    using BaseType::setTransferHandoff;
+#endif
+    using BaseType::stop;
+    using BaseType::getFailureCount;
+};
+
+}
+
+#endif // UAVCAN_NODE_LAZY_SUBSCRIBER_HPP_INCLUDED
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_MEMORY_BUDGET_HPP_INCLUDED
+#define UAVCAN_NODE_MEMORY_BUDGET_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/map.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/transport/transfer_receiver.hpp>
+#include <uavcan/transport/outgoing_transfer_registry.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+
+namespace uavcan
+{
+/**
+ * Worst-case number of memory pool blocks that one transfer listener needs to receive transfers of the given type
+ * from the given number of nodes at once. The listener is the one of a subscriber, of a service server, or the
+ * response listener of a service client; the static parameters are the same as in their templates.
+ *
+ * Every source node takes one receiver; the receivers that do not fit the static storage share pool blocks.
+ * Every multi-frame transfer in progress takes one buffer; the buffers that do not fit the static storage take
+ * one pool block for the buffer itself plus as many blocks as needed for the maximum size of the data type.
+ * The single-frame receiver table (see UAVCAN_TRANSFER_LISTENER_SINGLE_FRAME_TABLE_SIZE) is not taken into
+ * account, so the estimate for single-frame types is pessimistic.
+ */
+template <typename DataStruct, unsigned NumSources, unsigned NumStaticReceivers_, unsigned NumStaticBufs_>
+struct UAVCAN_EXPORT TransferListenerMemoryBudget
+{
+    typedef TransferListenerInstantiationHelper<DataStruct, NumStaticReceivers_, NumStaticBufs_> Helper;
+
+    enum { NumKVPerBlock = MapBase<TransferBufferManagerKey, TransferReceiver>::NumKVPerPoolBlock };
+    enum { NumBytesPerBlock = DynamicTransferBufferManagerEntry::NumBytesPerPoolBlock };
+
+    enum
+    {
+        NumDynamicReceivers = (NumSources > unsigned(Helper::NumStaticReceivers)) ?
+                              (NumSources - unsigned(Helper::NumStaticReceivers)) : 0
+    };
+    enum
+    {
+        NumDynamicBuffers = (Helper::NeedsBuffer && (NumSources > unsigned(Helper::NumStaticBufs))) ?
+                            (NumSources - unsigned(Helper::NumStaticBufs)) : 0
+    };
+    enum { NumBlocksPerBuffer = 1 + (unsigned(Helper::BufferSize) + NumBytesPerBlock - 1) / NumBytesPerBlock };
+
+    enum
+    {
+        NumBlocks = (unsigned(NumDynamicReceivers) + NumKVPerBlock - 1) / NumKVPerBlock +
+                    unsigned(NumDynamicBuffers) * unsigned(NumBlocksPerBuffer)
+    };
+};
+
+/**
+ * Memory budget of a subscriber that receives messages from the given number of publishers.
+ * The other template arguments must match the ones of the @ref Subscriber<>.
+ * The same applies to the @ref LazySubscriber<>.
+ */
+template <typename DataType,
+          unsigned NumPublishers,
+#if UAVCAN_TINY
+          unsigned NumStaticReceivers = 0,
+          unsigned NumStaticBufs = 0
+#else
+          unsigned NumStaticReceivers = 2,
+          unsigned NumStaticBufs = 1
+#endif
+          >
+struct UAVCAN_EXPORT SubscriberMemoryBudget
+{
+    enum
+    {
+        NumTransferReceiverBlocks =
+            TransferListenerMemoryBudget<DataType, NumPublishers, NumStaticReceivers, NumStaticBufs>::NumBlocks
+    };
+    enum { NumServiceCallBlocks = 0 };
+    enum { NumOutgoingTransferEntries = 0 };
+};
+
+/**
+ * Memory budget of a publisher that sends messages to the given number of destinations;
+ * broadcasting counts as one destination.
+ */
+template <unsigned NumDestinations = 1>
+struct UAVCAN_EXPORT PublisherMemoryBudget
+{
+    enum { NumTransferReceiverBlocks = 0 };
+    enum { NumServiceCallBlocks = 0 };
+    enum { NumOutgoingTransferEntries = NumDestinations };
+};
+
+/**
+ * Memory budget of a service server that serves the given number of clients at once.
+ * The other template arguments must match the ones of the @ref ServiceServer<>.
+ * Responses reuse the transfer ID of the request, so they do not need outgoing transfer registry entries.
+ */
+template <typename DataType,
+          unsigned NumClients,
+#if UAVCAN_TINY
+          unsigned NumStaticReceivers = 0,
+          unsigned NumStaticBufs = 0
+#else
+          unsigned NumStaticReceivers = 2,
+          unsigned NumStaticBufs = 1
+#endif
+          >
+struct UAVCAN_EXPORT ServiceServerMemoryBudget
+{
+    enum
+    {
+        NumTransferReceiverBlocks = TransferListenerMemoryBudget<typename DataType::Request, NumClients,
+                                                                 NumStaticReceivers, NumStaticBufs>::NumBlocks
+    };
+    enum { NumServiceCallBlocks = 0 };
+    enum { NumOutgoingTransferEntries = 0 };
+};
+
+/**
+ * Memory budget of a service client that keeps the given number of calls pending at once, addressed to
+ * the given number of servers. The last template argument must match the one of the @ref ServiceClient<>.
+ */
+template <typename DataType, unsigned NumConcurrentCalls, unsigned NumServers = NumConcurrentCalls,
+          unsigned NumStaticCalls = 1>
+struct UAVCAN_EXPORT ServiceClientMemoryBudget
+{
+    enum
+    {
+        NumTransferReceiverBlocks = TransferListenerMemoryBudget<typename DataType::Response, NumServers,
+                                                                 NumStaticCalls, NumStaticCalls>::NumBlocks
+    };
+    enum { NumServiceCallBlocks = (NumConcurrentCalls > NumStaticCalls) ? (NumConcurrentCalls - NumStaticCalls) : 0 };
+    enum { NumOutgoingTransferEntries = NumServers };
+};
+
+/**
+ * Calculator of the memory pool size for a node configuration.
+ *
+ * The worst-case needs of the components of the application are summed up per memory consumer (see
+ * @ref MemoryConsumer) from the budgets defined above, which are computed at compile time from the same
+ * data type properties and template arguments that the components are instantiated with:
+ *
+ *   uavcan::MemoryBudget budget;
+ *   budget.add<uavcan::SubscriberMemoryBudget<uavcan::equipment::ahrs::RawIMU, 2> >();
+ *   budget.add<uavcan::PublisherMemoryBudget<> >(5);       // Five publishers
+ *   budget.add<uavcan::ServiceClientMemoryBudget<uavcan::protocol::param::GetSet, 4> >();
+ *   budget.addCanTxQueue(2, 20);
+ *   // The result can be used as the pool size of the node: budget.getRecommendedPoolSize()
+ *
+ * The standard components of @ref Node serve their requests from the static storage, unless many nodes query
+ * them at once; in that case they can be accounted for with @ref ServiceServerMemoryBudget as well.
+ *
+ * Once the node is running, the budget can be enforced with @ref applyQuotas(), so that a component that
+ * exceeds its budget can not starve the others, and it can be checked against the actual peak usage reported
+ * by the node with @ref findConsumerOverBudget().
+ */
+class UAVCAN_EXPORT MemoryBudget
+{
+    uint32_t num_blocks_[NumMemoryConsumers];
+    uint32_t num_outgoing_transfer_entries_;
+    unsigned num_static_outgoing_transfer_entries_;
+    unsigned num_outgoing_transfer_entries_per_block_;
+    unsigned num_can_ifaces_;
+    unsigned num_tx_frames_per_iface_;
+
+public:
+    /**
+     * @param num_static_outgoing_transfer_entries      Number of statically allocated entries of the outgoing
+     *                                                  transfer registry of the node; the default is pessimistic.
+     * @param num_outgoing_transfer_entries_per_block   Depends on the type of the registry; the default matches
+     *                                                  the registry of the node classes.
+     */
+    explicit MemoryBudget(unsigned num_static_outgoing_transfer_entries = 0,
+                          unsigned num_outgoing_transfer_entries_per_block =
+                              DefaultOutgoingTransferRegistry<0>::Type::NumEntriesPerPoolBlock)
+        : num_outgoing_transfer_entries_(0)
+        , num_static_outgoing_transfer_entries_(num_static_outgoing_transfer_entries)
+        , num_outgoing_transfer_entries_per_block_(max(num_outgoing_transfer_entries_per_block, 1U))
+        , num_can_ifaces_(0)
+        , num_tx_frames_per_iface_(0)
+    {
+        fill(num_blocks_, num_blocks_ + NumMemoryConsumers, uint32_t(0));
+    }
+
+    /**
+     * Adds the given number of components with the same budget, which is one of the budget classes above.
+     */
+    template <typename ComponentBudget>
+    void add(unsigned count = 1)
+    {
+        num_blocks_[MemoryConsumerTransferReceivers] += uint32_t(ComponentBudget::NumTransferReceiverBlocks) * count;
+        num_blocks_[MemoryConsumerServiceCalls] += uint32_t(ComponentBudget::NumServiceCallBlocks) * count;
+        num_outgoing_transfer_entries_ += uint32_t(ComponentBudget::NumOutgoingTransferEntries) * count;
+    }
+
+    /**
+     * Adds blocks that are not covered by the budget classes, e.g. the containers of the protocol helpers.
+     */
+    void addBlocks(MemoryConsumer consumer, uint32_t num_blocks)
+    {
+        if (consumer < NumMemoryConsumers)
+        {
+            num_blocks_[consumer] += num_blocks;
+        }
+    }
+
+    /**
+     * Sets the number of CAN frames that each of the interfaces must be able to keep in its TX queue;
+     * every frame takes one block.
+     */
+    void addCanTxQueue(unsigned num_ifaces, unsigned num_frames_per_iface)
+    {
+        num_can_ifaces_ = num_ifaces;
+        num_tx_frames_per_iface_ = num_frames_per_iface;
+    }
+
+    /**
+     * Worst-case number of blocks needed by the consumer.
+     */
+    uint32_t getNumBlocks(MemoryConsumer consumer) const
+    {
+        if (consumer == MemoryConsumerCanTxQueue)
+        {
+            return uint32_t(num_can_ifaces_) * num_tx_frames_per_iface_;
+        }
+        if (consumer == MemoryConsumerOutgoingTransferRegistry)
+        {
+            const uint32_t num_dynamic = (num_outgoing_transfer_entries_ > num_static_outgoing_transfer_entries_) ?
+                (num_outgoing_transfer_entries_ - num_static_outgoing_transfer_entries_) : 0U;
+            return (num_dynamic + num_outgoing_transfer_entries_per_block_ - 1U) /
+                   num_outgoing_transfer_entries_per_block_;
+        }
+        return (consumer < NumMemoryConsumers) ? num_blocks_[consumer] : 0U;
+    }
+
+    /**
+     * Worst-case number of blocks needed by all consumers.
+     * Since by default the TX queue of each interface is allowed to take 1/(N+1) of the pool, where N is the
+     * number of interfaces, the total is increased if necessary to let the queues reach their budget.
+     */
+    uint32_t getTotalNumBlocks() const
+    {
+        uint32_t total = 0;
+        for (int i = 0; i < NumMemoryConsumers; i++)
+        {
+            total += getNumBlocks(MemoryConsumer(i));
+        }
+        if (num_tx_frames_per_iface_ > 1)
+        {
+            total = max(total, uint32_t(num_tx_frames_per_iface_ - 1U) * (num_can_ifaces_ + 1U));
+        }
+        return max(total, uint32_t(1));
+    }
+
+    /**
+     * Pool size, in bytes, that covers the worst case of all consumers.
+     */
+    uint32_t getRecommendedPoolSize() const { return getTotalNumBlocks() * MemPoolBlockSize; }
+
+    /**
+     * Limits every consumer, except the TX queue and the unaccounted consumers, to its budget.
+     * @return 0 = success, negative for error.
+     */
+    int applyQuotas(INode& node) const
+    {
+        for (int i = 0; i < NumMemoryConsumers; i++)
+        {
+            const MemoryConsumer consumer = MemoryConsumer(i);
+            const uint32_t num_blocks = getNumBlocks(consumer);
+            if ((consumer == MemoryConsumerCanTxQueue) || (num_blocks == 0))
+            {
+                continue;
+            }
+            const int res = node.setMemoryQuota(consumer, uint16_t(min(num_blocks, uint32_t(0xFFFFU))));
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Compares the budget with the peak usage reported by the node, to find out whether the assumptions of the
+     * budget hold. Consumers with zero budget are not checked, unless the strict mode is enabled.
+     * @return The first consumer whose peak usage exceeded its budget, or NumMemoryConsumers if there are none.
+     *         NumMemoryConsumers is also returned if the node does not track memory usage.
+     */
+    MemoryConsumer findConsumerOverBudget(const INode& node, bool strict = false) const
+    {
+        for (int i = 0; i < NumMemoryConsumers; i++)
+        {
+            const MemoryConsumer consumer = MemoryConsumer(i);
+            const InstrumentedPoolAllocator* const usage = node.getMemoryUsage(consumer);
+            const uint32_t num_blocks = getNumBlocks(consumer);
+            if ((usage == NULL) || ((num_blocks == 0) && !strict))
+            {
+                continue;
+            }
+            if (usage->getPeakNumUsedBlocks() > num_blocks)
+            {
+                UAVCAN_TRACE("MemoryBudget", "Consumer %d peak usage %u exceeds the budget of %u blocks",
+                             i, unsigned(usage->getPeakNumUsedBlocks()), unsigned(num_blocks));
+                return consumer;
+            }
+        }
+        return NumMemoryConsumers;
+    }
+};
+
+}
+
+#endif // UAVCAN_NODE_MEMORY_BUDGET_HPP_INCLUDED
@@ -35,6 +35,7 @@ namespace uavcan
  *                          For simple nodes this number can be reduced.
  *                          For high-traffic nodes the recommended minimum is
  *                          like 16K * (number of CAN ifaces + 1).
+ *                          The worst case of a given configuration can be computed with @ref MemoryBudget.
  *
  * @tparam OutgoingTransferRegistryStaticEntries    Number of statically allocated objects
  *                                                  to track Transfer ID for outgoing transfers.
@@ -61,7 +62,10 @@ class UAVCAN_EXPORT Node : public INode
     typedef PoolAllocator<MemPoolSize, MemPoolBlockSize> Allocator;
 
     Allocator pool_allocator_;
-    OutgoingTransferRegistry<OutgoingTransferRegistryStaticEntries> outgoing_trans_reg_;
+#if !UAVCAN_TINY
+    MemoryUsageTracker memory_usage_;
+#endif
+    typename DefaultOutgoingTransferRegistry<OutgoingTransferRegistryStaticEntries>::Type outgoing_trans_reg_;
     Scheduler scheduler_;
 
     NodeStatusProvider proto_nsp_;
@@ -89,8 +93,14 @@ protected:
 
 public:
     Node(ICanDriver& can_driver, ISystemClock& system_clock)
+#if UAVCAN_TINY
         : outgoing_trans_reg_(pool_allocator_)
         , scheduler_(can_driver, pool_allocator_, system_clock, outgoing_trans_reg_)
+#else
+        : memory_usage_(pool_allocator_)
+        , outgoing_trans_reg_(memory_usage_.get(MemoryConsumerOutgoingTransferRegistry))
+        , scheduler_(can_driver, memory_usage_.get(MemoryConsumerCanTxQueue), system_clock, outgoing_trans_reg_)
+#endif
         , proto_nsp_(*this)
 #if !UAVCAN_TINY
         , proto_dtp_(*this)
@@ -104,6 +114,21 @@ public:
 
     virtual Allocator& getAllocator() { return pool_allocator_; }
 
+#if !UAVCAN_TINY
+    virtual IPoolAllocator& getAllocatorFor(MemoryConsumer consumer) { return memory_usage_.get(consumer); }
+
+    virtual const InstrumentedPoolAllocator* getMemoryUsage(MemoryConsumer consumer) const
+    {
+        return &memory_usage_.get(consumer);
+    }
+
+    virtual int setMemoryQuota(MemoryConsumer consumer, uint16_t max_blocks)
+    {
+        memory_usage_.get(consumer).setQuota(max_blocks);
+        return 0;
+    }
+#endif
+
     virtual Scheduler& getScheduler() { return scheduler_; }
     virtual const Scheduler& getScheduler() const { return scheduler_; }
 
@@ -202,6 +227,11 @@ public:
 
     RestartRequestServer& getRestartRequestServer() { return proto_rrs_; }
 
+    /**
+     * The rate estimation of the transport stats provider can be enabled here.
+     */
+    TransportStatsProvider& getTransportStatsProvider() { return proto_tsp_; }
+
     /**
      * Node logging.
      * Logging calls are passed directly into the @ref Logger instance.
@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_PIPELINED_SERVICE_CLIENT_HPP_INCLUDED
+#define UAVCAN_NODE_PIPELINED_SERVICE_CLIENT_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+/**
+ * Result of a request submitted to @ref PipelinedServiceClient.
+ * The references point to the internal storage of the client, which will be reused once the callback returns.
+ */
+template <typename DataType>
+class UAVCAN_EXPORT PipelinedServiceCallResult : Noncopyable
+{
+public:
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+
+    enum Status
+    {
+        Success,
+        ErrorTimeout,           ///< All attempts have timed out
+        ErrorCallFailed         ///< The request could not be sent again after a timeout
+    };
+
+private:
+    const Status status_;
+    const uint8_t num_attempts_;
+    const RequestType& request_;
+    ResponseType& response_;
+
+public:
+    PipelinedServiceCallResult(Status arg_status, uint8_t arg_num_attempts, const RequestType& arg_request,
+                               ResponseType& arg_response)
+        : status_(arg_status)
+        , num_attempts_(arg_num_attempts)
+        , request_(arg_request)
+        , response_(arg_response)
+    { }
+
+    bool isSuccessful() const { return status_ == Success; }
+
+    Status getStatus() const { return status_; }
+
+    /**
+     * Number of times the request has been sent, including the successful attempt.
+     */
+    uint8_t getNumAttempts() const { return num_attempts_; }
+
+    /**
+     * The request as it was submitted, which allows to tell the results apart (e.g. by file offset).
+     */
+    const RequestType& getRequest() const { return request_; }
+
+    /**
+     * Value undefined if the request has failed.
+     */
+    const ResponseType& getResponse() const { return response_; }
+    ResponseType& getResponse() { return response_; }
+};
+
+/**
+ * Keeps a window of outstanding calls to one server, so that the throughput of bulk transfers (like reading
+ * a file with uavcan.protocol.file.Read) is not limited by the round trip time of one call.
+ *
+ * Requests are submitted while the window has free space; the results are delivered via the callback strictly
+ * in the order of submission, regardless of the order the responses arrive in. A timed out request is sent again,
+ * up to the configured number of attempts, before its failure is reported. The callback is allowed to submit
+ * new requests, which is the natural way to keep the window full.
+ *
+ * The calls in flight always have distinct transfer IDs: if issuing the next call would reuse the transfer ID
+ * of a call that is still pending, the next call is postponed until that call completes or times out.
+ * This assumes that no other service client of the same node calls the same service on the same server.
+ *
+ * @tparam DataType_        Service data type.
+ *
+ * @tparam WindowSize_      Maximum number of outstanding calls; not more than 31. Note that every outstanding
+ *                          call stores a copy of the request and the response.
+ *
+ * @tparam Callback_        Results will be delivered through the callback of this type.
+ *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ */
+template <typename DataType_,
+          unsigned WindowSize_ = 4,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const PipelinedServiceCallResult<DataType_>&)>
+#else
+          typename Callback_ = void (*)(const PipelinedServiceCallResult<DataType_>&)
+#endif
+          >
+class UAVCAN_EXPORT PipelinedServiceClient : Noncopyable
+{
+public:
+    typedef DataType_ DataType;
+    typedef typename DataType::Request RequestType;
+    typedef typename DataType::Response ResponseType;
+    typedef PipelinedServiceCallResult<DataType> ResultType;
+    typedef Callback_ Callback;
+
+    enum { WindowSize = WindowSize_ };
+
+private:
+    typedef PipelinedServiceClient<DataType, WindowSize, Callback> SelfType;
+    typedef MethodBinder<SelfType*, void (SelfType::*)(const ServiceCallResult<DataType>&)> ResponseCallback;
+    typedef ServiceClient<DataType, ResponseCallback, WindowSize> ClientType;
+
+    /*
+     * One extra slot holds the result that is being delivered to the application, so that the callback can
+     * fill up the window again.
+     */
+    enum { NumSlots = WindowSize + 1 };
+
+    struct Slot
+    {
+        enum State { Queued, Pending, Done };
+
+        RequestType request;
+        ResponseType response;
+        ServiceCallID call_id;
+        uint32_t issue_index;               ///< Value of the issued calls counter at the time of the last attempt
+        uint8_t num_attempts;
+        State state;
+        typename ResultType::Status status;
+
+        Slot()
+            : issue_index(0)
+            , num_attempts(0)
+            , state(Queued)
+            , status(ResultType::Success)
+        { }
+    };
+
+    Slot slots_[NumSlots];
+    ClientType client_;
+    Callback callback_;
+    NodeID server_node_id_;
+    uint32_t num_calls_issued_;
+    uint8_t head_;
+    uint8_t size_;
+    uint8_t max_attempts_;
+    bool delivering_;
+
+    Slot& getSlot(unsigned position) { return slots_[(head_ + position) % unsigned(NumSlots)]; }
+
+    bool canIssueNextCall();
+
+    int issue(Slot& slot);
+
+    void issueQueued();
+
+    void deliverCompleted();
+
+    void handleResponse(const ServiceCallResult<DataType>& result);
+
+public:
+    /**
+     * @param node      Node instance this client will be registered with.
+     * @param callback  Callback instance. Optional, can be assigned later.
+     */
+    explicit PipelinedServiceClient(INode& node, const Callback& callback = Callback())
+        : client_(node)
+        , callback_(callback)
+        , num_calls_issued_(0)
+        , head_(0)
+        , size_(0)
+        , max_attempts_(3)
+        , delivering_(false)
+    {
+        StaticAssert<(WindowSize > 0) && (WindowSize <= TransferID::Max)>::check();
+        client_.setCallback(ResponseCallback(this, &SelfType::handleResponse));
+    }
+
+    /**
+     * Shall be called before first use. Cancels the outstanding requests, if any.
+     * Returns negative error code.
+     */
+    int init(NodeID server_node_id)
+    {
+        if (!server_node_id.isUnicast())
+        {
+            return -ErrInvalidParam;
+        }
+        cancelAll();
+        server_node_id_ = server_node_id;
+        return client_.init();
+    }
+
+    /**
+     * Sends the request, or queues it if the next call would reuse the transfer ID of a pending call.
+     * Returns negative error code; -ErrLogic if the window is full.
+     */
+    int submit(const RequestType& request);
+
+    /**
+     * Cancels all outstanding requests; the callback will not be invoked for them.
+     */
+    void cancelAll();
+
+    /**
+     * Number of submitted requests whose results have not been delivered yet.
+     */
+    unsigned getNumOutstanding() const { return size_; }
+
+    bool isWindowFull() const { return size_ >= WindowSize; }
+
+    bool isIdle() const { return size_ == 0; }
+
+    NodeID getServerNodeID() const { return server_node_id_; }
+
+    /**
+     * Maximum number of times a request will be sent before its failure is reported. Default is 3.
+     */
+    uint8_t getMaxAttempts() const { return max_attempts_; }
+    void setMaxAttempts(uint8_t num) { max_attempts_ = max(num, static_cast<uint8_t>(1)); }
+
+    /**
+     * Timeout of every attempt, see @ref ServiceClient.
+     */
+    MonotonicDuration getRequestTimeout() const { return client_.getRequestTimeout(); }
+    void setRequestTimeout(MonotonicDuration timeout) { client_.setRequestTimeout(timeout); }
+
+    TransferPriority getPriority() const { return client_.getPriority(); }
+    void setPriority(const TransferPriority prio) { client_.setPriority(prio); }
+
+    const Callback& getCallback() const { return callback_; }
+    void setCallback(const Callback& cb) { callback_ = cb; }
+
+    /**
+     * Returns the number of failed attempts to decode received response, see @ref ServiceClient.
+     */
+    uint32_t getResponseFailureCount() const { return client_.getResponseFailureCount(); }
+};
+
+// ----------------------------------------------------------------------------
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+bool PipelinedServiceClient<DataType_, WindowSize_, Callback_>::canIssueNextCall()
+{
+    /*
+     * Every call gets the next transfer ID, so the transfer ID of a pending call is reused once 32 more
+     * calls have been issued after it.
+     */
+    for (unsigned i = 0; i < size_; i++)
+    {
+        const Slot& slot = getSlot(i);
+        if ((slot.state == Slot::Pending) &&
+            ((num_calls_issued_ - slot.issue_index) > static_cast<uint32_t>(TransferID::Max)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+int PipelinedServiceClient<DataType_, WindowSize_, Callback_>::issue(Slot& slot)
+{
+    const int res = client_.call(server_node_id_, slot.request, slot.call_id);
+    if (res < 0)
+    {
+        UAVCAN_TRACE("PipelinedServiceClient", "Call failed: %i", res);
+        return res;
+    }
+    slot.state = Slot::Pending;
+    slot.issue_index = num_calls_issued_++;
+    slot.num_attempts++;
+    return res;
+}
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+void PipelinedServiceClient<DataType_, WindowSize_, Callback_>::issueQueued()
+{
+    for (unsigned i = 0; i < size_; i++)
+    {
+        Slot& slot = getSlot(i);
+        if (slot.state != Slot::Queued)
+        {
+            continue;
+        }
+        if (!canIssueNextCall())
+        {
+            break;
+        }
+        if (issue(slot) < 0)
+        {
+            slot.state = Slot::Done;
+            slot.status = ResultType::ErrorCallFailed;
+        }
+    }
+    deliverCompleted();
+}
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+void PipelinedServiceClient<DataType_, WindowSize_, Callback_>::deliverCompleted()
+{
+    if (delivering_)
+    {
+        return;         // The outer call will go on delivering
+    }
+    delivering_ = true;
+
+    while ((size_ > 0) && (getSlot(0).state == Slot::Done))
+    {
+        Slot& slot = getSlot(0);
+        head_ = static_cast<uint8_t>((head_ + 1U) % unsigned(NumSlots));
+        size_--;
+
+        ResultType result(slot.status, slot.num_attempts, slot.request, slot.response);
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(result);
+        }
+        else
+        {
+            handleFatalError("Pipelined srv client clbk");
+        }
+    }
+
+    delivering_ = false;
+}
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+void PipelinedServiceClient<DataType_, WindowSize_, Callback_>::handleResponse(
+    const ServiceCallResult<DataType>& result)
+{
+    Slot* slot = NULL;
+    for (unsigned i = 0; i < size_; i++)
+    {
+        Slot& s = getSlot(i);
+        if ((s.state == Slot::Pending) && (s.call_id == result.getCallID()))
+        {
+            slot = &s;
+            break;
+        }
+    }
+    if (slot == NULL)
+    {
+        UAVCAN_ASSERT(0);       // Cancelled calls don't get callbacks
+        return;
+    }
+
+    if (result.isSuccessful())
+    {
+        slot->response = result.getResponse();
+        slot->status = ResultType::Success;
+        slot->state = Slot::Done;
+    }
+    else if (slot->num_attempts < max_attempts_)
+    {
+        UAVCAN_TRACE("PipelinedServiceClient", "Retrying tid=%d, attempt %d",
+                     int(slot->call_id.transfer_id.get()), int(slot->num_attempts));
+        slot->state = Slot::Queued;
+    }
+    else
+    {
+        slot->status = ResultType::ErrorTimeout;
+        slot->state = Slot::Done;
+    }
+
+    issueQueued();
+}
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+int PipelinedServiceClient<DataType_, WindowSize_, Callback_>::submit(const RequestType& request)
+{
+    if (!server_node_id_.isUnicast())
+    {
+        return -ErrNotInited;
+    }
+    if (!coerceOrFallback<bool>(callback_, true))
+    {
+        UAVCAN_TRACE("PipelinedServiceClient", "Invalid callback");
+        return -ErrInvalidConfiguration;
+    }
+    if (isWindowFull())
+    {
+        return -ErrLogic;
+    }
+
+    Slot& slot = getSlot(size_);
+    slot.request = request;
+    slot.response = ResponseType();
+    slot.num_attempts = 0;
+    slot.state = Slot::Queued;
+    slot.status = ResultType::Success;
+
+    /*
+     * The request is sent right away unless there are queued requests before it, which must go first.
+     * If it can't be sent at all, the error is reported to the caller and the request is not accepted.
+     */
+    bool can_issue = true;
+    for (unsigned i = 0; i < size_; i++)
+    {
+        if (getSlot(i).state == Slot::Queued)
+        {
+            can_issue = false;
+            break;
+        }
+    }
+    if (can_issue && canIssueNextCall())
+    {
+        const int res = issue(slot);
+        if (res < 0)
+        {
+            return res;
+        }
+    }
+
+    size_++;
+    return 0;
+}
+
+template <typename DataType_, unsigned WindowSize_, typename Callback_>
+void PipelinedServiceClient<DataType_, WindowSize_, Callback_>::cancelAll()
+{
+    client_.cancelAllCalls();
+    size_ = 0;
+}
+
+}
+
+#endif // UAVCAN_NODE_PIPELINED_SERVICE_CLIENT_HPP_INCLUDED
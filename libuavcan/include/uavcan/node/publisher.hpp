@@ -22,6 +22,8 @@ class UAVCAN_EXPORT Publisher : protected GenericPublisher<DataType_, DataType_>
 public:
     typedef DataType_ DataType; ///< Message data type
 
+    typedef typename BaseType::PreEncodedPayload PreEncodedPayload;
+
     /**
      * @param node          Node instance this publisher will be registered with.
      *
@@ -65,6 +67,16 @@ public:
         return BaseType::publish(message, TransferTypeMessageBroadcast, NodeID::Broadcast, tid);
     }
 
+    /**
+     * Broadcast a message whose contents rarely change, e.g. a static configuration.
+     * The message is encoded only if the payload object is marked dirty, see @ref PreEncodedPayload.
+     * Returns negative error code.
+     */
+    int broadcast(const DataType& message, PreEncodedPayload& payload)
+    {
+        return BaseType::publish(message, payload, TransferTypeMessageBroadcast, NodeID::Broadcast);
+    }
+
     static MonotonicDuration getDefaultTxTimeout() { return MonotonicDuration::fromMSec(10); }
 
     /**
@@ -79,8 +91,15 @@ public:
     using BaseType::getMaxTxTimeout;
     using BaseType::getTxTimeout;
     using BaseType::setTxTimeout;
+    using BaseType::isLatestValueOnly;
+    using BaseType::setLatestValueOnly;
     using BaseType::getPriority;
     using BaseType::setPriority;
+#if !UAVCAN_TINY
+    using BaseType::setRateLimit;
+    using BaseType::setPublishOnChange;
+    using BaseType::isPublishOnChange;
+#endif
     using BaseType::getNode;
 };
 
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_SAMPLE_BUFFER_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_SAMPLE_BUFFER_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+
+/**
+ * Full memory barrier: neither the compiler nor the CPU may move memory accesses across it.
+ * The default is the GCC builtin, which is also supported by Clang; on single-core microcontrollers a compiler
+ * barrier would be sufficient, but the builtin is cheap there anyway. Other compilers must define the macro.
+ */
+#ifndef UAVCAN_MEMORY_BARRIER
+# if defined(__GNUC__)
+#  define UAVCAN_MEMORY_BARRIER()   __sync_synchronize()
+# else
+#  error "UAVCAN_MEMORY_BARRIER() is not defined for this compiler"
+# endif
+#endif
+
+namespace uavcan
+{
+/**
+ * Same as @ref Subscriber<>, except that instead of invoking a callback it stores the received messages into a
+ * preallocated ring buffer of the last Depth_ samples, which the application polls at its own rate, e.g. from a
+ * fixed-rate control loop. With Depth_ = 1 it works as a latest-value slot.
+ *
+ * The messages are decoded by the thread that spins the node directly into the buffer. The read methods can be
+ * called from any thread or task concurrently with the spinning, without locks and without involving the scheduler:
+ * every slot carries the number of the sample it holds and a validity flag, which the reader checks before and after
+ * copying the sample out, so a sample that has been overwritten meanwhile is never returned torn.
+ * The buffer has one slot more than Depth_, which is where the next message is decoded, so that the latest samples
+ * stay readable while it is being received and are not lost if it fails to decode.
+ *
+ * Requirements: only one thread spins the node; 32-bit loads and stores are atomic; @ref UAVCAN_MEMORY_BARRIER()
+ * is defined for the compiler.
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam Depth_           Number of the latest samples available to the reader.
+ *
+ * Refer to @ref Subscriber<> for the other template arguments.
+ */
+template <typename DataType_,
+          unsigned Depth_ = 1,
+#if UAVCAN_TINY
+          unsigned NumStaticReceivers = 0,
+          unsigned NumStaticBufs = 0,
+#else
+          unsigned NumStaticReceivers = 2,
+          unsigned NumStaticBufs = 1,
+#endif
+          template <unsigned, unsigned, unsigned> class TransferListenerTemplate_ = TransferListener
+          >
+class UAVCAN_EXPORT SampleBufferSubscriber
+    : public GenericSubscriber<DataType_, DataType_,
+                               typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers,
+                                                                            NumStaticBufs,
+                                                                            TransferListenerTemplate_>::Type>
+{
+public:
+    typedef DataType_ DataType;
+
+    enum { Depth = Depth_ };
+
+    /**
+     * Received message along with the transport layer information.
+     */
+    struct Sample
+    {
+        DataType message;
+        MonotonicTime monotonic_timestamp;
+        UtcTime utc_timestamp;
+        NodeID src_node_id;
+    };
+
+private:
+    typedef typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers, NumStaticBufs,
+                                                         TransferListenerTemplate_>::Type TransferListenerType;
+    typedef GenericSubscriber<DataType_, DataType_, TransferListenerType> BaseType;
+
+    enum { NumSlots = Depth_ + 1 };
+
+    struct Slot
+    {
+        Sample sample;
+        volatile uint32_t number;   ///< Number of the sample, valid only if the flag is set
+        volatile bool valid;        ///< Cleared while the sample is being written
+
+        Slot()
+            : number(0)
+            , valid(false)
+        { }
+    };
+
+    Slot slots_[NumSlots];
+    volatile uint32_t num_received_;        ///< Also the number of the latest sample; modified by the writer only
+
+    virtual void handleIncomingTransfer(IncomingTransfer& transfer)
+    {
+        const uint32_t number = num_received_ + 1U;
+        Slot& slot = slots_[number % NumSlots];     // Not readable, it is out of the window of the latest samples
+
+        slot.valid = false;
+        UAVCAN_MEMORY_BARRIER();
+        slot.number = number;
+
+        BitStream bitstream(transfer);
+        ScalarCodec codec(bitstream);
+        const int decode_res = DataType::decode(slot.sample.message, codec,
+                                                transfer.isCanFD() ? TailArrayOptDisabled : TailArrayOptEnabled);
+        if (decode_res <= 0)
+        {
+            UAVCAN_TRACE("SampleBufferSubscriber", "Unable to decode the message [%i] [%s]",
+                         decode_res, DataType::getDataTypeFullName());
+            BaseType::registerDecodingFailure(BaseType::getTransferListener());
+            return;                                 // The slot stays invalid, the latest samples are intact
+        }
+        slot.sample.monotonic_timestamp = transfer.getMonotonicTimestamp();
+        slot.sample.utc_timestamp       = transfer.getUtcTimestamp();
+        slot.sample.src_node_id         = transfer.getSrcNodeID();
+
+        UAVCAN_MEMORY_BARRIER();
+        slot.valid = true;
+        UAVCAN_MEMORY_BARRIER();
+        num_received_ = number;
+    }
+
+    /// Never invoked, since the transfers are decoded directly into the buffer
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<DataType_>&) { }
+
+public:
+    explicit SampleBufferSubscriber(INode& node)
+        : BaseType(node)
+        , num_received_(0)
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+        StaticAssert<(Depth_ > 0)>::check();
+    }
+
+    /**
+     * Begin receiving messages. The samples received before are kept.
+     * Returns negative error code.
+     */
+    int start()
+    {
+        BaseType::stop();
+        return BaseType::startAsMessageListener();
+    }
+
+    /**
+     * Any thread. Number of the messages received so far, which is also the number of the latest sample;
+     * the first sample is number 1. The counter wraps around.
+     * A polling consumer can remember the number of the last sample it has processed and read the ones after it
+     * with @ref readSample(), which also tells it if it has fallen behind by more than Depth samples.
+     */
+    uint32_t getNumReceived() const { return num_received_; }
+
+    /**
+     * Any thread. Copies out the sample with the specified number.
+     * @return False if the sample has not been received yet or is no longer in the buffer.
+     */
+    bool readSample(uint32_t number, Sample& out_sample) const
+    {
+        if (uint32_t(num_received_ - number) >= uint32_t(Depth_))
+        {
+            return false;
+        }
+        const Slot& slot = slots_[number % NumSlots];
+        if (!slot.valid || (slot.number != number))
+        {
+            return false;
+        }
+        UAVCAN_MEMORY_BARRIER();
+        out_sample = slot.sample;
+        UAVCAN_MEMORY_BARRIER();
+        return slot.valid && (slot.number == number);
+    }
+
+    /**
+     * Any thread. Copies out the latest sample.
+     * @return False if nothing has been received yet.
+     */
+    bool readLatest(Sample& out_sample) const
+    {
+        while (true)
+        {
+            const uint32_t number = num_received_;
+            if (readSample(number, out_sample))
+            {
+                return true;
+            }
+            if (num_received_ == number)
+            {
+                return false;       // The latest sample can only be overwritten after Depth newer ones arrived
+            }
+        }
+    }
+
+    /**
+     * Any thread. Copies out up to max_samples latest samples, the newest first.
+     * @return Number of the samples copied out.
+     */
+    unsigned readLatest(Sample* out_samples, unsigned max_samples) const
+    {
+        if (out_samples == NULL)
+        {
+            return 0;
+        }
+        const uint32_t latest = num_received_;
+        unsigned num_read = 0;
+        while ((num_read < max_samples) && (num_read < unsigned(Depth_)) &&
+               readSample(latest - num_read, out_samples[num_read]))
+        {
+            num_read++;
+        }
+        return num_read;
+    }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::setTransferPrefilter;
+    using BaseType::setEarliestArrivalMode;
+    using BaseType::setReceiverRetention;
+    using BaseType::stop;
+    using BaseType::getFailureCount;
+};
+
+}
+
+#endif // UAVCAN_NODE_SAMPLE_BUFFER_SUBSCRIBER_HPP_INCLUDED
@@ -14,15 +14,40 @@ namespace uavcan
 
 class UAVCAN_EXPORT Scheduler;
 
-class UAVCAN_EXPORT DeadlineHandler : public LinkedListNode<DeadlineHandler>, Noncopyable
+class UAVCAN_EXPORT DeadlineHandler
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+    : public LinkedListNode<DeadlineHandler>
+#else
+    : public FastRemovalLinkedList<DeadlineHandler>::Node
+#endif
+    , Noncopyable
 {
     MonotonicTime deadline_;
 
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+    friend class DeadlineScheduler;
+
+    /*
+     * Pairing heap links. The list node link is used as the next sibling link.
+     * The previous link points either to the previous sibling or to the parent if this is the first child.
+     */
+    DeadlineHandler* heap_child_;
+    DeadlineHandler* heap_prev_;
+    uint32_t heap_seq_;         ///< Handlers with equal deadlines are processed in the order of registration
+#endif
+
 protected:
     Scheduler& scheduler_;
 
     explicit DeadlineHandler(Scheduler& scheduler)
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+        : heap_child_(NULL)
+        , heap_prev_(NULL)
+        , heap_seq_(0)
+        , scheduler_(scheduler)
+#else
         : scheduler_(scheduler)
+#endif
     { }
 
     virtual ~DeadlineHandler() { stop(); }
@@ -32,7 +57,11 @@ public:
 
     void startWithDeadline(MonotonicTime deadline);
     void startWithDelay(MonotonicDuration delay);
+#if UAVCAN_COMPACT_MONOTONIC_TIME
+    void generateDeadlineImmediately() { startWithDelay(MonotonicDuration()); }  // Wrapping time has no fixed past
+#else
     void generateDeadlineImmediately() { startWithDeadline(MonotonicTime::fromUSec(1)); }
+#endif
 
     void stop();
 
@@ -43,18 +72,104 @@ public:
 };
 
 
+/**
+ * Keeps the running deadline handlers ordered by deadline.
+ * Refer to UAVCAN_DEADLINE_SCHEDULER_HEAP for the available implementations.
+ */
 class UAVCAN_EXPORT DeadlineScheduler : Noncopyable
 {
-    LinkedListRoot<DeadlineHandler> handlers_;  // Ordered by deadline, lowest first
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+    DeadlineHandler* heap_root_;                // Earliest deadline
+    unsigned num_handlers_;
+    uint32_t next_seq_;
+
+    static bool isEarlier(const DeadlineHandler* a, const DeadlineHandler* b);
+    static DeadlineHandler* meld(DeadlineHandler* a, DeadlineHandler* b);
+    static DeadlineHandler* mergePairs(DeadlineHandler* first);
+
+    DeadlineHandler* getEarliest() const { return heap_root_; }
+#else
+    FastRemovalLinkedList<DeadlineHandler>::Root handlers_;     // Ordered by deadline, lowest first
+
+    DeadlineHandler* getEarliest() const { return handlers_.get(); }
+#endif
 
 public:
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+    DeadlineScheduler()
+        : heap_root_(NULL)
+        , num_handlers_(0)
+        , next_seq_(0)
+    { }
+#endif
+
     void add(DeadlineHandler* mdh);
     void remove(DeadlineHandler* mdh);
     bool doesExist(const DeadlineHandler* mdh) const;
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+    unsigned getNumHandlers() const { return num_handlers_; }
+#else
     unsigned getNumHandlers() const { return handlers_.getLength(); }
+#endif
 
-    MonotonicTime pollAndGetMonotonicTime(ISystemClock& sysclock);
+    /**
+     * Runs the expired handlers. If the counter is provided, the execution time of every handler is added to it;
+     * this doesn't cost any extra clock reads. Likewise, the lateness counter receives the difference between
+     * the real and the scheduled time of every handler.
+     * If max_handlers is not zero, at most this number of handlers will be run; the rest stays expired.
+     */
+    MonotonicTime pollAndGetMonotonicTime(ISystemClock& sysclock, ExecutionTimeCounter* callback_time_counter = NULL,
+                                          ExecutionTimeCounter* lateness_counter = NULL, unsigned max_handlers = 0);
+    /**
+     * Returns the deadline of the earliest handler. If there are no handlers, the result is MonotonicTime::getMax();
+     * with UAVCAN_COMPACT_MONOTONIC_TIME there's no such value, so isEmpty() must be checked first.
+     */
     MonotonicTime getEarliestDeadline() const;
+
+    bool isEmpty() const { return getEarliest() == NULL; }
+};
+
+/**
+ * Where the scheduler has spent its time; refer to @ref Scheduler::setLoadStatsEnabled().
+ * Everything that is not accounted as frame handling, deadline handling or cleanup is considered idle time:
+ * waiting for IO events, as well as the CAN driver calls made by the library outside of the callbacks.
+ */
+struct UAVCAN_EXPORT SchedulerLoadStats
+{
+    MonotonicDuration total_time;               ///< Time spent inside spin() and spinOnce()
+    ExecutionTimeCounter frame_handling;        ///< Per batch of received frames, including the transfer callbacks
+    ExecutionTimeCounter deadline_handling;     ///< Per deadline callback, e.g. timer event
+    ExecutionTimeCounter cleanup;
+    ExecutionTimeCounter deadline_lateness;     ///< How late every deadline callback was invoked; not busy time
+
+    MonotonicDuration getBusyTime() const
+    {
+        return min(frame_handling.getTotal() + deadline_handling.getTotal() + cleanup.getTotal(), total_time);
+    }
+
+    MonotonicDuration getIdleTime() const { return total_time - getBusyTime(); }
+
+    /**
+     * Longest callback - either a batch of received frames or a deadline callback.
+     */
+    MonotonicDuration getPeakCallbackTime() const
+    {
+        return max(frame_handling.getPeak(), deadline_handling.getPeak());
+    }
+
+    /**
+     * Busy time in percent of the total time, [0, 100]. Zero if nothing has been measured yet.
+     */
+    uint8_t getUtilizationPercent() const { return computeUtilizationPercent(getBusyTime(), total_time); }
+
+    static uint8_t computeUtilizationPercent(MonotonicDuration busy, MonotonicDuration total)
+    {
+        if (!total.isPositive() || busy.isNegative())
+        {
+            return 0;
+        }
+        return uint8_t((min(busy, total).toUSec() * 100 + total.toUSec() / 2) / total.toUSec());
+    }
 };
 
 /**
@@ -75,7 +190,13 @@ class UAVCAN_EXPORT Scheduler : Noncopyable
     MonotonicTime prev_cleanup_ts_;
     MonotonicDuration deadline_resolution_;
     MonotonicDuration cleanup_period_;
+    SchedulerLoadStats load_stats_;
+    unsigned cleanup_budget_;
+    unsigned rx_frame_budget_;
     bool inside_spin_;
+    bool tickless_;
+    bool load_stats_enabled_;
+    bool cleanup_in_progress_;
 
     struct InsideSpinSetter
     {
@@ -89,15 +210,33 @@ class UAVCAN_EXPORT Scheduler : Noncopyable
     };
 
     MonotonicTime computeDispatcherSpinDeadline(MonotonicTime spin_deadline) const;
+    int pollDeadlines(MonotonicTime& out_ts);
     void pollCleanup(MonotonicTime mono_ts, uint32_t num_frames_processed_with_last_spin);
 
+    ExecutionTimeCounter* getDeadlineTimeCounter()
+    {
+        return load_stats_enabled_ ? &load_stats_.deadline_handling : NULL;
+    }
+
+    ExecutionTimeCounter* getDeadlineLatenessCounter()
+    {
+        return load_stats_enabled_ ? &load_stats_.deadline_lateness : NULL;
+    }
+
+    void registerSpinTime(MonotonicTime started_at);
+
 public:
     Scheduler(ICanDriver& can_driver, IPoolAllocator& allocator, ISystemClock& sysclock, IOutgoingTransferRegistry& otr)
         : dispatcher_(can_driver, allocator, sysclock, otr)
         , prev_cleanup_ts_(sysclock.getMonotonic())
         , deadline_resolution_(MonotonicDuration::fromMSec(DefaultDeadlineResolutionMs))
         , cleanup_period_(MonotonicDuration::fromMSec(DefaultCleanupPeriodMs))
+        , cleanup_budget_(0)
+        , rx_frame_budget_(0)
         , inside_spin_(false)
+        , tickless_(false)
+        , load_stats_enabled_(false)
+        , cleanup_in_progress_(false)
     { }
 
     /**
@@ -114,12 +253,25 @@ public:
      */
     int spinOnce();
 
+    /**
+     * Single iteration of a super-loop: processes up to max_frames received frames (refer to
+     * @ref Dispatcher::spinBudget()), then the expired deadline handlers and the cleanup, and returns.
+     * The deadline limits only the wait for the first frame; zero deadline means that the call never blocks.
+     * Returns the number of processed frames, or negative error code.
+     */
+    int spinBudget(unsigned max_frames, MonotonicTime deadline = MonotonicTime());
+
     DeadlineScheduler& getDeadlineScheduler() { return deadline_scheduler_; }
 
     Dispatcher& getDispatcher()             { return dispatcher_; }
     const Dispatcher& getDispatcher() const { return dispatcher_; }
 
     ISystemClock& getSystemClock()         { return dispatcher_.getSystemClock(); }
+
+    /**
+     * Always reads the clock. The TX path uses the timestamp cached once per spin iteration instead,
+     * refer to @ref Dispatcher::getMonotonicTime().
+     */
     MonotonicTime getMonotonicTime() const { return dispatcher_.getSystemClock().getMonotonic(); }
     UtcTime getUtcTime()             const { return dispatcher_.getSystemClock().getUtc(); }
 
@@ -135,6 +287,42 @@ public:
         deadline_resolution_ = res;
     }
 
+    /**
+     * In tickless mode the scheduler does not wake up periodically. Instead, it blocks until the earliest
+     * deadline handler, the next cleanup, or the next CAN IO event, and recomputes the wait time after every batch
+     * of received frames, so deadline handlers started from frame handlers are never late.
+     * The deadline resolution setting has no effect in this mode. Disabled by default.
+     * This is recommended for low-power nodes, where idle wakeups must be avoided.
+     */
+    bool isTickless() const { return tickless_; }
+    void setTickless(bool tickless) { tickless_ = tickless; }
+
+    /**
+     * RX priority policy. By default it's disabled, and all expired deadline handlers are run at once, so that
+     * a series of heavy callbacks, e.g. timers, may delay the reception long enough to overflow the RX queue
+     * of the driver. If a non-zero frame budget is set, the expired handlers are run one at a time, and before
+     * every next one the scheduler processes up to this number of pending received frames.
+     * The lateness of the deadline handlers is reported via @ref SchedulerLoadStats::deadline_lateness.
+     */
+    unsigned getRxFrameBudget() const { return rx_frame_budget_; }
+    void setRxFrameBudget(unsigned max_frames) { rx_frame_budget_ = max_frames; }
+
+    /**
+     * Load statistics allow to find out how busy the node is, see @ref SchedulerLoadStats.
+     * Disabled by default, because they cost a few clock reads per spin and per batch of received frames.
+     * The statistics are accumulated until reset; the application can compute the load over a period of time
+     * by resetting them periodically, or by keeping the previous values.
+     */
+    bool isLoadStatsEnabled() const { return load_stats_enabled_; }
+    void setLoadStatsEnabled(bool enabled)
+    {
+        load_stats_enabled_ = enabled;
+        dispatcher_.setFrameHandlingTimeCounter(enabled ? &load_stats_.frame_handling : NULL);
+    }
+
+    const SchedulerLoadStats& getLoadStats() const { return load_stats_; }
+    void resetLoadStats() { load_stats_ = SchedulerLoadStats(); }
+
     /**
      * How often the scheduler will run cleanup (listeners, outgoing transfer registry, ...).
      * Cleanup execution time grows linearly with number of listeners and number of items
@@ -148,6 +336,21 @@ public:
         period = max(period, MonotonicDuration::fromMSec(MinCleanupPeriodMs));
         cleanup_period_ = period;
     }
+
+    /**
+     * Maximum number of transfer listeners the scheduler will clean up per spin iteration.
+     * By default it's zero, meaning that the whole cleanup is performed at once, which may take a while on nodes
+     * with many listeners and receivers. If the limit is set, every cleanup is spread over several spin iterations
+     * (refer to @ref Dispatcher::cleanupIncrementally()), which keeps the worst case spin latency flat.
+     * The cleanup period is measured from the beginning of the previous cleanup.
+     */
+    unsigned getCleanupBudget() const { return cleanup_budget_; }
+    void setCleanupBudget(unsigned max_listeners_per_spin) { cleanup_budget_ = max_listeners_per_spin; }
+
+    /**
+     * Whether the scheduler is in the middle of an incremental cleanup, see @ref setCleanupBudget().
+     */
+    bool isCleanupInProgress() const { return cleanup_in_progress_; }
 };
 
 }
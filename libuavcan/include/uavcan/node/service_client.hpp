@@ -6,7 +6,7 @@
 #define UAVCAN_NODE_SERVICE_CLIENT_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
-#include <uavcan/util/multiset.hpp>
+#include <uavcan/util/linked_list.hpp>
 #include <uavcan/node/generic_publisher.hpp>
 #include <uavcan/node/generic_subscriber.hpp>
 
@@ -131,49 +131,83 @@ class ServiceClientBase : protected ITransferAcceptanceFilter
     const DataTypeDescriptor* data_type_descriptor_;  ///< This will be initialized at the time of first call
 
 protected:
-    class CallState : DeadlineHandler
+    /**
+     * Pending call. The timeouts of all pending calls are handled by the single deadline handler of the client.
+     */
+    struct CallState : LinkedListNode<CallState>
     {
-        ServiceClientBase& owner_;
-        const ServiceCallID id_;
-        bool timed_out_;
+        MonotonicTime deadline;
+        CallState* prev_by_deadline;
+        CallState* next_by_deadline;
+        ServiceCallID id;
+
+        CallState()
+            : prev_by_deadline(NULL)
+            , next_by_deadline(NULL)
+        { }
+    };
 
-        virtual void handleDeadline(MonotonicTime);
+    /**
+     * Pending calls are kept in hash buckets keyed by server node ID, and in a list sorted by deadline.
+     * Hence matching of the response frames is O(1) of the number of pending calls (unless there are many
+     * calls to the same server), and so is the expiration of timed out calls.
+     * Entries are taken from the static storage of the client first, then from the pool, one block per entry.
+     * Refer to UAVCAN_SERVICE_CLIENT_CALL_INDEX_SIZE.
+     */
+    class CallRegistry : ::uavcan::Noncopyable
+    {
+        LinkedListRoot<CallState> buckets_[ServiceClientCallIndexSize];
+        LinkedListRoot<CallState> free_static_entries_;
+        const CallState* const static_entries_;
+        const unsigned num_static_entries_;
+        IPoolAllocator& allocator_;
+        CallState* earliest_;
+        CallState* latest_;
+        unsigned size_;
+
+        static unsigned computeBucketIndex(NodeID server_node_id)
+        {
+            return unsigned(server_node_id.get()) & (ServiceClientCallIndexSize - 1U);
+        }
 
-    public:
-        CallState(INode& node, ServiceClientBase& owner, ServiceCallID call_id)
-            : DeadlineHandler(node.getScheduler())
-            , owner_(owner)
-            , id_(call_id)
-            , timed_out_(false)
+        bool isStatic(const CallState* cs) const
         {
-            UAVCAN_ASSERT(id_.isValid());
-            DeadlineHandler::startWithDelay(owner_.request_timeout_);
+            return (cs >= static_entries_) && (cs < (static_entries_ + num_static_entries_));
         }
 
-        ServiceCallID getCallID() const { return id_; }
+        void insertByDeadline(CallState* cs);
 
-        bool hasTimedOut() const { return timed_out_; }
+    public:
+        CallRegistry(IPoolAllocator& allocator, CallState* static_entries, unsigned num_static_entries);
 
-        static bool hasTimedOutPredicate(const CallState& cs) { return cs.hasTimedOut(); }
+        ~CallRegistry() { clear(); }
 
-        bool operator==(const CallState& rhs) const
-        {
-            return (&owner_ == &rhs.owner_) && (id_ == rhs.id_);
-        }
-    };
+        /**
+         * Returns NULL if out of memory.
+         */
+        CallState* add(ServiceCallID id, MonotonicTime deadline);
 
-    struct CallStateMatchingPredicate
-    {
-        const ServiceCallID id;
-        CallStateMatchingPredicate(ServiceCallID reference) : id(reference) { }
-        bool operator()(const CallState& state) const { return (state.getCallID() == id) && !state.hasTimedOut(); }
-    };
+        void remove(CallState* cs);
 
-    struct ServerSearchPredicate
-    {
-        const NodeID server_node_id;
-        ServerSearchPredicate(NodeID nid) : server_node_id(nid) { }
-        bool operator()(const CallState& state) const { return state.getCallID().server_node_id == server_node_id; }
+        void clear();
+
+        /**
+         * If there are several pending calls with the same ID, the oldest one will be returned.
+         */
+        CallState* find(ServiceCallID id) const;
+
+        bool hasCallToServer(NodeID server_node_id) const;
+
+        /**
+         * Pending calls are indexed in the order of their deadlines.
+         */
+        const CallState* getByIndex(unsigned index) const;
+
+        CallState* getEarliest() const { return earliest_; }
+
+        unsigned getSize() const { return size_; }
+
+        bool isEmpty() const { return size_ == 0; }
     };
 
     MonotonicDuration request_timeout_;
@@ -202,7 +236,8 @@ public:
  * Use this class to invoke services on remote nodes.
  *
  * This class can manage multiple concurrent calls to the same or different remote servers. Number of concurrent
- * calls is limited only by amount of available pool memory.
+ * calls is limited only by amount of available pool memory. The client registers only one deadline handler with
+ * the scheduler, for the earliest timeout, so the load on the scheduler does not grow with the number of calls.
  *
  * Note that the reference passed to the callback points to a stack-allocated object, which means that the
  * reference invalidates once the callback returns. If you want to use this object after the callback execution,
@@ -253,32 +288,7 @@ private:
             TransferListenerType;
     typedef GenericSubscriber<DataType, ResponseType, TransferListenerType> SubscriberType;
 
-    typedef Multiset<CallState, NumStaticCalls> CallRegistry;
-
-    struct TimeoutCallbackCaller
-    {
-        ServiceClient& owner;
-
-        TimeoutCallbackCaller(ServiceClient& arg_owner) : owner(arg_owner) { }
-
-        void operator()(const CallState& state)
-        {
-            if (state.hasTimedOut())
-            {
-                UAVCAN_TRACE("ServiceClient::TimeoutCallbackCaller", "Timeout from nid=%d, tid=%d, dtname=%s",
-                             int(state.getCallID().server_node_id.get()), int(state.getCallID().transfer_id.get()),
-                             DataType::getDataTypeFullName());
-
-                typename SubscriberType::ReceivedDataStructureSpec rx_struct; // Default-initialized
-
-                ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, state.getCallID(),
-                                             rx_struct);    // Mutable!
-
-                owner.invokeCallback(result);
-            }
-        }
-    };
-
+    CallState static_calls_[NumStaticCalls + 1];          // One extra to avoid zero-length arrays
     CallRegistry call_registry_;
 
     PublisherType publisher_;
@@ -294,6 +304,8 @@ private:
 
     int addCallState(ServiceCallID call_id);
 
+    void stopIfIdle();
+
 public:
     /**
      * @param node      Node instance this client will be registered with.
@@ -302,7 +314,7 @@ public:
     explicit ServiceClient(INode& node, const Callback& callback = Callback())
         : SubscriberType(node)
         , ServiceClientBase(node)
-        , call_registry_(node.getAllocator())
+        , call_registry_(node.getAllocatorFor(MemoryConsumerServiceCalls), static_calls_, NumStaticCalls)
         , publisher_(node, getDefaultRequestTimeout())
         , callback_(callback)
     {
@@ -380,7 +392,7 @@ public:
     void setCallback(const Callback& cb) { callback_ = cb; }
 
     /**
-     * Complexity is O(N) of number of pending calls.
+     * Complexity is O(1).
      * Note that the number of pending calls will not be updated until the callback is executed.
      */
     unsigned getNumPendingCalls() const { return call_registry_.getSize(); }
@@ -420,6 +432,15 @@ public:
      */
     TransferPriority getPriority() const { return publisher_.getPriority(); }
     void setPriority(const TransferPriority prio) { publisher_.setPriority(prio); }
+
+    /**
+     * Send the requests in CAN FD frames; the server is supposed to respond in the same format.
+     * Refer to TransferSender::setCanFD(). Always disabled if CAN FD is not supported.
+     */
+#if UAVCAN_SUPPORT_CANFD
+    void setCanFD(bool enabled) { publisher_.setCanFD(enabled); }
+#endif
+    bool isCanFD() const { return publisher_.isCanFD(); }
 };
 
 // ----------------------------------------------------------------------------
@@ -442,9 +463,7 @@ bool ServiceClient<DataType_, Callback_, NumStaticCalls_>::shouldAcceptFrame(con
 {
     UAVCAN_ASSERT(frame.getTransferType() == TransferTypeServiceResponse); // Other types filtered out by dispatcher
 
-    return NULL != call_registry_.find(CallStateMatchingPredicate(ServiceCallID(frame.getSrcNodeID(),
-                                                                                frame.getTransferID())));
-
+    return NULL != call_registry_.find(ServiceCallID(frame.getSrcNodeID(), frame.getTransferID()));
 }
 
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
@@ -461,26 +480,40 @@ handleReceivedDataStruct(ReceivedDataStructure<ResponseType>& response)
 
 
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
-void ServiceClient<DataType_, Callback_, NumStaticCalls_>::handleDeadline(MonotonicTime)
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::handleDeadline(MonotonicTime current)
 {
-    UAVCAN_TRACE("ServiceClient", "Shared deadline event received");
     /*
-     * Invoking callbacks for timed out call state objects.
+     * The call state is released before its callback is invoked, so the callback is free to make new calls or
+     * cancel the pending ones. The registry is consulted again on every iteration for the same reason.
      */
-    TimeoutCallbackCaller callback_caller(*this);
-    call_registry_.template forEach<TimeoutCallbackCaller&>(callback_caller);
-    /*
-     * Removing timed out objects.
-     * This operation cannot be merged with the previous one because that will not work with recursive calls.
-     */
-    call_registry_.removeAllWhere(&CallState::hasTimedOutPredicate);
-    /*
-     * Subscriber does not need to be registered if we don't have any pending calls.
-     * Removing it makes processing of incoming frames a bit faster.
-     */
-    if (call_registry_.isEmpty())
+    while (CallState* const state = call_registry_.getEarliest())
     {
-        SubscriberType::stop();
+        if (state->deadline > current)
+        {
+            break;
+        }
+
+        const ServiceCallID call_id = state->id;
+        call_registry_.remove(state);
+
+        UAVCAN_TRACE("ServiceClient", "Timeout from nid=%d, tid=%d, dtname=%s",
+                     int(call_id.server_node_id.get()), int(call_id.transfer_id.get()),
+                     DataType::getDataTypeFullName());
+
+        typename SubscriberType::ReceivedDataStructureSpec rx_struct; // Default-initialized
+
+        ServiceCallResultType result(ServiceCallResultType::ErrorTimeout, call_id, rx_struct);    // Mutable!
+
+        invokeCallback(result);
+    }
+
+    if (const CallState* const earliest = call_registry_.getEarliest())
+    {
+        DeadlineHandler::startWithDeadline(earliest->deadline);
+    }
+    else
+    {
+        stopIfIdle();
     }
 }
 
@@ -497,16 +530,40 @@ int ServiceClient<DataType_, Callback_, NumStaticCalls_>::addCallState(ServiceCa
         }
     }
 
-    if (NULL == call_registry_.template emplace<INode&, ServiceClientBase&, ServiceCallID>(SubscriberType::getNode(),
-                                                                                           *this, call_id))
+    const CallState* const state =
+        call_registry_.add(call_id, SubscriberType::getNode().getDispatcher().getMonotonicTime() + request_timeout_);
+    if (state == NULL)
     {
-        SubscriberType::stop();
+        stopIfIdle();
         return -ErrMemory;
     }
 
+    /*
+     * The deadline handler is kept at the earliest deadline; it will be rescheduled when it fires
+     * if the earliest call was removed in the meantime.
+     */
+    if (state == call_registry_.getEarliest())
+    {
+        DeadlineHandler::startWithDeadline(state->deadline);
+    }
+
     return 0;
 }
 
+template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
+void ServiceClient<DataType_, Callback_, NumStaticCalls_>::stopIfIdle()
+{
+    /*
+     * Subscriber does not need to be registered if we don't have any pending calls.
+     * Removing it makes processing of incoming frames a bit faster.
+     */
+    if (call_registry_.isEmpty())
+    {
+        SubscriberType::stop();
+        DeadlineHandler::stop();
+    }
+}
+
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
 int ServiceClient<DataType_, Callback_, NumStaticCalls_>::call(NodeID server_node_id, const RequestType& request)
 {
@@ -576,31 +633,32 @@ int ServiceClient<DataType_, Callback_, NumStaticCalls_>::call(NodeID server_nod
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
 void ServiceClient<DataType_, Callback_, NumStaticCalls_>::cancelCall(ServiceCallID call_id)
 {
-    call_registry_.removeFirstWhere(CallStateMatchingPredicate(call_id));
-    if (call_registry_.isEmpty())
+    CallState* const state = call_registry_.find(call_id);
+    if (state != NULL)
     {
-        SubscriberType::stop();
+        call_registry_.remove(state);
     }
+    stopIfIdle();
 }
 
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
 void ServiceClient<DataType_, Callback_, NumStaticCalls_>::cancelAllCalls()
 {
     call_registry_.clear();
-    SubscriberType::stop();
+    stopIfIdle();
 }
 
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
 bool ServiceClient<DataType_, Callback_, NumStaticCalls_>::hasPendingCallToServer(NodeID server_node_id) const
 {
-    return NULL != call_registry_.find(ServerSearchPredicate(server_node_id));
+    return call_registry_.hasCallToServer(server_node_id);
 }
 
 template <typename DataType_, typename Callback_, unsigned NumStaticCalls_>
 ServiceCallID ServiceClient<DataType_, Callback_, NumStaticCalls_>::getCallIDByIndex(unsigned index) const
 {
-    const CallState* const id = call_registry_.getByIndex(index);
-    return (id == NULL) ? ServiceCallID() : id->getCallID();
+    const CallState* const state = call_registry_.getByIndex(index);
+    return (state == NULL) ? ServiceCallID() : state->id;
 }
 
 }
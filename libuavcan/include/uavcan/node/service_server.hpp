@@ -19,6 +19,40 @@
 
 namespace uavcan
 {
+/**
+ * Everything the server needs to respond to a service request after the server callback has returned.
+ * Obtained via @ref ServiceResponseDataStructure::deferResponse(); see @ref ServiceServer::respond().
+ */
+struct UAVCAN_EXPORT ServiceReplyContext
+{
+    NodeID client_node_id;
+    TransferID transfer_id;
+    TransferPriority priority;
+#if UAVCAN_SUPPORT_CANFD
+    bool canfd;                 ///< The response is sent in the same frame format as the request
+#endif
+
+    ServiceReplyContext()
+#if UAVCAN_SUPPORT_CANFD
+        : canfd(false)
+#endif
+    { }
+
+    ServiceReplyContext(NodeID arg_client_node_id, TransferID arg_transfer_id, TransferPriority arg_priority)
+        : client_node_id(arg_client_node_id)
+        , transfer_id(arg_transfer_id)
+        , priority(arg_priority)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd(false)
+#endif
+    { }
+
+    /**
+     * Default constructed context is invalid; a valid context always refers to a unicast client.
+     */
+    bool isValid() const { return client_node_id.isUnicast() && priority.isValid(); }
+};
+
 /**
  * This type can be used in place of the response type in a service server callback to get more advanced control
  * of service request processing.
@@ -40,6 +74,7 @@ template <typename ResponseDataType_>
 class ServiceResponseDataStructure : public ResponseDataType_
 {
     // Fields are weirdly named to avoid name clashing with the inherited data type
+    ServiceReplyContext _reply_context_;
     bool _enabled_;
 
 public:
@@ -49,6 +84,11 @@ public:
         : _enabled_(true)
     { }
 
+    explicit ServiceResponseDataStructure(const ServiceReplyContext& reply_context)
+        : _reply_context_(reply_context)
+        , _enabled_(true)
+    { }
+
     /**
      * When disabled, the server will not transmit the response transfer.
      * By default it is enabled, i.e. response will be sent.
@@ -59,6 +99,23 @@ public:
      * Whether the response will be sent. By default it will.
      */
     bool isResponseEnabled() const { return _enabled_; }
+
+    /**
+     * Tells the server not to respond now, and returns the context that allows to respond later via
+     * @ref ServiceServer::respond(), e.g. once a slow storage operation is complete.
+     * The context is a small value object that can be stored anywhere; the response object itself is discarded
+     * once the callback returns.
+     */
+    ServiceReplyContext deferResponse()
+    {
+        _enabled_ = false;
+        return _reply_context_;
+    }
+
+    /**
+     * Reply context of the request being processed. Invalid if this object was not created by the server.
+     */
+    const ServiceReplyContext& getReplyContext() const { return _reply_context_; }
 };
 
 /**
@@ -83,6 +140,9 @@ public:
  *
  * @tparam NumStaticBufs        Number of statically allocated receiver buffers. If there's more concurrent
  *                              incoming transfers, extra buffers will be allocated in the memory pool.
+ *
+ * @tparam TransferListenerTemplate_    Transfer listener implementation. Use @ref StaticTransferListener<> to
+ *                                      disable the memory pool fallback for receivers and buffers.
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
@@ -94,16 +154,18 @@ template <typename DataType_,
 #endif
 #if UAVCAN_TINY
           unsigned NumStaticReceivers = 0,
-          unsigned NumStaticBufs = 0
+          unsigned NumStaticBufs = 0,
 #else
           unsigned NumStaticReceivers = 2,
-          unsigned NumStaticBufs = 1
+          unsigned NumStaticBufs = 1,
 #endif
+          template <unsigned, unsigned, unsigned> class TransferListenerTemplate_ = TransferListener
           >
 class UAVCAN_EXPORT ServiceServer
     : public GenericSubscriber<DataType_, typename DataType_::Request,
                                typename TransferListenerInstantiationHelper<typename DataType_::Request,
-                                                                            NumStaticReceivers, NumStaticBufs>::Type>
+                                                                            NumStaticReceivers, NumStaticBufs,
+                                                                            TransferListenerTemplate_>::Type>
 {
 public:
     typedef DataType_ DataType;
@@ -112,11 +174,18 @@ public:
     typedef Callback_ Callback;
 
 private:
-    typedef typename TransferListenerInstantiationHelper<RequestType, NumStaticReceivers, NumStaticBufs>::Type
-        TransferListenerType;
+    typedef typename TransferListenerInstantiationHelper<RequestType, NumStaticReceivers, NumStaticBufs,
+                                                         TransferListenerTemplate_>::Type TransferListenerType;
     typedef GenericSubscriber<DataType, RequestType, TransferListenerType> SubscriberType;
     typedef GenericPublisher<DataType, ResponseType> PublisherType;
 
+public:
+    /**
+     * Encoded response that is kept between requests, see @ref respond().
+     */
+    typedef typename PublisherType::PreEncodedPayload PreEncodedResponse;
+
+private:
     PublisherType publisher_;
     Callback callback_;
     uint32_t response_failure_count_;
@@ -125,7 +194,11 @@ private:
     {
         UAVCAN_ASSERT(request.getTransferType() == TransferTypeServiceRequest);
 
-        ServiceResponseDataStructure<ResponseType> response;
+        ServiceReplyContext context(request.getSrcNodeID(), request.getTransferID(), request.getPriority());
+#if UAVCAN_SUPPORT_CANFD
+        context.canfd = request.isCanFD();
+#endif
+        ServiceResponseDataStructure<ResponseType> response(context);
 
         if (coerceOrFallback<bool>(callback_, true))
         {
@@ -139,16 +212,7 @@ private:
 
         if (response.isResponseEnabled())
         {
-            publisher_.setPriority(request.getPriority());      // Responding at the same priority.
-
-            const int res = publisher_.publish(response, TransferTypeServiceResponse, request.getSrcNodeID(),
-                                               request.getTransferID());
-            if (res < 0)
-            {
-                UAVCAN_TRACE("ServiceServer", "Response publication failure: %i", res);
-                publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
-                response_failure_count_++;
-            }
+            (void)publishResponse(response.getReplyContext(), response);
         }
         else
         {
@@ -156,6 +220,28 @@ private:
         }
     }
 
+    int publishResponse(const ServiceReplyContext& context, const ResponseType& response,
+                        PreEncodedResponse* pre_encoded = NULL)
+    {
+        publisher_.setPriority(context.priority);      // Responding at the same priority.
+#if UAVCAN_SUPPORT_CANFD
+        publisher_.setCanFD(context.canfd);
+#endif
+
+        const int res = (pre_encoded == NULL) ?
+                        publisher_.publish(response, TransferTypeServiceResponse, context.client_node_id,
+                                           context.transfer_id) :
+                        publisher_.publish(response, *pre_encoded, TransferTypeServiceResponse,
+                                           context.client_node_id, context.transfer_id);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ServiceServer", "Response publication failure: %i", res);
+            publisher_.getNode().getDispatcher().getTransferPerfCounter().addError();
+            response_failure_count_++;
+        }
+        return res;
+    }
+
 public:
     explicit ServiceServer(INode& node)
         : SubscriberType(node)
@@ -197,6 +283,41 @@ public:
      */
     using SubscriberType::stop;
 
+    /**
+     * Sends the response to a request whose processing was deferred via
+     * @ref ServiceResponseDataStructure::deferResponse(). Each context should be responded to at most once.
+     *
+     * The library is not thread safe, so this method must be invoked from the thread that spins the node,
+     * e.g. from a timer callback or after draining a queue populated by a worker thread.
+     * The client will discard the response if it arrives after the client's request timeout expires
+     * (see @ref ServiceClient::getDefaultRequestTimeout()), so slow operations should stay well within it.
+     *
+     * @return  Non-negative on success, negative error code otherwise.
+     */
+    int respond(const ServiceReplyContext& context, const ResponseType& response)
+    {
+        if (!context.isValid())
+        {
+            return -ErrInvalidParam;
+        }
+        return publishResponse(context, response);
+    }
+
+    /**
+     * Same as above, but the response is encoded only if the pre-encoded response is dirty; otherwise the stored
+     * bytes are sent as is. This is meant for servers whose responses are large and rarely change, such as
+     * uavcan.protocol.GetNodeInfo: the callback defers the response and immediately responds via this method.
+     * The application must call PreEncodedResponse::markDirty() whenever the response object changes.
+     */
+    int respond(const ServiceReplyContext& context, const ResponseType& response, PreEncodedResponse& pre_encoded)
+    {
+        if (!context.isValid())
+        {
+            return -ErrInvalidParam;
+        }
+        return publishResponse(context, response, &pre_encoded);
+    }
+
     static MonotonicDuration getDefaultTxTimeout() { return MonotonicDuration::fromMSec(1000); }
     static MonotonicDuration getMinTxTimeout() { return PublisherType::getMinTxTimeout(); }
     static MonotonicDuration getMaxTxTimeout() { return PublisherType::getMaxTxTimeout(); }
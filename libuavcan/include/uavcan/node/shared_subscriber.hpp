@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_SHARED_SUBSCRIBER_HPP_INCLUDED
+#define UAVCAN_NODE_SHARED_SUBSCRIBER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/generic_subscriber.hpp>
+#include <uavcan/util/linked_list.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+
+template <typename DataType_>
+class UAVCAN_EXPORT SharedSubscriberBase;
+
+/**
+ * Base class of @ref SharedSubscription<> that does not depend on the callback type.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT SharedSubscriptionBase : public LinkedListNode<SharedSubscriptionBase<DataType_> >
+                                           , Noncopyable
+{
+    friend class SharedSubscriberBase<DataType_>;
+
+    SharedSubscriberBase<DataType_>* subscriber_;
+
+    virtual void handleMessage(const ReceivedDataStructure<DataType_>& msg) = 0;
+
+protected:
+    SharedSubscriptionBase()
+        : subscriber_(NULL)
+    { }
+
+    virtual ~SharedSubscriptionBase() { UAVCAN_ASSERT(subscriber_ == NULL); }
+
+    int attach(SharedSubscriberBase<DataType_>& subscriber) { return subscriber.attach(this); }
+
+    void detach()
+    {
+        if (subscriber_ != NULL)
+        {
+            subscriber_->detach(this);
+        }
+    }
+
+public:
+    bool isActive() const { return subscriber_ != NULL; }
+};
+
+/**
+ * Base class of @ref SharedSubscriber<> that does not depend on the transport layer configuration.
+ * It keeps the list of the subscriptions and delivers every decoded message to all of them.
+ */
+template <typename DataType_>
+class UAVCAN_EXPORT SharedSubscriberBase
+{
+    friend class SharedSubscriptionBase<DataType_>;
+
+    typedef SharedSubscriptionBase<DataType_> Subscription;
+
+    LinkedListRoot<Subscription> subscriptions_;
+    Subscription* next_to_invoke_;      ///< Lets the callbacks remove any subscription while the message is delivered
+
+    int attach(Subscription* subscription)
+    {
+        UAVCAN_ASSERT((subscription != NULL) && (subscription->subscriber_ == NULL));
+        if (subscriptions_.isEmpty())
+        {
+            const int res = startListener();
+            if (res < 0)
+            {
+                return res;
+            }
+        }
+        subscriptions_.insert(subscription);
+        subscription->subscriber_ = this;
+        return 0;
+    }
+
+    void detach(Subscription* subscription)
+    {
+        UAVCAN_ASSERT((subscription != NULL) && (subscription->subscriber_ == this));
+        if (next_to_invoke_ == subscription)
+        {
+            next_to_invoke_ = subscription->getNextListNode();
+        }
+        subscriptions_.remove(subscription);
+        subscription->subscriber_ = NULL;
+        if (subscriptions_.isEmpty())
+        {
+            stopListener();
+        }
+    }
+
+    virtual int startListener() = 0;
+    virtual void stopListener() = 0;
+
+protected:
+    SharedSubscriberBase()
+        : next_to_invoke_(NULL)
+    { }
+
+    virtual ~SharedSubscriberBase()
+    {
+        while (!subscriptions_.isEmpty())
+        {
+            Subscription* const subscription = subscriptions_.get();
+            subscriptions_.remove(subscription);
+            subscription->subscriber_ = NULL;
+        }
+    }
+
+    void deliver(const ReceivedDataStructure<DataType_>& msg)
+    {
+        Subscription* p = subscriptions_.get();
+        while (p != NULL)
+        {
+            next_to_invoke_ = p->getNextListNode();
+            p->handleMessage(msg);
+            p = next_to_invoke_;
+        }
+    }
+
+public:
+    unsigned getNumSubscriptions() const { return subscriptions_.getLength(); }
+};
+
+/**
+ * Receives a message type once for any number of consumers.
+ *
+ * Every @ref Subscriber<> owns a transfer listener, so N subscribers of the same data type reassemble, validate
+ * and decode every transfer N times, and keep N sets of receivers and buffers in the memory pool. A shared
+ * subscriber does that once, and delivers the decoded message to all of the @ref SharedSubscription<> objects
+ * attached to it. The subscriptions are cheap: they keep only the callback and a list link.
+ *
+ * The application keeps one shared subscriber per data type, e.g. next to the node object, and passes it to
+ * the modules that need the messages. The transfer listener is registered while there is at least one
+ * subscription. The transport layer options are configured here and apply to all subscriptions.
+ *
+ * Refer to @ref Subscriber<> for the template arguments.
+ */
+template <typename DataType_,
+#if UAVCAN_TINY
+          unsigned NumStaticReceivers = 0,
+          unsigned NumStaticBufs = 0,
+#else
+          unsigned NumStaticReceivers = 2,
+          unsigned NumStaticBufs = 1,
+#endif
+          template <unsigned, unsigned, unsigned> class TransferListenerTemplate_ = TransferListener
+          >
+class UAVCAN_EXPORT SharedSubscriber
+    : public GenericSubscriber<DataType_, DataType_,
+                               typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers,
+                                                                            NumStaticBufs,
+                                                                            TransferListenerTemplate_>::Type>
+    , public SharedSubscriberBase<DataType_>
+{
+    typedef typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers, NumStaticBufs,
+                                                         TransferListenerTemplate_>::Type TransferListenerType;
+    typedef GenericSubscriber<DataType_, DataType_, TransferListenerType> BaseType;
+
+    virtual void handleReceivedDataStruct(ReceivedDataStructure<DataType_>& msg)
+    {
+        SharedSubscriberBase<DataType_>::deliver(msg);
+    }
+
+    virtual int startListener() { return BaseType::startAsMessageListener(); }
+
+    virtual void stopListener() { BaseType::stop(); }
+
+public:
+    typedef DataType_ DataType;
+
+    explicit SharedSubscriber(INode& node)
+        : BaseType(node)
+    {
+        StaticAssert<DataTypeKind(DataType::DataTypeKind) == DataTypeKindMessage>::check();
+    }
+
+    using BaseType::allowAnonymousTransfers;
+    using BaseType::setTransferPrefilter;
+    using BaseType::setEarliestArrivalMode;
+    using BaseType::setReceiverRetention;
+#if !UAVCAN_TINY
+    using BaseType::setTransferHandoff;
+#endif
+    using BaseType::getFailureCount;
+};
+
+/**
+ * Consumer of the messages received by a @ref SharedSubscriber<>.
+ * All subscriptions receive the same decoded message object, hence the callback can't modify it.
+ * The order in which the subscriptions are invoked is not defined.
+ *
+ * @tparam DataType_        Message data type.
+ *
+ * @tparam Callback_        Type of the callback; the argument type can be either const DataType_& or
+ *                          const ReceivedDataStructure<DataType_>&.
+ *                          In C++11 mode this type defaults to std::function<>.
+ *                          In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                          call member functions as callbacks.
+ */
+template <typename DataType_,
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const ReceivedDataStructure<DataType_>&)>
+#else
+          typename Callback_ = void (*)(const ReceivedDataStructure<DataType_>&)
+#endif
+          >
+class UAVCAN_EXPORT SharedSubscription : public SharedSubscriptionBase<DataType_>
+{
+public:
+    typedef Callback_ Callback;
+
+private:
+    Callback callback_;
+
+    virtual void handleMessage(const ReceivedDataStructure<DataType_>& msg)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(msg);
+        }
+        else
+        {
+            handleFatalError("Sub clbk");
+        }
+    }
+
+public:
+    typedef DataType_ DataType;
+
+    SharedSubscription()
+        : callback_()
+    { }
+
+    virtual ~SharedSubscription() { stop(); }
+
+    /**
+     * Begin receiving messages from the shared subscriber.
+     * Returns negative error code.
+     */
+    int start(SharedSubscriberBase<DataType_>& subscriber, const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("SharedSubscription", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+        callback_ = callback;
+
+        return SharedSubscriptionBase<DataType_>::attach(subscriber);
+    }
+
+    /**
+     * Can be called from the callback.
+     */
+    void stop() { SharedSubscriptionBase<DataType_>::detach(); }
+};
+
+}
+
+#endif // UAVCAN_NODE_SHARED_SUBSCRIBER_HPP_INCLUDED
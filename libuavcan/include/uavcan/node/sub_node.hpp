@@ -33,7 +33,8 @@ class UAVCAN_EXPORT SubNode : public INode
     typedef PoolAllocator<MemPoolSize, MemPoolBlockSize> Allocator;
 
     Allocator pool_allocator_;
-    OutgoingTransferRegistry<OutgoingTransferRegistryStaticEntries> outgoing_trans_reg_;
+    MemoryUsageTracker memory_usage_;
+    typename DefaultOutgoingTransferRegistry<OutgoingTransferRegistryStaticEntries>::Type outgoing_trans_reg_;
     Scheduler scheduler_;
 
     uint64_t internal_failure_cnt_;
@@ -48,13 +49,27 @@ protected:
 
 public:
     SubNode(ICanDriver& can_driver, ISystemClock& system_clock) :
-        outgoing_trans_reg_(pool_allocator_),
-        scheduler_(can_driver, pool_allocator_, system_clock, outgoing_trans_reg_),
+        memory_usage_(pool_allocator_),
+        outgoing_trans_reg_(memory_usage_.get(MemoryConsumerOutgoingTransferRegistry)),
+        scheduler_(can_driver, memory_usage_.get(MemoryConsumerCanTxQueue), system_clock, outgoing_trans_reg_),
         internal_failure_cnt_(0)
     { }
 
     virtual Allocator& getAllocator() { return pool_allocator_; }
 
+    virtual IPoolAllocator& getAllocatorFor(MemoryConsumer consumer) { return memory_usage_.get(consumer); }
+
+    virtual const InstrumentedPoolAllocator* getMemoryUsage(MemoryConsumer consumer) const
+    {
+        return &memory_usage_.get(consumer);
+    }
+
+    virtual int setMemoryQuota(MemoryConsumer consumer, uint16_t max_blocks)
+    {
+        memory_usage_.get(consumer).setQuota(max_blocks);
+        return 0;
+    }
+
     virtual Scheduler& getScheduler() { return scheduler_; }
     virtual const Scheduler& getScheduler() const { return scheduler_; }
 
@@ -40,6 +40,11 @@ namespace uavcan
  *
  * @tparam NumStaticBufs        Number of statically allocated receiver buffers. If there's more concurrent
  *                              incoming transfers, extra buffers will be allocated in the memory pool.
+ *
+ * @tparam TransferListenerTemplate_    Transfer listener implementation. Use @ref StaticTransferListener<> to
+ *                                      disable the memory pool fallback for receivers and buffers, or
+ *                                      @ref RuntimeCapacityTransferListener<> (with both static counts set to
+ *                                      zero) to size the static capacity at run time, see setListenerCapacity().
  */
 template <typename DataType_,
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
@@ -49,23 +54,25 @@ template <typename DataType_,
 #endif
 #if UAVCAN_TINY
           unsigned NumStaticReceivers = 0,
-          unsigned NumStaticBufs = 0
+          unsigned NumStaticBufs = 0,
 #else
           unsigned NumStaticReceivers = 2,
-          unsigned NumStaticBufs = 1
+          unsigned NumStaticBufs = 1,
 #endif
+          template <unsigned, unsigned, unsigned> class TransferListenerTemplate_ = TransferListener
           >
 class UAVCAN_EXPORT Subscriber
     : public GenericSubscriber<DataType_, DataType_,
                                typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers,
-                                                                            NumStaticBufs>::Type>
+                                                                            NumStaticBufs,
+                                                                            TransferListenerTemplate_>::Type>
 {
 public:
     typedef Callback_ Callback;
 
 private:
-    typedef typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers, NumStaticBufs>::Type
-        TransferListenerType;
+    typedef typename TransferListenerInstantiationHelper<DataType_, NumStaticReceivers, NumStaticBufs,
+                                                         TransferListenerTemplate_>::Type TransferListenerType;
     typedef GenericSubscriber<DataType_, DataType_, TransferListenerType> BaseType;
 
     Callback callback_;
@@ -112,6 +119,14 @@ public:
     }
 
     using BaseType::allowAnonymousTransfers;
+    using BaseType::setTransferPrefilter;
+    using BaseType::setEarliestArrivalMode;
+    using BaseType::setReceiverRetention;
+#if !UAVCAN_TINY
+    using BaseType::setTransferHandoff;
+    using BaseType::setListenerCapacity;
+    using BaseType::getListenerStorageSize;
+#endif
     using BaseType::stop;
     using BaseType::getFailureCount;
 };
@@ -133,6 +133,147 @@ public:
 };
 
 
+class UAVCAN_EXPORT TimerGroup;
+
+/**
+ * Periodic timer that shares the scheduler entry with other timers of the same @ref TimerGroup.
+ * Inherit this class if you need a grouped timer callback method in your class.
+ * The timer must be destroyed before its group.
+ */
+class UAVCAN_EXPORT GroupedTimerBase : public FastRemovalLinkedList<GroupedTimerBase>::Node, Noncopyable
+{
+    friend class TimerGroup;
+
+    TimerGroup& group_;
+
+public:
+    explicit GroupedTimerBase(TimerGroup& group)
+        : group_(group)
+    { }
+
+    virtual ~GroupedTimerBase() { stop(); }
+
+    /**
+     * Joins the group; the first event will be generated at the next deadline of the group.
+     * Does nothing if the timer is running already.
+     */
+    void start();
+
+    /**
+     * Leaves the group. It is allowed to stop any timer of the group from a callback, including this one.
+     */
+    void stop();
+
+    bool isRunning() const;
+
+    TimerGroup& getGroup() const { return group_; }
+
+    /**
+     * Implement this method in your class to receive callbacks.
+     */
+    virtual void handleTimerEvent(const TimerEvent& event) = 0;
+};
+
+/**
+ * Runs many periodic timers of the same period as one scheduler entry, see @ref GroupedTimerBase.
+ * On every deadline the callbacks of all running timers of the group are invoked in one pass, in the reverse order
+ * of starting; all timers receive the same scheduled time, so their phase relationship never changes.
+ * This reduces the number of scheduler insertions on nodes that run many timers at a few common rates.
+ *
+ * The group is started automatically when the first timer joins it, and stops when the last one leaves it.
+ * Like @ref TimerBase in periodic mode, the group does not accumulate error over time.
+ */
+class UAVCAN_EXPORT TimerGroup : private DeadlineHandler
+{
+    friend class GroupedTimerBase;
+
+    FastRemovalLinkedList<GroupedTimerBase>::Root timers_;
+    GroupedTimerBase* next_to_fire_;            ///< Next timer to call within the ongoing pass
+    MonotonicDuration period_;
+
+    virtual void handleDeadline(MonotonicTime current);
+
+    void add(GroupedTimerBase* timer);
+    void remove(GroupedTimerBase* timer);
+
+public:
+    using DeadlineHandler::getDeadline;
+    using DeadlineHandler::getScheduler;
+
+    TimerGroup(INode& node, MonotonicDuration period)
+        : DeadlineHandler(node.getScheduler())
+        , next_to_fire_(NULL)
+        , period_(period)
+    {
+        UAVCAN_ASSERT(period.isPositive() && (period < MonotonicDuration::getInfinite()));
+    }
+
+    virtual ~TimerGroup();
+
+    MonotonicDuration getPeriod() const { return period_; }
+
+    /**
+     * Changes the period; if the group is running, the next deadline will be one new period from now.
+     */
+    void setPeriod(MonotonicDuration period);
+
+    /**
+     * Whether the group is registered in the scheduler, i.e. there is at least one running timer.
+     */
+    bool isRunning() const { return DeadlineHandler::isRunning(); }
+
+    /**
+     * Number of running timers in the group.
+     */
+    unsigned getNumTimers() const { return timers_.getLength(); }
+};
+
+/**
+ * Wrapper over GroupedTimerBase that forwards callbacks into arbitrary handlers, like @ref TimerEventForwarder.
+ *
+ * @tparam Callback_    Callback type. Shall accept const reference to TimerEvent as its argument.
+ */
+template <typename Callback_>
+class UAVCAN_EXPORT GroupedTimerEventForwarder : public GroupedTimerBase
+{
+public:
+    typedef Callback_ Callback;
+
+private:
+    Callback callback_;
+
+    virtual void handleTimerEvent(const TimerEvent& event)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(event);
+        }
+        else
+        {
+            handleFatalError("Invalid timer callback");
+        }
+    }
+
+public:
+    explicit GroupedTimerEventForwarder(TimerGroup& group)
+        : GroupedTimerBase(group)
+        , callback_()
+    { }
+
+    GroupedTimerEventForwarder(TimerGroup& group, const Callback& callback)
+        : GroupedTimerBase(group)
+        , callback_(callback)
+    { }
+
+    /**
+     * Get/set the callback object.
+     * Callback must be set before the first event happens; otherwise the event will generate a fatal error.
+     */
+    const Callback& getCallback() const { return callback_; }
+    void setCallback(const Callback& callback) { callback_ = callback; }
+};
+
+
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
 /**
@@ -141,6 +282,11 @@ public:
  */
 typedef TimerEventForwarder<std::function<void (const TimerEvent& event)> > Timer;
 
+/**
+ * Grouped version of @ref Timer.
+ */
+typedef GroupedTimerEventForwarder<std::function<void (const TimerEvent& event)> > GroupedTimer;
+
 #endif
 
 }
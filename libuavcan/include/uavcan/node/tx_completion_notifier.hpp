@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_NODE_TX_COMPLETION_NOTIFIER_HPP_INCLUDED
+#define UAVCAN_NODE_TX_COMPLETION_NOTIFIER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/util/templates.hpp>
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+# include <functional>
+#endif
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+/**
+ * Reported when the last frame of a published transfer has been transmitted.
+ */
+struct UAVCAN_EXPORT TxCompletionEvent
+{
+    MonotonicTime ts_mono;      ///< Transmission timestamp reported by the driver
+    UtcTime ts_utc;
+    TransferID transfer_id;
+    uint8_t iface_index;
+};
+
+/**
+ * Non-generic part of @ref TxCompletionNotifier<>.
+ */
+class UAVCAN_EXPORT TxCompletionNotifierBase : protected LoopbackFrameListenerBase
+{
+    TransferSender* sender_;
+    bool loopback_was_enabled_;
+
+    virtual void handleLoopbackFrame(const RxFrame& frame);
+
+protected:
+    explicit TxCompletionNotifierBase(INode& node)
+        : LoopbackFrameListenerBase(node.getDispatcher())
+        , sender_(NULL)
+        , loopback_was_enabled_(false)
+    { }
+
+    virtual ~TxCompletionNotifierBase() { stop(); }
+
+    int startImpl(TransferSender& sender);
+
+    virtual void handleTxCompletion(const TxCompletionEvent& event) = 0;
+
+public:
+    /**
+     * Restores the CAN IO flags of the publisher.
+     */
+    void stop();
+
+    bool isActive() const { return sender_ != NULL; }
+};
+
+/**
+ * Reports when the transfers of a publisher actually hit the wire, with the TX timestamps of the driver; this is
+ * useful to measure the real TX latency, or to pace the publications.
+ *
+ * The publisher is switched to the loopback mode (@ref CanIOFlagLoopback), where the driver sends every transmitted
+ * frame back with its TX timestamp. One event is reported per transfer per interface, when the last frame of the
+ * transfer has been transmitted; transfers that expired in the TX queue are not reported. The publish path is not
+ * affected otherwise, no memory is allocated. If several publishers of the same data type share the node, the
+ * transfers of all of them are reported.
+ *
+ * Requires the driver to support the loopback; not available in UAVCAN_TINY mode.
+ *
+ * @tparam Callback_    Callback type, the argument is const TxCompletionEvent&.
+ *                      In C++11 mode this type defaults to std::function<>.
+ *                      In C++03 mode this type defaults to a plain function pointer; use binder to
+ *                      call member functions as callbacks.
+ */
+template <
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+          typename Callback_ = std::function<void (const TxCompletionEvent&)>
+#else
+          typename Callback_ = void (*)(const TxCompletionEvent&)
+#endif
+          >
+class UAVCAN_EXPORT TxCompletionNotifier : public TxCompletionNotifierBase
+{
+public:
+    typedef Callback_ Callback;
+
+private:
+    Callback callback_;
+
+    virtual void handleTxCompletion(const TxCompletionEvent& event)
+    {
+        if (coerceOrFallback<bool>(callback_, true))
+        {
+            callback_(event);
+        }
+        else
+        {
+            handleFatalError("TX compl clbk");
+        }
+    }
+
+public:
+    explicit TxCompletionNotifier(INode& node)
+        : TxCompletionNotifierBase(node)
+        , callback_()
+    { }
+
+    /**
+     * Starts reporting the transfers of the publisher, which is initialized if it wasn't yet.
+     * The publisher must outlive the notifier, or the notifier must be stopped first.
+     * Returns negative error code.
+     */
+    template <typename DataType>
+    int start(Publisher<DataType>& publisher, const Callback& callback)
+    {
+        stop();
+
+        if (!coerceOrFallback<bool>(callback, true))
+        {
+            UAVCAN_TRACE("TxCompletionNotifier", "Invalid callback");
+            return -ErrInvalidParam;
+        }
+
+        const int res = publisher.init();
+        if (res < 0)
+        {
+            return res;
+        }
+
+        callback_ = callback;
+        return startImpl(publisher.getTransferSender());
+    }
+};
+#endif
+
+}
+
+#endif // UAVCAN_NODE_TX_COMPLETION_NOTIFIER_HPP_INCLUDED
@@ -20,11 +20,24 @@ namespace uavcan
  */
 class UAVCAN_EXPORT DataTypeInfoProvider : Noncopyable
 {
+    typedef ServiceResponseDataStructure<protocol::GetDataTypeInfo::Response> Response;
+
     typedef MethodBinder<DataTypeInfoProvider*,
                          void (DataTypeInfoProvider::*)(const protocol::GetDataTypeInfo::Request&,
-                                                        protocol::GetDataTypeInfo::Response&)> GetDataTypeInfoCallback;
+                                                        Response&)> GetDataTypeInfoCallback;
+    typedef ServiceServer<protocol::GetDataTypeInfo, GetDataTypeInfoCallback> GetDataTypeInfoServer;
+
+    GetDataTypeInfoServer gdti_srv_;
 
-    ServiceServer<protocol::GetDataTypeInfo, GetDataTypeInfoCallback> gdti_srv_;
+#if !UAVCAN_TINY
+    /*
+     * Monitoring tools tend to query the same types in the same order, often at the same time (e.g. after a bus
+     * restart), so the last successful response is kept encoded, along with what it depends on.
+     */
+    GetDataTypeInfoServer::PreEncodedResponse last_response_encoded_;
+    const DataTypeDescriptor* last_response_desc_;
+    uint8_t last_response_flags_;
+#endif
 
     INode& getNode() { return gdti_srv_.getNode(); }
 
@@ -33,8 +46,7 @@ class UAVCAN_EXPORT DataTypeInfoProvider : Noncopyable
         return (kind == DataTypeKindMessage) || (kind == DataTypeKindService);
     }
 
-    void handleGetDataTypeInfoRequest(const protocol::GetDataTypeInfo::Request& request,
-                                      protocol::GetDataTypeInfo::Response& response)
+    void handleGetDataTypeInfoRequest(const protocol::GetDataTypeInfo::Request& request, Response& response)
     {
         /*
          * Asking the Global Data Type Registry for the matching type descriptor, either by name or by ID
@@ -105,11 +117,25 @@ class UAVCAN_EXPORT DataTypeInfoProvider : Noncopyable
         {
             UAVCAN_ASSERT(0); // That means that GDTR somehow found a type of an unknown kind. The horror.
         }
+
+#if !UAVCAN_TINY
+        if ((desc != last_response_desc_) || (response.flags != last_response_flags_))
+        {
+            last_response_desc_ = desc;
+            last_response_flags_ = response.flags;
+            last_response_encoded_.markDirty();
+        }
+        (void)gdti_srv_.respond(response.deferResponse(), response, last_response_encoded_);
+#endif
     }
 
 public:
     explicit DataTypeInfoProvider(INode& node) :
         gdti_srv_(node)
+#if !UAVCAN_TINY
+        , last_response_desc_(NULL)
+        , last_response_flags_(0)
+#endif
     { }
 
     int start()
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_DATA_TYPE_STATS_PUBLISHER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_DATA_TYPE_STATS_PUBLISHER_HPP_INCLUDED
+
+#include <uavcan/debug.hpp>
+#include <uavcan/std.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/transport/data_type_stats.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+
+#if UAVCAN_TINY
+# error "This functionality is not available in tiny mode"
+#endif
+
+namespace uavcan
+{
+/**
+ * Publishes the per data type transport statistics of the local node (see Dispatcher::getDataTypeStatsTable())
+ * as uavcan.protocol.debug.KeyValue messages. This helps to find out which data type saturates the node
+ * without attaching a bus analyzer.
+ *
+ * Eleven values are published for every tracked data type. The keys look like "dt.m341.frx", where the second
+ * component is "m" for messages or "s" for services followed by the data type ID, and the last one is the counter:
+ *  - frx, ftx - number of received and transmitted frames
+ *  - trx, ttx - number of received and transmitted transfers
+ *  - brx, btx - number of received and transmitted payload bytes
+ *  - err      - number of reassembly errors
+ *  - rcr, rrm - number of created and removed receivers, refer to TransferListenerBase::setReceiverRetention()
+ *  - rtm      - maximum reassembly time, microseconds
+ *  - cbt      - maximum callback duration, microseconds
+ * The counters are cumulative, so the rates can be computed by the receiving side.
+ *
+ * The statistics can be published either once by calling @ref publish(), or periodically. Since every data type
+ * takes several messages, the period should not be too short.
+ */
+class UAVCAN_EXPORT DataTypeStatsPublisher : private TimerBase
+{
+    Publisher<protocol::debug::KeyValue> pub_;
+
+    int publishValue(const DataTypeStats& stats, const char* suffix, uint32_t value)
+    {
+        char prefix[16];
+        (void)snprintf(prefix, sizeof(prefix), "dt.%c%u.",
+                       (stats.data_type_kind == DataTypeKindMessage) ? 'm' : 's', unsigned(stats.data_type_id.get()));
+        protocol::debug::KeyValue msg;
+        msg.key = prefix;
+        msg.key += suffix;
+        msg.value = static_cast<float>(value);
+        return pub_.broadcast(msg);
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        if (publish() < 0)
+        {
+            pub_.getNode().registerInternalFailure("DataTypeStatsPublisher pub failed");
+        }
+    }
+
+public:
+    explicit DataTypeStatsPublisher(INode& node)
+        : TimerBase(node)
+        , pub_(node)
+    { }
+
+    /**
+     * Publishes the statistics once.
+     * Returns negative error code if any message could not be published.
+     */
+    int publish()
+    {
+        const int init_res = pub_.init();       // So that the statistics include the outgoing messages as well
+        if (init_res < 0)
+        {
+            return init_res;
+        }
+        const DataTypeStatsTable& table = pub_.getNode().getDispatcher().getDataTypeStatsTable();
+        int result = 0;
+        for (unsigned i = 0; i < table.getSize(); i++)
+        {
+            // Copying, because the statistics of the KeyValue type change as the messages are published
+            const DataTypeStats stats = *table.getByIndex(i);
+            const int res[] =
+            {
+                publishValue(stats, "frx", stats.frames_rx),
+                publishValue(stats, "ftx", stats.frames_tx),
+                publishValue(stats, "trx", stats.transfers_rx),
+                publishValue(stats, "ttx", stats.transfers_tx),
+                publishValue(stats, "brx", stats.payload_bytes_rx),
+                publishValue(stats, "btx", stats.payload_bytes_tx),
+                publishValue(stats, "err", stats.rx_errors),
+                publishValue(stats, "rcr", stats.receivers_created),
+                publishValue(stats, "rrm", stats.receivers_removed),
+                publishValue(stats, "rtm", stats.max_reassembly_time_usec),
+                publishValue(stats, "cbt", stats.max_callback_duration_usec)
+            };
+            for (unsigned k = 0; k < (sizeof(res) / sizeof(res[0])); k++)
+            {
+                if (res[k] < 0)
+                {
+                    result = res[k];
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Starts periodic publishing with the specified interval.
+     */
+    void startPeriodic(MonotonicDuration period)
+    {
+        UAVCAN_TRACE("DataTypeStatsPublisher", "Starting with period %u ms", unsigned(period.toMSec()));
+        TimerBase::startPeriodic(period);
+    }
+
+    /**
+     * Stops periodic publishing.
+     */
+    void stop() { TimerBase::stop(); }
+
+    bool isRunning() const { return TimerBase::isRunning(); }
+
+    /**
+     * Priority and TX timeout of the outgoing messages can be configured via the publisher.
+     */
+    Publisher<protocol::debug::KeyValue>& getPublisher() { return pub_; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_DATA_TYPE_STATS_PUBLISHER_HPP_INCLUDED
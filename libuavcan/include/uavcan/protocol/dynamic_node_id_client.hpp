@@ -26,6 +26,11 @@ namespace uavcan
  *
  * Once dynamic allocation is complete (or not needed anymore), the object can be deleted.
  *
+ * By default the request pacing is adaptive: the random delays are drawn from narrower sub-ranges of the ranges
+ * defined by the specification, which are widened when the client observes competing allocation traffic (colliding
+ * first-stage requests or follow-up requests of other nodes with the same unique ID prefix) and narrowed again when
+ * allocation rounds complete without collisions. The delays never leave the ranges defined by the specification.
+ *
  * Note that this class uses std::rand(), which must be correctly seeded before use.
  */
 class UAVCAN_EXPORT DynamicNodeIDClient : private TimerBase
@@ -52,8 +57,16 @@ class UAVCAN_EXPORT DynamicNodeIDClient : private TimerBase
     NodeID allocated_node_id_;
     NodeID allocator_node_id_;
 
+    MonotonicTime last_first_stage_request_ts_;     ///< Zero if the last request has been responded
+    uint16_t request_window_msec_;
+    uint16_t followup_window_msec_;
+    bool adaptive_pacing_;
+
     void terminate();
 
+    void handleCompetingTraffic(const ReceivedDataStructure<protocol::dynamic_node_id::Allocation>& msg,
+                                bool was_waiting_for_followup);
+
     static MonotonicDuration getRandomDuration(uint32_t lower_bound_msec, uint32_t upper_bound_msec);
 
     void restartTimer(const Mode mode);
@@ -63,11 +76,18 @@ class UAVCAN_EXPORT DynamicNodeIDClient : private TimerBase
     void handleAllocation(const ReceivedDataStructure<protocol::dynamic_node_id::Allocation>& msg);
 
 public:
+    enum { InitialRequestWindowMSec = 100 };
+    enum { MinRequestWindowMSec = 20 };
+    enum { InitialFollowupWindowMSec = 50 };
+
     DynamicNodeIDClient(INode& node)
         : TimerBase(node)
         , dnida_pub_(node)
         , dnida_sub_(node)
         , size_of_received_unique_id_(0)
+        , request_window_msec_(InitialRequestWindowMSec)
+        , followup_window_msec_(InitialFollowupWindowMSec)
+        , adaptive_pacing_(true)
     { }
 
     /**
@@ -103,6 +123,21 @@ public:
      *                  If allocation is not complete yet, an non-unicast node ID will be returned.
      */
     NodeID getAllocatorNodeID() const { return allocator_node_id_; }
+
+    /**
+     * Adaptive request pacing is enabled by default. If disabled, the delays are drawn from the full ranges
+     * defined by the specification. Can be changed at any time.
+     */
+    void setAdaptivePacing(bool enabled) { adaptive_pacing_ = enabled; }
+    bool isAdaptivePacingEnabled() const { return adaptive_pacing_; }
+
+    /**
+     * Widths of the current sub-ranges of the request period and of the follow-up delay, in milliseconds.
+     * The request period is drawn from [MIN_REQUEST_PERIOD_MS, MIN_REQUEST_PERIOD_MS + request window), the follow-up
+     * delay is drawn from [MIN_FOLLOWUP_DELAY_MS, MIN_FOLLOWUP_DELAY_MS + follow-up window).
+     */
+    uint16_t getRequestWindowMSec() const { return request_window_msec_; }
+    uint16_t getFollowupWindowMSec() const { return followup_window_msec_; }
 };
 
 }
@@ -35,12 +35,30 @@ public:
      */
     virtual void handleAllocationRequest(const UniqueID& unique_id, NodeID preferred_node_id) = 0;
 
+    /**
+     * This method will be invoked when the unique ID of the requesting node has been guessed from the first part
+     * of it, using the cache of known unique IDs. Since the guess is not confirmed by the client, the handler must
+     * not make new allocations here; it should only publish the existing allocation, if there is one.
+     * @return True if the allocation response has been published, false to proceed with the full unique ID exchange.
+     */
+    virtual bool handleKnownAllocationRequest(const UniqueID& unique_id)
+    {
+        (void)unique_id;
+        return false;
+    }
+
     virtual ~IAllocationRequestHandler() { }
 };
 
 /**
  * This class manages communication with allocation clients.
  * Three-stage unique ID exchange is implemented here, as well as response publication.
+ *
+ * The unique IDs of allocated nodes are cached, so that when a known node restarts and requests allocation again,
+ * the response can be published as soon as the received part of the unique ID matches exactly one cached entry,
+ * skipping the remaining stages of the exchange. The client only accepts a response whose unique ID matches its own,
+ * so a node that happens to share the first part of its unique ID with a cached one will ignore the response;
+ * in this case the full exchange will be performed on its next attempt.
  */
 class AllocationRequestManager
 {
@@ -59,6 +77,16 @@ class AllocationRequestManager
     Subscriber<Allocation, AllocationCallback> allocation_sub_;
     Publisher<Allocation> allocation_pub_;
 
+    struct KnownUniqueID
+    {
+        PackedUniqueID unique_id;
+        MonotonicTime last_fast_path_ts;
+    };
+
+    KnownUniqueID known_unique_ids_[DynamicNodeIDServerUniqueIDCacheSize];
+    unsigned num_known_unique_ids_;
+    unsigned next_known_unique_id_;         ///< The one to be replaced when the cache is full
+
     enum { InvalidStage = 0 };
 
     void trace(TraceCode code, int64_t argument) { tracer_.onEvent(code, argument); }
@@ -124,6 +152,60 @@ class AllocationRequestManager
         }
     }
 
+    /**
+     * Returns the only cached unique ID that begins with the part of the unique ID received so far.
+     * Returns NULL if there are none or more than one.
+     */
+    KnownUniqueID* findKnownUniqueIDByPrefix()
+    {
+        const PackedUniqueID prefix(current_unique_id_);
+        KnownUniqueID* found = NULL;
+        for (unsigned i = 0; i < num_known_unique_ids_; i++)
+        {
+            if (known_unique_ids_[i].unique_id.hasPrefix(prefix, current_unique_id_.size()))
+            {
+                if (found != NULL)
+                {
+                    return NULL;
+                }
+                found = &known_unique_ids_[i];
+            }
+        }
+        return found;
+    }
+
+    bool tryCompleteFromCache(const MonotonicTime timestamp)
+    {
+        KnownUniqueID* const known = findKnownUniqueIDByPrefix();
+        if (known == NULL)
+        {
+            return false;
+        }
+
+        /*
+         * If this entry has served a request recently, the client must have ignored the response, which means that
+         * its unique ID only begins like the cached one. The full exchange is required in this case.
+         */
+        if (!known->last_fast_path_ts.isZero() &&
+            (timestamp - known->last_fast_path_ts) < MonotonicDuration::fromMSec(Allocation::MAX_REQUEST_PERIOD_MS * 2))
+        {
+            return false;
+        }
+
+        if (!handler_.handleKnownAllocationRequest(known->unique_id.toUniqueID()))
+        {
+            return false;
+        }
+
+        UAVCAN_TRACE("AllocationRequestManager", "Allocation request served from cache after %u bytes of unique ID",
+                     unsigned(current_unique_id_.size()));
+
+        trace(TraceAllocationFastPath, current_unique_id_.size());
+        known->last_fast_path_ts = timestamp;
+        current_unique_id_.clear();
+        return true;
+    }
+
     void handleAllocation(const ReceivedDataStructure<Allocation>& msg)
     {
         trace(TraceAllocationActivity, msg.getSrcNodeID().get());
@@ -213,7 +295,10 @@ class AllocationRequestManager
         {
             if (handler_.canPublishFollowupAllocationResponse())
             {
-                publishFollowupAllocationResponse();
+                if (!tryCompleteFromCache(msg.getMonotonicTimestamp()))
+                {
+                    publishFollowupAllocationResponse();
+                }
             }
             else
             {
@@ -235,6 +320,8 @@ public:
         , tracer_(tracer)
         , allocation_sub_(node)
         , allocation_pub_(node)
+        , num_known_unique_ids_(0)
+        , next_known_unique_id_(0)
     { }
 
     int init(const TransferPriority priority)
@@ -256,8 +343,41 @@ public:
         return 0;
     }
 
+    /**
+     * Adds the unique ID of an allocated node to the cache, replacing the oldest entry if the cache is full.
+     * This is done automatically for every published allocation response.
+     */
+    void addKnownUniqueID(const UniqueID& unique_id)
+    {
+        const PackedUniqueID packed(unique_id);
+        for (unsigned i = 0; i < num_known_unique_ids_; i++)
+        {
+            if (known_unique_ids_[i].unique_id == packed)
+            {
+                return;
+            }
+        }
+
+        KnownUniqueID* known = NULL;
+        if (num_known_unique_ids_ < DynamicNodeIDServerUniqueIDCacheSize)
+        {
+            known = &known_unique_ids_[num_known_unique_ids_++];
+        }
+        else
+        {
+            known = &known_unique_ids_[next_known_unique_id_];
+            next_known_unique_id_ = (next_known_unique_id_ + 1U) % DynamicNodeIDServerUniqueIDCacheSize;
+        }
+        known->unique_id = packed;
+        known->last_fast_path_ts = MonotonicTime();
+    }
+
+    unsigned getNumKnownUniqueIDs() const { return num_known_unique_ids_; }
+
     int broadcastAllocationResponse(const UniqueID& unique_id, NodeID allocated_node_id)
     {
+        addKnownUniqueID(unique_id);
+
         Allocation msg;
 
         msg.unique_id.resize(msg.unique_id.capacity());
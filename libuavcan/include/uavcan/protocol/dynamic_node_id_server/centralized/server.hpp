@@ -95,6 +95,17 @@ class Server : IAllocationRequestHandler
         }
     }
 
+    virtual bool handleKnownAllocationRequest(const UniqueID& unique_id)
+    {
+        const NodeID existing_node_id = storage_.getNodeIDForUniqueID(unique_id);
+        if (!existing_node_id.isValid())
+        {
+            return false;
+        }
+        tryPublishAllocationResult(existing_node_id, unique_id);
+        return true;
+    }
+
     /*
      * Methods of INodeDiscoveryHandler
      */
@@ -20,6 +20,12 @@ namespace centralized
 /**
  * This class transparently replicates its state to the storage backend, keeping the most recent state in memory.
  * Writes are slow, reads are instantaneous.
+ *
+ * All allocations are mirrored in memory: the unique ID of every allocated node ID is kept in a table, which is
+ * indexed by a hash table, so that the lookups do not access the storage backend. For every allocation, the storage
+ * contains the node ID keyed by the unique ID, and the unique ID keyed by the node ID; the latter is used to load
+ * the mirror at initialization. Storages written by older versions lack the latter, in which case the lookups of
+ * unknown unique IDs fall back to the storage backend.
  */
 class Storage
 {
@@ -28,11 +34,46 @@ class Storage
                   BitLenToByteLen<NodeID::Max + 1>::Result>
             OccupationMaskArray;
 
+    enum { IndexSize = 256 };           ///< Power of two, twice the number of node IDs
+
     IStorageBackend& storage_;
     OccupationMask occupation_mask_;
+    PackedUniqueID unique_ids_[NodeID::Max + 1];
+    uint8_t index_[IndexSize];          ///< Node ID, zero if the slot is empty
+    bool index_complete_;               ///< False if some unique IDs could not be loaded from the storage
 
     static IStorageBackend::String getOccupationMaskKey() { return "occupation_mask"; }
 
+    static IStorageBackend::String makeUniqueIDKey(const NodeID node_id)
+    {
+        IStorageBackend::String str;
+        // "node42_unique_id"
+        str += "node";
+        str.appendFormatted("%d", int(node_id.get()));
+        str += "_unique_id";
+        return str;
+    }
+
+    /**
+     * Returns the index slot that contains the unique ID, or the empty slot where it should be inserted.
+     */
+    unsigned findIndexSlot(const PackedUniqueID& unique_id) const
+    {
+        unsigned slot = unique_id.computeHash() & (IndexSize - 1U);
+        while ((index_[slot] != 0) && (unique_ids_[index_[slot]] != unique_id))
+        {
+            slot = (slot + 1U) & (IndexSize - 1U);          // Never full, see IndexSize
+        }
+        return slot;
+    }
+
+    void addToIndex(const NodeID node_id, const UniqueID& unique_id)
+    {
+        const PackedUniqueID packed(unique_id);
+        unique_ids_[node_id.get()] = packed;
+        index_[findIndexSlot(packed)] = node_id.get();      // Same as in the storage, the latest allocation wins
+    }
+
     static OccupationMask maskFromArray(const OccupationMaskArray& array)
     {
         OccupationMask mask;
@@ -64,11 +105,14 @@ class Storage
 
 public:
     Storage(IStorageBackend& storage) :
-        storage_(storage)
-    { }
+        storage_(storage),
+        index_complete_(true)
+    {
+        fill_n(index_, unsigned(IndexSize), uint8_t(0));
+    }
 
     /**
-     * This method reads only the occupation mask from the storage.
+     * This method reads the occupation mask and the unique IDs of all allocated node IDs from the storage.
      */
     int init()
     {
@@ -76,6 +120,43 @@ public:
         OccupationMaskArray array;
         io.get(getOccupationMaskKey(), array);
         occupation_mask_ = maskFromArray(array);
+
+        fill_n(index_, unsigned(IndexSize), uint8_t(0));
+        index_complete_ = true;
+        for (uint8_t node_id = 1; node_id <= NodeID::Max; node_id++)
+        {
+            if (!occupation_mask_[node_id])
+            {
+                continue;
+            }
+            UniqueID unique_id;
+            if (io.get(makeUniqueIDKey(node_id), unique_id) < 0)
+            {
+                UAVCAN_TRACE("dynamic_node_id_server::centralized::Storage", "Unique ID of %d is unknown",
+                             int(node_id));
+                index_complete_ = false;
+                continue;
+            }
+            const PackedUniqueID packed(unique_id);
+            unique_ids_[node_id] = packed;
+            const unsigned slot = findIndexSlot(packed);
+            if (index_[slot] != 0)
+            {
+                /*
+                 * The unique ID was allocated more than once, e.g. when the node came back with a different node ID.
+                 * The storage keeps the latest allocation under the unique ID key, so it decides which one is used.
+                 */
+                uint32_t latest_node_id = 0;
+                io.get(StorageMarshaller::convertUniqueIDToHex(unique_id), latest_node_id);
+                UAVCAN_TRACE("dynamic_node_id_server::centralized::Storage", "Unique ID of %d is also at %d, latest %d",
+                             int(node_id), int(index_[slot]), int(latest_node_id));
+                if (latest_node_id != node_id)
+                {
+                    continue;
+                }
+            }
+            index_[slot] = node_id;
+        }
         return 0;
     }
 
@@ -90,6 +171,7 @@ public:
             return -ErrInvalidParam;
         }
 
+        StorageBatch batch(storage_);
         StorageMarshaller io(storage_);
 
         // If next operations fail, we'll get a dangling entry, but it's absolutely OK.
@@ -104,6 +186,17 @@ public:
             {
                 return -ErrFailure;
             }
+
+            UniqueID unique_id_copy = unique_id;
+            res = io.setAndGetBack(makeUniqueIDKey(node_id), unique_id_copy);
+            if (res < 0)
+            {
+                return res;
+            }
+            if (unique_id_copy != unique_id)
+            {
+                return -ErrFailure;
+            }
         }
 
         // Updating the mask in the storage
@@ -121,17 +214,25 @@ public:
             return -ErrFailure;
         }
 
-        // Updating the cached mask only if the storage was updated successfully
+        // Updating the cached state only if the storage was updated successfully
         occupation_mask_ = new_occupation_mask;
+        addToIndex(node_id, unique_id);
 
         return 0;
     }
 
     /**
      * Returns an invalid node ID if there's no such allocation.
+     * This method does not access the storage backend, unless the storage was written by an older version.
      */
     NodeID getNodeIDForUniqueID(const UniqueID& unique_id) const
     {
+        const uint8_t indexed_node_id = index_[findIndexSlot(PackedUniqueID(unique_id))];
+        if ((indexed_node_id != 0) || index_complete_)
+        {
+            return (indexed_node_id != 0) ? NodeID(indexed_node_id) : NodeID();
+        }
+
         StorageMarshaller io(storage_);
         uint32_t node_id = 0;
         io.get(StorageMarshaller::convertUniqueIDToHex(unique_id), node_id);
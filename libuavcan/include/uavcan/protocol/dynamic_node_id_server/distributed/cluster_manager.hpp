@@ -26,6 +26,15 @@ namespace distributed
 {
 /**
  * This class maintains the cluster state.
+ *
+ * The list of known servers is kept in the storage, so that after a restart the Raft core can contact the other
+ * servers right away instead of waiting for the discovery to complete. The restored servers are not considered
+ * discovered until they have been heard from; until then, they are not advertised in the Discovery messages,
+ * and any of them can be replaced with a server that is actually discovered, so that a stale list can't lock
+ * out a server that has been replaced.
+ *
+ * Upon initialization, a short burst of Discovery messages is published at a higher rate, so that the servers
+ * that are started at the same time learn about each other sooner.
  */
 class ClusterManager : private TimerBase
 {
@@ -38,15 +47,24 @@ private:
                              (const ReceivedDataStructure<Discovery>&)>
         DiscoveryCallback;
 
+    enum { NodeIDBitLength = 7 };
+    enum { ClusterSizeOffsetInStoredServers = NodeIDBitLength * (MaxClusterSize - 1) };
+
+    /// Number of the Discovery messages published at the higher rate upon initialization
+    enum { StartupBurstLength = 3 };
+    enum { StartupBurstPeriodDivider = 10 };
+
     struct Server
     {
         NodeID node_id;
         Log::Index next_index;
         Log::Index match_index;
+        bool confirmed;                 ///< False if restored from the storage and not heard from since
 
         Server()
             : next_index(0)
             , match_index(0)
+            , confirmed(false)
         { }
 
         void resetIndices(const Log& log)
@@ -67,8 +85,10 @@ private:
 
     uint8_t cluster_size_;
     uint8_t num_known_servers_;
+    uint8_t num_startup_broadcasts_left_;
 
     static IStorageBackend::String getStorageKeyForClusterSize() { return "cluster_size"; }
+    static IStorageBackend::String getStorageKeyForServers() { return "cluster_servers"; }
 
     INode&       getNode()       { return discovery_sub_.getNode(); }
     const INode& getNode() const { return discovery_sub_.getNode(); }
@@ -87,6 +107,82 @@ private:
         return NULL;
     }
 
+    Server* findUnconfirmedServer()
+    {
+        for (uint8_t i = 0; i < num_known_servers_; i++)
+        {
+            if (!servers_[i].confirmed)
+            {
+                return &servers_[i];
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * The list is stored as one number, so that it is always updated atomically: 7 bits per node ID, starting from
+     * the least significant bits, followed by the cluster size, which invalidates the list if the cluster has been
+     * reconfigured. Zero node ID marks an unused position.
+     */
+    void storeServers()
+    {
+        StaticAssert<(ClusterSizeOffsetInStoredServers + 4) <= 32>::check();
+        StaticAssert<(MaxClusterSize < 16)>::check();
+
+        uint32_t value = uint32_t(cluster_size_) << ClusterSizeOffsetInStoredServers;
+        for (uint8_t i = 0; i < num_known_servers_; i++)
+        {
+            value |= uint32_t(servers_[i].node_id.get()) << (i * NodeIDBitLength);
+        }
+
+        StorageMarshaller io(storage_);
+        const int res = io.setAndGetBack(getStorageKeyForServers(), value);
+        if (res < 0)
+        {
+            // Not critical - the servers will be discovered again after restart
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::ClusterManager", "Failed to store servers: %d", res);
+        }
+    }
+
+    void restoreServers()
+    {
+        if (storage_.get(getStorageKeyForServers()).empty())
+        {
+            return;
+        }
+
+        StorageMarshaller io(storage_);
+        uint32_t value = 0;
+        const int res = io.get(getStorageKeyForServers(), value);
+        if ((res < 0) || ((value >> ClusterSizeOffsetInStoredServers) != cluster_size_))
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::ClusterManager", "Stored servers are discarded");
+            return;
+        }
+
+        for (uint8_t i = 0; i < (cluster_size_ - 1); i++)
+        {
+            const NodeID node_id(uint8_t((value >> (i * NodeIDBitLength)) & NodeID::Max));
+            if (node_id.isUnicast() && !isKnownServer(node_id))
+            {
+                servers_[num_known_servers_].node_id = node_id;
+                servers_[num_known_servers_].confirmed = false;
+                num_known_servers_ = static_cast<uint8_t>(num_known_servers_ + 1U);
+            }
+        }
+
+        tracer_.onEvent(TraceRaftServersRestored, num_known_servers_);
+    }
+
+    void confirmServer(NodeID node_id)
+    {
+        Server* const s = findServer(node_id);
+        if (s != NULL)
+        {
+            s->confirmed = true;
+        }
+    }
+
     virtual void handleTimerEvent(const TimerEvent&)
     {
         UAVCAN_ASSERT(num_known_servers_ < cluster_size_);
@@ -95,6 +191,7 @@ private:
 
         /*
          * Filling the message
+         * The servers that were restored from the storage are not advertised, since they may no longer exist.
          */
         Discovery msg;
         msg.configured_cluster_size = cluster_size_;
@@ -104,10 +201,13 @@ private:
         for (uint8_t i = 0; i < num_known_servers_; i++)
         {
             UAVCAN_ASSERT(servers_[i].node_id.isUnicast());
-            msg.known_nodes.push_back(servers_[i].node_id.get());
+            if (servers_[i].confirmed)
+            {
+                msg.known_nodes.push_back(servers_[i].node_id.get());
+            }
         }
 
-        UAVCAN_ASSERT(msg.known_nodes.size() == (num_known_servers_ + 1));
+        UAVCAN_ASSERT(msg.known_nodes.size() <= (num_known_servers_ + 1));
 
         /*
          * Broadcasting
@@ -123,6 +223,20 @@ private:
             getNode().registerInternalFailure("Raft discovery broadcast");
         }
 
+        /*
+         * The startup burst is always published completely, since the other servers may need it to discover
+         * this one, then the normal rate applies.
+         */
+        if (num_startup_broadcasts_left_ > 0)
+        {
+            num_startup_broadcasts_left_--;
+            if (num_startup_broadcasts_left_ > 0)
+            {
+                return;
+            }
+            startPeriodic(MonotonicDuration::fromMSec(Discovery::BROADCASTING_PERIOD_MS));
+        }
+
         /*
          * Termination condition
          */
@@ -151,16 +265,18 @@ private:
 
         /*
          * Updating the set of known servers
+         * The sender advertises only the servers it has heard from, so they are confirmed as well.
          */
+        confirmServer(msg.getSrcNodeID());
+
         for (uint8_t i = 0; i < msg.known_nodes.size(); i++)
         {
-            if (isClusterDiscovered())
+            const NodeID node_id(msg.known_nodes[i]);
+            if (isKnownServer(node_id))
             {
-                break;
+                confirmServer(node_id);
             }
-
-            const NodeID node_id(msg.known_nodes[i]);
-            if (node_id.isUnicast() && !isKnownServer(node_id))
+            else if (node_id.isUnicast() && !isClusterDiscovered())
             {
                 addServer(node_id);
             }
@@ -200,11 +316,13 @@ public:
         , discovery_pub_(node)
         , cluster_size_(0)
         , num_known_servers_(0)
+        , num_startup_broadcasts_left_(0)
     { }
 
     /**
      * If cluster_size is set to ClusterSizeUnknown, the class will try to read this parameter from the
      * storage backend using key 'cluster_size'.
+     * The list of known servers is restored from the storage if it was stored with the same cluster size.
      * Returns negative error code.
      */
     int init(const uint8_t init_cluster_size, const TransferPriority priority)
@@ -255,6 +373,8 @@ public:
         UAVCAN_ASSERT(cluster_size_ > 0);
         UAVCAN_ASSERT(cluster_size_ <= MaxClusterSize);
 
+        restoreServers();
+
         /*
          * Initializing pub/sub and timer
          */
@@ -270,7 +390,15 @@ public:
             return res;
         }
 
-        startDiscoveryPublishingTimerIfNotRunning();
+        if (cluster_size_ > 1)
+        {
+            num_startup_broadcasts_left_ = StartupBurstLength;
+            startPeriodic(MonotonicDuration::fromMSec(Discovery::BROADCASTING_PERIOD_MS / StartupBurstPeriodDivider));
+        }
+        else
+        {
+            startDiscoveryPublishingTimerIfNotRunning();
+        }
 
         /*
          * Misc
@@ -281,16 +409,37 @@ public:
 
     /**
      * Adds once server regardless of the discovery logic.
+     * If the list is full, the server replaces one of those restored from the storage that were not heard from.
+     * The list is written to the storage.
      */
     void addServer(NodeID node_id)
     {
-        UAVCAN_ASSERT((num_known_servers_ + 1) < MaxClusterSize);
+        UAVCAN_ASSERT(!isClusterDiscovered());
         if (!isKnownServer(node_id) && node_id.isUnicast())
         {
-            tracer_.onEvent(TraceRaftNewServerDiscovered, node_id.get());
-            servers_[num_known_servers_].node_id = node_id;
-            servers_[num_known_servers_].resetIndices(log_);
-            num_known_servers_ = static_cast<uint8_t>(num_known_servers_ + 1U);
+            Server* s = NULL;
+            if ((num_known_servers_ + 1) < cluster_size_)
+            {
+                s = &servers_[num_known_servers_];
+                num_known_servers_ = static_cast<uint8_t>(num_known_servers_ + 1U);
+            }
+            else
+            {
+                s = findUnconfirmedServer();
+            }
+
+            if (s != NULL)
+            {
+                tracer_.onEvent(TraceRaftNewServerDiscovered, node_id.get());
+                s->node_id = node_id;
+                s->confirmed = true;
+                s->resetIndices(log_);
+                storeServers();
+            }
+            else
+            {
+                UAVCAN_ASSERT(0);
+            }
         }
         else
         {
@@ -413,7 +562,7 @@ public:
 
     /**
      * Number of known servers can only grow, and it never exceeds the cluster size value.
-     * This number does not include the local server.
+     * This number does not include the local server, and it includes the servers restored from the storage.
      */
     uint8_t getNumKnownServers() const { return num_known_servers_; }
 
@@ -423,7 +572,14 @@ public:
     uint8_t getClusterSize() const { return cluster_size_; }
     uint8_t getQuorumSize() const { return static_cast<uint8_t>(cluster_size_ / 2U + 1U); }
 
-    bool isClusterDiscovered() const { return num_known_servers_ == (cluster_size_ - 1); }
+    /**
+     * Whether all servers are known and have been heard from since initialization.
+     */
+    bool isClusterDiscovered() const
+    {
+        return (num_known_servers_ == (cluster_size_ - 1)) &&
+               (const_cast<ClusterManager*>(this)->findUnconfirmedServer() == NULL);
+    }
 };
 
 }
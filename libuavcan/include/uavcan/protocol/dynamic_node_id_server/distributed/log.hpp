@@ -35,6 +35,60 @@ private:
     Entry entries_[Capacity];
     Index last_index_;             // Index zero always contains an empty entry
 
+    /*
+     * Indices of the latest entries per node ID and per unique ID, so that the lookups done by the server for every
+     * allocation request don't have to scan the log. The unique ID index is an open addressing hash table with
+     * linear probing; it has twice as many slots as the log capacity, so it never fills up.
+     * Both indices are only appended to, and rebuilt from scratch when entries are removed.
+     */
+    enum { UniqueIDIndexSize = Capacity * 2 };
+    enum { NoIndex = 0xFF };
+
+    Index node_id_index_[NodeID::Max + 1];
+    Index unique_id_index_[UniqueIDIndexSize];
+    PackedUniqueID packed_unique_ids_[Capacity];   ///< Unique IDs of the entries, for the index lookups
+
+    static unsigned computeUniqueIDIndexSlot(const PackedUniqueID& unique_id)
+    {
+        return unique_id.computeHash() % UniqueIDIndexSize;
+    }
+
+    void addEntryToIndex(Index index)
+    {
+        const Entry& entry = entries_[index];
+
+        if (entry.node_id <= NodeID::Max)
+        {
+            node_id_index_[entry.node_id] = index;
+        }
+
+        const PackedUniqueID unique_id(entry.unique_id);
+        packed_unique_ids_[index] = unique_id;
+
+        unsigned slot = computeUniqueIDIndexSlot(unique_id);
+        while (unique_id_index_[slot] != NoIndex && packed_unique_ids_[unique_id_index_[slot]] != unique_id)
+        {
+            slot = (slot + 1U) % UniqueIDIndexSize;
+        }
+        unique_id_index_[slot] = index;
+    }
+
+    void rebuildIndex()
+    {
+        for (unsigned i = 0; i <= NodeID::Max; i++)
+        {
+            node_id_index_[i] = NoIndex;
+        }
+        for (unsigned i = 0; i < UniqueIDIndexSize; i++)
+        {
+            unique_id_index_[i] = NoIndex;
+        }
+        for (unsigned index = 0; index <= last_index_; index++)
+        {
+            addEntryToIndex(Index(index));
+        }
+    }
+
     static IStorageBackend::String getLastIndexKey() { return "log_last_index"; }
 
     static IStorageBackend::String makeEntryKey(Index index, const char* postfix)
@@ -48,10 +102,51 @@ private:
         return str;
     }
 
+    /*
+     * If the backend supports binary values, every entry is stored as a single record under the key "log<N>_entry":
+     * term (4 bytes), unique ID (16 bytes), node ID (4 bytes). Otherwise, every field has its own key.
+     */
+    static IStorageBackend::String encodeEntry(const Entry& entry)
+    {
+        IStorageBackend::String record;
+        const bool ok = StorageMarshaller::appendBinary(record, entry.term) &&
+                        StorageMarshaller::appendBinary(record, entry.unique_id) &&
+                        StorageMarshaller::appendBinary(record, uint32_t(entry.node_id));
+        UAVCAN_ASSERT(ok);
+        (void)ok;
+        return record;
+    }
+
+    static int decodeEntry(const IStorageBackend::String& record, Entry& out_entry)
+    {
+        unsigned offset = 0;
+        uint32_t node_id = 0;
+        if (!StorageMarshaller::readBinary(record, offset, out_entry.term) ||
+            !StorageMarshaller::readBinary(record, offset, out_entry.unique_id) ||
+            !StorageMarshaller::readBinary(record, offset, node_id) ||
+            (offset != record.size()) ||
+            (node_id > NodeID::Max))
+        {
+            return -ErrFailure;
+        }
+        out_entry.node_id = static_cast<uint8_t>(node_id);
+        return 0;
+    }
+
     int readEntryFromStorage(Index index, Entry& out_entry)
     {
         const StorageMarshaller io(storage_);
 
+        if (storage_.supportsBinaryValues())
+        {
+            const IStorageBackend::String record = storage_.get(makeEntryKey(index, "entry"));
+            if (!record.empty())
+            {
+                return decodeEntry(record, out_entry);
+            }
+            // Not found - the entry may have been written in text form, before binary values were enabled
+        }
+
         // Term
         if (io.get(makeEntryKey(index, "term"), out_entry.term) < 0)
         {
@@ -85,6 +180,16 @@ private:
 
         StorageMarshaller io(storage_);
 
+        if (storage_.supportsBinaryValues())
+        {
+            IStorageBackend::String record = encodeEntry(entry);
+            if ((io.setAndGetBack(makeEntryKey(index, "entry"), record) < 0) || (decodeEntry(record, temp) < 0))
+            {
+                return -ErrFailure;
+            }
+            return (temp == entry) ? 0 : -ErrFailure;
+        }
+
         // Term
         if (io.setAndGetBack(makeEntryKey(index, "term"), temp.term) < 0)
         {
@@ -110,6 +215,7 @@ private:
 
     int initEmptyLogStorage()
     {
+        StorageBatch batch(storage_);
         StorageMarshaller io(storage_);
 
         /*
@@ -147,7 +253,10 @@ public:
         : storage_(storage)
         , tracer_(tracer)
         , last_index_(0)
-    { }
+    {
+        StaticAssert<(unsigned(Capacity) < unsigned(NoIndex))>::check();
+        rebuildIndex();
+    }
 
     int init()
     {
@@ -190,6 +299,7 @@ public:
                 return result;
             }
         }
+        rebuildIndex();
 
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Restored %u log entries", unsigned(last_index_));
         return 0;
@@ -208,6 +318,8 @@ public:
 
         tracer_.onEvent(TraceRaftLogAppend, last_index_ + 1U);
 
+        StorageBatch batch(storage_);
+
         // If next operations fail, we'll get a dangling entry, but it's absolutely OK.
         int res = writeEntryToStorage(Index(last_index_ + 1), entry);
         if (res < 0)
@@ -229,6 +341,7 @@ public:
         }
         entries_[new_last_index] = entry;
         last_index_ = Index(new_last_index);
+        addEntryToIndex(last_index_);
 
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "New entry, index %u, node ID %u, term %u",
                      unsigned(last_index_), unsigned(entry.node_id), unsigned(entry.term));
@@ -267,6 +380,7 @@ public:
             UAVCAN_TRACE("dynamic_node_id_server::distributed::Log", "Entries removed, last index %u --> %u",
                          unsigned(last_index_), unsigned(new_last_index));
             last_index_ = Index(new_last_index);
+            rebuildIndex();
         }
 
         // Removal operation leaves dangling entries in storage, it's OK
@@ -290,6 +404,31 @@ public:
 
     Index getLastIndex() const { return last_index_; }
 
+    /**
+     * Return the index of the latest entry with the specified node ID or unique ID, or a negative value if there's
+     * no such entry. Same as scanning the log from the end, but in constant time.
+     * These methods do not use storage IO.
+     */
+    int findLastIndexByNodeID(NodeID node_id) const
+    {
+        const Index index = node_id.isValid() ? node_id_index_[node_id.get()] : Index(NoIndex);
+        return (index == NoIndex) ? -ErrFailure : int(index);
+    }
+
+    int findLastIndexByUniqueID(const UniqueID& unique_id) const
+    {
+        const PackedUniqueID packed(unique_id);
+        for (unsigned slot = computeUniqueIDIndexSlot(packed); unique_id_index_[slot] != NoIndex;
+             slot = (slot + 1U) % UniqueIDIndexSize)
+        {
+            if (packed_unique_ids_[unique_id_index_[slot]] == packed)
+            {
+                return int(unique_id_index_[slot]);
+            }
+        }
+        return -ErrFailure;
+    }
+
     bool isOtherLogUpToDate(Index other_last_index, Term other_last_term) const
     {
         UAVCAN_ASSERT(last_index_ < Capacity);
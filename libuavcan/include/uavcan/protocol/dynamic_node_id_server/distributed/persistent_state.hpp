@@ -228,6 +228,34 @@ public:
     }
 
     int resetVotedFor() { return setVotedFor(NodeID(0)); }
+
+    /**
+     * Updates both the current term and votedFor in one storage batch (see @ref StorageBatch), so that a backend
+     * can make them durable at once. The term is written first; should the update be interrupted halfway, the old
+     * vote will be restored with the new term, which may only prevent this node from voting, never let it vote
+     * twice in the same term.
+     * Invokes storage IO.
+     */
+    int setCurrentTermAndVotedFor(Term term, NodeID node_id)
+    {
+        if ((term < current_term_) || !node_id.isValid())
+        {
+            UAVCAN_ASSERT(0);
+            return -ErrInvalidParam;
+        }
+
+        StorageBatch batch(storage_);
+
+        const int res = setCurrentTerm(term);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        return setVotedFor(node_id);
+    }
+
+    int setCurrentTermAndResetVotedFor(Term term) { return setCurrentTermAndVotedFor(term, NodeID(0)); }
 };
 
 }
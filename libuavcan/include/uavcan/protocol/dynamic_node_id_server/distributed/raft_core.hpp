@@ -9,6 +9,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/util/method_binder.hpp>
+#include <uavcan/util/bitset.hpp>
 #include <uavcan/node/timer.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/node/service_client.hpp>
@@ -54,6 +55,26 @@ public:
  *
  * Note that this class uses std::rand(), so the RNG must be properly seeded by the application.
  *
+ * Transient disruptions (a server that was partitioned away or has just rebooted) do not trigger elections:
+ *   - Pre-vote. Once the activity timeout expires, the candidate first asks the other servers whether they would
+ *     vote for it, without incrementing its term. The real election is started only if the quorum agrees,
+ *     otherwise the candidate returns to the follower state with its term intact, so it can't depose the leader
+ *     when it comes back.
+ *     The pre-vote request is a regular RequestVote request with the most significant bit of the last log index set
+ *     (the log index never exceeds 127), carrying the term that precedes the current term of the candidate, or zero.
+ *     The servers that implement pre-vote take the request term plus two for the term of the upcoming election
+ *     (which is one too many if the current term is zero, making the pre-vote slightly more permissive), and grant
+ *     it by responding with that term. A server that doesn't implement pre-vote rejects the request as stale, or,
+ *     if its own term is even older, catches up to a term that is already over; it never responds with the term of
+ *     the upcoming election, so its grants are never counted.
+ *     A mixed cluster could fail to elect a leader if the servers that don't implement pre-vote were necessary to
+ *     pass it, so pre-vote is skipped while any of the known servers is seen not implementing it: that is, once it
+ *     has requested a vote without a preceding pre-vote request, or granted a pre-vote in a wrong term. This is
+ *     undone as soon as the server sends a pre-vote request.
+ *   - Leader lease. A follower that has heard from the leader within the minimum election timeout, or a leader
+ *     that has heard from the quorum within the same interval, denies both pre-vote and vote requests without
+ *     updating its term.
+ *
  * Activity registration:
  *   - persistent state update error
  *   - switch to candidate (this defines timeout between reelections)
@@ -88,6 +109,7 @@ private:
 
     struct PendingAppendEntriesFields
     {
+        NodeID server_node_id;
         Log::Index prev_log_index;
         Log::Index num_entries;
 
@@ -102,6 +124,8 @@ private:
      */
     enum { MaxNumFollowers = ClusterManager::MaxClusterSize - 1 };
 
+    enum { PreVoteFlag = 0x80 };        ///< Set in RequestVote::Request::last_log_index
+
     IEventTracer& tracer_;
     IRaftLeaderMonitor& leader_monitor_;
 
@@ -118,14 +142,21 @@ private:
 
     uint8_t next_server_index_;         ///< Next server to query AE from
     uint8_t num_votes_received_in_this_campaign_;
+    bool pre_vote_;                     ///< The campaign is in the pre-vote phase
+
+    MonotonicTime last_leader_contact_timestamp_;                   ///< Last AppendEntries from the current leader
+    MonotonicTime follower_response_timestamps_[MaxNumFollowers];   ///< Per server index, only if leader
+
+    PendingAppendEntriesFields pending_append_entries_fields_[MaxNumFollowers];
 
-    PendingAppendEntriesFields pending_append_entries_fields_;
+    BitSet<NodeID::Max + 1> pre_vote_requesters_;   ///< Sent a pre-vote request, a vote request is expected next
+    BitSet<NodeID::Max + 1> legacy_servers_;        ///< Servers that are seen not implementing pre-vote
 
     /*
      * Transport
      */
     ServiceServer<AppendEntries, AppendEntriesCallback>         append_entries_srv_;
-    ServiceClient<AppendEntries, AppendEntriesResponseCallback> append_entries_client_;
+    ServiceClient<AppendEntries, AppendEntriesResponseCallback, MaxNumFollowers> append_entries_client_;
     ServiceServer<RequestVote, RequestVoteCallback> request_vote_srv_;
     ServiceClient<RequestVote, RequestVoteResponseCallback, MaxNumFollowers> request_vote_client_;
 
@@ -149,11 +180,11 @@ private:
 
         // Elections
         UAVCAN_ASSERT(server_state_ != ServerStateCandidate || !request_vote_client_.hasPendingCalls() ||
-                      persistent_state_.getVotedFor() == getNode().getNodeID());
+                      pre_vote_ || persistent_state_.getVotedFor() == getNode().getNodeID());
         UAVCAN_ASSERT(num_votes_received_in_this_campaign_ <= cluster_.getClusterSize());
 
         // Transport
-        UAVCAN_ASSERT(append_entries_client_.getNumPendingCalls() <= 1);
+        UAVCAN_ASSERT(append_entries_client_.getNumPendingCalls() <= cluster_.getNumKnownServers());
         UAVCAN_ASSERT(request_vote_client_.getNumPendingCalls() <= cluster_.getNumKnownServers());
         UAVCAN_ASSERT(server_state_ != ServerStateCandidate || !append_entries_client_.hasPendingCalls());
         UAVCAN_ASSERT(server_state_ != ServerStateLeader    || !request_vote_client_.hasPendingCalls());
@@ -182,6 +213,66 @@ private:
         return getNode().getMonotonicTime() > (last_activity_timestamp_ + randomized_activity_timeout_);
     }
 
+    /**
+     * See the class documentation. Candidates never hold the lease.
+     */
+    bool isLeaderLeaseActive() const
+    {
+        const MonotonicTime now = getNode().getMonotonicTime();
+        const MonotonicDuration lease =
+            MonotonicDuration::fromMSec(AppendEntries::Request::DEFAULT_MIN_ELECTION_TIMEOUT_MS);
+
+        if (server_state_ == ServerStateFollower)
+        {
+            return !last_leader_contact_timestamp_.isZero() && (now <= (last_leader_contact_timestamp_ + lease));
+        }
+
+        if (server_state_ == ServerStateLeader)
+        {
+            uint8_t num_servers_in_contact = 1;         // Local node
+            for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
+            {
+                const MonotonicTime ts = follower_response_timestamps_[i];
+                if (!ts.isZero() && (now <= (ts + lease)))
+                {
+                    num_servers_in_contact++;
+                }
+            }
+            return num_servers_in_contact >= cluster_.getQuorumSize();
+        }
+
+        return false;
+    }
+
+    /**
+     * See the class documentation on the terms of the pre-vote requests.
+     */
+    static Term getPreVoteRequestTerm(Term current_term) { return (current_term > 0) ? Term(current_term - 1U) : 0; }
+    static Term getPreVoteElectionTerm(Term request_term) { return Term(request_term + 2U); }
+
+    void registerLegacyServer(NodeID node_id)
+    {
+        if (!legacy_servers_.test(node_id.get()))
+        {
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "Server %d does not implement pre-vote",
+                         int(node_id.get()));
+            trace(TraceRaftPreVoteUnsupported, node_id.get());
+            legacy_servers_.set(node_id.get());
+        }
+    }
+
+    bool isPreVoteSupportedByAllServers() const
+    {
+        for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
+        {
+            if (legacy_servers_.test(cluster_.getRemoteServerNodeIDAtIndex(i).get()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     void handlePersistentStateUpdateError(int error)
     {
         UAVCAN_ASSERT(error < 0);
@@ -199,9 +290,104 @@ private:
         }
     }
 
+    void requestVotes(const RequestVote::Request& req)
+    {
+        for (uint8_t i = 0; i < MaxNumFollowers; i++)
+        {
+            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(i);
+            if (!node_id.isUnicast())
+            {
+                break;
+            }
+
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore",
+                         "Requesting %svote from %d", pre_vote_ ? "pre-" : "", int(node_id.get()));
+            trace(TraceRaftVoteRequestInitiation, node_id.get());
+
+            const int res = request_vote_client_.call(node_id, req);
+            if (res < 0)
+            {
+                trace(TraceError, res);
+            }
+        }
+    }
+
+    void startPreVote()
+    {
+        UAVCAN_ASSERT(pre_vote_);
+        num_votes_received_in_this_campaign_ = 1;               // Voting for self
+
+        // Nothing is persisted; the term is chosen so that the servers without pre-vote reject the request
+        RequestVote::Request req;
+        req.last_log_index = persistent_state_.getLog().getLastIndex();
+        req.last_log_term = persistent_state_.getLog().getEntryAtIndex(req.last_log_index)->term;
+        req.last_log_index = static_cast<uint8_t>(req.last_log_index | PreVoteFlag);
+        req.term = getPreVoteRequestTerm(persistent_state_.getCurrentTerm());
+
+        requestVotes(req);
+    }
+
+    void startElection()
+    {
+        UAVCAN_ASSERT(!pre_vote_);
+
+        // Increment current term and vote for self, abort on failure
+        const int res = persistent_state_.setCurrentTermAndVotedFor(persistent_state_.getCurrentTerm() + 1U,
+                                                                    getNode().getNodeID());
+        if (res < 0)
+        {
+            handlePersistentStateUpdateError(res);
+            return;
+        }
+
+        num_votes_received_in_this_campaign_ = 1;               // Voting for self
+
+        RequestVote::Request req;
+        req.last_log_index = persistent_state_.getLog().getLastIndex();
+        req.last_log_term = persistent_state_.getLog().getEntryAtIndex(req.last_log_index)->term;
+        req.term = persistent_state_.getCurrentTerm();
+
+        requestVotes(req);
+    }
+
     void updateCandidate()
     {
-        if (num_votes_received_in_this_campaign_ > 0)
+        if (num_votes_received_in_this_campaign_ == 0)
+        {
+            if (pre_vote_ && !isPreVoteSupportedByAllServers())
+            {
+                UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "Pre-vote skipped");
+                pre_vote_ = false;
+            }
+            if (pre_vote_)
+            {
+                startPreVote();
+            }
+            else
+            {
+                startElection();
+            }
+        }
+        else if (pre_vote_)
+        {
+            trace(TraceRaftPreVoteComplete, num_votes_received_in_this_campaign_);
+            const bool passed = num_votes_received_in_this_campaign_ >= cluster_.getQuorumSize();
+
+            UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore", "Pre-vote complete, passed: %d",
+                         int(passed));
+
+            if (passed)
+            {
+                request_vote_client_.cancelAllCalls();
+                pre_vote_ = false;
+                startElection();
+            }
+            else
+            {
+                switchState(ServerStateFollower);           // Start over later, the term is left intact
+            }
+        }
+        else
         {
             trace(TraceRaftElectionComplete, num_votes_received_in_this_campaign_);
             const bool won = num_votes_received_in_this_campaign_ >= cluster_.getQuorumSize();
@@ -210,50 +396,75 @@ private:
 
             switchState(won ? ServerStateLeader : ServerStateFollower);       // Start over or become leader
         }
-        else
+    }
+
+    PendingAppendEntriesFields* findPendingAppendEntriesFields(NodeID server_node_id)
+    {
+        for (uint8_t i = 0; i < MaxNumFollowers; i++)
         {
-            // Set votedFor, abort on failure
-            int res = persistent_state_.setVotedFor(getNode().getNodeID());
-            if (res < 0)
+            if (pending_append_entries_fields_[i].server_node_id == server_node_id)
             {
-                handlePersistentStateUpdateError(res);
-                return;
+                return &pending_append_entries_fields_[i];
             }
+        }
+        return NULL;
+    }
 
-            // Increment current term, abort on failure
-            res = persistent_state_.setCurrentTerm(persistent_state_.getCurrentTerm() + 1U);
-            if (res < 0)
-            {
-                handlePersistentStateUpdateError(res);
-                return;
-            }
+    void resetPendingAppendEntriesFields()
+    {
+        for (uint8_t i = 0; i < MaxNumFollowers; i++)
+        {
+            pending_append_entries_fields_[i] = PendingAppendEntriesFields();
+        }
+    }
 
-            num_votes_received_in_this_campaign_ = 1;               // Voting for self
+    /**
+     * Sends the entries the follower is missing, as many as fit into one request, or an empty heartbeat request.
+     * Returns false if the log is inconsistent, in which case the persistent state error has been handled already.
+     */
+    bool sendAppendEntries(uint8_t server_index, NodeID node_id)
+    {
+        UAVCAN_ASSERT(server_index < MaxNumFollowers);
+        UAVCAN_ASSERT(node_id.isUnicast());
 
-            RequestVote::Request req;
-            req.last_log_index = persistent_state_.getLog().getLastIndex();
-            req.last_log_term = persistent_state_.getLog().getEntryAtIndex(req.last_log_index)->term;
-            req.term = persistent_state_.getCurrentTerm();
+        AppendEntries::Request req;
+        req.term = persistent_state_.getCurrentTerm();
+        req.leader_commit = commit_index_;
 
-            for (uint8_t i = 0; i < MaxNumFollowers; i++)
-            {
-                const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(i);
-                if (!node_id.isUnicast())
-                {
-                    break;
-                }
+        req.prev_log_index = Log::Index(cluster_.getServerNextIndex(node_id) - 1U);
 
-                UAVCAN_TRACE("dynamic_node_id_server::distributed::RaftCore",
-                             "Requesting vote from %d", int(node_id.get()));
-                trace(TraceRaftVoteRequestInitiation, node_id.get());
+        const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(req.prev_log_index);
+        if (entry == NULL)
+        {
+            UAVCAN_ASSERT(0);
+            handlePersistentStateUpdateError(-ErrLogic);
+            return false;
+        }
 
-                res = request_vote_client_.call(node_id, req);
-                if (res < 0)
-                {
-                    trace(TraceError, res);
-                }
+        req.prev_log_term = entry->term;
+
+        for (Log::Index index = cluster_.getServerNextIndex(node_id);
+             index <= persistent_state_.getLog().getLastIndex();
+             index++)
+        {
+            req.entries.push_back(*persistent_state_.getLog().getEntryAtIndex(index));
+            if (req.entries.size() == req.entries.capacity())
+            {
+                break;
             }
         }
+
+        PendingAppendEntriesFields& pending = pending_append_entries_fields_[server_index];
+        pending.server_node_id = node_id;
+        pending.num_entries = req.entries.size();
+        pending.prev_log_index = req.prev_log_index;
+
+        const int res = append_entries_client_.call(node_id, req);
+        if (res < 0)
+        {
+            trace(TraceRaftAppendEntriesCallFailure, res);
+        }
+        return true;
     }
 
     void updateLeader()
@@ -262,11 +473,16 @@ private:
         {
             append_entries_client_.cancelAllCalls();    // Refer to the response callback to learn why
         }
+        resetPendingAppendEntriesFields();
 
         if (cluster_.getClusterSize() > 1)
         {
-            const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(next_server_index_);
-            UAVCAN_ASSERT(node_id.isUnicast());
+            /*
+             * Heartbeats are sent to one server per update interval in a round robin fashion, as the specification
+             * requires. The followers whose logs are behind are updated in parallel at every update interval
+             * though, so that a burst of allocations gets replicated to the whole cluster as fast as possible.
+             */
+            const uint8_t heartbeat_server_index = next_server_index_;
 
             next_server_index_++;
             if (next_server_index_ >= cluster_.getNumKnownServers())
@@ -274,41 +490,17 @@ private:
                 next_server_index_ = 0;
             }
 
-            AppendEntries::Request req;
-            req.term = persistent_state_.getCurrentTerm();
-            req.leader_commit = commit_index_;
-
-            req.prev_log_index = Log::Index(cluster_.getServerNextIndex(node_id) - 1U);
-
-            const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(req.prev_log_index);
-            if (entry == NULL)
+            for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
             {
-                UAVCAN_ASSERT(0);
-                handlePersistentStateUpdateError(-ErrLogic);
-                return;
-            }
-
-            req.prev_log_term = entry->term;
+                const NodeID node_id = cluster_.getRemoteServerNodeIDAtIndex(i);
+                UAVCAN_ASSERT(node_id.isUnicast());
 
-            for (Log::Index index = cluster_.getServerNextIndex(node_id);
-                 index <= persistent_state_.getLog().getLastIndex();
-                 index++)
-            {
-                req.entries.push_back(*persistent_state_.getLog().getEntryAtIndex(index));
-                if (req.entries.size() == req.entries.capacity())
+                const bool lagging = cluster_.getServerNextIndex(node_id) <= persistent_state_.getLog().getLastIndex();
+                if ((i == heartbeat_server_index || lagging) && !sendAppendEntries(i, node_id))
                 {
-                    break;
+                    return;
                 }
             }
-
-            pending_append_entries_fields_.num_entries = req.entries.size();
-            pending_append_entries_fields_.prev_log_index = req.prev_log_index;
-
-            const int res = append_entries_client_.call(node_id, req);
-            if (res < 0)
-            {
-                trace(TraceRaftAppendEntriesCallFailure, res);
-            }
         }
 
         propagateCommitIndex();
@@ -341,6 +533,12 @@ private:
 
         next_server_index_ = 0;
         num_votes_received_in_this_campaign_ = 0;
+        pre_vote_ = true;
+
+        for (uint8_t i = 0; i < MaxNumFollowers; i++)
+        {
+            follower_response_timestamps_[i] = MonotonicTime();
+        }
 
         request_vote_client_.cancelAllCalls();
         append_entries_client_.cancelAllCalls();
@@ -359,7 +557,7 @@ private:
     void tryIncrementCurrentTermFromResponse(Term new_term)
     {
         trace(TraceRaftNewerTermInResponse, new_term);
-        const int res = persistent_state_.setCurrentTerm(new_term);
+        const int res = persistent_state_.setCurrentTermAndResetVotedFor(new_term);
         if (res < 0)
         {
             trace(TraceRaftPersistStateUpdateError, res);
@@ -429,15 +627,7 @@ private:
          */
         if (request.term > persistent_state_.getCurrentTerm())
         {
-            int res = persistent_state_.setCurrentTerm(request.term);
-            if (res < 0)
-            {
-                handlePersistentStateUpdateError(res);
-                response.setResponseEnabled(false);
-                return;
-            }
-
-            res = persistent_state_.resetVotedFor();
+            const int res = persistent_state_.setCurrentTermAndResetVotedFor(request.term);
             if (res < 0)
             {
                 handlePersistentStateUpdateError(res);
@@ -464,6 +654,7 @@ private:
 
         registerActivity();
         switchState(ServerStateFollower);
+        last_leader_contact_timestamp_ = getNode().getMonotonicTime();
 
         /*
          * Step 2
@@ -543,19 +734,34 @@ private:
             return;
         }
 
+        PendingAppendEntriesFields* const pending = findPendingAppendEntriesFields(result.getCallID().server_node_id);
+        if (pending == NULL)
+        {
+            UAVCAN_ASSERT(0);       // The calls are cancelled when the pending fields are reset
+            return;
+        }
+        const PendingAppendEntriesFields fields = *pending;
+        *pending = PendingAppendEntriesFields();
+
         if (result.getResponse().term > persistent_state_.getCurrentTerm())
         {
             tryIncrementCurrentTermFromResponse(result.getResponse().term);
         }
         else
         {
+            for (uint8_t i = 0; i < cluster_.getNumKnownServers(); i++)
+            {
+                if (cluster_.getRemoteServerNodeIDAtIndex(i) == result.getCallID().server_node_id)
+                {
+                    follower_response_timestamps_[i] = getNode().getMonotonicTime();
+                }
+            }
+
             if (result.getResponse().success)
             {
-                cluster_.incrementServerNextIndexBy(result.getCallID().server_node_id,
-                                                    pending_append_entries_fields_.num_entries);
+                cluster_.incrementServerNextIndexBy(result.getCallID().server_node_id, fields.num_entries);
                 cluster_.setServerMatchIndex(result.getCallID().server_node_id,
-                                             Log::Index(pending_append_entries_fields_.prev_log_index +
-                                                        pending_append_entries_fields_.num_entries));
+                                             Log::Index(fields.prev_log_index + fields.num_entries));
             }
             else
             {
@@ -564,7 +770,6 @@ private:
             }
         }
 
-        pending_append_entries_fields_ = PendingAppendEntriesFields();
         // Rest of the logic is implemented in periodic update handlers.
     }
 
@@ -583,6 +788,53 @@ private:
 
         UAVCAN_ASSERT(response.isResponseEnabled());  // This is default
 
+        const bool pre_vote = (request.last_log_index & PreVoteFlag) != 0;
+        const Log::Index last_log_index = static_cast<Log::Index>(request.last_log_index & ~PreVoteFlag);
+
+        /*
+         * Telling apart the servers that don't implement pre-vote - they request votes without pre-vote requests.
+         */
+        if (pre_vote)
+        {
+            pre_vote_requesters_.set(request.getSrcNodeID().get());
+            legacy_servers_.set(request.getSrcNodeID().get(), false);
+        }
+        else
+        {
+            if (!pre_vote_requesters_.test(request.getSrcNodeID().get()))
+            {
+                registerLegacyServer(request.getSrcNodeID());
+            }
+            pre_vote_requesters_.set(request.getSrcNodeID().get(), false);
+        }
+
+        /*
+         * Leader lease - the current leader is alive, so the request is denied without updating the term.
+         */
+        if (isLeaderLeaseActive())
+        {
+            trace(TraceRaftVoteRequestLeaseDenied, request.getSrcNodeID().get());
+            response.term = persistent_state_.getCurrentTerm();
+            response.vote_granted = false;
+            return;
+        }
+
+        /*
+         * Pre-vote - telling whether we would grant the vote, the local state is not changed.
+         */
+        if (pre_vote)
+        {
+            const Term election_term = getPreVoteElectionTerm(request.term);
+            const bool can_vote = (election_term > persistent_state_.getCurrentTerm()) ||
+                                  !persistent_state_.isVotedForSet() ||
+                                  (persistent_state_.getVotedFor() == request.getSrcNodeID());
+
+            response.vote_granted = (election_term >= persistent_state_.getCurrentTerm()) && can_vote &&
+                persistent_state_.getLog().isOtherLogUpToDate(last_log_index, request.last_log_term);
+            response.term = response.vote_granted ? election_term : persistent_state_.getCurrentTerm();
+            return;
+        }
+
         /*
          * Checking if our current state is up to date.
          * The request will be ignored if persistent state cannot be updated.
@@ -591,15 +843,7 @@ private:
         {
             switchState(ServerStateFollower);   // Our term is stale, so we can't serve as leader
 
-            int res = persistent_state_.setCurrentTerm(request.term);
-            if (res < 0)
-            {
-                handlePersistentStateUpdateError(res);
-                response.setResponseEnabled(false);
-                return;
-            }
-
-            res = persistent_state_.resetVotedFor();
+            const int res = persistent_state_.setCurrentTermAndResetVotedFor(request.term);
             if (res < 0)
             {
                 handlePersistentStateUpdateError(res);
@@ -622,7 +866,7 @@ private:
             const bool can_vote = !persistent_state_.isVotedForSet() ||
                                   (persistent_state_.getVotedFor() == request.getSrcNodeID());
             const bool log_is_up_to_date =
-                persistent_state_.getLog().isOtherLogUpToDate(request.last_log_index, request.last_log_term);
+                persistent_state_.getLog().isOtherLogUpToDate(last_log_index, request.last_log_term);
 
             response.vote_granted = can_vote && log_is_up_to_date;
 
@@ -654,7 +898,19 @@ private:
 
         trace(TraceRaftVoteRequestSucceeded, result.getCallID().server_node_id.get());
 
-        if (result.getResponse().term > persistent_state_.getCurrentTerm())
+        if (pre_vote_ && result.getResponse().vote_granted)
+        {
+            const Term request_term = getPreVoteRequestTerm(persistent_state_.getCurrentTerm());
+            if (result.getResponse().term == getPreVoteElectionTerm(request_term))
+            {
+                num_votes_received_in_this_campaign_++;
+            }
+            else
+            {
+                registerLegacyServer(result.getCallID().server_node_id);    // It has granted a real vote instead
+            }
+        }
+        else if (result.getResponse().term > persistent_state_.getCurrentTerm())
         {
             tryIncrementCurrentTermFromResponse(result.getResponse().term);
         }
@@ -715,11 +971,14 @@ public:
         , server_state_(ServerStateFollower)
         , next_server_index_(0)
         , num_votes_received_in_this_campaign_(0)
+        , pre_vote_(true)
         , append_entries_srv_(node)
         , append_entries_client_(node)
         , request_vote_srv_(node)
         , request_vote_client_(node)
-    { }
+    {
+        StaticAssert<(unsigned(Log::Capacity) <= unsigned(PreVoteFlag))>::check();
+    }
 
     /**
      * Once started, the logic runs in the background until destructor is called.
@@ -735,7 +994,11 @@ public:
         server_state_ = ServerStateFollower;
         next_server_index_ = 0;
         num_votes_received_in_this_campaign_ = 0;
+        pre_vote_ = true;
+        last_leader_contact_timestamp_ = MonotonicTime();
         commit_index_ = 0;
+        pre_vote_requesters_.reset();
+        legacy_servers_.reset();
 
         registerActivity();
 
@@ -864,6 +1127,20 @@ public:
         { }
     };
 
+private:
+    LazyConstructor<LogEntryInfo> makeLogEntryInfo(int index) const
+    {
+        LazyConstructor<LogEntryInfo> ret;
+        if (index >= 0)
+        {
+            const Entry* const entry = persistent_state_.getLog().getEntryAtIndex(Log::Index(index));
+            UAVCAN_ASSERT(entry != NULL);
+            ret.construct<const LogEntryInfo&>(LogEntryInfo(*entry, Log::Index(index) <= commit_index_));
+        }
+        return ret;
+    }
+
+public:
     /**
      * This method is used by the allocator to query existence of certain entries in the Raft log.
      * Predicate is a callable of the following prototype:
@@ -892,6 +1169,20 @@ public:
         return LazyConstructor<LogEntryInfo>();
     }
 
+    /**
+     * Same as @ref traverseLogFromEndUntil() with a predicate that matches the node ID or the unique ID of the
+     * entry, but these methods use the indices maintained by the log instead of scanning it.
+     */
+    LazyConstructor<LogEntryInfo> findLastLogEntryByNodeID(NodeID node_id) const
+    {
+        return makeLogEntryInfo(persistent_state_.getLog().findLastIndexByNodeID(node_id));
+    }
+
+    LazyConstructor<LogEntryInfo> findLastLogEntryByUniqueID(const UniqueID& unique_id) const
+    {
+        return makeLogEntryInfo(persistent_state_.getLog().findLastIndexByUniqueID(unique_id));
+    }
+
     Log::Index getNumAllocations() const
     {
         // Remember that index zero contains a special-purpose entry that doesn't count as allocation
@@ -27,34 +27,6 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
                            , INodeDiscoveryHandler
                            , IRaftLeaderMonitor
 {
-    struct UniqueIDLogPredicate
-    {
-        const UniqueID unique_id;
-
-        UniqueIDLogPredicate(const UniqueID& uid)
-            : unique_id(uid)
-        { }
-
-        bool operator()(const RaftCore::LogEntryInfo& info) const
-        {
-            return info.entry.unique_id == unique_id;
-        }
-    };
-
-    struct NodeIDLogPredicate
-    {
-        const NodeID node_id;
-
-        NodeIDLogPredicate(const NodeID& nid)
-            : node_id(nid)
-        { }
-
-        bool operator()(const RaftCore::LogEntryInfo& info) const
-        {
-            return info.entry.node_id == node_id.get();
-        }
-    };
-
     /*
      * Constants
      */
@@ -108,7 +80,7 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
          * otherwise the request will be ignored because only leader can add new allocations.
          */
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(UniqueIDLogPredicate(unique_id));
+            raft_core_.findLastLogEntryByUniqueID(unique_id);
 
          if (result.isConstructed())
          {
@@ -135,6 +107,17 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
          }
     }
 
+    virtual bool handleKnownAllocationRequest(const UniqueID& unique_id)
+    {
+        const LazyConstructor<RaftCore::LogEntryInfo> result = raft_core_.findLastLogEntryByUniqueID(unique_id);
+        if (!result.isConstructed() || !result->committed)
+        {
+            return false;
+        }
+        tryPublishAllocationResult(result->entry);
+        return true;
+    }
+
     /*
      * Methods of INodeDiscoveryHandler
      */
@@ -146,7 +129,7 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
     virtual NodeAwareness checkNodeAwareness(NodeID node_id) const
     {
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id));
+            raft_core_.findLastLogEntryByNodeID(node_id);
         if (result.isConstructed())
         {
             return result->committed ? NodeAwarenessKnownAndCommitted : NodeAwarenessKnownButNotCommitted;
@@ -159,7 +142,7 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
 
     virtual void handleNewNodeDiscovery(const UniqueID* unique_id_or_null, NodeID node_id)
     {
-        if (raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id)).isConstructed())
+        if (raft_core_.findLastLogEntryByNodeID(node_id).isConstructed())
         {
             UAVCAN_ASSERT(0);   // Such node is already known, the class that called this method should have known that
             return;
@@ -192,7 +175,7 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
         }
 
         const LazyConstructor<RaftCore::LogEntryInfo> result =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_.getNodeID()));
+            raft_core_.findLastLogEntryByNodeID(node_.getNodeID());
 
         if (!result.isConstructed())
         {
@@ -207,7 +190,7 @@ class UAVCAN_EXPORT Server : IAllocationRequestHandler
     {
         UAVCAN_TRACE("dynamic_node_id_server::distributed::Server",
                      "Testing if node ID %d is taken", int(node_id.get()));
-        return raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_id));
+        return raft_core_.findLastLogEntryByNodeID(node_id);
     }
 
     void allocateNewNode(const UniqueID& unique_id, const NodeID preferred_node_id)
@@ -265,7 +248,7 @@ public:
         own_unique_id_ = own_unique_id;
 
         const LazyConstructor<RaftCore::LogEntryInfo> own_log_entry =
-            raft_core_.traverseLogFromEndUntil(NodeIDLogPredicate(node_.getNodeID()));
+            raft_core_.findLastLogEntryByNodeID(node_.getNodeID());
 
         if (own_log_entry.isConstructed())
         {
@@ -284,6 +267,15 @@ public:
             return res;
         }
 
+        for (Log::Index index = 1; index <= raft_core_.getPersistentState().getLog().getLastIndex(); index++)
+        {
+            const Entry* const entry = raft_core_.getPersistentState().getLog().getEntryAtIndex(index);
+            if ((entry != NULL) && NodeID(entry->node_id).isUnicast())
+            {
+                allocation_request_manager_.addKnownUniqueID(entry->unique_id);
+            }
+        }
+
         res = node_discoverer_.init(priority);
         if (res < 0)
         {
@@ -38,7 +38,7 @@ enum UAVCAN_EXPORT TraceCode
     TraceRaftCoreInited,                // update interval in usec
     TraceRaftStateSwitch,               // 0 - Follower, 1 - Candidate, 2 - Leader
     // 15
-    Trace0,
+    TraceRaftServersRestored,           // number of servers restored from the storage
     TraceRaftNewLogEntry,               // node ID value
     TraceRaftRequestIgnored,            // node ID of the client
     TraceRaftVoteRequestReceived,       // node ID of the client
@@ -53,8 +53,8 @@ enum UAVCAN_EXPORT TraceCode
     TraceRaftAppendEntriesCallFailure,  // error code (may be negated)
     TraceRaftElectionComplete,          // number of votes collected
     TraceRaftAppendEntriesRespUnsucfl,  // node ID of the client
-    Trace2,
-    Trace3,
+    TraceRaftPreVoteComplete,           // number of pre-votes collected
+    TraceRaftVoteRequestLeaseDenied,    // node ID of the client
     // 30
     TraceAllocationFollowupResponse,    // number of unique ID bytes in this response
     TraceAllocationFollowupDenied,      // reason code (see sources for details)
@@ -66,7 +66,7 @@ enum UAVCAN_EXPORT TraceCode
     TraceAllocationExchangeComplete,    // first 8 bytes of unique ID interpreted as signed 64 bit big endian
     TraceAllocationResponse,            // allocated node ID
     TraceAllocationActivity,            // source node ID of the message
-    Trace12,
+    TraceAllocationFastPath,            // number of unique ID bytes received before the cache match
     // 40
     TraceDiscoveryNewNodeFound,         // node ID
     TraceDiscoveryCommitCacheUpdated,   // node ID marked as committed
@@ -78,7 +78,7 @@ enum UAVCAN_EXPORT TraceCode
     TraceDiscoveryGetNodeInfoRequest,   // target node ID
     TraceDiscoveryNodeRestartDetected,  // node ID
     TraceDiscoveryNodeRemoved,          // node ID
-    Trace22,
+    TraceRaftPreVoteUnsupported,        // node ID of the server
     // 50
 
     NumTraceCodes
@@ -115,7 +115,7 @@ public:
             "RaftBadClusterSizeReceived",
             "RaftCoreInited",
             "RaftStateSwitch",
-            "",
+            "RaftServersRestored",
             "RaftNewLogEntry",
             "RaftRequestIgnored",
             "RaftVoteRequestReceived",
@@ -128,8 +128,8 @@ public:
             "RaftAppendEntriesCallFailure",
             "RaftElectionComplete",
             "RaftAppendEntriesRespUnsucfl",
-            "",
-            "",
+            "RaftPreVoteComplete",
+            "RaftVoteRequestLeaseDenied",
             "AllocationFollowupResponse",
             "AllocationFollowupDenied",
             "AllocationFollowupTimeout",
@@ -139,7 +139,7 @@ public:
             "AllocationExchangeComplete",
             "AllocationResponse",
             "AllocationActivity",
-            "",
+            "AllocationFastPath",
             "DiscoveryNewNodeFound",
             "DiscoveryCommitCacheUpdated",
             "DiscoveryNodeFinalized",
@@ -149,7 +149,7 @@ public:
             "DiscoveryGetNodeInfoRequest",
             "DiscoveryNodeRestartDetected",
             "DiscoveryNodeRemoved",
-            ""
+            "RaftPreVoteUnsupported"
         };
         uavcan::StaticAssert<sizeof(Strings) / sizeof(Strings[0]) == NumTraceCodes>::check();
         UAVCAN_ASSERT(code < NumTraceCodes);
@@ -6,7 +6,6 @@
 #define UAVCAN_PROTOCOL_DYNAMIC_NODE_ID_SERVER_NODE_DISCOVERER_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
-#include <uavcan/util/map.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/util/bitset.hpp>
 #include <uavcan/node/timer.hpp>
@@ -64,6 +63,9 @@ public:
 /**
  * This class listens to NodeStatus messages from other nodes and retrieves their unique ID if they are not
  * known to the allocator.
+ * The nodes awaiting GetNodeInfo are tracked in a bitmap indexed by node ID, with the per-node data in flat arrays,
+ * so that any number of unknown nodes can be handled without memory allocation, and the next node to query is found
+ * in constant time. The nodes are queried in round-robin order.
  */
 class NodeDiscoverer : TimerBase
 {
@@ -73,18 +75,11 @@ class NodeDiscoverer : TimerBase
     typedef MethodBinder<NodeDiscoverer*, void (NodeDiscoverer::*)(const ReceivedDataStructure<protocol::NodeStatus>&)>
         NodeStatusCallback;
 
-    struct NodeData
-    {
-        uint32_t last_seen_uptime;
-        uint8_t num_get_node_info_attempts;
-
-        NodeData()
-            : last_seen_uptime(0)
-            , num_get_node_info_attempts(0)
-        { }
-    };
+    typedef uint32_t Bitmap;
 
-    typedef Map<NodeID, NodeData, 10> NodeMap;
+    enum { BitmapWidth = 32 };
+    enum { NumNodeIDs = NodeID::Max + 1 };
+    enum { NumBitmapWords = NumNodeIDs / BitmapWidth };
 
     /**
      * When this number of attempts has been made, the discoverer will give up and assume that the node
@@ -101,7 +96,12 @@ class NodeDiscoverer : TimerBase
     IEventTracer& tracer_;
 
     BitSet<NodeID::Max + 1> committed_node_mask_;       ///< Nodes that are marked will not be queried
-    NodeMap node_map_;                                  ///< Will not work in UAVCAN_TINY
+
+    Bitmap pending_node_mask_[NumBitmapWords];          ///< Nodes awaiting GetNodeInfo
+    uint32_t last_seen_uptime_[NumNodeIDs];
+    uint8_t num_get_node_info_attempts_[NumNodeIDs];
+    uint8_t num_pending_nodes_;
+    uint8_t next_node_to_query_;                        ///< The search for the next node to query starts here
 
     ServiceClient<protocol::GetNodeInfo, GetNodeInfoResponseCallback> get_node_info_client_;
     Subscriber<protocol::NodeStatus, NodeStatusCallback, MaxNetworkSizeHint, 0> node_status_sub_;
@@ -113,17 +113,75 @@ class NodeDiscoverer : TimerBase
 
     INode& getNode() { return node_status_sub_.getNode(); }
 
+    static unsigned countTrailingZeros(Bitmap x)
+    {
+        UAVCAN_ASSERT(x != 0);
+#if defined(__GNUC__)
+        return unsigned(__builtin_ctz(x));
+#else
+        unsigned n = 0;
+        while ((x & 1U) == 0)
+        {
+            x >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    static Bitmap getNodeBit(const NodeID node_id) { return Bitmap(1) << (node_id.get() % BitmapWidth); }
+
+    bool isPendingNode(const NodeID node_id) const
+    {
+        return (pending_node_mask_[node_id.get() / BitmapWidth] & getNodeBit(node_id)) != 0;
+    }
+
+    void addNode(const NodeID node_id)
+    {
+        UAVCAN_ASSERT(node_id.isUnicast() && !isPendingNode(node_id));
+        pending_node_mask_[node_id.get() / BitmapWidth] |= getNodeBit(node_id);
+        last_seen_uptime_[node_id.get()] = 0;
+        num_get_node_info_attempts_[node_id.get()] = 0;
+        num_pending_nodes_++;
+    }
+
     void removeNode(const NodeID node_id)
     {
-        node_map_.remove(node_id);
+        if (isPendingNode(node_id))
+        {
+            pending_node_mask_[node_id.get() / BitmapWidth] &= Bitmap(~getNodeBit(node_id));
+            UAVCAN_ASSERT(num_pending_nodes_ > 0);
+            num_pending_nodes_--;
+        }
         trace(TraceDiscoveryNodeRemoved, node_id.get());
     }
 
+    /**
+     * Returns the first pending node starting from next_node_to_query_, wrapping around.
+     */
     NodeID pickNextNodeToQuery() const
     {
-        // This essentially means that we pick first available node. Remember that the map is unordered.
-        const NodeMap::KVPair* const pair = node_map_.getByIndex(0);
-        return (pair == NULL) ? NodeID() : pair->key;
+        const unsigned start_word = next_node_to_query_ / BitmapWidth;
+        const Bitmap start_mask = Bitmap(~Bitmap(0)) << (next_node_to_query_ % BitmapWidth);
+
+        for (unsigned i = 0; i <= NumBitmapWords; i++)
+        {
+            const unsigned word = (start_word + i) % NumBitmapWords;
+            Bitmap bits = pending_node_mask_[word];
+            if (i == 0)
+            {
+                bits &= start_mask;
+            }
+            else if (i == NumBitmapWords)
+            {
+                bits &= Bitmap(~start_mask);    // The lower part of the first word, after wrapping around
+            }
+            if (bits != 0)
+            {
+                return NodeID(uint8_t(word * BitmapWidth + countTrailingZeros(bits)));
+            }
+        }
+        return NodeID();
     }
 
     bool needToQuery(NodeID node_id)
@@ -176,6 +234,7 @@ class NodeDiscoverer : TimerBase
             {
                 if (needToQuery(node_id))
                 {
+                    next_node_to_query_ = uint8_t((node_id.get() + 1U) % NumNodeIDs);
                     return node_id;
                 }
                 else
@@ -215,20 +274,21 @@ class NodeDiscoverer : TimerBase
         {
             trace(TraceDiscoveryGetNodeInfoFailure, result.getCallID().server_node_id.get());
 
-            NodeData* const data = node_map_.access(result.getCallID().server_node_id);
-            if (data == NULL)
+            const NodeID node_id = result.getCallID().server_node_id;
+            if (!isPendingNode(node_id))
             {
                 return;         // Probably it is a known node now
             }
 
+            uint8_t& num_attempts = num_get_node_info_attempts_[node_id.get()];
+
             UAVCAN_TRACE("dynamic_node_id_server::NodeDiscoverer",
                          "GetNodeInfo request to %d has timed out, %d attempts",
-                         int(result.getCallID().server_node_id.get()), int(data->num_get_node_info_attempts));
-            data->num_get_node_info_attempts++;
-            if (data->num_get_node_info_attempts >= MaxAttemptsToGetNodeInfo)
+                         int(node_id.get()), int(num_attempts));
+            num_attempts++;
+            if (num_attempts >= MaxAttemptsToGetNodeInfo)
             {
-                finalizeNodeDiscovery(NULL, result.getCallID().server_node_id);
-                // Warning: data pointer is invalidated now
+                finalizeNodeDiscovery(NULL, node_id);
             }
         }
     }
@@ -271,26 +331,20 @@ class NodeDiscoverer : TimerBase
             return;
         }
 
-        NodeData* data = node_map_.access(msg.getSrcNodeID());
-        if (data == NULL)
-        {
-            trace(TraceDiscoveryNewNodeFound, msg.getSrcNodeID().get());
+        const uint8_t index = msg.getSrcNodeID().get();
 
-            data = node_map_.insert(msg.getSrcNodeID(), NodeData());
-            if (data == NULL)
-            {
-                getNode().registerInternalFailure("NodeDiscoverer OOM");
-                return;
-            }
+        if (!isPendingNode(msg.getSrcNodeID()))
+        {
+            trace(TraceDiscoveryNewNodeFound, index);
+            addNode(msg.getSrcNodeID());
         }
-        UAVCAN_ASSERT(data != NULL);
 
-        if (msg.uptime_sec < data->last_seen_uptime)
+        if (msg.uptime_sec < last_seen_uptime_[index])
         {
-            trace(TraceDiscoveryNodeRestartDetected, msg.getSrcNodeID().get());
-            data->num_get_node_info_attempts = 0;
+            trace(TraceDiscoveryNodeRestartDetected, index);
+            num_get_node_info_attempts_[index] = 0;
         }
-        data->last_seen_uptime = msg.uptime_sec;
+        last_seen_uptime_[index] = msg.uptime_sec;
 
         if (!isRunning())
         {
@@ -304,10 +358,14 @@ public:
         : TimerBase(node)
         , handler_(handler)
         , tracer_(tracer)
-        , node_map_(node.getAllocator())
+        , num_pending_nodes_(0)
+        , next_node_to_query_(0)
         , get_node_info_client_(node)
         , node_status_sub_(node)
-    { }
+    {
+        StaticAssert<(NumNodeIDs % BitmapWidth) == 0>::check();
+        fill(pending_node_mask_, pending_node_mask_ + NumBitmapWords, Bitmap(0));
+    }
 
     int init(const TransferPriority priority)
     {
@@ -333,13 +391,13 @@ public:
     /**
      * Returns true if there's at least one node with pending GetNodeInfo.
      */
-    bool hasUnknownNodes() const { return !node_map_.isEmpty(); }
+    bool hasUnknownNodes() const { return num_pending_nodes_ > 0; }
 
     /**
      * Returns number of nodes that are being queried at the moment.
      * This method is needed for testing and state visualization.
      */
-    uint8_t getNumUnknownNodes() const { return static_cast<uint8_t>(node_map_.getSize()); }
+    uint8_t getNumUnknownNodes() const { return num_pending_nodes_; }
 };
 
 }
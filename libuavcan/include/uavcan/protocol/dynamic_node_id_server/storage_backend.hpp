@@ -7,6 +7,7 @@
 
 #include <uavcan/build_config.hpp>
 #include <uavcan/marshal/types.hpp>
+#include <uavcan/util/templates.hpp>
 
 namespace uavcan
 {
@@ -53,9 +54,48 @@ public:
      */
     virtual void set(const String& key, const String& value) = 0;
 
+    /**
+     * The server brackets the groups of set() calls that make up one logical update (e.g. a Raft log entry and
+     * the new last index) with these calls; see @ref StorageBatch. Batches may be nested.
+     * A backend may defer making the writes of a batch durable until the outermost endBatch() returns, e.g. to
+     * flush them with a single fsync(); the values must be readable back via get() immediately though.
+     * The default implementation does nothing, i.e. every set() call is expected to be durable on its own.
+     */
+    virtual void beginBatch() { }
+    virtual void endBatch() { }
+
+    /**
+     * A backend that can store arbitrary bytes in values (i.e. any value of up to @ref MaxStringLength bytes,
+     * including zero bytes and whitespace, is read back exactly as it was written) should return true here.
+     * The server will then store composite values, such as Raft log entries, as compact binary records, which
+     * takes fewer set() calls and less formatting/parsing per update. Values that were written in text form remain
+     * readable. The default implementation returns false, i.e. only printable values will be written.
+     */
+    virtual bool supportsBinaryValues() const { return false; }
+
     virtual ~IStorageBackend() { }
 };
 
+/**
+ * Scoped helper that calls @ref IStorageBackend::beginBatch() and @ref IStorageBackend::endBatch().
+ */
+class UAVCAN_EXPORT StorageBatch : Noncopyable
+{
+    IStorageBackend& storage_;
+
+public:
+    explicit StorageBatch(IStorageBackend& storage)
+        : storage_(storage)
+    {
+        storage_.beginBatch();
+    }
+
+    ~StorageBatch()
+    {
+        storage_.endBatch();
+    }
+};
+
 }
 }
 
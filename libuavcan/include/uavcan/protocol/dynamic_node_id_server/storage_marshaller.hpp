@@ -52,6 +52,65 @@ public:
         return serialized;
     }
 
+    /**
+     * Binary encoding helpers, for backends that support binary values (see
+     * @ref IStorageBackend::supportsBinaryValues()). All integers are little endian.
+     * Append methods return false if the value does not fit; read methods return false if the input is too short,
+     * advancing the offset otherwise.
+     */
+    static bool appendBinary(IStorageBackend::String& inout_record, uint32_t value)
+    {
+        if ((inout_record.size() + 4U) > IStorageBackend::MaxStringLength)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            inout_record.push_back(static_cast<uint8_t>(value >> (i * 8U)));
+        }
+        return true;
+    }
+
+    static bool appendBinary(IStorageBackend::String& inout_record, const UniqueID& value)
+    {
+        if ((inout_record.size() + UniqueID::MaxSize) > IStorageBackend::MaxStringLength)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < UniqueID::MaxSize; i++)
+        {
+            inout_record.push_back(value[i]);
+        }
+        return true;
+    }
+
+    static bool readBinary(const IStorageBackend::String& record, unsigned& inout_offset, uint32_t& out_value)
+    {
+        if ((inout_offset + 4U) > record.size())
+        {
+            return false;
+        }
+        out_value = 0;
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            out_value |= static_cast<uint32_t>(record[inout_offset++]) << (i * 8U);
+        }
+        return true;
+    }
+
+    static bool readBinary(const IStorageBackend::String& record, unsigned& inout_offset, UniqueID& out_value)
+    {
+        if ((inout_offset + UniqueID::MaxSize) > record.size())
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < UniqueID::MaxSize; i++)
+        {
+            out_value[i] = record[inout_offset++];
+        }
+        return true;
+    }
+
     /**
      * These methods set the value and then immediately read it back.
      *  1. Serialize the value.
@@ -80,6 +139,19 @@ public:
         return get(key, inout_value);
     }
 
+    /**
+     * Stores a binary record as is; the backend must support binary values.
+     */
+    int setAndGetBack(const IStorageBackend::String& key, IStorageBackend::String& inout_record)
+    {
+        UAVCAN_ASSERT(storage_.supportsBinaryValues());
+        UAVCAN_TRACE("StorageMarshaller", "Set %s = <%u bytes>", key.c_str(), unsigned(inout_record.size()));
+        storage_.set(key, inout_record);
+
+        inout_record = storage_.get(key);
+        return inout_record.empty() ? -ErrFailure : 0;
+    }
+
     /**
      * Getters simply read and deserialize the value.
      *  1. Read the value back from the backend; return false if read fails.
@@ -6,6 +6,7 @@
 #define UAVCAN_PROTOCOL_DYNAMIC_NODE_ID_SERVER_TYPES_HPP_INCLUDED
 
 #include <uavcan/build_config.hpp>
+#include <uavcan/util/templates.hpp>
 // UAVCAN types
 #include <uavcan/protocol/dynamic_node_id/server/Entry.hpp>
 
@@ -21,6 +22,91 @@ using namespace ::uavcan::protocol::dynamic_node_id;
  */
 typedef protocol::dynamic_node_id::server::Entry::FieldTypes::unique_id UniqueID;
 
+/**
+ * Node Unique ID packed into two 64-bit words, for the lookups done by the servers for every allocation request.
+ * Comparisons and hashing take a couple of word operations instead of a loop over 16 bytes.
+ * The bytes are packed in big endian order, so that a prefix of the unique ID is a prefix of the packed words.
+ */
+class UAVCAN_EXPORT PackedUniqueID
+{
+    uint64_t high_;
+    uint64_t low_;
+
+    static uint64_t makePrefixMask(unsigned num_bytes)
+    {
+        return (num_bytes == 0) ? 0 : ((num_bytes >= 8) ? ~uint64_t(0) : (~uint64_t(0) << ((8U - num_bytes) * 8U)));
+    }
+
+public:
+    enum { NumBytes = 16 };
+
+    PackedUniqueID()
+        : high_(0)
+        , low_(0)
+    { }
+
+    /**
+     * Accepts any container of bytes, e.g. @ref UniqueID or the partial unique ID of an allocation request.
+     * Missing bytes are zero, extra bytes are ignored.
+     */
+    template <typename Container>
+    explicit PackedUniqueID(const Container& bytes)
+        : high_(0)
+        , low_(0)
+    {
+        const unsigned size = min(unsigned(bytes.size()), unsigned(NumBytes));
+        for (unsigned i = 0; i < size; i++)
+        {
+            const uint64_t byte = uint8_t(bytes[i]);
+            if (i < 8)
+            {
+                high_ |= byte << ((7U - i) * 8U);
+            }
+            else
+            {
+                low_ |= byte << ((15U - i) * 8U);
+            }
+        }
+    }
+
+    UniqueID toUniqueID() const
+    {
+        UniqueID out;
+        for (unsigned i = 0; i < NumBytes; i++)
+        {
+            out[i] = uint8_t((i < 8) ? (high_ >> ((7U - i) * 8U)) : (low_ >> ((15U - i) * 8U)));
+        }
+        return out;
+    }
+
+    /**
+     * Whether the first num_bytes bytes of this unique ID are equal to those of the other one.
+     */
+    bool hasPrefix(const PackedUniqueID& prefix, unsigned num_bytes) const
+    {
+        const uint64_t high_mask = makePrefixMask(num_bytes);
+        const uint64_t low_mask = makePrefixMask((num_bytes > 8) ? (num_bytes - 8U) : 0U);
+        return (((high_ ^ prefix.high_) & high_mask) | ((low_ ^ prefix.low_) & low_mask)) == 0;
+    }
+
+    /**
+     * Well distributed 32-bit hash, any number of its lower or upper bits can be used.
+     */
+    uint32_t computeHash() const
+    {
+        uint64_t x = high_ ^ (low_ * 0x9E3779B97F4A7C15ULL);
+        x ^= x >> 29;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 32;
+        return uint32_t(x);
+    }
+
+    bool isZero() const { return (high_ | low_) == 0; }
+
+    bool operator==(const PackedUniqueID& rhs) const { return (high_ == rhs.high_) && (low_ == rhs.low_); }
+    bool operator!=(const PackedUniqueID& rhs) const { return !operator==(rhs); }
+};
+
 }
 }
 
@@ -8,6 +8,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/node/service_server.hpp>
+#include <uavcan/node/timer.hpp>
 #include <uavcan/util/method_binder.hpp>
 // UAVCAN types
 #include <uavcan/protocol/file/GetInfo.hpp>
@@ -18,6 +19,25 @@
 
 namespace uavcan
 {
+/**
+ * Receives the results of the writes that the backend completes asynchronously;
+ * see @ref IFileServerBackend::beginWrite(). Implemented by @ref FileServer.
+ */
+class UAVCAN_EXPORT IFileWriteCompletionListener
+{
+public:
+    /**
+     * Must be invoked from the thread that spins the node, exactly once per deferred write.
+     *
+     * @param context   Context that was passed to @ref IFileServerBackend::beginWrite().
+     *
+     * @param error     Result of the write; zero on success.
+     */
+    virtual void handleFileWriteCompletion(const ServiceReplyContext& context, int16_t error) = 0;
+
+    virtual ~IFileWriteCompletionListener() { }
+};
+
 /**
  * The file server backend should implement this interface.
  * Note that error codes returned by these methods are defined in uavcan.protocol.file.Error; these are
@@ -30,6 +50,12 @@ public:
     typedef protocol::file::EntryType EntryType;
     typedef protocol::file::Error Error;
 
+    /**
+     * Returned by @ref beginWrite() if the result will be reported later.
+     * This is not a valid uavcan.protocol.file.Error value, so it is never sent to the client.
+     */
+    enum { WriteInProgress = -1 };
+
     /**
      * All read operations must return this number of bytes, unless end of file is reached.
      */
@@ -73,6 +99,22 @@ public:
         return Error::NOT_IMPLEMENTED;
     }
 
+    /**
+     * Backend for uavcan.protocol.file.Write, as invoked by @ref FileServer.
+     * The default implementation completes the request immediately via @ref write().
+     * A backend that does not want to block the node on slow storage can stage the data and return
+     * @ref WriteInProgress; then the response is deferred until the backend reports the result via the listener,
+     * e.g. once the data is durably written. Any other return value is sent to the client immediately.
+     * The buffer is valid only until the method returns.
+     */
+    virtual int16_t beginWrite(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size,
+                               const ServiceReplyContext& context, IFileWriteCompletionListener& listener)
+    {
+        (void)context;
+        (void)listener;
+        return write(path, offset, buffer, size);
+    }
+
     /**
      * Backend for uavcan.protocol.file.Delete. ('delete' is a C++ keyword, so 'remove' is used instead)
      * Implementation of this method is NOT required; by default it returns uavcan.protocol.file.Error.NOT_IMPLEMENTED.
@@ -103,37 +145,143 @@ public:
     virtual ~IFileServerBackend() { }
 };
 
+/**
+ * Optional observer of the read requests served by @ref BasicFileServer.
+ * It allows the application to meter the bandwidth consumed by the file transfers, or to track the progress of
+ * the nodes that are retrieving their firmware images (refer to @ref FirmwareUpdateTrigger).
+ */
+class UAVCAN_EXPORT IFileServerReadListener
+{
+public:
+    /**
+     * Invoked after every uavcan.protocol.file.Read request has been served.
+     *
+     * @param client_node_id    Node ID of the node that has sent the request.
+     *
+     * @param path              Requested path.
+     *
+     * @param offset            Requested offset.
+     *
+     * @param size              Number of bytes sent in the response; zero in case of error or at the end of file.
+     */
+    virtual void handleFileRead(NodeID client_node_id, const IFileServerBackend::Path& path, uint64_t offset,
+                                uint16_t size) = 0;
+
+    virtual ~IFileServerReadListener() { }
+};
+
+/**
+ * Serves the read requests that have been deferred by an @ref IFileReadScheduler.
+ * Implemented by @ref BasicFileServer.
+ */
+class UAVCAN_EXPORT IFileReadExecutor
+{
+public:
+    /**
+     * Reads the data from the backend and sends the response. Must be invoked from the thread that spins the node,
+     * exactly once per deferred request.
+     */
+    virtual void executeRead(NodeID client_node_id, const IFileServerBackend::Path& path, uint64_t offset,
+                             const ServiceReplyContext& context) = 0;
+
+    /**
+     * Size of the file according to the backend; returns false if it is not known.
+     */
+    virtual bool getFileSize(const IFileServerBackend::Path& path, uint64_t& out_size) = 0;
+
+    virtual ~IFileReadExecutor() { }
+};
+
+/**
+ * Optional scheduler of the read requests received by @ref BasicFileServer; see @ref FileReadScheduler.
+ */
+class UAVCAN_EXPORT IFileReadScheduler
+{
+public:
+    /**
+     * Invoked for every uavcan.protocol.file.Read request.
+     *
+     * @return  True if the request has been queued; it must be served later via @ref IFileReadExecutor::executeRead().
+     *          False if the request can't be queued; the server will serve it immediately.
+     */
+    virtual bool scheduleRead(IFileReadExecutor& executor, NodeID client_node_id,
+                              const IFileServerBackend::Path& path, uint64_t offset,
+                              const ServiceReplyContext& context) = 0;
+
+    virtual ~IFileReadScheduler() { }
+};
+
 /**
  * Basic file server implements only the following services:
  *      uavcan.protocol.file.GetInfo
  *      uavcan.protocol.file.Read
  * Also see @ref IFileServerBackend.
  */
-class BasicFileServer
+class BasicFileServer : private IFileReadExecutor
 {
     typedef MethodBinder<BasicFileServer*,
         void (BasicFileServer::*)(const protocol::file::GetInfo::Request&, protocol::file::GetInfo::Response&)>
             GetInfoCallback;
 
     typedef MethodBinder<BasicFileServer*,
-        void (BasicFileServer::*)(const protocol::file::Read::Request&, protocol::file::Read::Response&)>
+        void (BasicFileServer::*)(const ReceivedDataStructure<protocol::file::Read::Request>&,
+                                  ServiceResponseDataStructure<protocol::file::Read::Response>&)>
             ReadCallback;
 
     ServiceServer<protocol::file::GetInfo, GetInfoCallback> get_info_srv_;
     ServiceServer<protocol::file::Read, ReadCallback> read_srv_;
 
+    IFileServerReadListener* read_listener_;
+    IFileReadScheduler* read_scheduler_;
+
     void handleGetInfo(const protocol::file::GetInfo::Request& req, protocol::file::GetInfo::Response& resp)
     {
         resp.error.value = backend_.getInfo(req.path.path, resp.size, resp.entry_type);
     }
 
-    void handleRead(const protocol::file::Read::Request& req, protocol::file::Read::Response& resp)
+    void handleRead(const ReceivedDataStructure<protocol::file::Read::Request>& req,
+                    ServiceResponseDataStructure<protocol::file::Read::Response>& resp)
+    {
+        if (read_scheduler_ != NULL)
+        {
+            const ServiceReplyContext context = resp.deferResponse();
+            if (!read_scheduler_->scheduleRead(*this, req.getSrcNodeID(), req.path.path, req.offset, context))
+            {
+                executeRead(req.getSrcNodeID(), req.path.path, req.offset, context);
+            }
+        }
+        else
+        {
+            performRead(req.getSrcNodeID(), req.path.path, req.offset, resp);
+        }
+    }
+
+    virtual void executeRead(NodeID client_node_id, const IFileServerBackend::Path& path, uint64_t offset,
+                             const ServiceReplyContext& context)
+    {
+        protocol::file::Read::Response resp;
+        performRead(client_node_id, path, offset, resp);
+        const int res = read_srv_.respond(context, resp);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("BasicFileServer", "Deferred read response failure: %i", res);
+        }
+    }
+
+    virtual bool getFileSize(const IFileServerBackend::Path& path, uint64_t& out_size)
+    {
+        IFileServerBackend::EntryType type;
+        return backend_.getInfo(path, out_size, type) == protocol::file::Error::OK;
+    }
+
+    void performRead(NodeID client_node_id, const IFileServerBackend::Path& path, uint64_t offset,
+                     protocol::file::Read::Response& resp)
     {
         uint16_t inout_size = resp.data.capacity();
 
         resp.data.resize(inout_size);
 
-        resp.error.value = backend_.read(req.path.path, req.offset, resp.data.begin(), inout_size);
+        resp.error.value = backend_.read(path, offset, resp.data.begin(), inout_size);
 
         if (resp.error.value != protocol::file::Error::OK)
         {
@@ -149,6 +297,11 @@ class BasicFileServer
         {
             resp.data.resize(inout_size);
         }
+
+        if (read_listener_ != NULL)
+        {
+            read_listener_->handleFileRead(client_node_id, path, offset, uint16_t(resp.data.size()));
+        }
     }
 
 protected:
@@ -158,6 +311,8 @@ public:
     BasicFileServer(INode& node, IFileServerBackend& backend)
         : get_info_srv_(node)
         , read_srv_(node)
+        , read_listener_(NULL)
+        , read_scheduler_(NULL)
         , backend_(backend)
     { }
 
@@ -177,6 +332,17 @@ public:
 
         return 0;
     }
+
+    /**
+     * Installs the read request observer; pass NULL to remove it. The listener must outlive the server.
+     */
+    void setReadListener(IFileServerReadListener* listener) { read_listener_ = listener; }
+
+    /**
+     * Installs the read request scheduler, e.g. @ref FileReadScheduler; pass NULL to serve every request as soon
+     * as it arrives (this is the default). The scheduler must outlive the server.
+     */
+    void setReadScheduler(IFileReadScheduler* scheduler) { read_scheduler_ = scheduler; }
 };
 
 /**
@@ -187,11 +353,15 @@ public:
  *      uavcan.protocol.file.Delete
  *      uavcan.protocol.file.GetDirectoryEntryInfo
  * Also see @ref IFileServerBackend.
+ * The backend may complete the writes asynchronously, see @ref IFileServerBackend::beginWrite(); in that case
+ * it must not report completions after the server has been destroyed.
  */
 class FileServer : protected BasicFileServer
+                 , private IFileWriteCompletionListener
 {
     typedef MethodBinder<FileServer*,
-        void (FileServer::*)(const protocol::file::Write::Request&, protocol::file::Write::Response&)>
+        void (FileServer::*)(const protocol::file::Write::Request&,
+                             ServiceResponseDataStructure<protocol::file::Write::Response>&)>
             WriteCallback;
 
     typedef MethodBinder<FileServer*,
@@ -207,9 +377,30 @@ class FileServer : protected BasicFileServer
     ServiceServer<protocol::file::Delete, DeleteCallback> delete_srv_;
     ServiceServer<protocol::file::GetDirectoryEntryInfo, GetDirectoryEntryInfoCallback> get_directory_entry_info_srv_;
 
-    void handleWrite(const protocol::file::Write::Request& req, protocol::file::Write::Response& resp)
+    void handleWrite(const protocol::file::Write::Request& req,
+                     ServiceResponseDataStructure<protocol::file::Write::Response>& resp)
     {
-        resp.error.value = backend_.write(req.path.path, req.offset, req.data.begin(), req.data.size());
+        const int16_t res = backend_.beginWrite(req.path.path, req.offset, req.data.begin(), req.data.size(),
+                                                resp.getReplyContext(), *this);
+        if (res == IFileServerBackend::WriteInProgress)
+        {
+            (void)resp.deferResponse();
+        }
+        else
+        {
+            resp.error.value = res;
+        }
+    }
+
+    virtual void handleFileWriteCompletion(const ServiceReplyContext& context, int16_t error)
+    {
+        protocol::file::Write::Response resp;
+        resp.error.value = error;
+        const int res = write_srv_.respond(context, resp);
+        if (res < 0)
+        {
+            UAVCAN_TRACE("FileServer", "Deferred write response failure: %i", res);
+        }
     }
 
     void handleDelete(const protocol::file::Delete::Request& req, protocol::file::Delete::Response& resp)
@@ -232,6 +423,9 @@ public:
         , get_directory_entry_info_srv_(node)
     { }
 
+    using BasicFileServer::setReadListener;
+    using BasicFileServer::setReadScheduler;
+
     int start()
     {
         int res = BasicFileServer::start();
@@ -263,6 +457,244 @@ public:
     }
 };
 
+
+/**
+ * Schedules the read requests of @ref BasicFileServer so that many nodes reading large files at once, e.g. during
+ * a fleet-wide firmware update, finish as early as possible; install it with
+ * @ref BasicFileServer::setReadScheduler().
+ *
+ * Without a scheduler the requests are served in the order of arrival, so the responses to all readers interleave
+ * and every reader is slowed down by all others. This class queues the requests and serves them in rounds: at most
+ * MaxResponsesPerRound responses are sent per round, which bounds the number of responses competing for the bus,
+ * and the readers that have the fewest bytes left to read are served first, which minimizes the time until all
+ * readers are done. A request that has been queued longer than the maximum queueing delay is served before all
+ * others, so that no reader can time out. If the queue is full, the request is served immediately.
+ *
+ * The remaining size is computed from the file size reported by the backend, which is requested once per client
+ * and path. Every queued request takes about 250 bytes of RAM.
+ *
+ * @tparam MaxPendingReads  Maximum number of the queued requests; should not be less than the number of nodes
+ *                          that are expected to read at the same time.
+ */
+template <unsigned MaxPendingReads = 16>
+class UAVCAN_EXPORT FileReadScheduler : public IFileReadScheduler, private TimerBase
+{
+public:
+    enum { DefaultMaxResponsesPerRound = 4 };
+    enum { DefaultRoundIntervalMs = 10 };
+    enum { DefaultMaxQueueingDelayMs = 200 };
+
+private:
+    struct PendingRead
+    {
+        ServiceReplyContext context;
+        IFileReadExecutor* executor;
+        IFileServerBackend::Path path;
+        uint64_t offset;
+        uint64_t remaining;
+        MonotonicTime arrived_at;
+        NodeID client_node_id;
+
+        PendingRead()
+            : executor(NULL)
+            , offset(0)
+            , remaining(0)
+        { }
+    };
+
+    struct KnownFileSize
+    {
+        uint64_t size;
+        uint32_t path_hash;
+        NodeID client_node_id;
+
+        KnownFileSize()
+            : size(0)
+            , path_hash(0)
+        { }
+    };
+
+    PendingRead pending_[MaxPendingReads];
+    KnownFileSize known_sizes_[MaxPendingReads];
+    MonotonicDuration round_interval_;
+    MonotonicDuration max_queueing_delay_;
+    uint16_t num_pending_;
+    uint16_t next_known_size_;
+    uint8_t max_responses_per_round_;
+    uint32_t num_overflows_;
+
+    static uint32_t computePathHash(const IFileServerBackend::Path& path)
+    {
+        uint32_t hash = 2166136261U;
+        for (unsigned i = 0; i < path.size(); i++)
+        {
+            hash = (hash ^ path[i]) * 16777619U;     // FNV-1a
+        }
+        return hash;
+    }
+
+    /**
+     * Returns the size of the file being read by the client, requesting it from the backend if not known.
+     * A new path of the same client replaces the old one, so the table holds one entry per active reader.
+     */
+    uint64_t getFileSize(IFileReadExecutor& executor, NodeID client_node_id, const IFileServerBackend::Path& path)
+    {
+        const uint32_t path_hash = computePathHash(path);
+        KnownFileSize* entry = NULL;
+        for (unsigned i = 0; i < MaxPendingReads; i++)
+        {
+            if (known_sizes_[i].client_node_id == client_node_id)
+            {
+                if (known_sizes_[i].path_hash == path_hash)
+                {
+                    return known_sizes_[i].size;
+                }
+                entry = &known_sizes_[i];
+                break;
+            }
+        }
+        if (entry == NULL)
+        {
+            entry = &known_sizes_[next_known_size_];
+            next_known_size_ = uint16_t((next_known_size_ + 1U) % MaxPendingReads);
+        }
+
+        uint64_t size = 0;
+        if (!executor.getFileSize(path, size))
+        {
+            size = 0xFFFFFFFFFFFFFFFFULL;       // Unknown, lowest priority
+        }
+        entry->client_node_id = client_node_id;
+        entry->path_hash = path_hash;
+        entry->size = size;
+        return size;
+    }
+
+    /**
+     * Overdue requests come first in the order of arrival, then the requests with the fewest bytes remaining.
+     */
+    unsigned selectNext(MonotonicTime now) const
+    {
+        unsigned best = 0;
+        for (unsigned i = 1; i < num_pending_; i++)
+        {
+            const PendingRead& a = pending_[i];
+            const PendingRead& b = pending_[best];
+            const bool a_overdue = (now - a.arrived_at) >= max_queueing_delay_;
+            const bool b_overdue = (now - b.arrived_at) >= max_queueing_delay_;
+            if (a_overdue != b_overdue)
+            {
+                if (a_overdue)
+                {
+                    best = i;
+                }
+            }
+            else if (a_overdue)
+            {
+                if (a.arrived_at < b.arrived_at)
+                {
+                    best = i;
+                }
+            }
+            else if ((a.remaining < b.remaining) || ((a.remaining == b.remaining) && (a.arrived_at < b.arrived_at)))
+            {
+                best = i;
+            }
+            else
+            {
+                ;
+            }
+        }
+        return best;
+    }
+
+    virtual void handleTimerEvent(const TimerEvent& event)
+    {
+        for (unsigned i = 0; (i < max_responses_per_round_) && (num_pending_ > 0); i++)
+        {
+            const unsigned index = selectNext(event.real_time);
+            const PendingRead read = pending_[index];
+            num_pending_--;
+            if (index != num_pending_)
+            {
+                pending_[index] = pending_[num_pending_];
+            }
+            read.executor->executeRead(read.client_node_id, read.path, read.offset, read.context);
+        }
+
+        if (num_pending_ > 0)
+        {
+            startOneShotWithDelay(round_interval_);
+        }
+    }
+
+public:
+    explicit FileReadScheduler(INode& node)
+        : TimerBase(node)
+        , round_interval_(MonotonicDuration::fromMSec(DefaultRoundIntervalMs))
+        , max_queueing_delay_(MonotonicDuration::fromMSec(DefaultMaxQueueingDelayMs))
+        , num_pending_(0)
+        , next_known_size_(0)
+        , max_responses_per_round_(DefaultMaxResponsesPerRound)
+        , num_overflows_(0)
+    {
+        StaticAssert<(MaxPendingReads > 0)>::check();
+    }
+
+    virtual bool scheduleRead(IFileReadExecutor& executor, NodeID client_node_id,
+                              const IFileServerBackend::Path& path, uint64_t offset,
+                              const ServiceReplyContext& context)
+    {
+        if (num_pending_ >= MaxPendingReads)
+        {
+            num_overflows_++;
+            return false;
+        }
+
+        const uint64_t size = getFileSize(executor, client_node_id, path);
+
+        PendingRead& read = pending_[num_pending_++];
+        read.context = context;
+        read.executor = &executor;
+        read.path = path;
+        read.offset = offset;
+        read.remaining = (size > offset) ? (size - offset) : 0;
+        read.arrived_at = getScheduler().getMonotonicTime();
+        read.client_node_id = client_node_id;
+
+        if (!isRunning())
+        {
+            startOneShotWithDelay(MonotonicDuration());     // The first round runs on the next spin
+        }
+        return true;
+    }
+
+    /**
+     * Maximum number of responses sent per round. Lower values leave more bus bandwidth to other traffic.
+     */
+    void setMaxResponsesPerRound(uint8_t num) { max_responses_per_round_ = uint8_t(max(num, uint8_t(1))); }
+    uint8_t getMaxResponsesPerRound() const { return max_responses_per_round_; }
+
+    /**
+     * Interval between the rounds while there are requests in the queue.
+     */
+    void setRoundInterval(MonotonicDuration interval) { round_interval_ = interval; }
+    MonotonicDuration getRoundInterval() const { return round_interval_; }
+
+    /**
+     * Requests that have been queued for longer than this are served first. This must be well below the request
+     * timeout of the clients.
+     */
+    void setMaxQueueingDelay(MonotonicDuration delay) { max_queueing_delay_ = delay; }
+    MonotonicDuration getMaxQueueingDelay() const { return max_queueing_delay_; }
+
+    unsigned getNumPendingReads() const { return num_pending_; }
+
+    /**
+     * Number of requests that were served immediately because the queue was full.
+     */
+    uint32_t getNumOverflows() const { return num_overflows_; }
+};
 }
 
 #endif // Include guard
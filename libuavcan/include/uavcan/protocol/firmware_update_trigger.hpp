@@ -9,8 +9,11 @@
 #include <uavcan/debug.hpp>
 #include <uavcan/node/service_client.hpp>
 #include <uavcan/util/method_binder.hpp>
-#include <uavcan/util/map.hpp>
+#include <uavcan/util/bitset.hpp>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/util/placement_new.hpp>
 #include <uavcan/protocol/node_info_retriever.hpp>
+#include <uavcan/protocol/file_server.hpp>
 // UAVCAN types
 #include <uavcan/protocol/file/BeginFirmwareUpdate.hpp>
 
@@ -24,8 +27,8 @@ class IFirmwareVersionChecker
 {
 public:
     /**
-     * This value is limited by the pool block size minus some extra data. Please refer to the Map<> documentation
-     * for details. If this size is set too high, the compilation will fail in the Map<> template.
+     * This value is limited by the pool block size minus some extra data, because every distinct path is stored
+     * in one pool block. If this size is set too high, the compilation will fail in @ref FirmwareUpdateTrigger.
      */
     enum { MaxFirmwareFilePathLength = 40 };
 
@@ -93,6 +96,22 @@ public:
         (void)response;
     }
 
+    /**
+     * This method is used only if the number of concurrent updates is limited, refer to
+     * @ref FirmwareUpdateTrigger::setMaxConcurrentUpdates(). It is invoked immediately after
+     * @ref shouldRequestFirmwareUpdate() has returned true, and it defines the order in which the nodes will be
+     * admitted to update: nodes with higher values go first, nodes with equal values are admitted in round-robin.
+     * For example, the application may want to update the flight-critical nodes (or the slowest ones) first.
+     *
+     * Implementation is optional; default one returns zero for all nodes.
+     */
+    virtual uint8_t getFirmwareUpdatePriority(NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
+    {
+        (void)node_id;
+        (void)node_info;
+        return 0;
+    }
+
     virtual ~IFirmwareVersionChecker() { }
 };
 
@@ -126,16 +145,36 @@ public:
  * - dynamic node ID allocation server;
  * - file server.
  *
- * Implementation details: the class uses memory pool to keep the list of nodes that have not responded yet, which
- * limits the maximum length of the path to the firmware file, which is covered in @ref IFirmwareVersionChecker.
+ * Orchestrated mode: if the number of concurrent updates is limited via @ref setMaxConcurrentUpdates(), the
+ * requests are sent only to the nodes that have been admitted to update; the others wait in the order defined by
+ * @ref IFirmwareVersionChecker::getFirmwareUpdatePriority(). A node holds its slot from the moment it is admitted
+ * until it restarts, goes offline, declines the update, or stops reading the image for longer than the inactivity
+ * timeout (@ref setUpdateInactivityTimeout()); an admitted node that does not confirm the request within that
+ * timeout is returned to the waiting list. This prevents a large number of nodes from downloading their images
+ * at once, which would saturate the bus and slow down every one of them.
+ * For the inactivity tracking, the file server should report the read requests to this class via
+ * @ref BasicFileServer::setReadListener(); otherwise the slot is released after the inactivity timeout expires
+ * since the confirmation. The reported reads are also used to meter the aggregate read bandwidth: if a budget is
+ * configured via @ref setReadBandwidthBudget(), new nodes are admitted only while the measured bandwidth,
+ * extrapolated to one more node, fits the budget.
+ *
+ * Implementation details: the nodes that have not responded yet are kept in a bitmap indexed by Node ID, and the
+ * firmware pathes are interned in a table allocated from the memory pool, so that the nodes that share one image
+ * path (which is the common case) share one pool block. This limits the maximum length of the path to the firmware
+ * file, which is covered in @ref IFirmwareVersionChecker.
  * To somewhat relieve the maximum path length limitation, the class can be supplied with a common prefix that
  * will be prepended to firmware pathes before sending requests.
  * Interval at which requests are being sent is configurable, but the default value should cover the needs of
  * virtually all use cases (as always).
  */
 class FirmwareUpdateTrigger : public INodeInfoListener,
+                              public IFileServerReadListener,
                               private TimerBase
 {
+public:
+    enum { MaxConcurrentUpdates = 16 };
+
+private:
     typedef MethodBinder<FirmwareUpdateTrigger*,
         void (FirmwareUpdateTrigger::*)(const ServiceCallResult<protocol::file::BeginFirmwareUpdate>&)>
             BeginFirmwareUpdateResponseCallback;
@@ -144,27 +183,39 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     enum { DefaultRequestIntervalMs = 1000 };   ///< Shall not be less than default service response timeout.
 
-    struct NextNodeIDSearchPredicate : ::uavcan::Noncopyable
+    enum { DefaultUpdateInactivityTimeoutMs = 15000 };
+
+    /**
+     * Interned firmware path, shared by all pending nodes that are to be updated with the same image.
+     */
+    struct PathEntry : public ::uavcan::LinkedListNode<PathEntry>
     {
-        enum { DefaultOutput = 0xFFU };
+        FirmwareFilePath path;
+        uint8_t index;              ///< Non-zero, unique within the table
+        uint8_t ref_count;
+
+        PathEntry(const FirmwareFilePath& arg_path, uint8_t arg_index)
+            : path(arg_path)
+            , index(arg_index)
+            , ref_count(0)
+        {
+            IsDynamicallyAllocatable<PathEntry>::check();
+        }
+    };
 
-        const FirmwareUpdateTrigger& owner;
-        uint8_t output;
+    /**
+     * Node that has been admitted to update in the orchestrated mode.
+     */
+    struct UpdateSlot
+    {
+        MonotonicTime last_activity;    ///< Admission, confirmation or the last read request
+        uint8_t node_id;                ///< Zero if the slot is free
+        bool confirmed;
 
-        NextNodeIDSearchPredicate(const FirmwareUpdateTrigger& arg_owner)
-            : owner(arg_owner)
-            , output(DefaultOutput)
+        UpdateSlot()
+            : node_id(0)
+            , confirmed(false)
         { }
-
-        bool operator()(const NodeID node_id, const FirmwareFilePath&)
-        {
-            if (node_id.get() > owner.last_queried_node_id_ &&
-                !owner.begin_fw_update_client_.hasPendingCallToServer(node_id))
-            {
-                output = min(output, node_id.get());
-            }
-            return false;
-        }
     };
 
     /*
@@ -176,7 +227,15 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     NodeInfoRetriever* node_info_retriever_;
 
-    Map<NodeID, FirmwareFilePath> pending_nodes_;
+    IPoolAllocator& allocator_;
+
+    LinkedListRoot<PathEntry> paths_;
+
+    BitSet<NodeID::Max + 1> pending_nodes_;
+
+    uint8_t path_indices_[NodeID::Max + 1];     ///< Index of the interned path of every pending node
+
+    uint8_t num_pending_nodes_;
 
     MonotonicDuration request_interval_;
 
@@ -184,29 +243,55 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
 
     mutable uint8_t last_queried_node_id_;
 
+    /*
+     * Orchestrated mode
+     */
+    UpdateSlot slots_[MaxConcurrentUpdates];
+
+    uint8_t priorities_[NodeID::Max + 1];
+
+    uint8_t max_concurrent_updates_;            ///< Zero if not limited
+
+    MonotonicDuration update_inactivity_timeout_;
+
+    uint32_t read_bandwidth_budget_;            ///< Bytes per second, zero if not limited
+
+    uint32_t read_rate_;                        ///< Bytes per second, measured over the last timer period
+
+    uint32_t bytes_read_;                       ///< Since the last timer event
+
+    MonotonicTime last_read_rate_update_;
+
     /*
      * Methods of INodeInfoListener
      */
     virtual void handleNodeInfoUnavailable(NodeID node_id)
     {
         UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d could not provide GetNodeInfo response", int(node_id.get()));
-        pending_nodes_.remove(node_id); // For extra paranoia
+        removePendingNode(node_id); // For extra paranoia
+        releaseSlot(node_id);
     }
 
     virtual void handleNodeInfoRetrieved(const NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
     {
+        releaseSlot(node_id);           // The node has restarted, so its update is either finished or aborted
+
         FirmwareFilePath firmware_file_path;
         const bool update_needed = checker_.shouldRequestFirmwareUpdate(node_id, node_info, firmware_file_path);
         if (update_needed)
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d requires update; file path: %s",
                          int(node_id.get()), firmware_file_path.c_str());
+            if (node_id.isUnicast())
+            {
+                priorities_[node_id.get()] = checker_.getFirmwareUpdatePriority(node_id, node_info);
+            }
             trySetPendingNode(node_id, firmware_file_path);
         }
         else
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d does not need update", int(node_id.get()));
-            pending_nodes_.remove(node_id);
+            removePendingNode(node_id);
         }
     }
 
@@ -214,19 +299,197 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
     {
         if (event.status.mode == protocol::NodeStatus::MODE_OFFLINE)
         {
-            pending_nodes_.remove(event.node_id);
+            removePendingNode(event.node_id);
+            releaseSlot(event.node_id);
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node ID %d is offline hence forgotten", int(event.node_id.get()));
         }
     }
 
+    /*
+     * Methods of IFileServerReadListener
+     */
+    virtual void handleFileRead(NodeID client_node_id, const IFileServerBackend::Path&, uint64_t, uint16_t size)
+    {
+        bytes_read_ += size;
+        UpdateSlot* const slot = findSlot(client_node_id);
+        if (slot != NULL)
+        {
+            slot->last_activity = getNode().getMonotonicTime();
+        }
+    }
+
     /*
      * Own methods
      */
     INode& getNode() { return begin_fw_update_client_.getNode(); }
 
+    bool isOrchestrated() const { return max_concurrent_updates_ > 0; }
+
+    UpdateSlot* findSlot(const NodeID node_id)
+    {
+        if (node_id.isUnicast())
+        {
+            for (unsigned i = 0; i < MaxConcurrentUpdates; i++)
+            {
+                if (slots_[i].node_id == node_id.get())
+                {
+                    return &slots_[i];
+                }
+            }
+        }
+        return NULL;
+    }
+
+    UpdateSlot* findFreeSlot()
+    {
+        for (unsigned i = 0; i < max_concurrent_updates_; i++)
+        {
+            if (slots_[i].node_id == 0)
+            {
+                return &slots_[i];
+            }
+        }
+        return NULL;
+    }
+
+    void releaseSlot(const NodeID node_id)
+    {
+        UpdateSlot* const slot = findSlot(node_id);
+        if (slot != NULL)
+        {
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d released its update slot", int(node_id.get()));
+            *slot = UpdateSlot();
+        }
+    }
+
+    unsigned getNumUsedSlots(bool confirmed_only) const
+    {
+        unsigned result = 0;
+        for (unsigned i = 0; i < MaxConcurrentUpdates; i++)
+        {
+            if ((slots_[i].node_id != 0) && (slots_[i].confirmed || !confirmed_only))
+            {
+                result++;
+            }
+        }
+        return result;
+    }
+
+    PathEntry* findPath(uint8_t index) const
+    {
+        PathEntry* p = paths_.get();
+        while ((p != NULL) && (p->index != index))
+        {
+            p = p->getNextListNode();
+        }
+        return p;
+    }
+
+    /**
+     * Returns the entry with the specified path, adding it to the table if necessary; NULL if out of memory.
+     * The reference count is not modified.
+     */
+    PathEntry* internPath(const FirmwareFilePath& path)
+    {
+        uint8_t max_index = 0;
+        for (PathEntry* p = paths_.get(); p != NULL; p = p->getNextListNode())
+        {
+            if (p->path == path)
+            {
+                return p;
+            }
+            max_index = max(max_index, p->index);
+        }
+
+        uint8_t index = uint8_t(max_index + 1U);
+        if (index == 0)                                     // Wrapped around, looking for a gap
+        {
+            do
+            {
+                index++;
+            }
+            while (findPath(index) != NULL);
+        }
+
+        void* const praw = allocator_.allocate(sizeof(PathEntry));
+        if (praw == NULL)
+        {
+            return NULL;
+        }
+        PathEntry* const entry = new (praw) PathEntry(path, index);
+        paths_.insert(entry);
+        return entry;
+    }
+
+    void releasePath(PathEntry* entry)
+    {
+        UAVCAN_ASSERT((entry != NULL) && (entry->ref_count > 0));
+        entry->ref_count--;
+        if (entry->ref_count == 0)
+        {
+            paths_.remove(entry);
+            entry->~PathEntry();
+            allocator_.deallocate(entry);
+        }
+    }
+
+    PathEntry* getPathOfPendingNode(const NodeID node_id) const
+    {
+        if (!node_id.isUnicast() || !pending_nodes_.test(node_id.get()))
+        {
+            return NULL;
+        }
+        PathEntry* const entry = findPath(path_indices_[node_id.get()]);
+        UAVCAN_ASSERT(entry != NULL);
+        return entry;
+    }
+
+    void removePendingNode(const NodeID node_id)
+    {
+        PathEntry* const entry = getPathOfPendingNode(node_id);
+        if (entry != NULL)
+        {
+            pending_nodes_.set(node_id.get(), false);
+            num_pending_nodes_--;
+            releasePath(entry);
+        }
+    }
+
+    /**
+     * Assigns the path to the node, adding the node to the pending set if it is not there yet.
+     * Returns false if out of memory; in this case the node keeps its old path, if any.
+     */
+    bool setPendingNodePath(const NodeID node_id, const FirmwareFilePath& path)
+    {
+        PathEntry* const new_entry = internPath(path);
+        if (new_entry == NULL)
+        {
+            return false;
+        }
+        new_entry->ref_count++;
+
+        PathEntry* const old_entry = getPathOfPendingNode(node_id);
+        if (old_entry != NULL)
+        {
+            releasePath(old_entry);
+        }
+        else
+        {
+            pending_nodes_.set(node_id.get());
+            num_pending_nodes_++;
+        }
+        path_indices_[node_id.get()] = new_entry->index;
+        return true;
+    }
+
     void trySetPendingNode(const NodeID node_id, const FirmwareFilePath& path)
     {
-        if (NULL != pending_nodes_.insert(node_id, path))
+        if (!node_id.isUnicast())
+        {
+            UAVCAN_ASSERT(0);
+            return;
+        }
+        if (setPendingNodePath(node_id, path))
         {
             if (!TimerBase::isRunning())
             {
@@ -240,39 +503,166 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
         }
     }
 
+    /**
+     * Round-robin over the pending nodes, starting from the one that follows the last queried node.
+     * The nodes that have a request in flight are skipped. The search is bounded by the size of the bitmap.
+     */
     NodeID pickNextNodeID() const
     {
-        // We can't do index search because indices are unstable in Map<>
-        // First try - from the current node up
-        NextNodeIDSearchPredicate s1(*this);
-        (void)pending_nodes_.find<NextNodeIDSearchPredicate&>(s1);
+        NodeID result;
+        unsigned candidate = last_queried_node_id_;
+        for (unsigned i = 0; i < NodeID::Max; i++)
+        {
+            candidate = (candidate >= NodeID::Max) ? 1U : (candidate + 1U);
+            if (pending_nodes_.test(candidate) &&
+                !begin_fw_update_client_.hasPendingCallToServer(NodeID(uint8_t(candidate))))
+            {
+                last_queried_node_id_ = uint8_t(candidate);
+                result = NodeID(uint8_t(candidate));
+                break;
+            }
+        }
+        UAVCAN_TRACE("FirmwareUpdateTrigger", "Next node ID to query: %d, pending nodes: %u, pending calls: %u",
+                     int(result.get()), unsigned(num_pending_nodes_),
+                     begin_fw_update_client_.getNumPendingCalls());
+        return result;
+    }
 
-        if (s1.output != NextNodeIDSearchPredicate::DefaultOutput)
+    /**
+     * Picks the pending node of the highest priority that has not been admitted yet; the nodes of equal priority
+     * are picked in round-robin.
+     */
+    NodeID pickNextWaitingNodeID()
+    {
+        NodeID result;
+        unsigned candidate = last_queried_node_id_;
+        for (unsigned i = 0; i < NodeID::Max; i++)
         {
-            last_queried_node_id_ = s1.output;
+            candidate = (candidate >= NodeID::Max) ? 1U : (candidate + 1U);
+            if (pending_nodes_.test(candidate) &&
+                (findSlot(uint8_t(candidate)) == NULL) &&
+                (!result.isUnicast() || (priorities_[candidate] > priorities_[result.get()])))
+            {
+                result = NodeID(uint8_t(candidate));
+            }
         }
-        else if (last_queried_node_id_ != 0)
+        if (result.isUnicast())
         {
-            // Nothing was found, resetting the selector and trying again
-            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node selector reset, last value: %d", int(last_queried_node_id_));
-            last_queried_node_id_ = 0;
+            last_queried_node_id_ = result.get();
+        }
+        return result;
+    }
 
-            NextNodeIDSearchPredicate s2(*this);
-            (void)pending_nodes_.find<NextNodeIDSearchPredicate&>(s2);
+    void updateReadRate(const MonotonicTime ts)
+    {
+        if (!last_read_rate_update_.isZero() && (ts > last_read_rate_update_))
+        {
+            read_rate_ = uint32_t((uint64_t(bytes_read_) * 1000000U) / uint64_t((ts - last_read_rate_update_).toUSec()));
+        }
+        last_read_rate_update_ = ts;
+        bytes_read_ = 0;
+    }
 
-            if (s2.output != NextNodeIDSearchPredicate::DefaultOutput)
+    /**
+     * The measured read rate is extrapolated to the number of the admitted nodes plus one.
+     */
+    bool isReadBandwidthAvailable() const
+    {
+        if (read_bandwidth_budget_ == 0)
+        {
+            return true;
+        }
+        const unsigned num_reading = getNumUsedSlots(true);
+        if (num_reading == 0)
+        {
+            return read_rate_ < read_bandwidth_budget_;
+        }
+        const uint64_t rate_per_node = read_rate_ / num_reading;
+        return (rate_per_node * (getNumUsedSlots(false) + 1U)) <= read_bandwidth_budget_;
+    }
+
+    void sendRequest(const NodeID node_id)
+    {
+        const PathEntry* const path = getPathOfPendingNode(node_id);
+        if (path == NULL)
+        {
+            UAVCAN_ASSERT(0);   // The node ID is not pending
+            return;
+        }
+
+        protocol::file::BeginFirmwareUpdate::Request req;
+
+        req.source_node_id = getNode().getNodeID().get();
+        if (!common_path_prefix_.empty())
+        {
+            req.image_file_remote_path.path += common_path_prefix_.c_str();
+            req.image_file_remote_path.path.push_back(protocol::file::Path::SEPARATOR);
+        }
+        req.image_file_remote_path.path += path->path.c_str();
+
+        UAVCAN_TRACE("FirmwareUpdateTrigger", "Request to %d with path: %s",
+                     int(node_id.get()), req.image_file_remote_path.path.c_str());
+
+        const int call_res = begin_fw_update_client_.call(node_id, req);
+        if (call_res < 0)
+        {
+            getNode().registerInternalFailure("FirmwareUpdateTrigger call");
+        }
+    }
+
+    void handleTimerEventOrchestrated(const MonotonicTime ts)
+    {
+        updateReadRate(ts);
+
+        for (unsigned i = 0; i < max_concurrent_updates_; i++)
+        {
+            UpdateSlot& slot = slots_[i];
+            if (slot.node_id == 0)
             {
-                last_queried_node_id_ = s2.output;
+                continue;
+            }
+            if ((ts - slot.last_activity) > update_inactivity_timeout_)
+            {
+                // If the node has never confirmed, it will get another chance after the other waiting nodes
+                UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d is inactive, confirmed: %d",
+                             int(slot.node_id), int(slot.confirmed));
+                slot = UpdateSlot();
+            }
+            else if (!slot.confirmed && !begin_fw_update_client_.hasPendingCallToServer(slot.node_id))
+            {
+                sendRequest(slot.node_id);
+            }
+            else
+            {
+                ;   // Updating
             }
         }
-        else
+
+        while (isReadBandwidthAvailable())
         {
-            ; // Hopeless
+            UpdateSlot* const slot = findFreeSlot();
+            if (slot == NULL)
+            {
+                break;
+            }
+            const NodeID node_id = pickNextWaitingNodeID();
+            if (!node_id.isUnicast())
+            {
+                break;
+            }
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d admitted, read rate %u B/s",
+                         int(node_id.get()), unsigned(read_rate_));
+            slot->node_id = node_id.get();
+            slot->confirmed = false;
+            slot->last_activity = ts;
+            sendRequest(node_id);
+        }
+
+        if ((num_pending_nodes_ == 0) && (getNumUsedSlots(false) == 0))
+        {
+            TimerBase::stop();
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Timer stopped");
         }
-        UAVCAN_TRACE("FirmwareUpdateTrigger", "Next node ID to query: %d, pending nodes: %u, pending calls: %u",
-                     int(last_queried_node_id_), pending_nodes_.getSize(),
-                     begin_fw_update_client_.getNumPendingCalls());
-        return last_queried_node_id_;
     }
 
     void handleBeginFirmwareUpdateResponse(const ServiceCallResult<protocol::file::BeginFirmwareUpdate>& result)
@@ -284,8 +674,8 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
             return;
         }
 
-        FirmwareFilePath* const old_path = pending_nodes_.access(result.getCallID().server_node_id);
-        if (old_path == NULL)
+        const PathEntry* const old_entry = getPathOfPendingNode(result.getCallID().server_node_id);
+        if (old_entry == NULL)
         {
             // The entry has been removed, assuming that it's not needed anymore
             return;
@@ -299,67 +689,64 @@ class FirmwareUpdateTrigger : public INodeInfoListener,
         {
             UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d confirmed the update request",
                          int(result.getCallID().server_node_id.get()));
-            pending_nodes_.remove(result.getCallID().server_node_id);
+            removePendingNode(result.getCallID().server_node_id);
+            UpdateSlot* const slot = findSlot(result.getCallID().server_node_id);
+            if (slot != NULL)
+            {
+                slot->confirmed = true;
+                slot->last_activity = getNode().getMonotonicTime();
+            }
             checker_.handleFirmwareUpdateConfirmation(result.getCallID().server_node_id, result.getResponse());
         }
         else
         {
-            UAVCAN_ASSERT(old_path != NULL);
             UAVCAN_ASSERT(TimerBase::isRunning());
-            // We won't have to call trySetPendingNode(), because we'll directly update the old path via the pointer
 
+            FirmwareFilePath path = old_entry->path;
             const bool update_needed =
-                checker_.shouldRetryFirmwareUpdate(result.getCallID().server_node_id, result.getResponse(), *old_path);
+                checker_.shouldRetryFirmwareUpdate(result.getCallID().server_node_id, result.getResponse(), path);
 
             if (!update_needed)
             {
                 UAVCAN_TRACE("FirmwareUpdateTrigger", "Node %d does not need retry",
                              int(result.getCallID().server_node_id.get()));
-                pending_nodes_.remove(result.getCallID().server_node_id);
+                removePendingNode(result.getCallID().server_node_id);
+                releaseSlot(result.getCallID().server_node_id);
+            }
+            else if (path != old_entry->path)
+            {
+                // The old path may be deallocated at this point if no other node refers to it
+                trySetPendingNode(result.getCallID().server_node_id, path);
+            }
+            else
+            {
+                ;   // Retrying with the same path
             }
         }
     }
 
-    virtual void handleTimerEvent(const TimerEvent&)
+    virtual void handleTimerEvent(const TimerEvent& event)
     {
-        if (pending_nodes_.isEmpty())
+        if (isOrchestrated())
         {
-            TimerBase::stop();
-            UAVCAN_TRACE("FirmwareUpdateTrigger", "Timer stopped");
+            handleTimerEventOrchestrated(event.real_time);
             return;
         }
 
-        const NodeID node_id = pickNextNodeID();
-        if (!node_id.isUnicast())
+        if (num_pending_nodes_ == 0)
         {
+            TimerBase::stop();
+            UAVCAN_TRACE("FirmwareUpdateTrigger", "Timer stopped");
             return;
         }
 
-        FirmwareFilePath* const path = pending_nodes_.access(node_id);
-        if (path == NULL)
+        const NodeID node_id = pickNextNodeID();
+        if (!node_id.isUnicast())
         {
-            UAVCAN_ASSERT(0);   // pickNextNodeID() returned a node ID that is not present in the map
             return;
         }
 
-        protocol::file::BeginFirmwareUpdate::Request req;
-
-        req.source_node_id = getNode().getNodeID().get();
-        if (!common_path_prefix_.empty())
-        {
-            req.image_file_remote_path.path += common_path_prefix_.c_str();
-            req.image_file_remote_path.path.push_back(protocol::file::Path::SEPARATOR);
-        }
-        req.image_file_remote_path.path += path->c_str();
-
-        UAVCAN_TRACE("FirmwareUpdateTrigger", "Request to %d with path: %s",
-                     int(node_id.get()), req.image_file_remote_path.path.c_str());
-
-        const int call_res = begin_fw_update_client_.call(node_id, req);
-        if (call_res < 0)
-        {
-            getNode().registerInternalFailure("FirmwareUpdateTrigger call");
-        }
+        sendRequest(node_id);
     }
 
 public:
@@ -368,10 +755,19 @@ public:
         , begin_fw_update_client_(node)
         , checker_(checker)
         , node_info_retriever_(NULL)
-        , pending_nodes_(node.getAllocator())
+        , allocator_(node.getAllocatorFor(MemoryConsumerOther))
+        , num_pending_nodes_(0)
         , request_interval_(MonotonicDuration::fromMSec(DefaultRequestIntervalMs))
         , last_queried_node_id_(0)
-    { }
+        , max_concurrent_updates_(0)
+        , update_inactivity_timeout_(MonotonicDuration::fromMSec(DefaultUpdateInactivityTimeoutMs))
+        , read_bandwidth_budget_(0)
+        , read_rate_(0)
+        , bytes_read_(0)
+    {
+        fill_n(path_indices_, NodeID::Max + 1, uint8_t(0));
+        fill_n(priorities_, NodeID::Max + 1, uint8_t(0));
+    }
 
     ~FirmwareUpdateTrigger()
     {
@@ -379,6 +775,13 @@ public:
         {
             node_info_retriever_->removeListener(this);
         }
+        while (paths_.get() != NULL)
+        {
+            PathEntry* const entry = paths_.get();
+            paths_.remove(entry);
+            entry->~PathEntry();
+            allocator_.deallocate(entry);
+        }
     }
 
     /**
@@ -456,6 +859,56 @@ public:
         }
     }
 
+    /**
+     * Maximum number of nodes that can be updated concurrently; refer to the class documentation for details.
+     * Zero (default) disables the limit, so that the requests are sent to all pending nodes in round-robin.
+     * The value is clamped to @ref MaxConcurrentUpdates. Changing the limit releases all update slots.
+     */
+    unsigned getMaxConcurrentUpdates() const { return max_concurrent_updates_; }
+    void setMaxConcurrentUpdates(const unsigned num)
+    {
+        max_concurrent_updates_ = uint8_t(min(num, unsigned(MaxConcurrentUpdates)));
+        for (unsigned i = 0; i < MaxConcurrentUpdates; i++)
+        {
+            slots_[i] = UpdateSlot();
+        }
+    }
+
+    /**
+     * Aggregate rate of the firmware image reads, in bytes per second, that the admission of new nodes should not
+     * exceed. Zero (default) disables the limit. Requires the read requests to be reported by the file server.
+     */
+    uint32_t getReadBandwidthBudget() const { return read_bandwidth_budget_; }
+    void setReadBandwidthBudget(const uint32_t bytes_per_sec) { read_bandwidth_budget_ = bytes_per_sec; }
+
+    /**
+     * An admitted node that has not confirmed the update request, or an updating node that has not read the image,
+     * for this amount of time releases its slot. It should exceed the time the target nodes may spend without
+     * reading, e.g. while erasing the flash.
+     */
+    MonotonicDuration getUpdateInactivityTimeout() const { return update_inactivity_timeout_; }
+    void setUpdateInactivityTimeout(const MonotonicDuration timeout)
+    {
+        if (timeout.isPositive())
+        {
+            update_inactivity_timeout_ = timeout;
+        }
+        else
+        {
+            UAVCAN_ASSERT(0);
+        }
+    }
+
+    /**
+     * Number of the nodes that hold update slots (orchestrated mode only).
+     */
+    unsigned getNumActiveUpdates() const { return getNumUsedSlots(false); }
+
+    /**
+     * Aggregate read rate reported by the file server, in bytes per second, measured over the last request interval.
+     */
+    uint32_t getReadRate() const { return read_rate_; }
+
     /**
      * This method is mostly needed for testing.
      * When triggering is not in progress, the class consumes zero CPU time.
@@ -464,11 +917,16 @@ public:
 
     unsigned getNumPendingNodes() const
     {
-        const unsigned ret = pending_nodes_.getSize();
+        const unsigned ret = num_pending_nodes_;
         UAVCAN_ASSERT((ret > 0) ? isTimerRunning() : true);
         return ret;
     }
 
+    /**
+     * Number of distinct firmware pathes of the pending nodes; the nodes that share a path share one pool block.
+     */
+    unsigned getNumFirmwarePaths() const { return paths_.getLength(); }
+
 };
 
 }
@@ -8,6 +8,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/node/publisher.hpp>
 #include <uavcan/node/subscriber.hpp>
+#include <uavcan/transport/transfer_buffer.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/util/lazy_constructor.hpp>
 #include <uavcan/protocol/GlobalTimeSync.hpp>
@@ -33,52 +34,43 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
 {
     class IfaceMaster
     {
-        Publisher<protocol::GlobalTimeSync> pub_;
+        INode& node_;
         MonotonicTime iface_prev_pub_mono_;
         UtcTime prev_tx_utc_;
         const uint8_t iface_index_;
 
     public:
         IfaceMaster(INode& node, uint8_t iface_index)
-            : pub_(node)
+            : node_(node)
             , iface_index_(iface_index)
         {
             UAVCAN_ASSERT(iface_index < MaxCanIfaces);
         }
 
-        int init(TransferPriority priority)
-        {
-            const int res = pub_.init(priority);
-            if (res >= 0)
-            {
-                pub_.getTransferSender().setIfaceMask(uint8_t(1 << iface_index_));
-                pub_.getTransferSender().setCanIOFlags(CanIOFlagLoopback);
-            }
-            return res;
-        }
-
         void setTxTimestamp(UtcTime ts)
         {
             if (ts.isZero())
             {
                 UAVCAN_ASSERT(0);
-                pub_.getNode().registerInternalFailure("GlobalTimeSyncMaster zero TX ts");
+                node_.registerInternalFailure("GlobalTimeSyncMaster zero TX ts");
                 return;
             }
             if (!prev_tx_utc_.isZero())
             {
                 prev_tx_utc_ = UtcTime(); // Reset again, because there's something broken in the driver and we don't trust it
-                pub_.getNode().registerInternalFailure("GlobalTimeSyncMaster pub conflict");
+                node_.registerInternalFailure("GlobalTimeSyncMaster pub conflict");
                 return;
             }
             prev_tx_utc_ = ts;
         }
 
-        int publish(TransferID tid, MonotonicTime current_time)
+        /**
+         * Encodes the sync message of this interface into a single frame transfer ready for transmission.
+         * Returns the payload length or negative error code.
+         */
+        int compileFrame(DataTypeID dtid, TransferPriority priority, TransferID tid, MonotonicTime current_time,
+                         CanFrame& out_frame)
         {
-            UAVCAN_ASSERT(pub_.getTransferSender().getCanIOFlags() == CanIOFlagLoopback);
-            UAVCAN_ASSERT(pub_.getTransferSender().getIfaceMask() == (1 << iface_index_));
-
             const MonotonicDuration since_prev_pub = current_time - iface_prev_pub_mono_;
             iface_prev_pub_mono_ = current_time;
             UAVCAN_ASSERT(since_prev_pub.isPositive());
@@ -88,17 +80,44 @@ class UAVCAN_EXPORT GlobalTimeSyncMaster : protected LoopbackFrameListenerBase
             msg.previous_transmission_timestamp_usec = long_period ? 0 : prev_tx_utc_.toUSec();
             prev_tx_utc_ = UtcTime();
 
+            StaticTransferBuffer<BitLenToByteLen<protocol::GlobalTimeSync::MaxBitLen>::Result> buffer;
+            {
+                BitStream bitstream(buffer);
+                ScalarCodec codec(bitstream);
+                if (protocol::GlobalTimeSync::encode(msg, codec) <= 0)
+                {
+                    UAVCAN_ASSERT(0);
+                    return -ErrInvalidMarshalData;
+                }
+            }
+
+            Frame frame(dtid, TransferTypeMessageBroadcast, node_.getNodeID(), NodeID::Broadcast, tid);
+            frame.setPriority(priority);
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            if ((frame.setPayload(buffer.getRawPtr(), buffer.getMaxWritePos()) != buffer.getMaxWritePos()) ||
+                !frame.compile(out_frame))
+            {
+                UAVCAN_ASSERT(0);       // The message always fits one frame
+                return -ErrLogic;
+            }
+
             UAVCAN_TRACE("GlobalTimeSyncMaster", "Publishing %llu iface=%i tid=%i",
                          static_cast<unsigned long long>(msg.previous_transmission_timestamp_usec),
                          int(iface_index_), int(tid.get()));
-            return pub_.broadcast(msg, tid);
+            return int(frame.getPayloadLen());
         }
     };
 
     INode& node_;
     LazyConstructor<IfaceMaster> iface_masters_[MaxCanIfaces];
     MonotonicTime prev_pub_mono_;
+    MonotonicDuration tx_timeout_;
     DataTypeID dtid_;
+    TransferPriority priority_;
+#if !UAVCAN_TINY
+    DataTypeStats* stats_;
+#endif
     bool initialized_;
 
     virtual void handleLoopbackFrame(const RxFrame& frame)
@@ -143,6 +162,10 @@ public:
     explicit GlobalTimeSyncMaster(INode& node)
         : LoopbackFrameListenerBase(node.getDispatcher())
         , node_(node)
+        , tx_timeout_(Publisher<protocol::GlobalTimeSync>::getDefaultTxTimeout())
+#if !UAVCAN_TINY
+        , stats_(NULL)
+#endif
         , initialized_(false)
     { }
 
@@ -166,29 +189,24 @@ public:
             return -ErrUnknownDataType;
         }
         dtid_ = desc->getID();
+        priority_ = priority;
+#if !UAVCAN_TINY
+        stats_ = node_.getDispatcher().getDataTypeStatsTable().access(DataTypeKindMessage, dtid_);
+#endif
 
         // Iface master array
-        int res = -ErrLogic;
         for (uint8_t i = 0; i < MaxCanIfaces; i++)
         {
             if (!iface_masters_[i].isConstructed())
             {
                 iface_masters_[i].construct<INode&, uint8_t>(node_, i);
             }
-            res = iface_masters_[i]->init(priority);
-            if (res < 0)
-            {
-                break;
-            }
         }
 
         // Loopback listener
-        initialized_ = res >= 0;
-        if (initialized_)
-        {
-            LoopbackFrameListenerBase::startListening();
-        }
-        return res;
+        initialized_ = true;
+        LoopbackFrameListenerBase::startListening(dtid_);
+        return 0;
     }
 
     /**
@@ -196,6 +214,12 @@ public:
      */
     bool isInitialized() const { return initialized_; }
 
+    /**
+     * The sync frames that could not be transmitted within this interval are discarded.
+     */
+    void setTxTimeout(MonotonicDuration timeout) { tx_timeout_ = timeout; }
+    MonotonicDuration getTxTimeout() const { return tx_timeout_; }
+
     /**
      * Publishes one sync message.
      *
@@ -205,6 +229,13 @@ public:
      * This method shall be called with a proper interval - refer to the time sync message definition
      * for min/max interval values.
      *
+     * The frames for all interfaces are compiled first, and then handed over to the driver back to back without
+     * blocking, so that the sync messages leave the redundant interfaces as close in time as possible. They share
+     * one Transfer ID; the TX timestamp of every interface is obtained from its own loopback. A failure on one
+     * interface does not prevent publication via the other ones. The publication on every interface is accounted
+     * as one transfer in the transport performance counter and in the data type statistics, same as if it was sent
+     * by a publisher.
+     *
      * Returns negative error code.
      */
     int publish()
@@ -218,6 +249,11 @@ public:
             }
         }
 
+        if (node_.isPassiveMode())
+        {
+            return -ErrPassiveMode;
+        }
+
         /*
          * Enforce max frequency
          */
@@ -245,15 +281,49 @@ public:
             }
         }
 
-        for (uint8_t i = 0; i < node_.getDispatcher().getCanIOManager().getNumIfaces(); i++)
+        const uint8_t num_ifaces = node_.getDispatcher().getCanIOManager().getNumIfaces();
+        CanFrame frames[MaxCanIfaces];
+        unsigned payload_lens[MaxCanIfaces] = { };
+        for (uint8_t i = 0; i < num_ifaces; i++)
         {
-            const int res = iface_masters_[i]->publish(tid, current_time);
+            const int res = iface_masters_[i]->compileFrame(dtid_, priority_, tid, current_time, frames[i]);
             if (res < 0)
             {
                 return res;
             }
+            payload_lens[i] = unsigned(res);
         }
-        return 0;
+
+        /*
+         * The frames bypass TransferSender, so the same accounting is done here
+         */
+        const MonotonicTime tx_deadline = current_time + tx_timeout_;
+        int result = 0;
+        for (uint8_t i = 0; i < num_ifaces; i++)
+        {
+            node_.getDispatcher().getTransferPerfCounter().addTxTransfer();
+#if !UAVCAN_TINY
+            DataTypeStats* const stats = (DataTypeStatsTableSize > 0) ? stats_ : NULL;
+            if (stats != NULL)
+            {
+                stats->transfers_tx++;
+            }
+#endif
+            const int res = node_.getDispatcher().send(frames[i], tx_deadline, MonotonicTime(), CanTxQueue::Volatile,
+                                                       CanIOFlagLoopback, uint8_t(1U << i));
+            if (res < 0)
+            {
+                UAVCAN_TRACE("GlobalTimeSyncMaster", "Send failed: iface=%i res=%i", int(i), res);
+                result = res;
+            }
+#if !UAVCAN_TINY
+            else if (stats != NULL)
+            {
+                stats->addTxFrame(payload_lens[i]);
+            }
+#endif
+        }
+        return result;
     }
 };
 
@@ -22,11 +22,52 @@ namespace uavcan
  *  - CAN bus RX UTC timestamping;
  *  - Clock adjustment method in the system clock interface @ref ISystemClock::adjustUtc().
  *
+ * By default, every measured clock offset is applied to the local clock as is, so the jitter of the RX timestamps
+ * (e.g. caused by bus arbitration) is translated directly into the local UTC. Optionally, the slave can discipline
+ * the local clock instead, see @ref setClockDisciplineEnabled().
+ *
  * Ref. M. Gergeleit, H. Streich - "Implementing a Distributed High-Resolution Real-Time Clock using the CAN-Bus"
  * http://modecs.cs.uni-salzburg.at/results/related_documents/CAN_clock.pdf
  */
 class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
 {
+public:
+    /**
+     * State of the clock discipline, see @ref setClockDisciplineEnabled().
+     */
+    struct ClockDisciplineStatistics
+    {
+        int32_t last_offset_usec;       ///< Last measured offset of the local clock, master minus local
+        int32_t offset_jitter_usec;     ///< Median absolute deviation of the recent offsets
+        int32_t frequency_error_ppb;    ///< Estimated frequency error of the local clock, parts per billion
+        uint32_t num_adjustments;       ///< Filtered adjustments applied to the local clock
+        uint32_t num_outliers;          ///< Measurements that were rejected as outliers
+        uint32_t num_steps;             ///< Measurements that were applied as is, skipping the filter
+        bool locked;                    ///< Recent offsets are all within DisciplineLockThresholdUSec
+
+        ClockDisciplineStatistics()
+            : last_offset_usec(0)
+            , offset_jitter_usec(0)
+            , frequency_error_ppb(0)
+            , num_adjustments(0)
+            , num_outliers(0)
+            , num_steps(0)
+            , locked(false)
+        { }
+    };
+
+    enum { DisciplineStepThresholdUSec = 10000 };
+    enum { DisciplineLockThresholdUSec = 10 };
+
+private:
+    enum { OffsetWindowSize = 5 };
+    enum { MinOffsetsForOutlierRejection = 3 };
+    enum { OutlierMinThresholdUSec = 20 };
+    enum { OutlierThresholdJitterMultiplier = 4 };
+    enum { ProportionalGainDivisor = 2 };
+    enum { IntegralGainDivisor = 8 };
+    enum { MaxFrequencyErrorPPB = 1000000 };
+
     typedef MethodBinder<GlobalTimeSyncSlave*,
                          void (GlobalTimeSyncSlave::*)(const ReceivedDataStructure<protocol::GlobalTimeSync>&)>
         GlobalTimeSyncCallback;
@@ -43,8 +84,153 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
     uint8_t prev_iface_index_;
     bool suppressed_;
 
+    bool discipline_enabled_;
+    bool discipline_initialized_;
+    uint8_t num_offsets_;
+    uint8_t next_offset_index_;
+    uint8_t num_offsets_within_lock_threshold_;
+    int32_t offsets_usec_[OffsetWindowSize];
+    int32_t residual_nsec_;                 ///< Sub-microsecond part of the corrections, carried to the next one
+    MonotonicTime last_discipline_ts_;
+    ClockDisciplineStatistics discipline_stats_;
+
     ISystemClock& getSystemClock() const { return sub_.getNode().getSystemClock(); }
 
+    static int32_t computeMedian(int32_t* values, unsigned num)
+    {
+        for (unsigned i = 1; i < num; i++)         // Insertion sort, the window is tiny
+        {
+            const int32_t x = values[i];
+            unsigned k = i;
+            for (; (k > 0) && (values[k - 1] > x); k--)
+            {
+                values[k] = values[k - 1];
+            }
+            values[k] = x;
+        }
+        return values[num / 2];
+    }
+
+    static int64_t absolute(int64_t x) { return (x < 0) ? -x : x; }
+
+    static int32_t saturateToInt32(int64_t x)
+    {
+        return static_cast<int32_t>(max<int64_t>(min<int64_t>(x, NumericTraits<int32_t>::max()),
+                                                 NumericTraits<int32_t>::min()));
+    }
+
+    void resetClockDiscipline()
+    {
+        discipline_initialized_ = false;
+        num_offsets_ = 0;
+        next_offset_index_ = 0;
+        num_offsets_within_lock_threshold_ = 0;
+        residual_nsec_ = 0;
+        discipline_stats_.locked = false;
+        // The frequency estimate is preserved, it is a property of the local oscillator
+    }
+
+    /**
+     * Returns true if the offset does not fit the recent ones, using the median and the median absolute deviation.
+     * The offset is added to the window in any case, so that a persistent change of the offset is accepted soon.
+     */
+    bool addOffsetAndCheckOutlier(const int32_t offset_usec)
+    {
+        bool outlier = false;
+        if (num_offsets_ >= MinOffsetsForOutlierRejection)
+        {
+            int32_t sorted[OffsetWindowSize];
+            copy(offsets_usec_, offsets_usec_ + num_offsets_, sorted);
+            const int32_t median = computeMedian(sorted, num_offsets_);
+
+            for (unsigned i = 0; i < num_offsets_; i++)
+            {
+                sorted[i] = static_cast<int32_t>(absolute(int64_t(sorted[i]) - median));
+            }
+            discipline_stats_.offset_jitter_usec = computeMedian(sorted, num_offsets_);
+
+            const int64_t threshold = max<int64_t>(OutlierMinThresholdUSec,
+                                                   int64_t(discipline_stats_.offset_jitter_usec) *
+                                                   OutlierThresholdJitterMultiplier);
+            outlier = absolute(int64_t(offset_usec) - median) > threshold;
+        }
+
+        offsets_usec_[next_offset_index_] = offset_usec;
+        next_offset_index_ = static_cast<uint8_t>((next_offset_index_ + 1U) % OffsetWindowSize);
+        num_offsets_ = static_cast<uint8_t>(min<unsigned>(num_offsets_ + 1U, OffsetWindowSize));
+        return outlier;
+    }
+
+    /**
+     * Applies the given correction plus the drift expected from the estimated frequency error since the last
+     * correction; the sub-microsecond remainder is carried over to the next correction.
+     */
+    void applyCorrection(const int64_t correction_nsec, const MonotonicTime ts)
+    {
+        const int64_t dt_usec = (ts - last_discipline_ts_).toUSec();
+        last_discipline_ts_ = ts;
+
+        const int64_t total_nsec = correction_nsec + residual_nsec_ +
+                                   (int64_t(discipline_stats_.frequency_error_ppb) * dt_usec) / 1000000;
+        const int64_t total_usec = total_nsec / 1000;
+        residual_nsec_ = static_cast<int32_t>(total_nsec - total_usec * 1000);
+
+        getSystemClock().adjustUtc(UtcDuration::fromUSec(total_usec));
+    }
+
+    /**
+     * PI controller: the proportional term corrects a fraction of the measured offset, the integral term estimates
+     * the frequency error of the local clock, which is used to compensate the drift. Outliers are not fed into the
+     * controller, but the drift is compensated regardless.
+     * Since @ref ISystemClock does not allow to adjust the clock rate, all corrections are applied as small steps.
+     */
+    void disciplineClock(const UtcDuration adjustment, const MonotonicTime ts)
+    {
+        const int64_t offset_usec = adjustment.toUSec();
+        const int64_t dt_usec = (ts - last_discipline_ts_).toUSec();
+
+        const bool outlier = discipline_initialized_ && addOffsetAndCheckOutlier(saturateToInt32(offset_usec));
+        if (outlier)
+        {
+            UAVCAN_TRACE("GlobalTimeSyncSlave", "Outlier rejected: usec=%lli", static_cast<long long>(offset_usec));
+            discipline_stats_.num_outliers++;
+            applyCorrection(0, ts);
+            return;
+        }
+
+        discipline_stats_.last_offset_usec = saturateToInt32(offset_usec);
+
+        if (!discipline_initialized_ || (absolute(offset_usec) > DisciplineStepThresholdUSec) || (dt_usec <= 0))
+        {
+            getSystemClock().adjustUtc(adjustment);
+            resetClockDiscipline();
+            discipline_initialized_ = true;
+            last_discipline_ts_ = ts;
+            discipline_stats_.num_steps++;
+            return;
+        }
+
+        const int64_t frequency_error_ppb = int64_t(discipline_stats_.frequency_error_ppb) +
+                                            (offset_usec * 1000000000LL / dt_usec) / IntegralGainDivisor;
+        discipline_stats_.frequency_error_ppb =
+            saturateToInt32(max<int64_t>(min<int64_t>(frequency_error_ppb, MaxFrequencyErrorPPB),
+                                         -MaxFrequencyErrorPPB));
+
+        applyCorrection((offset_usec * 1000) / ProportionalGainDivisor, ts);
+        discipline_stats_.num_adjustments++;
+
+        if (absolute(offset_usec) <= DisciplineLockThresholdUSec)
+        {
+            num_offsets_within_lock_threshold_ =
+                static_cast<uint8_t>(min<unsigned>(num_offsets_within_lock_threshold_ + 1U, OffsetWindowSize));
+        }
+        else
+        {
+            num_offsets_within_lock_threshold_ = 0;
+        }
+        discipline_stats_.locked = num_offsets_within_lock_threshold_ >= OffsetWindowSize;
+    }
+
     void adjustFromMsg(const ReceivedDataStructure<protocol::GlobalTimeSync>& msg)
     {
         UAVCAN_ASSERT(msg.previous_transmission_timestamp_usec > 0);
@@ -54,7 +240,15 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
                      static_cast<long long>(adjustment.toUSec()),
                      int(msg.getSrcNodeID().get()), int(msg.getIfaceIndex()), int(suppressed_));
 
-        if (!suppressed_)
+        if (suppressed_)
+        {
+            resetClockDiscipline();
+        }
+        else if (discipline_enabled_)
+        {
+            disciplineClock(adjustment, msg.getMonotonicTimestamp());
+        }
+        else
         {
             getSystemClock().adjustUtc(adjustment);
         }
@@ -89,6 +283,7 @@ class UAVCAN_EXPORT GlobalTimeSyncSlave : Noncopyable
         {
             UAVCAN_TRACE("GlobalTimeSyncSlave", "Force update: needs_init=%i switch_master=%i pub_timeout=%i",
                          int(needs_init), int(switch_master), int(pub_timeout));
+            resetClockDiscipline();
             updateFromMsg(msg);
         }
         else if (msg.getIfaceIndex() == prev_iface_index_ && msg.getSrcNodeID() == master_nid_)
@@ -140,7 +335,15 @@ public:
         , state_(Update)
         , prev_iface_index_(0xFF)
         , suppressed_(false)
-    { }
+        , discipline_enabled_(false)
+        , discipline_initialized_(false)
+        , num_offsets_(0)
+        , next_offset_index_(0)
+        , num_offsets_within_lock_threshold_(0)
+        , residual_nsec_(0)
+    {
+        fill(offsets_usec_, offsets_usec_ + OffsetWindowSize, int32_t(0));
+    }
 
     /**
      * Starts the time sync slave. Once started, it works on its own and does not require any
@@ -169,6 +372,30 @@ public:
     void suppress(bool suppressed) { suppressed_ = suppressed; }
     bool isSuppressed() const { return suppressed_; }
 
+    /**
+     * Enable or disable the clock discipline mode.
+     *
+     * In this mode the measured offsets are not applied to the local clock directly. Instead, offsets that deviate
+     * from the median of the recent ones by more than a few median absolute deviations are rejected as outliers,
+     * and the remaining ones are fed into a PI controller that estimates the frequency error of the local clock.
+     * This way, the jitter of the RX timestamps is attenuated rather than translated into UTC jumps.
+     * Offsets larger than DisciplineStepThresholdUSec, e.g. upon the first synchronization or a master switch,
+     * are applied as is.
+     *
+     * The clock discipline mode is disabled by default.
+     */
+    void setClockDisciplineEnabled(const bool enabled)
+    {
+        discipline_enabled_ = enabled;
+        resetClockDiscipline();
+    }
+    bool isClockDisciplineEnabled() const { return discipline_enabled_; }
+
+    /**
+     * Convergence statistics of the clock discipline.
+     */
+    const ClockDisciplineStatistics& getClockDisciplineStatistics() const { return discipline_stats_; }
+
     /**
      * If the clock sync slave sees any clock sync masters in the network, it is ACTIVE.
      * When the last master times out (PUBLISHER_TIMEOUT), the slave will be INACTIVE.
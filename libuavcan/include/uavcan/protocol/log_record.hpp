@@ -0,0 +1,506 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_LOG_RECORD_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_LOG_RECORD_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/protocol/debug/LogLevel.hpp>
+#include <uavcan/marshal/char_array_formatter.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/util/templates.hpp>
+#include <cstring>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+namespace uavcan
+{
+/**
+ * Compact binary log records.
+ *
+ * A log record carries the ID of the format string and the raw values of the arguments instead of the formatted
+ * text; the text is rendered by the receiving side, which knows the format strings of the firmware.
+ * The format string ID is a 32-bit FNV-1a hash of the format string (see @ref LogRecordEncoder::computeFormatID()).
+ *
+ * Every argument is encoded as a one byte type tag followed by the value:
+ *  - ArgUnsigned, ArgSigned, ArgPointer: variable length integer, 7 bits per byte, least significant group first,
+ *    the highest bit of a byte is set if more bytes follow; signed values are zigzag encoded;
+ *  - ArgChar: one byte;
+ *  - ArgFloat, ArgDouble: IEEE 754 binary32 or binary64, little endian;
+ *  - ArgString: the characters followed by a zero byte.
+ * The arguments that don't fit into the record are dropped; a string that doesn't fit is truncated.
+ */
+class UAVCAN_EXPORT LogRecordEncoder
+{
+public:
+    enum ArgType
+    {
+        ArgUnsigned,
+        ArgSigned,
+        ArgChar,
+        ArgFloat,
+        ArgDouble,
+        ArgString,
+        ArgPointer
+    };
+
+    /**
+     * Format string ID, as used by the record publishers.
+     */
+    static uint32_t computeFormatID(const char* format)
+    {
+        uint32_t hash = 0x811C9DC5U;
+        while ((format != NULL) && (*format != '\0'))
+        {
+            hash = (hash ^ uint8_t(*format++)) * 0x01000193U;
+        }
+        return hash;
+    }
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+private:
+    uint8_t* const buf_;
+    const unsigned capacity_;
+    unsigned size_;
+    bool truncated_;
+
+    bool reserve(unsigned len)
+    {
+        if (truncated_ || (len > (capacity_ - size_)))
+        {
+            truncated_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    static unsigned getVarintLength(unsigned long long value)
+    {
+        unsigned len = 1;
+        while (value >= 0x80U)
+        {
+            value >>= 7;
+            len++;
+        }
+        return len;
+    }
+
+    void putVarint(ArgType type, unsigned long long value)
+    {
+        if (reserve(1U + getVarintLength(value)))
+        {
+            buf_[size_++] = uint8_t(type);
+            while (value >= 0x80U)
+            {
+                buf_[size_++] = uint8_t((value & 0x7FU) | 0x80U);
+                value >>= 7;
+            }
+            buf_[size_++] = uint8_t(value);
+        }
+    }
+
+    template <typename Bits>
+    void putLittleEndian(ArgType type, Bits bits)
+    {
+        if (reserve(1U + sizeof(Bits)))
+        {
+            buf_[size_++] = uint8_t(type);
+            for (unsigned i = 0; i < sizeof(Bits); i++)
+            {
+                buf_[size_++] = uint8_t(bits >> (i * 8U));
+            }
+        }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    encodeValue(T value)
+    {
+        StaticAssert<sizeof(float) == 4>::check();
+        StaticAssert<sizeof(double) == 8>::check();
+        if (std::is_same<T, float>())
+        {
+            const float x = float(value);
+            uint32_t bits = 0;
+            (void)std::memcpy(&bits, &x, sizeof(bits));
+            putLittleEndian(ArgFloat, bits);
+        }
+        else
+        {
+            const double x = double(value);
+            uint64_t bits = 0;
+            (void)std::memcpy(&bits, &x, sizeof(bits));
+            putLittleEndian(ArgDouble, bits);
+        }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type
+    encodeValue(T value)
+    {
+        if (std::is_same<T, char>())
+        {
+            if (reserve(2))
+            {
+                buf_[size_++] = uint8_t(ArgChar);
+                buf_[size_++] = uint8_t(value);
+            }
+        }
+        else if (std::is_signed<T>())
+        {
+            const long long x = static_cast<long long>(value);
+            const unsigned long long zigzag = (x < 0) ? (((~static_cast<unsigned long long>(x)) << 1) | 1U)
+                                                      : (static_cast<unsigned long long>(x) << 1);
+            putVarint(ArgSigned, zigzag);
+        }
+        else
+        {
+            putVarint(ArgUnsigned, static_cast<unsigned long long>(value));
+        }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_pointer<T>::value && !std::is_same<T, const char*>::value>::type
+    encodeValue(T value)
+    {
+        putVarint(ArgPointer, reinterpret_cast<unsigned long long>(static_cast<const void*>(value)));
+    }
+
+    void encodeValue(const char* value)
+    {
+        if (value == NULL)
+        {
+            value = "(null)";
+        }
+        if (reserve(2))                         // The tag and the terminator, the text is truncated if needed
+        {
+            buf_[size_++] = uint8_t(ArgString);
+            while ((*value != '\0') && ((capacity_ - size_) > 1))
+            {
+                buf_[size_++] = uint8_t(*value++);
+            }
+            buf_[size_++] = 0;
+        }
+    }
+
+public:
+    LogRecordEncoder(uint8_t* buffer, unsigned capacity)
+        : buf_(buffer)
+        , capacity_(capacity)
+        , size_(0)
+        , truncated_(false)
+    { }
+
+    /**
+     * Appends the arguments to the record.
+     * The supported argument types are the same as of @ref CharArrayFormatter.
+     */
+    void write() { }
+
+    template <typename T, typename... Args>
+    void write(T value, Args... args)
+    {
+        encodeValue(value);
+        write(args...);
+    }
+
+    unsigned getSize() const { return size_; }
+
+    /**
+     * Whether some of the arguments have been dropped or truncated.
+     */
+    bool isTruncated() const { return truncated_; }
+
+#endif
+};
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+/**
+ * Renders a log record into text, exactly as @ref CharArrayFormatter would have rendered the original arguments.
+ * This is the receiving side of the log records; it is not needed on the node that produces them.
+ */
+template <typename CharArrayType_>
+class UAVCAN_EXPORT LogRecordRenderer
+{
+    CharArrayFormatter<CharArrayType_> formatter_;
+    const uint8_t* data_;
+    unsigned size_;
+    unsigned offset_;
+
+    bool getBytes(unsigned len, uint64_t& out_bits)
+    {
+        if (len > (size_ - offset_))
+        {
+            return false;
+        }
+        out_bits = 0;
+        for (unsigned i = 0; i < len; i++)
+        {
+            out_bits |= uint64_t(data_[offset_++]) << (i * 8U);
+        }
+        return true;
+    }
+
+    bool getVarint(unsigned long long& out_value)
+    {
+        out_value = 0;
+        for (unsigned shift = 0; (offset_ < size_) && (shift < 64); shift += 7)
+        {
+            const uint8_t byte = data_[offset_++];
+            out_value |= static_cast<unsigned long long>(byte & 0x7FU) << shift;
+            if ((byte & 0x80U) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Returns negative error code if the record is malformed.
+     */
+    int renderNextArg()
+    {
+        const LogRecordEncoder::ArgType type = LogRecordEncoder::ArgType(data_[offset_++]);
+        unsigned long long integer = 0;
+        uint64_t bits = 0;
+        switch (type)
+        {
+        case LogRecordEncoder::ArgUnsigned:
+        {
+            if (!getVarint(integer))
+            {
+                return -ErrFailure;
+            }
+            formatter_.write("%*", integer);
+            break;
+        }
+        case LogRecordEncoder::ArgSigned:
+        {
+            if (!getVarint(integer))
+            {
+                return -ErrFailure;
+            }
+            const unsigned long long magnitude = integer >> 1;
+            if ((integer & 1U) != 0)
+            {
+                formatter_.write("-%*", magnitude + 1U);    // Can't be represented as long long if it is the minimum
+            }
+            else
+            {
+                formatter_.write("%*", magnitude);
+            }
+            break;
+        }
+        case LogRecordEncoder::ArgChar:
+        {
+            if (!getBytes(1, bits))
+            {
+                return -ErrFailure;
+            }
+            formatter_.write("%*", char(bits));
+            break;
+        }
+        case LogRecordEncoder::ArgFloat:
+        {
+            if (!getBytes(4, bits))
+            {
+                return -ErrFailure;
+            }
+            const uint32_t bits32 = uint32_t(bits);
+            float x = 0;
+            (void)std::memcpy(&x, &bits32, sizeof(x));
+            formatter_.write("%*", x);
+            break;
+        }
+        case LogRecordEncoder::ArgDouble:
+        {
+            if (!getBytes(8, bits))
+            {
+                return -ErrFailure;
+            }
+            double x = 0;
+            (void)std::memcpy(&x, &bits, sizeof(x));
+            formatter_.write("%*", x);
+            break;
+        }
+        case LogRecordEncoder::ArgString:
+        {
+            const char* const str = reinterpret_cast<const char*>(data_ + offset_);
+            while ((offset_ < size_) && (data_[offset_] != 0))
+            {
+                offset_++;
+            }
+            if (offset_ >= size_)
+            {
+                return -ErrFailure;
+            }
+            offset_++;
+            formatter_.write("%*", str);
+            break;
+        }
+        case LogRecordEncoder::ArgPointer:
+        {
+            if (!getVarint(integer))
+            {
+                return -ErrFailure;
+            }
+            formatter_.write("%*", reinterpret_cast<const void*>(static_cast<std::size_t>(integer)));
+            break;
+        }
+        default:
+        {
+            return -ErrFailure;
+        }
+        }
+        return 0;
+    }
+
+public:
+    explicit LogRecordRenderer(CharArrayType_& output)
+        : formatter_(output)
+        , data_(NULL)
+        , size_(0)
+        , offset_(0)
+    { }
+
+    /**
+     * Appends the text of the record to the output array.
+     * Returns negative error code if the record is malformed; the text rendered so far is kept.
+     */
+    int render(const char* format, const uint8_t* data, unsigned size)
+    {
+        data_ = data;
+        size_ = size;
+        offset_ = 0;
+
+        const char* s = format;
+        while ((s != NULL) && (*s != '\0'))
+        {
+            if (offset_ >= size_)
+            {
+                formatter_.write(s);            // No arguments left, the rest is printed as is
+                break;
+            }
+            if (*s == '%')
+            {
+                s++;
+                if (*s != '%')
+                {
+                    const int res = renderNextArg();
+                    if (res < 0)
+                    {
+                        return res;
+                    }
+                    if (*s == '\0')
+                    {
+                        break;
+                    }
+                    s++;
+                    continue;
+                }
+            }
+            formatter_.write("%*", *s++);
+        }
+        return 0;
+    }
+};
+
+#endif
+
+/**
+ * Receiver of the binary log records, see @ref Logger::setRecordSink().
+ */
+class UAVCAN_EXPORT ILogRecordSink
+{
+public:
+    typedef typename StorageType<typename protocol::debug::LogLevel::FieldTypes::value>::Type LogLevel;
+
+    virtual ~ILogRecordSink() { }
+
+    /**
+     * Maximum size of the encoded arguments accepted by @ref logRecord(), in bytes.
+     */
+    virtual unsigned getMaxArgumentsSize() const = 0;
+
+    /**
+     * @param level     Severity level of the record.
+     * @param source    Source of the record, as passed to the logger.
+     * @param format    Format string; it is not rendered.
+     * @param args      Arguments encoded with @ref LogRecordEncoder.
+     * @param args_size Size of the encoded arguments, never exceeds @ref getMaxArgumentsSize().
+     * @return          Negative error code.
+     */
+    virtual int logRecord(LogLevel level, const char* source, const char* format,
+                          const uint8_t* args, unsigned args_size) = 0;
+};
+
+/**
+ * Broadcasts the binary log records using an application-defined (vendor-specific) message type.
+ * The message type must have the following fields (the capacity of the arrays is up to the application):
+ *
+ *      uavcan.protocol.debug.LogLevel level
+ *      uint32 format_id
+ *      uint8[<=31] source
+ *      uint8[<=64] args
+ *
+ * The receiving side renders the text using the format strings of the firmware, see @ref LogRecordRenderer.
+ */
+template <typename MessageType_>
+class UAVCAN_EXPORT LogRecordPublisher : public ILogRecordSink
+{
+public:
+    typedef MessageType_ MessageType;
+
+private:
+    enum { DefaultTxTimeoutMs = 2000 };
+
+    Publisher<MessageType> pub_;
+    MessageType msg_buf_;
+
+public:
+    explicit LogRecordPublisher(INode& node)
+        : pub_(node)
+    {
+        setTxTimeout(MonotonicDuration::fromMSec(DefaultTxTimeoutMs));
+    }
+
+    /**
+     * Initializes the publisher, does not perform any network activity.
+     * Returns negative error code.
+     */
+    int init(const TransferPriority priority = TransferPriority::Lowest)
+    {
+        return pub_.init(priority);
+    }
+
+    virtual unsigned getMaxArgumentsSize() const { return MessageType::FieldTypes::args::MaxSize; }
+
+    virtual int logRecord(LogLevel level, const char* source, const char* format,
+                          const uint8_t* args, unsigned args_size)
+    {
+        UAVCAN_ASSERT(args_size <= getMaxArgumentsSize());
+        msg_buf_.level.value = level;
+        msg_buf_.format_id = LogRecordEncoder::computeFormatID(format);
+        msg_buf_.source = source;
+        msg_buf_.args.clear();
+        for (unsigned i = 0; (i < args_size) && (msg_buf_.args.size() < msg_buf_.args.capacity()); i++)
+        {
+            msg_buf_.args.push_back(args[i]);
+        }
+        return pub_.broadcast(msg_buf_);
+    }
+
+    MonotonicDuration getTxTimeout() const { return pub_.getTxTimeout(); }
+    void setTxTimeout(MonotonicDuration val) { pub_.setTxTimeout(val); }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_LOG_RECORD_HPP_INCLUDED
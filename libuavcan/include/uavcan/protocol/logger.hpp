@@ -8,8 +8,11 @@
 #include <uavcan/time.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/protocol/debug/LogMessage.hpp>
+#include <uavcan/protocol/log_record.hpp>
 #include <uavcan/marshal/char_array_formatter.hpp>
 #include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/method_binder.hpp>
 #include <cstdlib>
 
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
@@ -54,6 +57,17 @@ public:
  *  - Sink into the application via @ref ILogSink.
  *
  * For each sink an individual severity threshold filter can be configured.
+ *
+ * By default the messages are broadcasted synchronously, i.e. the message is encoded and its frames are enqueued
+ * from the context of the logging call. In the asynchronous mode (see @ref enableAsyncMode()) the logging call
+ * only copies the message into a ring buffer provided by the application, and a timer broadcasts the buffered
+ * messages one by one with a limited rate; messages that don't fit into the buffer are dropped and counted.
+ * The external sink is always invoked synchronously.
+ *
+ * If a record sink is installed (see @ref setRecordSink()), the messages that pass the broadcasting severity filter
+ * are not formatted; instead, the format string and the raw arguments are passed to the record sink (normally a
+ * @ref LogRecordPublisher), and the text is rendered by the receiving side. The text is then formatted only if the
+ * external sink needs it. The asynchronous mode does not apply to the records.
  */
 class UAVCAN_EXPORT Logger
 {
@@ -66,23 +80,85 @@ public:
      */
     static LogLevel getLogLevelAboveAll() { return (1U << protocol::debug::LogLevel::FieldTypes::value::BitLen) - 1U; }
 
+    enum { DefaultAsyncMinIntervalMs = 100 };
+
+    /**
+     * The arguments of a log record are encoded on the stack, so the size is limited.
+     */
+    enum { MaxRecordArgumentsSize = 64 };
+
 private:
     enum { DefaultTxTimeoutMs = 2000 };
 
+    typedef MethodBinder<Logger*, void (Logger::*)(const TimerEvent&)> TimerCallback;
+
     Publisher<protocol::debug::LogMessage> logmsg_pub_;
+    TimerEventForwarder<TimerCallback> async_timer_;
     protocol::debug::LogMessage msg_buf_;
     LogLevel level_;
     ILogSink* external_sink_;
+    ILogRecordSink* record_sink_;
+
+    protocol::debug::LogMessage* async_queue_;      ///< Ring buffer; null pointer in the synchronous mode
+    uint16_t async_queue_capacity_;
+    uint16_t async_queue_head_;
+    uint16_t async_queue_size_;
+    MonotonicDuration async_min_interval_;
+    MonotonicTime last_async_broadcast_ts_;
+    uint32_t num_dropped_messages_;
 
     LogLevel getExternalSinkLevel() const
     {
         return (external_sink_ == NULL) ? getLogLevelAboveAll() : external_sink_->getLogLevel();
     }
 
+    int enqueue(const protocol::debug::LogMessage& message)
+    {
+        if (async_queue_size_ >= async_queue_capacity_)
+        {
+            num_dropped_messages_++;
+            return -ErrMemory;
+        }
+        async_queue_[(async_queue_head_ + async_queue_size_) % async_queue_capacity_] = message;
+        async_queue_size_++;
+        if (!async_timer_.isRunning())
+        {
+            // Fires at the next spin if the previous broadcast happened long enough ago
+            async_timer_.startOneShotWithDeadline(last_async_broadcast_ts_ + async_min_interval_);
+        }
+        return 0;
+    }
+
+    void handleAsyncTimerEvent(const TimerEvent& event)
+    {
+        if (async_queue_size_ == 0)
+        {
+            return;
+        }
+        if (logmsg_pub_.broadcast(async_queue_[async_queue_head_]) < 0)
+        {
+            num_dropped_messages_++;
+        }
+        async_queue_head_ = uint16_t((async_queue_head_ + 1U) % async_queue_capacity_);
+        async_queue_size_--;
+        last_async_broadcast_ts_ = event.real_time;
+        if (async_queue_size_ > 0)
+        {
+            async_timer_.startOneShotWithDeadline(event.real_time + async_min_interval_);
+        }
+    }
+
 public:
     explicit Logger(INode& node)
         : logmsg_pub_(node)
+        , async_timer_(node)
         , external_sink_(NULL)
+        , record_sink_(NULL)
+        , async_queue_(NULL)
+        , async_queue_capacity_(0)
+        , async_queue_head_(0)
+        , async_queue_size_(0)
+        , num_dropped_messages_(0)
     {
         level_ = protocol::debug::LogLevel::ERROR;
         setTxTimeout(MonotonicDuration::fromMSec(DefaultTxTimeoutMs));
@@ -108,7 +184,8 @@ public:
      * Logs one message. Please consider using helper methods instead of this one.
      *
      * The message will be broadcasted via the UAVCAN bus if the severity level of the
-     * message is >= severity level of the logger.
+     * message is >= severity level of the logger. In the asynchronous mode the message is
+     * only buffered, and -ErrMemory is returned if the buffer is full.
      *
      * The message will be reported into the external log sink if the external sink is
      * installed and the severity level of the message is >= severity level of the external sink.
@@ -124,11 +201,59 @@ public:
         }
         if (message.level.value >= level_)
         {
-            retval = logmsg_pub_.broadcast(message);
+            retval = (async_queue_ == NULL) ? logmsg_pub_.broadcast(message) : enqueue(message);
         }
         return retval;
     }
 
+    /**
+     * Switches the broadcasting into the asynchronous mode, see the class documentation.
+     * The buffer is provided by the application and must remain valid until the asynchronous mode is disabled.
+     * The buffered messages will be broadcasted not more often than once per min_interval.
+     * Returns negative error code.
+     */
+    int enableAsyncMode(protocol::debug::LogMessage* queue_storage, uint16_t capacity,
+                        MonotonicDuration min_interval = MonotonicDuration::fromMSec(DefaultAsyncMinIntervalMs))
+    {
+        if (queue_storage == NULL || capacity == 0 || min_interval.isNegative())
+        {
+            return -ErrInvalidParam;
+        }
+        disableAsyncMode();
+        async_queue_ = queue_storage;
+        async_queue_capacity_ = capacity;
+        async_min_interval_ = min_interval;
+        async_timer_.setCallback(TimerCallback(this, &Logger::handleAsyncTimerEvent));
+        return 0;
+    }
+
+    /**
+     * Switches back to the synchronous mode. The messages that are still buffered are discarded
+     * and counted as dropped.
+     */
+    void disableAsyncMode()
+    {
+        async_timer_.stop();
+        num_dropped_messages_ += async_queue_size_;
+        async_queue_ = NULL;
+        async_queue_capacity_ = 0;
+        async_queue_head_ = 0;
+        async_queue_size_ = 0;
+    }
+
+    bool isAsyncModeEnabled() const { return async_queue_ != NULL; }
+
+    /**
+     * Number of messages waiting in the asynchronous mode buffer.
+     */
+    unsigned getNumPendingMessages() const { return async_queue_size_; }
+
+    /**
+     * Number of messages that were lost in the asynchronous mode: because the buffer was full, because the
+     * broadcasting failed, or because the asynchronous mode was disabled before they could be broadcasted.
+     */
+    uint32_t getNumDroppedMessages() const { return num_dropped_messages_; }
+
     /**
      * Severity filter for UAVCAN broadcasting.
      * Log message will be broadcasted via the UAVCAN network only if its severity is >= getLevel().
@@ -147,6 +272,15 @@ public:
     ILogSink* getExternalSink() const { return external_sink_; }
     void setExternalSink(ILogSink* sink) { external_sink_ = sink; }
 
+    /**
+     * Record sink replaces the broadcasting of the formatted messages with binary log records, see the class
+     * documentation. The severity filter of the broadcasting (@ref getLevel()) applies to the records.
+     * Null pointer means that there's no record sink (can be used to remove it).
+     * By default there's no record sink.
+     */
+    ILogRecordSink* getRecordSink() const { return record_sink_; }
+    void setRecordSink(ILogRecordSink* sink) { record_sink_ = sink; }
+
     /**
      * Log message broadcast transmission timeout.
      * The default value should be acceptable for any use case.
@@ -208,14 +342,27 @@ public:
         try
     #endif
         {
-            if (level >= level_ || level >= getExternalSinkLevel())
+            int retval = 0;
+            const bool use_record = (record_sink_ != NULL) && (level >= level_);
+            if (use_record)
+            {
+                retval = record_sink_->logRecord(level, source, text, NULL, 0);
+            }
+            if ((!use_record && (level >= level_)) || (level >= getExternalSinkLevel()))
             {
                 msg_buf_.level.value = level;
                 msg_buf_.source = source;
                 msg_buf_.text = text;
-                return log(msg_buf_);
+                if (use_record)
+                {
+                    external_sink_->log(msg_buf_);
+                }
+                else
+                {
+                    retval = log(msg_buf_);
+                }
             }
-            return 0;
+            return retval;
         }
     #if UAVCAN_EXCEPTIONS
         catch (...)
@@ -260,16 +407,33 @@ int Logger::log(LogLevel level, const char* source, const char* format, Args...
     try
 #endif
     {
-        if (level >= level_ || level >= getExternalSinkLevel())
+        int retval = 0;
+        const bool use_record = (record_sink_ != NULL) && (level >= level_);
+        if (use_record)
+        {
+            uint8_t buffer[MaxRecordArgumentsSize];
+            LogRecordEncoder encoder(buffer, min(unsigned(MaxRecordArgumentsSize),
+                                                 record_sink_->getMaxArgumentsSize()));
+            encoder.write(args...);
+            retval = record_sink_->logRecord(level, source, format, buffer, encoder.getSize());
+        }
+        if ((!use_record && (level >= level_)) || (level >= getExternalSinkLevel()))
         {
             msg_buf_.level.value = level;
             msg_buf_.source = source;
             msg_buf_.text.clear();
             CharArrayFormatter<typename protocol::debug::LogMessage::FieldTypes::text> formatter(msg_buf_.text);
             formatter.write(format, args...);
-            return log(msg_buf_);
+            if (use_record)
+            {
+                external_sink_->log(msg_buf_);      // The message has been recorded already
+            }
+            else
+            {
+                retval = log(msg_buf_);
+            }
         }
-        return 0;
+        return retval;
     }
 #if UAVCAN_EXCEPTIONS
     catch (...)
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_MEMORY_USAGE_PUBLISHER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_MEMORY_USAGE_PUBLISHER_HPP_INCLUDED
+
+#include <uavcan/debug.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+
+namespace uavcan
+{
+/**
+ * Publishes memory pool usage statistics of the local node as uavcan.protocol.debug.KeyValue messages.
+ * This helps to find out which subsystem has exhausted the memory pool.
+ *
+ * Three values are published for every subsystem that is tracked by the node (see INode::getMemoryUsage()):
+ * number of used blocks, peak number of used blocks, and number of failed allocations. The keys look like
+ * "mem.rx.used", "mem.rx.peak", "mem.rx.fail", where the second component identifies the subsystem:
+ *  - txq   - CAN TX queues
+ *  - rx    - transfer receivers and buffers
+ *  - otr   - outgoing transfer registry
+ *  - srv   - service call registries
+ *  - other - everything else
+ *
+ * The statistics can be published either once by calling @ref publish(), or periodically.
+ */
+class UAVCAN_EXPORT MemoryUsagePublisher : private TimerBase
+{
+    Publisher<protocol::debug::KeyValue> pub_;
+
+    static const char* getConsumerName(MemoryConsumer consumer)
+    {
+        static const char* const Names[NumMemoryConsumers] = { "txq", "rx", "otr", "srv", "other" };
+        return (consumer < NumMemoryConsumers) ? Names[consumer] : "";
+    }
+
+    int publishValue(MemoryConsumer consumer, const char* suffix, uint32_t value)
+    {
+        protocol::debug::KeyValue msg;
+        msg.key = "mem.";
+        msg.key += getConsumerName(consumer);
+        msg.key += suffix;
+        msg.value = static_cast<float>(value);
+        return pub_.broadcast(msg);
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        if (publish() < 0)
+        {
+            pub_.getNode().registerInternalFailure("MemoryUsagePublisher pub failed");
+        }
+    }
+
+public:
+    explicit MemoryUsagePublisher(INode& node)
+        : TimerBase(node)
+        , pub_(node)
+    { }
+
+    /**
+     * Publishes the statistics once.
+     * Returns negative error code if any message could not be published.
+     */
+    int publish()
+    {
+        int result = 0;
+        for (int i = 0; i < NumMemoryConsumers; i++)
+        {
+            const MemoryConsumer consumer = MemoryConsumer(i);
+            const InstrumentedPoolAllocator* const usage = pub_.getNode().getMemoryUsage(consumer);
+            if (usage == NULL)
+            {
+                continue;
+            }
+            const int res[] =
+            {
+                publishValue(consumer, ".used", usage->getNumUsedBlocks()),
+                publishValue(consumer, ".peak", usage->getPeakNumUsedBlocks()),
+                publishValue(consumer, ".fail", usage->getNumFailures())
+            };
+            for (unsigned k = 0; k < (sizeof(res) / sizeof(res[0])); k++)
+            {
+                if (res[k] < 0)
+                {
+                    result = res[k];
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Starts periodic publishing with the specified interval.
+     */
+    void startPeriodic(MonotonicDuration period)
+    {
+        UAVCAN_TRACE("MemoryUsagePublisher", "Starting with period %u ms", unsigned(period.toMSec()));
+        TimerBase::startPeriodic(period);
+    }
+
+    /**
+     * Stops periodic publishing.
+     */
+    void stop() { TimerBase::stop(); }
+
+    bool isRunning() const { return TimerBase::isRunning(); }
+
+    /**
+     * Priority and TX timeout of the outgoing messages can be configured via the publisher.
+     */
+    Publisher<protocol::debug::KeyValue>& getPublisher() { return pub_; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_MEMORY_USAGE_PUBLISHER_HPP_INCLUDED
@@ -8,6 +8,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/util/multiset.hpp>
+#include <uavcan/util/map.hpp>
 #include <uavcan/node/service_client.hpp>
 #include <uavcan/node/timer.hpp>
 #include <uavcan/protocol/node_status_monitor.hpp>
@@ -15,6 +16,113 @@
 
 namespace uavcan
 {
+/**
+ * Compact summary of a GetNodeInfo response that is kept in the node info cache of @ref NodeInfoRetriever.
+ * The name and the certificate of authenticity are not stored, but they are covered by the hash together with
+ * the rest of the software and hardware version fields. The node status is not covered.
+ */
+struct UAVCAN_EXPORT NodeInfoSummary
+{
+    enum { UniqueIDSize = protocol::HardwareVersion::FieldTypes::unique_id::MaxSize };
+
+    uint32_t software_image_crc_low;    ///< The image CRC is split so that the map entry fits a 48-byte pool block
+    uint32_t software_image_crc_high;
+    uint32_t software_vcs_commit;
+    uint32_t hash;
+    uint8_t software_version_major;
+    uint8_t software_version_minor;
+    uint8_t software_optional_field_flags;
+    uint8_t hardware_version_major;
+    uint8_t hardware_version_minor;
+    uint8_t hardware_unique_id[UniqueIDSize];
+
+private:
+    static uint32_t addToHash(uint32_t hash, uint64_t value, unsigned num_bytes)
+    {
+        for (unsigned i = 0; i < num_bytes; i++)
+        {
+            hash = (hash ^ static_cast<uint8_t>(value >> (i * 8U))) * 16777619U;     // FNV-1a
+        }
+        return hash;
+    }
+
+    template <typename Array>
+    static uint32_t addArrayToHash(uint32_t hash, const Array& array)
+    {
+        hash = addToHash(hash, array.size(), 1);
+        for (typename Array::const_iterator it = array.begin(); it != array.end(); ++it)
+        {
+            hash = addToHash(hash, *it, 1);
+        }
+        return hash;
+    }
+
+public:
+    static uint32_t computeHash(const protocol::GetNodeInfo::Response& node_info)
+    {
+        uint32_t hash = 2166136261U;
+        hash = addToHash(hash, node_info.software_version.major, 1);
+        hash = addToHash(hash, node_info.software_version.minor, 1);
+        hash = addToHash(hash, node_info.software_version.optional_field_flags, 1);
+        hash = addToHash(hash, node_info.software_version.vcs_commit, 4);
+        hash = addToHash(hash, node_info.software_version.image_crc, 8);
+        hash = addToHash(hash, node_info.hardware_version.major, 1);
+        hash = addToHash(hash, node_info.hardware_version.minor, 1);
+        hash = addArrayToHash(hash, node_info.hardware_version.unique_id);
+        hash = addArrayToHash(hash, node_info.hardware_version.certificate_of_authenticity);
+        return addArrayToHash(hash, node_info.name);
+    }
+
+    NodeInfoSummary()
+        : software_image_crc_low(0)
+        , software_image_crc_high(0)
+        , software_vcs_commit(0)
+        , hash(0)
+        , software_version_major(0)
+        , software_version_minor(0)
+        , software_optional_field_flags(0)
+        , hardware_version_major(0)
+        , hardware_version_minor(0)
+    {
+        fill(hardware_unique_id, hardware_unique_id + UniqueIDSize, uint8_t(0));
+    }
+
+    explicit NodeInfoSummary(const protocol::GetNodeInfo::Response& node_info)
+        : software_image_crc_low(static_cast<uint32_t>(node_info.software_version.image_crc & 0xFFFFFFFFU))
+        , software_image_crc_high(static_cast<uint32_t>(node_info.software_version.image_crc >> 32))
+        , software_vcs_commit(node_info.software_version.vcs_commit)
+        , hash(computeHash(node_info))
+        , software_version_major(node_info.software_version.major)
+        , software_version_minor(node_info.software_version.minor)
+        , software_optional_field_flags(node_info.software_version.optional_field_flags)
+        , hardware_version_major(node_info.hardware_version.major)
+        , hardware_version_minor(node_info.hardware_version.minor)
+    {
+        copy(node_info.hardware_version.unique_id.begin(), node_info.hardware_version.unique_id.end(),
+             hardware_unique_id);
+    }
+
+    uint64_t getSoftwareImageCRC() const
+    {
+        return (static_cast<uint64_t>(software_image_crc_high) << 32) | software_image_crc_low;
+    }
+
+    bool operator==(const NodeInfoSummary& rhs) const
+    {
+        return hash == rhs.hash &&
+               software_image_crc_low == rhs.software_image_crc_low &&
+               software_image_crc_high == rhs.software_image_crc_high &&
+               software_vcs_commit == rhs.software_vcs_commit &&
+               software_version_major == rhs.software_version_major &&
+               software_version_minor == rhs.software_version_minor &&
+               software_optional_field_flags == rhs.software_optional_field_flags &&
+               hardware_version_major == rhs.hardware_version_major &&
+               hardware_version_minor == rhs.hardware_version_minor &&
+               equal(hardware_unique_id, hardware_unique_id + UniqueIDSize, rhs.hardware_unique_id);
+    }
+    bool operator!=(const NodeInfoSummary& rhs) const { return !operator==(rhs); }
+};
+
 /**
  * Classes that need to receive GetNodeInfo responses should implement this interface.
  */
@@ -35,6 +143,17 @@ public:
      */
     virtual void handleNodeInfoUnavailable(NodeID node_id) = 0;
 
+    /**
+     * Called instead of @ref handleNodeInfoRetrieved() if the node info cache is enabled and the node has
+     * responded with the same info as the last time, e.g. after it has restarted without a firmware update.
+     * Default implementation forwards the call to @ref handleNodeInfoRetrieved(); listeners that only need
+     * to track changes can override it to skip the redundant processing.
+     */
+    virtual void handleNodeInfoUnchanged(NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
+    {
+        handleNodeInfoRetrieved(node_id, node_info);
+    }
+
     /**
      * This call is routed directly from @ref NodeStatusMonitor.
      * Default implementation does nothing.
@@ -77,15 +196,25 @@ public:
  * Given default service timeout 500 ms and the defined above request frequency 40 ms, the maximum number of
  * concurrent requests will be:
  *      max concurrent requests = ceil(500 [ms] timeout / 40 [ms] request interval)
- * Which yields 13 requests.
+ * Which yields 13 requests. This is the default limit, see @ref setMaxConcurrentRequests().
  *
- * Keep the above equations in mind when changing the default request interval.
+ * Keep the above equations in mind when changing the default request interval or the concurrency limit.
  *
- * Obviously, if all calls are completing in under (request interval), the number of concurrent requests will never
- * exceed one. This is actually the most likely scenario.
+ * In order to harvest the node info from a large network quickly, a new request is issued as soon as a pending one
+ * completes, and the number of concurrent requests grows by one every interval while the bus is idle, up to the
+ * limit, so that a fully populated network can be queried in well under a second. Should the bus become
+ * congested - i.e. if the local TX queue is not empty or the CAN error counters are growing - the allowed number
+ * of concurrent requests is halved, so that no new requests are issued until enough of the pending ones complete.
  *
  * Note that all nodes are queried in a round-robin fashion, regardless of their uptime, number of requests made, etc.
  *
+ * Optionally, a compact summary of the last response from every node can be kept in the node's memory pool (about
+ * one pool block per node), see @ref setNodeInfoCacheEnabled(). The cache allows the application to look up the
+ * software and hardware versions of the nodes at any time, and it allows the listeners to skip re-processing of
+ * the responses that did not change, see @ref INodeInfoListener::handleNodeInfoUnchanged(). The cache can be
+ * saved and restored across restarts of the local node (see @ref WarmStartSnapshot); the restored summaries are
+ * available immediately and are confirmed or replaced once the nodes respond.
+ *
  * Events from this class can be routed to many listeners, @ref INodeInfoListener.
  */
 class UAVCAN_EXPORT NodeInfoRetriever : NodeStatusMonitor
@@ -106,12 +235,14 @@ private:
         uint8_t num_attempts_made;
         bool request_needed;                    ///< Always false for unknown nodes
         bool updated_since_last_attempt;        ///< Always false for unknown nodes
+        bool cached_info_restored;              ///< The cached summary has not been confirmed by the node yet
 
         Entry()
             : uptime_sec(0)
             , num_attempts_made(0)
             , request_needed(false)
             , updated_since_last_attempt(false)
+            , cached_info_restored(false)
         {
 #if UAVCAN_DEBUG
             StaticAssert<sizeof(Entry) <= 8>::check();
@@ -123,16 +254,26 @@ private:
     {
         const NodeID node_id;
         const protocol::GetNodeInfo::Response& node_info;
+        const bool unchanged;
 
-        NodeInfoRetrievedHandlerCaller(NodeID arg_node_id, const protocol::GetNodeInfo::Response& arg_node_info)
+        NodeInfoRetrievedHandlerCaller(NodeID arg_node_id, const protocol::GetNodeInfo::Response& arg_node_info,
+                                       bool arg_unchanged)
             : node_id(arg_node_id)
             , node_info(arg_node_info)
+            , unchanged(arg_unchanged)
         { }
 
         bool operator()(INodeInfoListener* key)
         {
             UAVCAN_ASSERT(key != NULL);
-            key->handleNodeInfoRetrieved(node_id, node_info);
+            if (unchanged)
+            {
+                key->handleNodeInfoUnchanged(node_id, node_info);
+            }
+            else
+            {
+                key->handleNodeInfoRetrieved(node_id, node_info);
+            }
             return false;
         }
     };
@@ -159,6 +300,7 @@ private:
     enum { NumStaticCalls = 2 };
     enum { DefaultNumRequestAttempts = 16 };
     enum { DefaultTimerIntervalMSec = 40 };  ///< Read explanation in the class documentation
+    enum { DefaultMaxConcurrentRequests = 13 };
 
     /*
      * State
@@ -175,6 +317,14 @@ private:
 
     uint8_t num_attempts_;
 
+    uint8_t max_concurrent_requests_;
+    uint8_t request_window_;                    ///< Current limit of concurrent requests, adapted to the bus load
+
+    uint64_t last_num_can_errors_;
+
+    Map<NodeID, NodeInfoSummary> node_info_cache_;
+    bool node_info_cache_enabled_;
+
     /*
      * Methods
      */
@@ -229,29 +379,96 @@ private:
         return NodeID();        // No node could be found
     }
 
-    virtual void handleTimerEvent(const TimerEvent&)
+    /**
+     * The bus is considered congested if there are frames waiting in the local TX queue, or if the error counters
+     * of any interface have grown since the last check.
+     */
+    bool checkBusCongestion()
     {
-        bool at_least_one_request_needed = false;
-        const NodeID next = pickNextNodeToQuery(at_least_one_request_needed);
+        const CanIOManager& canio = get_node_info_client_.getNode().getDispatcher().getCanIOManager();
 
-        if (next.isUnicast())
+        uint64_t num_errors = 0;
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
         {
+            num_errors += canio.getIfacePerfCounters(i).errors;
+        }
+
+        const bool errors_growing = num_errors != last_num_can_errors_;
+        last_num_can_errors_ = num_errors;
+
+        return errors_growing || (canio.makePendingTxMask() != 0);
+    }
+
+    void updateRequestWindow()
+    {
+        if (checkBusCongestion())
+        {
+            request_window_ = static_cast<uint8_t>(max(request_window_ / 2, 1));
+            UAVCAN_TRACE("NodeInfoRetriever", "Bus congestion, request window %d", int(request_window_));
+        }
+        else if (request_window_ < max_concurrent_requests_)
+        {
+            request_window_++;
+        }
+    }
+
+    void issueRequests()
+    {
+        while (get_node_info_client_.getNumPendingCalls() < request_window_)
+        {
+            bool at_least_one_request_needed = false;
+            const NodeID next = pickNextNodeToQuery(at_least_one_request_needed);
+
+            if (!next.isUnicast())
+            {
+                if (!at_least_one_request_needed)
+                {
+                    TimerBase::stop();
+                    request_window_ = 1;
+                    UAVCAN_TRACE("NodeInfoRetriever", "Timer stopped");
+                }
+                break;
+            }
+
             UAVCAN_ASSERT(at_least_one_request_needed);
             getEntry(next).updated_since_last_attempt = false;
             const int res = get_node_info_client_.call(next, protocol::GetNodeInfo::Request());
             if (res < 0)
             {
                 get_node_info_client_.getNode().registerInternalFailure("NodeInfoRetriever GetNodeInfo call");
+                break;
             }
         }
-        else
+    }
+
+    /**
+     * Returns true if the node info is the same as the cached one.
+     * The cache is best effort: if the pool is exhausted, the node is not cached.
+     */
+    bool updateNodeInfoCache(NodeID node_id, const protocol::GetNodeInfo::Response& node_info)
+    {
+        const NodeInfoSummary summary(node_info);
+        getEntry(node_id).cached_info_restored = false;
+
+        NodeInfoSummary* const cached = node_info_cache_.access(node_id);
+        if (cached != NULL)
         {
-            if (!at_least_one_request_needed)
-            {
-                TimerBase::stop();
-                UAVCAN_TRACE("NodeInfoRetriever", "Timer stopped");
-            }
+            const bool unchanged = *cached == summary;
+            *cached = summary;
+            return unchanged;
+        }
+
+        if (NULL == node_info_cache_.insert(node_id, summary))
+        {
+            UAVCAN_TRACE("NodeInfoRetriever", "Node info cache: no memory for node ID %d", int(node_id.get()));
         }
+        return false;
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        updateRequestWindow();
+        issueRequests();
     }
 
     virtual void handleNodeStatusChange(const NodeStatusChangeEvent& event)
@@ -311,8 +528,12 @@ private:
              */
             entry.uptime_sec = result.getResponse().status.uptime_sec;
             entry.request_needed = false;
+
+            const bool unchanged = node_info_cache_enabled_ &&
+                                   updateNodeInfoCache(result.getCallID().server_node_id, result.getResponse());
+
             listeners_.forEach(NodeInfoRetrievedHandlerCaller(result.getCallID().server_node_id,
-                                                              result.getResponse()));
+                                                              result.getResponse(), unchanged));
         }
         else
         {
@@ -322,22 +543,34 @@ private:
                 if (entry.num_attempts_made >= num_attempts_)
                 {
                     entry.request_needed = false;
+                    entry.cached_info_restored = false;
+                    node_info_cache_.remove(result.getCallID().server_node_id);
                     listeners_.forEach(GenericHandlerCaller<NodeID>(&INodeInfoListener::handleNodeInfoUnavailable,
                                                                     result.getCallID().server_node_id));
                 }
             }
         }
+
+        if (TimerBase::isRunning())
+        {
+            issueRequests();        // Refilling the window right away rather than waiting for the next interval
+        }
     }
 
 public:
     NodeInfoRetriever(INode& node)
         : NodeStatusMonitor(node)
         , TimerBase(node)
-        , listeners_(node.getAllocator())
+        , listeners_(node.getAllocatorFor(MemoryConsumerOther))
         , get_node_info_client_(node)
         , request_interval_(MonotonicDuration::fromMSec(DefaultTimerIntervalMSec))
         , last_picked_node_(1)
         , num_attempts_(DefaultNumRequestAttempts)
+        , max_concurrent_requests_(DefaultMaxConcurrentRequests)
+        , request_window_(1)
+        , last_num_can_errors_(0)
+        , node_info_cache_(node.getAllocatorFor(MemoryConsumerOther))
+        , node_info_cache_enabled_(false)
     { }
 
     /**
@@ -366,12 +599,13 @@ public:
 
     /**
      * This method forces the class to re-request uavcan.protocol.GetNodeInfo from all nodes as if they
-     * have just appeared in the network.
+     * have just appeared in the network. The node info cache is cleared as well.
      */
     void invalidateAll()
     {
         NodeStatusMonitor::forgetAllNodes();
         get_node_info_client_.cancelAllCalls();
+        node_info_cache_.clear();
 
         for (unsigned i = 0; i < (sizeof(entries_) / sizeof(entries_[0])); i++)
         {
@@ -427,7 +661,19 @@ public:
     }
 
     /**
-     * Request interval also implicitly defines the maximum number of concurrent requests.
+     * Maximum number of GetNodeInfo requests that can be pending at the same time.
+     * The actual number of concurrent requests is adapted to the bus load, read the class documentation for details.
+     * One turns off the burst mode, so that at most one request is issued per request interval.
+     */
+    uint8_t getMaxConcurrentRequests() const { return max_concurrent_requests_; }
+    void setMaxConcurrentRequests(const uint8_t num)
+    {
+        max_concurrent_requests_ = max(num, static_cast<uint8_t>(1));
+        request_window_ = min(request_window_, max_concurrent_requests_);
+    }
+
+    /**
+     * Request interval also defines the pace at which the number of concurrent requests can grow.
      * Read the class documentation for details.
      */
     MonotonicDuration getRequestInterval() const { return request_interval_; }
@@ -447,6 +693,69 @@ public:
         }
     }
 
+    /**
+     * Enables or disables the node info cache; see the class documentation.
+     * The cache is disabled by default. Disabling the cache releases its memory.
+     */
+    bool isNodeInfoCacheEnabled() const { return node_info_cache_enabled_; }
+    void setNodeInfoCacheEnabled(const bool enabled)
+    {
+        node_info_cache_enabled_ = enabled;
+        if (!enabled)
+        {
+            node_info_cache_.clear();
+        }
+    }
+
+    /**
+     * Returns the summary of the last GetNodeInfo response from the specified node, or NULL if the node is not
+     * in the cache. The summary is kept after the node goes offline, until it fails to respond to GetNodeInfo.
+     * The returned pointer is invalidated by any subsequent spin of the node.
+     */
+    const NodeInfoSummary* getCachedNodeInfo(NodeID node_id) const
+    {
+        if (!node_id.isUnicast())
+        {
+            return NULL;
+        }
+        return const_cast<NodeInfoRetriever*>(this)->node_info_cache_.access(node_id);
+    }
+
+    unsigned getNumCachedNodeInfos() const { return node_info_cache_.getSize(); }
+
+    /**
+     * Adds a summary to the node info cache without querying the node, e.g. from a snapshot that was saved before
+     * the local node restarted. The restored summary is validated lazily: the node is queried as usual once it is
+     * seen online, and if the response matches, the listeners are notified via
+     * @ref INodeInfoListener::handleNodeInfoUnchanged() rather than handleNodeInfoRetrieved().
+     * The cache must be enabled. Returns negative error code.
+     */
+    int restoreCachedNodeInfo(NodeID node_id, const NodeInfoSummary& summary)
+    {
+        if (!node_info_cache_enabled_)
+        {
+            return -ErrLogic;
+        }
+        if (!node_id.isUnicast())
+        {
+            return -ErrInvalidParam;
+        }
+        if (NULL == node_info_cache_.insert(node_id, summary))
+        {
+            return -ErrMemory;
+        }
+        getEntry(node_id).cached_info_restored = true;
+        return 0;
+    }
+
+    /**
+     * Whether the cached summary was restored with @ref restoreCachedNodeInfo() and the node has not responded yet.
+     */
+    bool isCachedNodeInfoRestored(NodeID node_id) const
+    {
+        return node_id.isUnicast() && (getCachedNodeInfo(node_id) != NULL) && getEntry(node_id).cached_info_restored;
+    }
+
     /**
      * These methods are needed mostly for testing.
      */
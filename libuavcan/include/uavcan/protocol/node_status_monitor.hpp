@@ -67,8 +67,6 @@ public:
     };
 
 private:
-    enum { TimerPeriodMs100 = 2 };
-
     typedef MethodBinder<NodeStatusMonitor*,
                          void (NodeStatusMonitor::*)(const ReceivedDataStructure<protocol::NodeStatus>&)>
             NodeStatusCallback;
@@ -79,17 +77,31 @@ private:
 
     TimerEventForwarder<TimerCallback> timer_;
 
+    /**
+     * Online nodes are kept in an intrusive list ordered by the time of the last update, so that the timer only
+     * needs to visit the nodes that are about to time out, and can be armed exactly at the next expiry.
+     */
     struct Entry
     {
         NodeStatus status;
-        int8_t time_since_last_update_ms100;
+        bool known;
+        uint8_t prev;               ///< Node ID of the previous entry in the expiry queue, zero if none
+        uint8_t next;               ///< Node ID of the next entry in the expiry queue, zero if none
+        uint32_t last_update_ms;    ///< Lower 32 bits of the monotonic time, valid while the entry is queued
+
         Entry() :
-            time_since_last_update_ms100(-1)
+            known(false),
+            prev(0),
+            next(0),
+            last_update_ms(0)
         { }
     };
 
     mutable Entry entries_[NodeID::Max];  // [1, NodeID::Max]
 
+    uint8_t queue_head_;                ///< The node that will time out first, zero if none
+    uint8_t queue_tail_;
+
     Entry& getEntry(NodeID node_id) const
     {
         if (node_id.get() < 1 || node_id.get() > NodeID::Max)
@@ -99,16 +111,62 @@ private:
         return entries_[node_id.get() - 1];
     }
 
-    void changeNodeStatus(const NodeID node_id, const Entry new_entry_value)
+    void removeFromQueue(const NodeID node_id)
     {
         Entry& entry = getEntry(node_id);
-        if (entry.status != new_entry_value.status)
+        if (entry.prev != 0)
+        {
+            getEntry(entry.prev).next = entry.next;
+        }
+        else if (queue_head_ == node_id.get())
+        {
+            queue_head_ = entry.next;
+        }
+        if (entry.next != 0)
+        {
+            getEntry(entry.next).prev = entry.prev;
+        }
+        else if (queue_tail_ == node_id.get())
+        {
+            queue_tail_ = entry.prev;
+        }
+        entry.prev = 0;
+        entry.next = 0;
+    }
+
+    void appendToQueue(const NodeID node_id, const MonotonicTime ts)
+    {
+        Entry& entry = getEntry(node_id);
+        UAVCAN_ASSERT(entry.prev == 0 && entry.next == 0 && queue_head_ != node_id.get());
+        entry.last_update_ms = static_cast<uint32_t>(ts.toMSec());
+        entry.prev = queue_tail_;
+        if (queue_tail_ != 0)
+        {
+            getEntry(queue_tail_).next = node_id.get();
+        }
+        else
+        {
+            queue_head_ = node_id.get();
+        }
+        queue_tail_ = node_id.get();
+    }
+
+    MonotonicTime getExpiryDeadline(const NodeID node_id, const MonotonicTime now) const
+    {
+        const uint32_t age_ms = static_cast<uint32_t>(now.toMSec()) - getEntry(node_id).last_update_ms;
+        return now + MonotonicDuration::fromMSec(int64_t(protocol::NodeStatus::OFFLINE_TIMEOUT_MS) - age_ms);
+    }
+
+    void changeNodeStatus(const NodeID node_id, const NodeStatus new_status)
+    {
+        Entry& entry = getEntry(node_id);
+        if (entry.status != new_status)
         {
             NodeStatusChangeEvent event;
             event.node_id    = node_id;
             event.old_status = entry.status;
-            event.status     = new_entry_value.status;
-            event.was_known  = entry.time_since_last_update_ms100 >= 0;
+            event.status     = new_status;
+            event.was_known  = entry.known;
 
             UAVCAN_TRACE("NodeStatusMonitor", "Node %i [%s] status change: [%s] --> [%s]", int(node_id.get()),
                          (event.was_known ? "known" : "new"),
@@ -116,43 +174,54 @@ private:
 
             handleNodeStatusChange(event);
         }
-        entry = new_entry_value;
+        entry.status = new_status;
+        entry.known = true;
     }
 
     void handleNodeStatus(const ReceivedDataStructure<protocol::NodeStatus>& msg)
     {
-        Entry new_entry;
-        new_entry.time_since_last_update_ms100 = 0;
-        new_entry.status.health   = msg.health   & ((1 << protocol::NodeStatus::FieldTypes::health::BitLen) - 1);
-        new_entry.status.mode     = msg.mode     & ((1 << protocol::NodeStatus::FieldTypes::mode::BitLen) - 1);
-        new_entry.status.sub_mode = msg.sub_mode & ((1 << protocol::NodeStatus::FieldTypes::sub_mode::BitLen) - 1);
+        const NodeID node_id = msg.getSrcNodeID();
 
-        changeNodeStatus(msg.getSrcNodeID(), new_entry);
+        NodeStatus new_status;
+        new_status.health   = msg.health   & ((1 << protocol::NodeStatus::FieldTypes::health::BitLen) - 1);
+        new_status.mode     = msg.mode     & ((1 << protocol::NodeStatus::FieldTypes::mode::BitLen) - 1);
+        new_status.sub_mode = msg.sub_mode & ((1 << protocol::NodeStatus::FieldTypes::sub_mode::BitLen) - 1);
+
+        removeFromQueue(node_id);
+        changeNodeStatus(node_id, new_status);
+
+        // Nodes that report being offline will not time out
+        if (new_status.mode != protocol::NodeStatus::MODE_OFFLINE)
+        {
+            const MonotonicTime now = timer_.getScheduler().getMonotonicTime();
+            appendToQueue(node_id, now);
+            if (!timer_.isRunning())
+            {
+                timer_.startOneShotWithDeadline(getExpiryDeadline(queue_head_, now));
+            }
+        }
 
         handleNodeStatusMessage(msg);
     }
 
-    void handleTimerEvent(const TimerEvent&)
+    void handleTimerEvent(const TimerEvent& event)
     {
-        const int OfflineTimeoutMs100 = protocol::NodeStatus::OFFLINE_TIMEOUT_MS / 100;
-
-        for (uint8_t i = 1; i <= NodeID::Max; i++)
+        while (queue_head_ != 0)
         {
-            Entry& entry = getEntry(i);
-            if (entry.time_since_last_update_ms100 >= 0 &&
-                entry.status.mode != protocol::NodeStatus::MODE_OFFLINE)
-            {
-                entry.time_since_last_update_ms100 =
-                    int8_t(entry.time_since_last_update_ms100 + int8_t(TimerPeriodMs100));
+            const NodeID node_id(queue_head_);
 
-                if (entry.time_since_last_update_ms100 > OfflineTimeoutMs100)
-                {
-                    Entry new_entry_value = entry;
-                    new_entry_value.time_since_last_update_ms100 = OfflineTimeoutMs100;
-                    new_entry_value.status.mode = protocol::NodeStatus::MODE_OFFLINE;
-                    changeNodeStatus(i, new_entry_value);
-                }
+            const MonotonicTime deadline = getExpiryDeadline(node_id, event.real_time);
+            if (deadline > event.real_time)
+            {
+                timer_.startOneShotWithDeadline(deadline);
+                break;
             }
+
+            removeFromQueue(node_id);
+
+            NodeStatus new_status = getEntry(node_id).status;
+            new_status.mode = protocol::NodeStatus::MODE_OFFLINE;
+            changeNodeStatus(node_id, new_status);
         }
     }
 
@@ -177,10 +246,21 @@ protected:
         (void)msg;
     }
 
+    /**
+     * Called when a known node is made unknown by @ref forgetNode() or @ref forgetAllNodes().
+     * Overriding is not required.
+     */
+    virtual void handleNodeForgotten(NodeID node_id)
+    {
+        (void)node_id;
+    }
+
 public:
     explicit NodeStatusMonitor(INode& node)
         : sub_(node)
         , timer_(node)
+        , queue_head_(0)
+        , queue_tail_(0)
     { }
 
     virtual ~NodeStatusMonitor() { }
@@ -196,7 +276,6 @@ public:
         if (res >= 0)
         {
             timer_.setCallback(TimerCallback(this, &NodeStatusMonitor::handleTimerEvent));
-            timer_.startPeriodic(MonotonicDuration::fromMSec(TimerPeriodMs100 * 100));
         }
         return res;
     }
@@ -208,8 +287,13 @@ public:
     {
         if (node_id.isValid())
         {
-            Entry& entry = getEntry(node_id);
-            entry = Entry();
+            removeFromQueue(node_id);
+            const bool was_known = getEntry(node_id).known;
+            getEntry(node_id) = Entry();
+            if (was_known)
+            {
+                handleNodeForgotten(node_id);
+            }
         }
         else
         {
@@ -222,9 +306,16 @@ public:
      */
     void forgetAllNodes()
     {
+        queue_head_ = 0;
+        queue_tail_ = 0;
         for (unsigned i = 0; i < (sizeof(entries_) / sizeof(entries_[0])); i++)
         {
+            const bool was_known = entries_[i].known;
             entries_[i] = Entry();
+            if (was_known)
+            {
+                handleNodeForgotten(NodeID(uint8_t(i + 1)));
+            }
         }
     }
 
@@ -242,7 +333,7 @@ public:
         }
 
         const Entry& entry = getEntry(node_id);
-        if (entry.time_since_last_update_ms100 >= 0)
+        if (entry.known)
         {
             return entry.status;
         }
@@ -263,7 +354,7 @@ public:
             UAVCAN_ASSERT(0);
             return false;
         }
-        return getEntry(node_id).time_since_last_update_ms100 >= 0;
+        return getEntry(node_id).known;
     }
 
     /**
@@ -281,7 +372,7 @@ public:
             const NodeID nid(i);
             UAVCAN_ASSERT(nid.isUnicast());
             const Entry& entry = getEntry(nid);
-            if (entry.time_since_last_update_ms100 >= 0)
+            if (entry.known)
             {
                 if (entry.status.health > worst_health || !nid_with_worst_health.isValid())
                 {
@@ -307,7 +398,7 @@ public:
             const NodeID nid(i);
             UAVCAN_ASSERT(nid.isUnicast());
             const Entry& entry = getEntry(nid);
-            if (entry.time_since_last_update_ms100 >= 0)
+            if (entry.known)
             {
                 op(nid, entry.status);
             }
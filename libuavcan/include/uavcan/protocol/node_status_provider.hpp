@@ -29,23 +29,46 @@ class UAVCAN_EXPORT NodeStatusProvider : private TimerBase
 {
     typedef MethodBinder<NodeStatusProvider*,
                          void (NodeStatusProvider::*)(const protocol::GetNodeInfo::Request&,
-                                                      protocol::GetNodeInfo::Response&)> GetNodeInfoCallback;
+                                                      ServiceResponseDataStructure<protocol::GetNodeInfo::Response>&)>
+        GetNodeInfoCallback;
+    typedef ServiceServer<protocol::GetNodeInfo, GetNodeInfoCallback> GetNodeInfoServer;
 
-    const MonotonicTime creation_timestamp_;
+    MonotonicTime uptime_origin_;     ///< Creation time plus the uptime published so far
 
     Publisher<protocol::NodeStatus> node_status_pub_;
-    ServiceServer<protocol::GetNodeInfo, GetNodeInfoCallback> gni_srv_;
+    GetNodeInfoServer gni_srv_;
 
     protocol::GetNodeInfo::Response node_info_;
+#if !UAVCAN_TINY
+    /*
+     * Every monitoring tool requests the node info after a bus restart, so the response is encoded once and
+     * reused until the node info changes. This costs as much memory as the largest encoded response.
+     */
+    GetNodeInfoServer::PreEncodedResponse node_info_encoded_;
+#endif
+
+    MonotonicDuration prev_load_total_time_;
+    MonotonicDuration prev_load_busy_time_;
+    bool load_reporting_enabled_;
 
     INode& getNode() { return node_status_pub_.getNode(); }
 
     bool isNodeInfoInitialized() const;
 
+    void updateLoadReport();
+
+    void invalidateEncodedNodeInfo()
+    {
+#if !UAVCAN_TINY
+        node_info_encoded_.markDirty();
+#endif
+    }
+
     int publish();
 
     virtual void handleTimerEvent(const TimerEvent&);
-    void handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&, protocol::GetNodeInfo::Response& rsp);
+    void handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&,
+                                  ServiceResponseDataStructure<protocol::GetNodeInfo::Response>& rsp);
 
 public:
     typedef typename StorageType<typename protocol::NodeStatus::FieldTypes::vendor_specific_status_code>::Type
@@ -53,12 +76,11 @@ public:
 
     explicit NodeStatusProvider(INode& node)
         : TimerBase(node)
-        , creation_timestamp_(node.getMonotonicTime())
+        , uptime_origin_(node.getMonotonicTime())
         , node_status_pub_(node)
         , gni_srv_(node)
+        , load_reporting_enabled_(false)
     {
-        UAVCAN_ASSERT(!creation_timestamp_.isZero());
-
         node_info_.status.mode = protocol::NodeStatus::MODE_INITIALIZATION;
 
         node_info_.status.health = protocol::NodeStatus::HEALTH_OK;
@@ -114,6 +136,14 @@ public:
         return node_info_.status.vendor_specific_status_code;
     }
 
+    /**
+     * If enabled, the vendor-specific status code will be replaced before every publication with the utilization
+     * of the scheduler over the last publication period, in percent [0, 100]; see @ref SchedulerLoadStats.
+     * Enabling this also enables the load statistics of the scheduler. Disabled by default.
+     */
+    void setLoadReportingEnabled(bool enabled);
+    bool isLoadReportingEnabled() const { return load_reporting_enabled_; }
+
     /**
      * Local node name control.
      * Can be set only once before the provider is started.
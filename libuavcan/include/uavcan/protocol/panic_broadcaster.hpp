@@ -40,6 +40,7 @@ public:
         , pub_(node)
     {
         pub_.setTxTimeout(MonotonicDuration::fromMSec(protocol::Panic::BROADCASTING_PERIOD_MS - 10));
+        pub_.getTransferSender().setCanIOFlags(CanIOFlagEmergency);     // Must not depend on the pool
     }
 
     /**
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PARAM_ENUMERATOR_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PARAM_ENUMERATOR_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/pipelined_service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/protocol/param/GetSet.hpp>
+
+namespace uavcan
+{
+/**
+ * Application must implement this interface to receive the parameters fetched by @ref ParamEnumerator.
+ */
+class UAVCAN_EXPORT IParamEnumerationHandler
+{
+public:
+    typedef protocol::param::GetSet::Response Param;
+
+    virtual ~IParamEnumerationHandler() { }
+
+    /**
+     * Called for every parameter of the remote node, in the order of indices.
+     * It is allowed to cancel or restart the enumeration from this method.
+     */
+    virtual void handleParam(NodeID node_id, uint16_t index, const Param& param) = 0;
+
+    /**
+     * Called once the enumeration is finished.
+     * It is allowed to start the next enumeration from this method, e.g. for the next node.
+     * @param node_id       The node whose parameters were being fetched.
+     * @param result        Zero if all parameters were fetched; negative error code otherwise, e.g.
+     *                      -ErrFailure if the node did not respond.
+     * @param num_params    Number of parameters that have been reported via @ref handleParam().
+     */
+    virtual void handleParamEnumerationFinished(NodeID node_id, int result, unsigned num_params) = 0;
+};
+
+/**
+ * Fetches all parameters of a remote node with GetSet requests by index, keeping up to WindowSize requests in
+ * flight (see @ref PipelinedServiceClient), so that a full dump takes about (number of params / WindowSize)
+ * round trips instead of one round trip per parameter. The results are reported in the order of indices.
+ * The enumeration ends once the node returns an empty name, as mandated by the GetSet service definition;
+ * the requests that have been sent beyond the last index are cancelled.
+ *
+ * One instance can fetch parameters from one node at a time; a single instance can be reused for many nodes by
+ * restarting it from @ref IParamEnumerationHandler::handleParamEnumerationFinished().
+ *
+ * @tparam WindowSize   Maximum number of requests in flight; see @ref PipelinedServiceClient.
+ */
+template <unsigned WindowSize = 8>
+class UAVCAN_EXPORT ParamEnumerator : Noncopyable
+{
+public:
+    typedef PipelinedServiceCallResult<protocol::param::GetSet> ResultType;
+
+private:
+    typedef MethodBinder<ParamEnumerator*, void (ParamEnumerator::*)(const ResultType&)> ResultCallback;
+
+    enum { MaxIndex = (1U << protocol::param::GetSet::Request::FieldTypes::index::BitLen) - 1U };
+
+    PipelinedServiceClient<protocol::param::GetSet, WindowSize, ResultCallback> client_;
+    IParamEnumerationHandler* handler_;
+    uint16_t next_index_;
+    uint16_t num_params_;
+    bool running_;
+    bool exhausted_;                    ///< All indices have been requested
+
+    int fillWindow()
+    {
+        while (!exhausted_ && !client_.isWindowFull())
+        {
+            protocol::param::GetSet::Request request;
+            request.index = next_index_;
+            const int res = client_.submit(request);
+            if (res < 0)
+            {
+                return res;
+            }
+            if (next_index_ >= MaxIndex)
+            {
+                exhausted_ = true;
+            }
+            else
+            {
+                next_index_++;
+            }
+        }
+        return 0;
+    }
+
+    void finish(int result)
+    {
+        UAVCAN_TRACE("ParamEnumerator", "Finished: node=%i result=%i num_params=%u",
+                     int(client_.getServerNodeID().get()), result, unsigned(num_params_));
+        running_ = false;
+        client_.cancelAll();
+        UAVCAN_ASSERT(handler_ != NULL);
+        handler_->handleParamEnumerationFinished(client_.getServerNodeID(), result, num_params_);
+    }
+
+    void handleResult(const ResultType& result)
+    {
+        if (!running_)
+        {
+            return;
+        }
+
+        if (!result.isSuccessful())
+        {
+            UAVCAN_TRACE("ParamEnumerator", "Index %i failed", int(result.getRequest().index));
+            finish(-ErrFailure);
+            return;
+        }
+
+        if (result.getResponse().name.empty())
+        {
+            finish(0);                  // End of the list
+            return;
+        }
+
+        num_params_++;
+        handler_->handleParam(client_.getServerNodeID(), result.getRequest().index, result.getResponse());
+        if (!running_)
+        {
+            return;                     // Cancelled from the handler
+        }
+
+        const int res = fillWindow();
+        if (res < 0)
+        {
+            finish(res);
+        }
+        else if (client_.isIdle())
+        {
+            finish(0);                  // All indices are used up
+        }
+        else
+        {
+            ;   // Waiting for more results
+        }
+    }
+
+public:
+    explicit ParamEnumerator(INode& node)
+        : client_(node)
+        , handler_(NULL)
+        , next_index_(0)
+        , num_params_(0)
+        , running_(false)
+        , exhausted_(false)
+    { }
+
+    /**
+     * Starts fetching the parameters of the specified node; the ongoing enumeration, if any, is cancelled
+     * without calling the handler.
+     * Returns negative error code.
+     */
+    int start(NodeID node_id, IParamEnumerationHandler* handler)
+    {
+        if (handler == NULL)
+        {
+            return -ErrInvalidParam;
+        }
+        running_ = false;
+        client_.setCallback(ResultCallback(this, &ParamEnumerator::handleResult));
+
+        int res = client_.init(node_id);
+        if (res < 0)
+        {
+            return res;
+        }
+
+        handler_ = handler;
+        next_index_ = 0;
+        num_params_ = 0;
+        exhausted_ = false;
+        running_ = true;
+
+        res = fillWindow();
+        if (res < 0)
+        {
+            running_ = false;
+            client_.cancelAll();
+        }
+        return res;
+    }
+
+    /**
+     * Stops the enumeration without calling the handler.
+     */
+    void cancel()
+    {
+        running_ = false;
+        client_.cancelAll();
+    }
+
+    bool isRunning() const { return running_; }
+
+    NodeID getNodeID() const { return client_.getServerNodeID(); }
+
+    /**
+     * Number of parameters reported so far.
+     */
+    unsigned getNumParams() const { return num_params_; }
+
+    /**
+     * Every request will be sent up to this number of times before the enumeration is considered failed.
+     */
+    uint8_t getMaxAttempts() const { return client_.getMaxAttempts(); }
+    void setMaxAttempts(uint8_t num) { client_.setMaxAttempts(num); }
+
+    MonotonicDuration getRequestTimeout() const { return client_.getRequestTimeout(); }
+    void setRequestTimeout(MonotonicDuration timeout) { client_.setRequestTimeout(timeout); }
+
+    TransferPriority getPriority() const { return client_.getPriority(); }
+    void setPriority(const TransferPriority prio) { client_.setPriority(prio); }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_PARAM_ENUMERATOR_HPP_INCLUDED
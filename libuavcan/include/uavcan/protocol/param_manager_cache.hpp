@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PARAM_MANAGER_CACHE_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PARAM_MANAGER_CACHE_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/protocol/param_server.hpp>
+
+namespace uavcan
+{
+/**
+ * Caching layer over an application's @ref IParamManager, to be passed to @ref ParamServer instead of it.
+ *
+ * Enumerating all parameters of a node with GetSet by index costs the backend a name lookup by index, a value read
+ * and a default/max/min read per parameter; for backends that keep parameters in a linked list or in a file this
+ * makes a full dump quadratic. This class builds a table of parameter names together with their default/max/min
+ * on first use, so that index-to-name and name-to-index lookups and the default/max/min reads are served from RAM.
+ * Values are never cached - they are always read from and assigned to the backend directly.
+ *
+ * The table is built by enumerating the backend until it returns an empty name, or until MaxParams entries are
+ * collected; parameters beyond the capacity are still served by the backend. The application must call
+ * @ref invalidate() if the set of parameters or their defaults/limits change at run time.
+ *
+ * Every entry takes about 300 bytes of RAM, so MaxParams should be chosen carefully on embedded targets.
+ *
+ * @tparam MaxParams    Maximum number of parameters kept in the table.
+ */
+template <unsigned MaxParams>
+class UAVCAN_EXPORT ParamManagerCache : public IParamManager, Noncopyable
+{
+    struct Entry
+    {
+        Name name;
+        Value default_value;
+        NumericValue max_value;
+        NumericValue min_value;
+        uint32_t name_hash;
+
+        Entry() : name_hash(0) { }
+    };
+
+    enum { MaxIndex = (1U << protocol::param::GetSet::Request::FieldTypes::index::BitLen) - 1U };
+
+    IParamManager& backend_;
+    mutable Entry entries_[MaxParams];
+    mutable uint16_t num_entries_;
+    mutable bool valid_;
+    mutable bool complete_;             ///< True if all parameters of the backend fit the table
+
+    static uint32_t computeNameHash(const Name& name)
+    {
+        uint32_t hash = 2166136261U;
+        for (typename Name::const_iterator it = name.begin(); it != name.end(); ++it)
+        {
+            hash = (hash ^ *it) * 16777619U;     // FNV-1a
+        }
+        return hash;
+    }
+
+    void build() const
+    {
+        if (valid_)
+        {
+            return;
+        }
+        num_entries_ = 0;
+        complete_ = false;
+
+        while (num_entries_ < MaxParams)
+        {
+            Entry& entry = entries_[num_entries_];
+            entry = Entry();
+            backend_.getParamNameByIndex(Index(num_entries_), entry.name);
+            if (entry.name.empty())
+            {
+                complete_ = true;
+                break;
+            }
+            entry.name_hash = computeNameHash(entry.name);
+            backend_.readParamDefaultMaxMin(entry.name, entry.default_value, entry.max_value, entry.min_value);
+            num_entries_++;
+        }
+
+        valid_ = true;
+        UAVCAN_TRACE("ParamManagerCache", "%u params cached, complete=%i", unsigned(num_entries_), int(complete_));
+    }
+
+    const Entry* find(const Name& name, Index& out_index) const
+    {
+        build();
+        const uint32_t hash = computeNameHash(name);
+        for (unsigned i = 0; i < num_entries_; i++)
+        {
+            if ((entries_[i].name_hash == hash) && (entries_[i].name == name))
+            {
+                out_index = Index(i);
+                return &entries_[i];
+            }
+        }
+        return NULL;
+    }
+
+public:
+    explicit ParamManagerCache(IParamManager& backend)
+        : backend_(backend)
+        , num_entries_(0)
+        , valid_(false)
+        , complete_(false)
+    {
+        StaticAssert<(MaxParams > 0) && (MaxParams <= (MaxIndex + 1U))>::check();
+    }
+
+    /**
+     * Drops the table; it will be rebuilt on the next access.
+     */
+    void invalidate() { valid_ = false; }
+
+    /**
+     * Number of parameters in the table. Builds the table if necessary.
+     */
+    unsigned getNumCachedParams() const
+    {
+        build();
+        return num_entries_;
+    }
+
+    /**
+     * Whether the table contains all parameters of the backend, i.e. the backend has not more than MaxParams.
+     * Builds the table if necessary.
+     */
+    bool isComplete() const
+    {
+        build();
+        return complete_;
+    }
+
+    /**
+     * Name-to-index lookup. Returns false if the parameter is not in the table.
+     */
+    bool findParamIndex(const Name& name, Index& out_index) const
+    {
+        return find(name, out_index) != NULL;
+    }
+
+    IParamManager& getBackend() const { return backend_; }
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        build();
+        if (index < num_entries_)
+        {
+            out_name = entries_[index].name;
+        }
+        else if (!complete_)
+        {
+            backend_.getParamNameByIndex(index, out_name);
+        }
+        else
+        {
+            ;   // Nothing to do - no such parameter
+        }
+    }
+
+    virtual void assignParamValue(const Name& name, const Value& value)
+    {
+        backend_.assignParamValue(name, value);
+    }
+
+    virtual void readParamValue(const Name& name, Value& out_value) const
+    {
+        backend_.readParamValue(name, out_value);
+    }
+
+    virtual void readParamDefaultMaxMin(const Name& name, Value& out_default,
+                                        NumericValue& out_max, NumericValue& out_min) const
+    {
+        Index index = 0;
+        const Entry* const entry = find(name, index);
+        if (entry != NULL)
+        {
+            out_default = entry->default_value;
+            out_max = entry->max_value;
+            out_min = entry->min_value;
+        }
+        else if (!complete_)
+        {
+            backend_.readParamDefaultMaxMin(name, out_default, out_max, out_min);
+        }
+        else
+        {
+            ;   // Unknown param
+        }
+    }
+
+    virtual int saveAllParams()
+    {
+        return backend_.saveAllParams();
+    }
+
+    virtual int saveModifiedParams(const Name* names, unsigned num_names)
+    {
+        return backend_.saveModifiedParams(names, num_names);
+    }
+
+    virtual int eraseAllParams()
+    {
+        return backend_.eraseAllParams();
+    }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_PARAM_MANAGER_CACHE_HPP_INCLUDED
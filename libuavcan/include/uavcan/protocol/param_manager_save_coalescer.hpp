@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PARAM_MANAGER_SAVE_COALESCER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PARAM_MANAGER_SAVE_COALESCER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/protocol/param_server.hpp>
+
+namespace uavcan
+{
+/**
+ * Layer over an application's @ref IParamManager that defers and coalesces the save requests; it is to be passed
+ * to @ref ParamServer instead of the application's manager (it can be stacked with @ref ParamManagerCache).
+ *
+ * Ground tools often request OPCODE_SAVE after every single GetSet. With flash backed storage every save may stall
+ * the node for tens of milliseconds and wears the flash. This class acknowledges the save request immediately and
+ * performs the actual save once the save delay expires, so that all save requests received within the delay are
+ * served by one write. Parameters that have not been assigned since the last successful save are not written:
+ * the backend receives their names via @ref IParamManager::saveModifiedParams(). If nothing has been assigned,
+ * the save request is not forwarded to the backend at all.
+ *
+ * Since the response is sent before the data is written, a failure of the deferred save can't be reported to
+ * the requesting node; it is counted instead (see @ref getNumFailedSaves()), and the modified parameters will be
+ * saved again on the next request. The application should call @ref flush() before restarting the node.
+ *
+ * Every tracked name takes about 100 bytes of RAM. If more than MaxModifiedParams parameters have been modified,
+ * the backend is asked to save all parameters.
+ *
+ * @tparam MaxModifiedParams    Maximum number of modified parameter names tracked between saves.
+ */
+template <unsigned MaxModifiedParams = 8>
+class UAVCAN_EXPORT ParamManagerSaveCoalescer : public IParamManager, private TimerBase
+{
+public:
+    enum { DefaultSaveDelayMs = 1000 };
+
+private:
+    IParamManager& backend_;
+    MonotonicDuration save_delay_;
+    Name modified_names_[MaxModifiedParams];
+    uint16_t num_modified_names_;
+    bool all_modified_;                 ///< Set on overflow of the name table or after the storage was erased
+    uint32_t num_saves_;
+    uint32_t num_failed_saves_;
+
+    bool hasModifiedParams() const { return all_modified_ || (num_modified_names_ > 0); }
+
+    void markModified(const Name& name)
+    {
+        if (all_modified_)
+        {
+            return;
+        }
+        for (unsigned i = 0; i < num_modified_names_; i++)
+        {
+            if (modified_names_[i] == name)
+            {
+                return;
+            }
+        }
+        if (num_modified_names_ < MaxModifiedParams)
+        {
+            modified_names_[num_modified_names_++] = name;
+        }
+        else
+        {
+            UAVCAN_TRACE("ParamManagerSaveCoalescer", "Too many modified params, full save will be performed");
+            all_modified_ = true;
+        }
+    }
+
+    void clearModified()
+    {
+        num_modified_names_ = 0;
+        all_modified_ = false;
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        (void)flush();
+    }
+
+public:
+    ParamManagerSaveCoalescer(INode& node, IParamManager& backend)
+        : TimerBase(node)
+        , backend_(backend)
+        , save_delay_(MonotonicDuration::fromMSec(DefaultSaveDelayMs))
+        , num_modified_names_(0)
+        , all_modified_(false)
+        , num_saves_(0)
+        , num_failed_saves_(0)
+    {
+        StaticAssert<(MaxModifiedParams > 0)>::check();
+    }
+
+    /**
+     * Save requests received within this interval after the first one are served by one write.
+     * Zero delay means that the save will be performed on the next spin.
+     */
+    void setSaveDelay(MonotonicDuration delay) { save_delay_ = delay; }
+    MonotonicDuration getSaveDelay() const { return save_delay_; }
+
+    /**
+     * Whether a save has been requested but not performed yet.
+     */
+    bool hasPendingSave() const { return isRunning(); }
+
+    /**
+     * Performs the pending save immediately, if any. This should be done before restarting the node.
+     * @return Negative if the backend failed to save the params.
+     */
+    int flush()
+    {
+        stop();
+        if (!hasModifiedParams())
+        {
+            return 0;
+        }
+
+        const int res = all_modified_ ? backend_.saveAllParams() :
+                        backend_.saveModifiedParams(modified_names_, num_modified_names_);
+        num_saves_++;
+        if (res < 0)
+        {
+            UAVCAN_TRACE("ParamManagerSaveCoalescer", "Save failed: %i", res);
+            num_failed_saves_++;
+        }
+        else
+        {
+            clearModified();
+        }
+        return res;
+    }
+
+    /**
+     * Makes the next save write all params, e.g. if they were modified by the application directly.
+     */
+    void markAllParamsModified() { all_modified_ = true; }
+
+    /**
+     * Number of the save requests that reached the backend, and how many of them failed.
+     */
+    uint32_t getNumSaves() const { return num_saves_; }
+    uint32_t getNumFailedSaves() const { return num_failed_saves_; }
+
+    IParamManager& getBackend() const { return backend_; }
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        backend_.getParamNameByIndex(index, out_name);
+    }
+
+    virtual void assignParamValue(const Name& name, const Value& value)
+    {
+        backend_.assignParamValue(name, value);
+        markModified(name);
+    }
+
+    virtual void readParamValue(const Name& name, Value& out_value) const
+    {
+        backend_.readParamValue(name, out_value);
+    }
+
+    virtual void readParamDefaultMaxMin(const Name& name, Value& out_default,
+                                        NumericValue& out_max, NumericValue& out_min) const
+    {
+        backend_.readParamDefaultMaxMin(name, out_default, out_max, out_min);
+    }
+
+    /**
+     * Schedules the save and returns immediately.
+     */
+    virtual int saveAllParams()
+    {
+        if (hasModifiedParams() && !isRunning())
+        {
+            startOneShotWithDelay(save_delay_);
+        }
+        return 0;
+    }
+
+    virtual int saveModifiedParams(const Name*, unsigned)
+    {
+        return saveAllParams();
+    }
+
+    /**
+     * Cancels the pending save and erases the storage immediately.
+     * All params will be written on the next save, since the storage is empty.
+     */
+    virtual int eraseAllParams()
+    {
+        stop();
+        clearModified();
+        all_modified_ = true;
+        return backend_.eraseAllParams();
+    }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_PARAM_MANAGER_SAVE_COALESCER_HPP_INCLUDED
@@ -64,6 +64,19 @@ public:
      */
     virtual int saveAllParams() = 0;
 
+    /**
+     * Save the listed params to non-volatile storage; the other params have not been modified since the last save.
+     * This is used by @ref ParamManagerSaveCoalescer; backends that can't update individual entries of their
+     * storage don't need to override it.
+     * @return Negative if failed.
+     */
+    virtual int saveModifiedParams(const Name* names, unsigned num_names)
+    {
+        (void)names;
+        (void)num_names;
+        return saveAllParams();
+    }
+
     /**
      * Clear the non-volatile storage.
      * @return Negative if failed.
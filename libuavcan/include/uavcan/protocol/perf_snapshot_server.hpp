@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_PERF_SNAPSHOT_SERVER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_PERF_SNAPSHOT_SERVER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/debug.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/node/service_server.hpp>
+#include <uavcan/transport/data_type_stats.hpp>
+#include <uavcan/util/method_binder.hpp>
+
+#if UAVCAN_TINY
+# error "This functionality is not available in tiny mode"
+#endif
+
+namespace uavcan
+{
+/**
+ * Serves a snapshot of the performance counters of the local node using an application-defined (vendor-specific)
+ * service type, so that the nodes can be profiled remotely without debug builds of the firmware.
+ * The service type must have the following fields (the capacity of the arrays is up to the application; the values
+ * that don't fit are not reported):
+ *
+ *      uint8 data_type_offset
+ *      ---
+ *      uint16 pool_blocks                  # Size of the memory pool
+ *      uint16[<=5] pool_used               # Per memory consumer, see INode::getMemoryUsage()
+ *      uint16[<=5] pool_peak
+ *      uint32[<=5] pool_failures
+ *      uint16[<=3] tx_queue_depth          # Per interface
+ *      uint32[<=3] iface_errors
+ *      uint8 utilization_percent           # Scheduler load, see Scheduler::setLoadStatsEnabled()
+ *      uint32 peak_callback_usec
+ *      uint8 num_data_types                # Size of the data type statistics table
+ *      DataTypeStats[<=4] data_types       # Entries of the table, starting from data_type_offset
+ *
+ * where DataTypeStats is a nested type with the following fields:
+ *
+ *      uint16 data_type_id
+ *      uint8 data_type_kind
+ *      uint32 transfers_rx
+ *      uint32 transfers_tx
+ *      uint32 rx_errors
+ *      uint16 active_receivers             # Reassembly states currently held by the listeners of the data type
+ *      uint32 max_callback_duration_usec
+ *
+ * The memory pool usage is reported only if the node tracks it, and the scheduler load only if the load statistics
+ * are enabled; otherwise the respective fields are empty or zero. The table of per data type statistics can be
+ * fetched in several requests. Nothing is reset by the request.
+ */
+template <typename ServiceType_>
+class UAVCAN_EXPORT PerfSnapshotServer : Noncopyable
+{
+public:
+    typedef ServiceType_ ServiceType;
+    typedef typename ServiceType::Request Request;
+    typedef typename ServiceType::Response Response;
+
+private:
+    typedef MethodBinder<PerfSnapshotServer*,
+                         void (PerfSnapshotServer::*)(const Request&, Response&)> Callback;
+
+    typedef typename Response::FieldTypes::data_types::ValueType DataTypeEntry;
+
+    ServiceServer<ServiceType, Callback> srv_;
+    INode& node_;
+
+    static uint16_t saturate16(uint64_t x) { return (x > 0xFFFFU) ? uint16_t(0xFFFFU) : uint16_t(x); }
+    static uint32_t saturate32(uint64_t x) { return (x > 0xFFFFFFFFU) ? 0xFFFFFFFFU : uint32_t(x); }
+
+    template <typename Array, typename Value>
+    static void append(Array& array, Value value)
+    {
+        if (array.size() < array.capacity())
+        {
+            array.push_back(value);
+        }
+    }
+
+    void fillMemoryUsage(Response& out)
+    {
+        out.pool_blocks = node_.getAllocator().getNumBlocks();
+        for (int i = 0; i < NumMemoryConsumers; i++)
+        {
+            const InstrumentedPoolAllocator* const usage = node_.getMemoryUsage(MemoryConsumer(i));
+            if (usage == NULL)
+            {
+                break;
+            }
+            append(out.pool_used, usage->getNumUsedBlocks());
+            append(out.pool_peak, usage->getPeakNumUsedBlocks());
+            append(out.pool_failures, usage->getNumFailures());
+        }
+    }
+
+    void fillIfaceStats(Response& out) const
+    {
+        const CanIOManager& canio = node_.getDispatcher().getCanIOManager();
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+        {
+            append(out.tx_queue_depth, saturate16(canio.getNumPendingTxFrames(i)));
+            append(out.iface_errors, saturate32(canio.getIfacePerfCounters(i).errors));
+        }
+    }
+
+    void fillSchedulerLoad(Response& out) const
+    {
+        const Scheduler& scheduler = node_.getScheduler();
+        if (scheduler.isLoadStatsEnabled())
+        {
+            out.utilization_percent = scheduler.getLoadStats().getUtilizationPercent();
+            out.peak_callback_usec = DataTypeStats::saturateUSec(scheduler.getLoadStats().getPeakCallbackTime());
+        }
+    }
+
+    void fillDataTypeStats(unsigned offset, Response& out) const
+    {
+        const DataTypeStatsTable& table = node_.getDispatcher().getDataTypeStatsTable();
+        out.num_data_types = uint8_t(min(table.getSize(), 0xFFU));
+        for (unsigned i = offset; (i < table.getSize()) && (out.data_types.size() < out.data_types.capacity()); i++)
+        {
+            const DataTypeStats& stats = *table.getByIndex(i);
+            DataTypeEntry entry;
+            entry.data_type_id = stats.data_type_id.get();
+            entry.data_type_kind = uint8_t(stats.data_type_kind);
+            entry.transfers_rx = stats.transfers_rx;
+            entry.transfers_tx = stats.transfers_tx;
+            entry.rx_errors = stats.rx_errors;
+            entry.active_receivers = saturate16(uint32_t(stats.receivers_created - stats.receivers_removed));
+            entry.max_callback_duration_usec = stats.max_callback_duration_usec;
+            out.data_types.push_back(entry);
+        }
+    }
+
+    void handleRequest(const Request& request, Response& response)
+    {
+        fillMemoryUsage(response);
+        fillIfaceStats(response);
+        fillSchedulerLoad(response);
+        fillDataTypeStats(request.data_type_offset, response);
+        UAVCAN_TRACE("PerfSnapshotServer", "Snapshot served, %u data types from %u",
+                     unsigned(response.data_types.size()), unsigned(request.data_type_offset));
+    }
+
+public:
+    explicit PerfSnapshotServer(INode& node)
+        : srv_(node)
+        , node_(node)
+    { }
+
+    /**
+     * Starts the server. Returns negative error code.
+     */
+    int start()
+    {
+        return srv_.start(Callback(this, &PerfSnapshotServer::handleRequest));
+    }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_PERF_SNAPSHOT_SERVER_HPP_INCLUDED
@@ -7,23 +7,125 @@
 
 #include <uavcan/build_config.hpp>
 #include <uavcan/node/service_server.hpp>
+#include <uavcan/node/timer.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include <uavcan/protocol/GetTransportStats.hpp>
 
 namespace uavcan
 {
+/**
+ * Exponentially weighted moving averages of the CAN interface counters, per second.
+ * Refer to @ref TransportStatsProvider::startRateEstimation().
+ */
+struct UAVCAN_EXPORT CanIfaceRates
+{
+    float frames_tx;
+    float frames_rx;
+    float bytes_tx;         ///< CAN frame payload bytes
+    float bytes_rx;
+    float errors;
+
+    CanIfaceRates()
+        : frames_tx(0)
+        , frames_rx(0)
+        , bytes_tx(0)
+        , bytes_rx(0)
+        , errors(0)
+    { }
+};
+
 /**
  * This class provides statistics about the transport layer performance on the local node.
  * The user's application does not deal with this class directly because it's instantiated by the node class.
+ *
+ * Optionally, the provider can sample the CAN interface counters periodically and maintain their rates on the
+ * local node, so that the monitoring tools don't need to poll the raw counters and differentiate them;
+ * see @ref startRateEstimation(). The rates can be broadcasted with @ref TransportStatsPublisher.
  */
-class UAVCAN_EXPORT TransportStatsProvider : Noncopyable
+class UAVCAN_EXPORT TransportStatsProvider : private TimerBase
 {
     typedef MethodBinder<const TransportStatsProvider*,
                          void (TransportStatsProvider::*)(const protocol::GetTransportStats::Request&,
                                                           protocol::GetTransportStats::Response&) const>
             GetTransportStatsCallback;
 
+    /**
+     * Lower bits of the counters are enough to compute the increments between samples.
+     */
+    struct CounterSnapshot
+    {
+        uint32_t frames_tx;
+        uint32_t frames_rx;
+        uint32_t bytes_tx;
+        uint32_t bytes_rx;
+        uint32_t errors;
+
+        CounterSnapshot()
+            : frames_tx(0)
+            , frames_rx(0)
+            , bytes_tx(0)
+            , bytes_rx(0)
+            , errors(0)
+        { }
+
+        explicit CounterSnapshot(const CanIfacePerfCounters& cnt)
+            : frames_tx(uint32_t(cnt.frames_tx))
+            , frames_rx(uint32_t(cnt.frames_rx))
+            , bytes_tx(uint32_t(cnt.bytes_tx))
+            , bytes_rx(uint32_t(cnt.bytes_rx))
+            , errors(uint32_t(cnt.errors))
+        { }
+    };
+
     ServiceServer<protocol::GetTransportStats, GetTransportStatsCallback> srv_;
+    CounterSnapshot prev_counters_[MaxCanIfaces];
+    CanIfaceRates rates_[MaxCanIfaces];
+    MonotonicTime prev_sample_ts_;
+    MonotonicDuration rate_time_constant_;
+    bool rates_initialized_;
+
+    static void updateRate(float& rate, uint32_t increment, float dt_sec, float weight, bool initialized)
+    {
+        const float new_rate = float(increment) / dt_sec;
+        rate = initialized ? (rate + weight * (new_rate - rate)) : new_rate;
+    }
+
+    void takeSnapshot(MonotonicTime ts)
+    {
+        const CanIOManager& canio = srv_.getNode().getDispatcher().getCanIOManager();
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+        {
+            prev_counters_[i] = CounterSnapshot(canio.getIfacePerfCounters(i));
+        }
+        prev_sample_ts_ = ts;
+    }
+
+    virtual void handleTimerEvent(const TimerEvent& event)
+    {
+        const MonotonicDuration dt = event.real_time - prev_sample_ts_;
+        if (!dt.isPositive())
+        {
+            return;
+        }
+        const float dt_sec = float(dt.toUSec()) * 1e-6F;
+        const float weight = float(dt.toUSec()) / float((dt + rate_time_constant_).toUSec());
+
+        const CanIOManager& canio = srv_.getNode().getDispatcher().getCanIOManager();
+        for (uint8_t i = 0; i < canio.getNumIfaces(); i++)
+        {
+            const CounterSnapshot cnt(canio.getIfacePerfCounters(i));
+            const CounterSnapshot& prev = prev_counters_[i];
+            CanIfaceRates& rates = rates_[i];
+            updateRate(rates.frames_tx, cnt.frames_tx - prev.frames_tx, dt_sec, weight, rates_initialized_);
+            updateRate(rates.frames_rx, cnt.frames_rx - prev.frames_rx, dt_sec, weight, rates_initialized_);
+            updateRate(rates.bytes_tx, cnt.bytes_tx - prev.bytes_tx, dt_sec, weight, rates_initialized_);
+            updateRate(rates.bytes_rx, cnt.bytes_rx - prev.bytes_rx, dt_sec, weight, rates_initialized_);
+            updateRate(rates.errors, cnt.errors - prev.errors, dt_sec, weight, rates_initialized_);
+            prev_counters_[i] = cnt;
+        }
+        prev_sample_ts_ = event.real_time;
+        rates_initialized_ = true;
+    }
 
     void handleGetTransportStats(const protocol::GetTransportStats::Request&,
                                  protocol::GetTransportStats::Response& resp) const
@@ -46,8 +148,13 @@ class UAVCAN_EXPORT TransportStatsProvider : Noncopyable
     }
 
 public:
+    enum { DefaultRateSamplePeriodMs = 1000 };
+    enum { DefaultRateTimeConstantMs = 5000 };
+
     explicit TransportStatsProvider(INode& node)
-        : srv_(node)
+        : TimerBase(node)
+        , srv_(node)
+        , rates_initialized_(false)
     { }
 
     /**
@@ -58,6 +165,46 @@ public:
     {
         return srv_.start(GetTransportStatsCallback(this, &TransportStatsProvider::handleGetTransportStats));
     }
+
+    /**
+     * Starts sampling the CAN interface counters with the specified period. The rates are smoothed with an
+     * exponentially weighted moving average, where the weight of every new sample is
+     * sample_period / (sample_period + time_constant); zero time constant disables the smoothing.
+     * The rates become available after the first sample period; the rate estimation is disabled by default.
+     */
+    void startRateEstimation(MonotonicDuration sample_period =
+                                 MonotonicDuration::fromMSec(DefaultRateSamplePeriodMs),
+                             MonotonicDuration time_constant =
+                                 MonotonicDuration::fromMSec(DefaultRateTimeConstantMs))
+    {
+        rate_time_constant_ = max(time_constant, MonotonicDuration());
+        rates_initialized_ = false;
+        for (unsigned i = 0; i < MaxCanIfaces; i++)
+        {
+            rates_[i] = CanIfaceRates();
+        }
+        takeSnapshot(srv_.getNode().getMonotonicTime());
+        TimerBase::startPeriodic(max(sample_period, MonotonicDuration::fromMSec(1)));
+    }
+
+    void stopRateEstimation() { TimerBase::stop(); }
+
+    bool isRateEstimationRunning() const { return TimerBase::isRunning(); }
+
+    /**
+     * Whether at least one sample has been taken since the rate estimation was started.
+     */
+    bool areRatesAvailable() const { return rates_initialized_; }
+
+    /**
+     * Rates of the specified interface. Zero if unavailable or if the interface index is invalid.
+     */
+    CanIfaceRates getIfaceRates(uint8_t iface_index) const
+    {
+        return (iface_index < MaxCanIfaces) ? rates_[iface_index] : CanIfaceRates();
+    }
+
+    uint8_t getNumIfaces() const { return srv_.getNode().getDispatcher().getCanIOManager().getNumIfaces(); }
 };
 
 }
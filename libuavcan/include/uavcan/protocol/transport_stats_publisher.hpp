@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_TRANSPORT_STATS_PUBLISHER_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_TRANSPORT_STATS_PUBLISHER_HPP_INCLUDED
+
+#include <uavcan/debug.hpp>
+#include <uavcan/std.hpp>
+#include <uavcan/node/publisher.hpp>
+#include <uavcan/node/timer.hpp>
+#include <uavcan/protocol/transport_stats_provider.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+
+namespace uavcan
+{
+/**
+ * Publishes the CAN interface rates estimated by @ref TransportStatsProvider as uavcan.protocol.debug.KeyValue
+ * messages, so that the monitoring tools can passively collect the load of many nodes instead of polling
+ * uavcan.protocol.GetTransportStats and differentiating the counters.
+ *
+ * Five values are published for every interface. The keys look like "can0.frx", where the first component
+ * identifies the interface, and the second one is the rate per second:
+ *  - frx, ftx - received and transmitted frames
+ *  - brx, btx - received and transmitted CAN payload bytes
+ *  - err      - errors
+ *
+ * Nothing is published until the rate estimation is started (see @ref TransportStatsProvider::startRateEstimation())
+ * and the first sample is taken. The statistics can be published either once by calling @ref publish(),
+ * or periodically.
+ */
+class UAVCAN_EXPORT TransportStatsPublisher : private TimerBase
+{
+    Publisher<protocol::debug::KeyValue> pub_;
+    const TransportStatsProvider& provider_;
+
+    int publishValue(uint8_t iface_index, const char* suffix, float value)
+    {
+        char key[8];
+        (void)snprintf(key, sizeof(key), "can%u.", unsigned(iface_index));
+        protocol::debug::KeyValue msg;
+        msg.key = key;
+        msg.key += suffix;
+        msg.value = value;
+        return pub_.broadcast(msg);
+    }
+
+    virtual void handleTimerEvent(const TimerEvent&)
+    {
+        if (publish() < 0)
+        {
+            pub_.getNode().registerInternalFailure("TransportStatsPublisher pub failed");
+        }
+    }
+
+public:
+    TransportStatsPublisher(INode& node, const TransportStatsProvider& provider)
+        : TimerBase(node)
+        , pub_(node)
+        , provider_(provider)
+    { }
+
+    /**
+     * Publishes the statistics once.
+     * Returns negative error code if any message could not be published.
+     */
+    int publish()
+    {
+        if (!provider_.areRatesAvailable())
+        {
+            return 0;
+        }
+        int result = 0;
+        for (uint8_t i = 0; i < provider_.getNumIfaces(); i++)
+        {
+            const CanIfaceRates rates = provider_.getIfaceRates(i);
+            const int res[] =
+            {
+                publishValue(i, "frx", rates.frames_rx),
+                publishValue(i, "ftx", rates.frames_tx),
+                publishValue(i, "brx", rates.bytes_rx),
+                publishValue(i, "btx", rates.bytes_tx),
+                publishValue(i, "err", rates.errors)
+            };
+            for (unsigned k = 0; k < (sizeof(res) / sizeof(res[0])); k++)
+            {
+                if (res[k] < 0)
+                {
+                    result = res[k];
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Starts periodic publishing with the specified interval.
+     */
+    void startPeriodic(MonotonicDuration period)
+    {
+        UAVCAN_TRACE("TransportStatsPublisher", "Starting with period %u ms", unsigned(period.toMSec()));
+        TimerBase::startPeriodic(period);
+    }
+
+    /**
+     * Stops periodic publishing.
+     */
+    void stop() { TimerBase::stop(); }
+
+    bool isRunning() const { return TimerBase::isRunning(); }
+
+    /**
+     * Priority and TX timeout of the outgoing messages can be configured via the publisher.
+     */
+    Publisher<protocol::debug::KeyValue>& getPublisher() { return pub_; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_TRANSPORT_STATS_PUBLISHER_HPP_INCLUDED
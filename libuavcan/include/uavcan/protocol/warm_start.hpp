@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_PROTOCOL_WARM_START_HPP_INCLUDED
+#define UAVCAN_PROTOCOL_WARM_START_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/error.hpp>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/transport/can_acceptance_filter_configurator.hpp>
+#include <uavcan/protocol/node_info_retriever.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+
+namespace uavcan
+{
+/**
+ * Snapshot of the state that a node normally rebuilds from the bus after every restart:
+ *  - the node ID, which may have been allocated dynamically;
+ *  - the CAN acceptance filter configuration;
+ *  - the node info cache of @ref NodeInfoRetriever, i.e. the last seen nodes with their NodeInfo hashes.
+ *
+ * The application saves the snapshot into a byte buffer whenever convenient (e.g. once the node became
+ * operational) and keeps it in memory that survives the restart (non-volatile storage, or RAM that is not
+ * initialized on brownout reset). On the next start the state is restored from the snapshot immediately,
+ * and then validated lazily:
+ *  - the restored node ID should be monitored with @ref NodeIDConflictMonitor; if another node
+ *    is using the same node ID, the snapshot must be discarded and the node ID allocated anew;
+ *  - the restored filter configuration is replaced by the automatic reconfiguration if the set of listeners
+ *    turns out to be different; see @ref CanAcceptanceFilterConfigurator::restoreConfiguration();
+ *  - the restored node info is confirmed by the retriever once the nodes are seen online;
+ *    see @ref NodeInfoRetriever::restoreCachedNodeInfo().
+ *
+ * The data type registry is not a part of the snapshot, because the registration is static and takes
+ * no bus communication.
+ *
+ * The snapshot is protected with a CRC, so that a damaged or uninitialized buffer is rejected.
+ * The contents are platform-independent (little endian), but they are only meant to be read by the same
+ * firmware that wrote them; a snapshot written by a different version of the format is rejected as well.
+ */
+class UAVCAN_EXPORT WarmStartSnapshot : Noncopyable
+{
+public:
+    enum { FormatVersion = 1 };
+
+    enum { HeaderSize = 6 };
+    enum { FilterRecordSize = 8 };
+    enum { NodeRecordSize = 22 + NodeInfoSummary::UniqueIDSize };
+    enum { CrcSize = 2 };
+
+    /**
+     * Buffer size that is sufficient for any snapshot.
+     * Smaller buffers can be used as well; the node records that do not fit are dropped when saving.
+     */
+    enum
+    {
+        MaxSize = HeaderSize + MaxCanAcceptanceFilters * FilterRecordSize + NodeID::Max * NodeRecordSize + CrcSize
+    };
+
+private:
+    const uint8_t* const data_;
+    const unsigned size_;
+    bool valid_;
+
+    uint8_t getNumFiltersUnchecked() const { return data_[4]; }
+    uint8_t getNumNodesUnchecked() const { return data_[5]; }
+    const uint8_t* getFilterRecord(uint8_t index) const;
+    const uint8_t* getNodeRecord(uint8_t index) const;
+
+    bool validate() const;
+
+public:
+    /**
+     * Saves the current state into the buffer.
+     * @param node          The node whose node ID will be saved. The node ID must be set.
+     * @param filters       Filter configurator whose applied configuration will be saved; may be null.
+     * @param retriever     Node info retriever whose node info cache will be saved; may be null.
+     * @param buffer        Output buffer.
+     * @param capacity      Size of the buffer; the node records that do not fit are dropped.
+     * @return              Size of the snapshot in bytes, negative error code.
+     */
+    static int save(const INode& node, const CanAcceptanceFilterConfigurator* filters,
+                    const NodeInfoRetriever* retriever, uint8_t* buffer, unsigned capacity);
+
+    /**
+     * The data is not copied; the buffer must remain valid while the object is used.
+     * The snapshot is validated here; the restore methods fail with -ErrInvalidParam if it is not valid.
+     */
+    WarmStartSnapshot(const uint8_t* data, unsigned size)
+        : data_(data)
+        , size_(size)
+        , valid_(false)
+    {
+        valid_ = validate();
+        UAVCAN_TRACE("WarmStartSnapshot", "Snapshot of size %u is %s", size_, valid_ ? "valid" : "not valid");
+    }
+
+    bool isValid() const { return valid_; }
+
+    NodeID getNodeID() const { return valid_ ? NodeID(data_[3]) : NodeID(); }
+    unsigned getNumFilterConfigs() const { return valid_ ? getNumFiltersUnchecked() : 0U; }
+    unsigned getNumNodeInfos() const { return valid_ ? getNumNodesUnchecked() : 0U; }
+
+    /**
+     * Assigns the saved node ID to the node. This is only possible if the node ID has not been set yet.
+     * The node ID should be validated with @ref NodeIDConflictMonitor afterwards.
+     * @return 0 = success, negative for error.
+     */
+    int restoreNodeID(INode& node) const;
+
+    /**
+     * Loads the saved filter configuration into the CAN driver.
+     * If the snapshot contains no filter configuration, nothing is done.
+     * @return 0 = success, negative for error.
+     */
+    int restoreFilters(CanAcceptanceFilterConfigurator& filters) const;
+
+    /**
+     * Populates the node info cache of the retriever, which must be enabled.
+     * @return Number of restored entries, negative for error.
+     */
+    int restoreNodeInfoCache(NodeInfoRetriever& retriever) const;
+};
+
+/**
+ * Detects whether another node on the bus is using the same node ID as the local node, which is the case when
+ * a node ID restored from a @ref WarmStartSnapshot has been allocated to another node meanwhile.
+ * The detection is based on the NodeStatus messages, which all nodes publish at least once a second.
+ *
+ * The application should keep this object running for a couple of seconds after start (see
+ * NodeStatus::OFFLINE_TIMEOUT_MS); if a conflict has been detected, the snapshot should be discarded and
+ * the node restarted, so that a new node ID is allocated.
+ */
+class UAVCAN_EXPORT NodeIDConflictMonitor : Noncopyable
+{
+    typedef MethodBinder<NodeIDConflictMonitor*,
+                         void (NodeIDConflictMonitor::*)(const ReceivedDataStructure<protocol::NodeStatus>&)>
+            NodeStatusCallback;
+
+    Subscriber<protocol::NodeStatus, NodeStatusCallback, 1, 0> sub_;
+    bool conflict_detected_;
+
+    void handleNodeStatus(const ReceivedDataStructure<protocol::NodeStatus>& msg)
+    {
+        if (!conflict_detected_ && (msg.getSrcNodeID() == sub_.getNode().getNodeID()))
+        {
+            UAVCAN_TRACE("NodeIDConflictMonitor", "Conflict with node ID %d", int(msg.getSrcNodeID().get()));
+            conflict_detected_ = true;
+        }
+    }
+
+public:
+    explicit NodeIDConflictMonitor(INode& node)
+        : sub_(node)
+        , conflict_detected_(false)
+    { }
+
+    /**
+     * @return 0 = success, negative for error.
+     */
+    int start()
+    {
+        return sub_.start(NodeStatusCallback(this, &NodeIDConflictMonitor::handleNodeStatus));
+    }
+
+    /**
+     * The subscription can be stopped once the node ID has been validated, to save memory.
+     */
+    void stop() { sub_.stop(); }
+
+    bool isConflictDetected() const { return conflict_detected_; }
+};
+
+}
+
+#endif // UAVCAN_PROTOCOL_WARM_START_HPP_INCLUDED
@@ -32,6 +32,9 @@ protected:
 public:
     static D getInfinite() { return fromUSec(NumericTraits<int64_t>::max()); }
 
+    /// The shortest non-zero duration
+    static D getResolution() { return fromUSec(1); }
+
     static D fromUSec(int64_t us)
     {
         D d;
@@ -176,12 +179,178 @@ public:
 #endif
 };
 
+/**
+ * Compact counterparts of DurationBase and TimeBase, see UAVCAN_COMPACT_MONOTONIC_TIME.
+ * The values are 32-bit numbers of ticks, where one tick is ResolutionUSec microseconds long.
+ * The duration saturates at +/-(2^31 - 1) ticks. The time wraps around; two time points are compared by the sign of
+ * their difference, which is only meaningful if they are less than 2^31 ticks apart.
+ */
+template <typename D, unsigned ResolutionUSec>
+class CompactDurationBase
+{
+    int32_t ticks_;
+
+    static D fromTicksSaturated(int64_t ticks)
+    {
+        const int64_t Max = NumericTraits<int32_t>::max();
+        return fromTicks(static_cast<int32_t>((ticks > Max) ? Max : ((ticks < -Max) ? -Max : ticks)));
+    }
+
+protected:
+    ~CompactDurationBase() { }
+
+    CompactDurationBase()
+        : ticks_(0)
+    {
+        StaticAssert<(sizeof(D) == 4)>::check();
+        StaticAssert<(ResolutionUSec > 0)>::check();
+    }
+
+public:
+    static D getInfinite() { return fromTicks(NumericTraits<int32_t>::max()); }
+
+    /// The shortest non-zero duration
+    static D getResolution() { return fromTicks(1); }
+
+    static D fromTicks(int32_t ticks)
+    {
+        D d;
+        d.ticks_ = ticks;
+        return d;
+    }
+    static D fromUSec(int64_t us) { return fromTicksSaturated(us / int64_t(ResolutionUSec)); }
+    static D fromMSec(int64_t ms) { return fromTicksSaturated((ms * 1000) / int64_t(ResolutionUSec)); }
+
+    int32_t toTicks() const { return ticks_; }
+    int64_t toUSec() const { return int64_t(ticks_) * int64_t(ResolutionUSec); }
+    int64_t toMSec() const { return toUSec() / 1000; }
+
+    D getAbs() const { return fromTicks((ticks_ < 0) ? (-ticks_) : ticks_); }
+
+    bool isPositive() const { return ticks_ > 0; }
+    bool isNegative() const { return ticks_ < 0; }
+    bool isZero() const { return ticks_ == 0; }
+
+    bool operator==(const D& r) const { return ticks_ == r.ticks_; }
+    bool operator!=(const D& r) const { return !operator==(r); }
+
+    bool operator<(const D& r) const { return ticks_ < r.ticks_; }
+    bool operator>(const D& r) const { return ticks_ > r.ticks_; }
+    bool operator<=(const D& r) const { return ticks_ <= r.ticks_; }
+    bool operator>=(const D& r) const { return ticks_ >= r.ticks_; }
+
+    D operator+(const D& r) const { return fromTicksSaturated(int64_t(ticks_) + r.ticks_); }
+    D operator-(const D& r) const { return fromTicksSaturated(int64_t(ticks_) - r.ticks_); }
+
+    D operator-() const { return fromTicks(-ticks_); }
+
+    D& operator+=(const D& r)
+    {
+        *this = *this + r;
+        return *static_cast<D*>(this);
+    }
+    D& operator-=(const D& r)
+    {
+        *this = *this - r;
+        return *static_cast<D*>(this);
+    }
+
+    template <typename Scale>
+    D operator*(Scale scale)   const { return fromTicksSaturated(static_cast<int64_t>(int64_t(ticks_) * scale)); }
+
+    template <typename Scale>
+    D& operator*=(Scale scale)
+    {
+        *this = *this * scale;
+        return *static_cast<D*>(this);
+    }
+
+    static const unsigned StringBufSize = 32;
+    void toString(char buf[StringBufSize]) const; ///< Prints time in seconds with microsecond resolution
+#if UAVCAN_TOSTRING
+    std::string toString() const;                 ///< Prints time in seconds with microsecond resolution
+#endif
+};
+
+
+template <typename T, typename D, unsigned ResolutionUSec>
+class CompactTimeBase
+{
+    uint32_t ticks_;
+
+    int32_t diff(const T& r) const { return static_cast<int32_t>(ticks_ - r.ticks_); }
+
+protected:
+    ~CompactTimeBase() { }
+
+    CompactTimeBase()
+        : ticks_(0)
+    {
+        StaticAssert<(sizeof(T) == 4)>::check();
+        StaticAssert<(sizeof(D) == 4)>::check();
+    }
+
+public:
+    static T fromTicks(uint32_t ticks)
+    {
+        T d;
+        d.ticks_ = ticks;
+        return d;
+    }
+    static T fromUSec(uint64_t us) { return fromTicks(static_cast<uint32_t>(us / ResolutionUSec)); }
+    static T fromMSec(uint64_t ms) { return fromTicks(static_cast<uint32_t>((ms * 1000U) / ResolutionUSec)); }
+
+    /// Note that the values returned by toUSec() and toMSec() wrap around together with the tick counter
+    uint32_t toTicks() const { return ticks_; }
+    uint64_t toUSec() const { return uint64_t(ticks_) * ResolutionUSec; }
+    uint64_t toMSec() const { return toUSec() / 1000U; }
+
+    bool isZero() const { return ticks_ == 0; }
+
+    bool operator==(const T& r) const { return ticks_ == r.ticks_; }
+    bool operator!=(const T& r) const { return !operator==(r); }
+
+    bool operator<(const T& r) const { return diff(r) < 0; }
+    bool operator>(const T& r) const { return diff(r) > 0; }
+    bool operator<=(const T& r) const { return diff(r) <= 0; }
+    bool operator>=(const T& r) const { return diff(r) >= 0; }
+
+    T operator+(const D& r) const { return fromTicks(ticks_ + static_cast<uint32_t>(r.toTicks())); }
+    T operator-(const D& r) const { return fromTicks(ticks_ - static_cast<uint32_t>(r.toTicks())); }
+    D operator-(const T& r) const { return D::fromTicks(diff(r)); }
+
+    T& operator+=(const D& r)
+    {
+        *this = *this + r;
+        return *static_cast<T*>(this);
+    }
+    T& operator-=(const D& r)
+    {
+        *this = *this - r;
+        return *static_cast<T*>(this);
+    }
+
+    static const unsigned StringBufSize = 32;
+    void toString(char buf[StringBufSize]) const; ///< Prints time in seconds with microsecond resolution
+#if UAVCAN_TOSTRING
+    std::string toString() const;                 ///< Prints time in seconds with microsecond resolution
+#endif
+};
+
 /*
  * Monotonic
  */
+#if UAVCAN_COMPACT_MONOTONIC_TIME
+class UAVCAN_EXPORT MonotonicDuration
+    : public CompactDurationBase<MonotonicDuration, UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC> { };
+
+class UAVCAN_EXPORT MonotonicTime
+    : public CompactTimeBase<MonotonicTime, MonotonicDuration, UAVCAN_COMPACT_MONOTONIC_TIME_RESOLUTION_USEC> { };
+#else
 class UAVCAN_EXPORT MonotonicDuration : public DurationBase<MonotonicDuration> { };
 
 class UAVCAN_EXPORT MonotonicTime : public TimeBase<MonotonicTime, MonotonicDuration> { };
+#endif
 
 /*
  * UTC
@@ -220,6 +389,12 @@ const unsigned DurationBase<D>::StringBufSize;
 template <typename T, typename D>
 const unsigned TimeBase<T, D>::StringBufSize;
 
+template <typename D, unsigned R>
+const unsigned CompactDurationBase<D, R>::StringBufSize;
+
+template <typename T, typename D, unsigned R>
+const unsigned CompactTimeBase<T, D, R>::StringBufSize;
+
 template <typename D>
 void DurationBase<D>::toString(char buf[StringBufSize]) const
 {
@@ -243,6 +418,29 @@ void TimeBase<T, D>::toString(char buf[StringBufSize]) const
 }
 
 
+template <typename D, unsigned R>
+void CompactDurationBase<D, R>::toString(char buf[StringBufSize]) const
+{
+    char* ptr = buf;
+    if (isNegative())
+    {
+        *ptr++ = '-';
+    }
+    (void)snprintf(ptr, StringBufSize - 1, "%lu.%06lu",
+                   static_cast<unsigned long>(getAbs().toUSec() / 1000000L),
+                   static_cast<unsigned long>(getAbs().toUSec() % 1000000L));
+}
+
+
+template <typename T, typename D, unsigned R>
+void CompactTimeBase<T, D, R>::toString(char buf[StringBufSize]) const
+{
+    (void)snprintf(buf, StringBufSize, "%lu.%06lu",
+                   static_cast<unsigned long>(toUSec() / 1000000UL),
+                   static_cast<unsigned long>(toUSec() % 1000000UL));
+}
+
+
 #if UAVCAN_TOSTRING
 
 template <typename D>
@@ -261,6 +459,22 @@ std::string TimeBase<T, D>::toString() const
     return std::string(buf);
 }
 
+template <typename D, unsigned R>
+std::string CompactDurationBase<D, R>::toString() const
+{
+    char buf[StringBufSize];
+    toString(buf);
+    return std::string(buf);
+}
+
+template <typename T, typename D, unsigned R>
+std::string CompactTimeBase<T, D, R>::toString() const
+{
+    char buf[StringBufSize];
+    toString(buf);
+    return std::string(buf);
+}
+
 #endif
 
 
@@ -284,6 +498,26 @@ Stream& operator<<(Stream& s, const TimeBase<T, D>& t)
     return s;
 }
 
+template <typename Stream, typename D, unsigned R>
+UAVCAN_EXPORT
+Stream& operator<<(Stream& s, const CompactDurationBase<D, R>& d)
+{
+    char buf[CompactDurationBase<D, R>::StringBufSize];
+    d.toString(buf);
+    s << buf;
+    return s;
+}
+
+template <typename Stream, typename T, typename D, unsigned R>
+UAVCAN_EXPORT
+Stream& operator<<(Stream& s, const CompactTimeBase<T, D, R>& t)
+{
+    char buf[CompactTimeBase<T, D, R>::StringBufSize];
+    t.toString(buf);
+    s << buf;
+    return s;
+}
+
 }
 
 #endif // UAVCAN_TIME_HPP_INCLUDED
@@ -20,6 +20,15 @@ public:
 
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const = 0;
     virtual int write(unsigned offset, const uint8_t* data, unsigned len) = 0;
+
+    /**
+     * Provides direct read-only access to the contiguous chunk of stored data that starts at the specified offset,
+     * so that the data can be decoded in place rather than copied out with read().
+     * Returns the number of bytes accessible via the pointer. Zero means that either the offset is out of range
+     * or the buffer does not support direct access; read() should be used in this case.
+     * The pointer is valid until the buffer is modified.
+     */
+    virtual unsigned getContiguousSpan(unsigned, const uint8_t*&) const { return 0; }
 };
 
 }
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_BUS_LOAD_ESTIMATOR_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_BUS_LOAD_ESTIMATOR_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/driver/can.hpp>
+
+namespace uavcan
+{
+/**
+ * Estimates the utilization of one CAN bus from the frames that were seen on it, both received and transmitted.
+ *
+ * Every frame is accounted for with its exact length on the wire: the stuff bits are computed from the actual
+ * bit stream, including the CRC, and the interframe space is included. Error frames, arbitration losses and
+ * retransmissions are not visible to the library, so the estimate is a lower bound of the real bus load.
+ *
+ * The frames are accumulated in a sliding window that is split into NumSlots slots; the load is computed over the
+ * complete slots plus the elapsed part of the current slot, so the window does not jump when a slot is dropped.
+ * The estimator is disabled until it's configured with a non-zero bit rate.
+ */
+class UAVCAN_EXPORT BusLoadEstimator
+{
+public:
+    enum { NumSlots = 8 };
+    enum { DefaultWindowMs = 1000 };
+
+private:
+    class StuffedBitCounter;
+
+    uint32_t slot_bits_[NumSlots];
+    MonotonicTime slot_start_ts_;               ///< Start of the current slot
+    MonotonicTime start_ts_;                    ///< When the estimator was configured
+    MonotonicDuration slot_duration_;
+    uint32_t bitrate_;
+    uint8_t current_slot_;
+
+    uint64_t getNumElapsedSlots(MonotonicTime ts) const;
+    void advance(MonotonicTime ts);
+
+public:
+    BusLoadEstimator()
+        : bitrate_(0)
+        , current_slot_(0)
+    {
+        reset();
+    }
+
+    /**
+     * Sets the bit rate of the bus in bits per second and the length of the sliding window, and drops the
+     * accumulated history. Zero bit rate disables the estimator.
+     */
+    void configure(uint32_t bitrate, MonotonicDuration window, MonotonicTime now);
+
+    /**
+     * Drops the accumulated history.
+     */
+    void reset(MonotonicTime now = MonotonicTime());
+
+    bool isEnabled() const { return bitrate_ > 0; }
+
+    uint32_t getBitRate() const { return bitrate_; }
+
+    MonotonicDuration getWindow() const { return slot_duration_ * int(NumSlots); }
+
+    /**
+     * Accounts for one frame that has been seen on the bus. Does nothing if the estimator is disabled.
+     */
+    void addFrame(const CanFrame& frame, MonotonicTime ts);
+
+    /**
+     * Bus load within [0, 1] over the last window. Zero if the estimator is disabled.
+     */
+    float getLoad(MonotonicTime now) const;
+
+    /**
+     * Number of bits the frame takes on the bus, from the start of frame bit to the end of the interframe space,
+     * including the stuff bits. Returns zero for error frames.
+     */
+    static unsigned computeFrameBitLength(const CanFrame& frame);
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_BUS_LOAD_ESTIMATOR_HPP_INCLUDED
@@ -11,6 +11,7 @@
 #include <uavcan/error.hpp>
 #include <uavcan/transport/dispatcher.hpp>
 #include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/timer.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/multiset.hpp>
 
@@ -27,62 +28,124 @@ namespace uavcan
  * automatically merges configs in the most efficient way until their number is reduced to the number of
  * available HW filters. Subsequently obtained configurations are then loaded into the CAN driver.
  *
+ * Alternatively, the object can be kept alive with the automatic reconfiguration enabled, so that the filters
+ * follow the subscribers and servers that are created and destroyed later; refer to
+ * @ref enableAutomaticReconfiguration().
+ *
  * The maximum number of CAN acceptance filters is predefined in uavcan/build_config.hpp through a constant
  * @ref MaxCanAcceptanceFilters. The algorithm doesn't allow to have higher number of HW filters configurations than
  * defined by MaxCanAcceptanceFilters. You can change this value according to the number specified in your CAN driver
  * datasheet.
  */
 class CanAcceptanceFilterConfigurator
+#if !UAVCAN_TINY
+    : private IListenerRegistryObserver
+    , private TimerBase
+#endif
 {
     /**
-     * Below constants based on UAVCAN transport layer specification. Masks and ID's depends on message Priority,
-     * TypeID, TransferID (RequestNotResponse - for service types, BroadcastNotUnicast - for message types).
-     * For more details refer to uavcan.org/CAN_bus_transport_layer_specification.
-     * For clarity let's represent "i" as Data Type ID
-     * DefaultFilterMsgMask = 00111111111110000000000000000
-     * DefaultFilterMsgID   = 00iiiiiiiiiii0000000000000000, no need to explicitly define, since MsgID initialized as 0.
-     * DefaultFilterServiceRequestMask = 11111111111100000000000000000
-     * DefaultFilterServiceRequestID   = 101iiiiiiiii00000000000000000
-     * ServiceRespFrameMask = 11100000000000000000000000000
-     * ServiceRespFrameID   = 10000000000000000000000000000, all Service Response Frames are accepted by HW filters.
+     * Below constants are based on the CAN ID layout defined by the UAVCAN transport layer specification,
+     * refer to Frame::compile(). Bits:
+     *   Messages:          [28:24] priority, [23:8]  data type ID, [7] 0, [6:0] source node ID
+     *   Service transfers: [28:24] priority, [23:16] data type ID, [15] request not response,
+     *                      [14:8] destination node ID, [7] 1, [6:0] source node ID
+     * Anonymous messages carry only the two lowest bits of the data type ID, the rest is the discriminator.
+     * All service responses addressed to the local node are accepted by one filter.
      */
-    static const unsigned DefaultFilterMsgMask = 0x7FF0000;
-    static const unsigned DefaultFilterServiceRequestID = 0x14000000;
-    static const unsigned DefaultFilterServiceRequestMask = 0x1FFE0000;
-    static const unsigned ServiceRespFrameID = 0x10000000;
-    static const unsigned ServiceRespFrameMask = 0x1C000000;
+    static const uint32_t ServiceNotMessageBit = 1U << 7;
+    static const uint32_t RequestNotResponseBit = 1U << 15;
+    static const uint32_t MessageDataTypeIDMask = 0xFFFFU << 8;
+    static const uint32_t AnonymousMessageDataTypeIDMask = 3U << 8;
+    static const uint32_t ServiceDataTypeIDMask = 0xFFU << 16;
+    static const uint32_t DestinationNodeIDMask = 0x7FU << 8;
+
+    /**
+     * The filters never constrain the priority and the source node ID, so these bits are not tracked.
+     */
+    static const uint32_t TrafficStatsKeyMask = CanFrame::FlagEFF | 0x00FFFF80U;
 
     typedef uavcan::Multiset<CanFilterConfig, 1> MultisetConfigContainer;
 
+#if !UAVCAN_TINY
+    /**
+     * Most frequent CAN IDs among the frames that were accepted by the hardware but not needed by the node,
+     * tracked with the space-saving algorithm: a new ID replaces the least frequent one and inherits its count,
+     * so the counts of frequent IDs are never underestimated.
+     */
+    struct TrafficStatsEntry
+    {
+        uint32_t key;
+        uint32_t count;
+
+        TrafficStatsEntry() : key(0), count(0) { }
+    };
+
+    enum { NumTrafficStatsEntries = 16 };
+
+    TrafficStatsEntry traffic_stats_[NumTrafficStatsEntries];
+#endif
+
     static CanFilterConfig mergeFilters(CanFilterConfig &a_, CanFilterConfig &b_);
     static uint8_t countBits(uint32_t n_);
+    static bool isAccepted(const CanFilterConfig& cfg, uint32_t can_id) { return ((can_id ^ cfg.id) & cfg.mask) == 0; }
     uint16_t getNumFilters() const;
 
+    /**
+     * Expected number of irrelevant frames that would be accepted if the filter was added to the configuration,
+     * based on the observed traffic. Always zero if there are no traffic statistics.
+     */
+    uint32_t estimateFalseAcceptance(const CanFilterConfig& cfg) const;
+
+    void decayTrafficStats();
+
     /**
      * Fills the multiset_configs_ to proceed it with computeConfiguration()
      */
     int16_t loadInputConfiguration();
 
     /**
-     * This method merges several listeners's filter configurations by predetermined algorithm
-     * if number of available hardware acceptance filters less than number of listeners
+     * This method merges several listeners's filter configurations if number of available hardware acceptance
+     * filters less than number of listeners. At every step, it merges the pair that admits the least observed
+     * irrelevant traffic; in case of a tie (e.g. no traffic was observed yet), the pair whose merged mask keeps
+     * the most bits is selected.
      */
     int16_t computeConfiguration();
 
     /**
-     * This method loads the configuration computed with computeConfiguration() to the CAN driver.
+     * This method loads the configuration computed with computeConfiguration() to the CAN driver,
+     * unless it is the same as the one that was loaded last time.
      */
     int16_t applyConfiguration();
 
+#if !UAVCAN_TINY
+    virtual void handleListenerRegistryChange();
+    virtual void handleRejectedRxFrame(const CanRxFrame& frame);
+    virtual void handleTimerEvent(const TimerEvent&);
+#endif
+
     INode& node_;               //< Node reference is needed for access to ICanDriver and Dispatcher
     MultisetConfigContainer multiset_configs_;
+    CanFilterConfig applied_configs_[MaxCanAcceptanceFilters];
+    uint16_t num_applied_configs_;
+    uint32_t num_reconfigurations_;
 
 public:
     explicit CanAcceptanceFilterConfigurator(INode& node)
+#if !UAVCAN_TINY
+        : TimerBase(node)
+        , node_(node)
+#else
         : node_(node)
-        , multiset_configs_(node.getAllocator())
+#endif
+        , multiset_configs_(node.getAllocatorFor(MemoryConsumerOther))
+        , num_applied_configs_(0)
+        , num_reconfigurations_(0)
     { }
 
+#if !UAVCAN_TINY
+    ~CanAcceptanceFilterConfigurator() { disableAutomaticReconfiguration(); }
+#endif
+
     /**
      * This method invokes loadInputConfiguration(), computeConfiguration() and applyConfiguration() consequently, so that
      * optimal acceptance filter configuration will be computed and loaded through CanDriver::configureFilters()
@@ -90,6 +153,50 @@ public:
      */
     int configureFilters();
 
+#if !UAVCAN_TINY
+    /**
+     * Configures the filters immediately, then keeps them up to date: every time a message or service request
+     * listener is registered or unregistered, or the local Node ID is assigned, the configuration is recomputed
+     * from the scheduler's context at the next spin, so that the changes made in a row are handled at once.
+     * The driver is reconfigured only if the resulting configuration differs from the current one.
+     * Configuration failures are reported via INode::registerInternalFailure().
+     *
+     * In this mode the configurator also collects statistics of the frames that pass the hardware filters but
+     * are not needed by the node, so that the subsequent configurations avoid admitting the busiest of them when
+     * the filters have to be merged. The statistics decay with every reconfiguration. Calling configureFilters()
+     * explicitly re-optimizes the current configuration using the collected statistics.
+     *
+     * Only one object per node can be in this mode, and the automatic reconfiguration is disabled when the
+     * object is destroyed.
+     * @return 0 = success, negative for error; automatic reconfiguration remains disabled in case of error.
+     */
+    int enableAutomaticReconfiguration();
+
+    void disableAutomaticReconfiguration();
+
+    bool isAutomaticReconfigurationEnabled() const;
+#endif
+
+    /**
+     * Loads a known configuration into the CAN driver without computing it, e.g. the configuration that was in use
+     * before a restart (see @ref WarmStartSnapshot), so that the filters are effective right from the start.
+     * A subsequent configureFilters() call or automatic reconfiguration that yields the same configuration does not
+     * reconfigure the driver again; hence, the restored configuration should be validated by enabling the automatic
+     * reconfiguration after the listeners of the application have been created.
+     * @return 0 = success, negative for error.
+     */
+    int restoreConfiguration(const CanFilterConfig* configs, uint16_t num_configs);
+
+    /**
+     * Configuration that was loaded into the CAN driver last time.
+     */
+    uint16_t getNumAppliedConfigs() const { return num_applied_configs_; }
+    const CanFilterConfig& getAppliedConfig(uint16_t index) const
+    {
+        UAVCAN_ASSERT(index < num_applied_configs_);
+        return applied_configs_[min(index, uint16_t(MaxCanAcceptanceFilters - 1U))];
+    }
+
     /**
      * Returns the configuration computed with computeConfiguration().
      * If computeConfiguration() has not been called yet, an empty configuration will be returned.
@@ -98,6 +205,13 @@ public:
     {
         return multiset_configs_;
     }
+
+    /**
+     * Number of times the configuration was loaded into the CAN driver.
+     * The frames that pass the hardware filters but are not needed by the node are counted by
+     * Dispatcher::getNumRejectedRxFrames().
+     */
+    uint32_t getNumReconfigurations() const { return num_reconfigurations_; }
 };
 
 }
@@ -14,6 +14,8 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/templates.hpp>
 #include <uavcan/util/lazy_constructor.hpp>
+#include <uavcan/util/latency_histogram.hpp>
+#include <uavcan/transport/bus_load_estimator.hpp>
 #include <uavcan/driver/can.hpp>
 #include <uavcan/driver/system_clock.hpp>
 #include <uavcan/time.hpp>
@@ -21,39 +23,48 @@
 namespace uavcan
 {
 
-struct UAVCAN_EXPORT CanRxFrame : public CanFrame
-{
-    MonotonicTime ts_mono;
-    UtcTime ts_utc;
-    uint8_t iface_index;
-
-    CanRxFrame()
-        : iface_index(0)
-    { }
-
-#if UAVCAN_TOSTRING
-    std::string toString(StringRepresentation mode = StrTight) const;
-#endif
-};
-
-
+/**
+ * TX queue shared by all CAN interfaces. A frame that has to be transmitted via several (redundant) interfaces
+ * is stored once, and the entry keeps the mask of interfaces it is still pending for; the entry is freed when
+ * it has been transmitted via all of them, or when it expires.
+ *
+ * Every interface can keep at most allocator_quota / num_ifaces frames pending, so that a dead interface can't
+ * consume the memory needed by the others.
+ */
 class UAVCAN_EXPORT CanTxQueue : Noncopyable
 {
 public:
     enum Qos { Volatile, Persistent };
 
-    struct Entry : public LinkedListNode<Entry>  // Not required to be packed - fits the block in any case
+    struct Entry : public FastRemovalLinkedList<Entry>::Node  // Not required to be packed - fits the block in any case
     {
         MonotonicTime deadline;
         CanFrame frame;
         uint8_t qos;
+        uint8_t iface_mask;                      ///< Interfaces the frame is pending for
         CanIOFlags flags;
+#if UAVCAN_LATENCY_HISTOGRAMS
+        uint32_t push_ts_usec;                   ///< Lower 32 bits of the time the frame was queued or replaced
+#endif
+#if !UAVCAN_TINY
+        Entry* deadline_prev;                    ///< Neighbors in the deadline index of the queue
+        Entry* deadline_next;
+#endif
 
-        Entry(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags)
+        Entry(const CanFrame& arg_frame, MonotonicTime arg_deadline, Qos arg_qos, CanIOFlags arg_flags,
+              uint8_t arg_iface_mask = 1)
             : deadline(arg_deadline)
             , frame(arg_frame)
             , qos(uint8_t(arg_qos))
+            , iface_mask(arg_iface_mask)
             , flags(arg_flags)
+#if UAVCAN_LATENCY_HISTOGRAMS
+            , push_ts_usec(0)
+#endif
+#if !UAVCAN_TINY
+            , deadline_prev(NULL)
+            , deadline_next(NULL)
+#endif
         {
             UAVCAN_ASSERT((qos == Volatile) || (qos == Persistent));
             IsDynamicallyAllocatable<Entry>::check();
@@ -63,6 +74,8 @@ public:
 
         bool isExpired(MonotonicTime timestamp) const { return timestamp > deadline; }
 
+        bool isPendingFor(uint8_t iface_index) const { return (iface_mask & (1U << iface_index)) != 0; }
+
         bool qosHigherThan(const CanFrame& rhs_frame, Qos rhs_qos) const;
         bool qosLowerThan(const CanFrame& rhs_frame, Qos rhs_qos) const;
         bool qosHigherThan(const Entry& rhs) const { return qosHigherThan(rhs.frame, Qos(rhs.qos)); }
@@ -86,34 +99,256 @@ private:
         }
     };
 
-    LinkedListRoot<Entry> queue_;
+    FastRemovalLinkedList<Entry>::Root queue_;
     LimitedPoolAllocator allocator_;
     ISystemClock& sysclock_;
-    uint32_t rejected_frames_cnt_;
+    const uint16_t iface_quota_;
+    uint16_t num_pending_[MaxCanIfaces];
+    uint32_t rejected_frames_cnt_[MaxCanIfaces];
 
-    void registerRejectedFrame();
+#if !UAVCAN_TINY
+    /**
+     * The queue is split into priority levels defined by the 5 most significant bits of the arbitration field.
+     * Entries of the same level are adjacent in the list; for every level the last entry is tracked, which allows
+     * to insert a frame in constant time when its priority is not higher than that of the last entry of its level
+     * (e.g. consecutive frames of a multi-frame transfer). Otherwise only entries of the same level are traversed.
+     */
+    enum { NumPriorityLevels = 32 };
+
+    Entry* level_tails_[NumPriorityLevels];
+
+    static unsigned getPriorityLevel(const CanFrame& frame);
+
+    /**
+     * All entries are also linked in the order of their deadlines, the equal deadlines in the order of insertion,
+     * so that the expired entries can be found without traversing the queue. New frames usually have the latest
+     * deadline, so the insertion starts from the tail.
+     */
+    Entry* deadline_head_;
+    Entry* deadline_tail_;
+
+    void linkDeadline(Entry* entry);
+    void unlinkDeadline(Entry* entry);
+
+    void linkPriority(Entry* entry);
+    void unlinkPriority(Entry* entry);
+
+    uint32_t last_tx_can_id_[MaxCanIfaces];     ///< CAN ID of the last frame transmitted from the queue, or zero
+    bool fair_scheduling_;
+
+    MonotonicDuration escalation_horizon_;      ///< Zero if the escalation is disabled
+    uint8_t escalation_ceiling_;
+    uint32_t escalated_frames_cnt_;
+
+    void escalateApproachingDeadlines(MonotonicTime timestamp);
+#endif
+
+    Entry* findCoalescible(const CanFrame& frame, uint8_t iface_mask);
+    Entry* findFirstPendingFor(uint8_t iface_index) const;
+    Entry* findNextPendingFor(uint8_t iface_index) const;
+
+    void registerRejectedFrame(uint8_t iface_mask);
+
+    uint8_t enforceIfaceQuota(const CanFrame& frame, Qos qos, uint8_t iface_mask, MonotonicTime timestamp);
+
+    void insert(Entry* entry);
+    void unlink(Entry*& entry);
+    void release(Entry*& entry, uint8_t iface_index);
 
 public:
-    CanTxQueue(IPoolAllocator& allocator, ISystemClock& sysclock, std::size_t allocator_quota)
+    CanTxQueue(IPoolAllocator& allocator, ISystemClock& sysclock, std::size_t allocator_quota,
+               uint8_t num_ifaces = 1)
         : allocator_(allocator, allocator_quota)
         , sysclock_(sysclock)
-        , rejected_frames_cnt_(0)
-    { }
+        , iface_quota_(static_cast<uint16_t>(min<std::size_t>(allocator_quota / num_ifaces, 0xFFFFU)))
+    {
+        UAVCAN_ASSERT((num_ifaces > 0) && (num_ifaces <= MaxCanIfaces));
+        fill_n(num_pending_, unsigned(MaxCanIfaces), uint16_t(0));
+        fill_n(rejected_frames_cnt_, unsigned(MaxCanIfaces), uint32_t(0));
+#if !UAVCAN_TINY
+        fill_n(level_tails_, unsigned(NumPriorityLevels), static_cast<Entry*>(NULL));
+        deadline_head_ = NULL;
+        deadline_tail_ = NULL;
+        fill_n(last_tx_can_id_, unsigned(MaxCanIfaces), uint32_t(0));
+        fair_scheduling_ = false;
+        escalation_ceiling_ = 0;
+        escalated_frames_cnt_ = 0;
+#endif
+    }
 
     ~CanTxQueue();
 
-    void push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags);
+    /**
+     * Enqueues the frame for all interfaces specified by the mask, using one entry.
+     * The second overload accepts the current monotonic time from the caller, and does not read the clock.
+     */
+    void push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags, uint8_t iface_mask = 1);
+    void push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags, uint8_t iface_mask,
+              MonotonicTime now);
+
+    /**
+     * Replaces the queued frame that has the same CAN ID and was pushed with @ref CanIOFlagCoalesce, keeping its
+     * position in the queue. The replaced frame must not be pending for interfaces outside of the mask.
+     * Returns false if there is no such frame; the queue is not modified in this case.
+     */
+    bool replace(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                 uint8_t iface_mask = 1);
+    bool replace(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                 uint8_t iface_mask, MonotonicTime now);
+
+    /**
+     * Returns the entry to be transmitted next via the specified interface, removing expired entries on the way.
+     * That is the top priority entry, unless the fair scheduling is enabled.
+     */
+    Entry* peek(uint8_t iface_index = 0);               // Modifier
+    Entry* peek(uint8_t iface_index, MonotonicTime now);
 
-    Entry* peek();               // Modifier
+    /**
+     * Marks the entry as transmitted via the specified interface; the entry is destroyed if it is not pending for
+     * other interfaces. The entry pointer is reset in any case.
+     */
+    void remove(Entry*& entry, uint8_t iface_index);
+
+    /**
+     * Destroys the entry regardless of the interfaces it is pending for.
+     */
     void remove(Entry*& entry);
-    const CanFrame* getTopPriorityPendingFrame() const;
+
+    /**
+     * Destroys the entries whose deadline has passed; they are counted as rejected frames.
+     * Complexity is O(number of expired entries), or O(N) in UAVCAN_TINY mode.
+     */
+    void removeExpired(MonotonicTime timestamp);
+
+    /**
+     * Drops the frames pending for the specified interface, except for the num_to_keep ones of the highest priority;
+     * they are counted as rejected frames. The entries that are still pending for other interfaces are kept.
+     */
+    void removePendingFor(uint8_t iface_index, unsigned num_to_keep = 0);
+
+    const CanFrame* getTopPriorityPendingFrame(uint8_t iface_index = 0) const;
 
     /// The 'or equal' condition is necessary to avoid frame reordering.
-    bool topPriorityHigherOrEqual(const CanFrame& rhs_frame) const;
+    bool topPriorityHigherOrEqual(const CanFrame& rhs_frame, uint8_t iface_index = 0) const;
+
+    uint32_t getRejectedFrameCount(uint8_t iface_index = 0) const { return rejected_frames_cnt_[iface_index]; }
 
-    uint32_t getRejectedFrameCount() const { return rejected_frames_cnt_; }
+    unsigned getNumPendingFrames(uint8_t iface_index) const { return num_pending_[iface_index]; }
 
     bool isEmpty() const { return queue_.isEmpty(); }
+
+    /**
+     * Mask of interfaces that have at least one frame pending.
+     */
+    uint8_t getPendingIfaceMask() const;
+
+#if !UAVCAN_TINY
+    /**
+     * Within a priority level (the 5 most significant bits of the arbitration field), the frames are normally
+     * transmitted in the order of their CAN IDs, so that a long multi-frame transfer holds back all frames of the
+     * same level that have a higher CAN ID until it drains. In the fair mode, each interface serves the distinct
+     * CAN IDs of the top priority level round-robin, one frame at a time. The frames of one CAN ID (e.g. the frames
+     * of a transfer) are still transmitted in order, and the priority levels are still strictly respected.
+     * Selection of the next frame becomes linear in the number of the queued frames of the top priority level.
+     * Disabled by default.
+     */
+    void setFairScheduling(bool enabled) { fair_scheduling_ = enabled; }
+    bool isFairScheduling() const { return fair_scheduling_; }
+
+    /**
+     * Earliest deadline first escalation. When the queue is peeked, the queued frames whose TX deadline is less than
+     * the horizon away are moved up to the ceiling priority (the 5-bit UAVCAN transfer priority, lower value means
+     * higher priority), unless their priority is already higher; this rewrites the priority field of their CAN ID.
+     * Frames sharing a deadline are escalated together and keep their order, so a multi-frame transfer stays intact.
+     * Transfers whose deadlines are not in the order of their queuing may overtake each other. Standard frames and
+     * coalescible frames (@ref CanIOFlagCoalesce) are never escalated - the latter are superseded rather than late.
+     * Every peek traverses the frames within the horizon. Zero horizon disables the escalation, which is the default.
+     */
+    void setDeadlineEscalation(MonotonicDuration horizon, uint8_t ceiling_priority)
+    {
+        UAVCAN_ASSERT(ceiling_priority < NumPriorityLevels);
+        escalation_horizon_ = horizon;
+        escalation_ceiling_ = uint8_t(min(ceiling_priority, uint8_t(NumPriorityLevels - 1)));
+    }
+    MonotonicDuration getDeadlineEscalationHorizon() const { return escalation_horizon_; }
+
+    /**
+     * Number of frames whose priority has been raised by the deadline escalation.
+     */
+    uint32_t getEscalatedFrameCount() const { return escalated_frames_cnt_; }
+#endif
+};
+
+/**
+ * Small preallocated TX queue for the frames sent with @ref CanIOFlagEmergency, such as panic messages.
+ * It never allocates memory, so it keeps working when the memory pool is exhausted by the regular traffic, and it is
+ * serviced before the regular TX queue. The frames are ordered by CAN priority, the equal ones in the order of
+ * insertion; the capacity is small, so all operations are linear. Expired frames are counted as rejected.
+ * The capacity is defined by UAVCAN_CAN_EMERGENCY_TX_LANE_CAPACITY.
+ */
+class UAVCAN_EXPORT CanEmergencyTxLane : Noncopyable
+{
+public:
+    enum { Capacity = UAVCAN_CAN_EMERGENCY_TX_LANE_CAPACITY };
+
+    struct Entry
+    {
+        CanFrame frame;
+        MonotonicTime deadline;
+        CanIOFlags flags;
+        uint8_t iface_mask;                     ///< Interfaces the frame is still pending for
+
+        Entry()
+            : flags(0)
+            , iface_mask(0)
+        { }
+
+        bool isPendingFor(uint8_t iface_index) const { return (iface_mask & (1U << iface_index)) != 0; }
+    };
+
+private:
+    Entry entries_[Capacity];                   ///< Entries [0, size_) are used, in the order of insertion
+    uint8_t size_;
+    uint32_t rejected_frames_cnt_[MaxCanIfaces];
+
+    void removeAt(unsigned index);
+    int findTopPendingFor(uint8_t iface_index) const;
+
+public:
+    CanEmergencyTxLane()
+        : size_(0)
+    {
+        StaticAssert<(Capacity > 0) && (Capacity <= 255)>::check();
+        fill_n(rejected_frames_cnt_, unsigned(MaxCanIfaces), uint32_t(0));
+    }
+
+    /**
+     * Returns false if the lane is full even after the expired frames were removed; the frame is not queued then.
+     */
+    bool push(const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags, uint8_t iface_mask,
+              MonotonicTime now);
+
+    /**
+     * Returns the top priority frame pending for the interface, removing the expired ones; NULL if there's none.
+     */
+    Entry* peek(uint8_t iface_index, MonotonicTime now);
+
+    /**
+     * Marks the entry as transmitted via the interface; the entry is freed once it's transmitted via all of them.
+     */
+    void remove(Entry*& entry, uint8_t iface_index);
+
+    void removeExpired(MonotonicTime now);
+
+    const CanFrame* getTopPriorityPendingFrame(uint8_t iface_index) const;
+
+    uint8_t getPendingIfaceMask() const;
+
+    uint32_t getRejectedFrameCount(uint8_t iface_index) const { return rejected_frames_cnt_[iface_index]; }
+
+    unsigned getSize() const { return size_; }
+
+    bool isEmpty() const { return size_ == 0; }
 };
 
 
@@ -121,43 +356,123 @@ struct UAVCAN_EXPORT CanIfacePerfCounters
 {
     uint64_t frames_tx;
     uint64_t frames_rx;
+    uint64_t bytes_tx;      ///< CAN frame payload bytes, i.e. sum of DLC
+    uint64_t bytes_rx;
     uint64_t errors;
 
     CanIfacePerfCounters()
         : frames_tx(0)
         , frames_rx(0)
+        , bytes_tx(0)
+        , bytes_rx(0)
         , errors(0)
     { }
 };
 
 
+#if !UAVCAN_TINY
+/**
+ * Source of transfers that were prepared outside of the thread that spins the node, e.g. by a lock-free queue
+ * that other threads push pre-encoded transfers into. The IO manager polls it from the spinning thread before
+ * every select() call that waits for RX frames, so that the collected transfers are sent without waiting for
+ * the current spin to end. If the producers need the spinning thread to react promptly, they must also make
+ * the blocking select() return early; see Dispatcher::installExternalTxSource().
+ */
+class UAVCAN_EXPORT IExternalTxSource
+{
+public:
+    virtual ~IExternalTxSource() { }
+
+    /**
+     * Sends the pending transfers through the node; invoked from the spinning thread. Must not block.
+     */
+    virtual void flushPendingTransfers() = 0;
+};
+#endif
+
 class UAVCAN_EXPORT CanIOManager : Noncopyable
 {
     struct IfaceFrameCounters
     {
         uint64_t frames_tx;
         uint64_t frames_rx;
+        uint64_t bytes_tx;
+        uint64_t bytes_rx;
+        uint64_t frames_suppressed;     ///< Frames that were not queued because the interface was unhealthy
 
         IfaceFrameCounters()
             : frames_tx(0)
             , frames_rx(0)
+            , bytes_tx(0)
+            , bytes_rx(0)
+            , frames_suppressed(0)
         { }
     };
 
+#if !UAVCAN_TINY
+    /**
+     * Snapshot of the interface state taken at the last health check.
+     */
+    struct IfaceHealth
+    {
+        uint64_t error_count;
+        uint64_t frames_tx;
+        uint8_t bus_state;              ///< CanBusState, never unknown
+        bool tx_pending;
+
+        IfaceHealth()
+            : error_count(0)
+            , frames_tx(0)
+            , bus_state(CanBusStateErrorActive)
+            , tx_pending(false)
+        { }
+    };
+#endif
+
     ICanDriver& driver_;
     ISystemClock& sysclock_;
 
-    LazyConstructor<CanTxQueue> tx_queues_[MaxCanIfaces];
+    LazyConstructor<CanTxQueue> tx_queue_;
+    CanEmergencyTxLane emergency_lane_;
     IfaceFrameCounters counters_[MaxCanIfaces];
+#if UAVCAN_LATENCY_HISTOGRAMS
+    LatencyHistogram tx_queue_latency_;
+#endif
+#if !UAVCAN_TINY
+    BusLoadEstimator bus_load_[MaxCanIfaces];
+    IExternalTxSource* external_tx_source_;
+    IfaceHealth health_[MaxCanIfaces];
+    MonotonicTime next_health_check_ts_;
+    uint8_t tx_suppressed_mask_;
+#endif
 
     const uint8_t num_ifaces_;
 
-    int sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags);
-    int sendFromTxQueue(uint8_t iface_index);
+    MonotonicTime last_select_ts_;
+
+    /*
+     * The current time is read once per select() and passed down, so that transmission of a frame does not
+     * cost several clock reads.
+     */
+    int sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags,
+                    MonotonicTime now);
+    int sendFromTxQueue(uint8_t iface_index, MonotonicTime now);
+    const CanFrame* getTopPriorityPendingFrame(uint8_t iface_index) const;
+    bool hasQueuedFrameBefore(const CanFrame& frame, bool emergency, uint8_t iface_index) const;
     int callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pending_tx)[MaxCanIfaces],
                    MonotonicTime blocking_deadline);
+#if !UAVCAN_TINY
+    void checkIfaceHealth(MonotonicTime now);
+    void updateTxSuppressedMask();
+    uint8_t filterTxSuppressedIfaces(uint8_t iface_mask);
+#endif
 
 public:
+    /**
+     * The interface health is reevaluated at this interval, from the transmitting context; see getIfaceBusState().
+     */
+    enum { IfaceHealthCheckPeriodMs = 50 };
+
     CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock,
                  std::size_t mem_blocks_per_iface = 0);
 
@@ -165,11 +480,101 @@ public:
 
     CanIfacePerfCounters getIfacePerfCounters(uint8_t iface_index) const;
 
+#if UAVCAN_LATENCY_HISTOGRAMS
+    /**
+     * Time the frames spent in the TX queue before they were transmitted, counted per interface.
+     * The frames that were transmitted immediately, bypassing the queue, are not counted.
+     */
+    const LatencyHistogram& getTxQueueLatencyHistogram() const { return tx_queue_latency_; }
+    LatencyHistogram& getTxQueueLatencyHistogram()             { return tx_queue_latency_; }
+#endif
+
+#if !UAVCAN_TINY
+    /**
+     * Enables the bus load estimation on all interfaces; see @ref BusLoadEstimator. Both received and transmitted
+     * frames are accounted for. Zero bit rate disables the estimation, which is the default.
+     * @param bitrate   Bit rate of the CAN bus in bits per second.
+     * @param window    Length of the sliding window the load is averaged over.
+     */
+    void configureBusLoadEstimation(uint32_t bitrate, MonotonicDuration window =
+                                        MonotonicDuration::fromMSec(BusLoadEstimator::DefaultWindowMs));
+
+    /**
+     * Estimated bus load of the specified interface within [0, 1] over the last window.
+     * Returns zero if the estimation is disabled.
+     */
+    float getBusLoad(uint8_t iface_index) const;
+
+    const BusLoadEstimator& getBusLoadEstimator(uint8_t iface_index) const
+    {
+        UAVCAN_ASSERT(iface_index < MaxCanIfaces);
+        return bus_load_[min(iface_index, uint8_t(MaxCanIfaces - 1))];
+    }
+
+    /**
+     * Fault confinement state of the interface as tracked by the IO manager. It is reported by the driver (see
+     * @ref ICanIface::getBusState()); if the driver doesn't report it, the interface is considered bus off when
+     * its error count keeps growing while the pending frames can't be transmitted.
+     *
+     * The TX is suppressed for the interfaces that are bus off, and for the error passive ones if another interface
+     * is error active: at most one frame is kept pending for such interface, which probes the bus, and the rest of
+     * the frames are not queued for it (they are still transmitted via the redundant interfaces, if any); they are
+     * counted as errors. The frames sent to a specific interface only are never moved to another one.
+     * The interface recovers as soon as a frame has been transmitted via it, or the driver reports a better state.
+     */
+    CanBusState getIfaceBusState(uint8_t iface_index) const;
+
+    bool isIfaceTxSuppressed(uint8_t iface_index) const
+    {
+        return (iface_index < MaxCanIfaces) && ((tx_suppressed_mask_ & (1U << iface_index)) != 0);
+    }
+
+    /**
+     * Round-robin transmission of the queued frames that have the same priority; see
+     * @ref CanTxQueue::setFairScheduling(). Disabled by default.
+     */
+    void setTxFairScheduling(bool enabled) { tx_queue_->setFairScheduling(enabled); }
+    bool isTxFairScheduling() const { return tx_queue_->isFairScheduling(); }
+
+    /**
+     * Raises the priority of the queued frames that are about to miss their TX deadline; see
+     * @ref CanTxQueue::setDeadlineEscalation(). Disabled by default.
+     */
+    void setTxDeadlineEscalation(MonotonicDuration horizon, uint8_t ceiling_priority)
+    {
+        tx_queue_->setDeadlineEscalation(horizon, ceiling_priority);
+    }
+
+    IExternalTxSource* getExternalTxSource() const { return external_tx_source_; }
+    void removeExternalTxSource() { external_tx_source_ = NULL; }
+    void installExternalTxSource(IExternalTxSource* source) { external_tx_source_ = source; }
+#endif
+
     const ICanDriver& getCanDriver() const { return driver_; }
     ICanDriver& getCanDriver()             { return driver_; }
 
     uint8_t makePendingTxMask() const;
 
+    /**
+     * Number of frames waiting in the TX queue for the specified interface.
+     */
+    unsigned getNumPendingTxFrames(uint8_t iface_index) const
+    {
+        return (iface_index < MaxCanIfaces) ? tx_queue_->getNumPendingFrames(iface_index) : 0;
+    }
+
+    /**
+     * Frames sent with @ref CanIOFlagEmergency are queued here; if the lane is full, they go to the regular TX queue.
+     */
+    const CanEmergencyTxLane& getEmergencyTxLane() const { return emergency_lane_; }
+
+    /**
+     * Time when the last call to select() inside @ref send() or @ref receiveBatch() has returned.
+     * It is read anyway, so the upper layers can reuse it instead of reading the clock once again.
+     * Zero if there was no IO yet.
+     */
+    MonotonicTime getLastSelectTimestamp() const { return last_select_ts_; }
+
     /**
      * Returns:
      *  0 - rejected/timedout/enqueued
@@ -179,6 +584,13 @@ public:
     int send(const CanFrame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
              uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags);
     int receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline, CanIOFlags& out_flags);
+
+    /**
+     * Same as @ref receive(), but fetches up to max_frames frames from the first interface that has RX frames
+     * pending. Returns the number of received frames.
+     */
+    int receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames,
+                     MonotonicTime blocking_deadline);
 };
 
 }
@@ -12,6 +12,15 @@
 namespace uavcan
 {
 
+#if UAVCAN_USE_EXTERNAL_CRC
+/**
+ * Must be implemented by the application if UAVCAN_USE_EXTERNAL_CRC is set, e.g. using a hardware CRC unit.
+ * Continues the computation of CRC-16-CCITT (see @ref TransferCRC) from the given intermediate value over the
+ * given bytes, and returns the new intermediate value.
+ */
+extern uint16_t computeTransferCrcExternally(uint16_t crc, const uint8_t* bytes, unsigned len);
+#endif
+
 /**
  * CRC-16-CCITT
  * Initial value: 0xFFFF
@@ -30,6 +39,11 @@ class UAVCAN_EXPORT TransferCRC
 #if !UAVCAN_TINY
     static const uint16_t Table[256];
 #endif
+#if UAVCAN_CRC_SLICING_BY_4
+    static const uint16_t SlicingTable[3][256];
+
+    void addSlicingBy4(const uint8_t* bytes, unsigned len);
+#endif
 
     uint16_t value_;
 
@@ -66,10 +80,16 @@ public:
     void add(const uint8_t* bytes, unsigned len)
     {
         UAVCAN_ASSERT(bytes);
+#if UAVCAN_USE_EXTERNAL_CRC
+        value_ = computeTransferCrcExternally(value_, bytes, len);
+#elif UAVCAN_CRC_SLICING_BY_4
+        addSlicingBy4(bytes, len);
+#else
         while (len--)
         {
             add(*bytes++);
         }
+#endif
     }
 
     uint16_t get() const { return value_; }
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_DATA_TYPE_STATS_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_DATA_TYPE_STATS_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/data_type.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Transport statistics of one data type, maintained by the dispatcher; refer to @ref DataTypeStatsTable.
+ * Statistics of service data types include both requests and responses.
+ *
+ * The frame counters reflect the traffic received by the node, every frame is counted once.
+ * The transfer counters reflect the work done by the listeners, so if there are several subscribers of the same
+ * message type, every received transfer is counted by each of them.
+ *
+ * All counters are 32 bit wide and wrap around, so that the rates can be computed as differences.
+ */
+struct UAVCAN_EXPORT DataTypeStats
+{
+    DataTypeID data_type_id;
+    DataTypeKind data_type_kind;    ///< NumDataTypeKinds if the entry is not used
+
+    uint32_t frames_rx;
+    uint32_t frames_tx;
+    uint32_t transfers_rx;
+    uint32_t transfers_tx;
+    uint32_t payload_bytes_rx;      ///< Payload of the CAN frames, including the CRC of multi-frame transfers
+    uint32_t payload_bytes_tx;
+    uint32_t rx_errors;             ///< Reassembly failures, e.g. lost frames or CRC mismatches
+    uint32_t receivers_created;     ///< Reassembly states allocated for new sources
+    uint32_t receivers_removed;     ///< Reassembly states released after the sources went silent
+
+    uint32_t max_reassembly_time_usec;  ///< Time between the first and the last frame of a multi-frame transfer
+    uint32_t max_callback_duration_usec;
+
+    DataTypeStats()
+        : data_type_kind(NumDataTypeKinds)
+    {
+        resetCounters();
+    }
+
+    bool isUsed() const { return data_type_kind != NumDataTypeKinds; }
+
+    void resetCounters()
+    {
+        frames_rx = 0;
+        frames_tx = 0;
+        transfers_rx = 0;
+        transfers_tx = 0;
+        payload_bytes_rx = 0;
+        payload_bytes_tx = 0;
+        rx_errors = 0;
+        receivers_created = 0;
+        receivers_removed = 0;
+        max_reassembly_time_usec = 0;
+        max_callback_duration_usec = 0;
+    }
+
+    void addRxFrame(unsigned payload_len)
+    {
+        frames_rx++;
+        payload_bytes_rx += payload_len;
+    }
+
+    void addTxFrame(unsigned payload_len)
+    {
+        frames_tx++;
+        payload_bytes_tx += payload_len;
+    }
+
+    void addRxTransfer(MonotonicDuration reassembly_time)
+    {
+        transfers_rx++;
+        max_reassembly_time_usec = max(max_reassembly_time_usec, saturateUSec(reassembly_time));
+    }
+
+    void addCallbackDuration(MonotonicDuration duration)
+    {
+        max_callback_duration_usec = max(max_callback_duration_usec, saturateUSec(duration));
+    }
+
+    static uint32_t saturateUSec(MonotonicDuration dur)
+    {
+        const int64_t usec = dur.toUSec();
+        return (usec <= 0) ? 0U : ((usec >= int64_t(0xFFFFFFFFU)) ? 0xFFFFFFFFU : uint32_t(usec));
+    }
+};
+
+/**
+ * Fixed-size table of per data type statistics, refer to Dispatcher::getDataTypeStatsTable().
+ * Entries are allocated when the data type is used for the first time (i.e. its listener is registered,
+ * or its first transfer is sent), and are never released, so it is safe to keep pointers to them.
+ * Data types that do not fit the table are not tracked; the capacity is defined by UAVCAN_DATA_TYPE_STATS_SIZE.
+ */
+class UAVCAN_EXPORT DataTypeStatsTable : Noncopyable
+{
+public:
+    enum { Capacity = DataTypeStatsTableSize };
+
+private:
+    DataTypeStats entries_[(Capacity > 0) ? Capacity : 1];
+    unsigned num_entries_;
+
+public:
+    DataTypeStatsTable()
+        : num_entries_(0)
+    { }
+
+    /**
+     * Returns the entry of the specified data type, possibly allocating a new one.
+     * Returns NULL if the table is full or disabled.
+     */
+    DataTypeStats* access(DataTypeKind kind, DataTypeID dtid);
+
+    /**
+     * Returns NULL if the data type is not tracked.
+     */
+    const DataTypeStats* find(DataTypeKind kind, DataTypeID dtid) const;
+
+    unsigned getSize() const { return num_entries_; }
+
+    const DataTypeStats* getByIndex(unsigned index) const
+    {
+        return (index < num_entries_) ? &entries_[index] : NULL;
+    }
+
+    /**
+     * Resets the counters of all entries; the entries remain allocated.
+     */
+    void resetCounters();
+};
+
+}
+
+#endif // UAVCAN_TRANSPORT_DATA_TYPE_STATS_HPP_INCLUDED
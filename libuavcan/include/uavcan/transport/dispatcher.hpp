@@ -10,6 +10,7 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/perf_counter.hpp>
+#include <uavcan/transport/data_type_stats.hpp>
 #include <uavcan/transport/transfer_listener.hpp>
 #include <uavcan/transport/outgoing_transfer_registry.hpp>
 #include <uavcan/transport/can_io.hpp>
@@ -19,43 +20,85 @@ namespace uavcan
 {
 
 class UAVCAN_EXPORT Dispatcher;
+#if !UAVCAN_TINY
+class UAVCAN_EXPORT PromiscuousTransferListenerBase;
+#endif
 
 #if !UAVCAN_TINY
 /**
  * Inherit this class to receive notifications about all TX CAN frames that were transmitted with the loopback flag.
  */
-class UAVCAN_EXPORT LoopbackFrameListenerBase : public LinkedListNode<LoopbackFrameListenerBase>, Noncopyable
+class UAVCAN_EXPORT LoopbackFrameListenerBase : public FastRemovalLinkedList<LoopbackFrameListenerBase>::Node,
+                                                Noncopyable
 {
     Dispatcher& dispatcher_;
+    DataTypeID data_type_id_;
+    bool all_data_types_;
 
 protected:
     explicit LoopbackFrameListenerBase(Dispatcher& dispatcher)
         : dispatcher_(dispatcher)
+        , all_data_types_(true)
     { }
 
     virtual ~LoopbackFrameListenerBase() { stopListening(); }
 
+    /**
+     * Listens for the loopback frames of all data types.
+     */
     void startListening();
+
+    /**
+     * Listens for the loopback frames of the specified data type ID only. The loopback is not requested from the
+     * driver for the frames that no listener is interested in, so this overload should be preferred.
+     */
+    void startListening(DataTypeID data_type_id);
+
     void stopListening();
     bool isListening() const;
 
     Dispatcher& getDispatcher() { return dispatcher_; }
 
 public:
+    bool isInterestedIn(DataTypeID data_type_id) const { return all_data_types_ || (data_type_id == data_type_id_); }
+    bool isInterestedInAllDataTypes() const { return all_data_types_; }
+    DataTypeID getDataTypeID() const { return data_type_id_; }
+
     virtual void handleLoopbackFrame(const RxFrame& frame) = 0;
 };
 
 
 class UAVCAN_EXPORT LoopbackFrameListenerRegistry : Noncopyable
 {
-    LinkedListRoot<LoopbackFrameListenerBase> listeners_;
+    FastRemovalLinkedList<LoopbackFrameListenerBase>::Root listeners_;
+
+    /**
+     * Bit N is set if there may be a listener whose data type ID modulo 64 equals N; all bits are set if there is
+     * a listener that accepts all data types.
+     */
+    uint64_t data_type_mask_;
+
+    void updateDataTypeMask();
 
 public:
+    LoopbackFrameListenerRegistry()
+        : data_type_mask_(0)
+    { }
+
     void add(LoopbackFrameListenerBase* listener);
     void remove(LoopbackFrameListenerBase* listener);
     bool doesExist(const LoopbackFrameListenerBase* listener) const;
     unsigned getNumListeners() const { return listeners_.getLength(); }
 
+    /**
+     * Conservative check that works on the raw CAN ID, so that the frames nobody is interested in need neither
+     * be looped back by the driver nor parsed. False positives are possible, false negatives are not.
+     */
+    bool mayBeInterestedIn(const CanFrame& can_frame) const;
+
+    /**
+     * Invokes only the listeners that are interested in the data type of the frame.
+     */
     void invokeListeners(RxFrame& frame);
 };
 
@@ -72,6 +115,27 @@ public:
      */
     virtual void handleRxFrame(const CanRxFrame& frame, CanIOFlags flags) = 0;
 };
+
+/**
+ * Implement this interface to be notified when the set of frames the node needs to receive may have changed,
+ * i.e. when a message or service request listener is registered or unregistered, when the RX frame listener is
+ * installed or removed, or when the local Node ID is set.
+ * The notification may be delivered from the constructors and destructors of the listeners, so the handler
+ * should defer any heavy processing.
+ */
+class UAVCAN_EXPORT IListenerRegistryObserver
+{
+public:
+    virtual ~IListenerRegistryObserver() { }
+
+    virtual void handleListenerRegistryChange() = 0;
+
+    /**
+     * Invoked for every received frame that was discarded by the dispatcher, refer to
+     * Dispatcher::getNumRejectedRxFrames(). This can be used to assess the efficiency of the hardware filters.
+     */
+    virtual void handleRejectedRxFrame(const CanRxFrame& frame) { (void)frame; }
+};
 #endif
 
 /**
@@ -86,7 +150,7 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
 
     class ListenerRegistry
     {
-        LinkedListRoot<TransferListenerBase> list_;
+        FastRemovalLinkedList<TransferListenerBase>::Root list_;
 
         class DataTypeIDInsertionComparator
         {
@@ -100,48 +164,162 @@ class UAVCAN_EXPORT Dispatcher : Noncopyable
             }
         };
 
+        /**
+         * Direct-mapped index: each entry points to the first listener of the cached data type ID in the list,
+         * or to NULL if there are no such listeners. Collisions are resolved by eviction, so that a lookup that
+         * misses the index falls back to linear search and then updates the index.
+         */
+        struct IndexEntry
+        {
+            DataTypeID dtid;
+            TransferListenerBase* first;
+
+            IndexEntry() : first(NULL) { }
+        };
+
+        enum { IndexSize = (DispatcherListenerIndexSize > 0) ? DispatcherListenerIndexSize : 1 };
+
+        IndexEntry index_[IndexSize];
+
+        TransferListenerBase* cleanup_cursor_;      ///< Next listener to clean up within the ongoing pass
+        bool cleanup_in_progress_;
+
+        static unsigned getIndexPosition(DataTypeID dtid) { return dtid.get() & (unsigned(IndexSize) - 1U); }
+
+        TransferListenerBase* findFirstLinear(DataTypeID dtid) const;
+        TransferListenerBase* findFirst(DataTypeID dtid);
+        void updateIndex(DataTypeID dtid);
+
     public:
         enum Mode { UniqueListener, ManyListeners };
 
+        ListenerRegistry()
+            : cleanup_cursor_(NULL)
+            , cleanup_in_progress_(false)
+        { }
+
         bool add(TransferListenerBase* listener, Mode mode);
         void remove(TransferListenerBase* listener);
         bool exists(DataTypeID dtid) const;
         void cleanup(MonotonicTime ts);
-        void handleFrame(const RxFrame& frame);
+        /// Cleans up the listeners until the budget is exhausted; returns true once the pass is finished
+        bool cleanupIncrementally(MonotonicTime ts, unsigned& budget);
+        /// Returns false if there were no listeners for this frame
+        bool handleFrame(const RxFrame& frame);
 
         unsigned getNumEntries() const { return list_.getLength(); }
 
-        const LinkedListRoot<TransferListenerBase>& getList() const { return list_; }
+        const FastRemovalLinkedList<TransferListenerBase>::Root& getList() const { return list_; }
     };
 
     ListenerRegistry lmsg_;
     ListenerRegistry lsrv_req_;
     ListenerRegistry lsrv_resp_;
 
+    /**
+     * Bit N is set if there may be a message listener whose data type ID modulo 64 equals N.
+     * This allows to drop most of the unwanted message frames without parsing them, see isRejectedByCanID().
+     */
+    uint64_t message_dtid_mask_;
+
 #if !UAVCAN_TINY
     LoopbackFrameListenerRegistry loopback_listeners_;
     IRxFrameListener* rx_listener_;
+    PromiscuousTransferListenerBase* promiscuous_listener_;
+    IListenerRegistryObserver* listener_registry_observer_;
+    uint64_t num_rejected_rx_frames_;
+    uint64_t num_prefiltered_rx_frames_;
+    DataTypeStatsTable data_type_stats_;
 #endif
 
+    ExecutionTimeCounter* frame_handling_time_counter_;
+
+    MonotonicTime iteration_ts_;                ///< Refer to getMonotonicTime()
+    uint8_t iteration_depth_;
+
     NodeID self_node_id_;
     bool self_node_id_is_set_;
+    uint8_t cleanup_stage_;                     ///< Refer to cleanupIncrementally()
+    TransferPriority emergency_priority_threshold_;     ///< Invalid if disabled
+
+    void updateIterationTimestamp() { setIterationTimestamp(canio_.getLastSelectTimestamp()); }
+
+    static uint64_t getMessageDataTypeMaskBit(DataTypeID dtid) { return uint64_t(1) << (dtid.get() & 63U); }
+
+    void updateMessageDataTypeMask();
+
+    /// Cheap check that works on the raw CAN ID, before the frame is parsed
+    bool isRejectedByCanID(const CanRxFrame& can_frame) const;
 
     void handleFrame(const CanRxFrame& can_frame);
 
     void handleLoopbackFrame(const CanRxFrame& can_frame);
 
+#if UAVCAN_TINY
+    bool isLoopbackNeeded(const CanFrame&) const { return false; }
+#else
+    /// The loopback frames are also reported to the RX frame listener, refer to @ref IRxFrameListener
+    bool isLoopbackNeeded(const CanFrame& can_frame) const
+    {
+        return (rx_listener_ != NULL) || loopback_listeners_.mayBeInterestedIn(can_frame);
+    }
+#endif
+
     void notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags flags);
 
+    void notifyListenerRegistryObserver();
+
+    void registerRejectedRxFrame(const CanRxFrame& can_frame, bool prefiltered = false);
+
+    void attachDataTypeStats(TransferListenerBase* listener);
+
+    /// Returns the number of processed frames, i.e. received frames excluding loopback
+    int handleFrameBatch(const CanRxFrame* can_frames, const CanIOFlags* flags, int num_frames);
+
 public:
+    /**
+     * Marks the scope of one spin iteration, see @ref getMonotonicTime(). Scopes can be nested; the cached
+     * timestamp is dropped when the outermost scope is left, so it never leaks outside of the spin.
+     */
+    class IterationScope : Noncopyable
+    {
+        Dispatcher& owner_;
+
+    public:
+        explicit IterationScope(Dispatcher& owner)
+            : owner_(owner)
+        {
+            owner_.iteration_depth_++;
+        }
+
+        ~IterationScope()
+        {
+            UAVCAN_ASSERT(owner_.iteration_depth_ > 0);
+            owner_.iteration_depth_--;
+            if (owner_.iteration_depth_ == 0)
+            {
+                owner_.iteration_ts_ = MonotonicTime();
+            }
+        }
+    };
+
     Dispatcher(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock, IOutgoingTransferRegistry& otr)
         : canio_(driver, allocator, sysclock)
         , sysclock_(sysclock)
         , outgoing_transfer_reg_(otr)
+        , message_dtid_mask_(0)
 #if !UAVCAN_TINY
         , rx_listener_(NULL)
+        , promiscuous_listener_(NULL)
+        , listener_registry_observer_(NULL)
+        , num_rejected_rx_frames_(0)
+        , num_prefiltered_rx_frames_(0)
 #endif
+        , frame_handling_time_counter_(NULL)
+        , iteration_depth_(0)
         , self_node_id_(NodeID::Broadcast)  // Default
         , self_node_id_is_set_(false)
+        , cleanup_stage_(0)
     { }
 
     /**
@@ -150,9 +328,33 @@ public:
     int spin(MonotonicTime deadline);
 
     /**
-     * This version does not return until all available frames are processed.
+     * This version does not return until all available frames are processed, or until the specified number of
+     * frames, including the loopback frames, has been received, if it's not zero. Never blocks.
      */
-    int spinOnce();
+    int spinOnce(unsigned max_frames = 0);
+
+    /**
+     * This version returns as soon as one batch of frames is processed, or when the deadline is reached.
+     * It allows the caller to reconsider the deadline after every batch.
+     */
+    int spinBatch(MonotonicTime deadline);
+
+    /**
+     * Processes up to max_frames frames, including the loopback frames, which must be positive.
+     * Waits until the deadline only for the first frame, so that it never blocks if the deadline is zero, and returns
+     * as soon as the budget is used up or no more frames are immediately available; hence the execution time is
+     * bounded by the budget even if the bus is saturated.
+     * Returns the number of processed frames (excluding the loopback ones), or negative error code.
+     */
+    int spinBudget(unsigned max_frames, MonotonicTime deadline);
+
+    /**
+     * Frames of transfers with this priority or higher (i.e. numerically lower or equal) are sent with
+     * @ref CanIOFlagEmergency, see @ref CanEmergencyTxLane. Pass a default constructed (invalid) priority to disable,
+     * which is the default; individual publishers can still set the flag via their transfer sender.
+     */
+    void setEmergencyPriorityThreshold(TransferPriority priority) { emergency_priority_threshold_ = priority; }
+    TransferPriority getEmergencyPriorityThreshold() const { return emergency_priority_threshold_; }
 
     /**
      * Refer to CanIOManager::send() for the parameter description
@@ -160,8 +362,33 @@ public:
     int send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline, CanTxQueue::Qos qos,
              CanIOFlags flags, uint8_t iface_mask);
 
+    /**
+     * Sends a frame that was compiled by the caller, refer to Frame::compile().
+     * The caller must make sure that the Source Node ID of the frame matches the local Node ID.
+     */
+    int send(const CanFrame& can_frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+             CanTxQueue::Qos qos, CanIOFlags flags, uint8_t iface_mask)
+    {
+        if ((flags & CanIOFlagLoopback) && !isLoopbackNeeded(can_frame))
+        {
+            flags = CanIOFlags(flags & ~CanIOFlagLoopback);     // Nobody is going to use it, spare the driver
+        }
+        const int res = canio_.send(can_frame, tx_deadline, blocking_deadline, iface_mask, qos, flags);
+        updateIterationTimestamp();
+        return res;
+    }
+
     void cleanup(MonotonicTime ts);
 
+    /**
+     * Same as @ref cleanup(), but the work is split between many calls, so that the execution time of every call
+     * stays bounded regardless of the number of listeners. Every call cleans up at most max_listeners transfer
+     * listeners, where the outgoing transfer registry counts as one listener, continuing from where the previous
+     * call stopped. Zero means no limit.
+     * Returns true once a complete pass is finished; the next call will start a new pass.
+     */
+    bool cleanupIncrementally(MonotonicTime ts, unsigned max_listeners);
+
     bool registerMessageListener(TransferListenerBase* listener);
     bool registerServiceRequestListener(TransferListenerBase* listener);
     bool registerServiceResponseListener(TransferListenerBase* listener);
@@ -185,15 +412,15 @@ public:
      * removed from this list as soon as the corresponding service call is complete.
      * @{
      */
-    const LinkedListRoot<TransferListenerBase>& getListOfMessageListeners() const
+    const FastRemovalLinkedList<TransferListenerBase>::Root& getListOfMessageListeners() const
     {
         return lmsg_.getList();
     }
-    const LinkedListRoot<TransferListenerBase>& getListOfServiceRequestListeners() const
+    const FastRemovalLinkedList<TransferListenerBase>::Root& getListOfServiceRequestListeners() const
     {
         return lsrv_req_.getList();
     }
-    const LinkedListRoot<TransferListenerBase>& getListOfServiceResponseListeners() const
+    const FastRemovalLinkedList<TransferListenerBase>::Root& getListOfServiceResponseListeners() const
     {
         return lsrv_resp_.getList();
     }
@@ -206,13 +433,81 @@ public:
 #if !UAVCAN_TINY
     LoopbackFrameListenerRegistry& getLoopbackFrameListenerRegistry() { return loopback_listeners_; }
 
+    /**
+     * The RX frame listener needs every frame on the bus, so the listener registry observer is notified when
+     * it is installed or removed, same as when the set of transfer listeners changes.
+     */
     IRxFrameListener* getRxFrameListener() const { return rx_listener_; }
-    void removeRxFrameListener() { rx_listener_ = NULL; }
+    void removeRxFrameListener()
+    {
+        rx_listener_ = NULL;
+        notifyListenerRegistryObserver();
+    }
     void installRxFrameListener(IRxFrameListener* listener)
     {
         UAVCAN_ASSERT(listener != NULL);
         rx_listener_ = listener;
+        notifyListenerRegistryObserver();
+    }
+
+    /**
+     * Refer to @ref PromiscuousTransferListenerBase. Same as the RX frame listener, it needs every frame on the
+     * bus, so the listener registry observer is notified when it is installed or removed.
+     * The listener must be removed before it is destroyed.
+     */
+    PromiscuousTransferListenerBase* getPromiscuousTransferListener() const { return promiscuous_listener_; }
+    void removePromiscuousTransferListener()
+    {
+        promiscuous_listener_ = NULL;
+        notifyListenerRegistryObserver();
     }
+    void installPromiscuousTransferListener(PromiscuousTransferListenerBase* listener)
+    {
+        UAVCAN_ASSERT(listener != NULL);
+        promiscuous_listener_ = listener;
+        notifyListenerRegistryObserver();
+    }
+
+    IListenerRegistryObserver* getListenerRegistryObserver() const { return listener_registry_observer_; }
+    void removeListenerRegistryObserver() { listener_registry_observer_ = NULL; }
+    void installListenerRegistryObserver(IListenerRegistryObserver* observer)
+    {
+        UAVCAN_ASSERT(observer != NULL);
+        listener_registry_observer_ = observer;
+    }
+
+    /**
+     * Refer to @ref IExternalTxSource. The source must be removed before it is destroyed.
+     */
+    IExternalTxSource* getExternalTxSource() const { return canio_.getExternalTxSource(); }
+    void removeExternalTxSource() { canio_.removeExternalTxSource(); }
+    void installExternalTxSource(IExternalTxSource* source)
+    {
+        UAVCAN_ASSERT(source != NULL);
+        canio_.installExternalTxSource(source);
+    }
+
+    /**
+     * Number of received frames that were accepted by the hardware acceptance filters, but discarded by the
+     * dispatcher because they were malformed, addressed to another node, or had no listeners.
+     * Frames that were rejected by the hardware are not visible to the library, so they are not counted.
+     * Refer to @ref CanAcceptanceFilterConfigurator.
+     */
+    uint64_t getNumRejectedRxFrames() const { return num_rejected_rx_frames_; }
+
+    /**
+     * Part of @ref getNumRejectedRxFrames() that was discarded by the software filter based on the CAN ID alone,
+     * without parsing the frame: service frames addressed to other nodes and most of the message frames that
+     * have no listeners. A large value here means that the hardware acceptance filters could do a better job.
+     */
+    uint64_t getNumSoftwareFilteredRxFrames() const { return num_prefiltered_rx_frames_; }
+
+    /**
+     * Per data type transport statistics; this allows to find out which data types load the node the most.
+     * Empty if the statistics are disabled, refer to UAVCAN_DATA_TYPE_STATS_SIZE.
+     */
+    const DataTypeStatsTable& getDataTypeStatsTable() const { return data_type_stats_; }
+    DataTypeStatsTable& getDataTypeStatsTable() { return data_type_stats_; }
 #endif
 
     /**
@@ -230,11 +525,43 @@ public:
     const ISystemClock& getSystemClock() const { return sysclock_; }
     ISystemClock& getSystemClock() { return sysclock_; }
 
+    /**
+     * Within a spin iteration, returns the timestamp that was taken when the last IO call returned, so that
+     * the TX/RX path, the publishers and the scheduler share one clock read per iteration. Outside of a spin,
+     * or if fresh is true, the clock is read directly.
+     * The cached value may lag behind the real time by the frame handling time, which is fine for transmission
+     * deadlines and timeouts; the callers that need precise time (e.g. time synchronization) must request a
+     * fresh reading.
+     */
+    MonotonicTime getMonotonicTime(bool fresh = false) const
+    {
+        return (fresh || iteration_ts_.isZero()) ? sysclock_.getMonotonic() : iteration_ts_;
+    }
+
+    /**
+     * Updates the cached timestamp of the current spin iteration; ignored outside of an @ref IterationScope.
+     */
+    void setIterationTimestamp(MonotonicTime ts)
+    {
+        if (iteration_depth_ > 0)
+        {
+            iteration_ts_ = ts;
+        }
+    }
+
     const CanIOManager& getCanIOManager() const { return canio_; }
     CanIOManager& getCanIOManager() { return canio_; }
 
     const TransferPerfCounter& getTransferPerfCounter() const { return perf_; }
     TransferPerfCounter& getTransferPerfCounter() { return perf_; }
+
+    /**
+     * If set, the time spent handling every batch of received frames will be added to this counter.
+     * This costs two clock reads per batch. NULL disables the measurement, which is the default.
+     * Refer to @ref Scheduler::setLoadStatsEnabled().
+     */
+    void setFrameHandlingTimeCounter(ExecutionTimeCounter* counter) { frame_handling_time_counter_ = counter; }
+    ExecutionTimeCounter* getFrameHandlingTimeCounter() const { return frame_handling_time_counter_; }
 };
 
 }
@@ -16,7 +16,8 @@ namespace uavcan
 
 class UAVCAN_EXPORT Frame
 {
-    enum { PayloadCapacity = 7 };       // Will be redefined when CAN FD is available
+    enum { ClassicPayloadCapacity = CanFrame::MaxClassicDataLen - 1 };
+    enum { PayloadCapacity = CanFrame::MaxDataLen - 1 };
 
     uint8_t payload_[PayloadCapacity];
     TransferPriority transfer_priority_;
@@ -29,6 +30,9 @@ class UAVCAN_EXPORT Frame
     bool start_of_transfer_;
     bool end_of_transfer_;
     bool toggle_;
+#if UAVCAN_SUPPORT_CANFD
+    bool canfd_;
+#endif
 
 public:
     Frame() :
@@ -37,6 +41,9 @@ public:
         start_of_transfer_(false),
         end_of_transfer_(false),
         toggle_(false)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd_(false)
+#endif
     { }
 
     Frame(DataTypeID data_type_id,
@@ -54,6 +61,9 @@ public:
         start_of_transfer_(false),
         end_of_transfer_(false),
         toggle_(false)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd_(false)
+#endif
     {
         UAVCAN_ASSERT((transfer_type == TransferTypeMessageBroadcast) == dst_node_id.isBroadcast());
         UAVCAN_ASSERT(data_type_id.isValidForDataTypeKind(getDataTypeKindForTransferType(transfer_type)));
@@ -64,9 +74,17 @@ public:
     TransferPriority getPriority() const { return transfer_priority_; }
 
     /**
-     * Max payload length depends on the transfer type and frame index.
+     * Max payload length depends on the frame format: CAN FD frames carry up to 63 bytes, classic frames up to 7.
+     * The CAN FD format is always off if CAN FD is not supported, refer to UAVCAN_SUPPORT_CANFD.
      */
+#if UAVCAN_SUPPORT_CANFD
+    void setCanFD(bool x) { canfd_ = x; }
+    bool isCanFD() const { return canfd_; }
+    uint8_t getPayloadCapacity() const { return canfd_ ? uint8_t(PayloadCapacity) : uint8_t(ClassicPayloadCapacity); }
+#else
+    bool isCanFD() const { return false; }
     uint8_t getPayloadCapacity() const { return PayloadCapacity; }
+#endif
     uint8_t setPayload(const uint8_t* data, unsigned len);
 
     unsigned getPayloadLen() const { return payload_len_; }
@@ -90,6 +108,20 @@ public:
     bool parse(const CanFrame& can_frame);
     bool compile(CanFrame& can_frame) const;
 
+    /**
+     * CAN ID of this frame, excluding the discriminator of anonymous frames, which depends on the payload.
+     * It depends only on the priority, the transfer type, the data type ID and the node IDs, so it can be
+     * computed once and reused for all frames that share these fields.
+     */
+    uint32_t compileCanID() const;
+
+    /**
+     * Same as @ref compile(), but uses the CAN ID obtained from @ref compileCanID() for a frame with the
+     * same header fields; only the payload, the tail byte and the discriminator are computed.
+     * The caller is responsible for the validity of the frame.
+     */
+    bool compile(CanFrame& can_frame, uint32_t can_id) const;
+
     bool isValid() const;
 
     bool operator!=(const Frame& rhs) const { return !operator==(rhs); }
@@ -9,7 +9,10 @@
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/util/map.hpp>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/util/placement_new.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/data_type.hpp>
 #include <uavcan/transport/transfer.hpp>
 #include <uavcan/time.hpp>
 
@@ -42,6 +45,7 @@ public:
 
     DataTypeID getDataTypeID() const { return data_type_id_; }
     TransferType getTransferType() const { return TransferType(transfer_type_); }
+    NodeID getDestinationNodeID() const { return destination_node_id_; }
 
     bool operator==(const OutgoingTransferRegistryKey& rhs) const
     {
@@ -51,6 +55,22 @@ public:
             (destination_node_id_ == rhs.destination_node_id_);
     }
 
+    /**
+     * Ordering for the containers that keep the keys sorted, e.g. FlatMap<>.
+     */
+    bool operator<(const OutgoingTransferRegistryKey& rhs) const
+    {
+        if (data_type_id_ != rhs.data_type_id_)
+        {
+            return data_type_id_ < rhs.data_type_id_;
+        }
+        if (transfer_type_ != rhs.transfer_type_)
+        {
+            return transfer_type_ < rhs.transfer_type_;
+        }
+        return destination_node_id_ < rhs.destination_node_id_;
+    }
+
 #if UAVCAN_TOSTRING
     std::string toString() const;
 #endif
@@ -126,6 +146,11 @@ class UAVCAN_EXPORT OutgoingTransferRegistry : public IOutgoingTransferRegistry,
     Map<OutgoingTransferRegistryKey, Value, NumStaticEntries> map_;
 
 public:
+    /**
+     * Number of entries that share one memory pool block once the static entries are exhausted.
+     */
+    enum { NumEntriesPerPoolBlock = MapBase<OutgoingTransferRegistryKey, Value>::NumKVPerPoolBlock };
+
     explicit OutgoingTransferRegistry(IPoolAllocator& allocator)
         : map_(allocator)
     { }
@@ -137,6 +162,116 @@ public:
     virtual void cleanup(MonotonicTime ts);
 };
 
+/**
+ * Same as @ref OutgoingTransferRegistry, but the entries are indexed by a hash of the key, so the lookup time
+ * does not grow with the number of active (data type, transfer type, destination) triples. This is useful for
+ * nodes that send requests to many destinations, such as gateways.
+ *
+ * Each entry that doesn't fit the static storage occupies one memory pool block, whereas the plain registry
+ * packs several entries into one block; hence the plain registry is preferred for nodes with few entries.
+ *
+ * @tparam NumBuckets           Number of hash buckets, must be a power of two.
+ * @tparam NumStaticEntries     Number of entries allocated statically; the pool is used only when these run out.
+ */
+template <unsigned NumBuckets, unsigned NumStaticEntries = 0>
+class UAVCAN_EXPORT IndexedOutgoingTransferRegistry : public IOutgoingTransferRegistry, Noncopyable
+{
+    struct Entry : public LinkedListNode<Entry>
+    {
+        OutgoingTransferRegistryKey key;
+        MonotonicTime deadline;
+        TransferID tid;
+
+        void reset()
+        {
+            this->setNextListNode(NULL);
+            key = OutgoingTransferRegistryKey();
+            deadline = MonotonicTime();
+            tid = TransferID();
+        }
+    };
+
+    LinkedListRoot<Entry> buckets_[NumBuckets];
+    LinkedListRoot<Entry> free_static_entries_;
+    Entry static_entries_[NumStaticEntries + 1];        // One extra to avoid zero-length arrays
+    IPoolAllocator& allocator_;
+
+    static unsigned computeBucketIndex(const OutgoingTransferRegistryKey& key)
+    {
+        const unsigned hash = (unsigned(key.getDataTypeID().get()) * 31U + unsigned(key.getDestinationNodeID().get())) ^
+                              (unsigned(key.getTransferType()) << 3);
+        return hash & (NumBuckets - 1U);
+    }
+
+    bool isStatic(const Entry* entry) const
+    {
+        return (entry >= static_entries_) && (entry < (static_entries_ + NumStaticEntries));
+    }
+
+    Entry* allocate();
+    void destroy(Entry* entry);
+
+public:
+    enum { NumEntriesPerPoolBlock = 1 };
+
+    explicit IndexedOutgoingTransferRegistry(IPoolAllocator& allocator)
+        : allocator_(allocator)
+    {
+        StaticAssert<((NumBuckets > 0) && ((NumBuckets & (NumBuckets - 1U)) == 0))>::check();
+        IsDynamicallyAllocatable<Entry>::check();
+        for (unsigned i = 0; i < NumStaticEntries; i++)
+        {
+            free_static_entries_.insertAfter(NULL, static_entries_ + i);
+        }
+    }
+
+    virtual ~IndexedOutgoingTransferRegistry()
+    {
+        for (unsigned i = 0; i < NumBuckets; i++)
+        {
+            while (Entry* const entry = buckets_[i].get())
+            {
+                buckets_[i].remove(entry);
+                destroy(entry);
+            }
+        }
+    }
+
+    virtual TransferID* accessOrCreate(const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline);
+
+    virtual bool exists(DataTypeID dtid, TransferType tt) const;
+
+    virtual void cleanup(MonotonicTime ts);
+
+    /**
+     * Number of active entries, for testing purposes. O(N).
+     */
+    unsigned getNumEntries() const
+    {
+        unsigned num = 0;
+        for (unsigned i = 0; i < NumBuckets; i++)
+        {
+            num += buckets_[i].getLength();
+        }
+        return num;
+    }
+};
+
+/**
+ * Outgoing transfer registry of the node classes, refer to UAVCAN_OUTGOING_TRANSFER_REGISTRY_BUCKETS.
+ */
+template <unsigned NumStaticEntries, unsigned NumBuckets = UAVCAN_OUTGOING_TRANSFER_REGISTRY_BUCKETS>
+struct UAVCAN_EXPORT DefaultOutgoingTransferRegistry
+{
+    typedef IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries> Type;
+};
+
+template <unsigned NumStaticEntries>
+struct UAVCAN_EXPORT DefaultOutgoingTransferRegistry<NumStaticEntries, 0>
+{
+    typedef OutgoingTransferRegistry<int(NumStaticEntries)> Type;
+};
+
 // ----------------------------------------------------------------------------
 
 /*
@@ -173,6 +308,109 @@ void OutgoingTransferRegistry<NumStaticEntries>::cleanup(MonotonicTime ts)
     map_.removeAllWhere(DeadlineExpiredPredicate(ts));
 }
 
+/*
+ * IndexedOutgoingTransferRegistry<>
+ */
+template <unsigned NumBuckets, unsigned NumStaticEntries>
+typename IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries>::Entry*
+IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries>::allocate()
+{
+    Entry* entry = free_static_entries_.get();
+    if (entry != NULL)
+    {
+        free_static_entries_.remove(entry);
+        entry->reset();
+        return entry;
+    }
+    void* const praw = allocator_.allocate(sizeof(Entry));
+    if (praw == NULL)
+    {
+        return NULL;
+    }
+    return new (praw) Entry();
+}
+
+template <unsigned NumBuckets, unsigned NumStaticEntries>
+void IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries>::destroy(Entry* entry)
+{
+    UAVCAN_ASSERT(entry != NULL);
+    if (isStatic(entry))
+    {
+        free_static_entries_.insertAfter(NULL, entry);
+    }
+    else
+    {
+        entry->~Entry();
+        allocator_.deallocate(entry);
+    }
+}
+
+template <unsigned NumBuckets, unsigned NumStaticEntries>
+TransferID* IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries>::accessOrCreate(
+    const OutgoingTransferRegistryKey& key, MonotonicTime new_deadline)
+{
+    UAVCAN_ASSERT(!new_deadline.isZero());
+    LinkedListRoot<Entry>& bucket = buckets_[computeBucketIndex(key)];
+
+    Entry* p = bucket.get();
+    while ((p != NULL) && !(p->key == key))
+    {
+        p = p->getNextListNode();
+    }
+
+    if (p == NULL)
+    {
+        p = allocate();
+        if (p == NULL)
+        {
+            return NULL;
+        }
+        p->key = key;
+        bucket.insertAfter(NULL, p);
+        UAVCAN_TRACE("OutgoingTransferRegistry", "Created %s", key.toString().c_str());
+    }
+    p->deadline = new_deadline;
+    return &p->tid;
+}
+
+template <unsigned NumBuckets, unsigned NumStaticEntries>
+bool IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries>::exists(DataTypeID dtid, TransferType tt) const
+{
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        for (const Entry* p = buckets_[i].get(); p != NULL; p = p->getNextListNode())
+        {
+            if ((p->key.getDataTypeID() == dtid) && (p->key.getTransferType() == tt))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+template <unsigned NumBuckets, unsigned NumStaticEntries>
+void IndexedOutgoingTransferRegistry<NumBuckets, NumStaticEntries>::cleanup(MonotonicTime ts)
+{
+    for (unsigned i = 0; i < NumBuckets; i++)
+    {
+        Entry* p = buckets_[i].get();
+        while (p != NULL)
+        {
+            Entry* const next = p->getNextListNode();
+            UAVCAN_ASSERT(!p->deadline.isZero());
+            if (p->deadline <= ts)
+            {
+                UAVCAN_TRACE("OutgoingTransferRegistry", "Expired %s tid=%i",
+                             p->key.toString().c_str(), int(p->tid.get()));
+                buckets_[i].remove(p);
+                destroy(p);
+            }
+            p = next;
+        }
+    }
+}
+
 }
 
 #endif // UAVCAN_TRANSPORT_OUTGOING_TRANSFER_REGISTRY_HPP_INCLUDED
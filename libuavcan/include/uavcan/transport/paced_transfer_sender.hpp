@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_PACED_TRANSFER_SENDER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_PACED_TRANSFER_SENDER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/transport/transfer_sender.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+/**
+ * Sends a multi frame transfer without putting all of its frames into the TX queue at once.
+ *
+ * @ref TransferSender::send() queues every frame of the transfer immediately, so that a long transfer takes
+ * one TX queue block per frame until it is transmitted. This class queues only a window of frames; the next
+ * frames are generated as the earlier ones are reported transmitted via the loopback (@ref CanIOFlagLoopback),
+ * so that the TX queue memory used by the transfer doesn't depend on its length. The window advances when the
+ * frame has been transmitted on all interfaces enabled by the sender's interface mask.
+ *
+ * The payload is not copied; it must remain valid until the transfer is no longer in progress. One transfer
+ * at a time can be sent. The configuration of the underlying sender must not be changed while the transfer
+ * is in progress.
+ *
+ * If an interface is not able to transmit the frames, the transfer stalls and fails once the TX deadline is
+ * reached, as all of its remaining frames would have expired in the TX queue anyway.
+ */
+class UAVCAN_EXPORT PacedTransferSender : LoopbackFrameListenerBase
+{
+public:
+    enum Status
+    {
+        StatusIdle,
+        StatusInProgress,
+        StatusDone,             ///< All frames were transmitted on all interfaces
+        StatusFailed            ///< Failed to queue a frame, timed out, or cancelled
+    };
+
+    enum { DefaultWindowSize = 4 };
+
+private:
+    TransferSender& sender_;
+    const uint8_t* payload_;
+    Frame frame_;                                       ///< Next frame to be sent
+    MonotonicTime tx_deadline_;
+    uint32_t can_id_;
+    unsigned payload_len_;
+    unsigned offset_;                                   ///< Number of payload bytes written into the frames
+    uint16_t num_frames_sent_;
+    uint16_t num_frames_transmitted_[MaxCanIfaces];     ///< Per interface, as reported via the loopback
+    uint8_t iface_mask_;
+    const uint8_t window_size_;
+    bool all_frames_sent_;
+    Status status_;
+
+    uint16_t getMinNumFramesTransmitted() const;
+
+    int sendFrames();
+
+    void finish(Status status);
+
+    virtual void handleLoopbackFrame(const RxFrame& frame);
+
+public:
+    explicit PacedTransferSender(TransferSender& sender, uint8_t window_size = DefaultWindowSize);
+
+    virtual ~PacedTransferSender() { }
+
+    /**
+     * Sends the first window of frames; a single frame transfer is sent right away.
+     * Returns negative error code.
+     */
+    int start(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+              TransferType transfer_type, NodeID dst_node_id, TransferID tid);
+
+    /**
+     * Same as above, but the Transfer ID is managed by the outgoing transfer registry.
+     */
+    int start(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+              TransferType transfer_type, NodeID dst_node_id);
+
+    /**
+     * Stops generating the frames; the frames that are already queued will be transmitted.
+     * The receivers will discard the incomplete transfer.
+     */
+    void cancel();
+
+    /**
+     * A transfer that didn't complete before its TX deadline is reported as failed.
+     */
+    Status getStatus() const;
+
+    bool isInProgress() const { return getStatus() == StatusInProgress; }
+
+    unsigned getNumFramesSent() const { return num_frames_sent_; }
+
+    uint8_t getWindowSize() const { return window_size_; }
+};
+#endif
+
+}
+
+#endif // UAVCAN_TRANSPORT_PACED_TRANSFER_SENDER_HPP_INCLUDED
@@ -7,6 +7,7 @@
 
 #include <uavcan/std.hpp>
 #include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
 
 namespace uavcan
 {
@@ -57,6 +58,37 @@ public:
 
 #endif
 
+/**
+ * Accumulated and peak execution time of a recurring activity, e.g. handling of a callback.
+ */
+class UAVCAN_EXPORT ExecutionTimeCounter
+{
+    MonotonicDuration total_;
+    MonotonicDuration peak_;
+    uint32_t count_;
+
+public:
+    ExecutionTimeCounter()
+        : count_(0)
+    { }
+
+    void add(MonotonicDuration duration)
+    {
+        total_ += duration;
+        peak_ = max(peak_, duration);
+        count_++;
+    }
+
+    MonotonicDuration getTotal() const { return total_; }
+    MonotonicDuration getPeak() const { return peak_; }
+    uint32_t getCount() const { return count_; }
+
+    MonotonicDuration getAverage() const
+    {
+        return (count_ > 0) ? MonotonicDuration::fromUSec(total_.toUSec() / count_) : MonotonicDuration();
+    }
+};
+
 }
 
 #endif // UAVCAN_TRANSPORT_PERF_COUNTER_HPP_INCLUDED
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_TRANSPORT_PROMISCUOUS_TRANSFER_LISTENER_HPP_INCLUDED
+#define UAVCAN_TRANSPORT_PROMISCUOUS_TRANSFER_LISTENER_HPP_INCLUDED
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/transport/frame.hpp>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+/**
+ * Raw transfer reassembled by @ref PromiscuousTransferListenerBase.
+ * Besides the usual metadata, it carries the fields that are implied by the data type for regular transfers.
+ */
+class UAVCAN_EXPORT PromiscuousIncomingTransfer : public IncomingTransfer
+{
+    const uint8_t* const payload_;
+    const unsigned payload_len_;
+    const MonotonicTime last_frame_ts_mono_;
+    const DataTypeID data_type_id_;
+    const NodeID dst_node_id_;
+    const uint16_t transfer_crc_;
+    const bool multi_frame_;
+
+public:
+    PromiscuousIncomingTransfer(MonotonicTime ts_mono, UtcTime ts_utc, const RxFrame& last_frame,
+                                const uint8_t* payload, unsigned payload_len, uint16_t transfer_crc,
+                                bool multi_frame);
+
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
+    virtual bool isAnonymousTransfer() const;
+    virtual MonotonicTime getLastFrameMonotonicTimestamp() const { return last_frame_ts_mono_; }
+
+    DataTypeID getDataTypeID() const { return data_type_id_; }
+
+    /// Broadcast for messages
+    NodeID getDstNodeID() const { return dst_node_id_; }
+
+    bool isMultiFrame() const { return multi_frame_; }
+
+    /**
+     * Transfer CRC as received in the first frame; zero for single frame transfers.
+     * It is not verified, because the CRC is seeded with the data type signature, which is not known to the
+     * listener. It can be verified by the application once the data type is identified.
+     */
+    uint16_t getTransferCRC() const { return transfer_crc_; }
+};
+
+/**
+ * Reassembles all transfers on the bus regardless of their data type, source and destination, so that a bus
+ * analyzer doesn't need to register a subscriber per data type.
+ * Install it with Dispatcher::installPromiscuousTransferListener(); the dispatcher feeds it every valid received
+ * frame before any filtering, and the hardware acceptance filters are opened, refer to
+ * @ref CanAcceptanceFilterConfigurator. Frames transmitted by the local node are not delivered.
+ *
+ * Single frame transfers are delivered right away and don't need any state. Every multi frame transfer in
+ * progress occupies one reassembly slot; the number of slots and the slot size are fixed by the derived class,
+ * so the memory footprint is bounded and no dynamic memory is used. A slot that didn't receive a frame within
+ * the transfer timeout can be reused by a new transfer; if all slots are busy, the new transfer is dropped.
+ * Transfers that don't fit the slot are dropped as well.
+ *
+ * Copies of the same transfer received via redundant interfaces are delivered separately; use
+ * IncomingTransfer::getIfaceIndex() to tell them apart.
+ *
+ * The cost is O(number of slots) per received frame of a multi frame transfer.
+ */
+class UAVCAN_EXPORT PromiscuousTransferListenerBase : Noncopyable
+{
+public:
+    struct Slot
+    {
+        MonotonicTime ts_mono;          ///< First frame
+        UtcTime ts_utc;
+        MonotonicTime last_frame_ts_mono;
+        uint16_t payload_len;
+        uint16_t transfer_crc;
+        DataTypeID data_type_id;
+        TransferType transfer_type;
+        NodeID src_node_id;
+        NodeID dst_node_id;
+        TransferID transfer_id;
+        uint8_t iface_index;
+        bool next_toggle;
+        bool active;
+
+        Slot()
+            : payload_len(0)
+            , transfer_crc(0)
+            , transfer_type(TransferTypeMessageBroadcast)
+            , iface_index(0)
+            , next_toggle(false)
+            , active(false)
+        { }
+
+        bool match(const RxFrame& frame) const;
+    };
+
+    static MonotonicDuration getDefaultTransferTimeout()
+    {
+        return MonotonicDuration::fromMSec(TransferReceiver::DefaultTidTimeoutMSec);
+    }
+
+private:
+    Slot* const slots_;
+    uint8_t* const buffers_;
+    const uint16_t num_slots_;
+    const uint16_t max_payload_len_;
+    MonotonicDuration transfer_timeout_;
+    uint32_t num_dropped_transfers_;
+    uint32_t num_errors_;
+
+    uint8_t* getBuffer(const Slot& slot) const
+    {
+        return buffers_ + unsigned(&slot - slots_) * max_payload_len_;
+    }
+
+    Slot* findSlot(const RxFrame& frame);
+    Slot* allocateSlot(MonotonicTime ts);
+
+    void handleStartOfTransfer(const RxFrame& frame);
+    void handleContinuation(Slot& slot, const RxFrame& frame);
+
+protected:
+    /**
+     * @param slots             Array of num_slots elements.
+     * @param buffers           Storage of num_slots * max_payload_len bytes.
+     */
+    PromiscuousTransferListenerBase(Slot* slots, uint8_t* buffers, uint16_t num_slots, uint16_t max_payload_len)
+        : slots_(slots)
+        , buffers_(buffers)
+        , num_slots_(num_slots)
+        , max_payload_len_(max_payload_len)
+        , transfer_timeout_(getDefaultTransferTimeout())
+        , num_dropped_transfers_(0)
+        , num_errors_(0)
+    {
+        UAVCAN_ASSERT((slots != NULL) && (buffers != NULL));
+    }
+
+    /**
+     * The transfer object and its payload are valid only within the call.
+     */
+    virtual void handleIncomingTransfer(PromiscuousIncomingTransfer& transfer) = 0;
+
+public:
+    virtual ~PromiscuousTransferListenerBase() { }
+
+    /**
+     * Invoked by the dispatcher for every valid received frame.
+     */
+    void handleFrame(const RxFrame& frame);
+
+    /**
+     * Discards all transfers in progress.
+     */
+    void reset();
+
+    /**
+     * Incomplete transfer that didn't receive a frame for this long may be evicted by a new transfer.
+     */
+    MonotonicDuration getTransferTimeout() const { return transfer_timeout_; }
+    void setTransferTimeout(MonotonicDuration x) { transfer_timeout_ = x; }
+
+    unsigned getNumSlots() const { return num_slots_; }
+    unsigned getMaxPayloadLen() const { return max_payload_len_; }
+    unsigned getNumTransfersInProgress() const;
+
+    /**
+     * Transfers that were dropped because no slot was available, or because they were too long.
+     */
+    uint32_t getNumDroppedTransfers() const { return num_dropped_transfers_; }
+
+    /**
+     * Incomplete transfers that were discarded due to a missing or unexpected frame.
+     */
+    uint32_t getNumErrors() const { return num_errors_; }
+};
+
+/**
+ * Provides the storage for @ref PromiscuousTransferListenerBase.
+ * @tparam NumSlots         Max number of multi frame transfers being reassembled concurrently.
+ * @tparam MaxPayloadLen    Max payload length of a multi frame transfer, excluding the transfer CRC.
+ */
+template <unsigned NumSlots, unsigned MaxPayloadLen>
+class UAVCAN_EXPORT PromiscuousTransferListener : public PromiscuousTransferListenerBase
+{
+    Slot slot_storage_[NumSlots];
+    uint8_t buffer_storage_[NumSlots * MaxPayloadLen];
+
+protected:
+    PromiscuousTransferListener()
+        : PromiscuousTransferListenerBase(slot_storage_, buffer_storage_, uint16_t(NumSlots),
+                                          uint16_t(MaxPayloadLen))
+    {
+        StaticAssert<(NumSlots > 0) && (NumSlots <= 0xFFFF)>::check();
+        StaticAssert<(MaxPayloadLen > 0) && (MaxPayloadLen <= 0xFFFF)>::check();
+    }
+};
+#endif
+
+}
+
+#endif // UAVCAN_TRANSPORT_PROMISCUOUS_TRANSFER_LISTENER_HPP_INCLUDED
@@ -83,7 +83,11 @@ public:
 /**
  * Resizable gather/scatter storage.
  * reset() call releases all memory blocks.
- * Supports unordered write operations - from higher to lower offsets
+ * Supports unordered write operations - from higher to lower offsets.
+ * The block that was accessed last is cached, so that sequential reads and writes don't need to walk the chain
+ * from the head every time.
+ * If UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS is enabled, the buffer will attempt to allocate the rest of its capacity
+ * as one contiguous span before falling back to regular pool blocks; see build_config.hpp.
  */
 class UAVCAN_EXPORT DynamicTransferBufferManagerEntry
     : public TransferBufferManagerEntry
@@ -91,22 +95,38 @@ class UAVCAN_EXPORT DynamicTransferBufferManagerEntry
 {
     struct Block : LinkedListNode<Block>
     {
+#if UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+        uint16_t capacity;
+        enum { Size = MemPoolBlockSize - sizeof(LinkedListNode<Block>) - sizeof(uint16_t) };
+#else
         enum { Size = MemPoolBlockSize - sizeof(LinkedListNode<Block>) };
+#endif
         uint8_t data[static_cast<unsigned>(Size)];
 
-        static Block* instantiate(IPoolAllocator& allocator);
+        static Block* instantiate(IPoolAllocator& allocator, unsigned desired_capacity);
         static void destroy(Block*& obj, IPoolAllocator& allocator);
 
-        void read(uint8_t*& outptr, unsigned target_offset,
-                  unsigned& total_offset, unsigned& left_to_read);
-        void write(const uint8_t*& inptr, unsigned target_offset,
-                   unsigned& total_offset, unsigned& left_to_write);
+#if UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+        unsigned getCapacity() const { return capacity; }
+#else
+        unsigned getCapacity() const { return unsigned(Size); }
+#endif
     };
 
     IPoolAllocator& allocator_;
     LinkedListRoot<Block> blocks_;    // Blocks are ordered from lower to higher buffer offset
+    mutable Block* cursor_;           // Last accessed block
+    mutable uint16_t cursor_offset_;  // Buffer offset of the first byte of the last accessed block
     uint16_t max_write_pos_;
     const uint16_t max_size_;
+    bool written_;                    // Set on every write, see fetchWrittenFlag()
+
+    /**
+     * Returns the block that contains the specified offset, and the offset of its first byte.
+     * If the offset is beyond the allocated blocks, returns NULL; the cursor will point to the last block then,
+     * and the output offset will be the total capacity of the allocated blocks.
+     */
+    Block* findBlock(unsigned offset, unsigned& out_block_offset) const;
 
     /// Reset functionality must be implemented in a non-virtual method to call it safely from the destructor.
     void doReset();
@@ -114,10 +134,18 @@ class UAVCAN_EXPORT DynamicTransferBufferManagerEntry
     virtual void resetImpl();
 
 public:
+    /**
+     * Number of payload bytes stored in one memory pool block; the entry itself takes one more block.
+     */
+    enum { NumBytesPerPoolBlock = Block::Size };
+
     DynamicTransferBufferManagerEntry(IPoolAllocator& allocator, uint16_t max_size)
         : allocator_(allocator)
+        , cursor_(NULL)
+        , cursor_offset_(0)
         , max_write_pos_(0)
         , max_size_(max_size)
+        , written_(false)
     {
         StaticAssert<(Block::Size > 8)>::check();
         IsDynamicallyAllocatable<Block>::check();
@@ -134,6 +162,18 @@ public:
 
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
     virtual int write(unsigned offset, const uint8_t* data, unsigned len);
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
+
+    /**
+     * Returns true if the buffer has been written since the previous call.
+     * The buffer manager uses this to tell the idle buffers from the ones that are being filled.
+     */
+    bool fetchWrittenFlag()
+    {
+        const bool res = written_;
+        written_ = false;
+        return res;
+    }
 };
 
 /**
@@ -154,6 +194,7 @@ public:
 
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
     virtual int write(unsigned offset, const uint8_t* data, unsigned len);
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
 
     void reset();
 
@@ -194,8 +235,13 @@ public:
 
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
     virtual int write(unsigned offset, const uint8_t* data, unsigned len);
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
 
-    bool migrateFrom(const TransferBufferManagerEntry* tbme);
+    /**
+     * Moves the key and the data of the specified entry into this one; the source entry is not modified.
+     * @return Number of bytes copied, or negative error code; this entry remains empty on failure.
+     */
+    int migrateFrom(const TransferBufferManagerEntry* tbme);
 };
 
 template <uint16_t Size>
@@ -246,9 +292,26 @@ public:
  */
 class TransferBufferManagerImpl : public ITransferBufferManager, Noncopyable
 {
+public:
+    /**
+     * What to do with the dynamic buffers when a static buffer is released.
+     * Migration of a dynamic buffer into the static one releases the pool blocks early, but it copies all the data
+     * that have been received so far; under heavy multi-frame traffic this happens on almost every transfer.
+     */
+    enum MigrationPolicy
+    {
+        MigrateAlways,      ///< Default, minimizes the use of the memory pool
+        MigrateIdleOnly,    ///< Only the buffers that were not written since the previous release of a static buffer
+        MigrateNever        ///< Dynamic buffers stay in the pool until they are removed
+    };
+
+private:
     LinkedListRoot<DynamicTransferBufferManagerEntry> dynamic_buffers_;
     IPoolAllocator& allocator_;
     const uint16_t max_buf_size_;
+    MigrationPolicy migration_policy_;
+    uint32_t num_migrations_;
+    uint32_t num_migrated_bytes_;
 
     virtual StaticTransferBufferManagerEntryImpl* getStaticByIndex(uint16_t index) const = 0;
 
@@ -260,6 +323,9 @@ public:
     TransferBufferManagerImpl(uint16_t max_buf_size, IPoolAllocator& allocator)
         : allocator_(allocator)
         , max_buf_size_(max_buf_size)
+        , migration_policy_(MigrateAlways)
+        , num_migrations_(0)
+        , num_migrated_bytes_(0)
     { }
 
     virtual ~TransferBufferManagerImpl();
@@ -271,6 +337,15 @@ public:
 
     unsigned getNumDynamicBuffers() const;
     unsigned getNumStaticBuffers() const;
+
+    void setMigrationPolicy(MigrationPolicy policy) { migration_policy_ = policy; }
+    MigrationPolicy getMigrationPolicy() const { return migration_policy_; }
+
+    /**
+     * Number of dynamic buffers that have been moved into static buffers, and the number of bytes copied.
+     */
+    uint32_t getNumMigrations() const { return num_migrations_; }
+    uint32_t getNumMigratedBytes() const { return num_migrated_bytes_; }
 };
 
 template <uint16_t MaxBufSize, uint8_t NumStaticBufs>
@@ -10,8 +10,11 @@
 #include <uavcan/std.hpp>
 #include <uavcan/transport/transfer_receiver.hpp>
 #include <uavcan/transport/perf_counter.hpp>
+#include <uavcan/transport/data_type_stats.hpp>
+#include <uavcan/driver/system_clock.hpp>
 #include <uavcan/util/linked_list.hpp>
 #include <uavcan/util/map.hpp>
+#include <uavcan/util/placement_new.hpp>
 #include <uavcan/debug.hpp>
 #include <uavcan/transport/crc.hpp>
 #include <uavcan/data_type.hpp>
@@ -30,6 +33,9 @@ class UAVCAN_EXPORT IncomingTransfer : public ITransferBuffer
     TransferID transfer_id_;
     NodeID src_node_id_;
     uint8_t iface_index_;
+#if UAVCAN_SUPPORT_CANFD
+    bool canfd_;
+#endif
 
     /// That's a no-op, asserts in debug builds
     virtual int write(unsigned offset, const uint8_t* data, unsigned len);
@@ -45,8 +51,15 @@ protected:
         , transfer_id_(transfer_id)
         , src_node_id_(source_node_id)
         , iface_index_(iface_index)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd_(false)
+#endif
     { }
 
+#if UAVCAN_SUPPORT_CANFD
+    void setCanFD(bool x) { canfd_ = x; }
+#endif
+
 public:
     /**
      * Dispose the payload buffer. Further calls to read() will not be possible.
@@ -58,6 +71,12 @@ public:
      */
     virtual bool isAnonymousTransfer() const { return false; }
 
+    /**
+     * Reception time of the last frame of the transfer, whereas @ref getMonotonicTimestamp() returns the
+     * reception time of the first one. Both are the same for single frame transfers.
+     */
+    virtual MonotonicTime getLastFrameMonotonicTimestamp() const { return ts_mono_; }
+
     MonotonicTime getMonotonicTimestamp() const { return ts_mono_; }
     UtcTime getUtcTimestamp()             const { return ts_utc_; }
     TransferPriority getPriority()        const { return transfer_priority_; }
@@ -65,6 +84,16 @@ public:
     TransferID getTransferID()            const { return transfer_id_; }
     NodeID getSrcNodeID()                 const { return src_node_id_; }
     uint8_t getIfaceIndex()               const { return iface_index_; }
+
+    /**
+     * Whether the transfer was received in CAN FD frames; such transfers are encoded with the tail array
+     * optimization disabled. Always false if CAN FD is not supported.
+     */
+#if UAVCAN_SUPPORT_CANFD
+    bool isCanFD()                        const { return canfd_; }
+#else
+    bool isCanFD()                        const { return false; }
+#endif
 };
 
 /**
@@ -77,6 +106,7 @@ class UAVCAN_EXPORT SingleFrameIncomingTransfer : public IncomingTransfer
 public:
     explicit SingleFrameIncomingTransfer(const RxFrame& frm);
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
     virtual bool isAnonymousTransfer() const;
 };
 
@@ -86,51 +116,223 @@ public:
 class UAVCAN_EXPORT MultiFrameIncomingTransfer : public IncomingTransfer, Noncopyable
 {
     TransferBufferAccessor& buf_acc_;
+    const MonotonicTime last_frame_ts_mono_;
 public:
     MultiFrameIncomingTransfer(MonotonicTime ts_mono, UtcTime ts_utc, const RxFrame& last_frame,
                                TransferBufferAccessor& tba);
     virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
     virtual void release() { buf_acc_.remove(); }
+    virtual MonotonicTime getLastFrameMonotonicTimestamp() const { return last_frame_ts_mono_; }
+};
+
+/**
+ * Allows to discard the unwanted transfers by the beginning of their payload, e.g. by the instance index that is
+ * usually the first field of the data structure, before the multi-frame transfers are reassembled and before any
+ * transfer is decoded; refer to TransferListenerBase::setTransferPrefilter().
+ */
+class UAVCAN_EXPORT ITransferPrefilter
+{
+public:
+    virtual ~ITransferPrefilter() { }
+
+    /**
+     * Invoked once per transfer, when its first frame is received.
+     * @param payload       Beginning of the serialized data structure, that is, the payload of the first frame
+     *                      without the transfer CRC.
+     * @param payload_len   Number of bytes available; may be less than the size of the data structure.
+     * @param src_node_id   Source Node ID; broadcast for anonymous transfers.
+     * @return              False to discard the transfer.
+     */
+    virtual bool acceptTransfer(const uint8_t* payload, unsigned payload_len, NodeID src_node_id) = 0;
+};
+
+#if !UAVCAN_TINY
+
+/**
+ * Copy of a received transfer that outlives the reception; refer to @ref ITransferHandoff.
+ * The payload storage is owned by the caller and must remain valid while this object is used.
+ */
+class UAVCAN_EXPORT DeferredIncomingTransfer : public IncomingTransfer
+{
+    const uint8_t* const payload_;
+    const unsigned payload_len_;
+    const MonotonicTime last_frame_ts_mono_;
+    const bool anonymous_;
+public:
+    DeferredIncomingTransfer(const IncomingTransfer& origin, const uint8_t* payload, unsigned payload_len);
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const;
+    virtual unsigned getContiguousSpan(unsigned offset, const uint8_t*& out_data) const;
+    virtual bool isAnonymousTransfer() const { return anonymous_; }
+    virtual MonotonicTime getLastFrameMonotonicTimestamp() const { return last_frame_ts_mono_; }
+};
+
+/**
+ * Outcome of the processing of a deferred transfer. The counters of the node are not thread-safe, so the thread
+ * that processes the deferred transfers records the outcome here, and the thread that spins the node accounts it
+ * later via TransferListenerBase::commitDeferredTransfer().
+ */
+struct UAVCAN_EXPORT DeferredTransferResult
+{
+    MonotonicDuration callback_duration;    ///< Zero if the data type statistics are disabled
+    MonotonicDuration rx_latency;           ///< Negative if the handler did not report it
+    bool failed;                            ///< The transfer could not be processed, e.g. decoding failed
+
+    DeferredTransferResult()
+        : rx_latency(MonotonicDuration::fromUSec(-1))
+        , failed(false)
+    { }
+};
+
+class UAVCAN_EXPORT TransferListenerBase;
+
+/**
+ * Allows to process the received transfers outside of the dispatcher, e.g. in a worker thread, so that slow
+ * callbacks do not delay the reception; refer to TransferListenerBase::setTransferHandoff().
+ * The transfer object is valid only during the call, so the implementation must copy the payload out (see
+ * @ref DeferredIncomingTransfer) and pass the copy to TransferListenerBase::handleDeferredTransfer() later.
+ */
+class UAVCAN_EXPORT ITransferHandoff
+{
+public:
+    virtual ~ITransferHandoff() { }
+
+    /**
+     * Returns false if the transfer could not be accepted; in this case it will be dropped and counted as error.
+     */
+    virtual bool handOff(TransferListenerBase& listener, IncomingTransfer& transfer) = 0;
+};
+
+#endif
+
+/**
+ * Internal. Storage for the single-frame receiver table of @ref TransferListenerBase; empty for listeners that
+ * accept multi-frame transfers.
+ */
+template <unsigned Size>
+struct UAVCAN_EXPORT SingleFrameReceiverTable
+{
+    SingleFrameTransferReceiver receivers[Size];
+
+    SingleFrameTransferReceiver* get() { return receivers; }
+};
+
+template <>
+struct UAVCAN_EXPORT SingleFrameReceiverTable<0>
+{
+    SingleFrameTransferReceiver* get() { return NULL; }
 };
 
 /**
  * Internal, refer to the transport dispatcher class.
  */
-class UAVCAN_EXPORT TransferListenerBase : public LinkedListNode<TransferListenerBase>, Noncopyable
+class UAVCAN_EXPORT TransferListenerBase : public FastRemovalLinkedList<TransferListenerBase>::Node, Noncopyable
 {
     const DataTypeDescriptor& data_type_;
     MapBase<TransferBufferManagerKey, TransferReceiver>& receivers_;
     ITransferBufferManager& bufmgr_;
     TransferPerfCounter& perf_;
-    const TransferCRC crc_base_;                      ///< Pre-initialized with data type hash, thus constant
+    SingleFrameTransferReceiver* const sft_receivers_;  ///< Table of TransferListenerSingleFrameTableSize, or NULL
+    const bool single_frame_only_;                    ///< No buffers, multi-frame transfers are dropped early
     bool allow_anonymous_transfers_;
+    bool earliest_arrival_;
+    MonotonicDuration receiver_retention_;
+    ITransferPrefilter* prefilter_;
+#if !UAVCAN_TINY
+    ITransferHandoff* handoff_;
+    DeferredTransferResult* deferred_result_;       ///< Set only while a deferred transfer is being processed
+    DataTypeStats* stats_;
+    ISystemClock* stats_clock_;
+#endif
+
+    /**
+     * Direct-mapped cache of pointers to the receivers stored in the map, indexed by source node ID.
+     * The map may relocate its entries when one is removed, so the index is invalidated completely in that case.
+     */
+    struct ReceiverIndexEntry
+    {
+        TransferBufferManagerKey key;
+        TransferReceiver* receiver;
+
+        ReceiverIndexEntry() : receiver(NULL) { }
+    };
+
+    enum { ReceiverIndexSize = (TransferListenerReceiverIndexSize > 0) ? TransferListenerReceiverIndexSize : 1 };
+
+    ReceiverIndexEntry receiver_index_[ReceiverIndexSize];
 
     class TimedOutReceiverPredicate
     {
         const MonotonicTime ts_;
+        const MonotonicDuration max_retention_;
         ITransferBufferManager& parent_bufmgr_;
+        unsigned& num_removed_;
 
     public:
-        TimedOutReceiverPredicate(MonotonicTime arg_ts, ITransferBufferManager& arg_bufmgr)
+        TimedOutReceiverPredicate(MonotonicTime arg_ts, MonotonicDuration arg_max_retention,
+                                  ITransferBufferManager& arg_bufmgr, unsigned& num_removed)
             : ts_(arg_ts)
+            , max_retention_(arg_max_retention)
             , parent_bufmgr_(arg_bufmgr)
+            , num_removed_(num_removed)
         { }
 
         bool operator()(const TransferBufferManagerKey& key, const TransferReceiver& value) const;
     };
 
-    bool checkPayloadCrc(const uint16_t compare_with, const ITransferBuffer& tbb) const;
+    ReceiverIndexEntry& getReceiverIndexEntry(const TransferBufferManagerKey& key)
+    {
+        return receiver_index_[key.getNodeID().get() & (unsigned(ReceiverIndexSize) - 1U)];
+    }
+
+    TransferReceiver* accessReceiver(const TransferBufferManagerKey& key);
+    TransferReceiver* insertReceiver(const TransferBufferManagerKey& key);
+    void invalidateReceiverIndex();
+
+    /// Returns NULL if the statistics are disabled
+    DataTypeStats* getActiveDataTypeStats() const
+    {
+#if UAVCAN_TINY
+        return NULL;
+#else
+        return (DataTypeStatsTableSize > 0) ? stats_ : NULL;
+#endif
+    }
+
+    /// The frame must be the first frame of a transfer
+    bool isRejectedByPrefilter(const RxFrame& frame) const;
+
+    void deliverIncomingTransfer(IncomingTransfer& transfer);
+    void deliverSingleFrameTransfer(const RxFrame& frame);
+
+    /// Returns false if the frame has to be processed by a regular receiver
+    bool handleSingleFrameTableReception(const RxFrame& frame);
 
 protected:
+    /**
+     * @param sft_receivers     Single-frame receiver table of @ref TransferListenerSingleFrameTableSize entries;
+     *                          NULL if the listener accepts multi-frame transfers or the table is disabled.
+     */
     TransferListenerBase(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
                          MapBase<TransferBufferManagerKey, TransferReceiver>& receivers,
-                         ITransferBufferManager& bufmgr)
+                         ITransferBufferManager& bufmgr, bool single_frame_only,
+                         SingleFrameTransferReceiver* sft_receivers)
         : data_type_(data_type)
         , receivers_(receivers)
         , bufmgr_(bufmgr)
         , perf_(perf)
-        , crc_base_(data_type.getSignature().toTransferCRC())
+        , sft_receivers_(single_frame_only ? sft_receivers : NULL)
+        , single_frame_only_(single_frame_only)
         , allow_anonymous_transfers_(false)
+        , earliest_arrival_(false)
+        , receiver_retention_(MonotonicDuration::fromMSec(TransferReceiver::DefaultTidTimeoutMSec))
+        , prefilter_(NULL)
+#if !UAVCAN_TINY
+        , handoff_(NULL)
+        , deferred_result_(NULL)
+        , stats_(NULL)
+        , stats_clock_(NULL)
+#endif
     { }
 
     virtual ~TransferListenerBase() { }
@@ -149,6 +351,74 @@ public:
      */
     void allowAnonymousTransfers() { allow_anonymous_transfers_ = true; }
 
+    /**
+     * Redundant interfaces: by default, the interface that delivered the previous transfer is preferred, and the
+     * listener switches to another one only if the preferred interface stays silent for a while.
+     * This option makes the listener accept every transfer from whichever interface delivers its first frame
+     * first; the copies that arrive later via other interfaces are discarded as duplicates by transfer ID.
+     */
+    void setEarliestArrivalMode(bool enabled) { earliest_arrival_ = enabled; }
+    bool isEarliestArrivalMode() const { return earliest_arrival_; }
+
+    /**
+     * Upper limit of the time the state of a silent source is kept in memory, refer to
+     * @ref TransferReceiver::isExpired(). By default, the state is removed once the transfer ID times out.
+     * Longer retention avoids reallocation of the receivers for the sources that publish less often than
+     * once per transfer ID timeout, at the cost of memory; the numbers of allocated and removed receivers
+     * are counted in the data type statistics.
+     */
+    void setReceiverRetention(MonotonicDuration max_retention) { receiver_retention_ = max_retention; }
+    MonotonicDuration getReceiverRetention() const { return receiver_retention_; }
+
+    /**
+     * If set, every transfer is offered to the prefilter when its first frame arrives; the discarded transfers are
+     * neither reassembled nor delivered, and they are not counted as received.
+     * Pass NULL to accept all transfers.
+     */
+    void setTransferPrefilter(ITransferPrefilter* prefilter) { prefilter_ = prefilter; }
+    ITransferPrefilter* getTransferPrefilter() const { return prefilter_; }
+
+#if !UAVCAN_TINY
+    /**
+     * If set, the received transfers are passed to the handoff object instead of being processed immediately.
+     * The deferred transfers must be fed back via @ref handleDeferredTransfer(), possibly from a different thread;
+     * this listener must not be destroyed while the handoff object holds any of its transfers.
+     * Pass NULL to restore the default behavior.
+     */
+    void setTransferHandoff(ITransferHandoff* handoff) { handoff_ = handoff; }
+    ITransferHandoff* getTransferHandoff() const { return handoff_; }
+
+    /**
+     * Processes a transfer that was previously passed to the handoff object. This method does not update any
+     * counters, so it can be invoked from a different thread; the outcome must be passed to
+     * @ref commitDeferredTransfer() in the thread that spins the node afterwards.
+     */
+    void handleDeferredTransfer(IncomingTransfer& transfer, DeferredTransferResult& out_result);
+
+    /**
+     * Accounts the outcome of a deferred transfer in the performance counters and the data type statistics.
+     * Must be invoked from the thread that spins the node.
+     */
+    virtual void commitDeferredTransfer(const DeferredTransferResult& result);
+
+    /**
+     * Returns the result of the deferred transfer that is being processed, or NULL if the transfer is processed
+     * in the thread that spins the node; in the latter case the handler may update the counters directly.
+     */
+    DeferredTransferResult* getDeferredTransferResult() const { return deferred_result_; }
+
+    /**
+     * Internal, invoked by the dispatcher when the listener is registered. The clock is needed to measure the
+     * callback duration. The statistics entry is shared by all listeners of the same data type.
+     */
+    void setDataTypeStats(DataTypeStats* stats, ISystemClock* clock)
+    {
+        stats_ = stats;
+        stats_clock_ = clock;
+    }
+    DataTypeStats* getDataTypeStats() const { return stats_; }
+#endif
+
     void cleanup(MonotonicTime ts);
 
     virtual void handleFrame(const RxFrame& frame);
@@ -162,10 +432,11 @@ class UAVCAN_EXPORT TransferListener : public TransferListenerBase
 {
     TransferBufferManager<MaxBufSize, NumStaticBufs> bufmgr_;
     Map<TransferBufferManagerKey, TransferReceiver, NumStaticReceivers> receivers_;
+    SingleFrameReceiverTable<(MaxBufSize == 0) ? TransferListenerSingleFrameTableSize : 0> sft_table_;
 
 public:
     TransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type, IPoolAllocator& allocator)
-        : TransferListenerBase(perf, data_type, receivers_, bufmgr_)
+        : TransferListenerBase(perf, data_type, receivers_, bufmgr_, MaxBufSize == 0, sft_table_.get())
         , bufmgr_(allocator)
         , receivers_(allocator)
     {
@@ -181,8 +452,284 @@ public:
         // Map must be cleared before bufmgr is destroyed
         receivers_.clear();
     }
+
+    /**
+     * Gives access to the migration policy of the transfer buffers and to its statistics, refer to
+     * @ref TransferBufferManagerImpl::MigrationPolicy.
+     */
+    TransferBufferManager<MaxBufSize, NumStaticBufs>& getBufferManager() { return bufmgr_; }
 };
 
+#if !UAVCAN_TINY
+/**
+ * Static-only version of @ref TransferListener<>, for nodes that need deterministic reception time.
+ * All receivers and buffers are preallocated in the object itself. The memory pool is never used and entries are
+ * never migrated between static and dynamic storage. If the static capacity is exceeded, i.e. there are more
+ * concurrent sources or transfers than preallocated receivers or buffers, the offending frames are dropped and
+ * the event is registered in the overflow counters.
+ *
+ * Can be used in place of @ref TransferListener<> via @ref TransferListenerInstantiationHelper.
+ */
+template <unsigned MaxBufSize, unsigned NumStaticBufs, unsigned NumStaticReceivers>
+class UAVCAN_EXPORT StaticTransferListener : public TransferListenerBase
+{
+    /**
+     * Refuses all allocation requests and counts them.
+     */
+    class OverflowCounter : public IPoolAllocator
+    {
+        uint32_t count_;
+
+    public:
+        OverflowCounter() : count_(0) { }
+
+        virtual void* allocate(std::size_t)
+        {
+            count_++;
+            return NULL;
+        }
+
+        virtual void deallocate(const void*) { UAVCAN_ASSERT(0); }
+
+        virtual uint16_t getNumBlocks() const { return 0; }
+
+        uint32_t get() const { return count_; }
+    };
+
+    OverflowCounter receiver_overflows_;
+    OverflowCounter buffer_overflows_;
+    TransferBufferManager<MaxBufSize, NumStaticBufs> bufmgr_;
+    Map<TransferBufferManagerKey, TransferReceiver, NumStaticReceivers> receivers_;
+    SingleFrameReceiverTable<(MaxBufSize == 0) ? TransferListenerSingleFrameTableSize : 0> sft_table_;
+
+public:
+    /**
+     * The allocator argument is ignored; it exists for compatibility with @ref TransferListener<>.
+     */
+    StaticTransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type, IPoolAllocator&)
+        : TransferListenerBase(perf, data_type, receivers_, bufmgr_, MaxBufSize == 0, sft_table_.get())
+        , bufmgr_(buffer_overflows_)
+        , receivers_(receiver_overflows_)
+    {
+        StaticAssert<(NumStaticReceivers > 0)>::check();
+        StaticAssert<(NumStaticReceivers >= NumStaticBufs)>::check();  // Otherwise it would be meaningless
+    }
+
+    virtual ~StaticTransferListener()
+    {
+        // Map must be cleared before bufmgr is destroyed
+        receivers_.clear();
+    }
+
+    /**
+     * Number of times a new source could not be served because all receivers were in use.
+     */
+    uint32_t getReceiverOverflowCount() const { return receiver_overflows_.get(); }
+
+    /**
+     * Number of times a multi-frame transfer could not be received because all buffers were in use.
+     */
+    uint32_t getBufferOverflowCount() const { return buffer_overflows_.get(); }
+};
+
+/**
+ * Version of @ref TransferListener<> whose static capacity is chosen at run time instead of by the template
+ * arguments. The receivers and buffers are placed in a storage block supplied by the application via
+ * @ref setCapacity(); until then, and for the sources and transfers beyond the capacity, they are allocated from
+ * the pool as usual. This allows to size every subscription after the expected number of its publishers and
+ * concurrent multi-frame transfers, so that subscriptions with high fan-in can be fully preallocated, and the
+ * rarely used ones take no static memory at all.
+ *
+ * Can be used in place of @ref TransferListener<> via @ref TransferListenerInstantiationHelper with both static
+ * counts set to zero, e.g. Subscriber<DataType, Callback, 0, 0, RuntimeCapacityTransferListener>.
+ */
+template <unsigned MaxBufSize, unsigned NumStaticBufs, unsigned NumStaticReceivers>
+class UAVCAN_EXPORT RuntimeCapacityTransferListener : public TransferListenerBase
+{
+    typedef MapBase<TransferBufferManagerKey, TransferReceiver> ReceiverMapBase;
+    typedef typename ReceiverMapBase::KVPair ReceiverEntry;
+
+    class ReceiverMap : public ReceiverMapBase
+    {
+    public:
+        explicit ReceiverMap(IPoolAllocator& allocator)
+            : ReceiverMapBase(NULL, 0, allocator)
+        { }
+
+        ~ReceiverMap() { this->clear(); }
+
+        using ReceiverMapBase::setStaticStorage;
+    };
+
+    class BufferManager : public TransferBufferManagerImpl
+    {
+        StaticTransferBufferManagerEntryImpl* static_buffers_;
+        uint16_t num_static_buffers_;
+
+        virtual StaticTransferBufferManagerEntryImpl* getStaticByIndex(uint16_t index) const
+        {
+            return (index < num_static_buffers_) ? &static_buffers_[index] : NULL;
+        }
+
+    public:
+        explicit BufferManager(IPoolAllocator& allocator)
+            : TransferBufferManagerImpl(MaxBufSize, allocator)
+            , static_buffers_(NULL)
+            , num_static_buffers_(0)
+        { }
+
+        void setStaticStorage(StaticTransferBufferManagerEntryImpl* buffers, uint16_t num_buffers)
+        {
+            UAVCAN_ASSERT(isEmpty());
+            static_buffers_ = buffers;
+            num_static_buffers_ = num_buffers;
+        }
+    };
+
+    BufferManager bufmgr_;
+    ReceiverMap receivers_;
+    SingleFrameReceiverTable<(MaxBufSize == 0) ? TransferListenerSingleFrameTableSize : 0> sft_table_;
+    ReceiverEntry* static_receivers_;
+    StaticTransferBufferManagerEntryImpl* static_buffers_;
+    uint16_t num_static_receivers_;
+    uint16_t num_static_buffers_;
+
+    static std::size_t alignUp(std::size_t size)
+    {
+        return (size + MemPoolAlignment - 1U) & ~std::size_t(MemPoolAlignment - 1U);
+    }
+
+    static unsigned getNumBuffersFor(unsigned num_receivers, unsigned num_buffers)
+    {
+        // Single-frame transfers need no buffers; there can't be more transfers in progress than their sources
+        return (MaxBufSize == 0) ? 0U : min(num_buffers, num_receivers);
+    }
+
+    void releaseStorage()
+    {
+        receivers_.setStaticStorage(NULL, 0);
+        bufmgr_.setStaticStorage(NULL, 0);
+        for (unsigned i = 0; i < num_static_receivers_; i++)
+        {
+            static_receivers_[i].~ReceiverEntry();
+        }
+        for (unsigned i = 0; i < num_static_buffers_; i++)
+        {
+            static_buffers_[i].~StaticTransferBufferManagerEntryImpl();
+        }
+        static_receivers_ = NULL;
+        static_buffers_ = NULL;
+        num_static_receivers_ = 0;
+        num_static_buffers_ = 0;
+    }
+
+public:
+    RuntimeCapacityTransferListener(TransferPerfCounter& perf, const DataTypeDescriptor& data_type,
+                                    IPoolAllocator& allocator)
+        : TransferListenerBase(perf, data_type, receivers_, bufmgr_, MaxBufSize == 0, sft_table_.get())
+        , bufmgr_(allocator)
+        , receivers_(allocator)
+        , static_receivers_(NULL)
+        , static_buffers_(NULL)
+        , num_static_receivers_(0)
+        , num_static_buffers_(0)
+    {
+        StaticAssert<(NumStaticBufs == 0) && (NumStaticReceivers == 0)>::check();  // The capacity is set at run time
+    }
+
+    virtual ~RuntimeCapacityTransferListener()
+    {
+        // Map must be cleared before bufmgr is destroyed
+        receivers_.clear();
+        releaseStorage();
+    }
+
+    /**
+     * Size of the storage block required by @ref setCapacity() for the given capacity, in bytes.
+     * It includes the slack for alignment, so the block itself need not be aligned.
+     */
+    static unsigned getStorageSize(unsigned expected_publishers, unsigned max_concurrent_transfers)
+    {
+        const unsigned num_buffers = getNumBuffersFor(expected_publishers, max_concurrent_transfers);
+        return unsigned(MemPoolAlignment - 1U +
+                        alignUp(expected_publishers * sizeof(ReceiverEntry)) +
+                        alignUp(num_buffers * sizeof(StaticTransferBufferManagerEntryImpl)) +
+                        num_buffers * MaxBufSize);
+    }
+
+    /**
+     * Places the receivers and buffers in the storage block, replacing the previous one, if any.
+     * This must be done before the listener receives anything, e.g. right before the subscription is started.
+     *
+     * @param expected_publishers       Number of sources that are served without the pool.
+     * @param max_concurrent_transfers  Number of multi-frame transfers that can be reassembled concurrently without
+     *                                  the pool; ignored for single-frame data types.
+     * @param storage                   Block of at least @ref getStorageSize() bytes; it must outlive the listener
+     *                                  or be replaced. NULL releases the current block.
+     * @param storage_size              Size of the block in bytes.
+     * @return                          Negative error code.
+     */
+    int setCapacity(unsigned expected_publishers, unsigned max_concurrent_transfers,
+                    void* storage, unsigned storage_size)
+    {
+        if (!receivers_.isEmpty() || !bufmgr_.isEmpty())
+        {
+            return -ErrLogic;
+        }
+        if ((storage != NULL) &&
+            ((expected_publishers > 0xFFFFU) ||
+             (storage_size < getStorageSize(expected_publishers, max_concurrent_transfers))))
+        {
+            return -ErrInvalidParam;
+        }
+
+        releaseStorage();
+        if (storage == NULL)
+        {
+            return 0;
+        }
+
+        const uint16_t num_receivers = uint16_t(expected_publishers);
+        const uint16_t num_buffers = uint16_t(getNumBuffersFor(expected_publishers, max_concurrent_transfers));
+
+        const std::size_t address = std::size_t(reinterpret_cast<unsigned long long>(storage));
+        uint8_t* ptr = static_cast<uint8_t*>(storage) + (alignUp(address) - address);
+
+        static_receivers_ = reinterpret_cast<ReceiverEntry*>(ptr);
+        ptr += alignUp(num_receivers * sizeof(ReceiverEntry));
+        static_buffers_ = reinterpret_cast<StaticTransferBufferManagerEntryImpl*>(ptr);
+        ptr += alignUp(num_buffers * sizeof(StaticTransferBufferManagerEntryImpl));
+
+        for (unsigned i = 0; i < num_receivers; i++)
+        {
+            new (&static_receivers_[i]) ReceiverEntry();
+        }
+        for (unsigned i = 0; i < num_buffers; i++)
+        {
+            new (&static_buffers_[i]) StaticTransferBufferManagerEntryImpl(ptr + i * MaxBufSize, uint16_t(MaxBufSize));
+        }
+        num_static_receivers_ = num_receivers;
+        num_static_buffers_ = num_buffers;
+
+        receivers_.setStaticStorage(static_receivers_, num_static_receivers_);
+        bufmgr_.setStaticStorage(static_buffers_, num_static_buffers_);
+
+        UAVCAN_TRACE("RuntimeCapacityTransferListener", "Capacity: %u receivers, %u buffers",
+                     unsigned(num_static_receivers_), unsigned(num_static_buffers_));
+        return 0;
+    }
+
+    unsigned getNumStaticReceivers() const { return num_static_receivers_; }
+    unsigned getNumStaticBuffers() const { return num_static_buffers_; }
+
+    /**
+     * Gives access to the migration policy of the transfer buffers and to its statistics, refer to
+     * @ref TransferBufferManagerImpl::MigrationPolicy.
+     */
+    TransferBufferManagerImpl& getBufferManager() { return bufmgr_; }
+};
+#endif
+
 /**
  * This class is used by transfer listener to decide if the frame should be accepted or ignored.
  */
@@ -199,11 +746,51 @@ public:
 
 /**
  * This class should be derived by callers.
+ *
+ * The filter is consulted for every first frame. If the first frame of a multi-frame transfer is rejected,
+ * the transfer is remembered, and its remaining frames are dropped without consulting the filter again.
  */
 template <unsigned MaxBufSize, unsigned NumStaticBufs, unsigned NumStaticReceivers>
 class UAVCAN_EXPORT TransferListenerWithFilter : public TransferListener<MaxBufSize, NumStaticBufs, NumStaticReceivers>
 {
+    /**
+     * Direct-mapped by source node ID. If an entry gets overwritten by another source, the remaining frames of
+     * the evicted transfer are simply checked by the filter as usual.
+     */
+    struct RejectedTransfer
+    {
+        uint8_t node_id;            ///< Zero if the entry is empty, since anonymous transfers are single-frame
+        uint8_t transfer_type;
+        uint8_t transfer_id;
+
+        RejectedTransfer() : node_id(0), transfer_type(0), transfer_id(0) { }
+
+        explicit RejectedTransfer(const RxFrame& frame)
+            : node_id(frame.getSrcNodeID().get())
+            , transfer_type(uint8_t(frame.getTransferType()))
+            , transfer_id(frame.getTransferID().get())
+        { }
+
+        bool isSameSource(const RxFrame& frame) const
+        {
+            return (node_id == frame.getSrcNodeID().get()) && (transfer_type == uint8_t(frame.getTransferType()));
+        }
+
+        bool matches(const RxFrame& frame) const
+        {
+            return isSameSource(frame) && (transfer_id == frame.getTransferID().get());
+        }
+    };
+
+    enum { NumRejectedTransfers = 4 };
+
     const ITransferAcceptanceFilter* filter_;
+    RejectedTransfer rejected_transfers_[NumRejectedTransfers];
+
+    RejectedTransfer& getRejectedTransferEntry(const RxFrame& frame)
+    {
+        return rejected_transfers_[frame.getSrcNodeID().get() & (unsigned(NumRejectedTransfers) - 1U)];
+    }
 
     virtual void handleFrame(const RxFrame& frame);
 
@@ -230,16 +817,44 @@ public:
 template <unsigned MaxBufSize, unsigned NumStaticBufs, unsigned NumStaticReceivers>
 void TransferListenerWithFilter<MaxBufSize, NumStaticBufs, NumStaticReceivers>::handleFrame(const RxFrame& frame)
 {
-    if (filter_ != NULL)
+    if (filter_ == NULL)
     {
-        if (filter_->shouldAcceptFrame(frame))
+        UAVCAN_ASSERT(0);
+        return;
+    }
+
+    RejectedTransfer& rejected = getRejectedTransferEntry(frame);
+
+    if (frame.isStartOfTransfer())
+    {
+        const bool accepted = filter_->shouldAcceptFrame(frame);
+        if (!accepted && !frame.isEndOfTransfer())
+        {
+            rejected = RejectedTransfer(frame);
+        }
+        else if (rejected.isSameSource(frame))
+        {
+            rejected = RejectedTransfer();      // A new transfer from this source, the old entry is obsolete
+        }
+        if (accepted)
         {
             BaseType::handleFrame(frame);
         }
+        return;
     }
-    else
+
+    if (rejected.matches(frame))
     {
-        UAVCAN_ASSERT(0);
+        if (frame.isEndOfTransfer())
+        {
+            rejected = RejectedTransfer();
+        }
+        return;
+    }
+
+    if (filter_->shouldAcceptFrame(frame))
+    {
+        BaseType::handleFrame(frame);
     }
 }
 
@@ -9,6 +9,7 @@
 #include <uavcan/build_config.hpp>
 #include <uavcan/transport/frame.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
+#include <uavcan/transport/crc.hpp>
 
 namespace uavcan
 {
@@ -16,7 +17,7 @@ namespace uavcan
 class UAVCAN_EXPORT TransferReceiver
 {
 public:
-    enum ResultCode { ResultNotComplete, ResultComplete, ResultSingleFrame };
+    enum ResultCode { ResultNotComplete, ResultComplete, ResultSingleFrame, ResultSkipped };
 
     static const uint16_t MinTransferIntervalMSec     = 1;
     static const uint16_t MaxTransferIntervalMSec     = 0xFFFF;
@@ -33,15 +34,21 @@ public:
 private:
     enum { IfaceIndexNotSet = MaxCanIfaces };
 
-    enum { ErrorCntMask = 31 };
+    enum { ErrorCntMask = 15 };
     enum { IfaceIndexMask = MaxCanIfaces };
 
-    MonotonicTime prev_transfer_ts_;
+    enum { RetentionNumIntervals = 4 };
+
+    /*
+     * The fields are ordered by access frequency. The cleanup of timed out receivers reads only the first field;
+     * the frame acceptance logic reads the fields up to the bitfields, which fit into the first 24 bytes.
+     * Since the Map<> places the value before the key, this is also the beginning of the key/value pair,
+     * so the periodic cleanup and frame lookup touch fewer cache lines. The cold fields are accessed only
+     * while the payload is being written.
+     */
     MonotonicTime this_transfer_ts_;
-    UtcTime first_frame_ts_;
+    MonotonicTime prev_transfer_ts_;
     uint16_t transfer_interval_msec_;
-    uint16_t this_transfer_crc_;
-
     uint16_t buffer_write_pos_;
 
     TransferID tid_;    // 1 byte field
@@ -49,7 +56,13 @@ private:
     // 1 byte aligned bitfields:
     uint8_t next_toggle_        : 1;
     uint8_t iface_index_        : 2;
-    mutable uint8_t error_cnt_  : 5;
+    uint8_t skipping_           : 1;    ///< The payload of the current transfer is being discarded
+    mutable uint8_t error_cnt_  : 4;
+
+    // Cold fields:
+    uint16_t this_transfer_crc_;
+    TransferCRC computed_crc_;      ///< Accumulated over the payload as it arrives, 2 bytes
+    UtcTime first_frame_ts_;
 
     bool isInitialized() const { return iface_index_ != IfaceIndexNotSet; }
 
@@ -65,21 +78,45 @@ private:
 
     bool validate(const RxFrame& frame) const;
     bool writePayload(const RxFrame& frame, ITransferBuffer& buf);
-    ResultCode receive(const RxFrame& frame, TransferBufferAccessor& tba);
+    ResultCode receive(const RxFrame& frame, TransferBufferAccessor& tba, const TransferCRC& crc_base,
+                       bool skip_payload);
 
 public:
     TransferReceiver() :
         transfer_interval_msec_(DefaultTransferIntervalMSec),
-        this_transfer_crc_(0),
         buffer_write_pos_(0),
         next_toggle_(false),
         iface_index_(IfaceIndexNotSet),
-        error_cnt_(0)
+        skipping_(false),
+        error_cnt_(0),
+        this_transfer_crc_(0)
     { }
 
     bool isTimedOut(MonotonicTime current_ts) const;
 
-    ResultCode addFrame(const RxFrame& frame, TransferBufferAccessor& tba);
+    /**
+     * Returns true if the receiver is no longer needed and can be removed. It is kept while the transfer ID is
+     * valid, and also while the source is silent for less than a few of its own transfer intervals, so that the
+     * receivers of slow publishers are not removed and recreated every time; but never longer than max_retention.
+     * If max_retention does not exceed the transfer ID timeout, this is equivalent to @ref isTimedOut().
+     */
+    bool isExpired(MonotonicTime current_ts, MonotonicDuration max_retention) const;
+
+    /**
+     * The CRC of multi-frame transfers is computed incrementally as the frames arrive, starting from crc_base
+     * (normally initialized with the data type signature). Once the transfer is complete, the computed CRC
+     * can be compared against the received one without reading the buffer again.
+     *
+     * If skip_payload is set for the first frame of a multi-frame transfer, the transfer is tracked as usual, but its
+     * payload is not stored; the last frame yields ResultSkipped instead of ResultComplete. The flag is ignored for
+     * the other frames.
+     *
+     * If earliest_arrival is set, the receiver switches to another interface as soon as it delivers the first frame
+     * of a new transfer, unless a transfer is being received already; otherwise the switch is delayed by the
+     * interface switch delay. The copies of the transfers that were received already are rejected either way.
+     */
+    ResultCode addFrame(const RxFrame& frame, TransferBufferAccessor& tba, const TransferCRC& crc_base = TransferCRC(),
+                        bool skip_payload = false, bool earliest_arrival = false);
 
     uint8_t yieldErrorCount();
 
@@ -87,6 +124,67 @@ public:
     UtcTime getLastTransferTimestampUtc() const { return first_frame_ts_; }
 
     uint16_t getLastTransferCrc() const { return this_transfer_crc_; }
+    uint16_t getLastTransferComputedCrc() const { return computed_crc_.get(); }
+
+    MonotonicDuration getInterval() const { return MonotonicDuration::fromMSec(transfer_interval_msec_); }
+};
+
+/**
+ * Compact state of the reception of single-frame transfers from one source, 8 bytes.
+ * Implements the same transfer ID and interface validation logic as @ref TransferReceiver for single-frame
+ * transfers, but it needs no buffers, so it can be stored in a plain array instead of the receiver map.
+ * Timestamps are kept with millisecond resolution in 32 bits; the intervals are capped at 16 seconds, which
+ * doesn't affect the logic because the transfer ID times out much earlier.
+ */
+class UAVCAN_EXPORT SingleFrameTransferReceiver
+{
+    enum { MaxTransferIntervalMSec = 0x3FFF };
+
+    uint32_t ts_msec_;                      ///< Last accepted transfer, lower 32 bits
+    uint16_t transfer_interval_msec_ : 14;
+    uint16_t transfer_type_          : 2;
+    uint8_t node_id_;                       ///< Zero if the slot is free
+    uint8_t tid_                     : 5;   ///< Expected transfer ID
+    uint8_t iface_index_             : 2;
+
+    static uint32_t getTimestampMSec(const RxFrame& frame)
+    {
+        return static_cast<uint32_t>(frame.getMonotonicTimestamp().toMSec());
+    }
+
+    void accept(const RxFrame& frame);
+
+public:
+    SingleFrameTransferReceiver() :
+        ts_msec_(0),
+        transfer_interval_msec_(TransferReceiver::DefaultTransferIntervalMSec),
+        transfer_type_(0),
+        node_id_(0),
+        tid_(0),
+        iface_index_(0)
+    { }
+
+    /**
+     * Initializes the state from the first accepted frame.
+     */
+    explicit SingleFrameTransferReceiver(const RxFrame& frame);
+
+    bool isFree() const { return node_id_ == 0; }
+
+    bool isOwnedBy(NodeID src_node_id, TransferType transfer_type) const
+    {
+        return (node_id_ == src_node_id.get()) && (transfer_type_ == unsigned(transfer_type));
+    }
+
+    bool isTimedOut(MonotonicTime current_ts) const;
+
+    /**
+     * Returns true if the frame is a new transfer that should be delivered.
+     * The frame must come from the owner of the state and be a single-frame transfer.
+     * @param out_error         Set to true if the frame indicates a transfer loss or a protocol violation.
+     * @param earliest_arrival  Accept a new transfer from any interface, refer to @ref TransferReceiver::addFrame().
+     */
+    bool addFrame(const RxFrame& frame, bool& out_error, bool earliest_arrival = false);
 
     MonotonicDuration getInterval() const { return MonotonicDuration::fromMSec(transfer_interval_msec_); }
 };
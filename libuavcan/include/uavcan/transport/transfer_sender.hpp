@@ -13,12 +13,32 @@
 #include <uavcan/transport/crc.hpp>
 #include <uavcan/transport/transfer.hpp>
 #include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/abstract_transfer_buffer.hpp>
 
 namespace uavcan
 {
+/**
+ * Produces the transfer payload by writing it sequentially into the provided buffer, the way the marshaling
+ * code does. Refer to @ref TransferSender::send().
+ */
+class UAVCAN_EXPORT ITransferPayloadEncoder
+{
+public:
+    virtual ~ITransferPayloadEncoder() { }
+
+    /**
+     * May be invoked several times per transfer, and must produce the same payload every time.
+     * Returns negative error code.
+     */
+    virtual int encode(ITransferBuffer& buffer) const = 0;
+};
+
+class UAVCAN_EXPORT PacedTransferSender;
 
 class UAVCAN_EXPORT TransferSender
 {
+    friend class PacedTransferSender;
+
     const MonotonicDuration max_transfer_interval_;
 
     Dispatcher& dispatcher_;
@@ -30,9 +50,47 @@ class UAVCAN_EXPORT TransferSender
     CanIOFlags flags_;
     uint8_t iface_mask_;
     bool allow_anonymous_transfers_;
+#if UAVCAN_SUPPORT_CANFD
+    bool canfd_;
+#endif
+    mutable uint32_t can_id_cache_;         ///< Refer to Frame::compileCanID()
+    mutable uint32_t can_id_cache_key_;     ///< Header fields the cached CAN ID was compiled from; zero if none
+#if !UAVCAN_TINY
+    DataTypeStats* stats_;                  ///< Resolved on initialization, NULL if the statistics are disabled
+    mutable MonotonicTime rate_limit_tat_;  ///< When the bucket is full again; refer to checkRateLimit()
+    MonotonicDuration rate_limit_interval_; ///< Time per frame, zero if the rate is not limited
+    uint16_t rate_limit_burst_;
+#endif
 
     void registerError() const;
 
+    unsigned getNumFrames(unsigned payload_len, unsigned frame_capacity) const;
+
+    int checkRateLimit(unsigned num_frames) const;
+
+    DataTypeStats* getActiveDataTypeStats() const
+    {
+#if UAVCAN_TINY
+        return NULL;
+#else
+        return (DataTypeStatsTableSize > 0) ? stats_ : NULL;
+#endif
+    }
+
+    Frame makeFrame(TransferType transfer_type, NodeID dst_node_id, TransferID tid) const;
+
+    unsigned getTransferCRCPaddingLen(unsigned payload_len) const;
+
+    bool getCanID(const Frame& frame, uint32_t& out_can_id) const;
+    int sendFrame(const Frame& frame, uint32_t can_id, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                  CanIOFlags flags) const;
+
+    TransferID* accessTransferID(MonotonicTime tx_deadline, TransferType transfer_type, NodeID dst_node_id) const;
+
+    int sendPayload(const uint8_t* payload, unsigned payload_len, const uint16_t* payload_crc,
+                    MonotonicTime tx_deadline, MonotonicTime blocking_deadline, TransferType transfer_type,
+                    NodeID dst_node_id, TransferID tid) const;
+
 public:
     enum { AllIfacesMask = 0xFF };
 
@@ -50,6 +108,15 @@ public:
         , flags_(CanIOFlags(0))
         , iface_mask_(AllIfacesMask)
         , allow_anonymous_transfers_(false)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd_(false)
+#endif
+        , can_id_cache_(0)
+        , can_id_cache_key_(0)
+#if !UAVCAN_TINY
+        , stats_(NULL)
+        , rate_limit_burst_(0)
+#endif
     {
         init(data_type, qos);
     }
@@ -62,12 +129,23 @@ public:
         , flags_(CanIOFlags(0))
         , iface_mask_(AllIfacesMask)
         , allow_anonymous_transfers_(false)
+#if UAVCAN_SUPPORT_CANFD
+        , canfd_(false)
+#endif
+        , can_id_cache_(0)
+        , can_id_cache_key_(0)
+#if !UAVCAN_TINY
+        , stats_(NULL)
+        , rate_limit_burst_(0)
+#endif
     { }
 
     void init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos);
 
     bool isInitialized() const { return data_type_id_ != DataTypeID(); }
 
+    DataTypeID getDataTypeID() const { return data_type_id_; }
+
     CanIOFlags getCanIOFlags() const { return flags_; }
     void setCanIOFlags(CanIOFlags flags) { flags_ = flags; }
 
@@ -90,6 +168,32 @@ public:
      */
     void allowAnonymousTransfers() { allow_anonymous_transfers_ = true; }
 
+    /**
+     * If enabled, the transfers are sent in CAN FD frames, 63 bytes of payload per frame; only the nodes that
+     * support CAN FD will be able to receive them. The last frame of a transfer is padded with zeros up to the
+     * nearest valid CAN FD frame length; the padding of a multi frame transfer is covered by the transfer CRC.
+     * The data structures must be encoded with the tail array optimization disabled.
+     * Disabled by default; always disabled if CAN FD is not supported, refer to UAVCAN_SUPPORT_CANFD.
+     */
+#if UAVCAN_SUPPORT_CANFD
+    void setCanFD(bool enabled) { canfd_ = enabled; }
+    bool isCanFD() const { return canfd_; }
+#else
+    bool isCanFD() const { return false; }
+#endif
+
+#if !UAVCAN_TINY
+    /**
+     * Limits the number of CAN frames this sender can emit, as a token bucket that holds up to @ref burst frames
+     * and is refilled at @ref max_frames_per_sec. A transfer is accepted or rejected as a whole, the rejected ones
+     * fail with @ref ErrRateLimited without being counted as errors. A transfer longer than the burst is
+     * accepted only if the bucket is full, and the bucket stays in debt afterwards.
+     * Zero rate disables the limit, which is the default.
+     */
+    void setFrameRateLimit(unsigned max_frames_per_sec, uint16_t burst);
+    bool isFrameRateLimited() const { return rate_limit_interval_.isPositive(); }
+#endif
+
     /**
      * Send with explicit Transfer ID.
      * Should be used only for service responses, where response TID should match request TID.
@@ -108,6 +212,37 @@ public:
      */
     int send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
              MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const;
+
+    /**
+     * Same as above, but the payload is encoded directly into the CAN frames, so that no buffer for the whole
+     * transfer is needed. The encoder is invoked once to compute the payload length and the transfer CRC; if the
+     * payload doesn't fit one frame, it is invoked again to fill in the frames, which are sent as soon as they
+     * are complete.
+     */
+    int send(const ITransferPayloadEncoder& encoder, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+             TransferType transfer_type, NodeID dst_node_id, TransferID tid) const;
+
+    int send(const ITransferPayloadEncoder& encoder, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+             TransferType transfer_type, NodeID dst_node_id) const;
+
+    /**
+     * Transfer CRC of the payload for this data type; only multi-frame transfers carry it.
+     * Depends on the CAN FD mode, which must not be changed before the transfer is sent.
+     */
+    uint16_t computeTransferCRC(const uint8_t* payload, unsigned payload_len) const;
+
+    /**
+     * Same as the raw payload overloads of @ref send(), but the transfer CRC is not computed; the value
+     * returned by @ref computeTransferCRC() for the same payload is used instead. This is intended for payloads
+     * that are encoded once and sent many times.
+     */
+    int sendPreEncoded(const uint8_t* payload, unsigned payload_len, uint16_t payload_crc,
+                       MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                       TransferType transfer_type, NodeID dst_node_id, TransferID tid) const;
+
+    int sendPreEncoded(const uint8_t* payload, unsigned payload_len, uint16_t payload_crc,
+                       MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                       TransferType transfer_type, NodeID dst_node_id) const;
 };
 
 }
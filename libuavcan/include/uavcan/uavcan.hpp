@@ -15,8 +15,11 @@
 #include <uavcan/node/timer.hpp>
 #include <uavcan/node/publisher.hpp>
 #include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/lazy_subscriber.hpp>
+#include <uavcan/node/sample_buffer_subscriber.hpp>
 #include <uavcan/node/service_server.hpp>
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/node/pipelined_service_client.hpp>
 #include <uavcan/node/global_data_type_registry.hpp>
 
 // Util
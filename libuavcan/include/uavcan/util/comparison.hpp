@@ -30,6 +30,12 @@ template <typename T>
 UAVCAN_EXPORT
 inline bool areFloatsClose(T a, T b, const T& absolute_epsilon, const T& relative_epsilon)
 {
+    // Exactly equal, which is the most common case for the elements of packed matrices; never true for NAN
+    if (areFloatsExactlyEqual(a, b))
+    {
+        return true;
+    }
+
     // NAN
     if (isNaN(a) || isNaN(b))
     {
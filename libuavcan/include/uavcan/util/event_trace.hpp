@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_EVENT_TRACE_HPP_INCLUDED
+#define UAVCAN_UTIL_EVENT_TRACE_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/util/templates.hpp>
+
+/**
+ * Source of the event timestamps; should resolve to a cheap free-running counter of at least 32 bits.
+ * Only the lower 32 bits are recorded, so the counter is allowed to wrap.
+ *
+ * The defaults are the TSC on x86 and the DWT cycle counter on ARMv7-M (the application is responsible for
+ * enabling the counter, via DEMCR.TRCENA and DWT_CTRL.CYCCNTENA). Other platforms must define the macro explicitly.
+ */
+#ifndef UAVCAN_EVENT_TRACE_TIMESTAMP
+# if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#  define UAVCAN_EVENT_TRACE_TIMESTAMP()    static_cast< ::uavcan::uint32_t>(__builtin_ia32_rdtsc())
+# elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#  define UAVCAN_EVENT_TRACE_TIMESTAMP()    (*reinterpret_cast<volatile ::uavcan::uint32_t*>(0xE0001004U))
+# elif UAVCAN_EVENT_TRACE
+#  error "UAVCAN_EVENT_TRACE_TIMESTAMP() is not defined for this platform"
+# else
+#  define UAVCAN_EVENT_TRACE_TIMESTAMP()    0U
+# endif
+#endif
+
+namespace uavcan
+{
+/**
+ * Trace point identifiers.
+ * Paired events are recorded by @ref EventTraceScope, where the end event always follows the begin event.
+ * The numbering is a part of the dump format; new events shall be added to the end of the list.
+ */
+enum EventTraceID
+{
+    EventTraceNone,                             ///< Never recorded
+    EventTraceDispatcherHandleFrameBegin,       ///< Arg: index of the interface the frame was received from
+    EventTraceDispatcherHandleFrameEnd,
+    EventTraceTransferReceiverAddFrame,         ///< Arg: source node ID in the lower byte, transfer ID in the upper
+    EventTraceCanTxQueuePush,                   ///< Arg: interface mask
+    EventTraceCanTxQueuePeek,                   ///< Arg: interface index
+    EventTraceSchedulerSpinBegin,
+    EventTraceSchedulerSpinEnd,
+    EventTraceSubscriberCallbackBegin,          ///< Arg: data type ID
+    EventTraceSubscriberCallbackEnd,
+    NumEventTraceIDs
+};
+
+/**
+ * One record of the trace buffer, 8 bytes.
+ */
+struct UAVCAN_EXPORT EventTraceRecord
+{
+    uint32_t timestamp;         ///< See UAVCAN_EVENT_TRACE_TIMESTAMP()
+    uint16_t event_id;          ///< See @ref EventTraceID
+    uint16_t arg;
+};
+
+/**
+ * Binary event tracing of the hot paths of the library, enabled with UAVCAN_EVENT_TRACE.
+ * Unlike UAVCAN_TRACE(), recording an event costs a few instructions: the timestamp is sampled and the record
+ * is written into a statically allocated ring buffer, so it is suitable for latency profiling on the target.
+ * Once the buffer is full, the oldest records are overwritten.
+ *
+ * The buffer can be dumped as is (e.g. with the debugger, or by writing @ref getBuffer() into a file on Linux)
+ * and decoded with tools/event_trace_decoder.py. The header of the buffer allows the decoder to find out
+ * how many records are valid and which one is the oldest.
+ *
+ * The recording is not thread safe, in the same way as the rest of the library.
+ * The buffer is only instantiated if it is used, so it costs no memory if the tracing is disabled.
+ */
+template <unsigned Capacity_>
+class UAVCAN_EXPORT EventTraceImpl
+{
+public:
+    enum { Capacity = Capacity_ };
+    enum { Magic = 0x54455655 };    ///< "UVET" in little endian
+
+    struct Buffer
+    {
+        uint32_t magic;
+        uint16_t capacity;          ///< Number of records
+        uint16_t record_size;       ///< sizeof(EventTraceRecord)
+        uint32_t num_recorded;      ///< Total number of events recorded since the last reset, wraps around
+        EventTraceRecord records[Capacity];
+    };
+
+private:
+    static Buffer buffer_;
+
+    EventTraceImpl();
+
+public:
+    static void record(EventTraceID event_id, uint16_t arg)
+    {
+        StaticAssert<((Capacity & (Capacity - 1)) == 0) && (Capacity > 0)>::check();
+        EventTraceRecord& rec = buffer_.records[buffer_.num_recorded & (Capacity - 1U)];
+        rec.timestamp = UAVCAN_EVENT_TRACE_TIMESTAMP();
+        rec.event_id = static_cast<uint16_t>(event_id);
+        rec.arg = arg;
+        buffer_.num_recorded++;
+    }
+
+    /**
+     * Returns the specified record counting from the oldest one, or NULL if there's no such record.
+     */
+    static const EventTraceRecord* getRecord(unsigned index)
+    {
+        const unsigned size = getSize();
+        if (index >= size)
+        {
+            return NULL;
+        }
+        return &buffer_.records[(buffer_.num_recorded - size + index) & (Capacity - 1U)];
+    }
+
+    /**
+     * Number of valid records in the buffer.
+     */
+    static unsigned getSize() { return min(unsigned(buffer_.num_recorded), unsigned(Capacity)); }
+
+    static const Buffer& getBuffer() { return buffer_; }
+
+    static void reset() { buffer_.num_recorded = 0; }
+};
+
+template <unsigned Capacity_>
+typename EventTraceImpl<Capacity_>::Buffer EventTraceImpl<Capacity_>::buffer_ =
+{
+    EventTraceImpl<Capacity_>::Magic,
+    static_cast<uint16_t>(Capacity_),
+    static_cast<uint16_t>(sizeof(EventTraceRecord)),
+    0,
+    {}
+};
+
+/**
+ * The trace buffer used by the library, see UAVCAN_EVENT_TRACE_BUFFER_SIZE.
+ */
+typedef EventTraceImpl<EventTraceBufferSize> EventTrace;
+
+/**
+ * Records the begin event when constructed and the matching end event when destroyed, so that the duration of
+ * the enclosing scope can be computed regardless of how it was left.
+ */
+template <typename Trace>
+class UAVCAN_EXPORT EventTraceScope : Noncopyable
+{
+    const EventTraceID end_id_;
+    const uint16_t arg_;
+
+public:
+    EventTraceScope(EventTraceID begin_id, uint16_t arg)
+        : end_id_(EventTraceID(begin_id + 1))
+        , arg_(arg)
+    {
+        Trace::record(begin_id, arg_);
+    }
+
+    ~EventTraceScope() { Trace::record(end_id_, arg_); }
+};
+
+}
+
+/**
+ * Trace point macros; the arguments are not evaluated if the tracing is disabled.
+ */
+#if UAVCAN_EVENT_TRACE
+# define UAVCAN_EVENT_TRACE_POINT(event_id, arg) \
+    ::uavcan::EventTrace::record((event_id), static_cast< ::uavcan::uint16_t>(arg))
+# define UAVCAN_EVENT_TRACE_SCOPE(begin_id, arg) \
+    const ::uavcan::EventTraceScope< ::uavcan::EventTrace> \
+        uavcan_event_trace_scope_((begin_id), static_cast< ::uavcan::uint16_t>(arg))
+#else
+# define UAVCAN_EVENT_TRACE_POINT(event_id, arg)    ((void)0)
+# define UAVCAN_EVENT_TRACE_SCOPE(begin_id, arg)    ((void)0)
+#endif
+
+#endif // UAVCAN_UTIL_EVENT_TRACE_HPP_INCLUDED
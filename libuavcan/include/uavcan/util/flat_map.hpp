@@ -0,0 +1,671 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_FLAT_MAP_HPP_INCLUDED
+#define UAVCAN_UTIL_FLAT_MAP_HPP_INCLUDED
+
+#include <cassert>
+#include <cstdlib>
+#include <uavcan/util/linked_list.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/dynamic_memory.hpp>
+#include <uavcan/util/templates.hpp>
+#include <uavcan/util/placement_new.hpp>
+
+namespace uavcan
+{
+/**
+ * KV container that keeps the pairs sorted by key, an alternative to Map<> for read-mostly maps.
+ * The API is the same as that of Map<>, so the users can switch between them with a typedef.
+ *
+ * KV pairs are stored in sorted segments: the static buffer holds the lowest keys, the following segments are
+ * allocated in the node's memory pool, one block per segment. Lookup walks the segments comparing only the last
+ * key of each, then does a binary search within the segment; with the static buffer only, the complexity of the
+ * lookup is O(log N). Insertion and removal shift the pairs within one segment; a full segment is split in two.
+ * When a pair is removed from the static buffer, the lowest pairs from the memory pool are moved into it, so the
+ * use of the memory pool is minimized, same as with Map<>.
+ *
+ * Unlike Map<>, the pairs are ordered by key, so getByIndex() and find() visit them in ascending key order.
+ * Any insertion or deletion invalidates the pointers to the pairs and to their values.
+ *
+ * Type requirements:
+ *  Both key and value must be copyable, assignable and default constructible.
+ *  Key must implement the comparison operator and the less-than operator, the order must be consistent with
+ *  the comparison operator.
+ *  Key's default constructor must initialize the object into invalid state.
+ *  Size of Key + Value + padding must not exceed MemPoolBlockSize.
+ */
+template <typename Key, typename Value>
+class UAVCAN_EXPORT FlatMapBase : Noncopyable
+{
+    template <typename, typename, unsigned> friend class FlatMap;
+
+public:
+    struct KVPair
+    {
+        Value value;    // Key and value are swapped because this may allow to reduce padding (depending on types)
+        Key key;
+
+        KVPair() :
+            value(),
+            key()
+        { }
+
+        KVPair(const Key& arg_key, const Value& arg_value) :
+            value(arg_value),
+            key(arg_key)
+        { }
+
+        bool match(const Key& rhs) const { return rhs == key; }
+    };
+
+private:
+    struct Segment;
+
+    /// Same layout as the header of Segment, used to compute how many pairs fit into one block
+    struct SegmentLayout : LinkedListNode<Segment>
+    {
+        uint8_t size;
+        KVPair kvs[1];
+    };
+
+    struct Segment : LinkedListNode<Segment>
+    {
+        enum { Capacity = (MemPoolBlockSize - (sizeof(SegmentLayout) - sizeof(KVPair))) / sizeof(KVPair) };
+
+        uint8_t size;
+        KVPair kvs[Capacity];
+
+        Segment()
+            : size(0)
+        {
+            StaticAssert<(static_cast<unsigned>(Capacity) > 0)>::check();
+            StaticAssert<(static_cast<unsigned>(Capacity) <= 0xFFU)>::check();
+            IsDynamicallyAllocatable<Segment>::check();
+        }
+
+        static Segment* instantiate(IPoolAllocator& allocator)
+        {
+            void* const praw = allocator.allocate(sizeof(Segment));
+            if (praw == NULL)
+            {
+                return NULL;
+            }
+            return new (praw) Segment();
+        }
+
+        static void destroy(Segment*& obj, IPoolAllocator& allocator)
+        {
+            if (obj != NULL)
+            {
+                obj->~Segment();
+                allocator.deallocate(obj);
+                obj = NULL;
+            }
+        }
+    };
+
+    LinkedListRoot<Segment> list_;
+    IPoolAllocator& allocator_;
+#if !UAVCAN_TINY
+    KVPair* const static_;
+    const unsigned num_static_entries_;
+    unsigned num_static_pairs_;
+#endif
+
+    /**
+     * Index of the first pair whose key is not less than the specified key.
+     */
+    static unsigned lowerBound(const KVPair* kvs, unsigned size, const Key& key);
+
+    static KVPair* findInRange(KVPair* kvs, unsigned size, const Key& key);
+
+    static void insertAt(KVPair* kvs, unsigned size, unsigned index, const KVPair& kv);
+
+    static void eraseAt(KVPair* kvs, unsigned size, unsigned index);
+
+    template <typename Predicate>
+    static unsigned removeFromRange(KVPair* kvs, unsigned size, Predicate& predicate);
+
+    /**
+     * Segment is set to null if the pair is located in the static buffer.
+     */
+    KVPair* findKey(const Key& key, Segment*& out_segment);
+
+    KVPair* insertDynamic(const KVPair& kv);
+
+    void destroySegmentIfEmpty(Segment* segment);
+
+#if !UAVCAN_TINY
+    void refillStatic();
+#endif
+
+    struct YesPredicate
+    {
+        bool operator()(const Key&, const Value&) const { return true; }
+    };
+
+protected:
+#if UAVCAN_TINY
+    FlatMapBase(IPoolAllocator& allocator)
+        : allocator_(allocator)
+    {
+        UAVCAN_ASSERT(Key() == Key());
+    }
+#else
+    FlatMapBase(KVPair* static_buf, unsigned num_static_entries, IPoolAllocator& allocator)
+        : allocator_(allocator)
+        , static_(static_buf)
+        , num_static_entries_(num_static_entries)
+        , num_static_pairs_(0)
+    {
+        UAVCAN_ASSERT(Key() == Key());
+    }
+#endif
+
+    /// Derived class destructor must call clear();
+    ~FlatMapBase()
+    {
+        UAVCAN_ASSERT(getSize() == 0);
+    }
+
+public:
+    /**
+     * Returns null pointer if there's no such entry.
+     */
+    Value* access(const Key& key);
+
+    /**
+     * If entry with the same key already exists, it will be replaced
+     */
+    Value* insert(const Key& key, const Value& value);
+
+    /**
+     * Does nothing if there's no such entry.
+     */
+    void remove(const Key& key);
+
+    /**
+     * Removes entries where the predicate returns true.
+     * Predicate prototype:
+     *  bool (Key& key, Value& value)
+     */
+    template <typename Predicate>
+    void removeAllWhere(Predicate predicate);
+
+    /**
+     * Returns first entry where the predicate returns true.
+     * Predicate prototype:
+     *  bool (const Key& key, const Value& value)
+     */
+    template <typename Predicate>
+    const Key* find(Predicate predicate) const;
+
+    /**
+     * Removes all items.
+     */
+    void clear();
+
+    /**
+     * Returns a key-value pair located at the specified position in ascending key order.
+     * If index is greater than or equal the number of pairs, null pointer will be returned.
+     */
+    KVPair* getByIndex(unsigned index);
+    const KVPair* getByIndex(unsigned index) const;
+
+    /**
+     * Complexity is O(1).
+     */
+    bool isEmpty() const { return (getNumStaticPairs() == 0) && list_.isEmpty(); }
+
+    unsigned getSize() const;
+
+    /**
+     * For testing, do not use directly.
+     */
+    unsigned getNumStaticPairs() const;
+    unsigned getNumDynamicPairs() const;
+};
+
+
+template <typename Key, typename Value, unsigned NumStaticEntries = 0>
+class UAVCAN_EXPORT FlatMap : public FlatMapBase<Key, Value>
+{
+    typename FlatMapBase<Key, Value>::KVPair static_[NumStaticEntries];
+
+public:
+
+#if !UAVCAN_TINY
+
+    // This instantiation will not be valid in UAVCAN_TINY mode
+    explicit FlatMap(IPoolAllocator& allocator)
+        : FlatMapBase<Key, Value>(static_, NumStaticEntries, allocator)
+    { }
+
+    ~FlatMap() { this->clear(); }
+
+#endif // !UAVCAN_TINY
+};
+
+
+template <typename Key, typename Value>
+class UAVCAN_EXPORT FlatMap<Key, Value, 0> : public FlatMapBase<Key, Value>
+{
+public:
+    explicit FlatMap(IPoolAllocator& allocator)
+#if UAVCAN_TINY
+        : FlatMapBase<Key, Value>(allocator)
+#else
+        : FlatMapBase<Key, Value>(NULL, 0, allocator)
+#endif
+    { }
+
+    ~FlatMap() { this->clear(); }
+};
+
+// ----------------------------------------------------------------------------
+
+/*
+ * FlatMapBase<>
+ */
+template <typename Key, typename Value>
+unsigned FlatMapBase<Key, Value>::lowerBound(const KVPair* kvs, unsigned size, const Key& key)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+    // The loop has no data-dependent branches, the comparison result is only used to select the half
+    const KVPair* base = kvs;
+    while (size > 1)
+    {
+        const unsigned half = size / 2U;
+        base = (base[half].key < key) ? (base + half) : base;
+        size -= half;
+    }
+    return unsigned(base - kvs) + ((base->key < key) ? 1U : 0U);
+}
+
+template <typename Key, typename Value>
+typename FlatMapBase<Key, Value>::KVPair* FlatMapBase<Key, Value>::findInRange(KVPair* kvs, unsigned size,
+                                                                              const Key& key)
+{
+    const unsigned index = lowerBound(kvs, size, key);
+    return ((index < size) && kvs[index].match(key)) ? (kvs + index) : NULL;
+}
+
+template <typename Key, typename Value>
+void FlatMapBase<Key, Value>::insertAt(KVPair* kvs, unsigned size, unsigned index, const KVPair& kv)
+{
+    for (unsigned i = size; i > index; i--)
+    {
+        kvs[i] = kvs[i - 1U];
+    }
+    kvs[index] = kv;
+}
+
+template <typename Key, typename Value>
+void FlatMapBase<Key, Value>::eraseAt(KVPair* kvs, unsigned size, unsigned index)
+{
+    for (unsigned i = index + 1U; i < size; i++)
+    {
+        kvs[i - 1U] = kvs[i];
+    }
+    kvs[size - 1U] = KVPair();
+}
+
+template <typename Key, typename Value>
+template <typename Predicate>
+unsigned FlatMapBase<Key, Value>::removeFromRange(KVPair* kvs, unsigned size, Predicate& predicate)
+{
+    unsigned num_kept = 0;
+    for (unsigned i = 0; i < size; i++)
+    {
+        if (!predicate(kvs[i].key, kvs[i].value))
+        {
+            if (num_kept != i)
+            {
+                kvs[num_kept] = kvs[i];
+            }
+            num_kept++;
+        }
+    }
+    for (unsigned i = num_kept; i < size; i++)
+    {
+        kvs[i] = KVPair();
+    }
+    return num_kept;
+}
+
+template <typename Key, typename Value>
+typename FlatMapBase<Key, Value>::KVPair* FlatMapBase<Key, Value>::findKey(const Key& key, Segment*& out_segment)
+{
+    out_segment = NULL;
+
+#if !UAVCAN_TINY
+    if ((num_static_pairs_ > 0) && !(static_[num_static_pairs_ - 1U].key < key))
+    {
+        return findInRange(static_, num_static_pairs_, key);
+    }
+#endif
+
+    Segment* p = list_.get();
+    while (p)
+    {
+        if (!(p->kvs[p->size - 1U].key < key))
+        {
+            out_segment = p;
+            return findInRange(p->kvs, p->size, key);
+        }
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+template <typename Key, typename Value>
+typename FlatMapBase<Key, Value>::KVPair* FlatMapBase<Key, Value>::insertDynamic(const KVPair& kv)
+{
+    // The pair goes into the last segment whose first key is not greater than the new key
+    Segment* seg = list_.get();
+    if (seg == NULL)
+    {
+        seg = Segment::instantiate(allocator_);
+        if (seg == NULL)
+        {
+            return NULL;
+        }
+        list_.insert(seg);
+    }
+    else
+    {
+        while ((seg->getNextListNode() != NULL) && !(kv.key < seg->getNextListNode()->kvs[0].key))
+        {
+            seg = seg->getNextListNode();
+        }
+    }
+
+    if (seg->size >= static_cast<unsigned>(Segment::Capacity))
+    {
+        Segment* const upper = Segment::instantiate(allocator_);
+        if (upper == NULL)
+        {
+            return NULL;
+        }
+        list_.insertAfter(seg, upper);
+
+        if (seg->kvs[seg->size - 1U].key < kv.key)
+        {
+            // Appending, typical for ascending keys; keeps the segments full
+            seg = upper;
+        }
+        else
+        {
+            // Splitting in halves
+            const unsigned num_lower = seg->size / 2U;
+            for (unsigned i = num_lower; i < seg->size; i++)
+            {
+                upper->kvs[i - num_lower] = seg->kvs[i];
+                seg->kvs[i] = KVPair();
+            }
+            upper->size = static_cast<uint8_t>(seg->size - num_lower);
+            seg->size = static_cast<uint8_t>(num_lower);
+
+            if (!(kv.key < upper->kvs[0].key))
+            {
+                seg = upper;
+            }
+        }
+    }
+
+    const unsigned index = lowerBound(seg->kvs, seg->size, kv.key);
+    insertAt(seg->kvs, seg->size, index, kv);
+    seg->size++;
+    return seg->kvs + index;
+}
+
+template <typename Key, typename Value>
+void FlatMapBase<Key, Value>::destroySegmentIfEmpty(Segment* segment)
+{
+    if (segment->size == 0)
+    {
+        list_.remove(segment);
+        Segment::destroy(segment, allocator_);
+    }
+}
+
+#if !UAVCAN_TINY
+
+template <typename Key, typename Value>
+void FlatMapBase<Key, Value>::refillStatic()
+{
+    // The lowest dynamic keys are greater than any static key, so they can be appended as is
+    while ((num_static_pairs_ < num_static_entries_) && !list_.isEmpty())
+    {
+        Segment* const seg = list_.get();
+        const unsigned num_moved = min(num_static_entries_ - num_static_pairs_, unsigned(seg->size));
+
+        for (unsigned i = 0; i < num_moved; i++)
+        {
+            static_[num_static_pairs_++] = seg->kvs[i];
+        }
+        for (unsigned i = num_moved; i < seg->size; i++)
+        {
+            seg->kvs[i - num_moved] = seg->kvs[i];
+        }
+        for (unsigned i = seg->size - num_moved; i < seg->size; i++)
+        {
+            seg->kvs[i] = KVPair();
+        }
+        seg->size = static_cast<uint8_t>(seg->size - num_moved);
+
+        destroySegmentIfEmpty(seg);
+    }
+}
+
+#endif // !UAVCAN_TINY
+
+template <typename Key, typename Value>
+Value* FlatMapBase<Key, Value>::access(const Key& key)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+    Segment* seg = NULL;
+    KVPair* const kv = findKey(key, seg);
+    return kv ? &kv->value : NULL;
+}
+
+template <typename Key, typename Value>
+Value* FlatMapBase<Key, Value>::insert(const Key& key, const Value& value)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+
+    Segment* seg = NULL;
+    KVPair* const existing = findKey(key, seg);
+    if (existing)
+    {
+        existing->value = value;
+        return &existing->value;
+    }
+
+    const KVPair kv(key, value);
+
+#if !UAVCAN_TINY
+    // The static buffer holds the lowest keys
+    if ((num_static_entries_ > 0) && (list_.isEmpty() || (key < list_.get()->kvs[0].key)))
+    {
+        if (num_static_pairs_ >= num_static_entries_)
+        {
+            const KVPair& greatest = static_[num_static_pairs_ - 1U];
+            if (greatest.key < key)
+            {
+                KVPair* const dyn = insertDynamic(kv);
+                return dyn ? &dyn->value : NULL;
+            }
+
+            // The greatest static pair is pushed out into the memory pool first, so nothing is lost on failure
+            if (insertDynamic(greatest) == NULL)
+            {
+                return NULL;
+            }
+            num_static_pairs_--;
+        }
+
+        const unsigned index = lowerBound(static_, num_static_pairs_, key);
+        insertAt(static_, num_static_pairs_, index, kv);
+        num_static_pairs_++;
+        return &static_[index].value;
+    }
+#endif
+
+    KVPair* const dyn = insertDynamic(kv);
+    return dyn ? &dyn->value : NULL;
+}
+
+template <typename Key, typename Value>
+void FlatMapBase<Key, Value>::remove(const Key& key)
+{
+    UAVCAN_ASSERT(!(key == Key()));
+
+    Segment* seg = NULL;
+    KVPair* const kv = findKey(key, seg);
+    if (kv == NULL)
+    {
+        return;
+    }
+
+#if !UAVCAN_TINY
+    if (seg == NULL)
+    {
+        eraseAt(static_, num_static_pairs_, unsigned(kv - static_));
+        num_static_pairs_--;
+        refillStatic();
+        return;
+    }
+#endif
+
+    eraseAt(seg->kvs, seg->size, unsigned(kv - seg->kvs));
+    seg->size--;
+    destroySegmentIfEmpty(seg);
+}
+
+template <typename Key, typename Value>
+template <typename Predicate>
+void FlatMapBase<Key, Value>::removeAllWhere(Predicate predicate)
+{
+#if !UAVCAN_TINY
+    num_static_pairs_ = removeFromRange(static_, num_static_pairs_, predicate);
+#endif
+
+    Segment* p = list_.get();
+    while (p != NULL)
+    {
+        Segment* const next_segment = p->getNextListNode();
+
+        p->size = static_cast<uint8_t>(removeFromRange(p->kvs, p->size, predicate));
+        destroySegmentIfEmpty(p);
+
+        p = next_segment;
+    }
+
+#if !UAVCAN_TINY
+    refillStatic();
+#endif
+}
+
+template <typename Key, typename Value>
+template <typename Predicate>
+const Key* FlatMapBase<Key, Value>::find(Predicate predicate) const
+{
+#if !UAVCAN_TINY
+    for (unsigned i = 0; i < num_static_pairs_; i++)
+    {
+        if (predicate(static_[i].key, static_[i].value))
+        {
+            return &static_[i].key;
+        }
+    }
+#endif
+
+    Segment* p = list_.get();
+    while (p != NULL)
+    {
+        for (unsigned i = 0; i < p->size; i++)
+        {
+            if (predicate(p->kvs[i].key, p->kvs[i].value))
+            {
+                return &p->kvs[i].key;
+            }
+        }
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+template <typename Key, typename Value>
+void FlatMapBase<Key, Value>::clear()
+{
+    removeAllWhere(YesPredicate());
+}
+
+template <typename Key, typename Value>
+typename FlatMapBase<Key, Value>::KVPair* FlatMapBase<Key, Value>::getByIndex(unsigned index)
+{
+#if !UAVCAN_TINY
+    if (index < num_static_pairs_)
+    {
+        return static_ + index;
+    }
+    index -= num_static_pairs_;
+#endif
+
+    Segment* p = list_.get();
+    while (p != NULL)
+    {
+        if (index < p->size)
+        {
+            return p->kvs + index;
+        }
+        index -= p->size;
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+template <typename Key, typename Value>
+const typename FlatMapBase<Key, Value>::KVPair* FlatMapBase<Key, Value>::getByIndex(unsigned index) const
+{
+    return const_cast<FlatMapBase<Key, Value>*>(this)->getByIndex(index);
+}
+
+template <typename Key, typename Value>
+unsigned FlatMapBase<Key, Value>::getSize() const
+{
+    return getNumStaticPairs() + getNumDynamicPairs();
+}
+
+template <typename Key, typename Value>
+unsigned FlatMapBase<Key, Value>::getNumStaticPairs() const
+{
+#if UAVCAN_TINY
+    return 0;
+#else
+    return num_static_pairs_;
+#endif
+}
+
+template <typename Key, typename Value>
+unsigned FlatMapBase<Key, Value>::getNumDynamicPairs() const
+{
+    unsigned num = 0;
+    Segment* p = list_.get();
+    while (p)
+    {
+        num += p->size;
+        p = p->getNextListNode();
+    }
+    return num;
+}
+
+}
+
+#endif // UAVCAN_UTIL_FLAT_MAP_HPP_INCLUDED
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#ifndef UAVCAN_UTIL_LATENCY_HISTOGRAM_HPP_INCLUDED
+#define UAVCAN_UTIL_LATENCY_HISTOGRAM_HPP_INCLUDED
+
+#include <uavcan/std.hpp>
+#include <uavcan/build_config.hpp>
+#include <uavcan/time.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/**
+ * Compact histogram of latencies with logarithmic bins, 68 bytes; refer to UAVCAN_LATENCY_HISTOGRAMS.
+ *
+ * Bin 0 counts the latencies below 1 microsecond; bin N counts the latencies within [2^(N-1), 2^N) microseconds;
+ * the last bin counts all latencies from 2^(NumBins-2) microseconds (16 ms) up. Negative latencies, that may
+ * appear if the clock has been adjusted, are counted as zero.
+ */
+struct UAVCAN_EXPORT LatencyHistogram
+{
+    enum { NumBins = 16 };
+
+    uint32_t bins[NumBins];
+    uint32_t max_usec;
+
+    LatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        fill_n(bins, unsigned(NumBins), uint32_t(0));
+        max_usec = 0;
+    }
+
+    void add(MonotonicDuration latency)
+    {
+        const int64_t usec64 = latency.toUSec();
+        const uint32_t usec = (usec64 <= 0) ? 0U : ((usec64 >= int64_t(0xFFFFFFFFU)) ? 0xFFFFFFFFU : uint32_t(usec64));
+        unsigned index = 0;
+        for (uint32_t x = usec; (x != 0) && (index < unsigned(NumBins - 1)); x >>= 1)
+        {
+            index++;
+        }
+        bins[index]++;
+        max_usec = max(max_usec, usec);
+    }
+
+    uint32_t getNumSamples() const
+    {
+        uint32_t sum = 0;
+        for (unsigned i = 0; i < unsigned(NumBins); i++)
+        {
+            sum += bins[i];
+        }
+        return sum;
+    }
+
+    /**
+     * Exclusive upper bound of the specified bin in microseconds; the last bin is unbounded.
+     */
+    static uint32_t getBinUpperBoundUSec(unsigned index)
+    {
+        return (index < unsigned(NumBins - 1)) ? (uint32_t(1) << index) : 0xFFFFFFFFU;
+    }
+
+    /**
+     * Returns an upper estimate of the specified percentile (e.g. 50 for the median, 99 for the tail latency),
+     * which is precise within a factor of two. Returns zero if there are no samples.
+     */
+    uint32_t computePercentileUSec(unsigned percent) const
+    {
+        const uint64_t num_samples = getNumSamples();
+        const uint64_t target = (num_samples * min(percent, 100U) + 99U) / 100U;
+        uint64_t accumulated = 0;
+        for (unsigned i = 0; (i < unsigned(NumBins)) && (num_samples > 0); i++)
+        {
+            accumulated += bins[i];
+            if ((accumulated >= target) && (accumulated > 0))
+            {
+                return min(getBinUpperBoundUSec(i), max_usec);
+            }
+        }
+        return max_usec;
+    }
+};
+
+}
+
+#endif // UAVCAN_UTIL_LATENCY_HISTOGRAM_HPP_INCLUDED
@@ -1,5 +1,5 @@
 /*
- * Singly-linked list.
+ * Intrusive linked lists.
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
@@ -57,6 +57,12 @@ public:
      */
     unsigned getLength() const;
 
+    /**
+     * Whether the node belongs to this list.
+     * Complexity: O(N)
+     */
+    bool contains(const T* node) const;
+
     /**
      * Inserts the node to the beginning of the list.
      * If the node is already present in the list, it will be relocated to the beginning.
@@ -72,6 +78,13 @@ public:
     template <typename Predicate>
     void insertBefore(T* node, Predicate predicate);
 
+    /**
+     * Inserts the node immediately after the specified node, or to the beginning of the list if the specified node
+     * is NULL. The specified node must belong to this list, and the inserted node must not belong to this list.
+     * Complexity: O(1)
+     */
+    void insertAfter(T* existing, T* node);
+
     /**
      * Removes only the first occurence of the node.
      * Complexity: O(N)
@@ -79,6 +92,120 @@ public:
     void remove(const T* node);
 };
 
+template <typename T>
+class UAVCAN_EXPORT DoublyLinkedListRoot;
+
+/**
+ * Same as @ref LinkedListNode, with the back link that allows to remove the node in constant time.
+ * The links can be modified only by the list root.
+ */
+template <typename T>
+class UAVCAN_EXPORT DoublyLinkedListNode
+{
+    friend class DoublyLinkedListRoot<T>;
+
+    T* next_;
+    T* prev_;
+
+protected:
+    DoublyLinkedListNode()
+        : next_(NULL)
+        , prev_(NULL)
+    { }
+
+    ~DoublyLinkedListNode() { }
+
+public:
+    T* getNextListNode() const { return next_; }
+    T* getPrevListNode() const { return prev_; }
+};
+
+/**
+ * Doubly-linked list root, the interface is the same as that of @ref LinkedListRoot.
+ * A node can belong to at most one list at a time.
+ * The removed node keeps the forward link, so that the list can still be traversed past a node that was removed
+ * during the traversal, exactly like in the case of the singly-linked list.
+ */
+template <typename T>
+class UAVCAN_EXPORT DoublyLinkedListRoot
+{
+    T* root_;
+
+    static DoublyLinkedListNode<T>& links(const T* node)
+    {
+        return *static_cast<DoublyLinkedListNode<T>*>(const_cast<T*>(node));
+    }
+
+    void link(T* node, T* prev, T* next);
+
+public:
+    DoublyLinkedListRoot()
+        : root_(NULL)
+    { }
+
+    T* get() const { return root_; }
+    bool isEmpty() const { return get() == NULL; }
+
+    /**
+     * Complexity: O(N)
+     */
+    unsigned getLength() const;
+
+    /**
+     * Whether the node belongs to this list.
+     * Complexity: O(1)
+     */
+    bool contains(const T* node) const
+    {
+        return (node != NULL) && ((node == root_) || (links(node).prev_ != NULL));
+    }
+
+    /**
+     * Inserts the node to the beginning of the list.
+     * If the node is already present in the list, it will be relocated to the beginning.
+     * Complexity: O(1)
+     */
+    void insert(T* node);
+
+    /**
+     * Inserts the node immediately before the node X where predicate(X) returns true.
+     * If the node is already present in the list, it can be relocated to a new position.
+     * Complexity: O(N)
+     */
+    template <typename Predicate>
+    void insertBefore(T* node, Predicate predicate);
+
+    /**
+     * Inserts the node immediately after the specified node, or to the beginning of the list if the specified node
+     * is NULL. The specified node must belong to this list, and the inserted node must not belong to this list.
+     * Complexity: O(1)
+     */
+    void insertAfter(T* existing, T* node);
+
+    /**
+     * Removes the node if it belongs to this list.
+     * Complexity: O(1)
+     */
+    void remove(const T* node);
+};
+
+/**
+ * The lists where nodes are removed often, e.g. on every transmitted frame or when a timer is stopped, use these
+ * types. Depending on UAVCAN_DOUBLY_LINKED_LISTS, these are either doubly-linked (constant time removal at the cost
+ * of one pointer per node) or singly-linked lists.
+ */
+template <typename T>
+struct UAVCAN_EXPORT FastRemovalLinkedList
+{
+#if UAVCAN_DOUBLY_LINKED_LISTS
+    typedef DoublyLinkedListNode<T> Node;
+    typedef DoublyLinkedListRoot<T> Root;
+#else
+    typedef LinkedListNode<T> Node;
+    typedef LinkedListRoot<T> Root;
+#endif
+};
+
 // ----------------------------------------------------------------------------
 
 /*
@@ -97,6 +224,21 @@ unsigned LinkedListRoot<T>::getLength() const
     return cnt;
 }
 
+template <typename T>
+bool LinkedListRoot<T>::contains(const T* node) const
+{
+    const T* p = root_;
+    while (p != NULL)
+    {
+        if (p == node)
+        {
+            return true;
+        }
+        p = p->getNextListNode();
+    }
+    return false;
+}
+
 template <typename T>
 void LinkedListRoot<T>::insert(T* node)
 {
@@ -143,6 +285,28 @@ void LinkedListRoot<T>::insertBefore(T* node, Predicate predicate)
     }
 }
 
+template <typename T>
+void LinkedListRoot<T>::insertAfter(T* existing, T* node)
+{
+    if (node == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+
+    if (existing == NULL)
+    {
+        node->setNextListNode(root_);
+        root_ = node;
+    }
+    else
+    {
+        UAVCAN_ASSERT(existing != node);
+        node->setNextListNode(existing->getNextListNode());
+        existing->setNextListNode(node);
+    }
+}
+
 template <typename T>
 void LinkedListRoot<T>::remove(const T* node)
 {
@@ -170,6 +334,124 @@ void LinkedListRoot<T>::remove(const T* node)
     }
 }
 
+/*
+ * DoublyLinkedListRoot<>
+ */
+template <typename T>
+void DoublyLinkedListRoot<T>::link(T* node, T* prev, T* next)
+{
+    links(node).prev_ = prev;
+    links(node).next_ = next;
+    if (prev == NULL)
+    {
+        root_ = node;
+    }
+    else
+    {
+        links(prev).next_ = node;
+    }
+    if (next != NULL)
+    {
+        links(next).prev_ = node;
+    }
+}
+
+template <typename T>
+unsigned DoublyLinkedListRoot<T>::getLength() const
+{
+    T* node = root_;
+    unsigned cnt = 0;
+    while (node)
+    {
+        cnt++;
+        node = node->getNextListNode();
+    }
+    return cnt;
+}
+
+template <typename T>
+void DoublyLinkedListRoot<T>::insert(T* node)
+{
+    if (node == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    remove(node);
+    link(node, NULL, root_);
+}
+
+template <typename T>
+template <typename Predicate>
+void DoublyLinkedListRoot<T>::insertBefore(T* node, Predicate predicate)
+{
+    if (node == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+
+    remove(node);
+
+    T* prev = NULL;
+    T* next = root_;
+    while ((next != NULL) && !predicate(next))
+    {
+        prev = next;
+        next = next->getNextListNode();
+    }
+    link(node, prev, next);
+}
+
+template <typename T>
+void DoublyLinkedListRoot<T>::insertAfter(T* existing, T* node)
+{
+    if (node == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    UAVCAN_ASSERT(existing != node);
+    UAVCAN_ASSERT(!contains(node));
+    UAVCAN_ASSERT((existing == NULL) || contains(existing));
+    link(node, existing, (existing == NULL) ? root_ : existing->getNextListNode());
+}
+
+template <typename T>
+void DoublyLinkedListRoot<T>::remove(const T* node)
+{
+    if (!contains(node))
+    {
+        return;
+    }
+#if UAVCAN_DEBUG
+    {
+        // The node must not belong to another list
+        const T* p = node;
+        while (p->getPrevListNode() != NULL)
+        {
+            p = p->getPrevListNode();
+        }
+        UAVCAN_ASSERT(p == root_);
+    }
+#endif
+    T* const prev = links(node).prev_;
+    T* const next = links(node).next_;
+    if (prev == NULL)
+    {
+        root_ = next;
+    }
+    else
+    {
+        links(prev).next_ = next;
+    }
+    if (next != NULL)
+    {
+        links(next).prev_ = prev;
+    }
+    links(node).prev_ = NULL;       // The forward link is kept, see the class description
+}
+
 }
 
 #endif // UAVCAN_UTIL_LINKED_LIST_HPP_INCLUDED
@@ -100,11 +100,18 @@ private:
         }
     };
 
+public:
+    /**
+     * Number of KV pairs that share one memory pool block, see @ref MemoryBudget.
+     */
+    enum { NumKVPerPoolBlock = KVGroup::NumKV };
+
+private:
     LinkedListRoot<KVGroup> list_;
     IPoolAllocator& allocator_;
 #if !UAVCAN_TINY
-    KVPair* const static_;
-    const unsigned num_static_entries_;
+    KVPair* static_;
+    unsigned num_static_entries_;
 #endif
 
     KVPair* findKey(const Key& key);
@@ -136,6 +143,18 @@ protected:
     }
 #endif
 
+#if !UAVCAN_TINY
+    /**
+     * Replaces the static storage, e.g. with one sized at run time. The map must be empty.
+     */
+    void setStaticStorage(KVPair* static_buf, unsigned num_static_entries)
+    {
+        UAVCAN_ASSERT(isEmpty());
+        static_ = static_buf;
+        num_static_entries_ = num_static_entries;
+    }
+#endif
+
     /// Derived class destructor must call clear();
     ~MapBase()
     {
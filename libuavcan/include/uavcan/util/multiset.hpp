@@ -7,6 +7,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <uavcan/std.hpp>
 #include <uavcan/util/linked_list.hpp>
 #include <uavcan/build_config.hpp>
 #include <uavcan/dynamic_memory.hpp>
@@ -20,20 +21,58 @@
 namespace uavcan
 {
 /**
- * Slow but memory efficient unordered multiset. Unlike Map<>, this container does not move objects, so
+ * Memory efficient unordered multiset. Unlike Map<>, this container does not move objects, so
  * they don't have to be copyable.
  *
  * Items can be allocated in a static buffer or in the node's memory pool if the static buffer is exhausted.
+ * Occupied slots are tracked with bitmaps, one per chunk and one per 32 static entries, so that the search for
+ * a free slot and the iteration skip the empty slots and the empty chunks quickly; the complexity of all
+ * operations is still linear in the number of chunks.
  *
  * Number of static entries must not be less than 1.
  */
 template <typename T, unsigned NumStaticEntries>
 class UAVCAN_EXPORT Multiset : Noncopyable
 {
-    struct Item : ::uavcan::Noncopyable
+    typedef uint32_t Bitmap;
+
+    enum { BitmapWidth = 32 };
+
+    static unsigned countTrailingZeros(Bitmap x)
+    {
+        UAVCAN_ASSERT(x != 0);
+#if defined(__GNUC__)
+        return unsigned(__builtin_ctz(x));
+#else
+        unsigned n = 0;
+        while ((x & 1U) == 0)
+        {
+            x >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    static unsigned countSetBits(Bitmap x)
     {
-        T* ptr;
+#if defined(__GNUC__)
+        return unsigned(__builtin_popcount(x));
+#else
+        unsigned n = 0;
+        for (; x != 0; x &= x - 1U)
+        {
+            n++;
+        }
+        return n;
+#endif
+    }
 
+    /**
+     * Storage of one object; whether it is constructed is recorded in the owner's bitmap.
+     */
+    struct Item : ::uavcan::Noncopyable
+    {
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
         alignas(T) unsigned char pool[sizeof(T)];       ///< Memory efficient version
 #else
@@ -50,38 +89,58 @@ class UAVCAN_EXPORT Multiset : Noncopyable
         };
 #endif
 
-        Item()
-            : ptr(NULL)
-        {
-            fill_n(pool, sizeof(pool), static_cast<unsigned char>(0));
-        }
+        T* get() { return reinterpret_cast<T*>(pool); }
+    };
+
+    /**
+     * A group of slots sharing one bitmap; bit N is set if the slot N is occupied.
+     */
+    struct Slot
+    {
+        Item* item;
+        Bitmap* bitmap;
+        Bitmap mask;
+
+        Slot()
+            : item(NULL)
+            , bitmap(NULL)
+            , mask(0)
+        { }
 
-        ~Item() { destroy(); }
+        Slot(Item* arg_item, Bitmap* arg_bitmap, Bitmap arg_mask)
+            : item(arg_item)
+            , bitmap(arg_bitmap)
+            , mask(arg_mask)
+        { }
+    };
 
-        bool isConstructed() const { return ptr != NULL; }
+    struct Chunk;
 
-        void destroy()
-        {
-            if (ptr != NULL)
-            {
-                ptr->~T();
-                ptr = NULL;
-                fill_n(pool, sizeof(pool), static_cast<unsigned char>(0));
-            }
-        }
+    /// Same layout as the header of Chunk, used to compute how many items fit into one block
+    struct ChunkLayout : LinkedListNode<Chunk>
+    {
+        Bitmap occupied;
+        Item items[1];
     };
 
-private:
     struct Chunk : LinkedListNode<Chunk>, ::uavcan::Noncopyable
     {
-        enum { NumItems = (MemPoolBlockSize - sizeof(LinkedListNode<Chunk>)) / sizeof(Item) };
+        enum
+        {
+            HeaderSize = sizeof(ChunkLayout) - sizeof(Item),
+            NumItemsThatFit = (MemPoolBlockSize - HeaderSize) / sizeof(Item),
+            NumItems = (unsigned(NumItemsThatFit) < unsigned(BitmapWidth)) ? unsigned(NumItemsThatFit) :
+                                                                             unsigned(BitmapWidth)
+        };
+
+        Bitmap occupied;
         Item items[NumItems];
 
         Chunk()
+            : occupied(0)
         {
             StaticAssert<(static_cast<unsigned>(NumItems) > 0)>::check();
             IsDynamicallyAllocatable<Chunk>::check();
-            UAVCAN_ASSERT(!items[0].isConstructed());
         }
 
         static Chunk* instantiate(IPoolAllocator& allocator)
@@ -104,30 +163,51 @@ private:
             }
         }
 
-        Item* findFreeSlot()
+        static Bitmap getFullMask()
         {
-            for (unsigned i = 0; i < static_cast<unsigned>(NumItems); i++)
-            {
-                if (!items[i].isConstructed())
-                {
-                    return items + i;
-                }
-            }
-            return NULL;
+            return (static_cast<unsigned>(NumItems) >= static_cast<unsigned>(BitmapWidth)) ?
+                   ~Bitmap(0) : static_cast<Bitmap>((Bitmap(1) << NumItems) - 1U);
         }
     };
 
+    enum { NumStaticBitmaps = (NumStaticEntries + BitmapWidth - 1) / BitmapWidth };
+
     /*
      * Data
      */
     LinkedListRoot<Chunk> list_;
     IPoolAllocator& allocator_;
     Item static_[NumStaticEntries];
+    Bitmap static_occupied_[NumStaticBitmaps];
 
     /*
      * Methods
      */
-    Item* findOrCreateFreeSlot();
+    static Bitmap getStaticMask(unsigned bitmap_index)
+    {
+        const unsigned num = NumStaticEntries - bitmap_index * unsigned(BitmapWidth);
+        return (num >= unsigned(BitmapWidth)) ? ~Bitmap(0) : static_cast<Bitmap>((Bitmap(1) << num) - 1U);
+    }
+
+    Slot findOrCreateFreeSlot();
+
+    template <typename Predicate>
+    T* findInGroup(Predicate& predicate, Item* items, const Bitmap occupied);
+
+    template <typename Predicate>
+    unsigned removeInGroup(Predicate& predicate, Item* items, Bitmap& occupied, bool remove_one);
+
+    template <typename Predicate>
+    bool removeItemIf(Predicate& predicate, Item& item, Bitmap& occupied, Bitmap mask)
+    {
+        if (((occupied & mask) != 0) && predicate(*item.get()))
+        {
+            occupied &= ~mask;                  // Cleared first, in case if the destructor accesses the container
+            item.get()->~T();
+            return true;
+        }
+        return false;
+    }
 
     void compact();
 
@@ -193,7 +273,9 @@ private:
 public:
     Multiset(IPoolAllocator& allocator)
         : allocator_(allocator)
-    { }
+    {
+        fill_n(static_occupied_, unsigned(NumStaticBitmaps), Bitmap(0));
+    }
 
     ~Multiset()
     {
@@ -207,53 +289,57 @@ public:
      */
     T* emplace()
     {
-        Item* const item = findOrCreateFreeSlot();
-        if (item == NULL)
+        const Slot slot = findOrCreateFreeSlot();
+        if (slot.item == NULL)
         {
             return NULL;
         }
-        UAVCAN_ASSERT(item->ptr == NULL);
-        item->ptr = new (item->pool) T();
-        return item->ptr;
+        UAVCAN_ASSERT((*slot.bitmap & slot.mask) == 0);
+        T* const ptr = new (slot.item->pool) T();
+        *slot.bitmap |= slot.mask;
+        return ptr;
     }
 
     template <typename P1>
     T* emplace(P1 p1)
     {
-        Item* const item = findOrCreateFreeSlot();
-        if (item == NULL)
+        const Slot slot = findOrCreateFreeSlot();
+        if (slot.item == NULL)
         {
             return NULL;
         }
-        UAVCAN_ASSERT(item->ptr == NULL);
-        item->ptr = new (item->pool) T(p1);
-        return item->ptr;
+        UAVCAN_ASSERT((*slot.bitmap & slot.mask) == 0);
+        T* const ptr = new (slot.item->pool) T(p1);
+        *slot.bitmap |= slot.mask;
+        return ptr;
     }
 
     template <typename P1, typename P2>
     T* emplace(P1 p1, P2 p2)
     {
-        Item* const item = findOrCreateFreeSlot();
-        if (item == NULL)
+        const Slot slot = findOrCreateFreeSlot();
+        if (slot.item == NULL)
         {
             return NULL;
         }
-        UAVCAN_ASSERT(item->ptr == NULL);
-        item->ptr = new (item->pool) T(p1, p2);
-        return item->ptr;
+        UAVCAN_ASSERT((*slot.bitmap & slot.mask) == 0);
+        T* const ptr = new (slot.item->pool) T(p1, p2);
+        *slot.bitmap |= slot.mask;
+        return ptr;
     }
 
     template <typename P1, typename P2, typename P3>
     T* emplace(P1 p1, P2 p2, P3 p3)
     {
-        Item* const item = findOrCreateFreeSlot();
-        if (item == NULL)
+        const Slot slot = findOrCreateFreeSlot();
+        if (slot.item == NULL)
         {
             return NULL;
         }
-        UAVCAN_ASSERT(item->ptr == NULL);
-        item->ptr = new (item->pool) T(p1, p2, p3);
-        return item->ptr;
+        UAVCAN_ASSERT((*slot.bitmap & slot.mask) == 0);
+        T* const ptr = new (slot.item->pool) T(p1, p2, p3);
+        *slot.bitmap |= slot.mask;
+        return ptr;
     }
 
     /**
@@ -331,7 +417,7 @@ public:
 
     /**
      * Counts number of items stored.
-     * Best case complexity is O(N).
+     * Complexity is O(N) of the number of chunks.
      */
     unsigned getSize() const { return getNumStaticItems() + getNumDynamicItems(); }
 
@@ -348,15 +434,17 @@ public:
  * Multiset<>
  */
 template <typename T, unsigned NumStaticEntries>
-typename Multiset<T, NumStaticEntries>::Item* Multiset<T, NumStaticEntries>::findOrCreateFreeSlot()
+typename Multiset<T, NumStaticEntries>::Slot Multiset<T, NumStaticEntries>::findOrCreateFreeSlot()
 {
 #if !UAVCAN_TINY
     // Search in static pool
-    for (unsigned i = 0; i < NumStaticEntries; i++)
+    for (unsigned i = 0; i < unsigned(NumStaticBitmaps); i++)
     {
-        if (!static_[i].isConstructed())
+        const Bitmap free_slots = ~static_occupied_[i] & getStaticMask(i);
+        if (free_slots != 0)
         {
-            return &static_[i];
+            const unsigned bit = countTrailingZeros(free_slots);
+            return Slot(&static_[i * unsigned(BitmapWidth) + bit], &static_occupied_[i], Bitmap(Bitmap(1) << bit));
         }
     }
 #endif
@@ -366,10 +454,11 @@ typename Multiset<T, NumStaticEntries>::Item* Multiset<T, NumStaticEntries>::fin
         Chunk* p = list_.get();
         while (p)
         {
-            Item* const dyn = p->findFreeSlot();
-            if (dyn != NULL)
+            const Bitmap free_slots = ~p->occupied & Chunk::getFullMask();
+            if (free_slots != 0)
             {
-                return dyn;
+                const unsigned bit = countTrailingZeros(free_slots);
+                return Slot(&p->items[bit], &p->occupied, Bitmap(Bitmap(1) << bit));
             }
             p = p->getNextListNode();
         }
@@ -379,29 +468,60 @@ typename Multiset<T, NumStaticEntries>::Item* Multiset<T, NumStaticEntries>::fin
     Chunk* const chunk = Chunk::instantiate(allocator_);
     if (chunk == NULL)
     {
-        return NULL;
+        return Slot();
     }
     list_.insert(chunk);
-    return &chunk->items[0];
+    return Slot(&chunk->items[0], &chunk->occupied, 1U);
 }
 
 template <typename T, unsigned NumStaticEntries>
-void Multiset<T, NumStaticEntries>::compact()
+template <typename Predicate>
+T* Multiset<T, NumStaticEntries>::findInGroup(Predicate& predicate, Item* items, const Bitmap occupied)
 {
-    Chunk* p = list_.get();
-    while (p)
+    Bitmap pending = occupied;
+    while (pending != 0)
     {
-        Chunk* const next = p->getNextListNode();
-        bool remove_this = true;
-        for (int i = 0; i < Chunk::NumItems; i++)
+        const unsigned bit = countTrailingZeros(pending);
+        pending &= pending - 1U;
+        if (predicate(*items[bit].get()))
+        {
+            return items[bit].get();
+        }
+    }
+    return NULL;
+}
+
+template <typename T, unsigned NumStaticEntries>
+template <typename Predicate>
+unsigned Multiset<T, NumStaticEntries>::removeInGroup(Predicate& predicate, Item* items, Bitmap& occupied,
+                                                      bool remove_one)
+{
+    unsigned num_removed = 0;
+    Bitmap pending = occupied;
+    while (pending != 0)
+    {
+        const unsigned bit = countTrailingZeros(pending);
+        pending &= pending - 1U;
+        if (removeItemIf(predicate, items[bit], occupied, Bitmap(Bitmap(1) << bit)))
         {
-            if (p->items[i].isConstructed())
+            num_removed++;
+            if (remove_one)
             {
-                remove_this = false;
                 break;
             }
         }
-        if (remove_this)
+    }
+    return num_removed;
+}
+
+template <typename T, unsigned NumStaticEntries>
+void Multiset<T, NumStaticEntries>::compact()
+{
+    Chunk* p = list_.get();
+    while (p)
+    {
+        Chunk* const next = p->getNextListNode();
+        if (p->occupied == 0)
         {
             list_.remove(p);
             Chunk::destroy(p, allocator_);
@@ -414,22 +534,16 @@ template <typename T, unsigned NumStaticEntries>
 template <typename Predicate>
 void Multiset<T, NumStaticEntries>::removeWhere(Predicate predicate, const RemoveStrategy strategy)
 {
+    const bool remove_one = strategy == RemoveOne;
     unsigned num_removed = 0;
 
 #if !UAVCAN_TINY
-    for (unsigned i = 0; i < NumStaticEntries; i++)
+    for (unsigned i = 0; i < unsigned(NumStaticBitmaps); i++)
     {
-        if (static_[i].isConstructed())
+        num_removed += removeInGroup(predicate, &static_[i * unsigned(BitmapWidth)], static_occupied_[i], remove_one);
+        if ((num_removed > 0) && remove_one)
         {
-            if (predicate(*static_[i].ptr))
-            {
-                num_removed++;
-                static_[i].destroy();
-                if (strategy == RemoveOne)
-                {
-                    break;
-                }
-            }
+            break;
         }
     }
 #endif
@@ -439,27 +553,12 @@ void Multiset<T, NumStaticEntries>::removeWhere(Predicate predicate, const Remov
     {
         Chunk* const next_chunk = p->getNextListNode(); // For the case if the current entry gets modified
 
-        if ((num_removed > 0) && (strategy == RemoveOne))
+        if ((num_removed > 0) && remove_one)
         {
             break;
         }
 
-        for (int i = 0; i < Chunk::NumItems; i++)
-        {
-            Item& item = p->items[i];
-            if (item.isConstructed())
-            {
-                if (predicate(*item.ptr))
-                {
-                    num_removed++;
-                    item.destroy();
-                    if (strategy == RemoveOne)
-                    {
-                        break;
-                    }
-                }
-            }
-        }
+        num_removed += removeInGroup(predicate, p->items, p->occupied, remove_one);
 
         p = next_chunk;
     }
@@ -475,14 +574,12 @@ template <typename Predicate>
 T* Multiset<T, NumStaticEntries>::find(Predicate predicate)
 {
 #if !UAVCAN_TINY
-    for (unsigned i = 0; i < NumStaticEntries; i++)
+    for (unsigned i = 0; i < unsigned(NumStaticBitmaps); i++)
     {
-        if (static_[i].isConstructed())
+        T* const ptr = findInGroup(predicate, &static_[i * unsigned(BitmapWidth)], static_occupied_[i]);
+        if (ptr != NULL)
         {
-            if (predicate(*static_[i].ptr))
-            {
-                return static_[i].ptr;
-            }
+            return ptr;
         }
     }
 #endif
@@ -492,15 +589,10 @@ T* Multiset<T, NumStaticEntries>::find(Predicate predicate)
     {
         Chunk* const next_chunk = p->getNextListNode(); // For the case if the current entry gets modified
 
-        for (int i = 0; i < Chunk::NumItems; i++)
+        T* const ptr = findInGroup(predicate, p->items, p->occupied);
+        if (ptr != NULL)
         {
-            if (p->items[i].isConstructed())
-            {
-                if (predicate(*p->items[i].ptr))
-                {
-                    return p->items[i].ptr;
-                }
-            }
+            return ptr;
         }
 
         p = next_chunk;
@@ -513,9 +605,9 @@ unsigned Multiset<T, NumStaticEntries>::getNumStaticItems() const
 {
     unsigned num = 0;
 #if !UAVCAN_TINY
-    for (unsigned i = 0; i < NumStaticEntries; i++)
+    for (unsigned i = 0; i < unsigned(NumStaticBitmaps); i++)
     {
-        num += static_[i].isConstructed() ? 1U : 0U;
+        num += countSetBits(static_occupied_[i]);
     }
 #endif
     return num;
@@ -528,10 +620,7 @@ unsigned Multiset<T, NumStaticEntries>::getNumDynamicItems() const
     Chunk* p = list_.get();
     while (p)
     {
-        for (int i = 0; i < Chunk::NumItems; i++)
-        {
-            num += p->items[i].isConstructed() ? 1U : 0U;
-        }
+        num += countSetBits(p->occupied);
         p = p->getNextListNode();
     }
     return num;
@@ -14,8 +14,32 @@ const uint32_t CanFrame::MaskExtID;
 const uint32_t CanFrame::FlagEFF;
 const uint32_t CanFrame::FlagRTR;
 const uint32_t CanFrame::FlagERR;
+const uint8_t CanFrame::MaxClassicDataLen;
 const uint8_t CanFrame::MaxDataLen;
 
+uint8_t CanFrame::dlcToDataLength(uint8_t dlc)
+{
+    static const uint8_t Table[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+    return Table[dlc & 15U];
+}
+
+uint8_t CanFrame::dataLengthToDlc(uint8_t data_length)
+{
+    if (data_length <= 8)
+    {
+        return data_length;
+    }
+    if (data_length <= 24)
+    {
+        return uint8_t(9U + (unsigned(data_length) - 9U) / 4U);    // 12, 16, 20, 24
+    }
+    if (data_length <= 32)
+    {
+        return 13;
+    }
+    return (data_length <= 48) ? 14 : 15;
+}
+
 bool CanFrame::priorityHigherThan(const CanFrame& rhs) const
 {
     const uint32_t clean_id     = id     & MaskExtID;
@@ -61,9 +85,9 @@ std::string CanFrame::toString(StringRepresentation mode) const
 {
     UAVCAN_ASSERT(mode == StrTight || mode == StrAligned);
 
-    static const unsigned AsciiColumnOffset = 36U;
+    static const unsigned AsciiColumnOffset = 12U + MaxDataLen * 3U;
 
-    char buf[50];
+    char buf[26U + MaxDataLen * 4U];
     char* wpos = buf;
     char* const epos = buf + sizeof(buf);
     fill(buf, buf + sizeof(buf), '\0');
@@ -115,4 +139,20 @@ std::string CanFrame::toString(StringRepresentation mode) const
 }
 #endif
 
+/*
+ * CanRxFrame
+ */
+#if UAVCAN_TOSTRING
+std::string CanRxFrame::toString(StringRepresentation mode) const
+{
+    std::string out = CanFrame::toString(mode);
+    out.reserve(128);
+    out += " ts_m="   + ts_mono.toString();
+    out += " ts_utc=" + ts_utc.toString();
+    out += " iface=";
+    out += char('0' + iface_index);
+    return out;
+}
+#endif
+
 }
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/marshal/array.hpp>
+
+namespace uavcan
+{
+namespace
+{
+
+IPoolAllocator* dynamic_array_allocator = NULL;
+uint32_t dynamic_array_allocation_failures = 0;
+
+}
+
+IPoolAllocator* DynamicArrayAllocator::getAllocator()
+{
+    return dynamic_array_allocator;
+}
+
+void DynamicArrayAllocator::setAllocator(IPoolAllocator* allocator)
+{
+    dynamic_array_allocator = allocator;
+}
+
+uint32_t DynamicArrayAllocator::getNumFailures()
+{
+    return dynamic_array_allocation_failures;
+}
+
+void* DynamicArrayAllocator::allocate(std::size_t size)
+{
+    void* const ptr = (dynamic_array_allocator != NULL) ? dynamic_array_allocator->allocate(size) : NULL;
+    if (ptr == NULL)
+    {
+        dynamic_array_allocation_failures++;
+    }
+    return ptr;
+}
+
+void DynamicArrayAllocator::deallocate(const void* ptr)
+{
+    if (ptr != NULL)
+    {
+        UAVCAN_ASSERT(dynamic_array_allocator != NULL);
+        if (dynamic_array_allocator != NULL)
+        {
+            dynamic_array_allocator->deallocate(ptr);
+        }
+    }
+}
+
+}
@@ -126,6 +126,76 @@ void bitarrayCopy(const unsigned char* src_org, unsigned src_offset, unsigned sr
  * Functions below were manually optimized in the most horrible way.
  */
 
+/*
+ * The middle section of unaligned copies is processed one machine word at a time while at least one word is left.
+ * Bits are ordered starting from the most significant one, so the words are loaded and stored as big endian.
+ * Loads and stores are written out byte by byte, so the compiler can turn them into word accesses with a byte swap.
+ */
+template <unsigned Size> struct BigEndianWord;
+
+template <>
+struct BigEndianWord<4>
+{
+    typedef uint32_t Type;
+
+    static Type load(const unsigned char* p)
+    {
+        return Type((Type(p[0]) << 24) | (Type(p[1]) << 16) | (Type(p[2]) << 8) | Type(p[3]));
+    }
+
+    static void store(unsigned char* p, Type w)
+    {
+        p[0] = static_cast<unsigned char>(w >> 24);
+        p[1] = static_cast<unsigned char>(w >> 16);
+        p[2] = static_cast<unsigned char>(w >> 8);
+        p[3] = static_cast<unsigned char>(w);
+    }
+};
+
+template <>
+struct BigEndianWord<8>
+{
+    typedef uint64_t Type;
+
+    static Type load(const unsigned char* p)
+    {
+        return Type((Type(p[0]) << 56) | (Type(p[1]) << 48) | (Type(p[2]) << 40) | (Type(p[3]) << 32) |
+                    (Type(p[4]) << 24) | (Type(p[5]) << 16) | (Type(p[6]) << 8)  | Type(p[7]));
+    }
+
+    static void store(unsigned char* p, Type w)
+    {
+        p[0] = static_cast<unsigned char>(w >> 56);
+        p[1] = static_cast<unsigned char>(w >> 48);
+        p[2] = static_cast<unsigned char>(w >> 40);
+        p[3] = static_cast<unsigned char>(w >> 32);
+        p[4] = static_cast<unsigned char>(w >> 24);
+        p[5] = static_cast<unsigned char>(w >> 16);
+        p[6] = static_cast<unsigned char>(w >> 8);
+        p[7] = static_cast<unsigned char>(w);
+    }
+};
+
+typedef BigEndianWord<(sizeof(void*) >= 8) ? 8 : 4> NativeWord;
+typedef NativeWord::Type Word;
+
+/**
+ * Does the same as the byte-wise middle loops below: dst[i] = (src[i] << shift) | (src[i + 1] >> (8 - shift)).
+ * The shift must be within [1, 7].
+ */
+static inline void copyShiftedWords(const unsigned char*& src, unsigned char*& dst, int& byte_len,
+                                    const unsigned shift)
+{
+    while (byte_len >= int(sizeof(Word)))
+    {
+        const Word w = Word(NativeWord::load(src) << shift) | Word(src[sizeof(Word)] >> (CHAR_BIT - shift));
+        NativeWord::store(dst, w);
+        src += sizeof(Word);
+        dst += sizeof(Word);
+        byte_len -= int(sizeof(Word));
+    }
+}
+
 void bitarrayCopyAlignedToUnaligned(const unsigned char* src_org, unsigned src_len,
                                     unsigned char* dst_org, unsigned dst_offset)
 {
@@ -173,6 +243,8 @@ void bitarrayCopyAlignedToUnaligned(const unsigned char* src_org, unsigned src_l
 
             int byte_len = int(src_len / CHAR_BIT);
 
+            copyShiftedWords(src_org, dst, byte_len, bit_diff_ls);
+
             while (--byte_len >= 0)
             {
                 c = static_cast<unsigned char>(*src_org++ << bit_diff_ls);
@@ -243,6 +315,8 @@ void bitarrayCopyUnalignedToAligned(const unsigned char* src_org, unsigned src_o
 
             int byte_len = int(src_len / CHAR_BIT);
 
+            copyShiftedWords(src, dst_org, byte_len, src_offset_modulo);
+
             while (--byte_len >= 0)
             {
                 c = static_cast<unsigned char>(*src++ << src_offset_modulo);
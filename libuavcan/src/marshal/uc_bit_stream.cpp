@@ -38,6 +38,8 @@ int BitStream::write(const uint8_t* bytes, const unsigned bitlen)
      * Note that if this write was unaligned, last written byte in the buffer will be rewritten with updated value
      * within the next write() operation.
      */
+    span_len_ = 0;                      // The buffer is being modified, the span may be stale
+
     const int write_res = buf_.write(bit_offset_ / 8, tmp, bytelen);
     if (write_res < 0)
     {
@@ -56,25 +58,97 @@ int BitStream::read(uint8_t* bytes, const unsigned bitlen)
 {
     uint8_t tmp[MaxBytesPerRW + 1];
 
+    const unsigned byte_offset = bit_offset_ / 8;
     const unsigned bytelen = bitlenToBytelen(bitlen + (bit_offset_ % 8));
     UAVCAN_ASSERT(MaxBytesPerRW >= bytelen);
 
-    const int read_res = buf_.read(bit_offset_ / 8, tmp, bytelen);
-    if (read_res < 0)
+    if (!isWithinSpan(byte_offset, bytelen))
     {
-        return read_res;
+        span_len_ = buf_.getContiguousSpan(byte_offset, span_data_);
+        span_offset_ = byte_offset;
     }
-    if (static_cast<unsigned>(read_res) < bytelen)
+
+    const uint8_t* src = NULL;
+    if (isWithinSpan(byte_offset, bytelen))
     {
-        return ResultOutOfBuffer;
+        src = span_data_ + (byte_offset - span_offset_);
+    }
+    else
+    {
+        // The requested bytes are not contiguous or the buffer does not support direct access
+        const int read_res = buf_.read(byte_offset, tmp, bytelen);
+        if (read_res < 0)
+        {
+            return read_res;
+        }
+        if (static_cast<unsigned>(read_res) < bytelen)
+        {
+            return ResultOutOfBuffer;
+        }
+        src = tmp;
     }
 
     fill(bytes, bytes + bitlenToBytelen(bitlen), uint8_t(0));
-    copyBitArrayUnalignedToAligned(tmp, bit_offset_ % 8, bitlen, bytes);
+    copyBitArrayUnalignedToAligned(src, bit_offset_ % 8, bitlen, bytes);
     bit_offset_ += bitlen;
     return ResultOk;
 }
 
+int BitStream::writeAlignedBytes(const uint8_t* bytes, const unsigned bytelen)
+{
+    UAVCAN_ASSERT(isByteAligned());
+    UAVCAN_ASSERT(byte_cache_ == 0);            // Aligned writes leave no cached bits
+
+    span_len_ = 0;
+
+    const int write_res = buf_.write(bit_offset_ / 8, bytes, bytelen);
+    if (write_res < 0)
+    {
+        return write_res;
+    }
+    if (static_cast<unsigned>(write_res) < bytelen)
+    {
+        return ResultOutOfBuffer;
+    }
+
+    bit_offset_ += bytelen * 8;
+    return ResultOk;
+}
+
+int BitStream::readAlignedBytes(uint8_t* bytes, const unsigned bytelen)
+{
+    UAVCAN_ASSERT(isByteAligned());
+
+    const unsigned byte_offset = bit_offset_ / 8;
+
+    if (!isWithinSpan(byte_offset, bytelen))
+    {
+        span_len_ = buf_.getContiguousSpan(byte_offset, span_data_);
+        span_offset_ = byte_offset;
+    }
+
+    if (isWithinSpan(byte_offset, bytelen))
+    {
+        const uint8_t* const src = span_data_ + (byte_offset - span_offset_);
+        (void)copy(src, src + bytelen, bytes);
+    }
+    else
+    {
+        const int read_res = buf_.read(byte_offset, bytes, bytelen);
+        if (read_res < 0)
+        {
+            return read_res;
+        }
+        if (static_cast<unsigned>(read_res) < bytelen)
+        {
+            return ResultOutOfBuffer;
+        }
+    }
+
+    bit_offset_ += bytelen * 8;
+    return ResultOk;
+}
+
 #if UAVCAN_TOSTRING
 std::string BitStream::toString() const
 {
@@ -14,14 +14,70 @@
 # include <limits>
 #endif
 
+#if UAVCAN_HARDWARE_FLOAT16 && defined(__F16C__)
+# include <immintrin.h>
+#elif UAVCAN_HARDWARE_FLOAT16
+# include <cstring>
+#endif
+
 namespace uavcan
 {
+#if UAVCAN_HARDWARE_FLOAT16
+/*
+ * Hardware float16 conversion
+ */
+namespace
+{
+/**
+ * The hardware keeps the NaN payload, but the portable implementation always produces the same NaN.
+ */
+inline uint16_t canonicalizeHalfNaN(uint16_t value)
+{
+    return ((value & 0x7FFFU) > 0x7C00U) ? uint16_t((value & 0x8000U) | 0x7FFFU) : value;
+}
+
+#if defined(__F16C__)
+
+inline uint16_t hardwareToHalf(float value)
+{
+    return canonicalizeHalfNaN(uint16_t(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT)));
+}
+
+inline float hardwareFromHalf(uint16_t value)
+{
+    return _cvtsh_ss(value);
+}
+
+#else
+
+inline uint16_t hardwareToHalf(float value)
+{
+    const __fp16 half = static_cast<__fp16>(value);
+    uint16_t out = 0;
+    (void)std::memcpy(&out, &half, sizeof(out));
+    return canonicalizeHalfNaN(out);
+}
+
+inline float hardwareFromHalf(uint16_t value)
+{
+    __fp16 half;
+    (void)std::memcpy(&half, &value, sizeof(value));
+    return static_cast<float>(half);
+}
+
+#endif
+}
+#endif
+
 /*
  * IEEE754Converter
  * Float16 conversion algorithm: http://half.sourceforge.net/ (MIT License)
  */
 uint16_t IEEE754Converter::nativeNonIeeeToHalf(float value)
 {
+#if UAVCAN_HARDWARE_FLOAT16
+    return hardwareToHalf(value);
+#else
     uint16_t hbits = uint16_t(getSignBit(value) ? 0x8000U : 0);
     if (areFloatsExactlyEqual(value, 0.0F))
     {
@@ -55,10 +111,14 @@ uint16_t IEEE754Converter::nativeNonIeeeToHalf(float value)
     float diff = std::fabs(value - static_cast<float>(ival));
     hbits = uint16_t(hbits + (diff >= 0.5F));
     return hbits;
+#endif
 }
 
 float IEEE754Converter::halfToNativeNonIeee(uint16_t value)
 {
+#if UAVCAN_HARDWARE_FLOAT16
+    return hardwareFromHalf(value);
+#else
     float out;
     unsigned abs = value & 0x7FFFU;
     if (abs > 0x7C00U)
@@ -87,6 +147,45 @@ float IEEE754Converter::halfToNativeNonIeee(uint16_t value)
         out = std::ldexp(static_cast<float>(abs), -24);
     }
     return (value & 0x8000U) ? -out : out;
+#endif
+}
+
+void IEEE754Converter::toHalfArray(const float* values, uint16_t* out_halfs, unsigned count)
+{
+    UAVCAN_ASSERT((values != NULL) && (out_halfs != NULL));
+    unsigned i = 0;
+#if UAVCAN_HARDWARE_FLOAT16 && defined(__F16C__)
+    for (; (i + 4) <= count; i += 4)
+    {
+        const __m128i halfs = _mm_cvtps_ph(_mm_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out_halfs + i), halfs);
+        for (unsigned k = i; k < (i + 4); k++)
+        {
+            out_halfs[k] = canonicalizeHalfNaN(out_halfs[k]);
+        }
+    }
+#endif
+    // Elsewhere the loop is left for the compiler to vectorize, if the target allows
+    for (; i < count; i++)
+    {
+        out_halfs[i] = nativeNonIeeeToHalf(values[i]);
+    }
+}
+
+void IEEE754Converter::fromHalfArray(const uint16_t* halfs, float* out_values, unsigned count)
+{
+    UAVCAN_ASSERT((halfs != NULL) && (out_values != NULL));
+    unsigned i = 0;
+#if UAVCAN_HARDWARE_FLOAT16 && defined(__F16C__)
+    for (; (i + 4) <= count; i += 4)
+    {
+        _mm_storeu_ps(out_values + i, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(halfs + i))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out_values[i] = halfToNativeNonIeee(halfs[i]);
+    }
 }
 
 }
@@ -43,4 +43,55 @@ int ScalarCodec::decodeBytesImpl(uint8_t* const bytes, const unsigned bitlen)
     return read_res;
 }
 
+int ScalarCodec::encodeBitArray(const uint8_t* bytes, unsigned bitlen)
+{
+    UAVCAN_ASSERT(bytes);
+    if (stream_.isByteAligned() && (bitlen >= 8))
+    {
+        const int res = stream_.writeAlignedBytes(bytes, bitlen / 8);
+        if ((res <= 0) || ((bitlen % 8) == 0))
+        {
+            return res;
+        }
+        bytes += bitlen / 8;
+        bitlen %= 8;
+    }
+    // One byte of the bit stream buffer is reserved for the bits that are left unaligned by the previous write
+    const unsigned MaxChunkBitLen = BitStream::MaxBitsPerRW - 8;
+    for (unsigned offset = 0; offset < bitlen; offset += MaxChunkBitLen)
+    {
+        const int res = stream_.write(bytes + offset / 8, min(MaxChunkBitLen, bitlen - offset));
+        if (res <= 0)
+        {
+            return res;
+        }
+    }
+    return BitStream::ResultOk;
+}
+
+int ScalarCodec::decodeBitArray(uint8_t* bytes, unsigned bitlen)
+{
+    UAVCAN_ASSERT(bytes);
+    if (stream_.isByteAligned() && (bitlen >= 8))
+    {
+        const int res = stream_.readAlignedBytes(bytes, bitlen / 8);
+        if ((res <= 0) || ((bitlen % 8) == 0))
+        {
+            return res;
+        }
+        bytes += bitlen / 8;
+        bitlen %= 8;
+    }
+    const unsigned MaxChunkBitLen = BitStream::MaxBitsPerRW - 8;
+    for (unsigned offset = 0; offset < bitlen; offset += MaxChunkBitLen)
+    {
+        const int res = stream_.read(bytes + offset / 8, min(MaxChunkBitLen, bitlen - offset));
+        if (res <= 0)
+        {
+            return res;
+        }
+    }
+    return BitStream::ResultOk;
+}
+
 }
@@ -6,6 +6,90 @@
 
 namespace uavcan
 {
+#if !UAVCAN_TINY
+/**
+ * Computes the CRC of the payload written by an encoder, without storing it. Write rules are the same as for the
+ * transfer payload analyzer of the transfer sender: sequential, the last written byte may be rewritten.
+ */
+class PublisherPayloadHasher : public ITransferBuffer
+{
+    DataTypeSignatureCRC crc_;      ///< All bytes except the last one, which may be rewritten
+    unsigned len_;
+    uint8_t last_byte_;
+
+public:
+    PublisherPayloadHasher()
+        : len_(0)
+        , last_byte_(0)
+    { }
+
+    virtual int read(unsigned, uint8_t*, unsigned) const { return -ErrLogic; }
+
+    virtual int write(unsigned offset, const uint8_t* data, unsigned len)
+    {
+        if (len == 0)
+        {
+            return 0;
+        }
+        const bool rewrite = (len_ > 0) && (offset == (len_ - 1));
+        if (!rewrite && (offset != len_))
+        {
+            UAVCAN_ASSERT(0);
+            return -ErrLogic;
+        }
+        if (!rewrite && (len_ > 0))
+        {
+            crc_.add(last_byte_);
+        }
+        crc_.add(data, len - 1);
+        last_byte_ = data[len - 1];
+        len_ = offset + len;
+        return int(len);
+    }
+
+    uint64_t getHash() const
+    {
+        DataTypeSignatureCRC crc = crc_;
+        if (len_ > 0)
+        {
+            crc.add(last_byte_);
+        }
+        return crc.get();
+    }
+};
+
+static uint64_t computePayloadHash(const StaticTransferBufferImpl& buffer)
+{
+    DataTypeSignatureCRC crc;
+    crc.add(buffer.getRawPtr(), buffer.getMaxWritePos());
+    return crc.get();
+}
+
+bool GenericPublisherBase::isPublicationRedundant(TransferType transfer_type, uint64_t payload_hash) const
+{
+    if (!isPublishOnChange() || (transfer_type != TransferTypeMessageBroadcast) || last_publication_ts_.isZero() ||
+        (payload_hash != last_payload_hash_))
+    {
+        return false;
+    }
+    return (node_.getDispatcher().getMonotonicTime() - last_publication_ts_) < max_silence_interval_;
+}
+
+void GenericPublisherBase::registerPublication(TransferType transfer_type, uint64_t payload_hash, int publish_res)
+{
+    if (isPublishOnChange() && (transfer_type == TransferTypeMessageBroadcast) && (publish_res >= 0))
+    {
+        last_payload_hash_ = payload_hash;
+        last_publication_ts_ = node_.getDispatcher().getMonotonicTime();
+    }
+}
+
+void GenericPublisherBase::setPublishOnChange(MonotonicDuration max_silence_interval)
+{
+    max_silence_interval_ = max_silence_interval;
+    last_publication_ts_ = MonotonicTime();
+}
+#endif
 
 bool GenericPublisherBase::isInited() const
 {
@@ -35,22 +119,97 @@ int GenericPublisherBase::doInit(DataTypeKind dtkind, const char* dtname, CanTxQ
 
 MonotonicTime GenericPublisherBase::getTxDeadline() const
 {
-    return node_.getMonotonicTime() + tx_timeout_;
+    return node_.getDispatcher().getMonotonicTime() + tx_timeout_;   // Cached within a spin iteration
 }
 
 int GenericPublisherBase::genericPublish(const StaticTransferBufferImpl& buffer, TransferType transfer_type,
                                          NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline)
 {
+#if !UAVCAN_TINY
+    const uint64_t hash = isPublishOnChange() ? computePayloadHash(buffer) : 0;
+    if (isPublicationRedundant(transfer_type, hash))
+    {
+        return 0;
+    }
+#endif
+    int res = 0;
+    if (tid)
+    {
+        res = sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
+                           blocking_deadline, transfer_type, dst_node_id, *tid);
+    }
+    else
+    {
+        res = sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
+                           blocking_deadline, transfer_type, dst_node_id);
+    }
+#if !UAVCAN_TINY
+    registerPublication(transfer_type, hash, res);
+#endif
+    return res;
+}
+
+int GenericPublisherBase::genericPublish(const StaticTransferBufferImpl& buffer, uint16_t payload_crc,
+                                         TransferType transfer_type, NodeID dst_node_id, TransferID* tid,
+                                         MonotonicTime blocking_deadline)
+{
+#if !UAVCAN_TINY
+    const uint64_t hash = isPublishOnChange() ? computePayloadHash(buffer) : 0;
+    if (isPublicationRedundant(transfer_type, hash))
+    {
+        return 0;
+    }
+#endif
+    int res = 0;
+    if (tid)
+    {
+        res = sender_.sendPreEncoded(buffer.getRawPtr(), buffer.getMaxWritePos(), payload_crc, getTxDeadline(),
+                                     blocking_deadline, transfer_type, dst_node_id, *tid);
+    }
+    else
+    {
+        res = sender_.sendPreEncoded(buffer.getRawPtr(), buffer.getMaxWritePos(), payload_crc, getTxDeadline(),
+                                     blocking_deadline, transfer_type, dst_node_id);
+    }
+#if !UAVCAN_TINY
+    registerPublication(transfer_type, hash, res);
+#endif
+    return res;
+}
+
+int GenericPublisherBase::genericPublish(const ITransferPayloadEncoder& encoder, TransferType transfer_type,
+                                         NodeID dst_node_id, TransferID* tid, MonotonicTime blocking_deadline)
+{
+#if !UAVCAN_TINY
+    uint64_t hash = 0;
+    if (isPublishOnChange())
+    {
+        PublisherPayloadHasher hasher;
+        const int encode_res = encoder.encode(hasher);
+        if (encode_res < 0)
+        {
+            return encode_res;
+        }
+        hash = hasher.getHash();
+        if (isPublicationRedundant(transfer_type, hash))
+        {
+            return 0;
+        }
+    }
+#endif
+    int res = 0;
     if (tid)
     {
-        return sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
-                            blocking_deadline, transfer_type, dst_node_id, *tid);
+        res = sender_.send(encoder, getTxDeadline(), blocking_deadline, transfer_type, dst_node_id, *tid);
     }
     else
     {
-        return sender_.send(buffer.getRawPtr(), buffer.getMaxWritePos(), getTxDeadline(),
-                            blocking_deadline, transfer_type, dst_node_id);
+        res = sender_.send(encoder, getTxDeadline(), blocking_deadline, transfer_type, dst_node_id);
     }
+#if !UAVCAN_TINY
+    registerPublication(transfer_type, hash, res);
+#endif
+    return res;
 }
 
 void GenericPublisherBase::setTxTimeout(MonotonicDuration tx_timeout)
@@ -34,4 +34,51 @@ void GenericSubscriberBase::stop(TransferListenerBase* listener)
     }
 }
 
+void GenericSubscriberBase::registerDecodingFailure(const TransferListenerBase* listener)
+{
+#if !UAVCAN_TINY
+    if ((listener != NULL) && (listener->getDeferredTransferResult() != NULL))
+    {
+        listener->getDeferredTransferResult()->failed = true;
+        return;
+    }
+#else
+    (void)listener;
+#endif
+    failure_count_++;
+    node_.getDispatcher().getTransferPerfCounter().addError();
+}
+
+#if UAVCAN_LATENCY_HISTOGRAMS
+void GenericSubscriberBase::registerRxLatency(const TransferListenerBase* listener, MonotonicDuration latency)
+{
+# if !UAVCAN_TINY
+    if ((listener != NULL) && (listener->getDeferredTransferResult() != NULL))
+    {
+        listener->getDeferredTransferResult()->rx_latency = latency;
+        return;
+    }
+# else
+    (void)listener;
+# endif
+    rx_latency_.add(latency);
+}
+#endif
+
+#if !UAVCAN_TINY
+void GenericSubscriberBase::commitDeferredResult(const DeferredTransferResult& result)
+{
+    if (result.failed)
+    {
+        failure_count_++;           // The transport error is accounted by the listener
+    }
+# if UAVCAN_LATENCY_HISTOGRAMS
+    if (!result.rx_latency.isNegative())
+    {
+        rx_latency_.add(result.rx_latency);
+    }
+# endif
+}
+#endif
+
 }
@@ -6,9 +6,146 @@
 #include <uavcan/debug.hpp>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 
 namespace uavcan
 {
+/*
+ * GlobalDataTypeRegistry::Index
+ */
+void GlobalDataTypeRegistry::Index::build(const GlobalDataTypeRegistry& registry, DataTypeKind kind)
+{
+    valid = false;
+    size = 0;
+    if (DataTypeRegistryIndexSize == 0)
+    {
+        return;
+    }
+
+    const List* const list = registry.selectList(kind);
+    const Entry* p = (list == NULL) ? NULL : list->get();
+    unsigned table_pos = 0;
+    while (true)
+    {
+        // Both the list and the table are ordered by data type ID, so they're merged into the ID index directly
+        const DataTypeDescriptor* table_desc = NULL;
+        while ((table_desc == NULL) && (table_pos < registry.table_size_))
+        {
+            const DataTypeDescriptor& d = registry.table_[table_pos];
+            if ((d.getKind() == kind) && !registry.isOverridden(d))
+            {
+                table_desc = &d;
+            }
+            else
+            {
+                table_pos++;
+            }
+        }
+
+        const DataTypeDescriptor* desc = NULL;
+        if ((p != NULL) && ((table_desc == NULL) || (p->descriptor.getID().get() < table_desc->getID().get())))
+        {
+            desc = &p->descriptor;
+            p = p->getNextListNode();
+        }
+        else if (table_desc != NULL)
+        {
+            desc = table_desc;
+            table_pos++;
+        }
+        else
+        {
+            break;
+        }
+
+        if (size >= unsigned(Capacity))
+        {
+            UAVCAN_TRACE("GlobalDataTypeRegistry", "Too many data types to index, linear search will be used");
+            return;
+        }
+        by_id[size] = desc;
+
+        // Insertion sort by name hash - this is done once, and the list is short
+        NameIndexItem item;
+        item.name_hash = computeNameHash(desc->getFullName());
+        item.descriptor = desc;
+        unsigned pos = size;
+        while ((pos > 0) && (by_name[pos - 1].name_hash > item.name_hash))
+        {
+            by_name[pos] = by_name[pos - 1];
+            pos--;
+        }
+        by_name[pos] = item;
+        size++;
+    }
+    valid = true;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::Index::find(DataTypeID dtid) const
+{
+    unsigned low = 0;
+    unsigned high = size;
+    while (low < high)
+    {
+        const unsigned mid = (low + high) / 2U;
+        const DataTypeID mid_id = by_id[mid]->getID();
+        if (mid_id == dtid)
+        {
+            return by_id[mid];
+        }
+        if (mid_id.get() < dtid.get())
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::Index::find(const char* name) const
+{
+    const uint32_t hash = computeNameHash(name);
+
+    // Lower bound of the hash; the names are compared for all entries with the same hash
+    unsigned low = 0;
+    unsigned high = size;
+    while (low < high)
+    {
+        const unsigned mid = (low + high) / 2U;
+        if (by_name[mid].name_hash < hash)
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    for (unsigned i = low; (i < size) && (by_name[i].name_hash == hash); i++)
+    {
+        if (!std::strncmp(by_name[i].descriptor->getFullName(), name, DataTypeDescriptor::MaxFullNameLen))
+        {
+            return by_name[i].descriptor;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * GlobalDataTypeRegistry
+ */
+uint32_t GlobalDataTypeRegistry::computeNameHash(const char* name)
+{
+    uint32_t hash = 2166136261U;        // FNV-1a over the characters that are compared by DataTypeDescriptor::match()
+    for (unsigned i = 0; (i < DataTypeDescriptor::MaxFullNameLen) && (name[i] != '\0'); i++)
+    {
+        hash = (hash ^ uint8_t(name[i])) * 16777619U;
+    }
+    return hash;
+}
 
 GlobalDataTypeRegistry::List* GlobalDataTypeRegistry::selectList(DataTypeKind kind) const
 {
@@ -27,6 +164,94 @@ GlobalDataTypeRegistry::List* GlobalDataTypeRegistry::selectList(DataTypeKind ki
     }
 }
 
+const GlobalDataTypeRegistry::Index* GlobalDataTypeRegistry::selectIndex(DataTypeKind kind) const
+{
+    const Index* const index = (kind == DataTypeKindMessage) ? &msg_index_ : &srv_index_;
+    return (frozen_ && index->valid) ? index : NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findInList(DataTypeKind kind, const char* name) const
+{
+    const List* list = selectList(kind);
+    for (const Entry* p = (list == NULL) ? NULL : list->get(); p != NULL; p = p->getNextListNode())
+    {
+        if (p->descriptor.match(kind, name))
+        {
+            return &p->descriptor;
+        }
+    }
+    return NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findInList(DataTypeKind kind, DataTypeID dtid) const
+{
+    const List* list = selectList(kind);
+    for (const Entry* p = (list == NULL) ? NULL : list->get(); p != NULL; p = p->getNextListNode())
+    {
+        if (p->descriptor.match(kind, dtid))
+        {
+            return &p->descriptor;
+        }
+    }
+    return NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findInTable(DataTypeKind kind, const char* name) const
+{
+    for (unsigned i = 0; i < table_size_; i++)
+    {
+        if (table_[i].match(kind, name))
+        {
+            return &table_[i];
+        }
+    }
+    return NULL;
+}
+
+const DataTypeDescriptor* GlobalDataTypeRegistry::findInTable(DataTypeKind kind, DataTypeID dtid) const
+{
+    // The table is ordered by kind, then by ID
+    unsigned low = 0;
+    unsigned high = table_size_;
+    while (low < high)
+    {
+        const unsigned mid = (low + high) / 2U;
+        const DataTypeDescriptor& d = table_[mid];
+        if (d.match(kind, dtid))
+        {
+            return &d;
+        }
+        if ((d.getKind() < kind) || ((d.getKind() == kind) && (d.getID().get() < dtid.get())))
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+bool GlobalDataTypeRegistry::isOverridden(const DataTypeDescriptor& table_entry) const
+{
+    return findInList(table_entry.getKind(), table_entry.getFullName()) != NULL;
+}
+
+unsigned GlobalDataTypeRegistry::getNumTypes(DataTypeKind kind) const
+{
+    const List* const list = selectList(kind);
+    unsigned num = (list == NULL) ? 0U : list->getLength();
+    for (unsigned i = 0; i < table_size_; i++)
+    {
+        if ((table_[i].getKind() == kind) && !isOverridden(table_[i]))
+        {
+            num++;
+        }
+    }
+    return num;
+}
+
 GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::remove(Entry* dtd)
 {
     if (!dtd)
@@ -93,6 +318,16 @@ GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::registImpl(En
             p = p->getNextListNode();
         }
     }
+    {   // Collision with the adopted table, except for the entry of the same name which is overridden
+        const DataTypeDescriptor* const table_desc =
+            findInTable(dtd->descriptor.getKind(), dtd->descriptor.getID());
+        if ((table_desc != NULL) &&
+            !table_desc->match(dtd->descriptor.getKind(), dtd->descriptor.getFullName()) &&
+            !isOverridden(*table_desc))
+        {
+            return RegistrationResultCollision;
+        }
+    }
 #if UAVCAN_DEBUG
     const unsigned len_before = list->getLength();
 #endif
@@ -125,6 +360,46 @@ GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::registImpl(En
     return RegistrationResultOk;
 }
 
+GlobalDataTypeRegistry::RegistrationResult GlobalDataTypeRegistry::adoptDataTypeTable(const DataTypeDescriptor* table,
+                                                                                      unsigned size)
+{
+    if (isFrozen())
+    {
+        return RegistrationResultFrozen;
+    }
+    if ((table == NULL) || (size == 0) || (size > 0xFFFFU))
+    {
+        return RegistrationResultInvalidParams;
+    }
+    if (table_ != NULL)
+    {
+        return ((table == table_) && (size == table_size_)) ? RegistrationResultOk : RegistrationResultCollision;
+    }
+
+#if UAVCAN_DEBUG
+    for (unsigned i = 0; i < size; i++)
+    {
+        if (!table[i].isValid())
+        {
+            UAVCAN_ASSERT(0);
+            return RegistrationResultInvalidParams;
+        }
+        if ((i > 0) && ((table[i - 1].getKind() > table[i].getKind()) ||
+                        ((table[i - 1].getKind() == table[i].getKind()) &&
+                         (table[i - 1].getID().get() >= table[i].getID().get()))))
+        {
+            UAVCAN_ASSERT(0);       // Wrong order or duplicate ID
+            return RegistrationResultInvalidParams;
+        }
+    }
+#endif
+
+    table_ = table;
+    table_size_ = uint16_t(size);
+    UAVCAN_TRACE("GlobalDataTypeRegistry", "Table of %u data types adopted", size);
+    return RegistrationResultOk;
+}
+
 GlobalDataTypeRegistry& GlobalDataTypeRegistry::instance()
 {
     static GlobalDataTypeRegistry singleton;
@@ -136,6 +411,8 @@ void GlobalDataTypeRegistry::freeze()
     if (!frozen_)
     {
         frozen_ = true;
+        msg_index_.build(*this, DataTypeKindMessage);
+        srv_index_.build(*this, DataTypeKindService);
         UAVCAN_TRACE("GlobalDataTypeRegistry", "Frozen; num msgs: %u, num srvs: %u",
                      getNumMessageTypes(), getNumServiceTypes());
     }
@@ -158,42 +435,39 @@ const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, const
         UAVCAN_ASSERT(0);
         return NULL;
     }
-    const List* list = selectList(kind);
-    if (!list)
+    if (!selectList(kind))
     {
         UAVCAN_ASSERT(0);
         return NULL;
     }
-    Entry* p = list->get();
-    while (p)
+    const Index* const index = selectIndex(kind);
+    if (index != NULL)
     {
-        if (p->descriptor.match(kind, name))
-        {
-            return &p->descriptor;
-        }
-        p = p->getNextListNode();
+        return index->find(name);
     }
-    return NULL;
+    const DataTypeDescriptor* const desc = findInList(kind, name);
+    return (desc != NULL) ? desc : findInTable(kind, name);
 }
 
 const DataTypeDescriptor* GlobalDataTypeRegistry::find(DataTypeKind kind, DataTypeID dtid) const
 {
-    const List* list = selectList(kind);
-    if (!list)
+    if (!selectList(kind))
     {
         UAVCAN_ASSERT(0);
         return NULL;
     }
-    Entry* p = list->get();
-    while (p)
+    const Index* const index = selectIndex(kind);
+    if (index != NULL)
     {
-        if (p->descriptor.match(kind, dtid))
-        {
-            return &p->descriptor;
-        }
-        p = p->getNextListNode();
+        return index->find(dtid);
     }
-    return NULL;
+    const DataTypeDescriptor* const desc = findInList(kind, dtid);
+    if (desc != NULL)
+    {
+        return desc;
+    }
+    const DataTypeDescriptor* const table_desc = findInTable(kind, dtid);
+    return ((table_desc != NULL) && !isOverridden(*table_desc)) ? table_desc : NULL;
 }
 
 }
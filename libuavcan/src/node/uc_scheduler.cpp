@@ -4,6 +4,7 @@
 
 #include <uavcan/node/scheduler.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/util/event_trace.hpp>
 #include <cassert>
 
 namespace uavcan
@@ -37,6 +38,145 @@ bool DeadlineHandler::isRunning() const
 /*
  * MonotonicDeadlineScheduler
  */
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+
+bool DeadlineScheduler::isEarlier(const DeadlineHandler* a, const DeadlineHandler* b)
+{
+    if (a->deadline_ != b->deadline_)
+    {
+        return a->deadline_ < b->deadline_;
+    }
+    return int32_t(a->heap_seq_ - b->heap_seq_) < 0;   // Overflow-safe comparison
+}
+
+/**
+ * Both arguments must be detached heap roots, either of them can be NULL.
+ */
+DeadlineHandler* DeadlineScheduler::meld(DeadlineHandler* a, DeadlineHandler* b)
+{
+    if (a == NULL)
+    {
+        return b;
+    }
+    if (b == NULL)
+    {
+        return a;
+    }
+    if (isEarlier(b, a))
+    {
+        DeadlineHandler* const tmp = a;
+        a = b;
+        b = tmp;
+    }
+    // The later root becomes the first child of the earlier one
+    b->heap_prev_ = a;
+    b->setNextListNode(a->heap_child_);
+    if (a->heap_child_ != NULL)
+    {
+        a->heap_child_->heap_prev_ = b;
+    }
+    a->heap_child_ = b;
+    return a;
+}
+
+/**
+ * Standard two-pass pairing, implemented iteratively to keep stack usage constant.
+ */
+DeadlineHandler* DeadlineScheduler::mergePairs(DeadlineHandler* first)
+{
+    // First pass: meld adjacent siblings from left to right, collecting the results in reverse order
+    DeadlineHandler* pairs = NULL;
+    while (first != NULL)
+    {
+        DeadlineHandler* const a = first;
+        DeadlineHandler* const b = a->getNextListNode();
+        first = (b != NULL) ? b->getNextListNode() : NULL;
+
+        a->heap_prev_ = NULL;
+        a->setNextListNode(NULL);
+        if (b != NULL)
+        {
+            b->heap_prev_ = NULL;
+            b->setNextListNode(NULL);
+        }
+
+        DeadlineHandler* const m = meld(a, b);
+        m->setNextListNode(pairs);
+        pairs = m;
+    }
+
+    // Second pass: meld the results from right to left
+    DeadlineHandler* result = NULL;
+    while (pairs != NULL)
+    {
+        DeadlineHandler* const next = pairs->getNextListNode();
+        pairs->setNextListNode(NULL);
+        result = meld(result, pairs);
+        pairs = next;
+    }
+    return result;
+}
+
+void DeadlineScheduler::add(DeadlineHandler* mdh)
+{
+    UAVCAN_ASSERT(mdh);
+    UAVCAN_ASSERT(!doesExist(mdh));
+    mdh->heap_child_ = NULL;
+    mdh->heap_prev_ = NULL;
+    mdh->setNextListNode(NULL);
+    mdh->heap_seq_ = next_seq_++;
+    heap_root_ = meld(heap_root_, mdh);
+    num_handlers_++;
+}
+
+void DeadlineScheduler::remove(DeadlineHandler* mdh)
+{
+    UAVCAN_ASSERT(mdh);
+    if (!doesExist(mdh))
+    {
+        return;
+    }
+
+    if (mdh == heap_root_)
+    {
+        heap_root_ = mergePairs(mdh->heap_child_);
+    }
+    else
+    {
+        // Unlink from the parent or from the previous sibling, then merge the orphaned subtree back
+        DeadlineHandler* const prev = mdh->heap_prev_;
+        DeadlineHandler* const next = mdh->getNextListNode();
+        if (prev->heap_child_ == mdh)
+        {
+            prev->heap_child_ = next;
+        }
+        else
+        {
+            prev->setNextListNode(next);
+        }
+        if (next != NULL)
+        {
+            next->heap_prev_ = prev;
+        }
+        heap_root_ = meld(heap_root_, mergePairs(mdh->heap_child_));
+    }
+
+    mdh->heap_child_ = NULL;
+    mdh->heap_prev_ = NULL;
+    mdh->setNextListNode(NULL);
+    UAVCAN_ASSERT(num_handlers_ > 0);
+    num_handlers_--;
+}
+
+bool DeadlineScheduler::doesExist(const DeadlineHandler* mdh) const
+{
+    UAVCAN_ASSERT(mdh);
+    // Every node except the root has a back link
+    return (mdh == heap_root_) || (mdh->heap_prev_ != NULL);
+}
+
+#else
+
 struct MonotonicDeadlineHandlerInsertionComparator
 {
     const MonotonicTime ts;
@@ -62,51 +202,62 @@ void DeadlineScheduler::remove(DeadlineHandler* mdh)
 bool DeadlineScheduler::doesExist(const DeadlineHandler* mdh) const
 {
     UAVCAN_ASSERT(mdh);
-    const DeadlineHandler* p = handlers_.get();
 #if UAVCAN_DEBUG
     MonotonicTime prev_deadline;
-#endif
-    while (p)
+    for (const DeadlineHandler* p = handlers_.get(); p != NULL; p = p->getNextListNode())
     {
-#if UAVCAN_DEBUG
         if (prev_deadline > p->getDeadline())  // Self check
         {
             std::abort();
         }
         prev_deadline = p->getDeadline();
-#endif
-        if (p == mdh)
-        {
-            return true;
-        }
-        p = p->getNextListNode();
     }
-    return false;
+#endif
+    return handlers_.contains(mdh);
 }
 
-MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
+#endif
+
+MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock,
+                                                         ExecutionTimeCounter* callback_time_counter,
+                                                         ExecutionTimeCounter* lateness_counter,
+                                                         unsigned max_handlers)
 {
+    MonotonicTime callback_started_at;
+    unsigned num_handlers = 0;
     while (true)
     {
-        DeadlineHandler* const mdh = handlers_.get();
+        DeadlineHandler* const mdh = getEarliest();
+        const MonotonicTime ts = sysclock.getMonotonic();
+
+        if ((callback_time_counter != NULL) && !callback_started_at.isZero())
+        {
+            callback_time_counter->add(ts - callback_started_at);     // The previous handler is finished
+        }
+
         if (!mdh)
         {
-            return sysclock.getMonotonic();
+            return ts;
         }
-#if UAVCAN_DEBUG
+#if UAVCAN_DEBUG && !UAVCAN_DEADLINE_SCHEDULER_HEAP
         if (mdh->getNextListNode())      // Order check
         {
             UAVCAN_ASSERT(mdh->getDeadline() <= mdh->getNextListNode()->getDeadline());
         }
 #endif
 
-        const MonotonicTime ts = sysclock.getMonotonic();
-        if (ts < mdh->getDeadline())
+        if ((ts < mdh->getDeadline()) || ((max_handlers > 0) && (num_handlers >= max_handlers)))
         {
             return ts;
         }
 
-        handlers_.remove(mdh);
+        remove(mdh);
+        num_handlers++;
+        if (lateness_counter != NULL)
+        {
+            lateness_counter->add(ts - mdh->getDeadline());
+        }
+        callback_started_at = ts;
         mdh->handleDeadline(ts);   // This handler can be re-registered immediately
     }
     UAVCAN_ASSERT(0);
@@ -115,12 +266,16 @@ MonotonicTime DeadlineScheduler::pollAndGetMonotonicTime(ISystemClock& sysclock)
 
 MonotonicTime DeadlineScheduler::getEarliestDeadline() const
 {
-    const DeadlineHandler* const mdh = handlers_.get();
+    const DeadlineHandler* const mdh = getEarliest();
     if (mdh)
     {
         return mdh->getDeadline();
     }
+#if UAVCAN_COMPACT_MONOTONIC_TIME
+    return MonotonicTime();
+#else
     return MonotonicTime::getMax();
+#endif
 }
 
 /*
@@ -128,8 +283,14 @@ MonotonicTime DeadlineScheduler::getEarliestDeadline() const
  */
 MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadline) const
 {
-    const MonotonicTime earliest = min(deadline_scheduler_.getEarliestDeadline(), spin_deadline);
-    const MonotonicTime ts = getMonotonicTime();
+    const MonotonicTime earliest =
+        deadline_scheduler_.isEmpty() ? spin_deadline : min(deadline_scheduler_.getEarliestDeadline(), spin_deadline);
+    if (tickless_)
+    {
+        // An unfinished cleanup must be continued without waiting
+        return min(earliest, cleanup_in_progress_ ? prev_cleanup_ts_ : (prev_cleanup_ts_ + cleanup_period_));
+    }
+    const MonotonicTime ts = dispatcher_.getMonotonicTime();
     if (earliest > ts)
     {
         if (earliest - ts > deadline_resolution_)
@@ -140,15 +301,63 @@ MonotonicTime Scheduler::computeDispatcherSpinDeadline(MonotonicTime spin_deadli
     return earliest;
 }
 
+/**
+ * Returns the number of frames processed in between the handlers, or negative error code.
+ */
+int Scheduler::pollDeadlines(MonotonicTime& out_ts)
+{
+    if (rx_frame_budget_ == 0)
+    {
+        out_ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock(), getDeadlineTimeCounter(),
+                                                             getDeadlineLatenessCounter());
+        return 0;
+    }
+
+    int num_frames_processed = 0;
+    while (true)
+    {
+        out_ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock(), getDeadlineTimeCounter(),
+                                                             getDeadlineLatenessCounter(), 1);
+        if (deadline_scheduler_.isEmpty() || (deadline_scheduler_.getEarliestDeadline() > out_ts))
+        {
+            break;                              // No expired handlers left
+        }
+        const int res = dispatcher_.spinOnce(rx_frame_budget_);
+        if (res < 0)
+        {
+            return res;
+        }
+        num_frames_processed += res;
+    }
+    return num_frames_processed;
+}
+
 void Scheduler::pollCleanup(MonotonicTime mono_ts, uint32_t num_frames_processed_with_last_spin)
 {
-    // cleanup will be performed less frequently if the stack handles more frames per second
-    const MonotonicTime deadline = prev_cleanup_ts_ + cleanup_period_ * (num_frames_processed_with_last_spin + 1);
-    if (mono_ts > deadline)
+    if (!cleanup_in_progress_)
     {
+        // cleanup will be performed less frequently if the stack handles more frames per second
+        const MonotonicTime deadline = prev_cleanup_ts_ + cleanup_period_ * (num_frames_processed_with_last_spin + 1);
+        if (mono_ts < deadline)
+        {
+            return;
+        }
         //UAVCAN_TRACE("Scheduler", "Cleanup with %u processed frames", num_frames_processed_with_last_spin);
         prev_cleanup_ts_ = mono_ts;
-        dispatcher_.cleanup(mono_ts);
+    }
+
+    cleanup_in_progress_ = !dispatcher_.cleanupIncrementally(mono_ts, cleanup_budget_);
+    if (load_stats_enabled_)
+    {
+        load_stats_.cleanup.add(getMonotonicTime() - mono_ts);
+    }
+}
+
+void Scheduler::registerSpinTime(MonotonicTime started_at)
+{
+    if (load_stats_enabled_ && !started_at.isZero())    // The stats could be enabled or disabled from a callback
+    {
+        load_stats_.total_time += getMonotonicTime() - started_at;
     }
 }
 
@@ -160,19 +369,31 @@ int Scheduler::spin(MonotonicTime deadline)
         return -ErrRecursiveCall;
     }
     InsideSpinSetter iss(*this);
+    Dispatcher::IterationScope dis(dispatcher_);
     UAVCAN_ASSERT(inside_spin_);
+    UAVCAN_EVENT_TRACE_SCOPE(EventTraceSchedulerSpinBegin, 0);
+
+    const MonotonicTime started_at = load_stats_enabled_ ? getMonotonicTime() : MonotonicTime();
 
     int retval = 0;
     while (true)
     {
         const MonotonicTime dl = computeDispatcherSpinDeadline(deadline);
-        retval = dispatcher_.spin(dl);
+        retval = tickless_ ? dispatcher_.spinBatch(dl) : dispatcher_.spin(dl);
         if (retval < 0)
         {
             break;
         }
 
-        const MonotonicTime ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
+        MonotonicTime ts;
+        const int res = pollDeadlines(ts);
+        if (res < 0)
+        {
+            retval = res;
+            break;
+        }
+        dispatcher_.setIterationTimestamp(ts);
+        retval += res;
         pollCleanup(ts, unsigned(retval));
         if (ts >= deadline)
         {
@@ -180,6 +401,7 @@ int Scheduler::spin(MonotonicTime deadline)
         }
     }
 
+    registerSpinTime(started_at);
     return retval;
 }
 
@@ -191,17 +413,64 @@ int Scheduler::spinOnce()
         return -ErrRecursiveCall;
     }
     InsideSpinSetter iss(*this);
+    Dispatcher::IterationScope dis(dispatcher_);
     UAVCAN_ASSERT(inside_spin_);
+    UAVCAN_EVENT_TRACE_SCOPE(EventTraceSchedulerSpinBegin, 0);
 
-    const int retval = dispatcher_.spinOnce();
-    if (retval < 0)
+    const MonotonicTime started_at = load_stats_enabled_ ? getMonotonicTime() : MonotonicTime();
+
+    int retval = dispatcher_.spinOnce();
+    if (retval >= 0)
     {
-        return retval;
+        MonotonicTime ts;
+        const int res = pollDeadlines(ts);
+        if (res < 0)
+        {
+            retval = res;
+        }
+        else
+        {
+            retval += res;
+            pollCleanup(ts, unsigned(retval));
+        }
     }
 
-    const MonotonicTime ts = deadline_scheduler_.pollAndGetMonotonicTime(getSystemClock());
-    pollCleanup(ts, unsigned(retval));
+    registerSpinTime(started_at);
+    return retval;
+}
+
+int Scheduler::spinBudget(unsigned max_frames, MonotonicTime deadline)
+{
+    if (inside_spin_)  // Preventing recursive calls
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrRecursiveCall;
+    }
+    InsideSpinSetter iss(*this);
+    Dispatcher::IterationScope dis(dispatcher_);
+    UAVCAN_ASSERT(inside_spin_);
+    UAVCAN_EVENT_TRACE_SCOPE(EventTraceSchedulerSpinBegin, 0);
+
+    const MonotonicTime started_at = load_stats_enabled_ ? getMonotonicTime() : MonotonicTime();
+
+    int retval = dispatcher_.spinBudget(max_frames, deadline.isZero() ? deadline :
+                                                    computeDispatcherSpinDeadline(deadline));
+    if (retval >= 0)
+    {
+        MonotonicTime ts;
+        const int res = pollDeadlines(ts);
+        if (res < 0)
+        {
+            retval = res;
+        }
+        else
+        {
+            retval += res;
+            pollCleanup(ts, unsigned(retval));
+        }
+    }
 
+    registerSpinTime(started_at);
     return retval;
 }
 
@@ -3,26 +3,171 @@
  */
 
 #include <uavcan/node/service_client.hpp>
+#include <uavcan/util/placement_new.hpp>
 
 namespace uavcan
 {
 /*
- * ServiceClientBase::CallState
+ * ServiceClientBase::CallRegistry
  */
-void ServiceClientBase::CallState::handleDeadline(MonotonicTime)
+ServiceClientBase::CallRegistry::CallRegistry(IPoolAllocator& allocator, CallState* static_entries,
+                                              unsigned num_static_entries)
+    : static_entries_(static_entries)
+    , num_static_entries_(num_static_entries)
+    , allocator_(allocator)
+    , earliest_(NULL)
+    , latest_(NULL)
+    , size_(0)
+{
+    StaticAssert<((ServiceClientCallIndexSize & (ServiceClientCallIndexSize - 1U)) == 0)>::check();
+    IsDynamicallyAllocatable<CallState>::check();
+    for (unsigned i = 0; i < num_static_entries; i++)
+    {
+        free_static_entries_.insertAfter(NULL, static_entries + i);
+    }
+}
+
+void ServiceClientBase::CallRegistry::insertByDeadline(CallState* cs)
 {
-    UAVCAN_TRACE("ServiceClient::CallState", "Timeout from nid=%d, tid=%d, dtname=%s",
-                 int(id_.server_node_id.get()), int(id_.transfer_id.get()),
-                 (owner_.data_type_descriptor_ == NULL) ? "???" : owner_.data_type_descriptor_->getFullName());
     /*
-     * What we're doing here is relaying execution from this call stack to a different one.
-     * We need it because call registry cannot release memory from this callback, because this will destroy the
-     * object method of which we're executing now.
+     * Normally all calls of a client have the same timeout, so the new call goes to the end of the list.
+     * Calls with equal deadlines are kept in the order of insertion.
      */
-    UAVCAN_ASSERT(timed_out_ == false);
-    timed_out_ = true;
-    owner_.generateDeadlineImmediately();
-    UAVCAN_TRACE("ServiceClient::CallState", "Relaying execution to the owner's handler via timer callback");
+    CallState* prev = latest_;
+    while ((prev != NULL) && (prev->deadline > cs->deadline))
+    {
+        prev = prev->prev_by_deadline;
+    }
+
+    CallState* const next = (prev == NULL) ? earliest_ : prev->next_by_deadline;
+    cs->prev_by_deadline = prev;
+    cs->next_by_deadline = next;
+    if (prev == NULL)
+    {
+        earliest_ = cs;
+    }
+    else
+    {
+        prev->next_by_deadline = cs;
+    }
+    if (next == NULL)
+    {
+        latest_ = cs;
+    }
+    else
+    {
+        next->prev_by_deadline = cs;
+    }
+}
+
+ServiceClientBase::CallState* ServiceClientBase::CallRegistry::add(ServiceCallID id, MonotonicTime deadline)
+{
+    UAVCAN_ASSERT(id.isValid());
+
+    CallState* cs = free_static_entries_.get();
+    if (cs != NULL)
+    {
+        free_static_entries_.remove(cs);
+        *cs = CallState();
+    }
+    else
+    {
+        void* const praw = allocator_.allocate(sizeof(CallState));
+        if (praw == NULL)
+        {
+            return NULL;
+        }
+        cs = new (praw) CallState();
+    }
+
+    cs->id = id;
+    cs->deadline = deadline;
+    buckets_[computeBucketIndex(id.server_node_id)].insertAfter(NULL, cs);
+    insertByDeadline(cs);
+    size_++;
+    return cs;
+}
+
+void ServiceClientBase::CallRegistry::remove(CallState* cs)
+{
+    UAVCAN_ASSERT((cs != NULL) && (size_ > 0));
+
+    buckets_[computeBucketIndex(cs->id.server_node_id)].remove(cs);
+
+    if (cs->prev_by_deadline == NULL)
+    {
+        earliest_ = cs->next_by_deadline;
+    }
+    else
+    {
+        cs->prev_by_deadline->next_by_deadline = cs->next_by_deadline;
+    }
+    if (cs->next_by_deadline == NULL)
+    {
+        latest_ = cs->prev_by_deadline;
+    }
+    else
+    {
+        cs->next_by_deadline->prev_by_deadline = cs->prev_by_deadline;
+    }
+    size_--;
+
+    if (isStatic(cs))
+    {
+        free_static_entries_.insertAfter(NULL, cs);
+    }
+    else
+    {
+        cs->~CallState();
+        allocator_.deallocate(cs);
+    }
+}
+
+void ServiceClientBase::CallRegistry::clear()
+{
+    while (earliest_ != NULL)
+    {
+        remove(earliest_);
+    }
+    UAVCAN_ASSERT(size_ == 0);
+}
+
+ServiceClientBase::CallState* ServiceClientBase::CallRegistry::find(ServiceCallID id) const
+{
+    // New entries are inserted at the head of the bucket, so the last match is the oldest one
+    CallState* match = NULL;
+    for (CallState* p = buckets_[computeBucketIndex(id.server_node_id)].get(); p != NULL; p = p->getNextListNode())
+    {
+        if (p->id == id)
+        {
+            match = p;
+        }
+    }
+    return match;
+}
+
+bool ServiceClientBase::CallRegistry::hasCallToServer(NodeID server_node_id) const
+{
+    for (const CallState* p = buckets_[computeBucketIndex(server_node_id)].get(); p != NULL;
+         p = p->getNextListNode())
+    {
+        if (p->id.server_node_id == server_node_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+const ServiceClientBase::CallState* ServiceClientBase::CallRegistry::getByIndex(unsigned index) const
+{
+    const CallState* p = earliest_;
+    while ((p != NULL) && (index > 0))
+    {
+        p = p->next_by_deadline;
+        index--;
+    }
+    return p;
 }
 
 /*
@@ -64,7 +209,8 @@ int ServiceClientBase::prepareToCall(INode& node,
      */
     const OutgoingTransferRegistryKey otr_key(data_type_descriptor_->getID(),
                                               TransferTypeServiceRequest, server_node_id);
-    const MonotonicTime otr_deadline = node.getMonotonicTime() + TransferSender::getDefaultMaxTransferInterval();
+    const MonotonicTime otr_deadline = node.getDispatcher().getMonotonicTime() +
+                                       TransferSender::getDefaultMaxTransferInterval();
     TransferID* const otr_tid =
         node.getDispatcher().getOutgoingTransferRegistry().accessOrCreate(otr_key, otr_deadline);
     if (!otr_tid)
@@ -47,4 +47,86 @@ void TimerBase::startPeriodic(MonotonicDuration period)
     DeadlineHandler::startWithDelay(period);
 }
 
+/*
+ * GroupedTimerBase
+ */
+void GroupedTimerBase::start()
+{
+    group_.add(this);
+}
+
+void GroupedTimerBase::stop()
+{
+    group_.remove(this);
+}
+
+bool GroupedTimerBase::isRunning() const
+{
+    return group_.timers_.contains(this);
+}
+
+/*
+ * TimerGroup
+ */
+TimerGroup::~TimerGroup()
+{
+    UAVCAN_ASSERT(timers_.isEmpty());           // The timers must be destroyed before the group
+}
+
+void TimerGroup::handleDeadline(MonotonicTime current)
+{
+    UAVCAN_ASSERT(!DeadlineHandler::isRunning());
+
+    const MonotonicTime scheduled_time = getDeadline();
+    startWithDeadline(scheduled_time + period_);
+
+    const TimerEvent event(scheduled_time, current);
+    GroupedTimerBase* p = timers_.get();
+    while (p != NULL)
+    {
+        next_to_fire_ = p->getNextListNode();   // Updated if the next timer is stopped from the callback
+        p->handleTimerEvent(event);
+        p = next_to_fire_;
+    }
+    next_to_fire_ = NULL;
+}
+
+void TimerGroup::add(GroupedTimerBase* timer)
+{
+    UAVCAN_ASSERT(timer != NULL);
+    if (timers_.contains(timer))
+    {
+        return;
+    }
+    timers_.insert(timer);                      // Timers started from a callback will fire on the next deadline
+    if (!DeadlineHandler::isRunning())
+    {
+        startWithDelay(period_);
+    }
+}
+
+void TimerGroup::remove(GroupedTimerBase* timer)
+{
+    UAVCAN_ASSERT(timer != NULL);
+    if (timer == next_to_fire_)
+    {
+        next_to_fire_ = timer->getNextListNode();
+    }
+    timers_.remove(timer);
+    if (timers_.isEmpty())
+    {
+        DeadlineHandler::stop();                // Also if all timers have been stopped from the callbacks
+    }
+}
+
+void TimerGroup::setPeriod(MonotonicDuration period)
+{
+    UAVCAN_ASSERT(period.isPositive() && (period < MonotonicDuration::getInfinite()));
+    period_ = period;
+    if (DeadlineHandler::isRunning())
+    {
+        startWithDelay(period_);
+    }
+}
+
 }
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/node/tx_completion_notifier.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+
+void TxCompletionNotifierBase::handleLoopbackFrame(const RxFrame& frame)
+{
+    if ((sender_ == NULL) ||
+        !frame.isEndOfTransfer() ||
+        (frame.getTransferType() != TransferTypeMessageBroadcast) ||
+        (frame.getDataTypeID() != sender_->getDataTypeID()))
+    {
+        return;
+    }
+
+    TxCompletionEvent event;
+    event.ts_mono = frame.getMonotonicTimestamp();
+    event.ts_utc = frame.getUtcTimestamp();
+    event.transfer_id = frame.getTransferID();
+    event.iface_index = frame.getIfaceIndex();
+    handleTxCompletion(event);
+}
+
+int TxCompletionNotifierBase::startImpl(TransferSender& sender)
+{
+    UAVCAN_ASSERT(sender_ == NULL);
+    if (!sender.isInitialized())
+    {
+        return -ErrNotInited;
+    }
+
+    loopback_was_enabled_ = (sender.getCanIOFlags() & CanIOFlagLoopback) != 0;
+    sender.setCanIOFlags(CanIOFlags(sender.getCanIOFlags() | CanIOFlagLoopback));
+    sender_ = &sender;
+
+    startListening(sender.getDataTypeID());
+    return 0;
+}
+
+void TxCompletionNotifierBase::stop()
+{
+    if (sender_ != NULL)
+    {
+        if (!loopback_was_enabled_)
+        {
+            sender_->setCanIOFlags(CanIOFlags(sender_->getCanIOFlags() & ~CanIOFlagLoopback));
+        }
+        sender_ = NULL;
+    }
+    stopListening();
+}
+
+#endif
+}
@@ -23,16 +23,87 @@ MonotonicDuration DynamicNodeIDClient::getRandomDuration(uint32_t lower_bound_ms
                                        static_cast<uint32_t>(std::rand()) % (upper_bound_msec - lower_bound_msec));
 }
 
+void DynamicNodeIDClient::handleCompetingTraffic(
+    const ReceivedDataStructure<protocol::dynamic_node_id::Allocation>& msg, bool was_waiting_for_followup)
+{
+    typedef protocol::dynamic_node_id::Allocation Allocation;
+
+    if (msg.isAnonymousTransfer())
+    {
+        if (msg.first_part_of_unique_id)
+        {
+            /*
+             * Another first-stage request before the allocator responded to the previous one means that the request
+             * periods of the clients are too close to each other - spreading them wider.
+             */
+            if (!last_first_stage_request_ts_.isZero() &&
+                ((msg.getMonotonicTimestamp() - last_first_stage_request_ts_) <
+                 MonotonicDuration::fromMSec(Allocation::FOLLOWUP_TIMEOUT_MS)))
+            {
+                request_window_msec_ = static_cast<uint16_t>(
+                    min<uint32_t>(request_window_msec_ * 2U,
+                                  Allocation::MAX_REQUEST_PERIOD_MS - Allocation::MIN_REQUEST_PERIOD_MS));
+                UAVCAN_TRACE("DynamicNodeIDClient", "Request collision, window %d ms",
+                             static_cast<int>(request_window_msec_));
+            }
+            last_first_stage_request_ts_ = msg.getMonotonicTimestamp();
+        }
+        else if (was_waiting_for_followup)
+        {
+            /*
+             * Another node has accepted the same offer, so its unique ID begins like ours - the follow-up delays
+             * must be spread wider in order to let one of the nodes proceed.
+             */
+            followup_window_msec_ = static_cast<uint16_t>(
+                min<uint32_t>(followup_window_msec_ * 2U,
+                              Allocation::MAX_FOLLOWUP_DELAY_MS - Allocation::MIN_FOLLOWUP_DELAY_MS));
+            UAVCAN_TRACE("DynamicNodeIDClient", "Follow-up collision, window %d ms",
+                         static_cast<int>(followup_window_msec_));
+        }
+    }
+    else
+    {
+        last_first_stage_request_ts_ = MonotonicTime();
+
+        if ((msg.unique_id.size() == msg.unique_id.capacity()) && (msg.node_id != 0))
+        {
+            // An allocation round has been completed, narrowing slowly
+            request_window_msec_ = max<uint16_t>(static_cast<uint16_t>(MinRequestWindowMSec),
+                                                 static_cast<uint16_t>(request_window_msec_ -
+                                                                       request_window_msec_ / 4U));
+        }
+    }
+}
+
 void DynamicNodeIDClient::restartTimer(const Mode mode)
 {
     UAVCAN_ASSERT(mode < NumModes);
     UAVCAN_ASSERT((mode == ModeWaitingForTimeSlot) == (size_of_received_unique_id_ == 0));
 
-    const MonotonicDuration delay = (mode == ModeWaitingForTimeSlot) ?
-        getRandomDuration(protocol::dynamic_node_id::Allocation::MIN_REQUEST_PERIOD_MS,
-                          protocol::dynamic_node_id::Allocation::MAX_REQUEST_PERIOD_MS) :
-        getRandomDuration(protocol::dynamic_node_id::Allocation::MIN_FOLLOWUP_DELAY_MS,
-                          protocol::dynamic_node_id::Allocation::MAX_FOLLOWUP_DELAY_MS);
+    typedef protocol::dynamic_node_id::Allocation Allocation;
+
+    uint32_t lower_bound_msec = 0;
+    uint32_t upper_bound_msec = 0;
+    if (mode == ModeWaitingForTimeSlot)
+    {
+        lower_bound_msec = Allocation::MIN_REQUEST_PERIOD_MS;
+        upper_bound_msec = Allocation::MAX_REQUEST_PERIOD_MS;
+        if (adaptive_pacing_)
+        {
+            upper_bound_msec = min(upper_bound_msec, lower_bound_msec + request_window_msec_);
+        }
+    }
+    else
+    {
+        lower_bound_msec = Allocation::MIN_FOLLOWUP_DELAY_MS;
+        upper_bound_msec = Allocation::MAX_FOLLOWUP_DELAY_MS;
+        if (adaptive_pacing_)
+        {
+            upper_bound_msec = min(upper_bound_msec, lower_bound_msec + followup_window_msec_);
+        }
+    }
+
+    const MonotonicDuration delay = getRandomDuration(lower_bound_msec, upper_bound_msec);
 
     startOneShotWithDelay(delay);
 
@@ -76,6 +147,11 @@ void DynamicNodeIDClient::handleTimerEvent(const TimerEvent&)
     size_of_received_unique_id_ = 0;
     restartTimer(ModeWaitingForTimeSlot);
 
+    if (tx.first_part_of_unique_id)
+    {
+        last_first_stage_request_ts_ = dnida_pub_.getNode().getMonotonicTime();
+    }
+
     /*
      * Broadcasting the message.
      */
@@ -103,6 +179,8 @@ void DynamicNodeIDClient::handleAllocation(const ReceivedDataStructure<protocol:
                  static_cast<int>(msg.getSrcNodeID().get()), static_cast<int>(msg.unique_id.size()),
                  static_cast<int>(msg.node_id));
 
+    handleCompetingTraffic(msg, size_of_received_unique_id_ > 0);
+
     /*
      * Switching to passive state by default; will switch to active state if response matches.
      */
@@ -182,6 +260,7 @@ int DynamicNodeIDClient::start(const protocol::HardwareVersion& hardware_version
     preferred_node_id_ = preferred_node_id;
     allocated_node_id_ = NodeID();
     allocator_node_id_ = NodeID();
+    last_first_stage_request_ts_ = MonotonicTime();
     UAVCAN_ASSERT(preferred_node_id_.isValid());
     UAVCAN_ASSERT(!allocated_node_id_.isValid());
     UAVCAN_ASSERT(!allocator_node_id_.isValid());
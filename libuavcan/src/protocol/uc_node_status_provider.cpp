@@ -15,11 +15,39 @@ bool NodeStatusProvider::isNodeInfoInitialized() const
     return !node_info_.name.empty();
 }
 
+void NodeStatusProvider::updateLoadReport()
+{
+    const SchedulerLoadStats& stats = getNode().getScheduler().getLoadStats();
+
+    if (stats.total_time < prev_load_total_time_)      // The stats have been reset
+    {
+        prev_load_total_time_ = MonotonicDuration();
+        prev_load_busy_time_ = MonotonicDuration();
+    }
+
+    const MonotonicDuration busy = stats.getBusyTime() - prev_load_busy_time_;
+    const MonotonicDuration total = stats.total_time - prev_load_total_time_;
+    prev_load_total_time_ = stats.total_time;
+    prev_load_busy_time_ = stats.getBusyTime();
+
+    node_info_.status.vendor_specific_status_code = SchedulerLoadStats::computeUtilizationPercent(busy, total);
+}
+
 int NodeStatusProvider::publish()
 {
-    const MonotonicDuration uptime = getNode().getMonotonicTime() - creation_timestamp_;
-    UAVCAN_ASSERT(uptime.isPositive());
-    node_info_.status.uptime_sec = uint32_t(uptime.toMSec() / 1000);
+    if (load_reporting_enabled_)
+    {
+        updateLoadReport();
+    }
+
+    // The uptime is accumulated in whole seconds, because the difference between two time points
+    // is limited in range if UAVCAN_COMPACT_MONOTONIC_TIME is enabled
+    const MonotonicDuration elapsed = getNode().getMonotonicTime() - uptime_origin_;
+    UAVCAN_ASSERT(!elapsed.isNegative());
+    const uint32_t elapsed_sec = uint32_t(elapsed.toMSec() / 1000);
+    uptime_origin_ += MonotonicDuration::fromMSec(int64_t(elapsed_sec) * 1000);
+    node_info_.status.uptime_sec += elapsed_sec;
+    invalidateEncodedNodeInfo();        // The status is a part of the node info, so it's re-encoded once per period
 
     UAVCAN_ASSERT(node_info_.status.health <= protocol::NodeStatus::FieldTypes::health::max());
 
@@ -43,11 +71,16 @@ void NodeStatusProvider::handleTimerEvent(const TimerEvent&)
 }
 
 void NodeStatusProvider::handleGetNodeInfoRequest(const protocol::GetNodeInfo::Request&,
-                                                  protocol::GetNodeInfo::Response& rsp)
+                                                  ServiceResponseDataStructure<protocol::GetNodeInfo::Response>& rsp)
 {
     UAVCAN_TRACE("NodeStatusProvider", "Got GetNodeInfo request");
     UAVCAN_ASSERT(isNodeInfoInitialized());
-    rsp = node_info_;
+#if UAVCAN_TINY
+    static_cast<protocol::GetNodeInfo::Response&>(rsp) = node_info_;
+#else
+    // Publication failures are counted by the server
+    (void)gni_srv_.respond(rsp.deferResponse(), node_info_, node_info_encoded_);
+#endif
 }
 
 int NodeStatusProvider::startAndPublish(const TransferPriority priority)
@@ -112,16 +145,31 @@ uavcan::MonotonicDuration NodeStatusProvider::getStatusPublicationPeriod() const
 void NodeStatusProvider::setHealth(uint8_t code)
 {
     node_info_.status.health = code;
+    invalidateEncodedNodeInfo();
 }
 
 void NodeStatusProvider::setMode(uint8_t code)
 {
     node_info_.status.mode = code;
+    invalidateEncodedNodeInfo();
 }
 
 void NodeStatusProvider::setVendorSpecificStatusCode(VendorSpecificStatusCode code)
 {
     node_info_.status.vendor_specific_status_code = code;
+    invalidateEncodedNodeInfo();
+}
+
+void NodeStatusProvider::setLoadReportingEnabled(bool enabled)
+{
+    load_reporting_enabled_ = enabled;
+    if (enabled)
+    {
+        Scheduler& scheduler = getNode().getScheduler();
+        scheduler.setLoadStatsEnabled(true);
+        prev_load_total_time_ = scheduler.getLoadStats().total_time;
+        prev_load_busy_time_ = scheduler.getLoadStats().getBusyTime();
+    }
 }
 
 void NodeStatusProvider::setName(const char* name)
@@ -129,6 +177,7 @@ void NodeStatusProvider::setName(const char* name)
     if ((name != NULL) && (*name != '\0') && (node_info_.name.empty()))
     {
         node_info_.name = name;  // The string contents will be copied, not just pointer.
+        invalidateEncodedNodeInfo();
     }
 }
 
@@ -137,6 +186,7 @@ void NodeStatusProvider::setSoftwareVersion(const protocol::SoftwareVersion& ver
     if (node_info_.software_version == protocol::SoftwareVersion())
     {
         node_info_.software_version = version;
+        invalidateEncodedNodeInfo();
     }
 }
 
@@ -145,6 +195,7 @@ void NodeStatusProvider::setHardwareVersion(const protocol::HardwareVersion& ver
     if (node_info_.hardware_version == protocol::HardwareVersion())
     {
         node_info_.hardware_version = version;
+        invalidateEncodedNodeInfo();
     }
 }
 
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/protocol/warm_start.hpp>
+#include <uavcan/transport/crc.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+namespace
+{
+
+const uint8_t Signature[2] = { 'U', 'W' };
+
+uint8_t* writeU32(uint8_t* p, uint32_t value)
+{
+    for (unsigned i = 0; i < 4; i++)
+    {
+        *p++ = static_cast<uint8_t>(value >> (i * 8U));
+    }
+    return p;
+}
+
+uint32_t readU32(const uint8_t* p)
+{
+    uint32_t value = 0;
+    for (unsigned i = 0; i < 4; i++)
+    {
+        value |= static_cast<uint32_t>(p[i]) << (i * 8U);
+    }
+    return value;
+}
+
+uint16_t computeCrc(const uint8_t* data, unsigned size)
+{
+    TransferCRC crc;
+    crc.add(data, size);
+    return crc.get();
+}
+
+}
+
+const uint8_t* WarmStartSnapshot::getFilterRecord(uint8_t index) const
+{
+    UAVCAN_ASSERT(index < getNumFiltersUnchecked());
+    return data_ + HeaderSize + unsigned(index) * FilterRecordSize;
+}
+
+const uint8_t* WarmStartSnapshot::getNodeRecord(uint8_t index) const
+{
+    UAVCAN_ASSERT(index < getNumNodesUnchecked());
+    return data_ + HeaderSize + unsigned(getNumFiltersUnchecked()) * FilterRecordSize +
+           unsigned(index) * NodeRecordSize;
+}
+
+bool WarmStartSnapshot::validate() const
+{
+    if ((data_ == NULL) || (size_ < (HeaderSize + CrcSize)))
+    {
+        return false;
+    }
+    if ((data_[0] != Signature[0]) || (data_[1] != Signature[1]) || (data_[2] != FormatVersion))
+    {
+        return false;
+    }
+    if ((data_[3] == 0) || (data_[3] > NodeID::Max) || (getNumFiltersUnchecked() > MaxCanAcceptanceFilters) ||
+        (getNumNodesUnchecked() > NodeID::Max))
+    {
+        return false;
+    }
+
+    const unsigned expected_size = HeaderSize + unsigned(getNumFiltersUnchecked()) * FilterRecordSize +
+                                   unsigned(getNumNodesUnchecked()) * NodeRecordSize + CrcSize;
+    if (size_ != expected_size)
+    {
+        return false;
+    }
+
+    const unsigned crc_offset = size_ - CrcSize;
+    const uint16_t crc = uint16_t(data_[crc_offset] | (data_[crc_offset + 1] << 8));
+    return crc == computeCrc(data_, crc_offset);
+}
+
+int WarmStartSnapshot::save(const INode& node, const CanAcceptanceFilterConfigurator* filters,
+                            const NodeInfoRetriever* retriever, uint8_t* buffer, unsigned capacity)
+{
+    if ((buffer == NULL) || !node.getNodeID().isUnicast())
+    {
+        return -ErrInvalidParam;
+    }
+
+    const uint16_t num_filters = (filters == NULL) ? uint16_t(0) : filters->getNumAppliedConfigs();
+    const unsigned fixed_size = HeaderSize + unsigned(num_filters) * FilterRecordSize + CrcSize;
+    if ((capacity < fixed_size) || (num_filters > 0xFFU))
+    {
+        return -ErrInvalidParam;
+    }
+
+    uint8_t* p = buffer;
+    *p++ = Signature[0];
+    *p++ = Signature[1];
+    *p++ = FormatVersion;
+    *p++ = node.getNodeID().get();
+    *p++ = static_cast<uint8_t>(num_filters);
+    uint8_t* const num_nodes_ptr = p++;
+
+    for (uint16_t i = 0; i < num_filters; i++)
+    {
+        const CanFilterConfig& cfg = filters->getAppliedConfig(i);
+        p = writeU32(p, cfg.id);
+        p = writeU32(p, cfg.mask);
+    }
+
+    // The node info cache is best effort, so are the node records
+    uint8_t num_nodes = 0;
+    for (uint8_t node_id = 1; (retriever != NULL) && (node_id <= NodeID::Max); node_id++)
+    {
+        const NodeInfoSummary* const info = retriever->getCachedNodeInfo(node_id);
+        if (info == NULL)
+        {
+            continue;
+        }
+        if (unsigned(p - buffer) + NodeRecordSize + CrcSize > capacity)
+        {
+            UAVCAN_TRACE("WarmStartSnapshot", "No space for node info records beyond node ID %d", int(node_id));
+            break;
+        }
+
+        *p++ = node_id;
+        p = writeU32(p, info->software_image_crc_low);
+        p = writeU32(p, info->software_image_crc_high);
+        p = writeU32(p, info->software_vcs_commit);
+        p = writeU32(p, info->hash);
+        *p++ = info->software_version_major;
+        *p++ = info->software_version_minor;
+        *p++ = info->software_optional_field_flags;
+        *p++ = info->hardware_version_major;
+        *p++ = info->hardware_version_minor;
+        (void)copy(info->hardware_unique_id, info->hardware_unique_id + NodeInfoSummary::UniqueIDSize, p);
+        p += NodeInfoSummary::UniqueIDSize;
+        num_nodes++;
+    }
+    *num_nodes_ptr = num_nodes;
+
+    const unsigned crc_offset = unsigned(p - buffer);
+    const uint16_t crc = computeCrc(buffer, crc_offset);
+    *p++ = static_cast<uint8_t>(crc & 0xFFU);
+    *p++ = static_cast<uint8_t>(crc >> 8);
+
+    UAVCAN_ASSERT(unsigned(p - buffer) <= capacity);
+    return static_cast<int>(p - buffer);
+}
+
+int WarmStartSnapshot::restoreNodeID(INode& node) const
+{
+    if (!valid_)
+    {
+        return -ErrInvalidParam;
+    }
+    return node.setNodeID(getNodeID()) ? 0 : -ErrLogic;
+}
+
+int WarmStartSnapshot::restoreFilters(CanAcceptanceFilterConfigurator& filters) const
+{
+    if (!valid_)
+    {
+        return -ErrInvalidParam;
+    }
+
+    const uint8_t num_configs = getNumFiltersUnchecked();
+    if (num_configs == 0)
+    {
+        return 0;
+    }
+
+    CanFilterConfig configs[MaxCanAcceptanceFilters];
+    for (uint8_t i = 0; i < num_configs; i++)
+    {
+        const uint8_t* const rec = getFilterRecord(i);
+        configs[i].id = readU32(rec);
+        configs[i].mask = readU32(rec + 4);
+    }
+    return filters.restoreConfiguration(configs, num_configs);
+}
+
+int WarmStartSnapshot::restoreNodeInfoCache(NodeInfoRetriever& retriever) const
+{
+    if (!valid_)
+    {
+        return -ErrInvalidParam;
+    }
+
+    int num_restored = 0;
+    for (uint8_t i = 0; i < getNumNodesUnchecked(); i++)
+    {
+        const uint8_t* rec = getNodeRecord(i);
+        const uint8_t node_id = *rec++;
+        if ((node_id == 0) || (node_id > NodeID::Max))
+        {
+            return -ErrInvalidParam;
+        }
+
+        NodeInfoSummary info;
+        info.software_image_crc_low = readU32(rec);
+        info.software_image_crc_high = readU32(rec + 4);
+        info.software_vcs_commit = readU32(rec + 8);
+        info.hash = readU32(rec + 12);
+        rec += 16;
+        info.software_version_major = *rec++;
+        info.software_version_minor = *rec++;
+        info.software_optional_field_flags = *rec++;
+        info.hardware_version_major = *rec++;
+        info.hardware_version_minor = *rec++;
+        (void)copy(rec, rec + NodeInfoSummary::UniqueIDSize, info.hardware_unique_id);
+
+        const int res = retriever.restoreCachedNodeInfo(node_id, info);
+        if (res < 0)
+        {
+            return res;
+        }
+        num_restored++;
+    }
+    return num_restored;
+}
+
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/bus_load_estimator.hpp>
+#include <uavcan/util/templates.hpp>
+
+namespace uavcan
+{
+/*
+ * BusLoadEstimator::StuffedBitCounter
+ */
+class BusLoadEstimator::StuffedBitCounter
+{
+    unsigned num_bits_;
+    uint16_t crc_;
+    uint8_t run_length_;
+    bool last_bit_;
+
+    void addStuffedBit(bool bit)
+    {
+        num_bits_++;
+        if ((run_length_ > 0) && (bit == last_bit_))
+        {
+            run_length_++;
+        }
+        else
+        {
+            run_length_ = 1;
+            last_bit_ = bit;
+        }
+        if (run_length_ == 5)
+        {
+            num_bits_++;                // The stuff bit starts a new run of the opposite polarity
+            run_length_ = 1;
+            last_bit_ = !bit;
+        }
+    }
+
+public:
+    StuffedBitCounter()
+        : num_bits_(0)
+        , crc_(0)
+        , run_length_(0)
+        , last_bit_(false)
+    { }
+
+    /**
+     * Adds the specified number of least significant bits of the value, MSB first, updating the CRC.
+     */
+    void addBits(uint32_t value, unsigned width)
+    {
+        while (width > 0)
+        {
+            width--;
+            const bool bit = ((value >> width) & 1U) != 0;
+            const bool crc_nxt = bit != (((crc_ >> 14) & 1U) != 0);
+            crc_ = uint16_t((crc_ << 1) & 0x7FFFU);
+            if (crc_nxt)
+            {
+                crc_ = uint16_t(crc_ ^ 0x4599U);
+            }
+            addStuffedBit(bit);
+        }
+    }
+
+    /**
+     * Terminates the stuffed part of the frame with the CRC sequence.
+     */
+    void addCrc()
+    {
+        const uint16_t crc = crc_;
+        for (int i = 14; i >= 0; i--)
+        {
+            addStuffedBit(((crc >> i) & 1U) != 0);
+        }
+    }
+
+    unsigned getNumBits() const { return num_bits_; }
+};
+
+/*
+ * BusLoadEstimator
+ */
+uint64_t BusLoadEstimator::getNumElapsedSlots(MonotonicTime ts) const
+{
+    if ((ts <= slot_start_ts_) || !slot_duration_.isPositive())
+    {
+        return 0;
+    }
+    return uint64_t((ts - slot_start_ts_).toUSec() / slot_duration_.toUSec());
+}
+
+void BusLoadEstimator::advance(MonotonicTime ts)
+{
+    const uint64_t elapsed = getNumElapsedSlots(ts);
+    if (elapsed == 0)
+    {
+        return;
+    }
+    const unsigned num_cleared = unsigned(min<uint64_t>(elapsed, NumSlots));
+    for (unsigned i = 0; i < num_cleared; i++)
+    {
+        current_slot_ = uint8_t((current_slot_ + 1U) % unsigned(NumSlots));
+        slot_bits_[current_slot_] = 0;
+    }
+    slot_start_ts_ += slot_duration_ * int64_t(elapsed);
+}
+
+void BusLoadEstimator::configure(uint32_t bitrate, MonotonicDuration window, MonotonicTime now)
+{
+    bitrate_ = bitrate;
+    slot_duration_ = max(MonotonicDuration::fromUSec(window.toUSec() / NumSlots), MonotonicDuration::getResolution());
+    reset(now);
+}
+
+void BusLoadEstimator::reset(MonotonicTime now)
+{
+    fill_n(slot_bits_, unsigned(NumSlots), uint32_t(0));
+    current_slot_ = 0;
+    slot_start_ts_ = now;
+    start_ts_ = now;
+}
+
+void BusLoadEstimator::addFrame(const CanFrame& frame, MonotonicTime ts)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    advance(ts);
+    const uint32_t bits = computeFrameBitLength(frame);
+    slot_bits_[current_slot_] = (slot_bits_[current_slot_] > (0xFFFFFFFFU - bits)) ?
+                                0xFFFFFFFFU : (slot_bits_[current_slot_] + bits);
+}
+
+float BusLoadEstimator::getLoad(MonotonicTime now) const
+{
+    if (!isEnabled() || (now <= start_ts_))
+    {
+        return 0.0F;
+    }
+
+    /*
+     * The slots that would be cleared by advance(now) are skipped; the current slot after advancing
+     * is partially elapsed.
+     */
+    const uint64_t elapsed = getNumElapsedSlots(now);
+    if (elapsed >= unsigned(NumSlots))
+    {
+        return 0.0F;
+    }
+    uint64_t bits = 0;
+    for (unsigned age = 0; age < (unsigned(NumSlots) - unsigned(elapsed)); age++)
+    {
+        bits += slot_bits_[(current_slot_ + unsigned(NumSlots) - age) % unsigned(NumSlots)];
+    }
+
+    const MonotonicTime current_slot_start = slot_start_ts_ + slot_duration_ * int64_t(elapsed);
+    const MonotonicDuration covered = min(now - start_ts_,
+                                          slot_duration_ * (int(NumSlots) - 1) + (now - current_slot_start));
+    if (!covered.isPositive())
+    {
+        return 0.0F;
+    }
+
+    const float load = float(bits) / (float(bitrate_) * float(covered.toUSec()) * 1e-6F);
+    return min(load, 1.0F);
+}
+
+unsigned BusLoadEstimator::computeFrameBitLength(const CanFrame& frame)
+{
+    if (frame.isErrorFrame())
+    {
+        return 0;
+    }
+    const bool rtr = frame.isRemoteTransmissionRequest();
+    const unsigned dlc = min(unsigned(frame.dlc), unsigned(CanFrame::MaxDataLen));
+
+    StuffedBitCounter counter;
+    counter.addBits(0, 1);                                      // SOF
+    if (frame.isExtended())
+    {
+        const uint32_t id = frame.id & CanFrame::MaskExtID;
+        counter.addBits(id >> 18, 11);                          // Base ID
+        counter.addBits(3, 2);                                  // SRR, IDE
+        counter.addBits(id, 18);                                // ID extension
+        counter.addBits(rtr ? 4U : 0U, 3);                      // RTR, r1, r0
+    }
+    else
+    {
+        counter.addBits(frame.id & CanFrame::MaskStdID, 11);
+        counter.addBits(rtr ? 4U : 0U, 3);                      // RTR, IDE, r0
+    }
+    counter.addBits(dlc, 4);
+    if (!rtr)
+    {
+        for (unsigned i = 0; i < dlc; i++)
+        {
+            counter.addBits(frame.data[i], 8);
+        }
+    }
+    counter.addCrc();
+
+    // CRC delimiter, ACK slot, ACK delimiter, end of frame, interframe space - not stuffed
+    return counter.getNumBits() + 1U + 2U + 7U + 3U;
+}
+
+}
@@ -8,19 +8,42 @@
 
 namespace uavcan
 {
-const unsigned CanAcceptanceFilterConfigurator::DefaultFilterMsgMask;
-const unsigned CanAcceptanceFilterConfigurator::DefaultFilterServiceRequestID;
-const unsigned CanAcceptanceFilterConfigurator::DefaultFilterServiceRequestMask;
-const unsigned CanAcceptanceFilterConfigurator::ServiceRespFrameID;
-const unsigned CanAcceptanceFilterConfigurator::ServiceRespFrameMask;
+const uint32_t CanAcceptanceFilterConfigurator::ServiceNotMessageBit;
+const uint32_t CanAcceptanceFilterConfigurator::RequestNotResponseBit;
+const uint32_t CanAcceptanceFilterConfigurator::MessageDataTypeIDMask;
+const uint32_t CanAcceptanceFilterConfigurator::AnonymousMessageDataTypeIDMask;
+const uint32_t CanAcceptanceFilterConfigurator::ServiceDataTypeIDMask;
+const uint32_t CanAcceptanceFilterConfigurator::DestinationNodeIDMask;
+const uint32_t CanAcceptanceFilterConfigurator::TrafficStatsKeyMask;
 
 int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration()
 {
     multiset_configs_.clear();
 
+#if !UAVCAN_TINY
+    /*
+     * The RX frame listener (e.g. a bus monitor or a sub-node bridge) and the promiscuous transfer listener need
+     * all frames, so everything is accepted.
+     */
+    if ((node_.getDispatcher().getRxFrameListener() != NULL) ||
+        (node_.getDispatcher().getPromiscuousTransferListener() != NULL))
+    {
+        const CanFilterConfig accept_all;           // Zero mask
+        return (multiset_configs_.emplace(accept_all) == NULL) ? -ErrMemory : 0;
+    }
+#endif
+
+    /*
+     * Service transfers are accepted only if they are addressed to the local node.
+     * In passive mode the Node ID is not known yet, so the destination is not checked.
+     */
+    const NodeID self_node_id = node_.getDispatcher().getNodeID();
+    const uint32_t dst_node_id = self_node_id.isUnicast() ? (uint32_t(self_node_id.get()) << 8) : 0U;
+    const uint32_t dst_node_id_mask = self_node_id.isUnicast() ? DestinationNodeIDMask : 0U;
+
     CanFilterConfig service_resp_cfg;
-    service_resp_cfg.id = ServiceRespFrameID;
-    service_resp_cfg.mask = ServiceRespFrameMask;
+    service_resp_cfg.id = CanFrame::FlagEFF | ServiceNotMessageBit | dst_node_id;
+    service_resp_cfg.mask = CanFrame::FlagEFF | ServiceNotMessageBit | RequestNotResponseBit | dst_node_id_mask;
     if (multiset_configs_.emplace(service_resp_cfg) == NULL)
     {
         return -ErrMemory;
@@ -29,10 +52,14 @@ int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration()
     const TransferListenerBase* p = node_.getDispatcher().getListOfMessageListeners().get();
     while (p)
     {
+        const uint32_t dtid = p->getDataTypeDescriptor().getID().get();
         CanFilterConfig cfg;
-        cfg.id = static_cast<uint32_t>(p->getDataTypeDescriptor().getID().get()) << 16;
-        cfg.id |= static_cast<uint32_t>(p->getDataTypeDescriptor().getKind()) << 8;
-        cfg.mask = DefaultFilterMsgMask;
+        cfg.id = CanFrame::FlagEFF | (dtid << 8);
+        cfg.mask = CanFrame::FlagEFF | ServiceNotMessageBit | MessageDataTypeIDMask;
+        if ((dtid & ~3U) == 0)
+        {
+            cfg.mask = CanFrame::FlagEFF | ServiceNotMessageBit | AnonymousMessageDataTypeIDMask;
+        }
         if (multiset_configs_.emplace(cfg) == NULL)
         {
             return -ErrMemory;
@@ -44,9 +71,10 @@ int16_t CanAcceptanceFilterConfigurator::loadInputConfiguration()
     while (p1)
     {
         CanFilterConfig cfg;
-        cfg.id = DefaultFilterServiceRequestID;
-        cfg.id |= static_cast<uint32_t>(p1->getDataTypeDescriptor().getID().get()) << 17;
-        cfg.mask = DefaultFilterServiceRequestMask;
+        cfg.id = CanFrame::FlagEFF | ServiceNotMessageBit | RequestNotResponseBit | dst_node_id;
+        cfg.id |= static_cast<uint32_t>(p1->getDataTypeDescriptor().getID().get()) << 16;
+        cfg.mask = CanFrame::FlagEFF | ServiceNotMessageBit | RequestNotResponseBit | ServiceDataTypeIDMask |
+                   dst_node_id_mask;
         if (multiset_configs_.emplace(cfg) == NULL)
         {
             return -ErrMemory;
@@ -85,6 +113,7 @@ int16_t CanAcceptanceFilterConfigurator::computeConfiguration()
     while (acceptance_filters_number < multiset_configs_.getSize())
     {
         uint16_t i_rank = 0, j_rank = 0;
+        uint32_t best_cost = 0xFFFFFFFFU;
         uint8_t best_rank = 0;
 
         const uint16_t multiset_array_size = static_cast<uint16_t>(multiset_configs_.getSize());
@@ -95,9 +124,11 @@ int16_t CanAcceptanceFilterConfigurator::computeConfiguration()
             {
                 CanFilterConfig temp_config = mergeFilters(*multiset_configs_.getByIndex(i_ind),
                                                            *multiset_configs_.getByIndex(j_ind));
+                const uint32_t cost = estimateFalseAcceptance(temp_config);
                 uint8_t rank = countBits(temp_config.mask);
-                if (rank > best_rank)
+                if ((cost < best_cost) || ((cost == best_cost) && (rank > best_rank)))
                 {
+                    best_cost = cost;
                     best_rank = rank;
                     i_rank = i_ind;
                     j_rank = j_ind;
@@ -112,9 +143,54 @@ int16_t CanAcceptanceFilterConfigurator::computeConfiguration()
 
     UAVCAN_ASSERT(acceptance_filters_number >= multiset_configs_.getSize());
 
+    decayTrafficStats();
+
+    return 0;
+}
+
+#if UAVCAN_TINY
+uint32_t CanAcceptanceFilterConfigurator::estimateFalseAcceptance(const CanFilterConfig&) const
+{
     return 0;
 }
 
+void CanAcceptanceFilterConfigurator::decayTrafficStats()
+{
+}
+#else
+uint32_t CanAcceptanceFilterConfigurator::estimateFalseAcceptance(const CanFilterConfig& cfg) const
+{
+    uint32_t cost = 0;
+    for (unsigned i = 0; i < NumTrafficStatsEntries; i++)
+    {
+        const TrafficStatsEntry& entry = traffic_stats_[i];
+        if ((entry.count == 0) || !isAccepted(cfg, entry.key))
+        {
+            continue;
+        }
+        // The frames that are already accepted by other filters don't make a difference
+        bool accepted = false;
+        for (uint16_t k = 0; !accepted && (k < multiset_configs_.getSize()); k++)
+        {
+            accepted = isAccepted(*multiset_configs_.getByIndex(k), entry.key);
+        }
+        if (!accepted)
+        {
+            cost += entry.count;
+        }
+    }
+    return cost;
+}
+
+void CanAcceptanceFilterConfigurator::decayTrafficStats()
+{
+    for (unsigned i = 0; i < NumTrafficStatsEntries; i++)
+    {
+        traffic_stats_[i].count /= 2U;
+    }
+}
+#endif
+
 int16_t CanAcceptanceFilterConfigurator::applyConfiguration(void)
 {
     CanFilterConfig filter_conf_array[MaxCanAcceptanceFilters];
@@ -133,6 +209,18 @@ int16_t CanAcceptanceFilterConfigurator::applyConfiguration(void)
         filter_conf_array[i] = temp_filter_config;
     }
 
+    bool same_as_applied = filter_array_size == num_applied_configs_;
+    for (uint16_t i = 0; same_as_applied && (i < filter_array_size); i++)
+    {
+        same_as_applied = filter_conf_array[i] == applied_configs_[i];
+    }
+    if (same_as_applied)
+    {
+        UAVCAN_TRACE("CanAcceptanceFilter", "Configuration did not change");
+        return 0;
+    }
+    num_applied_configs_ = 0;           // The driver may end up partially configured if something goes wrong
+
     ICanDriver& can_driver = node_.getDispatcher().getCanIOManager().getCanDriver();
     for (uint8_t i = 0; i < node_.getDispatcher().getCanIOManager().getNumIfaces(); i++)
     {
@@ -149,6 +237,13 @@ int16_t CanAcceptanceFilterConfigurator::applyConfiguration(void)
         }
     }
 
+    for (uint16_t i = 0; i < filter_array_size; i++)
+    {
+        applied_configs_[i] = filter_conf_array[i];
+    }
+    num_applied_configs_ = static_cast<uint16_t>(filter_array_size);
+    num_reconfigurations_++;
+
     return 0;
 }
 
@@ -183,6 +278,105 @@ int CanAcceptanceFilterConfigurator::configureFilters()
     return 0;
 }
 
+int CanAcceptanceFilterConfigurator::restoreConfiguration(const CanFilterConfig* configs, uint16_t num_configs)
+{
+    if ((configs == NULL) || (num_configs == 0) || (num_configs > getNumFilters()))
+    {
+        return -ErrInvalidParam;
+    }
+
+    multiset_configs_.clear();
+    for (uint16_t i = 0; i < num_configs; i++)
+    {
+        if (multiset_configs_.emplace(configs[i]) == NULL)
+        {
+            return -ErrMemory;
+        }
+    }
+
+    if (applyConfiguration() != 0)
+    {
+        UAVCAN_TRACE("CanAcceptanceFilter", "Failed to apply restored HW filter configuration");
+        return -ErrDriver;
+    }
+    return 0;
+}
+
+#if !UAVCAN_TINY
+int CanAcceptanceFilterConfigurator::enableAutomaticReconfiguration()
+{
+    IListenerRegistryObserver* const observer = node_.getDispatcher().getListenerRegistryObserver();
+    if ((observer != NULL) && (observer != this))
+    {
+        UAVCAN_TRACE("CanAcceptanceFilter", "Another listener registry observer is installed");
+        return -ErrLogic;
+    }
+
+    const int res = configureFilters();
+    if (res < 0)
+    {
+        return res;
+    }
+
+    node_.getDispatcher().installListenerRegistryObserver(this);
+    return 0;
+}
+
+void CanAcceptanceFilterConfigurator::disableAutomaticReconfiguration()
+{
+    if (isAutomaticReconfigurationEnabled())
+    {
+        node_.getDispatcher().removeListenerRegistryObserver();
+    }
+    TimerBase::stop();
+}
+
+bool CanAcceptanceFilterConfigurator::isAutomaticReconfigurationEnabled() const
+{
+    return node_.getDispatcher().getListenerRegistryObserver() == this;
+}
+
+void CanAcceptanceFilterConfigurator::handleListenerRegistryChange()
+{
+    if (!TimerBase::isRunning())
+    {
+        TimerBase::startOneShotWithDelay(MonotonicDuration());      // Deferred until the next spin
+    }
+}
+
+void CanAcceptanceFilterConfigurator::handleRejectedRxFrame(const CanRxFrame& frame)
+{
+    const uint32_t key = frame.id & TrafficStatsKeyMask;
+    unsigned least_frequent = 0;
+    for (unsigned i = 0; i < NumTrafficStatsEntries; i++)
+    {
+        TrafficStatsEntry& entry = traffic_stats_[i];
+        if ((entry.key == key) && (entry.count > 0))
+        {
+            entry.count++;
+            return;
+        }
+        if (entry.count < traffic_stats_[least_frequent].count)
+        {
+            least_frequent = i;
+        }
+    }
+    TrafficStatsEntry& entry = traffic_stats_[least_frequent];
+    entry.key = key;
+    entry.count++;
+}
+
+void CanAcceptanceFilterConfigurator::handleTimerEvent(const TimerEvent&)
+{
+    const int res = configureFilters();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("CanAcceptanceFilter", "Automatic reconfiguration failed: %d", res);
+        node_.registerInternalFailure("CAN acceptance filter reconfiguration");
+    }
+}
+#endif
+
 uint16_t CanAcceptanceFilterConfigurator::getNumFilters() const
 {
     static const uint16_t InvalidOut = 0xFFFF;
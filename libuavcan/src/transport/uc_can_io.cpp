@@ -4,27 +4,13 @@
  */
 
 #include <uavcan/transport/can_io.hpp>
+#include <uavcan/driver/static_binding.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/util/event_trace.hpp>
 #include <cassert>
 
 namespace uavcan
 {
-/*
- * CanRxFrame
- */
-#if UAVCAN_TOSTRING
-std::string CanRxFrame::toString(StringRepresentation mode) const
-{
-    std::string out = CanFrame::toString(mode);
-    out.reserve(128);
-    out += " ts_m="   + ts_mono.toString();
-    out += " ts_utc=" + ts_utc.toString();
-    out += " iface=";
-    out += char('0' + iface_index);
-    return out;
-}
-#endif
-
 /*
  * CanTxQueue::Entry
  */
@@ -97,22 +83,396 @@ CanTxQueue::~CanTxQueue()
     }
 }
 
-void CanTxQueue::registerRejectedFrame()
+#if !UAVCAN_TINY
+unsigned CanTxQueue::getPriorityLevel(const CanFrame& frame)
+{
+    // Same arbitration bits as in CanFrame::priorityHigherThan(), thus lower level means higher priority
+    const uint32_t clean_id = frame.id & CanFrame::MaskExtID;
+    const uint32_t arb11 = frame.isExtended() ? (clean_id >> 18) : (clean_id & CanFrame::MaskStdID);
+    return unsigned(arb11 >> 6);
+}
+#endif
+
+void CanTxQueue::insert(Entry* entry)
+{
+#if UAVCAN_TINY
+    queue_.insertBefore(entry, PriorityInsertionComparator(entry->frame));
+#else
+    linkPriority(entry);
+    linkDeadline(entry);
+#endif
+}
+
+#if !UAVCAN_TINY
+void CanTxQueue::linkPriority(Entry* entry)
+{
+    const unsigned level = getPriorityLevel(entry->frame);
+    UAVCAN_ASSERT(level < NumPriorityLevels);
+
+    Entry* prev = level_tails_[level];
+    if ((prev == NULL) || entry->frame.priorityHigherThan(prev->frame))
+    {
+        // Slow path - starting from the end of the closest non-empty level of higher priority
+        prev = NULL;
+        for (unsigned i = level; i > 0; i--)
+        {
+            if (level_tails_[i - 1] != NULL)
+            {
+                prev = level_tails_[i - 1];
+                break;
+            }
+        }
+        // Equal priority does not preempt, which preserves the order of frames
+        Entry* next = (prev == NULL) ? queue_.get() : prev->getNextListNode();
+        while ((next != NULL) && (getPriorityLevel(next->frame) == level) &&
+               !entry->frame.priorityHigherThan(next->frame))
+        {
+            prev = next;
+            next = next->getNextListNode();
+        }
+    }
+
+    queue_.insertAfter(prev, entry);
+
+    const Entry* const next = entry->getNextListNode();
+    if ((next == NULL) || (getPriorityLevel(next->frame) != level))
+    {
+        level_tails_[level] = entry;
+    }
+}
+
+void CanTxQueue::unlinkPriority(Entry* entry)
+{
+    const unsigned level = getPriorityLevel(entry->frame);
+    if (level_tails_[level] == entry)
+    {
+#if UAVCAN_DOUBLY_LINKED_LISTS
+        Entry* const prev = entry->getPrevListNode();
+#else
+        // Finding the previous entry, which is immediate if the entry is on top of the queue
+        Entry* prev = NULL;
+        Entry* p = queue_.get();
+        while ((p != NULL) && (p != entry))
+        {
+            prev = p;
+            p = p->getNextListNode();
+        }
+        UAVCAN_ASSERT(p == entry);
+#endif
+        level_tails_[level] = ((prev != NULL) && (getPriorityLevel(prev->frame) == level)) ? prev : NULL;
+    }
+    queue_.remove(entry);
+}
+
+void CanTxQueue::linkDeadline(Entry* entry)
+{
+    // Equal deadlines are kept in the order of insertion
+    Entry* prev = deadline_tail_;
+    while ((prev != NULL) && (entry->deadline < prev->deadline))
+    {
+        prev = prev->deadline_prev;
+    }
+    Entry* const next = (prev == NULL) ? deadline_head_ : prev->deadline_next;
+
+    entry->deadline_prev = prev;
+    entry->deadline_next = next;
+    if (prev != NULL)
+    {
+        prev->deadline_next = entry;
+    }
+    else
+    {
+        deadline_head_ = entry;
+    }
+    if (next != NULL)
+    {
+        next->deadline_prev = entry;
+    }
+    else
+    {
+        deadline_tail_ = entry;
+    }
+}
+
+void CanTxQueue::unlinkDeadline(Entry* entry)
+{
+    if (entry->deadline_prev != NULL)
+    {
+        entry->deadline_prev->deadline_next = entry->deadline_next;
+    }
+    else
+    {
+        UAVCAN_ASSERT(deadline_head_ == entry);
+        deadline_head_ = entry->deadline_next;
+    }
+    if (entry->deadline_next != NULL)
+    {
+        entry->deadline_next->deadline_prev = entry->deadline_prev;
+    }
+    else
+    {
+        UAVCAN_ASSERT(deadline_tail_ == entry);
+        deadline_tail_ = entry->deadline_prev;
+    }
+    entry->deadline_prev = NULL;
+    entry->deadline_next = NULL;
+}
+#endif
+
+void CanTxQueue::unlink(Entry*& entry)
 {
-    if (rejected_frames_cnt_ < NumericTraits<uint32_t>::max())
+#if UAVCAN_TINY
+    queue_.remove(entry);
+#else
+    unlinkPriority(entry);
+    unlinkDeadline(entry);
+#endif
+    Entry::destroy(entry, allocator_);
+}
+
+#if !UAVCAN_TINY
+void CanTxQueue::escalateApproachingDeadlines(MonotonicTime timestamp)
+{
+    if (!escalation_horizon_.isPositive())
     {
-        rejected_frames_cnt_++;
+        return;
+    }
+    static const uint32_t PriorityMask = uint32_t(NumPriorityLevels - 1) << 24;    // Top bits of the 29-bit ID
+
+    /*
+     * The deadline index keeps the frames of equal deadlines in the order of insertion, and the escalated frames
+     * are inserted after the frames of equal CAN ID, hence the frames of a transfer are not reordered.
+     */
+    const MonotonicTime limit = timestamp + escalation_horizon_;
+    for (Entry* p = deadline_head_; (p != NULL) && (p->deadline < limit); p = p->deadline_next)
+    {
+        if (!p->frame.isExtended() || ((p->flags & CanIOFlagCoalesce) != 0) ||
+            (getPriorityLevel(p->frame) <= escalation_ceiling_))
+        {
+            continue;
+        }
+        UAVCAN_TRACE("CanTxQueue", "Escalated %s", p->toString().c_str());
+        unlinkPriority(p);
+        p->frame.id = (p->frame.id & ~PriorityMask) | (uint32_t(escalation_ceiling_) << 24);
+        linkPriority(p);
+        if (escalated_frames_cnt_ < NumericTraits<uint32_t>::max())
+        {
+            escalated_frames_cnt_++;
+        }
     }
 }
+#endif
 
-void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags)
+CanTxQueue::Entry* CanTxQueue::findCoalescible(const CanFrame& frame, uint8_t iface_mask)
 {
-    const MonotonicTime timestamp = sysclock_.getMonotonic();
+#if UAVCAN_TINY
+    Entry* p = queue_.get();
+#else
+    // Frames with the same CAN ID belong to the same priority level, so only this level is traversed
+    const unsigned level = getPriorityLevel(frame);
+    if (level_tails_[level] == NULL)
+    {
+        return NULL;
+    }
+    Entry* p = queue_.get();
+    for (unsigned i = level; i > 0; i--)
+    {
+        if (level_tails_[i - 1] != NULL)
+        {
+            p = level_tails_[i - 1]->getNextListNode();
+            break;
+        }
+    }
+#endif
+    while (p != NULL)
+    {
+#if !UAVCAN_TINY
+        if (getPriorityLevel(p->frame) != level)
+        {
+            break;
+        }
+#endif
+        if ((p->frame.id == frame.id) && (p->flags & CanIOFlagCoalesce) && ((p->iface_mask & ~iface_mask) == 0))
+        {
+            return p;
+        }
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+CanTxQueue::Entry* CanTxQueue::findFirstPendingFor(uint8_t iface_index) const
+{
+    Entry* p = queue_.get();
+    while ((p != NULL) && !p->isPendingFor(iface_index))
+    {
+        p = p->getNextListNode();
+    }
+    return p;
+}
+
+CanTxQueue::Entry* CanTxQueue::findNextPendingFor(uint8_t iface_index) const
+{
+    Entry* const first = findFirstPendingFor(iface_index);
+#if !UAVCAN_TINY
+    if (!fair_scheduling_ || (first == NULL) || (last_tx_can_id_[iface_index] == 0))
+    {
+        return first;
+    }
+    CanFrame last_tx;
+    last_tx.id = last_tx_can_id_[iface_index];
+    const unsigned level = getPriorityLevel(first->frame);
+    if (getPriorityLevel(last_tx) != level)
+    {
+        return first;
+    }
+
+    /*
+     * The entries of the level are ordered by CAN ID, so the next CAN ID in the round is found in the first entry
+     * after the last transmitted CAN ID; if there is none, the next round begins.
+     */
+    for (Entry* p = first; (p != NULL) && (getPriorityLevel(p->frame) == level); p = p->getNextListNode())
+    {
+        if (p->isPendingFor(iface_index) && last_tx.priorityHigherThan(p->frame))
+        {
+            return p;
+        }
+    }
+#endif
+    return first;
+}
+
+void CanTxQueue::registerRejectedFrame(uint8_t iface_mask)
+{
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if ((iface_mask & (1U << i)) && (rejected_frames_cnt_[i] < NumericTraits<uint32_t>::max()))
+        {
+            rejected_frames_cnt_[i]++;
+        }
+    }
+}
+
+void CanTxQueue::removeExpired(MonotonicTime timestamp)
+{
+#if UAVCAN_TINY
+    Entry* p = queue_.get();
+    while (p)
+    {
+        Entry* const next = p->getNextListNode();
+        if (p->isExpired(timestamp))
+        {
+            UAVCAN_TRACE("CanTxQueue", "Expired %s", p->toString().c_str());
+            registerRejectedFrame(p->iface_mask);
+            remove(p);
+        }
+        p = next;
+    }
+#else
+    while ((deadline_head_ != NULL) && deadline_head_->isExpired(timestamp))
+    {
+        Entry* p = deadline_head_;
+        UAVCAN_TRACE("CanTxQueue", "Expired %s", p->toString().c_str());
+        registerRejectedFrame(p->iface_mask);
+        remove(p);
+    }
+#endif
+}
+
+void CanTxQueue::removePendingFor(uint8_t iface_index, unsigned num_to_keep)
+{
+    unsigned num_kept = 0;
+    Entry* p = queue_.get();
+    while ((p != NULL) && (num_pending_[iface_index] > num_kept))
+    {
+        Entry* next = p->getNextListNode();
+        if (p->isPendingFor(iface_index))
+        {
+            if (num_kept < num_to_keep)
+            {
+                num_kept++;
+            }
+            else
+            {
+                registerRejectedFrame(uint8_t(1U << iface_index));
+                release(p, iface_index);
+            }
+        }
+        p = next;
+    }
+}
+
+uint8_t CanTxQueue::enforceIfaceQuota(const CanFrame& frame, Qos qos, uint8_t iface_mask, MonotonicTime timestamp)
+{
+    bool cleaned_up = false;
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if (((iface_mask & (1U << i)) == 0) || (num_pending_[i] < iface_quota_))
+        {
+            continue;
+        }
+        if (!cleaned_up)
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push: iface %i quota exceeded, cleanup", int(i));
+            removeExpired(timestamp);
+            cleaned_up = true;
+            if (num_pending_[i] < iface_quota_)
+            {
+                continue;
+            }
+        }
+
+        UAVCAN_TRACE("CanTxQueue", "Push: iface %i quota exceeded, QoS arbitration", int(i));
+        registerRejectedFrame(uint8_t(1U << i));
+
+        // Find a frame with lowest QoS among the frames pending for this interface
+        Entry* lowestqos = findFirstPendingFor(i);
+        for (Entry* p = lowestqos; p != NULL; p = p->getNextListNode())
+        {
+            if (p->isPendingFor(i) && lowestqos->qosHigherThan(*p))
+            {
+                lowestqos = p;
+            }
+        }
+        if ((lowestqos == NULL) || lowestqos->qosHigherThan(frame, qos))
+        {
+            UAVCAN_TRACE("CanTxQueue", "Push rejected for iface %i: low QoS", int(i));
+            iface_mask = uint8_t(iface_mask & ~(1U << i));
+            continue;
+        }
+        UAVCAN_TRACE("CanTxQueue", "Push: Replacing for iface %i %s", int(i), lowestqos->toString().c_str());
+        release(lowestqos, i);
+    }
+    return iface_mask;
+}
+
+void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                      uint8_t iface_mask)
+{
+    push(frame, tx_deadline, qos, flags, iface_mask, DriverBinding::getMonotonic(sysclock_));
+}
+
+void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                      uint8_t iface_mask, MonotonicTime timestamp)
+{
+    UAVCAN_EVENT_TRACE_POINT(EventTraceCanTxQueuePush, iface_mask);
+    UAVCAN_ASSERT((iface_mask != 0) && (iface_mask < (1U << MaxCanIfaces)));
 
     if (timestamp >= tx_deadline)
     {
         UAVCAN_TRACE("CanTxQueue", "Push rejected: already expired");
-        registerRejectedFrame();
+        registerRejectedFrame(iface_mask);
+        return;
+    }
+
+    if ((flags & CanIOFlagCoalesce) && replace(frame, tx_deadline, qos, flags, iface_mask, timestamp))
+    {
+        return;
+    }
+
+    iface_mask = enforceIfaceQuota(frame, qos, iface_mask, timestamp);
+    if (iface_mask == 0)
+    {
         return;
     }
 
@@ -121,31 +481,20 @@ void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos,
     {
         UAVCAN_TRACE("CanTxQueue", "Push OOM #1, cleanup");
         // No memory left in the pool, so we try to remove expired frames
-        Entry* p = queue_.get();
-        while (p)
-        {
-            Entry* const next = p->getNextListNode();
-            if (p->isExpired(timestamp))
-            {
-                UAVCAN_TRACE("CanTxQueue", "Push: Expired %s", p->toString().c_str());
-                registerRejectedFrame();
-                remove(p);
-            }
-            p = next;
-        }
+        removeExpired(timestamp);
         praw = allocator_.allocate(sizeof(Entry));         // Try again
     }
 
     if (praw == NULL)
     {
         UAVCAN_TRACE("CanTxQueue", "Push OOM #2, QoS arbitration");
-        registerRejectedFrame();
 
         // Find a frame with lowest QoS
         Entry* p = queue_.get();
         if (p == NULL)
         {
             UAVCAN_TRACE("CanTxQueue", "Push rejected: Nothing to replace");
+            registerRejectedFrame(iface_mask);
             return;
         }
         Entry* lowestqos = p;
@@ -161,9 +510,11 @@ void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos,
         if (lowestqos->qosHigherThan(frame, qos))           // Frame that we want to transmit has lowest QoS
         {
             UAVCAN_TRACE("CanTxQueue", "Push rejected: low QoS");
+            registerRejectedFrame(iface_mask);
             return;                                         // What a loser.
         }
         UAVCAN_TRACE("CanTxQueue", "Push: Replacing %s", lowestqos->toString().c_str());
+        registerRejectedFrame(lowestqos->iface_mask);
         remove(lowestqos);
         praw = allocator_.allocate(sizeof(Entry));        // Try again
     }
@@ -172,31 +523,139 @@ void CanTxQueue::push(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos,
     {
         return;                                            // Seems that there is no memory at all.
     }
-    Entry* entry = new (praw) Entry(frame, tx_deadline, qos, flags);
+    Entry* entry = new (praw) Entry(frame, tx_deadline, qos, flags, iface_mask);
     UAVCAN_ASSERT(entry);
-    queue_.insertBefore(entry, PriorityInsertionComparator(frame));
+#if UAVCAN_LATENCY_HISTOGRAMS
+    entry->push_ts_usec = uint32_t(timestamp.toUSec());
+#endif
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if (entry->isPendingFor(i))
+        {
+            num_pending_[i]++;
+        }
+    }
+    insert(entry);
 }
 
-CanTxQueue::Entry* CanTxQueue::peek()
+bool CanTxQueue::replace(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                         uint8_t iface_mask)
 {
-    const MonotonicTime timestamp = sysclock_.getMonotonic();
+#if UAVCAN_LATENCY_HISTOGRAMS
+    const MonotonicTime now = DriverBinding::getMonotonic(sysclock_);
+#else
+    const MonotonicTime now;                                // Only needed for the latency histogram
+#endif
+    return replace(frame, tx_deadline, qos, flags, iface_mask, now);
+}
+
+bool CanTxQueue::replace(const CanFrame& frame, MonotonicTime tx_deadline, Qos qos, CanIOFlags flags,
+                         uint8_t iface_mask, MonotonicTime now)
+{
+    (void)now;
+    UAVCAN_ASSERT(flags & CanIOFlagCoalesce);
+    Entry* const entry = findCoalescible(frame, iface_mask);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    UAVCAN_TRACE("CanTxQueue", "Coalescing %s", entry->toString().c_str());
+
+    // The interfaces that have transmitted the old frame already will transmit the new one as well
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if ((iface_mask & (1U << i)) && !entry->isPendingFor(i))
+        {
+            if (num_pending_[i] < iface_quota_)
+            {
+                num_pending_[i]++;
+                entry->iface_mask = uint8_t(entry->iface_mask | (1U << i));
+            }
+            else
+            {
+                registerRejectedFrame(uint8_t(1U << i));
+            }
+        }
+    }
+
+    // The CAN ID is the same, hence the position in the queue remains valid
+    entry->frame = frame;
+    entry->deadline = tx_deadline;
+#if !UAVCAN_TINY
+    unlinkDeadline(entry);
+    linkDeadline(entry);
+#endif
+#if UAVCAN_LATENCY_HISTOGRAMS
+    entry->push_ts_usec = uint32_t(now.toUSec());
+#endif
+    entry->qos = uint8_t(qos);
+    entry->flags = flags;
+    return true;
+}
+
+CanTxQueue::Entry* CanTxQueue::peek(uint8_t iface_index)
+{
+    return peek(iface_index, DriverBinding::getMonotonic(sysclock_));
+}
+
+CanTxQueue::Entry* CanTxQueue::peek(uint8_t iface_index, MonotonicTime timestamp)
+{
+    UAVCAN_EVENT_TRACE_POINT(EventTraceCanTxQueuePeek, iface_index);
+#if UAVCAN_TINY
     Entry* p = queue_.get();
     while (p)
     {
+        Entry* const next = p->getNextListNode();
         if (p->isExpired(timestamp))
         {
             UAVCAN_TRACE("CanTxQueue", "Peek: Expired %s", p->toString().c_str());
-            Entry* const next = p->getNextListNode();
-            registerRejectedFrame();
+            registerRejectedFrame(p->iface_mask);
             remove(p);
-            p = next;
         }
-        else
+        else if (p->isPendingFor(iface_index))
         {
             return p;
         }
+        p = next;
     }
     return NULL;
+#else
+    removeExpired(timestamp);
+    escalateApproachingDeadlines(timestamp);
+    return findNextPendingFor(iface_index);
+#endif
+}
+
+void CanTxQueue::remove(Entry*& entry, uint8_t iface_index)
+{
+#if !UAVCAN_TINY
+    if (entry != NULL)
+    {
+        last_tx_can_id_[iface_index] = entry->frame.id;
+    }
+#endif
+    release(entry, iface_index);
+}
+
+void CanTxQueue::release(Entry*& entry, uint8_t iface_index)
+{
+    if (entry == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    UAVCAN_ASSERT(entry->isPendingFor(iface_index));
+    if (entry->isPendingFor(iface_index))
+    {
+        UAVCAN_ASSERT(num_pending_[iface_index] > 0);
+        num_pending_[iface_index]--;
+        entry->iface_mask = uint8_t(entry->iface_mask & ~(1U << iface_index));
+    }
+    if (entry->iface_mask == 0)
+    {
+        unlink(entry);
+    }
+    entry = NULL;
 }
 
 void CanTxQueue::remove(Entry*& entry)
@@ -206,18 +665,26 @@ void CanTxQueue::remove(Entry*& entry)
         UAVCAN_ASSERT(0);
         return;
     }
-    queue_.remove(entry);
-    Entry::destroy(entry, allocator_);
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if (entry->isPendingFor(i))
+        {
+            UAVCAN_ASSERT(num_pending_[i] > 0);
+            num_pending_[i]--;
+        }
+    }
+    unlink(entry);
 }
 
-const CanFrame* CanTxQueue::getTopPriorityPendingFrame() const
+const CanFrame* CanTxQueue::getTopPriorityPendingFrame(uint8_t iface_index) const
 {
-    return (queue_.get() == NULL) ? NULL : &queue_.get()->frame;
+    const Entry* const entry = findNextPendingFor(iface_index);
+    return (entry == NULL) ? NULL : &entry->frame;
 }
 
-bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame) const
+bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame, uint8_t iface_index) const
 {
-    const Entry* entry = queue_.get();
+    const Entry* const entry = findFirstPendingFor(iface_index);
     if (entry == NULL)
     {
         return false;
@@ -225,19 +692,145 @@ bool CanTxQueue::topPriorityHigherOrEqual(const CanFrame& rhs_frame) const
     return !rhs_frame.priorityHigherThan(entry->frame);
 }
 
+uint8_t CanTxQueue::getPendingIfaceMask() const
+{
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if (num_pending_[i] > 0)
+        {
+            mask = uint8_t(mask | (1U << i));
+        }
+    }
+    return mask;
+}
+
+/*
+ * CanEmergencyTxLane
+ */
+void CanEmergencyTxLane::removeAt(unsigned index)
+{
+    UAVCAN_ASSERT(index < size_);
+    size_--;
+    for (unsigned i = index; i < size_; i++)
+    {
+        entries_[i] = entries_[i + 1];
+    }
+    entries_[size_] = Entry();
+}
+
+int CanEmergencyTxLane::findTopPendingFor(uint8_t iface_index) const
+{
+    int top = -1;
+    for (unsigned i = 0; i < size_; i++)
+    {
+        // Strict comparison keeps the order of insertion for equal priorities
+        if (entries_[i].isPendingFor(iface_index) &&
+            ((top < 0) || entries_[i].frame.priorityHigherThan(entries_[top].frame)))
+        {
+            top = int(i);
+        }
+    }
+    return top;
+}
+
+bool CanEmergencyTxLane::push(const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags,
+                              uint8_t iface_mask, MonotonicTime now)
+{
+    removeExpired(now);
+    if (size_ >= Capacity)
+    {
+        UAVCAN_TRACE("CanEmergencyTxLane", "Full, frame %s", frame.toString().c_str());
+        return false;
+    }
+    Entry& entry = entries_[size_];
+    entry.frame = frame;
+    entry.deadline = tx_deadline;
+    entry.flags = flags;
+    entry.iface_mask = iface_mask;
+    size_++;
+    return true;
+}
+
+CanEmergencyTxLane::Entry* CanEmergencyTxLane::peek(uint8_t iface_index, MonotonicTime now)
+{
+    removeExpired(now);
+    const int index = findTopPendingFor(iface_index);
+    return (index < 0) ? NULL : &entries_[index];
+}
+
+void CanEmergencyTxLane::remove(Entry*& entry, uint8_t iface_index)
+{
+    if ((entry == NULL) || (entry < entries_) || (entry >= (entries_ + size_)))
+    {
+        UAVCAN_ASSERT(0);
+        return;
+    }
+    const unsigned index = unsigned(entry - entries_);
+    UAVCAN_ASSERT(entry->isPendingFor(iface_index));
+    entry->iface_mask = uint8_t(entry->iface_mask & ~(1U << iface_index));
+    if (entry->iface_mask == 0)
+    {
+        removeAt(index);
+    }
+    entry = NULL;
+}
+
+void CanEmergencyTxLane::removeExpired(MonotonicTime now)
+{
+    unsigned i = 0;
+    while (i < size_)
+    {
+        if (now > entries_[i].deadline)
+        {
+            UAVCAN_TRACE("CanEmergencyTxLane", "Expired %s", entries_[i].frame.toString().c_str());
+            for (uint8_t k = 0; k < MaxCanIfaces; k++)
+            {
+                if (entries_[i].isPendingFor(k))
+                {
+                    rejected_frames_cnt_[k]++;
+                }
+            }
+            removeAt(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+const CanFrame* CanEmergencyTxLane::getTopPriorityPendingFrame(uint8_t iface_index) const
+{
+    const int index = findTopPendingFor(iface_index);
+    return (index < 0) ? NULL : &entries_[index].frame;
+}
+
+uint8_t CanEmergencyTxLane::getPendingIfaceMask() const
+{
+    uint8_t mask = 0;
+    for (unsigned i = 0; i < size_; i++)
+    {
+        mask = uint8_t(mask | entries_[i].iface_mask);
+    }
+    return mask;
+}
+
 /*
  * CanIOManager
  */
-int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags)
+int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, MonotonicTime tx_deadline, CanIOFlags flags,
+                              MonotonicTime now)
 {
     UAVCAN_ASSERT(iface_index < MaxCanIfaces);
-    ICanIface* const iface = driver_.getIface(iface_index);
+    ICanIface* const iface = DriverBinding::getIface(driver_, iface_index);
     if (iface == NULL)
     {
         UAVCAN_ASSERT(0);   // Nonexistent interface
         return -ErrLogic;
     }
-    const int res = iface->send(frame, tx_deadline, flags);
+    const int res = DriverBinding::send(*iface, frame, tx_deadline,
+                                        CanIOFlags(flags & ~(CanIOFlagCoalesce | CanIOFlagEmergency)));
     if (res != 1)
     {
         UAVCAN_TRACE("CanIOManager", "Send failed: code %i, iface %i, frame %s",
@@ -246,32 +839,81 @@ int CanIOManager::sendToIface(uint8_t iface_index, const CanFrame& frame, Monoto
     if (res > 0)
     {
         counters_[iface_index].frames_tx += unsigned(res);
+        counters_[iface_index].bytes_tx += uint64_t(frame.dlc) * unsigned(res);
+#if !UAVCAN_TINY
+        if (bus_load_[iface_index].isEnabled())
+        {
+            bus_load_[iface_index].addFrame(frame, now);
+        }
+        if (health_[iface_index].bus_state == CanBusStateBusOff)
+        {
+            UAVCAN_TRACE("CanIOManager", "Iface %i has recovered from bus off", int(iface_index));
+            health_[iface_index].bus_state = CanBusStateErrorActive;    // Will be corrected by the next check
+            updateTxSuppressedMask();
+        }
+#else
+        (void)now;
+#endif
     }
     return res;
 }
 
-int CanIOManager::sendFromTxQueue(uint8_t iface_index)
+int CanIOManager::sendFromTxQueue(uint8_t iface_index, MonotonicTime now)
 {
     UAVCAN_ASSERT(iface_index < MaxCanIfaces);
-    CanTxQueue::Entry* entry = tx_queues_[iface_index]->peek();
+
+    CanEmergencyTxLane::Entry* urgent = emergency_lane_.peek(iface_index, now);
+    if (urgent != NULL)
+    {
+        const int res = sendToIface(iface_index, urgent->frame, urgent->deadline, urgent->flags, now);
+        if (res > 0)
+        {
+            emergency_lane_.remove(urgent, iface_index);
+        }
+        return res;
+    }
+
+    CanTxQueue::Entry* entry = tx_queue_->peek(iface_index, now);
     if (entry == NULL)
     {
         return 0;
     }
-    const int res = sendToIface(iface_index, entry->frame, entry->deadline, entry->flags);
+    const int res = sendToIface(iface_index, entry->frame, entry->deadline, entry->flags, now);
     if (res > 0)
     {
-        tx_queues_[iface_index]->remove(entry);
+#if UAVCAN_LATENCY_HISTOGRAMS
+        // The residence time is computed modulo 2^32 microseconds, which is more than an hour
+        const uint32_t now_usec = uint32_t(now.toUSec());
+        tx_queue_latency_.add(MonotonicDuration::fromUSec(now_usec - entry->push_ts_usec));
+#endif
+        tx_queue_->remove(entry, iface_index);
     }
     return res;
 }
 
+const CanFrame* CanIOManager::getTopPriorityPendingFrame(uint8_t iface_index) const
+{
+    const CanFrame* const urgent = emergency_lane_.getTopPriorityPendingFrame(iface_index);
+    return (urgent != NULL) ? urgent : tx_queue_->getTopPriorityPendingFrame(iface_index);
+}
+
+bool CanIOManager::hasQueuedFrameBefore(const CanFrame& frame, bool emergency, uint8_t iface_index) const
+{
+    // The emergency lane goes before everything else; the regular queue never goes before an emergency frame
+    const CanFrame* const urgent = emergency_lane_.getTopPriorityPendingFrame(iface_index);
+    if (urgent != NULL)
+    {
+        return !emergency || !frame.priorityHigherThan(*urgent);
+    }
+    return !emergency && tx_queue_->topPriorityHigherOrEqual(frame, iface_index);
+}
+
 int CanIOManager::callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pending_tx)[MaxCanIfaces],
                              MonotonicTime blocking_deadline)
 {
     const CanSelectMasks in_masks = inout_masks;
 
-    const int res = driver_.select(inout_masks, pending_tx, blocking_deadline);
+    const int res = DriverBinding::select(driver_, inout_masks, pending_tx, blocking_deadline);
     if (res < 0)
     {
         return -ErrDriver;
@@ -282,10 +924,133 @@ int CanIOManager::callSelect(CanSelectMasks& inout_masks, const CanFrame* (& pen
     return res;
 }
 
+#if !UAVCAN_TINY
+
+void CanIOManager::checkIfaceHealth(MonotonicTime now)
+{
+    next_health_check_ts_ = now + MonotonicDuration::fromMSec(IfaceHealthCheckPeriodMs);
+    const uint8_t pending_mask = makePendingTxMask();
+
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        const ICanIface* const iface = DriverBinding::getIface(driver_, i);
+        if (iface == NULL)
+        {
+            UAVCAN_ASSERT(0);
+            continue;
+        }
+        IfaceHealth& health = health_[i];
+        const uint64_t error_count = iface->getErrorCount();
+        const bool tx_pending = (pending_mask & (1U << i)) != 0;
+
+        CanBusState state = iface->getBusState();
+        if (state == CanBusStateUnknown)
+        {
+            // The errors keep growing while the frames that were pending at the previous check can't get through
+            const bool stalled = health.tx_pending && tx_pending && (counters_[i].frames_tx == health.frames_tx);
+            if (stalled && (error_count > health.error_count))
+            {
+                state = CanBusStateBusOff;
+            }
+            else
+            {
+                // Recovery is detected upon transmission, see sendToIface()
+                state = (health.bus_state == CanBusStateBusOff) ? CanBusStateBusOff : CanBusStateErrorActive;
+            }
+        }
+
+        if (state != health.bus_state)
+        {
+            UAVCAN_TRACE("CanIOManager", "Iface %i bus state %i --> %i", int(i), int(health.bus_state), int(state));
+        }
+        health.bus_state = uint8_t(state);
+        health.error_count = error_count;
+        health.frames_tx = counters_[i].frames_tx;
+        health.tx_pending = tx_pending;
+    }
+
+    updateTxSuppressedMask();
+}
+
+void CanIOManager::updateTxSuppressedMask()
+{
+    uint8_t error_active_mask = 0;
+    uint8_t error_passive_mask = 0;
+    uint8_t bus_off_mask = 0;
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        const uint8_t bit = uint8_t(1U << i);
+        switch (health_[i].bus_state)
+        {
+        case CanBusStateErrorPassive:
+        {
+            error_passive_mask = uint8_t(error_passive_mask | bit);
+            break;
+        }
+        case CanBusStateBusOff:
+        {
+            bus_off_mask = uint8_t(bus_off_mask | bit);
+            break;
+        }
+        default:
+        {
+            error_active_mask = uint8_t(error_active_mask | bit);
+            break;
+        }
+        }
+    }
+
+    // An error passive interface is still the best option if no other interface is error active
+    const uint8_t new_mask = uint8_t(bus_off_mask | ((error_active_mask != 0) ? error_passive_mask : 0U));
+
+    // The frames that were queued for the newly suppressed interfaces are dropped, except for the probe
+    const uint8_t newly_suppressed = uint8_t(new_mask & ~tx_suppressed_mask_);
+    tx_suppressed_mask_ = new_mask;
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        if ((newly_suppressed & (1U << i)) != 0)
+        {
+            UAVCAN_TRACE("CanIOManager", "TX suppressed on iface %i, %u frames pending",
+                         int(i), tx_queue_->getNumPendingFrames(i));
+            tx_queue_->removePendingFor(i, 1);
+        }
+    }
+}
+
+uint8_t CanIOManager::filterTxSuppressedIfaces(uint8_t iface_mask)
+{
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        const uint8_t bit = uint8_t(1U << i);
+        if (((iface_mask & tx_suppressed_mask_ & bit) != 0) && (tx_queue_->getNumPendingFrames(i) > 0))
+        {
+            iface_mask = uint8_t(iface_mask & ~bit);        // Otherwise this frame will be the probe
+            counters_[i].frames_suppressed++;
+        }
+    }
+    return iface_mask;
+}
+
+CanBusState CanIOManager::getIfaceBusState(uint8_t iface_index) const
+{
+    if (iface_index >= num_ifaces_)
+    {
+        UAVCAN_ASSERT(0);
+        return CanBusStateUnknown;
+    }
+    return CanBusState(health_[iface_index].bus_state);
+}
+
+#endif
+
 CanIOManager::CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISystemClock& sysclock,
                            std::size_t mem_blocks_per_iface)
     : driver_(driver)
     , sysclock_(sysclock)
+#if !UAVCAN_TINY
+    , external_tx_source_(NULL)
+    , tx_suppressed_mask_(0)
+#endif
     , num_ifaces_(driver.getNumIfaces())
 {
     if (num_ifaces_ < 1 || num_ifaces_ > MaxCanIfaces)
@@ -300,55 +1065,89 @@ CanIOManager::CanIOManager(ICanDriver& driver, IPoolAllocator& allocator, ISyste
     UAVCAN_TRACE("CanIOManager", "Memory blocks per iface: %u, total: %u",
                  unsigned(mem_blocks_per_iface), unsigned(allocator.getNumBlocks()));
 
-    for (int i = 0; i < num_ifaces_; i++)
-    {
-        tx_queues_[i].construct<IPoolAllocator&, ISystemClock&, std::size_t>
-        (allocator, sysclock, mem_blocks_per_iface);
-    }
+    // Every interface keeps its quota, the redundant frames are stored once
+    tx_queue_.construct<IPoolAllocator&, ISystemClock&, std::size_t, uint8_t>
+    (allocator, sysclock, mem_blocks_per_iface * num_ifaces_, num_ifaces_);
 }
 
 uint8_t CanIOManager::makePendingTxMask() const
 {
-    uint8_t write_mask = 0;
-    for (uint8_t i = 0; i < getNumIfaces(); i++)
-    {
-        if (!tx_queues_[i]->isEmpty())
-        {
-            write_mask |= uint8_t(1 << i);
-        }
-    }
-    return write_mask;
+    return uint8_t(tx_queue_->getPendingIfaceMask() | emergency_lane_.getPendingIfaceMask());
 }
 
 CanIfacePerfCounters CanIOManager::getIfacePerfCounters(uint8_t iface_index) const
 {
-    ICanIface* const iface = driver_.getIface(iface_index);
+    ICanIface* const iface = DriverBinding::getIface(driver_, iface_index);
     if (iface == NULL || iface_index >= MaxCanIfaces)
     {
         UAVCAN_ASSERT(0);
         return CanIfacePerfCounters();
     }
     CanIfacePerfCounters cnt;
-    cnt.errors = iface->getErrorCount() + tx_queues_[iface_index]->getRejectedFrameCount();
+    cnt.errors = iface->getErrorCount() + tx_queue_->getRejectedFrameCount(iface_index) +
+                 emergency_lane_.getRejectedFrameCount(iface_index) + counters_[iface_index].frames_suppressed;
     cnt.frames_rx = counters_[iface_index].frames_rx;
     cnt.frames_tx = counters_[iface_index].frames_tx;
+    cnt.bytes_rx = counters_[iface_index].bytes_rx;
+    cnt.bytes_tx = counters_[iface_index].bytes_tx;
     return cnt;
 }
 
+#if !UAVCAN_TINY
+
+void CanIOManager::configureBusLoadEstimation(uint32_t bitrate, MonotonicDuration window)
+{
+    const MonotonicTime now = DriverBinding::getMonotonic(sysclock_);
+    for (uint8_t i = 0; i < num_ifaces_; i++)
+    {
+        bus_load_[i].configure(bitrate, window, now);
+    }
+}
+
+float CanIOManager::getBusLoad(uint8_t iface_index) const
+{
+    if (iface_index >= num_ifaces_)
+    {
+        UAVCAN_ASSERT(0);
+        return 0.0F;
+    }
+    return bus_load_[iface_index].getLoad(DriverBinding::getMonotonic(sysclock_));
+}
+
+#endif
+
 int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
                        uint8_t iface_mask, CanTxQueue::Qos qos, CanIOFlags flags)
 {
     const uint8_t num_ifaces = getNumIfaces();
     const uint8_t all_ifaces_mask = uint8_t((1U << num_ifaces) - 1);
     iface_mask &= all_ifaces_mask;
+    const bool emergency = (flags & CanIOFlagEmergency) != 0;
 
     if (blocking_deadline > tx_deadline)
     {
         blocking_deadline = tx_deadline;
     }
 
+#if !UAVCAN_TINY
+    // The emergency frames have their own storage, so they are never suppressed
+    if (((iface_mask & tx_suppressed_mask_) != 0) && !emergency)
+    {
+        iface_mask = filterTxSuppressedIfaces(iface_mask);
+    }
+#endif
+
     int retval = 0;
 
+    if (flags & CanIOFlagCoalesce)
+    {
+        // The stale value must not be transmitted before the new one, so it is replaced right away
+        if ((iface_mask != 0) && tx_queue_->replace(frame, tx_deadline, qos, flags, iface_mask))
+        {
+            iface_mask = 0;
+        }
+    }
+
     while (true)        // Somebody please refactor this.
     {
         if (iface_mask == 0)
@@ -362,16 +1161,15 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
             // Building the list of next pending frames per iface.
             // The driver will give them a scrutinizing look before deciding whether he wants to accept them.
             const CanFrame* pending_tx[MaxCanIfaces] = {};
-            for (int i = 0; i < num_ifaces; i++)
+            for (uint8_t i = 0; i < num_ifaces; i++)
             {
-                CanTxQueue& q = *tx_queues_[i];
                 if (iface_mask & (1 << i))      // I hate myself so much right now.
                 {
-                    pending_tx[i] = q.topPriorityHigherOrEqual(frame) ? q.getTopPriorityPendingFrame() : &frame;
+                    pending_tx[i] = hasQueuedFrameBefore(frame, emergency, i) ? getTopPriorityPendingFrame(i) : &frame;
                 }
                 else
                 {
-                    pending_tx[i] = q.getTopPriorityPendingFrame();
+                    pending_tx[i] = getTopPriorityPendingFrame(i);
                 }
             }
 
@@ -383,6 +1181,21 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
             UAVCAN_ASSERT(masks.read == 0);
         }
 
+        // The transmission does not block, so this timestamp is used for the timeout check as well
+        const MonotonicTime now = DriverBinding::getMonotonic(sysclock_);
+        last_select_ts_ = now;
+        emergency_lane_.removeExpired(now);
+#if !UAVCAN_TINY
+        if (now >= next_health_check_ts_)
+        {
+            checkIfaceHealth(now);
+            if (((iface_mask & tx_suppressed_mask_) != 0) && !emergency)
+            {
+                iface_mask = filterTxSuppressedIfaces(iface_mask);
+            }
+        }
+#endif
+
         // Transmission
         for (uint8_t i = 0; i < num_ifaces; i++)
         {
@@ -391,13 +1204,13 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 int res = 0;
                 if (iface_mask & (1 << i))
                 {
-                    if (tx_queues_[i]->topPriorityHigherOrEqual(frame))
+                    if (hasQueuedFrameBefore(frame, emergency, i))
                     {
-                        res = sendFromTxQueue(i);                 // May return 0 if nothing to transmit (e.g. expired)
+                        res = sendFromTxQueue(i, now);            // May return 0 if nothing to transmit (e.g. expired)
                     }
                     if (res <= 0)
                     {
-                        res = sendToIface(i, frame, tx_deadline, flags);
+                        res = sendToIface(i, frame, tx_deadline, flags, now);
                         if (res > 0)
                         {
                             iface_mask &= uint8_t(~(1 << i));     // Mark transmitted
@@ -406,7 +1219,7 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 }
                 else
                 {
-                    res = sendFromTxQueue(i);
+                    res = sendFromTxQueue(i, now);
                 }
                 if (res > 0)
                 {
@@ -416,7 +1229,7 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
         }
 
         // Timeout. Enqueue the frame if wasn't transmitted and leave.
-        const bool timed_out = sysclock_.getMonotonic() >= blocking_deadline;
+        const bool timed_out = now >= blocking_deadline;
         if (masks.write == 0 || timed_out)
         {
             if (!timed_out)
@@ -424,12 +1237,9 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
                 UAVCAN_TRACE("CanIOManager", "Send: Premature timeout in select(), will try again");
                 continue;
             }
-            for (uint8_t i = 0; i < num_ifaces; i++)
+            if ((iface_mask != 0) && !(emergency && emergency_lane_.push(frame, tx_deadline, flags, iface_mask, now)))
             {
-                if (iface_mask & (1 << i))
-                {
-                    tx_queues_[i]->push(frame, tx_deadline, qos, flags);
-                }
+                tx_queue_->push(frame, tx_deadline, qos, flags, iface_mask, now);  // One entry for all ifaces
             }
             break;
         }
@@ -439,10 +1249,23 @@ int CanIOManager::send(const CanFrame& frame, MonotonicTime tx_deadline, Monoton
 
 int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline, CanIOFlags& out_flags)
 {
+    return receiveBatch(&out_frame, &out_flags, 1, blocking_deadline);
+}
+
+int CanIOManager::receiveBatch(CanRxFrame* out_frames, CanIOFlags* out_flags, unsigned max_frames,
+                               MonotonicTime blocking_deadline)
+{
+    UAVCAN_ASSERT((out_frames != NULL) && (out_flags != NULL) && (max_frames > 0));
     const uint8_t num_ifaces = getNumIfaces();
 
     while (true)
     {
+#if !UAVCAN_TINY
+        if (external_tx_source_ != NULL)
+        {
+            external_tx_source_->flushPendingTransfers();   // May enqueue new frames, so it goes before the TX mask
+        }
+#endif
         CanSelectMasks masks;
         masks.write = makePendingTxMask();
         masks.read = uint8_t((1 << num_ifaces) - 1);
@@ -450,7 +1273,7 @@ int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline
             const CanFrame* pending_tx[MaxCanIfaces] = {};
             for (int i = 0; i < num_ifaces; i++)      // Dear compiler, kindly unroll this. Thanks.
             {
-                pending_tx[i] = tx_queues_[i]->getTopPriorityPendingFrame();
+                pending_tx[i] = getTopPriorityPendingFrame(uint8_t(i));
             }
 
             const int select_res = callSelect(masks, pending_tx, blocking_deadline);
@@ -460,12 +1283,22 @@ int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline
             }
         }
 
+        // Used for the TX queue, bus load estimation and the timeout check, so the clock is read once per select()
+        const MonotonicTime now = DriverBinding::getMonotonic(sysclock_);
+        last_select_ts_ = now;
+
+        // Expired frames are dropped even if no interface is writable, so that they don't hold the pool memory
+        emergency_lane_.removeExpired(now);
+#if !UAVCAN_TINY
+        tx_queue_->removeExpired(now);
+#endif
+
         // Write - if buffers are not empty, one frame will be sent for each iface per one receive() call
         for (uint8_t i = 0; i < num_ifaces; i++)
         {
             if (masks.write & (1 << i))
             {
-                (void)sendFromTxQueue(i);  // It may fail, we don't care. Requested operation was receive, not send.
+                (void)sendFromTxQueue(i, now);  // It may fail, we don't care. Requested operation was receive.
             }
         }
 
@@ -474,31 +1307,45 @@ int CanIOManager::receive(CanRxFrame& out_frame, MonotonicTime blocking_deadline
         {
             if (masks.read & (1 << i))
             {
-                ICanIface* const iface = driver_.getIface(i);
+                ICanIface* const iface = DriverBinding::getIface(driver_, i);
                 if (iface == NULL)
                 {
                     UAVCAN_ASSERT(0);   // Nonexistent interface
                     continue;
                 }
 
-                const int res = iface->receive(out_frame, out_frame.ts_mono, out_frame.ts_utc, out_flags);
+                const int res = (max_frames == 1) ?
+                    DriverBinding::receive(*iface, out_frames[0], out_frames[0].ts_mono, out_frames[0].ts_utc,
+                                           out_flags[0]) :
+                    DriverBinding::receiveBatch(*iface, out_frames, out_flags, uint16_t(min(max_frames, 0xFFFFU)));
                 if (res == 0)
                 {
                     UAVCAN_ASSERT(0);   // select() reported that iface has pending RX frames, but receive() returned none
                     continue;
                 }
-                out_frame.iface_index = i;
+                if (res < 0)
+                {
+                    return -ErrDriver;
+                }
 
-                if ((res > 0) && !(out_flags & CanIOFlagLoopback))
+                for (int k = 0; k < res; k++)
                 {
-                    counters_[i].frames_rx += 1;
+                    out_frames[k].iface_index = i;
+                    if (!(out_flags[k] & CanIOFlagLoopback))
+                    {
+                        counters_[i].frames_rx += 1;
+                        counters_[i].bytes_rx += out_frames[k].dlc;
+#if !UAVCAN_TINY
+                        bus_load_[i].addFrame(out_frames[k], now);    // Loopback frames are counted on TX
+#endif
+                    }
                 }
-                return (res < 0) ? -ErrDriver : res;
+                return res;
             }
         }
 
         // Timeout checked in the last order - this way we can operate with expired deadline:
-        if (sysclock_.getMonotonic() >= blocking_deadline)
+        if (now >= blocking_deadline)
         {
             break;
         }
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/data_type_stats.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+
+DataTypeStats* DataTypeStatsTable::access(DataTypeKind kind, DataTypeID dtid)
+{
+    DataTypeStats* const existing = const_cast<DataTypeStats*>(find(kind, dtid));
+    if ((existing != NULL) || (num_entries_ >= unsigned(Capacity)))
+    {
+        return existing;
+    }
+    DataTypeStats& entry = entries_[num_entries_++];
+    entry.data_type_kind = kind;
+    entry.data_type_id = dtid;
+    UAVCAN_TRACE("DataTypeStatsTable", "New entry: kind=%i dtid=%i", int(kind), int(dtid.get()));
+    return &entry;
+}
+
+const DataTypeStats* DataTypeStatsTable::find(DataTypeKind kind, DataTypeID dtid) const
+{
+    for (unsigned i = 0; i < num_entries_; i++)
+    {
+        if ((entries_[i].data_type_kind == kind) && (entries_[i].data_type_id == dtid))
+        {
+            return &entries_[i];
+        }
+    }
+    return NULL;
+}
+
+void DataTypeStatsTable::resetCounters()
+{
+    for (unsigned i = 0; i < num_entries_; i++)
+    {
+        entries_[i].resetCounters();
+    }
+}
+
+}
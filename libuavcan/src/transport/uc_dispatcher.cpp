@@ -3,7 +3,11 @@
  */
 
 #include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/promiscuous_transfer_listener.hpp>
+#include <uavcan/driver/static_binding.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/util/event_trace.hpp>
+#include <uavcan/util/templates.hpp>
 #include <cassert>
 
 namespace uavcan
@@ -14,6 +18,14 @@ namespace uavcan
  */
 void LoopbackFrameListenerBase::startListening()
 {
+    all_data_types_ = true;
+    dispatcher_.getLoopbackFrameListenerRegistry().add(this);
+}
+
+void LoopbackFrameListenerBase::startListening(DataTypeID data_type_id)
+{
+    data_type_id_ = data_type_id;
+    all_data_types_ = false;
     dispatcher_.getLoopbackFrameListenerRegistry().add(this);
 }
 
@@ -30,31 +42,50 @@ bool LoopbackFrameListenerBase::isListening() const
 /*
  * LoopbackFrameListenerRegistry
  */
+void LoopbackFrameListenerRegistry::updateDataTypeMask()
+{
+    uint64_t mask = 0;
+    for (const LoopbackFrameListenerBase* p = listeners_.get(); p != NULL; p = p->getNextListNode())
+    {
+        mask |= p->isInterestedInAllDataTypes() ? ~uint64_t(0) : (uint64_t(1) << (p->getDataTypeID().get() & 63U));
+    }
+    data_type_mask_ = mask;
+}
+
 void LoopbackFrameListenerRegistry::add(LoopbackFrameListenerBase* listener)
 {
     UAVCAN_ASSERT(listener);
     listeners_.insert(listener);
+    updateDataTypeMask();
 }
 
 void LoopbackFrameListenerRegistry::remove(LoopbackFrameListenerBase* listener)
 {
     UAVCAN_ASSERT(listener);
     listeners_.remove(listener);
+    updateDataTypeMask();
 }
 
-bool LoopbackFrameListenerRegistry::doesExist(const LoopbackFrameListenerBase* listener) const
+bool LoopbackFrameListenerRegistry::mayBeInterestedIn(const CanFrame& can_frame) const
 {
-    UAVCAN_ASSERT(listener);
-    const LoopbackFrameListenerBase* p = listeners_.get();
-    while (p)
+    if (data_type_mask_ == 0)
     {
-        if (p == listener)
-        {
-            return true;
-        }
-        p = p->getNextListNode();
+        return false;
     }
-    return false;
+    const uint32_t id = can_frame.id & CanFrame::MaskExtID;
+    const bool service_not_message = ((id >> 7) & 1U) != 0U;
+    if (!service_not_message && ((id & NodeID::Max) == 0U))
+    {
+        return true;            // Anonymous message, the data type ID is mostly replaced with the discriminator
+    }
+    const uint32_t dtid = service_not_message ? (id >> 16) : (id >> 8);
+    return (data_type_mask_ & (uint64_t(1) << (dtid & 63U))) != 0U;
+}
+
+bool LoopbackFrameListenerRegistry::doesExist(const LoopbackFrameListenerBase* listener) const
+{
+    UAVCAN_ASSERT(listener);
+    return listeners_.contains(listener);
 }
 
 void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
@@ -63,7 +94,10 @@ void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
     while (p)
     {
         LoopbackFrameListenerBase* const next = p->getNextListNode();
-        p->handleLoopbackFrame(frame);     // p may be modified
+        if (p->isInterestedIn(frame.getDataTypeID()))
+        {
+            p->handleLoopbackFrame(frame); // p may be modified
+        }
         p = next;
     }
 }
@@ -72,42 +106,105 @@ void LoopbackFrameListenerRegistry::invokeListeners(RxFrame& frame)
 /*
  * Dispatcher::ListenerRegister
  */
+TransferListenerBase* Dispatcher::ListenerRegistry::findFirstLinear(DataTypeID dtid) const
+{
+    TransferListenerBase* p = list_.get();
+    while (p)
+    {
+        const DataTypeID p_dtid = p->getDataTypeDescriptor().getID();
+        if (p_dtid == dtid)
+        {
+            return p;
+        }
+        if (p_dtid < dtid)      // Listeners are ordered by data type id!
+        {
+            break;
+        }
+        p = p->getNextListNode();
+    }
+    return NULL;
+}
+
+TransferListenerBase* Dispatcher::ListenerRegistry::findFirst(DataTypeID dtid)
+{
+    if (DispatcherListenerIndexSize == 0)
+    {
+        return findFirstLinear(dtid);
+    }
+    IndexEntry& entry = index_[getIndexPosition(dtid)];
+    if (entry.dtid != dtid)
+    {
+        entry.dtid = dtid;      // Evicting the previous entry, if any
+        entry.first = findFirstLinear(dtid);
+    }
+    return entry.first;
+}
+
+void Dispatcher::ListenerRegistry::updateIndex(DataTypeID dtid)
+{
+    if (DispatcherListenerIndexSize > 0)
+    {
+        IndexEntry& entry = index_[getIndexPosition(dtid)];
+        if (entry.dtid == dtid)
+        {
+            entry.first = findFirstLinear(dtid);
+        }
+    }
+}
+
 bool Dispatcher::ListenerRegistry::add(TransferListenerBase* listener, Mode mode)
 {
+    const DataTypeID dtid = listener->getDataTypeDescriptor().getID();
     if (mode == UniqueListener)
     {
-        TransferListenerBase* p = list_.get();
-        while (p)
+        if (findFirst(dtid) != NULL)
         {
-            if (p->getDataTypeDescriptor().getID() == listener->getDataTypeDescriptor().getID())
-            {
-                return false;
-            }
-            p = p->getNextListNode();
+            return false;
         }
     }
     // Objective is to arrange entries by Data Type ID in ascending order from root.
-    list_.insertBefore(listener, DataTypeIDInsertionComparator(listener->getDataTypeDescriptor().getID()));
+    list_.insertBefore(listener, DataTypeIDInsertionComparator(dtid));
+    updateIndex(dtid);
     return true;
 }
 
 void Dispatcher::ListenerRegistry::remove(TransferListenerBase* listener)
 {
+    /*
+     * The list can't tell its own nodes from the nodes of another list, so the ownership is checked here:
+     * a subscriber unregisters its listener from all registries on stop. Listeners of the same data type are
+     * adjacent, hence this is cheap.
+     */
+    const DataTypeID dtid = listener->getDataTypeDescriptor().getID();
+    TransferListenerBase* p = findFirst(dtid);
+    while ((p != NULL) && (p != listener) && (p->getDataTypeDescriptor().getID() == dtid))
+    {
+        p = p->getNextListNode();
+    }
+    if (p != listener)
+    {
+        return;
+    }
+
+    if (listener == cleanup_cursor_)
+    {
+        cleanup_cursor_ = listener->getNextListNode();
+    }
     list_.remove(listener);
+    updateIndex(dtid);
 }
 
 bool Dispatcher::ListenerRegistry::exists(DataTypeID dtid) const
 {
-    TransferListenerBase* p = list_.get();
-    while (p)
+    if (DispatcherListenerIndexSize > 0)
     {
-        if (p->getDataTypeDescriptor().getID() == dtid)
+        const IndexEntry& entry = index_[getIndexPosition(dtid)];
+        if (entry.dtid == dtid)
         {
-            return true;
+            return entry.first != NULL;
         }
-        p = p->getNextListNode();
     }
-    return false;
+    return findFirstLinear(dtid) != NULL;
 }
 
 void Dispatcher::ListenerRegistry::cleanup(MonotonicTime ts)
@@ -121,62 +218,138 @@ void Dispatcher::ListenerRegistry::cleanup(MonotonicTime ts)
     }
 }
 
-void Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame)
+bool Dispatcher::ListenerRegistry::cleanupIncrementally(MonotonicTime ts, unsigned& budget)
 {
-    TransferListenerBase* p = list_.get();
-    while (p)
+    if (!cleanup_in_progress_)
     {
-        TransferListenerBase* const next = p->getNextListNode();
-        if (p->getDataTypeDescriptor().getID() == frame.getDataTypeID())
-        {
-            p->handleFrame(frame); // p may be modified
-        }
-        else if (p->getDataTypeDescriptor().getID() < frame.getDataTypeID())  // Listeners are ordered by data type id!
-        {
-            break;
-        }
-        else
+        cleanup_cursor_ = list_.get();
+        cleanup_in_progress_ = true;
+    }
+    while (cleanup_cursor_ != NULL)
+    {
+        if (budget == 0)
         {
-            ;  // Nothing to do with this one
+            return false;
         }
+        TransferListenerBase* const p = cleanup_cursor_;
+        cleanup_cursor_ = p->getNextListNode();
+        p->cleanup(ts);
+        budget--;
+    }
+    cleanup_in_progress_ = false;
+    return true;
+}
+
+bool Dispatcher::ListenerRegistry::handleFrame(const RxFrame& frame)
+{
+    // Listeners of the same data type are adjacent in the list
+    TransferListenerBase* p = findFirst(frame.getDataTypeID());
+    const bool found = (p != NULL) && (p->getDataTypeDescriptor().getID() == frame.getDataTypeID());
+#if !UAVCAN_TINY
+    if ((DataTypeStatsTableSize > 0) && found && (p->getDataTypeStats() != NULL))
+    {
+        p->getDataTypeStats()->addRxFrame(frame.getPayloadLen());   // Shared by all listeners of this data type
+    }
+#endif
+    while (p && (p->getDataTypeDescriptor().getID() == frame.getDataTypeID()))
+    {
+        TransferListenerBase* const next = p->getNextListNode();
+        p->handleFrame(frame); // p may be modified
         p = next;
     }
+    return found;
 }
 
 /*
  * Dispatcher
  */
+void Dispatcher::updateMessageDataTypeMask()
+{
+    uint64_t mask = 0;
+    for (const TransferListenerBase* p = lmsg_.getList().get(); p != NULL; p = p->getNextListNode())
+    {
+        mask |= getMessageDataTypeMaskBit(p->getDataTypeDescriptor().getID());
+    }
+    message_dtid_mask_ = mask;
+}
+
+bool Dispatcher::isRejectedByCanID(const CanRxFrame& can_frame) const
+{
+    if (can_frame.isErrorFrame() || can_frame.isRemoteTransmissionRequest() || !can_frame.isExtended())
+    {
+        return false;           // Will be rejected by the parser
+    }
+#if !UAVCAN_TINY
+    if (promiscuous_listener_ != NULL)
+    {
+        return false;
+    }
+#endif
+
+    const uint32_t id = can_frame.id & CanFrame::MaskExtID;
+    const bool service_not_message = ((id >> 7) & 1U) != 0U;
+    if (service_not_message)
+    {
+        // In passive mode the local node ID is zero, which is never a valid destination
+        return ((id >> 8) & NodeID::Max) != getNodeID().get();
+    }
+
+    if ((id & NodeID::Max) == 0U)
+    {
+        return false;           // Anonymous message, most of the data type ID bits are replaced with the discriminator
+    }
+    return (message_dtid_mask_ & getMessageDataTypeMaskBit(DataTypeID(uint16_t(id >> 8)))) == 0U;
+}
+
 void Dispatcher::handleFrame(const CanRxFrame& can_frame)
 {
+    UAVCAN_EVENT_TRACE_SCOPE(EventTraceDispatcherHandleFrameBegin, can_frame.iface_index);
+
+    if (isRejectedByCanID(can_frame))
+    {
+        registerRejectedRxFrame(can_frame, true);
+        return;
+    }
+
     RxFrame frame;
     if (!frame.parse(can_frame))
     {
         // This is not counted as a transport error
         UAVCAN_TRACE("Dispatcher", "Invalid CAN frame received: %s", can_frame.toString().c_str());
+        registerRejectedRxFrame(can_frame);
         return;
     }
 
+#if !UAVCAN_TINY
+    if (promiscuous_listener_ != NULL)
+    {
+        promiscuous_listener_->handleFrame(frame);
+    }
+#endif
+
     if ((frame.getDstNodeID() != NodeID::Broadcast) &&
         (frame.getDstNodeID() != getNodeID()))
     {
+        registerRejectedRxFrame(can_frame);
         return;
     }
 
+    bool found = false;
     switch (frame.getTransferType())
     {
     case TransferTypeMessageBroadcast:
     {
-        lmsg_.handleFrame(frame);
+        found = lmsg_.handleFrame(frame);
         break;
     }
     case TransferTypeServiceRequest:
     {
-        lsrv_req_.handleFrame(frame);
+        found = lsrv_req_.handleFrame(frame);
         break;
     }
     case TransferTypeServiceResponse:
     {
-        lsrv_resp_.handleFrame(frame);
+        found = lsrv_resp_.handleFrame(frame);
         break;
     }
     default:
@@ -185,6 +358,11 @@ void Dispatcher::handleFrame(const CanRxFrame& can_frame)
         break;
     }
     }
+
+    if (!found)
+    {
+        registerRejectedRxFrame(can_frame);
+    }
 }
 
 #if UAVCAN_TINY
@@ -195,9 +373,26 @@ void Dispatcher::handleLoopbackFrame(const CanRxFrame&)
 void Dispatcher::notifyRxFrameListener(const CanRxFrame&, CanIOFlags)
 {
 }
+
+void Dispatcher::notifyListenerRegistryObserver()
+{
+}
+
+void Dispatcher::registerRejectedRxFrame(const CanRxFrame&, bool)
+{
+}
+
+void Dispatcher::attachDataTypeStats(TransferListenerBase*)
+{
+}
 #else
 void Dispatcher::handleLoopbackFrame(const CanRxFrame& can_frame)
 {
+    if (!loopback_listeners_.mayBeInterestedIn(can_frame))
+    {
+        return;
+    }
+
     RxFrame frame;
     if (!frame.parse(can_frame))
     {
@@ -216,64 +411,116 @@ void Dispatcher::notifyRxFrameListener(const CanRxFrame& can_frame, CanIOFlags f
         rx_listener_->handleRxFrame(can_frame, flags);
     }
 }
+
+void Dispatcher::notifyListenerRegistryObserver()
+{
+    if (listener_registry_observer_ != NULL)
+    {
+        listener_registry_observer_->handleListenerRegistryChange();
+    }
+}
+
+void Dispatcher::attachDataTypeStats(TransferListenerBase* listener)
+{
+    const DataTypeDescriptor& dtd = listener->getDataTypeDescriptor();
+    listener->setDataTypeStats(data_type_stats_.access(dtd.getKind(), dtd.getID()), &sysclock_);
+}
+
+void Dispatcher::registerRejectedRxFrame(const CanRxFrame& can_frame, bool prefiltered)
+{
+    num_rejected_rx_frames_++;
+    if (prefiltered)
+    {
+        num_prefiltered_rx_frames_++;
+    }
+    if (listener_registry_observer_ != NULL)
+    {
+        listener_registry_observer_->handleRejectedRxFrame(can_frame);
+    }
+}
 #endif
 
+int Dispatcher::handleFrameBatch(const CanRxFrame* can_frames, const CanIOFlags* flags, int num_frames)
+{
+    ExecutionTimeCounter* const time_counter = (num_frames > 0) ? frame_handling_time_counter_ : NULL;
+    const MonotonicTime started_at = (time_counter != NULL) ? DriverBinding::getMonotonic(sysclock_) : MonotonicTime();
+
+    int num_frames_processed = 0;
+    for (int i = 0; i < num_frames; i++)
+    {
+        if (flags[i] & CanIOFlagLoopback)
+        {
+            handleLoopbackFrame(can_frames[i]);
+        }
+        else
+        {
+            num_frames_processed++;
+            handleFrame(can_frames[i]);
+        }
+        notifyRxFrameListener(can_frames[i], flags[i]);
+    }
+
+    if (time_counter != NULL)
+    {
+        time_counter->add(DriverBinding::getMonotonic(sysclock_) - started_at);
+    }
+    return num_frames_processed;
+}
+
 int Dispatcher::spin(MonotonicTime deadline)
 {
+    IterationScope scope(*this);
     int num_frames_processed = 0;
     do
     {
-        CanIOFlags flags = 0;
-        CanRxFrame frame;
-        const int res = canio_.receive(frame, deadline, flags);
+        const int res = spinBatch(deadline);
         if (res < 0)
         {
             return res;
         }
-        if (res > 0)
-        {
-            if (flags & CanIOFlagLoopback)
-            {
-                handleLoopbackFrame(frame);
-            }
-            else
-            {
-                num_frames_processed++;
-                handleFrame(frame);
-            }
-            notifyRxFrameListener(frame, flags);
-        }
+        num_frames_processed += res;
     }
-    while (sysclock_.getMonotonic() < deadline);
+    while (getMonotonicTime() < deadline);      // The timestamp of the last select() is good enough here
 
     return num_frames_processed;
 }
 
-int Dispatcher::spinOnce()
+int Dispatcher::spinBatch(MonotonicTime deadline)
 {
+    IterationScope scope(*this);
+    CanIOFlags flags[DispatcherRxBatchSize] = {};
+    CanRxFrame frames[DispatcherRxBatchSize];
+    const int res = canio_.receiveBatch(frames, flags, DispatcherRxBatchSize, deadline);
+    updateIterationTimestamp();
+    if (res < 0)
+    {
+        return res;
+    }
+    return handleFrameBatch(frames, flags, res);
+}
+
+int Dispatcher::spinOnce(unsigned max_frames)
+{
+    IterationScope scope(*this);
     int num_frames_processed = 0;
+    unsigned num_frames_received = 0;
 
-    while (true)
+    while ((max_frames == 0) || (num_frames_received < max_frames))
     {
-        CanIOFlags flags = 0;
-        CanRxFrame frame;
-        const int res = canio_.receive(frame, MonotonicTime(), flags);
+        const unsigned batch_size = (max_frames == 0) ? DispatcherRxBatchSize :
+                                    min(DispatcherRxBatchSize, max_frames - num_frames_received);
+        CanIOFlags flags[DispatcherRxBatchSize] = {};
+        CanRxFrame frames[DispatcherRxBatchSize];
+        const int res = canio_.receiveBatch(frames, flags, batch_size, MonotonicTime());
+        updateIterationTimestamp();
         if (res < 0)
         {
             return res;
         }
         else if (res > 0)
         {
-            if (flags & CanIOFlagLoopback)
-            {
-                handleLoopbackFrame(frame);
-            }
-            else
-            {
-                num_frames_processed++;
-                handleFrame(frame);
-            }
-            notifyRxFrameListener(frame, flags);
+            num_frames_received += unsigned(res);
+            num_frames_processed += handleFrameBatch(frames, flags, res);
         }
         else
         {
@@ -284,6 +531,33 @@ int Dispatcher::spinOnce()
     return num_frames_processed;
 }
 
+int Dispatcher::spinBudget(unsigned max_frames, MonotonicTime deadline)
+{
+    if (max_frames == 0)
+    {
+        return -ErrInvalidParam;
+    }
+
+    IterationScope scope(*this);
+    CanIOFlags flags[DispatcherRxBatchSize] = {};
+    CanRxFrame frames[DispatcherRxBatchSize];
+    const int res = canio_.receiveBatch(frames, flags, min(DispatcherRxBatchSize, max_frames), deadline);
+    updateIterationTimestamp();
+    if (res <= 0)
+    {
+        return res;
+    }
+    const int num_frames_processed = handleFrameBatch(frames, flags, res);
+
+    const unsigned num_frames_left = max_frames - unsigned(res);
+    if (num_frames_left == 0)
+    {
+        return num_frames_processed;
+    }
+    const int res_rest = spinOnce(num_frames_left);
+    return (res_rest < 0) ? res_rest : (num_frames_processed + res_rest);
+}
+
 int Dispatcher::send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
                      CanTxQueue::Qos qos, CanIOFlags flags, uint8_t iface_mask)
 {
@@ -300,7 +574,12 @@ int Dispatcher::send(const Frame& frame, MonotonicTime tx_deadline, MonotonicTim
         UAVCAN_ASSERT(0);
         return -ErrLogic;
     }
-    return canio_.send(can_frame, tx_deadline, blocking_deadline, iface_mask, qos, flags);
+    if (emergency_priority_threshold_.isValid() &&
+        (frame.getPriority().get() <= emergency_priority_threshold_.get()))
+    {
+        flags = CanIOFlags(flags | CanIOFlagEmergency);
+    }
+    return send(can_frame, tx_deadline, blocking_deadline, qos, flags, iface_mask);
 }
 
 void Dispatcher::cleanup(MonotonicTime ts)
@@ -311,6 +590,40 @@ void Dispatcher::cleanup(MonotonicTime ts)
     lsrv_resp_.cleanup(ts);
 }
 
+bool Dispatcher::cleanupIncrementally(MonotonicTime ts, unsigned max_listeners)
+{
+    ListenerRegistry* const registries[] = { &lmsg_, &lsrv_req_, &lsrv_resp_ };
+    const unsigned num_stages = 1U + unsigned(sizeof(registries) / sizeof(registries[0]));
+
+    unsigned budget = (max_listeners > 0) ? max_listeners : NumericTraits<unsigned>::max();
+    while (true)
+    {
+        if (cleanup_stage_ == 0)
+        {
+            if (budget == 0)
+            {
+                return false;
+            }
+            outgoing_transfer_reg_.cleanup(ts);
+            budget--;
+        }
+        else
+        {
+            if (!registries[cleanup_stage_ - 1U]->cleanupIncrementally(ts, budget))
+            {
+                return false;
+            }
+        }
+
+        cleanup_stage_++;
+        if (cleanup_stage_ >= num_stages)
+        {
+            cleanup_stage_ = 0;
+            return true;
+        }
+    }
+}
+
 bool Dispatcher::registerMessageListener(TransferListenerBase* listener)
 {
     if (listener->getDataTypeDescriptor().getKind() != DataTypeKindMessage)
@@ -318,7 +631,14 @@ bool Dispatcher::registerMessageListener(TransferListenerBase* listener)
         UAVCAN_ASSERT(0);
         return false;
     }
-    return lmsg_.add(listener, ListenerRegistry::ManyListeners);       // Multiple subscribers are OK
+    attachDataTypeStats(listener);
+    const bool res = lmsg_.add(listener, ListenerRegistry::ManyListeners);       // Multiple subscribers are OK
+    if (res)
+    {
+        message_dtid_mask_ |= getMessageDataTypeMaskBit(listener->getDataTypeDescriptor().getID());
+        notifyListenerRegistryObserver();
+    }
+    return res;
 }
 
 bool Dispatcher::registerServiceRequestListener(TransferListenerBase* listener)
@@ -328,7 +648,13 @@ bool Dispatcher::registerServiceRequestListener(TransferListenerBase* listener)
         UAVCAN_ASSERT(0);
         return false;
     }
-    return lsrv_req_.add(listener, ListenerRegistry::UniqueListener);  // Only one server per data type
+    attachDataTypeStats(listener);
+    const bool res = lsrv_req_.add(listener, ListenerRegistry::UniqueListener);  // Only one server per data type
+    if (res)
+    {
+        notifyListenerRegistryObserver();
+    }
+    return res;
 }
 
 bool Dispatcher::registerServiceResponseListener(TransferListenerBase* listener)
@@ -338,17 +664,21 @@ bool Dispatcher::registerServiceResponseListener(TransferListenerBase* listener)
         UAVCAN_ASSERT(0);
         return false;
     }
+    attachDataTypeStats(listener);
     return lsrv_resp_.add(listener, ListenerRegistry::ManyListeners);  // Multiple callers may call same srv
 }
 
 void Dispatcher::unregisterMessageListener(TransferListenerBase* listener)
 {
     lmsg_.remove(listener);
+    updateMessageDataTypeMask();
+    notifyListenerRegistryObserver();
 }
 
 void Dispatcher::unregisterServiceRequestListener(TransferListenerBase* listener)
 {
     lsrv_req_.remove(listener);
+    notifyListenerRegistryObserver();
 }
 
 void Dispatcher::unregisterServiceResponseListener(TransferListenerBase* listener)
@@ -377,6 +707,7 @@ bool Dispatcher::setNodeID(NodeID nid)
     {
         self_node_id_ = nid;
         self_node_id_is_set_ = true;
+        notifyListenerRegistryObserver();
         return true;
     }
     return false;
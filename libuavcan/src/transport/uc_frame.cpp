@@ -33,60 +33,63 @@ inline static uint32_t bitunpack(uint32_t val)
 
 bool Frame::parse(const CanFrame& can_frame)
 {
-    if (can_frame.isErrorFrame() || can_frame.isRemoteTransmissionRequest() || !can_frame.isExtended())
+    // Extended data frames only
+    if ((can_frame.id & (CanFrame::FlagEFF | CanFrame::FlagRTR | CanFrame::FlagERR)) != CanFrame::FlagEFF)
     {
         UAVCAN_TRACE("Frame", "Parsing failed at line %d", __LINE__);
         return false;
     }
 
-    if (can_frame.dlc > sizeof(can_frame.data))
-    {
-        UAVCAN_ASSERT(0);  // This is not a protocol error, so UAVCAN_ASSERT() is ok
-        return false;
-    }
-
-    if (can_frame.dlc < 1)
+    // Single comparison for both bounds: DLC of zero wraps around
+    if (unsigned(can_frame.dlc - 1U) >= (can_frame.isCanFD() ? sizeof(can_frame.data) : CanFrame::MaxClassicDataLen))
     {
+        UAVCAN_ASSERT(can_frame.dlc < 1);  // Oversized DLC is not a protocol error, so UAVCAN_ASSERT() is ok
         UAVCAN_TRACE("Frame", "Parsing failed at line %d", __LINE__);
         return false;
     }
 
     /*
      * CAN ID parsing
+     * The fields are extracted without branching on the frame kind; the shift and the width of the data type ID
+     * field, as well as the transfer type, are selected by the service flag instead.
      */
+    static const uint8_t TransferTypeByFlags[4] =   // Index: service_not_message, request_not_response
+    {
+        TransferTypeMessageBroadcast,
+        TransferTypeMessageBroadcast,
+        TransferTypeServiceResponse,
+        TransferTypeServiceRequest
+    };
+
     const uint32_t id = can_frame.id & CanFrame::MaskExtID;
 
-    transfer_priority_ = static_cast<uint8_t>(bitunpack<24, 5>(id));
-    src_node_id_ = static_cast<uint8_t>(bitunpack<0, 7>(id));
+    const uint32_t service_not_message = bitunpack<7, 1>(id);
+    const uint32_t src_node_id = bitunpack<0, 7>(id);
+    const uint32_t anonymous_message = (src_node_id == 0U) ? (1U - service_not_message) : 0U;
 
-    const bool service_not_message = bitunpack<7, 1>(id) != 0U;
-    if (service_not_message)
-    {
-        const bool request_not_response = bitunpack<15, 1>(id) != 0U;
-        transfer_type_ = request_not_response ? TransferTypeServiceRequest : TransferTypeServiceResponse;
+    transfer_priority_ = static_cast<uint8_t>(bitunpack<24, 5>(id));
+    src_node_id_ = static_cast<uint8_t>(src_node_id);
+    transfer_type_ = static_cast<TransferType>(TransferTypeByFlags[(service_not_message << 1) | bitunpack<15, 1>(id)]);
 
-        dst_node_id_ = static_cast<uint8_t>(bitunpack<8, 7>(id));
-        data_type_id_ = static_cast<uint16_t>(bitunpack<16, 8>(id));
-    }
-    else
-    {
-        transfer_type_ = TransferTypeMessageBroadcast;
-        dst_node_id_ = NodeID::Broadcast;
+    // Destination is zero (broadcast) for messages
+    dst_node_id_ = static_cast<uint8_t>(bitunpack<8, 7>(id) & (0U - service_not_message));
 
-        data_type_id_ = static_cast<uint16_t>(bitunpack<8, 16>(id));
-
-        if (src_node_id_.isBroadcast())
-        {
-            // Removing the discriminator
-            data_type_id_ = static_cast<uint16_t>(data_type_id_.get() & 3U);
-        }
-    }
+    // Services: 8 bits at offset 16; messages: 16 bits at offset 8, or 2 bits if anonymous (discriminator removed)
+    const uint32_t dtid_mask = (0xFFFFU >> (service_not_message * 8U)) & ~(0xFFFCU * anonymous_message);
+    data_type_id_ = static_cast<uint16_t>((id >> (8U + service_not_message * 8U)) & dtid_mask);
 
     /*
      * CAN payload parsing
      */
     payload_len_ = static_cast<uint8_t>(can_frame.dlc - 1U);
-    (void)copy(can_frame.data, can_frame.data + payload_len_, payload_);
+    // Constant length copy is cheaper than a loop; the bytes past the payload are never used
+#if UAVCAN_SUPPORT_CANFD
+    canfd_ = can_frame.isCanFD();
+    (void)copy(can_frame.data, can_frame.data + (canfd_ ? unsigned(payload_len_) : unsigned(ClassicPayloadCapacity)),
+               payload_);
+#else
+    (void)copy(can_frame.data, can_frame.data + PayloadCapacity, payload_);
+#endif
 
     const uint8_t tail = can_frame.data[can_frame.dlc - 1U];
 
@@ -96,7 +99,26 @@ bool Frame::parse(const CanFrame& can_frame)
 
     transfer_id_ = tail & TransferID::Max;
 
-    return isValid();
+    /*
+     * Validation.
+     * Most of the checks performed by isValid() hold by construction here, because every field was extracted
+     * from a bit field of the right width; only the checks below can fail.
+     */
+    const uint32_t dst_node_id = dst_node_id_.get();
+    const uint32_t sot = tail >> 7;
+    const uint32_t eot = (tail >> 6) & 1U;
+    const uint32_t tog = (tail >> 5) & 1U;
+    const bool valid =
+        ((sot & tog) == 0U) &
+        ((service_not_message == 0U) | ((dst_node_id != 0U) & (dst_node_id != src_node_id))) &
+        ((src_node_id != 0U) | ((sot & eot & (1U - service_not_message)) != 0U));
+
+    if (!valid)
+    {
+        UAVCAN_TRACE("Frame", "Parsing failed at line %d", __LINE__);
+    }
+    UAVCAN_ASSERT(valid == isValid());
+    return valid;
 }
 
 template <int OFFSET, int WIDTH>
@@ -109,37 +131,55 @@ inline static uint32_t bitpack(uint32_t field)
     return uint32_t((field & ((1UL << WIDTH) - 1)) << OFFSET);
 }
 
-bool Frame::compile(CanFrame& out_can_frame) const
+uint32_t Frame::compileCanID() const
 {
-    if (!isValid())
-    {
-        UAVCAN_ASSERT(0);        // This is an application error, so we need to maximize it.
-        return false;
-    }
-
-    /*
-     * CAN ID field
-     */
-    out_can_frame.id = CanFrame::FlagEFF |
+    uint32_t id = CanFrame::FlagEFF |
         bitpack<0, 7>(src_node_id_.get()) |
         bitpack<24, 5>(transfer_priority_.get());
 
     if (transfer_type_ == TransferTypeMessageBroadcast)
     {
-        out_can_frame.id |=
+        id |=
             bitpack<7, 1>(0U) |
             bitpack<8, 16>(data_type_id_.get());
     }
     else
     {
         const bool request_not_response = transfer_type_ == TransferTypeServiceRequest;
-        out_can_frame.id |=
+        id |=
             bitpack<7, 1>(1U) |
             bitpack<8, 7>(dst_node_id_.get()) |
             bitpack<15, 1>(request_not_response ? 1U : 0U) |
             bitpack<16, 8>(data_type_id_.get());
     }
 
+    return id;
+}
+
+bool Frame::compile(CanFrame& out_can_frame) const
+{
+    if (!isValid())
+    {
+        UAVCAN_ASSERT(0);        // This is an application error, so we need to maximize it.
+        return false;
+    }
+
+    return compile(out_can_frame, compileCanID());
+}
+
+bool Frame::compile(CanFrame& out_can_frame, uint32_t can_id) const
+{
+    UAVCAN_ASSERT(isValid());
+    UAVCAN_ASSERT(can_id == compileCanID());
+
+    if (payload_len_ > getPayloadCapacity())
+    {
+        UAVCAN_ASSERT(0);
+        return false;
+    }
+
+    out_can_frame.id = can_id;
+
     /*
      * Payload
      */
@@ -162,6 +202,20 @@ bool Frame::compile(CanFrame& out_can_frame) const
     out_can_frame.dlc = static_cast<uint8_t>(payload_len_);
     (void)copy(payload_, payload_ + payload_len_, out_can_frame.data);
 
+#if UAVCAN_SUPPORT_CANFD
+    /*
+     * CAN FD frames can't have arbitrary length, so the payload is padded with zeros up to the nearest valid length.
+     * The tail byte is always the last one.
+     */
+    out_can_frame.canfd = canfd_;
+    if (canfd_)
+    {
+        const uint8_t padded_len = uint8_t(CanFrame::roundUpDataLength(uint8_t(payload_len_ + 1U)) - 1U);
+        fill(out_can_frame.data + out_can_frame.dlc, out_can_frame.data + padded_len, uint8_t(0));
+        out_can_frame.dlc = padded_len;
+    }
+#endif
+
     out_can_frame.data[out_can_frame.dlc] = tail;
     out_can_frame.dlc++;
 
@@ -269,6 +323,7 @@ bool Frame::operator==(const Frame& rhs) const
         (toggle_            == rhs.toggle_) &&
         (start_of_transfer_ == rhs.start_of_transfer_) &&
         (end_of_transfer_   == rhs.end_of_transfer_) &&
+        (isCanFD()          == rhs.isCanFD()) &&
         (payload_len_       == rhs.payload_len_) &&
         equal(payload_, payload_ + payload_len_, rhs.payload_);
 }
@@ -276,7 +331,7 @@ bool Frame::operator==(const Frame& rhs) const
 #if UAVCAN_TOSTRING
 std::string Frame::toString() const
 {
-    static const int BUFLEN = 100;
+    static const int BUFLEN = 80 + PayloadCapacity * 3;
     char buf[BUFLEN];
     int ofs = snprintf(buf, BUFLEN, "prio=%d dtid=%d tt=%d snid=%d dnid=%d sot=%d eot=%d togl=%d tid=%d payload=[",
                        int(transfer_priority_.get()), int(data_type_id_.get()), int(transfer_type_),
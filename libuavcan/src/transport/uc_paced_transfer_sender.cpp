@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/paced_transfer_sender.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+
+PacedTransferSender::PacedTransferSender(TransferSender& sender, uint8_t window_size)
+    : LoopbackFrameListenerBase(sender.dispatcher_)
+    , sender_(sender)
+    , payload_(NULL)
+    , can_id_(0)
+    , payload_len_(0)
+    , offset_(0)
+    , num_frames_sent_(0)
+    , iface_mask_(0)
+    , window_size_(max(window_size, uint8_t(1)))
+    , all_frames_sent_(false)
+    , status_(StatusIdle)
+{
+    fill(num_frames_transmitted_, num_frames_transmitted_ + unsigned(MaxCanIfaces), uint16_t(0));
+}
+
+uint16_t PacedTransferSender::getMinNumFramesTransmitted() const
+{
+    uint16_t res = num_frames_sent_;
+    for (uint8_t i = 0; i < MaxCanIfaces; i++)
+    {
+        if ((iface_mask_ & (1U << i)) != 0)
+        {
+            res = min(res, num_frames_transmitted_[i]);
+        }
+    }
+    return res;
+}
+
+int PacedTransferSender::sendFrames()
+{
+    // Frames of a multi frame transfer can't be coalesced
+    const CanIOFlags flags = CanIOFlags((sender_.flags_ & ~CanIOFlagCoalesce) | CanIOFlagLoopback);
+
+    while (!all_frames_sent_ && ((num_frames_sent_ - getMinNumFramesTransmitted()) < window_size_))
+    {
+        const int send_res = sender_.sendFrame(frame_, can_id_, tx_deadline_, MonotonicTime(), flags);
+        if (send_res < 0)
+        {
+            return send_res;
+        }
+
+        num_frames_sent_++;
+        if (frame_.isEndOfTransfer())
+        {
+            all_frames_sent_ = true;
+            break;
+        }
+
+        frame_.setStartOfTransfer(false);
+        frame_.flipToggle();
+
+        const int write_res = frame_.setPayload(payload_ + offset_, payload_len_ - offset_);
+        if (write_res <= 0)
+        {
+            UAVCAN_TRACE("PacedTransferSender", "Frame payload write failure, %i", write_res);
+            return (write_res < 0) ? write_res : -ErrLogic;
+        }
+
+        offset_ += unsigned(write_res);
+        UAVCAN_ASSERT(offset_ <= payload_len_);
+        if (offset_ >= payload_len_)
+        {
+            frame_.setEndOfTransfer(true);
+        }
+    }
+    return 0;
+}
+
+void PacedTransferSender::finish(Status status)
+{
+    UAVCAN_ASSERT((status == StatusDone) || (status == StatusFailed));
+    if (status == StatusFailed)
+    {
+        sender_.registerError();
+    }
+    status_ = status;
+    payload_ = NULL;
+    stopListening();
+}
+
+void PacedTransferSender::handleLoopbackFrame(const RxFrame& frame)
+{
+    if (status_ != StatusInProgress)
+    {
+        stopListening();
+        return;
+    }
+
+    const uint8_t iface_index = frame.getIfaceIndex();
+    if ((iface_index >= MaxCanIfaces) || ((iface_mask_ & (1U << iface_index)) == 0) ||
+        (frame.getTransferType() != frame_.getTransferType()) ||
+        (frame.getSrcNodeID() != frame_.getSrcNodeID()) ||
+        (frame.getDstNodeID() != frame_.getDstNodeID()) ||
+        (frame.getTransferID() != frame_.getTransferID()))
+    {
+        return;
+    }
+
+    // The frames of the transfer are transmitted in order, so the toggle bit must match the frame index
+    uint16_t& num_transmitted = num_frames_transmitted_[iface_index];
+    if ((num_transmitted >= num_frames_sent_) || (frame.getToggle() != ((num_transmitted & 1U) != 0)))
+    {
+        return;
+    }
+    num_transmitted++;
+
+    if (all_frames_sent_)
+    {
+        if (getMinNumFramesTransmitted() == num_frames_sent_)
+        {
+            finish(StatusDone);
+        }
+        return;
+    }
+
+    if (getDispatcher().getMonotonicTime() >= tx_deadline_)
+    {
+        UAVCAN_TRACE("PacedTransferSender", "Timed out, %u frames sent", unsigned(num_frames_sent_));
+        finish(StatusFailed);
+        return;
+    }
+
+    const int res = sendFrames();
+    if (res < 0)
+    {
+        UAVCAN_TRACE("PacedTransferSender", "Failed to send the next frame, %i", res);
+        finish(StatusFailed);
+    }
+}
+
+int PacedTransferSender::start(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+                               TransferType transfer_type, NodeID dst_node_id, TransferID tid)
+{
+    if (status_ == StatusInProgress)
+    {
+        if (getStatus() == StatusInProgress)
+        {
+            return -ErrLogic;
+        }
+        finish(StatusFailed);               // Timed out
+    }
+    if ((payload == NULL) && (payload_len > 0))
+    {
+        return -ErrInvalidParam;
+    }
+
+    frame_ = sender_.makeFrame(transfer_type, dst_node_id, tid);
+    if (int(payload_len) <= frame_.getPayloadCapacity())
+    {
+        // Nothing to pace
+        const int res = sender_.send(payload, payload_len, tx_deadline, MonotonicTime(), transfer_type,
+                                     dst_node_id, tid);
+        status_ = (res < 0) ? StatusFailed : StatusDone;
+        return res;
+    }
+
+    if (sender_.dispatcher_.isPassiveMode())
+    {
+        return -ErrPassiveMode;
+    }
+
+    frame_.setPriority(sender_.priority_);
+    frame_.setStartOfTransfer(true);
+    if (!sender_.getCanID(frame_, can_id_))
+    {
+        return -ErrLogic;
+    }
+
+    // The whole transfer is accounted at once, even though its frames are queued later
+    const int rate_res = sender_.checkRateLimit(sender_.getNumFrames(payload_len,
+                                                                     unsigned(frame_.getPayloadCapacity())));
+    if (rate_res < 0)
+    {
+        return rate_res;
+    }
+
+    /*
+     * The first frame starts with the transfer CRC, and it is always full
+     */
+    {
+        const uint16_t crc = sender_.computeTransferCRC(payload, payload_len);
+
+        static const unsigned BufLen = sizeof(static_cast<CanFrame*>(0)->data);
+        uint8_t buf[BufLen];
+
+        const unsigned frame_len = unsigned(frame_.getPayloadCapacity());
+        UAVCAN_ASSERT((frame_len <= BufLen) && (payload_len > frame_len));
+
+        buf[0] = uint8_t(crc & 0xFFU);             // Transfer CRC, little endian
+        buf[1] = uint8_t((crc >> 8) & 0xFFU);
+        (void)copy(payload, payload + frame_len - 2, buf + 2);
+
+        const int write_res = frame_.setPayload(buf, frame_len);
+        if (write_res != int(frame_len))
+        {
+            UAVCAN_TRACE("PacedTransferSender", "Frame payload write failure, %i", write_res);
+            return (write_res < 0) ? write_res : -ErrLogic;
+        }
+        offset_ = frame_len - 2U;
+    }
+
+    UAVCAN_TRACE("PacedTransferSender", "%s, len %u", frame_.toString().c_str(), payload_len);
+
+    payload_ = payload;
+    payload_len_ = payload_len;
+    tx_deadline_ = tx_deadline;
+    num_frames_sent_ = 0;
+    fill(num_frames_transmitted_, num_frames_transmitted_ + unsigned(MaxCanIfaces), uint16_t(0));
+    iface_mask_ = uint8_t(sender_.iface_mask_ & ((1U << sender_.dispatcher_.getCanIOManager().getNumIfaces()) - 1U));
+    all_frames_sent_ = false;
+    status_ = StatusInProgress;
+
+    sender_.dispatcher_.getTransferPerfCounter().addTxTransfer();
+    if (sender_.getActiveDataTypeStats() != NULL)
+    {
+        sender_.getActiveDataTypeStats()->transfers_tx++;
+    }
+
+    // The loopback is requested from the driver only if there is a listener
+    startListening(frame_.getDataTypeID());
+
+    const int res = sendFrames();
+    if (res < 0)
+    {
+        finish(StatusFailed);
+        return res;
+    }
+    return 0;
+}
+
+int PacedTransferSender::start(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+                               TransferType transfer_type, NodeID dst_node_id)
+{
+    if (getStatus() == StatusInProgress)
+    {
+        return -ErrLogic;
+    }
+
+    TransferID* const tid = sender_.accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
+        return -ErrMemory;
+    }
+
+    const TransferID this_tid = tid->get();
+    tid->increment();
+
+    return start(payload, payload_len, tx_deadline, transfer_type, dst_node_id, this_tid);
+}
+
+void PacedTransferSender::cancel()
+{
+    if (status_ == StatusInProgress)
+    {
+        finish(StatusFailed);
+    }
+}
+
+PacedTransferSender::Status PacedTransferSender::getStatus() const
+{
+    if ((status_ == StatusInProgress) && (sender_.dispatcher_.getMonotonicTime() >= tx_deadline_))
+    {
+        return StatusFailed;
+    }
+    return status_;
+}
+
+#endif
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/promiscuous_transfer_listener.hpp>
+#include <uavcan/debug.hpp>
+
+namespace uavcan
+{
+#if !UAVCAN_TINY
+/*
+ * PromiscuousIncomingTransfer
+ */
+PromiscuousIncomingTransfer::PromiscuousIncomingTransfer(MonotonicTime ts_mono, UtcTime ts_utc,
+                                                         const RxFrame& last_frame, const uint8_t* payload,
+                                                         unsigned payload_len, uint16_t transfer_crc,
+                                                         bool multi_frame)
+    : IncomingTransfer(ts_mono, ts_utc, last_frame.getPriority(), last_frame.getTransferType(),
+                       last_frame.getTransferID(), last_frame.getSrcNodeID(), last_frame.getIfaceIndex())
+    , payload_(payload)
+    , payload_len_(payload_len)
+    , last_frame_ts_mono_(last_frame.getMonotonicTimestamp())
+    , data_type_id_(last_frame.getDataTypeID())
+    , dst_node_id_(last_frame.getDstNodeID())
+    , transfer_crc_(transfer_crc)
+    , multi_frame_(multi_frame)
+{
+    UAVCAN_ASSERT((payload != NULL) || (payload_len == 0));
+    UAVCAN_ASSERT(last_frame.isEndOfTransfer());
+#if UAVCAN_SUPPORT_CANFD
+    setCanFD(last_frame.isCanFD());
+#endif
+}
+
+int PromiscuousIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned len) const
+{
+    if (data == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+    if (offset >= payload_len_)
+    {
+        return 0;
+    }
+    if ((offset + len) > payload_len_)
+    {
+        len = payload_len_ - offset;
+    }
+    (void)copy(payload_ + offset, payload_ + offset + len, data);
+    return int(len);
+}
+
+unsigned PromiscuousIncomingTransfer::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    if (offset >= payload_len_)
+    {
+        return 0;
+    }
+    out_data = payload_ + offset;
+    return payload_len_ - offset;
+}
+
+bool PromiscuousIncomingTransfer::isAnonymousTransfer() const
+{
+    return (getTransferType() == TransferTypeMessageBroadcast) && getSrcNodeID().isBroadcast();
+}
+
+/*
+ * PromiscuousTransferListenerBase::Slot
+ */
+bool PromiscuousTransferListenerBase::Slot::match(const RxFrame& frame) const
+{
+    return active &&
+           (data_type_id == frame.getDataTypeID()) &&
+           (transfer_type == frame.getTransferType()) &&
+           (src_node_id == frame.getSrcNodeID()) &&
+           (dst_node_id == frame.getDstNodeID()) &&
+           (iface_index == frame.getIfaceIndex());
+}
+
+/*
+ * PromiscuousTransferListenerBase
+ */
+PromiscuousTransferListenerBase::Slot* PromiscuousTransferListenerBase::findSlot(const RxFrame& frame)
+{
+    for (unsigned i = 0; i < num_slots_; i++)
+    {
+        if (slots_[i].match(frame))
+        {
+            return &slots_[i];
+        }
+    }
+    return NULL;
+}
+
+PromiscuousTransferListenerBase::Slot* PromiscuousTransferListenerBase::allocateSlot(MonotonicTime ts)
+{
+    Slot* stale = NULL;
+    for (unsigned i = 0; i < num_slots_; i++)
+    {
+        Slot& s = slots_[i];
+        if (!s.active)
+        {
+            return &s;
+        }
+        // The stalest transfer is evicted first
+        if (((s.last_frame_ts_mono + transfer_timeout_) < ts) &&
+            ((stale == NULL) || (s.last_frame_ts_mono < stale->last_frame_ts_mono)))
+        {
+            stale = &s;
+        }
+    }
+    if (stale != NULL)
+    {
+        UAVCAN_TRACE("PromiscuousTransferListener", "Evicting stale transfer dtid=%u snid=%u",
+                     unsigned(stale->data_type_id.get()), unsigned(stale->src_node_id.get()));
+        num_errors_++;
+        stale->active = false;
+    }
+    return stale;
+}
+
+void PromiscuousTransferListenerBase::handleStartOfTransfer(const RxFrame& frame)
+{
+    Slot* slot = findSlot(frame);
+    if (slot != NULL)
+    {
+        // The previous transfer from the same source was never completed
+        num_errors_++;
+        slot->active = false;
+    }
+    else
+    {
+        slot = allocateSlot(frame.getMonotonicTimestamp());
+        if (slot == NULL)
+        {
+            UAVCAN_TRACE("PromiscuousTransferListener", "No free slots, %s", frame.toString().c_str());
+            num_dropped_transfers_++;
+            return;
+        }
+    }
+
+    if (frame.getPayloadLen() < 2)
+    {
+        num_errors_++;
+        return;
+    }
+
+    const uint8_t* const payload = frame.getPayloadPtr();
+    const unsigned len = frame.getPayloadLen() - 2U;
+    if (len > max_payload_len_)
+    {
+        num_dropped_transfers_++;
+        return;
+    }
+
+    slot->ts_mono = frame.getMonotonicTimestamp();
+    slot->ts_utc = frame.getUtcTimestamp();
+    slot->last_frame_ts_mono = frame.getMonotonicTimestamp();
+    slot->transfer_crc = uint16_t(payload[0] | (uint16_t(payload[1]) << 8));    // Little endian
+    slot->payload_len = uint16_t(len);
+    slot->data_type_id = frame.getDataTypeID();
+    slot->transfer_type = frame.getTransferType();
+    slot->src_node_id = frame.getSrcNodeID();
+    slot->dst_node_id = frame.getDstNodeID();
+    slot->transfer_id = frame.getTransferID();
+    slot->iface_index = frame.getIfaceIndex();
+    slot->next_toggle = !frame.getToggle();
+    slot->active = true;
+    (void)copy(payload + 2, payload + 2 + len, getBuffer(*slot));
+}
+
+void PromiscuousTransferListenerBase::handleContinuation(Slot& slot, const RxFrame& frame)
+{
+    if ((frame.getTransferID() != slot.transfer_id) || (frame.getToggle() != slot.next_toggle))
+    {
+        UAVCAN_TRACE("PromiscuousTransferListener", "Unexpected frame, %s", frame.toString().c_str());
+        num_errors_++;
+        slot.active = false;
+        return;
+    }
+
+    const unsigned len = frame.getPayloadLen();
+    if ((unsigned(slot.payload_len) + len) > max_payload_len_)
+    {
+        num_dropped_transfers_++;
+        slot.active = false;
+        return;
+    }
+
+    uint8_t* const buffer = getBuffer(slot);
+    (void)copy(frame.getPayloadPtr(), frame.getPayloadPtr() + len, buffer + slot.payload_len);
+    slot.payload_len = uint16_t(slot.payload_len + len);
+    slot.last_frame_ts_mono = frame.getMonotonicTimestamp();
+    slot.next_toggle = !slot.next_toggle;
+
+    if (frame.isEndOfTransfer())
+    {
+        slot.active = false;            // Released before the call, so that the handler may reset the listener
+        PromiscuousIncomingTransfer tr(slot.ts_mono, slot.ts_utc, frame, buffer, slot.payload_len,
+                                       slot.transfer_crc, true);
+        handleIncomingTransfer(tr);
+    }
+}
+
+void PromiscuousTransferListenerBase::handleFrame(const RxFrame& frame)
+{
+    if (frame.isStartOfTransfer() && frame.isEndOfTransfer())
+    {
+        PromiscuousIncomingTransfer tr(frame.getMonotonicTimestamp(), frame.getUtcTimestamp(), frame,
+                                       frame.getPayloadPtr(), frame.getPayloadLen(), 0, false);
+        handleIncomingTransfer(tr);
+        return;
+    }
+
+    if (frame.isStartOfTransfer())
+    {
+        handleStartOfTransfer(frame);
+        return;
+    }
+
+    Slot* const slot = findSlot(frame);
+    if (slot != NULL)
+    {
+        handleContinuation(*slot, frame);
+    }
+    // Otherwise the beginning of the transfer was missed or dropped
+}
+
+void PromiscuousTransferListenerBase::reset()
+{
+    for (unsigned i = 0; i < num_slots_; i++)
+    {
+        slots_[i].active = false;
+    }
+}
+
+unsigned PromiscuousTransferListenerBase::getNumTransfersInProgress() const
+{
+    unsigned res = 0;
+    for (unsigned i = 0; i < num_slots_; i++)
+    {
+        if (slots_[i].active)
+        {
+            res++;
+        }
+    }
+    return res;
+}
+
+#endif
+}
@@ -24,14 +24,33 @@ std::string TransferBufferManagerKey::toString() const
  * DynamicTransferBuffer::Block
  */
 DynamicTransferBufferManagerEntry::Block*
-DynamicTransferBufferManagerEntry::Block::instantiate(IPoolAllocator& allocator)
+DynamicTransferBufferManagerEntry::Block::instantiate(IPoolAllocator& allocator, unsigned desired_capacity)
 {
+#if UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+    if (desired_capacity > unsigned(Size))
+    {
+        // The allocator will refuse the request if it doesn't support blocks of this size
+        void* const praw = allocator.allocate(sizeof(Block) - unsigned(Size) + desired_capacity);
+        if (praw != NULL)
+        {
+            Block* const block = new (praw) Block;
+            block->capacity = uint16_t(desired_capacity);
+            return block;
+        }
+    }
+#else
+    (void)desired_capacity;
+#endif
     void* const praw = allocator.allocate(sizeof(Block));
     if (praw == NULL)
     {
         return NULL;
     }
-    return new (praw) Block;
+    Block* const block = new (praw) Block;
+#if UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+    block->capacity = uint16_t(Size);
+#endif
+    return block;
 }
 
 void DynamicTransferBufferManagerEntry::Block::destroy(Block*& obj, IPoolAllocator& allocator)
@@ -44,34 +63,6 @@ void DynamicTransferBufferManagerEntry::Block::destroy(Block*& obj, IPoolAllocat
     }
 }
 
-void DynamicTransferBufferManagerEntry::Block::read(uint8_t*& outptr, unsigned target_offset,
-                                                    unsigned& total_offset, unsigned& left_to_read)
-{
-    UAVCAN_ASSERT(outptr);
-    for (unsigned i = 0; (i < Block::Size) && (left_to_read > 0); i++, total_offset++)
-    {
-        if (total_offset >= target_offset)
-        {
-            *outptr++ = data[i];
-            left_to_read--;
-        }
-    }
-}
-
-void DynamicTransferBufferManagerEntry::Block::write(const uint8_t*& inptr, unsigned target_offset,
-                                                     unsigned& total_offset, unsigned& left_to_write)
-{
-    UAVCAN_ASSERT(inptr);
-    for (unsigned i = 0; (i < Block::Size) && (left_to_write > 0); i++, total_offset++)
-    {
-        if (total_offset >= target_offset)
-        {
-            data[i] = *inptr++;
-            left_to_write--;
-        }
-    }
-}
-
 /*
  * DynamicTransferBuffer
  */
@@ -96,9 +87,41 @@ void DynamicTransferBufferManagerEntry::destroy(DynamicTransferBufferManagerEntr
     }
 }
 
+DynamicTransferBufferManagerEntry::Block*
+DynamicTransferBufferManagerEntry::findBlock(unsigned offset, unsigned& out_block_offset) const
+{
+    // Blocks never move, so the search can be started from the cursor unless the offset lies before it
+    Block* p = blocks_.get();
+    unsigned block_offset = 0;
+    if ((cursor_ != NULL) && (cursor_offset_ <= offset))
+    {
+        p = cursor_;
+        block_offset = cursor_offset_;
+    }
+
+    while (p != NULL)
+    {
+        cursor_ = p;
+        cursor_offset_ = uint16_t(block_offset);
+        const unsigned block_end = block_offset + p->getCapacity();
+        if (offset < block_end)
+        {
+            break;
+        }
+        block_offset = block_end;
+        p = p->getNextListNode();
+    }
+
+    out_block_offset = block_offset;
+    return p;
+}
+
 void DynamicTransferBufferManagerEntry::doReset()
 {
     max_write_pos_ = 0;
+    written_ = false;
+    cursor_ = NULL;
+    cursor_offset_ = 0;
     Block* p = blocks_.get();
     while (p)
     {
@@ -131,25 +154,51 @@ int DynamicTransferBufferManagerEntry::read(unsigned offset, uint8_t* data, unsi
     }
     UAVCAN_ASSERT((offset + len) <= max_write_pos_);
 
-    // This shall be optimized.
-    unsigned total_offset = 0;
+    unsigned block_offset = 0;
+    Block* p = findBlock(offset, block_offset);
     unsigned left_to_read = len;
     uint8_t* outptr = data;
-    Block* p = blocks_.get();
-    while (p)
+    while ((left_to_read > 0) && (p != NULL))
     {
-        p->read(outptr, offset, total_offset, left_to_read);
-        if (left_to_read == 0)
+        const unsigned pos_in_block = offset + (len - left_to_read) - block_offset;
+        const unsigned chunk = min(left_to_read, p->getCapacity() - pos_in_block);
+        outptr = copy(p->data + pos_in_block, p->data + pos_in_block + chunk, outptr);
+        left_to_read -= chunk;
+        if (left_to_read > 0)
         {
-            break;
+            block_offset += p->getCapacity();
+            p = p->getNextListNode();
+            if (p != NULL)
+            {
+                cursor_ = p;
+                cursor_offset_ = uint16_t(block_offset);
+            }
         }
-        p = p->getNextListNode();
     }
 
     UAVCAN_ASSERT(left_to_read == 0);
     return int(len);
 }
 
+unsigned DynamicTransferBufferManagerEntry::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    if (offset >= max_write_pos_)
+    {
+        return 0;
+    }
+
+    unsigned block_offset = 0;
+    const Block* const p = findBlock(offset, block_offset);
+    if (p == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return 0;
+    }
+
+    out_data = p->data + (offset - block_offset);
+    return min(block_offset + p->getCapacity(), unsigned(max_write_pos_)) - offset;
+}
+
 int DynamicTransferBufferManagerEntry::write(unsigned offset, const uint8_t* data, unsigned len)
 {
     if (!data)
@@ -158,6 +207,8 @@ int DynamicTransferBufferManagerEntry::write(unsigned offset, const uint8_t* dat
         return -ErrInvalidParam;
     }
 
+    written_ = true;
+
     if (offset >= max_size_)
     {
         return 0;
@@ -168,51 +219,55 @@ int DynamicTransferBufferManagerEntry::write(unsigned offset, const uint8_t* dat
     }
     UAVCAN_ASSERT((offset + len) <= max_size_);
 
-    unsigned total_offset = 0;
+    unsigned block_offset = 0;
+    Block* p = findBlock(offset, block_offset);
     unsigned left_to_write = len;
     const uint8_t* inptr = data;
-    Block* p = blocks_.get();
-    Block* last_written_block = NULL;
-
-    // First we need to write the part that is already allocated
-    while (p)
-    {
-        last_written_block = p;
-        p->write(inptr, offset, total_offset, left_to_write);
-        if (left_to_write == 0)
-        {
-            break;
-        }
-        p = p->getNextListNode();
-    }
-
-    // Then we need to append new chunks until all data is written
     while (left_to_write > 0)
     {
-        // cppcheck-suppress nullPointer
-        UAVCAN_ASSERT(p == NULL);
-
-        // Allocating the chunk
-        Block* new_block = Block::instantiate(allocator_);
-        if (new_block == NULL)
+        if (p == NULL)
         {
-            break;                        // We're in deep shit.
+            // The cursor points to the last block in the chain, if any; the new block is appended after it
+            p = Block::instantiate(allocator_, max_size_ - block_offset);
+            if (p == NULL)
+            {
+                break;                        // We're in deep shit.
+            }
+            if (cursor_ != NULL)
+            {
+                UAVCAN_ASSERT(cursor_->getNextListNode() == NULL);
+                cursor_->setNextListNode(p);
+            }
+            else
+            {
+                UAVCAN_ASSERT(blocks_.isEmpty());
+                blocks_.insert(p);
+            }
+            cursor_ = p;
+            cursor_offset_ = uint16_t(block_offset);
         }
-        // Appending the chain with the new block
-        if (last_written_block != NULL)
+
+        // The block may lie entirely before the write offset if there is a gap after the end of the chain
+        const unsigned pos = offset + (len - left_to_write);
+        const unsigned block_end = block_offset + p->getCapacity();
+        if (pos < block_end)
         {
-            UAVCAN_ASSERT(last_written_block->getNextListNode() == NULL);  // Because it is last in the chain
-            last_written_block->setNextListNode(new_block);
-            new_block->setNextListNode(NULL);
+            const unsigned chunk = min(left_to_write, block_end - pos);
+            (void)copy(inptr, inptr + chunk, p->data + (pos - block_offset));
+            inptr += chunk;
+            left_to_write -= chunk;
         }
-        else
+
+        if (left_to_write > 0)
         {
-            blocks_.insert(new_block);
+            block_offset = block_end;
+            p = p->getNextListNode();
+            if (p != NULL)
+            {
+                cursor_ = p;
+                cursor_offset_ = uint16_t(block_offset);
+            }
         }
-        last_written_block = new_block;
-
-        // Writing the data
-        new_block->write(inptr, offset, total_offset, left_to_write);
     }
 
     UAVCAN_ASSERT(len >= left_to_write);
@@ -244,6 +299,16 @@ int StaticTransferBufferImpl::read(unsigned offset, uint8_t* data, unsigned len)
     return int(len);
 }
 
+unsigned StaticTransferBufferImpl::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    if (offset >= max_write_pos_)
+    {
+        return 0;
+    }
+    out_data = data_ + offset;
+    return max_write_pos_ - offset;
+}
+
 int StaticTransferBufferImpl::write(unsigned offset, const uint8_t* data, unsigned len)
 {
     if (!data)
@@ -291,12 +356,17 @@ int StaticTransferBufferManagerEntryImpl::write(unsigned offset, const uint8_t*
     return buf_.write(offset, data, len);
 }
 
-bool StaticTransferBufferManagerEntryImpl::migrateFrom(const TransferBufferManagerEntry* tbme)
+unsigned StaticTransferBufferManagerEntryImpl::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    return buf_.getContiguousSpan(offset, out_data);
+}
+
+int StaticTransferBufferManagerEntryImpl::migrateFrom(const TransferBufferManagerEntry* tbme)
 {
     if (tbme == NULL || tbme->isEmpty())
     {
         UAVCAN_ASSERT(0);
-        return false;
+        return -ErrInvalidParam;
     }
 
     // Resetting self and moving all data from the source
@@ -305,12 +375,12 @@ bool StaticTransferBufferManagerEntryImpl::migrateFrom(const TransferBufferManag
     if (res < 0)
     {
         TransferBufferManagerEntry::reset();
-        return false;
+        return res;
     }
     buf_.setMaxWritePos(uint16_t(res));
     if (res < int(buf_.getSize()))
     {
-        return true;
+        return res;
     }
 
     // Now we need to make sure that all data can fit the storage
@@ -318,9 +388,9 @@ bool StaticTransferBufferManagerEntryImpl::migrateFrom(const TransferBufferManag
     if (tbme->read(buf_.getSize(), &dummy, 1) > 0)
     {
         TransferBufferManagerEntry::reset();            // Damn, the buffer was too large
-        return false;
+        return -ErrLogic;
     }
-    return true;
+    return res;
 }
 
 /*
@@ -360,21 +430,38 @@ DynamicTransferBufferManagerEntry* TransferBufferManagerImpl::findFirstDynamic(c
 
 void TransferBufferManagerImpl::optimizeStorage()
 {
-    while (!dynamic_buffers_.isEmpty())
+    if (migration_policy_ == MigrateNever)
     {
+        return;
+    }
+
+    DynamicTransferBufferManagerEntry* dyn = dynamic_buffers_.get();
+    while (dyn != NULL)
+    {
+        DynamicTransferBufferManagerEntry* const next = dyn->getNextListNode();
+        UAVCAN_ASSERT(!dyn->isEmpty());
+
         StaticTransferBufferManagerEntryImpl* const sb = findFirstStatic(TransferBufferManagerKey());
         if (sb == NULL)
         {
             break;
         }
-        DynamicTransferBufferManagerEntry* dyn = dynamic_buffers_.get();
-        UAVCAN_ASSERT(dyn);
-        UAVCAN_ASSERT(!dyn->isEmpty());
-        if (sb->migrateFrom(dyn))
+
+        // A buffer that is being written will most likely be released soon, copying it would be a waste
+        if ((migration_policy_ == MigrateIdleOnly) && dyn->fetchWrittenFlag())
+        {
+            dyn = next;
+            continue;
+        }
+
+        const int res = sb->migrateFrom(dyn);
+        if (res >= 0)
         {
             UAVCAN_ASSERT(!dyn->isEmpty());
-            UAVCAN_TRACE("TransferBufferManager", "Storage optimization: Migrated %s",
-                         dyn->getKey().toString().c_str());
+            UAVCAN_TRACE("TransferBufferManager", "Storage optimization: Migrated %s, %d bytes",
+                         dyn->getKey().toString().c_str(), res);
+            num_migrations_++;
+            num_migrated_bytes_ += uint32_t(res);
             dynamic_buffers_.remove(dyn);
             DynamicTransferBufferManagerEntry::destroy(dyn, allocator_);
         }
@@ -389,6 +476,8 @@ void TransferBufferManagerImpl::optimizeStorage()
             sb->reset();
             break;
         }
+
+        dyn = next;
     }
 }
 
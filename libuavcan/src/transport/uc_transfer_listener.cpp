@@ -28,6 +28,9 @@ SingleFrameIncomingTransfer::SingleFrameIncomingTransfer(const RxFrame& frm)
     , payload_len_(uint8_t(frm.getPayloadLen()))
 {
     UAVCAN_ASSERT(frm.isValid());
+#if UAVCAN_SUPPORT_CANFD
+    setCanFD(frm.isCanFD());
+#endif
 }
 
 int SingleFrameIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned len) const
@@ -50,6 +53,16 @@ int SingleFrameIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned l
     return int(len);
 }
 
+unsigned SingleFrameIncomingTransfer::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    if (offset >= payload_len_)
+    {
+        return 0;
+    }
+    out_data = payload_ + offset;
+    return payload_len_ - offset;
+}
+
 bool SingleFrameIncomingTransfer::isAnonymousTransfer() const
 {
     return (getTransferType() == TransferTypeMessageBroadcast) && getSrcNodeID().isBroadcast();
@@ -63,9 +76,13 @@ MultiFrameIncomingTransfer::MultiFrameIncomingTransfer(MonotonicTime ts_mono, Ut
     : IncomingTransfer(ts_mono, ts_utc, last_frame.getPriority(), last_frame.getTransferType(),
                        last_frame.getTransferID(), last_frame.getSrcNodeID(), last_frame.getIfaceIndex())
     , buf_acc_(tba)
+    , last_frame_ts_mono_(last_frame.getMonotonicTimestamp())
 {
     UAVCAN_ASSERT(last_frame.isValid());
     UAVCAN_ASSERT(last_frame.isEndOfTransfer());
+#if UAVCAN_SUPPORT_CANFD
+    setCanFD(last_frame.isCanFD());
+#endif
 }
 
 int MultiFrameIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned len) const
@@ -79,13 +96,69 @@ int MultiFrameIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned le
     return tbb->read(offset, data, len);
 }
 
+unsigned MultiFrameIncomingTransfer::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    const ITransferBuffer* const tbb = const_cast<TransferBufferAccessor&>(buf_acc_).access();
+    return (tbb == NULL) ? 0 : tbb->getContiguousSpan(offset, out_data);
+}
+
+#if !UAVCAN_TINY
+/*
+ * DeferredIncomingTransfer
+ */
+DeferredIncomingTransfer::DeferredIncomingTransfer(const IncomingTransfer& origin, const uint8_t* payload,
+                                                   unsigned payload_len)
+    : IncomingTransfer(origin.getMonotonicTimestamp(), origin.getUtcTimestamp(), origin.getPriority(),
+                       origin.getTransferType(), origin.getTransferID(), origin.getSrcNodeID(),
+                       origin.getIfaceIndex())
+    , payload_(payload)
+    , payload_len_(payload_len)
+    , last_frame_ts_mono_(origin.getLastFrameMonotonicTimestamp())
+    , anonymous_(origin.isAnonymousTransfer())
+{
+    UAVCAN_ASSERT((payload != NULL) || (payload_len == 0));
+#if UAVCAN_SUPPORT_CANFD
+    setCanFD(origin.isCanFD());
+#endif
+}
+
+int DeferredIncomingTransfer::read(unsigned offset, uint8_t* data, unsigned len) const
+{
+    if (data == NULL)
+    {
+        UAVCAN_ASSERT(0);
+        return -ErrInvalidParam;
+    }
+    if (offset >= payload_len_)
+    {
+        return 0;
+    }
+    if ((offset + len) > payload_len_)
+    {
+        len = payload_len_ - offset;
+    }
+    (void)copy(payload_ + offset, payload_ + offset + len, data);
+    return int(len);
+}
+
+unsigned DeferredIncomingTransfer::getContiguousSpan(unsigned offset, const uint8_t*& out_data) const
+{
+    if (offset >= payload_len_)
+    {
+        return 0;
+    }
+    out_data = payload_ + offset;
+    return payload_len_ - offset;
+}
+#endif
+
 /*
  * TransferListenerBase::TimedOutReceiverPredicate
  */
 bool TransferListenerBase::TimedOutReceiverPredicate::operator()(const TransferBufferManagerKey& key,
                                                                  const TransferReceiver& value) const
 {
-    if (value.isTimedOut(ts_))
+    if (value.isExpired(ts_, max_retention_))
     {
         UAVCAN_TRACE("TransferListener", "Timed out receiver: %s", key.toString().c_str());
         /*
@@ -95,6 +168,7 @@ bool TransferListenerBase::TimedOutReceiverPredicate::operator()(const TransferB
          * Maybe it is not good that the predicate has side effects, but I ran out of better ideas.
          */
         parent_bufmgr_.remove(key);
+        num_removed_++;
         return true;
     }
     return false;
@@ -103,31 +177,193 @@ bool TransferListenerBase::TimedOutReceiverPredicate::operator()(const TransferB
 /*
  * TransferListenerBase
  */
-bool TransferListenerBase::checkPayloadCrc(const uint16_t compare_with, const ITransferBuffer& tbb) const
+TransferReceiver* TransferListenerBase::accessReceiver(const TransferBufferManagerKey& key)
+{
+    if (TransferListenerReceiverIndexSize == 0)
+    {
+        return receivers_.access(key);
+    }
+    ReceiverIndexEntry& entry = getReceiverIndexEntry(key);
+    if (!(entry.key == key))
+    {
+        TransferReceiver* const recv = receivers_.access(key);
+        if (recv == NULL)
+        {
+            return NULL;        // Negative results are not cached, the caller will likely insert a new receiver
+        }
+        entry.key = key;
+        entry.receiver = recv;
+    }
+    return entry.receiver;
+}
+
+TransferReceiver* TransferListenerBase::insertReceiver(const TransferBufferManagerKey& key)
+{
+    // Insertion of a new key does not relocate the existing entries, so the index remains valid
+    UAVCAN_ASSERT(receivers_.access(key) == NULL);
+    TransferReceiver new_recv;
+    TransferReceiver* const recv = receivers_.insert(key, new_recv);
+    if ((recv != NULL) && (TransferListenerReceiverIndexSize > 0))
+    {
+        ReceiverIndexEntry& entry = getReceiverIndexEntry(key);
+        entry.key = key;
+        entry.receiver = recv;
+    }
+    DataTypeStats* const stats = getActiveDataTypeStats();
+    if ((recv != NULL) && (stats != NULL))
+    {
+        stats->receivers_created++;
+    }
+    return recv;
+}
+
+void TransferListenerBase::invalidateReceiverIndex()
+{
+    for (unsigned i = 0; i < unsigned(ReceiverIndexSize); i++)
+    {
+        receiver_index_[i] = ReceiverIndexEntry();
+    }
+}
+
+bool TransferListenerBase::isRejectedByPrefilter(const RxFrame& frame) const
+{
+    UAVCAN_ASSERT(frame.isStartOfTransfer());
+    if (prefilter_ == NULL)
+    {
+        return false;
+    }
+    const unsigned crc_len = frame.isEndOfTransfer() ? 0U : unsigned(TransferCRC::NumBytes);
+    if (frame.getPayloadLen() < crc_len)
+    {
+        return false;                           // Malformed, the receiver will take care of it
+    }
+    if (prefilter_->acceptTransfer(frame.getPayloadPtr() + crc_len, frame.getPayloadLen() - crc_len,
+                                   frame.getSrcNodeID()))
+    {
+        return false;
+    }
+    UAVCAN_TRACE("TransferListenerBase", "Transfer discarded by the prefilter: %s", frame.toString().c_str());
+    return true;
+}
+
+void TransferListenerBase::deliverIncomingTransfer(IncomingTransfer& transfer)
+{
+#if !UAVCAN_TINY
+    if (handoff_ != NULL)
+    {
+        if (!handoff_->handOff(*this, transfer))
+        {
+            UAVCAN_TRACE("TransferListenerBase", "Transfer handoff failure, dtname=%s", data_type_.getFullName());
+            perf_.addError();
+        }
+        return;
+    }
+    DataTypeStats* const stats = getActiveDataTypeStats();
+    if ((stats != NULL) && (stats_clock_ != NULL))
+    {
+        const MonotonicTime started_at = stats_clock_->getMonotonic();
+        handleIncomingTransfer(transfer);
+        stats->addCallbackDuration(stats_clock_->getMonotonic() - started_at);
+        return;
+    }
+#endif
+    handleIncomingTransfer(transfer);
+}
+
+#if !UAVCAN_TINY
+
+void TransferListenerBase::handleDeferredTransfer(IncomingTransfer& transfer, DeferredTransferResult& out_result)
+{
+    UAVCAN_ASSERT(deferred_result_ == NULL);
+    deferred_result_ = &out_result;
+    if ((getActiveDataTypeStats() != NULL) && (stats_clock_ != NULL))
+    {
+        const MonotonicTime started_at = stats_clock_->getMonotonic();
+        handleIncomingTransfer(transfer);
+        out_result.callback_duration = stats_clock_->getMonotonic() - started_at;
+    }
+    else
+    {
+        handleIncomingTransfer(transfer);
+    }
+    deferred_result_ = NULL;
+}
+
+void TransferListenerBase::commitDeferredTransfer(const DeferredTransferResult& result)
+{
+    if (result.failed)
+    {
+        perf_.addError();
+    }
+    DataTypeStats* const stats = getActiveDataTypeStats();
+    if ((stats != NULL) && (stats_clock_ != NULL))
+    {
+        stats->addCallbackDuration(result.callback_duration);
+    }
+}
+
+#endif
+
+void TransferListenerBase::deliverSingleFrameTransfer(const RxFrame& frame)
+{
+    if (isRejectedByPrefilter(frame))
+    {
+        return;
+    }
+    perf_.addRxTransfer();
+    DataTypeStats* const stats = getActiveDataTypeStats();
+    if (stats != NULL)
+    {
+        stats->addRxTransfer(MonotonicDuration());
+    }
+    SingleFrameIncomingTransfer it(frame);
+    deliverIncomingTransfer(it);
+}
+
+bool TransferListenerBase::handleSingleFrameTableReception(const RxFrame& frame)
 {
-    TransferCRC crc = crc_base_;
-    unsigned offset = 0;
-    while (true)
+    UAVCAN_ASSERT(sft_receivers_ != NULL);
+    SingleFrameTransferReceiver& slot =
+        sft_receivers_[frame.getSrcNodeID().get() & (TransferListenerSingleFrameTableSize - 1U)];
+
+    if (!slot.isOwnedBy(frame.getSrcNodeID(), frame.getTransferType()))
     {
-        uint8_t buf[16];
-        const int res = tbb.read(offset, buf, sizeof(buf));
-        if (res < 0)
+        /*
+         * The slot can be taken over only if the source is not tracked by a regular receiver already,
+         * otherwise the transfer ID state would be lost and a duplicate transfer could be accepted.
+         */
+        const bool can_take_over = slot.isFree() || slot.isTimedOut(frame.getMonotonicTimestamp());
+        if (!can_take_over ||
+            (!receivers_.isEmpty() &&
+             (accessReceiver(TransferBufferManagerKey(frame.getSrcNodeID(), frame.getTransferType())) != NULL)))
         {
-            UAVCAN_TRACE("TransferListenerBase", "Failed to check CRC: Buffer read failure %i", res);
             return false;
         }
-        if (res == 0)
+        if (frame.getToggle())
         {
-            break;
+            UAVCAN_TRACE("TransferListenerBase", "Toggle bit is not cleared, %s", frame.toString().c_str());
+            perf_.addError();
+            return true;
         }
-        offset += unsigned(res);
-        crc.add(buf, unsigned(res));
+        slot = SingleFrameTransferReceiver(frame);
+        deliverSingleFrameTransfer(frame);
+        return true;
     }
-    if (crc.get() != compare_with)
+
+    bool error = false;
+    const bool accepted = slot.addFrame(frame, error, earliest_arrival_);
+    if (error)
     {
-        UAVCAN_TRACE("TransferListenerBase", "CRC mismatch, expected=0x%04x, got=0x%04x",
-                     int(compare_with), int(crc.get()));
-        return false;
+        perf_.addError();
+        DataTypeStats* const stats = getActiveDataTypeStats();
+        if (stats != NULL)
+        {
+            stats->rx_errors++;
+        }
+    }
+    if (accepted)
+    {
+        deliverSingleFrameTransfer(frame);
     }
     return true;
 }
@@ -135,40 +371,64 @@ bool TransferListenerBase::checkPayloadCrc(const uint16_t compare_with, const IT
 void TransferListenerBase::handleReception(TransferReceiver& receiver, const RxFrame& frame,
                                            TransferBufferAccessor& tba)
 {
-    switch (receiver.addFrame(frame, tba))
+    DataTypeStats* const stats = getActiveDataTypeStats();
+    // Single-frame transfers are checked upon delivery
+    const bool skip_payload = frame.isStartOfTransfer() && !frame.isEndOfTransfer() && isRejectedByPrefilter(frame);
+    switch (receiver.addFrame(frame, tba, data_type_.getTransferCRCBase(), skip_payload, earliest_arrival_))
     {
     case TransferReceiver::ResultNotComplete:
     {
-        perf_.addErrors(receiver.yieldErrorCount());
+        const uint8_t num_errors = receiver.yieldErrorCount();
+        perf_.addErrors(num_errors);
+        if (stats != NULL)
+        {
+            stats->rx_errors += num_errors;
+        }
         break;
     }
     case TransferReceiver::ResultSingleFrame:
     {
-        perf_.addRxTransfer();
-        SingleFrameIncomingTransfer it(frame);
-        handleIncomingTransfer(it);
+        deliverSingleFrameTransfer(frame);
         break;
     }
     case TransferReceiver::ResultComplete:
     {
         perf_.addRxTransfer();
-        const ITransferBuffer* tbb = tba.access();
-        if (tbb == NULL)
+        if (stats != NULL)
+        {
+            stats->addRxTransfer(frame.getMonotonicTimestamp() - receiver.getLastTransferTimestampMonotonic());
+        }
+        if (tba.access() == NULL)
         {
             UAVCAN_TRACE("TransferListenerBase", "Buffer access failure, last frame: %s", frame.toString().c_str());
+            if (stats != NULL)
+            {
+                stats->rx_errors++;
+            }
             break;
         }
-        if (!checkPayloadCrc(receiver.getLastTransferCrc(), *tbb))
+        // The CRC has been accumulated by the receiver as the payload was written, no need to read the buffer again
+        if (receiver.getLastTransferComputedCrc() != receiver.getLastTransferCrc())
         {
-            UAVCAN_TRACE("TransferListenerBase", "CRC error, last frame: %s", frame.toString().c_str());
+            UAVCAN_TRACE("TransferListenerBase", "CRC mismatch, expected=0x%04x, got=0x%04x, last frame: %s",
+                         int(receiver.getLastTransferCrc()), int(receiver.getLastTransferComputedCrc()),
+                         frame.toString().c_str());
+            if (stats != NULL)
+            {
+                stats->rx_errors++;
+            }
             break;
         }
         MultiFrameIncomingTransfer it(receiver.getLastTransferTimestampMonotonic(),
                                       receiver.getLastTransferTimestampUtc(), frame, tba);
-        handleIncomingTransfer(it);
+        deliverIncomingTransfer(it);
         it.release();
         break;
     }
+    case TransferReceiver::ResultSkipped:
+    {
+        break;
+    }
     default:
     {
         UAVCAN_ASSERT(0);
@@ -179,27 +439,53 @@ void TransferListenerBase::handleReception(TransferReceiver& receiver, const RxF
 
 void TransferListenerBase::handleAnonymousTransferReception(const RxFrame& frame)
 {
-    if (allow_anonymous_transfers_)
+    if (allow_anonymous_transfers_ && !isRejectedByPrefilter(frame))
     {
         perf_.addRxTransfer();
+        DataTypeStats* const stats = getActiveDataTypeStats();
+        if (stats != NULL)
+        {
+            stats->addRxTransfer(MonotonicDuration());
+        }
         SingleFrameIncomingTransfer it(frame);
-        handleIncomingTransfer(it);
+        deliverIncomingTransfer(it);
     }
 }
 
 void TransferListenerBase::cleanup(MonotonicTime ts)
 {
-    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts, bufmgr_));
+    unsigned num_removed = 0;
+    receivers_.removeAllWhere(TimedOutReceiverPredicate(ts, receiver_retention_, bufmgr_, num_removed));
+    if (num_removed > 0)
+    {
+        invalidateReceiverIndex();
+        DataTypeStats* const stats = getActiveDataTypeStats();
+        if (stats != NULL)
+        {
+            stats->receivers_removed += num_removed;
+        }
+    }
     UAVCAN_ASSERT(receivers_.isEmpty() ? bufmgr_.isEmpty() : 1);
 }
 
 void TransferListenerBase::handleFrame(const RxFrame& frame)
 {
+    if (single_frame_only_ && !(frame.isStartOfTransfer() && frame.isEndOfTransfer()))
+    {
+        UAVCAN_TRACE("TransferListenerBase", "MFT frame, SFT-only listener: %s", frame.toString().c_str());
+        return;                                 // Cannot be received anyway, no need to waste a receiver on it
+    }
+
     if (frame.getSrcNodeID().isUnicast())       // Normal transfer
     {
+        if ((sft_receivers_ != NULL) && handleSingleFrameTableReception(frame))
+        {
+            return;                             // Fast path, no receiver map, no buffers
+        }
+
         const TransferBufferManagerKey key(frame.getSrcNodeID(), frame.getTransferType());
 
-        TransferReceiver* recv = receivers_.access(key);
+        TransferReceiver* recv = accessReceiver(key);
         if (recv == NULL)
         {
             if (!frame.isStartOfTransfer())
@@ -207,8 +493,7 @@ void TransferListenerBase::handleFrame(const RxFrame& frame)
                 return;
             }
 
-            TransferReceiver new_recv;
-            recv = receivers_.insert(key, new_recv);
+            recv = insertReceiver(key);
             if (recv == NULL)
             {
                 UAVCAN_TRACE("TransferListener", "Receiver registration failed; frame %s", frame.toString().c_str());
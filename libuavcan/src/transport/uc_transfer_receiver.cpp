@@ -5,6 +5,7 @@
 #include <uavcan/transport/transfer_receiver.hpp>
 #include <uavcan/transport/crc.hpp>
 #include <uavcan/debug.hpp>
+#include <uavcan/util/event_trace.hpp>
 #include <cstdlib>
 #include <cassert>
 
@@ -51,6 +52,7 @@ void TransferReceiver::prepareForNextTransfer()
 {
     tid_.increment();
     next_toggle_ = false;
+    skipping_ = false;
     buffer_write_pos_ = 0;
 }
 
@@ -113,28 +115,47 @@ bool TransferReceiver::writePayload(const RxFrame& frame, ITransferBuffer& buf)
         if (success)
         {
             buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + effective_payload_len);
+            computed_crc_.add(payload + TransferCRC::NumBytes, effective_payload_len);
         }
         return success;
     }
     else
     {
         const int res = buf.write(buffer_write_pos_, payload, payload_len);
-        const bool success = res == static_cast<int>(payload_len);
+        bool success = res == static_cast<int>(payload_len);
+#if UAVCAN_SUPPORT_CANFD
+        /*
+         * The last frame of a CAN FD transfer may be padded with zeros, which may not fit the buffer if the buffer
+         * is sized for the largest data structure; they are covered by the transfer CRC though.
+         */
+        if (!success && (res >= 0) && frame.isCanFD() && frame.isEndOfTransfer())
+        {
+            success = true;
+            for (unsigned i = unsigned(res); i < payload_len; i++)
+            {
+                success = success && (payload[i] == 0);
+            }
+        }
+#endif
         if (success)
         {
-            buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + payload_len);
+            buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + unsigned(res));
+            computed_crc_.add(payload, payload_len);
         }
         return success;
     }
 }
 
-TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, TransferBufferAccessor& tba)
+TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, TransferBufferAccessor& tba,
+                                                      const TransferCRC& crc_base, bool skip_payload)
 {
     // Transfer timestamps are derived from the first frame
     if (frame.isStartOfTransfer())
     {
         this_transfer_ts_ = frame.getMonotonicTimestamp();
         first_frame_ts_   = frame.getUtcTimestamp();
+        computed_crc_     = crc_base;
+        skipping_         = skip_payload;
     }
 
     if (frame.isStartOfTransfer() && frame.isEndOfTransfer())
@@ -146,6 +167,24 @@ TransferReceiver::ResultCode TransferReceiver::receive(const RxFrame& frame, Tra
         return ResultSingleFrame;
     }
 
+    if (skipping_)
+    {
+        if (frame.isStartOfTransfer())
+        {
+            tba.remove();               // The buffer may be left over from the previous transfer
+        }
+        // The write position is advanced nevertheless, so that an unexpected start of transfer is detected
+        buffer_write_pos_ = static_cast<uint16_t>(buffer_write_pos_ + frame.getPayloadLen());
+        next_toggle_ = !next_toggle_;
+        if (frame.isEndOfTransfer())
+        {
+            updateTransferTimings();
+            prepareForNextTransfer();
+            return ResultSkipped;
+        }
+        return ResultNotComplete;
+    }
+
     // Payload write
     ITransferBuffer* buf = tba.access();
     if (buf == NULL)
@@ -183,8 +222,23 @@ bool TransferReceiver::isTimedOut(MonotonicTime current_ts) const
     return (current_ts - this_transfer_ts_) > getTidTimeout();
 }
 
-TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, TransferBufferAccessor& tba)
+bool TransferReceiver::isExpired(MonotonicTime current_ts, MonotonicDuration max_retention) const
+{
+    if (!isTimedOut(current_ts))
+    {
+        return false;
+    }
+    const MonotonicDuration retention = min(getInterval() * int64_t(RetentionNumIntervals), max_retention);
+    return (current_ts - this_transfer_ts_) > retention;
+}
+
+TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, TransferBufferAccessor& tba,
+                                                       const TransferCRC& crc_base, bool skip_payload,
+                                                       bool earliest_arrival)
 {
+    UAVCAN_EVENT_TRACE_POINT(EventTraceTransferReceiverAddFrame,
+                             frame.getSrcNodeID().get() | (unsigned(frame.getTransferID().get()) << 8));
+
     if ((frame.getMonotonicTimestamp().isZero()) ||
         (frame.getMonotonicTimestamp() < prev_transfer_ts_) ||
         (frame.getMonotonicTimestamp() < this_transfer_ts_))
@@ -199,7 +253,8 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
     const bool first_frame = frame.isStartOfTransfer();
     const bool non_wrapped_tid = tid_.computeForwardDistance(frame.getTransferID()) < TransferID::Half;
     const bool not_previous_tid = frame.getTransferID().computeForwardDistance(tid_) > 1;
-    const bool iface_switch_allowed = (frame.getMonotonicTimestamp() - this_transfer_ts_) > getIfaceSwitchDelay();
+    const bool iface_switch_allowed = (earliest_arrival && !isMidTransfer()) ||
+                                      ((frame.getMonotonicTimestamp() - this_transfer_ts_) > getIfaceSwitchDelay());
 
     // FSM, the hard way
     const bool need_restart =
@@ -222,6 +277,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
         iface_index_ = frame.getIfaceIndex() & IfaceIndexMask;
         tid_ = frame.getTransferID();
         next_toggle_ = false;
+        skipping_ = false;
         buffer_write_pos_ = 0;
         this_transfer_crc_ = 0;
         if (!first_frame)
@@ -235,7 +291,7 @@ TransferReceiver::ResultCode TransferReceiver::addFrame(const RxFrame& frame, Tr
     {
         return ResultNotComplete;
     }
-    return receive(frame, tba);
+    return receive(frame, tba, crc_base, skip_payload);
 }
 
 uint8_t TransferReceiver::yieldErrorCount()
@@ -245,4 +301,99 @@ uint8_t TransferReceiver::yieldErrorCount()
     return ret;
 }
 
+/*
+ * SingleFrameTransferReceiver
+ */
+SingleFrameTransferReceiver::SingleFrameTransferReceiver(const RxFrame& frame) :
+    ts_msec_(getTimestampMSec(frame)),
+    transfer_interval_msec_(TransferReceiver::DefaultTransferIntervalMSec),
+    transfer_type_(static_cast<uint16_t>(frame.getTransferType()) & 3U),
+    node_id_(frame.getSrcNodeID().get()),
+    tid_(0),
+    iface_index_(0)
+{
+    UAVCAN_ASSERT(frame.isStartOfTransfer() && frame.isEndOfTransfer() && frame.getSrcNodeID().isUnicast());
+    iface_index_ = frame.getIfaceIndex() & 3U;
+    TransferID tid = frame.getTransferID();
+    tid.increment();
+    tid_ = tid.get() & TransferID::Max;
+}
+
+void SingleFrameTransferReceiver::accept(const RxFrame& frame)
+{
+    const uint32_t ts_msec = getTimestampMSec(frame);
+
+    // Same as TransferReceiver::updateTransferTimings()
+    uint32_t interval_msec = ts_msec - ts_msec_;
+    interval_msec = min(interval_msec, uint32_t(MaxTransferIntervalMSec));
+    interval_msec = max(interval_msec, uint32_t(TransferReceiver::MinTransferIntervalMSec));
+    transfer_interval_msec_ = static_cast<uint16_t>(((uint32_t(transfer_interval_msec_) * 7U + interval_msec) / 8U) &
+                                                   MaxTransferIntervalMSec);
+
+    ts_msec_ = ts_msec;
+    iface_index_ = frame.getIfaceIndex() & 3U;
+    TransferID tid = frame.getTransferID();
+    tid.increment();
+    tid_ = tid.get() & TransferID::Max;
+}
+
+bool SingleFrameTransferReceiver::isTimedOut(MonotonicTime current_ts) const
+{
+    const uint32_t elapsed_msec = static_cast<uint32_t>(current_ts.toMSec()) - ts_msec_;
+    return (elapsed_msec < 0x80000000U) && (elapsed_msec > TransferReceiver::DefaultTidTimeoutMSec);
+}
+
+bool SingleFrameTransferReceiver::addFrame(const RxFrame& frame, bool& out_error, bool earliest_arrival)
+{
+    UAVCAN_ASSERT(isOwnedBy(frame.getSrcNodeID(), frame.getTransferType()));
+    UAVCAN_ASSERT(frame.isStartOfTransfer() && frame.isEndOfTransfer());
+    out_error = false;
+
+    const uint32_t elapsed_msec = getTimestampMSec(frame) - ts_msec_;
+    if (frame.getMonotonicTimestamp().isZero() || (elapsed_msec >= 0x80000000U))
+    {
+        UAVCAN_TRACE("SingleFrameTransferReceiver", "Invalid frame, %s", frame.toString().c_str());
+        return false;
+    }
+
+    // Same logic as in TransferReceiver::addFrame(), reduced for single-frame transfers
+    const TransferID expected_tid(tid_);
+    const bool tid_timed_out = elapsed_msec > TransferReceiver::DefaultTidTimeoutMSec;
+    const bool same_iface = frame.getIfaceIndex() == iface_index_;
+    const bool non_wrapped_tid = expected_tid.computeForwardDistance(frame.getTransferID()) < TransferID::Half;
+    const bool not_previous_tid = frame.getTransferID().computeForwardDistance(expected_tid) > 1;
+    const bool iface_switch_allowed = earliest_arrival || (elapsed_msec > transfer_interval_msec_);
+
+    const bool need_restart =
+        (tid_timed_out) ||
+        (same_iface && not_previous_tid) ||
+        (iface_switch_allowed && non_wrapped_tid);
+
+    if (!need_restart && !same_iface)
+    {
+        return false;
+    }
+    if (frame.getToggle())
+    {
+        UAVCAN_TRACE("SingleFrameTransferReceiver", "Toggle bit is not cleared, %s", frame.toString().c_str());
+        out_error = true;
+        return false;
+    }
+    if (need_restart)
+    {
+        out_error = expected_tid != frame.getTransferID();
+        accept(frame);
+        return true;
+    }
+    if (frame.getTransferID() != expected_tid)
+    {
+        UAVCAN_TRACE("SingleFrameTransferReceiver", "Unexpected TID (current %i), %s",
+                     expected_tid.get(), frame.toString().c_str());
+        out_error = true;
+        return false;
+    }
+    accept(frame);
+    return true;
+}
+
 }
@@ -10,25 +10,360 @@
 namespace uavcan
 {
 
+/**
+ * Computes the CRC and the length of the payload written by an encoder, and keeps the first bytes.
+ * Writes must be sequential; the last written byte can be rewritten, as the bit stream does with unaligned data.
+ */
+class TransferPayloadAnalyzer : public ITransferBuffer
+{
+    enum { HeadSize = sizeof(static_cast<CanFrame*>(0)->data) };
+
+    TransferCRC crc_;           ///< All bytes except the last one, which may be rewritten
+    unsigned len_;
+    uint8_t last_byte_;
+    uint8_t head_[HeadSize];
+
+public:
+    explicit TransferPayloadAnalyzer(const TransferCRC& crc_base)
+        : crc_(crc_base)
+        , len_(0)
+        , last_byte_(0)
+    {
+        fill(head_, head_ + unsigned(HeadSize), uint8_t(0));
+    }
+
+    virtual int read(unsigned, uint8_t*, unsigned) const { return -ErrLogic; }
+
+    virtual int write(unsigned offset, const uint8_t* data, unsigned len)
+    {
+        if (len == 0)
+        {
+            return 0;
+        }
+        const bool rewrite = (len_ > 0) && (offset == (len_ - 1));
+        if (!rewrite && (offset != len_))
+        {
+            UAVCAN_ASSERT(0);
+            return -ErrLogic;
+        }
+        if (!rewrite && (len_ > 0))
+        {
+            crc_.add(last_byte_);
+        }
+        for (unsigned i = 0; (i < len) && ((offset + i) < unsigned(HeadSize)); i++)
+        {
+            head_[offset + i] = data[i];
+        }
+        crc_.add(data, len - 1);
+        last_byte_ = data[len - 1];
+        len_ = offset + len;
+        return int(len);
+    }
+
+    unsigned getLength() const { return len_; }
+
+    /// Valid if the payload fits one frame
+    const uint8_t* getHead() const { return head_; }
+
+    uint16_t getCrc(unsigned padding_len) const
+    {
+        TransferCRC crc = crc_;
+        if (len_ > 0)
+        {
+            crc.add(last_byte_);
+        }
+        for (; padding_len > 0; padding_len--)
+        {
+            crc.add(0);
+        }
+        return crc.get();
+    }
+};
+
+/**
+ * Writes the payload of a multi frame transfer directly into the frames, prepending the transfer CRC; a frame is
+ * sent as soon as the encoder proceeds to the next one. Write rules are the same as for TransferPayloadAnalyzer.
+ */
+class TransferFrameStreamer : public ITransferBuffer
+{
+    enum { CrcLen = 2 };
+    enum { BufLen = sizeof(static_cast<CanFrame*>(0)->data) };
+
+    Dispatcher& dispatcher_;
+    DataTypeStats* const stats_;
+    Frame& frame_;
+    const uint32_t can_id_;
+    const MonotonicTime tx_deadline_;
+    const MonotonicTime blocking_deadline_;
+    const CanTxQueue::Qos qos_;
+    const CanIOFlags flags_;
+    const uint8_t iface_mask_;
+    const unsigned total_len_;      ///< Including the CRC
+    unsigned frame_offset_;         ///< Offset of the first byte of the current frame, including the CRC
+    unsigned frame_len_;
+    int num_sent_;
+    int error_;
+    uint8_t buf_[BufLen];
+
+    int flush()
+    {
+        const int write_res = frame_.setPayload(buf_, frame_len_);
+        if (write_res != int(frame_len_))
+        {
+            UAVCAN_TRACE("TransferSender", "Frame payload write failure, %i", write_res);
+            return (write_res < 0) ? write_res : -ErrLogic;
+        }
+        if ((frame_offset_ + frame_len_) >= total_len_)
+        {
+            frame_.setEndOfTransfer(true);
+        }
+        CanFrame can_frame;
+        if (!frame_.compile(can_frame, can_id_))
+        {
+            return -ErrLogic;
+        }
+        const int send_res = dispatcher_.send(can_frame, tx_deadline_, blocking_deadline_, qos_, flags_, iface_mask_);
+        if (send_res < 0)
+        {
+            return send_res;
+        }
+        num_sent_++;
+        if (stats_ != NULL)
+        {
+            stats_->addTxFrame(frame_len_);
+        }
+
+        frame_.setStartOfTransfer(false);
+        frame_.flipToggle();
+        frame_offset_ += frame_len_;
+        frame_len_ = 0;
+        return 0;
+    }
+
+public:
+    TransferFrameStreamer(Dispatcher& dispatcher, DataTypeStats* stats, Frame& frame, uint32_t can_id, uint16_t crc,
+                          unsigned payload_len, MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                          CanTxQueue::Qos qos, CanIOFlags flags, uint8_t iface_mask)
+        : dispatcher_(dispatcher)
+        , stats_(stats)
+        , frame_(frame)
+        , can_id_(can_id)
+        , tx_deadline_(tx_deadline)
+        , blocking_deadline_(blocking_deadline)
+        , qos_(qos)
+        , flags_(flags)
+        , iface_mask_(iface_mask)
+        , total_len_(payload_len + CrcLen)
+        , frame_offset_(0)
+        , frame_len_(CrcLen)
+        , num_sent_(0)
+        , error_(0)
+    {
+        UAVCAN_ASSERT(unsigned(frame.getPayloadCapacity()) <= unsigned(BufLen));
+        buf_[0] = uint8_t(crc & 0xFFU);             // Transfer CRC, little endian
+        buf_[1] = uint8_t((crc >> 8) & 0xFFU);
+    }
+
+    virtual int read(unsigned, uint8_t*, unsigned) const { return -ErrLogic; }
+
+    virtual int write(unsigned offset, const uint8_t* data, unsigned len)
+    {
+        if (error_ < 0)
+        {
+            return error_;
+        }
+        const unsigned capacity = unsigned(frame_.getPayloadCapacity());
+        unsigned pos = offset + CrcLen;
+        if ((pos < frame_offset_) || (pos > (frame_offset_ + frame_len_)) || ((pos + len) > total_len_))
+        {
+            UAVCAN_ASSERT(0);           // Non-sequential write, or the payload differs from the first pass
+            error_ = -ErrLogic;
+            return error_;
+        }
+        for (unsigned i = 0; i < len; i++, pos++)
+        {
+            if ((pos - frame_offset_) >= capacity)
+            {
+                // The encoder went past the current frame, so the frame will not be modified anymore
+                error_ = flush();
+                if (error_ < 0)
+                {
+                    return error_;
+                }
+            }
+            buf_[pos - frame_offset_] = data[i];
+            frame_len_ = max(frame_len_, pos - frame_offset_ + 1U);
+        }
+        return int(len);
+    }
+
+    /**
+     * Sends the last frame. Returns the number of sent frames or negative error code.
+     */
+    int finish(int encode_res)
+    {
+        if (error_ < 0)
+        {
+            return error_;
+        }
+        if (encode_res < 0)
+        {
+            return encode_res;
+        }
+        if ((frame_offset_ + frame_len_) != total_len_)
+        {
+            UAVCAN_ASSERT(0);           // The encoder produced different payload
+            return -ErrLogic;
+        }
+        const int res = flush();
+        return (res < 0) ? res : num_sent_;
+    }
+};
+
+/*
+ * TransferSender
+ */
 void TransferSender::registerError() const
 {
     dispatcher_.getTransferPerfCounter().addError();
 }
 
+Frame TransferSender::makeFrame(TransferType transfer_type, NodeID dst_node_id, TransferID tid) const
+{
+    Frame frame(data_type_id_, transfer_type, dispatcher_.getNodeID(), dst_node_id, tid);
+#if UAVCAN_SUPPORT_CANFD
+    frame.setCanFD(canfd_);
+#endif
+    return frame;
+}
+
+unsigned TransferSender::getTransferCRCPaddingLen(unsigned payload_len) const
+{
+#if UAVCAN_SUPPORT_CANFD
+    /*
+     * Zero padding of the last frame of a multi frame CAN FD transfer, refer to Frame::compile().
+     * Single frame transfers don't carry the CRC, so their padding doesn't matter.
+     */
+    static const unsigned Capacity = CanFrame::MaxDataLen - 1U;
+    const unsigned total_len = payload_len + TransferCRC::NumBytes;
+    if (canfd_ && (payload_len > Capacity))
+    {
+        const unsigned last_frame_len = ((total_len - 1U) % Capacity) + 1U + 1U;        // Including the tail byte
+        return CanFrame::roundUpDataLength(uint8_t(last_frame_len)) - last_frame_len;
+    }
+#endif
+    (void)payload_len;
+    return 0;
+}
+
+bool TransferSender::getCanID(const Frame& frame, uint32_t& out_can_id) const
+{
+    /*
+     * The data type ID is fixed, so the CAN ID depends only on these fields.
+     * The highest bit makes the key non-zero, so that zero can denote the empty cache.
+     */
+    const uint32_t key = (1UL << 31) |
+                         (uint32_t(frame.getPriority().get()) << 24) |
+                         (uint32_t(frame.getTransferType()) << 16) |
+                         (uint32_t(frame.getSrcNodeID().get()) << 8) |
+                         uint32_t(frame.getDstNodeID().get());
+    if (key != can_id_cache_key_)
+    {
+        if (!frame.isValid())
+        {
+            UAVCAN_ASSERT(0);
+            UAVCAN_TRACE("TransferSender", "Invalid frame: %s", frame.toString().c_str());
+            return false;
+        }
+        can_id_cache_ = frame.compileCanID();
+        can_id_cache_key_ = key;
+    }
+    out_can_id = can_id_cache_;
+    return true;
+}
+
+int TransferSender::sendFrame(const Frame& frame, uint32_t can_id, MonotonicTime tx_deadline,
+                              MonotonicTime blocking_deadline, CanIOFlags flags) const
+{
+    UAVCAN_ASSERT(frame.getSrcNodeID() == dispatcher_.getNodeID());
+    CanFrame can_frame;
+    if (!frame.compile(can_frame, can_id))
+    {
+        return -ErrLogic;
+    }
+    const int res = dispatcher_.send(can_frame, tx_deadline, blocking_deadline, qos_, flags, iface_mask_);
+    DataTypeStats* const stats = getActiveDataTypeStats();
+    if ((res >= 0) && (stats != NULL))
+    {
+        stats->addTxFrame(frame.getPayloadLen());
+    }
+    return res;
+}
+
 void TransferSender::init(const DataTypeDescriptor& dtid, CanTxQueue::Qos qos)
 {
     UAVCAN_ASSERT(!isInitialized());
 
     qos_          = qos;
     data_type_id_ = dtid.getID();
-    crc_base_     = dtid.getSignature().toTransferCRC();
+    crc_base_     = dtid.getTransferCRCBase();
+#if !UAVCAN_TINY
+    stats_        = dispatcher_.getDataTypeStatsTable().access(dtid.getKind(), dtid.getID());
+#endif
 }
 
-int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
-                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
-                         TransferID tid) const
+unsigned TransferSender::getNumFrames(unsigned payload_len, unsigned frame_capacity) const
 {
-    Frame frame(data_type_id_, transfer_type, dispatcher_.getNodeID(), dst_node_id, tid);
+    if ((payload_len <= frame_capacity) || (frame_capacity == 0))
+    {
+        return 1;
+    }
+    const unsigned total_len = payload_len + 2U;       // Multi frame transfers carry the transfer CRC
+    return (total_len + frame_capacity - 1U) / frame_capacity;
+}
+
+int TransferSender::checkRateLimit(unsigned num_frames) const
+{
+#if UAVCAN_TINY
+    (void)num_frames;
+#else
+    if (!isFrameRateLimited())
+    {
+        return 0;
+    }
+
+    /*
+     * Generic cell rate algorithm - the theoretical arrival time advances by the interval per frame,
+     * and may run ahead of the current time by no more than the burst.
+     */
+    const MonotonicTime ts = dispatcher_.getMonotonicTime();
+    const MonotonicTime tat = max(rate_limit_tat_, ts);
+    const unsigned allowance = (num_frames < rate_limit_burst_) ? (rate_limit_burst_ - num_frames) : 0U;
+    if ((tat - ts) > (rate_limit_interval_ * int64_t(allowance)))
+    {
+        UAVCAN_TRACE("TransferSender", "Rate limited, dtid=%d frames=%u", int(data_type_id_.get()), num_frames);
+        return -ErrRateLimited;
+    }
+    rate_limit_tat_ = tat + rate_limit_interval_ * int64_t(num_frames);
+#endif
+    return 0;
+}
+
+#if !UAVCAN_TINY
+void TransferSender::setFrameRateLimit(unsigned max_frames_per_sec, uint16_t burst)
+{
+    rate_limit_interval_ = (max_frames_per_sec > 0) ?
+                           MonotonicDuration::fromUSec(int64_t(1000000 / max_frames_per_sec)) : MonotonicDuration();
+    rate_limit_burst_ = max(burst, uint16_t(1));
+    rate_limit_tat_ = MonotonicTime();
+}
+#endif
+
+int TransferSender::sendPayload(const uint8_t* payload, unsigned payload_len, const uint16_t* payload_crc,
+                                MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                                TransferType transfer_type, NodeID dst_node_id, TransferID tid) const
+{
+    Frame frame = makeFrame(transfer_type, dst_node_id, tid);
 
     frame.setPriority(priority_);
     frame.setStartOfTransfer(true);
@@ -50,7 +385,17 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
         }
     }
 
+    const int rate_res = checkRateLimit(getNumFrames(payload_len, unsigned(frame.getPayloadCapacity())));
+    if (rate_res < 0)
+    {
+        return rate_res;
+    }
+
     dispatcher_.getTransferPerfCounter().addTxTransfer();
+    if (getActiveDataTypeStats() != NULL)
+    {
+        getActiveDataTypeStats()->transfers_tx++;
+    }
 
     /*
      * Sending frames
@@ -71,7 +416,14 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
 
         const CanIOFlags flags = frame.getSrcNodeID().isUnicast() ? flags_ : (flags_ | CanIOFlagAbortOnError);
 
-        return dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags, iface_mask_);
+        uint32_t can_id = 0;
+        if (!getCanID(frame, can_id))
+        {
+            registerError();
+            return -ErrLogic;
+        }
+
+        return sendFrame(frame, can_id, tx_deadline, blocking_deadline, flags);
     }
     else                                                   // Multi Frame Transfer
     {
@@ -80,17 +432,20 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
 
         int offset = 0;
         {
-            TransferCRC crc = crc_base_;
-            crc.add(payload, payload_len);
+            const uint16_t crc = (payload_crc != NULL) ? *payload_crc : computeTransferCRC(payload, payload_len);
 
             static const int BUFLEN = sizeof(static_cast<CanFrame*>(0)->data);
             uint8_t buf[BUFLEN];
 
-            buf[0] = uint8_t(crc.get() & 0xFFU);       // Transfer CRC, little endian
-            buf[1] = uint8_t((crc.get() >> 8) & 0xFF);
-            (void)copy(payload, payload + BUFLEN - 2, buf + 2);
+            // Payload is longer than the frame, so the first frame is always full
+            const unsigned frame_len = frame.getPayloadCapacity();
+            UAVCAN_ASSERT((frame_len <= unsigned(BUFLEN)) && (payload_len > frame_len));
+
+            buf[0] = uint8_t(crc & 0xFFU);             // Transfer CRC, little endian
+            buf[1] = uint8_t((crc >> 8) & 0xFF);
+            (void)copy(payload, payload + frame_len - 2, buf + 2);
 
-            const int write_res = frame.setPayload(buf, BUFLEN);
+            const int write_res = frame.setPayload(buf, frame_len);
             if (write_res < 2)
             {
                 UAVCAN_TRACE("TransferSender", "Frame payload write failure, %i", write_res);
@@ -101,11 +456,21 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
             UAVCAN_ASSERT(int(payload_len) > offset);
         }
 
+        // Frames of a multi frame transfer can't be coalesced
+        const CanIOFlags flags = CanIOFlags(flags_ & ~CanIOFlagCoalesce);
         int num_sent = 0;
 
+        // All frames of the transfer share the same CAN ID
+        uint32_t can_id = 0;
+        if (!getCanID(frame, can_id))
+        {
+            registerError();
+            return -ErrLogic;
+        }
+
         while (true)
         {
-            const int send_res = dispatcher_.send(frame, tx_deadline, blocking_deadline, qos_, flags_, iface_mask_);
+            const int send_res = sendFrame(frame, can_id, tx_deadline, blocking_deadline, flags);
             if (send_res < 0)
             {
                 registerError();
@@ -143,8 +508,34 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
     return -ErrLogic; // Return path analysis is apparently broken. There should be no warning, this 'return' is unreachable.
 }
 
+uint16_t TransferSender::computeTransferCRC(const uint8_t* payload, unsigned payload_len) const
+{
+    TransferCRC crc = crc_base_;
+    crc.add(payload, payload_len);
+    for (unsigned padding_len = getTransferCRCPaddingLen(payload_len); padding_len > 0; padding_len--)
+    {
+        crc.add(0);
+    }
+    return crc.get();
+}
+
 int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
-                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                         TransferID tid) const
+{
+    return sendPayload(payload, payload_len, NULL, tx_deadline, blocking_deadline, transfer_type, dst_node_id, tid);
+}
+
+int TransferSender::sendPreEncoded(const uint8_t* payload, unsigned payload_len, uint16_t payload_crc,
+                                   MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                                   TransferType transfer_type, NodeID dst_node_id, TransferID tid) const
+{
+    return sendPayload(payload, payload_len, &payload_crc, tx_deadline, blocking_deadline, transfer_type,
+                       dst_node_id, tid);
+}
+
+TransferID* TransferSender::accessTransferID(MonotonicTime tx_deadline, TransferType transfer_type,
+                                             NodeID dst_node_id) const
 {
     /*
      * TODO: TID is not needed for anonymous transfers, this part of the code can be skipped?
@@ -160,6 +551,16 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
     {
         UAVCAN_TRACE("TransferSender", "OTR access failure, dtid=%d tt=%i",
                      int(data_type_id_.get()), int(transfer_type));
+    }
+    return tid;
+}
+
+int TransferSender::send(const uint8_t* payload, unsigned payload_len, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const
+{
+    TransferID* const tid = accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
         return -ErrMemory;
     }
 
@@ -170,4 +571,101 @@ int TransferSender::send(const uint8_t* payload, unsigned payload_len, Monotonic
                 dst_node_id, this_tid);
 }
 
+int TransferSender::sendPreEncoded(const uint8_t* payload, unsigned payload_len, uint16_t payload_crc,
+                                   MonotonicTime tx_deadline, MonotonicTime blocking_deadline,
+                                   TransferType transfer_type, NodeID dst_node_id) const
+{
+    TransferID* const tid = accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
+        return -ErrMemory;
+    }
+
+    const TransferID this_tid = tid->get();
+    tid->increment();
+
+    return sendPreEncoded(payload, payload_len, payload_crc, tx_deadline, blocking_deadline, transfer_type,
+                          dst_node_id, this_tid);
+}
+
+int TransferSender::send(const ITransferPayloadEncoder& encoder, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id,
+                         TransferID tid) const
+{
+    /*
+     * First pass - payload length, CRC, and the head of the payload, which is enough for a single frame transfer
+     */
+    TransferPayloadAnalyzer analyzer(crc_base_);
+    const int encode_res = encoder.encode(analyzer);
+    if (encode_res < 0)
+    {
+        return encode_res;
+    }
+
+    Frame frame = makeFrame(transfer_type, dst_node_id, tid);
+    if (analyzer.getLength() <= unsigned(frame.getPayloadCapacity()))
+    {
+        return send(analyzer.getHead(), analyzer.getLength(), tx_deadline, blocking_deadline, transfer_type,
+                    dst_node_id, tid);
+    }
+
+    /*
+     * Second pass - multi frame transfer, the frames are sent as soon as they are filled in
+     */
+    frame.setPriority(priority_);
+    frame.setStartOfTransfer(true);
+
+    UAVCAN_TRACE("TransferSender", "Streaming %s", frame.toString().c_str());
+
+    if (dispatcher_.isPassiveMode())
+    {
+        return -ErrPassiveMode;
+    }
+    UAVCAN_ASSERT(frame.getSrcNodeID().isUnicast());
+
+    uint32_t can_id = 0;
+    if (!getCanID(frame, can_id))
+    {
+        return -ErrLogic;
+    }
+
+    const int rate_res = checkRateLimit(getNumFrames(analyzer.getLength(), unsigned(frame.getPayloadCapacity())));
+    if (rate_res < 0)
+    {
+        return rate_res;
+    }
+
+    dispatcher_.getTransferPerfCounter().addTxTransfer();
+    if (getActiveDataTypeStats() != NULL)
+    {
+        getActiveDataTypeStats()->transfers_tx++;
+    }
+
+    TransferFrameStreamer streamer(dispatcher_, getActiveDataTypeStats(), frame, can_id,
+                                   analyzer.getCrc(getTransferCRCPaddingLen(analyzer.getLength())),
+                                   analyzer.getLength(), tx_deadline, blocking_deadline, qos_,
+                                   CanIOFlags(flags_ & ~CanIOFlagCoalesce), iface_mask_);
+    const int res = streamer.finish(encoder.encode(streamer));
+    if (res < 0)
+    {
+        registerError();
+    }
+    return res;
+}
+
+int TransferSender::send(const ITransferPayloadEncoder& encoder, MonotonicTime tx_deadline,
+                         MonotonicTime blocking_deadline, TransferType transfer_type, NodeID dst_node_id) const
+{
+    TransferID* const tid = accessTransferID(tx_deadline, transfer_type, dst_node_id);
+    if (tid == NULL)
+    {
+        return -ErrMemory;
+    }
+
+    const TransferID this_tid = tid->get();
+    tid->increment();
+
+    return send(encoder, tx_deadline, blocking_deadline, transfer_type, dst_node_id, this_tid);
+}
+
 }
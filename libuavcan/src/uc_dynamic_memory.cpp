@@ -6,6 +6,125 @@
 
 namespace uavcan
 {
+/*
+ * MultiSizePoolAllocatorBase
+ */
+void MultiSizePoolAllocatorBase::addSizeClass(uint8_t* storage, uint8_t block_size, uint16_t num_blocks)
+{
+    UAVCAN_ASSERT(num_classes_ < MaxSizeClasses);
+    UAVCAN_ASSERT((num_classes_ == 0) || (classes_[num_classes_ - 1].usage.block_size < block_size));
+    UAVCAN_ASSERT(block_size >= sizeof(Node));
+    UAVCAN_ASSERT(num_blocks > 0);
+    if (num_classes_ >= MaxSizeClasses || num_blocks == 0)
+    {
+        return;
+    }
+
+    SizeClass& cls = classes_[num_classes_++];
+    cls.begin = storage;
+    cls.end = storage + unsigned(block_size) * num_blocks;
+    cls.usage.block_size = block_size;
+    cls.usage.num_blocks = num_blocks;
+
+    // Building the free list back to front, so that the blocks will be allocated in ascending address order
+    for (unsigned i = num_blocks; i > 0; i--)
+    {
+        Node* const node = reinterpret_cast<Node*>(storage + (i - 1U) * block_size);
+        node->next = cls.free_list;
+        cls.free_list = node;
+    }
+
+    num_blocks_ = static_cast<uint16_t>(num_blocks_ + num_blocks);
+}
+
+void* MultiSizePoolAllocatorBase::allocateFrom(SizeClass& cls)
+{
+    Node* const pmem = cls.free_list;
+    UAVCAN_ASSERT(pmem != NULL);
+    cls.free_list = pmem->next;
+
+    // Statistics
+    UAVCAN_ASSERT(cls.usage.num_used_blocks < cls.usage.num_blocks);
+    cls.usage.num_used_blocks++;
+    if (cls.usage.num_used_blocks > cls.usage.peak_num_used_blocks)
+    {
+        cls.usage.peak_num_used_blocks = cls.usage.num_used_blocks;
+    }
+
+    return pmem;
+}
+
+void* MultiSizePoolAllocatorBase::allocate(std::size_t size)
+{
+    unsigned best_fit = 0;
+    while (best_fit < num_classes_ && size > classes_[best_fit].usage.block_size)
+    {
+        best_fit++;
+    }
+    if (best_fit >= num_classes_)
+    {
+        return NULL;            // Larger than the largest block
+    }
+
+    for (unsigned i = best_fit; i < num_classes_; i++)
+    {
+        if (classes_[i].free_list != NULL)
+        {
+            if (i != best_fit)
+            {
+                classes_[best_fit].usage.num_spillovers++;
+            }
+            return allocateFrom(classes_[i]);
+        }
+    }
+
+    classes_[best_fit].usage.num_failures++;
+    return NULL;
+}
+
+void MultiSizePoolAllocatorBase::deallocate(const void* ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    const uint8_t* const p = static_cast<const uint8_t*>(ptr);
+    for (unsigned i = 0; i < num_classes_; i++)
+    {
+        SizeClass& cls = classes_[i];
+        if (p >= cls.begin && p < cls.end)
+        {
+            UAVCAN_ASSERT(((p - cls.begin) % cls.usage.block_size) == 0);
+
+            Node* const node = static_cast<Node*>(const_cast<void*>(ptr));
+            node->next = cls.free_list;
+            cls.free_list = node;
+
+            // Statistics
+            UAVCAN_ASSERT(cls.usage.num_used_blocks > 0);
+            cls.usage.num_used_blocks--;
+            return;
+        }
+    }
+    UAVCAN_ASSERT(0);           // The pointer does not belong to this allocator
+}
+
+uint16_t MultiSizePoolAllocatorBase::getNumUsedBlocks() const
+{
+    unsigned res = 0;
+    for (unsigned i = 0; i < num_classes_; i++)
+    {
+        res += classes_[i].usage.num_used_blocks;
+    }
+    return static_cast<uint16_t>(res);
+}
+
+MultiSizePoolAllocatorBase::SizeClassUsage MultiSizePoolAllocatorBase::getSizeClassUsage(unsigned index) const
+{
+    return (index < num_classes_) ? classes_[index].usage : SizeClassUsage();
+}
+
 /*
  * LimitedPoolAllocator
  */
@@ -38,4 +157,72 @@ uint16_t LimitedPoolAllocator::getNumBlocks() const
     return min(max_blocks_, allocator_.getNumBlocks());
 }
 
+/*
+ * InstrumentedPoolAllocator
+ */
+void* InstrumentedPoolAllocator::allocate(std::size_t size)
+{
+    void* const pmem = (num_used_blocks_ < max_blocks_) ? allocator_.allocate(size) : NULL;
+    if (pmem == NULL)
+    {
+        if (size <= MemPoolBlockSize)   // Larger requests are optional, see UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+        {
+            num_failures_++;
+        }
+        return NULL;
+    }
+
+    num_used_blocks_++;
+    if (num_used_blocks_ > peak_num_used_blocks_)
+    {
+        peak_num_used_blocks_ = num_used_blocks_;
+    }
+    return pmem;
+}
+
+void InstrumentedPoolAllocator::deallocate(const void* ptr)
+{
+    allocator_.deallocate(ptr);
+
+    UAVCAN_ASSERT(num_used_blocks_ > 0);
+    if (num_used_blocks_ > 0)
+    {
+        num_used_blocks_--;
+    }
+}
+
+#if !UAVCAN_TINY
+/*
+ * MemoryUsageTracker
+ */
+InstrumentedPoolAllocator& MemoryUsageTracker::get(MemoryConsumer consumer)
+{
+    switch (consumer)
+    {
+    case MemoryConsumerCanTxQueue:
+    {
+        return can_tx_queue_;
+    }
+    case MemoryConsumerTransferReceivers:
+    {
+        return transfer_receivers_;
+    }
+    case MemoryConsumerOutgoingTransferRegistry:
+    {
+        return outgoing_transfer_registry_;
+    }
+    case MemoryConsumerServiceCalls:
+    {
+        return service_calls_;
+    }
+    case MemoryConsumerOther:
+    default:
+    {
+        UAVCAN_ASSERT(consumer == MemoryConsumerOther);
+        return other_;
+    }
+    }
+}
+#endif
+
 }
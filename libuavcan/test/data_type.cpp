@@ -124,6 +124,35 @@ TEST(DataTypeDescriptor, Match)
 }
 
 
+TEST(DataTypeDescriptor, TransferCRCBase)
+{
+    const uavcan::DataTypeDescriptor def;
+    ASSERT_EQ(uavcan::DataTypeSignature().toTransferCRC().get(), def.getTransferCRCBase().get());
+
+    const uavcan::DataTypeSignature signature(0xdeadbeef12345678ULL);
+    uavcan::DataTypeDescriptor desc(uavcan::DataTypeKindMessage, 123, signature, "namespace.TypeName");
+    ASSERT_EQ(signature.toTransferCRC().get(), desc.getTransferCRCBase().get());
+    ASSERT_NE(def.getTransferCRCBase().get(), desc.getTransferCRCBase().get());
+
+    // Survives copying
+    desc = uavcan::DataTypeDescriptor(desc);
+    ASSERT_EQ(signature.toTransferCRC().get(), desc.getTransferCRCBase().get());
+
+    // Continuing the precomputed CRC is the same as hashing the signature and the payload at once
+    const uint8_t payload[] = { 1, 2, 3, 4, 5 };
+    uavcan::TransferCRC crc = desc.getTransferCRCBase();
+    crc.add(payload, sizeof(payload));
+
+    uavcan::TransferCRC reference;
+    for (int i = 0; i < 64; i += 8)
+    {
+        reference.add(uint8_t((signature.get() >> i) & 0xFFU));
+    }
+    reference.add(payload, sizeof(payload));
+    ASSERT_EQ(reference.get(), crc.get());
+}
+
+
 TEST(DataTypeID, Basic)
 {
     uavcan::DataTypeID id;
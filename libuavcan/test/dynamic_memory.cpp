@@ -72,3 +72,200 @@ TEST(DynamicMemory, LimitedPoolAllocator)
 
     EXPECT_EQ(2, pool32.getPeakNumUsedBlocks());
 }
+
+TEST(DynamicMemory, InstrumentedPoolAllocator)
+{
+    uavcan::PoolAllocator<128, 32> pool32;
+    uavcan::MemoryUsageTracker tracker(pool32);
+
+    uavcan::InstrumentedPoolAllocator& txq = tracker.get(uavcan::MemoryConsumerCanTxQueue);
+    uavcan::InstrumentedPoolAllocator& rx = tracker.get(uavcan::MemoryConsumerTransferReceivers);
+    EXPECT_EQ(4, txq.getNumBlocks());
+    EXPECT_NE(&txq, &rx);
+
+    const void* ptr1 = txq.allocate(1);
+    const void* ptr2 = txq.allocate(1);
+    const void* ptr3 = rx.allocate(1);
+    const void* ptr4 = rx.allocate(1);
+    const void* ptr5 = rx.allocate(1);      // No memory left
+
+    EXPECT_TRUE(ptr1);
+    EXPECT_TRUE(ptr2);
+    EXPECT_TRUE(ptr3);
+    EXPECT_TRUE(ptr4);
+    EXPECT_FALSE(ptr5);
+
+    EXPECT_EQ(2, txq.getNumUsedBlocks());
+    EXPECT_EQ(2, rx.getNumUsedBlocks());
+    EXPECT_EQ(0, txq.getNumFailures());
+    EXPECT_EQ(1, rx.getNumFailures());
+
+    // Oversized requests are probes for contiguous buffers, their refusal is not a failure
+    txq.deallocate(ptr2);
+    EXPECT_FALSE(txq.allocate(uavcan::MemPoolBlockSize + 1));
+    EXPECT_EQ(0, txq.getNumFailures());
+    ptr2 = txq.allocate(1);
+    EXPECT_TRUE(ptr2);
+
+    txq.deallocate(ptr1);
+    txq.deallocate(ptr2);
+    rx.deallocate(ptr3);
+
+    EXPECT_EQ(0, txq.getNumUsedBlocks());
+    EXPECT_EQ(2, txq.getPeakNumUsedBlocks());
+    EXPECT_EQ(1, rx.getNumUsedBlocks());
+    EXPECT_EQ(2, rx.getPeakNumUsedBlocks());
+    EXPECT_EQ(1, pool32.getNumUsedBlocks());
+
+    // Other consumers are not affected
+    EXPECT_EQ(0, tracker.get(uavcan::MemoryConsumerOther).getPeakNumUsedBlocks());
+    EXPECT_EQ(0, tracker.get(uavcan::MemoryConsumerServiceCalls).getNumFailures());
+
+    rx.deallocate(ptr4);
+    EXPECT_EQ(0, pool32.getNumUsedBlocks());
+}
+
+TEST(DynamicMemory, InstrumentedPoolAllocatorQuota)
+{
+    uavcan::PoolAllocator<256, 32> pool32;
+    uavcan::MemoryUsageTracker tracker(pool32);
+
+    uavcan::InstrumentedPoolAllocator& txq = tracker.get(uavcan::MemoryConsumerCanTxQueue);
+    uavcan::InstrumentedPoolAllocator& rx = tracker.get(uavcan::MemoryConsumerTransferReceivers);
+
+    EXPECT_EQ(0xFFFF, rx.getQuota());
+    rx.setQuota(3);
+    EXPECT_EQ(3, rx.getQuota());
+    EXPECT_EQ(3, rx.getNumBlocks());
+    EXPECT_EQ(8, txq.getNumBlocks());
+
+    // Receivers can't take more than their quota
+    const void* rx_ptrs[4];
+    for (int i = 0; i < 4; i++)
+    {
+        rx_ptrs[i] = rx.allocate(1);
+    }
+    EXPECT_TRUE(rx_ptrs[0]);
+    EXPECT_TRUE(rx_ptrs[1]);
+    EXPECT_TRUE(rx_ptrs[2]);
+    EXPECT_FALSE(rx_ptrs[3]);
+    EXPECT_EQ(1, rx.getNumFailures());
+    EXPECT_EQ(3, pool32.getNumUsedBlocks());
+
+    // The rest of the pool remains available to the TX queue
+    const void* txq_ptrs[5];
+    for (int i = 0; i < 5; i++)
+    {
+        txq_ptrs[i] = txq.allocate(1);
+        EXPECT_TRUE(txq_ptrs[i]);
+    }
+    EXPECT_FALSE(txq.allocate(1));          // Pool exhausted
+    EXPECT_EQ(1, txq.getNumFailures());
+
+    // Quota below the current usage
+    rx.setQuota(1);
+    rx.deallocate(rx_ptrs[0]);
+    EXPECT_FALSE(rx.allocate(1));
+    rx.deallocate(rx_ptrs[1]);
+    rx.deallocate(rx_ptrs[2]);
+    const void* const ptr = rx.allocate(1);
+    EXPECT_TRUE(ptr);
+    rx.deallocate(ptr);
+
+    for (int i = 0; i < 5; i++)
+    {
+        txq.deallocate(txq_ptrs[i]);
+    }
+    EXPECT_EQ(0, pool32.getNumUsedBlocks());
+}
+
+TEST(DynamicMemory, MultiSizePoolAllocator)
+{
+    static const uint8_t Small = uavcan::MemPoolAlignment * 2;
+    static const uint8_t Large = uavcan::MemPoolAlignment * 4;
+
+    uavcan::MultiSizePoolAllocator<Small * 2, Small, Large * 3, Large> pool;
+
+    EXPECT_EQ(5, pool.getNumBlocks());
+    EXPECT_EQ(2, pool.getNumSizeClasses());
+    EXPECT_EQ(Small, pool.getSizeClassUsage(0).block_size);
+    EXPECT_EQ(2, pool.getSizeClassUsage(0).num_blocks);
+    EXPECT_EQ(Large, pool.getSizeClassUsage(1).block_size);
+    EXPECT_EQ(3, pool.getSizeClassUsage(1).num_blocks);
+    EXPECT_EQ(0, pool.getSizeClassUsage(2).num_blocks);     // Out of range
+
+    EXPECT_FALSE(pool.allocate(Large + 1));                 // Too large for any class
+    EXPECT_EQ(0, pool.getSizeClassUsage(1).num_failures);
+
+    // Small requests go to the small class
+    const void* small1 = pool.allocate(1);
+    const void* small2 = pool.allocate(Small);
+    ASSERT_TRUE(small1);
+    ASSERT_TRUE(small2);
+    EXPECT_EQ(2, pool.getSizeClassUsage(0).num_used_blocks);
+    EXPECT_EQ(0, pool.getSizeClassUsage(1).num_used_blocks);
+
+    // Small class is exhausted - spillover to the large class
+    const void* small3 = pool.allocate(Small);
+    ASSERT_TRUE(small3);
+    EXPECT_EQ(1, pool.getSizeClassUsage(0).num_spillovers);
+    EXPECT_EQ(1, pool.getSizeClassUsage(1).num_used_blocks);
+
+    // Large requests never go to the small class
+    const void* large1 = pool.allocate(Small + 1);
+    const void* large2 = pool.allocate(Large);
+    ASSERT_TRUE(large1);
+    ASSERT_TRUE(large2);
+    EXPECT_EQ(3, pool.getSizeClassUsage(1).num_used_blocks);
+    EXPECT_EQ(0, pool.getSizeClassUsage(1).num_spillovers);
+    EXPECT_EQ(5, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, pool.getNumFreeBlocks());
+
+    EXPECT_FALSE(pool.allocate(Large));
+    EXPECT_FALSE(pool.allocate(1));
+    EXPECT_EQ(1, pool.getSizeClassUsage(0).num_failures);
+    EXPECT_EQ(1, pool.getSizeClassUsage(1).num_failures);
+
+    // Blocks are returned to the classes they were taken from
+    pool.deallocate(small3);
+    EXPECT_EQ(2, pool.getSizeClassUsage(1).num_used_blocks);
+    pool.deallocate(small1);
+    EXPECT_EQ(1, pool.getSizeClassUsage(0).num_used_blocks);
+    EXPECT_EQ(small1, pool.allocate(Small));                // LIFO
+    pool.deallocate(small1);
+
+    pool.deallocate(small2);
+    pool.deallocate(large1);
+    pool.deallocate(large2);
+    pool.deallocate(NULL);
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(2, pool.getSizeClassUsage(0).peak_num_used_blocks);
+    EXPECT_EQ(3, pool.getSizeClassUsage(1).peak_num_used_blocks);
+
+    // Usable through the generic interface
+    uavcan::LimitedPoolAllocator lim(pool, 4);
+    EXPECT_EQ(4, lim.getNumBlocks());
+}
+
+TEST(DynamicMemory, MultiSizePoolAllocatorAlignment)
+{
+    static const uint8_t Step = uavcan::MemPoolAlignment;
+
+    uavcan::MultiSizePoolAllocator<Step * 3, Step, Step * 4, Step * 2, Step * 3 * 2, Step * 3, Step * 4, Step * 4> pool;
+
+    EXPECT_EQ(4, pool.getNumSizeClasses());
+    EXPECT_EQ(3 + 2 + 2 + 1, pool.getNumBlocks());
+
+    for (unsigned i = 0; i < pool.getNumBlocks(); i++)
+    {
+        void* const ptr = pool.allocate(1);
+        ASSERT_TRUE(ptr);
+        EXPECT_EQ(0, reinterpret_cast<std::size_t>(ptr) % uavcan::MemPoolAlignment);
+        std::memset(ptr, 0xFF, 1);
+    }
+    EXPECT_FALSE(pool.allocate(1));
+    EXPECT_EQ(3, pool.getSizeClassUsage(0).num_used_blocks);
+    EXPECT_EQ(5, pool.getSizeClassUsage(0).num_spillovers);
+    EXPECT_EQ(1, pool.getSizeClassUsage(0).num_failures);
+    EXPECT_EQ(1, pool.getSizeClassUsage(3).num_used_blocks);
+}
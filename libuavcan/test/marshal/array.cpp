@@ -7,6 +7,7 @@
 #endif
 
 #include <gtest/gtest.h>
+#include <limits>
 #include <uavcan/marshal/types.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
 
@@ -20,6 +21,26 @@ using uavcan::SignednessUnsigned;
 using uavcan::CastModeSaturate;
 using uavcan::CastModeTruncate;
 
+/*
+ * These array types are pooled regardless of UAVCAN_DYNAMIC_ARRAY_POOL_THRESHOLD
+ */
+typedef IntegerSpec<8, SignednessUnsigned, CastModeSaturate> PooledByte;
+typedef IntegerSpec<32, SignednessSigned, CastModeSaturate> PooledInt;
+
+namespace uavcan
+{
+template <>
+struct ArrayStorageSelector<PooledByte, ArrayModeDynamic, 200>
+{
+    typedef PooledArrayImpl<PooledByte, 200> Result;
+};
+template <>
+struct ArrayStorageSelector<PooledInt, ArrayModeDynamic, 100>
+{
+    typedef PooledArrayImpl<PooledInt, 100> Result;
+};
+}
+
 struct CustomType
 {
     typedef uavcan::IntegerSpec<8, uavcan::SignednessSigned, uavcan::CastModeTruncate> A;
@@ -659,6 +680,125 @@ TEST(Array, StaticEncodeDecodeErrors)
 }
 
 
+TEST(Array, BulkEncodeDecode)
+{
+    typedef IntegerSpec<8, SignednessUnsigned, CastModeSaturate> U8;
+    typedef IntegerSpec<16, SignednessSigned, CastModeTruncate> S16;
+    typedef FloatSpec<32, CastModeSaturate> F32;
+    typedef IntegerSpec<3, SignednessUnsigned, CastModeSaturate> U3;
+
+    ASSERT_TRUE(uavcan::IsBulkCodable<U8>::Result);
+    ASSERT_TRUE(uavcan::IsBulkCodable<S16>::Result);
+    ASSERT_TRUE(uavcan::IsBulkCodable<F32>::Result);
+    ASSERT_FALSE((uavcan::IsBulkCodable<IntegerSpec<7, SignednessUnsigned, CastModeSaturate> >::Result));
+    ASSERT_FALSE((uavcan::IsBulkCodable<IntegerSpec<24, SignednessSigned, CastModeSaturate> >::Result));
+    ASSERT_FALSE((uavcan::IsBulkCodable<FloatSpec<16, CastModeSaturate> >::Result));
+
+    typedef Array<U8, ArrayModeDynamic, 100> Bytes;
+    typedef Array<S16, ArrayModeStatic, 11> Shorts;
+    typedef Array<F32, ArrayModeStatic, 5> Floats;
+
+    Bytes bytes;
+    for (unsigned i = 0; i < 37; i++)
+    {
+        bytes.push_back(uint8_t(i * 7 + 3));
+    }
+    Shorts shorts;
+    for (unsigned i = 0; i < Shorts::MaxSize; i++)
+    {
+        shorts[static_cast<Shorts::SizeType>(i)] = int16_t(int(i * 4099) - 12345);
+    }
+    Floats floats;
+    for (unsigned i = 0; i < Floats::MaxSize; i++)
+    {
+        floats[static_cast<Floats::SizeType>(i)] = float(i) * -1.25F + 0.1F;
+    }
+
+    /*
+     * Every leading bit offset is tried, the output must match element-by-element encoding
+     */
+    for (unsigned prefix_len = 0; prefix_len < 8; prefix_len++)
+    {
+        uavcan::StaticTransferBuffer<200> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+
+        uavcan::StaticTransferBuffer<200> ref_buf;
+        uavcan::BitStream ref_bs_wr(ref_buf);
+        uavcan::ScalarCodec ref_sc_wr(ref_bs_wr);
+
+        for (unsigned i = 0; i < prefix_len; i++)
+        {
+            ASSERT_EQ(1, U3::encode(1, sc_wr, uavcan::TailArrayOptDisabled));
+            ASSERT_EQ(1, U3::encode(1, ref_sc_wr, uavcan::TailArrayOptDisabled));
+        }
+
+        ASSERT_EQ(1, Bytes::encode(bytes, sc_wr, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, Shorts::encode(shorts, sc_wr, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, Floats::encode(floats, sc_wr, uavcan::TailArrayOptDisabled));
+
+        ASSERT_EQ(1, (IntegerSpec<7, SignednessUnsigned, CastModeSaturate>::encode(uint8_t(bytes.size()), ref_sc_wr,
+                                                                                    uavcan::TailArrayOptDisabled)));
+        for (unsigned i = 0; i < bytes.size(); i++)
+        {
+            ASSERT_EQ(1, U8::encode(bytes[static_cast<Bytes::SizeType>(i)], ref_sc_wr, uavcan::TailArrayOptDisabled));
+        }
+        for (unsigned i = 0; i < shorts.size(); i++)
+        {
+            ASSERT_EQ(1, S16::encode(shorts[static_cast<Shorts::SizeType>(i)], ref_sc_wr, uavcan::TailArrayOptDisabled));
+        }
+        for (unsigned i = 0; i < floats.size(); i++)
+        {
+            ASSERT_EQ(1, F32::encode(floats[static_cast<Floats::SizeType>(i)], ref_sc_wr, uavcan::TailArrayOptDisabled));
+        }
+
+        ASSERT_EQ(ref_bs_wr.toString(), bs_wr.toString());
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        for (unsigned i = 0; i < prefix_len; i++)
+        {
+            uint8_t dummy = 0;
+            ASSERT_EQ(1, U3::decode(dummy, sc_rd, uavcan::TailArrayOptDisabled));
+        }
+
+        Bytes bytes2;
+        Shorts shorts2;
+        Floats floats2;
+        ASSERT_EQ(1, Bytes::decode(bytes2, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, Shorts::decode(shorts2, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, Floats::decode(floats2, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_TRUE(bytes == bytes2);
+        ASSERT_TRUE(shorts == shorts2);
+        ASSERT_TRUE(floats == floats2);
+    }
+
+    /*
+     * Running out of buffer space in the middle of the array, both aligned and unaligned
+     */
+    for (unsigned prefix_len = 0; prefix_len < 2; prefix_len++)
+    {
+        uavcan::StaticTransferBuffer<20> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        for (unsigned i = 0; i < prefix_len; i++)
+        {
+            ASSERT_EQ(1, U3::encode(1, sc_wr, uavcan::TailArrayOptDisabled));
+        }
+        ASSERT_EQ(0, Shorts::encode(shorts, sc_wr, uavcan::TailArrayOptDisabled));
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        for (unsigned i = 0; i < prefix_len; i++)
+        {
+            uint8_t dummy = 0;
+            ASSERT_EQ(1, U3::decode(dummy, sc_rd, uavcan::TailArrayOptDisabled));
+        }
+        Shorts shorts2;
+        ASSERT_EQ(0, Shorts::decode(shorts2, sc_rd, uavcan::TailArrayOptDisabled));
+    }
+}
+
 TEST(Array, Copyability)
 {
     typedef Array<IntegerSpec<1, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 5>   OneBitArray;
@@ -1317,6 +1457,69 @@ TEST(Array, SquareMatrixPackingInPlace)
     ASSERT_EQ(6, m3x3s[5]);
 }
 
+/**
+ * The packing mode detection as it was done before it was reduced to a single pass.
+ */
+template <typename Analyzer>
+static typename Analyzer::PackingMode detectPackingModeMultiPass(const Analyzer& analyzer)
+{
+    if (analyzer.areAllElementsNan())
+    {
+        return Analyzer::PackingModeEmpty;
+    }
+    if (analyzer.isScalar())
+    {
+        return Analyzer::PackingModeScalar;
+    }
+    if (analyzer.isDiagonal())
+    {
+        return Analyzer::PackingModeDiagonal;
+    }
+    if (analyzer.isSymmetric())
+    {
+        return Analyzer::PackingModeSymmetric;
+    }
+    return Analyzer::PackingModeFull;
+}
+
+TEST(Array, SquareMatrixPackingModeDetection)
+{
+    typedef uavcan::SquareMatrixAnalyzer<const float*, 9> Analyzer;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    const float matrices[][9] =
+    {
+        { nan, nan, nan, nan, nan, nan, nan, nan, nan },        // Empty
+        { 1, 0, 0, 0, 1, 0, 0, 0, 1 },                          // Scalar
+        { 1, 0, 0, 0, 2, 0, 0, 0, 3 },                          // Diagonal
+        { 1, 4, 5, 4, 2, 6, 5, 6, 3 },                          // Symmetric
+        { 1, 4, 5, 4, 2, 6, 5, 7, 3 },                          // Full
+        { nan, 0, 0, 0, nan, 0, 0, 0, nan },                    // Diagonal, not scalar
+        { nan, nan, nan, nan, nan, nan, nan, nan, 1 },          // Not empty, not diagonal
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0 },                          // Scalar
+        { 1, 1e-9F, 0, 0, 1, 0, 0, 0, 1.0000001F },             // Scalar, fuzzy
+    };
+    const Analyzer::PackingMode expected[] =
+    {
+        Analyzer::PackingModeEmpty,
+        Analyzer::PackingModeScalar,
+        Analyzer::PackingModeDiagonal,
+        Analyzer::PackingModeSymmetric,
+        Analyzer::PackingModeFull,
+        Analyzer::PackingModeDiagonal,
+        Analyzer::PackingModeFull,
+        Analyzer::PackingModeScalar,
+        Analyzer::PackingModeScalar
+    };
+
+    for (unsigned i = 0; i < sizeof(matrices) / sizeof(matrices[0]); i++)
+    {
+        const Analyzer analyzer(matrices[i]);
+        EXPECT_EQ(expected[i], analyzer.detectOptimalPackingMode()) << i;
+        EXPECT_EQ(detectPackingModeMultiPass(analyzer), analyzer.detectOptimalPackingMode()) << i;
+    }
+}
+
 TEST(Array, FuzzyComparison)
 {
     typedef Array<Array<Array<FloatSpec<32, CastModeSaturate>, ArrayModeStatic, 2>,
@@ -1416,3 +1619,108 @@ TEST(Array, CaseConversion)
     str.convertToUpperCaseASCII();
     ASSERT_STREQ("HELLO WORLD!", str.c_str());
 }
+
+TEST(Array, Pooled)
+{
+    typedef Array<PooledByte, ArrayModeDynamic, 200> PooledString;
+    typedef Array<PooledInt, ArrayModeDynamic, 100> PooledInts;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::DynamicArrayAllocator::setAllocator(&pool);
+
+    /*
+     * The storage is allocated on demand
+     */
+    {
+        PooledString str;
+        ASSERT_GT(sizeof(uint8_t) * 200, sizeof(str));
+        ASSERT_EQ(200, str.capacity());
+        ASSERT_EQ(0, str.getAllocatedCapacity());
+        ASSERT_STREQ("", str.c_str());
+        ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+        str = "Hello";
+        ASSERT_STREQ("Hello", str.c_str());
+        ASSERT_EQ(1, pool.getNumUsedBlocks());
+        ASSERT_EQ(8, str.getAllocatedCapacity());
+
+        str += " pooled world!";
+        ASSERT_STREQ("Hello pooled world!", str.c_str());
+        ASSERT_EQ(1, pool.getNumUsedBlocks());          // Reallocated
+        ASSERT_LE(19, str.getAllocatedCapacity());
+
+        const PooledString copy = str;                  // Deep copy
+        ASSERT_TRUE(copy == str);
+        ASSERT_EQ(2, pool.getNumUsedBlocks());
+
+        str.clear();
+        str.shrink_to_fit();
+        ASSERT_EQ(0, str.getAllocatedCapacity());
+        ASSERT_EQ(1, pool.getNumUsedBlocks());
+        ASSERT_STREQ("Hello pooled world!", copy.c_str());
+
+        str.appendFormatted("%d", 123);
+        ASSERT_STREQ("123", str.c_str());
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * Encoding and decoding
+     */
+    {
+        PooledInts a;
+        for (int i = 0; i < 10; i++)
+        {
+            a.push_back(i * 1000);
+        }
+        ASSERT_EQ(10, a.size());
+
+        uavcan::StaticTransferBuffer<100> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        ASSERT_EQ(1, PooledInts::encode(a, sc_wr, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, PooledInts::encode(a, sc_wr, uavcan::TailArrayOptEnabled));
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        PooledInts b;
+        PooledInts c;
+        ASSERT_EQ(1, PooledInts::decode(b, sc_rd, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, PooledInts::decode(c, sc_rd, uavcan::TailArrayOptEnabled));
+        ASSERT_TRUE(a == b);
+        ASSERT_TRUE(a == c);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * Out of memory - the array doesn't grow, the decoding fails
+     */
+    {
+        PooledInts a;
+        a.resize(10);
+        ASSERT_EQ(10, a.size());
+        const uint32_t num_failures = uavcan::DynamicArrayAllocator::getNumFailures();
+
+        PooledInts b;
+        b.resize(100);                                  // Doesn't fit the block
+        ASSERT_EQ(0, b.size());
+        ASSERT_LT(num_failures, uavcan::DynamicArrayAllocator::getNumFailures());
+
+        uavcan::DynamicArrayAllocator::setAllocator(NULL);
+        b.push_back(1);
+        ASSERT_TRUE(b.empty());
+
+        uavcan::StaticTransferBuffer<100> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        ASSERT_EQ(1, PooledInts::encode(a, sc_wr, uavcan::TailArrayOptDisabled));
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        ASSERT_EQ(-uavcan::ErrMemory, PooledInts::decode(b, sc_rd, uavcan::TailArrayOptDisabled));
+
+        uavcan::DynamicArrayAllocator::setAllocator(&pool);
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    uavcan::DynamicArrayAllocator::setAllocator(NULL);
+}
@@ -2,6 +2,8 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
+#include <cstdlib>
 #include <gtest/gtest.h>
 #include <uavcan/marshal/bit_stream.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
@@ -192,3 +194,111 @@ TEST(BitStream, BitByBit)
     ASSERT_EQ(0, bs_wr.read(dummy_data_rd, 1));
     ASSERT_EQ(0xFF, dummy_data_rd[0]);
 }
+
+
+/**
+ * Hides the contiguous span interface, forcing the bit stream to copy the data out with read().
+ */
+struct NonContiguousBuffer : public uavcan::ITransferBuffer
+{
+    uavcan::ITransferBuffer& target;
+
+    explicit NonContiguousBuffer(uavcan::ITransferBuffer& arg_target) : target(arg_target) { }
+
+    virtual int read(unsigned offset, uint8_t* data, unsigned len) const { return target.read(offset, data, len); }
+    virtual int write(unsigned offset, const uint8_t* data, unsigned len) { return target.write(offset, data, len); }
+};
+
+TEST(BitStream, ReadAcrossSpans)
+{
+    // Multi-block buffer; random bit lengths make the reads straddle the block boundaries
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::DynamicTransferBufferManagerEntry dynbuf(pool, 256);
+
+    uint8_t data[200];
+    for (unsigned i = 0; i < sizeof(data); i++)
+    {
+        data[i] = uint8_t(i * 37 + 11);
+    }
+    ASSERT_EQ(int(sizeof(data)), dynbuf.write(0, data, sizeof(data)));
+    ASSERT_LT(1, pool.getNumUsedBlocks());
+
+    NonContiguousBuffer copybuf(dynbuf);
+
+    uavcan::BitStream direct(dynbuf);
+    uavcan::BitStream copied(copybuf);
+
+    unsigned bits_left = sizeof(data) * 8;
+    unsigned seed = 1;
+    while (bits_left > 0)
+    {
+        seed = seed * 1103515245U + 12345U;
+        const unsigned bitlen = std::min(bits_left, 1 + (seed >> 16) % 64);
+
+        uint8_t a[8] = {};
+        uint8_t b[8] = {};
+        ASSERT_EQ(1, direct.read(a, bitlen));
+        ASSERT_EQ(1, copied.read(b, bitlen));
+        ASSERT_TRUE(std::equal(a, a + 8, b)) << "bits left " << bits_left;
+
+        bits_left -= bitlen;
+    }
+
+    uint8_t dummy = 0;
+    ASSERT_EQ(0, direct.read(&dummy, 1));
+    ASSERT_EQ(0, copied.read(&dummy, 1));
+}
+
+static bool getBit(const uint8_t* bytes, unsigned index)
+{
+    return (bytes[index / 8] & (0x80U >> (index % 8))) != 0;
+}
+
+static void setBit(uint8_t* bytes, unsigned index, bool value)
+{
+    if (value)
+    {
+        bytes[index / 8] = uint8_t(bytes[index / 8] | (0x80U >> (index % 8)));
+    }
+}
+
+TEST(BitStream, BitArrayCopyLong)
+{
+    // Long copies are processed word-wise in the middle; the result must match a naive bit-by-bit copy
+    static const unsigned MaxBytes = 40;
+    std::srand(42);
+
+    for (unsigned iter = 0; iter < 2000; iter++)
+    {
+        uint8_t src[MaxBytes + 1];
+        for (unsigned i = 0; i < sizeof(src); i++)
+        {
+            src[i] = uint8_t(std::rand());
+        }
+        const unsigned offset = unsigned(std::rand()) % 8;
+        const unsigned len = unsigned(std::rand()) % (MaxBytes * 8 - 8) + 1;
+
+        uint8_t reference[MaxBytes + 1];
+        uint8_t result[MaxBytes + 1];
+
+        // Aligned to unaligned
+        std::fill(reference, reference + sizeof(reference), uint8_t(0));
+        std::fill(result, result + sizeof(result), uint8_t(0));
+        for (unsigned i = 0; i < len; i++)
+        {
+            setBit(reference, offset + i, getBit(src, i));
+        }
+        uavcan::bitarrayCopyAlignedToUnaligned(src, len, result, offset);
+        ASSERT_TRUE(std::equal(reference, reference + sizeof(reference), result)) << offset << " " << len;
+
+        // Unaligned to aligned
+        std::fill(reference, reference + sizeof(reference), uint8_t(0));
+        std::fill(result, result + sizeof(result), uint8_t(0));
+        for (unsigned i = 0; i < len; i++)
+        {
+            setBit(reference, i, getBit(src, offset + i));
+        }
+        uavcan::bitarrayCopyUnalignedToAligned(src, offset, len, result);
+        ASSERT_TRUE(std::equal(reference, reference + sizeof(reference), result)) << offset << " " << len;
+    }
+}
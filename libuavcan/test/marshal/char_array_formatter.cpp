@@ -2,6 +2,8 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdio>
+#include <limits>
 #include <gtest/gtest.h>
 #include <uavcan/marshal/char_array_formatter.hpp>
 
@@ -77,4 +79,62 @@ TEST(CharArrayFormatter, Hardcore)
     ASSERT_STREQ("%%Test% 1 %* %% %*", f.getArray().c_str());
 }
 
+TEST(CharArrayFormatter, Numbers)
+{
+    typedef Array<IntegerSpec<8, SignednessUnsigned, CastModeSaturate>, ArrayModeDynamic, 90> A8;
+    A8 a;
+
+    CharArrayFormatter<A8> f(a);
+
+    /*
+     * Integers, including the limits
+     */
+    f.write("%i %i %i %i %i", 0, -1, uavcan::int8_t(-128), uavcan::uint8_t(255), -9223372036854775807LL - 1);
+    ASSERT_STREQ("0 -1 -128 255 -9223372036854775808", f.getArray().c_str());
+
+    a.clear();
+    f.write("%i", 18446744073709551615ULL);
+    ASSERT_STREQ("18446744073709551615", f.getArray().c_str());
+
+    /*
+     * Floating point values must be rendered exactly like %g does
+     */
+    static const double Values[] =
+    {
+        0.0, 1.0, -1.0, 0.5, 0.1, 1e-4, 1e-5, 123456.0, 1234567.0, 999999.4, 999999.6, 9.9999951, 0.00012345678,
+        -12.3456, 3.14159265358979, 1e100, -2.5e-300, 1e-320, 65535.0, 100000.0, 1e6, 1.5e15, 12345.678,
+        1000.015, 1000.045, 56712.25, 56712.35     // Ties and near-ties
+    };
+
+    for (unsigned i = 0; i < sizeof(Values) / sizeof(Values[0]); i++)
+    {
+        char reference[32];
+        (void)std::snprintf(reference, sizeof(reference), "%g", Values[i]);
+
+        a.clear();
+        f.write("%g", Values[i]);
+        ASSERT_STREQ(reference, f.getArray().c_str());
+
+        a.clear();
+        f.write("%g", float(Values[i]));
+        (void)std::snprintf(reference, sizeof(reference), "%g", double(float(Values[i])));
+        ASSERT_STREQ(reference, f.getArray().c_str());
+    }
+
+    a.clear();
+    f.write("%g %g", std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity());
+    ASSERT_STREQ("inf -inf", f.getArray().c_str());
+
+    a.clear();
+    f.write("%g", std::numeric_limits<double>::quiet_NaN());
+    ASSERT_STREQ("nan", f.getArray().c_str());
+
+    /*
+     * Null string
+     */
+    a.clear();
+    f.write("%s", static_cast<const char*>(NULL));
+    ASSERT_STREQ("(null)", f.getArray().c_str());
+}
+
 #endif
@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 #include <limits>
+#include <algorithm>
 #include <uavcan/marshal/types.hpp>
 #include <uavcan/transport/transfer_buffer.hpp>
 
@@ -182,3 +183,88 @@ TEST(FloatSpec, Float16Representation)
 
     ASSERT_EQ(Reference, bs_wr.toString());
 }
+
+TEST(FloatSpec, Float16Array)
+{
+    using uavcan::FloatSpec;
+    using uavcan::CastModeSaturate;
+    using uavcan::CastModeTruncate;
+    using uavcan::Array;
+    using uavcan::ArrayModeStatic;
+
+    typedef FloatSpec<16, CastModeSaturate> F16S;
+    typedef FloatSpec<16, CastModeTruncate> F16T;
+
+    uavcan::StaticAssert<uavcan::IsBulkConvertible<F16S>::Result>::check();
+    uavcan::StaticAssert<!uavcan::IsBulkConvertible<FloatSpec<32, CastModeSaturate> >::Result>::check();
+
+    /*
+     * Long enough to span several chunks, the size is not a multiple of the chunk size
+     */
+    Array<F16S, ArrayModeStatic, 37> saturated;
+    Array<F16T, ArrayModeStatic, 37> truncated;
+    for (uint8_t i = 0; i < saturated.size(); i++)
+    {
+        saturated[i] = truncated[i] = (float(i) - 18.0F) * 1234.567F + 0.001F;
+    }
+    saturated[0] = truncated[0] = std::numeric_limits<float>::quiet_NaN();
+    saturated[1] = truncated[1] = -std::numeric_limits<float>::infinity();
+    saturated[2] = truncated[2] = 1e-6F;                                    // Subnormal
+    saturated[3] = truncated[3] = -0.0F;
+    saturated[4] = truncated[4] = 999999.0F;                                // Out of range
+
+    uavcan::StaticTransferBuffer<2 * 37 * 2> buf_array;
+    uavcan::StaticTransferBuffer<2 * 37 * 2> buf_elements;
+    {
+        uavcan::BitStream bs(buf_array);
+        uavcan::ScalarCodec sc(bs);
+        ASSERT_EQ(1, saturated.encode(saturated, sc, uavcan::TailArrayOptDisabled));
+        ASSERT_EQ(1, truncated.encode(truncated, sc, uavcan::TailArrayOptDisabled));
+    }
+    {
+        uavcan::BitStream bs(buf_elements);
+        uavcan::ScalarCodec sc(bs);
+        for (uint8_t i = 0; i < saturated.size(); i++)
+        {
+            ASSERT_EQ(1, F16S::encode(saturated[i], sc, uavcan::TailArrayOptDisabled));
+        }
+        for (uint8_t i = 0; i < truncated.size(); i++)
+        {
+            ASSERT_EQ(1, F16T::encode(truncated[i], sc, uavcan::TailArrayOptDisabled));
+        }
+    }
+    ASSERT_TRUE(std::equal(buf_array.getRawPtr(), buf_array.getRawPtr() + buf_array.getMaxWritePos(),
+                           buf_elements.getRawPtr()));
+    ASSERT_EQ(buf_elements.getMaxWritePos(), buf_array.getMaxWritePos());
+
+    /*
+     * Decoding
+     */
+    uavcan::BitStream bs_array(buf_array);
+    uavcan::ScalarCodec sc_array(bs_array);
+    uavcan::BitStream bs_elements(buf_elements);
+    uavcan::ScalarCodec sc_elements(bs_elements);
+
+    Array<F16S, ArrayModeStatic, 37> decoded;
+    ASSERT_EQ(1, decoded.decode(decoded, sc_array, uavcan::TailArrayOptDisabled));
+    for (uint8_t i = 0; i < decoded.size(); i++)
+    {
+        float value = 0.0F;
+        ASSERT_EQ(1, F16S::decode(value, sc_elements, uavcan::TailArrayOptDisabled));
+        if (i == 0)
+        {
+            ASSERT_TRUE(uavcan::isNaN(value));
+            ASSERT_TRUE(uavcan::isNaN(float(decoded[i])));
+        }
+        else
+        {
+            ASSERT_FLOAT_EQ(value, decoded[i]);
+        }
+    }
+    ASSERT_FLOAT_EQ(65504.0F, decoded[4]);
+
+    // Not enough data
+    Array<F16S, ArrayModeStatic, 37> too_long;
+    ASSERT_EQ(1, too_long.decode(too_long, sc_array, uavcan::TailArrayOptDisabled));     // The truncated half is still there
+    ASSERT_EQ(0, too_long.decode(too_long, sc_array, uavcan::TailArrayOptDisabled));
+}
@@ -96,3 +96,123 @@ TEST(ScalarCodec, RepresentationCorrectness)
     static const std::string REFERENCE = "11011010 11101111 01111100 00000000";
     ASSERT_EQ(REFERENCE, bs_wr.toString());
 }
+
+TEST(ScalarCodec, ByteAligned)
+{
+    uavcan::StaticTransferBuffer<17> buf;
+    uavcan::BitStream bs_wr(buf);
+    uavcan::ScalarCodec sc_wr(bs_wr);
+
+    // Aligned fields take the fast path, the 4-bit fields break the alignment and then restore it
+    ASSERT_EQ(1, sc_wr.encode<16>((uint16_t)0x1234));
+    ASSERT_EQ(1, sc_wr.encode<4>((uint8_t)0xA));
+    ASSERT_EQ(1, sc_wr.encode<8>((uint8_t)0xBC));       // Unaligned
+    ASSERT_EQ(1, sc_wr.encode<4>((uint8_t)0xD));
+    ASSERT_EQ(1, sc_wr.encode<24>((int32_t)-2));
+    ASSERT_EQ(1, sc_wr.encode<64>((uint64_t)0x0123456789ABCDEFULL));
+    ASSERT_EQ(0, sc_wr.encode<32>((uint32_t)0));        // Out of buffer space - 15 bytes written, 2 left
+
+    // Byte order is the same as in the generic path
+    static const std::string REFERENCE =
+        "00110100 00010010 10101011 11001101 11111110 11111111 11111111 "
+        "11101111 11001101 10101011 10001001 01100111 01000101 00100011 00000001";
+    ASSERT_EQ(REFERENCE, bs_wr.toString().substr(0, REFERENCE.length()));
+
+    uavcan::BitStream bs_rd(buf);
+    uavcan::ScalarCodec sc_rd(bs_rd);
+
+    uint16_t u16 = 0;
+    uint8_t u8 = 0;
+    int32_t i32 = 0;
+    uint64_t u64 = 0;
+    ASSERT_EQ(1, sc_rd.decode<16>(u16));
+    ASSERT_EQ(0x1234, u16);
+    ASSERT_EQ(1, sc_rd.decode<4>(u8));
+    ASSERT_EQ(0xA, u8);
+    ASSERT_EQ(1, sc_rd.decode<8>(u8));
+    ASSERT_EQ(0xBC, u8);
+    ASSERT_EQ(1, sc_rd.decode<4>(u8));
+    ASSERT_EQ(0xD, u8);
+    ASSERT_EQ(1, sc_rd.decode<24>(i32));
+    ASSERT_EQ(-2, i32);
+    ASSERT_EQ(1, sc_rd.decode<64>(u64));
+    ASSERT_EQ(0x0123456789ABCDEFULL, u64);
+    ASSERT_EQ(0, sc_rd.decode<32>(u64));                // Out of buffer space
+}
+
+TEST(ScalarCodec, PackUnpack)
+{
+    /*
+     * Packed fields and a bit array written at once must produce the same stream as sequential encoding.
+     * The leading bit makes the stream unaligned, which splits the bit array into several writes.
+     */
+    for (unsigned lead = 0; lead < 2; lead++)
+    {
+        uavcan::StaticTransferBuffer<40> ref_buf;
+        uavcan::BitStream ref_bs_wr(ref_buf);
+        uavcan::ScalarCodec ref_sc_wr(ref_bs_wr);
+        if (lead > 0)
+        {
+            ASSERT_EQ(1, ref_sc_wr.encode<1>(true));
+        }
+        ASSERT_EQ(1, ref_sc_wr.encode<3>((uint8_t)5));
+        ASSERT_EQ(1, ref_sc_wr.encode<12>((int16_t)-1234));
+        ASSERT_EQ(1, ref_sc_wr.encode<1>(true));
+        ASSERT_EQ(1, ref_sc_wr.encode<64>((uint64_t)0xFEDCBA9876543210ULL));
+        ASSERT_EQ(1, ref_sc_wr.encode<29>((int32_t)-123456789));
+        ASSERT_EQ(1, ref_sc_wr.encode<64>((int64_t)-2));
+        ASSERT_EQ(1, ref_sc_wr.encode<8>((uint8_t)0xA5));
+
+        enum { TotalBitLen = 3 + 12 + 1 + 64 + 29 + 64 + 8 };
+        uint8_t packed[(TotalBitLen + 7) / 8] = { 0 };
+        uavcan::ScalarCodec::pack<0, 3>(packed, (uint8_t)5);
+        uavcan::ScalarCodec::pack<3, 12>(packed, (int16_t)-1234);
+        uavcan::ScalarCodec::pack<15, 1>(packed, true);
+        uavcan::ScalarCodec::pack<16, 64>(packed, (uint64_t)0xFEDCBA9876543210ULL);
+        uavcan::ScalarCodec::pack<80, 29>(packed, (int32_t)-123456789);
+        uavcan::ScalarCodec::pack<109, 64>(packed, (int64_t)-2);
+        uavcan::ScalarCodec::pack<173, 8>(packed, (uint8_t)0xA5);
+
+        uavcan::StaticTransferBuffer<40> buf;
+        uavcan::BitStream bs_wr(buf);
+        uavcan::ScalarCodec sc_wr(bs_wr);
+        if (lead > 0)
+        {
+            ASSERT_EQ(1, sc_wr.encode<1>(true));
+        }
+        ASSERT_EQ(1, sc_wr.encodeBitArray(packed, TotalBitLen));
+        ASSERT_EQ(ref_bs_wr.toString(), bs_wr.toString());
+
+        uavcan::BitStream bs_rd(buf);
+        uavcan::ScalarCodec sc_rd(bs_rd);
+        bool b = false;
+        if (lead > 0)
+        {
+            ASSERT_EQ(1, sc_rd.decode<1>(b));
+        }
+        uint8_t unpacked[sizeof(packed)];
+        ASSERT_EQ(1, sc_rd.decodeBitArray(unpacked, TotalBitLen));
+
+        uint8_t u8 = 0;
+        int16_t i16 = 0;
+        uint64_t u64 = 0;
+        int32_t i32 = 0;
+        int64_t i64 = 0;
+        uavcan::ScalarCodec::unpack<0, 3>(unpacked, u8);
+        ASSERT_EQ(5, u8);
+        uavcan::ScalarCodec::unpack<3, 12>(unpacked, i16);
+        ASSERT_EQ(-1234, i16);
+        uavcan::ScalarCodec::unpack<15, 1>(unpacked, b);
+        ASSERT_TRUE(b);
+        uavcan::ScalarCodec::unpack<16, 64>(unpacked, u64);
+        ASSERT_EQ(0xFEDCBA9876543210ULL, u64);
+        uavcan::ScalarCodec::unpack<80, 29>(unpacked, i32);
+        ASSERT_EQ(-123456789, i32);
+        uavcan::ScalarCodec::unpack<109, 64>(unpacked, i64);
+        ASSERT_EQ(-2, i64);
+        uavcan::ScalarCodec::unpack<173, 8>(unpacked, u8);
+        ASSERT_EQ(0xA5, u8);
+
+        ASSERT_EQ(0, sc_rd.decodeBitArray(unpacked, 100));   // Out of buffer space
+    }
+}
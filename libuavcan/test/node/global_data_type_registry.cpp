@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdio>
 #include <gtest/gtest.h>
 #include <uavcan/node/global_data_type_registry.hpp>
 
@@ -48,6 +49,36 @@ struct DataTypeD
     static const char* getDataTypeFullName() { return "foo.DataTypeD"; }
 };
 
+/// Every third type is a service
+inline uint16_t getManyDataTypesID(int n) { return uint16_t((n % 3 == 0) ? (n * 4) : ((n * 37) % 1000)); }
+
+template <int N>
+struct ManyDataTypes
+{
+    enum { DefaultDataTypeID = (N % 3 == 0) ? (N * 4) : ((N * 37) % 1000) };
+    enum { DataTypeKind = (N % 3 == 0) ? uavcan::DataTypeKindService : uavcan::DataTypeKindMessage };
+    static uavcan::DataTypeSignature getDataTypeSignature() { return uavcan::DataTypeSignature(N); }
+    static const char* getDataTypeFullName()
+    {
+        static char name[32];
+        (void)std::snprintf(name, sizeof(name), "many.Type%i", N);
+        return name;
+    }
+
+    static void registerAll()
+    {
+        ManyDataTypes<N - 1>::registerAll();
+        ASSERT_EQ(uavcan::GlobalDataTypeRegistry::RegistrationResultOk,
+                  uavcan::GlobalDataTypeRegistry::instance().registerDataType<ManyDataTypes>(DefaultDataTypeID));
+    }
+};
+
+template <>
+struct ManyDataTypes<0>
+{
+    static void registerAll() { }
+};
+
 template <typename Type>
 uavcan::DataTypeDescriptor extractDescriptor(uint16_t dtid = Type::DefaultDataTypeID)
 {
@@ -155,6 +186,148 @@ TEST(GlobalDataTypeRegistry, Basic)
 }
 
 
+TEST(GlobalDataTypeRegistry, FrozenIndex)
+{
+    using uavcan::GlobalDataTypeRegistry;
+    using uavcan::DataTypeKind;
+    using uavcan::DataTypeKindMessage;
+    using uavcan::DataTypeKindService;
+
+    GlobalDataTypeRegistry& reg = GlobalDataTypeRegistry::instance();
+    const bool was_frozen = reg.isFrozen();
+    reg.reset();
+
+    enum { NumTypes = 60 };
+    ManyDataTypes<NumTypes>::registerAll();
+    ASSERT_EQ(40, reg.getNumMessageTypes());
+    ASSERT_EQ(20, reg.getNumServiceTypes());
+
+    /*
+     * The lookups must yield the same results before and after freezing, whether the index is used or not
+     */
+    const uavcan::DataTypeDescriptor* by_name[NumTypes + 1] = {};
+    const uavcan::DataTypeDescriptor* by_id[NumTypes + 1] = {};
+    for (int n = 1; n <= NumTypes; n++)
+    {
+        const DataTypeKind kind = (n % 3 == 0) ? DataTypeKindService : DataTypeKindMessage;
+        char name[32];
+        (void)std::snprintf(name, sizeof(name), "many.Type%i", n);
+        by_name[n] = reg.find(kind, name);
+        by_id[n] = reg.find(kind, uavcan::DataTypeID(getManyDataTypesID(n)));
+        ASSERT_TRUE(by_name[n]);
+        ASSERT_EQ(by_name[n], by_id[n]);
+        ASSERT_EQ(uavcan::DataTypeSignature(uint64_t(n)), by_name[n]->getSignature());
+    }
+
+    reg.freeze();
+
+    for (int n = 1; n <= NumTypes; n++)
+    {
+        const DataTypeKind kind = (n % 3 == 0) ? DataTypeKindService : DataTypeKindMessage;
+        const DataTypeKind other_kind = (kind == DataTypeKindService) ? DataTypeKindMessage : DataTypeKindService;
+        char name[32];
+        (void)std::snprintf(name, sizeof(name), "many.Type%i", n);
+        const uavcan::DataTypeID dtid(getManyDataTypesID(n));
+        ASSERT_EQ(by_name[n], reg.find(kind, name));
+        ASSERT_EQ(by_name[n], reg.find(name));
+        ASSERT_EQ(by_id[n], reg.find(kind, dtid));
+        ASSERT_FALSE(reg.find(other_kind, name));
+    }
+
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, "many.Type0"));
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, "many.Type"));
+    ASSERT_FALSE(reg.find(""));
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, uavcan::DataTypeID(998)));
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, uavcan::DataTypeID()));
+    ASSERT_FALSE(reg.find(DataTypeKindService, uavcan::DataTypeID(3)));
+
+    reg.reset();
+    if (was_frozen)
+    {
+        reg.freeze();           // The next test expects the registry to be frozen
+    }
+}
+
+
+TEST(GlobalDataTypeRegistry, Table)
+{
+    using uavcan::GlobalDataTypeRegistry;
+    using uavcan::DataTypeDescriptor;
+    using uavcan::DataTypeKindMessage;
+    using uavcan::DataTypeKindService;
+    using uavcan::DataTypeSignature;
+
+    GlobalDataTypeRegistry& reg = GlobalDataTypeRegistry::instance();
+    const bool was_frozen = reg.isFrozen();
+    reg.reset();
+
+    // Same layout as generated by the DSDL compiler - ordered by kind, then by ID
+    static const DataTypeDescriptor table[] =
+    {
+        DataTypeDescriptor(DataTypeKindService, 0, DataTypeSignature(789), "my_namespace.DataTypeA"),
+        DataTypeDescriptor(DataTypeKindService, 43, DataTypeSignature(987), "foo.DataTypeD"),
+        DataTypeDescriptor(DataTypeKindMessage, 0, DataTypeSignature(123), "my_namespace.DataTypeA"),
+        DataTypeDescriptor(DataTypeKindMessage, 42, DataTypeSignature(456), "my_namespace.DataTypeB"),
+        DataTypeDescriptor(DataTypeKindMessage, 1023, DataTypeSignature(654), "foo.DataTypeC")
+    };
+    const unsigned table_size = sizeof(table) / sizeof(table[0]);
+
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultInvalidParams, reg.adoptDataTypeTable(NULL, 0));
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk, reg.adoptDataTypeTable(table, table_size));
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk, reg.adoptDataTypeTable(table, table_size));
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultCollision, reg.adoptDataTypeTable(table, 2));
+
+    ASSERT_EQ(3, reg.getNumMessageTypes());
+    ASSERT_EQ(2, reg.getNumServiceTypes());
+
+    ASSERT_EQ(&table[3], reg.find(DataTypeKindMessage, "my_namespace.DataTypeB"));
+    ASSERT_EQ(&table[3], reg.find(DataTypeKindMessage, 42));
+    ASSERT_EQ(&table[1], reg.find("foo.DataTypeD"));
+    ASSERT_EQ(&table[0], reg.find(DataTypeKindService, uavcan::DataTypeID(0)));
+    ASSERT_FALSE(reg.find(DataTypeKindService, 42));
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, "foo.DataTypeD"));
+
+    /*
+     * Run time registrations take precedence over the table
+     */
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultCollision,
+              reg.registerDataType<DataTypeD>(0));                                  // ID of DataTypeA service
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk, reg.registerDataType<DataTypeB>(741));
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultOk, reg.registerDataType<DataTypeC>(42));  // Freed by B
+
+    ASSERT_EQ(3, reg.getNumMessageTypes());
+    ASSERT_EQ(2, reg.getNumServiceTypes());
+    ASSERT_EQ(extractDescriptor<DataTypeB>(741), *reg.find(DataTypeKindMessage, "my_namespace.DataTypeB"));
+    ASSERT_EQ(extractDescriptor<DataTypeC>(42), *reg.find(DataTypeKindMessage, 42));
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, 1023));                              // Overridden
+
+    /*
+     * The same results with the index
+     */
+    reg.freeze();
+    ASSERT_EQ(GlobalDataTypeRegistry::RegistrationResultFrozen, reg.adoptDataTypeTable(table, table_size));
+
+    ASSERT_EQ(3, reg.getNumMessageTypes());
+    ASSERT_EQ(2, reg.getNumServiceTypes());
+    ASSERT_EQ(&table[2], reg.find(DataTypeKindMessage, uavcan::DataTypeID(0)));
+    ASSERT_EQ(extractDescriptor<DataTypeB>(741), *reg.find(DataTypeKindMessage, "my_namespace.DataTypeB"));
+    ASSERT_EQ(extractDescriptor<DataTypeB>(741), *reg.find(DataTypeKindMessage, 741));
+    ASSERT_EQ(extractDescriptor<DataTypeC>(42), *reg.find(DataTypeKindMessage, 42));
+    ASSERT_EQ(extractDescriptor<DataTypeC>(42), *reg.find("foo.DataTypeC"));
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, 1023));
+    ASSERT_EQ(&table[1], reg.find(DataTypeKindService, 43));
+    ASSERT_EQ(&table[0], reg.find(DataTypeKindService, "my_namespace.DataTypeA"));
+
+    reg.reset();
+    ASSERT_EQ(0, reg.getNumMessageTypes());
+    ASSERT_FALSE(reg.find(DataTypeKindMessage, uavcan::DataTypeID(0)));
+    if (was_frozen)
+    {
+        reg.freeze();
+    }
+}
+
+
 TEST(GlobalDataTypeRegistry, Reset)
 {
     using uavcan::GlobalDataTypeRegistry;
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/lazy_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+struct LazySubscriptionListener
+{
+    typedef uavcan::LazyReceivedDataStructure<root_ns_a::MavlinkMessage> LazyMessage;
+    typedef uavcan::MethodBinder<LazySubscriptionListener*,
+                                 void (LazySubscriptionListener::*)(const LazyMessage&)> Binder;
+
+    uavcan::uint8_t wanted_msgid;
+    std::vector<root_ns_a::MavlinkMessage> accepted;
+    std::vector<uavcan::NodeID> src_node_ids;
+    unsigned num_skipped;
+
+    LazySubscriptionListener() : wanted_msgid(0), num_skipped(0) { }
+
+    void receive(const LazyMessage& msg)
+    {
+        src_node_ids.push_back(msg.getSrcNodeID());
+
+        // The fourth field, uint8 msgid, is at the bit offset 24
+        uavcan::uint8_t msgid = 0;
+        ASSERT_LT(0, (msg.decodeField<uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeSaturate> >
+                      (24, msgid)));
+        if (msgid != wanted_msgid)
+        {
+            num_skipped++;
+            return;
+        }
+
+        root_ns_a::MavlinkMessage full;
+        ASSERT_LT(0, msg.decode(full));
+        accepted.push_back(full);
+    }
+
+    Binder bind() { return Binder(this, &LazySubscriptionListener::receive); }
+};
+
+
+TEST(LazySubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(2, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    LazySubscriptionListener listener;
+    listener.wanted_msgid = 0xa5;
+
+    uavcan::LazySubscriber<root_ns_a::MavlinkMessage, LazySubscriptionListener::Binder> sub(node);
+
+    std::cout <<
+        "sizeof(uavcan::LazySubscriber<root_ns_a::MavlinkMessage, LazySubscriptionListener::Binder>): " <<
+        sizeof(uavcan::LazySubscriber<root_ns_a::MavlinkMessage, LazySubscriptionListener::Binder>) << std::endl;
+
+    /*
+     * Message layout:
+     * uint8 seq
+     * uint8 sysid
+     * uint8 compid
+     * uint8 msgid
+     * uint8[<256] payload
+     */
+    root_ns_a::MavlinkMessage expected_msg;
+    expected_msg.seq = 0x42;
+    expected_msg.sysid = 0x72;
+    expected_msg.compid = 0x08;
+    expected_msg.msgid = 0xa5;
+    expected_msg.payload = "Msg";
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        // Every other message has a different msgid and is going to be skipped without decoding
+        const uint8_t transfer_payload[] = {0x42, 0x72, 0x08, uint8_t((i % 2 == 0) ? 0xa5 : 0x10), 'M', 's', 'g'};
+
+        uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                            uavcan::NodeID(uint8_t(i + 100)), uavcan::NodeID::Broadcast, i);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPayload(transfer_payload, 7);
+        uavcan::RxFrame rx_frame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0);
+        can_driver.ifaces[0].pushRx(rx_frame);
+        can_driver.ifaces[1].pushRx(rx_frame);
+    }
+
+    ASSERT_EQ(0, sub.start(listener.bind()));
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(4, listener.src_node_ids.size());
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(uavcan::NodeID(uint8_t(i + 100)), listener.src_node_ids[i]);
+    }
+    ASSERT_EQ(2, listener.num_skipped);
+    ASSERT_EQ(2, listener.accepted.size());
+    ASSERT_TRUE(listener.accepted[0] == expected_msg);
+    ASSERT_TRUE(listener.accepted[1] == expected_msg);
+
+    ASSERT_EQ(0, sub.getFailureCount());
+    sub.registerFailure();
+    ASSERT_EQ(1, sub.getFailureCount());
+
+    sub.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/memory_budget.hpp>
+#include "test_node.hpp"
+
+namespace
+{
+
+struct SingleFrameType
+{
+    enum { MaxBitLen = 56 };
+    enum { IsSingleFrame = 1 };
+};
+
+struct MultiFrameType
+{
+    enum { MaxBitLen = 300 * 8 };
+    enum { IsSingleFrame = 0 };
+};
+
+struct ServiceType
+{
+    typedef MultiFrameType Request;
+    typedef MultiFrameType Response;
+};
+
+template <unsigned N, unsigned D>
+struct DivRoundUp
+{
+    enum { Result = (N + D - 1) / D };
+};
+
+}
+
+TEST(MemoryBudget, Components)
+{
+    enum { KV = uavcan::MapBase<uavcan::TransferBufferManagerKey, uavcan::TransferReceiver>::NumKVPerPoolBlock };
+    enum { BufferBlockSize = uavcan::DynamicTransferBufferManagerEntry::NumBytesPerPoolBlock };
+    enum { BlocksPerBuffer = 1 + DivRoundUp<300, BufferBlockSize>::Result };
+    ASSERT_LT(0, int(KV));
+
+    // Static storage is enough
+    ASSERT_EQ(0, (uavcan::SubscriberMemoryBudget<SingleFrameType, 2>::NumTransferReceiverBlocks));
+    ASSERT_EQ(0, (uavcan::SubscriberMemoryBudget<MultiFrameType, 1>::NumTransferReceiverBlocks));
+
+    // Single-frame types never need buffers
+    ASSERT_EQ(int(DivRoundUp<8, KV>::Result),
+              (uavcan::SubscriberMemoryBudget<SingleFrameType, 10>::NumTransferReceiverBlocks));
+    ASSERT_EQ(int(DivRoundUp<10, KV>::Result),
+              (uavcan::SubscriberMemoryBudget<SingleFrameType, 10, 0, 0>::NumTransferReceiverBlocks));
+
+    // Multi-frame: one dynamic receiver and two dynamic buffers
+    ASSERT_EQ(1 + 2 * int(BlocksPerBuffer),
+              (uavcan::SubscriberMemoryBudget<MultiFrameType, 3>::NumTransferReceiverBlocks));
+    ASSERT_EQ(0, (uavcan::SubscriberMemoryBudget<MultiFrameType, 3, 3, 3>::NumTransferReceiverBlocks));
+
+    ASSERT_EQ(1, (uavcan::PublisherMemoryBudget<>::NumOutgoingTransferEntries));
+    ASSERT_EQ(0, (uavcan::PublisherMemoryBudget<>::NumTransferReceiverBlocks));
+
+    ASSERT_EQ(int(DivRoundUp<2, KV>::Result) + 3 * int(BlocksPerBuffer),
+              (uavcan::ServiceServerMemoryBudget<ServiceType, 4>::NumTransferReceiverBlocks));
+    ASSERT_EQ(0, (uavcan::ServiceServerMemoryBudget<ServiceType, 4>::NumOutgoingTransferEntries));
+
+    // Five calls to three servers; one call and one server fit the static storage
+    typedef uavcan::ServiceClientMemoryBudget<ServiceType, 5, 3> ClientBudget;
+    ASSERT_EQ(int(DivRoundUp<2, KV>::Result) + 2 * int(BlocksPerBuffer), int(ClientBudget::NumTransferReceiverBlocks));
+    ASSERT_EQ(4, ClientBudget::NumServiceCallBlocks);
+    ASSERT_EQ(3, ClientBudget::NumOutgoingTransferEntries);
+}
+
+TEST(MemoryBudget, Calculator)
+{
+    uavcan::MemoryBudget budget(2, 4);
+    ASSERT_EQ(1, budget.getTotalNumBlocks());                  // Never zero
+    ASSERT_EQ(uavcan::MemPoolBlockSize, budget.getRecommendedPoolSize());
+
+    budget.add<uavcan::SubscriberMemoryBudget<MultiFrameType, 3> >(2);
+    budget.add<uavcan::PublisherMemoryBudget<> >(7);
+    budget.add<uavcan::ServiceClientMemoryBudget<ServiceType, 5, 3> >();
+    budget.addBlocks(uavcan::MemoryConsumerOther, 3);
+
+    const uint32_t receivers = 2 * uavcan::SubscriberMemoryBudget<MultiFrameType, 3>::NumTransferReceiverBlocks +
+        uavcan::ServiceClientMemoryBudget<ServiceType, 5, 3>::NumTransferReceiverBlocks;
+    ASSERT_EQ(receivers, budget.getNumBlocks(uavcan::MemoryConsumerTransferReceivers));
+    ASSERT_EQ(4, budget.getNumBlocks(uavcan::MemoryConsumerServiceCalls));
+    ASSERT_EQ(2, budget.getNumBlocks(uavcan::MemoryConsumerOutgoingTransferRegistry));    // (7 + 3 - 2) / 4
+    ASSERT_EQ(3, budget.getNumBlocks(uavcan::MemoryConsumerOther));
+    ASSERT_EQ(0, budget.getNumBlocks(uavcan::MemoryConsumerCanTxQueue));
+    ASSERT_EQ(0, budget.getNumBlocks(uavcan::NumMemoryConsumers));
+
+    const uint32_t total = receivers + 4 + 2 + 3;
+    ASSERT_EQ(total, budget.getTotalNumBlocks());
+
+    // The TX queues are added to the total
+    budget.addCanTxQueue(2, 5);
+    ASSERT_EQ(10, budget.getNumBlocks(uavcan::MemoryConsumerCanTxQueue));
+    ASSERT_EQ(total + 10, budget.getTotalNumBlocks());
+    ASSERT_EQ((total + 10) * uavcan::MemPoolBlockSize, budget.getRecommendedPoolSize());
+
+    // The pool must be large enough for the default TX queue quota to reach the budget
+    budget.addCanTxQueue(2, 1000);
+    ASSERT_EQ(999 * 3, budget.getTotalNumBlocks());
+}
+
+TEST(MemoryBudget, Node)
+{
+    SystemClockDriver clock;
+    PairableCanDriver can(clock);
+    TestNode node(can, clock, 1);
+
+    uavcan::MemoryBudget budget;
+    budget.add<uavcan::ServiceClientMemoryBudget<ServiceType, 3> >();
+    ASSERT_EQ(2, budget.getNumBlocks(uavcan::MemoryConsumerServiceCalls));
+
+    ASSERT_EQ(0, budget.applyQuotas(node));
+    ASSERT_EQ(2, node.memory_usage.get(uavcan::MemoryConsumerServiceCalls).getQuota());
+    ASSERT_EQ(0xFFFF, node.memory_usage.get(uavcan::MemoryConsumerOther).getQuota());    // Not accounted for
+    ASSERT_EQ(0xFFFF, node.memory_usage.get(uavcan::MemoryConsumerCanTxQueue).getQuota());
+
+    ASSERT_EQ(uavcan::NumMemoryConsumers, budget.findConsumerOverBudget(node));
+
+    // Within the budget
+    uavcan::IPoolAllocator& calls = node.getAllocatorFor(uavcan::MemoryConsumerServiceCalls);
+    void* a = calls.allocate(8);
+    void* b = calls.allocate(8);
+    ASSERT_TRUE(a && b);
+    ASSERT_FALSE(calls.allocate(8));                            // Quota
+    ASSERT_EQ(uavcan::NumMemoryConsumers, budget.findConsumerOverBudget(node));
+    calls.deallocate(a);
+    calls.deallocate(b);
+
+    // Unaccounted consumers are only checked in the strict mode
+    uavcan::IPoolAllocator& other = node.getAllocatorFor(uavcan::MemoryConsumerOther);
+    void* c = other.allocate(8);
+    ASSERT_TRUE(c);
+    other.deallocate(c);
+    ASSERT_EQ(uavcan::NumMemoryConsumers, budget.findConsumerOverBudget(node));
+    ASSERT_EQ(uavcan::MemoryConsumerOther, budget.findConsumerOverBudget(node, true));
+
+    // The budget was wrong
+    uavcan::MemoryBudget small_budget;
+    small_budget.add<uavcan::ServiceClientMemoryBudget<ServiceType, 2> >();
+    ASSERT_EQ(uavcan::MemoryConsumerServiceCalls, small_budget.findConsumerOverBudget(node));
+}
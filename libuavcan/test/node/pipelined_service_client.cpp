@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/pipelined_service_client.hpp>
+#include <uavcan/node/service_server.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <root_ns_a/StringService.hpp>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "test_node.hpp"
+
+
+/**
+ * Drops the configured number of first attempts of every request.
+ */
+struct LossyStringServer
+{
+    std::map<std::string, int> num_drops;
+    std::map<std::string, int> num_requests;
+
+    typedef uavcan::MethodBinder<LossyStringServer*,
+        void (LossyStringServer::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                                    uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>&)>
+        Binder;
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& req,
+                       uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& rsp)
+    {
+        const std::string key(req.string_request.c_str());
+        rsp.string_response = req.string_request;
+        if (num_requests[key]++ < num_drops[key])
+        {
+            rsp.setResponseEnabled(false);
+        }
+    }
+
+    Binder bind() { return Binder(this, &LossyStringServer::handleRequest); }
+};
+
+static std::string toString(int x)
+{
+    std::ostringstream os;
+    os << x;
+    return os.str();
+}
+
+struct PipelineResult
+{
+    std::string request;
+    std::string response;
+    bool success;
+    int num_attempts;
+};
+
+/**
+ * Collects the results and refills the window from the callback until the configured number of requests is sent.
+ */
+struct PipelineHandler
+{
+    typedef uavcan::PipelinedServiceCallResult<root_ns_a::StringService> ResultType;
+    typedef uavcan::MethodBinder<PipelineHandler*, void (PipelineHandler::*)(const ResultType&)> Binder;
+
+    template <unsigned WindowSize>
+    struct Client
+    {
+        typedef uavcan::PipelinedServiceClient<root_ns_a::StringService, WindowSize, Binder> Type;
+    };
+
+    std::vector<PipelineResult> results;
+    int next_request;
+    int num_requests;
+    uavcan::PipelinedServiceClient<root_ns_a::StringService, 4, Binder>* client;
+
+    PipelineHandler()
+        : next_request(0)
+        , num_requests(0)
+        , client(NULL)
+    { }
+
+    root_ns_a::StringService::Request makeNextRequest()
+    {
+        root_ns_a::StringService::Request req;
+        req.string_request = toString(next_request++).c_str();
+        return req;
+    }
+
+    void handleResult(const ResultType& result)
+    {
+        PipelineResult r;
+        r.request = result.getRequest().string_request.c_str();
+        r.response = result.getResponse().string_response.c_str();
+        r.success = result.isSuccessful();
+        r.num_attempts = result.getNumAttempts();
+        results.push_back(r);
+
+        if ((client != NULL) && (next_request < num_requests))
+        {
+            ASSERT_EQ(0, client->submit(makeNextRequest()));
+        }
+    }
+
+    Binder bind() { return Binder(this, &PipelineHandler::handleResult); }
+};
+
+
+TEST(PipelinedServiceClient, OrderedCompletion)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    LossyStringServer server_logic;
+    server_logic.num_drops["3"] = 1;     // Succeeds on the second attempt, after the responses to 4, 5 and 6
+    server_logic.num_drops["7"] = 100;   // Never succeeds
+
+    uavcan::ServiceServer<root_ns_a::StringService, LossyStringServer::Binder> server(nodes.a);
+    ASSERT_EQ(0, server.start(server_logic.bind()));
+
+    PipelineHandler handler;
+    handler.num_requests = 10;
+
+    PipelineHandler::Client<4>::Type client(nodes.b);
+    client.setMaxAttempts(2);
+    client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(50));
+
+    root_ns_a::StringService::Request request;
+    ASSERT_EQ(-uavcan::ErrNotInited, client.submit(request));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, client.init(uavcan::NodeID::Broadcast));
+    ASSERT_LE(0, client.init(1));
+    ASSERT_EQ(-uavcan::ErrInvalidConfiguration, client.submit(request));
+
+    handler.client = &client;
+    client.setCallback(handler.bind());
+
+    while (!client.isWindowFull())
+    {
+        ASSERT_EQ(0, client.submit(handler.makeNextRequest()));
+    }
+    ASSERT_EQ(4, handler.next_request);
+    ASSERT_EQ(4, client.getNumOutstanding());
+    ASSERT_EQ(-uavcan::ErrLogic, client.submit(request));
+
+    for (int i = 0; (i < 100) && !client.isIdle(); i++)
+    {
+        ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10)));
+    }
+    ASSERT_TRUE(client.isIdle());
+    ASSERT_EQ(10, handler.next_request);
+
+    const std::vector<PipelineResult>& results = handler.results;
+    ASSERT_EQ(10, int(results.size()));
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(toString(i), results[unsigned(i)].request);
+        if (i == 7)
+        {
+            EXPECT_FALSE(results[unsigned(i)].success);
+            EXPECT_EQ(2, results[unsigned(i)].num_attempts);
+        }
+        else
+        {
+            EXPECT_TRUE(results[unsigned(i)].success);
+            EXPECT_EQ(toString(i), results[unsigned(i)].response);
+            EXPECT_EQ((i == 3) ? 2 : 1, results[unsigned(i)].num_attempts);
+        }
+    }
+
+    EXPECT_EQ(2, server_logic.num_requests["3"]);
+    EXPECT_EQ(2, server_logic.num_requests["7"]);
+    EXPECT_EQ(1, server_logic.num_requests["8"]);
+}
+
+
+TEST(PipelinedServiceClient, Cancellation)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    PipelineHandler handler;
+    PipelineHandler::Client<2>::Type client(nodes.b, handler.bind());
+    client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_LE(0, client.init(1));
+
+    // Nobody responds
+    ASSERT_EQ(0, client.submit(root_ns_a::StringService::Request()));
+    ASSERT_EQ(0, client.submit(root_ns_a::StringService::Request()));
+    ASSERT_TRUE(client.isWindowFull());
+    ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+    client.cancelAll();
+    ASSERT_TRUE(client.isIdle());
+    ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200)));
+    ASSERT_EQ(0, handler.results.size());
+
+    // All attempts time out
+    client.setMaxAttempts(0);                           // Coerced to one
+    ASSERT_EQ(1, client.getMaxAttempts());
+    ASSERT_EQ(0, client.submit(root_ns_a::StringService::Request()));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100)));
+    ASSERT_EQ(1, handler.results.size());
+    ASSERT_FALSE(handler.results[0].success);
+    ASSERT_TRUE(client.isIdle());
+}
@@ -95,3 +95,188 @@ TEST(Publisher, Basic)
     ASSERT_TRUE(uavcan::GlobalDataTypeRegistry::instance().isFrozen());
     ASSERT_TRUE(publisher.getTransferSender().isInitialized());
 }
+
+
+TEST(Publisher, LatestValueOnly)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    ASSERT_FALSE(publisher.isLatestValueOnly());
+    publisher.setLatestValueOnly(true);
+    ASSERT_TRUE(publisher.isLatestValueOnly());
+
+    root_ns_a::MavlinkMessage msg;
+    msg.payload = "Msg";
+
+    /*
+     * The bus is busy, so all messages are queued; only the latest one survives in the queue
+     */
+    can_driver.ifaces[0].writeable = false;
+    can_driver.ifaces[1].writeable = false;
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        msg.seq = i;
+        ASSERT_LE(0, publisher.broadcast(msg));
+    }
+    ASSERT_EQ(0, publisher.getNode().getDispatcher().getTransferPerfCounter().getErrorCount());
+
+    can_driver.ifaces[0].writeable = true;
+    can_driver.ifaces[1].writeable = true;
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(1)));
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        ASSERT_EQ(1, can_driver.ifaces[i].tx.size());
+        EXPECT_EQ(0, can_driver.ifaces[i].tx.front().flags & uavcan::CanIOFlagCoalesce);  // Not for the driver
+        uavcan::Frame frame;
+        ASSERT_TRUE(frame.parse(can_driver.ifaces[i].popTxFrame()));
+        EXPECT_EQ(4, frame.getTransferID().get());
+        EXPECT_EQ(4, frame.getPayloadPtr()[0]);         // msg.seq
+    }
+
+    /*
+     * Multi frame transfers are queued as usual
+     */
+    can_driver.ifaces[0].writeable = false;
+    can_driver.ifaces[1].writeable = false;
+    msg.payload = "Long enough for a multi frame transfer";
+    ASSERT_LE(0, publisher.broadcast(msg));
+    ASSERT_LE(0, publisher.broadcast(msg));
+
+    can_driver.ifaces[0].writeable = true;
+    can_driver.ifaces[1].writeable = true;
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(1)));
+    EXPECT_LT(10, can_driver.ifaces[0].tx.size());
+    EXPECT_EQ(can_driver.ifaces[0].tx.size(), can_driver.ifaces[1].tx.size());
+}
+
+
+static uavcan::CanFrame makeMavlinkFrame(uavcan::NodeID src_node_id, uavcan::TransferID tid, const uint8_t* payload,
+                                         unsigned payload_len)
+{
+    uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                        src_node_id, uavcan::NodeID::Broadcast, tid);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    frame.setPayload(payload, payload_len);
+    uavcan::CanFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    return can_frame;
+}
+
+TEST(Publisher, PreEncodedPayload)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    uavcan::Publisher<root_ns_a::MavlinkMessage>::PreEncodedPayload payload;
+    ASSERT_TRUE(payload.isDirty());
+
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 0x42;
+    msg.payload = "Msg";
+
+    const uint64_t tx_timeout_usec = uint64_t(publisher.getDefaultTxTimeout().toUSec());
+
+    const uint8_t first_transfer_payload[] = {0x42, 0x00, 0x00, 0x00, 'M', 's', 'g'};
+    const uint8_t second_transfer_payload[] = {0x43, 0x00, 0x00, 0x00, 'M', 's', 'g'};
+
+    /*
+     * Encoded on the first publication
+     */
+    ASSERT_LT(0, publisher.broadcast(msg, payload));
+    ASSERT_FALSE(payload.isDirty());
+    ASSERT_TRUE(can_driver.ifaces[0].matchAndPopTx(makeMavlinkFrame(node.getNodeID(), 0, first_transfer_payload, 7),
+                                                   tx_timeout_usec + 100));
+
+    /*
+     * Modified, but not marked dirty - the old encoding is sent with the next TID
+     */
+    msg.seq = 0x43;
+    ASSERT_LT(0, publisher.broadcast(msg, payload));
+    ASSERT_TRUE(can_driver.ifaces[0].matchAndPopTx(makeMavlinkFrame(node.getNodeID(), 1, first_transfer_payload, 7),
+                                                   tx_timeout_usec + 100));
+
+    /*
+     * Marked dirty - encoded again
+     */
+    payload.markDirty();
+    ASSERT_LT(0, publisher.broadcast(msg, payload));
+    ASSERT_FALSE(payload.isDirty());
+    ASSERT_TRUE(can_driver.ifaces[0].matchAndPopTx(makeMavlinkFrame(node.getNodeID(), 2, second_transfer_payload, 7),
+                                                   tx_timeout_usec + 100));
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+}
+
+#if !UAVCAN_TINY
+TEST(Publisher, PublishOnChange)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    uavcan::Publisher<root_ns_a::MavlinkMessage> publisher(node);
+    ASSERT_FALSE(publisher.isPublishOnChange());
+    publisher.setPublishOnChange(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(publisher.isPublishOnChange());
+
+    root_ns_a::MavlinkMessage msg;
+    msg.seq = 0x42;
+    msg.payload = "Msg";
+
+    /*
+     * Unchanged messages are suppressed
+     */
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_EQ(0, publisher.broadcast(msg));
+    ASSERT_EQ(1, can_driver.ifaces[0].tx.size());
+
+    msg.payload = "Msg2";
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_EQ(2, can_driver.ifaces[0].tx.size());
+
+    // Multi frame transfer
+    msg.payload = "Long message";
+    ASSERT_LT(0, publisher.broadcast(msg));
+    const unsigned num_frames = unsigned(can_driver.ifaces[0].tx.size());
+    ASSERT_LT(3U, num_frames);
+    ASSERT_EQ(0, publisher.broadcast(msg));
+    ASSERT_EQ(num_frames, can_driver.ifaces[0].tx.size());
+
+    /*
+     * Until the max silence interval expires
+     */
+    clock_mock.advance(99000);
+    node.getDispatcher().spinOnce();
+    ASSERT_EQ(0, publisher.broadcast(msg));
+    ASSERT_EQ(num_frames, can_driver.ifaces[0].tx.size());
+
+    clock_mock.advance(1000);
+    node.getDispatcher().spinOnce();
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_LT(num_frames, can_driver.ifaces[0].tx.size());
+
+    /*
+     * Disabled
+     */
+    const unsigned num_frames_before = unsigned(can_driver.ifaces[0].tx.size());
+    publisher.setPublishOnChange(uavcan::MonotonicDuration());
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_LT(0, publisher.broadcast(msg));
+    ASSERT_EQ(num_frames_before + 2 * (num_frames - 2), can_driver.ifaces[0].tx.size());
+}
+#endif
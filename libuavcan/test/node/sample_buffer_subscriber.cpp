@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/node/sample_buffer_subscriber.hpp>
+#include <root_ns_a/MavlinkMessage.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+
+static void pushMavlinkMessage(CanDriverMock& can_driver, SystemClockDriver& clock_driver,
+                               uavcan::uint8_t seq, uavcan::uint8_t src_node_id, bool malformed = false)
+{
+    const uavcan::uint8_t transfer_payload[] = {seq, 0x72, 0x08, 0xa5, 'M', 's', 'g'};
+
+    uavcan::Frame frame(root_ns_a::MavlinkMessage::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                        uavcan::NodeID(src_node_id), uavcan::NodeID::Broadcast, seq);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    frame.setPayload(transfer_payload, malformed ? 2 : 7);     // Two bytes are not enough for the header fields
+    uavcan::RxFrame rx_frame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0);
+    can_driver.ifaces[0].pushRx(rx_frame);
+}
+
+
+TEST(SampleBufferSubscriber, Basic)
+{
+    // Manual type registration - we can't rely on the GDTR state
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::MavlinkMessage> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    typedef uavcan::SampleBufferSubscriber<root_ns_a::MavlinkMessage, 2> SubscriberType;
+    SubscriberType sub(node);
+
+    std::cout << "sizeof(uavcan::SampleBufferSubscriber<root_ns_a::MavlinkMessage, 2>): "
+              << sizeof(SubscriberType) << std::endl;
+
+    SubscriberType::Sample samples[3];
+
+    /*
+     * Nothing received yet
+     */
+    ASSERT_EQ(0, sub.getNumReceived());
+    ASSERT_FALSE(sub.readLatest(samples[0]));
+    ASSERT_EQ(0, sub.readLatest(samples, 3));
+    ASSERT_FALSE(sub.readSample(0, samples[0]));
+    ASSERT_FALSE(sub.readSample(1, samples[0]));
+
+    ASSERT_EQ(0, sub.start());
+    ASSERT_EQ(1, node.getDispatcher().getNumMessageListeners());
+
+    /*
+     * Three messages, only the last two are kept
+     */
+    pushMavlinkMessage(can_driver, clock_driver, 1, 100);
+    pushMavlinkMessage(can_driver, clock_driver, 2, 101);
+    pushMavlinkMessage(can_driver, clock_driver, 3, 102);
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(3, sub.getNumReceived());
+    ASSERT_EQ(0, sub.getFailureCount());
+
+    ASSERT_TRUE(sub.readLatest(samples[0]));
+    ASSERT_EQ(3, samples[0].message.seq);
+    ASSERT_EQ(uavcan::NodeID(102), samples[0].src_node_id);
+    ASSERT_EQ("Msg", samples[0].message.payload);
+    ASSERT_FALSE(samples[0].monotonic_timestamp.isZero());
+
+    ASSERT_EQ(2, sub.readLatest(samples, 3));          // Only two are available
+    ASSERT_EQ(3, samples[0].message.seq);
+    ASSERT_EQ(2, samples[1].message.seq);
+    ASSERT_EQ(uavcan::NodeID(101), samples[1].src_node_id);
+
+    ASSERT_FALSE(sub.readSample(1, samples[0]));       // Overwritten
+    ASSERT_TRUE(sub.readSample(2, samples[0]));
+    ASSERT_EQ(2, samples[0].message.seq);
+    ASSERT_FALSE(sub.readSample(4, samples[0]));       // Not received yet
+
+    /*
+     * A malformed message does not affect the stored samples
+     */
+    pushMavlinkMessage(can_driver, clock_driver, 4, 103, true);
+    ASSERT_LE(0, node.spin(clock_driver.getMonotonic() + durMono(10000)));
+
+    ASSERT_EQ(3, sub.getNumReceived());
+    ASSERT_EQ(1, sub.getFailureCount());
+    ASSERT_EQ(2, sub.readLatest(samples, 3));
+    ASSERT_EQ(3, samples[0].message.seq);
+    ASSERT_EQ(2, samples[1].message.seq);
+
+    /*
+     * The samples are still readable after the subscription is terminated
+     */
+    sub.stop();
+    ASSERT_EQ(0, node.getDispatcher().getNumMessageListeners());
+    ASSERT_TRUE(sub.readLatest(samples[0]));
+    ASSERT_EQ(3, samples[0].message.seq);
+}
@@ -3,10 +3,13 @@
  */
 
 #include <gtest/gtest.h>
+#include <cstdlib>
+#include <algorithm>
 #include <uavcan/node/timer.hpp>
 #include <uavcan/util/method_binder.hpp>
 #include "../clock.hpp"
 #include "../transport/can/can.hpp"
+#include "../transport/transfer_test_helpers.hpp"
 #include "test_node.hpp"
 
 #if !defined(UAVCAN_CPP11) || !defined(UAVCAN_CPP_VERSION)
@@ -27,6 +30,30 @@ struct TimerCallCounter
     Binder bindB() { return Binder(this, &TimerCallCounter::callB); }
 };
 
+class RecordingDeadlineHandler : public uavcan::DeadlineHandler
+{
+    std::vector<unsigned>& log_;
+
+public:
+    const unsigned id;
+
+    RecordingDeadlineHandler(uavcan::Scheduler& scheduler, std::vector<unsigned>& log, unsigned arg_id)
+        : uavcan::DeadlineHandler(scheduler)
+        , log_(log)
+        , id(arg_id)
+    { }
+
+    virtual void handleDeadline(uavcan::MonotonicTime) { log_.push_back(id); }
+};
+
+struct FirstLess
+{
+    bool operator()(const std::pair<uint64_t, unsigned>& a, const std::pair<uint64_t, unsigned>& b) const
+    {
+        return a.first < b.first;
+    }
+};
+
 /*
  * This test can fail on a non real time system. That's kinda sad but okay.
  */
@@ -90,6 +117,123 @@ TEST(Scheduler, Timers)
     ASSERT_EQ(0, node.spin(durMono(1000)));                                    // Spin some more without timers
 }
 
+struct GroupedTimerStopper : public uavcan::GroupedTimerBase
+{
+    uavcan::GroupedTimerBase* to_stop;
+    unsigned count;
+
+    explicit GroupedTimerStopper(uavcan::TimerGroup& group)
+        : uavcan::GroupedTimerBase(group)
+        , to_stop(NULL)
+        , count(0)
+    { }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent&)
+    {
+        count++;
+        if (to_stop != NULL)
+        {
+            to_stop->stop();
+        }
+    }
+};
+
+TEST(Scheduler, TimerGroup)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    node.getScheduler().setTickless(true);
+
+    uavcan::TimerGroup group(node, durMono(100000));
+    ASSERT_FALSE(group.isRunning());
+    ASSERT_EQ(100000, group.getPeriod().toUSec());
+
+    /*
+     * Many timers, one scheduler entry
+     */
+    {
+        TimerCallCounter tcc;
+        uavcan::GroupedTimerEventForwarder<TimerCallCounter::Binder> a(group, tcc.bindA());
+        uavcan::GroupedTimerEventForwarder<TimerCallCounter::Binder> b(group, tcc.bindB());
+
+        const uavcan::MonotonicTime start_ts = clock_mock.getMonotonic();
+        a.start();
+        ASSERT_TRUE(group.isRunning());
+        b.start();
+        b.start();                                  // Ignored
+        ASSERT_TRUE(a.isRunning());
+        ASSERT_TRUE(b.isRunning());
+        ASSERT_EQ(2, group.getNumTimers());
+#if UAVCAN_DEADLINE_SCHEDULER_HEAP
+        ASSERT_EQ(1, node.getScheduler().getDeadlineScheduler().getNumHandlers());
+#endif
+
+        ASSERT_EQ(0, node.spin(start_ts + durMono(1000000)));
+        ASSERT_EQ(10, tcc.events_a.size());
+        ASSERT_EQ(10, tcc.events_b.size());
+        for (unsigned i = 0; i < tcc.events_a.size(); i++)
+        {
+            const uavcan::MonotonicTime expected = start_ts + durMono(100000 * (i + 1));
+            ASSERT_EQ(expected, tcc.events_a[i].scheduled_time);
+            ASSERT_EQ(expected, tcc.events_b[i].scheduled_time);        // Same phase
+            ASSERT_EQ(expected, tcc.events_a[i].real_time);
+        }
+
+        a.stop();
+        ASSERT_FALSE(a.isRunning());
+        ASSERT_TRUE(group.isRunning());
+        ASSERT_EQ(1, group.getNumTimers());
+        // b is stopped by the destructor, which stops the group
+    }
+    ASSERT_FALSE(group.isRunning());
+    ASSERT_EQ(0, group.getNumTimers());
+
+    /*
+     * Stopping timers from the callbacks
+     */
+    GroupedTimerStopper x(group);
+    GroupedTimerStopper y(group);
+    GroupedTimerStopper z(group);
+    x.start();
+    y.start();
+    z.start();                                      // Fires first
+    z.to_stop = &y;                                 // Next in the pass
+
+    ASSERT_EQ(0, node.spin(durMono(100000)));
+    ASSERT_EQ(1, z.count);
+    ASSERT_EQ(0, y.count);
+    ASSERT_EQ(1, x.count);
+    ASSERT_FALSE(y.isRunning());
+
+    z.to_stop = NULL;
+    x.to_stop = &x;                                 // Itself
+    ASSERT_EQ(0, node.spin(durMono(100000)));
+    ASSERT_EQ(2, z.count);
+    ASSERT_EQ(2, x.count);
+    ASSERT_FALSE(x.isRunning());
+    ASSERT_TRUE(group.isRunning());
+
+    z.to_stop = &z;                                 // The last one, the group stops
+    ASSERT_EQ(0, node.spin(durMono(100000)));
+    ASSERT_EQ(3, z.count);
+    ASSERT_FALSE(group.isRunning());
+    ASSERT_EQ(0, node.spin(durMono(300000)));
+    ASSERT_EQ(3, z.count);
+
+    /*
+     * Period change
+     */
+    z.to_stop = NULL;
+    z.start();
+    group.setPeriod(durMono(50000));
+    const uavcan::MonotonicTime restart_ts = clock_mock.getMonotonic();
+    ASSERT_EQ(restart_ts + durMono(50000), group.getDeadline());
+    ASSERT_EQ(0, node.spin(durMono(200000)));
+    ASSERT_EQ(7, z.count);
+    z.stop();
+}
+
 #if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
 
 TEST(Scheduler, TimerCpp11)
@@ -114,3 +258,437 @@ TEST(Scheduler, TimerCpp11)
 }
 
 #endif
+
+/*
+ * Checks the deadline ordering against a trivial model: handlers fire in the order of deadline,
+ * and handlers with equal deadlines fire in the order they were started.
+ */
+TEST(Scheduler, DeadlineOrder)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::DeadlineScheduler& ds = node.getScheduler().getDeadlineScheduler();
+
+    static const unsigned NumHandlers = 64;
+    std::vector<unsigned> fired;
+    std::vector<RecordingDeadlineHandler*> handlers;
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        handlers.push_back(new RecordingDeadlineHandler(node.getScheduler(), fired, i));
+    }
+
+    std::vector<std::pair<uint64_t, unsigned> > model;     // In the order of registration
+    std::srand(42);
+
+    for (unsigned round = 0; round < 2000; round++)
+    {
+        const unsigned num_ops = unsigned(std::rand()) % 8;
+        for (unsigned op = 0; op < num_ops; op++)
+        {
+            RecordingDeadlineHandler* const h = handlers[unsigned(std::rand()) % NumHandlers];
+            for (unsigned i = 0; i < model.size(); i++)
+            {
+                if (model[i].second == h->id)
+                {
+                    model.erase(model.begin() + i);
+                    break;
+                }
+            }
+            if ((std::rand() % 4) == 0)
+            {
+                h->stop();
+                ASSERT_FALSE(h->isRunning());
+            }
+            else
+            {
+                const uint64_t deadline = clock_mock.monotonic + 1 + uint64_t(std::rand() % 16);  // Many ties
+                h->startWithDeadline(uavcan::MonotonicTime::fromUSec(deadline));
+                ASSERT_TRUE(h->isRunning());
+                model.push_back(std::make_pair(deadline, h->id));
+            }
+        }
+        ASSERT_EQ(model.size(), ds.getNumHandlers());
+
+        clock_mock.advance(uint64_t(std::rand() % 8));
+
+        std::vector<std::pair<uint64_t, unsigned> > expected_entries;
+        std::vector<std::pair<uint64_t, unsigned> > remaining;
+        for (unsigned i = 0; i < model.size(); i++)
+        {
+            ((model[i].first <= clock_mock.monotonic) ? expected_entries : remaining).push_back(model[i]);
+        }
+        std::stable_sort(expected_entries.begin(), expected_entries.end(), FirstLess());
+        model = remaining;
+
+        std::vector<unsigned> expected;
+        for (unsigned i = 0; i < expected_entries.size(); i++)
+        {
+            expected.push_back(expected_entries[i].second);
+        }
+
+        fired.clear();
+        ds.pollAndGetMonotonicTime(clock_mock);
+        ASSERT_EQ(expected, fired);
+
+        uint64_t earliest = uavcan::MonotonicTime::getMax().toUSec();
+        for (unsigned i = 0; i < model.size(); i++)
+        {
+            earliest = std::min(earliest, model[i].first);
+        }
+        ASSERT_EQ(earliest, ds.getEarliestDeadline().toUSec());
+    }
+
+    for (unsigned i = 0; i < NumHandlers; i++)
+    {
+        delete handlers[i];
+    }
+    ASSERT_EQ(0, ds.getNumHandlers());
+    ASSERT_EQ(uavcan::MonotonicTime::getMax(), ds.getEarliestDeadline());
+}
+
+struct SelectCountingCanDriverMock : public CanDriverMock
+{
+    unsigned num_selects;
+
+    SelectCountingCanDriverMock(unsigned num_ifaces, uavcan::ISystemClock& iclock)
+        : CanDriverMock(num_ifaces, iclock)
+        , num_selects(0)
+    { }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (& pending_tx)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime deadline)
+    {
+        num_selects++;
+        return CanDriverMock::select(inout_masks, pending_tx, deadline);
+    }
+};
+
+TEST(Scheduler, Tickless)
+{
+    SystemClockMock clock_mock(100);
+    SelectCountingCanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    TimerCallCounter tcc;
+    uavcan::TimerEventForwarder<TimerCallCounter::Binder> a(node, tcc.bindA());
+
+    /*
+     * Regular mode - the dispatcher wakes up every deadline resolution period
+     */
+    ASSERT_FALSE(node.getScheduler().isTickless());
+    a.startPeriodic(uavcan::MonotonicDuration::fromMSec(500));
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicDuration::fromMSec(3000)));
+    ASSERT_EQ(6, tcc.events_a.size());
+    std::cout << "Selects in regular mode: " << can_driver.num_selects << std::endl;
+    ASSERT_LT(500, can_driver.num_selects);
+
+    /*
+     * Tickless mode - only timer deadlines and the cleanup wake it up
+     */
+    node.getScheduler().setTickless(true);
+    ASSERT_TRUE(node.getScheduler().isTickless());
+    tcc.events_a.clear();
+    can_driver.num_selects = 0;
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicDuration::fromMSec(3000)));
+    ASSERT_EQ(6, tcc.events_a.size());
+    for (unsigned i = 0; i < tcc.events_a.size(); i++)
+    {
+        ASSERT_EQ(tcc.events_a[i].scheduled_time, tcc.events_a[i].real_time);   // Exactly on time
+    }
+    std::cout << "Selects in tickless mode: " << can_driver.num_selects << std::endl;
+    ASSERT_GE(12, can_driver.num_selects);
+
+    /*
+     * No timers - the cleanup only
+     */
+    a.stop();
+    can_driver.num_selects = 0;
+    ASSERT_EQ(0, node.spin(uavcan::MonotonicDuration::fromMSec(5000)));
+    ASSERT_GE(6, can_driver.num_selects);
+}
+
+
+struct BusyTimerCallback
+{
+    SystemClockDriver& clock;
+    uavcan::MonotonicDuration busy_time;
+    unsigned count;
+
+    BusyTimerCallback(SystemClockDriver& arg_clock, uavcan::MonotonicDuration arg_busy_time)
+        : clock(arg_clock)
+        , busy_time(arg_busy_time)
+        , count(0)
+    { }
+
+    void handle(const uavcan::TimerEvent&)
+    {
+        count++;
+        const uavcan::MonotonicTime deadline = clock.getMonotonic() + busy_time;
+        while (clock.getMonotonic() < deadline) { }
+    }
+
+    typedef uavcan::MethodBinder<BusyTimerCallback*, void (BusyTimerCallback::*)(const uavcan::TimerEvent&)> Binder;
+
+    Binder bind() { return Binder(this, &BusyTimerCallback::handle); }
+};
+
+TEST(Scheduler, LoadStats)
+{
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    BusyTimerCallback callback(clock_driver, durMono(2000));
+    uavcan::TimerEventForwarder<BusyTimerCallback::Binder> timer(node, callback.bind());
+    timer.startPeriodic(durMono(10000));
+
+    // Disabled by default
+    ASSERT_FALSE(sch.isLoadStatsEnabled());
+    ASSERT_EQ(0, node.spin(durMono(30000)));
+    ASSERT_EQ(0, sch.getLoadStats().total_time.toUSec());
+    ASSERT_EQ(0, sch.getLoadStats().deadline_handling.getCount());
+    ASSERT_EQ(0, sch.getLoadStats().getUtilizationPercent());
+
+    /*
+     * Timer callbacks use about 20% of the time
+     */
+    sch.setLoadStatsEnabled(true);
+    callback.count = 0;
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        uavcan::Frame frame(1, uavcan::TransferTypeMessageBroadcast, uavcan::NodeID(uint8_t(i + 10)),
+                            uavcan::NodeID::Broadcast, i);
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        can_driver.ifaces[0].pushRx(uavcan::RxFrame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0));
+    }
+
+    ASSERT_LE(0, node.spin(durMono(200000)));
+
+    const uavcan::SchedulerLoadStats& stats = sch.getLoadStats();
+    std::cout << "total " << stats.total_time.toString() << " busy " << stats.getBusyTime().toString()
+              << " peak " << stats.getPeakCallbackTime().toString()
+              << " util " << int(stats.getUtilizationPercent()) << "%" << std::endl;
+
+    ASSERT_LE(200000, stats.total_time.toUSec());
+    ASSERT_GT(300000, stats.total_time.toUSec());
+    ASSERT_EQ(callback.count, stats.deadline_handling.getCount());
+    ASSERT_LE(2000, stats.deadline_handling.getPeak().toUSec());
+    ASSERT_LE(2000, stats.getPeakCallbackTime().toUSec());
+    ASSERT_LE(2000, stats.deadline_handling.getAverage().toUSec());
+    ASSERT_LE(1, stats.frame_handling.getCount());
+    ASSERT_LE(10, stats.getUtilizationPercent());
+    ASSERT_GE(40, stats.getUtilizationPercent());
+    ASSERT_EQ(stats.total_time, stats.getBusyTime() + stats.getIdleTime());
+
+    // spinOnce() is accounted too
+    const uavcan::MonotonicDuration prev_total = stats.total_time;
+    ASSERT_LE(0, node.spinOnce());
+    ASSERT_LE(prev_total, stats.total_time);
+
+    /*
+     * Reset, disable
+     */
+    sch.resetLoadStats();
+    ASSERT_EQ(0, sch.getLoadStats().total_time.toUSec());
+    ASSERT_EQ(0, sch.getLoadStats().deadline_handling.getCount());
+
+    sch.setLoadStatsEnabled(false);
+    ASSERT_TRUE(sch.getDispatcher().getFrameHandlingTimeCounter() == NULL);
+    ASSERT_EQ(0, node.spin(durMono(30000)));
+    ASSERT_EQ(0, sch.getLoadStats().total_time.toUSec());
+
+    // Value conversion
+    ASSERT_EQ(0, uavcan::SchedulerLoadStats::computeUtilizationPercent(durMono(10), durMono(0)));
+    ASSERT_EQ(50, uavcan::SchedulerLoadStats::computeUtilizationPercent(durMono(10), durMono(20)));
+    ASSERT_EQ(100, uavcan::SchedulerLoadStats::computeUtilizationPercent(durMono(30), durMono(20)));
+}
+
+
+TEST(Scheduler, CleanupBudget)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+
+    typedef TestListener<8, 0, 0> Subscriber;
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindMessage, 1);
+    uavcan::TransferPerfCounter& perf = sch.getDispatcher().getTransferPerfCounter();
+    Subscriber sub_a(perf, type, node.getAllocator());
+    Subscriber sub_b(perf, type, node.getAllocator());
+    Subscriber sub_c(perf, type, node.getAllocator());
+    Subscriber sub_d(perf, type, node.getAllocator());
+    Subscriber* const subs[4] = { &sub_a, &sub_b, &sub_c, &sub_d };
+    for (unsigned i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(sch.getDispatcher().registerMessageListener(subs[i]));
+    }
+
+    sch.setLoadStatsEnabled(true);
+
+    /*
+     * No limit by default - the whole cleanup at once
+     */
+    ASSERT_EQ(0, sch.getCleanupBudget());
+    clock_mock.advance(1100000);
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_FALSE(sch.isCleanupInProgress());
+    ASSERT_EQ(1, sch.getLoadStats().cleanup.getCount());
+
+    /*
+     * Two listeners per spin: the outgoing transfer registry and the first listener,
+     * then two more listeners, then the last one
+     */
+    sch.setCleanupBudget(2);
+    ASSERT_EQ(2, sch.getCleanupBudget());
+    clock_mock.advance(1100000);
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_TRUE(sch.isCleanupInProgress());
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_TRUE(sch.isCleanupInProgress());
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_FALSE(sch.isCleanupInProgress());
+    ASSERT_EQ(4, sch.getLoadStats().cleanup.getCount());
+
+    // Not due yet
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_FALSE(sch.isCleanupInProgress());
+    ASSERT_EQ(4, sch.getLoadStats().cleanup.getCount());
+
+    /*
+     * In tickless mode the unfinished cleanup does not wait for the next wakeup
+     */
+    sch.setTickless(true);
+    clock_mock.advance(1100000);
+    ASSERT_LE(0, sch.spin(clock_mock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_FALSE(sch.isCleanupInProgress());
+    ASSERT_EQ(7, sch.getLoadStats().cleanup.getCount());
+
+    for (unsigned i = 0; i < 4; i++)
+    {
+        sch.getDispatcher().unregisterMessageListener(subs[i]);
+    }
+}
+
+
+class BurstRxDeadlineHandler : public uavcan::DeadlineHandler
+{
+    CanIfaceMock& iface_;
+
+public:
+    std::vector<unsigned>& rx_queue_sizes;
+
+    BurstRxDeadlineHandler(uavcan::Scheduler& scheduler, CanIfaceMock& iface, std::vector<unsigned>& sizes)
+        : uavcan::DeadlineHandler(scheduler)
+        , iface_(iface)
+        , rx_queue_sizes(sizes)
+    { }
+
+    /**
+     * Simulates a burst of frames arriving while the handler is running.
+     */
+    virtual void handleDeadline(uavcan::MonotonicTime)
+    {
+        rx_queue_sizes.push_back(unsigned(iface_.rx.size()));
+        for (unsigned i = 0; i < 3; i++)
+        {
+            iface_.pushRx(uavcan::CanFrame(0x1000 | uavcan::CanFrame::FlagEFF, reinterpret_cast<const uint8_t*>(""),
+                                           0));
+        }
+    }
+};
+
+TEST(Scheduler, RxFrameBudget)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+    uavcan::Scheduler& sch = node.getScheduler();
+    sch.setLoadStatsEnabled(true);
+
+    std::vector<unsigned> sizes;
+    BurstRxDeadlineHandler a(sch, can_driver.ifaces[0], sizes);
+    BurstRxDeadlineHandler b(sch, can_driver.ifaces[0], sizes);
+    BurstRxDeadlineHandler c(sch, can_driver.ifaces[0], sizes);
+
+    /*
+     * Disabled by default - all expired handlers are run back to back, the frames pile up
+     */
+    ASSERT_EQ(0, sch.getRxFrameBudget());
+    a.startWithDeadline(tsMono(1000));
+    b.startWithDeadline(tsMono(1100));
+    c.startWithDeadline(tsMono(1200));
+    clock_mock.advance(2000);                       // Now 2100
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_EQ(3, sizes.size());
+    ASSERT_EQ(0, sizes[0]);
+    ASSERT_EQ(3, sizes[1]);
+    ASSERT_EQ(6, sizes[2]);
+
+    const uavcan::ExecutionTimeCounter& lateness = sch.getLoadStats().deadline_lateness;
+    ASSERT_EQ(3, lateness.getCount());
+    ASSERT_EQ(1100, lateness.getPeak().toUSec());
+    ASSERT_EQ(1000, lateness.getAverage().toUSec());
+
+    ASSERT_LE(0, sch.spinOnce());                   // Draining
+    ASSERT_TRUE(can_driver.ifaces[0].rx.empty());
+
+    /*
+     * Two frames between the handlers
+     */
+    sizes.clear();
+    sch.setRxFrameBudget(2);
+    ASSERT_EQ(2, sch.getRxFrameBudget());
+    a.startWithDeadline(clock_mock.getMonotonic());
+    b.startWithDeadline(clock_mock.getMonotonic());
+    c.startWithDeadline(clock_mock.getMonotonic());
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_EQ(3, sizes.size());
+    ASSERT_EQ(0, sizes[0]);
+    ASSERT_EQ(1, sizes[1]);                         // 3 pushed, 2 received
+    ASSERT_EQ(2, sizes[2]);                         // 1 + 3 pushed, 2 received
+    ASSERT_EQ(5, can_driver.ifaces[0].rx.size());   // The last burst is left for the next spin
+    ASSERT_FALSE(a.isRunning() || b.isRunning() || c.isRunning());
+    ASSERT_EQ(6, lateness.getCount());
+
+    ASSERT_LE(0, sch.spinOnce());
+    ASSERT_TRUE(can_driver.ifaces[0].rx.empty());
+}
+
+
+TEST(Scheduler, SpinBudget)
+{
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    std::vector<unsigned> log;
+    RecordingDeadlineHandler handler(node.getScheduler(), log, 1);
+    handler.startWithDeadline(tsMono(1000));
+
+    const uavcan::CanFrame frame(0x1000 | uavcan::CanFrame::FlagEFF, reinterpret_cast<const uint8_t*>(""), 0);
+    for (unsigned i = 0; i < 5; i++)
+    {
+        can_driver.ifaces[0].pushRx(frame);
+    }
+
+    // Deadline handlers are serviced even when the frame budget is used up
+    clock_mock.advance(1000);
+    ASSERT_EQ(3, node.spinBudget(3));
+    ASSERT_EQ(1, log.size());
+    ASSERT_EQ(2, can_driver.ifaces[0].rx.size());
+
+    ASSERT_EQ(2, node.spinBudget(3));
+    ASSERT_EQ(0, node.spinBudget(3));
+
+    // The wait for frames is limited by the earliest deadline
+    handler.startWithDeadline(clock_mock.getMonotonic() + durMono(500));
+    ASSERT_EQ(0, node.spinBudget(3, clock_mock.getMonotonic() + durMono(100000)));
+    ASSERT_EQ(2, log.size());
+    ASSERT_GT(50000, clock_mock.monotonic);
+}
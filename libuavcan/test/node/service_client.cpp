@@ -11,6 +11,7 @@
 #include <root_ns_a/StringService.hpp>
 #include <root_ns_a/EmptyService.hpp>
 #include <queue>
+#include <vector>
 #include <sstream>
 #include "test_node.hpp"
 
@@ -292,6 +293,11 @@ TEST(ServiceClient, ConcurrentCalls)
 
     ASSERT_EQ(1, nodes.b.getDispatcher().getNumServiceResponseListeners());     // Listening
 
+    // The client has one deadline handler for all calls, scheduled for the earliest timeout
+    const uavcan::MonotonicTime earliest = nodes.b.getScheduler().getDeadlineScheduler().getEarliestDeadline();
+    ASSERT_LT(nodes.b.getMonotonicTime(), earliest);
+    ASSERT_GE(nodes.b.getMonotonicTime() + uavcan::MonotonicDuration::fromMSec(100), earliest);
+
     /*
      * Cancelling one
      */
@@ -354,6 +360,101 @@ TEST(ServiceClient, ConcurrentCalls)
 }
 
 
+/**
+ * Reissues a call to the next server from the timeout callback and cancels a pending call, in order to make sure
+ * that the callback is allowed to modify the call registry.
+ */
+struct ReissuingTimeoutHandler
+{
+    typedef uavcan::ServiceClient<root_ns_a::StringService,
+                                  uavcan::MethodBinder<ReissuingTimeoutHandler*,
+                                      void (ReissuingTimeoutHandler::*)(const uavcan::ServiceCallResult<
+                                                                            root_ns_a::StringService>&)> > ClientType;
+    ClientType* client;
+    std::vector<uavcan::NodeID> timed_out;
+
+    ReissuingTimeoutHandler() : client(NULL) { }
+
+    void handleResponse(const uavcan::ServiceCallResult<root_ns_a::StringService>& result)
+    {
+        ASSERT_FALSE(result.isSuccessful());
+        const uavcan::NodeID nid = result.getCallID().server_node_id;
+        ASSERT_FALSE(client->hasPendingCallToServer(nid));
+        timed_out.push_back(nid);
+        if (nid.get() == 10)
+        {
+            ASSERT_LT(0, client->call(100, root_ns_a::StringService::Request()));
+            client->cancelCall(client->getCallIDByIndex(client->getNumPendingCalls() - 2U));
+        }
+    }
+};
+
+TEST(ServiceClient, ManyServers)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    ReissuingTimeoutHandler handler;
+    ReissuingTimeoutHandler::ClientType client(nodes.b);
+    handler.client = &client;
+    client.setCallback(ReissuingTimeoutHandler::ClientType::Callback(&handler,
+                                                                      &ReissuingTimeoutHandler::handleResponse));
+    client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(100));
+
+    /*
+     * Nobody responds; the calls are made with decreasing timeouts, so the order of their deadlines is the
+     * reverse of the order of the calls, except for the first one
+     */
+    ASSERT_LT(0, client.call(10, root_ns_a::StringService::Request()));
+    client.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(300));
+    for (uint8_t nid = 11; nid < 30; nid++)
+    {
+        ASSERT_LT(0, client.call(nid, root_ns_a::StringService::Request()));
+        client.setRequestTimeout(client.getRequestTimeout() - uavcan::MonotonicDuration::fromMSec(5));
+    }
+    ASSERT_EQ(20, client.getNumPendingCalls());
+
+    ASSERT_EQ(uavcan::NodeID(10), client.getCallIDByIndex(0).server_node_id);
+    ASSERT_EQ(uavcan::NodeID(29), client.getCallIDByIndex(1).server_node_id);
+    ASSERT_EQ(uavcan::NodeID(11), client.getCallIDByIndex(19).server_node_id);
+    ASSERT_FALSE(client.getCallIDByIndex(20).isValid());
+
+    for (uint8_t nid = 10; nid < 30; nid++)
+    {
+        ASSERT_TRUE(client.hasPendingCallToServer(nid));
+    }
+    ASSERT_FALSE(client.hasPendingCallToServer(42));   // Shares the bucket with 10 if the index is small
+
+    client.cancelCall(uavcan::ServiceCallID(20, 0));
+    ASSERT_FALSE(client.hasPendingCallToServer(20));
+    ASSERT_EQ(19, client.getNumPendingCalls());
+
+    /*
+     * The first timeout reissues a call to 100 with the latest deadline, and cancels the call to 11,
+     * which has the second latest one
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_EQ(1, handler.timed_out.size());
+    ASSERT_EQ(18, client.getNumPendingCalls());
+    ASSERT_TRUE(client.hasPendingCallToServer(100));
+    ASSERT_FALSE(client.hasPendingCallToServer(11));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(300));
+    ASSERT_FALSE(client.hasPendingCalls());
+    ASSERT_EQ(0, nodes.b.getDispatcher().getNumServiceResponseListeners());
+
+    // Expired in the order of deadlines
+    const uint8_t expected[] = { 10, 29, 28, 27, 26, 25, 24, 23, 22, 21, 19, 18, 17, 16, 15, 14, 13, 12, 100 };
+    ASSERT_EQ(sizeof(expected), handler.timed_out.size());
+    for (unsigned i = 0; i < sizeof(expected); i++)
+    {
+        EXPECT_EQ(uavcan::NodeID(expected[i]), handler.timed_out[i]);
+    }
+}
+
+
 TEST(ServiceClient, Empty)
 {
     InterlinkedTestNodesWithSysClock nodes;
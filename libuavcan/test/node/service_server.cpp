@@ -7,6 +7,8 @@
 #include <uavcan/util/method_binder.hpp>
 #include <root_ns_a/StringService.hpp>
 #include <root_ns_a/EmptyService.hpp>
+#include <string>
+#include <vector>
 #include "../clock.hpp"
 #include "../transport/can/can.hpp"
 #include "test_node.hpp"
@@ -52,6 +54,30 @@ struct EmptyServerImpl
 };
 
 
+/**
+ * Defers every response, as if the request would be served by a slow storage.
+ */
+struct DeferringServerImpl
+{
+    std::vector<uavcan::ServiceReplyContext> contexts;
+    std::vector<std::string> requests;
+
+    void handleRequest(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>& request,
+                       uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>& response)
+    {
+        contexts.push_back(response.deferResponse());
+        requests.push_back(request.string_request.c_str());
+    }
+
+    typedef uavcan::MethodBinder<DeferringServerImpl*,
+        void (DeferringServerImpl::*)(const uavcan::ReceivedDataStructure<root_ns_a::StringService::Request>&,
+                                      uavcan::ServiceResponseDataStructure<root_ns_a::StringService::Response>&)>
+        Binder;
+
+    Binder bind() { return Binder(this, &DeferringServerImpl::handleRequest); }
+};
+
+
 TEST(ServiceServer, Basic)
 {
     // Manual type registration - we can't rely on the GDTR state
@@ -154,3 +180,73 @@ TEST(ServiceServer, Empty)
     ASSERT_GE(0, server.start(impl.bind()));
     ASSERT_EQ(1, node.getDispatcher().getNumServiceRequestListeners());
 }
+
+
+TEST(ServiceServer, DeferredResponse)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::StringService> _registrator;
+
+    SystemClockDriver clock_driver;
+    CanDriverMock can_driver(1, clock_driver);
+    TestNode node(can_driver, clock_driver, 1);
+
+    DeferringServerImpl impl;
+
+    uavcan::ServiceServer<root_ns_a::StringService, DeferringServerImpl::Binder> server(node);
+    ASSERT_LE(0, server.start(impl.bind()));
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        uavcan::Frame frame(root_ns_a::StringService::DefaultDataTypeID, uavcan::TransferTypeServiceRequest,
+                            uavcan::NodeID(uint8_t(i + 0x10)), 1, uint8_t(i + 5));
+
+        const uint8_t req[] = {'r', 'e', 'q', uint8_t(i + '0')};
+        frame.setPayload(req, sizeof(req));
+
+        frame.setStartOfTransfer(true);
+        frame.setEndOfTransfer(true);
+        frame.setPriority(uint8_t(i + 10));
+
+        uavcan::RxFrame rx_frame(frame, clock_driver.getMonotonic(), clock_driver.getUtc(), 0);
+        can_driver.ifaces[0].pushRx(rx_frame);
+    }
+
+    node.spin(clock_driver.getMonotonic() + uavcan::MonotonicDuration::fromUSec(10000));
+
+    // Nothing is sent until the application responds
+    ASSERT_EQ(2, impl.contexts.size());
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+
+    ASSERT_TRUE(impl.contexts[0].isValid());
+    ASSERT_EQ(0x10, impl.contexts[0].client_node_id.get());
+    ASSERT_EQ(5, impl.contexts[0].transfer_id.get());
+    ASSERT_EQ(10, impl.contexts[0].priority.get());
+
+    // Responding in the reverse order, long after the callbacks have returned
+    for (int i = 1; i >= 0; i--)
+    {
+        root_ns_a::StringService::Response response;
+        response.string_response = impl.requests[unsigned(i)].c_str();
+        ASSERT_LE(0, server.respond(impl.contexts[unsigned(i)], response));
+
+        uavcan::Frame fr;
+        ASSERT_TRUE(fr.parse(can_driver.ifaces[0].popTxFrame()));
+        std::cout << fr.toString() << std::endl;
+
+        ASSERT_EQ(uavcan::TransferTypeServiceResponse, fr.getTransferType());
+        ASSERT_EQ(i + 0x10, fr.getDstNodeID().get());
+        ASSERT_EQ(i + 5, fr.getTransferID().get());
+        ASSERT_EQ(i + 10, fr.getPriority().get());
+        ASSERT_FALSE(std::strncmp(impl.requests[unsigned(i)].c_str(),
+                                  reinterpret_cast<const char*>(fr.getPayloadPtr()), 4));
+    }
+
+    // Invalid context is rejected
+    ASSERT_FALSE(uavcan::ServiceReplyContext().isValid());
+    ASSERT_EQ(-uavcan::ErrInvalidParam,
+              server.respond(uavcan::ServiceReplyContext(), root_ns_a::StringService::Response()));
+    ASSERT_TRUE(can_driver.ifaces[0].tx.empty());
+
+    ASSERT_EQ(0, server.getResponseFailureCount());
+}
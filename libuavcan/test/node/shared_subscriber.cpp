@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/shared_subscriber.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include "../protocol/helpers.hpp"
+
+
+struct SharedSubscriptionListener
+{
+    typedef uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus> ReceivedNodeStatus;
+    typedef uavcan::MethodBinder<SharedSubscriptionListener*,
+                                 void (SharedSubscriptionListener::*)(const ReceivedNodeStatus&)> Binder;
+
+    std::vector<uavcan::uint32_t> uptimes;
+    std::vector<const uavcan::protocol::NodeStatus*> addresses;
+    uavcan::SharedSubscription<uavcan::protocol::NodeStatus, Binder>* to_stop;
+
+    SharedSubscriptionListener() : to_stop(NULL) { }
+
+    void receive(const ReceivedNodeStatus& msg)
+    {
+        uptimes.push_back(msg.uptime_sec);
+        addresses.push_back(&msg);
+        if (to_stop != NULL)
+        {
+            to_stop->stop();
+        }
+    }
+
+    Binder bind() { return Binder(this, &SharedSubscriptionListener::receive); }
+};
+
+
+TEST(SharedSubscriber, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    typedef uavcan::SharedSubscription<uavcan::protocol::NodeStatus, SharedSubscriptionListener::Binder> Subscription;
+
+    uavcan::SharedSubscriber<uavcan::protocol::NodeStatus> hub(nodes.a);
+    ASSERT_EQ(0, nodes.a.getDispatcher().getNumMessageListeners());
+
+    SharedSubscriptionListener listener_a;
+    SharedSubscriptionListener listener_b;
+    SharedSubscriptionListener listener_c;
+    Subscription sub_a;
+    Subscription sub_b;
+    Subscription sub_c;
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, sub_a.start(hub, SharedSubscriptionListener::Binder()));
+    ASSERT_FALSE(sub_a.isActive());
+    ASSERT_EQ(0, nodes.a.getDispatcher().getNumMessageListeners());
+
+    /*
+     * One transfer listener for all subscriptions
+     */
+    ASSERT_LE(0, sub_a.start(hub, listener_a.bind()));
+    ASSERT_LE(0, sub_b.start(hub, listener_b.bind()));
+    ASSERT_LE(0, sub_c.start(hub, listener_c.bind()));
+    ASSERT_TRUE(sub_a.isActive());
+    ASSERT_EQ(3, hub.getNumSubscriptions());
+    ASSERT_EQ(1, nodes.a.getDispatcher().getNumMessageListeners());
+
+    uavcan::protocol::NodeStatus msg;
+    uavcan::TransferID tid;
+
+    msg.uptime_sec = 100;
+    emulateSingleFrameBroadcastTransfer(nodes.can_a, uavcan::NodeID(10), msg, tid);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_EQ(1, listener_a.uptimes.size());
+    ASSERT_EQ(1, listener_b.uptimes.size());
+    ASSERT_EQ(1, listener_c.uptimes.size());
+    ASSERT_EQ(100, listener_a.uptimes[0]);
+    ASSERT_EQ(100, listener_c.uptimes[0]);
+    ASSERT_EQ(listener_a.addresses[0], listener_b.addresses[0]);        // Decoded once
+    ASSERT_EQ(listener_a.addresses[0], listener_c.addresses[0]);
+
+    /*
+     * Every subscription stops another one, or itself, from the callback
+     */
+    listener_a.to_stop = &sub_b;
+    listener_b.to_stop = &sub_c;
+    listener_c.to_stop = &sub_a;
+
+    msg.uptime_sec = 101;
+    tid.increment();
+    emulateSingleFrameBroadcastTransfer(nodes.can_a, uavcan::NodeID(10), msg, tid);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    // Whichever is invoked first stops the next one; no removed subscription is invoked
+    const unsigned num_invoked = unsigned(listener_a.uptimes.size() + listener_b.uptimes.size() +
+                                          listener_c.uptimes.size()) - 3U;
+    ASSERT_EQ(2, num_invoked);
+    ASSERT_EQ(1, hub.getNumSubscriptions());
+    ASSERT_EQ(1, nodes.a.getDispatcher().getNumMessageListeners());
+
+    listener_a.to_stop = &sub_a;
+    listener_b.to_stop = &sub_b;
+    listener_c.to_stop = &sub_c;
+
+    msg.uptime_sec = 102;
+    tid.increment();
+    emulateSingleFrameBroadcastTransfer(nodes.can_a, uavcan::NodeID(10), msg, tid);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    // The last subscription is gone, so is the transfer listener
+    ASSERT_EQ(0, hub.getNumSubscriptions());
+    ASSERT_FALSE(sub_a.isActive() || sub_b.isActive() || sub_c.isActive());
+    ASSERT_EQ(0, nodes.a.getDispatcher().getNumMessageListeners());
+    ASSERT_EQ(102, std::max(listener_a.uptimes.back(), std::max(listener_b.uptimes.back(),
+                                                                 listener_c.uptimes.back())));
+
+    /*
+     * Restart
+     */
+    listener_a.to_stop = NULL;
+    ASSERT_LE(0, sub_a.start(hub, listener_a.bind()));
+    ASSERT_EQ(1, nodes.a.getDispatcher().getNumMessageListeners());
+
+    const unsigned num_received = unsigned(listener_a.uptimes.size());
+    msg.uptime_sec = 103;
+    tid.increment();
+    emulateSingleFrameBroadcastTransfer(nodes.can_a, uavcan::NodeID(10), msg, tid);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(num_received + 1, listener_a.uptimes.size());
+    ASSERT_EQ(103, listener_a.uptimes.back());
+}
+
+TEST(SharedSubscriber, Lifetime)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    typedef uavcan::SharedSubscription<uavcan::protocol::NodeStatus, SharedSubscriptionListener::Binder> Subscription;
+
+    SharedSubscriptionListener listener;
+    Subscription sub_a;
+
+    {
+        uavcan::SharedSubscriber<uavcan::protocol::NodeStatus> hub(nodes.a);
+        ASSERT_LE(0, sub_a.start(hub, listener.bind()));
+        {
+            Subscription sub_b;
+            ASSERT_LE(0, sub_b.start(hub, listener.bind()));
+            ASSERT_EQ(2, hub.getNumSubscriptions());
+        }
+        ASSERT_EQ(1, hub.getNumSubscriptions());
+        ASSERT_EQ(1, nodes.a.getDispatcher().getNumMessageListeners());
+    }
+
+    // The subscription outlived the subscriber
+    ASSERT_FALSE(sub_a.isActive());
+    ASSERT_EQ(0, nodes.a.getDispatcher().getNumMessageListeners());
+    sub_a.stop();
+}
@@ -279,4 +279,11 @@ TEST(Subscriber, SingleFrameTransfer)
     {
         ASSERT_TRUE(listener.simple.at(i) == root_ns_a::EmptyMessage());
     }
+
+#if UAVCAN_LATENCY_HISTOGRAMS
+    // All frames were timestamped before the spin started
+    const uavcan::LatencyHistogram& latency = sub.getRxLatencyHistogram();
+    ASSERT_EQ(4, latency.getNumSamples());
+    ASSERT_GT(10000, latency.max_usec);
+#endif
 }
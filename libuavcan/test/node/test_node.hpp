@@ -20,18 +20,30 @@
 struct TestNode : public uavcan::INode
 {
     uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 100, uavcan::MemPoolBlockSize> pool;
+    uavcan::MemoryUsageTracker memory_usage;
     uavcan::OutgoingTransferRegistry<8> otr;
     uavcan::Scheduler scheduler;
     uint64_t internal_failure_count;
 
     TestNode(uavcan::ICanDriver& can_driver, uavcan::ISystemClock& clock_driver, uavcan::NodeID self_node_id)
-        : otr(pool)
-        , scheduler(can_driver, pool, clock_driver, otr)
+        : memory_usage(pool)
+        , otr(memory_usage.get(uavcan::MemoryConsumerOutgoingTransferRegistry))
+        , scheduler(can_driver, memory_usage.get(uavcan::MemoryConsumerCanTxQueue), clock_driver, otr)
         , internal_failure_count(0)
     {
         setNodeID(self_node_id);
     }
 
+    /**
+     * The node ID is not set, so that it can be assigned later.
+     */
+    TestNode(uavcan::ICanDriver& can_driver, uavcan::ISystemClock& clock_driver)
+        : memory_usage(pool)
+        , otr(memory_usage.get(uavcan::MemoryConsumerOutgoingTransferRegistry))
+        , scheduler(can_driver, memory_usage.get(uavcan::MemoryConsumerCanTxQueue), clock_driver, otr)
+        , internal_failure_count(0)
+    { }
+
     virtual void registerInternalFailure(const char* msg)
     {
         std::cout << "TestNode internal failure: " << msg << std::endl;
@@ -39,6 +51,19 @@ struct TestNode : public uavcan::INode
     }
 
     virtual uavcan::IPoolAllocator& getAllocator() { return pool; }
+    virtual uavcan::IPoolAllocator& getAllocatorFor(uavcan::MemoryConsumer consumer)
+    {
+        return memory_usage.get(consumer);
+    }
+    virtual const uavcan::InstrumentedPoolAllocator* getMemoryUsage(uavcan::MemoryConsumer consumer) const
+    {
+        return &memory_usage.get(consumer);
+    }
+    virtual int setMemoryQuota(uavcan::MemoryConsumer consumer, uavcan::uint16_t max_blocks)
+    {
+        memory_usage.get(consumer).setQuota(max_blocks);
+        return 0;
+    }
     virtual uavcan::Scheduler& getScheduler() { return scheduler; }
     virtual const uavcan::Scheduler& getScheduler() const { return scheduler; }
 };
@@ -114,7 +139,10 @@ struct PairableCanDriver : public uavcan::ICanDriver, public uavcan::ICanIface
         out_flags = 0;
         if (loopback_queue.empty())
         {
-            assert(read_queue.size());
+            if (read_queue.empty())
+            {
+                return 0;               // The dispatcher reads in batches until the RX buffer is empty
+            }
             out_frame = read_queue.front();
             read_queue.pop();
         }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/node/tx_completion_notifier.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include "../clock.hpp"
+#include "../transport/can/can.hpp"
+#include "test_node.hpp"
+
+#if !UAVCAN_TINY
+
+struct TxCompletionCollector
+{
+    typedef uavcan::MethodBinder<TxCompletionCollector*,
+                                 void (TxCompletionCollector::*)(const uavcan::TxCompletionEvent&)> Binder;
+
+    std::vector<uavcan::TxCompletionEvent> events;
+
+    void handle(const uavcan::TxCompletionEvent& event) { events.push_back(event); }
+
+    Binder bind() { return Binder(this, &TxCompletionCollector::handle); }
+};
+
+
+TEST(TxCompletionNotifier, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 1);
+
+    uavcan::Publisher<uavcan::protocol::NodeStatus> publisher(node);
+    uavcan::TxCompletionNotifier<TxCompletionCollector::Binder> notifier(node);
+    TxCompletionCollector collector;
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, notifier.start(publisher, TxCompletionCollector::Binder()));
+    ASSERT_FALSE(notifier.isActive());
+
+    ASSERT_LE(0, notifier.start(publisher, collector.bind()));
+    ASSERT_TRUE(notifier.isActive());
+    ASSERT_TRUE(publisher.getTransferSender().isInitialized());
+    ASSERT_TRUE(publisher.getTransferSender().getCanIOFlags() & uavcan::CanIOFlagLoopback);
+
+    /*
+     * One event per interface, timestamped by the driver
+     */
+    uavcan::protocol::NodeStatus msg;
+    ASSERT_LE(0, publisher.broadcast(msg));
+    clock_mock.advance(1000);
+    ASSERT_LE(0, publisher.broadcast(msg));
+
+    ASSERT_EQ(2, can_driver.ifaces.at(0).loopback.size());
+    ASSERT_EQ(2, can_driver.ifaces.at(1).loopback.size());
+
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_LE(0, node.getDispatcher().spinOnce());
+    }
+
+    ASSERT_EQ(4, collector.events.size());
+    unsigned num_per_iface[2] = { 0, 0 };
+    for (unsigned i = 0; i < collector.events.size(); i++)
+    {
+        const uavcan::TxCompletionEvent& ev = collector.events[i];
+        ASSERT_GT(2, ev.iface_index);
+        num_per_iface[ev.iface_index]++;
+        if (ev.transfer_id == uavcan::TransferID(0))
+        {
+            ASSERT_EQ(100, ev.ts_mono.toUSec());
+        }
+        else
+        {
+            ASSERT_EQ(uavcan::TransferID(1), ev.transfer_id);
+            ASSERT_EQ(1100, ev.ts_mono.toUSec());
+        }
+    }
+    ASSERT_EQ(2, num_per_iface[0]);
+    ASSERT_EQ(2, num_per_iface[1]);
+
+    /*
+     * Stopped - the loopback is no longer requested
+     */
+    notifier.stop();
+    ASSERT_FALSE(notifier.isActive());
+    ASSERT_FALSE(publisher.getTransferSender().getCanIOFlags() & uavcan::CanIOFlagLoopback);
+
+    ASSERT_LE(0, publisher.broadcast(msg));
+    ASSERT_TRUE(can_driver.ifaces.at(0).loopback.empty());
+    ASSERT_LE(0, node.getDispatcher().spinOnce());
+    ASSERT_EQ(4, collector.events.size());
+
+    /*
+     * The loopback that was enabled before is kept
+     */
+    publisher.getTransferSender().setCanIOFlags(uavcan::CanIOFlagLoopback);
+    ASSERT_LE(0, notifier.start(publisher, collector.bind()));
+    notifier.stop();
+    ASSERT_EQ(uavcan::CanIOFlagLoopback, publisher.getTransferSender().getCanIOFlags());
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/data_type_stats_publisher.hpp>
+#include "helpers.hpp"
+
+
+TEST(DataTypeStatsPublisher, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::DataTypeStatsPublisher dtsp(nodes.a);
+
+    SubscriberWithCollector<uavcan::protocol::debug::KeyValue> sub(nodes.b);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::KeyValue> _reg1;
+
+    ASSERT_LE(0, sub.start());
+
+    // Nothing has been sent yet
+    ASSERT_EQ(0, nodes.a.getDispatcher().getDataTypeStatsTable().getSize());
+
+    /*
+     * One-shot publishing; the publisher accounts for its own messages
+     */
+    const uavcan::DataTypeID dtid = uavcan::protocol::debug::KeyValue::DefaultDataTypeID;
+    ASSERT_LE(0, dtsp.publish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(sub.collector.msg.get());
+
+    char expected_key[32];
+    (void)uavcan::snprintf(expected_key, sizeof(expected_key), "dt.m%u.cbt", unsigned(dtid.get()));
+    ASSERT_STREQ(expected_key, sub.collector.msg->key.c_str());
+    ASSERT_FLOAT_EQ(0.0F, sub.collector.msg->value);
+
+    const uavcan::DataTypeStats* const stats =
+        nodes.a.getDispatcher().getDataTypeStatsTable().find(uavcan::DataTypeKindMessage, dtid);
+    ASSERT_TRUE(stats);
+    ASSERT_EQ(11, stats->transfers_tx);
+
+    // The receiving side has seen all of them
+    const uavcan::DataTypeStats* const rx_stats =
+        nodes.b.getDispatcher().getDataTypeStatsTable().find(uavcan::DataTypeKindMessage, dtid);
+    ASSERT_TRUE(rx_stats);
+    ASSERT_EQ(11, rx_stats->transfers_rx);
+    ASSERT_EQ(stats->frames_tx, rx_stats->frames_rx);
+    sub.collector.msg.reset();
+
+    /*
+     * Periodic publishing
+     */
+    ASSERT_FALSE(dtsp.isRunning());
+    dtsp.startPeriodic(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(dtsp.isRunning());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_TRUE(sub.collector.msg.get());
+    sub.collector.msg.reset();
+
+    dtsp.stop();
+    ASSERT_FALSE(dtsp.isRunning());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_FALSE(sub.collector.msg.get());
+}
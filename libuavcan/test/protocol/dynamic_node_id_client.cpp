@@ -177,3 +177,63 @@ TEST(DynamicNodeIDClient, NonPassiveMode)
 
     ASSERT_LE(-uavcan::ErrLogic, dnidac.start(hwver));
 }
+
+
+TEST(DynamicNodeIDClient, AdaptivePacing)
+{
+    // Node A emulates competing allocatees, Node B is the allocatee under test
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID::Broadcast, uavcan::NodeID::Broadcast);
+
+    uavcan::DynamicNodeIDClient dnidac(nodes.b);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::dynamic_node_id::Allocation> _reg1;
+    (void)_reg1;
+
+    uavcan::protocol::HardwareVersion hwver;
+    for (uavcan::uint8_t i = 0; i < hwver.unique_id.size(); i++)
+    {
+        hwver.unique_id[i] = i;
+    }
+
+    ASSERT_TRUE(dnidac.isAdaptivePacingEnabled());
+    ASSERT_LE(0, dnidac.start(hwver));
+    ASSERT_EQ(uavcan::DynamicNodeIDClient::InitialRequestWindowMSec, dnidac.getRequestWindowMSec());
+    ASSERT_EQ(uavcan::DynamicNodeIDClient::InitialFollowupWindowMSec, dnidac.getFollowupWindowMSec());
+
+    uavcan::Publisher<uavcan::protocol::dynamic_node_id::Allocation> competitor_pub(nodes.a);
+    ASSERT_LE(0, competitor_pub.init());
+    competitor_pub.allowAnonymousTransfers();
+
+    uavcan::protocol::dynamic_node_id::Allocation request;
+    request.first_part_of_unique_id = true;
+    request.unique_id.resize(uavcan::protocol::dynamic_node_id::Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST);
+
+    /*
+     * Two first-stage requests with no response in between - the request window is widened
+     */
+    request.unique_id[0] = 0xAA;
+    ASSERT_LE(0, competitor_pub.broadcast(request));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(uavcan::DynamicNodeIDClient::InitialRequestWindowMSec, dnidac.getRequestWindowMSec());
+
+    request.unique_id[0] = 0xBB;
+    ASSERT_LE(0, competitor_pub.broadcast(request));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(uavcan::DynamicNodeIDClient::InitialRequestWindowMSec * 2, dnidac.getRequestWindowMSec());
+
+    /*
+     * Saturation at the range defined by the specification
+     */
+    for (int i = 0; i < 5; i++)
+    {
+        request.unique_id[0] = uavcan::uint8_t(i);
+        ASSERT_LE(0, competitor_pub.broadcast(request));
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    }
+    ASSERT_EQ(uavcan::protocol::dynamic_node_id::Allocation::MAX_REQUEST_PERIOD_MS -
+              uavcan::protocol::dynamic_node_id::Allocation::MIN_REQUEST_PERIOD_MS,
+              dnidac.getRequestWindowMSec());
+
+    ASSERT_FALSE(dnidac.isAllocationComplete());
+}
@@ -18,13 +18,30 @@ class AllocationRequestHandler : public uavcan::dynamic_node_id_server::IAllocat
 public:
     bool can_followup;
 
-    AllocationRequestHandler() : can_followup(false) { }
+    uavcan::dynamic_node_id_server::AllocationRequestManager* manager;
+    uavcan::NodeID known_node_id;
+    std::vector<UniqueID> known_requests;
+
+    AllocationRequestHandler()
+        : can_followup(false)
+        , manager(NULL)
+    { }
 
     virtual void handleAllocationRequest(const UniqueID& unique_id, uavcan::NodeID preferred_node_id)
     {
         requests_.push_back(std::pair<UniqueID, uavcan::NodeID>(unique_id, preferred_node_id));
     }
 
+    virtual bool handleKnownAllocationRequest(const UniqueID& unique_id)
+    {
+        known_requests.push_back(unique_id);
+        if ((manager == NULL) || !known_node_id.isUnicast())
+        {
+            return false;
+        }
+        return manager->broadcastAllocationResponse(unique_id, known_node_id) >= 0;
+    }
+
     virtual bool canPublishFollowupAllocationResponse() const
     {
         return can_followup;
@@ -115,3 +132,119 @@ TEST(dynamic_node_id_server_AllocationRequestManager, Basic)
 
     ASSERT_EQ(PreferredNodeID, client.getAllocatedNodeID());
 }
+
+
+TEST(dynamic_node_id_server_AllocationRequestManager, KnownUniqueIDCache)
+{
+    using namespace uavcan::protocol::dynamic_node_id;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+    using namespace uavcan::dynamic_node_id_server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Allocation> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes(uavcan::NodeID(10), uavcan::NodeID::Broadcast);
+
+    uavcan::protocol::HardwareVersion hwver;
+    for (uavcan::uint8_t i = 0; i < hwver.unique_id.size(); i++)
+    {
+        hwver.unique_id[i] = i;
+    }
+    const uavcan::NodeID PreferredNodeID = 42;
+
+    EventTracer tracer;
+    AllocationRequestHandler handler;
+    handler.can_followup = true;
+
+    AllocationRequestManager manager(nodes.a, tracer, handler);
+    handler.manager = &manager;
+    ASSERT_LE(0, manager.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    /*
+     * Another node with the same first part of the unique ID, and an unrelated node
+     */
+    UniqueID similar_unique_id;
+    UniqueID other_unique_id;
+    for (uavcan::uint8_t i = 0; i < similar_unique_id.size(); i++)
+    {
+        similar_unique_id[i] = (i < Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST) ? i : 0xFF;
+        other_unique_id[i] = uavcan::uint8_t(0xA0 + i);
+    }
+    manager.addKnownUniqueID(other_unique_id);
+    manager.addKnownUniqueID(other_unique_id);
+    ASSERT_EQ(1, manager.getNumKnownUniqueIDs());
+
+    /*
+     * The first allocation requires the full exchange; the result is cached
+     */
+    {
+        uavcan::DynamicNodeIDClient client(nodes.b);
+        ASSERT_LE(0, client.start(hwver, PreferredNodeID));
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2000));
+
+        ASSERT_TRUE(handler.known_requests.empty());
+        ASSERT_TRUE(handler.matchAndPopLastRequest(hwver.unique_id, PreferredNodeID));
+        ASSERT_LE(0, manager.broadcastAllocationResponse(hwver.unique_id, PreferredNodeID));
+        handler.reset();                // The exchange may have been completed more than once meanwhile
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+        ASSERT_TRUE(client.isAllocationComplete());
+        ASSERT_EQ(2, manager.getNumKnownUniqueIDs());
+    }
+
+    /*
+     * The node restarts; it is served after the first stage
+     */
+    handler.known_node_id = PreferredNodeID;
+    {
+        uavcan::DynamicNodeIDClient client(nodes.b);
+        ASSERT_LE(0, client.start(hwver, PreferredNodeID));
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2000));
+
+        ASSERT_TRUE(client.isAllocationComplete());
+        ASSERT_EQ(PreferredNodeID, client.getAllocatedNodeID());
+
+        ASSERT_EQ(1, handler.known_requests.size());
+        ASSERT_TRUE(handler.known_requests[0] == hwver.unique_id);
+        ASSERT_FALSE(handler.matchAndPopLastRequest(hwver.unique_id, PreferredNodeID));    // No full exchange
+        ASSERT_EQ(1, tracer.countEvents(TraceAllocationFastPath));
+        ASSERT_EQ(Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST,
+                  tracer.getLastEventArgumentOrFail(TraceAllocationFastPath));
+    }
+
+    /*
+     * The first part of the unique ID becomes ambiguous, so the node is served after the second stage
+     */
+    manager.addKnownUniqueID(similar_unique_id);
+    handler.known_requests.clear();
+    {
+        uavcan::DynamicNodeIDClient client(nodes.b);
+        ASSERT_LE(0, client.start(hwver, PreferredNodeID));
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2000));
+
+        ASSERT_TRUE(client.isAllocationComplete());
+        ASSERT_EQ(1, handler.known_requests.size());
+        ASSERT_TRUE(handler.known_requests[0] == hwver.unique_id);
+        ASSERT_EQ(2, tracer.countEvents(TraceAllocationFastPath));
+        ASSERT_EQ(Allocation::MAX_LENGTH_OF_UNIQUE_ID_IN_REQUEST * 2,
+                  tracer.getLastEventArgumentOrFail(TraceAllocationFastPath));
+    }
+
+    /*
+     * The handler does not know the unique ID, so the full exchange is performed
+     */
+    handler.known_node_id = uavcan::NodeID();
+    handler.known_requests.clear();
+    {
+        uavcan::DynamicNodeIDClient client(nodes.b);
+        ASSERT_LE(0, client.start(hwver, PreferredNodeID));
+
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(2000));
+
+        ASSERT_TRUE(handler.matchAndPopLastRequest(hwver.unique_id, PreferredNodeID));
+        ASSERT_EQ(2, tracer.countEvents(TraceAllocationFastPath));
+    }
+}
@@ -91,8 +91,9 @@ TEST(dynamic_node_id_server_centralized_Storage, Basic)
 
     ASSERT_EQ("02000000000000000000000000000000", storage.get("occupation_mask"));
     ASSERT_EQ("1",                                storage.get("01000000000000000000000000000000"));
+    ASSERT_EQ("01000000000000000000000000000000", storage.get("node1_unique_id"));
 
-    ASSERT_EQ(2, storage.getNumKeys());
+    ASSERT_EQ(3, storage.getNumKeys());
     ASSERT_EQ(1, stor.getSize());
 
     /*
@@ -100,12 +101,13 @@ TEST(dynamic_node_id_server_centralized_Storage, Basic)
      */
     storage.failOnSetCalls(true);
 
-    ASSERT_EQ(2, storage.getNumKeys());
+    ASSERT_EQ(3, storage.getNumKeys());
 
     unique_id[0] = 2;
     ASSERT_GT(0, stor.add(2, unique_id));
 
-    ASSERT_EQ(2, storage.getNumKeys());  // No new entries, we failed
+    ASSERT_EQ(3, storage.getNumKeys());  // No new entries, we failed
+    ASSERT_FALSE(stor.getNodeIDForUniqueID(unique_id).isValid());
 
     ASSERT_EQ(1, stor.getSize());
 
@@ -128,3 +130,93 @@ TEST(dynamic_node_id_server_centralized_Storage, Basic)
 
     storage.print();
 }
+
+
+TEST(dynamic_node_id_server_centralized_Storage, InMemoryMirror)
+{
+    using namespace uavcan::dynamic_node_id_server::centralized;
+    using namespace uavcan::dynamic_node_id_server;
+
+    MemoryStorageBackend storage;
+
+    {
+        Storage stor(storage);
+        ASSERT_LE(0, stor.init());
+        for (uint8_t i = 1; i <= 127; i++)
+        {
+            UniqueID unique_id;
+            unique_id[0] = i;
+            unique_id[15] = uint8_t(i * 3U);
+            ASSERT_LE(0, stor.add(i, unique_id));
+        }
+    }
+
+    /*
+     * The mirror is loaded at initialization; after that the lookups do not need the backend.
+     * Removing the forward keys from the backend in order to make sure they are not used.
+     */
+    Storage stor(storage);
+    ASSERT_LE(0, stor.init());
+    ASSERT_EQ(127, stor.getSize());
+
+    for (uint8_t i = 1; i <= 127; i++)
+    {
+        UniqueID unique_id;
+        unique_id[0] = i;
+        unique_id[15] = uint8_t(i * 3U);
+        storage.set(StorageMarshaller::convertUniqueIDToHex(unique_id), "");
+    }
+
+    for (uint8_t i = 1; i <= 127; i++)
+    {
+        UniqueID unique_id;
+        unique_id[0] = i;
+        unique_id[15] = uint8_t(i * 3U);
+        ASSERT_EQ(i, stor.getNodeIDForUniqueID(unique_id).get());
+
+        unique_id[15]++;
+        ASSERT_FALSE(stor.getNodeIDForUniqueID(unique_id).isValid());
+    }
+
+    /*
+     * Re-allocation of the same unique ID under a lower node ID - the latest one wins, like in the backend
+     */
+    MemoryStorageBackend storage2;
+    UniqueID unique_id;
+    unique_id[0] = 42;
+    {
+        Storage stor2(storage2);
+        ASSERT_LE(0, stor2.init());
+        ASSERT_LE(0, stor2.add(100, unique_id));
+        ASSERT_LE(0, stor2.add(10, unique_id));
+
+        ASSERT_EQ("10", storage2.get(StorageMarshaller::convertUniqueIDToHex(unique_id)));
+        ASSERT_EQ(10, stor2.getNodeIDForUniqueID(unique_id).get());
+        ASSERT_TRUE(stor2.isNodeIDOccupied(10));
+        ASSERT_TRUE(stor2.isNodeIDOccupied(100));
+    }
+    {
+        Storage stor2(storage2);
+        ASSERT_LE(0, stor2.init());
+        ASSERT_EQ(2, stor2.getSize());
+        ASSERT_EQ(10, stor2.getNodeIDForUniqueID(unique_id).get());
+    }
+
+    /*
+     * And under a higher node ID, which is also the order of the mirror initialization
+     */
+    {
+        Storage stor2(storage2);
+        ASSERT_LE(0, stor2.init());
+        ASSERT_LE(0, stor2.add(120, unique_id));
+
+        ASSERT_EQ("120", storage2.get(StorageMarshaller::convertUniqueIDToHex(unique_id)));
+        ASSERT_EQ(120, stor2.getNodeIDForUniqueID(unique_id).get());
+    }
+    {
+        Storage stor2(storage2);
+        ASSERT_LE(0, stor2.init());
+        ASSERT_EQ(3, stor2.getSize());
+        ASSERT_EQ(120, stor2.getNodeIDForUniqueID(unique_id).get());
+    }
+}
@@ -175,6 +175,21 @@ TEST(dynamic_node_id_server_ClusterManager, ThreeServers)
     ASSERT_EQ(0, mgr.getNumKnownServers());
     ASSERT_FALSE(mgr.isClusterDiscovered());
 
+    /*
+     * Startup burst, every 100 ms
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_FALSE(sub.collector.msg.get());
+        nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+        ASSERT_TRUE(sub.collector.msg.get());
+        ASSERT_EQ(3, sub.collector.msg->configured_cluster_size);
+        ASSERT_EQ(1, sub.collector.msg->known_nodes.size());
+        ASSERT_EQ(1, sub.collector.msg->known_nodes[0]);
+        sub.collector.msg.reset();
+    }
+
     /*
      * Discovery publishing rate check
      */
@@ -260,3 +275,95 @@ TEST(dynamic_node_id_server_ClusterManager, ThreeServers)
     ASSERT_EQ(log.getLastIndex() + 1, mgr.getServerNextIndex(2));
     ASSERT_EQ(log.getLastIndex() + 1, mgr.getServerNextIndex(127));
 }
+
+
+TEST(dynamic_node_id_server_ClusterManager, RestoredServers)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::dynamic_node_id::server::Discovery> _reg1;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+    Log log(storage, tracer);
+
+    /*
+     * Storing the list of servers
+     */
+    {
+        InterlinkedTestNodesWithSysClock nodes;
+        ClusterManager mgr(nodes.a, storage, log, tracer);
+
+        ASSERT_LE(0, mgr.init(3, uavcan::TransferPriority::OneHigherThanLowest));
+        ASSERT_EQ(1, storage.getNumKeys());
+
+        mgr.addServer(2);
+        mgr.addServer(127);
+        ASSERT_TRUE(mgr.isClusterDiscovered());
+        ASSERT_EQ(2, storage.getNumKeys());
+    }
+
+    /*
+     * Restoring - the servers are available immediately, but the discovery is not complete until they are heard from
+     */
+    InterlinkedTestNodesWithSysClock nodes;
+
+    SubscriberWithCollector<uavcan::protocol::dynamic_node_id::server::Discovery> sub(nodes.b);
+    uavcan::Publisher<uavcan::protocol::dynamic_node_id::server::Discovery> pub(nodes.b);
+    ASSERT_LE(0, sub.start());
+    ASSERT_LE(0, pub.init());
+
+    ClusterManager mgr(nodes.a, storage, log, tracer);
+
+    ASSERT_LE(0, mgr.init(0, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_EQ(1, tracer.countEvents(uavcan::dynamic_node_id_server::TraceRaftServersRestored));
+
+    ASSERT_EQ(2, mgr.getNumKnownServers());
+    ASSERT_EQ(uavcan::NodeID(2),   mgr.getRemoteServerNodeIDAtIndex(0));
+    ASSERT_EQ(uavcan::NodeID(127), mgr.getRemoteServerNodeIDAtIndex(1));
+    ASSERT_EQ(log.getLastIndex() + 1, mgr.getServerNextIndex(127));
+    ASSERT_TRUE(mgr.isKnownServer(127));
+    ASSERT_FALSE(mgr.isClusterDiscovered());
+
+    // The restored servers are not advertised
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(1, sub.collector.msg->known_nodes.size());
+    sub.collector.msg.reset();
+
+    // Server 2 is heard from
+    uavcan::protocol::dynamic_node_id::server::Discovery msg;
+    msg.configured_cluster_size = 3;
+    msg.known_nodes.push_back(2U);
+    ASSERT_LE(0, pub.broadcast(msg));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_EQ(2, sub.collector.msg->known_nodes.size());
+    ASSERT_EQ(2, sub.collector.msg->known_nodes[1]);
+    sub.collector.msg.reset();
+    ASSERT_FALSE(mgr.isClusterDiscovered());
+
+    // Server 127 has been replaced with server 100, which takes its place
+    msg.known_nodes.push_back(100U);
+    ASSERT_LE(0, pub.broadcast(msg));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_TRUE(mgr.isClusterDiscovered());
+    ASSERT_EQ(2, mgr.getNumKnownServers());
+    ASSERT_EQ(uavcan::NodeID(2),   mgr.getRemoteServerNodeIDAtIndex(0));
+    ASSERT_EQ(uavcan::NodeID(100), mgr.getRemoteServerNodeIDAtIndex(1));
+    ASSERT_FALSE(mgr.isKnownServer(127));
+
+    /*
+     * The list is discarded if the cluster size has changed
+     */
+    {
+        InterlinkedTestNodesWithSysClock other_nodes;
+        ClusterManager other_mgr(other_nodes.a, storage, log, tracer);
+
+        ASSERT_LE(0, other_mgr.init(5, uavcan::TransferPriority::OneHigherThanLowest));
+        ASSERT_EQ(0, other_mgr.getNumKnownServers());
+    }
+}
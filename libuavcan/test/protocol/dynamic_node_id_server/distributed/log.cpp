@@ -2,6 +2,7 @@
  * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/dynamic_node_id_server/distributed/log.hpp>
 #include "../event_tracer.hpp"
@@ -138,7 +139,10 @@ TEST(dynamic_node_id_server_Log, Append)
     entry.term = 1;
     entry.node_id = 1;
     entry.unique_id[0] = 1;
+    const unsigned num_batches = storage.getNumBatches();
     ASSERT_LE(0, log.append(entry));
+    ASSERT_EQ(num_batches + 1, storage.getNumBatches());     // All keys of the entry are written in one batch
+    ASSERT_EQ(0, storage.getBatchDepth());
 
     ASSERT_EQ("1",                                storage.get("log_last_index"));
     ASSERT_EQ("1",                                storage.get("log1_term"));
@@ -185,6 +189,88 @@ TEST(dynamic_node_id_server_Log, Append)
 }
 
 
+TEST(dynamic_node_id_server_Log, BinaryRecords)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+
+    /*
+     * Text storage written by a backend that did not support binary values
+     */
+    storage.set("log_last_index", "1");
+    storage.set("log0_term",      "0");
+    storage.set("log0_unique_id", "00000000000000000000000000000000");
+    storage.set("log0_node_id",   "0");
+    storage.set("log1_term",      "1");
+    storage.set("log1_unique_id", "0123456789abcdef0123456789abcdef");
+    storage.set("log1_node_id",   "127");
+
+    storage.enableBinaryValues(true);
+
+    Log log(storage, tracer);
+    ASSERT_LE(0, log.init());
+    ASSERT_EQ(1, log.getLastIndex());
+    ASSERT_EQ(127, log.getEntryAtIndex(1)->node_id);
+    ASSERT_EQ(0xef, log.getEntryAtIndex(1)->unique_id[15]);
+
+    /*
+     * New entries are written as one record
+     */
+    uavcan::protocol::dynamic_node_id::server::Entry entry;
+    entry.term = 0x12345678;
+    entry.node_id = 42;
+    entry.unique_id[0] = 0;         // Zero bytes must survive
+    entry.unique_id[1] = ' ';
+    entry.unique_id[15] = 0xFF;
+    ASSERT_LE(0, log.append(entry));
+    ASSERT_EQ(2, log.getLastIndex());
+
+    ASSERT_EQ(8, storage.getNumKeys());     // Last index, two text entries, one binary entry
+    ASSERT_TRUE(storage.get("log2_term").empty());
+    const uavcan::dynamic_node_id_server::IStorageBackend::String record = storage.get("log2_entry");
+    ASSERT_EQ(24, record.size());
+    ASSERT_EQ(0x78, record[0]);
+    ASSERT_EQ(0x12, record[3]);
+    ASSERT_EQ(' ',  record[5]);
+    ASSERT_EQ(0xFF, record[19]);
+    ASSERT_EQ(42,   record[20]);
+
+    /*
+     * Both formats are restored
+     */
+    Log log2(storage, tracer);
+    ASSERT_LE(0, log2.init());
+    ASSERT_EQ(2, log2.getLastIndex());
+    ASSERT_EQ(127, log2.getEntryAtIndex(1)->node_id);
+    ASSERT_TRUE(entry == *log2.getEntryAtIndex(2));
+    ASSERT_EQ(2, log2.findLastIndexByNodeID(42));
+
+    /*
+     * Malformed record
+     */
+    uavcan::dynamic_node_id_server::IStorageBackend::String bad_record = record;
+    bad_record.pop_back();
+    storage.set("log2_entry", bad_record);
+    ASSERT_GT(0, log2.init());
+
+    bad_record = record;
+    bad_record[20] = 128;           // Invalid node ID
+    storage.set("log2_entry", bad_record);
+    ASSERT_GT(0, log2.init());
+
+    /*
+     * Write failure
+     */
+    storage.set("log2_entry", record);
+    ASSERT_LE(0, log2.init());
+    storage.failOnSetCalls(true);
+    entry.term++;
+    ASSERT_GT(0, log2.append(entry));
+    ASSERT_EQ(2, log2.getLastIndex());
+}
+
 TEST(dynamic_node_id_server_Log, Remove)
 {
     using namespace uavcan::dynamic_node_id_server::distributed;
@@ -241,3 +327,86 @@ TEST(dynamic_node_id_server_Log, Remove)
 
     storage.print();
 }
+
+
+static int findLastIndexByScanning(const uavcan::dynamic_node_id_server::distributed::Log& log,
+                                   const uavcan::protocol::dynamic_node_id::server::Entry& reference,
+                                   bool match_node_id)
+{
+    for (int index = log.getLastIndex(); index >= 0; index--)
+    {
+        const uavcan::protocol::dynamic_node_id::server::Entry* const entry = log.getEntryAtIndex(uint8_t(index));
+        if (match_node_id ? (entry->node_id == reference.node_id) : (entry->unique_id == reference.unique_id))
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+static void validateLogIndex(const uavcan::dynamic_node_id_server::distributed::Log& log)
+{
+    uavcan::protocol::dynamic_node_id::server::Entry reference;
+    for (unsigned i = 0; i <= 127; i++)
+    {
+        reference.node_id = uint8_t(i);
+        reference.unique_id[0] = uint8_t(i % 40);
+        reference.unique_id[15] = uint8_t(i % 3);
+
+        const int by_node_id = findLastIndexByScanning(log, reference, true);
+        const int by_unique_id = findLastIndexByScanning(log, reference, false);
+
+        ASSERT_EQ(by_node_id, std::max(-1, log.findLastIndexByNodeID(uint8_t(i))));
+        ASSERT_EQ(by_unique_id, std::max(-1, log.findLastIndexByUniqueID(reference.unique_id)));
+    }
+}
+
+TEST(dynamic_node_id_server_Log, Index)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+
+    EventTracer tracer;
+    MemoryStorageBackend storage;
+    Log log(storage, tracer);
+
+    ASSERT_LE(0, log.init());
+
+    // Entry zero is always there
+    ASSERT_EQ(0, log.findLastIndexByNodeID(0));
+    ASSERT_EQ(0, log.findLastIndexByUniqueID(uavcan::dynamic_node_id_server::UniqueID()));
+    ASSERT_GT(0, log.findLastIndexByNodeID(1));
+
+    /*
+     * Filling the log with entries that reuse node IDs and unique IDs, making sure the latest ones are found
+     */
+    uavcan::protocol::dynamic_node_id::server::Entry entry;
+    for (unsigned i = 1; i < Log::Capacity; i++)
+    {
+        entry.term = i;
+        entry.node_id = uint8_t(i % 50 + 1);
+        entry.unique_id[0] = uint8_t(i % 40);
+        entry.unique_id[15] = uint8_t(i % 3);
+        ASSERT_LE(0, log.append(entry));
+        validateLogIndex(log);
+    }
+
+    ASSERT_EQ(Log::Capacity - 1, log.findLastIndexByNodeID(entry.node_id));
+    ASSERT_EQ(Log::Capacity - 1, log.findLastIndexByUniqueID(entry.unique_id));
+
+    /*
+     * Removal
+     */
+    ASSERT_LE(0, log.removeEntriesWhereIndexGreaterOrEqual(70));
+    validateLogIndex(log);
+
+    ASSERT_LE(0, log.removeEntriesWhereIndexGreater(3));
+    validateLogIndex(log);
+
+    /*
+     * Restoring from the storage
+     */
+    Log restored_log(storage, tracer);
+    ASSERT_LE(0, restored_log.init());
+    ASSERT_EQ(3, restored_log.getLastIndex());
+    validateLogIndex(restored_log);
+}
@@ -185,6 +185,26 @@ TEST(dynamic_node_id_server_PersistentState, Basic)
     ASSERT_TRUE(pers.isVotedForSet());
     ASSERT_EQ("45", storage.get("voted_for"));
 
+    /*
+     * Changing current term and votedFor at once
+     */
+    unsigned num_batches = storage.getNumBatches();
+    ASSERT_LE(0, pers.setCurrentTermAndResetVotedFor(2));
+    ASSERT_EQ(num_batches + 1, storage.getNumBatches());      // Both keys are written in one batch
+    ASSERT_EQ(0, storage.getBatchDepth());
+    ASSERT_EQ(2, pers.getCurrentTerm());
+    ASSERT_FALSE(pers.isVotedForSet());
+    ASSERT_EQ("2", storage.get("current_term"));
+    ASSERT_EQ("0", storage.get("voted_for"));
+
+    num_batches = storage.getNumBatches();
+    ASSERT_LE(0, pers.setCurrentTermAndVotedFor(2, 45));
+    ASSERT_EQ(num_batches + 1, storage.getNumBatches());
+    ASSERT_EQ(2, pers.getCurrentTerm());
+    ASSERT_EQ(45, pers.getVotedFor().get());
+    ASSERT_EQ("2", storage.get("current_term"));
+    ASSERT_EQ("45", storage.get("voted_for"));
+
     /*
      * Handling errors
      */
@@ -198,6 +218,11 @@ TEST(dynamic_node_id_server_PersistentState, Basic)
     ASSERT_GT(0, pers.setVotedFor(78));
     ASSERT_EQ(45, pers.getVotedFor().get());
 
+    ASSERT_GT(0, pers.setCurrentTermAndVotedFor(7893, 78));
+    ASSERT_EQ(2, pers.getCurrentTerm());
+    ASSERT_EQ(45, pers.getVotedFor().get());
+    ASSERT_EQ(0, storage.getBatchDepth());
+
     ASSERT_EQ("1", storage.get("log_last_index"));
     ASSERT_EQ("2", storage.get("current_term"));
     ASSERT_EQ("45", storage.get("voted_for"));
@@ -115,6 +115,329 @@ TEST(dynamic_node_id_server_RaftCore, Basic)
 }
 
 
+TEST(dynamic_node_id_server_RaftCore, PreVote)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    EventTracer tracer_a("a");
+    EventTracer tracer_b("b");
+    MemoryStorageBackend storage_a;
+    MemoryStorageBackend storage_b;
+    CommitHandler commit_handler_a("a");
+    CommitHandler commit_handler_b("b");
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    std::auto_ptr<RaftCore> raft_a(new RaftCore(nodes.a, storage_a, tracer_a, commit_handler_a));
+    std::auto_ptr<RaftCore> raft_b(new RaftCore(nodes.b, storage_b, tracer_b, commit_handler_b));
+
+    ASSERT_LE(0, raft_a->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_LE(0, raft_b->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    ASSERT_TRUE(raft_a->isLeader() || raft_b->isLeader());
+    std::auto_ptr<RaftCore>& leader   = raft_a->isLeader() ? raft_a : raft_b;
+    std::auto_ptr<RaftCore>& follower = raft_a->isLeader() ? raft_b : raft_a;
+
+    const Term term = follower->getPersistentState().getCurrentTerm();
+    ASSERT_EQ(term, leader->getPersistentState().getCurrentTerm());
+
+    /*
+     * The follower holds the lease while the leader is alive
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(6000));
+    ASSERT_TRUE(leader->isLeader());
+    ASSERT_FALSE(follower->isLeader());
+    ASSERT_EQ(term, leader->getPersistentState().getCurrentTerm());
+    ASSERT_EQ(term, follower->getPersistentState().getCurrentTerm());
+
+    /*
+     * Terminating the leader - the follower can't collect the quorum of pre-votes, so it must not increment the
+     * term no matter how many times it tries
+     */
+    leader.reset();
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(15000));
+
+    ASSERT_FALSE(follower->isLeader());
+    ASSERT_EQ(term, follower->getPersistentState().getCurrentTerm());
+}
+
+
+/**
+ * Handles the vote requests the way the servers that don't implement pre-vote do.
+ */
+class LegacyVoter
+{
+    typedef uavcan::protocol::dynamic_node_id::server::RequestVote RequestVote;
+
+    typedef uavcan::MethodBinder<LegacyVoter*,
+                                 void (LegacyVoter::*)(const uavcan::ReceivedDataStructure<RequestVote::Request>&,
+                                                       uavcan::ServiceResponseDataStructure<RequestVote::Response>&)>
+        Callback;
+
+    uavcan::ServiceServer<RequestVote, Callback> srv_;
+
+    void handleRequest(const uavcan::ReceivedDataStructure<RequestVote::Request>& request,
+                       uavcan::ServiceResponseDataStructure<RequestVote::Response>& response)
+    {
+        num_requests++;
+        if (request.term > current_term)
+        {
+            current_term = request.term;
+            voted_for = uavcan::NodeID();
+        }
+        response.term = current_term;
+
+        // The index is compared as is, these servers know nothing about the pre-vote flag
+        const bool log_is_up_to_date = (request.last_log_term > last_log_term) ||
+            ((request.last_log_term == last_log_term) && (request.last_log_index >= last_log_index));
+
+        response.vote_granted = (request.term == current_term) && log_is_up_to_date &&
+            (!voted_for.isUnicast() || (voted_for == request.getSrcNodeID()));
+        if (response.vote_granted)
+        {
+            voted_for = request.getSrcNodeID();
+        }
+    }
+
+public:
+    uint32_t current_term;
+    uavcan::NodeID voted_for;
+    uint32_t last_log_term;
+    uint8_t last_log_index;
+    unsigned num_requests;
+
+    explicit LegacyVoter(uavcan::INode& node)
+        : srv_(node)
+        , current_term(0)
+        , last_log_term(0)
+        , last_log_index(0)
+        , num_requests(0)
+    { }
+
+    int start() { return srv_.start(Callback(this, &LegacyVoter::handleRequest)); }
+};
+
+
+TEST(dynamic_node_id_server_RaftCore, PreVoteMixedCluster)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    EventTracer tracer_a("a");
+    MemoryStorageBackend storage_a;
+    CommitHandler commit_handler_a("a");
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    /*
+     * The local server is in term 5 and has one entry in its log.
+     * The other server doesn't implement pre-vote; it has voted for some third server in this term, and its log
+     * is empty.
+     */
+    {
+        PersistentState state(storage_a, tracer_a);
+        ASSERT_LE(0, state.init());
+
+        Entry entry;
+        entry.term = 5;
+        entry.node_id = 42;
+        uavcan::fill_n(entry.unique_id.begin(), 16, uint8_t(0xAA));
+        ASSERT_LE(0, state.getLog().append(entry));
+        ASSERT_LE(0, state.setCurrentTerm(5));
+    }
+
+    LegacyVoter legacy(nodes.b);
+    legacy.current_term = 5;
+    legacy.voted_for = uavcan::NodeID(3);
+    ASSERT_LE(0, legacy.start());
+
+    std::auto_ptr<RaftCore> raft_a(new RaftCore(nodes.a, storage_a, tracer_a, commit_handler_a));
+    ASSERT_LE(0, raft_a->init(2, uavcan::TransferPriority::OneHigherThanLowest));
+    ASSERT_EQ(5, raft_a->getPersistentState().getCurrentTerm());
+
+    uavcan::Publisher<Discovery> discovery_pub(nodes.b);
+    Discovery discovery;
+    discovery.configured_cluster_size = 2;
+    discovery.known_nodes.push_back(nodes.b.getNodeID().get());
+    discovery.known_nodes.push_back(nodes.a.getNodeID().get());
+    ASSERT_LE(0, discovery_pub.broadcast(discovery));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_EQ(1, raft_a->getClusterManager().getNumKnownServers());
+
+    /*
+     * The legacy server rejects the pre-vote requests as stale, so its state is not affected, and the local server
+     * can't collect the quorum, so it stays in its term
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    ASSERT_LT(0, legacy.num_requests);
+    ASSERT_EQ(5, legacy.current_term);
+    ASSERT_EQ(3, legacy.voted_for.get());
+
+    ASSERT_FALSE(raft_a->isLeader());
+    ASSERT_EQ(5, raft_a->getPersistentState().getCurrentTerm());
+
+    /*
+     * The legacy server campaigns without pre-vote. Its log is behind, so it doesn't get the vote, but now the local
+     * server knows that pre-vote would never pass.
+     */
+    legacy.current_term = 6;
+    legacy.voted_for = nodes.b.getNodeID();
+
+    ServiceClientWithCollector<RequestVote> legacy_client(nodes.b);
+    RequestVote::Request request;
+    request.term = 6;
+    ASSERT_LE(0, legacy_client.call(nodes.a.getNodeID(), request));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(legacy_client.collector.result.get());
+    ASSERT_TRUE(legacy_client.collector.result->isSuccessful());
+    ASSERT_FALSE(legacy_client.collector.result->getResponse().vote_granted);
+    ASSERT_EQ(6, legacy_client.collector.result->getResponse().term);
+
+    /*
+     * The local server skips pre-vote and wins a regular election, since its log is up to date
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(9000));
+
+    ASSERT_TRUE(raft_a->isLeader());
+    ASSERT_EQ(7, raft_a->getPersistentState().getCurrentTerm());
+    ASSERT_EQ(7, legacy.current_term);
+    ASSERT_EQ(nodes.a.getNodeID(), legacy.voted_for);
+}
+
+
+TEST(dynamic_node_id_server_RaftCore, ParallelReplication)
+{
+    using namespace uavcan::dynamic_node_id_server::distributed;
+    using namespace uavcan::protocol::dynamic_node_id::server;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<Discovery> _reg1;
+    uavcan::DefaultDataTypeRegistrator<AppendEntries> _reg2;
+    uavcan::DefaultDataTypeRegistrator<RequestVote> _reg3;
+
+    static const unsigned NumServers = 3;
+    static const unsigned NumEntries = 5;
+
+    TestNetwork<NumServers> nodes;
+
+    std::auto_ptr<EventTracer> tracers[NumServers];
+    std::auto_ptr<MemoryStorageBackend> storages[NumServers];
+    std::auto_ptr<CommitHandler> commit_handlers[NumServers];
+    std::auto_ptr<RaftCore> rafts[NumServers];
+
+    for (unsigned i = 0; i < NumServers; i++)
+    {
+        const std::string id(1, char('a' + i));
+        tracers[i].reset(new EventTracer(id));
+        storages[i].reset(new MemoryStorageBackend);
+        commit_handlers[i].reset(new CommitHandler(id));
+        rafts[i].reset(new RaftCore(nodes[i], *storages[i], *tracers[i], *commit_handlers[i]));
+        ASSERT_LE(0, rafts[i]->init(NumServers, uavcan::TransferPriority::OneHigherThanLowest));
+    }
+
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(9000));
+
+    unsigned leader_index = NumServers;
+    for (unsigned i = 0; i < NumServers; i++)
+    {
+        if (rafts[i]->isLeader())
+        {
+            ASSERT_EQ(NumServers, leader_index);          // Only one leader
+            leader_index = i;
+        }
+    }
+    ASSERT_GT(NumServers, leader_index);
+    RaftCore& leader = *rafts[leader_index];
+    ASSERT_EQ(NumServers - 1, leader.getClusterManager().getNumKnownServers());
+
+    /*
+     * A burst of allocations, more than fits into one AppendEntries request
+     */
+    for (unsigned i = 0; i < NumEntries; i++)
+    {
+        Entry::FieldTypes::unique_id unique_id;
+        uavcan::fill_n(unique_id.begin(), 16, uint8_t(i + 1));
+        leader.appendLog(unique_id, uavcan::NodeID(uint8_t(100 + i)));
+    }
+    ASSERT_EQ(NumEntries, leader.getPersistentState().getLog().getLastIndex());
+
+    /*
+     * The followers are spun in the reverse order, and the first one is also spun much less often than the others,
+     * so that its responses arrive after the responses of the other follower and often after the leader has moved
+     * on to the next update interval. The indices of the followers must stay consistent regardless.
+     */
+    const uavcan::NodeID follower_ids[] =
+    {
+        leader.getClusterManager().getRemoteServerNodeIDAtIndex(0),
+        leader.getClusterManager().getRemoteServerNodeIDAtIndex(1)
+    };
+    Log::Index prev_match_indices[] = { 0, 0 };
+
+    for (unsigned iteration = 0; iteration < 6000; iteration++)
+    {
+        ASSERT_LE(0, nodes[leader_index].spin(uavcan::MonotonicDuration::fromMSec(1)));
+        for (unsigned i = NumServers; i --> 0;)
+        {
+            if (i == leader_index)
+            {
+                continue;
+            }
+            const bool slow = nodes[i].getNodeID() == follower_ids[0];
+            if (!slow || ((iteration % 700) == 0))
+            {
+                ASSERT_LE(0, nodes[i].spin(uavcan::MonotonicDuration::fromMSec(1)));
+            }
+        }
+
+        ASSERT_TRUE(leader.isLeader());
+        for (unsigned i = 0; i < 2; i++)
+        {
+            const Log::Index next_index = leader.getClusterManager().getServerNextIndex(follower_ids[i]);
+            const Log::Index match_index = leader.getClusterManager().getServerMatchIndex(follower_ids[i]);
+            ASSERT_LE(prev_match_indices[i], match_index);                   // Never goes back
+            ASSERT_LT(match_index, next_index);
+            ASSERT_GE(NumEntries + 1, next_index);
+            prev_match_indices[i] = match_index;
+        }
+        ASSERT_GE(NumEntries, leader.getCommitIndex());
+    }
+
+    /*
+     * Eventually the whole log gets replicated to both followers and committed everywhere
+     */
+    nodes.spinAll(uavcan::MonotonicDuration::fromMSec(6000));
+
+    ASSERT_TRUE(leader.isLeader());
+    for (unsigned i = 0; i < 2; i++)
+    {
+        ASSERT_EQ(NumEntries + 1, leader.getClusterManager().getServerNextIndex(follower_ids[i]));
+        ASSERT_EQ(NumEntries, leader.getClusterManager().getServerMatchIndex(follower_ids[i]));
+    }
+    for (unsigned i = 0; i < NumServers; i++)
+    {
+        ASSERT_EQ(NumEntries, rafts[i]->getPersistentState().getLog().getLastIndex());
+        ASSERT_EQ(NumEntries, rafts[i]->getCommitIndex());
+    }
+}
+
+
 TEST(dynamic_node_id_server_Server, Basic)
 {
     using namespace uavcan::dynamic_node_id_server;
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <map>
+#include <gtest/gtest.h>
 #include <uavcan/protocol/dynamic_node_id_server/storage_backend.hpp>
 
 class MemoryStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
@@ -13,10 +14,16 @@ class MemoryStorageBackend : public uavcan::dynamic_node_id_server::IStorageBack
     Container container_;
 
     bool fail_;
+    bool binary_;
+    unsigned batch_depth_;
+    unsigned num_batches_;
 
 public:
     MemoryStorageBackend()
         : fail_(false)
+        , binary_(false)
+        , batch_depth_(0)
+        , num_batches_(0)
     { }
 
     virtual String get(const String& key) const
@@ -37,8 +44,28 @@ public:
         }
     }
 
+    virtual void beginBatch() { batch_depth_++; }
+
+    virtual void endBatch()
+    {
+        EXPECT_LT(0, batch_depth_);
+        batch_depth_--;
+        if (batch_depth_ == 0)
+        {
+            num_batches_++;
+        }
+    }
+
+    virtual bool supportsBinaryValues() const { return binary_; }
+
     void failOnSetCalls(bool really) { fail_ = really; }
 
+    void enableBinaryValues(bool really) { binary_ = really; }
+
+    unsigned getBatchDepth() const { return batch_depth_; }
+
+    unsigned getNumBatches() const { return num_batches_; }
+
     void reset() { container_.clear(); }
 
     unsigned getNumKeys() const { return unsigned(container_.size()); }
@@ -285,3 +285,67 @@ TEST(dynamic_node_id_server_NodeDiscoverer, Sizes)
               << sizeof(Subscriber<protocol::NodeStatus,
                                    void (*)(const ReceivedDataStructure<protocol::NodeStatus>&), 64, 0>) << std::endl;
 }
+
+
+TEST(dynamic_node_id_server_NodeDiscoverer, ManyNodes)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    static const unsigned NumNodes = 12;
+
+    EventTracer tracer;
+    TestNetwork<NumNodes + 1> nodes;
+    NodeDiscoveryHandler handler;
+
+    NodeDiscoverer disc(nodes[0], tracer, handler);
+    ASSERT_LE(0, disc.init(uavcan::TransferPriority::OneHigherThanLowest));
+
+    /*
+     * All nodes appear at once, discovery is disabled
+     */
+    std::vector<uavcan::Publisher<uavcan::protocol::NodeStatus>*> node_status_pubs;
+    std::vector<GetNodeInfoMockServer*> get_node_info_servers;
+
+    for (unsigned i = 1; i <= NumNodes; i++)
+    {
+        get_node_info_servers.push_back(new GetNodeInfoMockServer(nodes[i]));
+        get_node_info_servers.back()->response.hardware_version.unique_id[0] = uint8_t(nodes[i].getNodeID().get());
+        ASSERT_LE(0, get_node_info_servers.back()->start());
+
+        node_status_pubs.push_back(new uavcan::Publisher<uavcan::protocol::NodeStatus>(nodes[i]));
+        ASSERT_LE(0, node_status_pubs.back()->init());
+        ASSERT_LE(0, node_status_pubs.back()->broadcast(uavcan::protocol::NodeStatus()));
+    }
+
+    ASSERT_LE(0, nodes.spinAll(uavcan::MonotonicDuration::fromMSec(100)));
+
+    ASSERT_EQ(NumNodes, disc.getNumUnknownNodes());
+    ASSERT_EQ(NumNodes, tracer.countEvents(TraceDiscoveryNewNodeFound));
+    ASSERT_EQ(0, tracer.countEvents(TraceDiscoveryGetNodeInfoRequest));
+
+    /*
+     * Enabling discovery - the nodes are queried in the order of their node ID
+     */
+    handler.can_discover = true;
+
+    ASSERT_LE(0, nodes.spinAll(uavcan::MonotonicDuration::fromMSec(3000)));
+
+    ASSERT_FALSE(disc.hasUnknownNodes());
+    ASSERT_EQ(NumNodes, tracer.countEvents(TraceDiscoveryGetNodeInfoRequest));
+    ASSERT_EQ(0, tracer.countEvents(TraceDiscoveryGetNodeInfoFailure));
+    ASSERT_EQ(NumNodes, handler.nodes.size());
+
+    for (unsigned i = 0; i < NumNodes; i++)
+    {
+        ASSERT_EQ(nodes[i + 1].getNodeID(), handler.nodes.at(i).node_id);
+        ASSERT_EQ(nodes[i + 1].getNodeID().get(), handler.nodes.at(i).unique_id[0]);
+    }
+
+    for (unsigned i = 0; i < NumNodes; i++)
+    {
+        delete node_status_pubs.at(i);
+        delete get_node_info_servers.at(i);
+    }
+}
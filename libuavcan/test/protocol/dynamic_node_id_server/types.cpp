@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/dynamic_node_id_server/types.hpp>
+
+
+TEST(dynamic_node_id_server_PackedUniqueID, Basic)
+{
+    using namespace uavcan::dynamic_node_id_server;
+
+    UniqueID uid;
+    for (uint8_t i = 0; i < uid.size(); i++)
+    {
+        uid[i] = uint8_t(i * 17U + 1U);
+    }
+
+    const PackedUniqueID packed(uid);
+    ASSERT_FALSE(packed.isZero());
+    ASSERT_TRUE(PackedUniqueID().isZero());
+    ASSERT_TRUE(uid == packed.toUniqueID());
+    ASSERT_TRUE(packed == PackedUniqueID(packed.toUniqueID()));
+
+    // Every byte matters
+    for (uint8_t i = 0; i < uid.size(); i++)
+    {
+        UniqueID other = uid;
+        other[i] ^= 0x80;
+        ASSERT_TRUE(packed != PackedUniqueID(other));
+        ASSERT_NE(packed.computeHash(), PackedUniqueID(other).computeHash());
+    }
+}
+
+
+TEST(dynamic_node_id_server_PackedUniqueID, Prefix)
+{
+    using namespace uavcan::dynamic_node_id_server;
+
+    UniqueID uid;
+    for (uint8_t i = 0; i < uid.size(); i++)
+    {
+        uid[i] = uint8_t(0xF0U - i);
+    }
+    const PackedUniqueID packed(uid);
+
+    for (unsigned len = 0; len <= PackedUniqueID::NumBytes; len++)
+    {
+        uavcan::Array<uavcan::IntegerSpec<8, uavcan::SignednessUnsigned, uavcan::CastModeTruncate>,
+                      uavcan::ArrayModeDynamic, 16> prefix;
+        for (unsigned i = 0; i < len; i++)
+        {
+            prefix.push_back(uid[i]);
+        }
+        ASSERT_TRUE(packed.hasPrefix(PackedUniqueID(prefix), len));
+
+        if (len > 0)
+        {
+            prefix[len - 1] = uint8_t(prefix[len - 1] + 1U);
+            ASSERT_FALSE(packed.hasPrefix(PackedUniqueID(prefix), len));
+            ASSERT_TRUE(packed.hasPrefix(PackedUniqueID(prefix), len - 1));
+        }
+    }
+}
@@ -2,6 +2,8 @@
  * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/file_server.hpp>
 #include "helpers.hpp"
@@ -134,3 +136,213 @@ TEST(FileServer, Basic)
 
     // TODO TEST
 }
+
+
+class DeferredWriteFileServerBackend : public TestFileServerBackend
+{
+public:
+    uavcan::ServiceReplyContext pending_context;
+    uavcan::IFileWriteCompletionListener* pending_listener;
+    std::string written_data;
+
+    DeferredWriteFileServerBackend() : pending_listener(NULL) { }
+
+    virtual int16_t beginWrite(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size,
+                               const uavcan::ServiceReplyContext& context,
+                               uavcan::IFileWriteCompletionListener& listener)
+    {
+        if (path != file_name)
+        {
+            return Error::NOT_FOUND;            // Completed immediately
+        }
+        (void)offset;
+        written_data.assign(reinterpret_cast<const char*>(buffer), size);
+        pending_context = context;
+        pending_listener = &listener;
+        return WriteInProgress;
+    }
+
+    void complete(int16_t error)
+    {
+        ASSERT_TRUE(pending_listener != NULL);
+        pending_listener->handleFileWriteCompletion(pending_context, error);
+        pending_listener = NULL;
+    }
+};
+
+TEST(FileServer, DeferredWrite)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+    uavcan::DefaultDataTypeRegistrator<Write> _reg3;
+    uavcan::DefaultDataTypeRegistrator<Delete> _reg4;
+    uavcan::DefaultDataTypeRegistrator<GetDirectoryEntryInfo> _reg5;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    DeferredWriteFileServerBackend backend;
+
+    uavcan::FileServer serv(nodes.a, backend);
+    ASSERT_LE(0, serv.start());
+
+    ServiceClientWithCollector<Write> write(nodes.b);
+
+    /*
+     * Completed immediately
+     */
+    Write::Request write_req;
+    write_req.path.path = "nonexistent";
+    write_req.data = "abc";
+
+    ASSERT_LE(0, write.call(1, write_req));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_TRUE(write.collector.result.get());
+    ASSERT_TRUE(write.collector.result->isSuccessful());
+    ASSERT_EQ(Error::NOT_FOUND, write.collector.result->getResponse().error.value);
+    ASSERT_TRUE(backend.pending_listener == NULL);
+
+    /*
+     * Deferred - no response until the backend reports the completion
+     */
+    write.collector.result.reset();
+    write_req.path.path = "test";
+
+    ASSERT_LE(0, write.call(1, write_req));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_FALSE(write.collector.result.get());
+    ASSERT_TRUE(write.client.hasPendingCalls());
+    ASSERT_EQ("abc", backend.written_data);
+
+    backend.complete(Error::IO_ERROR);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+
+    ASSERT_TRUE(write.collector.result.get());
+    ASSERT_TRUE(write.collector.result->isSuccessful());
+    ASSERT_EQ(Error::IO_ERROR, write.collector.result->getResponse().error.value);
+}
+
+
+class BigFileServerBackend : public TestFileServerBackend
+{
+public:
+    enum { BigFileSize = 1000 };
+
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        if (path == "big")
+        {
+            out_size = BigFileSize;
+            out_type.flags = EntryType::FLAG_FILE | EntryType::FLAG_READABLE;
+            return 0;
+        }
+        return TestFileServerBackend::getInfo(path, out_size, out_type);
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        if (path == "big")
+        {
+            inout_size = uint16_t(std::min(uint64_t(inout_size), (offset < BigFileSize) ? (BigFileSize - offset) : 0));
+            std::memset(out_buffer, 'x', inout_size);
+            return 0;
+        }
+        return TestFileServerBackend::read(path, offset, out_buffer, inout_size);
+    }
+};
+
+struct RecordingReadListener : public uavcan::IFileServerReadListener
+{
+    std::vector<std::string> paths;
+
+    virtual void handleFileRead(uavcan::NodeID, const uavcan::IFileServerBackend::Path& path, uint64_t, uint16_t)
+    {
+        paths.push_back(path.c_str());
+    }
+};
+
+TEST(BasicFileServer, ReadScheduler)
+{
+    using namespace uavcan::protocol::file;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<GetInfo> _reg1;
+    uavcan::DefaultDataTypeRegistrator<Read> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    BigFileServerBackend backend;
+    RecordingReadListener listener;
+
+    uavcan::FileReadScheduler<4> scheduler(nodes.a);
+    scheduler.setMaxResponsesPerRound(1);
+
+    uavcan::BasicFileServer serv(nodes.a, backend);
+    serv.setReadListener(&listener);
+    serv.setReadScheduler(&scheduler);
+    ASSERT_LE(0, serv.start());
+
+    ServiceClientWithCollector<Read> read_first(nodes.b);
+    ServiceClientWithCollector<Read> read_big(nodes.b);
+    ServiceClientWithCollector<Read> read_small(nodes.b);
+
+    /*
+     * One response per round; the reader that is closer to the end of its file is served first.
+     * The first request may be served before the others arrive, but it has less data remaining than the big one.
+     */
+    Read::Request req;
+    req.path.path = "test";
+    ASSERT_LE(0, read_first.call(1, req));
+    req.path.path = "big";
+    ASSERT_LE(0, read_big.call(1, req));
+    req.path.path = "test";
+    req.offset = 4;
+    ASSERT_LE(0, read_small.call(1, req));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(5));
+    ASSERT_LE(1, scheduler.getNumPendingReads());
+    ASSERT_FALSE(read_big.collector.result.get());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(0, scheduler.getNumPendingReads());
+    ASSERT_EQ(0, scheduler.getNumOverflows());
+
+    ASSERT_EQ(3, listener.paths.size());
+    ASSERT_EQ("test", listener.paths[0]);
+    ASSERT_EQ("test", listener.paths[1]);
+    ASSERT_EQ("big", listener.paths[2]);
+
+    ASSERT_TRUE(read_first.collector.result.get());
+    ASSERT_EQ("123456789", read_first.collector.result->getResponse().data);
+
+    ASSERT_TRUE(read_small.collector.result.get());
+    ASSERT_TRUE(read_small.collector.result->isSuccessful());
+    ASSERT_EQ("56789", read_small.collector.result->getResponse().data);
+
+    ASSERT_TRUE(read_big.collector.result.get());
+    ASSERT_TRUE(read_big.collector.result->isSuccessful());
+    ASSERT_EQ(256, read_big.collector.result->getResponse().data.size());
+
+    /*
+     * An overdue request is served before the ones with less data remaining
+     */
+    scheduler.setMaxQueueingDelay(uavcan::MonotonicDuration::fromMSec(0));
+    read_big.collector.result.reset();
+    read_small.collector.result.reset();
+    listener.paths.clear();
+
+    req.path.path = "big";
+    req.offset = 0;
+    ASSERT_LE(0, read_big.call(1, req));
+    req.path.path = "test";
+    ASSERT_LE(0, read_small.call(1, req));
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(2, listener.paths.size());
+    ASSERT_EQ("big", listener.paths[0]);
+    ASSERT_EQ("test", listener.paths[1]);
+}
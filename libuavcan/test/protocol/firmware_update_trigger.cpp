@@ -283,6 +283,7 @@ TEST(FirmwareUpdateTrigger, MultiNode)
 
     ASSERT_TRUE(trigger.isTimerRunning());
     ASSERT_EQ(3, trigger.getNumPendingNodes());
+    ASSERT_EQ(1, trigger.getNumFirmwarePaths());       // All three share the same path
 
     ASSERT_EQ(4, checker.should_request_cnt);
     ASSERT_EQ(0, checker.should_retry_cnt);
@@ -322,6 +323,7 @@ TEST(FirmwareUpdateTrigger, MultiNode)
 
     nodes.spinAll(uavcan::MonotonicDuration::fromMSec(1000));
     ASSERT_EQ(0, trigger.getNumPendingNodes());         // All removed now
+    ASSERT_EQ(0, trigger.getNumFirmwarePaths());
 
     EXPECT_EQ(4, checker.should_request_cnt);
     EXPECT_EQ(4, checker.should_retry_cnt);
@@ -334,3 +336,62 @@ TEST(FirmwareUpdateTrigger, MultiNode)
 
     ASSERT_FALSE(trigger.isTimerRunning());
 }
+
+
+TEST(FirmwareUpdateTrigger, Orchestrated)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<BeginFirmwareUpdate> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg3;
+
+    TestNetwork<4> nodes;
+
+    // The trigger node admits one node at a time
+    FirmwareVersionChecker checker;
+    uavcan::NodeInfoRetriever node_info_retriever(nodes[0]);
+    uavcan::FirmwareUpdateTrigger trigger(nodes[0], checker);
+    trigger.setMaxConcurrentUpdates(1);
+    trigger.setUpdateInactivityTimeout(uavcan::MonotonicDuration::fromMSec(1500));
+
+    // The client nodes, all of them confirm the request
+    std::auto_ptr<uavcan::NodeStatusProvider> providers[3];
+    std::auto_ptr<uavcan::ServiceServer<BeginFirmwareUpdate, BeginFirmwareUpdateServer::Callback> > servers[3];
+    BeginFirmwareUpdateServer server_impls[3];
+
+    ASSERT_LE(0, trigger.start(node_info_retriever, "/path_prefix/"));
+    ASSERT_LE(0, node_info_retriever.start());
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        uavcan::protocol::HardwareVersion hwver;
+        hwver.unique_id[0] = uint8_t(i + 1);
+        providers[i].reset(new uavcan::NodeStatusProvider(nodes[i + 1]));
+        providers[i]->setHardwareVersion(hwver);
+        providers[i]->setName("Victor");
+        ASSERT_LE(0, providers[i]->startAndPublish());
+
+        servers[i].reset(new uavcan::ServiceServer<BeginFirmwareUpdate, BeginFirmwareUpdateServer::Callback>(
+            nodes[i + 1]));
+        ASSERT_LE(0, servers[i]->start(server_impls[i].makeCallback()));
+    }
+
+    checker.expected_node_name_to_update = "Victor";
+    checker.firmware_path = "abc";
+
+    /*
+     * Every node holds the slot until the inactivity timeout expires, since there's no file server
+     */
+    for (unsigned i = 0; i < 30; i++)
+    {
+        nodes.spinAll(uavcan::MonotonicDuration::fromMSec(500));
+        ASSERT_GE(1, trigger.getNumActiveUpdates());
+    }
+
+    EXPECT_EQ(3, checker.should_request_cnt);
+    EXPECT_EQ(0, checker.should_retry_cnt);
+    EXPECT_EQ(3, checker.confirmation_cnt);
+    EXPECT_EQ(0, trigger.getNumPendingNodes());
+    EXPECT_EQ(0, trigger.getNumActiveUpdates());
+    EXPECT_FALSE(trigger.isTimerRunning());
+}
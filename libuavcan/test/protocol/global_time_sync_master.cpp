@@ -129,3 +129,94 @@ TEST(GlobalTimeSyncMaster, Basic)
     ASSERT_TRUE(slave.isActive());
     ASSERT_EQ(nwk.master_high.node.getNodeID(), slave.getMasterNodeID());
 }
+
+
+static uavcan::Frame popSyncFrame(CanIfaceMock& iface)
+{
+    uavcan::Frame frame;
+    EXPECT_FALSE(iface.tx.empty());
+    if (!iface.tx.empty())
+    {
+        EXPECT_TRUE(iface.tx.front().flags & uavcan::CanIOFlagLoopback);
+        EXPECT_TRUE(frame.parse(iface.tx.front().frame));
+        iface.tx.pop();
+    }
+    return frame;
+}
+
+TEST(GlobalTimeSyncMaster, RedundantInterfaces)
+{
+    SystemClockMock clock(1000000);
+    CanDriverMock driver(2, clock);
+    TestNode node(driver, clock, 120);
+    driver.ifaces.at(0).enable_utc_timestamping = true;     // The loopback frames carry the TX timestamps
+    driver.ifaces.at(1).enable_utc_timestamping = true;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GlobalTimeSync> _reg1;
+
+    uavcan::GlobalTimeSyncMaster master(node);
+    ASSERT_LE(0, master.init());
+
+    const uavcan::TransferPerfCounter& perf = node.getDispatcher().getTransferPerfCounter();
+    const uavcan::DataTypeStats* const stats =
+        node.getDispatcher().getDataTypeStatsTable().find(uavcan::DataTypeKindMessage,
+                                                          uavcan::protocol::GlobalTimeSync::DefaultDataTypeID);
+    ASSERT_TRUE(stats);
+
+    /*
+     * Both frames are handed over to the driver by the publish() call itself, sharing the Transfer ID
+     */
+    ASSERT_LE(0, master.publish());
+    ASSERT_EQ(1, driver.ifaces.at(0).tx.size());
+    ASSERT_EQ(1, driver.ifaces.at(1).tx.size());
+    for (unsigned i = 0; i < 2; i++)
+    {
+        const uavcan::Frame frame = popSyncFrame(driver.ifaces.at(i));
+        ASSERT_EQ(uavcan::protocol::GlobalTimeSync::DefaultDataTypeID, frame.getDataTypeID().get());
+        ASSERT_EQ(uavcan::TransferTypeMessageBroadcast, frame.getTransferType());
+        ASSERT_EQ(node.getNodeID(), frame.getSrcNodeID());
+        ASSERT_TRUE(frame.isStartOfTransfer() && frame.isEndOfTransfer());
+        ASSERT_EQ(0, frame.getTransferID().get());
+    }
+
+    // Accounted as one transfer per interface, as if there were a publisher per interface
+    ASSERT_EQ(2, perf.getTxTransferCount());
+    ASSERT_EQ(2, stats->transfers_tx);
+    ASSERT_EQ(2, stats->frames_tx);
+    ASSERT_EQ(0, perf.getErrorCount());
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(1)));    // Loopback processing
+
+    /*
+     * The next publication uses the next Transfer ID on both interfaces
+     */
+    clock.advance(uavcan::protocol::GlobalTimeSync::MIN_BROADCASTING_PERIOD_MS * 1000);
+    ASSERT_LE(0, master.publish());
+    ASSERT_EQ(1, popSyncFrame(driver.ifaces.at(0)).getTransferID().get());
+    ASSERT_EQ(1, popSyncFrame(driver.ifaces.at(1)).getTransferID().get());
+    ASSERT_EQ(4, perf.getTxTransferCount());
+    ASSERT_EQ(4, stats->frames_tx);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(1)));
+
+    /*
+     * A driver failure on one interface does not prevent publication via the other one; the rejected frame
+     * stays in the TX queue of its interface, same as a frame of a regular transfer
+     */
+    driver.ifaces.at(0).tx_failure = true;
+    clock.advance(uavcan::protocol::GlobalTimeSync::MIN_BROADCASTING_PERIOD_MS * 1000);
+    ASSERT_LE(0, master.publish());
+    ASSERT_TRUE(driver.ifaces.at(0).tx.empty());
+    ASSERT_EQ(1, node.getDispatcher().getCanIOManager().getNumPendingTxFrames(0));
+    ASSERT_EQ(2, popSyncFrame(driver.ifaces.at(1)).getTransferID().get());
+    ASSERT_EQ(6, perf.getTxTransferCount());
+    ASSERT_EQ(6, stats->transfers_tx);
+    ASSERT_EQ(6, stats->frames_tx);
+
+    // Once the interface recovers, the queued frame leaves with the Transfer ID it was compiled with
+    driver.ifaces.at(0).tx_failure = false;
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(1)));
+    ASSERT_EQ(0, node.getDispatcher().getCanIOManager().getNumPendingTxFrames(0));
+    ASSERT_EQ(2, popSyncFrame(driver.ifaces.at(0)).getTransferID().get());
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());
+    ASSERT_EQ(6, perf.getTxTransferCount());
+}
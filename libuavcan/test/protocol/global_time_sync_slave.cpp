@@ -312,3 +312,94 @@ TEST(GlobalTimeSyncSlave, Suppression)
     ASSERT_EQ(8, gtss.getMasterNodeID().get());
     ASSERT_EQ(0, slave_clock.utc);                  // The clock shall not be asjusted
 }
+
+
+/**
+ * Emulates a master broadcasting every second with a slave whose clock runs 50 ppm fast; the RX timestamps have
+ * a few microseconds of jitter, and every 10th one is delayed by 3 ms. Returns the largest adjustment of the slave
+ * clock after the warm-up period.
+ */
+static uavcan::int64_t runClockDisciplineScenario(bool discipline_enabled,
+                                                  uavcan::GlobalTimeSyncSlave::ClockDisciplineStatistics& out_stats)
+{
+    SystemClockMock slave_clock;
+    slave_clock.monotonic = 1000000;
+    slave_clock.utc = 5000000;
+    slave_clock.preserve_utc = true;
+
+    CanDriverMock slave_can(1, slave_clock);
+    slave_can.ifaces.at(0).enable_utc_timestamping = true;
+
+    TestNode node(slave_can, slave_clock, 64);
+
+    uavcan::GlobalTimeSyncSlave gtss(node);
+    gtss.setClockDisciplineEnabled(discipline_enabled);
+    EXPECT_EQ(discipline_enabled, gtss.isClockDisciplineEnabled());
+    EXPECT_LE(0, gtss.start());
+
+    const uavcan::uint64_t master_utc_base = 1000000000;
+    uavcan::uint32_t rng = 42;
+    uavcan::int64_t max_adjustment = 0;
+
+    for (unsigned i = 0; i < 200; i++)
+    {
+        rng = rng * 1103515245U + 12345U;
+        uavcan::int64_t jitter = uavcan::int64_t((rng >> 16) % 7U) - 3;
+        if ((i >= 20) && (i % 10 == 0))
+        {
+            jitter += 3000;
+        }
+
+        const uavcan::uint64_t prev_tx_usec = (i == 0) ? 0 : (master_utc_base + (i - 1) * 1000000ULL);
+        slave_clock.last_adjustment = uavcan::UtcDuration();
+
+        slave_clock.utc = uavcan::uint64_t(uavcan::int64_t(slave_clock.utc) + jitter);
+        broadcastSyncMsg(slave_can.ifaces.at(0), prev_tx_usec, 8, uavcan::TransferID(uavcan::uint8_t(i % 32)));
+        EXPECT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+        slave_clock.utc = uavcan::uint64_t(uavcan::int64_t(slave_clock.utc) - jitter);
+
+        if (i >= 60)
+        {
+            max_adjustment = std::max(max_adjustment, std::abs(slave_clock.last_adjustment.toUSec()));
+        }
+
+        slave_clock.monotonic += 990000;
+        slave_clock.utc += 1000050;
+    }
+
+    EXPECT_TRUE(gtss.isActive());
+    out_stats = gtss.getClockDisciplineStatistics();
+    return max_adjustment;
+}
+
+
+TEST(GlobalTimeSyncSlave, ClockDiscipline)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GlobalTimeSync> _reg1;
+
+    uavcan::GlobalTimeSyncSlave::ClockDisciplineStatistics stats;
+
+    /*
+     * Plain adjustment - the delayed timestamps are translated into UTC jumps
+     */
+    ASSERT_LE(2000, runClockDisciplineScenario(false, stats));
+    ASSERT_EQ(0, stats.num_adjustments);
+
+    /*
+     * Clock discipline - the outliers are rejected, the frequency error is compensated
+     */
+    const uavcan::int64_t max_adjustment = runClockDisciplineScenario(true, stats);
+    std::cout << "Max adjustment: " << max_adjustment << " usec, frequency error: " << stats.frequency_error_ppb
+              << " ppb, jitter: " << stats.offset_jitter_usec << " usec, last offset: " << stats.last_offset_usec
+              << " usec, adjustments: " << stats.num_adjustments << ", outliers: " << stats.num_outliers
+              << ", steps: " << stats.num_steps << std::endl;
+
+    ASSERT_GT(200, max_adjustment);
+    ASSERT_TRUE(stats.locked);
+    ASSERT_GT(10, std::abs(stats.last_offset_usec));
+    ASSERT_GT(2000, std::abs(stats.frequency_error_ppb + 50000));
+    ASSERT_LT(50, stats.num_adjustments);
+    ASSERT_LE(5, stats.num_outliers);
+    ASSERT_EQ(1, stats.num_steps);
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <limits>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/log_record.hpp>
+
+#if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
+# error UAVCAN_CPP_VERSION
+#endif
+
+TEST(LogRecord, FormatID)
+{
+    ASSERT_EQ(0x811C9DC5U, uavcan::LogRecordEncoder::computeFormatID(""));
+    ASSERT_EQ(0x811C9DC5U, uavcan::LogRecordEncoder::computeFormatID(NULL));
+    ASSERT_EQ(0xE40C292CU, uavcan::LogRecordEncoder::computeFormatID("a"));
+    ASSERT_NE(uavcan::LogRecordEncoder::computeFormatID("%* %*"), uavcan::LogRecordEncoder::computeFormatID("%*%*"));
+}
+
+#if UAVCAN_CPP_VERSION >= UAVCAN_CPP11
+
+typedef uavcan::MakeString<200>::Type Text;
+
+/**
+ * Encodes the arguments into a record, renders it back, and compares the text with the output of the formatter.
+ */
+template <typename... Args>
+static ::testing::AssertionResult checkRoundtrip(const char* format, Args... args)
+{
+    Text expected;
+    uavcan::CharArrayFormatter<Text>(expected).write(format, args...);
+
+    uint8_t buffer[200];
+    uavcan::LogRecordEncoder encoder(buffer, sizeof(buffer));
+    encoder.write(args...);
+    if (encoder.isTruncated())
+    {
+        return ::testing::AssertionFailure() << "truncated";
+    }
+
+    Text rendered;
+    const int res = uavcan::LogRecordRenderer<Text>(rendered).render(format, buffer, encoder.getSize());
+    if (res < 0)
+    {
+        return ::testing::AssertionFailure() << "render error " << res;
+    }
+    if (!(rendered == expected))
+    {
+        return ::testing::AssertionFailure() << "'" << rendered.c_str() << "' != '" << expected.c_str() << "'";
+    }
+    return ::testing::AssertionSuccess() << rendered.c_str();
+}
+
+TEST(LogRecord, Roundtrip)
+{
+    ASSERT_TRUE(checkRoundtrip("No arguments"));
+    ASSERT_TRUE(checkRoundtrip("%% %* %%", 123));
+    ASSERT_TRUE(checkRoundtrip("%*,%*,%*,%*", 0, -1, 1, std::numeric_limits<int>::min()));
+    ASSERT_TRUE(checkRoundtrip("%* %*", std::numeric_limits<long long>::min(), std::numeric_limits<long long>::max()));
+    ASSERT_TRUE(checkRoundtrip("%* %*", std::numeric_limits<unsigned long long>::max(), uint8_t(200)));
+    ASSERT_TRUE(checkRoundtrip("%* %* %*", int8_t(-128), true, false));
+    ASSERT_TRUE(checkRoundtrip("char='%*'", '$'));
+    ASSERT_TRUE(checkRoundtrip("%* %* %* %*", 12.34, -0.0, 1e-300, std::numeric_limits<double>::infinity()));
+    ASSERT_TRUE(checkRoundtrip("%* %* %*", 1.5F, std::numeric_limits<float>::max(), 0.1F));
+    ASSERT_TRUE(checkRoundtrip("%* %*", std::numeric_limits<double>::quiet_NaN(), 1.0L));
+    ASSERT_TRUE(checkRoundtrip("'%*' '%*' '%*'", "string", "", static_cast<const char*>(NULL)));
+    ASSERT_TRUE(checkRoundtrip("%*", reinterpret_cast<const void*>(0x12345678)));
+
+    // Insufficient and extra arguments
+    ASSERT_TRUE(checkRoundtrip("%* %* %% %*", 1));
+    ASSERT_TRUE(checkRoundtrip("%*", 1, 2, "three"));
+}
+
+TEST(LogRecord, Encoding)
+{
+    uint8_t buffer[16];
+    uavcan::LogRecordEncoder encoder(buffer, sizeof(buffer));
+
+    encoder.write(300U, -2, 'a');
+    ASSERT_FALSE(encoder.isTruncated());
+    ASSERT_EQ(7, encoder.getSize());
+
+    const uint8_t expected[] =
+    {
+        uavcan::LogRecordEncoder::ArgUnsigned, 0xAC, 0x02,
+        uavcan::LogRecordEncoder::ArgSigned, 0x03,
+        uavcan::LogRecordEncoder::ArgChar, 'a'
+    };
+    ASSERT_EQ(0, std::memcmp(expected, buffer, sizeof(expected)));
+}
+
+TEST(LogRecord, Truncation)
+{
+    uint8_t buffer[12];
+
+    // The string is truncated to fit, the next arguments are dropped
+    {
+        uavcan::LogRecordEncoder encoder(buffer, sizeof(buffer));
+        encoder.write(1, "0123456789abcdef", 2);
+        ASSERT_TRUE(encoder.isTruncated());
+        ASSERT_EQ(12, encoder.getSize());
+
+        Text text;
+        ASSERT_EQ(0, uavcan::LogRecordRenderer<Text>(text).render("%* '%*' %*", buffer, encoder.getSize()));
+        ASSERT_STREQ("1 '01234567' %*", text.c_str());
+    }
+
+    // The arguments are never split
+    {
+        uavcan::LogRecordEncoder encoder(buffer, sizeof(buffer));
+        encoder.write(1.0, 2.0);
+        ASSERT_TRUE(encoder.isTruncated());
+        ASSERT_EQ(9, encoder.getSize());
+
+        Text text;
+        ASSERT_EQ(0, uavcan::LogRecordRenderer<Text>(text).render("%* %*", buffer, encoder.getSize()));
+        ASSERT_STREQ("1 %*", text.c_str());
+    }
+
+    // Nothing fits
+    {
+        uavcan::LogRecordEncoder encoder(buffer, 0);
+        encoder.write('a');
+        ASSERT_TRUE(encoder.isTruncated());
+        ASSERT_EQ(0, encoder.getSize());
+    }
+}
+
+TEST(LogRecord, Malformed)
+{
+    Text text;
+    uavcan::LogRecordRenderer<Text> renderer(text);
+
+    const uint8_t bad_tag[] = { 0xFF };
+    ASSERT_GT(0, renderer.render("%*", bad_tag, sizeof(bad_tag)));
+
+    const uint8_t unterminated_varint[] = { uavcan::LogRecordEncoder::ArgUnsigned, 0x80 };
+    ASSERT_GT(0, renderer.render("%*", unterminated_varint, sizeof(unterminated_varint)));
+
+    const uint8_t short_double[] = { uavcan::LogRecordEncoder::ArgDouble, 0, 0, 0 };
+    ASSERT_GT(0, renderer.render("%*", short_double, sizeof(short_double)));
+
+    const uint8_t unterminated_string[] = { uavcan::LogRecordEncoder::ArgString, 'a', 'b' };
+    ASSERT_GT(0, renderer.render("%*", unterminated_string, sizeof(unterminated_string)));
+}
+
+#endif
@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 #include <uavcan/protocol/logger.hpp>
+#include <root_ns_a/LogRecord.hpp>
 #include "helpers.hpp"
 
 
@@ -117,6 +118,74 @@ TEST(Logger, Basic)
     ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::DEBUG,   "foo", "Debug"));
 }
 
+TEST(Logger, AsyncMode)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::LogMessage> _reg1;
+
+    uavcan::Logger logger(nodes.a);
+    logger.setLevel(uavcan::protocol::debug::LogLevel::DEBUG);
+    ASSERT_LE(0, logger.init());
+
+    LogSink sink;
+    sink.level = uavcan::protocol::debug::LogLevel::DEBUG;
+    logger.setExternalSink(&sink);
+
+    SubscriberWithCollector<uavcan::protocol::debug::LogMessage> log_sub(nodes.b);
+    ASSERT_LE(0, log_sub.start());
+
+    uavcan::protocol::debug::LogMessage queue[3];
+    ASSERT_FALSE(logger.isAsyncModeEnabled());
+    ASSERT_EQ(-uavcan::ErrInvalidParam, logger.enableAsyncMode(NULL, 3));
+    ASSERT_EQ(-uavcan::ErrInvalidParam, logger.enableAsyncMode(queue, 0));
+    ASSERT_EQ(0, logger.enableAsyncMode(queue, 3, uavcan::MonotonicDuration::fromMSec(50)));
+    ASSERT_TRUE(logger.isAsyncModeEnabled());
+
+    // Only three messages fit into the buffer; the sink receives everything immediately
+    ASSERT_EQ(0, logger.logInfo("foo", "0"));
+    ASSERT_EQ(0, logger.logInfo("foo", "1"));
+    ASSERT_EQ(0, logger.logInfo("foo", "2"));
+    ASSERT_EQ(-uavcan::ErrMemory, logger.logInfo("foo", "3"));
+    ASSERT_EQ(-uavcan::ErrMemory, logger.logInfo("foo", "4"));
+    ASSERT_EQ(3, logger.getNumPendingMessages());
+    ASSERT_EQ(2, logger.getNumDroppedMessages());
+    ASSERT_EQ(5, sink.msgs.size());
+
+    // Nothing has been sent from the logging calls
+    ASSERT_TRUE(nodes.can_b.read_queue.empty());
+    ASSERT_FALSE(log_sub.collector.msg.get());
+
+    // The first message goes out at the next spin, the rest are rate limited
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(log_sub.collector.msg.get());
+    ASSERT_EQ(log_sub.collector.msg->text, "0");
+    ASSERT_EQ(2, logger.getNumPendingMessages());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(log_sub.collector.msg->text, "0");
+    ASSERT_EQ(2, logger.getNumPendingMessages());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_EQ(log_sub.collector.msg->text, "1");
+    ASSERT_EQ(1, logger.getNumPendingMessages());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(60));
+    ASSERT_EQ(log_sub.collector.msg->text, "2");
+    ASSERT_EQ(0, logger.getNumPendingMessages());
+
+    // Disabling the asynchronous mode discards the pending messages
+    ASSERT_EQ(0, logger.logInfo("foo", "5"));
+    logger.disableAsyncMode();
+    ASSERT_FALSE(logger.isAsyncModeEnabled());
+    ASSERT_EQ(3, logger.getNumDroppedMessages());
+
+    ASSERT_LE(0, logger.logInfo("foo", "6"));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(log_sub.collector.msg->text, "6");
+}
+
 #if !defined(UAVCAN_CPP_VERSION) || !defined(UAVCAN_CPP11)
 # error UAVCAN_CPP_VERSION
 #endif
@@ -141,4 +210,90 @@ TEST(Logger, Cpp11Formatting)
     ASSERT_EQ(log_sub.collector.msg->text, "char='$', double is 12.34");
 }
 
+TEST(Logger, Records)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::LogMessage> _reg1;
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::LogRecord> _reg2;
+
+    uavcan::Logger logger(nodes.a);
+    logger.setLevel(uavcan::protocol::debug::LogLevel::INFO);
+    ASSERT_LE(0, logger.init());
+
+    uavcan::LogRecordPublisher<root_ns_a::LogRecord> record_pub(nodes.a);
+    ASSERT_LE(0, record_pub.init());
+    ASSERT_EQ(32, record_pub.getMaxArgumentsSize());
+
+    ASSERT_FALSE(logger.getRecordSink());
+    logger.setRecordSink(&record_pub);
+    ASSERT_EQ(&record_pub, logger.getRecordSink());
+
+    LogSink sink;
+    logger.setExternalSink(&sink);
+
+    SubscriberWithCollector<uavcan::protocol::debug::LogMessage> log_sub(nodes.b);
+    SubscriberWithCollector<root_ns_a::LogRecord> record_sub(nodes.b);
+    ASSERT_LE(0, log_sub.start());
+    ASSERT_LE(0, record_sub.start());
+
+    // Record only, the text is not needed by the external sink
+    const char* const format = "%* is %*, %*";
+    ASSERT_LE(0, logger.logWarning("foo", format, "double", 12.34, -5));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_FALSE(log_sub.collector.msg.get());
+    ASSERT_TRUE(sink.msgs.empty());
+    ASSERT_TRUE(record_sub.collector.msg.get());
+    ASSERT_EQ(uavcan::protocol::debug::LogLevel::WARNING, record_sub.collector.msg->level.value);
+    ASSERT_EQ(uavcan::LogRecordEncoder::computeFormatID(format), record_sub.collector.msg->format_id);
+    ASSERT_EQ(record_sub.collector.msg->source, "foo");
+
+    // The receiving side renders the text
+    {
+        uavcan::protocol::debug::LogMessage::FieldTypes::text text;
+        uint8_t args[32];
+        const unsigned args_size = record_sub.collector.msg->args.size();
+        for (unsigned i = 0; i < args_size; i++)
+        {
+            args[i] = record_sub.collector.msg->args[i];
+        }
+        uavcan::LogRecordRenderer<uavcan::protocol::debug::LogMessage::FieldTypes::text> renderer(text);
+        ASSERT_EQ(0, renderer.render(format, args, args_size));
+        ASSERT_EQ(text, "double is 12.34, -5");
+    }
+
+    // Record and text for the external sink
+    record_sub.collector.msg.reset();
+    sink.level = uavcan::protocol::debug::LogLevel::ERROR;
+    ASSERT_LE(0, logger.logError("foo", "Error %*", 42));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_FALSE(log_sub.collector.msg.get());
+    ASSERT_TRUE(record_sub.collector.msg.get());
+    ASSERT_EQ(uavcan::LogRecordEncoder::computeFormatID("Error %*"), record_sub.collector.msg->format_id);
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::ERROR, "foo", "Error 42"));
+
+    // Below the broadcasting level - text for the external sink only
+    record_sub.collector.msg.reset();
+    sink.level = uavcan::protocol::debug::LogLevel::DEBUG;
+    ASSERT_EQ(0, logger.logDebug("foo", "Debug %*", 1));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_FALSE(record_sub.collector.msg.get());
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::DEBUG, "foo", "Debug 1"));
+
+    // Arguments that don't fit into the record are dropped
+    ASSERT_LE(0, logger.logInfo("foo", "%* %* %* %* %*", 1.0, 2.0, 3.0, 4.0, 5.0));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(record_sub.collector.msg.get());
+    ASSERT_EQ(27, record_sub.collector.msg->args.size());
+    ASSERT_TRUE(sink.popMatchByLevelAndText(uavcan::protocol::debug::LogLevel::INFO, "foo", "1 2 3 4 5"));
+
+    // Removing the record sink restores the text broadcasting
+    logger.setRecordSink(NULL);
+    ASSERT_LE(0, logger.logInfo("foo", "Info %*", 2));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(log_sub.collector.msg.get());
+    ASSERT_EQ(log_sub.collector.msg->text, "Info 2");
+}
+
 #endif
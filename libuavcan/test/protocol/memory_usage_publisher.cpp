@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/memory_usage_publisher.hpp>
+#include "helpers.hpp"
+
+
+TEST(MemoryUsagePublisher, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::MemoryUsagePublisher mup(nodes.a);
+
+    SubscriberWithCollector<uavcan::protocol::debug::KeyValue> sub(nodes.b);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::KeyValue> _reg1;
+
+    ASSERT_LE(0, sub.start());
+
+    // Nothing has been transmitted yet
+    ASSERT_EQ(0, nodes.a.getMemoryUsage(uavcan::MemoryConsumerCanTxQueue)->getPeakNumUsedBlocks());
+
+    /*
+     * One-shot publishing; the last published value is the number of failures of the last consumer
+     */
+    ASSERT_LE(0, mup.publish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_STREQ("mem.other.fail", sub.collector.msg->key.c_str());
+    ASSERT_FLOAT_EQ(0.0F, sub.collector.msg->value);
+    sub.collector.msg.reset();
+
+    // The driver is always ready to transmit, so the frames bypassed the TX queue
+    ASSERT_EQ(0, nodes.a.getMemoryUsage(uavcan::MemoryConsumerCanTxQueue)->getPeakNumUsedBlocks());
+
+
+    /*
+     * Periodic publishing
+     */
+    ASSERT_FALSE(mup.isRunning());
+    mup.startPeriodic(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(mup.isRunning());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_TRUE(sub.collector.msg.get());
+    sub.collector.msg.reset();
+
+    mup.stop();
+    ASSERT_FALSE(mup.isRunning());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_FALSE(sub.collector.msg.get());
+}
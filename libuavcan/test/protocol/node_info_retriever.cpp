@@ -31,11 +31,17 @@ struct NodeInfoListener : public uavcan::INodeInfoListener
     unsigned status_message_cnt;
     unsigned status_change_cnt;
     unsigned info_unavailable_cnt;
+    unsigned info_retrieved_cnt;
+    unsigned info_unchanged_cnt;
+    bool skip_unchanged;
 
     NodeInfoListener()
         : status_message_cnt(0)
         , status_change_cnt(0)
         , info_unavailable_cnt(0)
+        , info_retrieved_cnt(0)
+        , info_unchanged_cnt(0)
+        , skip_unchanged(false)
     { }
 
     virtual void handleNodeInfoRetrieved(uavcan::NodeID node_id,
@@ -44,6 +50,17 @@ struct NodeInfoListener : public uavcan::INodeInfoListener
         last_node_id = node_id;
         std::cout << node_info << std::endl;
         last_node_info.reset(new uavcan::protocol::GetNodeInfo::Response(node_info));
+        info_retrieved_cnt++;
+    }
+
+    virtual void handleNodeInfoUnchanged(uavcan::NodeID node_id,
+                                         const uavcan::protocol::GetNodeInfo::Response& node_info)
+    {
+        info_unchanged_cnt++;
+        if (!skip_unchanged)
+        {
+            uavcan::INodeInfoListener::handleNodeInfoUnchanged(node_id, node_info);
+        }
     }
 
     virtual void handleNodeInfoUnavailable(uavcan::NodeID node_id)
@@ -114,8 +131,8 @@ TEST(NodeInfoRetriever, Basic)
     /*
      * Waiting for discovery
      */
-    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
-    ASSERT_TRUE(retr.isRetrievingInProgress());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));  // The timer stops as soon as the response arrives
+    ASSERT_FALSE(retr.isRetrievingInProgress());
     nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
     ASSERT_FALSE(retr.isRetrievingInProgress());
 
@@ -254,6 +271,11 @@ TEST(NodeInfoRetriever, MaxConcurrentRequests)
 
     ASSERT_EQ(40, retr.getRequestInterval().toMSec());
 
+    ASSERT_EQ(13, retr.getMaxConcurrentRequests());
+    retr.setMaxConcurrentRequests(0);                   // Coerced to one
+    ASSERT_EQ(1, retr.getMaxConcurrentRequests());
+    retr.setMaxConcurrentRequests(13);
+
     const unsigned MaxPendingRequests = 14;             // See class docs
     const unsigned MinPendingRequestsAtFullLoad = 12;
 
@@ -290,3 +312,126 @@ TEST(NodeInfoRetriever, MaxConcurrentRequests)
     ASSERT_EQ(0, retr.getNumPendingRequests());
     ASSERT_FALSE(retr.isRetrievingInProgress());
 }
+
+
+/**
+ * Emulates a restart of the node, so that the retriever requests the node info again.
+ */
+static void restartNodeStatusProvider(std::auto_ptr<uavcan::NodeStatusProvider>& provider, uavcan::INode& node,
+                                      const char* name)
+{
+    provider.reset();
+    provider.reset(new uavcan::NodeStatusProvider(node));
+
+    uavcan::protocol::HardwareVersion hwver;
+    hwver.major = 3;
+    hwver.unique_id[0] = 42;
+    provider->setHardwareVersion(hwver);
+
+    uavcan::protocol::SoftwareVersion swver;
+    swver.major = 1;
+    swver.minor = 2;
+    swver.optional_field_flags = uavcan::protocol::SoftwareVersion::OPTIONAL_FIELD_FLAG_VCS_COMMIT;
+    swver.vcs_commit = 0xDEADBEEF;
+    swver.image_crc = 0x0123456789ABCDEFULL;
+    provider->setSoftwareVersion(swver);
+
+    provider->setName(name);
+    ASSERT_LE(0, provider->startAndPublish());
+}
+
+
+TEST(NodeInfoRetriever, Cache)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::NodeInfoRetriever retr(nodes.a);
+    std::auto_ptr<uavcan::NodeStatusProvider> provider;
+    NodeInfoListener listener;
+
+    std::cout << "sizeof(uavcan::NodeInfoSummary): " << sizeof(uavcan::NodeInfoSummary) << std::endl;
+
+    ASSERT_LE(0, retr.start());
+    retr.addListener(&listener);
+
+    ASSERT_FALSE(retr.isNodeInfoCacheEnabled());
+    retr.setNodeInfoCacheEnabled(true);
+    ASSERT_TRUE(retr.isNodeInfoCacheEnabled());
+
+    /*
+     * First response is always delivered as a new one
+     */
+    restartNodeStatusProvider(provider, nodes.b, "Ivan");
+    ASSERT_FALSE(retr.getCachedNodeInfo(2));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+    ASSERT_FALSE(retr.isRetrievingInProgress());
+
+    ASSERT_EQ(1, listener.info_retrieved_cnt);
+    ASSERT_EQ(0, listener.info_unchanged_cnt);
+    ASSERT_EQ(1, retr.getNumCachedNodeInfos());
+
+    const uavcan::NodeInfoSummary* const summary = retr.getCachedNodeInfo(2);
+    ASSERT_TRUE(summary);
+    ASSERT_EQ(1, summary->software_version_major);
+    ASSERT_EQ(2, summary->software_version_minor);
+    ASSERT_EQ(0xDEADBEEF, summary->software_vcs_commit);
+    ASSERT_EQ(0x0123456789ABCDEFULL, summary->getSoftwareImageCRC());
+    ASSERT_EQ(3, summary->hardware_version_major);
+    ASSERT_EQ(42, summary->hardware_unique_id[0]);
+    ASSERT_EQ(uavcan::NodeInfoSummary::computeHash(*listener.last_node_info), summary->hash);
+
+    ASSERT_FALSE(retr.getCachedNodeInfo(3));
+    ASSERT_FALSE(retr.getCachedNodeInfo(uavcan::NodeID()));
+
+    /*
+     * Restart with the same info, the listener skips it
+     */
+    listener.skip_unchanged = true;
+    restartNodeStatusProvider(provider, nodes.b, "Ivan");
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_EQ(1, listener.info_retrieved_cnt);
+    ASSERT_EQ(1, listener.info_unchanged_cnt);
+
+    /*
+     * Same info again, the default implementation of the unchanged handler forwards the call
+     */
+    listener.skip_unchanged = false;
+    restartNodeStatusProvider(provider, nodes.b, "Ivan");
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_EQ(2, listener.info_retrieved_cnt);
+    ASSERT_EQ(2, listener.info_unchanged_cnt);
+
+    /*
+     * The name has changed
+     */
+    restartNodeStatusProvider(provider, nodes.b, "Peter");
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_EQ(3, listener.info_retrieved_cnt);
+    ASSERT_EQ(2, listener.info_unchanged_cnt);
+    ASSERT_EQ("Peter", listener.last_node_info->name);
+    ASSERT_EQ(1, retr.getNumCachedNodeInfos());
+
+    /*
+     * Disabling and invalidation
+     */
+    retr.setNodeInfoCacheEnabled(false);
+    ASSERT_EQ(0, retr.getNumCachedNodeInfos());
+    ASSERT_FALSE(retr.getCachedNodeInfo(2));
+
+    retr.setNodeInfoCacheEnabled(true);
+    restartNodeStatusProvider(provider, nodes.b, "Peter");
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(1500));
+
+    ASSERT_EQ(4, listener.info_retrieved_cnt);
+    ASSERT_EQ(1, retr.getNumCachedNodeInfos());
+
+    retr.invalidateAll();
+    ASSERT_EQ(0, retr.getNumCachedNodeInfos());
+}
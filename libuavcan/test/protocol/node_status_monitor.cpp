@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/node_status_monitor.hpp>
 #include <uavcan/protocol/node_status_provider.hpp>
@@ -174,3 +175,123 @@ TEST(NodeStatusMonitor, Basic)
     ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(uavcan::NodeID(9)).mode);
     ASSERT_EQ(NodeStatus::HEALTH_CRITICAL, nsm.getNodeStatus(uavcan::NodeID(9)).health);
 }
+
+
+TEST(NodeStatusMonitor, OfflineTimeout)
+{
+    using uavcan::protocol::NodeStatus;
+    using uavcan::NodeID;
+
+    SystemClockMock clock_mock(100);
+    clock_mock.monotonic_auto_advance = 1000;
+
+    CanDriverMock can(2, clock_mock);
+
+    TestNode node(can, clock_mock, 64);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    uavcan::NodeStatusMonitor nsm(node);
+    ASSERT_LE(0, nsm.start());
+
+    const uavcan::uint64_t TimeoutUSec = NodeStatus::OFFLINE_TIMEOUT_MS * 1000ULL;
+
+    publishNodeStatus(can, 5, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    publishNodeStatus(can, 6, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    publishNodeStatus(can, 7, NodeStatus::HEALTH_OK, NodeStatus::MODE_OFFLINE, 1, 0);     // Never times out
+    shortSpin(node);
+
+    /*
+     * Node 5 keeps publishing, node 6 goes silent
+     */
+    for (int i = 0; i < 4; i++)
+    {
+        clock_mock.advance(TimeoutUSec / 2);
+        publishNodeStatus(can, 5, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 2, uavcan::TransferID(i + 1));
+        shortSpin(node);
+
+        ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(5)).mode);
+        ASSERT_EQ((i == 0) ? NodeStatus::MODE_OPERATIONAL : NodeStatus::MODE_OFFLINE,
+                  nsm.getNodeStatus(NodeID(6)).mode);
+        ASSERT_TRUE(nsm.isNodeKnown(NodeID(7)));
+    }
+
+    /*
+     * Node 5 goes silent; the change is detected shortly after the timeout, not with a fixed period
+     */
+    clock_mock.advance(TimeoutUSec - 50000);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OPERATIONAL, nsm.getNodeStatus(NodeID(5)).mode);
+
+    clock_mock.advance(50000);
+    shortSpin(node);
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(5)).mode);
+    ASSERT_TRUE(nsm.isNodeKnown(NodeID(5)));
+
+    /*
+     * Forgotten nodes are removed from the queue
+     */
+    publishNodeStatus(can, 5, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 3, 5);
+    publishNodeStatus(can, 6, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 3, 5);
+    shortSpin(node);
+    nsm.forgetNode(5);
+
+    clock_mock.advance(TimeoutUSec + 100000);
+    shortSpin(node);
+    ASSERT_FALSE(nsm.isNodeKnown(NodeID(5)));
+    ASSERT_EQ(NodeStatus::MODE_OFFLINE, nsm.getNodeStatus(NodeID(6)).mode);
+}
+
+
+struct ForgettingNodeStatusMonitor : public uavcan::NodeStatusMonitor
+{
+    std::vector<uavcan::NodeID> forgotten;
+
+    explicit ForgettingNodeStatusMonitor(uavcan::INode& node) : uavcan::NodeStatusMonitor(node) { }
+
+    virtual void handleNodeForgotten(uavcan::NodeID node_id)
+    {
+        ASSERT_FALSE(isNodeKnown(node_id));
+        forgotten.push_back(node_id);
+    }
+};
+
+
+TEST(NodeStatusMonitor, ForgottenNotification)
+{
+    using uavcan::protocol::NodeStatus;
+    using uavcan::NodeID;
+
+    SystemClockMock clock_mock(100);
+    clock_mock.monotonic_auto_advance = 1000;
+
+    CanDriverMock can(2, clock_mock);
+
+    TestNode node(can, clock_mock, 64);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    ForgettingNodeStatusMonitor nsm(node);
+    ASSERT_LE(0, nsm.start());
+
+    publishNodeStatus(can, 5, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    publishNodeStatus(can, 6, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    publishNodeStatus(can, 7, NodeStatus::HEALTH_OK, NodeStatus::MODE_OPERATIONAL, 1, 0);
+    shortSpin(node);
+
+    // Unknown nodes are not reported
+    nsm.forgetNode(100);
+    nsm.forgetNode(6);
+    ASSERT_EQ(1, nsm.forgotten.size());
+    ASSERT_EQ(NodeID(6), nsm.forgotten.at(0));
+
+    nsm.forgetAllNodes();
+    ASSERT_EQ(3, nsm.forgotten.size());
+    ASSERT_EQ(NodeID(5), nsm.forgotten.at(1));
+    ASSERT_EQ(NodeID(7), nsm.forgotten.at(2));
+
+    nsm.forgetAllNodes();
+    ASSERT_EQ(3, nsm.forgotten.size());
+}
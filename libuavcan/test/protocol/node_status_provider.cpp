@@ -113,4 +113,88 @@ TEST(NodeStatusProvider, Basic)
     ASSERT_TRUE(swver == gni_cln.collector.result->getResponse().software_version);
 
     ASSERT_EQ("superluminal_communication_unit", gni_cln.collector.result->getResponse().name);
+
+    /*
+     * The response is re-encoded after a change
+     */
+    nsp.setHealthWarning();
+    ASSERT_LE(0, gni_cln.call(1, uavcan::protocol::GetNodeInfo::Request()));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(gni_cln.collector.result->isSuccessful());
+    ASSERT_EQ(uavcan::protocol::NodeStatus::HEALTH_WARNING,
+              gni_cln.collector.result->getResponse().status.health);
+    ASSERT_EQ("superluminal_communication_unit", gni_cln.collector.result->getResponse().name);
+}
+
+
+static void busyWait(const uavcan::TimerEvent&)
+{
+    const SystemClockDriver clock;
+    const uavcan::MonotonicTime deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(3);
+    while (clock.getMonotonic() < deadline) { }
+}
+
+
+TEST(NodeStatusProvider, LoadReporting)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetNodeInfo> _reg2;
+
+    uavcan::NodeStatusProvider nsp(nodes.a);
+    nsp.setName("busy_node");
+    nsp.setVendorSpecificStatusCode(1234);
+    ASSERT_LE(0, nsp.startAndPublish());
+
+    SubscriberWithCollector<uavcan::protocol::NodeStatus> status_sub(nodes.b);
+    ASSERT_LE(0, status_sub.start());
+
+    ASSERT_FALSE(nsp.isLoadReportingEnabled());
+    ASSERT_FALSE(nodes.a.getScheduler().isLoadStatsEnabled());
+    nsp.setLoadReportingEnabled(true);
+    ASSERT_TRUE(nsp.isLoadReportingEnabled());
+    ASSERT_TRUE(nodes.a.getScheduler().isLoadStatsEnabled());
+
+    /*
+     * Idle node
+     */
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50));
+    ASSERT_LE(0, nsp.forcePublish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(status_sub.collector.msg.get());
+    ASSERT_GT(20, status_sub.collector.msg->vendor_specific_status_code);
+    ASSERT_EQ(nsp.getVendorSpecificStatusCode(), status_sub.collector.msg->vendor_specific_status_code);
+
+    /*
+     * Busy node
+     */
+    uavcan::Timer busy_timer(nodes.a, &busyWait);
+    busy_timer.startPeriodic(uavcan::MonotonicDuration::fromMSec(4));
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_LE(0, nsp.forcePublish());
+    busy_timer.stop();
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    std::cout << "Load: " << status_sub.collector.msg->vendor_specific_status_code << "%" << std::endl;
+    ASSERT_LT(40, status_sub.collector.msg->vendor_specific_status_code);
+    ASSERT_GE(100, status_sub.collector.msg->vendor_specific_status_code);
+
+    /*
+     * Reset of the scheduler stats is handled
+     */
+    nodes.a.getScheduler().resetLoadStats();
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_LE(0, nsp.forcePublish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_GT(20, status_sub.collector.msg->vendor_specific_status_code);
+
+    /*
+     * Disabled - the application controls the code again
+     */
+    nsp.setLoadReportingEnabled(false);
+    nsp.setVendorSpecificStatusCode(4321);
+    ASSERT_LE(0, nsp.forcePublish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_EQ(4321, status_sub.collector.msg->vendor_specific_status_code);
 }
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/param_enumerator.hpp>
+#include <uavcan/protocol/param_server.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "helpers.hpp"
+
+
+/**
+ * Serves the params named "param0", "param1", ... with values equal to their indices.
+ */
+struct EnumeratedParamManager : public uavcan::IParamManager
+{
+    unsigned num_params;
+
+    explicit EnumeratedParamManager(unsigned arg_num_params) : num_params(arg_num_params) { }
+
+    static std::string makeName(unsigned index)
+    {
+        std::ostringstream os;
+        os << "param" << index;
+        return os.str();
+    }
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        if (index < num_params)
+        {
+            out_name = makeName(index).c_str();
+        }
+    }
+
+    virtual void assignParamValue(const Name&, const Value&) { }
+
+    virtual void readParamValue(const Name& name, Value& out_value) const
+    {
+        out_value.to<Value::Tag::integer_value>() = std::atoi(name.c_str() + 5);
+    }
+
+    virtual int saveAllParams() { return 0; }
+
+    virtual int eraseAllParams() { return 0; }
+};
+
+
+struct ParamEnumerationCollector : public uavcan::IParamEnumerationHandler
+{
+    struct Entry
+    {
+        uavcan::NodeID node_id;
+        uint16_t index;
+        std::string name;
+        int64_t value;
+    };
+
+    std::vector<Entry> params;
+    std::vector<int> results;
+    std::vector<unsigned> counts;
+    uavcan::ParamEnumerator<4>* restart_with;
+    uavcan::NodeID restart_node_id;
+    unsigned cancel_after;
+
+    ParamEnumerationCollector()
+        : restart_with(NULL)
+        , cancel_after(0)
+    { }
+
+    virtual void handleParam(uavcan::NodeID node_id, uint16_t index, const Param& param)
+    {
+        Entry entry;
+        entry.node_id = node_id;
+        entry.index = index;
+        entry.name = param.name.c_str();
+        entry.value = param.value.to<uavcan::protocol::param::Value::Tag::integer_value>();
+        params.push_back(entry);
+        if (restart_with != NULL && cancel_after > 0 && params.size() == cancel_after)
+        {
+            restart_with->cancel();
+        }
+    }
+
+    virtual void handleParamEnumerationFinished(uavcan::NodeID node_id, int result, unsigned num_params)
+    {
+        std::cout << "Finished: node " << int(node_id.get()) << " result " << result
+                  << " num_params " << num_params << std::endl;
+        results.push_back(result);
+        counts.push_back(num_params);
+        if (restart_with != NULL && restart_node_id.isUnicast())
+        {
+            const uavcan::NodeID nid = restart_node_id;
+            restart_node_id = uavcan::NodeID();
+            ASSERT_LE(0, restart_with->start(nid, this));
+        }
+    }
+};
+
+
+TEST(ParamEnumerator, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::GetSet> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::ExecuteOpcode> _reg2;
+
+    EnumeratedParamManager mgr(23);
+    uavcan::ParamServer server(nodes.a);
+    ASSERT_LE(0, server.start(&mgr));
+
+    ParamEnumerationCollector collector;
+    uavcan::ParamEnumerator<4> enumerator(nodes.b);
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, enumerator.start(1, NULL));
+    ASSERT_GT(0, enumerator.start(uavcan::NodeID(), &collector));
+    ASSERT_FALSE(enumerator.isRunning());
+
+    /*
+     * Full enumeration, restarted from the handler once it is finished
+     */
+    collector.restart_with = &enumerator;
+    collector.restart_node_id = nodes.a.getNodeID();
+    ASSERT_LE(0, enumerator.start(nodes.a.getNodeID(), &collector));
+    ASSERT_TRUE(enumerator.isRunning());
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(200)));
+    ASSERT_FALSE(enumerator.isRunning());
+
+    ASSERT_EQ(2, collector.results.size());
+    ASSERT_EQ(0, collector.results[0]);
+    ASSERT_EQ(0, collector.results[1]);
+    ASSERT_EQ(23, collector.counts[0]);
+    ASSERT_EQ(23, collector.counts[1]);
+    ASSERT_EQ(46, collector.params.size());
+    for (unsigned i = 0; i < collector.params.size(); i++)
+    {
+        const unsigned index = i % 23;
+        ASSERT_EQ(nodes.a.getNodeID(), collector.params[i].node_id);
+        ASSERT_EQ(index, collector.params[i].index);
+        ASSERT_EQ(EnumeratedParamManager::makeName(index), collector.params[i].name);
+        ASSERT_EQ(int64_t(index), collector.params[i].value);
+    }
+
+    /*
+     * Empty param list
+     */
+    mgr.num_params = 0;
+    ASSERT_LE(0, enumerator.start(nodes.a.getNodeID(), &collector));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50)));
+    ASSERT_EQ(3, collector.results.size());
+    ASSERT_EQ(0, collector.results[2]);
+    ASSERT_EQ(0, collector.counts[2]);
+    ASSERT_EQ(46, collector.params.size());
+
+    /*
+     * Cancellation from the handler
+     */
+    mgr.num_params = 10;
+    collector.params.clear();
+    collector.cancel_after = 5;
+    ASSERT_LE(0, enumerator.start(nodes.a.getNodeID(), &collector));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100)));
+    ASSERT_FALSE(enumerator.isRunning());
+    ASSERT_EQ(5, collector.params.size());
+    ASSERT_EQ(5, enumerator.getNumParams());
+    ASSERT_EQ(3, collector.results.size());         // Not reported
+
+    /*
+     * Unresponsive node
+     */
+    collector.cancel_after = 0;
+    collector.params.clear();
+    enumerator.setMaxAttempts(2);
+    enumerator.setRequestTimeout(uavcan::MonotonicDuration::fromMSec(20));
+    ASSERT_LE(0, enumerator.start(99, &collector));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150)));
+    ASSERT_FALSE(enumerator.isRunning());
+    ASSERT_EQ(4, collector.results.size());
+    ASSERT_EQ(-uavcan::ErrFailure, collector.results[3]);
+    ASSERT_EQ(0, collector.counts[3]);
+    ASSERT_TRUE(collector.params.empty());
+}
@@ -3,8 +3,11 @@
  */
 
 #include <map>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/protocol/param_server.hpp>
+#include <uavcan/protocol/param_manager_cache.hpp>
+#include <uavcan/protocol/param_manager_save_coalescer.hpp>
 #include "helpers.hpp"
 
 struct ParamServerTestManager : public uavcan::IParamManager
@@ -175,3 +178,295 @@ TEST(ParamServer, Basic)
     ASSERT_FLOAT_EQ(424242, get_set_cln.collector.result->getResponse().value.
                             to<uavcan::protocol::param::Value::Tag::real_value>());
 }
+
+
+/**
+ * Counts the calls that reach the backend.
+ */
+struct CountingParamServerTestManager : public ParamServerTestManager
+{
+    mutable int num_name_reads;
+    mutable int num_value_reads;
+    mutable int num_default_reads;
+
+    CountingParamServerTestManager()
+        : num_name_reads(0)
+        , num_value_reads(0)
+        , num_default_reads(0)
+    { }
+
+    virtual void getParamNameByIndex(Index index, Name& out_name) const
+    {
+        num_name_reads++;
+        ParamServerTestManager::getParamNameByIndex(index, out_name);
+    }
+
+    virtual void readParamValue(const Name& name, Value& out_value) const
+    {
+        num_value_reads++;
+        ParamServerTestManager::readParamValue(name, out_value);
+    }
+
+    virtual void readParamDefaultMaxMin(const Name& name, Value& out_default,
+                                        NumericValue& out_max, NumericValue& out_min) const
+    {
+        num_default_reads++;
+        out_default.to<Value::Tag::real_value>() = float(name.size());
+        out_max.to<NumericValue::Tag::integer_value>() = 100;
+        out_min.to<NumericValue::Tag::integer_value>() = -100;
+    }
+};
+
+
+TEST(ParamServer, ParamManagerCache)
+{
+    CountingParamServerTestManager backend;
+    backend.kv["a"] = 1;
+    backend.kv["bb"] = 2;
+    backend.kv["ccc"] = 3;
+
+    uavcan::ParamManagerCache<8> cache(backend);
+    ASSERT_EQ(0, backend.num_name_reads);               // Lazy
+
+    uavcan::IParamManager::Name name;
+    cache.getParamNameByIndex(1, name);
+    ASSERT_STREQ("bb", name.c_str());
+    ASSERT_EQ(4, backend.num_name_reads);               // Three names and the terminating empty one
+    ASSERT_EQ(3, backend.num_default_reads);
+    ASSERT_EQ(3, cache.getNumCachedParams());
+    ASSERT_TRUE(cache.isComplete());
+
+    // Served from the table
+    for (uavcan::IParamManager::Index i = 0; i < 10; i++)
+    {
+        name.clear();
+        cache.getParamNameByIndex(i, name);
+        ASSERT_EQ(i < 3, !name.empty());
+    }
+    uavcan::IParamManager::Value def;
+    uavcan::IParamManager::NumericValue max;
+    uavcan::IParamManager::NumericValue min;
+    cache.readParamDefaultMaxMin("ccc", def, max, min);
+    ASSERT_FLOAT_EQ(3.0F, def.to<uavcan::protocol::param::Value::Tag::real_value>());
+    ASSERT_EQ(100, max.to<uavcan::protocol::param::NumericValue::Tag::integer_value>());
+    ASSERT_EQ(-100, min.to<uavcan::protocol::param::NumericValue::Tag::integer_value>());
+    ASSERT_EQ(4, backend.num_name_reads);
+    ASSERT_EQ(3, backend.num_default_reads);
+
+    uavcan::IParamManager::Index index = 0;
+    ASSERT_TRUE(cache.findParamIndex("ccc", index));
+    ASSERT_EQ(2, index);
+    ASSERT_FALSE(cache.findParamIndex("dddd", index));
+
+    // Values are always live
+    uavcan::IParamManager::Value value;
+    value.to<uavcan::protocol::param::Value::Tag::integer_value>() = 42;
+    cache.assignParamValue("bb", value);
+    value = uavcan::IParamManager::Value();
+    cache.readParamValue("bb", value);
+    ASSERT_FLOAT_EQ(42.0F, value.to<uavcan::protocol::param::Value::Tag::real_value>());
+    ASSERT_EQ(1, backend.num_value_reads);
+
+    // New param is not visible until the table is invalidated
+    backend.kv["dddd"] = 4;
+    name.clear();
+    cache.getParamNameByIndex(3, name);
+    ASSERT_TRUE(name.empty());
+    cache.invalidate();
+    cache.getParamNameByIndex(3, name);
+    ASSERT_STREQ("dddd", name.c_str());
+    ASSERT_EQ(4, cache.getNumCachedParams());
+
+    // Params beyond the capacity are served by the backend
+    uavcan::ParamManagerCache<2> small_cache(backend);
+    ASSERT_EQ(2, small_cache.getNumCachedParams());
+    ASSERT_FALSE(small_cache.isComplete());
+    name.clear();
+    small_cache.getParamNameByIndex(3, name);
+    ASSERT_STREQ("dddd", name.c_str());
+    const int num_default_reads = backend.num_default_reads;
+    small_cache.readParamDefaultMaxMin("dddd", def, max, min);
+    ASSERT_EQ(num_default_reads + 1, backend.num_default_reads);
+    ASSERT_FLOAT_EQ(4.0F, def.to<uavcan::protocol::param::Value::Tag::real_value>());
+}
+
+
+TEST(ParamServer, CachedServer)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::GetSet> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::ExecuteOpcode> _reg2;
+
+    CountingParamServerTestManager backend;
+    backend.kv["foo"] = 1;
+    backend.kv["bar"] = 2;
+    uavcan::ParamManagerCache<16> cache(backend);
+
+    uavcan::ParamServer server(nodes.a);
+    ASSERT_LE(0, server.start(&cache));
+
+    ServiceClientWithCollector<uavcan::protocol::param::GetSet> get_set_cln(nodes.b);
+
+    for (int rep = 0; rep < 3; rep++)
+    {
+        for (uint16_t i = 0; i < 3; i++)
+        {
+            uavcan::protocol::param::GetSet::Request get_set_rq;
+            get_set_rq.index = i;
+            doCall(get_set_cln, get_set_rq, nodes);
+            const uavcan::protocol::param::GetSet::Response& rsp = get_set_cln.collector.result->getResponse();
+            if (i < 2)
+            {
+                ASSERT_STREQ((i == 0) ? "bar" : "foo", rsp.name.c_str());
+                ASSERT_FLOAT_EQ(3.0F, rsp.default_value.to<uavcan::protocol::param::Value::Tag::real_value>());
+                ASSERT_FLOAT_EQ(float(2 - i), rsp.value.to<uavcan::protocol::param::Value::Tag::real_value>());
+            }
+            else
+            {
+                ASSERT_TRUE(rsp.name.empty());
+            }
+        }
+    }
+
+    // The backend has been enumerated only once
+    ASSERT_EQ(3, backend.num_name_reads);
+    ASSERT_EQ(2, backend.num_default_reads);
+    ASSERT_EQ(6, backend.num_value_reads);
+}
+
+
+/**
+ * Records the save requests that reach the backend.
+ */
+struct SavingParamServerTestManager : public ParamServerTestManager
+{
+    int num_full_saves;
+    int num_erases;
+    int save_result;
+    std::vector<std::string> saved_names;
+
+    SavingParamServerTestManager()
+        : num_full_saves(0)
+        , num_erases(0)
+        , save_result(0)
+    { }
+
+    virtual int saveAllParams()
+    {
+        num_full_saves++;
+        return save_result;
+    }
+
+    virtual int saveModifiedParams(const Name* names, unsigned num_names)
+    {
+        saved_names.clear();
+        for (unsigned i = 0; i < num_names; i++)
+        {
+            saved_names.push_back(names[i].c_str());
+        }
+        return save_result;
+    }
+
+    virtual int eraseAllParams()
+    {
+        num_erases++;
+        return 0;
+    }
+};
+
+
+TEST(ParamServer, SaveCoalescer)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::GetSet> _reg1;
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::param::ExecuteOpcode> _reg2;
+
+    SavingParamServerTestManager backend;
+    backend.kv["a"] = 1;
+    backend.kv["b"] = 2;
+    backend.kv["c"] = 3;
+    uavcan::ParamManagerSaveCoalescer<2> coalescer(nodes.a, backend);
+    coalescer.setSaveDelay(uavcan::MonotonicDuration::fromMSec(100));
+
+    uavcan::ParamServer server(nodes.a);
+    ASSERT_LE(0, server.start(&coalescer));
+
+    ServiceClientWithCollector<uavcan::protocol::param::GetSet> get_set_cln(nodes.b);
+    ServiceClientWithCollector<uavcan::protocol::param::ExecuteOpcode> save_erase_cln(nodes.b);
+
+    uavcan::protocol::param::ExecuteOpcode::Request save_rq;
+    save_rq.opcode = uavcan::protocol::param::ExecuteOpcode::Request::OPCODE_SAVE;
+
+    // Nothing has been modified - nothing to save
+    doCall(save_erase_cln, save_rq, nodes);
+    ASSERT_TRUE(save_erase_cln.collector.result->getResponse().ok);
+    ASSERT_FALSE(coalescer.hasPendingSave());
+
+    // Several set/save sequences within the delay are served by one write
+    uavcan::protocol::param::GetSet::Request get_set_rq;
+    get_set_rq.value.to<uavcan::protocol::param::Value::Tag::integer_value>() = 10;
+    for (int i = 0; i < 3; i++)
+    {
+        get_set_rq.name = (i == 1) ? "b" : "a";
+        doCall(get_set_cln, get_set_rq, nodes);
+        doCall(save_erase_cln, save_rq, nodes);
+        ASSERT_TRUE(save_erase_cln.collector.result->getResponse().ok);
+        ASSERT_TRUE(coalescer.hasPendingSave());
+    }
+    ASSERT_EQ(0, coalescer.getNumSaves());
+    ASSERT_TRUE(backend.saved_names.empty());
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150)));
+    ASSERT_FALSE(coalescer.hasPendingSave());
+    ASSERT_EQ(1, coalescer.getNumSaves());
+    ASSERT_EQ(2, backend.saved_names.size());
+    ASSERT_EQ("a", backend.saved_names[0]);
+    ASSERT_EQ("b", backend.saved_names[1]);
+    ASSERT_EQ(0, backend.num_full_saves);
+    ASSERT_FLOAT_EQ(10, backend.kv["a"]);
+
+    // Failed save is retried on the next request
+    backend.save_result = -1;
+    get_set_rq.name = "c";
+    doCall(get_set_cln, get_set_rq, nodes);
+    doCall(save_erase_cln, save_rq, nodes);
+    ASSERT_GT(0, coalescer.flush());
+    ASSERT_EQ(1, coalescer.getNumFailedSaves());
+    backend.save_result = 0;
+    ASSERT_EQ(0, coalescer.flush());
+    ASSERT_EQ(1, backend.saved_names.size());
+    ASSERT_EQ("c", backend.saved_names[0]);
+    ASSERT_EQ(3, coalescer.getNumSaves());
+    ASSERT_EQ(0, coalescer.flush());                    // Nothing to save anymore
+    ASSERT_EQ(3, coalescer.getNumSaves());
+
+    // Too many modified params - full save
+    for (int i = 0; i < 3; i++)
+    {
+        get_set_rq.name = (i == 0) ? "a" : ((i == 1) ? "b" : "c");
+        doCall(get_set_cln, get_set_rq, nodes);
+    }
+    ASSERT_EQ(0, coalescer.flush());
+    ASSERT_EQ(1, backend.num_full_saves);
+
+    // Erase cancels the pending save and forces the next save to be full
+    get_set_rq.name = "a";
+    doCall(get_set_cln, get_set_rq, nodes);
+    doCall(save_erase_cln, save_rq, nodes);
+    ASSERT_TRUE(coalescer.hasPendingSave());
+    uavcan::protocol::param::ExecuteOpcode::Request erase_rq;
+    erase_rq.opcode = uavcan::protocol::param::ExecuteOpcode::Request::OPCODE_ERASE;
+    doCall(save_erase_cln, erase_rq, nodes);
+    ASSERT_TRUE(save_erase_cln.collector.result->getResponse().ok);
+    ASSERT_EQ(1, backend.num_erases);
+    ASSERT_FALSE(coalescer.hasPendingSave());
+    ASSERT_EQ(1, backend.num_full_saves);
+
+    doCall(save_erase_cln, save_rq, nodes);
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150)));
+    ASSERT_EQ(2, backend.num_full_saves);
+}
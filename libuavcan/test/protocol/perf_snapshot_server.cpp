@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/perf_snapshot_server.hpp>
+#include <root_ns_a/GetPerfSnapshot.hpp>
+#include "helpers.hpp"
+
+
+TEST(PerfSnapshotServer, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<root_ns_a::GetPerfSnapshot> _reg1;
+
+    uavcan::PerfSnapshotServer<root_ns_a::GetPerfSnapshot> server(nodes.a);
+    ASSERT_LE(0, server.start());
+
+    ServiceClientWithCollector<root_ns_a::GetPerfSnapshot> client(nodes.b);
+
+    /*
+     * Load statistics are disabled, the test node does not track the memory usage
+     */
+    root_ns_a::GetPerfSnapshot::Request request;
+    ASSERT_LE(0, client.call(1, request));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_TRUE(client.collector.result.get());
+    ASSERT_TRUE(client.collector.result->isSuccessful());
+    {
+        const root_ns_a::GetPerfSnapshot::Response& resp = client.collector.result->getResponse();
+        ASSERT_EQ(nodes.a.getAllocator().getNumBlocks(), resp.pool_blocks);
+        ASSERT_TRUE(resp.pool_used.empty());
+        ASSERT_TRUE(resp.pool_peak.empty());
+        ASSERT_TRUE(resp.pool_failures.empty());
+        ASSERT_EQ(1, resp.tx_queue_depth.size());           // One interface
+        ASSERT_EQ(1, resp.iface_errors.size());
+        ASSERT_EQ(0, resp.iface_errors[0]);
+        ASSERT_EQ(0, resp.utilization_percent);
+        ASSERT_EQ(0, resp.peak_callback_usec);
+
+        // The server sees its own request
+        const uavcan::DataTypeStatsTable& table = nodes.a.getDispatcher().getDataTypeStatsTable();
+        ASSERT_EQ(table.getSize(), resp.num_data_types);
+        ASSERT_LT(0, resp.num_data_types);
+        ASSERT_EQ(uavcan::min(table.getSize(), unsigned(resp.data_types.capacity())), resp.data_types.size());
+
+        const uavcan::DataTypeStats* const stats = table.find(uavcan::DataTypeKindService,
+                                                              root_ns_a::GetPerfSnapshot::DefaultDataTypeID);
+        ASSERT_TRUE(stats);
+        bool found = false;
+        for (unsigned i = 0; i < resp.data_types.size(); i++)
+        {
+            if (resp.data_types[i].data_type_id == root_ns_a::GetPerfSnapshot::DefaultDataTypeID)
+            {
+                ASSERT_EQ(uavcan::DataTypeKindService, resp.data_types[i].data_type_kind);
+                ASSERT_EQ(1, resp.data_types[i].transfers_rx);
+                ASSERT_EQ(0, resp.data_types[i].rx_errors);
+                found = true;
+            }
+        }
+        ASSERT_TRUE(found);
+    }
+
+    /*
+     * Offset past the end of the table
+     */
+    request.data_type_offset = 200;
+    ASSERT_LE(0, client.call(1, request));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_TRUE(client.collector.result->isSuccessful());
+    ASSERT_LT(0, client.collector.result->getResponse().num_data_types);
+    ASSERT_TRUE(client.collector.result->getResponse().data_types.empty());
+
+    /*
+     * Load statistics enabled
+     */
+    nodes.a.getScheduler().setLoadStatsEnabled(true);
+    request.data_type_offset = 0;
+    ASSERT_LE(0, client.call(1, request));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_TRUE(client.collector.result->isSuccessful());
+    ASSERT_GE(100, client.collector.result->getResponse().utilization_percent);
+}
@@ -84,3 +84,62 @@ TEST(TransportStatsProvider, Basic)
     EXPECT_EQ(4, tsp_cln.collector.result->getResponse().can_iface_stats[0].frames_rx);     // Same here
     EXPECT_EQ(12, tsp_cln.collector.result->getResponse().can_iface_stats[0].frames_tx);
 }
+
+
+TEST(TransportStatsProvider, RateEstimation)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::TransportStatsProvider tsp(nodes.a);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::GetTransportStats> _reg1;
+
+    ASSERT_LE(0, tsp.start());
+
+    ASSERT_FALSE(tsp.isRateEstimationRunning());
+    ASSERT_FALSE(tsp.areRatesAvailable());
+    ASSERT_EQ(1, tsp.getNumIfaces());
+    ASSERT_FLOAT_EQ(0.0F, tsp.getIfaceRates(0).frames_rx);
+    ASSERT_FLOAT_EQ(0.0F, tsp.getIfaceRates(9).frames_rx);     // Invalid index
+
+    ServiceClientWithCollector<uavcan::protocol::GetTransportStats> tsp_cln(nodes.b);
+
+    /*
+     * No smoothing, so the rates are just the increments over the sample period
+     */
+    tsp.startRateEstimation(uavcan::MonotonicDuration::fromMSec(100), uavcan::MonotonicDuration());
+    ASSERT_TRUE(tsp.isRateEstimationRunning());
+
+    ASSERT_LE(0, tsp_cln.call(1, uavcan::protocol::GetTransportStats::Request()));
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(50)));
+    ASSERT_FALSE(tsp.areRatesAvailable());                     // No samples yet
+
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(70)));
+    ASSERT_TRUE(tsp.areRatesAvailable());
+
+    // One single-frame request received, one multi-frame response transmitted - about 10 and 60 frames per second
+    const uavcan::CanIfaceRates rates = tsp.getIfaceRates(0);
+    EXPECT_NEAR(10.0F, rates.frames_rx, 1.0F);
+    EXPECT_NEAR(60.0F, rates.frames_tx, 6.0F);
+    EXPECT_LE(rates.frames_rx, rates.bytes_rx);                 // Empty request, tail byte only
+    EXPECT_LT(rates.frames_tx * 2.0F, rates.bytes_tx);
+    EXPECT_FLOAT_EQ(0.0F, rates.errors);
+
+    const uavcan::CanIfacePerfCounters cnt = nodes.a.getDispatcher().getCanIOManager().getIfacePerfCounters(0);
+    EXPECT_EQ(1, cnt.frames_rx);
+    EXPECT_EQ(6, cnt.frames_tx);
+    EXPECT_EQ(cnt.frames_rx, cnt.bytes_rx);
+    EXPECT_LT(cnt.frames_tx, cnt.bytes_tx);
+
+    /*
+     * No traffic - the rates drop to zero, since there's no smoothing
+     */
+    ASSERT_LE(0, nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(100)));
+    EXPECT_FLOAT_EQ(0.0F, tsp.getIfaceRates(0).frames_rx);
+    EXPECT_FLOAT_EQ(0.0F, tsp.getIfaceRates(0).frames_tx);
+
+    tsp.stopRateEstimation();
+    ASSERT_FALSE(tsp.isRateEstimationRunning());
+    ASSERT_TRUE(tsp.areRatesAvailable());                      // The last values are retained
+}
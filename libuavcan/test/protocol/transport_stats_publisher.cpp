@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/protocol/transport_stats_publisher.hpp>
+#include "helpers.hpp"
+
+
+TEST(TransportStatsPublisher, Basic)
+{
+    InterlinkedTestNodesWithSysClock nodes;
+
+    uavcan::TransportStatsProvider tsp(nodes.a);
+    uavcan::TransportStatsPublisher pub(nodes.a, tsp);
+
+    SubscriberWithCollector<uavcan::protocol::debug::KeyValue> sub(nodes.b);
+
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::debug::KeyValue> _reg1;
+
+    ASSERT_LE(0, sub.start());
+
+    /*
+     * Nothing is published until the rates are available
+     */
+    ASSERT_EQ(0, pub.publish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_FALSE(sub.collector.msg.get());
+
+    tsp.startRateEstimation(uavcan::MonotonicDuration::fromMSec(50), uavcan::MonotonicDuration());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(60));
+    ASSERT_TRUE(tsp.areRatesAvailable());
+
+    /*
+     * One-shot publishing; the last published value is the error rate of the last interface
+     */
+    ASSERT_LE(0, pub.publish());
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(sub.collector.msg.get());
+    ASSERT_STREQ("can0.err", sub.collector.msg->key.c_str());
+    ASSERT_FLOAT_EQ(0.0F, sub.collector.msg->value);
+    sub.collector.msg.reset();
+
+    /*
+     * Periodic publishing
+     */
+    ASSERT_FALSE(pub.isRunning());
+    pub.startPeriodic(uavcan::MonotonicDuration::fromMSec(100));
+    ASSERT_TRUE(pub.isRunning());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_TRUE(sub.collector.msg.get());
+    sub.collector.msg.reset();
+
+    pub.stop();
+    ASSERT_FALSE(pub.isRunning());
+
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(150));
+    ASSERT_FALSE(sub.collector.msg.get());
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <uavcan/protocol/warm_start.hpp>
+#include "helpers.hpp"
+
+/**
+ * Accepts any filter configuration and remembers it.
+ */
+struct FilteringCanDriver : public PairableCanDriver
+{
+    std::vector<uavcan::CanFilterConfig> filters;
+    unsigned num_configure_calls;
+
+    explicit FilteringCanDriver(uavcan::ISystemClock& clock)
+        : PairableCanDriver(clock)
+        , num_configure_calls(0)
+    { }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig* configs, uavcan::uint16_t num_configs)
+    {
+        filters.assign(configs, configs + num_configs);
+        num_configure_calls++;
+        return 0;
+    }
+
+    virtual uavcan::uint16_t getNumFilters() const { return 8; }
+};
+
+static uavcan::NodeInfoSummary makeNodeInfoSummary(uint8_t seed)
+{
+    uavcan::NodeInfoSummary info;
+    info.software_image_crc_low = 0xDEADBEEFU + seed;
+    info.software_image_crc_high = 0x12345678U;
+    info.software_vcs_commit = seed;
+    info.hash = 0xA5A5A5A5U ^ seed;
+    info.software_version_major = seed;
+    info.software_version_minor = 2;
+    info.software_optional_field_flags = 3;
+    info.hardware_version_major = 4;
+    info.hardware_version_minor = seed;
+    for (unsigned i = 0; i < uavcan::NodeInfoSummary::UniqueIDSize; i++)
+    {
+        info.hardware_unique_id[i] = uint8_t(seed + i);
+    }
+    return info;
+}
+
+TEST(WarmStartSnapshot, SaveRestore)
+{
+    SystemClockDriver clock;
+    FilteringCanDriver can_a(clock);
+    FilteringCanDriver can_b(clock);
+    can_a.linkTogether(&can_b);
+
+    TestNode node(can_a, clock, 42);
+
+    /*
+     * State before the restart
+     */
+    uavcan::CanAcceptanceFilterConfigurator filters(node);
+    uavcan::CanFilterConfig configs[2];
+    configs[0].id = 0x12345678U | uavcan::CanFrame::FlagEFF;
+    configs[0].mask = 0x1FFFFF80U | uavcan::CanFrame::FlagEFF;
+    configs[1].id = 0x00001234U | uavcan::CanFrame::FlagEFF;
+    configs[1].mask = 0x0000FFFFU | uavcan::CanFrame::FlagEFF;
+    ASSERT_EQ(0, filters.restoreConfiguration(configs, 2));
+    ASSERT_EQ(2, can_a.filters.size());
+
+    uavcan::NodeInfoRetriever retriever(node);
+    ASSERT_GT(0, retriever.restoreCachedNodeInfo(10, makeNodeInfoSummary(10)));    // Cache is disabled
+    retriever.setNodeInfoCacheEnabled(true);
+    ASSERT_GT(0, retriever.restoreCachedNodeInfo(uavcan::NodeID::Broadcast, makeNodeInfoSummary(10)));
+    ASSERT_EQ(0, retriever.restoreCachedNodeInfo(10, makeNodeInfoSummary(10)));
+    ASSERT_EQ(0, retriever.restoreCachedNodeInfo(127, makeNodeInfoSummary(127)));
+    ASSERT_EQ(2, retriever.getNumCachedNodeInfos());
+    ASSERT_TRUE(retriever.isCachedNodeInfoRestored(10));
+    ASSERT_FALSE(retriever.isCachedNodeInfoRestored(11));
+
+    /*
+     * Saving
+     */
+    uint8_t buffer[uavcan::WarmStartSnapshot::MaxSize];
+    ASSERT_GT(0, uavcan::WarmStartSnapshot::save(node, &filters, &retriever, buffer, 10));  // Filters don't fit
+
+    const int size = uavcan::WarmStartSnapshot::save(node, &filters, &retriever, buffer, sizeof(buffer));
+    ASSERT_EQ(uavcan::WarmStartSnapshot::HeaderSize + 2 * uavcan::WarmStartSnapshot::FilterRecordSize +
+              2 * uavcan::WarmStartSnapshot::NodeRecordSize + uavcan::WarmStartSnapshot::CrcSize, size);
+
+    /*
+     * Restoring into a node that has just started
+     */
+    {
+        TestNode new_node(can_b, clock);
+        uavcan::WarmStartSnapshot snapshot(buffer, unsigned(size));
+        ASSERT_TRUE(snapshot.isValid());
+        ASSERT_EQ(42, snapshot.getNodeID().get());
+        ASSERT_EQ(2, snapshot.getNumFilterConfigs());
+        ASSERT_EQ(2, snapshot.getNumNodeInfos());
+
+        ASSERT_EQ(0, snapshot.restoreNodeID(new_node));
+        ASSERT_EQ(42, new_node.getNodeID().get());
+        ASSERT_GT(0, snapshot.restoreNodeID(new_node));                 // Already set
+
+        uavcan::CanAcceptanceFilterConfigurator new_filters(new_node);
+        ASSERT_EQ(0, snapshot.restoreFilters(new_filters));
+        ASSERT_EQ(1, can_b.num_configure_calls);
+        ASSERT_EQ(2, can_b.filters.size());
+        ASSERT_TRUE(configs[0] == can_b.filters[0]);
+        ASSERT_TRUE(configs[1] == can_b.filters[1]);
+        ASSERT_EQ(2, new_filters.getNumAppliedConfigs());
+
+        uavcan::NodeInfoRetriever new_retriever(new_node);
+        ASSERT_GT(0, snapshot.restoreNodeInfoCache(new_retriever));     // Cache is disabled
+        new_retriever.setNodeInfoCacheEnabled(true);
+        ASSERT_EQ(2, snapshot.restoreNodeInfoCache(new_retriever));
+        ASSERT_EQ(2, new_retriever.getNumCachedNodeInfos());
+        ASSERT_TRUE(new_retriever.isCachedNodeInfoRestored(10));
+        ASSERT_TRUE(new_retriever.isCachedNodeInfoRestored(127));
+        ASSERT_TRUE(makeNodeInfoSummary(10) == *new_retriever.getCachedNodeInfo(10));
+        ASSERT_TRUE(makeNodeInfoSummary(127) == *new_retriever.getCachedNodeInfo(127));
+    }
+
+    /*
+     * Buffer that is too small for all node records
+     */
+    const int short_size = uavcan::WarmStartSnapshot::save(node, &filters, &retriever, buffer,
+                                                           unsigned(size) - 1U);
+    ASSERT_EQ(size - uavcan::WarmStartSnapshot::NodeRecordSize, short_size);
+    {
+        uavcan::WarmStartSnapshot snapshot(buffer, unsigned(short_size));
+        ASSERT_TRUE(snapshot.isValid());
+        ASSERT_EQ(1, snapshot.getNumNodeInfos());
+    }
+
+    /*
+     * Nothing but the node ID
+     */
+    const int min_size = uavcan::WarmStartSnapshot::save(node, NULL, NULL, buffer, sizeof(buffer));
+    ASSERT_EQ(uavcan::WarmStartSnapshot::HeaderSize + uavcan::WarmStartSnapshot::CrcSize, min_size);
+    {
+        uavcan::WarmStartSnapshot snapshot(buffer, unsigned(min_size));
+        ASSERT_TRUE(snapshot.isValid());
+        ASSERT_EQ(42, snapshot.getNodeID().get());
+
+        uavcan::CanAcceptanceFilterConfigurator new_filters(node);
+        ASSERT_EQ(0, snapshot.restoreFilters(new_filters));             // Nothing to restore
+        ASSERT_EQ(0, snapshot.restoreNodeInfoCache(retriever));
+    }
+}
+
+TEST(WarmStartSnapshot, Corrupted)
+{
+    SystemClockDriver clock;
+    PairableCanDriver can(clock);
+    TestNode node(can, clock, 42);
+
+    uint8_t buffer[uavcan::WarmStartSnapshot::MaxSize];
+    ASSERT_GT(0, uavcan::WarmStartSnapshot::save(node, NULL, NULL, NULL, sizeof(buffer)));
+    const int size = uavcan::WarmStartSnapshot::save(node, NULL, NULL, buffer, sizeof(buffer));
+    ASSERT_LT(0, size);
+
+    ASSERT_TRUE(uavcan::WarmStartSnapshot(buffer, unsigned(size)).isValid());
+    ASSERT_FALSE(uavcan::WarmStartSnapshot(buffer, unsigned(size) - 1U).isValid());
+    ASSERT_FALSE(uavcan::WarmStartSnapshot(buffer, unsigned(size) + 1U).isValid());
+    ASSERT_FALSE(uavcan::WarmStartSnapshot(NULL, unsigned(size)).isValid());
+
+    // Every single bit flip must be detected
+    for (int byte = 0; byte < size; byte++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            buffer[byte] = uint8_t(buffer[byte] ^ (1U << bit));
+            ASSERT_FALSE(uavcan::WarmStartSnapshot(buffer, unsigned(size)).isValid());
+            buffer[byte] = uint8_t(buffer[byte] ^ (1U << bit));
+        }
+    }
+
+    // Invalid snapshot restores nothing
+    std::fill(buffer, buffer + sizeof(buffer), uint8_t(0));
+    uavcan::WarmStartSnapshot snapshot(buffer, unsigned(size));
+    ASSERT_FALSE(snapshot.isValid());
+    ASSERT_FALSE(snapshot.getNodeID().isValid());
+
+    TestNode new_node(can, clock);
+    ASSERT_GT(0, snapshot.restoreNodeID(new_node));
+    ASSERT_TRUE(new_node.isPassiveMode());
+}
+
+TEST(NodeIDConflictMonitor, Basic)
+{
+    uavcan::GlobalDataTypeRegistry::instance().reset();
+    uavcan::DefaultDataTypeRegistrator<uavcan::protocol::NodeStatus> _reg1;
+
+    InterlinkedTestNodesWithSysClock nodes(42, 43);
+
+    uavcan::NodeIDConflictMonitor monitor(nodes.a);
+    ASSERT_LE(0, monitor.start());
+
+    uavcan::protocol::NodeStatus msg;
+    uavcan::TransferID tid;
+
+    // Other nodes are fine
+    emulateSingleFrameBroadcastTransfer(nodes.can_a, uavcan::NodeID(43), msg, tid);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_FALSE(monitor.isConflictDetected());
+
+    // Another node uses our node ID
+    tid.increment();
+    emulateSingleFrameBroadcastTransfer(nodes.can_a, uavcan::NodeID(42), msg, tid);
+    nodes.spinBoth(uavcan::MonotonicDuration::fromMSec(10));
+    ASSERT_TRUE(monitor.isConflictDetected());
+
+    monitor.stop();
+}
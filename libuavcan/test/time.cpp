@@ -105,3 +105,83 @@ TEST(Time, Overflow)
     min -= max_4_duration;
     ASSERT_EQ(min, MonotonicTime()); // Must not underflow
 }
+
+
+namespace
+{
+
+template <unsigned ResolutionUSec>
+struct CompactDuration : public uavcan::CompactDurationBase<CompactDuration<ResolutionUSec>, ResolutionUSec> { };
+
+template <unsigned ResolutionUSec>
+struct CompactTime : public uavcan::CompactTimeBase<CompactTime<ResolutionUSec>, CompactDuration<ResolutionUSec>,
+                                                    ResolutionUSec> { };
+
+}
+
+TEST(Time, CompactMilliseconds)
+{
+    typedef CompactDuration<1000> Duration;
+    typedef CompactTime<1000> Time;
+
+    ASSERT_EQ(4, sizeof(Duration));
+    ASSERT_EQ(4, sizeof(Time));
+
+    const Time t1 = Time::fromMSec(1500);
+    ASSERT_EQ(1500, t1.toTicks());
+    ASSERT_EQ(1500, t1.toMSec());
+    ASSERT_EQ(1500000, t1.toUSec());
+    ASSERT_EQ(t1, Time::fromUSec(1500999));                        // Truncated to one tick
+    ASSERT_EQ("1.500000", t1.toString());
+
+    const Duration d1 = Duration::fromUSec(-2500999);
+    ASSERT_EQ(-2500, d1.toTicks());
+    ASSERT_EQ(-2500000, d1.toUSec());
+    ASSERT_EQ("-2.500000", d1.toString());
+    ASSERT_TRUE(d1.isNegative());
+    ASSERT_EQ(2500, d1.getAbs().toMSec());
+    ASSERT_EQ(1, Duration::getResolution().toMSec());
+    ASSERT_TRUE(Duration::fromUSec(999).isZero());
+
+    ASSERT_EQ(0xFFFFFFFFU - 999U, (t1 + d1).toTicks());            // Wraps below zero
+    ASSERT_EQ(Time::fromMSec(4000), t1 - d1);
+    ASSERT_EQ(d1, (t1 + d1) - t1);
+
+    // Durations saturate
+    ASSERT_EQ(Duration::getInfinite(), Duration::fromMSec(10000000000LL));
+    ASSERT_EQ(-Duration::getInfinite(), Duration::fromMSec(-10000000000LL));
+    ASSERT_EQ(Duration::getInfinite(), Duration::getInfinite() + Duration::fromMSec(1));
+    ASSERT_EQ(-Duration::getInfinite(), -Duration::getInfinite() - Duration::getInfinite());
+    ASSERT_EQ(Duration::getInfinite(), Duration::fromMSec(0x40000000) * 3);
+}
+
+TEST(Time, CompactWrapAround)
+{
+    typedef CompactDuration<10> Duration;
+    typedef CompactTime<10> Time;
+
+    ASSERT_EQ(12, Duration::fromUSec(129).toTicks());
+    ASSERT_EQ(120, Duration::fromUSec(129).toUSec());
+    ASSERT_EQ(10, Duration::getResolution().toUSec());
+    ASSERT_EQ(100, Time::fromMSec(1).toTicks());
+
+    // Time points on both sides of the wrap
+    const Time before = Time::fromTicks(0xFFFFFF00U);
+    const Time after = before + Duration::fromTicks(0x200);
+    ASSERT_EQ(0x100, after.toTicks());
+
+    ASSERT_LT(before, after);
+    ASSERT_LE(before, after);
+    ASSERT_GT(after, before);
+    ASSERT_GE(after, before);
+    ASSERT_NE(before, after);
+    ASSERT_EQ(0x200, (after - before).toTicks());
+    ASSERT_EQ(-0x200, (before - after).toTicks());
+    ASSERT_EQ(before, after - Duration::fromTicks(0x200));
+    ASSERT_EQ(uavcan::min(before, after), before);
+
+    // Ordering holds within half of the wrap period
+    const Duration half = Duration::fromTicks(0x7FFFFFFF);
+    ASSERT_LT(before, before + half);
+    ASSERT_GT(before, (before + half) + half);                     // Too far ahead, looks like the past
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/transport/bus_load_estimator.hpp>
+#include "can/can.hpp"
+
+
+TEST(BusLoadEstimator, FrameBitLength)
+{
+    using uavcan::BusLoadEstimator;
+    using uavcan::CanFrame;
+
+    /*
+     * All zeros: 34 stuffable bits (SOF to CRC, the CRC is zero too) get a stuff bit after every five bits
+     */
+    CanFrame frame;
+    frame.id = 0;
+    frame.dlc = 0;
+    ASSERT_EQ(47 + 6, BusLoadEstimator::computeFrameBitLength(frame));
+
+    /*
+     * Bounds: unstuffed length is 47 + 8 * DLC for base frames, 67 + 8 * DLC for extended frames;
+     * at most one stuff bit per four stuffable bits is added
+     */
+    for (uint8_t dlc = 0; dlc <= 8; dlc++)
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            CanFrame std_frame = makeCanFrame(uint32_t(std::rand()) & CanFrame::MaskStdID, "", STD);
+            CanFrame ext_frame = makeCanFrame(uint32_t(std::rand()) & CanFrame::MaskExtID, "", EXT);
+            std_frame.dlc = ext_frame.dlc = dlc;
+            for (int k = 0; k < dlc; k++)
+            {
+                std_frame.data[k] = ext_frame.data[k] = uint8_t(std::rand());
+            }
+            const unsigned std_len = BusLoadEstimator::computeFrameBitLength(std_frame);
+            const unsigned ext_len = BusLoadEstimator::computeFrameBitLength(ext_frame);
+            ASSERT_LE(47U + 8U * dlc, std_len);
+            ASSERT_GE(47U + 8U * dlc + (34U + 8U * dlc - 1U) / 4U, std_len);
+            ASSERT_LE(67U + 8U * dlc, ext_len);
+            ASSERT_GE(67U + 8U * dlc + (54U + 8U * dlc - 1U) / 4U, ext_len);
+        }
+    }
+
+    /*
+     * Stuffing depends on the payload
+     */
+    CanFrame zeros = makeCanFrame(0x555, "", STD);
+    CanFrame alternating = zeros;
+    zeros.dlc = alternating.dlc = 8;
+    std::fill(zeros.data, zeros.data + 8, uint8_t(0));
+    std::fill(alternating.data, alternating.data + 8, uint8_t(0x55));
+    ASSERT_LT(BusLoadEstimator::computeFrameBitLength(alternating), BusLoadEstimator::computeFrameBitLength(zeros));
+
+    /*
+     * Remote frames carry no data; error frames are not accounted for
+     */
+    CanFrame rtr = makeCanFrame(123, "12345678", STD);
+    rtr.id |= CanFrame::FlagRTR;
+    ASSERT_GE(47U + (34U - 1U) / 4U, BusLoadEstimator::computeFrameBitLength(rtr));
+
+    CanFrame err = makeCanFrame(123, "12345678", STD);
+    err.id |= CanFrame::FlagERR;
+    ASSERT_EQ(0, BusLoadEstimator::computeFrameBitLength(err));
+}
+
+
+TEST(BusLoadEstimator, Window)
+{
+    using uavcan::BusLoadEstimator;
+
+    BusLoadEstimator ble;
+    const uavcan::CanFrame frame = makeCanFrame(123, "12345678", EXT);
+    const unsigned frame_len = BusLoadEstimator::computeFrameBitLength(frame);
+
+    /*
+     * Disabled by default
+     */
+    ASSERT_FALSE(ble.isEnabled());
+    ble.addFrame(frame, tsMono(1000000));
+    ASSERT_FLOAT_EQ(0.0F, ble.getLoad(tsMono(1100000)));
+
+    /*
+     * 100 kbit/s, 8 slots of 100 ms
+     */
+    ble.configure(100000, uavcan::MonotonicDuration::fromMSec(800), tsMono(1000000));
+    ASSERT_TRUE(ble.isEnabled());
+    ASSERT_EQ(100000, ble.getBitRate());
+    ASSERT_EQ(800, ble.getWindow().toMSec());
+    ASSERT_FLOAT_EQ(0.0F, ble.getLoad(tsMono(1000000)));
+
+    ble.addFrame(frame, tsMono(1050000));
+    ASSERT_FLOAT_EQ(float(frame_len) / 10000.0F, ble.getLoad(tsMono(1100000)));      // 100 ms elapsed
+    ASSERT_FLOAT_EQ(float(frame_len) / 75000.0F, ble.getLoad(tsMono(1750000)));      // The frame is in the oldest slot
+    ASSERT_FLOAT_EQ(0.0F, ble.getLoad(tsMono(1800000)));                           // Dropped
+
+    /*
+     * Steady traffic - one frame per 10 ms for a long time
+     */
+    for (uint64_t ts = 2000000; ts < 5000000; ts += 10000)
+    {
+        ble.addFrame(frame, tsMono(ts));
+    }
+    ASSERT_NEAR(float(frame_len) * 100.0F / 100000.0F, ble.getLoad(tsMono(5000000)), 0.01F);
+    ASSERT_NEAR(float(frame_len) * 100.0F / 100000.0F, ble.getLoad(tsMono(5000000 + 50000)), 0.05F);
+
+    /*
+     * Saturation
+     */
+    for (int i = 0; i < 1000; i++)
+    {
+        ble.addFrame(frame, tsMono(5100000));
+    }
+    ASSERT_FLOAT_EQ(1.0F, ble.getLoad(tsMono(5100000)));
+
+    /*
+     * Reset
+     */
+    ble.reset(tsMono(6000000));
+    ASSERT_FLOAT_EQ(0.0F, ble.getLoad(tsMono(6050000)));
+    ASSERT_TRUE(ble.isEnabled());
+}
@@ -52,17 +52,26 @@ public:
     bool tx_failure;
     bool rx_failure;
     uint64_t num_errors;
+    uavcan::CanBusState bus_state;
     uavcan::ISystemClock& iclock;
     bool enable_utc_timestamping;
     uavcan::CanFrame pending_tx;
+    bool batch_reception;               ///< Set while the RX queue is drained by receiveBatch()
+    unsigned num_batch_calls;
+    std::vector<uavcan::CanFilterConfig> filters;   ///< Last configuration passed to configureFilters()
+    unsigned num_filter_configurations;
 
     CanIfaceMock(uavcan::ISystemClock& iclock)
         : writeable(true)
         , tx_failure(false)
         , rx_failure(false)
         , num_errors(0)
+        , bus_state(uavcan::CanBusStateUnknown)
         , iclock(iclock)
         , enable_utc_timestamping(false)
+        , batch_reception(false)
+        , num_batch_calls(0)
+        , num_filter_configurations(0)
     { }
 
     void pushRx(const uavcan::CanFrame& frame)
@@ -145,7 +154,7 @@ public:
         assert(this);
         if (loopback.empty())
         {
-            EXPECT_TRUE(rx.size());        // Shall never be called when not readable
+            EXPECT_TRUE(rx.size() || batch_reception);         // Shall never be called when not readable
             if (rx_failure)
             {
                 return -1;
@@ -179,12 +188,30 @@ public:
         return 1;
     }
 
+    virtual uavcan::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                                         uavcan::uint16_t max_frames)
+    {
+        EXPECT_TRUE(rx.size() || loopback.size());              // Shall never be called when not readable
+        num_batch_calls++;
+        batch_reception = true;
+        const uavcan::int16_t res = uavcan::ICanIface::receiveBatch(out_frames, out_flags, max_frames);
+        batch_reception = false;
+        return res;
+    }
+
     // cppcheck-suppress unusedFunction
     // cppcheck-suppress functionConst
-    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs,
+                                             uavcan::uint16_t num_configs)
+    {
+        filters.assign(filter_configs, filter_configs + num_configs);
+        num_filter_configurations++;
+        return 0;
+    }
     // cppcheck-suppress unusedFunction
     virtual uavcan::uint16_t getNumFilters() const { return 4; } // decrease number of HW_filters from 9 to 4
     virtual uavcan::uint64_t getErrorCount() const { return num_errors; }
+    virtual uavcan::CanBusState getBusState() const { return bus_state; }
 };
 
 class CanDriverMock : public uavcan::ICanDriver
@@ -21,6 +21,33 @@ TEST(CanFrame, FrameProperties)
     EXPECT_TRUE(frame.isErrorFrame());
 }
 
+TEST(CanFrame, DataLengthCode)
+{
+    using uavcan::CanFrame;
+
+    for (uint8_t len = 0; len <= 8; len++)
+    {
+        EXPECT_EQ(len, CanFrame::dataLengthToDlc(len));
+        EXPECT_EQ(len, CanFrame::dlcToDataLength(len));
+    }
+
+    static const uint8_t FDLengths[] = { 12, 16, 20, 24, 32, 48, 64 };
+    for (uint8_t i = 0; i < sizeof(FDLengths); i++)
+    {
+        EXPECT_EQ(9 + i, CanFrame::dataLengthToDlc(FDLengths[i]));
+        EXPECT_EQ(FDLengths[i], CanFrame::dlcToDataLength(uint8_t(9 + i)));
+        EXPECT_EQ(FDLengths[i], CanFrame::roundUpDataLength(FDLengths[i]));
+    }
+
+    EXPECT_EQ(12, CanFrame::roundUpDataLength(9));
+    EXPECT_EQ(24, CanFrame::roundUpDataLength(21));
+    EXPECT_EQ(32, CanFrame::roundUpDataLength(25));
+    EXPECT_EQ(48, CanFrame::roundUpDataLength(33));
+    EXPECT_EQ(64, CanFrame::roundUpDataLength(49));
+
+    EXPECT_FALSE(makeCanFrame(0, "12345678", EXT).isCanFD());
+}
+
 TEST(CanFrame, Arbitration)
 {
     using uavcan::CanFrame;
@@ -111,6 +111,65 @@ TEST(CanIOManager, Reception)
     EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
+TEST(CanIOManager, BatchReception)
+{
+    uavcan::PoolAllocator<sizeof(uavcan::CanTxQueue::Entry) * 4, sizeof(uavcan::CanTxQueue::Entry)> pool;
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+    uavcan::CanIOManager iomgr(driver, pool, clockmock);
+
+    uavcan::CanRxFrame frames[4];
+    uavcan::CanIOFlags flags[4] = {};
+
+    // Empty, will time out
+    EXPECT_EQ(0, iomgr.receiveBatch(frames, flags, 4, tsMono(100)));
+
+    const uavcan::CanFrame a0 = makeCanFrame(1, "a0", EXT);
+    const uavcan::CanFrame a1 = makeCanFrame(99, "a1", EXT);
+    const uavcan::CanFrame a2 = makeCanFrame(803, "a2", STD);
+    const uavcan::CanFrame b0 = makeCanFrame(6341, "b0", EXT);
+
+    clockmock.advance(10);
+    driver.ifaces.at(0).pushRx(a0);         // Timestamp 110
+    driver.ifaces.at(0).pushRx(a1);
+    driver.ifaces.at(0).pushRx(a2);
+    driver.ifaces.at(1).pushRx(b0);
+
+    // Limited by the array size
+    EXPECT_EQ(2, iomgr.receiveBatch(frames, flags, 2, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], a0, 110, 0));
+    EXPECT_TRUE(rxFrameEquals(frames[1], a1, 110, 0));
+
+    // One iface per call
+    EXPECT_EQ(1, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], a2, 110, 0));
+
+    EXPECT_EQ(1, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], b0, 110, 1));
+    EXPECT_EQ(0, flags[0]);
+
+    EXPECT_EQ(0, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+
+    EXPECT_EQ(2, driver.ifaces.at(0).num_batch_calls);
+    EXPECT_EQ(3, iomgr.getIfacePerfCounters(0).frames_rx);
+    EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).frames_rx);
+
+    // Loopback frames are mixed with regular ones and flagged accordingly; not counted as RX
+    driver.ifaces.at(1).pushRx(a0);
+    driver.ifaces.at(1).loopback.push(CanIfaceMock::FrameWithTime(b0, 120));
+    EXPECT_EQ(2, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+    EXPECT_TRUE(rxFrameEquals(frames[0], b0, 120, 1));
+    EXPECT_EQ(uavcan::CanIOFlagLoopback, flags[0]);
+    EXPECT_TRUE(rxFrameEquals(frames[1], a0, 110, 1));
+    EXPECT_EQ(0, flags[1]);
+    EXPECT_EQ(2, iomgr.getIfacePerfCounters(1).frames_rx);
+
+    // Driver failure
+    driver.ifaces.at(1).pushRx(a0);
+    driver.ifaces.at(1).rx_failure = true;
+    EXPECT_EQ(-uavcan::ErrDriver, iomgr.receiveBatch(frames, flags, 4, uavcan::MonotonicTime()));
+}
+
 TEST(CanIOManager, Transmission)
 {
     using uavcan::CanIOManager;
@@ -176,7 +235,7 @@ TEST(CanIOManager, Transmission)
     // Sending to both, both blocked
     driver.ifaces.at(1).writeable = false;
     EXPECT_EQ(0, iomgr.send(frames[1], tsMono(777), tsMono(300), ALL_IFACES_MASK, CanTxQueue::Volatile, flags));
-    EXPECT_EQ(3, pool.getNumUsedBlocks());          // Total 3 frames in TX queue now
+    EXPECT_EQ(2, pool.getNumUsedBlocks());          // Total 3 frames in TX queue now, frames[1] is stored once
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0])); // Still 0
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1])); // 1!!
 
@@ -186,7 +245,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(400, clockmock.utc);
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
     EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
-    EXPECT_EQ(4, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1]));
 
@@ -228,17 +287,16 @@ TEST(CanIOManager, Transmission)
     driver.ifaces.at(0).writeable = false;
     driver.ifaces.at(1).writeable = false;
 
-    // Sending 5 frames, one will be rejected
+    // Sending 5 frames; the redundant ones are stored once, so nothing will be rejected
     EXPECT_EQ(0, iomgr.send(frames[2], tsMono(2222), tsMono(1000), ALL_IFACES_MASK, CanTxQueue::Persistent, flags));
     EXPECT_EQ(0, iomgr.send(frames[0], tsMono(3333), tsMono(1100), 2, CanTxQueue::Persistent, flags));
-    // One frame kicked here:
     EXPECT_EQ(0, iomgr.send(frames[1], tsMono(4444), tsMono(1200), ALL_IFACES_MASK, CanTxQueue::Volatile, flags));
 
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[1]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[0]));
 
     // State checks
-    EXPECT_EQ(4, pool.getNumUsedBlocks());          // TX queue is full
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
     EXPECT_EQ(1200, clockmock.monotonic);
     EXPECT_EQ(1200, clockmock.utc);
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
@@ -264,9 +322,16 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
     EXPECT_TRUE(rxFrameEquals(rx_frame, rx_frames[1], 1200, 1));
     EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(frames[2], 2222));
-    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));  // Iface #1, frame[1] was rejected (VOLATILE)
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[1], 4444));
     ASSERT_EQ(0, flags);
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[2]));
+    EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[1]));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());          // frames[2] is still pending for iface #1
+
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), flags));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(frames[2], 2222));
+    ASSERT_EQ(0, flags);
+    EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(uavcan::CanFrame()));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[2]));
 
     // State checks
@@ -276,7 +341,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(0).tx.empty());
     EXPECT_TRUE(driver.ifaces.at(1).tx.empty());
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(0).errors);
-    EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).errors); // This is because of rejected frame[1]
+    EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).errors);
 
     /*
      * Error handling
@@ -303,7 +368,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_TRUE(driver.ifaces.at(0).matchPendingTx(frames[0]));
     EXPECT_TRUE(driver.ifaces.at(1).matchPendingTx(frames[0]));
 
-    ASSERT_EQ(2, pool.getNumUsedBlocks());               // Untransmitted frames will be buffered
+    ASSERT_EQ(1, pool.getNumUsedBlocks());               // Untransmitted frames will be buffered, in one entry
 
     // Failure removed - transmission shall proceed
     driver.ifaces.at(0).tx_failure = false;
@@ -323,7 +388,7 @@ TEST(CanIOManager, Transmission)
     EXPECT_EQ(1, iomgr.getIfacePerfCounters(1).frames_rx);
 
     EXPECT_EQ(6, iomgr.getIfacePerfCounters(0).frames_tx);
-    EXPECT_EQ(8, iomgr.getIfacePerfCounters(1).frames_tx);
+    EXPECT_EQ(9, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
 TEST(CanIOManager, Loopback)
@@ -380,7 +445,321 @@ TEST(CanIOManager, Loopback)
     EXPECT_EQ(0, iomgr.getIfacePerfCounters(1).frames_tx);
 }
 
+#if UAVCAN_LATENCY_HISTOGRAMS
+TEST(CanIOManager, TxQueueLatency)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 4, sizeof(CanTxQueue::Entry)> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock);
+    const uavcan::LatencyHistogram& hist = iomgr.getTxQueueLatencyHistogram();
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "a", EXT);
+    uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    // Transmitted immediately, not counted
+    ASSERT_EQ(2, iomgr.send(frame, tsMono(10000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(0, hist.getNumSamples());
+
+    // Queued for both interfaces, transmitted 700 usec later via #1 and 3000 usec later via #0
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    ASSERT_EQ(0, iomgr.send(frame, tsMono(10000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(0, hist.getNumSamples());
+
+    clockmock.advance(700);
+    driver.ifaces.at(1).writeable = true;
+    uavcan::CanRxFrame rx_frame;
+    ASSERT_EQ(0, iomgr.receive(rx_frame, tsMono(0), flags));
+    ASSERT_EQ(1, hist.getNumSamples());
+    ASSERT_EQ(700, hist.max_usec);
+    ASSERT_EQ(1, hist.bins[10]);                        // [512, 1024)
+
+    clockmock.advance(2300);
+    driver.ifaces.at(0).writeable = true;
+    ASSERT_EQ(0, iomgr.receive(rx_frame, tsMono(0), flags));
+    ASSERT_EQ(2, hist.getNumSamples());
+    ASSERT_EQ(3000, hist.max_usec);
+    ASSERT_EQ(1, hist.bins[12]);                        // [2048, 4096)
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    iomgr.getTxQueueLatencyHistogram().reset();
+    ASSERT_EQ(0, hist.getNumSamples());
+}
+#endif
+
 TEST(CanIOManager, Size)
 {
     std::cout << sizeof(uavcan::CanIOManager) << std::endl;
 }
+
+#if !UAVCAN_TINY
+TEST(CanIOManager, BusLoad)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<sizeof(CanTxQueue::Entry) * 4, sizeof(CanTxQueue::Entry)> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock);
+
+    const uavcan::CanFrame frame = makeCanFrame(123, "12345678", EXT);
+    const float frame_len = float(uavcan::BusLoadEstimator::computeFrameBitLength(frame));
+    uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+
+    /*
+     * Disabled by default
+     */
+    ASSERT_EQ(1, iomgr.send(frame, tsMono(2000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    clockmock.advance(100000);
+    ASSERT_FLOAT_EQ(0.0F, iomgr.getBusLoad(0));
+    ASSERT_FALSE(iomgr.getBusLoadEstimator(0).isEnabled());
+
+    /*
+     * 100 kbit/s; TX via iface 0, loopback not counted twice, RX via iface 1
+     */
+    iomgr.configureBusLoadEstimation(100000, uavcan::MonotonicDuration::fromMSec(800));
+    ASSERT_TRUE(iomgr.getBusLoadEstimator(1).isEnabled());
+
+    ASSERT_EQ(1, iomgr.send(frame, tsMono(2000000), tsMono(0), 1, CanTxQueue::Volatile, uavcan::CanIOFlagLoopback));
+    uavcan::CanRxFrame rx_frame;
+    ASSERT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
+    ASSERT_EQ(uavcan::CanIOFlagLoopback, flags);
+
+    driver.ifaces.at(1).pushRx(frame);
+    driver.ifaces.at(1).pushRx(frame);
+    ASSERT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
+    ASSERT_EQ(1, iomgr.receive(rx_frame, tsMono(0), flags));
+
+    clockmock.advance(100000);
+    ASSERT_FLOAT_EQ(frame_len / 10000.0F, iomgr.getBusLoad(0));
+    ASSERT_FLOAT_EQ(frame_len * 2.0F / 10000.0F, iomgr.getBusLoad(1));
+
+    clockmock.advance(800000);
+    ASSERT_FLOAT_EQ(0.0F, iomgr.getBusLoad(0));
+    ASSERT_FLOAT_EQ(0.0F, iomgr.getBusLoad(1));
+
+    /*
+     * Disabling
+     */
+    iomgr.configureBusLoadEstimation(0);
+    ASSERT_FALSE(iomgr.getBusLoadEstimator(0).isEnabled());
+}
+#endif
+
+TEST(CanIOManager, EmergencyLane)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 2, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock;
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock);
+
+    const uavcan::CanFrame bulk0 = makeCanFrame(100, "bulk0", EXT);
+    const uavcan::CanFrame bulk1 = makeCanFrame(101, "bulk1", EXT);
+    const uavcan::CanFrame bulk2 = makeCanFrame(102, "bulk2", EXT);
+    const uavcan::CanFrame panic = makeCanFrame(900, "panic", EXT);     // Lower CAN priority than the bulk traffic
+
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    const uavcan::CanIOFlags emergency = uavcan::CanIOFlagEmergency;
+
+    /*
+     * The TX queue quota is exhausted by the bulk traffic; the emergency frame is queued anyway
+     */
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    EXPECT_EQ(0, iomgr.send(bulk0, tsMono(1000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(bulk1, tsMono(1000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(0, iomgr.send(bulk2, tsMono(1000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());          // One frame per interface
+    EXPECT_LT(0, iomgr.getIfacePerfCounters(0).errors);
+
+    const uint64_t errors_before = iomgr.getIfacePerfCounters(0).errors;
+    EXPECT_EQ(0, iomgr.send(panic, tsMono(1000), tsMono(0), 3, CanTxQueue::Volatile, emergency));
+    EXPECT_EQ(1, iomgr.getEmergencyTxLane().getSize());
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(errors_before, iomgr.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(3, iomgr.makePendingTxMask());
+
+    /*
+     * The emergency frame goes first regardless of the CAN priority, and the flag is not passed to the driver
+     */
+    driver.ifaces.at(0).writeable = true;
+    driver.ifaces.at(1).writeable = true;
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = 0;
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    ASSERT_FALSE(driver.ifaces.at(0).tx.empty());
+    EXPECT_EQ(0, driver.ifaces.at(0).tx.front().flags);
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(panic, 1000));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(panic, 1000));
+    EXPECT_TRUE(iomgr.getEmergencyTxLane().isEmpty());
+
+    // An emergency frame sent directly goes before the queued bulk frames as well
+    EXPECT_EQ(2, iomgr.send(panic, tsMono(1000), tsMono(0), 3, CanTxQueue::Volatile, emergency));
+    EXPECT_TRUE(driver.ifaces.at(0).matchAndPopTx(panic, 1000));
+    EXPECT_TRUE(driver.ifaces.at(1).matchAndPopTx(panic, 1000));
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+
+    /*
+     * The bulk frames expire, the lane overflows into the regular queue, then everything expires
+     */
+    driver.ifaces.at(0).writeable = false;
+    driver.ifaces.at(1).writeable = false;
+    clockmock.advance(1001);
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+
+    for (unsigned i = 0; i < uavcan::CanEmergencyTxLane::Capacity; i++)
+    {
+        EXPECT_EQ(0, iomgr.send(panic, tsMono(3000), tsMono(0), 1, CanTxQueue::Volatile, emergency));
+    }
+    EXPECT_EQ(unsigned(uavcan::CanEmergencyTxLane::Capacity), iomgr.getEmergencyTxLane().getSize());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, iomgr.send(panic, tsMono(3000), tsMono(0), 1, CanTxQueue::Volatile, emergency));
+    EXPECT_EQ(unsigned(uavcan::CanEmergencyTxLane::Capacity), iomgr.getEmergencyTxLane().getSize());
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(1, iomgr.makePendingTxMask());
+
+    const uint64_t errors_before_expiry = iomgr.getIfacePerfCounters(0).errors;
+    clockmock.advance(2000);
+    EXPECT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    EXPECT_TRUE(iomgr.getEmergencyTxLane().isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(errors_before_expiry + uavcan::CanEmergencyTxLane::Capacity + 1, iomgr.getIfacePerfCounters(0).errors);
+    EXPECT_EQ(0, iomgr.makePendingTxMask());
+}
+
+#if !UAVCAN_TINY
+TEST(CanIOManager, IfaceHealth)
+{
+    using uavcan::CanIOManager;
+    using uavcan::CanTxQueue;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(1000000);
+    CanDriverMock driver(2, clockmock);
+
+    CanIOManager iomgr(driver, pool, clockmock);
+
+    const uavcan::CanFrame fr1 = makeCanFrame(101, "fr1", EXT);
+    const uavcan::CanFrame fr2 = makeCanFrame(102, "fr2", EXT);
+    const uavcan::CanFrame fr3 = makeCanFrame(103, "fr3", EXT);
+    const uavcan::CanFrame fr4 = makeCanFrame(104, "fr4", EXT);
+    const uavcan::CanIOFlags flags = uavcan::CanIOFlags();
+    const uavcan::MonotonicDuration check_period =
+        uavcan::MonotonicDuration::fromMSec(CanIOManager::IfaceHealthCheckPeriodMs);
+
+    ASSERT_EQ(uavcan::CanBusStateErrorActive, iomgr.getIfaceBusState(1));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));
+
+    /*
+     * Bus off reported by the driver; the first frame is kept as a probe, the rest are not queued
+     */
+    driver.ifaces.at(1).bus_state = uavcan::CanBusStateBusOff;
+    driver.ifaces.at(1).writeable = false;
+    ASSERT_EQ(1, iomgr.send(fr1, tsMono(2000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(uavcan::CanBusStateBusOff, iomgr.getIfaceBusState(1));
+    ASSERT_TRUE(iomgr.isIfaceTxSuppressed(1));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(0));
+    ASSERT_TRUE(driver.ifaces.at(0).matchAndPopTx(fr1, 2000000));
+    ASSERT_EQ(2, iomgr.makePendingTxMask());
+
+    ASSERT_EQ(1, iomgr.send(fr2, tsMono(2000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_TRUE(driver.ifaces.at(0).matchAndPopTx(fr2, 2000000));
+    ASSERT_EQ(1, pool.getNumUsedBlocks());
+    ASSERT_EQ(1, iomgr.getIfacePerfCounters(1).errors);
+    ASSERT_EQ(0, iomgr.getIfacePerfCounters(0).errors);
+
+    // Frames addressed to the suppressed interface only are not moved to another one
+    ASSERT_EQ(0, iomgr.send(fr3, tsMono(2000000), tsMono(0), 2, CanTxQueue::Volatile, flags));
+    ASSERT_TRUE(driver.ifaces.at(0).tx.empty());
+    ASSERT_EQ(2, iomgr.getIfacePerfCounters(1).errors);
+
+    /*
+     * Recovery reported by the driver; the probe goes first
+     */
+    driver.ifaces.at(1).bus_state = uavcan::CanBusStateErrorActive;
+    driver.ifaces.at(1).writeable = true;
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    ASSERT_EQ(2, iomgr.send(fr3, tsMono(2000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));
+    ASSERT_TRUE(driver.ifaces.at(0).matchAndPopTx(fr3, 2000000));
+    ASSERT_TRUE(driver.ifaces.at(1).matchAndPopTx(fr1, 2000000));
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());                // fr3 was suppressed on iface 1
+    ASSERT_EQ(3, iomgr.getIfacePerfCounters(1).errors);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    /*
+     * Error passive is suppressed only if the other interface is error active
+     */
+    driver.ifaces.at(1).bus_state = uavcan::CanBusStateErrorPassive;
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    ASSERT_EQ(2, iomgr.send(fr1, tsMono(2000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_TRUE(iomgr.isIfaceTxSuppressed(1));
+    ASSERT_EQ(uavcan::CanBusStateErrorPassive, iomgr.getIfaceBusState(1));
+
+    driver.ifaces.at(0).bus_state = uavcan::CanBusStateErrorPassive;
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    ASSERT_EQ(2, iomgr.send(fr2, tsMono(2000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(0));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));
+
+    driver.ifaces.at(0).bus_state = uavcan::CanBusStateUnknown;
+    driver.ifaces.at(1).bus_state = uavcan::CanBusStateUnknown;
+    driver.ifaces.at(0).tx = std::queue<CanIfaceMock::FrameWithTime>();
+    driver.ifaces.at(1).tx = std::queue<CanIfaceMock::FrameWithTime>();
+
+    /*
+     * Bus off inferred from the error count: the errors grow while the pending frames don't get through
+     */
+    driver.ifaces.at(1).writeable = false;
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    ASSERT_EQ(1, iomgr.send(fr1, tsMono(5000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(1, iomgr.send(fr2, tsMono(5000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(1, iomgr.send(fr3, tsMono(5000000), tsMono(0), 3, CanTxQueue::Volatile, flags));
+    ASSERT_EQ(3, pool.getNumUsedBlocks());
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));
+
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    ASSERT_EQ(1, iomgr.send(fr4, tsMono(5000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));                 // The frames were not pending before
+
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    ASSERT_EQ(1, iomgr.send(fr4, tsMono(5000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));                 // No errors - the bus may be just busy
+
+    driver.ifaces.at(1).num_errors += 10;
+    clockmock.advance(uint64_t(check_period.toUSec()));
+    const uint64_t errors_before = iomgr.getIfacePerfCounters(1).errors;
+    ASSERT_EQ(1, iomgr.send(fr4, tsMono(5000000), tsMono(0), 1, CanTxQueue::Volatile, flags));
+    ASSERT_TRUE(iomgr.isIfaceTxSuppressed(1));
+    ASSERT_EQ(uavcan::CanBusStateBusOff, iomgr.getIfaceBusState(1));
+    ASSERT_EQ(1, pool.getNumUsedBlocks());                      // Only the probe is left
+    ASSERT_EQ(errors_before + 2, iomgr.getIfacePerfCounters(1).errors);
+    ASSERT_EQ(2, iomgr.makePendingTxMask());
+
+    // Recovers as soon as the probe has been transmitted
+    driver.ifaces.at(1).writeable = true;
+    uavcan::CanRxFrame rx_frame;
+    uavcan::CanIOFlags rx_flags = 0;
+    ASSERT_EQ(0, iomgr.receive(rx_frame, tsMono(0), rx_flags));
+    ASSERT_TRUE(driver.ifaces.at(1).matchAndPopTx(fr1, 5000000));
+    ASSERT_FALSE(iomgr.isIfaceTxSuppressed(1));
+    ASSERT_EQ(uavcan::CanBusStateErrorActive, iomgr.getIfaceBusState(1));
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+
+/**
+ * Driver types for the library flavour built with the static driver binding (see UAVCAN_STATIC_DRIVER_HEADER),
+ * so that this configuration is compiled by every debug build. The interface methods are private, as in the
+ * STM32 driver, to make sure that the library calls them through uavcan::DriverBinding only.
+ */
+namespace static_binding_test
+{
+
+class CanIface : public uavcan::ICanIface
+{
+    friend struct uavcan::DriverBinding;
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags) { return 1; }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame&, uavcan::MonotonicTime&, uavcan::UtcTime&,
+                                    uavcan::CanIOFlags&)
+    {
+        return 0;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return 0; }
+};
+
+class CanDriver : public uavcan::ICanDriver
+{
+    friend struct uavcan::DriverBinding;
+
+    CanIface iface_;
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) { return (iface_index == 0) ? &iface_ : NULL; }
+    virtual uavcan::uint8_t getNumIfaces() const { return 1; }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces], uavcan::MonotonicTime)
+    {
+        inout_masks.read = 0;
+        inout_masks.write = 1;
+        return 1;
+    }
+};
+
+class SystemClock : public uavcan::ISystemClock
+{
+    friend struct uavcan::DriverBinding;
+
+    virtual uavcan::MonotonicTime getMonotonic() const { return uavcan::MonotonicTime::fromUSec(1000); }
+    virtual uavcan::UtcTime getUtc() const { return uavcan::UtcTime(); }
+    virtual void adjustUtc(uavcan::UtcDuration) { }
+};
+
+}
@@ -2,6 +2,10 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/transport/can_io.hpp>
 #include "can.hpp"
@@ -65,9 +69,16 @@ TEST(CanTxQueue, TxQueue)
     using uavcan::CanTxQueue;
     using uavcan::CanFrame;
 
-    ASSERT_GE(40, sizeof(CanTxQueue::Entry)); // should be true for any platforms, though not required
+    // should be true for any platforms, though not required; the doubly-linked list costs one more pointer,
+    // the deadline index costs two more
+#if UAVCAN_DOUBLY_LINKED_LISTS
+    static const unsigned EntryBlockSize = 64;
+#else
+    static const unsigned EntryBlockSize = 56;
+#endif
+    ASSERT_GE(EntryBlockSize, sizeof(CanTxQueue::Entry));
 
-    uavcan::PoolAllocator<40 * 4, 40> pool;
+    uavcan::PoolAllocator<EntryBlockSize * 4, EntryBlockSize> pool;
 
     SystemClockMock clockmock;
 
@@ -214,3 +225,456 @@ TEST(CanTxQueue, TxQueue)
     EXPECT_FALSE(queue.peek());
     EXPECT_FALSE(queue.topPriorityHigherOrEqual(f0));
 }
+
+static bool frameOrderPredicate(const uavcan::CanFrame& a, const uavcan::CanFrame& b)
+{
+    return a.priorityHigherThan(b);
+}
+
+TEST(CanTxQueue, PriorityOrdering)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    static const unsigned NumFrames = 300;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumFrames, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    std::srand(42);
+
+    /*
+     * Bursts of frames with the same CAN ID interleaved with random frames, both STD and EXT.
+     * Frames with equal CAN ID are distinguished by their payload.
+     */
+    std::vector<CanFrame> reference;
+    while (reference.size() < NumFrames)
+    {
+        const bool ext = (std::rand() % 4) != 0;
+        const uint32_t id = uint32_t(std::rand()) & (ext ? CanFrame::MaskExtID : CanFrame::MaskStdID);
+        const unsigned burst_len = (std::rand() % 3 == 0) ? unsigned(std::rand() % 20) : 1U;
+
+        for (unsigned i = 0; (i < burst_len) && (reference.size() < NumFrames); i++)
+        {
+            char payload[8];
+            (void)std::snprintf(payload, sizeof(payload), "%u", unsigned(reference.size()));
+            const CanFrame frame = makeCanFrame(id, payload, ext ? EXT : STD);
+            reference.push_back(frame);
+            queue.push(frame, tsMono(1000), CanTxQueue::Volatile, 0);
+        }
+    }
+    ASSERT_EQ(0, queue.getRejectedFrameCount());
+    ASSERT_EQ(NumFrames, unsigned(getQueueLength(queue)));
+
+    std::stable_sort(reference.begin(), reference.end(), &frameOrderPredicate);
+
+    /*
+     * Removing from the middle and from the top, then checking the order
+     */
+    for (unsigned i = 0; i < 50; i++)
+    {
+        const unsigned index = unsigned(std::rand()) % unsigned(reference.size());
+        CanTxQueue::Entry* entry = queue.peek();
+        for (unsigned k = 0; k < index; k++)
+        {
+            entry = entry->getNextListNode();
+        }
+        ASSERT_EQ(reference.at(index), entry->frame);
+        queue.remove(entry);
+        reference.erase(reference.begin() + index);
+    }
+
+    for (unsigned i = 0; i < 50; i++)
+    {
+        const bool ext = (std::rand() % 4) != 0;
+        const CanFrame frame = makeCanFrame(uint32_t(std::rand()) & (ext ? CanFrame::MaskExtID : CanFrame::MaskStdID),
+                                            "new", ext ? EXT : STD);
+        reference.insert(std::upper_bound(reference.begin(), reference.end(), frame, &frameOrderPredicate), frame);
+        queue.push(frame, tsMono(1000), CanTxQueue::Volatile, 0);
+    }
+
+    for (unsigned i = 0; i < reference.size(); i++)
+    {
+        CanTxQueue::Entry* entry = queue.peek();
+        ASSERT_TRUE(entry);
+        ASSERT_EQ(reference[i], entry->frame);
+        queue.remove(entry);
+    }
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, Coalescing)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uavcan::CanIOFlags coalesce = uavcan::CanIOFlagCoalesce;
+
+    const CanFrame higher = makeCanFrame(100, "higher", EXT);
+    const CanFrame old_value = makeCanFrame(200, "old", EXT);
+    const CanFrame other = makeCanFrame(200, "other", EXT);        // Same ID, pushed without the flag
+    const CanFrame lower = makeCanFrame(300, "lower", EXT);
+
+    // Nothing to replace yet
+    EXPECT_FALSE(queue.replace(old_value, tsMono(1000), CanTxQueue::Volatile, coalesce));
+    EXPECT_TRUE(queue.isEmpty());
+
+    queue.push(other, tsMono(1000), CanTxQueue::Volatile, 0);
+    EXPECT_FALSE(queue.replace(old_value, tsMono(1000), CanTxQueue::Volatile, coalesce));
+
+    queue.push(higher, tsMono(1000), CanTxQueue::Volatile, coalesce);
+    queue.push(old_value, tsMono(1000), CanTxQueue::Volatile, coalesce);
+    queue.push(lower, tsMono(1000), CanTxQueue::Volatile, coalesce);
+    ASSERT_EQ(4, getQueueLength(queue));
+    ASSERT_EQ(4, pool.getNumUsedBlocks());
+
+    /*
+     * New values replace the old one in place; the frame pushed without the flag stays intact
+     */
+    for (int i = 0; i < 10; i++)
+    {
+        char payload[8];
+        (void)std::snprintf(payload, sizeof(payload), "new%i", i);
+        queue.push(makeCanFrame(200, payload, EXT), tsMono(2000 + uint64_t(i)), CanTxQueue::Volatile, coalesce);
+    }
+    const CanFrame new_value = makeCanFrame(200, "new9", EXT);
+    EXPECT_EQ(4, getQueueLength(queue));
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, queue.getRejectedFrameCount());
+    EXPECT_FALSE(isInQueue(queue, old_value));
+
+    // A different ID is appended as usual
+    const CanFrame std_frame = makeCanFrame(200, "std", STD);
+    queue.push(std_frame, tsMono(1000), CanTxQueue::Volatile, coalesce);
+    EXPECT_EQ(5, getQueueLength(queue));
+
+    const CanFrame expected_order[] = { higher, other, new_value, lower, std_frame };
+    for (unsigned i = 0; i < sizeof(expected_order) / sizeof(expected_order[0]); i++)
+    {
+        CanTxQueue::Entry* entry = queue.peek();
+        ASSERT_TRUE(entry);
+        ASSERT_EQ(expected_order[i], entry->frame);
+        if (entry->frame == new_value)
+        {
+            EXPECT_EQ(tsMono(2009), entry->deadline);
+        }
+        queue.remove(entry);
+    }
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+}
+
+TEST(CanTxQueue, SharedEntries)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanTxQueue queue(pool, clockmock, 4, 2);           // Two frames per iface
+
+    const CanFrame f0 = makeCanFrame(100, "f0", EXT);
+    const CanFrame f1 = makeCanFrame(200, "f1", EXT);
+    const CanFrame f2 = makeCanFrame(300, "f2", EXT);
+
+    /*
+     * One entry for both ifaces, destroyed when transmitted via both
+     */
+    queue.push(f1, tsMono(1000), CanTxQueue::Volatile, 0, 3);
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, queue.getPendingIfaceMask());
+    EXPECT_EQ(f1, *queue.getTopPriorityPendingFrame(0));
+    EXPECT_EQ(f1, *queue.getTopPriorityPendingFrame(1));
+
+    queue.push(f0, tsMono(1000), CanTxQueue::Volatile, 0, 2);
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(f1, *queue.getTopPriorityPendingFrame(0));
+    EXPECT_EQ(f0, *queue.getTopPriorityPendingFrame(1));
+    EXPECT_TRUE(queue.topPriorityHigherOrEqual(f1, 0));
+    EXPECT_FALSE(queue.topPriorityHigherOrEqual(f0, 0));
+    EXPECT_TRUE(queue.topPriorityHigherOrEqual(f0, 1));
+
+    CanTxQueue::Entry* entry = queue.peek(0);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(f1, entry->frame);
+    queue.remove(entry, 0);
+    EXPECT_FALSE(entry);
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(2, queue.getPendingIfaceMask());
+    EXPECT_FALSE(queue.peek(0));
+
+    entry = queue.peek(1);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(f0, entry->frame);
+    queue.remove(entry, 1);
+    entry = queue.peek(1);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(f1, entry->frame);
+    queue.remove(entry, 1);
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, queue.getPendingIfaceMask());
+    EXPECT_TRUE(queue.isEmpty());
+
+    /*
+     * Iface #1 is stuck; it can't take the quota of iface #0
+     */
+    queue.push(f1, tsMono(1000), CanTxQueue::Volatile, 0, 2);
+    queue.push(f2, tsMono(1000), CanTxQueue::Volatile, 0, 2);
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, queue.getRejectedFrameCount(1));
+
+    queue.push(f0, tsMono(1000), CanTxQueue::Volatile, 0, 3);      // Replaces f2 on iface #1
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, queue.getRejectedFrameCount(0));
+    EXPECT_EQ(1, queue.getRejectedFrameCount(1));
+    EXPECT_EQ(f0, *queue.getTopPriorityPendingFrame(0));
+    EXPECT_EQ(f0, *queue.getTopPriorityPendingFrame(1));
+
+    queue.push(f2, tsMono(1000), CanTxQueue::Volatile, 0, 3);      // Rejected on iface #1, enqueued for iface #0
+    EXPECT_EQ(3, pool.getNumUsedBlocks());
+    EXPECT_EQ(0, queue.getRejectedFrameCount(0));
+    EXPECT_EQ(2, queue.getRejectedFrameCount(1));
+
+    /*
+     * Expired entries are counted for all ifaces they were pending for
+     */
+    clockmock.advance(1001);
+    EXPECT_FALSE(queue.peek(0));
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(2, queue.getRejectedFrameCount(0));
+    EXPECT_EQ(4, queue.getRejectedFrameCount(1));
+}
+
+TEST(CanTxQueue, DeadlineExpiry)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uavcan::CanIOFlags coalesce = uavcan::CanIOFlagCoalesce;
+
+    const CanFrame f0 = makeCanFrame(100, "f0", EXT);
+    const CanFrame f1 = makeCanFrame(200, "f1", EXT);
+    const CanFrame f2 = makeCanFrame(300, "f2", EXT);
+    const CanFrame f3 = makeCanFrame(400, "f3", EXT);
+    const CanFrame f4 = makeCanFrame(500, "f4", EXT);
+
+    // Deadlines are not in the order of priority nor in the order of insertion
+    queue.push(f2, tsMono(300), CanTxQueue::Volatile, 0);
+    queue.push(f0, tsMono(500), CanTxQueue::Volatile, 0);
+    queue.push(f3, tsMono(100), CanTxQueue::Volatile, 0);
+    queue.push(f1, tsMono(300), CanTxQueue::Volatile, 0);
+    queue.push(f4, tsMono(200), CanTxQueue::Volatile, coalesce);
+    EXPECT_EQ(5, pool.getNumUsedBlocks());
+
+    // Nothing expired yet
+    queue.removeExpired(tsMono(100));
+    EXPECT_EQ(5, getQueueLength(queue));
+    EXPECT_EQ(0, queue.getRejectedFrameCount());
+
+    queue.removeExpired(tsMono(101));
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+    EXPECT_EQ(1, queue.getRejectedFrameCount());
+    EXPECT_FALSE(isInQueue(queue, f3));
+
+    // Coalescing moves the deadline
+    EXPECT_TRUE(queue.replace(f4, tsMono(1000), CanTxQueue::Volatile, coalesce));
+    queue.removeExpired(tsMono(201));
+    EXPECT_EQ(4, pool.getNumUsedBlocks());
+
+    // Equal deadlines expire together
+    queue.removeExpired(tsMono(301));
+    EXPECT_EQ(2, pool.getNumUsedBlocks());
+    EXPECT_EQ(3, queue.getRejectedFrameCount());
+    EXPECT_TRUE(isInQueue(queue, f0));
+    EXPECT_TRUE(isInQueue(queue, f4));
+
+    // Removal of a transmitted entry keeps the index consistent
+    CanTxQueue::Entry* entry = queue.peek(0, tsMono(301));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(f0, entry->frame);
+    queue.remove(entry);
+
+    queue.push(f1, tsMono(600), CanTxQueue::Volatile, 0);
+    clockmock.advance(601);
+    entry = queue.peek(0);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(f4, entry->frame);
+    EXPECT_EQ(1, pool.getNumUsedBlocks());
+    EXPECT_EQ(4, queue.getRejectedFrameCount());
+
+    queue.removeExpired(tsMono(1001));
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_EQ(0, pool.getNumUsedBlocks());
+    EXPECT_EQ(5, queue.getRejectedFrameCount());
+}
+
+#if !UAVCAN_TINY
+TEST(CanTxQueue, FairScheduling)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    // Same priority level, except for the last one
+    const CanFrame a1 = makeCanFrame(0x01000100, "a1", EXT);
+    const CanFrame a2 = makeCanFrame(0x01000100, "a2", EXT);
+    const CanFrame a3 = makeCanFrame(0x01000100, "a3", EXT);
+    const CanFrame b1 = makeCanFrame(0x01000200, "b1", EXT);
+    const CanFrame b2 = makeCanFrame(0x01000200, "b2", EXT);
+    const CanFrame c1 = makeCanFrame(0x01000300, "c1", EXT);
+    const CanFrame low = makeCanFrame(0x1F000000, "low", EXT);
+
+    const CanFrame* const input[] = { &low, &c1, &a1, &a2, &b1, &a3, &b2 };
+    const CanFrame* const strict_order[] = { &a1, &a2, &a3, &b1, &b2, &c1, &low };
+    const CanFrame* const fair_order[] = { &a1, &b1, &c1, &a2, &b2, &a3, &low };
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const bool fair = pass > 0;
+        queue.setFairScheduling(fair);
+        ASSERT_EQ(fair, queue.isFairScheduling());
+
+        for (unsigned i = 0; i < 7; i++)
+        {
+            queue.push(*input[i], tsMono(1000), CanTxQueue::Volatile, 0);
+        }
+        EXPECT_EQ(7, pool.getNumUsedBlocks());
+
+        for (unsigned i = 0; i < 7; i++)
+        {
+            CanTxQueue::Entry* entry = queue.peek(0);
+            ASSERT_TRUE(entry);
+            EXPECT_EQ(fair ? *fair_order[i] : *strict_order[i], entry->frame);
+            ASSERT_TRUE(queue.getTopPriorityPendingFrame(0));
+            EXPECT_EQ(entry->frame, *queue.getTopPriorityPendingFrame(0));
+            queue.remove(entry, 0);
+        }
+        EXPECT_TRUE(queue.isEmpty());
+    }
+
+    /*
+     * A frame of higher priority preempts the round, which continues afterwards
+     */
+    queue.push(a1, tsMono(1000), CanTxQueue::Volatile, 0);
+    queue.push(b1, tsMono(1000), CanTxQueue::Volatile, 0);
+    queue.push(c1, tsMono(1000), CanTxQueue::Volatile, 0);
+
+    CanTxQueue::Entry* entry = queue.peek(0);
+    EXPECT_EQ(a1, entry->frame);
+    queue.remove(entry, 0);
+
+    const CanFrame urgent = makeCanFrame(1, "urgent", EXT);
+    queue.push(urgent, tsMono(1000), CanTxQueue::Volatile, 0);
+    entry = queue.peek(0);
+    EXPECT_EQ(urgent, entry->frame);
+    queue.remove(entry, 0);
+
+    entry = queue.peek(0);
+    EXPECT_EQ(b1, entry->frame);
+    queue.remove(entry, 0);
+
+    // The round restarts from the first frame after the last CAN ID of the level
+    queue.push(a2, tsMono(1000), CanTxQueue::Volatile, 0);
+    entry = queue.peek(0);
+    EXPECT_EQ(c1, entry->frame);
+    queue.remove(entry, 0);
+    entry = queue.peek(0);
+    EXPECT_EQ(a2, entry->frame);
+    queue.remove(entry, 0);
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(CanTxQueue, DeadlineEscalation)
+{
+    using uavcan::CanTxQueue;
+    using uavcan::CanFrame;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+    SystemClockMock clockmock;
+    CanTxQueue queue(pool, clockmock, 99999);
+
+    const uint32_t prio10 = 10U << 24;
+    const uint32_t prio20 = 20U << 24;
+
+    const CanFrame high = makeCanFrame(prio10 | 100, "high", EXT);
+    const CanFrame late1 = makeCanFrame(prio20 | 200, "late1", EXT);       // Two frames of one transfer
+    const CanFrame late2 = makeCanFrame(prio20 | 200, "late2", EXT);
+    const CanFrame relaxed = makeCanFrame(prio20 | 300, "relaxed", EXT);
+    const CanFrame latest = makeCanFrame(prio20 | 400, "latest", EXT);
+    const CanFrame std_frame = makeCanFrame(0x7FF, "std", STD);
+
+    queue.push(relaxed, tsMono(5000), CanTxQueue::Volatile, 0);
+    queue.push(late1, tsMono(1000), CanTxQueue::Volatile, 0);
+    queue.push(latest, tsMono(1000), CanTxQueue::Volatile, uavcan::CanIOFlagCoalesce);
+    queue.push(high, tsMono(10000), CanTxQueue::Volatile, 0);
+    queue.push(late2, tsMono(1000), CanTxQueue::Volatile, 0);
+    queue.push(std_frame, tsMono(1000), CanTxQueue::Volatile, 0);
+
+    queue.setDeadlineEscalation(uavcan::MonotonicDuration::fromUSec(500), 5);
+    ASSERT_EQ(500, queue.getDeadlineEscalationHorizon().toUSec());
+
+    // Far from the deadlines
+    CanTxQueue::Entry* entry = queue.peek(0, tsMono(100));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(high, entry->frame);
+    EXPECT_EQ(0, queue.getEscalatedFrameCount());
+
+    // The transfer is escalated as a whole and stays in order; other frames keep their priority
+    entry = queue.peek(0, tsMono(600));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(2, queue.getEscalatedFrameCount());
+    EXPECT_EQ((5U << 24) | 200U, entry->frame.id & CanFrame::MaskExtID);
+    EXPECT_TRUE(entry->frame.isExtended());
+    EXPECT_EQ(0, std::memcmp(entry->frame.data, late1.data, late1.dlc));
+    queue.remove(entry, 0);
+
+    entry = queue.peek(0, tsMono(700));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(0, std::memcmp(entry->frame.data, late2.data, late2.dlc));
+    queue.remove(entry, 0);
+
+    entry = queue.peek(0, tsMono(800));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(high, entry->frame);
+    queue.remove(entry, 0);
+    EXPECT_EQ(2, queue.getEscalatedFrameCount());
+
+    // Escalation never lowers the priority
+    const CanFrame urgent = makeCanFrame((2U << 24) | 500, "urgent", EXT);
+    queue.push(urgent, tsMono(4900), CanTxQueue::Volatile, 0);
+    entry = queue.peek(0, tsMono(4800));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(urgent, entry->frame);
+    EXPECT_EQ(3, queue.getEscalatedFrameCount());       // The relaxed one
+    queue.remove(entry, 0);
+
+    entry = queue.peek(0, tsMono(4800));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ((5U << 24) | 300U, entry->frame.id & CanFrame::MaskExtID);
+    queue.remove(entry, 0);
+    EXPECT_EQ(3, queue.getEscalatedFrameCount());
+    EXPECT_TRUE(queue.isEmpty());       // The coalescible and the standard frames have expired
+
+    // Disabled
+    queue.setDeadlineEscalation(uavcan::MonotonicDuration(), 5);
+    queue.push(late1, tsMono(6000), CanTxQueue::Volatile, 0);
+    entry = queue.peek(0, tsMono(5999));
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(late1, entry->frame);
+    EXPECT_EQ(3, queue.getEscalatedFrameCount());
+}
+#endif
@@ -20,6 +20,8 @@
 #include <uavcan/node/service_server.hpp>
 #include <iostream>
 #include <bitset>
+#include <vector>
+#include "transfer_test_helpers.hpp"
 
 // TODO FIXME: Requires update
 #if 0
@@ -158,3 +160,235 @@ TEST(CanAcceptanceFilter, Basic_test)
 }
 #endif
 #endif
+
+static bool isAcceptedByFilters(const std::vector<uavcan::CanFilterConfig>& filters, const uavcan::Frame& frame)
+{
+    uavcan::CanFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    for (unsigned i = 0; i < filters.size(); i++)
+    {
+        if (((can_frame.id ^ filters[i].id) & filters[i].mask) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uavcan::Frame makeFrame(uint16_t dtid, uavcan::TransferType tt, uint8_t src, uint8_t dst)
+{
+    uavcan::Frame frame(dtid, tt, src, dst, 0);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    return frame;
+}
+
+struct RxFrameListenerStub : public uavcan::IRxFrameListener
+{
+    virtual void handleRxFrame(const uavcan::CanRxFrame&, uavcan::CanIOFlags) { }
+};
+
+TEST(CanAcceptanceFilter, AutomaticReconfiguration)
+{
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceRequest;
+    using uavcan::TransferTypeServiceResponse;
+
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(2, clock_mock);
+    TestNode node(can_driver, clock_mock, 24);
+
+    typedef TestListener<32, 1, 1> Listener;
+    uavcan::TransferPerfCounter perf;
+    NullAllocator poolmgr;
+    Listener msg_100(perf, makeDataType(uavcan::DataTypeKindMessage, 100), poolmgr);
+    Listener msg_1(perf, makeDataType(uavcan::DataTypeKindMessage, 1), poolmgr);
+    Listener msg_200(perf, makeDataType(uavcan::DataTypeKindMessage, 200), poolmgr);
+    Listener msg_300(perf, makeDataType(uavcan::DataTypeKindMessage, 300), poolmgr);
+    Listener srv_50(perf, makeDataType(uavcan::DataTypeKindService, 50), poolmgr);
+
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_100));
+    ASSERT_TRUE(node.getDispatcher().registerServiceRequestListener(&srv_50));
+
+    /*
+     * Initial configuration is applied immediately
+     */
+    uavcan::CanAcceptanceFilterConfigurator configurator(node);
+    ASSERT_FALSE(configurator.isAutomaticReconfigurationEnabled());
+    ASSERT_EQ(0, configurator.enableAutomaticReconfiguration());
+    ASSERT_TRUE(configurator.isAutomaticReconfigurationEnabled());
+    ASSERT_EQ(1, configurator.getNumReconfigurations());
+
+    for (unsigned i = 0; i < 2; i++)
+    {
+        const std::vector<uavcan::CanFilterConfig>& filters = can_driver.ifaces.at(i).filters;
+        ASSERT_EQ(3, filters.size());       // Few listeners, so the filters are exact
+        ASSERT_EQ(1, can_driver.ifaces.at(i).num_filter_configurations);
+
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(100, TransferTypeMessageBroadcast, 5, 0)));
+        ASSERT_FALSE(isAcceptedByFilters(filters, makeFrame(101, TransferTypeMessageBroadcast, 5, 0)));
+        ASSERT_FALSE(isAcceptedByFilters(filters, makeFrame(1, TransferTypeMessageBroadcast, 5, 0)));
+
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(50, TransferTypeServiceRequest, 5, 24)));
+        ASSERT_FALSE(isAcceptedByFilters(filters, makeFrame(50, TransferTypeServiceRequest, 5, 25)));
+        ASSERT_FALSE(isAcceptedByFilters(filters, makeFrame(51, TransferTypeServiceRequest, 5, 24)));
+
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(7, TransferTypeServiceResponse, 5, 24)));
+        ASSERT_FALSE(isAcceptedByFilters(filters, makeFrame(7, TransferTypeServiceResponse, 5, 25)));
+    }
+
+    /*
+     * New listeners are handled at the next spin, at once
+     */
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_1));
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_200));
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_300));
+    ASSERT_EQ(1, configurator.getNumReconfigurations());
+
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(2, configurator.getNumReconfigurations());
+    for (unsigned i = 0; i < 2; i++)
+    {
+        const std::vector<uavcan::CanFilterConfig>& filters = can_driver.ifaces.at(i).filters;
+        ASSERT_EQ(4, filters.size());       // Limited by the mock driver, so some were merged
+        ASSERT_EQ(2, can_driver.ifaces.at(i).num_filter_configurations);
+
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(100, TransferTypeMessageBroadcast, 5, 0)));
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(200, TransferTypeMessageBroadcast, 5, 0)));
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(300, TransferTypeMessageBroadcast, 5, 0)));
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(1, TransferTypeMessageBroadcast, 5, 0)));
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(1, TransferTypeMessageBroadcast, 0, 0)));  // Anonymous
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(50, TransferTypeServiceRequest, 5, 24)));
+        ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(7, TransferTypeServiceResponse, 5, 24)));
+    }
+
+    // Nothing changed - no reconfiguration, even if the listeners were re-registered
+    node.getDispatcher().unregisterMessageListener(&msg_300);
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_300));
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(2, configurator.getNumReconfigurations());
+    ASSERT_EQ(2, can_driver.ifaces.at(0).num_filter_configurations);
+
+    /*
+     * Removed listeners
+     */
+    node.getDispatcher().unregisterMessageListener(&msg_1);
+    node.getDispatcher().unregisterMessageListener(&msg_200);
+    node.getDispatcher().unregisterMessageListener(&msg_300);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(3, configurator.getNumReconfigurations());
+    ASSERT_EQ(3, can_driver.ifaces.at(0).filters.size());
+    ASSERT_FALSE(isAcceptedByFilters(can_driver.ifaces.at(0).filters,
+                                     makeFrame(200, TransferTypeMessageBroadcast, 5, 0)));
+
+    /*
+     * The mock driver doesn't filter anything, so the unwanted frames are rejected in software
+     */
+    ASSERT_EQ(0, node.getDispatcher().getNumRejectedRxFrames());
+    can_driver.ifaces.at(0).pushRx(uavcan::RxFrame(makeFrame(200, TransferTypeMessageBroadcast, 5, 0),
+                                                   clock_mock.getMonotonic(), uavcan::UtcTime(), 0));
+    can_driver.ifaces.at(0).pushRx(uavcan::RxFrame(makeFrame(50, TransferTypeServiceRequest, 5, 25),
+                                                   clock_mock.getMonotonic(), uavcan::UtcTime(), 0));
+    can_driver.ifaces.at(0).pushRx(uavcan::RxFrame(makeFrame(100, TransferTypeMessageBroadcast, 5, 0),
+                                                   clock_mock.getMonotonic(), uavcan::UtcTime(), 0));
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(2, node.getDispatcher().getNumRejectedRxFrames());
+
+    /*
+     * RX frame listener needs all frames
+     */
+    RxFrameListenerStub rx_listener;
+    node.getDispatcher().installRxFrameListener(&rx_listener);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(4, configurator.getNumReconfigurations());
+    ASSERT_EQ(1, can_driver.ifaces.at(0).filters.size());
+    ASSERT_TRUE(isAcceptedByFilters(can_driver.ifaces.at(0).filters,
+                                    makeFrame(200, TransferTypeMessageBroadcast, 5, 0)));
+    ASSERT_TRUE(isAcceptedByFilters(can_driver.ifaces.at(0).filters,
+                                    makeFrame(50, TransferTypeServiceRequest, 5, 25)));
+
+    node.getDispatcher().removeRxFrameListener();
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(5, configurator.getNumReconfigurations());
+    ASSERT_EQ(3, can_driver.ifaces.at(0).filters.size());
+    ASSERT_FALSE(isAcceptedByFilters(can_driver.ifaces.at(0).filters,
+                                     makeFrame(200, TransferTypeMessageBroadcast, 5, 0)));
+
+    /*
+     * Disabling
+     */
+    configurator.disableAutomaticReconfiguration();
+    ASSERT_FALSE(configurator.isAutomaticReconfigurationEnabled());
+    ASSERT_FALSE(node.getDispatcher().getListenerRegistryObserver());
+    node.getDispatcher().unregisterMessageListener(&msg_100);
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(5, configurator.getNumReconfigurations());
+
+    {
+        uavcan::CanAcceptanceFilterConfigurator other(node);
+        ASSERT_EQ(0, other.enableAutomaticReconfiguration());
+        ASSERT_EQ(-uavcan::ErrLogic, configurator.enableAutomaticReconfiguration());   // Only one per node
+    }
+    ASSERT_FALSE(node.getDispatcher().getListenerRegistryObserver());                  // Removed by destructor
+
+    node.getDispatcher().unregisterServiceRequestListener(&srv_50);
+}
+
+TEST(CanAcceptanceFilter, TrafficAwareMerging)
+{
+    using uavcan::TransferTypeMessageBroadcast;
+    using uavcan::TransferTypeServiceResponse;
+
+    SystemClockMock clock_mock(100);
+    CanDriverMock can_driver(1, clock_mock);
+    TestNode node(can_driver, clock_mock, 24);
+
+    typedef TestListener<32, 1, 1> Listener;
+    uavcan::TransferPerfCounter perf;
+    NullAllocator poolmgr;
+    Listener msg_256(perf, makeDataType(uavcan::DataTypeKindMessage, 256), poolmgr);
+    Listener msg_259(perf, makeDataType(uavcan::DataTypeKindMessage, 259), poolmgr);
+    Listener msg_1264(perf, makeDataType(uavcan::DataTypeKindMessage, 1264), poolmgr);
+    Listener msg_1279(perf, makeDataType(uavcan::DataTypeKindMessage, 1279), poolmgr);
+
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_256));
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_259));
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_1264));
+
+    uavcan::CanAcceptanceFilterConfigurator configurator(node);
+    ASSERT_EQ(0, configurator.enableAutomaticReconfiguration());
+    ASSERT_EQ(4, can_driver.ifaces.at(0).filters.size());       // Exact, the mock driver supports 4 filters
+
+    /*
+     * Busy traffic that the node doesn't need; merging 256 with 259 would keep the most bits,
+     * but this traffic would go through
+     */
+    for (unsigned i = 0; i < 10; i++)
+    {
+        can_driver.ifaces.at(0).pushRx(uavcan::RxFrame(makeFrame(257, TransferTypeMessageBroadcast,
+                                                                 uint8_t(1 + i), 0),
+                                                       clock_mock.getMonotonic(), uavcan::UtcTime(), 0));
+    }
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(10, node.getDispatcher().getNumRejectedRxFrames());
+
+    ASSERT_TRUE(node.getDispatcher().registerMessageListener(&msg_1279));
+    ASSERT_LE(0, node.spin(uavcan::MonotonicDuration::fromMSec(10)));
+    ASSERT_EQ(2, configurator.getNumReconfigurations());
+
+    const std::vector<uavcan::CanFilterConfig>& filters = can_driver.ifaces.at(0).filters;
+    ASSERT_EQ(4, filters.size());
+    ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(256, TransferTypeMessageBroadcast, 5, 0)));
+    ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(259, TransferTypeMessageBroadcast, 5, 0)));
+    ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(1264, TransferTypeMessageBroadcast, 5, 0)));
+    ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(1279, TransferTypeMessageBroadcast, 5, 0)));
+    ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(7, TransferTypeServiceResponse, 5, 24)));
+    ASSERT_FALSE(isAcceptedByFilters(filters, makeFrame(257, TransferTypeMessageBroadcast, 5, 0)));
+    ASSERT_TRUE(isAcceptedByFilters(filters, makeFrame(1269, TransferTypeMessageBroadcast, 5, 0)));  // Merged
+
+    configurator.disableAutomaticReconfiguration();
+    node.getDispatcher().unregisterMessageListener(&msg_256);
+    node.getDispatcher().unregisterMessageListener(&msg_259);
+    node.getDispatcher().unregisterMessageListener(&msg_1264);
+    node.getDispatcher().unregisterMessageListener(&msg_1279);
+}
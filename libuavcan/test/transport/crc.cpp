@@ -3,6 +3,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <cstdlib>
 #include <uavcan/transport/crc.hpp>
 
 /*
@@ -30,3 +31,41 @@ TEST(TransferCRC, Correctness)
     crc.add(reinterpret_cast<const uint8_t*>("456789"), 6);
     ASSERT_EQ(0x29B1, crc.get());
 }
+
+TEST(TransferCRC, BulkMatchesBytewise)
+{
+    uint8_t data[256];
+    std::srand(42);
+    for (unsigned i = 0; i < sizeof(data); i++)
+    {
+        data[i] = uint8_t(std::rand());
+    }
+
+    // All lengths and misaligned starting positions, so that every tail length of the bulk path is exercised
+    for (unsigned offset = 0; offset < 8; offset++)
+    {
+        for (unsigned len = 0; len <= (sizeof(data) - offset); len++)
+        {
+            uavcan::TransferCRC bytewise;
+            for (unsigned i = 0; i < len; i++)
+            {
+                bytewise.add(data[offset + i]);
+            }
+
+            uavcan::TransferCRC bulk;
+            bulk.add(data + offset, len);
+            ASSERT_EQ(bytewise.get(), bulk.get()) << "offset " << offset << " len " << len;
+        }
+    }
+
+    // Bulk computation continued from an intermediate value
+    uavcan::TransferCRC split;
+    split.add(data, 3);
+    split.add(data + 3, 125);
+    split.add(data[128]);
+    split.add(data + 129, 127);
+
+    uavcan::TransferCRC whole;
+    whole.add(data, 256);
+    ASSERT_EQ(whole.get(), split.get());
+}
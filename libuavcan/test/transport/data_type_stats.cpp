@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include "transfer_test_helpers.hpp"
+#include "can/can.hpp"
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/transfer_sender.hpp>
+
+
+TEST(DataTypeStatsTable, Basic)
+{
+    uavcan::DataTypeStatsTable table;
+    ASSERT_EQ(0, table.getSize());
+    ASSERT_FALSE(table.getByIndex(0));
+    ASSERT_FALSE(table.find(uavcan::DataTypeKindMessage, 1));
+
+    uavcan::DataTypeStats* const msg = table.access(uavcan::DataTypeKindMessage, 1);
+    ASSERT_TRUE(msg);
+    ASSERT_TRUE(msg->isUsed());
+    ASSERT_EQ(msg, table.access(uavcan::DataTypeKindMessage, 1));
+    ASSERT_EQ(msg, table.find(uavcan::DataTypeKindMessage, 1));
+    ASSERT_FALSE(table.find(uavcan::DataTypeKindService, 1));       // Different kind
+
+    uavcan::DataTypeStats* const srv = table.access(uavcan::DataTypeKindService, 1);
+    ASSERT_TRUE(srv);
+    ASSERT_NE(msg, srv);
+    ASSERT_EQ(2, table.getSize());
+    ASSERT_EQ(msg, table.getByIndex(0));
+    ASSERT_EQ(srv, table.getByIndex(1));
+
+    msg->addRxFrame(8);
+    msg->addRxFrame(3);
+    msg->addRxTransfer(uavcan::MonotonicDuration::fromUSec(1500));
+    msg->addRxTransfer(uavcan::MonotonicDuration::fromUSec(500));
+    msg->addCallbackDuration(uavcan::MonotonicDuration::fromUSec(-10));     // Clock jumped back
+    ASSERT_EQ(2, msg->frames_rx);
+    ASSERT_EQ(11, msg->payload_bytes_rx);
+    ASSERT_EQ(2, msg->transfers_rx);
+    ASSERT_EQ(1500, msg->max_reassembly_time_usec);
+    ASSERT_EQ(0, msg->max_callback_duration_usec);
+
+    table.resetCounters();
+    ASSERT_EQ(0, msg->frames_rx);
+    ASSERT_EQ(0, msg->max_reassembly_time_usec);
+    ASSERT_EQ(2, table.getSize());                                  // The entries are kept
+    ASSERT_EQ(msg, table.find(uavcan::DataTypeKindMessage, 1));
+
+    // Overflow
+    for (unsigned i = table.getSize(); i < unsigned(uavcan::DataTypeStatsTable::Capacity); i++)
+    {
+        ASSERT_TRUE(table.access(uavcan::DataTypeKindMessage, uavcan::DataTypeID(uint16_t(100 + i))));
+    }
+    ASSERT_FALSE(table.access(uavcan::DataTypeKindMessage, 1000));
+    ASSERT_EQ(msg, table.access(uavcan::DataTypeKindMessage, 1));   // Existing entries are still accessible
+}
+
+/**
+ * The callback takes some time
+ */
+class SlowTestListener : public TestListener<512, 2, 2>
+{
+    SystemClockMock& clock_;
+
+public:
+    SlowTestListener(SystemClockMock& clock, uavcan::TransferPerfCounter& perf,
+                     const uavcan::DataTypeDescriptor& data_type, uavcan::IPoolAllocator& allocator)
+        : TestListener<512, 2, 2>(perf, data_type, allocator)
+        , clock_(clock)
+    { }
+
+    void handleIncomingTransfer(uavcan::IncomingTransfer& transfer)
+    {
+        clock_.advance(250);
+        TestListener<512, 2, 2>::handleIncomingTransfer(transfer);
+    }
+};
+
+class DataTypeStatsTransferEmulator : public IncomingTransferEmulatorBase
+{
+    CanIfaceMock& target_;
+
+public:
+    DataTypeStatsTransferEmulator(CanIfaceMock& target, uavcan::NodeID dst_node_id)
+        : IncomingTransferEmulatorBase(dst_node_id)
+        , target_(target)
+    { }
+
+    void sendOneFrame(const uavcan::RxFrame& frame) { target_.pushRx(frame); }
+};
+
+
+TEST(DataTypeStatsTable, Dispatcher)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(pool);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    const uavcan::DataTypeDescriptor type_a = makeDataType(uavcan::DataTypeKindMessage, 1);
+    const uavcan::DataTypeDescriptor type_b = makeDataType(uavcan::DataTypeKindMessage, 2, "B");
+    const uavcan::DataTypeDescriptor type_c = makeDataType(uavcan::DataTypeKindMessage, 3, "C");
+
+    TestListener<512, 2, 2> sub_a1(dispatcher.getTransferPerfCounter(), type_a, pool);
+    SlowTestListener sub_a2(clockmock, dispatcher.getTransferPerfCounter(), type_a, pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a1));
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a2));
+
+    const uavcan::DataTypeStatsTable& table = dispatcher.getDataTypeStatsTable();
+    ASSERT_EQ(1, table.getSize());                      // Both subscribers share the same entry
+    const uavcan::DataTypeStats* const stats_a = table.find(uavcan::DataTypeKindMessage, 1);
+    ASSERT_TRUE(stats_a);
+
+    /*
+     * Reception; there's no listener for the type C
+     */
+    DataTypeStatsTransferEmulator emulator(driver.ifaces.at(0), 64);
+    const std::string payload = "The only way to get ideas for stories is to drink way too much coffee";
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, payload, type_a),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 11, "123", type_a),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 12, "456", type_c)
+    };
+    const unsigned num_frames = unsigned(serializeTransfer(transfers[0]).size());
+    ASSERT_LT(2, num_frames);
+    emulator.send(transfers);
+
+    while (dispatcher.spinOnce() > 0) { }
+
+    ASSERT_TRUE(sub_a1.matchAndPop(transfers[1]));                  // The emulator interleaves the frames
+    ASSERT_TRUE(sub_a1.matchAndPop(transfers[0]));
+
+    ASSERT_EQ(num_frames + 1, stats_a->frames_rx);                  // Every frame is counted once
+    ASSERT_EQ(payload.length() + 2 + 3, stats_a->payload_bytes_rx); // Including the transfer CRC
+    ASSERT_EQ(4, stats_a->transfers_rx);                            // Every transfer is counted by each listener
+    ASSERT_EQ(0, stats_a->rx_errors);
+    ASSERT_EQ(num_frames - 1, stats_a->max_reassembly_time_usec);   // The emulator advances the time by 1 usec
+    ASSERT_EQ(250, stats_a->max_callback_duration_usec);
+    ASSERT_EQ(0, stats_a->frames_tx);
+
+    ASSERT_FALSE(table.find(uavcan::DataTypeKindMessage, 3));
+
+    /*
+     * Broken transfer - the last frame is missing
+     */
+    std::vector<uavcan::RxFrame> frames =
+        serializeTransfer(emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, payload, type_a));
+    frames.pop_back();
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        emulator.sendOneFrame(frames[i]);
+    }
+    emulator.sendOneFrame(serializeTransfer(emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10,
+                                                                  payload, type_a)).front());
+    while (dispatcher.spinOnce() > 0) { }
+    ASSERT_LT(0, stats_a->rx_errors);
+    ASSERT_EQ(4, stats_a->transfers_rx);
+
+    /*
+     * Transmission
+     */
+    uavcan::TransferSender sender(dispatcher, type_b, uavcan::CanTxQueue::Volatile);
+    ASSERT_EQ(2, table.getSize());
+    const uavcan::DataTypeStats* const stats_b = table.find(uavcan::DataTypeKindMessage, 2);
+    ASSERT_TRUE(stats_b);
+
+    const uavcan::MonotonicTime deadline = clockmock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100);
+    ASSERT_LE(0, sender.send(reinterpret_cast<const uint8_t*>(payload.c_str()), unsigned(payload.length()),
+                             deadline, uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                             uavcan::NodeID::Broadcast));
+    ASSERT_LE(0, sender.send(reinterpret_cast<const uint8_t*>("123"), 3, deadline, uavcan::MonotonicTime(),
+                             uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast));
+    while (dispatcher.spinOnce() > 0) { }
+
+    ASSERT_EQ(2, stats_b->transfers_tx);
+    ASSERT_EQ(unsigned(driver.ifaces.at(0).tx.size()), stats_b->frames_tx);
+    ASSERT_EQ(num_frames + 1, stats_b->frames_tx);
+    ASSERT_EQ(payload.length() + 2 + 3, stats_b->payload_bytes_tx);
+    ASSERT_EQ(0, stats_b->frames_rx);
+
+    dispatcher.unregisterMessageListener(&sub_a1);
+    dispatcher.unregisterMessageListener(&sub_a2);
+}
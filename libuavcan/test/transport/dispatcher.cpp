@@ -337,6 +337,142 @@ TEST(Dispatcher, Spin)
 }
 
 
+TEST(Dispatcher, IterationTimestamp)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    clockmock.monotonic_auto_advance = 100;
+
+    // Outside of a spin the clock is read every time
+    ASSERT_NE(dispatcher.getMonotonicTime(), dispatcher.getMonotonicTime());
+
+    {
+        uavcan::Dispatcher::IterationScope scope(dispatcher);
+        ASSERT_EQ(0, dispatcher.spinOnce());
+
+        // The timestamp of the last select() is reused until the next IO call
+        const uavcan::MonotonicTime cached = dispatcher.getMonotonicTime();
+        ASSERT_FALSE(cached.isZero());
+        ASSERT_EQ(cached, dispatcher.getMonotonicTime());
+        ASSERT_LT(cached, dispatcher.getMonotonicTime(true));
+        ASSERT_EQ(cached, dispatcher.getMonotonicTime());
+
+        dispatcher.setIterationTimestamp(tsMono(1000000));
+        ASSERT_EQ(tsMono(1000000), dispatcher.getMonotonicTime());
+    }
+
+    // The cached timestamp does not leak outside of the scope
+    ASSERT_GT(tsMono(1000000), dispatcher.getMonotonicTime());
+    ASSERT_NE(dispatcher.getMonotonicTime(), dispatcher.getMonotonicTime());
+    dispatcher.setIterationTimestamp(tsMono(1000000));
+    ASSERT_GT(tsMono(1000000), dispatcher.getMonotonicTime());
+}
+
+
+TEST(Dispatcher, SpinBudget)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, dispatcher.spinBudget(0, uavcan::MonotonicTime()));
+
+    // Nothing to receive - blocks until the deadline
+    ASSERT_EQ(0, dispatcher.spinBudget(5, tsMono(1000)));
+    ASSERT_LE(1000, clockmock.monotonic);
+
+    // Frames exceeding the budget are left for later
+    const uavcan::CanFrame frame(0x1000 | uavcan::CanFrame::FlagEFF, reinterpret_cast<const uint8_t*>(""), 0);
+    for (unsigned i = 0; i < 25; i++)
+    {
+        driver.ifaces.at(i % 2).pushRx(frame);
+    }
+    ASSERT_EQ(10, dispatcher.spinBudget(10, uavcan::MonotonicTime()));
+    ASSERT_EQ(15, driver.ifaces.at(0).rx.size() + driver.ifaces.at(1).rx.size());
+    ASSERT_EQ(1, dispatcher.spinBudget(1, uavcan::MonotonicTime()));
+    ASSERT_EQ(14, dispatcher.spinBudget(100, tsMono(100000)));     // Returns without waiting for the deadline
+    ASSERT_GT(100000, clockmock.monotonic);
+    ASSERT_TRUE(driver.ifaces.at(0).rx.empty() && driver.ifaces.at(1).rx.empty());
+}
+
+
+struct ExternalTxSource : public uavcan::IExternalTxSource
+{
+    uavcan::Dispatcher& dispatcher;
+    std::vector<uavcan::Frame> pending;
+    unsigned num_flushes;
+
+    ExternalTxSource(uavcan::Dispatcher& dispatcher)
+        : dispatcher(dispatcher)
+        , num_flushes(0)
+    { }
+
+    virtual void flushPendingTransfers()
+    {
+        num_flushes++;
+        for (unsigned i = 0; i < pending.size(); i++)
+        {
+            EXPECT_EQ(1, dispatcher.send(pending[i], tsMono(1000000), uavcan::MonotonicTime(),
+                                         uavcan::CanTxQueue::Volatile, 0, 1));
+        }
+        pending.clear();
+    }
+};
+
+TEST(Dispatcher, ExternalTxSource)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    ExternalTxSource source(dispatcher);
+    ASSERT_FALSE(dispatcher.getExternalTxSource());
+    dispatcher.installExternalTxSource(&source);
+    ASSERT_EQ(&source, dispatcher.getExternalTxSource());
+
+    // Polled before every wait for IO
+    ASSERT_EQ(0, dispatcher.spinOnce());
+    ASSERT_EQ(1, source.num_flushes);
+    ASSERT_EQ(0, dispatcher.spinBudget(1, uavcan::MonotonicTime()));
+    ASSERT_EQ(2, source.num_flushes);
+
+    // The pending transfers go out with the same spin iteration
+    uavcan::Frame frame(123, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 0);
+    frame.setPayload(reinterpret_cast<const uint8_t*>("123"), 3);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    source.pending.push_back(frame);
+    ASSERT_EQ(0, dispatcher.spinOnce());
+    ASSERT_EQ(3, source.num_flushes);
+    ASSERT_EQ(1, driver.ifaces.at(0).tx.size());
+    ASSERT_TRUE(driver.ifaces.at(1).tx.empty());
+
+    dispatcher.removeExternalTxSource();
+    ASSERT_EQ(0, dispatcher.spinOnce());
+    ASSERT_EQ(3, source.num_flushes);
+}
+
+
 struct DispatcherTestLoopbackFrameListener : public uavcan::LoopbackFrameListenerBase
 {
     uavcan::RxFrame last_frame;
@@ -348,6 +484,7 @@ struct DispatcherTestLoopbackFrameListener : public uavcan::LoopbackFrameListene
     { }
 
     using uavcan::LoopbackFrameListenerBase::startListening;
+    using uavcan::LoopbackFrameListenerBase::stopListening;
     using uavcan::LoopbackFrameListenerBase::isListening;
 
     void handleLoopbackFrame(const uavcan::RxFrame& frame)
@@ -397,3 +534,325 @@ TEST(Dispatcher, Loopback)
     }
     ASSERT_EQ(0, dispatcher.getLoopbackFrameListenerRegistry().getNumListeners());
 }
+
+
+TEST(Dispatcher, LoopbackFiltering)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTestLoopbackFrameListener listener_a(dispatcher);
+    DispatcherTestLoopbackFrameListener listener_b(dispatcher);
+
+    uavcan::Frame frame_a(123, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 0);
+    uavcan::Frame frame_b(200, uavcan::TransferTypeServiceRequest, SELF_NODE_ID, 2, 0);
+    uavcan::Frame frame_c(123 + 64, uavcan::TransferTypeMessageBroadcast, SELF_NODE_ID, uavcan::NodeID::Broadcast, 0);
+    frame_a.setPayload(reinterpret_cast<const uint8_t*>("a"), 1);
+    frame_b.setPayload(reinterpret_cast<const uint8_t*>("b"), 1);
+    frame_c.setPayload(reinterpret_cast<const uint8_t*>("c"), 1);
+
+    /*
+     * No listeners - the loopback is not requested from the driver at all
+     */
+    ASSERT_LE(0, dispatcher.send(frame_a, tsMono(1000), tsMono(0), uavcan::CanTxQueue::Persistent,
+                                 uavcan::CanIOFlagLoopback, 0xFF));
+    ASSERT_EQ(0, dispatcher.spin(tsMono(1000)));
+    ASSERT_EQ(1, driver.ifaces.at(0).tx.size());
+    ASSERT_EQ(0, driver.ifaces.at(0).tx.front().flags);
+    driver.ifaces.at(0).tx.pop();
+
+    /*
+     * Each listener receives only its own data type
+     */
+    listener_a.startListening(123);
+    listener_b.startListening(200);
+
+    const uavcan::Frame* const frames[] = { &frame_a, &frame_b, &frame_c };
+    for (unsigned i = 0; i < 3; i++)
+    {
+        ASSERT_LE(0, dispatcher.send(*frames[i], tsMono(1000), tsMono(0), uavcan::CanTxQueue::Persistent,
+                                     uavcan::CanIOFlagLoopback, 0xFF));
+    }
+    ASSERT_EQ(0, dispatcher.spin(tsMono(1000)));
+
+    ASSERT_EQ(1, listener_a.count);
+    ASSERT_TRUE(listener_a.last_frame == frame_a);
+    ASSERT_EQ(1, listener_b.count);
+    ASSERT_TRUE(listener_b.last_frame == frame_b);
+
+    /*
+     * A listener for all data types receives everything
+     */
+    listener_b.stopListening();
+    listener_b.startListening();
+    ASSERT_EQ(2, dispatcher.getLoopbackFrameListenerRegistry().getNumListeners());
+
+    ASSERT_LE(0, dispatcher.send(frame_c, tsMono(1000), tsMono(0), uavcan::CanTxQueue::Persistent,
+                                 uavcan::CanIOFlagLoopback, 0xFF));
+    ASSERT_EQ(0, dispatcher.spin(tsMono(1000)));
+    ASSERT_EQ(1, listener_a.count);
+    ASSERT_EQ(2, listener_b.count);
+    ASSERT_TRUE(listener_b.last_frame == frame_c);
+}
+
+TEST(Dispatcher, ListenerIndexCollisions)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(pool);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    /*
+     * These data type IDs map to the same index entry, unless the index is disabled
+     */
+    const uint16_t Stride = uint16_t((uavcan::DispatcherListenerIndexSize > 0) ?
+                                     uavcan::DispatcherListenerIndexSize : 16);
+    const uavcan::DataTypeDescriptor TYPES[3] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, uint16_t(Stride * 1 + 3)),
+        makeDataType(uavcan::DataTypeKindMessage, uint16_t(Stride * 2 + 3)),
+        makeDataType(uavcan::DataTypeKindMessage, uint16_t(Stride * 3 + 3))
+    };
+
+    typedef TestListener<8, 0, 0> Subscriber;
+    Subscriber sub_a(dispatcher.getTransferPerfCounter(), TYPES[0], pool);
+    Subscriber sub_b(dispatcher.getTransferPerfCounter(), TYPES[1], pool);
+    Subscriber sub_b2(dispatcher.getTransferPerfCounter(), TYPES[1], pool);
+
+    // Negative lookups are cached too, then the cached entry must be invalidated upon registration
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[0].getID()));
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[1].getID()));
+
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a));
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_b));
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_b2));
+
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[0].getID()));
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[1].getID()));
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[2].getID()));
+
+    /*
+     * Interleaving the transfers so that every frame evicts the previous index entry
+     */
+    const Transfer transfers[4] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", TYPES[0]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "def", TYPES[1]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "ghi", TYPES[2]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 11, "jkl", TYPES[1])
+    };
+    emulator.send(transfers);
+
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(sub_a.matchAndPop(transfers[0]));
+    ASSERT_TRUE(sub_b.matchAndPop(transfers[1]));
+    ASSERT_TRUE(sub_b.matchAndPop(transfers[3]));
+    ASSERT_TRUE(sub_b2.matchAndPop(transfers[1]));
+    ASSERT_TRUE(sub_b2.matchAndPop(transfers[3]));
+    ASSERT_TRUE(sub_a.isEmpty());
+    ASSERT_TRUE(sub_b.isEmpty());
+    ASSERT_TRUE(sub_b2.isEmpty());
+
+    /*
+     * Unregistering from a registry the listener does not belong to must not affect its own registry
+     */
+    dispatcher.unregisterServiceRequestListener(&sub_b2);
+    dispatcher.unregisterServiceResponseListener(&sub_b2);
+    ASSERT_EQ(3, dispatcher.getNumMessageListeners());
+
+    /*
+     * Removing the first listener of a cached data type ID
+     */
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[1].getID()));
+    dispatcher.unregisterMessageListener(&sub_b);
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[1].getID()));
+    dispatcher.unregisterMessageListener(&sub_b2);
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[1].getID()));
+    ASSERT_TRUE(dispatcher.hasSubscriber(TYPES[0].getID()));
+
+    const Transfer more_transfers[2] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "mno", TYPES[1]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "pqr", TYPES[0])
+    };
+    emulator.send(more_transfers);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(sub_a.matchAndPop(more_transfers[1]));
+    ASSERT_TRUE(sub_a.isEmpty());
+    ASSERT_TRUE(sub_b.isEmpty());
+    ASSERT_TRUE(sub_b2.isEmpty());
+
+    dispatcher.unregisterMessageListener(&sub_a);
+    ASSERT_EQ(0, dispatcher.getNumMessageListeners());
+    ASSERT_FALSE(dispatcher.hasSubscriber(TYPES[0].getID()));
+}
+
+
+TEST(Dispatcher, SoftwareFilter)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(pool);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    const uavcan::DataTypeDescriptor TYPES[4] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 5),
+        makeDataType(uavcan::DataTypeKindMessage, 6),
+        makeDataType(uavcan::DataTypeKindMessage, 5 + 64),     // Same bit in the mask
+        makeDataType(uavcan::DataTypeKindService, 5)
+    };
+
+    typedef TestListener<8, 0, 0> Subscriber;
+    Subscriber sub(dispatcher.getTransferPerfCounter(), TYPES[0], pool);
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub));
+
+    const Transfer transfers[5] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", TYPES[0]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "def", TYPES[1]),    // Prefiltered
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "ghi", TYPES[2]),    // Rejected
+        emulator.makeTransfer(0, uavcan::TransferTypeServiceRequest,   10, "jkl", TYPES[3], 100), // Prefiltered
+        emulator.makeTransfer(0, uavcan::TransferTypeServiceRequest,   10, "mno", TYPES[3])     // Rejected
+    };
+    emulator.send(transfers);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    ASSERT_TRUE(sub.matchAndPop(transfers[0]));
+    ASSERT_TRUE(sub.isEmpty());
+    EXPECT_EQ(4, dispatcher.getNumRejectedRxFrames());
+    EXPECT_EQ(2, dispatcher.getNumSoftwareFilteredRxFrames());
+
+    /*
+     * The mask must be updated once the listener is removed
+     */
+    dispatcher.unregisterMessageListener(&sub);
+
+    const Transfer more_transfers[1] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 11, "pqr", TYPES[0])
+    };
+    emulator.send(more_transfers);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+
+    EXPECT_EQ(5, dispatcher.getNumRejectedRxFrames());
+    EXPECT_EQ(3, dispatcher.getNumSoftwareFilteredRxFrames());
+}
+
+TEST(Dispatcher, IncrementalCleanup)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(pool);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(SELF_NODE_ID));
+
+    DispatcherTransferEmulator emulator(driver, SELF_NODE_ID);
+
+    const uavcan::DataTypeDescriptor TYPES[3] =
+    {
+        makeDataType(uavcan::DataTypeKindMessage, 1),
+        makeDataType(uavcan::DataTypeKindMessage, 2),
+        makeDataType(uavcan::DataTypeKindMessage, 3)
+    };
+
+    typedef TestListener<8, 0, 0> Subscriber;
+    Subscriber sub_a(dispatcher.getTransferPerfCounter(), TYPES[0], pool);
+    std::auto_ptr<Subscriber> sub_b(new Subscriber(dispatcher.getTransferPerfCounter(), TYPES[1], pool));
+    Subscriber sub_c(dispatcher.getTransferPerfCounter(), TYPES[2], pool);
+
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_a));
+    ASSERT_TRUE(dispatcher.registerMessageListener(sub_b.get()));
+    ASSERT_TRUE(dispatcher.registerMessageListener(&sub_c));
+
+    /*
+     * Every listener gets one receiver
+     */
+    const Transfer transfers[3] =
+    {
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "abc", TYPES[0]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "def", TYPES[1]),
+        emulator.makeTransfer(0, uavcan::TransferTypeMessageBroadcast, 10, "ghi", TYPES[2])
+    };
+    emulator.send(transfers);
+    while (dispatcher.spinOnce() > 0)
+    {
+        clockmock.advance(100);
+    }
+    ASSERT_TRUE(sub_a.matchAndPop(transfers[0]));
+    ASSERT_TRUE(sub_b->matchAndPop(transfers[1]));
+    ASSERT_TRUE(sub_c.matchAndPop(transfers[2]));
+
+    const unsigned initial_blocks = pool.getNumUsedBlocks();
+    ASSERT_LE(3, initial_blocks);
+
+    /*
+     * Nothing has timed out yet - a complete pass with no limit
+     */
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(clockmock.getMonotonic(), 0));
+    ASSERT_EQ(initial_blocks, pool.getNumUsedBlocks());
+
+    /*
+     * One listener per call; the outgoing transfer registry goes first
+     */
+    clockmock.advance(5000000);
+    ASSERT_FALSE(dispatcher.cleanupIncrementally(clockmock.getMonotonic(), 1));
+    ASSERT_EQ(initial_blocks, pool.getNumUsedBlocks());
+
+    ASSERT_FALSE(dispatcher.cleanupIncrementally(clockmock.getMonotonic(), 1));     // A
+    ASSERT_EQ(initial_blocks - 1, pool.getNumUsedBlocks());
+
+    // The listener the cursor points to is removed - the pass continues with the next one
+    dispatcher.unregisterMessageListener(sub_b.get());
+    sub_b.reset();
+    ASSERT_EQ(initial_blocks - 2, pool.getNumUsedBlocks());
+
+    // C, then the empty service registries are passed through without spending the budget
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(clockmock.getMonotonic(), 1));
+    ASSERT_EQ(initial_blocks - 3, pool.getNumUsedBlocks());
+
+    /*
+     * The next pass starts over
+     */
+    ASSERT_FALSE(dispatcher.cleanupIncrementally(clockmock.getMonotonic(), 2));
+    ASSERT_TRUE(dispatcher.cleanupIncrementally(clockmock.getMonotonic(), 2));
+}
@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <cstdlib>
 #include <string>
 #include <gtest/gtest.h>
 #include <uavcan/transport/transfer.hpp>
@@ -303,6 +304,128 @@ TEST(Frame, FrameParsing)
 }
 
 
+TEST(Frame, ParseConsistency)
+{
+    using uavcan::Frame;
+    using uavcan::CanFrame;
+
+    /*
+     * Random frames of all kinds; the parser must agree with the full validation, and the valid frames must
+     * compile back into the same CAN ID.
+     */
+    std::srand(42);
+    unsigned num_valid = 0;
+    for (unsigned i = 0; i < 10000; i++)
+    {
+        CanFrame can;
+        can.id = CanFrame::FlagEFF | ((uint32_t(std::rand()) << 16) ^ uint32_t(std::rand()));
+        can.dlc = uint8_t(std::rand() % 9);
+        for (unsigned k = 0; k < sizeof(can.data); k++)
+        {
+            can.data[k] = uint8_t(std::rand());
+        }
+        if ((i % 8) == 0)
+        {
+            can.id &= ~0x7FU;                   // Anonymous
+        }
+
+        Frame frame;
+        const bool valid = frame.parse(can);
+        ASSERT_EQ(can.dlc > 0 && frame.isValid(), valid);
+        if (!valid)
+        {
+            continue;
+        }
+        num_valid++;
+
+        ASSERT_EQ(can.dlc - 1, frame.getPayloadLen());
+        if (!frame.getSrcNodeID().isBroadcast())
+        {
+            CanFrame compiled;
+            ASSERT_TRUE(frame.compile(compiled));
+            ASSERT_EQ(can.id, compiled.id);
+            ASSERT_EQ(can.dlc, compiled.dlc);
+        }
+    }
+    std::cout << "Valid frames: " << num_valid << std::endl;
+    ASSERT_LT(1000, num_valid);
+
+    // Non-data frames are rejected regardless of their contents
+    CanFrame can(CanFrame::FlagEFF | (456 << 8) | 42, reinterpret_cast<const uint8_t*>("\xc0"), 1);
+    Frame frame;
+    ASSERT_TRUE(frame.parse(can));
+    can.id |= CanFrame::FlagRTR;
+    ASSERT_FALSE(frame.parse(can));
+    can.id ^= CanFrame::FlagRTR | CanFrame::FlagERR;
+    ASSERT_FALSE(frame.parse(can));
+    can.id = (456 << 8) | 42;
+    ASSERT_FALSE(frame.parse(can));
+}
+
+#if UAVCAN_SUPPORT_CANFD
+
+TEST(Frame, CanFDParseCompile)
+{
+    using uavcan::Frame;
+    using uavcan::CanFrame;
+
+    Frame frame(1234, uavcan::TransferTypeMessageBroadcast, 42, uavcan::NodeID::Broadcast, 5);
+    ASSERT_FALSE(frame.isCanFD());
+    ASSERT_EQ(7, frame.getPayloadCapacity());
+    frame.setCanFD(true);
+    ASSERT_EQ(63, frame.getPayloadCapacity());
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+
+    uint8_t payload[70];
+    for (unsigned i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = uint8_t(i + 1);
+    }
+
+    for (unsigned len = 0; len <= 63; len++)
+    {
+        ASSERT_EQ(len, frame.setPayload(payload, len));
+
+        // The payload is padded with zeros, the tail byte is the last one
+        CanFrame can_frame;
+        ASSERT_TRUE(frame.compile(can_frame));
+        ASSERT_TRUE(can_frame.isCanFD());
+        ASSERT_EQ(CanFrame::roundUpDataLength(uint8_t(len + 1)), can_frame.dlc);
+        ASSERT_TRUE(std::equal(payload, payload + len, can_frame.data));
+        for (unsigned i = len; i < can_frame.dlc - 1U; i++)
+        {
+            ASSERT_EQ(0, can_frame.data[i]);
+        }
+        ASSERT_EQ(0xC5, can_frame.data[can_frame.dlc - 1U]);
+
+        // The padding becomes part of the payload
+        Frame parsed;
+        ASSERT_TRUE(parsed.parse(can_frame));
+        ASSERT_TRUE(parsed.isCanFD());
+        ASSERT_EQ(can_frame.dlc - 1U, parsed.getPayloadLen());
+        ASSERT_TRUE(std::equal(payload, payload + len, parsed.getPayloadPtr()));
+        ASSERT_EQ(1234, parsed.getDataTypeID().get());
+        ASSERT_EQ(42, parsed.getSrcNodeID().get());
+        ASSERT_EQ(5, parsed.getTransferID().get());
+    }
+    ASSERT_EQ(63, frame.setPayload(payload, sizeof(payload)));
+
+    // Classic frames are not affected
+    frame.setCanFD(false);
+    ASSERT_EQ(7, frame.setPayload(payload, sizeof(payload)));
+    CanFrame can_frame;
+    ASSERT_TRUE(frame.compile(can_frame));
+    ASSERT_FALSE(can_frame.isCanFD());
+    ASSERT_EQ(8, can_frame.dlc);
+    Frame parsed;
+    ASSERT_TRUE(parsed.parse(can_frame));
+    ASSERT_FALSE(parsed.isCanFD());
+    ASSERT_EQ(frame, parsed);
+}
+
+#endif
+
 TEST(Frame, RxFrameParse)
 {
     using uavcan::Frame;
@@ -29,6 +29,7 @@ static bool match(const uavcan::IncomingTransfer& it, const uavcan::RxFrame& fra
 {
     // Fields extracted from the frame struct
     EXPECT_EQ(it.getMonotonicTimestamp(), frame.getMonotonicTimestamp());
+    EXPECT_EQ(it.getLastFrameMonotonicTimestamp(), frame.getMonotonicTimestamp());
     EXPECT_EQ(it.getUtcTimestamp(),       frame.getUtcTimestamp());
     EXPECT_EQ(it.getSrcNodeID(),          frame.getSrcNodeID());
     EXPECT_EQ(it.getTransferID(),         frame.getTransferID());
@@ -101,6 +102,15 @@ TEST(MultiFrameIncomingTransfer, Basic)
      */
     ASSERT_TRUE(match(it, frame, data_ptr, unsigned(data.length())));
 
+    /*
+     * The transfer timestamp is defined by the first frame
+     */
+    const uavcan::MonotonicTime first_frame_ts =
+        frame.getMonotonicTimestamp() - uavcan::MonotonicDuration::fromUSec(500);
+    MultiFrameIncomingTransfer it2(first_frame_ts, frame.getUtcTimestamp(), frame, tba);
+    ASSERT_EQ(first_frame_ts, it2.getMonotonicTimestamp());
+    ASSERT_EQ(frame.getMonotonicTimestamp(), it2.getLastFrameMonotonicTimestamp());
+
     /*
      * Buffer release
      */
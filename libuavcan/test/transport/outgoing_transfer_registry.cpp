@@ -9,11 +9,13 @@
 #include "transfer_test_helpers.hpp"
 
 
-TEST(OutgoingTransferRegistry, Basic)
+/**
+ * The registry must be able to hold exactly 4 entries.
+ */
+template <typename Registry>
+static void testBasic(Registry& otr)
 {
     using uavcan::OutgoingTransferRegistryKey;
-    NullAllocator poolmgr;  // Empty
-    uavcan::OutgoingTransferRegistry<4> otr(poolmgr);
 
     otr.cleanup(tsMono(1000));
 
@@ -88,3 +90,74 @@ TEST(OutgoingTransferRegistry, Basic)
     otr.cleanup(tsMono(5000001));    // Frees some memory for 4
     ASSERT_EQ(0, otr.accessOrCreate(keys[0], tsMono(1000000))->get());
 }
+
+
+TEST(OutgoingTransferRegistry, Basic)
+{
+    NullAllocator poolmgr;  // Empty
+    uavcan::OutgoingTransferRegistry<4> otr(poolmgr);
+    testBasic(otr);
+}
+
+TEST(IndexedOutgoingTransferRegistry, Basic)
+{
+    NullAllocator poolmgr;  // Empty
+    uavcan::IndexedOutgoingTransferRegistry<2, 4> otr(poolmgr);   // Fewer buckets than entries to get collisions
+    testBasic(otr);
+}
+
+TEST(IndexedOutgoingTransferRegistry, ManyDestinations)
+{
+    using uavcan::OutgoingTransferRegistryKey;
+    static const unsigned NumDestinations = 100;
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 128, uavcan::MemPoolBlockSize> pool;
+    {
+        uavcan::IndexedOutgoingTransferRegistry<64, 8> otr(pool);
+
+        for (unsigned i = 0; i < NumDestinations; i++)
+        {
+            const OutgoingTransferRegistryKey key(123, uavcan::TransferTypeServiceRequest, uint8_t(i + 1));
+            for (unsigned k = 0; k <= i % 5; k++)
+            {
+                otr.accessOrCreate(key, tsMono(1000 + i))->increment();
+            }
+        }
+        ASSERT_EQ(NumDestinations, otr.getNumEntries());
+        ASSERT_EQ(NumDestinations - 8, pool.getNumUsedBlocks());          // The first 8 are static
+
+        for (unsigned i = 0; i < NumDestinations; i++)
+        {
+            const OutgoingTransferRegistryKey key(123, uavcan::TransferTypeServiceRequest, uint8_t(i + 1));
+            ASSERT_EQ((i % 5) + 1, otr.accessOrCreate(key, tsMono(1000 + i))->get());
+        }
+
+        ASSERT_TRUE(otr.exists(123, uavcan::TransferTypeServiceRequest));
+        ASSERT_FALSE(otr.exists(123, uavcan::TransferTypeMessageBroadcast));
+        ASSERT_FALSE(otr.exists(124, uavcan::TransferTypeServiceRequest));
+
+        // Same deadline semantics as the plain registry
+        otr.cleanup(tsMono(1000 + NumDestinations / 2));
+        ASSERT_EQ(NumDestinations / 2 - 1, otr.getNumEntries());
+        for (unsigned i = 0; i < NumDestinations; i++)
+        {
+            const OutgoingTransferRegistryKey key(123, uavcan::TransferTypeServiceRequest, uint8_t(i + 1));
+            const unsigned expected_tid = (i > NumDestinations / 2) ? ((i % 5) + 1) : 0;
+            ASSERT_EQ(expected_tid, otr.accessOrCreate(key, tsMono(1000000))->get());
+        }
+        ASSERT_EQ(NumDestinations, otr.getNumEntries());
+
+        otr.cleanup(tsMono(1000000));
+        ASSERT_EQ(0, otr.getNumEntries());
+        ASSERT_EQ(0, pool.getNumUsedBlocks());
+        ASSERT_FALSE(otr.exists(123, uavcan::TransferTypeServiceRequest));
+
+        for (unsigned i = 0; i < 20; i++)
+        {
+            otr.accessOrCreate(OutgoingTransferRegistryKey(uavcan::DataTypeID(uint16_t(i)),
+                                                           uavcan::TransferTypeMessageBroadcast, 0), tsMono(1000));
+        }
+        ASSERT_EQ(12, pool.getNumUsedBlocks());
+    }
+    ASSERT_EQ(0, pool.getNumUsedBlocks());              // Released by the destructor
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "transfer_test_helpers.hpp"
+#include "can/can.hpp"
+#include <uavcan/transport/paced_transfer_sender.hpp>
+
+#if !UAVCAN_TINY
+
+static std::vector<uavcan::CanFrame> popAllTxFrames(CanIfaceMock& iface)
+{
+    std::vector<uavcan::CanFrame> frames;
+    while (!iface.tx.empty())
+    {
+        frames.push_back(iface.popTxFrame());
+    }
+    return frames;
+}
+
+TEST(PacedTransferSender, Basic)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    uavcan::TransferSender sender(dispatcher, makeDataType(uavcan::DataTypeKindMessage, 42),
+                                  uavcan::CanTxQueue::Volatile);
+
+    std::vector<uint8_t> payload;
+    for (unsigned i = 0; i < 100; i++)
+    {
+        payload.push_back(uint8_t(i * 7));
+    }
+
+    /*
+     * The frames must be exactly the same as if the transfer was sent at once
+     */
+    ASSERT_EQ(15, sender.send(&payload[0], unsigned(payload.size()), tsMono(1000), uavcan::MonotonicTime(),
+                              uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast, 5));
+    const std::vector<uavcan::CanFrame> reference = popAllTxFrames(driver.ifaces.at(0));
+    ASSERT_EQ(15, reference.size());
+
+    uavcan::PacedTransferSender paced(sender, 3);
+    ASSERT_EQ(uavcan::PacedTransferSender::StatusIdle, paced.getStatus());
+
+    ASSERT_EQ(0, paced.start(&payload[0], unsigned(payload.size()), tsMono(1000),
+                             uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast, 5));
+    ASSERT_TRUE(paced.isInProgress());
+    ASSERT_EQ(-uavcan::ErrLogic, paced.start(&payload[0], unsigned(payload.size()), tsMono(1000),
+                                             uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast));
+
+    std::vector<uavcan::CanFrame> frames = popAllTxFrames(driver.ifaces.at(0));
+    ASSERT_EQ(3, frames.size());                // The window
+    ASSERT_EQ(3, paced.getNumFramesSent());
+
+    // Every transmitted frame lets the next one in
+    for (int i = 0; (i < 100) && paced.isInProgress(); i++)
+    {
+        ASSERT_LE(0, dispatcher.spinOnce(1));
+        ASSERT_GE(3, driver.ifaces.at(0).loopback.size());      // Frames in flight
+        const std::vector<uavcan::CanFrame> more = popAllTxFrames(driver.ifaces.at(0));
+        ASSERT_GE(1, more.size());
+        frames.insert(frames.end(), more.begin(), more.end());
+    }
+
+    ASSERT_EQ(uavcan::PacedTransferSender::StatusDone, paced.getStatus());
+    ASSERT_EQ(15, paced.getNumFramesSent());
+    ASSERT_TRUE(reference == frames);
+
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(2, dispatcher.getTransferPerfCounter().getTxTransferCount());
+
+    /*
+     * Single frame transfers are sent right away
+     */
+    ASSERT_LT(0, paced.start(&payload[0], 7, tsMono(1000), uavcan::TransferTypeMessageBroadcast,
+                             uavcan::NodeID::Broadcast));
+    ASSERT_EQ(uavcan::PacedTransferSender::StatusDone, paced.getStatus());
+    ASSERT_EQ(1, driver.ifaces.at(0).tx.size());
+}
+
+TEST(PacedTransferSender, SlowIface)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 16, uavcan::MemPoolBlockSize> poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    uavcan::TransferSender sender(dispatcher, makeDataType(uavcan::DataTypeKindService, 42),
+                                  uavcan::CanTxQueue::Persistent);
+
+    std::vector<uint8_t> payload(200, 0xA5);
+    uavcan::PacedTransferSender paced(sender);
+    ASSERT_EQ(uavcan::PacedTransferSender::DefaultWindowSize, paced.getWindowSize());
+
+    /*
+     * The second interface can't transmit, so the window doesn't advance
+     */
+    driver.ifaces.at(1).writeable = false;
+    ASSERT_EQ(0, paced.start(&payload[0], unsigned(payload.size()), tsMono(1000),
+                             uavcan::TransferTypeServiceRequest, uavcan::NodeID(65)));
+
+    for (int i = 0; i < 5; i++)
+    {
+        ASSERT_LE(0, dispatcher.spinOnce());
+    }
+    ASSERT_TRUE(paced.isInProgress());
+    ASSERT_EQ(uavcan::PacedTransferSender::DefaultWindowSize, paced.getNumFramesSent());
+    ASSERT_EQ(uavcan::PacedTransferSender::DefaultWindowSize, driver.ifaces.at(0).tx.size());
+    ASSERT_EQ(0, driver.ifaces.at(1).tx.size());
+    ASSERT_EQ(uavcan::PacedTransferSender::DefaultWindowSize, poolmgr.getNumUsedBlocks());    // One per frame
+
+    /*
+     * Once it can, the transfer is completed on both interfaces
+     */
+    driver.ifaces.at(1).writeable = true;
+    for (int i = 0; (i < 100) && paced.isInProgress(); i++)
+    {
+        ASSERT_LE(0, dispatcher.spinOnce());
+    }
+    ASSERT_EQ(uavcan::PacedTransferSender::StatusDone, paced.getStatus());
+    ASSERT_EQ(29, paced.getNumFramesSent());                    // (200 + 2) / 7
+    ASSERT_EQ(29, driver.ifaces.at(0).tx.size());
+    ASSERT_EQ(29, driver.ifaces.at(1).tx.size());
+
+    /*
+     * Interface that never recovers - the transfer fails at the TX deadline
+     */
+    driver.ifaces.at(1).writeable = false;
+    ASSERT_EQ(0, paced.start(&payload[0], unsigned(payload.size()), tsMono(1000),
+                             uavcan::TransferTypeServiceRequest, uavcan::NodeID(65)));
+    ASSERT_LE(0, dispatcher.spinOnce());
+    ASSERT_TRUE(paced.isInProgress());
+
+    clockmock.advance(1000);
+    ASSERT_EQ(uavcan::PacedTransferSender::StatusFailed, paced.getStatus());
+
+    // A new transfer can be started right away
+    driver.ifaces.at(1).writeable = true;
+    ASSERT_EQ(0, paced.start(&payload[0], unsigned(payload.size()), tsMono(3000),
+                             uavcan::TransferTypeServiceRequest, uavcan::NodeID(65)));
+    paced.cancel();
+    ASSERT_EQ(uavcan::PacedTransferSender::StatusFailed, paced.getStatus());
+    EXPECT_EQ(2, dispatcher.getTransferPerfCounter().getErrorCount());
+
+    // Passive mode
+    uavcan::Dispatcher passive_dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    uavcan::TransferSender passive_sender(passive_dispatcher, makeDataType(uavcan::DataTypeKindMessage, 42),
+                                          uavcan::CanTxQueue::Volatile);
+    uavcan::PacedTransferSender passive_paced(passive_sender);
+    ASSERT_EQ(-uavcan::ErrPassiveMode, passive_paced.start(&payload[0], unsigned(payload.size()), tsMono(3000),
+                                                           uavcan::TransferTypeMessageBroadcast,
+                                                           uavcan::NodeID::Broadcast, 0));
+}
+
+#endif
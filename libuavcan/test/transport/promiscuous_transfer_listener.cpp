@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "transfer_test_helpers.hpp"
+#include "can/can.hpp"
+#include <uavcan/transport/dispatcher.hpp>
+#include <uavcan/transport/promiscuous_transfer_listener.hpp>
+
+#if !UAVCAN_TINY
+
+template <unsigned NumSlots, unsigned MaxPayloadLen>
+struct PromiscuousListener : public uavcan::PromiscuousTransferListener<NumSlots, MaxPayloadLen>
+{
+    struct Received
+    {
+        uavcan::DataTypeID data_type_id;
+        uavcan::TransferType transfer_type;
+        uavcan::NodeID src_node_id;
+        uavcan::NodeID dst_node_id;
+        uavcan::TransferID transfer_id;
+        uint16_t transfer_crc;
+        bool multi_frame;
+        std::string payload;
+    };
+
+    std::vector<Received> transfers;
+
+    virtual void handleIncomingTransfer(uavcan::PromiscuousIncomingTransfer& transfer)
+    {
+        Received r;
+        r.data_type_id = transfer.getDataTypeID();
+        r.transfer_type = transfer.getTransferType();
+        r.src_node_id = transfer.getSrcNodeID();
+        r.dst_node_id = transfer.getDstNodeID();
+        r.transfer_id = transfer.getTransferID();
+        r.transfer_crc = transfer.getTransferCRC();
+        r.multi_frame = transfer.isMultiFrame();
+
+        uint8_t buf[512];
+        const int res = transfer.read(0, buf, sizeof(buf));
+        EXPECT_LE(0, res);
+        r.payload = std::string(reinterpret_cast<const char*>(buf), unsigned(std::max(res, 0)));
+        transfers.push_back(r);
+    }
+};
+
+static uint16_t computeTransferCRC(const Transfer& tr)
+{
+    uavcan::TransferCRC crc = tr.data_type.getSignature().toTransferCRC();
+    crc.add(reinterpret_cast<const uint8_t*>(tr.payload.c_str()), unsigned(tr.payload.length()));
+    return crc.get();
+}
+
+TEST(PromiscuousTransferListener, Reassembly)
+{
+    PromiscuousListener<2, 64> listener;
+    ASSERT_EQ(2, listener.getNumSlots());
+    ASSERT_EQ(64, listener.getMaxPayloadLen());
+
+    const uavcan::DataTypeDescriptor type_a = makeDataType(uavcan::DataTypeKindMessage, 100);
+    const uavcan::DataTypeDescriptor type_b = makeDataType(uavcan::DataTypeKindService, 200);
+
+    const Transfer tr_a(1000, 0, 10, uavcan::TransferTypeMessageBroadcast, 1, 42, uavcan::NodeID::Broadcast,
+                        "Long message transfer of an unregistered type", type_a);
+    const Transfer tr_b(1000, 0, 10, uavcan::TransferTypeServiceRequest, 2, 43, 44,
+                        "Request addressed to some other node", type_b);
+    const Transfer tr_c(1000, 0, 10, uavcan::TransferTypeMessageBroadcast, 3, 45, uavcan::NodeID::Broadcast,
+                        "Short", type_a);
+
+    const std::vector<uavcan::RxFrame> frames_a = serializeTransfer(tr_a);
+    const std::vector<uavcan::RxFrame> frames_b = serializeTransfer(tr_b);
+    const std::vector<uavcan::RxFrame> frames_c = serializeTransfer(tr_c);
+    ASSERT_LT(1, frames_a.size());
+    ASSERT_LT(1, frames_b.size());
+    ASSERT_EQ(1, frames_c.size());
+
+    /*
+     * Interleaved multi frame transfers, single frame transfer in the middle
+     */
+    for (unsigned i = 0; i < std::max(frames_a.size(), frames_b.size()); i++)
+    {
+        if (i < frames_a.size())
+        {
+            listener.handleFrame(frames_a[i]);
+        }
+        if (i < frames_b.size())
+        {
+            listener.handleFrame(frames_b[i]);
+        }
+        if (i == 1)
+        {
+            ASSERT_EQ(2, listener.getNumTransfersInProgress());
+            listener.handleFrame(frames_c[0]);
+        }
+    }
+
+    ASSERT_EQ(3, listener.transfers.size());
+    ASSERT_EQ(0, listener.getNumTransfersInProgress());
+    ASSERT_EQ(0, listener.getNumErrors());
+    ASSERT_EQ(0, listener.getNumDroppedTransfers());
+
+    ASSERT_EQ(tr_c.payload, listener.transfers[0].payload);
+    ASSERT_FALSE(listener.transfers[0].multi_frame);
+    ASSERT_EQ(0, listener.transfers[0].transfer_crc);
+
+    // Transfer B is shorter, so it completes first
+    ASSERT_EQ(tr_b.payload, listener.transfers[1].payload);
+    ASSERT_EQ(200, listener.transfers[1].data_type_id.get());
+    ASSERT_EQ(uavcan::TransferTypeServiceRequest, listener.transfers[1].transfer_type);
+    ASSERT_EQ(uavcan::NodeID(44), listener.transfers[1].dst_node_id);
+    ASSERT_EQ(computeTransferCRC(tr_b), listener.transfers[1].transfer_crc);
+
+    ASSERT_EQ(tr_a.payload, listener.transfers[2].payload);
+    ASSERT_TRUE(listener.transfers[2].multi_frame);
+    ASSERT_EQ(100, listener.transfers[2].data_type_id.get());
+    ASSERT_EQ(uavcan::NodeID(42), listener.transfers[2].src_node_id);
+    ASSERT_EQ(uavcan::NodeID::Broadcast, listener.transfers[2].dst_node_id);
+    ASSERT_EQ(computeTransferCRC(tr_a), listener.transfers[2].transfer_crc);
+    listener.transfers.clear();
+
+    /*
+     * Missing frame
+     */
+    listener.handleFrame(frames_a[0]);
+    listener.handleFrame(frames_a[2]);
+    ASSERT_EQ(1, listener.getNumErrors());
+    ASSERT_EQ(0, listener.getNumTransfersInProgress());
+    for (unsigned i = 3; i < frames_a.size(); i++)
+    {
+        listener.handleFrame(frames_a[i]);          // Ignored, the beginning is missing
+    }
+    ASSERT_TRUE(listener.transfers.empty());
+
+    /*
+     * Too long
+     */
+    const Transfer tr_long(1000, 0, 10, uavcan::TransferTypeMessageBroadcast, 4, 42, uavcan::NodeID::Broadcast,
+                           std::string(100, 'x'), type_a);
+    const std::vector<uavcan::RxFrame> frames_long = serializeTransfer(tr_long);
+    for (unsigned i = 0; i < frames_long.size(); i++)
+    {
+        listener.handleFrame(frames_long[i]);
+    }
+    ASSERT_TRUE(listener.transfers.empty());
+    ASSERT_EQ(1, listener.getNumDroppedTransfers());
+    ASSERT_EQ(0, listener.getNumTransfersInProgress());
+}
+
+TEST(PromiscuousTransferListener, SlotExhaustion)
+{
+    PromiscuousListener<2, 64> listener;
+
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindMessage, 300);
+    std::vector<std::vector<uavcan::RxFrame> > frames;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        const Transfer tr(1000 + i * 1000000ULL, 0, 10, uavcan::TransferTypeMessageBroadcast, 0, uint8_t(10 + i),
+                          uavcan::NodeID::Broadcast, "Multi frame transfer payload", type);
+        frames.push_back(serializeTransfer(tr));
+    }
+
+    // Two slots are taken
+    listener.handleFrame(frames[0][0]);
+    listener.handleFrame(frames[1][0]);
+    ASSERT_EQ(2, listener.getNumTransfersInProgress());
+
+    // The third transfer starts 2 seconds after the first one, within the timeout, so it is dropped
+    listener.setTransferTimeout(uavcan::MonotonicDuration::fromMSec(2500));
+    listener.handleFrame(frames[2][0]);
+    ASSERT_EQ(1, listener.getNumDroppedTransfers());
+
+    // The fourth one starts 3 seconds after the first one, the stalest transfer is evicted
+    listener.handleFrame(frames[3][0]);
+    ASSERT_EQ(1, listener.getNumDroppedTransfers());
+    ASSERT_EQ(1, listener.getNumErrors());
+    ASSERT_EQ(2, listener.getNumTransfersInProgress());
+
+    for (unsigned i = 1; i < frames[3].size(); i++)
+    {
+        listener.handleFrame(frames[3][i]);
+    }
+    for (unsigned i = 1; i < frames[0].size(); i++)
+    {
+        listener.handleFrame(frames[0][i]);         // Evicted, ignored
+    }
+    for (unsigned i = 1; i < frames[1].size(); i++)
+    {
+        listener.handleFrame(frames[1][i]);
+    }
+
+    ASSERT_EQ(2, listener.transfers.size());
+    ASSERT_EQ(uavcan::NodeID(13), listener.transfers[0].src_node_id);
+    ASSERT_EQ(uavcan::NodeID(11), listener.transfers[1].src_node_id);
+    ASSERT_EQ(0, listener.getNumTransfersInProgress());
+
+    listener.handleFrame(frames[0][0]);
+    listener.reset();
+    ASSERT_EQ(0, listener.getNumTransfersInProgress());
+}
+
+TEST(PromiscuousTransferListener, Dispatcher)
+{
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(2, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(pool);
+
+    uavcan::Dispatcher dispatcher(driver, pool, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    PromiscuousListener<4, 128> listener;
+    ASSERT_FALSE(dispatcher.getPromiscuousTransferListener());
+    dispatcher.installPromiscuousTransferListener(&listener);
+    ASSERT_EQ(&listener, dispatcher.getPromiscuousTransferListener());
+
+    // No transfer listeners at all; the service request is addressed to another node
+    const Transfer tr_msg(1000, 0, 10, uavcan::TransferTypeMessageBroadcast, 1, 42, uavcan::NodeID::Broadcast,
+                          "Message of unknown type", makeDataType(uavcan::DataTypeKindMessage, 1000));
+    const Transfer tr_srv(1000, 0, 10, uavcan::TransferTypeServiceRequest, 2, 42, 65,
+                          "Request", makeDataType(uavcan::DataTypeKindService, 100));
+
+    std::vector<uavcan::RxFrame> frames = serializeTransfer(tr_msg);
+    const std::vector<uavcan::RxFrame> frames_srv = serializeTransfer(tr_srv);
+    frames.insert(frames.end(), frames_srv.begin(), frames_srv.end());
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        driver.ifaces.at(1).pushRx(frames[i]);
+    }
+
+    while (dispatcher.spinOnce() > 0)
+    {
+    }
+
+    ASSERT_EQ(2, listener.transfers.size());
+    ASSERT_EQ(tr_msg.payload, listener.transfers[0].payload);
+    ASSERT_EQ(1000, listener.transfers[0].data_type_id.get());
+    ASSERT_EQ(tr_srv.payload, listener.transfers[1].payload);
+    ASSERT_EQ(uavcan::NodeID(65), listener.transfers[1].dst_node_id);
+
+    // The frames are still unwanted by the node itself
+    ASSERT_EQ(frames.size(), dispatcher.getNumRejectedRxFrames());
+
+    dispatcher.removePromiscuousTransferListener();
+    ASSERT_FALSE(dispatcher.getPromiscuousTransferListener());
+
+    driver.ifaces.at(1).pushRx(frames_srv[0]);
+    while (dispatcher.spinOnce() > 0)
+    {
+    }
+    ASSERT_EQ(2, listener.transfers.size());
+}
+
+#endif
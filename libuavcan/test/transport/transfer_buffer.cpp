@@ -191,6 +191,131 @@ TEST(DynamicTransferBufferManagerEntry, Basic)
 }
 
 
+TEST(DynamicTransferBufferManagerEntry, ContiguousSpans)
+{
+    using uavcan::DynamicTransferBufferManagerEntry;
+
+    static const int MAX_SIZE = TEST_BUFFER_SIZE;
+    static const int POOL_BLOCKS = 8;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    DynamicTransferBufferManagerEntry buf(pool, MAX_SIZE);
+    const uint8_t* span = NULL;
+    ASSERT_EQ(0, buf.getContiguousSpan(0, span));
+
+    const uint8_t* const test_data_ptr = reinterpret_cast<const uint8_t*>(TEST_DATA.c_str());
+    ASSERT_EQ(MAX_SIZE - 10, buf.write(0, test_data_ptr, MAX_SIZE - 10));
+
+    // Walking the buffer span by span must yield the same data as read()
+    std::string gathered;
+    unsigned num_spans = 0;
+    while (true)
+    {
+        const unsigned len = buf.getContiguousSpan(unsigned(gathered.length()), span);
+        if (len == 0)
+        {
+            break;
+        }
+        ASSERT_TRUE(span);
+        gathered.append(reinterpret_cast<const char*>(span), len);
+        num_spans++;
+    }
+    ASSERT_EQ(TEST_DATA.substr(0, MAX_SIZE - 10), gathered);
+    ASSERT_EQ(pool.getNumUsedBlocks(), num_spans);
+
+    // Span from the middle of a block ends at the block boundary
+    const unsigned first_len = buf.getContiguousSpan(0, span);
+    const unsigned len = buf.getContiguousSpan(3, span);
+    ASSERT_EQ(first_len - 3, len);
+    ASSERT_EQ(TEST_DATA.substr(3, len), std::string(reinterpret_cast<const char*>(span), len));
+    ASSERT_EQ(0, buf.getContiguousSpan(MAX_SIZE - 10, span));
+}
+
+TEST(DynamicTransferBufferManagerEntry, SequentialAccess)
+{
+    using uavcan::DynamicTransferBufferManagerEntry;
+
+    static const int MAX_SIZE = TEST_BUFFER_SIZE;
+    static const int POOL_BLOCKS = 8;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    DynamicTransferBufferManagerEntry buf(pool, MAX_SIZE);
+    const uint8_t* const test_data_ptr = reinterpret_cast<const uint8_t*>(TEST_DATA.c_str());
+
+    // Frame-sized writes, like the transfer receiver does
+    static const unsigned Chunk = 7;
+    for (unsigned offset = 0; offset < MAX_SIZE; offset += Chunk)
+    {
+        const unsigned len = std::min(Chunk, MAX_SIZE - offset);
+        ASSERT_EQ(int(len), buf.write(offset, test_data_ptr + offset, len));
+    }
+    ASSERT_TRUE(matchAgainstTestData(buf, 0));
+
+    // Frame-sized reads, both forward and backward
+    uint8_t local_buffer[Chunk];
+    for (unsigned offset = 0; offset < MAX_SIZE; offset += Chunk)
+    {
+        const int res = buf.read(offset, local_buffer, Chunk);
+        ASSERT_EQ(int(std::min(Chunk, MAX_SIZE - offset)), res);
+        ASSERT_TRUE(std::equal(local_buffer, local_buffer + res, test_data_ptr + offset));
+    }
+    for (unsigned offset = MAX_SIZE - Chunk; offset >= Chunk; offset -= Chunk)
+    {
+        ASSERT_EQ(int(Chunk), buf.read(offset, local_buffer, Chunk));
+        ASSERT_TRUE(std::equal(local_buffer, local_buffer + Chunk, test_data_ptr + offset));
+    }
+
+    // Overwriting the beginning after the cursor has moved to the end
+    ASSERT_EQ(int(Chunk), buf.write(0, test_data_ptr + 1, Chunk));
+    ASSERT_EQ(int(Chunk), buf.read(0, local_buffer, Chunk));
+    ASSERT_TRUE(std::equal(local_buffer, local_buffer + Chunk, test_data_ptr + 1));
+
+    // Reset must invalidate the cursor
+    buf.reset();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    ASSERT_EQ(MAX_SIZE, buf.write(0, test_data_ptr, MAX_SIZE));
+    ASSERT_TRUE(matchAgainstTestData(buf, 0));
+}
+
+#if UAVCAN_CONTIGUOUS_TRANSFER_BUFFERS
+TEST(DynamicTransferBufferManagerEntry, LargeSpans)
+{
+    using uavcan::DynamicTransferBufferManagerEntry;
+
+    static const int MAX_SIZE = TEST_BUFFER_SIZE;
+    static const unsigned LargeBlockSize = 240;
+    uavcan::MultiSizePoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize,
+                                   LargeBlockSize, LargeBlockSize> pool;
+
+    DynamicTransferBufferManagerEntry buf(pool, MAX_SIZE);
+    const uint8_t* const test_data_ptr = reinterpret_cast<const uint8_t*>(TEST_DATA.c_str());
+
+    // The whole buffer fits one large block
+    ASSERT_EQ(MAX_SIZE, buf.write(0, test_data_ptr, MAX_SIZE));
+    ASSERT_TRUE(matchAgainstTestData(buf, 0));
+    ASSERT_EQ(0, pool.getSizeClassUsage(0).num_used_blocks);
+    ASSERT_EQ(1, pool.getSizeClassUsage(1).num_used_blocks);
+
+    const uint8_t* span = NULL;
+    ASSERT_EQ(unsigned(MAX_SIZE), buf.getContiguousSpan(0, span));
+    ASSERT_EQ(TEST_DATA.substr(0, MAX_SIZE), std::string(reinterpret_cast<const char*>(span), MAX_SIZE));
+
+    buf.reset();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    // Large block is not available - falling back to regular blocks
+    void* const large = pool.allocate(LargeBlockSize);
+    ASSERT_TRUE(large);
+    ASSERT_EQ(MAX_SIZE, buf.write(0, test_data_ptr, MAX_SIZE));
+    ASSERT_TRUE(matchAgainstTestData(buf, 0));
+    ASSERT_LT(1, pool.getSizeClassUsage(0).num_used_blocks);
+
+    buf.reset();
+    pool.deallocate(large);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+#endif
+
 static const std::string MGR_TEST_DATA[4] =
 {
     "I thought you would cry out again \'don\'t speak of it, leave off.\'\" Raskolnikov gave a laugh, but rather a "
@@ -334,6 +459,83 @@ TEST(TransferBufferManager, Basic)
 }
 
 
+TEST(TransferBufferManager, MigrationPolicy)
+{
+    using uavcan::TransferBufferManager;
+    using uavcan::TransferBufferManagerImpl;
+    using uavcan::TransferBufferManagerKey;
+    using uavcan::ITransferBuffer;
+
+    static const int POOL_BLOCKS = 16;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    TransferBufferManager<MGR_MAX_BUFFER_SIZE, 1> mgr(pool);
+    ASSERT_EQ(TransferBufferManagerImpl::MigrateAlways, mgr.getMigrationPolicy());
+
+    const TransferBufferManagerKey keys[3] =
+    {
+        TransferBufferManagerKey(1, uavcan::TransferTypeMessageBroadcast),
+        TransferBufferManagerKey(2, uavcan::TransferTypeMessageBroadcast),
+        TransferBufferManagerKey(3, uavcan::TransferTypeServiceRequest)
+    };
+
+    ITransferBuffer* tbb = NULL;
+
+    // Never - the released static buffer stays empty until the next transfer
+    mgr.setMigrationPolicy(TransferBufferManagerImpl::MigrateNever);
+    ASSERT_TRUE((tbb = mgr.create(keys[0])));
+    ASSERT_EQ(MGR_MAX_BUFFER_SIZE, fillTestData(MGR_TEST_DATA[0], tbb));
+    ASSERT_TRUE((tbb = mgr.create(keys[1])));
+    ASSERT_EQ(MGR_MAX_BUFFER_SIZE, fillTestData(MGR_TEST_DATA[1], tbb));
+    ASSERT_EQ(1, mgr.getNumStaticBuffers());
+    ASSERT_EQ(1, mgr.getNumDynamicBuffers());
+
+    mgr.remove(keys[0]);
+    ASSERT_EQ(0, mgr.getNumStaticBuffers());
+    ASSERT_EQ(1, mgr.getNumDynamicBuffers());
+    ASSERT_EQ(0, mgr.getNumMigrations());
+
+    ASSERT_TRUE((tbb = mgr.create(keys[0])));
+    ASSERT_EQ(MGR_MAX_BUFFER_SIZE, fillTestData(MGR_TEST_DATA[0], tbb));
+    ASSERT_EQ(1, mgr.getNumStaticBuffers());
+    ASSERT_EQ(1, mgr.getNumDynamicBuffers());
+
+    // Idle only - the dynamic buffer was written since it was created, so it is skipped once
+    mgr.setMigrationPolicy(TransferBufferManagerImpl::MigrateIdleOnly);
+    mgr.remove(keys[0]);
+    ASSERT_EQ(0, mgr.getNumStaticBuffers());
+    ASSERT_EQ(1, mgr.getNumDynamicBuffers());
+    ASSERT_EQ(0, mgr.getNumMigrations());
+
+    ASSERT_TRUE((tbb = mgr.create(keys[0])));
+    ASSERT_EQ(MGR_MAX_BUFFER_SIZE, fillTestData(MGR_TEST_DATA[0], tbb));
+    mgr.remove(keys[0]);                                    // Not written since the last time, migrating
+    ASSERT_EQ(1, mgr.getNumStaticBuffers());
+    ASSERT_EQ(0, mgr.getNumDynamicBuffers());
+    ASSERT_EQ(1, mgr.getNumMigrations());
+    ASSERT_EQ(MGR_MAX_BUFFER_SIZE, mgr.getNumMigratedBytes());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    ASSERT_TRUE((tbb = mgr.access(keys[1])));
+    ASSERT_TRUE(matchAgainst(MGR_TEST_DATA[1], *tbb, 0, MGR_MAX_BUFFER_SIZE));
+
+    // Always - migrated regardless of the recent writes
+    mgr.setMigrationPolicy(TransferBufferManagerImpl::MigrateAlways);
+    ASSERT_TRUE((tbb = mgr.create(keys[2])));
+    ASSERT_EQ(10, tbb->write(0, reinterpret_cast<const uint8_t*>(MGR_TEST_DATA[2].c_str()), 10));
+    ASSERT_EQ(1, mgr.getNumDynamicBuffers());
+
+    mgr.remove(keys[1]);
+    ASSERT_EQ(1, mgr.getNumStaticBuffers());
+    ASSERT_EQ(0, mgr.getNumDynamicBuffers());
+    ASSERT_EQ(2, mgr.getNumMigrations());
+    ASSERT_EQ(MGR_MAX_BUFFER_SIZE + 10, mgr.getNumMigratedBytes());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    ASSERT_TRUE((tbb = mgr.access(keys[2])));
+    ASSERT_TRUE(matchAgainst(MGR_TEST_DATA[2], *tbb, 0, 10));
+}
+
 TEST(TransferBufferManager, EmptySpecialization)
 {
     uavcan::TransferBufferManager<0, 0> mgr;
@@ -148,7 +148,7 @@ TEST(TransferListener, BasicSFT)
         emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   2, ""),
         emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   3, "abc"),
         emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse,  4, ""),
-        emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse,  2, ""),             // New TT, ignored due to OOM
+        emulator.makeTransfer(16, uavcan::TransferTypeServiceResponse,  2, ""),             // New TT, regular receiver
         emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   2, "foo"),          // Same as 2, not ignored
         emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   2, "123456789abc"), // Same as 2, not SFT - ignore
         emulator.makeTransfer(16, uavcan::TransferTypeServiceRequest,   2, "bar"),          // Same as 2, not ignored
@@ -161,6 +161,7 @@ TEST(TransferListener, BasicSFT)
     ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));
     ASSERT_TRUE(subscriber.matchAndPop(transfers[3]));
     ASSERT_TRUE(subscriber.matchAndPop(transfers[4]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[5]));
     ASSERT_TRUE(subscriber.matchAndPop(transfers[6]));
     ASSERT_TRUE(subscriber.matchAndPop(transfers[8]));
 
@@ -168,6 +169,425 @@ TEST(TransferListener, BasicSFT)
 }
 
 
+TEST(TransferListener, SingleFrameOnly)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    NullAllocator poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener<0, 0, 1> subscriber(perf, type, poolmgr); // The only receiver must not be wasted on MFT
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "123456789abc"), // MFT - dropped
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "123"),          // Another node - accepted
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "456")           // Node 1 accepted too
+    };
+
+    emulator.send(transfers);
+
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));
+    ASSERT_TRUE(subscriber.isEmpty());
+}
+
+
+static uavcan::RxFrame makeSingleFrame(const uavcan::DataTypeDescriptor& type, uint64_t& ts_usec,
+                                       uint8_t src_node_id, uint8_t tid, uint8_t iface_index, uint64_t delay_usec)
+{
+    const uint8_t payload[] = { 42 };
+    uavcan::Frame frame(type.getID(), uavcan::TransferTypeMessageBroadcast, src_node_id,
+                        uavcan::NodeID::Broadcast, tid);
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    EXPECT_EQ(1, frame.setPayload(payload, sizeof(payload)));
+    ts_usec += delay_usec;
+    return uavcan::RxFrame(frame, tsMono(ts_usec), tsUtc(ts_usec), iface_index);
+}
+
+TEST(TransferListener, SingleFrameTable)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    NullAllocator poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener<0, 0, 0> subscriber(perf, type, poolmgr); // No receivers at all, single-frame table only
+
+    uint64_t ts = 10000;
+
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 0, 0, 0));         // New source - accepted
+    subscriber.handleFrame(makeSingleFrame(type, ts, 11, 5, 0, 0));         // Another new source - accepted
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 0, 1, 100));       // Redundant iface - ignored
+    ASSERT_EQ(2, subscriber.getNumReceivedTransfers());
+
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 1, 0, 10000));     // Next TID - accepted
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 1, 0, 100));       // Duplicate - rejected, error
+    ASSERT_EQ(3, subscriber.getNumReceivedTransfers());
+    ASSERT_EQ(1, perf.getErrorCount());
+
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 5, 0, 10000));     // TID jump - accepted, error
+    ASSERT_EQ(4, subscriber.getNumReceivedTransfers());
+    ASSERT_EQ(2, perf.getErrorCount());
+
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 5, 0, 2000000));   // TID timeout - accepted, error
+    ASSERT_EQ(5, subscriber.getNumReceivedTransfers());
+    ASSERT_EQ(3, perf.getErrorCount());
+
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 6, 1, 2000000));   // Timeout, other iface - accepted
+    ASSERT_EQ(6, subscriber.getNumReceivedTransfers());
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 7, 0, 1000));      // Old iface - ignored
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 7, 1, 1000));      // Current iface - accepted
+    ASSERT_EQ(7, subscriber.getNumReceivedTransfers());
+    ASSERT_EQ(3, perf.getErrorCount());
+    ASSERT_EQ(7, perf.getRxTransferCount());
+}
+
+TEST(TransferListener, EarliestArrival)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    NullAllocator poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener<0, 0, 0> subscriber(perf, type, poolmgr);
+    ASSERT_FALSE(subscriber.isEarliestArrivalMode());
+    subscriber.setEarliestArrivalMode(true);
+    ASSERT_TRUE(subscriber.isEarliestArrivalMode());
+
+    uint64_t ts = 10000;
+
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 0, 0, 0));         // New source - accepted
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 0, 1, 100));       // Redundant copy - ignored
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 1, 1, 1000));      // Other iface came first - accepted
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 1, 0, 100));       // Redundant copy - ignored
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 2, 0, 1000));      // Back to the first iface - accepted
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 1, 1, 100));       // Late old copy - ignored
+    subscriber.handleFrame(makeSingleFrame(type, ts, 10, 2, 1, 100));       // Redundant copy - ignored
+    ASSERT_EQ(3, subscriber.getNumReceivedTransfers());
+    ASSERT_EQ(0, perf.getErrorCount());
+}
+
+
+/**
+ * Keeps copies of the received transfers until they are fed back explicitly.
+ */
+class TransferHandoffMock : public uavcan::ITransferHandoff
+{
+    struct Entry
+    {
+        uavcan::TransferListenerBase* listener;
+        uint8_t payload[1024];
+        uavcan::DeferredIncomingTransfer* transfer;
+        uavcan::DeferredTransferResult result;
+    };
+
+    std::vector<Entry*> entries_;
+    std::vector<Entry*> processed_;
+
+public:
+    bool accept;
+
+    TransferHandoffMock() : accept(true) { }
+
+    virtual bool handOff(uavcan::TransferListenerBase& listener, uavcan::IncomingTransfer& transfer)
+    {
+        if (!accept)
+        {
+            return false;
+        }
+        Entry* const e = new Entry;
+        e->listener = &listener;
+        const int len = transfer.read(0, e->payload, sizeof(e->payload));
+        EXPECT_LE(0, len);
+        e->transfer = new uavcan::DeferredIncomingTransfer(transfer, e->payload, unsigned(len));
+        entries_.push_back(e);
+        return true;
+    }
+
+    unsigned getNumPending() const { return unsigned(entries_.size()); }
+
+    /**
+     * Emulates the worker thread; the results are kept until committed.
+     */
+    void processAll()
+    {
+        for (unsigned i = 0; i < entries_.size(); i++)
+        {
+            entries_[i]->listener->handleDeferredTransfer(*entries_[i]->transfer, entries_[i]->result);
+            delete entries_[i]->transfer;
+            processed_.push_back(entries_[i]);
+        }
+        entries_.clear();
+    }
+
+    void commitAll()
+    {
+        for (unsigned i = 0; i < processed_.size(); i++)
+        {
+            processed_[i]->listener->commitDeferredTransfer(processed_[i]->result);
+            delete processed_[i];
+        }
+        processed_.clear();
+    }
+
+    ~TransferHandoffMock()
+    {
+        processAll();
+        commitAll();
+    }
+};
+
+
+TEST(TransferListener, Handoff)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    TestListener<256, 0, 2> subscriber(perf, type, pool);    // The MFT buffer is taken from the pool
+    TransferHandoffMock handoff;
+
+    ASSERT_EQ(NULL, subscriber.getTransferHandoff());
+    subscriber.setTransferHandoff(&handoff);
+    ASSERT_EQ(&handoff, subscriber.getTransferHandoff());
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "123456789abcdefghijklmnopqrstuvwxyz"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "123")
+    };
+
+    /*
+     * The transfers are not processed until fed back; the reception buffers are released immediately
+     */
+    emulator.send(transfers);
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(2, handoff.getNumPending());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    handoff.processAll();
+    handoff.commitAll();
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(0, perf.getErrorCount());
+
+    /*
+     * Rejected transfers are dropped
+     */
+    handoff.accept = false;
+    const Transfer rejected = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "456");
+    emulator.send(&rejected, 1);
+    ASSERT_EQ(0, handoff.getNumPending());
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(1, perf.getErrorCount());
+
+    /*
+     * Handoff disabled
+     */
+    subscriber.setTransferHandoff(NULL);
+    const Transfer direct = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 4, "789");
+    emulator.send(&direct, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(direct));
+}
+
+
+/**
+ * Fails the transfers that start with '!', like a subscriber that cannot decode them; takes 100 usec per transfer.
+ */
+class SlowFailingListener : public TestListener<256, 0, 2>
+{
+    const SystemClockMock& clock_;
+
+public:
+    SlowFailingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                        uavcan::IPoolAllocator& allocator, const SystemClockMock& clock)
+        : TestListener<256, 0, 2>(perf, data_type, allocator)
+        , clock_(clock)
+    { }
+
+    void handleIncomingTransfer(uavcan::IncomingTransfer& transfer)
+    {
+        uint8_t first = 0;
+        (void)transfer.read(0, &first, 1);
+        TestListener<256, 0, 2>::handleIncomingTransfer(transfer);
+        clock_.advance(100);
+        if (first == '!')
+        {
+            ASSERT_TRUE(getDeferredTransferResult());
+            getDeferredTransferResult()->failed = true;
+        }
+    }
+};
+
+TEST(TransferListener, HandoffAccounting)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 8, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    SystemClockMock clock;
+    SlowFailingListener subscriber(perf, type, pool, clock);
+    uavcan::DataTypeStats stats;
+    subscriber.setDataTypeStats(&stats, &clock);
+
+    TransferHandoffMock handoff;
+    subscriber.setTransferHandoff(&handoff);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "!bad"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "good")
+    };
+    emulator.send(transfers);
+    ASSERT_EQ(2, handoff.getNumPending());
+    ASSERT_EQ(2, perf.getRxTransferCount());
+    ASSERT_EQ(2, stats.transfers_rx);
+
+    /*
+     * The worker does not touch the counters
+     */
+    ASSERT_FALSE(subscriber.getDeferredTransferResult());
+    handoff.processAll();
+    ASSERT_FALSE(subscriber.getDeferredTransferResult());
+    ASSERT_EQ(0, perf.getErrorCount());
+    ASSERT_EQ(0, stats.max_callback_duration_usec);
+
+    /*
+     * The outcome is accounted when committed by the spinning thread
+     */
+    handoff.commitAll();
+    ASSERT_EQ(1, perf.getErrorCount());
+    ASSERT_EQ(100, stats.max_callback_duration_usec);
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[1]));
+}
+
+
+/**
+ * Accepts the transfers whose payload starts with the specified character.
+ */
+struct FirstBytePrefilter : public uavcan::ITransferPrefilter
+{
+    const char wanted;
+    unsigned num_calls;
+
+    explicit FirstBytePrefilter(char arg_wanted) : wanted(arg_wanted), num_calls(0) { }
+
+    virtual bool acceptTransfer(const uint8_t* payload, unsigned payload_len, uavcan::NodeID)
+    {
+        num_calls++;
+        return (payload_len > 0) && (payload[0] == uint8_t(wanted));
+    }
+};
+
+TEST(TransferListener, Prefilter)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    static const int NUM_POOL_BLOCKS = 8;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NUM_POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    uavcan::TransferPerfCounter perf;
+    TestListener<256, 0, 1> subscriber(perf, type, pool);        // The buffers are allocated from the pool
+
+    FirstBytePrefilter prefilter('A');
+    subscriber.setTransferPrefilter(&prefilter);
+    ASSERT_EQ(&prefilter, subscriber.getTransferPrefilter());
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "A multi-frame transfer, accepted"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "B multi-frame transfer, discarded"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "A multi-frame transfer, accepted again"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "Bsft"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "Asft")
+    };
+
+    // The discarded transfer does not allocate the buffer
+    const std::vector<uavcan::RxFrame> ser_discarded = serializeTransfer(transfers[1]);
+    ASSERT_LT(2, ser_discarded.size());
+    emulator.send(&transfers[0], 1);
+    subscriber.handleFrame(ser_discarded[0]);
+    subscriber.handleFrame(ser_discarded[1]);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    for (unsigned i = 2; i < ser_discarded.size(); i++)
+    {
+        subscriber.handleFrame(ser_discarded[i]);
+    }
+    emulator.send(&transfers[2], 3);
+
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[4]));           // Sent concurrently, the SFT completes first
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    ASSERT_EQ(5, prefilter.num_calls);                          // Once per transfer
+    ASSERT_EQ(0, perf.getErrorCount());                         // The discarded transfer did not confuse the receiver
+    ASSERT_EQ(3, perf.getRxTransferCount());
+
+    // Without the prefilter everything is accepted again
+    subscriber.setTransferPrefilter(NULL);
+    const Transfer tr = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "Bcd");
+    emulator.send(&tr, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(tr));
+}
+
+
+/**
+ * Rejects the transfers from the specified node, counts the invocations.
+ */
+struct SourceRejectingFilter : public uavcan::ITransferAcceptanceFilter
+{
+    const uavcan::NodeID rejected;
+    mutable unsigned num_calls;
+
+    explicit SourceRejectingFilter(uavcan::NodeID arg_rejected) : rejected(arg_rejected), num_calls(0) { }
+
+    virtual bool shouldAcceptFrame(const uavcan::RxFrame& frame) const
+    {
+        num_calls++;
+        return frame.getSrcNodeID() != rejected;
+    }
+};
+
+TEST(TransferListener, AcceptanceFilter)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    NullAllocator poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener<256, 2, 2, uavcan::TransferListenerWithFilter> subscriber(perf, type, poolmgr);
+
+    SourceRejectingFilter filter(2);
+    subscriber.installAcceptanceFilter(&filter);
+
+    TransferListenerEmulator emulator(subscriber, type);
+    const Transfer transfers[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "Accepted multi-frame transfer"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "Rejected multi-frame transfer"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "SFT"),
+    };
+    const unsigned num_accepted_frames = unsigned(serializeTransfer(transfers[0]).size());
+    ASSERT_LT(2, num_accepted_frames);
+    ASSERT_LT(2, serializeTransfer(transfers[1]).size());
+
+    emulator.send(transfers);
+
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[2]));
+    ASSERT_TRUE(subscriber.matchAndPop(transfers[0]));
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    // Every frame of the accepted transfers, but only the first frame of the rejected one
+    ASSERT_EQ(num_accepted_frames + 2, filter.num_calls);
+    ASSERT_EQ(0, perf.getErrorCount());
+}
+
+
 TEST(TransferListener, Cleanup)
 {
     const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
@@ -223,6 +643,141 @@ TEST(TransferListener, Cleanup)
 }
 
 
+TEST(TransferListener, ReceiverRetention)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    NullAllocator poolmgr;
+    uavcan::TransferPerfCounter perf;
+    TestListener<256, 1, 2> subscriber(perf, type, poolmgr);
+    uavcan::TransferListenerBase& base = subscriber;
+
+    SystemClockMock clock;
+    uavcan::DataTypeStats stats;
+    subscriber.setDataTypeStats(&stats, &clock);
+
+    ASSERT_EQ(uavcan::TransferReceiver::DefaultTidTimeoutMSec, subscriber.getReceiverRetention().toMSec());
+
+    /*
+     * By default, the receiver of a source that publishes every 3 seconds is recreated for every transfer
+     */
+    uint64_t ts = 10000;
+    for (uint8_t tid = 0; tid < 3; tid++)
+    {
+        subscriber.handleFrame(makeSingleFrame(type, ts, 10, tid, 0, 3000000));
+        base.cleanup(tsMono(ts + 2900000));
+    }
+    ASSERT_EQ(3, perf.getRxTransferCount());
+    ASSERT_EQ(3, stats.receivers_created);
+    ASSERT_EQ(3, stats.receivers_removed);
+
+    /*
+     * With longer retention, the receiver is kept as long as the source keeps publishing at its usual rate
+     */
+    stats.resetCounters();
+    subscriber.setReceiverRetention(uavcan::MonotonicDuration::fromMSec(60000));
+    for (uint8_t tid = 3; tid < 10; tid++)
+    {
+        subscriber.handleFrame(makeSingleFrame(type, ts, 10, tid, 0, 3000000));
+        base.cleanup(tsMono(ts + 2900000));
+    }
+    ASSERT_EQ(10, perf.getRxTransferCount());
+    ASSERT_EQ(1, stats.receivers_created);
+    ASSERT_EQ(0, stats.receivers_removed);
+    ASSERT_EQ(0, perf.getErrorCount());
+
+    base.cleanup(tsMono(ts + 7000000));                 // Still within a few transfer intervals
+    ASSERT_EQ(0, stats.receivers_removed);
+    base.cleanup(tsMono(ts + 20000000));                // The source went silent
+    ASSERT_EQ(1, stats.receivers_removed);
+}
+
+TEST(TransferListener, ManySources)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 128, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    TestListener<8, 0, 2> subscriber(perf, type, pool);   // Most receivers will be allocated in the pool
+
+    static const uint8_t NumSources = 100;
+
+    TransferListenerEmulator emulator(subscriber, type);
+
+    /*
+     * Every source publishes once
+     */
+    std::vector<Transfer> first_round;
+    for (uint8_t i = 1; i <= NumSources; i++)
+    {
+        first_round.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, i, "abc"));
+    }
+    emulator.send(&first_round[0], unsigned(first_round.size()));
+    for (unsigned i = 0; i < first_round.size(); i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(first_round[i]));
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_LT(0, pool.getNumUsedBlocks());
+
+    /*
+     * Only even sources publish again, much later
+     */
+    std::vector<Transfer> second_round;
+    for (uint8_t i = 2; i <= NumSources; i = uint8_t(i + 2))
+    {
+        second_round.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, i, "def"));
+        second_round.back().ts_monotonic += uavcan::MonotonicDuration::fromMSec(3000);
+    }
+    emulator.send(&second_round[0], unsigned(second_round.size()));
+    for (unsigned i = 0; i < second_round.size(); i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(second_round[i]));
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    /*
+     * Odd receivers are timed out; removal makes the map relocate the remaining entries
+     */
+    const uavcan::MonotonicTime cleanup_ts = second_round.back().ts_monotonic + uavcan::MonotonicDuration::fromMSec(500);
+    static_cast<uavcan::TransferListenerBase&>(subscriber).cleanup(cleanup_ts);
+
+    /*
+     * Repeated transfers from the even sources must be rejected by their receivers
+     */
+    for (unsigned i = 0; i < second_round.size(); i++)
+    {
+        second_round[i].ts_monotonic = cleanup_ts;
+    }
+    emulator.send(&second_round[0], unsigned(second_round.size()));
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    /*
+     * New transfers from all sources are accepted
+     */
+    std::vector<Transfer> third_round;
+    for (uint8_t i = 1; i <= NumSources; i++)
+    {
+        third_round.push_back(emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, i, "ghi"));
+        third_round.back().ts_monotonic = cleanup_ts + uavcan::MonotonicDuration::fromUSec(i);
+        if (i % 2 == 0)
+        {
+            third_round.back().transfer_id = second_round[i / 2 - 1].transfer_id;   // Next TID for this source
+            third_round.back().transfer_id.increment();
+        }
+    }
+    emulator.send(&third_round[0], unsigned(third_round.size()));
+    for (unsigned i = 0; i < third_round.size(); i++)
+    {
+        ASSERT_TRUE(subscriber.matchAndPop(third_round[i]));
+    }
+    ASSERT_TRUE(subscriber.isEmpty());
+
+    static_cast<uavcan::TransferListenerBase&>(subscriber).cleanup(cleanup_ts + uavcan::MonotonicDuration::fromMSec(5000));
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+
 TEST(TransferListener, AnonymousTransfers)
 {
     const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
@@ -257,9 +812,134 @@ TEST(TransferListener, AnonymousTransfers)
     ASSERT_TRUE(subscriber.isEmpty());
 }
 
+TEST(TransferListener, StaticOnly)
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 32, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    TestListener<64, 1, 2, uavcan::StaticTransferListener> subscriber(perf, type, pool);
+
+    TransferListenerEmulator emulator(subscriber, type);
+
+    /*
+     * Three sources, two receivers - the third source is dropped
+     */
+    const Transfer sft[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "123"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "456"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "789")
+    };
+    emulator.send(sft);
+
+    ASSERT_TRUE(subscriber.matchAndPop(sft[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(sft[1]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(1, subscriber.getReceiverOverflowCount());
+    ASSERT_EQ(0, subscriber.getBufferOverflowCount());
+
+    /*
+     * Two concurrent multi-frame transfers, one buffer - the second transfer is dropped
+     */
+    const Transfer mft[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "123456789abcdefghik"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abcdefghik123456789")
+    };
+    emulator.send(mft);
+
+    ASSERT_TRUE(subscriber.matchAndPop(mft[0]));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_LT(0, subscriber.getBufferOverflowCount());
+
+    /*
+     * The buffer is free again, so the next transfer from the second source is accepted
+     */
+    Transfer mft_retry = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "abcdefghik123456789");
+    mft_retry.ts_monotonic += uavcan::MonotonicDuration::fromMSec(100);
+    const uint32_t buffer_overflows = subscriber.getBufferOverflowCount();
+    emulator.send(&mft_retry, 1);
+
+    ASSERT_TRUE(subscriber.matchAndPop(mft_retry));
+    ASSERT_EQ(buffer_overflows, subscriber.getBufferOverflowCount());
+
+    /*
+     * The pool has never been touched
+     */
+    ASSERT_EQ(0, pool.getPeakNumUsedBlocks());
+}
+
+TEST(TransferListener, RuntimeCapacity)
+{
+    typedef TestListener<64, 0, 0, uavcan::RuntimeCapacityTransferListener> Listener;
+
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+
+    /*
+     * Storage of two receivers and one buffer; the block is misaligned deliberately. It must outlive the listener.
+     */
+    const unsigned storage_size = Listener::getStorageSize(2, 1);
+    std::vector<uint8_t> storage(storage_size + 1);
+
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 32, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    Listener subscriber(perf, type, pool);
+
+    TransferListenerEmulator emulator(subscriber, type);
+
+    ASSERT_GT(storage_size, Listener::getStorageSize(2, 0));
+    ASSERT_EQ(Listener::getStorageSize(1, 1), Listener::getStorageSize(1, 5));   // No more buffers than receivers
+
+    ASSERT_EQ(-uavcan::ErrInvalidParam, subscriber.setCapacity(2, 1, &storage[1], storage_size - 1));
+    ASSERT_EQ(0, subscriber.getNumStaticReceivers());
+    ASSERT_EQ(0, subscriber.setCapacity(2, 1, &storage[1], storage_size));
+    ASSERT_EQ(2, subscriber.getNumStaticReceivers());
+    ASSERT_EQ(1, subscriber.getNumStaticBuffers());
+
+    /*
+     * Two sources and one multi-frame transfer are served without the pool
+     */
+    const Transfer sft[] =
+    {
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "123"),
+        emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 2, "456")
+    };
+    emulator.send(sft);
+    ASSERT_TRUE(subscriber.matchAndPop(sft[0]));
+    ASSERT_TRUE(subscriber.matchAndPop(sft[1]));
+
+    Transfer mft = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 1, "123456789abcdefghik");
+    mft.ts_monotonic += uavcan::MonotonicDuration::fromMSec(100);
+    emulator.send(&mft, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(mft));
+    ASSERT_TRUE(subscriber.isEmpty());
+    ASSERT_EQ(0, pool.getPeakNumUsedBlocks());
+
+    /*
+     * The capacity can't be changed while the listener holds the state of the sources
+     */
+    ASSERT_EQ(-uavcan::ErrLogic, subscriber.setCapacity(0, 0, NULL, 0));
+
+    /*
+     * The third source falls back to the pool
+     */
+    const Transfer sft3 = emulator.makeTransfer(16, uavcan::TransferTypeMessageBroadcast, 3, "789");
+    emulator.send(&sft3, 1);
+    ASSERT_TRUE(subscriber.matchAndPop(sft3));
+    ASSERT_LT(0, pool.getPeakNumUsedBlocks());
+
+    /*
+     * Single-frame listeners need no buffers
+     */
+    typedef TestListener<0, 0, 0, uavcan::RuntimeCapacityTransferListener> SingleFrameListener;
+    ASSERT_EQ(SingleFrameListener::getStorageSize(3, 0), SingleFrameListener::getStorageSize(3, 3));
+}
+
 TEST(TransferListener, Sizes)
 {
     using namespace uavcan;
 
     std::cout << "sizeof(TransferListener<64, 1, 2>): " << sizeof(TransferListener<64, 1, 2>) << std::endl;
+    std::cout << "sizeof(StaticTransferListener<64, 1, 2>): " << sizeof(StaticTransferListener<64, 1, 2>) << std::endl;
 }
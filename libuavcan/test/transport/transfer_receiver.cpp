@@ -315,11 +315,43 @@ TEST(TransferReceiver, OutOfOrderFrames)
     ASSERT_TRUE(matchBufferContent(bufmgr.access(gen.bufmgr_key), "34567qwertyuabcd"));
     ASSERT_EQ(0x3231, rcv.getLastTransferCrc());
 
+    // Rejected frames must not affect the computed CRC
+    uavcan::TransferCRC crc;
+    crc.add(reinterpret_cast<const uint8_t*>("34567qwertyuabcd"), 16);
+    ASSERT_EQ(crc.get(), rcv.getLastTransferComputedCrc());
+
     ASSERT_EQ(3, rcv.yieldErrorCount());
     ASSERT_EQ(0, rcv.yieldErrorCount());
 }
 
 
+TEST(TransferReceiver, IncrementalCrc)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+
+    uavcan::TransferCRC crc_base;
+    crc_base.add(reinterpret_cast<const uint8_t*>("signature"), 9);
+
+    uavcan::TransferCRC expected = crc_base;
+    expected.add(reinterpret_cast<const uint8_t*>("34567qwertyuabcd"), 16);
+
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 0, 1000), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwertyu", SET001, 0, 1100), bk, crc_base));
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET010, 0, 1200), bk, crc_base));
+    ASSERT_EQ(expected.get(), rcv.getLastTransferComputedCrc());
+
+    // Interrupted transfer followed by a new one - the computation must start over
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 1, 2000), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567", SET100, 2, 2100), bk, crc_base));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwertyu", SET001, 2, 2200), bk, crc_base));
+    CHECK_COMPLETE(    rcv.addFrame(gen(1, "abcd",    SET010, 2, 2300), bk, crc_base));
+    ASSERT_EQ(expected.get(), rcv.getLastTransferComputedCrc());
+}
+
+
 TEST(TransferReceiver, IntervalMeasurement)
 {
     Context<32> context;
@@ -398,6 +430,48 @@ TEST(TransferReceiver, Restart)
 }
 
 
+TEST(TransferReceiver, EarliestArrival)
+{
+    Context<32> context;
+    RxFrameGenerator gen(789);
+    uavcan::TransferReceiver& rcv = context.receiver;
+    uavcan::ITransferBufferManager& bufmgr = context.bufmgr;
+    uavcan::TransferBufferAccessor bk(context.bufmgr, RxFrameGenerator::DEFAULT_KEY);
+    const uavcan::TransferCRC crc;
+
+    /*
+     * Every transfer is duplicated on both ifaces; each one is accepted from the iface that delivers it first
+     * Args: iface_index, data, set, transfer_id, ts_monotonic
+     */
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "qwe", SET110, 0, 1000), bk, crc, false, true));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwe", SET110, 0, 1100), bk, crc, false, true));
+
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(1, "qwe", SET110, 1, 2000), bk, crc, false, true));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "qwe", SET110, 1, 2100), bk, crc, false, true));
+
+    /*
+     * Multi-frame transfer, the slower iface catches up in the middle - its frames are ignored
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "\x34\x12" "34567", SET100, 2, 3000), bk, crc, false, true));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "\x34\x12" "34567", SET100, 2, 3050), bk, crc, false, true));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(0, "1234567",          SET001, 2, 3100), bk, crc, false, true));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "1234567",          SET001, 2, 3150), bk, crc, false, true));
+    CHECK_COMPLETE(    rcv.addFrame(gen(0, "foo",              SET010, 2, 3200), bk, crc, false, true));
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "foo",              SET010, 2, 3250), bk, crc, false, true));
+
+    ASSERT_TRUE(matchBufferContent(bufmgr.access(gen.bufmgr_key), "345671234567foo"));
+    ASSERT_EQ(0x1234, rcv.getLastTransferCrc());
+
+    /*
+     * Without the option, the receiver sticks to the last iface
+     */
+    CHECK_NOT_COMPLETE(rcv.addFrame(gen(1, "qwe", SET110, 3, 4000), bk));
+    CHECK_SINGLE_FRAME(rcv.addFrame(gen(0, "qwe", SET110, 3, 4100), bk));
+
+    ASSERT_EQ(0, rcv.yieldErrorCount());
+}
+
+
 TEST(TransferReceiver, UtcTransferTimestamping)
 {
     Context<32> context;
@@ -3,10 +3,13 @@
  */
 
 #include <algorithm>
+#include <queue>
+#include <vector>
 #include <gtest/gtest.h>
 #include "transfer_test_helpers.hpp"
 #include "can/can.hpp"
 #include <uavcan/transport/transfer_sender.hpp>
+#include <uavcan/marshal/bit_stream.hpp>
 
 static int sendOne(uavcan::TransferSender& sender, const std::string& data,
                    uint64_t monotonic_tx_deadline, uint64_t monotonic_blocking_deadline,
@@ -270,3 +273,405 @@ TEST(TransferSender, PassiveMode)
     EXPECT_EQ(1, dispatcher.getTransferPerfCounter().getTxTransferCount());
     EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getRxTransferCount());
 }
+
+#if !UAVCAN_TINY
+TEST(TransferSender, FrameRateLimit)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    uavcan::TransferSender sender(dispatcher, makeDataType(uavcan::DataTypeKindMessage, 123),
+                                  uavcan::CanTxQueue::Volatile);
+
+    static const uint8_t Payload[60] = {};
+
+    const uavcan::MonotonicTime txdl = tsMono(1000000);
+    const uavcan::MonotonicTime bldl;
+    const uavcan::TransferType tt = uavcan::TransferTypeMessageBroadcast;
+    const uavcan::NodeID dst = uavcan::NodeID::Broadcast;
+
+    ASSERT_FALSE(sender.isFrameRateLimited());
+    sender.setFrameRateLimit(1000, 4);              // 1 ms per frame
+    ASSERT_TRUE(sender.isFrameRateLimited());
+
+    // The burst
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_LE(0, sender.send(Payload, 7, txdl, bldl, tt, dst));
+    }
+    ASSERT_EQ(-uavcan::ErrRateLimited, sender.send(Payload, 7, txdl, bldl, tt, dst));
+
+    // Refill
+    clockmock.advance(1000);
+    ASSERT_LE(0, sender.send(Payload, 7, txdl, bldl, tt, dst));
+    ASSERT_EQ(-uavcan::ErrRateLimited, sender.send(Payload, 7, txdl, bldl, tt, dst));
+
+    // Multi frame transfers are accounted per frame: (20 + 2) / 7 = 4 frames
+    clockmock.advance(3000);
+    ASSERT_EQ(-uavcan::ErrRateLimited, sender.send(Payload, 20, txdl, bldl, tt, dst));
+    clockmock.advance(1000);
+    ASSERT_EQ(4, sender.send(Payload, 20, txdl, bldl, tt, dst));
+
+    // Transfer longer than the burst is sent from the full bucket, then the debt is to be paid off
+    clockmock.advance(4000);
+    ASSERT_EQ(9, sender.send(Payload, 60, txdl, bldl, tt, dst));
+    clockmock.advance(5000);
+    ASSERT_EQ(-uavcan::ErrRateLimited, sender.send(Payload, 7, txdl, bldl, tt, dst));
+    clockmock.advance(1000);
+    ASSERT_LE(0, sender.send(Payload, 7, txdl, bldl, tt, dst));
+
+    // The rejected transfers are not errors
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(8, dispatcher.getTransferPerfCounter().getTxTransferCount());
+    EXPECT_EQ(4 + 1 + 4 + 9 + 1, driver.ifaces.at(0).tx.size());
+
+    // Disabled
+    sender.setFrameRateLimit(0, 0);
+    ASSERT_FALSE(sender.isFrameRateLimited());
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_LE(0, sender.send(Payload, 7, txdl, bldl, tt, dst));
+    }
+}
+#endif
+
+/**
+ * Writes the payload through the bit stream in small unaligned chunks, like the generated marshaling code would do.
+ */
+struct BitStreamPayloadEncoder : public uavcan::ITransferPayloadEncoder
+{
+    std::vector<uint8_t> payload;
+
+    virtual int encode(uavcan::ITransferBuffer& buffer) const
+    {
+        uavcan::BitStream bitstream(buffer);
+        const unsigned bitlen = unsigned(payload.size() * 8);
+        unsigned offset = 0;
+        for (unsigned chunk = 3; offset < bitlen; chunk = (chunk % 13) + 3)
+        {
+            const unsigned len = std::min(chunk, bitlen - offset);
+            uint8_t tmp[2] = {};
+            for (unsigned i = 0; i < len; i++)          // MSB first
+            {
+                const unsigned src = offset + i;
+                if (payload[src / 8] & (0x80U >> (src % 8)))
+                {
+                    tmp[i / 8] = uint8_t(tmp[i / 8] | (0x80U >> (i % 8)));
+                }
+            }
+            const int res = bitstream.write(tmp, len);
+            if (res != uavcan::BitStream::ResultOk)
+            {
+                return (res < 0) ? res : -uavcan::ErrLogic;
+            }
+            offset += len;
+        }
+        return 1;
+    }
+};
+
+TEST(TransferSender, StreamingEncoder)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    uavcan::TransferSender sender(dispatcher, makeDataType(uavcan::DataTypeKindService, 42),
+                                  uavcan::CanTxQueue::Persistent);
+
+    /*
+     * The frames must be exactly the same as if the payload was encoded into a buffer beforehand
+     */
+    BitStreamPayloadEncoder encoder;
+    for (unsigned len = 0; len < 100; len++)
+    {
+        encoder.payload.push_back(uint8_t(std::rand()));
+        const uavcan::TransferID tid(uint8_t(len % 32));
+
+        const int num_frames = sender.send(&encoder.payload[0], unsigned(encoder.payload.size()), tsMono(1000),
+                                           uavcan::MonotonicTime(), uavcan::TransferTypeServiceRequest,
+                                           uavcan::NodeID(65), tid);
+        ASSERT_LT(0, num_frames);
+        std::vector<uavcan::CanFrame> reference;
+        while (!driver.ifaces.at(0).tx.empty())
+        {
+            reference.push_back(driver.ifaces.at(0).popTxFrame());
+        }
+
+        ASSERT_EQ(num_frames, sender.send(encoder, tsMono(1000), uavcan::MonotonicTime(),
+                                          uavcan::TransferTypeServiceRequest, uavcan::NodeID(65), tid));
+        ASSERT_EQ(reference.size(), driver.ifaces.at(0).tx.size());
+        for (unsigned i = 0; i < reference.size(); i++)
+        {
+            ASSERT_EQ(reference[i], driver.ifaces.at(0).popTxFrame());
+        }
+    }
+
+    // Automatic TID
+    ASSERT_LT(1, sender.send(encoder, tsMono(1000), uavcan::MonotonicTime(), uavcan::TransferTypeServiceRequest,
+                             uavcan::NodeID(65)));
+
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(201, dispatcher.getTransferPerfCounter().getTxTransferCount());
+
+    // Passive mode - multi frame transfers are not allowed
+    uavcan::Dispatcher passive_dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    uavcan::TransferSender passive_sender(passive_dispatcher, makeDataType(uavcan::DataTypeKindMessage, 42),
+                                          uavcan::CanTxQueue::Volatile);
+    ASSERT_EQ(-uavcan::ErrPassiveMode, passive_sender.send(encoder, tsMono(1000), uavcan::MonotonicTime(),
+                                                           uavcan::TransferTypeMessageBroadcast,
+                                                           uavcan::NodeID::Broadcast));
+}
+
+
+TEST(TransferSender, PreEncoded)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    uavcan::TransferSender sender(dispatcher, makeDataType(uavcan::DataTypeKindMessage, 42),
+                                  uavcan::CanTxQueue::Volatile);
+
+    /*
+     * Given the precomputed CRC, the frames must be exactly the same as if the CRC was computed by the sender
+     */
+    std::vector<uint8_t> payload;
+    for (unsigned len = 1; len < 100; len++)
+    {
+        payload.push_back(uint8_t(std::rand()));
+        const uavcan::TransferID tid(uint8_t(len % 32));
+
+        const int num_frames = sender.send(&payload[0], unsigned(payload.size()), tsMono(1000),
+                                           uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                                           uavcan::NodeID::Broadcast, tid);
+        ASSERT_LT(0, num_frames);
+        std::vector<uavcan::CanFrame> reference;
+        while (!driver.ifaces.at(0).tx.empty())
+        {
+            reference.push_back(driver.ifaces.at(0).popTxFrame());
+        }
+
+        const uint16_t crc = sender.computeTransferCRC(&payload[0], unsigned(payload.size()));
+        ASSERT_EQ(num_frames, sender.sendPreEncoded(&payload[0], unsigned(payload.size()), crc, tsMono(1000),
+                                                    uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                                                    uavcan::NodeID::Broadcast, tid));
+        ASSERT_EQ(reference.size(), driver.ifaces.at(0).tx.size());
+        for (unsigned i = 0; i < reference.size(); i++)
+        {
+            ASSERT_EQ(reference[i], driver.ifaces.at(0).popTxFrame());
+        }
+    }
+
+    // Automatic TID
+    ASSERT_LT(1, sender.sendPreEncoded(&payload[0], unsigned(payload.size()),
+                                       sender.computeTransferCRC(&payload[0], unsigned(payload.size())),
+                                       tsMono(1000), uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                                       uavcan::NodeID::Broadcast));
+
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(199, dispatcher.getTransferPerfCounter().getTxTransferCount());
+}
+
+#if UAVCAN_SUPPORT_CANFD
+
+/**
+ * Doesn't check the timestamps, unlike TestListener<>.
+ */
+struct CanFDTestListener : public uavcan::TransferListener<150, 1, 1>
+{
+    std::queue<std::string> payloads;
+    bool all_canfd;
+
+    CanFDTestListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& data_type,
+                      uavcan::IPoolAllocator& allocator)
+        : uavcan::TransferListener<150, 1, 1>(perf, data_type, allocator)
+        , all_canfd(true)
+    { }
+
+    void handleIncomingTransfer(uavcan::IncomingTransfer& transfer)
+    {
+        payloads.push(Transfer(transfer, getDataTypeDescriptor()).payload);
+        all_canfd = all_canfd && transfer.isCanFD();
+    }
+};
+
+TEST(TransferSender, CanFD)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher_tx(driver, poolmgr, clockmock, out_trans_reg);
+    uavcan::Dispatcher dispatcher_rx(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher_tx.setNodeID(64));
+    ASSERT_TRUE(dispatcher_rx.setNodeID(65));
+
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindMessage, 42);
+    uavcan::TransferSender sender(dispatcher_tx, type, uavcan::CanTxQueue::Volatile);
+    ASSERT_FALSE(sender.isCanFD());
+    sender.setCanFD(true);
+
+    // The padding that doesn't fit the buffer is dropped
+    static const unsigned MaxBufSize = 150;
+    CanFDTestListener listener(dispatcher_rx.getTransferPerfCounter(), type, poolmgr);
+    dispatcher_rx.registerMessageListener(&listener);
+
+    static const unsigned Lengths[] = { 0, 1, 7, 8, 62, 63, 64, 100, 124, 125, 126, 140, 150 };
+    for (unsigned i = 0; i < sizeof(Lengths) / sizeof(Lengths[0]); i++)
+    {
+        std::string payload;
+        for (unsigned k = 0; k < Lengths[i]; k++)
+        {
+            payload.push_back(char('a' + (k % 26)));
+        }
+        const uavcan::TransferID tid(static_cast<uint8_t>(i));
+
+        const int num_frames = sendOne(sender, payload, 1000000, 0, uavcan::TransferTypeMessageBroadcast,
+                                       uavcan::NodeID::Broadcast, tid);
+        ASSERT_EQ((payload.length() <= 63) ? 1 : int((payload.length() + 2 + 62) / 63), num_frames);
+
+        /*
+         * The frames must be exactly the same if the payload is streamed or pre-encoded
+         */
+        std::vector<uavcan::CanFrame> frames;
+        while (!driver.ifaces.at(0).tx.empty())
+        {
+            frames.push_back(driver.ifaces.at(0).popTxFrame());
+            ASSERT_TRUE(frames.back().isCanFD());
+            ASSERT_EQ(uavcan::CanFrame::roundUpDataLength(frames.back().dlc), frames.back().dlc);
+        }
+
+        BitStreamPayloadEncoder encoder;
+        encoder.payload.assign(payload.begin(), payload.end());
+        ASSERT_EQ(num_frames, sender.send(encoder, tsMono(1000000), uavcan::MonotonicTime(),
+                                          uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast, tid));
+        const uint8_t* const raw = reinterpret_cast<const uint8_t*>(payload.c_str());
+        ASSERT_EQ(num_frames, sender.sendPreEncoded(raw, unsigned(payload.length()),
+                                                    sender.computeTransferCRC(raw, unsigned(payload.length())),
+                                                    tsMono(1000000), uavcan::MonotonicTime(),
+                                                    uavcan::TransferTypeMessageBroadcast,
+                                                    uavcan::NodeID::Broadcast, tid));
+        for (unsigned pass = 0; pass < 2; pass++)
+        {
+            for (unsigned k = 0; k < frames.size(); k++)
+            {
+                ASSERT_EQ(frames[k], driver.ifaces.at(0).popTxFrame());
+            }
+        }
+        ASSERT_TRUE(driver.ifaces.at(0).tx.empty());
+
+        /*
+         * Reception - the payload is followed by the zero padding, if it fits
+         */
+        for (unsigned k = 0; k < frames.size(); k++)
+        {
+            driver.ifaces.at(0).pushRx(frames[k]);
+        }
+        while (dispatcher_rx.spin(tsMono(0)) > 0)
+        {
+            clockmock.advance(100);
+        }
+
+        const unsigned padded_len = frames.back().dlc - 1U +
+                                    ((frames.size() > 1) ? (63U * unsigned(frames.size() - 1) - 2U) : 0U);
+        std::string expected = payload;
+        expected.resize(std::min(padded_len, (frames.size() > 1) ? MaxBufSize : padded_len), '\0');
+
+        ASSERT_EQ(1, listener.payloads.size()) << payload.length();
+        ASSERT_EQ(expected, listener.payloads.front()) << payload.length();
+        listener.payloads.pop();
+    }
+    EXPECT_TRUE(listener.all_canfd);
+
+    EXPECT_EQ(0, dispatcher_tx.getTransferPerfCounter().getErrorCount());
+    EXPECT_EQ(0, dispatcher_rx.getTransferPerfCounter().getErrorCount());
+}
+
+#endif
+
+static uavcan::CanFrame compileSingleFrame(uavcan::Frame frame, const std::string& data)
+{
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    (void)frame.setPayload(reinterpret_cast<const uint8_t*>(data.c_str()), unsigned(data.length()));
+    uavcan::CanFrame can_frame;
+    EXPECT_TRUE(frame.compile(can_frame));
+    return can_frame;
+}
+
+TEST(TransferSender, CanIDCache)
+{
+    NullAllocator poolmgr;
+
+    SystemClockMock clockmock(100);
+    CanDriverMock driver(1, clockmock);
+
+    uavcan::OutgoingTransferRegistry<8> out_trans_reg(poolmgr);
+
+    uavcan::Dispatcher dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    ASSERT_TRUE(dispatcher.setNodeID(64));
+
+    const uavcan::DataTypeDescriptor type = makeDataType(uavcan::DataTypeKindService, 42);
+    uavcan::TransferSender sender(dispatcher, type, uavcan::CanTxQueue::Persistent);
+
+    /*
+     * Every change of the header fields must be reflected in the CAN ID
+     */
+    const uavcan::TransferType tts[2] = { uavcan::TransferTypeServiceRequest, uavcan::TransferTypeServiceResponse };
+    const uint8_t dst_node_ids[2] = { 65, 66 };
+    const uint8_t priorities[2] = { 8, 30 };
+    uint8_t tid = 0;
+    for (unsigned i = 0; i < 16; i++)
+    {
+        const uavcan::TransferType tt = tts[i % 2];
+        const uavcan::NodeID dst(dst_node_ids[(i / 2) % 2]);
+        sender.setPriority(priorities[(i / 4) % 2]);
+
+        ASSERT_EQ(1, sendOne(sender, "123", 1000, 0, tt, dst, tid));
+
+        uavcan::Frame frame(type.getID(), tt, 64, dst, tid);
+        frame.setPriority(sender.getPriority());
+        ASSERT_TRUE(driver.ifaces.at(0).matchAndPopTx(compileSingleFrame(frame, "123"), 1000));
+        tid++;
+    }
+
+    // Anonymous frames have the discriminator computed per frame
+    uavcan::Dispatcher passive_dispatcher(driver, poolmgr, clockmock, out_trans_reg);
+    uavcan::TransferSender passive_sender(passive_dispatcher, makeDataType(uavcan::DataTypeKindMessage, 42),
+                                          uavcan::CanTxQueue::Volatile);
+    passive_sender.allowAnonymousTransfers();
+    const std::string payloads[2] = { "abc", "xyz" };
+    for (unsigned i = 0; i < 2; i++)
+    {
+        ASSERT_EQ(1, sendOne(passive_sender, payloads[i], 1000, 0, uavcan::TransferTypeMessageBroadcast,
+                             uavcan::NodeID::Broadcast, 0));
+        const uavcan::Frame frame(42, uavcan::TransferTypeMessageBroadcast, uavcan::NodeID::Broadcast,
+                                  uavcan::NodeID::Broadcast, 0);
+        ASSERT_TRUE(driver.ifaces.at(0).matchAndPopTx(compileSingleFrame(frame, payloads[i]), 1000));
+    }
+
+    EXPECT_EQ(0, dispatcher.getTransferPerfCounter().getErrorCount());
+}
@@ -117,10 +117,11 @@ struct Transfer
  * In reality, uavcan::TransferListener should accept only specific transfer types
  * which are dispatched/filtered by uavcan::Dispatcher.
  */
-template <unsigned MAX_BUF_SIZE, unsigned NUM_STATIC_BUFS, unsigned NUM_STATIC_RECEIVERS>
-class TestListener : public uavcan::TransferListener<MAX_BUF_SIZE, NUM_STATIC_BUFS, NUM_STATIC_RECEIVERS>
+template <unsigned MAX_BUF_SIZE, unsigned NUM_STATIC_BUFS, unsigned NUM_STATIC_RECEIVERS,
+          template <unsigned, unsigned, unsigned> class ListenerTemplate = uavcan::TransferListener>
+class TestListener : public ListenerTemplate<MAX_BUF_SIZE, NUM_STATIC_BUFS, NUM_STATIC_RECEIVERS>
 {
-    typedef uavcan::TransferListener<MAX_BUF_SIZE, NUM_STATIC_BUFS, NUM_STATIC_RECEIVERS> Base;
+    typedef ListenerTemplate<MAX_BUF_SIZE, NUM_STATIC_BUFS, NUM_STATIC_RECEIVERS> Base;
 
     std::queue<Transfer> transfers_;
 
@@ -166,7 +167,7 @@ public:
         return res;
     }
 
-    int getNumReceivedTransfers() const { return transfers_.size(); }
+    int getNumReceivedTransfers() const { return static_cast<int>(transfers_.size()); }
     bool isEmpty() const { return transfers_.empty(); }
 };
 
@@ -176,7 +177,7 @@ namespace
 
 std::vector<uavcan::RxFrame> serializeTransfer(const Transfer& transfer)
 {
-    const bool need_crc = transfer.payload.length() > (sizeof(uavcan::CanFrame::data) - 1);
+    const bool need_crc = transfer.payload.length() > (uavcan::CanFrame::MaxClassicDataLen - 1U);
 
     std::vector<uint8_t> raw_payload;
     if (need_crc)
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/util/event_trace.hpp>
+
+
+typedef uavcan::EventTraceImpl<4> SmallEventTrace;
+
+TEST(EventTrace, RingBuffer)
+{
+    SmallEventTrace::reset();
+
+    const SmallEventTrace::Buffer& buf = SmallEventTrace::getBuffer();
+    ASSERT_EQ(unsigned(SmallEventTrace::Magic), buf.magic);
+    ASSERT_EQ(4, buf.capacity);
+    ASSERT_EQ(8, buf.record_size);
+    ASSERT_EQ(0, SmallEventTrace::getSize());
+    ASSERT_FALSE(SmallEventTrace::getRecord(0));
+
+    SmallEventTrace::record(uavcan::EventTraceCanTxQueuePush, 1);
+    SmallEventTrace::record(uavcan::EventTraceCanTxQueuePeek, 2);
+    ASSERT_EQ(2, SmallEventTrace::getSize());
+    ASSERT_EQ(uavcan::EventTraceCanTxQueuePush, SmallEventTrace::getRecord(0)->event_id);
+    ASSERT_EQ(1, SmallEventTrace::getRecord(0)->arg);
+    ASSERT_EQ(uavcan::EventTraceCanTxQueuePeek, SmallEventTrace::getRecord(1)->event_id);
+    ASSERT_EQ(2, SmallEventTrace::getRecord(1)->arg);
+    ASSERT_FALSE(SmallEventTrace::getRecord(2));
+
+    // Overwriting the oldest records
+    for (uavcan::uint16_t i = 10; i < 15; i++)
+    {
+        SmallEventTrace::record(uavcan::EventTraceTransferReceiverAddFrame, i);
+    }
+    ASSERT_EQ(7, buf.num_recorded);
+    ASSERT_EQ(4, SmallEventTrace::getSize());
+    for (unsigned i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(uavcan::EventTraceTransferReceiverAddFrame, SmallEventTrace::getRecord(i)->event_id);
+        ASSERT_EQ(11 + i, SmallEventTrace::getRecord(i)->arg);
+    }
+    ASSERT_FALSE(SmallEventTrace::getRecord(4));
+
+    SmallEventTrace::reset();
+    ASSERT_EQ(0, SmallEventTrace::getSize());
+    ASSERT_EQ(unsigned(SmallEventTrace::Magic), buf.magic);
+}
+
+TEST(EventTrace, Scope)
+{
+    SmallEventTrace::reset();
+    {
+        uavcan::EventTraceScope<SmallEventTrace> scope(uavcan::EventTraceSchedulerSpinBegin, 42);
+        ASSERT_EQ(1, SmallEventTrace::getSize());
+    }
+    ASSERT_EQ(2, SmallEventTrace::getSize());
+    ASSERT_EQ(uavcan::EventTraceSchedulerSpinBegin, SmallEventTrace::getRecord(0)->event_id);
+    ASSERT_EQ(uavcan::EventTraceSchedulerSpinEnd, SmallEventTrace::getRecord(1)->event_id);
+    ASSERT_EQ(42, SmallEventTrace::getRecord(1)->arg);
+}
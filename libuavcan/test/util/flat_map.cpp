@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <gtest/gtest.h>
+#include <uavcan/util/flat_map.hpp>
+
+
+static bool oddKeyPredicate(const short& key, const short&)
+{
+    return key & 1;
+}
+
+struct ValueFindPredicate
+{
+    const short target;
+    ValueFindPredicate(short target) : target(target) { }
+    bool operator()(const short&, const short& value) const { return value == target; }
+};
+
+
+TEST(FlatMap, Basic)
+{
+    using uavcan::FlatMap;
+
+    static const int POOL_BLOCKS = 3;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    typedef FlatMap<short, short, 2> MapType;
+    std::auto_ptr<MapType> map(new MapType(pool));
+
+    // Empty
+    ASSERT_FALSE(map->access(1));
+    map->remove(8);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    ASSERT_TRUE(map->isEmpty());
+    ASSERT_FALSE(map->getByIndex(0));
+    ASSERT_FALSE(map->getByIndex(10000));
+
+    // Static insertion, out of order
+    ASSERT_EQ(20, *map->insert(2, 20));
+    ASSERT_EQ(10, *map->insert(1, 10));
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    ASSERT_EQ(2, map->getNumStaticPairs());
+    ASSERT_EQ(0, map->getNumDynamicPairs());
+
+    // Ordering is by key
+    ASSERT_TRUE(map->getByIndex(0)->match(1));
+    ASSERT_TRUE(map->getByIndex(1)->match(2));
+
+    // Dynamic insertion; the lowest key pushes the greatest static one into the pool
+    ASSERT_EQ(40, *map->insert(4, 40));
+    ASSERT_EQ(5, *map->insert(-5, 5));
+    ASSERT_EQ(1, pool.getNumUsedBlocks());
+    ASSERT_EQ(2, map->getNumStaticPairs());
+    ASSERT_EQ(2, map->getNumDynamicPairs());
+
+    ASSERT_EQ(5, *map->access(-5));
+    ASSERT_EQ(10, *map->access(1));
+    ASSERT_EQ(20, *map->access(2));
+    ASSERT_EQ(40, *map->access(4));
+    ASSERT_FALSE(map->access(3));
+    ASSERT_FALSE(map->access(100));
+
+    ASSERT_TRUE(map->getByIndex(0)->match(-5));
+    ASSERT_TRUE(map->getByIndex(1)->match(1));
+    ASSERT_TRUE(map->getByIndex(2)->match(2));
+    ASSERT_TRUE(map->getByIndex(3)->match(4));
+    ASSERT_FALSE(map->getByIndex(4));
+
+    // Replacing
+    ASSERT_EQ(22, *map->insert(2, 22));
+    ASSERT_EQ(4, map->getSize());
+    ASSERT_EQ(2, *map->find(ValueFindPredicate(22)));
+    ASSERT_FALSE(map->find(ValueFindPredicate(20)));
+
+    // Removing a static one - the lowest dynamic one migrates to the static storage
+    map->remove(-5);
+    map->remove(8);
+    ASSERT_EQ(2, map->getNumStaticPairs());
+    ASSERT_EQ(1, map->getNumDynamicPairs());
+    ASSERT_TRUE(map->getByIndex(0)->match(1));
+    ASSERT_TRUE(map->getByIndex(1)->match(2));
+    ASSERT_TRUE(map->getByIndex(2)->match(4));
+
+    map->remove(1);
+    ASSERT_EQ(2, map->getNumStaticPairs());
+    ASSERT_EQ(0, map->getNumDynamicPairs());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+
+    // Filling up until OOM, descending, so that the segments get split
+    short min_key = 0;
+    for (short i = 1000; i > 0; i--)
+    {
+        short* res = map->insert(i, i);
+        if (res == NULL)
+        {
+            break;
+        }
+        ASSERT_EQ(i, *res);
+        min_key = i;
+    }
+    ASSERT_LT(10, 1000 - min_key);
+    ASSERT_EQ(0, pool.getNumFreeBlocks());
+
+    // Failed insertion leaves the map intact; there still may be room in the segment where the key goes
+    const short extra_keys[] = { -1, 2000, short(min_key - 2), 500 };
+    for (unsigned i = 0; i < sizeof(extra_keys) / sizeof(extra_keys[0]); i++)
+    {
+        const unsigned size = map->getSize();
+        if (map->insert(extra_keys[i], 0) == NULL)
+        {
+            ASSERT_EQ(size, map->getSize());
+            ASSERT_FALSE(map->access(extra_keys[i]));
+        }
+        else
+        {
+            ASSERT_EQ(size + 1, map->getSize());
+        }
+    }
+    for (short i = 1000; i >= min_key; i--)
+    {
+        ASSERT_TRUE(map->access(i));
+    }
+
+    // Removing odd keys
+    map->removeAllWhere(oddKeyPredicate);
+    ASSERT_EQ(2, map->getNumStaticPairs());
+    for (short i = 1000; i >= min_key; i--)
+    {
+        ASSERT_EQ((i & 1) == 0, map->access(i) != NULL);
+    }
+    for (unsigned i = 1; i < map->getSize(); i++)
+    {
+        ASSERT_TRUE(map->getByIndex(i - 1)->key < map->getByIndex(i)->key);
+    }
+
+    // Making sure the memory will be released
+    map.reset();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+
+TEST(FlatMap, NoStatic)
+{
+    using uavcan::FlatMap;
+
+    static const int POOL_BLOCKS = 3;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    typedef FlatMap<short, short> MapType;
+    std::auto_ptr<MapType> map(new MapType(pool));
+
+    ASSERT_FALSE(map->access(1));
+    map->remove(8);
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+    ASSERT_FALSE(map->getByIndex(0));
+
+    ASSERT_EQ(20, *map->insert(2, 20));
+    ASSERT_EQ(10, *map->insert(1, 10));
+    ASSERT_EQ(1, pool.getNumUsedBlocks());
+    ASSERT_EQ(0, map->getNumStaticPairs());
+    ASSERT_EQ(2, map->getNumDynamicPairs());
+
+    ASSERT_TRUE(map->getByIndex(0)->match(1));
+    ASSERT_TRUE(map->getByIndex(1)->match(2));
+    ASSERT_FALSE(map->getByIndex(3));
+
+    map->clear();
+    ASSERT_TRUE(map->isEmpty());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
+
+
+TEST(FlatMap, PrimitiveKeyRandomized)
+{
+    using uavcan::FlatMap;
+
+    static const int POOL_BLOCKS = 64;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    typedef FlatMap<short, short, 5> MapType;
+    std::auto_ptr<MapType> map(new MapType(pool));
+    std::map<short, short> reference;
+
+    std::srand(42);
+    for (int iteration = 0; iteration < 20000; iteration++)
+    {
+        // coverity[dont_call]
+        const short key = short(1 + std::rand() % 200);
+        // coverity[dont_call]
+        if ((std::rand() % 3) != 0)
+        {
+            short* const res = map->insert(key, short(iteration));
+            ASSERT_TRUE(res);
+            ASSERT_EQ(short(iteration), *res);
+            reference[key] = short(iteration);
+        }
+        else
+        {
+            map->remove(key);
+            reference.erase(key);
+        }
+
+        if ((iteration % 1000) == 999)
+        {
+            map->removeAllWhere(oddKeyPredicate);
+            for (short k = 1; k <= 200; k += 2)
+            {
+                reference.erase(k);
+            }
+        }
+
+        ASSERT_EQ(reference.size(), map->getSize());
+        if (map->getSize() > 5)
+        {
+            ASSERT_EQ(5, map->getNumStaticPairs());
+        }
+    }
+
+    // Contents and ordering
+    unsigned index = 0;
+    for (std::map<short, short>::const_iterator it = reference.begin(); it != reference.end(); ++it, index++)
+    {
+        ASSERT_EQ(it->second, *map->access(it->first));
+        ASSERT_TRUE(map->getByIndex(index)->match(it->first));
+    }
+    ASSERT_FALSE(map->getByIndex(index));
+
+    map.reset();
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <gtest/gtest.h>
+#include <uavcan/util/latency_histogram.hpp>
+
+
+TEST(LatencyHistogram, Basic)
+{
+    uavcan::LatencyHistogram hist;
+    ASSERT_EQ(0, hist.getNumSamples());
+    ASSERT_EQ(0, hist.computePercentileUSec(50));
+
+    hist.add(uavcan::MonotonicDuration::fromUSec(0));
+    hist.add(uavcan::MonotonicDuration::fromUSec(-100));           // Clock adjustment, counted as zero
+    hist.add(uavcan::MonotonicDuration::fromUSec(1));
+    hist.add(uavcan::MonotonicDuration::fromUSec(3));
+    hist.add(uavcan::MonotonicDuration::fromUSec(4));
+    hist.add(uavcan::MonotonicDuration::fromUSec(1000));
+    ASSERT_EQ(6, hist.getNumSamples());
+    ASSERT_EQ(2, hist.bins[0]);
+    ASSERT_EQ(1, hist.bins[1]);
+    ASSERT_EQ(1, hist.bins[2]);                                     // [2, 4)
+    ASSERT_EQ(1, hist.bins[3]);                                     // [4, 8)
+    ASSERT_EQ(1, hist.bins[10]);                                    // [512, 1024)
+    ASSERT_EQ(1000, hist.max_usec);
+
+    // Everything from 16384 usec up goes into the last bin
+    hist.add(uavcan::MonotonicDuration::fromMSec(17));
+    hist.add(uavcan::MonotonicDuration::fromMSec(100000000));
+    ASSERT_EQ(2, hist.bins[uavcan::LatencyHistogram::NumBins - 1]);
+    ASSERT_EQ(0xFFFFFFFFU, hist.max_usec);
+
+    hist.reset();
+    ASSERT_EQ(0, hist.getNumSamples());
+    ASSERT_EQ(0, hist.max_usec);
+}
+
+TEST(LatencyHistogram, Percentiles)
+{
+    ASSERT_EQ(1, uavcan::LatencyHistogram::getBinUpperBoundUSec(0));
+    ASSERT_EQ(1024, uavcan::LatencyHistogram::getBinUpperBoundUSec(10));
+    ASSERT_EQ(0xFFFFFFFFU, uavcan::LatencyHistogram::getBinUpperBoundUSec(uavcan::LatencyHistogram::NumBins - 1));
+
+    uavcan::LatencyHistogram hist;
+    for (int i = 0; i < 90; i++)
+    {
+        hist.add(uavcan::MonotonicDuration::fromUSec(100));         // [64, 128)
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        hist.add(uavcan::MonotonicDuration::fromUSec(5000));        // [4096, 8192)
+    }
+
+    ASSERT_EQ(128, hist.computePercentileUSec(0));
+    ASSERT_EQ(128, hist.computePercentileUSec(50));
+    ASSERT_EQ(128, hist.computePercentileUSec(90));
+    ASSERT_EQ(5000, hist.computePercentileUSec(91));                // Limited by the maximum
+    ASSERT_EQ(5000, hist.computePercentileUSec(100));
+    ASSERT_EQ(5000, hist.computePercentileUSec(1000));
+}
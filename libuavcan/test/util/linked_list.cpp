@@ -2,6 +2,7 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <vector>
 #include <gtest/gtest.h>
 #include <uavcan/util/linked_list.hpp>
 
@@ -139,3 +140,169 @@ TEST(LinkedList, Sorting)
         item = item->getNextListNode();
     }
 }
+
+TEST(LinkedList, InsertAfter)
+{
+    uavcan::LinkedListRoot<ListItem> root;
+    ListItem items[] = {0, 1, 2, 3};
+
+    root.insertAfter(NULL, items + 1);          // Empty list
+    root.insertAfter(NULL, items + 0);          // Beginning
+    root.insertAfter(items + 1, items + 3);     // End
+    root.insertAfter(items + 1, items + 2);     // Middle
+    EXPECT_EQ(4, root.getLength());
+
+    const ListItem* item = root.get();
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(item);
+        EXPECT_EQ(i, item->value);
+        item = item->getNextListNode();
+    }
+    EXPECT_FALSE(item);
+}
+
+TEST(LinkedList, Contains)
+{
+    uavcan::LinkedListRoot<ListItem> root;
+    ListItem items[] = {0, 1};
+
+    EXPECT_FALSE(root.contains(items + 0));
+    root.insert(items + 0);
+    EXPECT_TRUE(root.contains(items + 0));
+    EXPECT_FALSE(root.contains(items + 1));
+    root.remove(items + 0);
+    EXPECT_FALSE(root.contains(items + 0));
+}
+
+
+struct DoublyListItem : uavcan::DoublyLinkedListNode<DoublyListItem>
+{
+    int value;
+
+    DoublyListItem(int value = 0)
+        : value(value)
+    { }
+};
+
+/**
+ * Checks the back links and returns the values in the list order.
+ */
+static std::vector<int> collectValues(const uavcan::DoublyLinkedListRoot<DoublyListItem>& root)
+{
+    std::vector<int> values;
+    const DoublyListItem* prev = NULL;
+    for (const DoublyListItem* p = root.get(); p != NULL; p = p->getNextListNode())
+    {
+        EXPECT_EQ(prev, p->getPrevListNode());
+        EXPECT_TRUE(root.contains(p));
+        values.push_back(p->value);
+        prev = p;
+    }
+    EXPECT_EQ(values.size(), root.getLength());
+    return values;
+}
+
+TEST(DoublyLinkedList, Basic)
+{
+    uavcan::DoublyLinkedListRoot<DoublyListItem> root;
+    DoublyListItem items[] = {0, 1, 2, 3};
+
+    EXPECT_TRUE(root.isEmpty());
+    EXPECT_FALSE(root.contains(items + 0));
+    EXPECT_FALSE(root.contains(NULL));
+
+    root.insert(items + 0);
+    root.insert(items + 0);         // Insert twice - second will be ignored
+    EXPECT_EQ(1, root.getLength());
+    EXPECT_TRUE(root.contains(items + 0));
+
+    root.remove(items + 0);
+    root.remove(items + 0);
+    EXPECT_TRUE(root.isEmpty());
+    EXPECT_FALSE(root.contains(items + 0));
+
+    root.insert(items + 0);
+    root.insert(items + 1);
+    root.insert(items + 2);
+    root.insert(items + 3);
+    {
+        const int expected[] = {3, 2, 1, 0};
+        EXPECT_EQ(std::vector<int>(expected, expected + 4), collectValues(root));
+    }
+
+    // Middle, end, beginning
+    root.remove(items + 2);
+    root.remove(items + 0);
+    root.remove(items + 3);
+    root.remove(items + 3);
+    EXPECT_FALSE(root.contains(items + 2));
+    EXPECT_EQ(std::vector<int>(1, 1), collectValues(root));
+
+    // Relocation to the beginning
+    root.insert(items + 2);
+    root.insert(items + 1);
+    {
+        const int expected[] = {1, 2};
+        EXPECT_EQ(std::vector<int>(expected, expected + 2), collectValues(root));
+    }
+
+    root.remove(items + 1);
+    root.remove(items + 2);
+    EXPECT_TRUE(root.isEmpty());
+}
+
+TEST(DoublyLinkedList, Sorting)
+{
+    uavcan::DoublyLinkedListRoot<DoublyListItem> root;
+    DoublyListItem items[] = {0, 1, 2, 3, 4, 5};
+    const int order[] = {2, 2, 3, 0, 4, 1, 1, 5};     // With duplicates
+
+    for (unsigned i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    {
+        DoublyListItem* const item = items + order[i];
+        struct GreaterThan
+        {
+            int value;
+            bool operator()(const DoublyListItem* x) const { return x->value > value; }
+        } predicate = { item->value };
+        root.insertBefore(item, predicate);
+    }
+
+    const int expected[] = {0, 1, 2, 3, 4, 5};
+    EXPECT_EQ(std::vector<int>(expected, expected + 6), collectValues(root));
+}
+
+TEST(DoublyLinkedList, InsertAfter)
+{
+    uavcan::DoublyLinkedListRoot<DoublyListItem> root;
+    DoublyListItem items[] = {0, 1, 2, 3};
+
+    root.insertAfter(NULL, items + 1);          // Empty list
+    root.insertAfter(NULL, items + 0);          // Beginning
+    root.insertAfter(items + 1, items + 3);     // End
+    root.insertAfter(items + 1, items + 2);     // Middle
+
+    const int expected[] = {0, 1, 2, 3};
+    EXPECT_EQ(std::vector<int>(expected, expected + 4), collectValues(root));
+}
+
+TEST(DoublyLinkedList, RemovalDuringTraversal)
+{
+    uavcan::DoublyLinkedListRoot<DoublyListItem> root;
+    DoublyListItem items[] = {0, 1, 2};
+    root.insert(items + 2);
+    root.insert(items + 1);
+    root.insert(items + 0);
+
+    // The removed node keeps the forward link
+    std::vector<int> visited;
+    for (DoublyListItem* p = root.get(); p != NULL; p = p->getNextListNode())
+    {
+        visited.push_back(p->value);
+        root.remove(p);
+    }
+    const int expected[] = {0, 1, 2};
+    EXPECT_EQ(std::vector<int>(expected, expected + 3), visited);
+    EXPECT_TRUE(root.isEmpty());
+}
@@ -300,3 +300,69 @@ TEST(Multiset, NoncopyableWithCounter)
     ASSERT_EQ(0, pool.getNumUsedBlocks());
     ASSERT_EQ(0, NoncopyableWithCounter::num_objects);          // All destroyed
 }
+
+
+static bool isOddByte(const uint8_t& value)
+{
+    return (value & 1U) != 0;
+}
+
+struct ByteFindPredicate
+{
+    const uint8_t target;
+    ByteFindPredicate(uint8_t target) : target(target) { }
+    bool operator()(const uint8_t& value) const { return value == target; }
+};
+
+TEST(Multiset, ManyItems)
+{
+    using uavcan::Multiset;
+
+    static const int POOL_BLOCKS = 64;
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * POOL_BLOCKS, uavcan::MemPoolBlockSize> pool;
+
+    // More static entries than one bitmap can hold, more small items per chunk than one bitmap can hold
+    typedef Multiset<uint8_t, 40> MultisetType;
+    std::auto_ptr<MultisetType> mset(new MultisetType(pool));
+
+    for (unsigned i = 0; i < 200; i++)
+    {
+        ASSERT_EQ(uint8_t(i), *mset->emplace(uint8_t(i)));
+    }
+    ASSERT_EQ(40, mset->getNumStaticItems());
+    ASSERT_EQ(160, mset->getNumDynamicItems());
+    ASSERT_LT(0, pool.getNumUsedBlocks());
+
+    for (unsigned i = 0; i < 40; i++)
+    {
+        ASSERT_EQ(uint8_t(i), *mset->getByIndex(i));           // Static entries are filled in order
+    }
+    for (unsigned i = 0; i < 200; i++)
+    {
+        ASSERT_TRUE(mset->find(ByteFindPredicate(uint8_t(i))));
+    }
+
+    // Removing every other item; the freed slots are reused before new chunks are allocated
+    mset->removeAllWhere(&isOddByte);
+    ASSERT_EQ(100, mset->getSize());
+    ASSERT_FALSE(mset->find(ByteFindPredicate(1)));
+    ASSERT_FALSE(mset->find(ByteFindPredicate(39)));
+    ASSERT_TRUE(mset->find(ByteFindPredicate(38)));
+
+    const unsigned used_blocks = pool.getNumUsedBlocks();
+    for (unsigned i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(mset->emplace(uint8_t(1)));
+    }
+    ASSERT_EQ(used_blocks, pool.getNumUsedBlocks());
+    ASSERT_EQ(200, mset->getSize());
+    ASSERT_EQ(uint8_t(1), *mset->getByIndex(1));               // Lowest free static slot was taken first
+
+    mset->removeAll(uint8_t(1));
+    ASSERT_EQ(100, mset->getSize());
+
+    // Removal of all dynamic items releases the chunks
+    mset->clear();
+    ASSERT_TRUE(mset->isEmpty());
+    ASSERT_EQ(0, pool.getNumUsedBlocks());
+}
@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+#
+# Decoder of the libuavcan event trace dumps, see include/uavcan/util/event_trace.hpp.
+# Supported Python versions: 3.2+, 2.7.
+#
+# The input is a raw binary image of uavcan::EventTrace::getBuffer(). It can be obtained with GDB:
+#   dump binary value trace.bin 'uavcan::EventTraceImpl<256u>::buffer_'
+# or by writing the buffer into a file from the application.
+#
+# Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+#
+
+from __future__ import division, absolute_import, print_function, unicode_literals
+import os, sys, re, struct, argparse
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_HEADER = os.path.join(SCRIPT_DIR, '..', 'include', 'uavcan', 'util', 'event_trace.hpp')
+
+MAGIC = 0x54455655
+BUFFER_HEADER_FORMAT = 'IHHI'
+RECORD_FORMAT = 'IHH'
+
+def die(text):
+    print(text, file=sys.stderr)
+    exit(1)
+
+def read_event_names(header_path):
+    '''Parses the enum EventTraceID, so that the decoder never goes out of sync with the library.'''
+    with open(header_path) as f:
+        text = f.read()
+    body = re.search(r'enum\s+EventTraceID\s*\{(.*?)\};', text, re.DOTALL)
+    if not body:
+        die('EventTraceID is not found in %s' % header_path)
+    names = []
+    for line in body.group(1).splitlines():
+        m = re.match(r'\s*EventTrace(\w+)\s*,', line)
+        if m:
+            names.append(m.group(1))
+    return names
+
+def read_records(path, endian):
+    with open(path, 'rb') as f:
+        data = f.read()
+    header_size = struct.calcsize(endian + BUFFER_HEADER_FORMAT)
+    if len(data) < header_size:
+        die('The dump is too short')
+    magic, capacity, record_size, num_recorded = struct.unpack_from(endian + BUFFER_HEADER_FORMAT, data)
+    if magic != MAGIC:
+        die('Invalid magic 0x%08x; wrong endianness?' % magic)
+    if record_size != struct.calcsize(endian + RECORD_FORMAT):
+        die('Unsupported record size %d' % record_size)
+    if len(data) < header_size + capacity * record_size:
+        die('The dump is truncated: capacity %d, size %d' % (capacity, len(data)))
+    size = min(num_recorded, capacity)
+    records = []
+    for i in range(size):
+        index = (num_recorded - size + i) % capacity
+        records.append(struct.unpack_from(endian + RECORD_FORMAT, data, header_size + index * record_size))
+    return records, num_recorded
+
+def format_ticks(ticks, ticks_per_usec):
+    if ticks_per_usec:
+        return '%.3f us' % (ticks / ticks_per_usec)
+    return '%d' % ticks
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes the libuavcan event trace dumps')
+    parser.add_argument('dump', help='binary dump of the event trace buffer')
+    parser.add_argument('--header', default=DEFAULT_HEADER, help='path to event_trace.hpp')
+    parser.add_argument('--freq', type=float, default=0,
+                        help='timestamp frequency in MHz, e.g. the CPU clock; the ticks are printed if not set')
+    parser.add_argument('--big-endian', action='store_true', help='the dump comes from a big endian target')
+    parser.add_argument('--summary', action='store_true', help='print only the durations of the paired events')
+    args = parser.parse_args()
+
+    names = read_event_names(args.header)
+    records, num_recorded = read_records(args.dump, '>' if args.big_endian else '<')
+    print('%d records, %d events lost' % (len(records), num_recorded - len(records)))
+
+    open_scopes = {}        # Begin event ID -> start timestamp; the scopes of the same kind are not nested
+    durations = {}          # Event name -> list of durations in ticks
+    prev_ts = records[0][0] if records else 0
+    for ts, event_id, arg in records:
+        name = names[event_id] if event_id < len(names) else 'Unknown%d' % event_id
+        delta = (ts - prev_ts) & 0xFFFFFFFF
+        prev_ts = ts
+        extra = ''
+        if name.endswith('Begin'):
+            open_scopes[event_id] = ts
+        elif name.endswith('End') and (event_id - 1) in open_scopes:
+            duration = (ts - open_scopes.pop(event_id - 1)) & 0xFFFFFFFF
+            durations.setdefault(name[:-3], []).append(duration)
+            extra = '  duration %s' % format_ticks(duration, args.freq)
+        if not args.summary:
+            print('%10d  +%-12s %-28s %5d%s' % (ts, format_ticks(delta, args.freq), name, arg, extra))
+
+    if durations:
+        print('%-28s %8s %14s %14s %14s' % ('Scope', 'Count', 'Min', 'Avg', 'Max'))
+        for name in sorted(durations):
+            d = durations[name]
+            print('%-28s %8d %14s %14s %14s' % (name, len(d), format_ticks(min(d), args.freq),
+                                                format_ticks(sum(d) // len(d), args.freq),
+                                                format_ticks(max(d), args.freq)))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+#include "debug.hpp"
+
+static uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::NodeID nid,
+                                      const std::string& name)
+{
+    auto node = uavcan_linux::makeNode(ifaces);
+    node->setNodeID(nid);
+    node->setName(name.c_str());
+    ENFORCE(0 == node->start());
+    node->setModeOperational();
+    return node;
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <node-id> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "Two nodes will be started: <node-id> and <node-id> + 1" << std::endl;
+            return 1;
+        }
+        const int self_node_id = std::stoi(argv[1]);
+        std::vector<std::string> iface_names;
+        for (int i = 2; i < argc; i++)
+        {
+            iface_names.emplace_back(argv[i]);
+        }
+
+        auto client_node = initNode(iface_names, self_node_id, "org.uavcan.linux_test_async_client");
+        auto server_node = initNode(iface_names, self_node_id + 1, "org.uavcan.linux_test_async_server");
+
+        uavcan_linux::NodeThread client_thread(*client_node);
+        uavcan_linux::NodeThread server_thread(*server_node);
+
+        uavcan_linux::AsyncServiceClient<uavcan::protocol::GetNodeInfo> client(client_thread);
+
+        /*
+         * Several threads issue concurrent calls through the same client.
+         * The total number of calls in flight must not exceed the range of the Transfer ID.
+         */
+        const unsigned NumThreads = 3;
+        const unsigned NumCallsPerThread = 5;
+        std::vector<std::thread> threads;
+        std::atomic<unsigned> num_successful(0);
+        for (unsigned i = 0; i < NumThreads; i++)
+        {
+            threads.emplace_back([&]()
+            {
+                std::vector<std::future<uavcan_linux::AsyncServiceCallResult<uavcan::protocol::GetNodeInfo>>> fut;
+                for (unsigned k = 0; k < NumCallsPerThread; k++)
+                {
+                    fut.push_back(client.call(self_node_id + 1, uavcan::protocol::GetNodeInfo::Request()));
+                }
+                for (auto& f : fut)
+                {
+                    const auto res = f.get();
+                    if (res.successful && (res.response.name == "org.uavcan.linux_test_async_server"))
+                    {
+                        num_successful++;
+                    }
+                }
+            });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        std::cout << "Successful calls: " << num_successful << " of " << (NumThreads * NumCallsPerThread) << std::endl;
+        ENFORCE(num_successful == NumThreads * NumCallsPerThread);
+        ENFORCE(client.getNumPendingCalls() == 0);
+
+        /*
+         * Timeout
+         */
+        const auto res = client.call(127, uavcan::protocol::GetNodeInfo::Request()).get();
+        ENFORCE(!res.successful);
+        ENFORCE(client_thread.getLastSpinError() == 0);
+        ENFORCE(server_thread.getLastSpinError() == 0);
+
+        std::cout << "Test passed" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan_linux/coroutines.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include "debug.hpp"
+
+static uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::NodeID nid,
+                                      const std::string& name)
+{
+    auto node = uavcan_linux::makeNode(ifaces);
+    node->setNodeID(nid);
+    node->setName(name.c_str());
+    ENFORCE(0 == node->start());
+    node->setModeOperational();
+    return node;
+}
+
+/**
+ * A multi-step procedure written sequentially: wait for the remote node to appear, query it, wait a bit,
+ * then make sure that a call to a nonexistent node times out.
+ */
+static uavcan_linux::CoTask runProcedure(uavcan::INode& node, uavcan::NodeID remote_node_id)
+{
+    uavcan_linux::CoSubscriber<uavcan::protocol::NodeStatus> status_sub(node);
+    uavcan_linux::CoServiceClient<uavcan::protocol::GetNodeInfo> client(node);
+
+    std::cout << "Waiting for NodeStatus..." << std::endl;
+    unsigned num_status_messages = 0;
+    while (num_status_messages < 3)
+    {
+        const uavcan::protocol::NodeStatus status = co_await status_sub.next();
+        std::cout << "NodeStatus: uptime " << status.uptime_sec << std::endl;
+        num_status_messages++;
+    }
+
+    const auto info = co_await client.call(remote_node_id, uavcan::protocol::GetNodeInfo::Request());
+    ENFORCE(info.successful);
+    std::cout << info.response << std::endl;
+
+    const auto started_at = node.getMonotonicTime();
+    co_await uavcan_linux::sleep(node, uavcan::MonotonicDuration::fromMSec(100));
+    ENFORCE((node.getMonotonicTime() - started_at).toMSec() >= 100);
+
+    const auto timed_out = co_await client.call(127, uavcan::protocol::GetNodeInfo::Request());
+    ENFORCE(!timed_out.successful);
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <node-id> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "Two nodes will be started: <node-id> and <node-id> + 1" << std::endl;
+            return 1;
+        }
+        const int self_node_id = std::stoi(argv[1]);
+        std::vector<std::string> iface_names;
+        for (int i = 2; i < argc; i++)
+        {
+            iface_names.emplace_back(argv[i]);
+        }
+
+        auto node = initNode(iface_names, self_node_id, "org.uavcan.linux_test_coroutines");
+        auto remote_node = initNode(iface_names, self_node_id + 1, "org.uavcan.linux_test_coroutines_remote");
+
+        auto task = runProcedure(*node, self_node_id + 1);
+        while (!task.isDone())
+        {
+            ENFORCE(0 <= node->spin(uavcan::MonotonicDuration::fromMSec(5)));
+            ENFORCE(0 <= remote_node->spin(uavcan::MonotonicDuration::fromMSec(5)));
+        }
+        task.rethrowIfFailed();
+
+        std::cout << "Test passed" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -16,6 +16,7 @@
 // UAVCAN POSIX drivers
 #include <uavcan_posix/basic_file_server_backend.hpp>
 #include <uavcan_posix/firmware_version_checker.hpp>  // Compilability test
+#include <uavcan_posix/delta_firmware_server_backend.hpp>  // Compilability test
 
 namespace
 {
@@ -48,7 +49,7 @@ uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::N
 
 void runForever(const uavcan_linux::NodePtr& node)
 {
-    uavcan_posix::BasicFileSeverBackend backend(*node);
+    uavcan_posix::BasicFileSeverBackend backend(*node, 32);    // 128 KB read cache
 
     uavcan::FileServer server(*node, backend);
 
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+constexpr unsigned NumThreads = 4;
+constexpr unsigned NumIterations = 200000;
+constexpr unsigned BlocksPerThread = 8;
+
+typedef uavcan_linux::ConcurrentPoolAllocator<NumThreads * BlocksPerThread * uavcan::MemPoolBlockSize> Allocator;
+
+/**
+ * Every thread allocates a few blocks, fills them with its own pattern, verifies the pattern and releases them.
+ * If two threads ever get the same block, the pattern check will fail.
+ */
+void hammer(Allocator& allocator, std::uint8_t pattern, bool& ok)
+{
+    void* blocks[BlocksPerThread] = {};
+
+    for (unsigned iter = 0; iter < NumIterations; iter++)
+    {
+        const unsigned num = 1 + (iter % BlocksPerThread);
+        for (unsigned i = 0; i < num; i++)
+        {
+            blocks[i] = allocator.allocate(uavcan::MemPoolBlockSize);
+            if (blocks[i] == nullptr)
+            {
+                ok = false;
+                return;
+            }
+            std::memset(blocks[i], pattern, uavcan::MemPoolBlockSize);
+        }
+        for (unsigned i = 0; i < num; i++)
+        {
+            const std::uint8_t* const p = static_cast<const std::uint8_t*>(blocks[i]);
+            for (unsigned k = 0; k < uavcan::MemPoolBlockSize; k++)
+            {
+                if (p[k] != pattern)
+                {
+                    ok = false;
+                }
+            }
+            allocator.deallocate(blocks[i]);
+        }
+    }
+}
+
+void testSingleThreaded()
+{
+    uavcan_linux::ConcurrentPoolAllocator<uavcan::MemPoolBlockSize * 2> allocator;
+    ENFORCE(allocator.getNumBlocks() == 2);
+    ENFORCE(allocator.allocate(uavcan::MemPoolBlockSize + 1) == nullptr);
+
+    void* const a = allocator.allocate(1);
+    void* const b = allocator.allocate(1);
+    ENFORCE(a != nullptr && b != nullptr && a != b);
+    ENFORCE(allocator.allocate(1) == nullptr);
+    ENFORCE(allocator.getNumFailures() == 1);
+    ENFORCE(allocator.getNumUsedBlocks() == 2);
+    ENFORCE(allocator.getNumFreeBlocks() == 0);
+
+    allocator.deallocate(a);
+    ENFORCE(allocator.allocate(1) == a);
+    allocator.deallocate(b);
+    allocator.deallocate(a);
+    allocator.deallocate(nullptr);
+    ENFORCE(allocator.getNumUsedBlocks() == 0);
+    ENFORCE(allocator.getPeakNumUsedBlocks() == 2);
+    ENFORCE(allocator.getNumContentions() == 0);
+}
+
+void testMultiThreaded()
+{
+    static Allocator allocator;
+    bool ok[NumThreads] = {};
+
+    const auto started_at = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < NumThreads; i++)
+    {
+        ok[i] = true;
+        threads.emplace_back(hammer, std::ref(allocator), std::uint8_t(0x10 + i), std::ref(ok[i]));
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                               started_at);
+    for (bool x : ok)
+    {
+        ENFORCE(x);
+    }
+    ENFORCE(allocator.getNumUsedBlocks() == 0);
+    ENFORCE(allocator.getNumFailures() == 0);
+
+    std::cout << "Threads: " << NumThreads << ", "
+              << "elapsed: " << elapsed.count() << " ms, "
+              << "peak blocks: " << allocator.getPeakNumUsedBlocks() << "/" << allocator.getNumBlocks() << ", "
+              << "contentions: " << allocator.getNumContentions() << std::endl;
+}
+
+}
+
+int main()
+{
+    try
+    {
+        testSingleThreaded();
+        testMultiThreaded();
+        std::cout << "OK" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
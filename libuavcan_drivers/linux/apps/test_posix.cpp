@@ -3,10 +3,13 @@
  */
 
 #include <uavcan_posix/dynamic_node_id_server/file_event_tracer.hpp>
+#include <uavcan_posix/dynamic_node_id_server/binary_file_event_tracer.hpp>
 #include <uavcan_posix/dynamic_node_id_server/file_storage_backend.hpp>
+#include <uavcan_posix/dynamic_node_id_server/journal_storage_backend.hpp>
 #include <uavcan_linux/uavcan_linux.hpp>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include "debug.hpp"
 
 int main(int argc, const char** argv)
@@ -40,6 +43,55 @@ int main(int argc, const char** argv)
             ENFORCE(0 == std::system(("cat " + event_log_file).c_str()));
         }
 
+        /*
+         * Binary event tracer test
+         */
+        {
+            using namespace uavcan::dynamic_node_id_server;
+            typedef uavcan_posix::dynamic_node_id_server::BinaryFileEventTracer Tracer;
+
+            const std::string event_log_file("/tmp/uavcan_posix/dynamic_node_id_server/event.bin");
+
+            {
+                Tracer tracer;
+                ENFORCE(0 <= tracer.init(event_log_file.c_str(), 60000));
+
+                static_cast<IEventTracer&>(tracer).onEvent(TraceError, 123456);
+                static_cast<IEventTracer&>(tracer).onEvent(TraceRaftVoteRequestReceived, -789123);
+                ENFORCE(0 == std::system(("test $(stat -c %s " + event_log_file + ") -eq 16").c_str()));   // Buffered
+
+                ENFORCE(0 == tracer.flush());
+                ENFORCE(0 == std::system(("test $(stat -c %s " + event_log_file + ") -eq 56").c_str()));
+
+                for (int i = 0; i < 1000; i++)
+                {
+                    static_cast<IEventTracer&>(tracer).onEvent(TraceError, i);
+                }
+                ENFORCE(0 == tracer.getNumLostEvents());
+            }                                                   // Flushed on destruction
+
+            std::ifstream in(event_log_file, std::ios::binary);
+            std::uint8_t header[Tracer::HeaderSize];
+            ENFORCE(in.read(reinterpret_cast<char*>(header), sizeof(header)));
+            ENFORCE(Tracer::decodeHeader(header));
+
+            std::uint8_t raw[Tracer::RecordSize];
+            ENFORCE(in.read(reinterpret_cast<char*>(raw), sizeof(raw)));
+            ENFORCE(Tracer::decodeRecord(raw).code == TraceError);
+            ENFORCE(Tracer::decodeRecord(raw).argument == 123456);
+            ENFORCE(in.read(reinterpret_cast<char*>(raw), sizeof(raw)));
+            ENFORCE(Tracer::decodeRecord(raw).code == TraceRaftVoteRequestReceived);
+            ENFORCE(Tracer::decodeRecord(raw).argument == -789123);
+
+            unsigned num_records = 2;
+            while (in.read(reinterpret_cast<char*>(raw), sizeof(raw)))
+            {
+                ENFORCE(Tracer::decodeRecord(raw).argument == num_records - 2);
+                num_records++;
+            }
+            ENFORCE(num_records == 1002);
+        }
+
         /*
          * Storage backend test
          */
@@ -63,6 +115,145 @@ int main(int argc, const char** argv)
             print_key("nonexistent");
         }
 
+        /*
+         * Journal storage backend test
+         */
+        {
+            using namespace uavcan::dynamic_node_id_server;
+            typedef uavcan_posix::dynamic_node_id_server::JournalStorageBackend Backend;
+
+            const std::string journal_dir("/tmp/uavcan_posix/dynamic_node_id_server/journal");
+            const std::string journal_file(journal_dir + "/journal");
+            ENFORCE(0 == std::system(("rm -rf " + journal_dir).c_str()));
+
+            const auto get = [](Backend& backend, const std::string& key) {
+                return std::string(static_cast<IStorageBackend&>(backend).get(key.c_str()).c_str());
+            };
+            const auto set = [](Backend& backend, const std::string& key, const std::string& value) {
+                static_cast<IStorageBackend&>(backend).set(key.c_str(), value.c_str());
+            };
+            const auto get_file_size = [&journal_file]() {
+                std::ifstream in(journal_file, std::ios::binary | std::ios::ate);
+                return static_cast<long>(in.tellg());
+            };
+            const auto make_long_value = [](unsigned x) {    // Full length values make the records long
+                const std::string digits = std::to_string(x);
+                return std::string(IStorageBackend::MaxStringLength - digits.size(), '0') + digits;
+            };
+            const auto count_records = [&journal_file]() {
+                std::ifstream in(journal_file);
+                unsigned num_records = 0;
+                std::string line;
+                while (std::getline(in, line))
+                {
+                    num_records++;
+                }
+                return num_records;
+            };
+
+            // Round trip across re-initialization
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                ENFORCE(get(backend, "foobar").empty());
+                set(backend, "foobar", "0123456789abcdef0123456789abcdef");
+                set(backend, "the_answer", "42");
+                set(backend, "the_answer", "43");
+                ENFORCE(get(backend, "the_answer") == "43");
+            }
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                ENFORCE(get(backend, "foobar") == "0123456789abcdef0123456789abcdef");
+                ENFORCE(get(backend, "the_answer") == "43");
+                ENFORCE(get(backend, "nonexistent").empty());
+            }
+            ENFORCE(count_records() == 3);
+
+            // Garbled and torn records at the end are discarded, new records are appended after the valid part
+            const long valid_size = get_file_size();
+            {
+                std::ofstream out(journal_file, std::ios::binary | std::ios::app);
+                out << "the_answer 44 0000\n";                  // Bad CRC
+                out << "foobar 012345";                         // Torn by a power loss
+            }
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                ENFORCE(get_file_size() == valid_size);
+                ENFORCE(get(backend, "the_answer") == "43");
+                ENFORCE(get(backend, "foobar") == "0123456789abcdef0123456789abcdef");
+                set(backend, "after_torn_tail", "1");
+            }
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                ENFORCE(get(backend, "after_torn_tail") == "1");
+                ENFORCE(count_records() == 4);
+
+                // Deleting a key with an empty value
+                set(backend, "after_torn_tail", "");
+                ENFORCE(get(backend, "after_torn_tail").empty());
+            }
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                ENFORCE(get(backend, "after_torn_tail").empty());
+                ENFORCE(get(backend, "the_answer") == "43");
+            }
+
+            // A batch that doesn't fit into the write buffer is written in chunks and committed once finished
+            const unsigned batch_size = 3 * Backend::WriteBufferSize / Backend::MaxRecordLength;
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                const long size_before_batch = get_file_size();
+                {
+                    StorageBatch batch(backend);
+                    for (unsigned i = 0; i < batch_size; i++)
+                    {
+                        set(backend, "batch" + std::to_string(i), make_long_value(i));
+                    }
+                    ENFORCE(get_file_size() > size_before_batch);
+                    ENFORCE(get(backend, "batch0") == make_long_value(0));
+                }
+            }
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                for (unsigned i = 0; i < batch_size; i++)
+                {
+                    ENFORCE(get(backend, "batch" + std::to_string(i)) == make_long_value(i));
+                }
+            }
+            const unsigned num_live_keys = 2 + batch_size;      // foobar, the_answer, batch*
+
+            // Too many obsolete records make the journal compacted; it must remain writeable afterwards
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                {
+                    StorageBatch batch(backend);
+                    for (unsigned i = 0; i <= Backend::MaxObsoleteRecords; i++)
+                    {
+                        set(backend, "the_answer", std::to_string(i));
+                    }
+                }
+                ENFORCE(count_records() == num_live_keys);
+                set(backend, "after_compaction", "1");
+                ENFORCE(count_records() == num_live_keys + 1);
+            }
+            {
+                Backend backend;
+                ENFORCE(0 <= backend.init(journal_dir.c_str()));
+                ENFORCE(get(backend, "the_answer") == std::to_string(unsigned(Backend::MaxObsoleteRecords)));
+                ENFORCE(get(backend, "foobar") == "0123456789abcdef0123456789abcdef");
+                ENFORCE(get(backend, "batch1") == make_long_value(1));
+                ENFORCE(get(backend, "after_compaction") == "1");
+            }
+            std::cout << "Journal storage backend: OK" << std::endl;
+        }
+
         return 0;
     }
     catch (const std::exception& ex)
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <unistd.h>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * Runs a node in a 1 kHz loop with the real-time settings applied and prints the observed scheduling latency
+ * and page faults. SCHED_FIFO, memory locking and busy polling are requested only if running as root.
+ */
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name-1> [can-iface-name-N...]" << std::endl;
+            return 1;
+        }
+        const std::vector<std::string> iface_names(argv + 1, argv + argc);
+
+        auto node = uavcan_linux::makeNode(iface_names);
+        node->setNodeID(127);
+        node->setName("org.uavcan.linux_test_realtime");
+
+        const bool privileged = ::geteuid() == 0;
+        uavcan_linux::RealtimeConfig config;
+        config.cpu = 0;
+        config.lock_memory = privileged;
+        config.fifo_priority = privileged ? 50 : 0;
+        config.busy_poll_usec = privileged ? 50 : 0;
+        uavcan_linux::applyRealtimeConfig(*node, config);
+
+        ENFORCE(0 == node->start());
+        node->setModeOperational();
+
+        uavcan_linux::RealtimeSpinner<uavcan_linux::Node> spinner(*node, uavcan::MonotonicDuration::fromMSec(1));
+        spinner.spin(uavcan::MonotonicDuration::fromMSec(100));     // Warm-up
+        spinner.resetStatistics();
+
+        for (int i = 0; i < 5; i++)
+        {
+            spinner.spin(uavcan::MonotonicDuration::fromMSec(1000));
+            const auto& stats = spinner.getStatistics();
+            std::cout << "cycles: " << stats.num_cycles
+                      << "  overruns: " << stats.num_overruns
+                      << "  latency avg/max, usec: " << stats.getAverageLatencyNSec() / 1000U
+                      << "/" << stats.latency_max_nsec / 1000U
+                      << "  page faults minor/major: " << stats.minor_page_faults
+                      << "/" << stats.major_page_faults << std::endl;
+            ENFORCE(stats.num_spin_errors == 0);
+        }
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
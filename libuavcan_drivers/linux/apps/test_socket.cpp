@@ -5,9 +5,33 @@
 #include <iostream>
 #include <vector>
 #include <cerrno>
+#include <cstdlib>
+#include <new>
 #include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan_linux/socketcan_io_uring.hpp>
 #include "debug.hpp"
 
+/*
+ * Counts every heap allocation made by the process, see testSteadyStateAllocations()
+ */
+static std::uint64_t g_num_heap_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    g_num_heap_allocations++;
+    void* const ptr = std::malloc((size > 0) ? size : 1);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
 static uavcan::CanFrame makeFrame(std::uint32_t id, const std::string& data)
 {
     return uavcan::CanFrame(id, reinterpret_cast<const std::uint8_t*>(data.c_str()), data.length());
@@ -104,6 +128,9 @@ static void testSocketRxTx(const std::string& iface_name)
     ENFORCE(!if1.hasPendingTx());
     ENFORCE(!if1.hasReadyRx());
 
+    ENFORCE(if1.getRxTimestampSource() != uavcan_linux::RxTimestampSource::Unknown);
+    std::cout << "RX timestamp source: " << int(if1.getRxTimestampSource()) << std::endl;
+
     /*
      * Read second
      */
@@ -211,6 +238,56 @@ static void testSocketFilters(const std::string& iface_name)
     ENFORCE(!if2.hasReadyRx());
 }
 
+static void testSteadyStateAllocations(const std::string& iface_name)
+{
+    const int sock1 = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    const int sock2 = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    ENFORCE(sock1 >= 0 && sock2 >= 0);
+
+    const uavcan_linux::SystemClock clock;
+    uavcan_linux::SocketCanIface if1(clock, sock1);
+    uavcan_linux::SocketCanIface if2(clock, sock2);
+
+    const auto errors_before = if1.getErrorCount() + if2.getErrorCount();
+    const auto allocations_before = g_num_heap_allocations;
+
+    uavcan::CanRxFrame rx_frames[8];
+    uavcan::CanIOFlags rx_flags[8] = {};
+    unsigned num_received = 0;
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        const std::uint8_t data[2] = { std::uint8_t(i), std::uint8_t(i >> 8) };
+        const uavcan::CanFrame frame(i | uavcan::CanFrame::FlagEFF, data, sizeof(data));
+        ENFORCE(1 == if1.send(frame, tsMonoOffsetMs(100), (i % 2) ? uavcan::CanIOFlagLoopback : 0));
+        while (if1.hasPendingTx())
+        {
+            if1.poll(true, true);
+        }
+        if2.poll(true, false);
+        const int res = if2.receiveBatch(rx_frames, rx_flags, 8);
+        ENFORCE(res >= 0);
+        num_received += unsigned(res);
+        uavcan::CanFrame loopback;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+        while (if1.receive(loopback, ts_mono, ts_utc, flags) > 0)
+        {
+            ENFORCE(flags == uavcan::CanIOFlagLoopback);
+        }
+    }
+    num_received += unsigned(if2.receiveBatch(rx_frames, rx_flags, 8));
+
+    const auto num_allocations = g_num_heap_allocations - allocations_before;
+    std::cout << "Heap allocations during TX/RX: " << num_allocations
+              << ", frames received: " << num_received << std::endl;
+
+    ENFORCE(errors_before == if1.getErrorCount() + if2.getErrorCount());
+    ENFORCE(num_allocations == 0);
+}
+
+template <typename Driver>
 static void testDriver(const std::vector<std::string>& iface_names)
 {
     /*
@@ -221,7 +298,7 @@ static void testDriver(const std::vector<std::string>& iface_names)
     clock_impl.adjustUtc(uavcan::UtcDuration::fromMSec(9000000));
     const uavcan_linux::SystemClock& clock = clock_impl;
 
-    uavcan_linux::SocketCanDriver driver(clock);
+    Driver driver(clock);
     for (auto ifn : iface_names)
     {
         std::cout << "Adding iface " << ifn << std::endl;
@@ -351,8 +428,11 @@ int main(int argc, const char** argv)
         testNonexistentIface();
         testSocketRxTx(iface_names[0]);
         testSocketFilters(iface_names[0]);
+        testSteadyStateAllocations(iface_names[0]);
 
-        testDriver(iface_names);
+        testDriver<uavcan_linux::SocketCanDriver>(iface_names);
+        testDriver<uavcan_linux::EpollSocketCanDriver>(iface_names);
+        testDriver<uavcan_linux::IoUringSocketCanDriver>(iface_names);
 
         return 0;
     }
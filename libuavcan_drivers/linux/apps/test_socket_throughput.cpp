@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <ctime>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+/*
+ * Measures how many frames per second a single core can push through a pair of SocketCAN sockets.
+ * Both sockets are served from the same thread, so the figure accounts for TX, loopback and RX processing.
+ * The socket TX queue depth limits the number of frames that can be sent with one system call, hence depth 1
+ * is the same as writing one frame per syscall.
+ */
+namespace
+{
+
+constexpr unsigned NumFrames = 200000;
+constexpr unsigned BurstSize = 64;
+
+double getThreadCpuTimeSec()
+{
+    auto ts = ::timespec();
+    ENFORCE(0 == ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+    return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+}
+
+unsigned drain(uavcan_linux::SocketCanIface& iface)
+{
+    uavcan::CanRxFrame frames[BurstSize];
+    uavcan::CanIOFlags flags[BurstSize];
+    unsigned total = 0;
+    while (true)
+    {
+        const int res = iface.receiveBatch(frames, flags, BurstSize);
+        ENFORCE(res >= 0);
+        if (res == 0)
+        {
+            break;
+        }
+        total += unsigned(res);
+    }
+    return total;
+}
+
+void benchmark(const std::string& iface_name, unsigned socket_tx_queue_depth)
+{
+    const int sock_tx = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    const int sock_rx = uavcan_linux::SocketCanIface::openSocket(iface_name);
+    ENFORCE(sock_tx >= 0 && sock_rx >= 0);
+
+    const uavcan_linux::SystemClock clock;
+    uavcan_linux::SocketCanIface tx(clock, sock_tx, int(socket_tx_queue_depth));
+    uavcan_linux::SocketCanIface rx(clock, sock_rx);
+
+    const std::uint8_t payload[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const auto deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(10000);
+
+    unsigned num_received = 0;
+    const double started_at = getThreadCpuTimeSec();
+
+    for (unsigned i = 0; i < NumFrames; i += BurstSize)
+    {
+        for (unsigned k = 0; k < BurstSize; k++)
+        {
+            const uavcan::CanFrame frame((i + k) | uavcan::CanFrame::FlagEFF, payload, sizeof(payload));
+            ENFORCE(1 == tx.send(frame, deadline, 0));
+        }
+        while (tx.hasPendingTx())
+        {
+            tx.poll(true, true);
+            num_received += drain(rx);
+        }
+        num_received += drain(rx);
+    }
+    num_received += drain(rx);
+
+    const double elapsed = getThreadCpuTimeSec() - started_at;
+
+    ENFORCE(0 == tx.getErrorCount());
+    ENFORCE(0 == rx.getErrorCount());
+
+    std::cout << "Socket TX queue depth " << std::setw(2) << socket_tx_queue_depth << ": "
+              << std::fixed << std::setprecision(0) << (NumFrames / elapsed) << " frames/sec per core, "
+              << "received " << num_received << "/" << NumFrames << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc != 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name>" << std::endl;
+            std::cerr << "A virtual interface should be used, e.g. vcan0" << std::endl;
+            return 1;
+        }
+        for (unsigned depth : { 1U, 4U, 32U })
+        {
+            benchmark(argv[1], depth);
+        }
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <uavcan/transport/transfer_listener.hpp>
+#include <uavcan_linux/transfer_handoff.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+constexpr unsigned NumTransfers = 200000;
+constexpr unsigned NumSources = 8;
+
+typedef uavcan_linux::TransferHandoffQueue<64, 8> Queue;
+
+/**
+ * Records the sequence numbers carried in the payloads; invoked from the worker thread only.
+ */
+class RecordingListener : public uavcan::TransferListener<0, 0, NumSources>
+{
+    void handleIncomingTransfer(uavcan::IncomingTransfer& transfer) override
+    {
+        std::uint8_t buf[4] = {};
+        ENFORCE(transfer.read(0, buf, sizeof(buf)) == int(sizeof(buf)));
+        const unsigned seq = unsigned(buf[0]) | (unsigned(buf[1]) << 8) | (unsigned(buf[2]) << 16) |
+                             (unsigned(buf[3]) << 24);
+        ENFORCE(transfer.getSrcNodeID().get() == (1 + seq % NumSources));
+        ENFORCE((num_received == 0) || (seq > last_seq));
+        last_seq = seq;
+        num_received++;
+
+        if ((seq % 1000) == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));   // Heavy callback
+        }
+    }
+
+public:
+    unsigned num_received = 0;
+    unsigned last_seq = 0;
+
+    RecordingListener(uavcan::TransferPerfCounter& perf, const uavcan::DataTypeDescriptor& type,
+                      uavcan::IPoolAllocator& allocator)
+        : uavcan::TransferListener<0, 0, NumSources>(perf, type, allocator)
+    { }
+};
+
+uavcan::RxFrame makeFrame(unsigned seq)
+{
+    uavcan::Frame frame(123, uavcan::TransferTypeMessageBroadcast, uavcan::NodeID(std::uint8_t(1 + seq % NumSources)),
+                        uavcan::NodeID::Broadcast, uavcan::TransferID(std::uint8_t((seq / NumSources) % 32)));
+    const std::uint8_t payload[4] = { std::uint8_t(seq), std::uint8_t(seq >> 8), std::uint8_t(seq >> 16),
+                                      std::uint8_t(seq >> 24) };
+    (void)frame.setPayload(payload, sizeof(payload));
+    frame.setStartOfTransfer(true);
+    frame.setEndOfTransfer(true);
+    return uavcan::RxFrame(frame, uavcan::MonotonicTime::fromUSec(1000 + seq * 10ULL), uavcan::UtcTime(), 0);
+}
+
+void testHandoff()
+{
+    const uavcan::DataTypeDescriptor type(uavcan::DataTypeKindMessage, 123, uavcan::DataTypeSignature(123456789), "A");
+    uavcan::PoolAllocator<uavcan::MemPoolBlockSize * 32, uavcan::MemPoolBlockSize> pool;
+    uavcan::TransferPerfCounter perf;
+    RecordingListener listener(perf, type, pool);
+
+    static Queue queue;
+    listener.setTransferHandoff(&queue);
+
+    std::atomic<bool> done(false);
+    std::thread worker([&]()
+        {
+            while (!done || !queue.isEmpty())
+            {
+                (void)queue.waitAndProcess(std::chrono::milliseconds(10));
+            }
+        });
+
+    const auto started_at = std::chrono::steady_clock::now();
+    for (unsigned seq = 0; seq < NumTransfers; seq++)
+    {
+        listener.handleFrame(makeFrame(seq));
+        if ((seq % 64) == 0)
+        {
+            std::this_thread::yield();                  // Give the worker a chance to keep up sometimes
+        }
+    }
+    done = true;
+    worker.join();
+    const unsigned num_committed = queue.commitProcessed();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                               started_at);
+
+    ENFORCE(queue.isEmpty());
+    ENFORCE(listener.num_received > 0);
+    ENFORCE((listener.num_received + queue.getNumDropped()) == NumTransfers);
+    ENFORCE(num_committed <= listener.num_received);
+    ENFORCE(queue.commitProcessed() == 0);
+    ENFORCE(perf.getErrorCount() == queue.getNumDropped());
+
+    std::cout << "Transfers: " << NumTransfers << ", "
+              << "received: " << listener.num_received << ", "
+              << "dropped: " << queue.getNumDropped() << ", "
+              << "elapsed: " << elapsed.count() << " ms" << std::endl;
+}
+
+}
+
+int main()
+{
+    try
+    {
+        testHandoff();
+        std::cout << "OK" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
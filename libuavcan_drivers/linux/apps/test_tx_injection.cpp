@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/protocol/debug/KeyValue.hpp>
+#include "debug.hpp"
+
+/*
+ * Several threads publish through one node that is spun by the main thread; a second node receives the messages
+ * and checks that every producer's messages arrive in order. Also reports the latency from the push to the
+ * reception, which includes the wakeup of the spinning thread.
+ */
+namespace
+{
+
+constexpr unsigned NumProducers = 4;
+constexpr unsigned NumMessagesPerProducer = 2000;
+
+typedef uavcan_linux::TxInjectionQueue<64, 64> Queue;
+
+const auto StartedAt = std::chrono::steady_clock::now();
+
+/// Relative to the start, so that it can be carried in a float without loss of precision
+std::int64_t getTimestampUSec()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - StartedAt).count();
+}
+
+void runTest(const std::vector<std::string>& iface_names)
+{
+    auto tx_node = uavcan_linux::makeNode(iface_names);
+    tx_node->setNodeID(127);
+    tx_node->setName("org.uavcan.linux_test_tx_injection_tx");
+
+    auto rx_node = uavcan_linux::makeNode(iface_names);
+    rx_node->setNodeID(126);
+    rx_node->setName("org.uavcan.linux_test_tx_injection_rx");
+
+    unsigned num_received[NumProducers] = {};
+    std::int64_t latency_sum_usec = 0;
+    std::int64_t latency_max_usec = 0;
+    unsigned num_out_of_order = 0;
+
+    auto sub = rx_node->makeSubscriber<uavcan::protocol::debug::KeyValue>(
+        [&](const uavcan::protocol::debug::KeyValue& msg)
+        {
+            const unsigned producer = unsigned(msg.key[0] - 'a');
+            ENFORCE(producer < NumProducers);
+            // The value carries the time of the push, the key carries the sequence number
+            const unsigned seq = unsigned(std::stoul(std::string(msg.key.c_str() + 1)));
+            if (seq != num_received[producer])
+            {
+                num_out_of_order++;
+            }
+            num_received[producer] = seq + 1;
+            const std::int64_t latency = getTimestampUSec() - std::int64_t(msg.value);
+            latency_sum_usec += latency;
+            latency_max_usec = std::max(latency_max_usec, latency);
+        });
+
+    Queue queue(*tx_node);
+    const int channel = queue.addChannel<uavcan::protocol::debug::KeyValue>();
+    ENFORCE(channel >= 0);
+
+    std::atomic<bool> rx_done(false);
+    std::thread rx_thread([&]()
+        {
+            while (!rx_done)
+            {
+                ENFORCE(0 <= rx_node->spin(uavcan::MonotonicDuration::fromMSec(10)));
+            }
+        });
+
+    std::vector<std::thread> producers;
+    for (unsigned p = 0; p < NumProducers; p++)
+    {
+        producers.emplace_back([&queue, channel, p]()
+            {
+                for (unsigned seq = 0; seq < NumMessagesPerProducer; seq++)
+                {
+                    uavcan::protocol::debug::KeyValue msg;
+                    msg.key = (std::string(1, char('a' + p)) + std::to_string(seq)).c_str();
+                    msg.value = float(getTimestampUSec());
+                    while (!queue.publish(channel, msg))
+                    {
+                        std::this_thread::yield();          // Full, the bus is slower than the producers
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            });
+    }
+
+    // The main thread only spins; the producers never touch the node
+    std::atomic<unsigned> num_producers_done(0);
+    std::thread joiner([&]()
+        {
+            for (auto& t : producers)
+            {
+                t.join();
+            }
+            num_producers_done = NumProducers;
+        });
+    while (num_producers_done < NumProducers)
+    {
+        ENFORCE(0 <= tx_node->spin(uavcan::MonotonicDuration::fromMSec(100)));
+    }
+    joiner.join();
+    ENFORCE(0 <= tx_node->spin(uavcan::MonotonicDuration::fromMSec(100)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    rx_done = true;
+    rx_thread.join();
+
+    unsigned total_received = 0;
+    for (unsigned p = 0; p < NumProducers; p++)
+    {
+        total_received += num_received[p];
+    }
+    std::cout << "Published: " << NumProducers * NumMessagesPerProducer << ", "
+              << "received: " << total_received << ", "
+              << "out of order: " << num_out_of_order << ", "
+              << "dropped: " << queue.getNumDropped() << ", "
+              << "TX errors: " << queue.getNumTxErrors() << ", "
+              << "latency avg/max, usec: " << (latency_sum_usec / std::max(total_received, 1U))
+              << "/" << latency_max_usec << std::endl;
+
+    ENFORCE(num_out_of_order == 0);
+    ENFORCE(queue.getNumTxErrors() == 0);
+    ENFORCE(total_received == NumProducers * NumMessagesPerProducer);
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <can-iface-name-1> [can-iface-name-N...]" << std::endl;
+            return 1;
+        }
+        runTest(std::vector<std::string>(argv + 1, argv + argc));
+        std::cout << "OK" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
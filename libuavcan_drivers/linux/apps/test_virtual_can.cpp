@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include <uavcan/node/sub_node.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+uavcan::CanRxFrame makeFrame(std::uint32_t id, std::uint8_t iface_index)
+{
+    uavcan::CanRxFrame frame;
+    frame.id = id | uavcan::CanFrame::FlagEFF;
+    frame.dlc = 8;
+    frame.iface_index = iface_index;
+    return frame;
+}
+
+uavcan::MonotonicTime getDeadline(uavcan::ISystemClock& clock, unsigned msec)
+{
+    return clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(msec);
+}
+
+/**
+ * Stands in for the CAN driver of the main node; counts the transmitted frames.
+ */
+class CountingCanDriver : public uavcan::ICanDriver
+{
+    struct Iface : public uavcan::ICanIface
+    {
+        unsigned num_sent = 0;
+
+        std::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags) override
+        {
+            num_sent++;
+            return 1;
+        }
+        std::int16_t receive(uavcan::CanFrame&, uavcan::MonotonicTime&, uavcan::UtcTime&,
+                             uavcan::CanIOFlags&) override { return 0; }
+        std::int16_t configureFilters(const uavcan::CanFilterConfig*, std::uint16_t) override { return 0; }
+        std::uint16_t getNumFilters() const override { return 0; }
+        std::uint64_t getErrorCount() const override { return 0; }
+    };
+
+    Iface ifaces_[2];
+
+public:
+    unsigned getNumSent(unsigned iface_index) const { return ifaces_[iface_index].num_sent; }
+
+    uavcan::ICanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index < 2) ? &ifaces_[iface_index] : nullptr;
+    }
+    std::uint8_t getNumIfaces() const override { return 2; }
+
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks, const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime) override
+    {
+        inout_masks.read = 0;               // Always ready to write, never ready to read
+        return 2;
+    }
+};
+
+void testSingleThreaded()
+{
+    uavcan_linux::SystemClock clock;
+    uavcan_linux::VirtualCanDriver driver(2, 4);
+    uavcan::ICanDriver& idriver = driver;
+    const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+
+    /*
+     * RX
+     */
+    uavcan::CanSelectMasks masks;
+    masks.read = 3;
+    ENFORCE(0 == idriver.select(masks, pending_tx, uavcan::MonotonicTime()));
+    ENFORCE(masks.read == 0 && masks.write == 0);
+
+    for (std::uint32_t i = 0; i < 5; i++)
+    {
+        driver.handleRxFrame(makeFrame(i, 1), 0);
+    }
+    ENFORCE(idriver.getIface(1)->getErrorCount() == 1);      // The last frame did not fit
+    ENFORCE(idriver.getIface(0)->getErrorCount() == 0);
+
+    masks.read = 3;
+    ENFORCE(1 == idriver.select(masks, pending_tx, uavcan::MonotonicTime()));
+    ENFORCE(masks.read == 2 && masks.write == 0);
+
+    for (std::uint32_t i = 0; i < 4; i++)
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+        ENFORCE(1 == idriver.getIface(1)->receive(frame, ts_mono, ts_utc, flags));
+        ENFORCE(frame.id == (i | uavcan::CanFrame::FlagEFF));
+    }
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+        ENFORCE(0 == idriver.getIface(1)->receive(frame, ts_mono, ts_utc, flags));
+    }
+
+    /*
+     * TX, then timeout in select() because the TX queue is full
+     */
+    const uavcan::CanFrame tx_frame = makeFrame(123, 0);
+    for (unsigned i = 0; i < 4; i++)
+    {
+        ENFORCE(1 == idriver.getIface(0)->send(tx_frame, getDeadline(clock, 1000), 0));
+    }
+    ENFORCE(0 == idriver.getIface(0)->send(tx_frame, getDeadline(clock, 1000), 0));
+
+    masks = uavcan::CanSelectMasks();
+    masks.write = 1;
+    const auto started_at = Clock::now();
+    ENFORCE(0 == idriver.select(masks, pending_tx, getDeadline(clock, 20)));
+    ENFORCE((Clock::now() - started_at) >= std::chrono::milliseconds(15));
+    ENFORCE(masks.write == 0);
+
+    /*
+     * Injection into the main node
+     */
+    CountingCanDriver main_driver;
+    uavcan::SubNode<16384> main_node(main_driver, clock);
+    driver.injectTxFramesInto(main_node);
+    ENFORCE(main_driver.getNumSent(0) == 4);
+    ENFORCE(main_driver.getNumSent(1) == 0);
+
+    masks = uavcan::CanSelectMasks();
+    masks.write = 1;
+    ENFORCE(1 == idriver.select(masks, pending_tx, uavcan::MonotonicTime()));
+    ENFORCE(masks.write == 1);
+}
+
+void testFilters()
+{
+    uavcan_linux::VirtualCanDriver driver(1);
+    uavcan::ICanIface& iface = *static_cast<uavcan::ICanDriver&>(driver).getIface(0);
+
+    const auto receive = [&iface]()
+        {
+            uavcan::CanFrame frame;
+            uavcan::MonotonicTime ts_mono;
+            uavcan::UtcTime ts_utc;
+            uavcan::CanIOFlags flags = 0;
+            return (iface.receive(frame, ts_mono, ts_utc, flags) == 1) ? (frame.id & uavcan::CanFrame::MaskExtID)
+                                                                       : 0xFFFFFFFFU;
+        };
+
+    // Not configured - everything is accepted
+    driver.handleRxFrame(makeFrame(1, 0), 0);
+    ENFORCE(receive() == 1);
+
+    uavcan::CanFilterConfig filters[2];
+    filters[0].id = 0x10 | uavcan::CanFrame::FlagEFF;
+    filters[0].mask = 0xF0 | uavcan::CanFrame::FlagEFF;
+    filters[1].id = 0x200 | uavcan::CanFrame::FlagEFF;
+    filters[1].mask = uavcan::CanFrame::MaskExtID | uavcan::CanFrame::FlagEFF;
+    ENFORCE(0 == iface.configureFilters(filters, 2));
+
+    driver.handleRxFrame(makeFrame(0x1A, 0), 0);
+    driver.handleRxFrame(makeFrame(0x2A, 0), 0);
+    driver.handleRxFrame(makeFrame(0x200, 0), 0);
+    driver.handleRxFrame(makeFrame(0x201, 0), 0);
+    driver.handleRxFrame(makeFrame(0x2A, 0), uavcan::CanIOFlagLoopback);
+    ENFORCE(receive() == 0x1A);
+    ENFORCE(receive() == 0x200);
+    ENFORCE(receive() == 0x2A);
+    ENFORCE(receive() == 0xFFFFFFFFU);
+    ENFORCE(driver.getNumFilteredFrames() == 2);
+    ENFORCE(driver.getNumWakeups() == 0);
+
+    // Empty configuration rejects everything
+    ENFORCE(0 == iface.configureFilters(filters, 0));
+    driver.handleRxFrame(makeFrame(0x1A, 0), 0);
+    ENFORCE(receive() == 0xFFFFFFFFU);
+    ENFORCE(driver.getNumFilteredFrames() == 3);
+}
+
+void testWakeup()
+{
+    uavcan_linux::SystemClock clock;
+    uavcan_linux::VirtualCanDriver driver(1);
+
+    std::atomic<bool> unblocked(false);
+    std::thread sub_thread([&]()
+        {
+            const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+            uavcan::CanSelectMasks masks;
+            masks.read = 1;
+            const auto res = static_cast<uavcan::ICanDriver&>(driver).select(masks, pending_tx,
+                                                                             getDeadline(clock, 5000));
+            unblocked = (res == 1) && (masks.read == 1);
+        });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto started_at = Clock::now();
+    driver.handleRxFrame(makeFrame(1, 0), 0);
+    sub_thread.join();
+
+    ENFORCE(unblocked);
+    ENFORCE((Clock::now() - started_at) < std::chrono::milliseconds(1000));
+    ENFORCE(driver.getNumWakeups() == 1);
+}
+
+/**
+ * The main thread fans out the frames to all sub-nodes, each sub-node thread drains its queue
+ * like the libuavcan IO manager would do.
+ * If the traffic is partitioned, every sub-node accepts only its own share of the CAN IDs via the filters;
+ * the number of sub-nodes must be a power of two then.
+ */
+void benchmark(unsigned num_subnodes, bool partitioned)
+{
+    constexpr unsigned NumFrames = 1000000;
+    constexpr unsigned BatchSize = 32;
+
+    uavcan_linux::SystemClock clock;
+    uavcan_linux::VirtualCanHub hub;
+    std::vector<std::unique_ptr<uavcan_linux::VirtualCanDriver>> drivers;
+    for (unsigned i = 0; i < num_subnodes; i++)
+    {
+        drivers.emplace_back(new uavcan_linux::VirtualCanDriver(1));
+        hub.addDriver(*drivers.back());
+        if (partitioned)
+        {
+            uavcan::CanFilterConfig filter;
+            filter.id = i | uavcan::CanFrame::FlagEFF;
+            filter.mask = (num_subnodes - 1U) | uavcan::CanFrame::FlagEFF;
+            ENFORCE(0 == static_cast<uavcan::ICanDriver&>(*drivers.back()).getIface(0)->configureFilters(&filter, 1));
+        }
+    }
+
+    std::atomic<bool> done(false);
+    std::vector<unsigned> num_received(num_subnodes, 0);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < num_subnodes; i++)
+    {
+        threads.emplace_back([&, i]()
+            {
+                uavcan::ICanDriver& driver = *drivers[i];
+                const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+                uavcan::CanRxFrame frames[BatchSize];
+                uavcan::CanIOFlags flags[BatchSize];
+                while (true)
+                {
+                    uavcan::CanSelectMasks masks;
+                    masks.read = 1;
+                    (void)driver.select(masks, pending_tx, getDeadline(clock, 10));
+                    const int res = driver.getIface(0)->receiveBatch(frames, flags, BatchSize);
+                    if (res > 0)
+                    {
+                        num_received[i] += unsigned(res);
+                    }
+                    else if (done)
+                    {
+                        break;
+                    }
+                }
+            });
+    }
+
+    const auto started_at = Clock::now();
+    for (unsigned i = 0; i < NumFrames; i++)
+    {
+        hub.handleRxFrame(makeFrame(i, 0), 0);
+    }
+    done = true;
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started_at);
+
+    unsigned total_received = 0;
+    std::uint64_t total_dropped = 0;
+    std::uint64_t total_wakeups = 0;
+    for (unsigned i = 0; i < num_subnodes; i++)
+    {
+        const std::uint64_t dropped = static_cast<uavcan::ICanDriver&>(*drivers[i]).getIface(0)->getErrorCount();
+        ENFORCE((num_received[i] + dropped + drivers[i]->getNumFilteredFrames()) == NumFrames);
+        total_received += num_received[i];
+        total_dropped += dropped;
+        total_wakeups += drivers[i]->getNumWakeups();
+    }
+
+    std::cout << "Sub-nodes: " << num_subnodes << (partitioned ? " partitioned" : "") << ", "
+              << "delivered: " << (double(total_received) / double(elapsed.count())) << " Mframes/s, "
+              << "dropped: " << total_dropped << ", "
+              << "wakeups: " << total_wakeups << std::endl;
+}
+
+}
+
+int main()
+{
+    try
+    {
+        testSingleThreaded();
+        testFilters();
+        testWakeup();
+        for (unsigned n : { 1U, 2U, 4U, 8U })
+        {
+            benchmark(n, false);
+            benchmark(n, true);
+        }
+        std::cout << "OK" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <uavcan_linux/clock.hpp>
+#include <uavcan_linux/socketcan.hpp>
+#include <uavcan_linux/frame_log.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+std::atomic<bool> g_stop_requested(false);
+
+void handleSignal(int)
+{
+    g_stop_requested = true;
+}
+
+/**
+ * Records all frames from the specified interfaces until interrupted.
+ * No node is created, so the tool never transmits anything.
+ */
+void runCapture(const std::string& output_path, const std::vector<std::string>& iface_names)
+{
+    uavcan_linux::SystemClock clock;
+    uavcan_linux::SocketCanDriver driver(clock);
+    for (auto ifn : iface_names)
+    {
+        ENFORCE(driver.addIface(ifn) >= 0);
+    }
+
+    uavcan_linux::FrameLogWriter writer(output_path, driver.getNumIfaces());
+
+    const unsigned BatchSize = 64;
+    uavcan::CanRxFrame frames[BatchSize];
+    uavcan::CanIOFlags flags[BatchSize];
+    const uavcan::CanFrame* pending_tx[uavcan::MaxCanIfaces] = {};
+
+    auto last_report_at = clock.getMonotonic();
+    std::uint64_t num_errors = 0;
+
+    while (!g_stop_requested)
+    {
+        uavcan::CanSelectMasks masks;
+        masks.read = std::uint8_t((1U << driver.getNumIfaces()) - 1U);
+        const auto deadline = clock.getMonotonic() + uavcan::MonotonicDuration::fromMSec(100);
+        if (driver.select(masks, pending_tx, deadline) < 0)
+        {
+            num_errors++;
+            continue;
+        }
+
+        for (std::uint8_t i = 0; i < driver.getNumIfaces(); i++)
+        {
+            if ((masks.read & (1U << i)) == 0)
+            {
+                continue;
+            }
+            const int res = driver.getIface(i)->receiveBatch(frames, flags, BatchSize);
+            if (res < 0)
+            {
+                num_errors++;
+                continue;
+            }
+            for (int k = 0; k < res; k++)
+            {
+                frames[k].iface_index = i;
+                writer.append(frames[k], flags[k]);
+            }
+        }
+
+        const auto now = clock.getMonotonic();
+        if ((now - last_report_at).toMSec() >= 1000)
+        {
+            last_report_at = now;
+            std::cerr << "\rFrames: " << writer.getNumRecords() << "  errors: " << num_errors << "    " << std::flush;
+        }
+    }
+
+    writer.flush();
+    std::cerr << "\nCaptured " << writer.getNumRecords() << " frames into " << output_path << std::endl;
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <output-file> <can-iface-name-1> [can-iface-name-N...]\n"
+                      << "Press Ctrl+C to stop the capture." << std::endl;
+            return 1;
+        }
+        std::vector<std::string> iface_names;
+        for (int i = 2; i < argc; i++)
+        {
+            iface_names.emplace_back(argv[i]);
+        }
+
+        (void)std::signal(SIGINT, &handleSignal);
+        (void)std::signal(SIGTERM, &handleSignal);
+
+        runCapture(argv[1], iface_names);
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
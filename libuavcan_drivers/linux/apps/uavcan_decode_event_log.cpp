@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <uavcan_posix/dynamic_node_id_server/binary_file_event_tracer.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+/**
+ * Prints the binary event log as text, one event per line: UTC timestamp, event code, argument, event name.
+ * The first three columns match the format of the text log written by FileEventTracer.
+ */
+void decode(const std::string& path)
+{
+    typedef uavcan_posix::dynamic_node_id_server::BinaryFileEventTracer Tracer;
+
+    std::ifstream in(path, std::ios::binary);
+    ENFORCE(in.good());
+
+    std::uint8_t header[Tracer::HeaderSize];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in.good() || !Tracer::decodeHeader(header))
+    {
+        throw std::runtime_error("Not a binary event log, or unsupported version: " + path);
+    }
+
+    std::uint8_t raw[Tracer::RecordSize];
+    while (in.read(reinterpret_cast<char*>(raw), sizeof(raw)))
+    {
+        const Tracer::Record rec = Tracer::decodeRecord(raw);
+        const bool known = rec.code < uavcan::dynamic_node_id_server::NumTraceCodes;   // Logs of newer versions
+        std::printf("%llu.%06llu\t%d\t%lld\t%s\n",
+                    static_cast<unsigned long long>(rec.utc_usec / 1000000U),
+                    static_cast<unsigned long long>(rec.utc_usec % 1000000U),
+                    static_cast<int>(rec.code),
+                    static_cast<long long>(rec.argument),
+                    known ? uavcan::dynamic_node_id_server::IEventTracer::getEventName(rec.code) : "?");
+    }
+    if (in.gcount() != 0)
+    {
+        std::cerr << "Truncated record at the end of the log ignored" << std::endl;
+    }
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <event-log-file>" << std::endl;
+            return 1;
+        }
+        decode(argv[1]);
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
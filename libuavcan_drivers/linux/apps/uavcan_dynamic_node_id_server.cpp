@@ -10,10 +10,16 @@
 #include <cstdlib>
 #include <cstdio>
 #include <deque>
+#include <vector>
 #include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 #include "debug.hpp"
 // UAVCAN
@@ -22,13 +28,16 @@
 #include <uavcan_linux/uavcan_linux.hpp>
 // UAVCAN POSIX drivers
 #include <uavcan_posix/dynamic_node_id_server/file_storage_backend.hpp>
-#include <uavcan_posix/dynamic_node_id_server/file_event_tracer.hpp>
+#include <uavcan_posix/dynamic_node_id_server/journal_storage_backend.hpp>
+#include <uavcan_posix/dynamic_node_id_server/binary_file_event_tracer.hpp>
 
 namespace
 {
 
 constexpr int MaxNumLastEvents = 30;
 constexpr int MinUpdateInterval = 100;
+constexpr unsigned StorageQueueCapacity = 1024;
+constexpr unsigned EventQueueCapacity = 4096;
 
 uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::NodeID nid, const std::string& name)
 {
@@ -57,7 +66,237 @@ uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::N
 }
 
 
-class EventTracer : public uavcan_posix::dynamic_node_id_server::FileEventTracer
+/**
+ * Background thread that performs the storage writes and appends the event log, so that the node thread does not
+ * wait for the disk. The storage writes are executed in the order of submission; if the storage queue is full,
+ * the node thread waits for the I/O thread to catch up rather than losing data. The event log is best effort:
+ * the events that do not fit into the queue are dropped and counted. The event log is written in the binary format
+ * of BinaryFileEventTracer; use uavcan_decode_event_log to read it.
+ * The queues are flushed when the object is destroyed.
+ */
+class IOThread
+{
+public:
+    typedef uavcan::dynamic_node_id_server::IStorageBackend::String String;
+
+private:
+    struct StorageOperation
+    {
+        enum class Type { Set, BeginBatch, EndBatch };
+
+        Type type;
+        String key;
+        String value;
+    };
+
+    typedef uavcan_posix::dynamic_node_id_server::BinaryFileEventTracer::Record EventRecord;
+
+    uavcan::dynamic_node_id_server::IStorageBackend& backend_;
+    std::mutex backend_mutex_;                  ///< Held by the I/O thread while it is accessing the backend
+    const int event_log_fd_;
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable space_available_;
+    std::deque<StorageOperation> storage_queue_;
+    std::deque<EventRecord> event_queue_;
+    std::uint64_t num_storage_stalls_ = 0;
+    std::uint64_t num_dropped_events_ = 0;
+    bool stop_ = false;
+
+    std::thread thread_;                        ///< Must be the last member
+
+    void enqueueStorageOperation(StorageOperation&& op)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (storage_queue_.size() >= StorageQueueCapacity)
+        {
+            num_storage_stalls_++;
+            space_available_.wait(lock, [this]() { return storage_queue_.size() < StorageQueueCapacity; });
+        }
+        storage_queue_.push_back(std::move(op));
+        work_available_.notify_one();
+    }
+
+    void executeStorageOperations(const std::deque<StorageOperation>& ops)
+    {
+        std::lock_guard<std::mutex> backend_lock(backend_mutex_);
+        for (const auto& op : ops)
+        {
+            switch (op.type)
+            {
+            case StorageOperation::Type::Set:        backend_.set(op.key, op.value); break;
+            case StorageOperation::Type::BeginBatch: backend_.beginBatch();          break;
+            case StorageOperation::Type::EndBatch:   backend_.endBatch();            break;
+            }
+        }
+    }
+
+    void writeEventRecords(const std::deque<EventRecord>& records)
+    {
+        typedef uavcan_posix::dynamic_node_id_server::BinaryFileEventTracer Tracer;
+
+        std::vector<std::uint8_t> data;
+        data.reserve(records.size() * Tracer::RecordSize);
+        for (const auto& r : records)
+        {
+            std::uint8_t raw[Tracer::RecordSize];
+            Tracer::encodeRecord(r, raw);
+            data.insert(data.end(), raw, raw + sizeof(raw));
+        }
+        writeEventLog(data.data(), data.size());
+    }
+
+    void writeEventLog(const std::uint8_t* data, std::size_t size)
+    {
+        std::size_t offset = 0;
+        while (offset < size)
+        {
+            const ssize_t res = ::write(event_log_fd_, data + offset, size - offset);
+            if (res <= 0)
+            {
+                break;                                  // Nothing can be done about it here
+            }
+            offset += std::size_t(res);
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            work_available_.wait(lock, [this]() { return stop_ || !storage_queue_.empty() || !event_queue_.empty(); });
+            if (storage_queue_.empty() && event_queue_.empty())
+            {
+                return;                                 // Stop requested and everything has been flushed
+            }
+
+            std::deque<StorageOperation> storage_ops;
+            std::deque<EventRecord> event_records;
+            storage_ops.swap(storage_queue_);
+            event_records.swap(event_queue_);
+            space_available_.notify_all();
+
+            lock.unlock();
+            executeStorageOperations(storage_ops);
+            writeEventRecords(event_records);
+            lock.lock();
+        }
+    }
+
+public:
+    IOThread(uavcan::dynamic_node_id_server::IStorageBackend& backend, const std::string& event_log_file)
+        : backend_(backend)
+        , event_log_fd_(::open(event_log_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666))
+        , thread_(&IOThread::run, this)
+    {
+        ENFORCE(event_log_fd_ >= 0);
+
+        std::uint8_t header[uavcan_posix::dynamic_node_id_server::BinaryFileEventTracer::HeaderSize];
+        uavcan_posix::dynamic_node_id_server::BinaryFileEventTracer::encodeHeader(header);
+        writeEventLog(header, sizeof(header));
+    }
+
+    ~IOThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_available_.notify_one();
+        thread_.join();
+        (void)::close(event_log_fd_);
+    }
+
+    /**
+     * Reads directly from the backend. This may block, but it is only needed for the keys that have not been
+     * written since startup, i.e. while the server is initializing.
+     */
+    String read(const String& key)
+    {
+        std::lock_guard<std::mutex> backend_lock(backend_mutex_);
+        return backend_.get(key);
+    }
+
+    void write(const String& key, const String& value)
+    {
+        enqueueStorageOperation(StorageOperation{ StorageOperation::Type::Set, key, value });
+    }
+
+    void beginBatch() { enqueueStorageOperation(StorageOperation{ StorageOperation::Type::BeginBatch, {}, {} }); }
+    void endBatch()   { enqueueStorageOperation(StorageOperation{ StorageOperation::Type::EndBatch, {}, {} }); }
+
+    void traceEvent(uavcan::dynamic_node_id_server::TraceCode code, std::int64_t argument)
+    {
+        timespec ts = timespec();                   // If clock_gettime() fails, zero time will be used
+        (void)clock_gettime(CLOCK_REALTIME, &ts);
+
+        EventRecord record;
+        record.utc_usec = std::uint64_t(ts.tv_sec) * 1000000U + std::uint64_t(ts.tv_nsec / 1000L);
+        record.code = code;
+        record.argument = argument;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (event_queue_.size() >= EventQueueCapacity)
+        {
+            num_dropped_events_++;
+            return;
+        }
+        event_queue_.push_back(record);
+        work_available_.notify_one();
+    }
+
+    std::uint64_t getNumStorageStalls()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_storage_stalls_;
+    }
+
+    std::uint64_t getNumDroppedEvents()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return num_dropped_events_;
+    }
+};
+
+/**
+ * Write-behind storage: the values are cached in memory and written to the underlying backend by the I/O thread.
+ * Note that the writes reach the disk with a delay, so a power loss may roll back the most recent updates of the
+ * persistent state; the queue is short, so the window is normally a few milliseconds.
+ */
+class AsyncStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
+{
+    IOThread& io_;
+    mutable std::unordered_map<std::string, String> cache_;
+
+public:
+    explicit AsyncStorageBackend(IOThread& io) : io_(io) { }
+
+    String get(const String& key) const override
+    {
+        const auto it = cache_.find(key.c_str());
+        if (it != cache_.end())
+        {
+            return it->second;
+        }
+        const String value = io_.read(key);
+        cache_.emplace(key.c_str(), value);
+        return value;
+    }
+
+    void set(const String& key, const String& value) override
+    {
+        cache_[key.c_str()] = value;
+        io_.write(key, value);
+    }
+
+    void beginBatch() override { io_.beginBatch(); }
+    void endBatch() override   { io_.endBatch(); }
+};
+
+
+class EventTracer : public uavcan::dynamic_node_id_server::IEventTracer
 {
 public:
     struct RecentEvent
@@ -129,6 +368,7 @@ private:
         std::size_t operator()(T t) const { return static_cast<std::size_t>(t); }
     };
 
+    IOThread& io_;
     uavcan_linux::SystemClock clock_;
     const uavcan::MonotonicTime started_at_ = clock_.getMonotonic();
     const unsigned num_last_events_;
@@ -140,7 +380,7 @@ private:
 
     void onEvent(uavcan::dynamic_node_id_server::TraceCode code, std::int64_t argument) override
     {
-        uavcan_posix::dynamic_node_id_server::FileEventTracer::onEvent(code, argument);
+        io_.traceEvent(code, argument);
 
         had_events_ = true;
 
@@ -158,12 +398,11 @@ private:
     }
 
 public:
-    EventTracer(unsigned num_last_events_to_keep)
-        : num_last_events_(num_last_events_to_keep)
+    EventTracer(IOThread& io, unsigned num_last_events_to_keep)
+        : io_(io)
+        , num_last_events_(num_last_events_to_keep)
     { }
 
-    using uavcan_posix::dynamic_node_id_server::FileEventTracer::init;
-
     const RecentEvent& getEventByIndex(unsigned index) const { return last_events_.at(index); }
 
     unsigned getNumEvents() const { return last_events_.size(); }
@@ -480,24 +719,37 @@ void redraw(const uavcan_linux::NodePtr& node,
 void runForever(const uavcan_linux::NodePtr& node,
                 const std::uint8_t cluster_size,
                 const std::string& event_log_file,
-                const std::string& persistent_storage_path)
+                const std::string& persistent_storage_path,
+                const bool use_journal)
 {
     /*
-     * Event tracer
+     * Storage backend
      */
-    EventTracer event_tracer(MaxNumLastEvents);
-    ENFORCE(0 <= event_tracer.init(event_log_file.c_str()));
+    uavcan_posix::dynamic_node_id_server::FileStorageBackend file_storage_backend;
+    uavcan_posix::dynamic_node_id_server::JournalStorageBackend journal_storage_backend;
+    uavcan::dynamic_node_id_server::IStorageBackend* storage_backend = nullptr;
+    if (use_journal)
+    {
+        ENFORCE(0 <= journal_storage_backend.init(persistent_storage_path.c_str()));
+        storage_backend = &journal_storage_backend;
+    }
+    else
+    {
+        ENFORCE(0 <= file_storage_backend.init(persistent_storage_path.c_str()));
+        storage_backend = &file_storage_backend;
+    }
 
     /*
-     * Storage backend
+     * The disk is accessed from the I/O thread only, except for the initial reads of the storage
      */
-    uavcan_posix::dynamic_node_id_server::FileStorageBackend storage_backend;
-    ENFORCE(0 <= storage_backend.init(persistent_storage_path.c_str()));
+    IOThread io_thread(*storage_backend, event_log_file);
+    AsyncStorageBackend async_storage_backend(io_thread);
+    EventTracer event_tracer(io_thread, MaxNumLastEvents);
 
     /*
      * Server
      */
-    uavcan::dynamic_node_id_server::DistributedServer server(*node, storage_backend, event_tracer);
+    uavcan::dynamic_node_id_server::DistributedServer server(*node, async_storage_backend, event_tracer);
 
     const int server_init_res = server.init(node->getNodeStatusProvider().getHardwareVersion().unique_id, cluster_size);
     if (server_init_res < 0)
@@ -539,6 +791,7 @@ struct Options
     std::vector<std::string> ifaces;
     std::uint8_t cluster_size = 0;
     std::string storage_path;
+    bool use_journal = false;
 };
 
 Options parseOptions(int argc, const char** argv)
@@ -552,7 +805,10 @@ Options parseOptions(int argc, const char** argv)
             std::cerr << error_text << "\n"
                       << "Usage:\n\t"
                       << executable_name
-                      << " <node-id> <can-iface-name-1> [can-iface-name-N...] [-c <cluster-size>] -s <storage-path>"
+                      << " <node-id> <can-iface-name-1> [can-iface-name-N...] [-c <cluster-size>] [-j]"
+                      << " -s <storage-path>\n"
+                      << "Options:\n"
+                      << "\t-j  Keep the storage in a single journal file instead of one file per key"
                       << std::endl;
             std::exit(1);
         }
@@ -595,6 +851,10 @@ Options parseOptions(int argc, const char** argv)
                     "Invalid cluster size");
             out.cluster_size = std::uint8_t(cluster_size);
         }
+        else if (token == "-j")
+        {
+            out.use_journal = true;
+        }
         else if (token[1] == 's')
         {
             if (token.length() > 2)     // -s/foo/bar
@@ -637,6 +897,7 @@ int main(int argc, const char** argv)
         std::cout << "Self node ID: " << int(options.node_id.get()) << "\n"
                      "Cluster size: " << int(options.cluster_size) << "\n"
                      "Storage path: " << options.storage_path << "\n"
+                     "Storage type: " << (options.use_journal ? "Journal" : "Files") << "\n"
                      "Num ifaces:   " << options.ifaces.size() << "\n"
 #ifdef NDEBUG
                      "Build mode:   Release"
@@ -653,14 +914,14 @@ int main(int argc, const char** argv)
         int system_res = std::system(("mkdir -p '" + options.storage_path + "' &>/dev/null").c_str());
         (void)system_res;
 
-        const auto event_log_file = options.storage_path + "/events.log";
-        const auto storage_path   = options.storage_path + "/storage/";
+        const auto event_log_file = options.storage_path + "/events.bin";
+        const auto storage_path   = options.storage_path + (options.use_journal ? "/journal/" : "/storage/");
 
         /*
          * Starting the node
          */
         auto node = initNode(options.ifaces, options.node_id, "org.uavcan.linux_app.dynamic_node_id_server");
-        runForever(node, options.cluster_size, event_log_file, storage_path);
+        runForever(node, options.cluster_size, event_log_file, storage_path, options.use_journal);
         return 0;
     }
     catch (const std::exception& ex)
@@ -2,9 +2,11 @@
  * Copyright (C) 2014 Pavel Kirienko <pavel.kirienko@gmail.com>
  */
 
+#include <array>
 #include <cstdio>
 #include <bitset>
-#include <unordered_map>
+#include <string>
+#include <vector>
 #include <uavcan_linux/uavcan_linux.hpp>
 #include <uavcan/protocol/node_status_monitor.hpp>
 #include "debug.hpp"
@@ -21,109 +23,166 @@ enum class CLIColor : unsigned
     Default = 39
 };
 
-class CLIColorizer
+static std::string colorize(CLIColor color, const char* text, int width)
 {
-    const CLIColor color_;
-public:
-    explicit CLIColorizer(CLIColor c) : color_(c)
-    {
-        std::printf("\033[%um", static_cast<unsigned>(color_));
-    }
-
-    ~CLIColorizer()
-    {
-        std::printf("\033[%um", static_cast<unsigned>(CLIColor::Default));
-    }
-};
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "\033[%um %-*s \033[%um", static_cast<unsigned>(color), width, text,
+                  static_cast<unsigned>(CLIColor::Default));
+    return buf;
+}
 
+/**
+ * The screen is redrawn incrementally: only the rows that differ from what is already displayed are rewritten,
+ * and the whole update is written to the terminal at once. This keeps the traffic and the CPU usage low even
+ * if the bus is full of nodes and the terminal is remote.
+ */
 class Monitor : public uavcan::NodeStatusMonitor
 {
+    static constexpr unsigned NumNodeIDs = uavcan::NodeID::Max + 1;
+    static constexpr unsigned HeaderHeight = 3;
+
+    /**
+     * NodeStatus message rate is estimated from the reception timestamps using exponential moving average
+     * of the intervals between the messages.
+     */
+    struct NodeEntry
+    {
+        uavcan::protocol::NodeStatus msg;
+        uavcan::MonotonicTime last_ts;
+        float avg_interval_sec = 0.0F;
+        std::uint64_t num_messages = 0;
+
+        float getRate() const { return (avg_interval_sec > 0.0F) ? (1.0F / avg_interval_sec) : 0.0F; }
+    };
+
     uavcan_linux::TimerPtr timer_;
-    std::unordered_map<int, uavcan::protocol::NodeStatus> status_registry_;
+    std::array<NodeEntry, NumNodeIDs> entries_;
+    std::vector<std::string> displayed_rows_;   ///< What is currently on the screen, row by row
+    std::string output_;                        ///< Reused to avoid reallocations
 
     void handleNodeStatusMessage(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>& msg) override
     {
-        status_registry_[msg.getSrcNodeID().get()] = msg;
+        NodeEntry& e = entries_[msg.getSrcNodeID().get()];
+        const uavcan::MonotonicTime ts = msg.getMonotonicTimestamp();
+        if (!e.last_ts.isZero() && (ts > e.last_ts))
+        {
+            const float interval = float((ts - e.last_ts).toUSec()) * 1e-6F;
+            e.avg_interval_sec = (e.avg_interval_sec > 0.0F) ? (e.avg_interval_sec * 0.9F + interval * 0.1F) :
+                                 interval;
+        }
+        e.last_ts = ts;
+        e.msg = msg;
+        e.num_messages++;
     }
 
-    static std::pair<CLIColor, std::string> healthToColoredString(const std::uint8_t health)
+    static std::pair<CLIColor, const char*> healthToColoredString(const std::uint8_t health)
     {
-        static const std::unordered_map<std::uint8_t, std::pair<CLIColor, std::string>> map
-        {
-            { uavcan::protocol::NodeStatus::HEALTH_OK,       { CLIColor(CLIColor::Green),   "OK" }},
-            { uavcan::protocol::NodeStatus::HEALTH_WARNING,  { CLIColor(CLIColor::Yellow),  "WARNING" }},
-            { uavcan::protocol::NodeStatus::HEALTH_ERROR,    { CLIColor(CLIColor::Magenta), "ERROR" }},
-            { uavcan::protocol::NodeStatus::HEALTH_CRITICAL, { CLIColor(CLIColor::Red),     "CRITICAL" }}
-        };
-        try
-        {
-            return map.at(health);
-        }
-        catch (std::out_of_range&)
+        switch (health)
         {
-            return { CLIColor(CLIColor::Red), std::to_string(health) };
+        case uavcan::protocol::NodeStatus::HEALTH_OK:       return { CLIColor::Green,   "OK" };
+        case uavcan::protocol::NodeStatus::HEALTH_WARNING:  return { CLIColor::Yellow,  "WARNING" };
+        case uavcan::protocol::NodeStatus::HEALTH_ERROR:    return { CLIColor::Magenta, "ERROR" };
+        case uavcan::protocol::NodeStatus::HEALTH_CRITICAL: return { CLIColor::Red,     "CRITICAL" };
+        default:                                            return { CLIColor::Red,     "?" };
         }
     }
 
-    static std::pair<CLIColor, std::string> modeToColoredString(const std::uint8_t mode)
+    static std::pair<CLIColor, const char*> modeToColoredString(const std::uint8_t mode)
     {
-        static const std::unordered_map<std::uint8_t, std::pair<CLIColor, std::string>> map
-        {
-            { uavcan::protocol::NodeStatus::MODE_OPERATIONAL,     { CLIColor(CLIColor::Green),   "OPERATIONAL" }},
-            { uavcan::protocol::NodeStatus::MODE_INITIALIZATION,  { CLIColor(CLIColor::Yellow),  "INITIALIZATION" }},
-            { uavcan::protocol::NodeStatus::MODE_MAINTENANCE,     { CLIColor(CLIColor::Cyan),    "MAINTENANCE" }},
-            { uavcan::protocol::NodeStatus::MODE_SOFTWARE_UPDATE, { CLIColor(CLIColor::Magenta), "SOFTWARE_UPDATE" }},
-            { uavcan::protocol::NodeStatus::MODE_OFFLINE,         { CLIColor(CLIColor::Red),     "OFFLINE" }}
-        };
-        try
+        switch (mode)
         {
-            return map.at(mode);
-        }
-        catch (std::out_of_range&)
-        {
-            return { CLIColor(CLIColor::Red), std::to_string(mode) };
+        case uavcan::protocol::NodeStatus::MODE_OPERATIONAL:     return { CLIColor::Green,   "OPERATIONAL" };
+        case uavcan::protocol::NodeStatus::MODE_INITIALIZATION:  return { CLIColor::Yellow,  "INITIALIZATION" };
+        case uavcan::protocol::NodeStatus::MODE_MAINTENANCE:     return { CLIColor::Cyan,    "MAINTENANCE" };
+        case uavcan::protocol::NodeStatus::MODE_SOFTWARE_UPDATE: return { CLIColor::Magenta, "SOFTWARE_UPDATE" };
+        case uavcan::protocol::NodeStatus::MODE_OFFLINE:         return { CLIColor::Red,     "OFFLINE" };
+        default:                                                 return { CLIColor::Red,     "?" };
         }
     }
 
-    void printStatusLine(const uavcan::NodeID nid, const uavcan::NodeStatusMonitor::NodeStatus& status)
+    std::string renderStatusLine(const uavcan::NodeID nid, const uavcan::NodeStatusMonitor::NodeStatus& status) const
     {
         const auto health_and_color = healthToColoredString(status.health);
         const auto mode_and_color   = modeToColoredString(status.mode);
 
-        const int nid_int = nid.get();
-        const unsigned long uptime = status_registry_[nid_int].uptime_sec;
-        const unsigned vendor_code = status_registry_[nid_int].vendor_specific_status_code;
+        const NodeEntry& e = entries_[nid.get()];
+        const unsigned long uptime = e.msg.uptime_sec;
+        const unsigned vendor_code = e.msg.vendor_specific_status_code;
 
-        std::printf(" %-3d |", nid_int);
-        {
-            CLIColorizer clz(mode_and_color.first);
-            std::printf(" %-15s ", mode_and_color.second.c_str());
-        }
-        std::printf("|");
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "| %-10lu | %6.2f | %04x  %s'%s  %u", uptime, double(e.getRate()),
+                      vendor_code, std::bitset<8>((vendor_code >> 8) & 0xFF).to_string().c_str(),
+                      std::bitset<8>(vendor_code).to_string().c_str(), vendor_code);
+
+        char nid_buf[8];
+        std::snprintf(nid_buf, sizeof(nid_buf), " %-3d |", int(nid.get()));
+
+        return nid_buf + colorize(mode_and_color.first, mode_and_color.second, 15) + "|" +
+               colorize(health_and_color.first, health_and_color.second, 8) + buf;
+    }
+
+    std::vector<std::string> renderScreen() const
+    {
+        std::vector<std::string> rows;
+        rows.reserve(HeaderHeight + NumNodeIDs);
+        rows.emplace_back();        // Summary, filled in below
+        rows.emplace_back(" NID | Mode            | Health   | Uptime [s] | Rate   | Vendor-specific status code");
+        rows.emplace_back("-----+-----------------+----------+------------+--------+-hex---bin----------------dec--");
+
+        unsigned num_nodes = 0;
+        float total_rate = 0.0F;
+        for (unsigned i = 1; i <= uavcan::NodeID::Max; i++)
         {
-            CLIColorizer clz(health_and_color.first);
-            std::printf(" %-8s ", health_and_color.second.c_str());
+            if (isNodeKnown(i))
+            {
+                rows.push_back(renderStatusLine(i, getNodeStatus(i)));
+                num_nodes++;
+                total_rate += entries_[i].getRate();
+            }
         }
-        std::printf("| %-10lu | %04x  %s'%s  %u\n", uptime, vendor_code,
-                    std::bitset<8>((vendor_code >> 8) & 0xFF).to_string().c_str(),
-                    std::bitset<8>(vendor_code).to_string().c_str(),
-                    vendor_code);
+
+        char buf[80];
+        std::snprintf(buf, sizeof(buf), " Nodes: %-3u  NodeStatus messages: %.1f per second", num_nodes,
+                      double(total_rate));
+        rows[0] = buf;
+        return rows;
     }
 
     void redraw(const uavcan::TimerEvent&)
     {
-        std::printf("\x1b[1J");   // Clear screen from the current cursor position to the beginning
-        std::printf("\x1b[H");    // Move cursor to the coordinates 1,1
-        std::printf(" NID | Mode            | Health   | Uptime [s] | Vendor-specific status code\n");
-        std::printf("-----+-----------------+----------+------------+-hex---bin----------------dec--\n");
+        const std::vector<std::string> rows = renderScreen();
 
-        for (unsigned i = 1; i <= uavcan::NodeID::Max; i++)
+        output_.clear();
+        if (displayed_rows_.empty())
         {
-            if (isNodeKnown(i))
+            output_ += "\x1b[2J";   // Clear the screen once, then only the changed rows are rewritten
+        }
+
+        char move[16];
+        for (unsigned i = 0; i < rows.size(); i++)
+        {
+            if ((i < displayed_rows_.size()) && (displayed_rows_[i] == rows[i]))
             {
-                printStatusLine(i, getNodeStatus(i));
+                continue;
             }
+            std::snprintf(move, sizeof(move), "\x1b[%u;1H", i + 1);
+            output_ += move;
+            output_ += rows[i];
+            output_ += "\x1b[K";    // Erase the rest of the line, the previous content could be longer
+        }
+        if (rows.size() < displayed_rows_.size())
+        {
+            std::snprintf(move, sizeof(move), "\x1b[%u;1H", unsigned(rows.size() + 1));
+            output_ += move;
+            output_ += "\x1b[J";    // Erase the rows of the nodes that went offline
+        }
+
+        if (!output_.empty())
+        {
+            std::fwrite(output_.data(), 1, output_.size(), stdout);
+            std::fflush(stdout);
         }
+        displayed_rows_ = rows;
     }
 
 public:
@@ -7,6 +7,8 @@
 #include <thread>
 #include <mutex>
 #include <map>
+#include <set>
+#include <vector>
 #include <algorithm>
 #include <iterator>
 #include <uavcan_linux/uavcan_linux.hpp>
@@ -83,25 +85,173 @@ uavcan_linux::NodePtr initNode(const std::vector<std::string>& ifaces, uavcan::N
     return node;
 }
 
+/**
+ * Service calls to many nodes at once may take a while, because all responses share the bus.
+ */
+constexpr unsigned BatchRequestTimeoutMs = 1000;
+
+/**
+ * Outcome of a batch call for one node, see callMany().
+ */
+template <typename DataType>
+struct BatchCallResult
+{
+    bool successful = false;                                ///< False if a call has timed out or could not be sent
+    std::vector<typename DataType::Response> responses;     ///< More than one if the calls were continued
+};
+
+template <typename DataType>
+using BatchCallResults = std::map<std::uint8_t, BatchCallResult<DataType>>;
+
+/**
+ * Invoked on every response; returns true if the updated request must be sent to the same node again.
+ */
 template <typename DataType>
-typename DataType::Response call(uavcan_linux::BlockingServiceClient<DataType>& client,
-                                 uavcan::NodeID server_node_id, const typename DataType::Request& request)
+using BatchContinuation = std::function<bool (const typename DataType::Response&, typename DataType::Request&)>;
+
+/**
+ * Sends the request to all nodes at once, then spins the node until every node has responded or timed out,
+ * printing the progress. A batch takes about one round trip regardless of the number of nodes.
+ * Multi-step operations (e.g. reading all parameters) are pipelined by the continuation: the next request to a
+ * node is sent as soon as its previous response arrives, independently from the other nodes.
+ */
+template <typename DataType>
+BatchCallResults<DataType> callMany(const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+                                    const typename DataType::Request& request,
+                                    const BatchContinuation<DataType>& continuation = BatchContinuation<DataType>())
 {
-    const int res = client.blockingCall(server_node_id, request, uavcan::MonotonicDuration::fromMSec(100));
-    ENFORCE(res >= 0);
-    ENFORCE(client.wasSuccessful());
-    return client.getResponse();
+    BatchCallResults<DataType> results;
+    std::map<std::uint8_t, typename DataType::Request> requests;
+    unsigned num_finished = 0;
+    uavcan_linux::ServiceClientPtr<DataType> client;
+
+    const auto finish = [&](std::uint8_t node_id, bool successful)
+    {
+        results[node_id].successful = successful;
+        num_finished++;
+        std::cout << "\r" << num_finished << "/" << node_ids.size() << " nodes done" << std::flush;
+    };
+
+    client = node->makeServiceClient<DataType>([&](const uavcan::ServiceCallResult<DataType>& res)
+    {
+        const std::uint8_t node_id = res.getCallID().server_node_id.get();
+        if (!res.isSuccessful())
+        {
+            finish(node_id, false);
+            return;
+        }
+        results[node_id].responses.push_back(res.getResponse());
+        auto& req = requests[node_id];
+        if (continuation && continuation(res.getResponse(), req))
+        {
+            if (client->call(node_id, req) < 0)
+            {
+                finish(node_id, false);
+            }
+            return;
+        }
+        finish(node_id, true);
+    });
+    client->setRequestTimeout(uavcan::MonotonicDuration::fromMSec(BatchRequestTimeoutMs));
+
+    for (auto node_id : node_ids)
+    {
+        requests[node_id.get()] = request;
+        results[node_id.get()];                 // Every node must appear in the results
+        if (client->call(node_id, request) < 0)
+        {
+            finish(node_id.get(), false);
+        }
+    }
+
+    while (num_finished < node_ids.size())
+    {
+        ENFORCE(node->spin(uavcan::MonotonicDuration::fromMSec(10)) >= 0);
+    }
+    std::cout << std::endl;
+    return results;
+}
+
+/**
+ * Prints the responses grouped by node, followed by the summary.
+ */
+template <typename DataType>
+void printResults(const BatchCallResults<DataType>& results,
+                  const std::function<void (const typename DataType::Response&)>& print_response =
+                      [](const typename DataType::Response& r) { std::cout << r << std::endl; })
+{
+    std::vector<int> failed;
+    for (auto& r : results)
+    {
+        std::cout << "Node " << int(r.first) << ":\n";
+        for (auto& response : r.second.responses)
+        {
+            print_response(response);
+        }
+        if (!r.second.successful)
+        {
+            std::cout << "<NO RESPONSE>" << std::endl;
+            failed.push_back(r.first);
+        }
+    }
+    std::cout << (results.size() - failed.size()) << " of " << results.size() << " nodes responded";
+    if (!failed.empty())
+    {
+        std::cout << "; no response from:";
+        for (auto node_id : failed)
+        {
+            std::cout << " " << node_id;
+        }
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * Parses a node ID list, e.g. "42", "10-20,25", or "all" for all online nodes seen by the monitor.
+ */
+std::vector<uavcan::NodeID> parseNodeIDs(const std::string& spec, const uavcan::NodeStatusMonitor& monitor)
+{
+    std::set<std::uint8_t> ids;
+    if (spec == "all")
+    {
+        monitor.forEachNode([&ids](uavcan::NodeID node_id, uavcan::NodeStatusMonitor::NodeStatus status)
+        {
+            if (status.mode != uavcan::protocol::NodeStatus::MODE_OFFLINE)
+            {
+                ids.insert(node_id.get());
+            }
+        });
+        ENFORCE(!ids.empty());
+    }
+    else
+    {
+        std::istringstream iss(spec);
+        std::string item;
+        while (std::getline(iss, item, ','))
+        {
+            const auto dash = item.find('-');
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+            ENFORCE(first >= 1 && first <= last && last <= uavcan::NodeID::Max);
+            for (int i = first; i <= last; i++)
+            {
+                ids.insert(std::uint8_t(i));
+            }
+        }
+    }
+    return std::vector<uavcan::NodeID>(ids.begin(), ids.end());
 }
 
 /*
  * Command table.
  * The structure is:
  *      command_name : (command_usage_info, command_entry_point)
+ * The service calls are made to all requested nodes at once, see callMany().
  * This code was written while listening to some bad dubstep so I'm not sure about its quality.
  */
 const std::map<std::string,
                std::pair<std::string,
-                         std::function<void(const uavcan_linux::NodePtr&, const uavcan::NodeID,
+                         std::function<void(const uavcan_linux::NodePtr&, const std::vector<uavcan::NodeID>&,
                                             const std::vector<std::string>&)>
                         >
               > commands =
@@ -109,34 +259,39 @@ const std::map<std::string,
     {
         "param",
         {
-            "No arguments supplied - requests all params from a remote node\n"
+            "No arguments supplied - requests all params from remote nodes\n"
             "<param_name> <param_value> - assigns parameter <param_name> to value <param_value>",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID node_id, const std::vector<std::string>& args)
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>& args)
             {
-                auto client = node->makeBlockingServiceClient<uavcan::protocol::param::GetSet>();
                 uavcan::protocol::param::GetSet::Request request;
                 if (args.empty())
                 {
-                    while (true)
-                    {
-                        auto response = call(*client, node_id, request);
-                        if (response.name.empty())
+                    auto results = callMany<uavcan::protocol::param::GetSet>(node, node_ids, request,
+                        [](const uavcan::protocol::param::GetSet::Response& response,
+                           uavcan::protocol::param::GetSet::Request& next_request)
+                        {
+                            next_request.index++;
+                            return !response.name.empty();
+                        });
+                    printResults<uavcan::protocol::param::GetSet>(results,
+                        [](const uavcan::protocol::param::GetSet::Response& response)
                         {
-                            break;
-                        }
-                        std::cout
-                            << response
-                            << "\n" << std::string(80, '-')
-                            << std::endl;
-                        request.index++;
-                    }
+                            if (!response.name.empty())
+                            {
+                                std::cout
+                                    << response
+                                    << "\n" << std::string(80, '-')
+                                    << std::endl;
+                            }
+                        });
                 }
                 else
                 {
                     request.name = args.at(0).c_str();
                     // TODO: add support for string parameters
                     request.value.to<uavcan::protocol::param::Value::Tag::real_value>() = std::stof(args.at(1));
-                    std::cout << call(*client, node_id, request) << std::endl;
+                    printResults(callMany<uavcan::protocol::param::GetSet>(node, node_ids, request));
                 }
             }
         }
@@ -144,69 +299,63 @@ const std::map<std::string,
     {
         "param_save",
         {
-            "Calls uavcan.protocol.param.ExecuteOpcode on a remote node with OPCODE_SAVE",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID node_id, const std::vector<std::string>&)
+            "Calls uavcan.protocol.param.ExecuteOpcode on remote nodes with OPCODE_SAVE",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
             {
-                auto client = node->makeBlockingServiceClient<uavcan::protocol::param::ExecuteOpcode>();
                 uavcan::protocol::param::ExecuteOpcode::Request request;
                 request.opcode = request.OPCODE_SAVE;
-                std::cout << call(*client, node_id, request) << std::endl;
+                printResults(callMany<uavcan::protocol::param::ExecuteOpcode>(node, node_ids, request));
             }
         }
     },
     {
         "param_erase",
         {
-            "Calls uavcan.protocol.param.ExecuteOpcode on a remote node with OPCODE_ERASE",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID node_id, const std::vector<std::string>&)
+            "Calls uavcan.protocol.param.ExecuteOpcode on remote nodes with OPCODE_ERASE",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
             {
-                auto client = node->makeBlockingServiceClient<uavcan::protocol::param::ExecuteOpcode>();
                 uavcan::protocol::param::ExecuteOpcode::Request request;
                 request.opcode = request.OPCODE_ERASE;
-                std::cout << call(*client, node_id, request) << std::endl;
+                printResults(callMany<uavcan::protocol::param::ExecuteOpcode>(node, node_ids, request));
             }
         }
     },
     {
         "restart",
         {
-            "Restarts a remote node using uavcan.protocol.RestartNode",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID node_id, const std::vector<std::string>&)
+            "Restarts remote nodes using uavcan.protocol.RestartNode",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
             {
-                auto client = node->makeBlockingServiceClient<uavcan::protocol::RestartNode>();
                 uavcan::protocol::RestartNode::Request request;
                 request.magic_number = request.MAGIC_NUMBER;
-                (void)client->blockingCall(node_id, request);
-                if (client->wasSuccessful())
-                {
-                    std::cout << client->getResponse() << std::endl;
-                }
-                else
-                {
-                    std::cout << "<NO RESPONSE>" << std::endl;
-                }
+                printResults(callMany<uavcan::protocol::RestartNode>(node, node_ids, request));
             }
         }
     },
     {
         "info",
         {
-            "Calls uavcan.protocol.GetNodeInfo on a remote node",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID node_id, const std::vector<std::string>&)
+            "Calls uavcan.protocol.GetNodeInfo on remote nodes",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
             {
-                auto client = node->makeBlockingServiceClient<uavcan::protocol::GetNodeInfo>();
-                std::cout << call(*client, node_id, uavcan::protocol::GetNodeInfo::Request()) << std::endl;
+                const uavcan::protocol::GetNodeInfo::Request request;
+                printResults(callMany<uavcan::protocol::GetNodeInfo>(node, node_ids, request));
             }
         }
     },
     {
         "transport_stats",
         {
-            "Calls uavcan.protocol.GetTransportStats on a remote node",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID node_id, const std::vector<std::string>&)
+            "Calls uavcan.protocol.GetTransportStats on remote nodes",
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>& node_ids,
+               const std::vector<std::string>&)
             {
-                auto client = node->makeBlockingServiceClient<uavcan::protocol::GetTransportStats>();
-                std::cout << call(*client, node_id, uavcan::protocol::GetTransportStats::Request()) << std::endl;
+                const uavcan::protocol::GetTransportStats::Request request;
+                printResults(callMany<uavcan::protocol::GetTransportStats>(node, node_ids, request));
             }
         }
     },
@@ -215,7 +364,8 @@ const std::map<std::string,
         {
             "Publishes uavcan.equipment.hardpoint.Command\n"
             "Expected argument: command",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID, const std::vector<std::string>& args)
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>&,
+               const std::vector<std::string>& args)
             {
                 uavcan::equipment::hardpoint::Command msg;
                 msg.command = std::stoi(args.at(0));
@@ -229,7 +379,8 @@ const std::map<std::string,
         {
             "Publishes uavcan.protocol.EnumerationRequest\n"
             "Expected arguments: node_id, timeout_sec (optional, defaults to 60)",
-            [](const uavcan_linux::NodePtr& node, const uavcan::NodeID, const std::vector<std::string>& args)
+            [](const uavcan_linux::NodePtr& node, const std::vector<uavcan::NodeID>&,
+               const std::vector<std::string>& args)
             {
                 uavcan::protocol::EnumerationRequest msg;
                 msg.node_id = std::stoi(args.at(0));
@@ -244,6 +395,9 @@ const std::map<std::string,
 
 void runForever(const uavcan_linux::NodePtr& node)
 {
+    uavcan::NodeStatusMonitor node_status_monitor(*node);      // Provides the list of nodes for "all"
+    ENFORCE(node_status_monitor.start() >= 0);
+
     StdinLineReader stdin_reader;
     std::cout << "> " << std::flush;
     while (true)
@@ -261,12 +415,12 @@ void runForever(const uavcan_linux::NodePtr& node)
             if (words.size() >= 2)
             {
                 const auto cmd = words.at(0);
-                const uavcan::NodeID node_id(std::stoi(words.at(1)));
                 auto it = commands.find(cmd);
                 if (it != std::end(commands))
                 {
                     command_is_known = true;
-                    it->second.second(node, node_id, std::vector<std::string>(words.begin() + 2, words.end()));
+                    const auto node_ids = parseNodeIDs(words.at(1), node_status_monitor);
+                    it->second.second(node, node_ids, std::vector<std::string>(words.begin() + 2, words.end()));
                 }
             }
         }
@@ -277,7 +431,8 @@ void runForever(const uavcan_linux::NodePtr& node)
 
         if (!command_is_known)
         {
-            std::cout << "<command> <remote node id> [args...]\n";
+            std::cout << "<command> <remote node ids> [args...]\n";
+            std::cout << "Remote node ids: a list like '10-20,25', or 'all' for all online nodes.\n";
             std::cout << "Say 'help' to get help.\n";     // I'll show myself out.
 
             if (!words.empty() && words.at(0) == "help")
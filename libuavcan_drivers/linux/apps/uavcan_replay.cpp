@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <chrono>
+#include <iostream>
+#include <sys/resource.h>
+#include <uavcan_linux/uavcan_linux.hpp>
+#include "debug.hpp"
+
+namespace
+{
+
+double getCpuTimeSec()
+{
+    ::rusage usage = ::rusage();
+    (void)::getrusage(RUSAGE_SELF, &usage);
+    return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+/**
+ * Replays the log into a regular node and reports how well the node kept up with the load.
+ */
+void runReplay(const std::string& log_path, double speed, int node_id, unsigned num_passes)
+{
+    const uavcan_linux::FrameLogReader log(log_path);
+    std::cout << "Frames in the log: " << log.getNumRecords() << ", ifaces: " << int(log.getNumIfaces()) << std::endl;
+    ENFORCE(log.getNumRecords() > 0);
+
+    const uavcan_linux::SystemClock clock;
+    auto driver = std::make_shared<uavcan_linux::ReplayCanDriver>(log, clock, speed);
+    auto node = uavcan_linux::makeNode(driver);
+    node->setName("org.uavcan.linux_app.replay");
+    if (node_id > 0)
+    {
+        node->setNodeID(std::uint8_t(node_id));
+    }
+    ENFORCE(0 == node->start());
+    node->setModeOperational();
+
+    for (unsigned pass = 0; pass < num_passes; pass++)
+    {
+        driver->restart();
+        const auto started_at = std::chrono::steady_clock::now();
+        const double cpu_started_at = getCpuTimeSec();
+
+        while (!driver->isFinished())
+        {
+            const int res = node->spin(uavcan::MonotonicDuration::fromMSec(10));
+            if (res < 0)
+            {
+                std::cerr << "Spin error " << res << std::endl;
+            }
+        }
+
+        const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+        const double cpu = getCpuTimeSec() - cpu_started_at;
+        const auto& perf = node->getDispatcher().getTransferPerfCounter();     // Cumulative across the passes
+
+        std::cout << "Pass " << pass + 1 << ": "
+                  << "wall " << wall << " s, "
+                  << "CPU " << cpu << " s (" << (100.0 * cpu / wall) << "%), "
+                  << double(log.getNumRecords()) / wall << " frames/s, "
+                  << "transfers RX " << perf.getRxTransferCount() << " TX " << perf.getTxTransferCount() << ", "
+                  << "errors " << perf.getErrorCount() << ", "
+                  << "rejected frames " << node->getDispatcher().getNumRejectedRxFrames() << ", "
+                  << "peak pool usage " << node->getAllocator().getPeakNumUsedBlocks() << " of "
+                  << node->getAllocator().getNumBlocks() << " blocks"
+                  << std::endl;
+    }
+}
+
+}
+
+int main(int argc, const char** argv)
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cerr << "Usage:\n\t" << argv[0] << " <log-file> [speed [node-id [passes]]]\n"
+                      << "Speed 1 replays at the original rate, 0 as fast as possible; default is 1.\n"
+                      << "Node ID 0 starts the node in passive mode (default)." << std::endl;
+            return 1;
+        }
+        const double speed = (argc > 2) ? std::stod(argv[2]) : 1.0;
+        const int node_id = (argc > 3) ? std::stoi(argv[3]) : 0;
+        const unsigned passes = (argc > 4) ? unsigned(std::stoi(argv[4])) : 1U;
+        runReplay(argv[1], speed, node_id, passes);
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Spins the node in a dedicated thread and executes the tasks posted by other threads in between the spins.
+ * This is the only thread that may access the node once it is started; other threads interact with the node
+ * by posting tasks via @ref post() or @ref invoke().
+ *
+ * The node is spun in short quanta, so that a posted task waits at most one quantum before it is executed.
+ * Shorter quanta reduce the latency at the cost of more frequent wakeups.
+ */
+class NodeThread : uavcan::Noncopyable
+{
+    uavcan::INode& node_;
+    const uavcan::MonotonicDuration spin_quantum_;
+
+    std::mutex mutex_;
+    std::deque<std::function<void ()>> tasks_;
+    std::atomic<bool> stop_requested_;
+    std::atomic<int> spin_error_;
+    std::thread thread_;
+
+    void runPendingTasks()
+    {
+        std::deque<std::function<void ()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks.swap(tasks_);
+        }
+        for (auto& t : tasks)
+        {
+            t();
+        }
+    }
+
+    void run()
+    {
+        while (!stop_requested_)
+        {
+            runPendingTasks();
+            const int res = node_.spin(spin_quantum_);
+            if (res < 0)
+            {
+                spin_error_ = res;
+            }
+        }
+        runPendingTasks();      // The tasks posted before stop() must not be lost
+    }
+
+public:
+    static uavcan::MonotonicDuration getDefaultSpinQuantum() { return uavcan::MonotonicDuration::fromMSec(1); }
+
+    /**
+     * The thread is started immediately.
+     */
+    explicit NodeThread(uavcan::INode& node, uavcan::MonotonicDuration spin_quantum = getDefaultSpinQuantum())
+        : node_(node)
+        , spin_quantum_(spin_quantum)
+        , stop_requested_(false)
+        , spin_error_(0)
+        , thread_(&NodeThread::run, this)
+    { }
+
+    ~NodeThread() { stop(); }
+
+    /**
+     * Stops the thread after the current spin quantum. The pending tasks are executed before the thread exits.
+     * Must not be called from the node thread.
+     */
+    void stop()
+    {
+        stop_requested_ = true;
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    bool isNodeThread() const { return std::this_thread::get_id() == thread_.get_id(); }
+
+    /**
+     * Schedules the task for execution in the node thread. Can be called from any thread.
+     */
+    void post(std::function<void ()> task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+
+    /**
+     * Executes the task in the node thread and blocks until it is finished; exceptions are propagated to the
+     * caller. If called from the node thread, the task is executed immediately.
+     */
+    template <typename Result>
+    Result invoke(const std::function<Result ()>& task)
+    {
+        if (isNodeThread())
+        {
+            return task();
+        }
+        auto packaged = std::make_shared<std::packaged_task<Result ()>>(task);
+        auto future = packaged->get_future();
+        post([packaged]() { (*packaged)(); });
+        return future.get();
+    }
+
+    /**
+     * Last error returned by the node's spin() method, or zero if there were no errors.
+     */
+    int getLastSpinError() const { return spin_error_; }
+
+    uavcan::INode& getNode() { return node_; }
+};
+
+/**
+ * Outcome of an asynchronous service call, see @ref AsyncServiceClient.
+ */
+template <typename DataType>
+struct AsyncServiceCallResult
+{
+    uavcan::ServiceCallID call_id;
+    bool successful = false;                    ///< False if the call has timed out
+    typename DataType::Response response;       ///< Default constructed if the call was unsuccessful
+};
+
+/**
+ * Non-blocking replacement for @ref BlockingServiceClient that can be used from any number of threads at once.
+ * The calls are executed by @ref NodeThread, and every call returns a future that becomes ready when the
+ * response is received or the call times out. Many calls can be in flight concurrently, including the calls
+ * to the same server, so one spinning thread serves all of them.
+ *
+ * The underlying uavcan::ServiceClient is created, used and destroyed in the node thread only.
+ * The object must not outlive the NodeThread it was created with.
+ *
+ * Usage:
+ *   uavcan_linux::NodeThread node_thread(*node);
+ *   uavcan_linux::AsyncServiceClient<uavcan::protocol::GetNodeInfo> client(node_thread);
+ *   auto a = client.call(42, uavcan::protocol::GetNodeInfo::Request());
+ *   auto b = client.call(43, uavcan::protocol::GetNodeInfo::Request());
+ *   std::cout << a.get().response << b.get().response << std::endl;
+ */
+template <typename DataType>
+class AsyncServiceClient : uavcan::Noncopyable
+{
+    typedef uavcan::ServiceClient<DataType> Client;
+    typedef AsyncServiceCallResult<DataType> Result;
+
+    struct CallIDLess
+    {
+        bool operator()(const uavcan::ServiceCallID& a, const uavcan::ServiceCallID& b) const
+        {
+            if (a.server_node_id != b.server_node_id)
+            {
+                return a.server_node_id < b.server_node_id;
+            }
+            return a.transfer_id.get() < b.transfer_id.get();
+        }
+    };
+
+    /*
+     * Accessed from the node thread only
+     */
+    struct State
+    {
+        std::unique_ptr<Client> client;
+        std::map<uavcan::ServiceCallID, std::promise<Result>, CallIDLess> promises;
+    };
+
+    NodeThread& node_thread_;
+    std::shared_ptr<State> state_;
+
+    static void handleResult(State& state, const uavcan::ServiceCallResult<DataType>& res)
+    {
+        auto it = state.promises.find(res.getCallID());
+        if (it == state.promises.end())
+        {
+            return;
+        }
+        Result result;
+        result.call_id = res.getCallID();
+        result.successful = res.isSuccessful();
+        if (result.successful)
+        {
+            result.response = res.getResponse();
+        }
+        it->second.set_value(result);
+        state.promises.erase(it);
+    }
+
+public:
+    /**
+     * Initializes the service client in the node thread; blocks until that is done.
+     * @throws uavcan_linux::Exception.
+     */
+    explicit AsyncServiceClient(NodeThread& node_thread,
+                                uavcan::MonotonicDuration request_timeout = Client::getDefaultRequestTimeout())
+        : node_thread_(node_thread)
+        , state_(std::make_shared<State>())
+    {
+        const std::shared_ptr<State> state = state_;
+        const int res = node_thread_.invoke<int>([state, &node_thread, request_timeout]()
+        {
+            state->client.reset(new Client(node_thread.getNode()));
+            State* const raw_state = state.get();
+            state->client->setCallback([raw_state](const uavcan::ServiceCallResult<DataType>& r)
+            {
+                handleResult(*raw_state, r);
+            });
+            state->client->setRequestTimeout(request_timeout);
+            return state->client->init();
+        });
+        if (res < 0)
+        {
+            std::ostringstream os;
+            os << "AsyncServiceClient init failure " << DataType::getDataTypeFullName() << " [" << res << "]";
+            throw Exception(os.str());
+        }
+    }
+
+    /**
+     * The pending calls are cancelled; their futures will throw std::future_error (broken promise).
+     */
+    ~AsyncServiceClient()
+    {
+        const std::shared_ptr<State> state = state_;
+        node_thread_.post([state]() { state->client.reset(); state->promises.clear(); });
+    }
+
+    /**
+     * Submits the call to the node thread and returns immediately. Can be called from any thread.
+     * If the request could not be sent, the future throws uavcan_linux::Exception.
+     */
+    std::future<Result> call(uavcan::NodeID server_node_id, const typename DataType::Request& request)
+    {
+        auto promise = std::make_shared<std::promise<Result>>();
+        std::future<Result> future = promise->get_future();
+        const std::shared_ptr<State> state = state_;
+        node_thread_.post([state, promise, server_node_id, request]()
+        {
+            uavcan::ServiceCallID call_id;
+            const int res = state->client->call(server_node_id, request, call_id);
+            if (res < 0)
+            {
+                std::ostringstream os;
+                os << "Service call failure " << DataType::getDataTypeFullName() << " [" << res << "]";
+                promise->set_exception(std::make_exception_ptr(Exception(os.str())));
+                return;
+            }
+            state->promises[call_id] = std::move(*promise);
+        });
+        return future;
+    }
+
+    /**
+     * Number of the calls that are awaiting responses. Blocks until the node thread reports it.
+     */
+    unsigned getNumPendingCalls()
+    {
+        const std::shared_ptr<State> state = state_;
+        return node_thread_.invoke<unsigned>([state]() { return state->client->getNumPendingCalls(); });
+    }
+};
+
+template <typename T>
+using AsyncServiceClientPtr = std::shared_ptr<AsyncServiceClient<T>>;
+
+}
@@ -26,6 +26,17 @@ enum class ClockAdjustmentMode
     PerDriverPrivate ///< Adjust the clock only for the current driver instance
 };
 
+/**
+ * POSIX clock that backs the monotonic time.
+ * All of them are served from the vDSO on the common architectures, so reading them does not involve a syscall.
+ */
+enum class MonotonicClockSource
+{
+    Monotonic,       ///< CLOCK_MONOTONIC; slewed by NTP, microsecond resolution
+    MonotonicRaw,    ///< CLOCK_MONOTONIC_RAW; free running hardware time, not affected by NTP
+    MonotonicCoarse  ///< CLOCK_MONOTONIC_COARSE; cheapest to read, but the resolution is one scheduler tick
+};
+
 /**
  * Linux system clock driver.
  * Requires librt.
@@ -35,12 +46,25 @@ class SystemClock : public uavcan::ISystemClock
     uavcan::UtcDuration private_adj_;
     uavcan::UtcDuration gradual_adj_limit_;
     const ClockAdjustmentMode adj_mode_;
+    const clockid_t mono_clock_id_;
+    const MonotonicClockSource mono_source_;
     std::uint64_t step_adj_cnt_;
     std::uint64_t gradual_adj_cnt_;
 
     static constexpr std::int64_t Int1e6   = 1000000;
     static constexpr std::uint64_t UInt1e6 = 1000000;
 
+    static clockid_t toClockID(MonotonicClockSource source)
+    {
+        switch (source)
+        {
+        case MonotonicClockSource::MonotonicRaw:    return CLOCK_MONOTONIC_RAW;
+        case MonotonicClockSource::MonotonicCoarse: return CLOCK_MONOTONIC_COARSE;
+        case MonotonicClockSource::Monotonic:
+        default:                                    return CLOCK_MONOTONIC;
+        }
+    }
+
     bool performStepAdjustment(const uavcan::UtcDuration adjustment)
     {
         step_adj_cnt_++;
@@ -68,22 +92,29 @@ class SystemClock : public uavcan::ISystemClock
 public:
     /**
      * By default, the clock adjustment mode will be selected automatically - global if root, private otherwise.
+     *
+     * The coarse monotonic clock can be used where the timestamps are only needed for deadlines and timeouts
+     * of the order of tens of milliseconds. It should not be used if the node runs time synchronization master,
+     * or if the RX timestamps are used for anything beyond expiring the transfers.
      */
-    explicit SystemClock(ClockAdjustmentMode adj_mode = detectPreferredClockAdjustmentMode())
+    explicit SystemClock(ClockAdjustmentMode adj_mode = detectPreferredClockAdjustmentMode(),
+                         MonotonicClockSource mono_source = MonotonicClockSource::Monotonic)
         : gradual_adj_limit_(uavcan::UtcDuration::fromMSec(4000))
         , adj_mode_(adj_mode)
+        , mono_clock_id_(toClockID(mono_source))
+        , mono_source_(mono_source)
         , step_adj_cnt_(0)
         , gradual_adj_cnt_(0)
     { }
 
     /**
-     * Returns monotonic timestamp from librt.
+     * Returns monotonic timestamp from librt, using the clock selected via constructor.
      * @throws uavcan_linux::Exception.
      */
     uavcan::MonotonicTime getMonotonic() const override
     {
         timespec ts;
-        if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        if (clock_gettime(mono_clock_id_, &ts) != 0)
         {
             throw Exception("Failed to get monotonic time");
         }
@@ -165,6 +196,8 @@ public:
 
     ClockAdjustmentMode getAdjustmentMode() const { return adj_mode_; }
 
+    MonotonicClockSource getMonotonicClockSource() const { return mono_source_; }
+
     /**
      * This is only applicable if the selected clock adjustment mode is private.
      * In system wide mode this method will always return zero duration.
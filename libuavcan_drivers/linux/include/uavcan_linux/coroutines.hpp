@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+/*
+ * This header is optional and requires C++20; the rest of the Linux helpers only need C++11.
+ * Since libuavcan does not recognize newer standards, it must be built with UAVCAN_CPP_VERSION=UAVCAN_CPP11.
+ */
+#if (__cplusplus < 202002L) || !defined(__has_include)
+# error "uavcan_linux/coroutines.hpp requires C++20"
+#endif
+#if !__has_include(<coroutine>)
+# error "uavcan_linux/coroutines.hpp requires the <coroutine> header"
+#endif
+
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan/node/scheduler.hpp>
+#include <uavcan/node/subscriber.hpp>
+#include <uavcan/node/service_client.hpp>
+#include <uavcan/util/method_binder.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Coroutine type for the awaitables defined below.
+ * The coroutine starts executing immediately and runs until the first co_await; from then on it is resumed
+ * from the callbacks of the node, i.e. from within Node::spin(), so no extra threads are involved.
+ * The object owns the coroutine frame; destroying it cancels the coroutine at its current suspension point,
+ * which unregisters the pending awaitables.
+ *
+ * Usage:
+ *   uavcan_linux::CoTask updateFirmware(uavcan::INode& node, uavcan::NodeID target)
+ *   {
+ *       uavcan_linux::CoServiceClient<uavcan::protocol::GetNodeInfo> client(node);
+ *       const auto info = co_await client.call(target, uavcan::protocol::GetNodeInfo::Request());
+ *       ...
+ *       co_await uavcan_linux::sleep(node, uavcan::MonotonicDuration::fromMSec(100));
+ *   }
+ *
+ *   auto task = updateFirmware(*node, 42);
+ *   while (!task.isDone()) { node->spin(uavcan::MonotonicDuration::fromMSec(10)); }
+ *   task.rethrowIfFailed();
+ */
+class CoTask
+{
+public:
+    struct promise_type
+    {
+        std::exception_ptr exception;
+
+        CoTask get_return_object() { return CoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }   // The frame is destroyed by the owner
+        void return_void() { }
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit CoTask(std::coroutine_handle<promise_type> h) : handle_(h) { }
+
+public:
+    CoTask(CoTask&& rhs) noexcept : handle_(std::exchange(rhs.handle_, nullptr)) { }
+
+    CoTask& operator=(CoTask&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            handle_ = std::exchange(rhs.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() { reset(); }
+
+    void reset()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+
+    bool isDone() const { return !handle_ || handle_.done(); }
+
+    /**
+     * Rethrows the exception that has terminated the coroutine, if any.
+     */
+    void rethrowIfFailed() const
+    {
+        if (handle_ && handle_.done() && handle_.promise().exception)
+        {
+            std::rethrow_exception(handle_.promise().exception);
+        }
+    }
+};
+
+/**
+ * co_await sleep(node, duration) suspends the coroutine until the scheduler reaches the deadline.
+ * The deadline handler lives in the coroutine frame, so this does not allocate.
+ */
+class SleepAwaitable : private uavcan::DeadlineHandler
+{
+    const uavcan::MonotonicTime deadline_;
+    std::coroutine_handle<> waiter_;
+
+    void handleDeadline(uavcan::MonotonicTime) override { waiter_.resume(); }
+
+public:
+    SleepAwaitable(uavcan::INode& node, uavcan::MonotonicTime deadline)
+        : uavcan::DeadlineHandler(node.getScheduler())
+        , deadline_(deadline)
+    { }
+
+    bool await_ready() const { return false; }      // Even an expired deadline yields to the scheduler once
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        waiter_ = h;
+        startWithDeadline(deadline_);
+    }
+    void await_resume() { }
+};
+
+inline SleepAwaitable sleep(uavcan::INode& node, uavcan::MonotonicDuration duration)
+{
+    return SleepAwaitable(node, node.getMonotonicTime() + duration);
+}
+
+inline SleepAwaitable sleepUntil(uavcan::INode& node, uavcan::MonotonicTime deadline)
+{
+    return SleepAwaitable(node, deadline);
+}
+
+/**
+ * Subscriber that delivers messages to a coroutine: co_await sub.next() returns the next received message.
+ * Only one coroutine may wait on the subscriber at a time. The messages received while nobody is waiting
+ * are dropped, except the last one if keep_last is enabled, which is then returned by the next call to next()
+ * immediately.
+ * @throws uavcan_linux::Exception if the subscriber could not be started.
+ */
+template <typename DataType>
+class CoSubscriber : uavcan::Noncopyable
+{
+    typedef uavcan::ReceivedDataStructure<DataType> Message;
+    typedef uavcan::MethodBinder<CoSubscriber*, void (CoSubscriber::*)(const Message&)> Callback;
+
+    uavcan::Subscriber<DataType, Callback> sub_;
+    std::optional<DataType> last_;
+    std::coroutine_handle<> waiter_;
+    std::optional<DataType>* waiter_storage_ = nullptr;
+    const bool keep_last_;
+
+    void handleMessage(const Message& msg)
+    {
+        if (waiter_)
+        {
+            waiter_storage_->emplace(msg);
+            const std::coroutine_handle<> h = std::exchange(waiter_, nullptr);
+            waiter_storage_ = nullptr;
+            h.resume();                             // May call next() again
+        }
+        else if (keep_last_)
+        {
+            last_.emplace(msg);
+        }
+    }
+
+public:
+    class NextAwaitable
+    {
+        CoSubscriber& owner_;
+        std::optional<DataType> result_;
+        bool suspended_ = false;
+
+    public:
+        explicit NextAwaitable(CoSubscriber& owner) : owner_(owner) { }
+
+        ~NextAwaitable()
+        {
+            if (suspended_ && owner_.waiter_storage_ == &result_)     // The coroutine was cancelled
+            {
+                owner_.waiter_ = nullptr;
+                owner_.waiter_storage_ = nullptr;
+            }
+        }
+
+        bool await_ready()
+        {
+            if (owner_.last_)
+            {
+                result_ = std::move(owner_.last_);
+                owner_.last_.reset();
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            assert(!owner_.waiter_);                // Only one waiter is allowed
+            owner_.waiter_ = h;
+            owner_.waiter_storage_ = &result_;
+            suspended_ = true;
+        }
+
+        DataType await_resume() { return std::move(*result_); }
+    };
+
+    explicit CoSubscriber(uavcan::INode& node, bool keep_last = false)
+        : sub_(node)
+        , keep_last_(keep_last)
+    {
+        if (sub_.start(Callback(this, &CoSubscriber::handleMessage)) < 0)
+        {
+            throw Exception(std::string("CoSubscriber start failure ") + DataType::getDataTypeFullName());
+        }
+    }
+
+    NextAwaitable next() { return NextAwaitable(*this); }
+
+    uavcan::Subscriber<DataType, Callback>& getSubscriber() { return sub_; }
+};
+
+/**
+ * Outcome of a service call made via @ref CoServiceClient.
+ */
+template <typename DataType>
+struct CoServiceCallResult
+{
+    bool successful = false;                    ///< False if the call has timed out
+    typename DataType::Response response;       ///< Default constructed if the call was unsuccessful
+};
+
+/**
+ * Service client for coroutines: co_await client.call(server_node_id, request).
+ * Several coroutines may have calls in flight through the same client concurrently.
+ * The pending calls are tracked in an intrusive list of awaitables that live in the coroutine frames,
+ * so no allocation is needed besides the one of the underlying service client.
+ * @throws uavcan_linux::Exception if the client could not be initialized, or if the request could not be sent.
+ */
+template <typename DataType>
+class CoServiceClient : uavcan::Noncopyable
+{
+    typedef uavcan::ServiceCallResult<DataType> RawResult;
+    typedef uavcan::MethodBinder<CoServiceClient*, void (CoServiceClient::*)(const RawResult&)> Callback;
+
+public:
+    class CallAwaitable;
+
+private:
+    uavcan::ServiceClient<DataType, Callback> client_;
+    CallAwaitable* pending_ = nullptr;          ///< Singly linked list of the suspended calls
+
+    void unlink(CallAwaitable* a)
+    {
+        for (CallAwaitable** pp = &pending_; *pp != nullptr; pp = &(*pp)->next_)
+        {
+            if (*pp == a)
+            {
+                *pp = a->next_;
+                return;
+            }
+        }
+    }
+
+    void handleResult(const RawResult& res)
+    {
+        for (CallAwaitable* p = pending_; p != nullptr; p = p->next_)
+        {
+            if (p->call_id_ == res.getCallID())
+            {
+                unlink(p);
+                p->result_.successful = res.isSuccessful();
+                if (p->result_.successful)
+                {
+                    p->result_.response = res.getResponse();
+                }
+                p->waiter_.resume();                // The awaitable may be destroyed after this
+                return;
+            }
+        }
+    }
+
+public:
+    class CallAwaitable
+    {
+        friend class CoServiceClient;
+
+        CoServiceClient& owner_;
+        const uavcan::NodeID server_node_id_;
+        const typename DataType::Request& request_;
+        uavcan::ServiceCallID call_id_;
+        CoServiceCallResult<DataType> result_;
+        std::coroutine_handle<> waiter_;
+        CallAwaitable* next_ = nullptr;
+
+    public:
+        CallAwaitable(CoServiceClient& owner, uavcan::NodeID server_node_id,
+                      const typename DataType::Request& request)
+            : owner_(owner)
+            , server_node_id_(server_node_id)
+            , request_(request)
+        { }
+
+        ~CallAwaitable()
+        {
+            if (waiter_)                            // The coroutine was cancelled while the call was pending
+            {
+                owner_.unlink(this);
+                owner_.client_.cancelCall(call_id_);
+            }
+        }
+
+        bool await_ready() const { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            const int res = owner_.client_.call(server_node_id_, request_, call_id_);
+            if (res < 0)
+            {
+                throw Exception(std::string("CoServiceClient call failure ") + DataType::getDataTypeFullName());
+            }
+            waiter_ = h;
+            next_ = owner_.pending_;
+            owner_.pending_ = this;
+        }
+
+        CoServiceCallResult<DataType> await_resume()
+        {
+            waiter_ = nullptr;
+            return std::move(result_);
+        }
+    };
+
+    explicit CoServiceClient(uavcan::INode& node,
+                             uavcan::MonotonicDuration request_timeout =
+                                 uavcan::ServiceClient<DataType, Callback>::getDefaultRequestTimeout())
+        : client_(node)
+    {
+        if (client_.init() < 0)
+        {
+            throw Exception(std::string("CoServiceClient init failure ") + DataType::getDataTypeFullName());
+        }
+        client_.setCallback(Callback(this, &CoServiceClient::handleResult));
+        client_.setRequestTimeout(request_timeout);
+    }
+
+    /**
+     * The request is sent when the returned object is awaited; it must stay valid until then.
+     */
+    CallAwaitable call(uavcan::NodeID server_node_id, const typename DataType::Request& request)
+    {
+        return CallAwaitable(*this, server_node_id, request);
+    }
+
+    uavcan::ServiceClient<DataType, Callback>& getServiceClient() { return client_; }
+};
+
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <uavcan/driver/can.hpp>
+#include <uavcan/driver/system_clock.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Binary log of raw CAN frames, used by uavcan_capture and uavcan_replay.
+ *
+ * The file consists of a header followed by fixed-size records in host byte order, so that the file can be
+ * memory-mapped and indexed directly. The records are stored in the order of reception.
+ */
+struct FrameLogHeader
+{
+    static constexpr std::uint16_t CurrentVersion = 1;
+
+    char magic[8];                      ///< "UAVCANFL"
+    std::uint16_t version;
+    std::uint16_t record_size;
+    std::uint8_t num_ifaces;
+    std::uint8_t reserved[3];
+
+    FrameLogHeader()
+        : version(CurrentVersion)
+        , record_size(0)
+        , num_ifaces(0)
+        , reserved()
+    {
+        std::memcpy(magic, getMagic(), sizeof(magic));
+    }
+
+    static const char* getMagic() { return "UAVCANFL"; }
+
+    bool isValid() const
+    {
+        return (std::memcmp(magic, getMagic(), sizeof(magic)) == 0) && (version == CurrentVersion);
+    }
+};
+
+struct FrameLogRecord
+{
+    static constexpr std::uint8_t FlagLoopback = 1;
+
+    std::uint64_t ts_mono_usec;
+    std::uint64_t ts_utc_usec;
+    std::uint32_t id;                   ///< Including the flags, see uavcan::CanFrame
+    std::uint8_t dlc;
+    std::uint8_t iface_index;
+    std::uint8_t flags;
+    std::uint8_t reserved;
+    std::uint8_t data[8];
+
+    FrameLogRecord() { std::memset(this, 0, sizeof(*this)); }
+
+    FrameLogRecord(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags io_flags)
+    {
+        std::memset(this, 0, sizeof(*this));
+        ts_mono_usec = frame.ts_mono.toUSec();
+        ts_utc_usec = frame.ts_utc.toUSec();
+        id = frame.id;
+        dlc = frame.dlc;
+        iface_index = frame.iface_index;
+        flags = (io_flags & uavcan::CanIOFlagLoopback) ? FlagLoopback : 0;
+        std::memcpy(data, frame.data, sizeof(data));
+    }
+
+    uavcan::CanRxFrame toRxFrame() const
+    {
+        uavcan::CanRxFrame frame;
+        frame.id = id;
+        frame.dlc = dlc;
+        std::memcpy(frame.data, data, sizeof(data));
+        frame.ts_mono = uavcan::MonotonicTime::fromUSec(ts_mono_usec);
+        frame.ts_utc = uavcan::UtcTime::fromUSec(ts_utc_usec);
+        frame.iface_index = iface_index;
+        return frame;
+    }
+};
+
+static_assert(sizeof(FrameLogHeader) == 16, "Frame log header layout");
+static_assert(sizeof(FrameLogRecord) == 32, "Frame log record layout");
+
+/**
+ * Appends records to the log file. The records are buffered in memory and written in large chunks,
+ * so that the capture keeps up with a fully loaded bus.
+ */
+class FrameLogWriter : uavcan::Noncopyable
+{
+    int fd_;
+    std::vector<FrameLogRecord> buffer_;
+    std::uint64_t num_records_ = 0;
+
+    void writeAll(const void* data, std::size_t size)
+    {
+        const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+        while (size > 0)
+        {
+            const ssize_t res = ::write(fd_, p, size);
+            if (res <= 0)
+            {
+                throw Exception("Frame log write failure");
+            }
+            p += res;
+            size -= std::size_t(res);
+        }
+    }
+
+public:
+    static constexpr unsigned DefaultBufferSize = 32768;     ///< In records
+
+    /**
+     * The file is truncated if exists.
+     * @throws uavcan_linux::Exception.
+     */
+    FrameLogWriter(const std::string& path, std::uint8_t num_ifaces, unsigned buffer_size = DefaultBufferSize)
+        : fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    {
+        if (fd_ < 0)
+        {
+            throw Exception("Failed to open " + path);
+        }
+        buffer_.reserve(buffer_size);
+        FrameLogHeader hdr;
+        hdr.record_size = sizeof(FrameLogRecord);
+        hdr.num_ifaces = num_ifaces;
+        writeAll(&hdr, sizeof(hdr));
+    }
+
+    ~FrameLogWriter()
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+        (void)::close(fd_);
+    }
+
+    void append(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        buffer_.emplace_back(frame, flags);
+        num_records_++;
+        if (buffer_.size() >= buffer_.capacity())
+        {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (!buffer_.empty())
+        {
+            writeAll(buffer_.data(), buffer_.size() * sizeof(FrameLogRecord));
+            buffer_.clear();
+        }
+    }
+
+    std::uint64_t getNumRecords() const { return num_records_; }
+};
+
+/**
+ * Provides random access to the records of a log file via read-only memory mapping.
+ */
+class FrameLogReader : uavcan::Noncopyable
+{
+    void* map_ = MAP_FAILED;
+    std::size_t map_size_ = 0;
+    const FrameLogHeader* header_ = nullptr;
+    const FrameLogRecord* records_ = nullptr;
+    std::size_t num_records_ = 0;
+
+public:
+    /**
+     * @throws uavcan_linux::Exception.
+     */
+    explicit FrameLogReader(const std::string& path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw Exception("Failed to open " + path);
+        }
+        struct ::stat st;
+        if ((::fstat(fd, &st) < 0) || (std::size_t(st.st_size) < sizeof(FrameLogHeader)))
+        {
+            (void)::close(fd);
+            throw Exception("Invalid frame log " + path);
+        }
+        map_size_ = std::size_t(st.st_size);
+        map_ = ::mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        (void)::close(fd);
+        if (map_ == MAP_FAILED)
+        {
+            throw Exception("Failed to map " + path);
+        }
+        (void)::madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+        header_ = static_cast<const FrameLogHeader*>(map_);
+        if (!header_->isValid() || (header_->record_size != sizeof(FrameLogRecord)))
+        {
+            (void)::munmap(map_, map_size_);
+            throw Exception("Unsupported frame log format " + path);
+        }
+        records_ = reinterpret_cast<const FrameLogRecord*>(static_cast<const std::uint8_t*>(map_) +
+                                                           sizeof(FrameLogHeader));
+        num_records_ = (map_size_ - sizeof(FrameLogHeader)) / sizeof(FrameLogRecord);   // Tail may be truncated
+    }
+
+    ~FrameLogReader() { (void)::munmap(map_, map_size_); }
+
+    std::uint8_t getNumIfaces() const { return header_->num_ifaces; }
+    std::size_t getNumRecords() const { return num_records_; }
+    const FrameLogRecord& operator[](std::size_t index) const { return records_[index]; }
+};
+
+/**
+ * Feeds the frames from the log into the node at the original rate multiplied by the speed factor; zero speed
+ * factor means that the frames are delivered as fast as the node can accept them. The reception timestamps are
+ * replaced with the current time, because the node expects them to be consistent with its clock.
+ * Transmitted frames are accepted and counted, but go nowhere.
+ *
+ * The loopback frames that were recorded are skipped, because they were sent by the capturing node itself.
+ */
+class ReplayCanDriver : public uavcan::ICanDriver,
+                        uavcan::Noncopyable
+{
+    class Iface : public uavcan::ICanIface
+    {
+        ReplayCanDriver& owner_;
+        const std::uint8_t index_;
+
+    public:
+        std::uint64_t num_tx_frames = 0;
+
+        Iface(ReplayCanDriver& owner, std::uint8_t index) : owner_(owner), index_(index) { }
+
+        std::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags) override
+        {
+            num_tx_frames++;
+            return 1;
+        }
+
+        std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                             uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+        {
+            const FrameLogRecord* const rec = owner_.getDueRecord(index_);
+            if (rec == nullptr)
+            {
+                return 0;
+            }
+            const uavcan::CanRxFrame frame = rec->toRxFrame();
+            out_frame = frame;
+            out_ts_monotonic = owner_.clock_.getMonotonic();
+            out_ts_utc = frame.ts_utc;
+            out_flags = 0;
+            owner_.advance();
+            return 1;
+        }
+
+        std::int16_t configureFilters(const uavcan::CanFilterConfig*, std::uint16_t) override { return 0; }
+        std::uint16_t getNumFilters() const override { return 0; }
+        std::uint64_t getErrorCount() const override { return 0; }
+    };
+
+    const FrameLogReader& log_;
+    const uavcan::ISystemClock& clock_;
+    const double speed_;
+    std::vector<std::unique_ptr<Iface>> ifaces_;
+    std::size_t position_ = 0;
+    uavcan::MonotonicTime started_at_;
+
+    void skipLoopback()
+    {
+        while ((position_ < log_.getNumRecords()) && (log_[position_].flags & FrameLogRecord::FlagLoopback))
+        {
+            position_++;
+        }
+    }
+
+    void advance()
+    {
+        position_++;
+        skipLoopback();
+    }
+
+    uavcan::MonotonicTime getDueTime(const FrameLogRecord& rec) const
+    {
+        if (speed_ <= 0.0)
+        {
+            return started_at_;
+        }
+        const double offset_usec = double(rec.ts_mono_usec - log_[0].ts_mono_usec) / speed_;
+        return started_at_ + uavcan::MonotonicDuration::fromUSec(std::int64_t(offset_usec));
+    }
+
+    const FrameLogRecord* getDueRecord(std::uint8_t iface_index) const
+    {
+        if (isFinished())
+        {
+            return nullptr;
+        }
+        const FrameLogRecord& rec = log_[position_];
+        if ((rec.iface_index != iface_index) || (getDueTime(rec) > clock_.getMonotonic()))
+        {
+            return nullptr;
+        }
+        return &rec;
+    }
+
+public:
+    ReplayCanDriver(const FrameLogReader& log, const uavcan::ISystemClock& clock, double speed)
+        : log_(log)
+        , clock_(clock)
+        , speed_(speed)
+    {
+        const unsigned num_ifaces = std::max<unsigned>(1, std::min<unsigned>(log.getNumIfaces(),
+                                                                              uavcan::MaxCanIfaces));
+        for (unsigned i = 0; i < num_ifaces; i++)
+        {
+            ifaces_.emplace_back(new Iface(*this, std::uint8_t(i)));
+        }
+        skipLoopback();
+    }
+
+    /**
+     * The replay starts with the first call to select() after this one.
+     */
+    void restart()
+    {
+        position_ = 0;
+        started_at_ = uavcan::MonotonicTime();
+        skipLoopback();
+    }
+
+    bool isFinished() const { return position_ >= log_.getNumRecords(); }
+    std::size_t getPosition() const { return position_; }
+
+    std::uint64_t getNumTxFrames() const
+    {
+        std::uint64_t res = 0;
+        for (auto& i : ifaces_)
+        {
+            res += i->num_tx_frames;
+        }
+        return res;
+    }
+
+    uavcan::ICanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index < ifaces_.size()) ? ifaces_[iface_index].get() : nullptr;
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(ifaces_.size()); }
+
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks, const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override
+    {
+        if (started_at_.isZero())
+        {
+            started_at_ = clock_.getMonotonic();
+        }
+
+        const std::uint8_t write_mask = std::uint8_t(inout_masks.write & ((1U << ifaces_.size()) - 1U));
+        std::uint8_t read_mask = 0;
+        if (!isFinished() && (inout_masks.read & (1U << log_[position_].iface_index)))
+        {
+            const uavcan::MonotonicTime due = getDueTime(log_[position_]);
+            uavcan::MonotonicTime now = clock_.getMonotonic();
+            if ((due > now) && (write_mask == 0))           // Nothing to do until the next frame is due
+            {
+                const uavcan::MonotonicTime wake_at = std::min(due, blocking_deadline);
+                if (wake_at > now)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds((wake_at - now).toUSec()));
+                    now = clock_.getMonotonic();
+                }
+            }
+            if (due <= now)
+            {
+                read_mask = std::uint8_t(1U << log_[position_].iface_index);
+            }
+        }
+        else if ((write_mask == 0) && !blocking_deadline.isZero())
+        {
+            const uavcan::MonotonicTime now = clock_.getMonotonic();
+            if (blocking_deadline > now)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds((blocking_deadline - now).toUSec()));
+            }
+        }
+
+        inout_masks.read = read_mask;
+        inout_masks.write = write_mask;                     // Always ready to transmit
+        return std::int16_t(__builtin_popcount(unsigned(read_mask | write_mask)));
+    }
+};
+
+}
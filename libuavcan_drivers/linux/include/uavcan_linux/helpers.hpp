@@ -12,6 +12,7 @@
 #include <sstream>
 #include <uavcan/uavcan.hpp>
 #include <uavcan/node/sub_node.hpp>
+#include <uavcan/transport/can_acceptance_filter_configurator.hpp>
 
 namespace uavcan_linux
 {
@@ -32,6 +33,7 @@ class DefaultLogSink : public uavcan::ILogSink
 /**
  * Wrapper over uavcan::ServiceClient<> for blocking calls.
  * Blocks on uavcan::Node::spin() internally until the call is complete.
+ * It cannot be used if the node is spun by another thread; consider @ref AsyncServiceClient instead.
  */
 template <typename DataType>
 class BlockingServiceClient : public uavcan::ServiceClient<DataType>
@@ -171,6 +173,7 @@ class NodeBase : public NodeType
 {
 protected:
     DriverPackPtr driver_pack_;
+    std::unique_ptr<uavcan::CanAcceptanceFilterConfigurator> filter_configurator_;
 
     static void enforce(int error, const std::string& msg)
     {
@@ -296,6 +299,50 @@ public:
         return p;
     }
 
+    /**
+     * Makes the CAN driver drop the frames the node has no listeners for, so that with SocketCAN the unwanted
+     * frames are discarded by the kernel and never cross the syscall boundary. The filters are exact per data type
+     * as long as the driver reports enough of them, and they are kept up to date automatically as subscribers and
+     * servers come and go; refer to @ref uavcan::CanAcceptanceFilterConfigurator::enableAutomaticReconfiguration().
+     * While an RX frame listener is installed on the dispatcher, all frames are accepted.
+     * This is enabled by default for the nodes created with the SocketCAN driver.
+     * @throws uavcan_linux::Exception.
+     */
+    void enableKernelFrameFiltering()
+    {
+        if (!filter_configurator_)
+        {
+            std::unique_ptr<uavcan::CanAcceptanceFilterConfigurator> cfg(
+                new uavcan::CanAcceptanceFilterConfigurator(*this));
+            enforce(cfg->enableAutomaticReconfiguration(), "Failed to configure CAN filters");
+            filter_configurator_ = std::move(cfg);
+        }
+    }
+
+    /**
+     * Stops updating the filters and makes the driver accept all frames again.
+     * @throws uavcan_linux::Exception.
+     */
+    void disableKernelFrameFiltering()
+    {
+        if (filter_configurator_)
+        {
+            filter_configurator_.reset();
+            uavcan::ICanDriver& driver = this->getDispatcher().getCanIOManager().getCanDriver();
+            const uavcan::CanFilterConfig accept_all;
+            for (std::uint8_t i = 0; i < driver.getNumIfaces(); i++)
+            {
+                uavcan::ICanIface* const iface = driver.getIface(i);
+                if (iface != nullptr)
+                {
+                    enforce(iface->configureFilters(&accept_all, 1), "Failed to reset CAN filters");
+                }
+            }
+        }
+    }
+
+    bool isKernelFrameFilteringEnabled() const { return bool(filter_configurator_); }
+
     const DriverPackPtr& getDriverPack() const { return driver_pack_; }
     DriverPackPtr& getDriverPack() { return driver_pack_; }
 };
@@ -358,6 +405,7 @@ typedef std::shared_ptr<SubNode> SubNodePtr;
  * Use this function to create a node instance with default SocketCAN driver.
  * It accepts the list of interface names to use for the new node, e.g. "can1", "vcan2", "slcan0".
  * Clock adjustment mode will be detected automatically unless provided explicitly.
+ * Kernel frame filtering is enabled, see @ref NodeBase::enableKernelFrameFiltering().
  * @throws uavcan_linux::Exception.
  */
 static inline NodePtr makeNode(const std::vector<std::string>& iface_names,
@@ -365,7 +413,9 @@ static inline NodePtr makeNode(const std::vector<std::string>& iface_names,
                                    SystemClock::detectPreferredClockAdjustmentMode())
 {
     DriverPackPtr dp(new DriverPack(clock_adjustment_mode, iface_names));
-    return NodePtr(new Node(dp));
+    NodePtr node(new Node(dp));
+    node->enableKernelFrameFiltering();
+    return node;
 }
 
 /**
@@ -385,6 +435,7 @@ static inline NodePtr makeNode(const std::shared_ptr<uavcan::ICanDriver>& can_dr
  * Use this function to create a sub-node instance with default SocketCAN driver.
  * It accepts the list of interface names to use for the new node, e.g. "can1", "vcan2", "slcan0".
  * Clock adjustment mode will be detected automatically unless provided explicitly.
+ * Kernel frame filtering is enabled, see @ref NodeBase::enableKernelFrameFiltering().
  * @throws uavcan_linux::Exception.
  */
 static inline SubNodePtr makeSubNode(const std::vector<std::string>& iface_names,
@@ -392,7 +443,9 @@ static inline SubNodePtr makeSubNode(const std::vector<std::string>& iface_names
                                       SystemClock::detectPreferredClockAdjustmentMode())
 {
     DriverPackPtr dp(new DriverPack(clock_adjustment_mode, iface_names));
-    return SubNodePtr(new SubNode(dp));
+    SubNodePtr node(new SubNode(dp));
+    node->enableKernelFrameFiltering();
+    return node;
 }
 
 /**
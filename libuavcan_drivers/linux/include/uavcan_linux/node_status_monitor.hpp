@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <uavcan/protocol/node_status_monitor.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Node status monitor whose state can be read from any thread, e.g. by a GUI or a web server, without passing
+ * requests to the thread that spins the node.
+ *
+ * The node thread publishes every change of the monitor state into a table of atomics guarded by a sequence lock:
+ *  - Reading the status of one node is a single atomic load, it never waits.
+ *  - Reading a consistent snapshot of the whole table retries only if the node thread has published a change
+ *    while the table was being copied. Changes are rare (they are not published for every NodeStatus message,
+ *    only when the status of a node is different), so in practice the snapshot is taken on the first attempt.
+ *
+ * The methods of the base class remain node-thread-only. Subclasses that override @ref handleNodeStatusChange(),
+ * @ref handleNodeStatusMessage() or @ref handleNodeForgotten() must invoke the implementations of this class.
+ */
+class ConcurrentNodeStatusMonitor : public uavcan::NodeStatusMonitor
+{
+    static constexpr unsigned NumEntries = uavcan::NodeID::Max;
+
+    /// Bits 0..7 - NodeStatus, bit 8 - the node is known
+    static constexpr std::uint16_t KnownFlag = 1U << 8;
+
+    std::atomic<std::uint16_t> table_[NumEntries];
+    std::atomic<std::uint32_t> sequence_;           ///< Odd while the node thread is updating the table
+
+    static std::uint16_t pack(bool known, NodeStatus status)
+    {
+        return std::uint16_t((known ? KnownFlag : 0U) |
+                             unsigned(status.health) | (unsigned(status.mode) << 2) | (unsigned(status.sub_mode) << 5));
+    }
+
+    static NodeStatus unpackStatus(std::uint16_t packed)
+    {
+        NodeStatus status;
+        if (packed & KnownFlag)
+        {
+            status.health   = packed & 3U;
+            status.mode     = (packed >> 2) & 7U;
+            status.sub_mode = (packed >> 5) & 7U;
+        }
+        return status;                              // Unknown nodes are considered offline, same as in the base class
+    }
+
+    static bool isValidNodeID(uavcan::NodeID node_id) { return node_id.isUnicast(); }
+
+    void publish(uavcan::NodeID node_id, bool known, NodeStatus status)
+    {
+        std::atomic<std::uint16_t>& entry = table_[node_id.get() - 1U];
+        const std::uint16_t packed = pack(known, status);
+        if (entry.load(std::memory_order_relaxed) == packed)
+        {
+            return;
+        }
+        const std::uint32_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);        // Readers must see the odd value first
+        entry.store(packed, std::memory_order_relaxed);
+        sequence_.store(seq + 2U, std::memory_order_release);
+    }
+
+protected:
+    void handleNodeStatusChange(const NodeStatusChangeEvent& event) override
+    {
+        publish(event.node_id, true, event.status);
+    }
+
+    /**
+     * A node that has appeared with the default status does not trigger a status change, so the table is also
+     * updated here; nothing is published if the state has not changed.
+     */
+    void handleNodeStatusMessage(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>& msg) override
+    {
+        const uavcan::NodeID node_id = msg.getSrcNodeID();
+        publish(node_id, isNodeKnown(node_id), getNodeStatus(node_id));
+    }
+
+    void handleNodeForgotten(uavcan::NodeID node_id) override
+    {
+        publish(node_id, false, NodeStatus());
+    }
+
+public:
+    /**
+     * Consistent copy of the state of all nodes.
+     */
+    class Snapshot
+    {
+        friend class ConcurrentNodeStatusMonitor;
+
+        std::uint16_t table_[NumEntries];
+        std::uint32_t version_ = 0;
+
+    public:
+        Snapshot()
+        {
+            for (auto& x : table_)
+            {
+                x = 0;
+            }
+        }
+
+        /**
+         * Incremented with every change of the monitor state; equal versions mean equal snapshots.
+         */
+        std::uint32_t getVersion() const { return version_; }
+
+        bool isNodeKnown(uavcan::NodeID node_id) const
+        {
+            return isValidNodeID(node_id) && ((table_[node_id.get() - 1U] & KnownFlag) != 0);
+        }
+
+        NodeStatus getNodeStatus(uavcan::NodeID node_id) const
+        {
+            return isValidNodeID(node_id) ? unpackStatus(table_[node_id.get() - 1U]) : NodeStatus();
+        }
+
+        /**
+         * Same as @ref uavcan::NodeStatusMonitor::forEachNode().
+         */
+        template <typename Operator>
+        void forEachNode(Operator op) const
+        {
+            for (std::uint8_t i = 1; i <= NumEntries; i++)
+            {
+                if (table_[i - 1U] & KnownFlag)
+                {
+                    op(uavcan::NodeID(i), unpackStatus(table_[i - 1U]));
+                }
+            }
+        }
+    };
+
+    explicit ConcurrentNodeStatusMonitor(uavcan::INode& node)
+        : uavcan::NodeStatusMonitor(node)
+        , sequence_(0)
+    {
+        for (auto& x : table_)
+        {
+            x.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Any thread. Same as @ref uavcan::NodeStatusMonitor::getNodeStatus(), never waits.
+     */
+    NodeStatus getNodeStatusConcurrent(uavcan::NodeID node_id) const
+    {
+        return isValidNodeID(node_id) ?
+               unpackStatus(table_[node_id.get() - 1U].load(std::memory_order_relaxed)) : NodeStatus();
+    }
+
+    /**
+     * Any thread. Same as @ref uavcan::NodeStatusMonitor::isNodeKnown(), never waits.
+     */
+    bool isNodeKnownConcurrent(uavcan::NodeID node_id) const
+    {
+        return isValidNodeID(node_id) &&
+               ((table_[node_id.get() - 1U].load(std::memory_order_relaxed) & KnownFlag) != 0);
+    }
+
+    /**
+     * Any thread. Number of changes of the monitor state so far; a cheap way to find out whether the snapshot
+     * that was taken earlier is still up to date.
+     */
+    std::uint32_t getVersion() const { return sequence_.load(std::memory_order_acquire) / 2U; }
+
+    /**
+     * Any thread. Copies the state of all nodes; retries if a change was published during the copying.
+     */
+    void takeSnapshot(Snapshot& out_snapshot) const
+    {
+        while (true)
+        {
+            const std::uint32_t seq_before = sequence_.load(std::memory_order_acquire);
+            if ((seq_before & 1U) != 0)
+            {
+                continue;                           // The node thread is in the middle of an update
+            }
+            for (unsigned i = 0; i < NumEntries; i++)
+            {
+                out_snapshot.table_[i] = table_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == seq_before)
+            {
+                out_snapshot.version_ = seq_before / 2U;
+                return;
+            }
+        }
+    }
+
+    Snapshot takeSnapshot() const
+    {
+        Snapshot snapshot;
+        takeSnapshot(snapshot);
+        return snapshot;
+    }
+};
+
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <uavcan/dynamic_memory.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Thread-safe lock-free pool allocator.
+ * Unlike @ref uavcan::PoolAllocator<>, this one can be shared between components running in different threads,
+ * e.g. between several node instances, or between a node and the virtual CAN interfaces of its sub-nodes.
+ *
+ * The free list is a Treiber stack. Its head is a 64-bit word that contains the index of the top block and a
+ * modification tag that is incremented on every update, which prevents the ABA problem. The links between free
+ * blocks are stored in a separate array of atomics rather than in the blocks themselves, so the memory handed out
+ * to the application is never accessed by the allocator concurrently.
+ *
+ * All counters are updated with relaxed ordering, they are intended for diagnostics only.
+ */
+template <std::size_t PoolSize, std::uint8_t BlockSize = uavcan::MemPoolBlockSize>
+class ConcurrentPoolAllocator : public uavcan::IPoolAllocator,
+                                uavcan::Noncopyable
+{
+    static constexpr std::uint32_t NullIndex = 0xFFFFFFFFU;
+
+public:
+    static constexpr std::uint16_t NumBlocks = PoolSize / BlockSize;
+
+private:
+    static_assert(NumBlocks > 0, "Pool size must be large enough to fit at least one block");
+    static_assert(NumBlocks <= 0xFFFFU, "The limit is imposed by the return type of getNumBlocks()");
+    static_assert((BlockSize % uavcan::MemPoolAlignment) == 0, "Block size must be a multiple of alignment");
+
+    static std::uint64_t pack(std::uint32_t index, std::uint32_t tag)
+    {
+        return (std::uint64_t(tag) << 32) | index;
+    }
+    static std::uint32_t getIndex(std::uint64_t head) { return std::uint32_t(head & 0xFFFFFFFFU); }
+    static std::uint32_t getTag(std::uint64_t head)   { return std::uint32_t(head >> 32); }
+
+    alignas(uavcan::MemPoolAlignment) std::uint8_t pool_[NumBlocks * BlockSize];
+    std::atomic<std::uint32_t> next_[NumBlocks];
+    std::atomic<std::uint64_t> head_;
+
+    std::atomic<unsigned> used_;
+    std::atomic<unsigned> max_used_;
+    std::atomic<std::uint64_t> num_contentions_;
+    std::atomic<std::uint64_t> num_failures_;
+
+    void updatePeak(unsigned used)
+    {
+        unsigned peak = max_used_.load(std::memory_order_relaxed);
+        while (used > peak && !max_used_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) { }
+    }
+
+public:
+    ConcurrentPoolAllocator()
+        : head_(pack(0, 0))
+        , used_(0)
+        , max_used_(0)
+        , num_contentions_(0)
+        , num_failures_(0)
+    {
+        (void)std::memset(pool_, 0, sizeof(pool_));
+        for (unsigned i = 0; i < NumBlocks; i++)
+        {
+            next_[i].store(((i + 1U) < NumBlocks) ? (i + 1U) : NullIndex, std::memory_order_relaxed);
+        }
+    }
+
+    void* allocate(std::size_t size) override
+    {
+        if (size > BlockSize)
+        {
+            return nullptr;
+        }
+
+        std::uint64_t head = head_.load(std::memory_order_acquire);
+        for (;;)
+        {
+            const std::uint32_t index = getIndex(head);
+            if (index == NullIndex)
+            {
+                num_failures_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            // The link may be stale if the block is taken concurrently; the tag makes the CAS fail in that case
+            const std::uint32_t next = next_[index].load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, pack(next, getTag(head) + 1U),
+                                            std::memory_order_acquire, std::memory_order_acquire))
+            {
+                updatePeak(used_.fetch_add(1, std::memory_order_relaxed) + 1U);
+                return pool_ + std::size_t(index) * BlockSize;
+            }
+            num_contentions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void deallocate(const void* ptr) override
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+
+        const std::size_t offset = std::size_t(static_cast<const std::uint8_t*>(ptr) - pool_);
+        assert((offset < sizeof(pool_)) && ((offset % BlockSize) == 0));
+        const std::uint32_t index = std::uint32_t(offset / BlockSize);
+
+        std::uint64_t head = head_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            next_[index].store(getIndex(head), std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, pack(index, getTag(head) + 1U),
+                                            std::memory_order_release, std::memory_order_relaxed))
+            {
+                break;
+            }
+            num_contentions_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        assert(used_.load(std::memory_order_relaxed) > 0);
+        used_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::uint16_t getNumBlocks() const override { return NumBlocks; }
+
+    /**
+     * Return the number of blocks that are currently allocated/unallocated.
+     */
+    std::uint16_t getNumUsedBlocks() const { return std::uint16_t(used_.load(std::memory_order_relaxed)); }
+    std::uint16_t getNumFreeBlocks() const { return std::uint16_t(NumBlocks - getNumUsedBlocks()); }
+
+    /**
+     * Returns the maximum number of blocks that were ever allocated at the same time.
+     */
+    std::uint16_t getPeakNumUsedBlocks() const { return std::uint16_t(max_used_.load(std::memory_order_relaxed)); }
+
+    /**
+     * Number of times a thread had to retry an operation because the free list was modified concurrently.
+     */
+    std::uint64_t getNumContentions() const { return num_contentions_.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of allocation requests that could not be served because the pool was exhausted.
+     */
+    std::uint64_t getNumFailures() const { return num_failures_.load(std::memory_order_relaxed); }
+};
+
+template <std::size_t PoolSize, std::uint8_t BlockSize>
+constexpr std::uint16_t ConcurrentPoolAllocator<PoolSize, BlockSize>::NumBlocks;
+
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <uavcan/uavcan.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Settings for running a node on a real-time kernel (e.g. PREEMPT_RT), see @ref applyRealtimeConfig().
+ * Defaults do not require any privileges; the scheduling policy and the busy polling are not changed by default.
+ */
+struct RealtimeConfig
+{
+    /**
+     * CPU the calling thread will be pinned to; negative - the affinity is not changed.
+     */
+    int cpu = -1;
+
+    /**
+     * SCHED_FIFO priority of the calling thread, 1 to 99; zero - the scheduling policy is not changed.
+     * Requires CAP_SYS_NICE or an appropriate RLIMIT_RTPRIO.
+     */
+    int fifo_priority = 0;
+
+    /**
+     * Lock all current and future pages of the process in RAM with mlockall(). This also faults them in.
+     * Requires CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK.
+     */
+    bool lock_memory = true;
+
+    /**
+     * Touch every page of the node object, including its memory pool, and this much of the calling thread's stack,
+     * so that the pages are mapped before the node starts spinning.
+     */
+    std::size_t stack_prefault_size = 64 * 1024;
+
+    /**
+     * SO_BUSY_POLL value for the SocketCAN sockets of the node, microseconds; zero - not changed.
+     * Only makes a difference if the CAN controller driver supports busy polling. Requires CAP_NET_ADMIN.
+     */
+    unsigned busy_poll_usec = 0;
+};
+
+namespace impl_
+{
+
+inline void prefaultRange(void* ptr, std::size_t size)
+{
+    const std::size_t page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+    volatile std::uint8_t* const begin = static_cast<volatile std::uint8_t*>(ptr);
+    for (std::size_t offset = 0; offset < size; offset += page_size)
+    {
+        begin[offset] = begin[offset];      // Writing, so that the page is not mapped to the zero page
+    }
+    if (size > 0)
+    {
+        begin[size - 1] = begin[size - 1];
+    }
+}
+
+__attribute__((noinline))
+inline void prefaultStack(std::size_t size)
+{
+    volatile std::uint8_t* const buf = static_cast<volatile std::uint8_t*>(::alloca(size));
+    for (std::size_t i = 0; i < size; i++)
+    {
+        buf[i] = 0;
+    }
+}
+
+}
+
+/**
+ * Prepares the calling thread and the node for real-time operation; the thread is expected to spin the node.
+ * Call this after the node has been created, before it is started.
+ * @throws uavcan_linux::Exception if any of the settings could not be applied; the ones before it remain applied.
+ */
+template <typename NodeType>
+void applyRealtimeConfig(NodeType& node, const RealtimeConfig& config)
+{
+    if (config.lock_memory && (::mlockall(MCL_CURRENT | MCL_FUTURE) < 0))
+    {
+        throw Exception("mlockall() failed");
+    }
+
+    impl_::prefaultRange(&node, sizeof(node));
+    if (config.stack_prefault_size > 0)
+    {
+        impl_::prefaultStack(config.stack_prefault_size);
+    }
+
+    if (config.cpu >= 0)
+    {
+        ::cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        const int res = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus);
+        if (res != 0)
+        {
+            errno = res;
+            throw Exception("Failed to pin the thread to CPU " + std::to_string(config.cpu));
+        }
+    }
+
+    if (config.fifo_priority > 0)
+    {
+        auto param = ::sched_param();
+        param.sched_priority = config.fifo_priority;
+        const int res = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+        if (res != 0)
+        {
+            errno = res;
+            throw Exception("Failed to set SCHED_FIFO priority " + std::to_string(config.fifo_priority));
+        }
+    }
+
+    if (config.busy_poll_usec > 0)
+    {
+        uavcan::ICanDriver& driver = node.getDispatcher().getCanIOManager().getCanDriver();
+        for (std::uint8_t i = 0; i < driver.getNumIfaces(); i++)
+        {
+            const auto iface = dynamic_cast<const SocketCanIface*>(driver.getIface(i));
+            if (iface == nullptr)
+            {
+                continue;           // Not a socket, e.g. a virtual iface
+            }
+            const int value = int(config.busy_poll_usec);
+            if (::setsockopt(iface->getFileDescriptor(), SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) < 0)
+            {
+                throw Exception("Failed to set SO_BUSY_POLL on iface " + std::to_string(i));
+            }
+        }
+    }
+}
+
+/**
+ * Spins the node in a fixed-rate loop, like a control loop would, and measures how well the real-time settings
+ * work: every cycle the thread sleeps until the start of the next period with clock_nanosleep(), then processes
+ * everything the node has pending with spinOnce().
+ *
+ * The scheduling latency is the delay between the start of the period and the moment the thread actually woke up.
+ * Page faults are counted for the spinning thread; once the memory is locked and prefaulted, there should be none.
+ */
+template <typename NodeType>
+class RealtimeSpinner
+{
+public:
+    struct Statistics
+    {
+        std::uint64_t num_cycles = 0;
+        std::uint64_t num_overruns = 0;             ///< Cycles that took longer than the period
+        std::uint64_t num_spin_errors = 0;          ///< Negative results of spinOnce()
+        std::uint64_t latency_max_nsec = 0;
+        std::uint64_t latency_sum_nsec = 0;
+        std::uint64_t minor_page_faults = 0;
+        std::uint64_t major_page_faults = 0;
+
+        std::uint64_t getAverageLatencyNSec() const
+        {
+            return (num_cycles > 0) ? (latency_sum_nsec / num_cycles) : 0;
+        }
+    };
+
+private:
+    NodeType& node_;
+    const std::uint64_t period_nsec_;
+    Statistics stats_;
+
+    static std::uint64_t getTimeNSec()
+    {
+        auto ts = ::timespec();
+        (void)::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return std::uint64_t(ts.tv_sec) * 1000000000ULL + std::uint64_t(ts.tv_nsec);
+    }
+
+    static void getPageFaults(std::uint64_t& out_minor, std::uint64_t& out_major)
+    {
+        auto usage = ::rusage();
+        (void)::getrusage(RUSAGE_THREAD, &usage);
+        out_minor = std::uint64_t(usage.ru_minflt);
+        out_major = std::uint64_t(usage.ru_majflt);
+    }
+
+public:
+    /**
+     * @throws uavcan_linux::Exception if the period is not positive.
+     */
+    RealtimeSpinner(NodeType& node, uavcan::MonotonicDuration period)
+        : node_(node)
+        , period_nsec_(std::uint64_t(std::max<std::int64_t>(period.toUSec(), 0)) * 1000ULL)
+    {
+        if (period_nsec_ == 0)
+        {
+            throw Exception("Invalid spin period");
+        }
+    }
+
+    /**
+     * Spins for the specified duration; the statistics are accumulated across calls.
+     */
+    void spin(uavcan::MonotonicDuration duration)
+    {
+        std::uint64_t minflt_before = 0;
+        std::uint64_t majflt_before = 0;
+        getPageFaults(minflt_before, majflt_before);
+
+        std::uint64_t next_cycle = getTimeNSec();
+        const std::uint64_t end = next_cycle + std::uint64_t(std::max<std::int64_t>(duration.toUSec(), 0)) * 1000ULL;
+
+        while (next_cycle < end)
+        {
+            auto ts = ::timespec();
+            ts.tv_sec  = time_t(next_cycle / 1000000000ULL);
+            ts.tv_nsec = long(next_cycle % 1000000000ULL);
+            while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) { }
+
+            const std::uint64_t woke_up = getTimeNSec();
+            const std::uint64_t latency = (woke_up > next_cycle) ? (woke_up - next_cycle) : 0;
+            stats_.latency_max_nsec = std::max(stats_.latency_max_nsec, latency);
+            stats_.latency_sum_nsec += latency;
+            stats_.num_cycles++;
+
+            if (node_.spinOnce() < 0)
+            {
+                stats_.num_spin_errors++;
+            }
+
+            next_cycle += period_nsec_;
+            const std::uint64_t now = getTimeNSec();
+            if (now > next_cycle)
+            {
+                stats_.num_overruns++;
+                next_cycle += ((now - next_cycle) / period_nsec_ + 1) * period_nsec_;     // Skipping missed cycles
+            }
+        }
+
+        std::uint64_t minflt_after = 0;
+        std::uint64_t majflt_after = 0;
+        getPageFaults(minflt_after, majflt_after);
+        stats_.minor_page_faults += minflt_after - minflt_before;
+        stats_.major_page_faults += majflt_after - majflt_before;
+    }
+
+    const Statistics& getStatistics() const { return stats_; }
+
+    void resetStatistics() { stats_ = Statistics(); }
+};
+
+}
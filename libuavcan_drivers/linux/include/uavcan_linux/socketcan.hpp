@@ -6,10 +6,8 @@
 
 #include <cassert>
 #include <cstdint>
-#include <queue>
 #include <vector>
 #include <map>
-#include <unordered_set>
 #include <algorithm>
 
 #include <fcntl.h>
@@ -18,7 +16,13 @@
 #include <net/if.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <linux/sockios.h>
+#include <linux/ethtool.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <uavcan/uavcan.hpp>
 #include <uavcan_linux/clock.hpp>
@@ -36,6 +40,17 @@ enum class SocketCanError
     TxTimeout
 };
 
+/**
+ * Origin of the UTC timestamps of received frames, see @ref SocketCanIface::getRxTimestampSource().
+ */
+enum class RxTimestampSource
+{
+    Unknown,            ///< Nothing has been received yet
+    SoTimestamp,        ///< Kernel software timestamp via SO_TIMESTAMP, microsecond resolution
+    KernelSoftware,     ///< Kernel software timestamp via SO_TIMESTAMPING, nanosecond resolution
+    Hardware            ///< CAN controller timestamp via SO_TIMESTAMPING
+};
+
 /**
  * Single SocketCAN socket interface.
  *
@@ -46,19 +61,63 @@ enum class SocketCanError
  *
  * This approach allows to properly maintain TX timeouts (http://stackoverflow.com/questions/19633015/).
  * TX timestamping is implemented by means of reading RX timestamps of loopback frames (see "TX timestamping" on
- * linux-can mailing list, http://permalink.gmane.org/gmane.linux.can/5322).
+ * linux-can mailing list, http://permalink.gmane.org/gmane.linux.can/5322). If the CAN controller supports hardware
+ * TX timestamping, the loopback frames carry the hardware TX timestamps reported via the socket error queue instead,
+ * which are free from the jitter of the kernel loopback path.
  *
  * Note that if max_frames_in_socket_tx_queue_ is greater than one, frame reordering may occur (depending on the
  * unrderlying logic).
+ * The limit can also be adjusted automatically by the observed loopback latency, see @ref setTxQueueTargetLatency().
+ *
+ * All queues have fixed capacity and are allocated once, upon construction, so that the TX/RX path never touches
+ * the heap. If the user space TX queue is full, send() returns zero; if the RX queue is full, the frames are left
+ * in the socket buffer until the application reads some.
  *
  * This class is too complex and needs to be refactored later. At least, basic socket IO and configuration
  * should be extracted into a different class.
  */
 class SocketCanIface : public uavcan::ICanIface
 {
-    static inline ::can_frame makeSocketCanFrame(const uavcan::CanFrame& uavcan_frame)
+    /**
+     * Up to this number of frames can be transferred to or from the socket with a single system call.
+     */
+    static constexpr unsigned MaxFramesPerSyscall = 32;
+
+public:
+    static constexpr unsigned TxQueueCapacity = 512;
+    static constexpr unsigned RxQueueCapacity = 512;
+
+private:
+
+    /**
+     * If CAN FD is supported, the CAN FD frame structure is used for all frames; the classic frames are sent and
+     * received in its first CAN_MTU bytes, which have the same layout as the classic frame structure.
+     */
+#if UAVCAN_SUPPORT_CANFD
+    typedef ::canfd_frame SocketCanFrame;
+
+    static unsigned getSocketCanFrameSize(const uavcan::CanFrame& frame)
     {
-        ::can_frame sockcan_frame { uavcan_frame.id & uavcan::CanFrame::MaskExtID, uavcan_frame.dlc, { } };
+        return frame.isCanFD() ? CANFD_MTU : CAN_MTU;
+    }
+    static bool isValidSocketCanFrameSize(unsigned size) { return (size == CAN_MTU) || (size == CANFD_MTU); }
+#else
+    typedef ::can_frame SocketCanFrame;
+
+    static unsigned getSocketCanFrameSize(const uavcan::CanFrame&) { return CAN_MTU; }
+    static bool isValidSocketCanFrameSize(unsigned size) { return size == CAN_MTU; }
+#endif
+
+    static inline SocketCanFrame makeSocketCanFrame(const uavcan::CanFrame& uavcan_frame)
+    {
+        auto sockcan_frame = SocketCanFrame();
+        sockcan_frame.can_id = uavcan_frame.id & uavcan::CanFrame::MaskExtID;
+#if UAVCAN_SUPPORT_CANFD
+        sockcan_frame.len = uavcan_frame.dlc;
+        sockcan_frame.flags = uavcan_frame.isCanFD() ? CANFD_BRS : 0;     // Bit rate switch is used if configured
+#else
+        sockcan_frame.can_dlc = uavcan_frame.dlc;
+#endif
         (void)std::copy(uavcan_frame.data, uavcan_frame.data + uavcan_frame.dlc, sockcan_frame.data);
         if (uavcan_frame.isExtended())
         {
@@ -75,9 +134,21 @@ class SocketCanIface : public uavcan::ICanIface
         return sockcan_frame;
     }
 
-    static inline uavcan::CanFrame makeUavcanFrame(const ::can_frame& sockcan_frame)
+    /**
+     * @param size      Number of bytes received, refer to @ref isValidSocketCanFrameSize().
+     */
+    static inline uavcan::CanFrame makeUavcanFrame(const SocketCanFrame& sockcan_frame, unsigned size)
     {
+#if UAVCAN_SUPPORT_CANFD
+        const bool canfd = size == CANFD_MTU;
+        const std::uint8_t max_len = canfd ? uavcan::CanFrame::MaxDataLen : uavcan::CanFrame::MaxClassicDataLen;
+        uavcan::CanFrame uavcan_frame(sockcan_frame.can_id & CAN_EFF_MASK, sockcan_frame.data,
+                                      std::min(sockcan_frame.len, max_len));
+        uavcan_frame.canfd = canfd;
+#else
+        (void)size;
         uavcan::CanFrame uavcan_frame(sockcan_frame.can_id & CAN_EFF_MASK, sockcan_frame.data, sockcan_frame.can_dlc);
+#endif
         if (sockcan_frame.can_id & CAN_EFF_FLAG)
         {
             uavcan_frame.id |= uavcan::CanFrame::FlagEFF;
@@ -100,6 +171,8 @@ class SocketCanIface : public uavcan::ICanIface
         uavcan::CanIOFlags flags = 0;
         std::uint64_t order = 0;
 
+        TxItem() { }
+
         TxItem(const uavcan::CanFrame& arg_frame, uavcan::MonotonicTime arg_deadline,
                uavcan::CanIOFlags arg_flags, std::uint64_t arg_order)
             : frame(arg_frame)
@@ -128,39 +201,340 @@ class SocketCanIface : public uavcan::ICanIface
         uavcan::MonotonicTime ts_mono;
         uavcan::UtcTime ts_utc;
         uavcan::CanIOFlags flags;
+        RxTimestampSource ts_source;
 
         RxItem()
             : flags(0)
+            , ts_source(RxTimestampSource::Unknown)
         { }
     };
 
+    /**
+     * Binary heap on top of a preallocated array. The top element has the highest priority.
+     */
+    class TxQueue
+    {
+        const unsigned capacity_;
+        std::vector<TxItem> heap_;
+
+    public:
+        explicit TxQueue(unsigned capacity)
+            : capacity_(capacity)
+        {
+            heap_.reserve(capacity_);
+        }
+
+        bool empty() const { return heap_.empty(); }
+        bool full()  const { return heap_.size() >= capacity_; }
+
+        const TxItem& top() const
+        {
+            assert(!empty());
+            return heap_.front();
+        }
+
+        void pop()
+        {
+            assert(!empty());
+            std::pop_heap(heap_.begin(), heap_.end());
+            heap_.pop_back();
+        }
+
+        bool push(const TxItem& item)
+        {
+            if (full())
+            {
+                return false;
+            }
+            heap_.push_back(item);
+            std::push_heap(heap_.begin(), heap_.end());
+            return true;
+        }
+    };
+
+    /**
+     * FIFO ring buffer on top of a preallocated array.
+     */
+    class RxQueue
+    {
+        const unsigned capacity_;
+        std::vector<RxItem> buf_;
+        unsigned head_ = 0;
+        unsigned size_ = 0;
+
+    public:
+        explicit RxQueue(unsigned capacity)
+            : capacity_(capacity)
+            , buf_(capacity)
+        {
+            assert(capacity_ > 0);
+        }
+
+        bool empty() const { return size_ == 0; }
+        unsigned getNumFreeSlots() const { return capacity_ - size_; }
+
+        const RxItem& front() const
+        {
+            assert(!empty());
+            return buf_[head_];
+        }
+
+        void pop()
+        {
+            assert(!empty());
+            head_ = (head_ + 1) % capacity_;
+            size_--;
+        }
+
+        bool push(const RxItem& item)
+        {
+            if (size_ >= capacity_)
+            {
+                return false;
+            }
+            buf_[(head_ + size_) % capacity_] = item;
+            size_++;
+            return true;
+        }
+    };
+
+    /**
+     * IDs of the frames whose loopback must be delivered to the library; duplicates are allowed.
+     * The number of entries cannot exceed the number of frames in the socket TX queue, which is small,
+     * so linear search is the fastest option here.
+     */
+    class PendingLoopbackIdSet
+    {
+        const unsigned capacity_;
+        std::vector<std::uint32_t> ids_;
+
+    public:
+        explicit PendingLoopbackIdSet(unsigned capacity)
+            : capacity_(capacity)
+        {
+            ids_.reserve(capacity_);
+        }
+
+        bool insert(std::uint32_t id)
+        {
+            if (ids_.size() >= capacity_)
+            {
+                return false;
+            }
+            ids_.push_back(id);
+            return true;
+        }
+
+        /**
+         * Removes one entry with the given ID, if there is any.
+         * @return True if the ID has been found.
+         */
+        bool take(std::uint32_t id)
+        {
+            const auto it = std::find(ids_.begin(), ids_.end(), id);
+            if (it == ids_.end())
+            {
+                return false;
+            }
+            *it = ids_.back();
+            ids_.pop_back();
+            return true;
+        }
+
+        bool contains(std::uint32_t id) const
+        {
+            return std::find(ids_.begin(), ids_.end(), id) != ids_.end();
+        }
+    };
+
+    /**
+     * Hardware TX timestamps of the frames whose loopback is pending, in the order of transmission.
+     * The kernel reports them via the socket error queue, separately from the loopback frames themselves.
+     */
+    class TxTimestampQueue
+    {
+        struct Entry
+        {
+            std::uint32_t id;
+            uavcan::UtcTime ts;
+        };
+
+        const unsigned capacity_;
+        std::vector<Entry> entries_;
+
+    public:
+        explicit TxTimestampQueue(unsigned capacity)
+            : capacity_(capacity)
+        {
+            entries_.reserve(capacity_);
+        }
+
+        void push(std::uint32_t id, uavcan::UtcTime ts)
+        {
+            if (capacity_ == 0)
+            {
+                return;
+            }
+            if (entries_.size() >= capacity_)
+            {
+                entries_.erase(entries_.begin());       // The loopback of the oldest one must have been lost
+            }
+            entries_.push_back(Entry{ id, ts });
+        }
+
+        /**
+         * Removes the oldest entry with the given ID, if there is any.
+         * @return True if the ID has been found.
+         */
+        bool take(std::uint32_t id, uavcan::UtcTime& out_ts)
+        {
+            const auto it = std::find_if(entries_.begin(), entries_.end(),
+                                         [id](const Entry& e) { return e.id == id; });
+            if (it == entries_.end())
+            {
+                return false;
+            }
+            out_ts = it->ts;
+            entries_.erase(it);
+            return true;
+        }
+    };
+
+    /**
+     * Adjusts the number of frames allowed in the socket TX queue by the loopback latency, i.e. the time from
+     * writing a frame into the socket until its loopback is read, which is dominated by the time the frame spends
+     * in the kernel queue behind the frames written before it. That is also how long a high-priority frame may
+     * be blocked by the lower-priority frames already in the socket, since the kernel doesn't reorder them.
+     *
+     * The limit is additively increased while the latency stays within the target and the frames are waiting in
+     * the user space TX queue (i.e. the throughput is limited by the depth), and halved once per window of frames
+     * in flight when the latency exceeds the target, like the TCP congestion control does.
+     * The frames are expected to be confirmed in the order of transmission, so their send times are kept in a FIFO.
+     */
+    class TxQueueDepthController
+    {
+        const unsigned max_depth_;
+        std::vector<uavcan::MonotonicTime> sent_at_;    ///< Ring buffer, one entry per frame in the socket
+        unsigned head_ = 0;
+        unsigned size_ = 0;
+
+        uavcan::MonotonicDuration target_latency_;      ///< Zero if the depth is fixed
+        unsigned depth_;
+        unsigned num_good_confirmations_ = 0;
+        unsigned num_confirmations_until_decrease_ = 0;
+        uavcan::MonotonicDuration last_latency_;
+
+    public:
+        explicit TxQueueDepthController(unsigned max_depth)
+            : max_depth_(max_depth)
+            , sent_at_(max_depth)
+            , depth_(max_depth)
+        {
+            assert(max_depth_ > 0);
+        }
+
+        void setTargetLatency(uavcan::MonotonicDuration latency)
+        {
+            target_latency_ = latency;
+            depth_ = latency.isZero() ? max_depth_ : 1U;
+            num_good_confirmations_ = 0;
+            num_confirmations_until_decrease_ = 0;
+        }
+
+        uavcan::MonotonicDuration getTargetLatency() const { return target_latency_; }
+
+        unsigned getDepth() const { return depth_; }
+
+        uavcan::MonotonicDuration getLastLatency() const { return last_latency_; }
+
+        void handleSent(uavcan::MonotonicTime ts)
+        {
+            assert(size_ < max_depth_);
+            sent_at_[(head_ + size_) % max_depth_] = ts;
+            size_++;
+        }
+
+        /**
+         * @param backlog       Whether there are frames waiting for the socket TX queue.
+         */
+        void handleConfirmed(uavcan::MonotonicTime ts, bool backlog)
+        {
+            if (size_ == 0)
+            {
+                return;
+            }
+            last_latency_ = ts - sent_at_[head_];
+            head_ = (head_ + 1) % max_depth_;
+            size_--;
+
+            if (target_latency_.isZero())
+            {
+                return;
+            }
+            if (num_confirmations_until_decrease_ > 0)
+            {
+                num_confirmations_until_decrease_--;
+            }
+
+            if (last_latency_ > target_latency_)
+            {
+                num_good_confirmations_ = 0;
+                // The frames that are still in the socket were written under the old limit
+                if ((num_confirmations_until_decrease_ == 0) && (depth_ > 1))
+                {
+                    depth_ = std::max(depth_ / 2U, 1U);
+                    num_confirmations_until_decrease_ = size_;
+                }
+            }
+            else if (backlog && (depth_ < max_depth_))
+            {
+                num_good_confirmations_++;
+                if (num_good_confirmations_ >= depth_)
+                {
+                    depth_++;
+                    num_good_confirmations_ = 0;
+                }
+            }
+        }
+    };
+
     const SystemClock& clock_;
     const int fd_;
+    const bool tx_hw_timestamping_;             ///< Whether the error queue delivers hardware TX timestamps
 
     const unsigned max_frames_in_socket_tx_queue_;
     unsigned frames_in_socket_tx_queue_ = 0;
+    TxQueueDepthController tx_queue_depth_;
 
     std::uint64_t tx_frame_counter_ = 0;        ///< Increments with every frame pushed into the TX queue
 
+    bool async_rx_ = false;
+
     std::map<SocketCanError, std::uint64_t> errors_;
 
-    std::priority_queue<TxItem> tx_queue_;                          // TODO: Use pool allocator
-    std::queue<RxItem> rx_queue_;                                   // TODO: Use pool allocator
-    std::unordered_multiset<std::uint32_t> pending_loopback_ids_;   // TODO: Use pool allocator
+    RxTimestampSource rx_ts_source_ = RxTimestampSource::Unknown;
+    RxTimestampSource tx_ts_source_ = RxTimestampSource::Unknown;
+
+    TxQueue tx_queue_;
+    RxQueue rx_queue_;
+    PendingLoopbackIdSet pending_loopback_ids_;
+    TxTimestampQueue tx_timestamps_;
 
     void registerError(SocketCanError e) { errors_[e]++; }
 
-    void incrementNumFramesInSocketTxQueue()
+    void incrementNumFramesInSocketTxQueue(uavcan::MonotonicTime ts)
     {
         assert(frames_in_socket_tx_queue_ < max_frames_in_socket_tx_queue_);
         frames_in_socket_tx_queue_++;
+        tx_queue_depth_.handleSent(ts);
     }
 
-    void confirmSentFrame()
+    void confirmSentFrame(uavcan::MonotonicTime ts)
     {
         if (frames_in_socket_tx_queue_ > 0)
         {
             frames_in_socket_tx_queue_--;
+            tx_queue_depth_.handleConfirmed(ts, !tx_queue_.empty());
         }
         else
         {
@@ -170,27 +544,151 @@ class SocketCanIface : public uavcan::ICanIface
 
     bool wasInPendingLoopbackSet(const uavcan::CanFrame& frame)
     {
-        if (pending_loopback_ids_.count(frame.id) > 0)
+        return pending_loopback_ids_.take(frame.id);
+    }
+
+    /**
+     * Sends the frames with one sendmmsg() call.
+     * @return Number of frames accepted by the socket, starting from the first one; negative on error.
+     */
+    int write(const TxItem* const items, const unsigned num_items) const
+    {
+        assert(num_items <= MaxFramesPerSyscall);
+
+        SocketCanFrame sockcan_frames[MaxFramesPerSyscall];
+        ::iovec iovs[MaxFramesPerSyscall];
+        ::mmsghdr msgs[MaxFramesPerSyscall];
+
+        for (unsigned i = 0; i < num_items; i++)
         {
-            (void)pending_loopback_ids_.erase(frame.id);
-            return true;
+            sockcan_frames[i] = makeSocketCanFrame(items[i].frame);
+            iovs[i] = ::iovec();
+            iovs[i].iov_base = &sockcan_frames[i];
+            iovs[i].iov_len  = getSocketCanFrameSize(items[i].frame);
+            msgs[i] = ::mmsghdr();
+            msgs[i].msg_hdr.msg_iov    = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int res = ::sendmmsg(fd_, msgs, num_items, MSG_DONTWAIT);
+        if (res <= 0)
+        {
+            return (res < 0) ? res : -1;
+        }
+        for (int i = 0; i < res; i++)
+        {
+            if (msgs[i].msg_len != iovs[i].iov_len)
+            {
+                return i;               // Partially written frame, treated as failed
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Hardware timestamps that differ from the kernel software timestamps more than this are assumed to be
+     * in a different time domain (e.g. time since the controller was powered on) and are not used.
+     */
+    static uavcan::UtcDuration getMaxHardwareTimestampError() { return uavcan::UtcDuration::fromMSec(100); }
+
+    static bool isTxHardwareTimestampingEnabled(int socket_fd)
+    {
+        int flags = 0;
+        ::socklen_t len = sizeof(flags);
+        if (::getsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, &len) < 0)
+        {
+            return false;
+        }
+        return (flags & SOF_TIMESTAMPING_TX_HARDWARE) != 0;
+    }
+
+    static std::uint64_t toUSec(const ::timespec& ts)
+    {
+        return std::uint64_t(ts.tv_sec) * 1000000ULL + std::uint64_t(ts.tv_nsec) / 1000ULL;
+    }
+
+    /**
+     * Extracts the best RX timestamp available from the control messages.
+     * @return False if the message contains no timestamp.
+     */
+    static bool parseTimestamp(const ::msghdr& msg, uavcan::UtcTime& out_ts, RxTimestampSource& out_source)
+    {
+        for (const ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(const_cast< ::msghdr*>(&msg), const_cast< ::cmsghdr*>(cmsg)))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET)
+            {
+                continue;
+            }
+            if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+            {
+                // [0] - software, [1] - deprecated, [2] - raw hardware
+                auto tss = ::scm_timestamping();
+                (void)std::memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));  // Copy to avoid alignment problems
+                const auto sw = uavcan::UtcTime::fromUSec(toUSec(tss.ts[0]));
+                const auto hw = uavcan::UtcTime::fromUSec(toUSec(tss.ts[2]));
+                if (!hw.isZero() && (sw.isZero() || (hw - sw).getAbs() < getMaxHardwareTimestampError()))
+                {
+                    out_ts = hw;
+                    out_source = RxTimestampSource::Hardware;
+                    return true;
+                }
+                if (!sw.isZero())
+                {
+                    out_ts = sw;
+                    out_source = RxTimestampSource::KernelSoftware;
+                    return true;
+                }
+            }
+            else if (cmsg->cmsg_type == SO_TIMESTAMP)
+            {
+                auto tv = ::timeval();
+                (void)std::memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));  // Copy to avoid alignment problems
+                assert(tv.tv_sec >= 0 && tv.tv_usec >= 0);
+                out_ts = uavcan::UtcTime::fromUSec(std::uint64_t(tv.tv_sec) * 1000000ULL + tv.tv_usec);
+                out_source = RxTimestampSource::SoTimestamp;
+                return true;
+            }
         }
         return false;
     }
 
-    int write(const uavcan::CanFrame& frame) const
+    struct RxControl
     {
-        const ::can_frame sockcan_frame = makeSocketCanFrame(frame);
-        const int res = ::write(fd_, &sockcan_frame, sizeof(sockcan_frame));
-        if (res <= 0)
+        alignas(::cmsghdr) std::uint8_t data[CMSG_SPACE(sizeof(::scm_timestamping))];
+    };
+
+    static void initRxMessage(SocketCanFrame& frame, ::iovec& iov, RxControl& control, ::msghdr& msg)
+    {
+        iov = ::iovec();
+        iov.iov_base = &frame;
+        iov.iov_len  = sizeof(SocketCanFrame);
+        control = RxControl();
+        msg = ::msghdr();
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = &control;
+        msg.msg_controllen = sizeof(RxControl);
+    }
+
+    /**
+     * Converts a message received from the socket; the monotonic timestamp is not filled in.
+     * @return False if the message is malformed.
+     */
+    static bool parseRxMessage(const ::msghdr& msg, const SocketCanFrame& sockcan_frame, unsigned size,
+                               RxItem& out_rx)
+    {
+        if (!isValidSocketCanFrameSize(size))
         {
-            return res;
+            return false;
         }
-        if (res != sizeof(sockcan_frame))
+        out_rx.frame = makeUavcanFrame(sockcan_frame, size);
+        if (!parseTimestamp(msg, out_rx.ts_utc, out_rx.ts_source))
         {
-            return -1;
+            return false;
         }
-        return 1;
+        out_rx.flags = ((msg.msg_flags & static_cast<int>(MSG_CONFIRM)) != 0) ? uavcan::CanIOFlagLoopback : 0;
+        return true;
     }
 
     /**
@@ -199,109 +697,241 @@ class SocketCanIface : public uavcan::ICanIface
      *    MSG_CONFIRM is set for any pakcet of your socket.
      * Diff: https://git.ucsd.edu/abuss/linux/commit/1e55659ce6ddb5247cee0b1f720d77a799902b85
      * Man: https://www.kernel.org/doc/Documentation/networking/can.txt (chapter 4.1.6).
+     *
+     * Reads up to max_items frames with one recvmmsg() call; the monotonic timestamp is not filled in.
+     * @return Number of frames read, 0 if there's nothing to read, negative on error.
      */
-    int read(uavcan::CanFrame& frame, uavcan::UtcTime& ts_utc, bool& loopback) const
+    int read(RxItem* const out_items, const unsigned max_items) const
     {
-        auto iov = ::iovec();
-        auto sockcan_frame = ::can_frame();
-        iov.iov_base = &sockcan_frame;
-        iov.iov_len  = sizeof(sockcan_frame);
+        assert(max_items <= MaxFramesPerSyscall);
+
+        SocketCanFrame sockcan_frames[MaxFramesPerSyscall];
+        ::iovec iovs[MaxFramesPerSyscall];
+        RxControl controls[MaxFramesPerSyscall];
+        ::mmsghdr msgs[MaxFramesPerSyscall];
+
+        for (unsigned i = 0; i < max_items; i++)
+        {
+            initRxMessage(sockcan_frames[i], iovs[i], controls[i], msgs[i].msg_hdr);
+        }
 
+        const int res = ::recvmmsg(fd_, msgs, max_items, MSG_DONTWAIT, nullptr);
+        if (res <= 0)
+        {
+            return (res < 0 && errno == EWOULDBLOCK) ? 0 : res;
+        }
+
+        for (int i = 0; i < res; i++)
+        {
+            if (!parseRxMessage(msgs[i].msg_hdr, sockcan_frames[i], msgs[i].msg_len, out_items[i]))
+            {
+                assert(0);
+                return -1;
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Drains the socket error queue, where the kernel reports the hardware TX timestamps of the sent frames.
+     * Only the timestamps of the frames whose loopback is pending are kept; the rest are discarded.
+     */
+    void readTxTimestamps()
+    {
         struct Control
         {
-            cmsghdr cm;
-            std::uint8_t data[sizeof(::timeval)];
+            alignas(::cmsghdr) std::uint8_t data[CMSG_SPACE(sizeof(::scm_timestamping)) +
+                                                 CMSG_SPACE(sizeof(::sock_extended_err))];
         };
-        auto control = Control();
 
-        auto msg = ::msghdr();
-        msg.msg_iov    = &iov;
-        msg.msg_iovlen = 1;
-        msg.msg_control = &control;
-        msg.msg_controllen = sizeof(control);
+        SocketCanFrame sockcan_frames[MaxFramesPerSyscall];
+        ::iovec iovs[MaxFramesPerSyscall];
+        Control controls[MaxFramesPerSyscall];
+        ::mmsghdr msgs[MaxFramesPerSyscall];
 
-        const int res = ::recvmsg(fd_, &msg, MSG_DONTWAIT);
-        if (res <= 0)
+        while (true)
         {
-            return (res < 0 && errno == EWOULDBLOCK) ? 0 : res;
+            for (unsigned i = 0; i < MaxFramesPerSyscall; i++)
+            {
+                iovs[i] = ::iovec();
+                iovs[i].iov_base = &sockcan_frames[i];
+                iovs[i].iov_len  = sizeof(SocketCanFrame);
+                controls[i] = Control();
+                msgs[i] = ::mmsghdr();
+                msgs[i].msg_hdr.msg_iov        = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen     = 1;
+                msgs[i].msg_hdr.msg_control    = &controls[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof(Control);
+            }
+
+            const int res = ::recvmmsg(fd_, msgs, MaxFramesPerSyscall, MSG_ERRQUEUE | MSG_DONTWAIT, nullptr);
+            if (res <= 0)
+            {
+                break;
+            }
+
+            for (int i = 0; i < res; i++)
+            {
+                const ::msghdr& msg = msgs[i].msg_hdr;
+                if (!isValidSocketCanFrameSize(msgs[i].msg_len))
+                {
+                    continue;
+                }
+                for (const ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                     cmsg = CMSG_NXTHDR(const_cast< ::msghdr*>(&msg), const_cast< ::cmsghdr*>(cmsg)))
+                {
+                    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+                    {
+                        auto tss = ::scm_timestamping();
+                        (void)std::memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));  // Copy to avoid alignment problems
+                        const auto hw = uavcan::UtcTime::fromUSec(toUSec(tss.ts[2]));
+                        const std::uint32_t id = makeUavcanFrame(sockcan_frames[i], msgs[i].msg_len).id;
+                        if (!hw.isZero() && pending_loopback_ids_.contains(id))
+                        {
+                            tx_timestamps_.push(id, hw);
+                        }
+                    }
+                }
+            }
+
+            if (unsigned(res) < MaxFramesPerSyscall)
+            {
+                break;
+            }
         }
-        frame = makeUavcanFrame(sockcan_frame);
-        /*
-         * Timestamp
-         */
-        const ::cmsghdr* const cmsg = CMSG_FIRSTHDR(&msg);
-        assert(cmsg != nullptr);
-        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP)
+    }
+
+    /**
+     * Replaces the timestamp of a loopback frame with its hardware TX timestamp, if the kernel has reported one.
+     */
+    void applyTxTimestamp(RxItem& rx)
+    {
+        uavcan::UtcTime ts;
+        if (!tx_timestamps_.take(rx.frame.id, ts))
         {
-            auto tv = ::timeval();
-            (void)std::memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));  // Copy to avoid alignment problems
-            assert(tv.tv_sec >= 0 && tv.tv_usec >= 0);
-            ts_utc = uavcan::UtcTime::fromUSec(std::uint64_t(tv.tv_sec) * 1000000ULL + tv.tv_usec);
+            readTxTimestamps();     // The report may have been queued after the error queue was read
+            if (!tx_timestamps_.take(rx.frame.id, ts))
+            {
+                return;
+            }
         }
-        else
+        // The loopback is received right after the transmission, so its timestamp tells the time domain apart
+        if ((ts - rx.ts_utc).getAbs() < getMaxHardwareTimestampError())
         {
-            assert(0);
-            return -1;
+            rx.ts_utc = ts;
+            rx.ts_source = RxTimestampSource::Hardware;
         }
-        /*
-         * Flags
-         */
-        loopback = (msg.msg_flags & static_cast<int>(MSG_CONFIRM)) != 0;
-        return 1;
     }
 
     void pollWrite()
     {
-        while (!tx_queue_.empty() && (frames_in_socket_tx_queue_ < max_frames_in_socket_tx_queue_))
+        while (!tx_queue_.empty() && (frames_in_socket_tx_queue_ < tx_queue_depth_.getDepth()))
         {
-            const TxItem tx = tx_queue_.top();
-            tx_queue_.pop();
-            assert(tx_queue_.empty() ? true : !tx.frame.priorityLowerThan(tx_queue_.top().frame)); // Order check
-            if (tx.deadline >= clock_.getMonotonic())
+            const unsigned max_batch_size = std::min(tx_queue_depth_.getDepth() - frames_in_socket_tx_queue_,
+                                                     unsigned(MaxFramesPerSyscall));
+            TxItem batch[MaxFramesPerSyscall];
+            unsigned batch_size = 0;
+
+            const uavcan::MonotonicTime ts = clock_.getMonotonic();
+            while (!tx_queue_.empty() && (batch_size < max_batch_size))
             {
-                const int res = write(tx.frame);
-                if (res == 1)
+                const TxItem tx = tx_queue_.top();
+                tx_queue_.pop();
+                assert(tx_queue_.empty() ? true : !tx.frame.priorityLowerThan(tx_queue_.top().frame)); // Order check
+                if (tx.deadline >= ts)
                 {
-                    incrementNumFramesInSocketTxQueue();
-                    if (tx.flags & uavcan::CanIOFlagLoopback)
-                    {
-                        (void)pending_loopback_ids_.insert(tx.frame.id);
-                    }
+                    batch[batch_size++] = tx;
                 }
                 else
                 {
-                    registerError(SocketCanError::SocketWriteFailure);
+                    registerError(SocketCanError::TxTimeout);
                 }
             }
-            else
+            if (batch_size == 0)
+            {
+                continue;
+            }
+
+            const int res = write(batch, batch_size);
+            const unsigned num_sent = (res > 0) ? unsigned(res) : 0U;
+            for (unsigned i = 0; i < num_sent; i++)
             {
-                registerError(SocketCanError::TxTimeout);
+                incrementNumFramesInSocketTxQueue(ts);
+                if (batch[i].flags & uavcan::CanIOFlagLoopback)
+                {
+                    const bool inserted = pending_loopback_ids_.insert(batch[i].frame.id);
+                    assert(inserted);   // Can't overflow because it's limited by the socket TX queue depth
+                    (void)inserted;
+                }
+            }
+            if (num_sent < batch_size)
+            {
+                // The first rejected frame is dropped; the rest go back into the queue, keeping their order
+                registerError(SocketCanError::SocketWriteFailure);
+                for (unsigned i = num_sent + 1; i < batch_size; i++)
+                {
+                    (void)tx_queue_.push(batch[i]);   // Can't fail, these were just popped
+                }
+            }
+        }
+    }
+
+    void acceptRxItem(RxItem& rx)
+    {
+        assert(!rx.ts_utc.isZero());
+        rx_ts_source_ = rx.ts_source;
+        bool accept = true;
+        if (rx.flags & uavcan::CanIOFlagLoopback)   // We receive loopback for all CAN frames
+        {
+            confirmSentFrame(rx.ts_mono);
+            if (tx_hw_timestamping_ && pending_loopback_ids_.contains(rx.frame.id))
+            {
+                applyTxTimestamp(rx);
+            }
+            accept = wasInPendingLoopbackSet(rx.frame); // Do we need to send this loopback into the lib?
+            if (accept)
+            {
+                tx_ts_source_ = rx.ts_source;
             }
         }
+        if (accept)
+        {
+            rx.ts_utc += clock_.getPrivateAdjustment();
+            (void)rx_queue_.push(rx);
+        }
     }
 
     void pollRead()
     {
+        if (tx_hw_timestamping_)
+        {
+            readTxTimestamps();     // Also keeps the error queue from eating up the socket receive buffer
+        }
+        if (async_rx_)
+        {
+            return;                 // The socket is read by the driver, see handleAsyncRx()
+        }
         while (true)
         {
-            RxItem rx;
-            rx.ts_mono = clock_.getMonotonic();  // Monotonic timestamp is not required to be precise (unlike UTC)
-            bool loopback = false;
-            const int res = read(rx.frame, rx.ts_utc, loopback);
-            if (res == 1)
+            // Reading no more than the RX queue can accommodate, so that accepted frames are never dropped
+            const unsigned max_batch_size = std::min(rx_queue_.getNumFreeSlots(), unsigned(MaxFramesPerSyscall));
+            if (max_batch_size == 0)
+            {
+                break;
+            }
+            RxItem batch[MaxFramesPerSyscall];
+            const int res = read(batch, max_batch_size);
+            if (res > 0)
             {
-                assert(!rx.ts_utc.isZero());
-                bool accept = true;
-                if (loopback)                   // We receive loopback for all CAN frames
+                const uavcan::MonotonicTime ts_mono = clock_.getMonotonic(); // Not required to be precise (unlike UTC)
+                for (int i = 0; i < res; i++)
                 {
-                    confirmSentFrame();
-                    rx.flags |= uavcan::CanIOFlagLoopback;
-                    accept = wasInPendingLoopbackSet(rx.frame); // Do we need to send this loopback into the lib?
+                    batch[i].ts_mono = ts_mono;
+                    acceptRxItem(batch[i]);
                 }
-                if (accept)
+                if (unsigned(res) < max_batch_size)
                 {
-                    rx.ts_utc += clock_.getPrivateAdjustment();
-                    rx_queue_.push(rx);
+                    break;      // The socket has been drained, no need to waste another syscall
                 }
             }
             else if (res == 0)
@@ -324,7 +954,13 @@ public:
     SocketCanIface(const SystemClock& clock, int socket_fd, int max_frames_in_socket_tx_queue = 3)
         : clock_(clock)
         , fd_(socket_fd)
+        , tx_hw_timestamping_(isTxHardwareTimestampingEnabled(socket_fd))
         , max_frames_in_socket_tx_queue_(max_frames_in_socket_tx_queue)
+        , tx_queue_depth_(max_frames_in_socket_tx_queue_)
+        , tx_queue_(TxQueueCapacity)
+        , rx_queue_(RxQueueCapacity)
+        , pending_loopback_ids_(max_frames_in_socket_tx_queue_)
+        , tx_timestamps_(max_frames_in_socket_tx_queue_)
     {
         assert(fd_ >= 0);
     }
@@ -338,12 +974,15 @@ public:
     }
 
     /**
-     * Assumes that the socket is writeable
+     * Returns zero if the user space TX queue is full, see @ref isTxQueueFull().
      */
     std::int16_t send(const uavcan::CanFrame& frame, const uavcan::MonotonicTime tx_deadline,
                       const uavcan::CanIOFlags flags) override
     {
-        tx_queue_.emplace(frame, tx_deadline, flags, tx_frame_counter_);
+        if (!tx_queue_.push(TxItem(frame, tx_deadline, flags, tx_frame_counter_)))
+        {
+            return 0;
+        }
         tx_frame_counter_++;
         pollRead();     // Read poll is necessary because it can release the pending TX flag
         pollWrite();
@@ -376,6 +1015,31 @@ public:
         return 1;
     }
 
+    /**
+     * Same as @ref receive(), but moves all frames that are ready at once, saving a virtual call per frame.
+     */
+    std::int16_t receiveBatch(uavcan::CanRxFrame* out_frames, uavcan::CanIOFlags* out_flags,
+                              std::uint16_t max_frames) override
+    {
+        if (rx_queue_.empty())
+        {
+            pollRead();
+        }
+        std::uint16_t num_received = 0;
+        while (!rx_queue_.empty() && (num_received < max_frames))
+        {
+            const RxItem& rx = rx_queue_.front();
+            uavcan::CanRxFrame& out = out_frames[num_received];
+            static_cast<uavcan::CanFrame&>(out) = rx.frame;
+            out.ts_mono = rx.ts_mono;
+            out.ts_utc  = rx.ts_utc;
+            out_flags[num_received] = rx.flags;
+            rx_queue_.pop();
+            num_received++;
+        }
+        return std::int16_t(num_received);
+    }
+
     /**
      * Performs socket read/write.
      * @param read  Socket is readable
@@ -393,8 +1057,87 @@ public:
         }
     }
 
+    /**
+     * Makes the number of frames allowed in the socket TX queue adapt to the bus, between one and
+     * max_frames_in_socket_tx_queue, so that the loopback latency stays within the target: a deeper queue keeps the
+     * bus busy when it is idle, a shallower one bounds the priority inversion in the kernel when the bus is busy.
+     * The target is the maximum acceptable blocking time of a high-priority frame by the frames already in the
+     * socket; a few frame transmission times at the bus bit rate is a reasonable choice. The latency is measured
+     * when the loopback is read, so the socket must be polled promptly, which is normally the case.
+     * Zero restores the fixed limit, which is the default.
+     */
+    void setTxQueueTargetLatency(uavcan::MonotonicDuration latency) { tx_queue_depth_.setTargetLatency(latency); }
+
+    uavcan::MonotonicDuration getTxQueueTargetLatency() const { return tx_queue_depth_.getTargetLatency(); }
+
+    /**
+     * Current number of frames allowed in the socket TX queue; see @ref setTxQueueTargetLatency().
+     */
+    unsigned getSocketTxQueueDepth() const { return tx_queue_depth_.getDepth(); }
+
+    /**
+     * Loopback latency of the most recently confirmed frame.
+     */
+    uavcan::MonotonicDuration getLastTxLatency() const { return tx_queue_depth_.getLastLatency(); }
+
     bool hasPendingTx() const { return !tx_queue_.empty(); }
+    bool isTxQueueFull() const { return tx_queue_.full(); }
+    bool isRxQueueFull() const { return rx_queue_.getNumFreeSlots() == 0; }
     bool hasReadyRx()   const { return !rx_queue_.empty(); }
+    unsigned getNumFreeRxQueueSlots() const { return rx_queue_.getNumFreeSlots(); }
+
+    /**
+     * Receive buffer for one frame, for the drivers that read the socket asynchronously, e.g. via io_uring.
+     * The kernel keeps pointers into the buffer while the read is in progress, so it must not be moved.
+     */
+    class AsyncRxSlot
+    {
+        friend class SocketCanIface;
+
+        SocketCanFrame frame_;
+        ::iovec iov_;
+        RxControl control_;
+        ::msghdr msg_;
+
+    public:
+        AsyncRxSlot() { (void)prepare(); }
+
+        AsyncRxSlot(const AsyncRxSlot&) = delete;
+        AsyncRxSlot& operator=(const AsyncRxSlot&) = delete;
+
+        /**
+         * Resets the buffer before the next read.
+         * @return The message header to be passed to recvmsg().
+         */
+        ::msghdr* prepare()
+        {
+            initRxMessage(frame_, iov_, control_, msg_);
+            return &msg_;
+        }
+    };
+
+    /**
+     * Makes the iface stop reading the socket by itself; instead, the driver reads the frames into
+     * @ref AsyncRxSlot and passes them to @ref handleAsyncRx(). The driver must never have more reads in progress
+     * than @ref getNumFreeRxQueueSlots(), so that the received frames are never dropped.
+     */
+    void enableAsyncRx() { async_rx_ = true; }
+
+    /**
+     * Processes a frame read into the slot by the driver.
+     * @param msg_len       Result of recvmsg(); negative is treated as a read failure.
+     */
+    void handleAsyncRx(const AsyncRxSlot& slot, int msg_len)
+    {
+        RxItem rx;
+        if ((msg_len < 0) || !parseRxMessage(slot.msg_, slot.frame_, unsigned(msg_len), rx))
+        {
+            registerError(SocketCanError::SocketReadFailure);
+            return;
+        }
+        rx.ts_mono = clock_.getMonotonic();
+        acceptRxItem(rx);
+    }
 
     std::int16_t configureFilters(const uavcan::CanFilterConfig* const filter_configs,
                                   const std::uint16_t num_configs) override
@@ -454,6 +1197,18 @@ public:
 
     int getFileDescriptor() const { return fd_; }
 
+    /**
+     * Where the UTC timestamps of the received frames come from; reflects the most recently received frame.
+     * Hardware timestamps are used automatically if the CAN controller provides them.
+     */
+    RxTimestampSource getRxTimestampSource() const { return rx_ts_source_; }
+
+    /**
+     * Where the UTC timestamps of the loopback frames (i.e. the TX timestamps) come from; reflects the most recently
+     * delivered loopback frame. Hardware TX timestamps are used automatically if the CAN controller provides them.
+     */
+    RxTimestampSource getTxTimestampSource() const { return tx_ts_source_; }
+
     /**
      * Open and configure a CAN socket on iface specified by name.
      * @param iface_name String containing iface name, e.g. "can0", "vcan1", "slcan0"
@@ -490,8 +1245,30 @@ public:
         // Configure
         {
             const int on = 1;
-            // Timestamping
-            if (::setsockopt(s, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)) < 0)
+            // Hardware TX timestamps are requested only if supported, so that the error queue is not polled in vain
+            bool tx_hw_timestamping = false;
+            {
+                auto info = ::ethtool_ts_info();
+                info.cmd = ETHTOOL_GET_TS_INFO;
+                ifr.ifr_data = reinterpret_cast<char*>(&info);
+                tx_hw_timestamping = (::ioctl(s, SIOCETHTOOL, &ifr) >= 0) &&
+                                     ((info.so_timestamping & SOF_TIMESTAMPING_TX_HARDWARE) != 0) &&
+                                     ((info.tx_types & (1U << HWTSTAMP_TX_ON)) != 0);
+            }
+            // Hardware timestamping - optional, requires CAP_NET_ADMIN; many CAN drivers have it always enabled
+            {
+                auto hwcfg = ::hwtstamp_config();
+                hwcfg.tx_type   = tx_hw_timestamping ? HWTSTAMP_TX_ON : HWTSTAMP_TX_OFF;
+                hwcfg.rx_filter = HWTSTAMP_FILTER_ALL;
+                ifr.ifr_data = reinterpret_cast<char*>(&hwcfg);
+                (void)::ioctl(s, SIOCSHWTSTAMP, &ifr);
+            }
+            // Timestamping - SO_TIMESTAMPING delivers hardware timestamps if available; SO_TIMESTAMP is the fallback
+            const int ts_flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                                 SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                                 (tx_hw_timestamping ? SOF_TIMESTAMPING_TX_HARDWARE : 0);
+            if (::setsockopt(s, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) < 0 &&
+                ::setsockopt(s, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on)) < 0)
             {
                 goto fail;
             }
@@ -500,6 +1277,13 @@ public:
             {
                 goto fail;
             }
+#if UAVCAN_SUPPORT_CANFD
+            // CAN FD frames - fails if the kernel doesn't support CAN FD; the interface may still be classic CAN
+            if (::setsockopt(s, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on)) < 0)
+            {
+                goto fail;
+            }
+#endif
             // Non-blocking
             if (::fcntl(s, F_SETFL , O_NONBLOCK) < 0)
             {
@@ -525,22 +1309,46 @@ public:
 
 private:
     const SystemClock& clock_;
+    const int wakeup_fd_;
     uavcan::LazyConstructor<SocketCanIface> ifaces_[MaxIfaces];
-    ::pollfd pollfds_[MaxIfaces];
+    ::pollfd pollfds_[MaxIfaces + 1];       ///< The wakeup event always follows the last iface
     std::uint8_t num_ifaces_ = 0;
 
 public:
     /**
      * Reference to the clock object shall remain valid.
+     * @throws uavcan_linux::Exception.
      */
     explicit SocketCanDriver(const SystemClock& clock)
         : clock_(clock)
+        , wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
     {
+        if (wakeup_fd_ < 0)
+        {
+            throw Exception("Failed to create wakeup eventfd");
+        }
         for (auto& p : pollfds_)
         {
             p = ::pollfd();
             p.fd = -1;
         }
+        pollfds_[0].fd = wakeup_fd_;
+        pollfds_[0].events = POLLIN;
+    }
+
+    ~SocketCanDriver()
+    {
+        (void)::close(wakeup_fd_);
+    }
+
+    /**
+     * Makes the blocking select() return early, so that the spinning thread gets to process the work that other
+     * threads have passed to it, see @ref TxInjectionQueue. This is the only method that is thread-safe.
+     */
+    void wakeUp()
+    {
+        const std::uint64_t one = 1;
+        (void)::write(wakeup_fd_, &one, sizeof(one));
     }
 
     /**
@@ -554,11 +1362,13 @@ public:
                         uavcan::MonotonicTime blocking_deadline) override
     {
         // Detecting whether we need to block at all
-        bool need_block = (inout_masks.write == 0);    // Write queue is infinite
+        bool need_block = true;
         for (unsigned i = 0; need_block && (i < num_ifaces_); i++)
         {
-            const bool need_read = inout_masks.read  & (1 << i);
-            if (need_read && ifaces_[i]->hasReadyRx())
+            const bool need_read  = inout_masks.read  & (1 << i);
+            const bool need_write = inout_masks.write & (1 << i);
+            if ((need_read && ifaces_[i]->hasReadyRx()) ||
+                (need_write && !ifaces_[i]->isTxQueueFull()))   // The TX queue is large, this is the common case
             {
                 need_block = false;
             }
@@ -586,16 +1396,21 @@ public:
             }
 
             // Blocking here
-            const int res = ::ppoll(pollfds_, num_ifaces_, &ts, nullptr);
+            const int res = ::ppoll(pollfds_, num_ifaces_ + 1U, &ts, nullptr);
             if (res < 0)
             {
                 return res;
             }
+            if (pollfds_[num_ifaces_].revents & POLLIN)
+            {
+                std::uint64_t counter = 0;
+                (void)::read(wakeup_fd_, &counter, sizeof(counter));
+            }
 
             // Handling poll output
             for (unsigned i = 0; i < num_ifaces_; i++)
             {
-                const bool poll_read  = pollfds_[i].revents & POLLIN;
+                const bool poll_read  = pollfds_[i].revents & (POLLIN | POLLERR);   // POLLERR - TX timestamps
                 const bool poll_write = pollfds_[i].revents & POLLOUT;
                 ifaces_[i]->poll(poll_read, poll_write);
             }
@@ -603,17 +1418,24 @@ public:
 
         // Writing the output masks
         inout_masks = uavcan::CanSelectMasks();
+        std::int16_t num_ready_ifaces = 0;
         for (unsigned i = 0; i < num_ifaces_; i++)
         {
             const std::uint8_t iface_mask = 1 << i;
-            inout_masks.write |= iface_mask;           // Always ready to write
+            if (!ifaces_[i]->isTxQueueFull())
+            {
+                inout_masks.write |= iface_mask;
+            }
             if (ifaces_[i]->hasReadyRx())
             {
                 inout_masks.read |= iface_mask;
             }
+            if ((inout_masks.write | inout_masks.read) & iface_mask)
+            {
+                num_ready_ifaces++;
+            }
         }
-        // Since all ifaces are always ready to write, return value is always the same
-        return num_ifaces_;
+        return num_ready_ifaces;
     }
 
     SocketCanIface* getIface(std::uint8_t iface_index) override
@@ -654,6 +1476,219 @@ public:
         // Init pollfd
         pollfds_[num_ifaces_].fd = fd;
         num_ifaces_++;
+        pollfds_[num_ifaces_].fd = wakeup_fd_;
+        pollfds_[num_ifaces_].events = POLLIN;
+        return 0;
+    }
+};
+
+/**
+ * Same as @ref SocketCanDriver, but uses edge-triggered epoll() for multiplexing.
+ * The sockets are registered with epoll once, when the ifaces are added, and every blocking call processes only
+ * the ifaces that have reported events, so the overhead per spin does not depend on the number of ifaces.
+ *
+ * Since the readiness notifications are edge-triggered, an iface that has stopped reading its socket because its
+ * RX queue got full is polled again as soon as the application frees some space in the queue.
+ */
+class EpollSocketCanDriver : public uavcan::ICanDriver
+{
+public:
+    static constexpr unsigned MaxIfaces = uavcan::MaxCanIfaces;
+
+private:
+    static constexpr std::uint32_t WakeupEventTag = 0xFFFFFFFFU;
+
+    const SystemClock& clock_;
+    const int epoll_fd_;
+    const int wakeup_fd_;
+    uavcan::LazyConstructor<SocketCanIface> ifaces_[MaxIfaces];
+    bool rx_backlog_[MaxIfaces] = {};       ///< The socket may still contain unread frames
+    std::uint8_t num_ifaces_ = 0;
+
+    void closeFds()
+    {
+        if (wakeup_fd_ >= 0)
+        {
+            (void)::close(wakeup_fd_);
+        }
+        if (epoll_fd_ >= 0)
+        {
+            (void)::close(epoll_fd_);
+        }
+    }
+
+    void pollIface(unsigned index, bool read, bool write)
+    {
+        ifaces_[index]->poll(read, write);
+        if (read)
+        {
+            rx_backlog_[index] = ifaces_[index]->isRxQueueFull();
+        }
+    }
+
+public:
+    /**
+     * Reference to the clock object shall remain valid.
+     * @throws uavcan_linux::Exception.
+     */
+    explicit EpollSocketCanDriver(const SystemClock& clock)
+        : clock_(clock)
+        , epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
+        , wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+        if ((epoll_fd_ < 0) || (wakeup_fd_ < 0))
+        {
+            closeFds();
+            throw Exception("Failed to create epoll instance");
+        }
+        auto ev = ::epoll_event();
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u32 = WakeupEventTag;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev) < 0)
+        {
+            closeFds();
+            throw Exception("Failed to register wakeup eventfd");
+        }
+    }
+
+    ~EpollSocketCanDriver()
+    {
+        closeFds();
+    }
+
+    /**
+     * Same as @ref SocketCanDriver::wakeUp().
+     */
+    void wakeUp()
+    {
+        const std::uint64_t one = 1;
+        (void)::write(wakeup_fd_, &one, sizeof(one));
+    }
+
+    /**
+     * Same as @ref SocketCanDriver::select().
+     * Note that epoll_wait() has millisecond resolution; the timeout is rounded up.
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override
+    {
+        // Catching up with the sockets that could not be drained last time
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            if (rx_backlog_[i] && !ifaces_[i]->isRxQueueFull())
+            {
+                pollIface(i, true, true);
+            }
+        }
+
+        // Detecting whether we need to block at all
+        bool need_block = true;
+        for (unsigned i = 0; need_block && (i < num_ifaces_); i++)
+        {
+            const bool need_read  = inout_masks.read  & (1 << i);
+            const bool need_write = inout_masks.write & (1 << i);
+            if ((need_read && ifaces_[i]->hasReadyRx()) ||
+                (need_write && !ifaces_[i]->isTxQueueFull()))
+            {
+                need_block = false;
+            }
+        }
+
+        if (need_block)
+        {
+            const std::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+            const int timeout_msec = (timeout_usec > 0) ? int((timeout_usec + 999) / 1000) : 0;
+
+            ::epoll_event events[MaxIfaces + 1];
+            const int res = ::epoll_wait(epoll_fd_, events, MaxIfaces + 1, timeout_msec);
+            if (res < 0)
+            {
+                return res;
+            }
+
+            for (int k = 0; k < res; k++)
+            {
+                if (events[k].data.u32 == WakeupEventTag)
+                {
+                    std::uint64_t counter = 0;
+                    (void)::read(wakeup_fd_, &counter, sizeof(counter));
+                    continue;
+                }
+                const unsigned i = events[k].data.u32;
+                assert(i < num_ifaces_);
+                const bool poll_read = (events[k].events & (EPOLLIN | EPOLLERR)) != 0;
+                pollIface(i, poll_read, true);    // Writing is cheap if there's nothing to send
+            }
+        }
+
+        // Writing the output masks
+        inout_masks = uavcan::CanSelectMasks();
+        std::int16_t num_ready_ifaces = 0;
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            const std::uint8_t iface_mask = 1 << i;
+            if (!ifaces_[i]->isTxQueueFull())
+            {
+                inout_masks.write |= iface_mask;
+            }
+            if (ifaces_[i]->hasReadyRx())
+            {
+                inout_masks.read |= iface_mask;
+            }
+            if ((inout_masks.write | inout_masks.read) & iface_mask)
+            {
+                num_ready_ifaces++;
+            }
+        }
+        return num_ready_ifaces;
+    }
+
+    SocketCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= num_ifaces_) ? nullptr : static_cast<SocketCanIface*>(ifaces_[iface_index]);
+    }
+
+    std::uint8_t getNumIfaces() const override { return num_ifaces_; }
+
+    /**
+     * Adds one iface by name. Will fail if there are @ref MaxIfaces ifaces registered already.
+     * @param iface_name E.g. "can0", "vcan1"
+     * @return Negative on error, zero on success.
+     * @throws uavcan_linux::Exception.
+     */
+    int addIface(const std::string& iface_name)
+    {
+        if (num_ifaces_ >= MaxIfaces)
+        {
+            return -1;
+        }
+        // Open the socket
+        const int fd = SocketCanIface::openSocket(iface_name);
+        if (fd < 0)
+        {
+            return fd;
+        }
+        // Register with epoll before the iface takes ownership of the fd, so that failures are easy to handle
+        auto ev = ::epoll_event();
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.u32 = num_ifaces_;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            (void)::close(fd);
+            return -1;
+        }
+        // Construct the iface - upon successful construction the iface will take ownership of the fd.
+        try
+        {
+            ifaces_[num_ifaces_].construct<const SystemClock&, int>(clock_, fd);
+        }
+        catch (...)
+        {
+            (void)::close(fd);      // Closing also removes the fd from the epoll set
+            throw;
+        }
+        num_ifaces_++;
         return 0;
     }
 };
@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Minimal io_uring wrapper, just enough for @ref IoUringSocketCanDriver, so that liburing is not required.
+ * Requires Linux 5.11 or newer (IORING_FEAT_EXT_ARG), which is checked upon construction.
+ */
+class IoUring
+{
+    int fd_ = -1;
+
+    void* sq_ring_ = MAP_FAILED;
+    std::size_t sq_ring_size_ = 0;
+    void* cq_ring_ = MAP_FAILED;
+    std::size_t cq_ring_size_ = 0;
+    ::io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sqe_tail_ = 0;         ///< Entries up to this one are published with the next submission
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    ::io_uring_cqe* cqes_ = nullptr;
+
+    template <typename T>
+    static T* at(void* base, unsigned offset)
+    {
+        return reinterpret_cast<T*>(static_cast<std::uint8_t*>(base) + offset);
+    }
+
+    unsigned getNumUnsubmitted() const
+    {
+        return sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    }
+
+    void release()
+    {
+        if (sqes_ != nullptr)
+        {
+            (void)::munmap(sqes_, sqes_size_);
+        }
+        if ((cq_ring_ != MAP_FAILED) && (cq_ring_ != sq_ring_))
+        {
+            (void)::munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_ != MAP_FAILED)
+        {
+            (void)::munmap(sq_ring_, sq_ring_size_);
+        }
+        if (fd_ >= 0)
+        {
+            (void)::close(fd_);     // The requests that are still in progress are cancelled by the kernel
+        }
+    }
+
+public:
+    /**
+     * @param entries   Submission queue size; the completion queue is twice as large.
+     * @throws uavcan_linux::Exception.
+     */
+    explicit IoUring(unsigned entries)
+    {
+        auto params = ::io_uring_params();
+        fd_ = int(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0)
+        {
+            throw Exception("Failed to create io_uring instance");
+        }
+        if (((params.features & IORING_FEAT_EXT_ARG) == 0) || ((params.features & IORING_FEAT_NODROP) == 0))
+        {
+            release();
+            throw Exception("io_uring is too old");
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap)
+        {
+            sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            cq_ring_size_ = sq_ring_size_;
+        }
+
+        sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_SQ_RING);
+        cq_ring_ = single_mmap ? sq_ring_ :
+                   ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(::io_uring_sqe);
+        void* const sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  fd_, IORING_OFF_SQES);
+        sqes_ = (sqes == MAP_FAILED) ? nullptr : static_cast< ::io_uring_sqe*>(sqes);
+        if ((sq_ring_ == MAP_FAILED) || (cq_ring_ == MAP_FAILED) || (sqes_ == nullptr))
+        {
+            release();
+            throw Exception("Failed to map io_uring");
+        }
+
+        sq_head_    = at<unsigned>(sq_ring_, params.sq_off.head);
+        sq_tail_    = at<unsigned>(sq_ring_, params.sq_off.tail);
+        sq_mask_    = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        sqe_tail_   = *sq_tail_;
+        cq_head_    = at<unsigned>(cq_ring_, params.cq_off.head);
+        cq_tail_    = at<unsigned>(cq_ring_, params.cq_off.tail);
+        cq_mask_    = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+        cqes_       = at< ::io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+        // The submission queue entries are always used in order, so the indirection array is constant
+        unsigned* const sq_array = at<unsigned>(sq_ring_, params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; i++)
+        {
+            sq_array[i] = i;
+        }
+    }
+
+    ~IoUring() { release(); }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * Returns a zeroed submission queue entry, or null if the queue is full.
+     * The entry will be submitted with the next call to @ref submitAndWait().
+     */
+    ::io_uring_sqe* getSqe()
+    {
+        if (getNumUnsubmitted() >= sq_entries_)
+        {
+            return nullptr;
+        }
+        ::io_uring_sqe* const sqe = &sqes_[sqe_tail_ & sq_mask_];
+        *sqe = ::io_uring_sqe();
+        sqe_tail_++;
+        return sqe;
+    }
+
+    /**
+     * Submits the new entries and waits for at least the specified number of completions, with timeout.
+     * Does not invoke the system call if there is nothing to submit and nothing to wait for.
+     * @return Non-negative on success, including timeout and interruption by a signal; negative errno otherwise.
+     */
+    int submitAndWait(unsigned wait_nr, std::int64_t timeout_usec)
+    {
+        const unsigned to_submit = getNumUnsubmitted();
+        if ((to_submit == 0) && (wait_nr == 0))
+        {
+            return 0;
+        }
+        __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+
+        long res = 0;
+        if (wait_nr > 0)
+        {
+            auto ts = ::__kernel_timespec();
+            if (timeout_usec > 0)
+            {
+                ts.tv_sec  = timeout_usec / 1000000LL;
+                ts.tv_nsec = (timeout_usec % 1000000LL) * 1000LL;
+            }
+            auto arg = ::io_uring_getevents_arg();
+            arg.ts = reinterpret_cast<std::uintptr_t>(&ts);
+            res = ::syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr,
+                            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        }
+        else
+        {
+            res = ::syscall(__NR_io_uring_enter, fd_, to_submit, 0, 0, nullptr, 0);
+        }
+        if ((res < 0) && (errno != ETIME) && (errno != EINTR))
+        {
+            return -errno;
+        }
+        return 0;
+    }
+
+    /**
+     * Returns the oldest completion queue entry that has not been consumed yet, or null if there's none.
+     * Call @ref popCqe() once the entry has been processed.
+     */
+    const ::io_uring_cqe* peekCqe() const
+    {
+        const unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        {
+            return nullptr;
+        }
+        return &cqes_[head & cq_mask_];
+    }
+
+    void popCqe()
+    {
+        __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+    }
+
+    unsigned getSubmissionQueueSize() const { return sq_entries_; }
+};
+
+/**
+ * Same as @ref SocketCanDriver, but uses io_uring instead of ppoll() and recvmmsg().
+ *
+ * Every iface keeps a number of reads posted in the submission ring, so that the kernel delivers the received frames
+ * directly into the preallocated buffers, and the application collects them from the completion ring without
+ * system calls. A single io_uring_enter() call per spin submits the new reads and waits for completions, so the
+ * cost of the multiplexing does not depend on the number of ifaces. The number of reads in progress never exceeds
+ * the free space in the RX queue of the iface, so the received frames are never dropped.
+ *
+ * TX frames are written with sendmmsg() directly from @ref SocketCanIface, which already batches them; when the
+ * socket buffer is full, the driver waits for the socket to become writable via the ring as well.
+ *
+ * The buffers cannot be registered with the ring, because the reads must go through recvmsg() in order to obtain
+ * the timestamps and the loopback flag.
+ *
+ * Requires Linux 5.11 or newer; the constructor throws otherwise.
+ */
+class IoUringSocketCanDriver : public uavcan::ICanDriver
+{
+public:
+    static constexpr unsigned MaxIfaces = uavcan::MaxCanIfaces;
+
+    /**
+     * Number of reads kept in progress per iface. This is also the maximum number of frames that can be received
+     * per iface per spin without waiting for the next call to select().
+     */
+    static constexpr unsigned ReadsPerIface = 32;
+
+private:
+    enum class Op : std::uint8_t
+    {
+        Read,
+        PollOut
+    };
+
+    struct IfaceState
+    {
+        SocketCanIface::AsyncRxSlot slots[ReadsPerIface];
+        bool slot_busy[ReadsPerIface] = {};
+        unsigned num_reads_in_progress = 0;
+        bool poll_out_in_progress = false;
+    };
+
+    static std::uint64_t makeUserData(Op op, unsigned iface_index, unsigned slot_index)
+    {
+        return (std::uint64_t(op) << 32) | (std::uint64_t(iface_index) << 16) | slot_index;
+    }
+
+    const SystemClock& clock_;
+    uavcan::LazyConstructor<SocketCanIface> ifaces_[MaxIfaces];
+    std::unique_ptr<IfaceState> states_[MaxIfaces];
+    std::uint8_t num_ifaces_ = 0;
+    IoUring ring_;                  ///< Destroyed first, so that the buffers outlive the requests
+
+    void postReads(unsigned index)
+    {
+        SocketCanIface& iface = *ifaces_[index];
+        IfaceState& st = *states_[index];
+        for (unsigned slot = 0; slot < ReadsPerIface; slot++)
+        {
+            if (st.num_reads_in_progress >= iface.getNumFreeRxQueueSlots())
+            {
+                break;
+            }
+            if (st.slot_busy[slot])
+            {
+                continue;
+            }
+            ::io_uring_sqe* const sqe = ring_.getSqe();
+            if (sqe == nullptr)
+            {
+                break;
+            }
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->fd = iface.getFileDescriptor();
+            sqe->addr = reinterpret_cast<std::uintptr_t>(st.slots[slot].prepare());
+            sqe->len = 1;
+            sqe->user_data = makeUserData(Op::Read, index, slot);
+            st.slot_busy[slot] = true;
+            st.num_reads_in_progress++;
+        }
+    }
+
+    void postPollOut(unsigned index)
+    {
+        IfaceState& st = *states_[index];
+        if (st.poll_out_in_progress || !ifaces_[index]->hasPendingTx())
+        {
+            return;
+        }
+        ::io_uring_sqe* const sqe = ring_.getSqe();
+        if (sqe != nullptr)
+        {
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = ifaces_[index]->getFileDescriptor();
+            sqe->poll32_events = POLLOUT;
+            sqe->user_data = makeUserData(Op::PollOut, index, 0);
+            st.poll_out_in_progress = true;
+        }
+    }
+
+    void handleCompletion(const ::io_uring_cqe& cqe)
+    {
+        const Op op = Op(cqe.user_data >> 32);
+        const unsigned index = unsigned(cqe.user_data >> 16) & 0xFFFFU;
+        const unsigned slot = unsigned(cqe.user_data) & 0xFFFFU;
+        assert(index < num_ifaces_);
+        IfaceState& st = *states_[index];
+
+        if (op == Op::Read)
+        {
+            assert((slot < ReadsPerIface) && st.slot_busy[slot]);
+            st.slot_busy[slot] = false;
+            st.num_reads_in_progress--;
+            if (cqe.res != -ECANCELED)
+            {
+                ifaces_[index]->handleAsyncRx(st.slots[slot], cqe.res);
+            }
+        }
+        else
+        {
+            st.poll_out_in_progress = false;
+        }
+    }
+
+public:
+    /**
+     * Reference to the clock object shall remain valid.
+     * @throws uavcan_linux::Exception.
+     */
+    explicit IoUringSocketCanDriver(const SystemClock& clock)
+        : clock_(clock)
+        , ring_(MaxIfaces * (ReadsPerIface + 1))
+    { }
+
+    /**
+     * Same as @ref SocketCanDriver::select().
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override
+    {
+        // Replenishing the reads, since the application may have freed some space in the RX queues
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            postReads(i);
+            postPollOut(i);
+        }
+
+        // Detecting whether we need to block at all
+        bool need_block = true;
+        for (unsigned i = 0; need_block && (i < num_ifaces_); i++)
+        {
+            const bool need_read  = inout_masks.read  & (1 << i);
+            const bool need_write = inout_masks.write & (1 << i);
+            if ((need_read && ifaces_[i]->hasReadyRx()) ||
+                (need_write && !ifaces_[i]->isTxQueueFull()))
+            {
+                need_block = false;
+            }
+        }
+        need_block = need_block && (ring_.peekCqe() == nullptr);
+
+        const std::int64_t timeout_usec = (blocking_deadline - clock_.getMonotonic()).toUSec();
+        const int res = ring_.submitAndWait(need_block ? 1U : 0U, timeout_usec);
+        if (res < 0)
+        {
+            return std::int16_t(res);
+        }
+
+        // Collecting the completions; no system calls here
+        bool completed = false;
+        while (const ::io_uring_cqe* const cqe = ring_.peekCqe())
+        {
+            handleCompletion(*cqe);
+            ring_.popCqe();
+            completed = true;
+        }
+
+        // Loopback frames release the socket TX queue, so the pending frames can be sent now
+        if (completed)
+        {
+            for (unsigned i = 0; i < num_ifaces_; i++)
+            {
+                ifaces_[i]->poll(false, true);
+            }
+        }
+
+        // Writing the output masks
+        inout_masks = uavcan::CanSelectMasks();
+        std::int16_t num_ready_ifaces = 0;
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            const std::uint8_t iface_mask = 1 << i;
+            if (!ifaces_[i]->isTxQueueFull())
+            {
+                inout_masks.write |= iface_mask;
+            }
+            if (ifaces_[i]->hasReadyRx())
+            {
+                inout_masks.read |= iface_mask;
+            }
+            if ((inout_masks.write | inout_masks.read) & iface_mask)
+            {
+                num_ready_ifaces++;
+            }
+        }
+        return num_ready_ifaces;
+    }
+
+    SocketCanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index >= num_ifaces_) ? nullptr : static_cast<SocketCanIface*>(ifaces_[iface_index]);
+    }
+
+    std::uint8_t getNumIfaces() const override { return num_ifaces_; }
+
+    /**
+     * Adds one iface by name. Will fail if there are @ref MaxIfaces ifaces registered already.
+     * The reads will be submitted with the next call to @ref select().
+     * @param iface_name E.g. "can0", "vcan1"
+     * @return Negative on error, zero on success.
+     * @throws uavcan_linux::Exception.
+     */
+    int addIface(const std::string& iface_name)
+    {
+        if (num_ifaces_ >= MaxIfaces)
+        {
+            return -1;
+        }
+        // Open the socket
+        const int fd = SocketCanIface::openSocket(iface_name);
+        if (fd < 0)
+        {
+            return fd;
+        }
+        // Construct the iface - upon successful construction the iface will take ownership of the fd.
+        try
+        {
+            states_[num_ifaces_].reset(new IfaceState);
+            ifaces_[num_ifaces_].construct<const SystemClock&, int>(clock_, fd);
+        }
+        catch (...)
+        {
+            (void)::close(fd);
+            throw;
+        }
+        ifaces_[num_ifaces_]->enableAsyncRx();
+        num_ifaces_++;
+        return 0;
+    }
+};
+
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <uavcan/transport/transfer_listener.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Moves the decoding of received transfers and the subscription callbacks from the thread that spins the node
+ * to a worker thread, so that slow callbacks do not delay the reception and do not cause RX overflows.
+ * The reception and reassembly of transfers stay in the spinning thread.
+ *
+ * This is a single-producer single-consumer lock-free ring buffer. The producer is the thread that spins the node;
+ * the consumer is the worker thread that calls @ref processPending() or @ref waitAndProcess(). If more than one
+ * worker is needed, use one queue per worker. Each slot keeps a copy of the transfer payload; transfers that
+ * are longer than MaxPayloadLen, or that arrive while the queue is full, are dropped and counted as errors.
+ *
+ * The worker does not touch the counters of the node, which are not thread-safe; instead, the outcome of each
+ * transfer (decoding failures, callback duration, latency) stays in its slot until the producer commits it.
+ * This happens on every handoff and in @ref commitProcessed(), so the counters lag behind by at most one call.
+ *
+ * Usage:
+ *   subscriber.setTransferHandoff(&queue);     // Spinning thread
+ *   queue.commitProcessed();                   // Spinning thread, e.g. after every spin()
+ *   queue.waitAndProcess(timeout);             // Worker thread, callbacks are invoked from here
+ *
+ * Keep in mind that the node is not thread-safe, so the callbacks invoked by the worker must not access it.
+ * Subscribers must not be destroyed while the queue contains their transfers or uncommitted results.
+ */
+template <unsigned Capacity, unsigned MaxPayloadLen>
+class TransferHandoffQueue : public uavcan::ITransferHandoff,
+                             uavcan::Noncopyable
+{
+    static_assert((Capacity > 0) && ((Capacity & (Capacity - 1U)) == 0), "Capacity must be a power of two");
+
+    struct Slot
+    {
+        uavcan::TransferListenerBase* listener;
+        uavcan::DeferredTransferResult result;          ///< Written by the consumer, committed by the producer
+        alignas(uavcan::DeferredIncomingTransfer) std::uint8_t transfer[sizeof(uavcan::DeferredIncomingTransfer)];
+        std::uint8_t payload[MaxPayloadLen];
+    };
+
+    Slot slots_[Capacity];
+
+    alignas(64) std::atomic<unsigned> head_;        ///< Written by the consumer only
+    alignas(64) std::atomic<unsigned> tail_;        ///< Written by the producer only
+    unsigned committed_;                            ///< Accessed by the producer only, lags behind head_
+    std::atomic<bool> consumer_waiting_;
+    std::atomic<std::uint64_t> num_dropped_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    bool drop()
+    {
+        num_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+public:
+    TransferHandoffQueue()
+        : head_(0)
+        , tail_(0)
+        , committed_(0)
+        , consumer_waiting_(false)
+        , num_dropped_(0)
+    { }
+
+    ~TransferHandoffQueue()
+    {
+        // Destroying the pending transfers without processing
+        for (unsigned head = head_.load(); head != tail_.load(); head++)
+        {
+            Slot& slot = slots_[head & (Capacity - 1U)];
+            reinterpret_cast<uavcan::DeferredIncomingTransfer*>(slot.transfer)->~DeferredIncomingTransfer();
+        }
+    }
+
+    /**
+     * Producer side, invoked by the transfer listener.
+     */
+    bool handOff(uavcan::TransferListenerBase& listener, uavcan::IncomingTransfer& transfer) override
+    {
+        (void)commitProcessed();
+        const unsigned tail = tail_.load(std::memory_order_relaxed);
+        if ((tail - committed_) >= Capacity)
+        {
+            return drop();
+        }
+
+        Slot& slot = slots_[tail & (Capacity - 1U)];
+        const int len = transfer.read(0, slot.payload, MaxPayloadLen);
+        if (len < 0)
+        {
+            return drop();
+        }
+        std::uint8_t extra = 0;
+        if ((unsigned(len) == MaxPayloadLen) && (transfer.read(MaxPayloadLen, &extra, 1) > 0))
+        {
+            return drop();                      // Does not fit
+        }
+
+        slot.listener = &listener;
+        (void)new (slot.transfer) uavcan::DeferredIncomingTransfer(transfer, slot.payload, unsigned(len));
+
+        tail_.store(tail + 1U, std::memory_order_release);
+
+        // Pairs with the fence in waitAndProcess(), so that either the consumer sees the new item or we see it waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Producer side. Accounts the outcome of the transfers processed by the worker since the last call in the
+     * counters of the node. Returns the number of committed transfers.
+     */
+    unsigned commitProcessed()
+    {
+        const unsigned head = head_.load(std::memory_order_acquire);
+        unsigned num_committed = 0;
+        for (; committed_ != head; committed_++)
+        {
+            const Slot& slot = slots_[committed_ & (Capacity - 1U)];
+            slot.listener->commitDeferredTransfer(slot.result);
+            num_committed++;
+        }
+        return num_committed;
+    }
+
+    /**
+     * Consumer side. Processes all pending transfers, does not block.
+     * Returns the number of processed transfers.
+     */
+    unsigned processPending()
+    {
+        unsigned num_processed = 0;
+        unsigned head = head_.load(std::memory_order_relaxed);
+        while (head != tail_.load(std::memory_order_acquire))
+        {
+            Slot& slot = slots_[head & (Capacity - 1U)];
+            auto transfer = reinterpret_cast<uavcan::DeferredIncomingTransfer*>(slot.transfer);
+            slot.result = uavcan::DeferredTransferResult();
+            slot.listener->handleDeferredTransfer(*transfer, slot.result);
+            transfer->~DeferredIncomingTransfer();
+
+            head++;
+            head_.store(head, std::memory_order_release);   // The result can be committed by the producer from now on
+            num_processed++;
+        }
+        return num_processed;
+    }
+
+    /**
+     * Consumer side. Blocks until there is at least one pending transfer or until the timeout expires,
+     * then processes all pending transfers. Returns the number of processed transfers.
+     */
+    template <typename Rep, typename Period>
+    unsigned waitAndProcess(std::chrono::duration<Rep, Period> timeout)
+    {
+        const unsigned num_processed = processPending();
+        if (num_processed > 0)
+        {
+            return num_processed;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            consumer_waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            (void)cv_.wait_for(lock, timeout, [this]() { return !isEmpty(); });
+            consumer_waiting_.store(false, std::memory_order_relaxed);
+        }
+        return processPending();
+    }
+
+    bool isEmpty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+    /**
+     * Number of transfers that were dropped because the queue was full or the payload did not fit.
+     */
+    std::uint64_t getNumDropped() const { return num_dropped_.load(std::memory_order_relaxed); }
+};
+
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <uavcan/uavcan.hpp>
+#include <uavcan_linux/exception.hpp>
+#include <uavcan_linux/socketcan.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Allows any thread to publish messages through a node that is spun by another thread, without running a
+ * sub-node (see @ref VirtualCanDriver) and without locks. The producer threads encode the messages themselves
+ * and push the encoded payloads into a bounded multi-producer single-consumer ring buffer; the spinning thread
+ * sends them before every wait for IO, see uavcan::IExternalTxSource.
+ *
+ * If the node runs on @ref SocketCanDriver or @ref EpollSocketCanDriver, a push into an empty queue wakes up
+ * the spinning thread, so the message goes out immediately rather than when the node is done waiting.
+ * With other drivers the messages are sent with the next spin iteration.
+ *
+ * Usage:
+ *   TxInjectionQueue<64, 64> queue(node);                              // Spinning thread, before it starts
+ *   const int channel = queue.addChannel<uavcan::protocol::debug::KeyValue>();
+ *   queue.publish(channel, message);                                   // Any thread
+ *
+ * The channels must be added before the producers start. The queue must be destroyed by the spinning thread,
+ * after the producers are stopped. Each channel owns its Transfer ID counter, so a data type should not be
+ * published through the queue and through a regular publisher at the same time.
+ */
+template <unsigned Capacity, unsigned MaxPayloadLen>
+class TxInjectionQueue : public uavcan::IExternalTxSource,
+                         uavcan::Noncopyable
+{
+    static_assert((Capacity > 0) && ((Capacity & (Capacity - 1U)) == 0), "Capacity must be a power of two");
+
+    struct Slot
+    {
+        std::atomic<unsigned> sequence;     ///< Equals the position when free, the position + 1 when ready
+        int channel;
+        unsigned payload_len;
+        std::uint8_t payload[MaxPayloadLen];
+    };
+
+    struct Channel
+    {
+        uavcan::TransferSender sender;
+        uavcan::MonotonicDuration tx_timeout;
+
+        Channel(uavcan::Dispatcher& dispatcher, const uavcan::DataTypeDescriptor& descr,
+                uavcan::TransferPriority priority, uavcan::MonotonicDuration tx_timeout)
+            : sender(dispatcher, descr, uavcan::CanTxQueue::Volatile)
+            , tx_timeout(tx_timeout)
+        {
+            sender.setPriority(priority);
+        }
+    };
+
+    uavcan::INode& node_;
+    SocketCanDriver* const socketcan_driver_;
+    EpollSocketCanDriver* const epoll_driver_;
+    std::vector<std::unique_ptr<Channel>> channels_;    ///< Not modified while the producers are running
+
+    Slot slots_[Capacity];
+
+    alignas(64) std::atomic<unsigned> tail_;            ///< Claimed by the producers
+    alignas(64) std::atomic<unsigned> num_pending_;     ///< Ready slots that have not been sent yet
+    unsigned head_ = 0;                                 ///< Accessed by the consumer only
+
+    std::atomic<std::uint64_t> num_dropped_;
+    std::uint64_t num_tx_errors_ = 0;
+
+    void wakeUp()
+    {
+        if (socketcan_driver_ != nullptr)
+        {
+            socketcan_driver_->wakeUp();
+        }
+        if (epoll_driver_ != nullptr)
+        {
+            epoll_driver_->wakeUp();
+        }
+    }
+
+    Slot* claimSlot(unsigned& out_pos)
+    {
+        unsigned pos = tail_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Slot& slot = slots_[pos & (Capacity - 1U)];
+            const int diff = int(slot.sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                {
+                    out_pos = pos;
+                    return &slot;
+                }
+            }
+            else if (diff < 0)
+            {
+                num_dropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;                 // Full, the consumer has not released this slot yet
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void commitSlot(Slot& slot, unsigned pos)
+    {
+        slot.sequence.store(pos + 1U, std::memory_order_release);
+        if (num_pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+        {
+            wakeUp();                           // The consumer may be blocked, nobody has woken it up yet
+        }
+    }
+
+    bool sendOne()
+    {
+        Slot& slot = slots_[head_ & (Capacity - 1U)];
+        if (slot.sequence.load(std::memory_order_acquire) != (head_ + 1U))
+        {
+            return false;
+        }
+
+        if ((slot.channel >= 0) && (unsigned(slot.channel) < channels_.size()))
+        {
+            const Channel& ch = *channels_[unsigned(slot.channel)];
+            const int res = ch.sender.send(slot.payload, slot.payload_len,
+                                           node_.getDispatcher().getMonotonicTime() + ch.tx_timeout,
+                                           uavcan::MonotonicTime(), uavcan::TransferTypeMessageBroadcast,
+                                           uavcan::NodeID::Broadcast);
+            if (res < 0)
+            {
+                num_tx_errors_++;
+            }
+        }
+        else
+        {
+            num_tx_errors_++;                   // Invalid channel or the message could not be encoded
+        }
+
+        slot.sequence.store(head_ + Capacity, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+public:
+    /**
+     * Installs itself as the external TX source of the node.
+     * @throws uavcan_linux::Exception if the node already has an external TX source.
+     */
+    explicit TxInjectionQueue(uavcan::INode& node)
+        : node_(node)
+        , socketcan_driver_(dynamic_cast<SocketCanDriver*>(&node.getDispatcher().getCanIOManager().getCanDriver()))
+        , epoll_driver_(dynamic_cast<EpollSocketCanDriver*>(&node.getDispatcher().getCanIOManager().getCanDriver()))
+        , tail_(0)
+        , num_pending_(0)
+        , num_dropped_(0)
+    {
+        for (unsigned i = 0; i < Capacity; i++)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        if (node_.getDispatcher().getExternalTxSource() != nullptr)
+        {
+            throw Exception("The node already has an external TX source");
+        }
+        node_.getDispatcher().installExternalTxSource(this);
+    }
+
+    ~TxInjectionQueue()
+    {
+        if (node_.getDispatcher().getExternalTxSource() == this)
+        {
+            node_.getDispatcher().removeExternalTxSource();
+        }
+    }
+
+    /**
+     * Registers a message type; must be called from the spinning thread before the producers start.
+     * The TX timeout is counted from the moment the message is taken from the queue.
+     * @return Channel index to publish with, or negative error code.
+     */
+    template <typename DataType>
+    int addChannel(uavcan::TransferPriority priority = uavcan::TransferPriority::Default,
+                   uavcan::MonotonicDuration tx_timeout = uavcan::MonotonicDuration::fromMSec(100))
+    {
+        static_assert(unsigned(DataType::DataTypeKind) == unsigned(uavcan::DataTypeKindMessage),
+                      "Only messages can be published through the queue");
+
+        uavcan::GlobalDataTypeRegistry::instance().freeze();
+        const uavcan::DataTypeDescriptor* const descr =
+            uavcan::GlobalDataTypeRegistry::instance().find(uavcan::DataTypeKindMessage,
+                                                            DataType::getDataTypeFullName());
+        if (descr == nullptr)
+        {
+            return -uavcan::ErrUnknownDataType;
+        }
+        channels_.emplace_back(new Channel(node_.getDispatcher(), *descr, priority, tx_timeout));
+        return int(channels_.size() - 1U);
+    }
+
+    /**
+     * Producer side, any thread. Pushes an encoded message payload.
+     * @return False if the queue is full or the payload is too long; the message is dropped.
+     */
+    bool push(int channel, const std::uint8_t* payload, unsigned payload_len)
+    {
+        if (payload_len > MaxPayloadLen)
+        {
+            num_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        unsigned pos = 0;
+        Slot* const slot = claimSlot(pos);
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        slot->channel = channel;
+        slot->payload_len = payload_len;
+        std::memcpy(slot->payload, payload, payload_len);
+        commitSlot(*slot, pos);
+        return true;
+    }
+
+    /**
+     * Producer side, any thread. Encodes the message in the calling thread directly into the queue.
+     * The channel must have been added for the same data type.
+     * @return False if the queue is full; the message is dropped.
+     */
+    template <typename DataType>
+    bool publish(int channel, const DataType& message)
+    {
+        static_assert(uavcan::BitLenToByteLen<DataType::MaxBitLen>::Result <= MaxPayloadLen,
+                      "MaxPayloadLen is too small for this data type");
+        unsigned pos = 0;
+        Slot* const slot = claimSlot(pos);
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        uavcan::StaticTransferBufferImpl buffer(slot->payload, std::uint16_t(MaxPayloadLen));
+        uavcan::BitStream bitstream(buffer);
+        uavcan::ScalarCodec codec(bitstream);
+        const bool encoded = DataType::encode(message, codec, uavcan::TailArrayOptEnabled) > 0;
+        slot->channel = encoded ? channel : -1;         // The slot is committed anyway; the consumer will skip it
+        slot->payload_len = buffer.getMaxWritePos();
+        commitSlot(*slot, pos);
+        return encoded;
+    }
+
+    /**
+     * Consumer side, invoked by the dispatcher from the spinning thread.
+     * Sends at most Capacity messages per call, so that busy producers cannot stall the spinning thread.
+     */
+    void flushPendingTransfers() override
+    {
+        unsigned num_pending = num_pending_.load(std::memory_order_acquire);
+        unsigned num_sent_total = 0;
+        while (num_pending > 0)
+        {
+            unsigned num_sent = 0;
+            while ((num_sent < num_pending) && (num_sent_total < Capacity) && sendOne())
+            {
+                num_sent++;
+                num_sent_total++;
+            }
+            if (num_sent == 0)
+            {
+                // Either the budget is exhausted, or the next producer in line is still writing its slot.
+                // The spinning thread must not block on the messages that are already counted as pending.
+                wakeUp();
+                break;
+            }
+            num_pending = num_pending_.fetch_sub(num_sent, std::memory_order_acq_rel) - num_sent;
+        }
+    }
+
+    /**
+     * Number of messages that were not accepted because the queue was full or the payload was too long.
+     */
+    std::uint64_t getNumDropped() const { return num_dropped_.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of messages that were taken from the queue but could not be sent. Consumer side only.
+     */
+    std::uint64_t getNumTxErrors() const { return num_tx_errors_; }
+};
+
+}
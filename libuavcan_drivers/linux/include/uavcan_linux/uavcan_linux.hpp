@@ -10,3 +10,11 @@
 #include <uavcan_linux/socketcan.hpp>
 #include <uavcan_linux/helpers.hpp>
 #include <uavcan_linux/system_utils.hpp>
+#include <uavcan_linux/pool_allocator.hpp>
+#include <uavcan_linux/transfer_handoff.hpp>
+#include <uavcan_linux/tx_injection.hpp>
+#include <uavcan_linux/node_status_monitor.hpp>
+#include <uavcan_linux/virtual_can.hpp>
+#include <uavcan_linux/async_service_client.hpp>
+#include <uavcan_linux/frame_log.hpp>
+#include <uavcan_linux/realtime.hpp>
@@ -0,0 +1,599 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <uavcan/node/abstract_node.hpp>
+#include <uavcan_linux/clock.hpp>
+#include <uavcan_linux/exception.hpp>
+
+namespace uavcan_linux
+{
+/**
+ * Bounded lock-free single-producer single-consumer queue.
+ * The capacity is rounded up to the nearest power of two; the memory is allocated once in the constructor.
+ */
+template <typename T>
+class SpscQueue : uavcan::Noncopyable
+{
+    static unsigned roundUpToPowerOfTwo(unsigned x)
+    {
+        unsigned res = 1;
+        while (res < x)
+        {
+            res <<= 1;
+        }
+        return res;
+    }
+
+    const unsigned mask_;
+    std::unique_ptr<T[]> items_;
+
+    // The indexes are kept in separate cache lines to avoid false sharing between the producer and the consumer
+    std::atomic<unsigned> head_;                    ///< Written by the consumer only
+    std::uint8_t padding_[64];
+    std::atomic<unsigned> tail_;                    ///< Written by the producer only
+
+public:
+    explicit SpscQueue(unsigned min_capacity)
+        : mask_(roundUpToPowerOfTwo(min_capacity) - 1U)
+        , items_(new T[mask_ + 1U])
+        , head_(0)
+        , padding_()
+        , tail_(0)
+    { }
+
+    /**
+     * Producer side. Returns false if the queue is full.
+     */
+    bool tryPush(const T& item)
+    {
+        const unsigned tail = tail_.load(std::memory_order_relaxed);
+        if ((tail - head_.load(std::memory_order_acquire)) > mask_)
+        {
+            return false;
+        }
+        items_[tail & mask_] = item;
+        tail_.store(tail + 1U, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side. Returns false if the queue is empty.
+     */
+    bool tryPop(T& out_item)
+    {
+        const unsigned head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        out_item = items_[head & mask_];
+        head_.store(head + 1U, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+    bool isFull() const
+    {
+        return (tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire)) > mask_;
+    }
+
+    unsigned getCapacity() const { return mask_ + 1U; }
+};
+
+/**
+ * This interface defines one method that will be called by the main node thread periodically in order to
+ * transfer contents of TX queue of the sub-node into the TX queue of the main node.
+ */
+class ITxQueueInjector
+{
+public:
+    virtual ~ITxQueueInjector() { }
+
+    /**
+     * Flush contents of TX queues into the main node.
+     * @param main_node         Reference to the main node.
+     */
+    virtual void injectTxFramesInto(uavcan::INode& main_node) = 0;
+};
+
+/**
+ * Objects of this class are owned by the sub-node thread.
+ * The RX queue is filled by the main node thread, the TX queue is drained by the main node thread;
+ * neither direction takes a lock.
+ *
+ * The acceptance filters are emulated: the frames rejected by the filters are not copied into the RX queue at all,
+ * so a sub-node that keeps its filters configured with uavcan::CanAcceptanceFilterConfigurator does not receive
+ * the traffic it has no listeners for. Until the filters are configured, all frames are accepted.
+ */
+class VirtualCanIface : public uavcan::ICanIface,
+                        uavcan::Noncopyable
+{
+    struct RxItem
+    {
+        uavcan::CanRxFrame frame;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    struct TxItem
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime deadline;
+        uavcan::CanIOFlags flags = 0;
+    };
+
+    struct FilterItem
+    {
+        std::atomic<std::uint32_t> id;
+        std::atomic<std::uint32_t> mask;
+    };
+
+    static constexpr unsigned FiltersNotConfigured = ~0U;
+
+    SpscQueue<RxItem> rx_queue_;                    ///< Main thread --> sub-node thread
+    SpscQueue<TxItem> tx_queue_;                    ///< Sub-node thread --> main thread
+    std::atomic<std::uint64_t> num_rx_overflows_;
+    std::atomic<std::uint64_t> num_rx_filtered_;
+
+    // The filters are written by the sub-node thread and read by the main thread under a sequence lock
+    FilterItem filters_[uavcan::MaxCanAcceptanceFilters];
+    std::atomic<unsigned> num_filters_;
+    std::atomic<unsigned> filters_seq_;             ///< Odd while the filters are being updated
+
+    bool checkFilters(std::uint32_t can_id) const
+    {
+        const unsigned num_filters = num_filters_.load(std::memory_order_relaxed);
+        if (num_filters == FiltersNotConfigured)
+        {
+            return true;
+        }
+        for (unsigned i = 0; i < num_filters; i++)
+        {
+            const std::uint32_t mask = filters_[i].mask.load(std::memory_order_relaxed);
+            if (((can_id ^ filters_[i].id.load(std::memory_order_relaxed)) & mask) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::int16_t send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                      uavcan::CanIOFlags flags) override
+    {
+        TxItem item;
+        item.frame = frame;
+        item.deadline = tx_deadline;
+        item.flags = flags;
+        return tx_queue_.tryPush(item) ? 1 : 0;
+    }
+
+    std::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                         uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags) override
+    {
+        RxItem item;
+        if (!rx_queue_.tryPop(item))
+        {
+            return 0;
+        }
+        out_frame = item.frame;
+        out_ts_monotonic = item.frame.ts_mono;
+        out_ts_utc = item.frame.ts_utc;
+        out_flags = item.flags;
+        return 1;
+    }
+
+    /**
+     * Invoked by the sub-node thread; the main thread never blocks on it.
+     */
+    std::int16_t configureFilters(const uavcan::CanFilterConfig* filter_configs, std::uint16_t num_configs) override
+    {
+        if ((filter_configs == nullptr) || (num_configs > uavcan::MaxCanAcceptanceFilters))
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+        const unsigned seq = filters_seq_.load(std::memory_order_relaxed);
+        filters_seq_.store(seq + 1U, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (unsigned i = 0; i < num_configs; i++)
+        {
+            filters_[i].id.store(filter_configs[i].id, std::memory_order_relaxed);
+            filters_[i].mask.store(filter_configs[i].mask, std::memory_order_relaxed);
+        }
+        num_filters_.store(num_configs, std::memory_order_relaxed);
+        filters_seq_.store(seq + 2U, std::memory_order_release);
+        return 0;
+    }
+
+    std::uint16_t getNumFilters() const override { return std::uint16_t(uavcan::MaxCanAcceptanceFilters); }
+
+    /**
+     * Returns the number of frames that were dropped because the RX queue was full.
+     */
+    std::uint64_t getErrorCount() const override { return num_rx_overflows_.load(std::memory_order_relaxed); }
+
+public:
+    explicit VirtualCanIface(unsigned queue_capacity)
+        : rx_queue_(queue_capacity)
+        , tx_queue_(queue_capacity)
+        , num_rx_overflows_(0)
+        , num_rx_filtered_(0)
+        , filters_()
+        , num_filters_(FiltersNotConfigured)
+        , filters_seq_(0)
+    { }
+
+    /**
+     * Call this from the main thread only.
+     * Returns false if the frame is rejected by the acceptance filters; such frames are counted.
+     * Loopback frames are always accepted, since they are produced by the sub-node itself.
+     */
+    bool accept(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        if (flags & uavcan::CanIOFlagLoopback)
+        {
+            return true;
+        }
+        while (true)
+        {
+            const unsigned seq = filters_seq_.load(std::memory_order_acquire);
+            if ((seq & 1U) == 0)
+            {
+                const bool accepted = checkFilters(frame.id);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (filters_seq_.load(std::memory_order_relaxed) == seq)
+                {
+                    if (!accepted)
+                    {
+                        num_rx_filtered_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    return accepted;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Call this from the main thread only.
+     * Note that the newest frame is dropped if the RX queue is full.
+     */
+    bool addRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags)
+    {
+        RxItem item;
+        item.frame = frame;
+        item.flags = flags;
+        if (!rx_queue_.tryPush(item))
+        {
+            num_rx_overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Call this from the main thread only.
+     * Returns the number of frames removed from the TX queue.
+     */
+    unsigned flushTxQueueTo(uavcan::INode& main_node, std::uint8_t iface_index)
+    {
+        const std::uint8_t iface_mask = static_cast<std::uint8_t>(1U << iface_index);
+        unsigned num_flushed = 0;
+        TxItem item;
+        while (tx_queue_.tryPop(item))
+        {
+            num_flushed++;
+            const int res = main_node.injectTxFrame(item.frame, item.deadline, iface_mask,
+                                                    uavcan::CanTxQueue::Volatile, item.flags);
+            if (res <= 0)
+            {
+                break;
+            }
+        }
+        return num_flushed;
+    }
+
+    /**
+     * Number of frames that were not delivered to the sub-node because of the acceptance filters.
+     */
+    std::uint64_t getNumFilteredFrames() const { return num_rx_filtered_.load(std::memory_order_relaxed); }
+
+    /**
+     * Call this from the sub-node thread only.
+     */
+    bool hasDataInRxQueue() const { return !rx_queue_.isEmpty(); }
+    bool hasSpaceInTxQueue() const { return !tx_queue_.isFull(); }
+};
+
+/**
+ * CAN driver for a sub-node that runs in a separate thread and exchanges frames with the main node.
+ * Install it as the RX frame listener of the main node (directly, or via @ref VirtualCanHub if there are
+ * several sub-nodes), and call @ref injectTxFramesInto() from the main node thread periodically.
+ *
+ * Every interface has two lock-free single-producer single-consumer queues, one per direction.
+ * The interfaces support acceptance filters, so the sub-node should keep them configured according to its
+ * listeners with uavcan::CanAcceptanceFilterConfigurator (automatic reconfiguration); then the main node thread
+ * delivers to the sub-node only the frames it is interested in, and does not wake it up for anything else.
+ * When the sub-node thread has nothing to do, it sleeps in select() on an eventfd; the main node thread signals
+ * the eventfd only if the sub-node thread is actually sleeping, so in the busy state no system calls are made.
+ *
+ * Objects of this class are owned by the sub-node thread.
+ */
+class VirtualCanDriver : public uavcan::ICanDriver,
+                         public uavcan::IRxFrameListener,
+                         public ITxQueueInjector,
+                         uavcan::Noncopyable
+{
+    static constexpr unsigned SpinIterations = 100;
+
+    std::unique_ptr<VirtualCanIface> ifaces_[uavcan::MaxCanIfaces];
+    const unsigned num_ifaces_;
+    SystemClock clock_;
+    const int eventfd_;
+    std::atomic<bool> waiting_;
+    std::atomic<std::uint64_t> num_wakeups_;
+
+    /**
+     * Invoked by the main node thread when the sub-node thread may have become unblocked.
+     * The fence pairs with the one in select(), so that either the sub-node sees the new state or we see it waiting.
+     */
+    void wakeUp()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed))
+        {
+            const std::uint64_t one = 1;
+            (void)::write(eventfd_, &one, sizeof(one));
+            num_wakeups_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    uavcan::CanSelectMasks getReadyMasks(const uavcan::CanSelectMasks& requested) const
+    {
+        uavcan::CanSelectMasks ready;
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            const std::uint8_t iface_mask = static_cast<std::uint8_t>(1U << i);
+            if ((requested.read & iface_mask) && ifaces_[i]->hasDataInRxQueue())
+            {
+                ready.read |= iface_mask;
+            }
+            if ((requested.write & iface_mask) && ifaces_[i]->hasSpaceInTxQueue())
+            {
+                ready.write |= iface_mask;
+            }
+        }
+        return ready;
+    }
+
+    /**
+     * Returns true if any of the queues has changed state within the spin interval.
+     */
+    bool spin() const
+    {
+        for (unsigned i = 0; i < SpinIterations; i++)
+        {
+            for (unsigned k = 0; k < num_ifaces_; k++)
+            {
+                if (ifaces_[k]->hasDataInRxQueue())
+                {
+                    return true;
+                }
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    static std::int16_t countReadyIfaces(const uavcan::CanSelectMasks& masks)
+    {
+        std::int16_t res = 0;
+        for (unsigned i = 0; i < uavcan::MaxCanIfaces; i++)
+        {
+            res = std::int16_t(res + (((masks.read | masks.write) & (1U << i)) ? 1 : 0));
+        }
+        return res;
+    }
+
+    uavcan::ICanIface* getIface(std::uint8_t iface_index) override
+    {
+        return (iface_index < num_ifaces_) ? ifaces_[iface_index].get() : nullptr;
+    }
+
+    std::uint8_t getNumIfaces() const override { return std::uint8_t(num_ifaces_); }
+
+    /**
+     * This and other methods of ICanDriver will be invoked by the sub-node thread.
+     */
+    std::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                        const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                        uavcan::MonotonicTime blocking_deadline) override
+    {
+        const uavcan::CanSelectMasks requested = inout_masks;
+        while (true)
+        {
+            inout_masks = getReadyMasks(requested);
+            if ((inout_masks.read | inout_masks.write) != 0)
+            {
+                return countReadyIfaces(inout_masks);
+            }
+
+            const uavcan::MonotonicDuration timeout = blocking_deadline - clock_.getMonotonic();
+            if (!timeout.isPositive())
+            {
+                return 0;
+            }
+
+            // Waiting briefly before going to sleep, because frames usually come in bursts
+            if (spin())
+            {
+                continue;
+            }
+
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            int poll_res = 0;
+            inout_masks = getReadyMasks(requested);
+            if ((inout_masks.read | inout_masks.write) == 0)
+            {
+                ::pollfd fd = ::pollfd();
+                fd.fd = eventfd_;
+                fd.events = POLLIN;
+                ::timespec ts = ::timespec();
+                ts.tv_sec = std::time_t(timeout.toUSec() / 1000000);
+                ts.tv_nsec = long((timeout.toUSec() % 1000000) * 1000);
+                poll_res = ::ppoll(&fd, 1, &ts, nullptr);
+            }
+
+            waiting_.store(false, std::memory_order_relaxed);
+
+            std::uint64_t counter = 0;
+            (void)::read(eventfd_, &counter, sizeof(counter));        // Non-blocking, resets the event
+
+            if ((poll_res < 0) && (errno != EINTR))
+            {
+                return -1;
+            }
+        }
+    }
+
+public:
+    static constexpr unsigned DefaultQueueCapacity = 512;
+
+    /**
+     * @param arg_num_ifaces      Number of interfaces, usually the same as the number of ifaces of the main node.
+     * @param queue_capacity      Number of frames that fit into each RX and TX queue of each interface.
+     * @throws uavcan_linux::Exception.
+     */
+    explicit VirtualCanDriver(unsigned arg_num_ifaces, unsigned queue_capacity = DefaultQueueCapacity)
+        : num_ifaces_(arg_num_ifaces)
+        , eventfd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , waiting_(false)
+        , num_wakeups_(0)
+    {
+        if (eventfd_ < 0)
+        {
+            throw Exception("Failed to create eventfd");
+        }
+        if ((num_ifaces_ == 0) || (num_ifaces_ > uavcan::MaxCanIfaces))
+        {
+            (void)::close(eventfd_);
+            throw Exception("Invalid number of ifaces");
+        }
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            ifaces_[i].reset(new VirtualCanIface(queue_capacity));
+        }
+    }
+
+    ~VirtualCanDriver()
+    {
+        (void)::close(eventfd_);
+    }
+
+    /**
+     * This handler will be invoked by the main node thread.
+     */
+    void handleRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags) override
+    {
+        UAVCAN_TRACE("VirtualCanDriver", "RX [flags=%u]: %s", unsigned(flags), frame.toString().c_str());
+        if (frame.iface_index < num_ifaces_)
+        {
+            if (ifaces_[frame.iface_index]->accept(frame, flags))
+            {
+                (void)ifaces_[frame.iface_index]->addRxFrame(frame, flags);
+                wakeUp();
+            }
+        }
+        else
+        {
+            assert(false);
+        }
+    }
+
+    /**
+     * This method will be invoked by the main node thread.
+     */
+    void injectTxFramesInto(uavcan::INode& main_node) override
+    {
+        unsigned num_flushed = 0;
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            num_flushed += ifaces_[i]->flushTxQueueTo(main_node, std::uint8_t(i));
+        }
+        if (num_flushed > 0)
+        {
+            wakeUp();               // The sub-node may be waiting for free space in the TX queue
+        }
+    }
+
+    /**
+     * Number of times the main node thread had to wake up the sleeping sub-node thread.
+     */
+    std::uint64_t getNumWakeups() const { return num_wakeups_.load(std::memory_order_relaxed); }
+
+    /**
+     * Number of frames that were not delivered to the sub-node because of the acceptance filters, all ifaces.
+     */
+    std::uint64_t getNumFilteredFrames() const
+    {
+        std::uint64_t res = 0;
+        for (unsigned i = 0; i < num_ifaces_; i++)
+        {
+            res += ifaces_[i]->getNumFilteredFrames();
+        }
+        return res;
+    }
+};
+
+/**
+ * Connects several sub-nodes to one main node: the frames received by the main node are offered to every
+ * virtual driver, and the TX queues of every virtual driver are injected into the main node.
+ * A frame is copied only to the sub-nodes whose acceptance filters admit it, see @ref VirtualCanDriver.
+ * Install it as the RX frame listener of the main node. The drivers must be added before that.
+ * All methods must be invoked from the main node thread.
+ */
+class VirtualCanHub : public uavcan::IRxFrameListener,
+                      public ITxQueueInjector,
+                      uavcan::Noncopyable
+{
+    std::vector<VirtualCanDriver*> drivers_;
+
+public:
+    void addDriver(VirtualCanDriver& driver) { drivers_.push_back(&driver); }
+
+    void handleRxFrame(const uavcan::CanRxFrame& frame, uavcan::CanIOFlags flags) override
+    {
+        for (VirtualCanDriver* d : drivers_)
+        {
+            d->handleRxFrame(frame, flags);
+        }
+    }
+
+    void injectTxFramesInto(uavcan::INode& main_node) override
+    {
+        for (VirtualCanDriver* d : drivers_)
+        {
+            d->injectTxFramesInto(main_node);
+        }
+    }
+
+    unsigned getNumDrivers() const { return unsigned(drivers_.size()); }
+};
+
+}
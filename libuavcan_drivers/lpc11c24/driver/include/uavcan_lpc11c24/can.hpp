@@ -6,6 +6,14 @@
 
 #include <uavcan/driver/can.hpp>
 
+/**
+ * CAN interrupt profiling with SysTick, see @ref uavcan_lpc11c24::CanDriver::getIsrProfile().
+ * This is intended for benchmarking only, because every CAN interrupt is slowed down by a few cycles.
+ */
+#ifndef UAVCAN_LPC11C24_ISR_PROFILING
+# define UAVCAN_LPC11C24_ISR_PROFILING 0
+#endif
+
 namespace uavcan_lpc11c24
 {
 /**
@@ -38,6 +46,12 @@ public:
     bool hasReadyRx() const;
     bool hasEmptyTx() const;
 
+    /**
+     * Whether the frame can be loaded into a TX message object right now without breaking the transmission order;
+     * see the message object allocation notes in the implementation.
+     */
+    bool isWritable(const uavcan::CanFrame* pending_tx) const;
+
     /**
      * This method will return true only if there was any CAN bus activity since previous call of this method.
      * This is intended to be used for LED iface activity indicators.
@@ -64,6 +78,39 @@ public:
     virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index);
 
     virtual uavcan::uint8_t getNumIfaces() const;
+
+#if UAVCAN_LPC11C24_ISR_PROFILING
+    /**
+     * Execution time of the CAN interrupt handler in CPU cycles, measured with SysTick, which is also used by the
+     * clock driver; the clock must be initialized first. All CAN events share the same interrupt, so this includes
+     * the TX completion and error handling as well, but it is dominated by the reception under load.
+     * The interrupt entry and exit overhead of the core is not included.
+     */
+    struct IsrProfile
+    {
+        uavcan::uint64_t total_cycles;
+        uavcan::uint32_t max_cycles;
+        uavcan::uint32_t num_calls;
+
+        IsrProfile()
+            : total_cycles(0)
+            , max_cycles(0)
+            , num_calls(0)
+        { }
+
+        void add(uavcan::uint32_t cycles)
+        {
+            total_cycles += cycles;
+            max_cycles = (cycles > max_cycles) ? cycles : max_cycles;
+            num_calls++;
+        }
+    };
+
+    /**
+     * Returns the accumulated profile; see UAVCAN_LPC11C24_ISR_PROFILING.
+     */
+    IsrProfile getIsrProfile() const;
+#endif
 };
 
 }
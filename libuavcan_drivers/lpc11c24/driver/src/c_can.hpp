@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ * Register layout and bit definitions are taken from the LPC11Cxx user manual (UM10398), chapter 16.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chip.h>
+
+namespace uavcan_lpc11c24
+{
+namespace c_can
+{
+/**
+ * Message interface register set. There are two of them; the ROM driver is free to use either, so the driver
+ * must access the message RAM only with the CAN interrupt disabled.
+ */
+struct MsgIfaceType
+{
+    volatile uint32_t CMDREQ;       ///< Command request,           Offset: 0x00
+    volatile uint32_t CMDMSK;       ///< Command mask,              Offset: 0x04
+    volatile uint32_t MSK1;         ///< Mask 1,                    Offset: 0x08
+    volatile uint32_t MSK2;         ///< Mask 2,                    Offset: 0x0C
+    volatile uint32_t ARB1;         ///< Arbitration 1,             Offset: 0x10
+    volatile uint32_t ARB2;         ///< Arbitration 2,             Offset: 0x14
+    volatile uint32_t MCTRL;        ///< Message control,           Offset: 0x18
+    volatile uint32_t DA1;          ///< Data A1,                   Offset: 0x1C
+    volatile uint32_t DA2;          ///< Data A2,                   Offset: 0x20
+    volatile uint32_t DB1;          ///< Data B1,                   Offset: 0x24
+    volatile uint32_t DB2;          ///< Data B2,                   Offset: 0x28
+    uint32_t RESERVED[13];          ///< Reserved,                  Offset: 0x2C - 0x5F
+};
+
+struct Type
+{
+    volatile uint32_t CNTL;         ///< Control,                   Offset: 0x000
+    volatile uint32_t STAT;         ///< Status,                    Offset: 0x004
+    volatile uint32_t EC;           ///< Error counter,             Offset: 0x008
+    volatile uint32_t BT;           ///< Bit timing,                Offset: 0x00C
+    volatile uint32_t INT;          ///< Interrupt,                 Offset: 0x010
+    volatile uint32_t TEST;         ///< Test,                      Offset: 0x014
+    volatile uint32_t BRPE;         ///< Baud rate prescaler ext.,  Offset: 0x018
+    uint32_t RESERVED0;             ///< Reserved,                  Offset: 0x01C
+    MsgIfaceType IF[2];             ///< Message interfaces,        Offset: 0x020 - 0x0DF
+    uint32_t RESERVED1[8];          ///< Reserved,                  Offset: 0x0E0 - 0x0FF
+    volatile uint32_t TXREQ1;       ///< Transmission request 1,    Offset: 0x100
+    volatile uint32_t TXREQ2;       ///< Transmission request 2,    Offset: 0x104
+    uint32_t RESERVED2[6];          ///< Reserved,                  Offset: 0x108 - 0x11F
+    volatile uint32_t ND1;          ///< New data 1,                Offset: 0x120
+    volatile uint32_t ND2;          ///< New data 2,                Offset: 0x124
+    uint32_t RESERVED3[6];          ///< Reserved,                  Offset: 0x128 - 0x13F
+    volatile uint32_t IR1;          ///< Interrupt pending 1,       Offset: 0x140
+    volatile uint32_t IR2;          ///< Interrupt pending 2,       Offset: 0x144
+    uint32_t RESERVED4[6];          ///< Reserved,                  Offset: 0x148 - 0x15F
+    volatile uint32_t MSGV1;        ///< Message valid 1,           Offset: 0x160
+    volatile uint32_t MSGV2;        ///< Message valid 2,           Offset: 0x164
+    uint32_t RESERVED5[6];          ///< Reserved,                  Offset: 0x168 - 0x17F
+    volatile uint32_t CLKDIV;       ///< Clock divider,             Offset: 0x180
+};
+
+Type* const CAN = reinterpret_cast<Type*>(LPC_CAN0_BASE);
+
+/**
+ * CMDREQ
+ */
+static const uint32_t CMDREQ_MN_MASK     = 0x3FU;
+static const uint32_t CMDREQ_BUSY        = 1U << 15;
+
+/**
+ * CMDMSK
+ */
+static const uint32_t CMDMSK_DATA_B      = 1U << 0;
+static const uint32_t CMDMSK_DATA_A      = 1U << 1;
+static const uint32_t CMDMSK_NEWDAT      = 1U << 2;     ///< TXRQST in write direction
+static const uint32_t CMDMSK_CLRINTPND   = 1U << 3;
+static const uint32_t CMDMSK_CTRL        = 1U << 4;
+static const uint32_t CMDMSK_ARB         = 1U << 5;
+static const uint32_t CMDMSK_MASK        = 1U << 6;
+static const uint32_t CMDMSK_WR          = 1U << 7;
+
+/**
+ * MSK2
+ */
+static const uint32_t MSK2_MSK_MASK      = 0x1FFFU;     ///< Mask bits 28..16
+static const uint32_t MSK2_MDIR          = 1U << 14;
+static const uint32_t MSK2_MXTD          = 1U << 15;
+
+/**
+ * ARB2
+ */
+static const uint32_t ARB2_ID_MASK       = 0x1FFFU;     ///< ID bits 28..16
+static const uint32_t ARB2_DIR           = 1U << 13;
+static const uint32_t ARB2_XTD           = 1U << 14;
+static const uint32_t ARB2_MSGVAL        = 1U << 15;
+
+/**
+ * MCTRL
+ */
+static const uint32_t MCTRL_DLC_MASK     = 0x0FU;
+static const uint32_t MCTRL_EOB          = 1U << 7;
+static const uint32_t MCTRL_TXRQST       = 1U << 8;
+static const uint32_t MCTRL_RMTEN        = 1U << 9;
+static const uint32_t MCTRL_RXIE         = 1U << 10;
+static const uint32_t MCTRL_TXIE         = 1U << 11;
+static const uint32_t MCTRL_UMASK        = 1U << 12;
+static const uint32_t MCTRL_INTPND       = 1U << 13;
+static const uint32_t MCTRL_MSGLST       = 1U << 14;
+static const uint32_t MCTRL_NEWDAT       = 1U << 15;
+
+}
+}
@@ -7,6 +7,7 @@
 #include <uavcan/util/templates.hpp>
 #include <chip.h>
 #include "internal.hpp"
+#include "c_can.hpp"
 
 /**
  * The default value should be OK for any use case.
@@ -19,6 +20,18 @@
 # error UAVCAN_LPC11C24_RX_QUEUE_LEN is too large
 #endif
 
+/**
+ * Number of message objects used for transmission; the rest is used for reception.
+ * More objects allow to keep the bus busy at high TX rates, at the cost of fewer RX objects.
+ */
+#ifndef UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS
+# define UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS   3
+#endif
+
+#if (UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS < 1) || (UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS > 16)
+# error UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS must be within [1, 16]
+#endif
+
 extern "C" void canRxCallback(uint8_t msg_obj_num);
 extern "C" void canTxCallback(uint8_t msg_obj_num);
 extern "C" void canErrorCallback(uint32_t error_info);
@@ -29,12 +42,29 @@ namespace
 {
 /**
  * Hardware message objects are allocated as follows:
- *  - 1 - Single TX object
- *  - 2..32 - RX objects
+ *  - 1..N - TX objects, N = UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS
+ *  - N+1..32 - RX objects
  * TX priority is defined by the message object number, not by the CAN ID (chapter 16.7.3.5 of the user manual),
- * hence we can't use more than one object because that would cause priority inversion on long transfers.
+ * hence a new frame can be loaded only into such a free object that all pending frames in the lower numbered objects
+ * have the same or higher priority, and all pending frames in the higher numbered objects have lower priority.
+ * This keeps the order of transmission the same as if the frames were arbitrated by CAN ID, see findTxMsgObject().
+ *
+ * The RX objects are split evenly between the configured acceptance filters. The objects of every filter are
+ * chained into a hardware FIFO (all but the last one have EOB cleared), so the frames that arrive while the CAN
+ * interrupt is delayed are kept by the controller rather than overwritten. Without filters, all RX objects make
+ * up a single FIFO that accepts everything.
  */
 const unsigned NumMsgObjects = 32;
+const unsigned FirstTxMsgObject = 1;
+const unsigned NumTxMsgObjects = UAVCAN_LPC11C24_NUM_TX_MSG_OBJECTS;
+const unsigned FirstRxMsgObject = FirstTxMsgObject + NumTxMsgObjects;
+const unsigned NumRxMsgObjects = NumMsgObjects - FirstRxMsgObject + 1;
+
+/**
+ * Number of the last message object of the FIFO every RX message object belongs to, indexed by the message object
+ * number. Zero for the objects that are not used for reception.
+ */
+uint8_t rx_fifo_end[NumMsgObjects + 1];
 
 /**
  * Total number of CAN errors.
@@ -42,10 +72,31 @@ const unsigned NumMsgObjects = 32;
  */
 uint32_t error_cnt;
 
+#if UAVCAN_LPC11C24_ISR_PROFILING
+CanDriver::IsrProfile isr_profile;
+
 /**
- * True if there's no pending TX frame, i.e. write is possible.
+ * SysTick counts downwards and wraps at the reload value, which is longer than any interrupt.
  */
-bool tx_free = true;
+uint32_t getSysTickCyclesSince(uint32_t started_at)
+{
+    const uint32_t now = SysTick->VAL;
+    return (now <= started_at) ? (started_at - now) : (started_at + (SysTick->LOAD + 1U) - now);
+}
+#endif
+
+/**
+ * Frames loaded into the TX message objects, indexed from the first TX object.
+ */
+struct TxItem
+{
+    uavcan::MonotonicTime deadline;
+    uavcan::CanFrame frame;
+    bool pending;
+    TxItem() : pending(false) { }
+};
+
+TxItem tx_items[NumTxMsgObjects];
 
 /**
  * Gets updated every time the CAN IRQ handler is being called.
@@ -128,6 +179,178 @@ public:
 
 RxQueue rx_queue;
 
+/**
+ * Must be called with the CAN interrupt disabled, because the ROM driver uses the message interfaces too.
+ */
+void writeRxMsgObject(unsigned msgobj, const uavcan::CanFilterConfig& filter, bool end_of_fifo)
+{
+    const bool ext = (filter.id & uavcan::CanFrame::FlagEFF) != 0;
+    const bool match_ext = (filter.mask & uavcan::CanFrame::FlagEFF) != 0;
+
+    // Standard IDs occupy the bits 28..18 of the 29-bit identifier field
+    const uint32_t id   = ext ? (filter.id & uavcan::CanFrame::MaskExtID) :
+                                ((filter.id & uavcan::CanFrame::MaskStdID) << 18);
+    const uint32_t mask = ext ? (filter.mask & uavcan::CanFrame::MaskExtID) :
+                                ((filter.mask & uavcan::CanFrame::MaskStdID) << 18);
+
+    c_can::MsgIfaceType& iface = c_can::CAN->IF[1];
+    while ((iface.CMDREQ & c_can::CMDREQ_BUSY) != 0) { }
+
+    iface.CMDMSK = c_can::CMDMSK_WR | c_can::CMDMSK_MASK | c_can::CMDMSK_ARB | c_can::CMDMSK_CTRL |
+                   c_can::CMDMSK_CLRINTPND;
+    iface.MSK1  = mask & 0xFFFFU;
+    iface.MSK2  = ((mask >> 16) & c_can::MSK2_MSK_MASK) | c_can::MSK2_MDIR | (match_ext ? c_can::MSK2_MXTD : 0);
+    iface.ARB1  = id & 0xFFFFU;
+    iface.ARB2  = ((id >> 16) & c_can::ARB2_ID_MASK) | (ext ? c_can::ARB2_XTD : 0) | c_can::ARB2_MSGVAL;
+    iface.MCTRL = c_can::MCTRL_UMASK | c_can::MCTRL_RXIE | (end_of_fifo ? c_can::MCTRL_EOB : 0);
+    iface.CMDREQ = msgobj & c_can::CMDREQ_MN_MASK;
+
+    while ((iface.CMDREQ & c_can::CMDREQ_BUSY) != 0) { }
+}
+
+/**
+ * Distributes the RX message objects between the filters; see the allocation notes above.
+ * Must be called with the CAN interrupt disabled.
+ */
+void configureRxMsgObjects(const uavcan::CanFilterConfig* filter_configs, unsigned num_configs)
+{
+    static const uavcan::CanFilterConfig AcceptAll = uavcan::CanFilterConfig();
+    if (num_configs == 0)
+    {
+        filter_configs = &AcceptAll;
+        num_configs = 1;
+    }
+
+    uavcan::fill(rx_fifo_end, rx_fifo_end + NumMsgObjects + 1, uint8_t(0));
+
+    unsigned msgobj = FirstRxMsgObject;
+    for (unsigned i = 0; i < num_configs; i++)
+    {
+        const unsigned depth = (NumRxMsgObjects / num_configs) + ((i < (NumRxMsgObjects % num_configs)) ? 1U : 0U);
+        const unsigned last = msgobj + depth - 1;
+        for (; msgobj <= last; msgobj++)
+        {
+            writeRxMsgObject(msgobj, filter_configs[i], msgobj == last);
+            rx_fifo_end[msgobj] = uint8_t(last);
+        }
+    }
+}
+
+/**
+ * Returns the index of the TX object the frame can be loaded into, or -1 if there is none at the moment.
+ * Must be called with the CAN interrupt disabled.
+ */
+int findTxMsgObject(const uavcan::CanFrame& frame)
+{
+    for (unsigned k = 0; k < NumTxMsgObjects; k++)
+    {
+        if (tx_items[k].pending)
+        {
+            continue;
+        }
+        bool order_preserved = true;
+        for (unsigned j = 0; (j < NumTxMsgObjects) && order_preserved; j++)
+        {
+            if (tx_items[j].pending)
+            {
+                const bool lower = tx_items[j].frame.priorityLowerThan(frame);
+                order_preserved = (j < k) ? !lower : lower;
+            }
+        }
+        if (order_preserved)
+        {
+            return int(k);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Cancels the transmission request of the message object. If the frame is being transmitted at the moment,
+ * the transmission will be completed anyway.
+ * Must be called with the CAN interrupt disabled.
+ */
+void abortTxMsgObject(unsigned msgobj)
+{
+    c_can::MsgIfaceType& iface = c_can::CAN->IF[1];
+    while ((iface.CMDREQ & c_can::CMDREQ_BUSY) != 0) { }
+
+    iface.CMDMSK = c_can::CMDMSK_CTRL;                      // Read the control register
+    iface.CMDREQ = msgobj & c_can::CMDREQ_MN_MASK;
+    while ((iface.CMDREQ & c_can::CMDREQ_BUSY) != 0) { }
+
+    iface.CMDMSK = c_can::CMDMSK_WR | c_can::CMDMSK_CTRL;
+    iface.MCTRL  = iface.MCTRL & ~(c_can::MCTRL_TXRQST | c_can::MCTRL_INTPND);
+    iface.CMDREQ = msgobj & c_can::CMDREQ_MN_MASK;
+    while ((iface.CMDREQ & c_can::CMDREQ_BUSY) != 0) { }
+}
+
+void discardTimedOutTxMsgObjects(uavcan::MonotonicTime current_time)
+{
+    CriticalSectionLocker locker;
+    for (unsigned i = 0; i < NumTxMsgObjects; i++)
+    {
+        if (tx_items[i].pending && (tx_items[i].deadline < current_time))
+        {
+            abortTxMsgObject(FirstTxMsgObject + i);
+            tx_items[i].pending = false;
+            if (error_cnt < 0xFFFFFFFF)
+            {
+                error_cnt++;
+            }
+        }
+    }
+}
+
+bool canAcceptNewTxFrame(const uavcan::CanFrame& frame)
+{
+    CriticalSectionLocker locker;
+    return findTxMsgObject(frame) >= 0;
+}
+
+bool hasNewData(unsigned msgobj)
+{
+    const unsigned index = msgobj - 1U;
+    const uint32_t nd = (index < 16) ? c_can::CAN->ND1 : c_can::CAN->ND2;
+    return (nd & (1U << (index % 16))) != 0;
+}
+
+/**
+ * Fetches the frame from the message object via the ROM driver, which also releases the object.
+ */
+void receiveFromMsgObject(uint8_t msgobj)
+{
+    CCAN_MSG_OBJ_T msg_obj = CCAN_MSG_OBJ_T();
+    msg_obj.msgobj = msgobj;
+    LPC_CCAN_API->can_receive(&msg_obj);
+
+    uavcan::CanFrame frame;
+
+    // CAN ID, EXT or not
+    if (msg_obj.mode_id & CAN_MSGOBJ_EXT)
+    {
+        frame.id = msg_obj.mode_id & uavcan::CanFrame::MaskExtID;
+        frame.id |= uavcan::CanFrame::FlagEFF;
+    }
+    else
+    {
+        frame.id = msg_obj.mode_id & uavcan::CanFrame::MaskStdID;
+    }
+
+    // RTR
+    if (msg_obj.mode_id & CAN_MSGOBJ_RTR)
+    {
+        frame.id |= uavcan::CanFrame::FlagRTR;
+    }
+
+    // Payload
+    frame.dlc = msg_obj.dlc;
+    uavcan::copy(msg_obj.data, msg_obj.data + msg_obj.dlc, frame.data);
+
+    rx_queue.push(frame, last_irq_utc_timestamp);
+    had_activity = true;
+}
+
 
 int computeBaudrate(uint32_t baud_rate, uint32_t can_api_timing_cfg[2])
 {
@@ -167,7 +390,10 @@ int CanDriver::init(uavcan::uint32_t baudrate)
     CriticalSectionLocker locker;
 
     error_cnt = 0;
-    tx_free = true;
+    for (unsigned i = 0; i < NumTxMsgObjects; i++)
+    {
+        tx_items[i] = TxItem();
+    }
     last_irq_utc_timestamp = 0;
     had_activity = false;
 
@@ -196,17 +422,9 @@ int CanDriver::init(uavcan::uint32_t baudrate)
     NVIC_EnableIRQ(CAN_IRQn);
 
     /*
-     * Default RX msgobj config:
-     *  31 - all STD
-     *  32 - all EXT
-     * RTR ignored
+     * Default RX msgobj config - all RX objects make up one FIFO that accepts everything
      */
-    CCAN_MSG_OBJ_T msg_obj = CCAN_MSG_OBJ_T();
-    msg_obj.msgobj = 31;
-    LPC_CCAN_API->config_rxmsgobj(&msg_obj);
-    msg_obj.mode_id = CAN_MSGOBJ_EXT;
-    msg_obj.msgobj = 32;
-    LPC_CCAN_API->config_rxmsgobj(&msg_obj);
+    configureRxMsgObjects(NULL, 0);
 
     return 0;
 }
@@ -220,7 +438,20 @@ bool CanDriver::hasReadyRx() const
 bool CanDriver::hasEmptyTx() const
 {
     CriticalSectionLocker locker;
-    return tx_free;
+    for (unsigned i = 0; i < NumTxMsgObjects; i++)
+    {
+        if (!tx_items[i].pending)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CanDriver::isWritable(const uavcan::CanFrame* pending_tx) const
+{
+    // Without the frame to check against, any free TX object will do
+    return (pending_tx == NULL) ? hasEmptyTx() : canAcceptNewTxFrame(*pending_tx);
 }
 
 bool CanDriver::hadActivity()
@@ -231,6 +462,14 @@ bool CanDriver::hadActivity()
     return ret;
 }
 
+#if UAVCAN_LPC11C24_ISR_PROFILING
+CanDriver::IsrProfile CanDriver::getIsrProfile() const
+{
+    CriticalSectionLocker locker;
+    return isr_profile;
+}
+#endif
+
 uavcan::int16_t CanDriver::send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
                                 uavcan::CanIOFlags flags)
 {
@@ -260,18 +499,20 @@ uavcan::int16_t CanDriver::send(const uavcan::CanFrame& frame, uavcan::Monotonic
     /*
      * Transmission
      */
-    (void)tx_deadline;               // TX timeouts are not supported by this driver yet (and hardly going to be).
-
     CriticalSectionLocker locker;
 
-    if (tx_free)
+    const int index = findTxMsgObject(frame);
+    if (index < 0)
     {
-        tx_free = false;   // Mark as pending - will be released in TX callback
-        msgobj.msgobj = 1;
-        LPC_CCAN_API->can_transmit(&msgobj);
-        return 1;
+        return 0;
     }
-    return 0;
+    TxItem& txi = tx_items[index];
+    txi.deadline = tx_deadline;
+    txi.frame = frame;
+    txi.pending = true;                 // Will be released in TX callback, or upon timeout
+    msgobj.msgobj = uint8_t(FirstTxMsgObject + unsigned(index));
+    LPC_CCAN_API->can_transmit(&msgobj);
+    return 1;
 }
 
 uavcan::int16_t CanDriver::receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
@@ -292,11 +533,13 @@ uavcan::int16_t CanDriver::receive(uavcan::CanFrame& out_frame, uavcan::Monotoni
 }
 
 uavcan::int16_t CanDriver::select(uavcan::CanSelectMasks& inout_masks,
-                                  const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                  const uavcan::CanFrame* (& pending_tx)[uavcan::MaxCanIfaces],
                                   uavcan::MonotonicTime blocking_deadline)
 {
+    discardTimedOutTxMsgObjects(clock::getMonotonic());  // This may release some TX objects
+
     const bool noblock = ((inout_masks.read  == 1) && hasReadyRx()) ||
-                         ((inout_masks.write == 1) && hasEmptyTx());
+                         ((inout_masks.write == 1) && isWritable(pending_tx[0]));
 
     if (!noblock && (clock::getMonotonic() > blocking_deadline))
     {
@@ -322,16 +565,20 @@ uavcan::int16_t CanDriver::select(uavcan::CanSelectMasks& inout_masks,
     }
 
     inout_masks.read  = hasReadyRx() ? 1 : 0;
-    inout_masks.write = hasEmptyTx() ? 1 : 0;
+    inout_masks.write = isWritable(pending_tx[0]) ? 1 : 0;
     return 0;  // Return value doesn't matter as long as it is non-negative
 }
 
 uavcan::int16_t CanDriver::configureFilters(const uavcan::CanFilterConfig* filter_configs,
                                             uavcan::uint16_t num_configs)
 {
-    (void)filter_configs;
-    (void)num_configs;
-    return -1;
+    if ((num_configs > getNumFilters()) || ((filter_configs == NULL) && (num_configs > 0)))
+    {
+        return -1;
+    }
+    CriticalSectionLocker locker;
+    configureRxMsgObjects(filter_configs, num_configs);
+    return 0;
 }
 
 uavcan::uint64_t CanDriver::getErrorCount() const
@@ -342,7 +589,7 @@ uavcan::uint64_t CanDriver::getErrorCount() const
 
 uavcan::uint16_t CanDriver::getNumFilters() const
 {
-    return NumMsgObjects - 1;  // First msgobj is reserved for TX frame
+    return NumRxMsgObjects;    // First msgobj is reserved for TX frame; every filter takes at least one msgobj
 }
 
 uavcan::ICanIface* CanDriver::getIface(uavcan::uint8_t iface_index)
@@ -365,41 +612,31 @@ extern "C"
 
 void canRxCallback(uint8_t msg_obj_num)
 {
-    CCAN_MSG_OBJ_T msg_obj = CCAN_MSG_OBJ_T();
-    msg_obj.msgobj = msg_obj_num;
-    LPC_CCAN_API->can_receive(&msg_obj);
+    uavcan_lpc11c24::receiveFromMsgObject(msg_obj_num);
 
-    uavcan::CanFrame frame;
-
-    // CAN ID, EXT or not
-    if (msg_obj.mode_id & CAN_MSGOBJ_EXT)
-    {
-        frame.id = msg_obj.mode_id & uavcan::CanFrame::MaskExtID;
-        frame.id |= uavcan::CanFrame::FlagEFF;
-    }
-    else
-    {
-        frame.id = msg_obj.mode_id & uavcan::CanFrame::MaskStdID;
-    }
-
-    // RTR
-    if (msg_obj.mode_id & CAN_MSGOBJ_RTR)
+    /*
+     * The objects of a FIFO are filled in the order of their numbers, so the rest of the FIFO is emptied right away,
+     * in the same order, rather than on the next interrupts. The preceding objects have been read already, because
+     * the lower object numbers have higher interrupt priority.
+     */
+    const uint8_t fifo_end = (msg_obj_num <= uavcan_lpc11c24::NumMsgObjects) ?
+                             uavcan_lpc11c24::rx_fifo_end[msg_obj_num] : 0;
+    for (uint8_t msgobj = uint8_t(msg_obj_num + 1U); msgobj <= fifo_end; msgobj++)
     {
-        frame.id |= uavcan::CanFrame::FlagRTR;
+        if (uavcan_lpc11c24::hasNewData(msgobj))
+        {
+            uavcan_lpc11c24::receiveFromMsgObject(msgobj);
+        }
     }
-
-    // Payload
-    frame.dlc = msg_obj.dlc;
-    uavcan::copy(msg_obj.data, msg_obj.data + msg_obj.dlc, frame.data);
-
-    uavcan_lpc11c24::rx_queue.push(frame, uavcan_lpc11c24::last_irq_utc_timestamp);
-    uavcan_lpc11c24::had_activity = true;
 }
 
 void canTxCallback(uint8_t msg_obj_num)
 {
-    (void)msg_obj_num;
-    uavcan_lpc11c24::tx_free = true;
+    const unsigned index = unsigned(msg_obj_num) - uavcan_lpc11c24::FirstTxMsgObject;
+    if (index < uavcan_lpc11c24::NumTxMsgObjects)
+    {
+        uavcan_lpc11c24::tx_items[index].pending = false;
+    }
     uavcan_lpc11c24::had_activity = true;
 }
 
@@ -416,8 +653,14 @@ void CAN_IRQHandler();
 
 void CAN_IRQHandler()
 {
+#if UAVCAN_LPC11C24_ISR_PROFILING
+    const uint32_t started_at = SysTick->VAL;
+#endif
     uavcan_lpc11c24::last_irq_utc_timestamp = uavcan_lpc11c24::clock::getUtcUSecFromCanInterrupt();
     LPC_CCAN_API->isr();
+#if UAVCAN_LPC11C24_ISR_PROFILING
+    uavcan_lpc11c24::isr_profile.add(uavcan_lpc11c24::getSysTickCyclesSince(started_at));
+#endif
 }
 
 }
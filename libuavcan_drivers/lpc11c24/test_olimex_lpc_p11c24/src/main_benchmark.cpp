@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * On-target benchmark; build with:
+ *   make MAIN=main_benchmark.cpp
+ * The report is printed to UART0 (PIO1_7 TXD, 115200 8N1) periodically. All figures are CPU cycles.
+ * The CAN ISR figures are collected from the real bus traffic, so the board should be connected to a loaded bus;
+ * all other figures are synthetic and do not depend on the bus.
+ * Given the amount of RAM available, only the small data types are benchmarked here.
+ */
+
+#include <board.hpp>
+#include <chip.h>
+#include <uavcan_lpc11c24/uavcan_lpc11c24.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+
+namespace
+{
+
+#if __GNUC__
+__attribute__((noreturn))
+#endif
+void die()
+{
+    while (true) { }
+}
+
+/*
+ * UART
+ * The chip library doesn't include the UART driver, so the registers are accessed via the inline helpers.
+ */
+void initUart()
+{
+    LPC_IOCON->REG[IOCON_PIO1_6] = IOCON_FUNC1 | IOCON_MODE_INACT;     // RXD
+    LPC_IOCON->REG[IOCON_PIO1_7] = IOCON_FUNC1 | IOCON_MODE_INACT;     // TXD
+
+    Chip_Clock_SetUARTClockDiv(1);
+    Chip_Clock_EnablePeriphClock(SYSCTL_CLOCK_UART0);
+
+    const uint32_t divisor = (SystemCoreClock + 8 * 115200) / (16 * 115200);
+
+    Chip_UART_ConfigData(LPC_USART, UART_LCR_WLEN8 | UART_LCR_SBS_1BIT | UART_LCR_PARITY_DIS);
+    Chip_UART_EnableDivisorAccess(LPC_USART);
+    Chip_UART_SetDivisorLatches(LPC_USART, uint8_t(divisor & 0xFF), uint8_t(divisor >> 8));
+    Chip_UART_DisableDivisorAccess(LPC_USART);
+    Chip_UART_SetupFIFOS(LPC_USART, UART_FCR_FIFO_EN | UART_FCR_RX_RS | UART_FCR_TX_RS);
+    Chip_UART_TXEnable(LPC_USART);
+}
+
+void print(const char* s)
+{
+    while (*s != '\0')
+    {
+        while ((Chip_UART_ReadLineStatus(LPC_USART) & UART_LSR_THRE) == 0)
+        {
+        }
+        Chip_UART_SendByte(LPC_USART, uint8_t(*s++));
+    }
+}
+
+/**
+ * We don't want to use the formatting functions, because they rely on std::snprintf().
+ */
+void print(uint32_t n)
+{
+    char buf[11];
+    unsigned i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do
+    {
+        buf[--i] = char(n % 10 + '0');
+    }
+    while ((n /= 10) > 0);
+    print(&buf[i]);
+}
+
+/*
+ * SysTick is configured by the clock driver; it counts downwards and wraps at the reload value,
+ * which is much longer than any of the measured operations.
+ */
+inline uint32_t getSysTick()
+{
+    return SysTick->VAL;
+}
+
+uint32_t getCyclesSince(uint32_t started_at)
+{
+    const uint32_t now = SysTick->VAL;
+    return (now <= started_at) ? (started_at - now) : (started_at + (SysTick->LOAD + 1U) - now);
+}
+
+struct Measurement
+{
+    uint64_t total_cycles = 0;
+    uint32_t max_cycles = 0;
+    uint32_t num_samples = 0;
+
+    void add(uint32_t cycles)
+    {
+        total_cycles += cycles;
+        max_cycles = (cycles > max_cycles) ? cycles : max_cycles;
+        num_samples++;
+    }
+
+    void print(const char* name) const
+    {
+        ::print(name);
+        ::print(": avg ");
+        ::print((num_samples > 0) ? uint32_t(total_cycles / num_samples) : 0U);
+        ::print(" max ");
+        ::print(max_cycles);
+        ::print(" n ");
+        ::print(num_samples);
+        ::print("\r\n");
+    }
+};
+
+/*
+ * Pool allocator
+ */
+void benchmarkPoolAllocator()
+{
+    static const unsigned NumBlocks = 8;
+    static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumBlocks, uavcan::MemPoolBlockSize> pool;
+
+    Measurement alloc;
+    Measurement dealloc;
+    void* blocks[NumBlocks] = {};
+
+    for (int round = 0; round < 16; round++)
+    {
+        for (unsigned i = 0; i < NumBlocks; i++)
+        {
+            const uint32_t started_at = getSysTick();
+            blocks[i] = pool.allocate(uavcan::MemPoolBlockSize);
+            alloc.add(getCyclesSince(started_at));
+            if (blocks[i] == nullptr)
+            {
+                die();
+            }
+        }
+        // Freed in the interleaved order, so that the free list gets fragmented like in the real life
+        for (unsigned step = 0; step < 2; step++)
+        {
+            for (unsigned i = step; i < NumBlocks; i += 2)
+            {
+                const uint32_t started_at = getSysTick();
+                pool.deallocate(blocks[i]);
+                dealloc.add(getCyclesSince(started_at));
+            }
+        }
+    }
+
+    alloc.print("pool allocate");
+    dealloc.print("pool deallocate");
+}
+
+/*
+ * DSDL codec
+ */
+void benchmarkCodec()
+{
+    uavcan::protocol::NodeStatus sample;
+    sample.uptime_sec = 123456;
+    sample.health = sample.HEALTH_WARNING;
+    sample.mode = sample.MODE_OPERATIONAL;
+    sample.vendor_specific_status_code = 0xBEEF;
+
+    uavcan::StaticTransferBuffer<(uavcan::protocol::NodeStatus::MaxBitLen + 7) / 8> buf;
+
+    Measurement encode;
+    Measurement decode;
+
+    for (int i = 0; i < 100; i++)
+    {
+        buf.reset();
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+
+        const uint32_t started_at = getSysTick();
+        const int res = uavcan::protocol::NodeStatus::encode(sample, codec);
+        encode.add(getCyclesSince(started_at));
+        if (res <= 0)
+        {
+            die();
+        }
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        uavcan::protocol::NodeStatus decoded;
+
+        const uint32_t started_at = getSysTick();
+        const int res = uavcan::protocol::NodeStatus::decode(decoded, codec);
+        decode.add(getCyclesSince(started_at));
+        if ((res <= 0) || (decoded != sample))
+        {
+            die();
+        }
+    }
+
+    encode.print("NodeStatus encode");
+    decode.print("NodeStatus decode");
+}
+
+/*
+ * Dispatcher
+ */
+/**
+ * Delivers the loaded frames to the library as if they were received from the bus, and discards the transmitted
+ * frames. This way the cost of the library can be measured without the driver and the bus.
+ */
+class ReplayCanDriver : public uavcan::ICanDriver, public uavcan::ICanIface, uavcan::Noncopyable
+{
+    const uavcan::CanFrame* frames_ = nullptr;
+    unsigned num_frames_ = 0;
+    unsigned next_frame_ = 0;
+
+public:
+    void load(const uavcan::CanFrame* frames, unsigned num_frames)
+    {
+        frames_ = frames;
+        num_frames_ = num_frames;
+        next_frame_ = 0;
+    }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags)
+    {
+        return 1;
+    }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        if (next_frame_ >= num_frames_)
+        {
+            return 0;
+        }
+        out_frame = frames_[next_frame_++];
+        out_ts_monotonic = uavcan_lpc11c24::clock::getMonotonic();
+        out_ts_utc = uavcan::UtcTime();
+        out_flags = 0;
+        return 1;
+    }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime)
+    {
+        inout_masks.read = uavcan::uint8_t((next_frame_ < num_frames_) ? 1 : 0);
+        inout_masks.write = 1;
+        return 1;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return 0; }
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) { return (iface_index == 0) ? this : nullptr; }
+    virtual uavcan::uint8_t getNumIfaces() const { return 1; }
+};
+
+typedef uavcan::Node<1024> Node;
+
+ReplayCanDriver& getReplayDriver()
+{
+    static ReplayCanDriver driver;
+    return driver;
+}
+
+Node& getNode()
+{
+    static Node node(getReplayDriver(), uavcan_lpc11c24::SystemClock::instance());
+    return node;
+}
+
+unsigned num_node_status_received = 0;
+
+void handleNodeStatus(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>&)
+{
+    num_node_status_received++;
+}
+
+typedef uavcan::Subscriber<uavcan::protocol::NodeStatus,
+                           void (*)(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>&)>
+    NodeStatusSubscriber;
+
+NodeStatusSubscriber& getNodeStatusSubscriber()
+{
+    static NodeStatusSubscriber sub(getNode());
+    return sub;
+}
+
+/**
+ * NodeStatus messages from a number of nodes, which is the most common traffic on a real bus.
+ * The cost includes the reception, the transfer reassembly, decoding and the subscriber callback.
+ */
+void benchmarkDispatcher()
+{
+    static const unsigned NumSourceNodes = 8;
+    static const unsigned NumRounds = 16;
+    static uint8_t transfer_id = 0;
+
+    Measurement per_frame;
+    num_node_status_received = 0;
+
+    for (unsigned round = 0; round < NumRounds; round++)
+    {
+        uavcan::CanFrame frames[NumSourceNodes];
+        for (unsigned i = 0; i < NumSourceNodes; i++)
+        {
+            uavcan::protocol::NodeStatus msg;
+            msg.uptime_sec = transfer_id;
+
+            uavcan::StaticTransferBuffer<(uavcan::protocol::NodeStatus::MaxBitLen + 7) / 8> buf;
+            uavcan::BitStream bitstream(buf);
+            uavcan::ScalarCodec codec(bitstream);
+            (void)uavcan::protocol::NodeStatus::encode(msg, codec);
+
+            uavcan::Frame frame(uavcan::protocol::NodeStatus::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                uavcan::NodeID(uint8_t(i + 1)), uavcan::NodeID::Broadcast, transfer_id);
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            (void)frame.setPayload(buf.getRawPtr(), buf.getMaxWritePos());
+            (void)frame.compile(frames[i]);
+        }
+        transfer_id++;
+
+        getReplayDriver().load(frames, NumSourceNodes);
+
+        const uint32_t started_at = getSysTick();
+        const int res = getNode().getDispatcher().spinOnce();
+        const uint32_t cycles = getCyclesSince(started_at);
+        if (res < 0)
+        {
+            die();
+        }
+        per_frame.add(cycles / NumSourceNodes);
+
+        board::resetWatchdog();
+    }
+
+    per_frame.print("dispatcher per frame");
+    if (num_node_status_received != (NumRounds * NumSourceNodes))
+    {
+        print("dispatcher: messages lost\r\n");
+    }
+}
+
+/*
+ * CAN ISR
+ */
+void printIsrProfile()
+{
+    const uavcan_lpc11c24::CanDriver::IsrProfile profile = uavcan_lpc11c24::CanDriver::instance().getIsrProfile();
+    Measurement m;
+    m.total_cycles = profile.total_cycles;
+    m.max_cycles = profile.max_cycles;
+    m.num_samples = profile.num_calls;
+    m.print("can isr");
+}
+
+void drainRxQueue()
+{
+    uavcan::CanFrame frame;
+    uavcan::MonotonicTime ts_mono;
+    uavcan::UtcTime ts_utc;
+    uavcan::CanIOFlags flags = 0;
+    while (uavcan_lpc11c24::CanDriver::instance().receive(frame, ts_mono, ts_utc, flags) > 0)
+    {
+    }
+}
+
+#if __GNUC__
+__attribute__((noinline))
+#endif
+void init()
+{
+    board::resetWatchdog();
+
+    uavcan_lpc11c24::clock::init();     // SysTick must be running before the CAN interrupts are enabled
+
+    if (uavcan_lpc11c24::CanDriver::instance().init(1000000) < 0)
+    {
+        die();
+    }
+
+    initUart();
+
+    if (getNodeStatusSubscriber().start(&handleNodeStatus) < 0)
+    {
+        die();
+    }
+
+    board::resetWatchdog();
+}
+
+}
+
+int main()
+{
+    init();
+
+    print("Benchmark; core clock ");
+    print(SystemCoreClock);
+    print(" Hz\r\n");
+
+    uint32_t report_cnt = 0;
+
+    while (true)
+    {
+        // The bus traffic keeps coming in meanwhile, it is only needed to exercise the CAN ISR
+        const uavcan::MonotonicTime started_at = uavcan_lpc11c24::clock::getMonotonic();
+        while ((uavcan_lpc11c24::clock::getMonotonic() - started_at).toMSec() < 5000)
+        {
+            drainRxQueue();
+            board::resetWatchdog();
+        }
+
+        board::setStatusLed(uavcan_lpc11c24::CanDriver::instance().hadActivity());
+
+        print("\r\nreport #");
+        print(report_cnt++);
+        print("\r\n");
+        printIsrProfile();
+        benchmarkPoolAllocator();
+        benchmarkCodec();
+        board::resetWatchdog();
+        benchmarkDispatcher();
+    }
+}
@@ -0,0 +1,351 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_ASYNC_FILE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_ASYNC_FILE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <pthread.h>
+#include <uavcan_posix/basic_file_server_backend.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Same as @ref BasicFileSeverBackend, except that the writes are performed by a background thread, so that slow
+ * storage does not stall the thread that spins the node.
+ *
+ * Every write request is copied into a preallocated buffer and queued; the response is deferred until the data
+ * is synced to the storage (see @ref uavcan::IFileServerBackend::beginWrite()). The background thread takes all
+ * requests that have been queued meanwhile at once, and writes them file by file: each file is opened once and
+ * synced once per batch. Since the sync is the slow part, the requests that arrive during a sync are coalesced
+ * into the next batch, so the number of syncs adapts to the speed of the storage rather than to the request rate.
+ *
+ * The completions are reported from the thread that spins the node, polled by a timer.
+ * If all buffers are busy, the request is written synchronously. A client waits for the response before sending
+ * the next request, so the number of buffers only needs to match the number of clients uploading concurrently.
+ *
+ * The destructor waits for the queued writes to finish; their responses are not sent.
+ */
+class AsyncFileServerBackend : public BasicFileSeverBackend
+                             , private uavcan::TimerBase
+{
+    enum { MaxPathLength = uavcan::protocol::file::Path::FieldTypes::path::MaxSize };
+    enum { MaxDataLength = uavcan::protocol::file::Write::Request::FieldTypes::data::MaxSize };
+
+    /// Rate at which the completions are polled while there are writes in progress.
+    enum { CompletionPollPeriodMs = 10 };
+
+    struct PendingWrite
+    {
+        PendingWrite* next;
+        char path[MaxPathLength + 1];
+        uint64_t offset;
+        uint16_t size;
+        int16_t error;
+        bool done;
+        uavcan::ServiceReplyContext context;
+        uavcan::IFileWriteCompletionListener* listener;
+        uint8_t data[MaxDataLength];
+
+        PendingWrite() :
+            next(NULL),
+            offset(0),
+            size(0),
+            error(0),
+            done(false),
+            listener(NULL)
+        {
+            path[0] = '\0';
+        }
+    };
+
+    /**
+     * FIFO of pending writes linked through PendingWrite::next.
+     */
+    class Queue
+    {
+        PendingWrite* head_;
+        PendingWrite* tail_;
+
+    public:
+        Queue() :
+            head_(NULL),
+            tail_(NULL)
+        { }
+
+        bool isEmpty() const { return head_ == NULL; }
+
+        void push(PendingWrite* item)
+        {
+            item->next = NULL;
+            if (tail_ == NULL)
+            {
+                head_ = item;
+            }
+            else
+            {
+                tail_->next = item;
+            }
+            tail_ = item;
+        }
+
+        /**
+         * Moves all items into the returned list.
+         */
+        PendingWrite* takeAll()
+        {
+            PendingWrite* const list = head_;
+            head_ = NULL;
+            tail_ = NULL;
+            return list;
+        }
+    };
+
+    PendingWrite* pool_;
+    const unsigned num_buffers_;
+    PendingWrite* free_list_;               ///< Node thread only
+    unsigned num_in_progress_;              ///< Node thread only
+
+    // Shared with the background thread, protected by the mutex
+    Queue queued_;
+    Queue completed_;
+    bool stop_requested_;
+
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    pthread_t thread_;
+    bool thread_started_;
+    bool thread_failed_;
+
+    /**
+     * Writes all requests to the file of the first unprocessed one, then syncs the file once.
+     * The result of the sync is reported for every request whose data has been written successfully.
+     */
+    static void flushFile(PendingWrite* first)
+    {
+        const int fd = ::open(first->path, O_WRONLY | O_CREAT, FilePermissions);
+        const int open_error = (fd < 0) ? errno : 0;
+
+        for (PendingWrite* p = first; p != NULL; p = p->next)
+        {
+            if (!p->done && 0 == ::strcmp(p->path, first->path))
+            {
+                p->error = int16_t((fd < 0) ? open_error : writeFile(fd, p->offset, p->data, p->size));
+                p->done = true;
+            }
+        }
+
+        if (fd < 0)
+        {
+            return;
+        }
+
+        int sync_error = (::fsync(fd) < 0) ? errno : 0;
+        if (::close(fd) < 0 && sync_error == 0)
+        {
+            sync_error = errno;
+        }
+        if (sync_error != 0)
+        {
+            for (PendingWrite* p = first; p != NULL; p = p->next)
+            {
+                if (p->error == 0 && 0 == ::strcmp(p->path, first->path))
+                {
+                    p->error = int16_t(sync_error);
+                }
+            }
+        }
+    }
+
+    void run()
+    {
+        (void)::pthread_mutex_lock(&mutex_);
+        for (;;)
+        {
+            while (queued_.isEmpty() && !stop_requested_)
+            {
+                (void)::pthread_cond_wait(&cond_, &mutex_);
+            }
+            if (queued_.isEmpty())
+            {
+                break;                      // Stop is requested and everything is written
+            }
+            PendingWrite* const batch = queued_.takeAll();
+            (void)::pthread_mutex_unlock(&mutex_);
+
+            for (PendingWrite* p = batch; p != NULL; p = p->next)
+            {
+                if (!p->done)
+                {
+                    flushFile(p);
+                }
+            }
+
+            (void)::pthread_mutex_lock(&mutex_);
+            for (PendingWrite* p = batch; p != NULL;)
+            {
+                PendingWrite* const next = p->next;
+                completed_.push(p);
+                p = next;
+            }
+        }
+        (void)::pthread_mutex_unlock(&mutex_);
+    }
+
+    static void* threadEntry(void* arg)
+    {
+        static_cast<AsyncFileServerBackend*>(arg)->run();
+        return NULL;
+    }
+
+    /**
+     * Allocates the buffers and starts the background thread upon the first write.
+     * Returns false if the writes have to be performed synchronously.
+     */
+    bool ensureStarted()
+    {
+        if (thread_started_)
+        {
+            return true;
+        }
+        if (thread_failed_ || num_buffers_ == 0)
+        {
+            return false;
+        }
+
+        pool_ = new PendingWrite[num_buffers_];
+        if (pool_ == NULL || 0 != ::pthread_create(&thread_, NULL, &AsyncFileServerBackend::threadEntry, this))
+        {
+            delete [] pool_;
+            pool_ = NULL;
+            thread_failed_ = true;
+            return false;
+        }
+
+        for (unsigned i = 0; i < num_buffers_; i++)
+        {
+            pool_[i].next = free_list_;
+            free_list_ = &pool_[i];
+        }
+        thread_started_ = true;
+        return true;
+    }
+
+    /**
+     * Reports the completed writes to the listeners.
+     */
+    virtual void handleTimerEvent(const uavcan::TimerEvent&)
+    {
+        (void)::pthread_mutex_lock(&mutex_);
+        PendingWrite* p = completed_.takeAll();
+        (void)::pthread_mutex_unlock(&mutex_);
+
+        if (p != NULL)
+        {
+            flushReadCache();
+        }
+
+        while (p != NULL)
+        {
+            PendingWrite* const next = p->next;
+            p->listener->handleFileWriteCompletion(p->context, p->error);
+
+            p->next = free_list_;
+            free_list_ = p;
+            UAVCAN_ASSERT(num_in_progress_ > 0);
+            num_in_progress_--;
+            p = next;
+        }
+
+        if (num_in_progress_ == 0)
+        {
+            stop();
+        }
+    }
+
+protected:
+    virtual int16_t beginWrite(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size,
+                               const uavcan::ServiceReplyContext& context,
+                               uavcan::IFileWriteCompletionListener& listener)
+    {
+        if (path.size() == 0 || size > MaxDataLength || !ensureStarted() || free_list_ == NULL)
+        {
+            return write(path, offset, buffer, size);
+        }
+
+        PendingWrite* const p = free_list_;
+        free_list_ = p->next;
+
+        (void)::strncpy(p->path, path.c_str(), MaxPathLength);
+        p->path[MaxPathLength] = '\0';
+        p->offset = offset;
+        p->size = size;
+        (void)::memcpy(p->data, buffer, size);
+        p->error = 0;
+        p->done = false;
+        p->context = context;
+        p->listener = &listener;
+
+        (void)::pthread_mutex_lock(&mutex_);
+        queued_.push(p);
+        (void)::pthread_cond_signal(&cond_);
+        (void)::pthread_mutex_unlock(&mutex_);
+
+        if (num_in_progress_++ == 0)
+        {
+            startPeriodic(uavcan::MonotonicDuration::fromMSec(CompletionPollPeriodMs));
+        }
+        return WriteInProgress;
+    }
+
+public:
+    /**
+     * @param num_write_buffers         Number of writes that can be in progress at once; each buffer takes about
+     *                                  400 bytes of heap memory, allocated on the first write. Zero makes all
+     *                                  writes synchronous.
+     * @param num_read_cache_blocks     See @ref BasicFileSeverBackend.
+     */
+    AsyncFileServerBackend(uavcan::INode& node, unsigned num_write_buffers = 8, unsigned num_read_cache_blocks = 0) :
+        BasicFileSeverBackend(node, num_read_cache_blocks),
+        uavcan::TimerBase(node),
+        pool_(NULL),
+        num_buffers_(num_write_buffers),
+        free_list_(NULL),
+        num_in_progress_(0),
+        stop_requested_(false),
+        thread_(),
+        thread_started_(false),
+        thread_failed_(false)
+    {
+        (void)::pthread_mutex_init(&mutex_, NULL);
+        (void)::pthread_cond_init(&cond_, NULL);
+    }
+
+    virtual ~AsyncFileServerBackend()
+    {
+        if (thread_started_)
+        {
+            (void)::pthread_mutex_lock(&mutex_);
+            stop_requested_ = true;
+            (void)::pthread_cond_signal(&cond_);
+            (void)::pthread_mutex_unlock(&mutex_);
+            (void)::pthread_join(thread_, NULL);
+        }
+        delete [] pool_;
+
+        (void)::pthread_cond_destroy(&cond_);
+        (void)::pthread_mutex_destroy(&mutex_);
+    }
+
+    /**
+     * Number of writes whose responses have not been sent yet.
+     */
+    unsigned getNumWritesInProgress() const { return num_in_progress_; }
+};
+}
+
+#endif // Include guard
@@ -15,14 +15,17 @@
 #include <cstdlib>
 #include <cstring>
 #include <cerrno>
+#include <ctime>
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
 
 #include <uavcan/node/timer.hpp>
 #include <uavcan/data_type.hpp>
 #include <uavcan/protocol/file/Error.hpp>
 #include <uavcan/protocol/file/EntryType.hpp>
 #include <uavcan/protocol/file/Read.hpp>
+#include <uavcan/protocol/file/Write.hpp>
 #include <uavcan/protocol/file_server.hpp>
 #include <uavcan/data_type.hpp>
 
@@ -33,9 +36,9 @@ namespace uavcan_posix
  */
 class BasicFileSeverBackend : public uavcan::IFileServerBackend
 {
+protected:
     enum { FilePermissions = 438 };   ///< 0o666
 
-protected:
     class FDCacheBase
     {
     public:
@@ -310,7 +313,322 @@ protected:
         }
     };
 
+    /**
+     * Optional cache of file blocks, which is disabled by default, see the constructor.
+     * Every miss loads a whole aligned block, so that sequential reads performed by many clients at once (e.g.
+     * firmware update of a fleet of nodes) are served from memory instead of costing two syscalls per request.
+     * Blocks are evicted in the least recently used order, and are dropped once they are older than
+     * MaxAgeSeconds, so that a modified file is picked up eventually.
+     */
+    class ReadCache : uavcan::Noncopyable
+    {
+        /// Age in Seconds a block will stay valid since it was loaded from the file.
+        enum { MaxAgeSeconds = 7 };
+
+        enum { MaxPathLength = uavcan::protocol::file::Path::FieldTypes::path::MaxSize };
+
+    public:
+        /// Must be a multiple of the protocol read size.
+        enum { BlockSize = 4096 };
+
+        struct Block
+        {
+            char path[MaxPathLength + 1];
+            uint64_t offset;
+            uint16_t size;              ///< Less than BlockSize if the block contains the end of file
+            time_t loaded_at;
+            uint32_t last_use;
+            uint8_t data[BlockSize];
+
+            Block() :
+                offset(0),
+                size(0),
+                loaded_at(0),
+                last_use(0)
+            {
+                path[0] = '\0';
+            }
+
+            bool valid() const
+            {
+                return path[0] != '\0' && (time(NULL) - loaded_at) <= MaxAgeSeconds;
+            }
+        };
+
+    private:
+        Block* const blocks_;
+        const unsigned num_blocks_;
+        uint32_t use_counter_;
+
+    public:
+        ReadCache(unsigned num_blocks) :
+            blocks_(new Block[num_blocks]),
+            num_blocks_((blocks_ == NULL) ? 0 : num_blocks),
+            use_counter_(0)
+        { }
+
+        ~ReadCache()
+        {
+            delete [] blocks_;
+        }
+
+        bool isEnabled() const { return num_blocks_ > 0; }
+
+        Block* find(const char* path, uint64_t block_offset)
+        {
+            for (unsigned i = 0; i < num_blocks_; i++)
+            {
+                Block& b = blocks_[i];
+                if (b.offset == block_offset && b.valid() && 0 == ::strcmp(b.path, path))
+                {
+                    b.last_use = ++use_counter_;
+                    return &b;
+                }
+            }
+            return NULL;
+        }
+
+        /**
+         * Reuses an invalid or the least recently used block. The caller is responsible for filling in the data.
+         */
+        Block& allocate(const char* path, uint64_t block_offset)
+        {
+            UAVCAN_ASSERT(isEnabled());
+            Block* victim = &blocks_[0];
+            for (unsigned i = 0; i < num_blocks_; i++)
+            {
+                if (!blocks_[i].valid())
+                {
+                    victim = &blocks_[i];
+                    break;
+                }
+                if (blocks_[i].last_use < victim->last_use)
+                {
+                    victim = &blocks_[i];
+                }
+            }
+
+            (void)::strncpy(victim->path, path, MaxPathLength);
+            victim->path[MaxPathLength] = '\0';
+            victim->offset = block_offset;
+            victim->size = 0;
+            victim->loaded_at = time(NULL);
+            victim->last_use = ++use_counter_;
+            return *victim;
+        }
+
+        static void invalidate(Block& block)
+        {
+            block.path[0] = '\0';
+        }
+
+        void clear()
+        {
+            for (unsigned i = 0; i < num_blocks_; i++)
+            {
+                invalidate(blocks_[i]);
+            }
+        }
+    };
+
+    /**
+     * Listings of the recently browsed directories.
+     * uavcan.protocol.file.GetDirectoryEntryInfo requests one entry at a time, so without the listings every request
+     * would walk the directory from the beginning, making a full listing quadratic in the directory size.
+     * A listing is reloaded once the modification time of the directory changes; since the time has a resolution
+     * of one second, a listing that was loaded in the same second the directory was modified is not trusted.
+     */
+    class DirectoryCache : uavcan::Noncopyable
+    {
+        enum { MaxPathLength = uavcan::protocol::file::Path::FieldTypes::path::MaxSize };
+
+        enum { NumListings = 2 };
+
+    public:
+        class Listing : uavcan::Noncopyable
+        {
+            char path_[MaxPathLength + 1];
+            time_t mtime_;
+            time_t loaded_at_;
+            uint32_t last_use_;
+
+            char* names_;                   ///< Null-terminated entry names one after another
+            size_t names_size_;
+            size_t names_capacity_;
+            uint32_t* offsets_;             ///< Offset of every name in names_
+            uint32_t num_entries_;
+            uint32_t offsets_capacity_;
+
+            bool append(const char* name)
+            {
+                const size_t len = ::strlen(name) + 1;
+                if (names_size_ + len > names_capacity_)
+                {
+                    const size_t new_capacity = uavcan::max<size_t>(names_capacity_ * 2, names_size_ + len + 1024);
+                    char* const p = static_cast<char*>(::realloc(names_, new_capacity));
+                    if (p == NULL)
+                    {
+                        return false;
+                    }
+                    names_ = p;
+                    names_capacity_ = new_capacity;
+                }
+                if (num_entries_ >= offsets_capacity_)
+                {
+                    const uint32_t new_capacity = uavcan::max<uint32_t>(offsets_capacity_ * 2, 64);
+                    uint32_t* const p = static_cast<uint32_t*>(::realloc(offsets_, new_capacity * sizeof(uint32_t)));
+                    if (p == NULL)
+                    {
+                        return false;
+                    }
+                    offsets_ = p;
+                    offsets_capacity_ = new_capacity;
+                }
+                (void)::memcpy(names_ + names_size_, name, len);
+                offsets_[num_entries_++] = uint32_t(names_size_);
+                names_size_ += len;
+                return true;
+            }
+
+        public:
+            Listing() :
+                mtime_(0),
+                loaded_at_(0),
+                last_use_(0),
+                names_(NULL),
+                names_size_(0),
+                names_capacity_(0),
+                offsets_(NULL),
+                num_entries_(0),
+                offsets_capacity_(0)
+            {
+                path_[0] = '\0';
+            }
+
+            ~Listing()
+            {
+                ::free(names_);
+                ::free(offsets_);
+            }
+
+            bool valid(const char* path, const struct stat& sb) const
+            {
+                return path_[0] != '\0' && mtime_ == sb.st_mtime && mtime_ < loaded_at_ &&
+                       0 == ::strcmp(path_, path);
+            }
+
+            void invalidate()
+            {
+                path_[0] = '\0';
+                names_size_ = 0;
+                num_entries_ = 0;
+            }
+
+            /**
+             * Reads the whole directory; the entries "." and ".." are skipped.
+             * Returns zero or errno; on failure the listing is left invalid.
+             */
+            int load(const char* path, const struct stat& sb)
+            {
+                invalidate();
+
+                DIR* const dir = ::opendir(path);
+                if (dir == NULL)
+                {
+                    return errno;
+                }
+
+                int rv = 0;
+                for (;;)
+                {
+                    errno = 0;
+                    const struct dirent* const ent = ::readdir(dir);
+                    if (ent == NULL)
+                    {
+                        rv = errno;
+                        break;
+                    }
+                    if (0 == ::strcmp(ent->d_name, ".") || 0 == ::strcmp(ent->d_name, ".."))
+                    {
+                        continue;
+                    }
+                    if (!append(ent->d_name))
+                    {
+                        rv = ENOMEM;
+                        break;
+                    }
+                }
+                (void)::closedir(dir);
+
+                if (rv != 0)
+                {
+                    invalidate();
+                    return rv;
+                }
+
+                (void)::strncpy(path_, path, MaxPathLength);
+                path_[MaxPathLength] = '\0';
+                mtime_ = sb.st_mtime;
+                loaded_at_ = time(NULL);
+                return 0;
+            }
+
+            /**
+             * Returns NULL if the index is out of range.
+             */
+            const char* getName(uint32_t index) const
+            {
+                return (index < num_entries_) ? (names_ + offsets_[index]) : NULL;
+            }
+
+            uint32_t getLastUse() const { return last_use_; }
+            void setLastUse(uint32_t value) { last_use_ = value; }
+        };
+
+    private:
+        Listing listings_[NumListings];
+        uint32_t use_counter_;
+
+    public:
+        DirectoryCache() :
+            use_counter_(0)
+        { }
+
+        /**
+         * Returns the listing of the directory, reusing the least recently used one if it is not cached.
+         * The argument sb must be the result of stat() on the directory.
+         * Returns NULL and sets out_error if the directory could not be read.
+         */
+        const Listing* get(const char* path, const struct stat& sb, int& out_error)
+        {
+            Listing* victim = &listings_[0];
+            for (unsigned i = 0; i < NumListings; i++)
+            {
+                if (listings_[i].valid(path, sb))
+                {
+                    listings_[i].setLastUse(++use_counter_);
+                    return &listings_[i];
+                }
+                if (listings_[i].getLastUse() < victim->getLastUse())
+                {
+                    victim = &listings_[i];
+                }
+            }
+
+            out_error = victim->load(path, sb);
+            if (out_error != 0)
+            {
+                return NULL;
+            }
+            victim->setLastUse(++use_counter_);
+            return victim;
+        }
+    };
+
     FDCacheBase* fdcache_;
+    ReadCache* read_cache_;
+    const unsigned num_read_cache_blocks_;
+    DirectoryCache* dir_cache_;
     uavcan::INode& node_;
 
     FDCacheBase& getFDCache()
@@ -329,6 +647,157 @@ protected:
         return *fdcache_;
     }
 
+    /**
+     * Returns NULL if the read cache is disabled or could not be allocated.
+     */
+    ReadCache* getReadCache()
+    {
+        if (read_cache_ == NULL && num_read_cache_blocks_ > 0)
+        {
+            read_cache_ = new ReadCache(num_read_cache_blocks_);
+        }
+        return (read_cache_ != NULL && read_cache_->isEnabled()) ? read_cache_ : NULL;
+    }
+
+    /**
+     * Reads the file directly, bypassing the read cache.
+     */
+    int readFile(const char* path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        FDCacheBase& cache = getFDCache();
+        int fd = cache.open(path, O_RDONLY);
+        int rv;
+
+        if (fd < 0)
+        {
+            rv = errno;
+        }
+        else
+        {
+            rv = ::lseek(fd, offset, SEEK_SET);
+
+            ssize_t len = 0;
+
+            if (rv < 0)
+            {
+                rv = errno;
+            }
+            else
+            {
+                // TODO use a read at offset to fill on EAGAIN
+                len = ::read(fd, out_buffer, inout_size);
+
+                if (len < 0)
+                {
+                    rv = errno;
+                }
+                else
+                {
+                    rv = 0;
+                }
+            }
+
+            (void)cache.close(fd, rv != 0 || len != inout_size);
+            inout_size = len;
+        }
+        return rv;
+    }
+
+    /**
+     * Serves the request from the read cache, loading the missing blocks from the file.
+     */
+    int readCached(ReadCache& read_cache, const char* path, const uint64_t offset, uint8_t* out_buffer,
+                   uint16_t& inout_size)
+    {
+        uint16_t done = 0;
+
+        while (done < inout_size)
+        {
+            const uint64_t position = offset + done;
+            const uint64_t block_offset = position - position % ReadCache::BlockSize;
+
+            ReadCache::Block* block = read_cache.find(path, block_offset);
+            if (block == NULL)
+            {
+                block = &read_cache.allocate(path, block_offset);
+
+                uint16_t size = ReadCache::BlockSize;
+                const int rv = readFile(path, block_offset, block->data, size);
+                if (rv != 0)
+                {
+                    ReadCache::invalidate(*block);
+                    return rv;
+                }
+                block->size = size;
+            }
+
+            const unsigned block_position = unsigned(position - block_offset);
+            if (block_position >= block->size)
+            {
+                break;          // End of file
+            }
+
+            const unsigned chunk = uavcan::min(unsigned(block->size - block_position), unsigned(inout_size - done));
+            (void)::memcpy(out_buffer + done, block->data + block_position, chunk);
+            done = uint16_t(done + chunk);
+        }
+
+        inout_size = done;
+        return 0;
+    }
+
+    /**
+     * Returns NULL if the cache could not be allocated.
+     */
+    DirectoryCache* getDirectoryCache()
+    {
+        if (dir_cache_ == NULL)
+        {
+            dir_cache_ = new DirectoryCache();
+        }
+        return dir_cache_;
+    }
+
+    /**
+     * Walks the directory up to the requested entry, bypassing the directory cache; the entries "." and ".." are
+     * skipped. Used if the listing does not fit in memory.
+     * Returns zero or errno.
+     */
+    static int readDirectoryEntryName(const char* path, uint32_t entry_index, char* out_name, size_t out_name_size)
+    {
+        DIR* const dir = ::opendir(path);
+        if (dir == NULL)
+        {
+            return errno;
+        }
+
+        int rv = uavcan::protocol::file::Error::NOT_FOUND;
+        uint32_t index = 0;
+        for (;;)
+        {
+            errno = 0;
+            const struct dirent* const ent = ::readdir(dir);
+            if (ent == NULL)
+            {
+                rv = (errno != 0) ? errno : rv;
+                break;
+            }
+            if (0 == ::strcmp(ent->d_name, ".") || 0 == ::strcmp(ent->d_name, ".."))
+            {
+                continue;
+            }
+            if (index++ == entry_index)
+            {
+                (void)::strncpy(out_name, ent->d_name, out_name_size - 1);
+                out_name[out_name_size - 1] = '\0';
+                rv = 0;
+                break;
+            }
+        }
+        (void)::closedir(dir);
+        return rv;
+    }
+
     /**
      * Back-end for uavcan.protocol.file.GetInfo.
      * Implementation of this method is required.
@@ -382,59 +851,187 @@ protected:
 
         if (path.size() > 0)
         {
-            FDCacheBase& cache = getFDCache();
-            int fd = cache.open(path.c_str(), O_RDONLY);
-
-            if (fd < 0)
+            ReadCache* const read_cache = getReadCache();
+            if (read_cache != NULL)
             {
-                rv = errno;
+                rv = readCached(*read_cache, path.c_str(), offset, out_buffer, inout_size);
             }
             else
             {
-                rv = ::lseek(fd, offset, SEEK_SET);
-
-                ssize_t len = 0;
+                rv = readFile(path.c_str(), offset, out_buffer, inout_size);
+            }
+        }
+        return rv;
+    }
 
-                if (rv < 0)
+    /**
+     * Writes the whole buffer at the specified offset, retrying on partial writes.
+     * This method does not touch the state of the backend, so it can be used from any thread.
+     * Returns zero or errno.
+     */
+    static int writeFile(int fd, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+    {
+        uint16_t done = 0;
+        while (done < size)
+        {
+            const ssize_t len = ::pwrite(fd, buffer + done, size - done, off_t(offset + done));
+            if (len < 0)
+            {
+                if (errno == EINTR)
                 {
-                    rv = errno;
+                    continue;
                 }
-                else
-                {
-                    // TODO use a read at offset to fill on EAGAIN
-                    len = ::read(fd, out_buffer, inout_size);
+                return errno;
+            }
+            done = uint16_t(done + len);
+        }
+        return 0;
+    }
 
-                    if (len < 0)
-                    {
-                        rv = errno;
-                    }
-                    else
-                    {
-                        rv = 0;
-                    }
-                }
+    /**
+     * Back-end for uavcan.protocol.file.Write.
+     * The file is created if it does not exist; the data is synced to the storage before the method returns.
+     * On success the method must return zero.
+     */
+    virtual int16_t write(const Path& path, const uint64_t offset, const uint8_t* buffer, const uint16_t size)
+    {
+        if (path.size() == 0)
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
 
-                (void)cache.close(fd, rv != 0 || len != inout_size);
-                inout_size = len;
-            }
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, FilePermissions);
+        if (fd < 0)
+        {
+            return errno;
         }
+
+        int rv = writeFile(fd, offset, buffer, size);
+        if (rv == 0 && ::fsync(fd) < 0)
+        {
+            rv = errno;
+        }
+        if (::close(fd) < 0 && rv == 0)
+        {
+            rv = errno;
+        }
+
+        flushReadCache();
         return rv;
     }
 
+    /**
+     * Back-end for uavcan.protocol.file.GetDirectoryEntryInfo.
+     * The entries are served from the directory cache, so that each request costs two stat() calls rather than
+     * a walk through the directory. The order of the entries is the order of readdir().
+     * On success the method must return zero.
+     */
+    virtual int16_t getDirectoryEntryInfo(const Path& directory_path, const uint32_t entry_index,
+                                          EntryType& out_type, Path& out_entry_full_path)
+    {
+        using namespace std;
+
+        if (directory_path.size() == 0)
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+
+        struct stat sb;
+        if (stat(directory_path.c_str(), &sb) < 0)
+        {
+            return errno;
+        }
+        if (!S_ISDIR(sb.st_mode))
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+
+        const char* name = NULL;
+        char name_buffer[uavcan::protocol::file::Path::FieldTypes::path::MaxSize + 1];
+        int rv = ENOMEM;
+
+        DirectoryCache* const dir_cache = getDirectoryCache();
+        if (dir_cache != NULL)
+        {
+            const DirectoryCache::Listing* const listing = dir_cache->get(directory_path.c_str(), sb, rv);
+            if (listing != NULL)
+            {
+                name = listing->getName(entry_index);
+                if (name == NULL)
+                {
+                    return uavcan::protocol::file::Error::NOT_FOUND;
+                }
+            }
+        }
+        if (name == NULL)
+        {
+            if (rv != ENOMEM)
+            {
+                return rv;
+            }
+            rv = readDirectoryEntryName(directory_path.c_str(), entry_index, name_buffer, sizeof(name_buffer));
+            if (rv != 0)
+            {
+                return rv;
+            }
+            name = name_buffer;
+        }
+
+        const bool needs_separator = directory_path[directory_path.size() - 1] != '/';
+        if (directory_path.size() + (needs_separator ? 1U : 0U) + ::strlen(name) > out_entry_full_path.capacity())
+        {
+            return uavcan::protocol::file::Error::INVALID_VALUE;
+        }
+        out_entry_full_path = directory_path.c_str();
+        if (needs_separator)
+        {
+            out_entry_full_path += "/";
+        }
+        out_entry_full_path += name;
+
+        uint64_t size = 0;
+        return getInfo(out_entry_full_path, size, out_type);
+    }
+
 public:
-    BasicFileSeverBackend(uavcan::INode& node) :
+    /**
+     * @param num_read_cache_blocks     Number of blocks of the read cache, see @ref ReadCache; each block takes
+     *                                  slightly more than 4 KB of heap memory, allocated on the first read.
+     *                                  Zero disables the cache, so that every request is read from the file.
+     */
+    BasicFileSeverBackend(uavcan::INode& node, unsigned num_read_cache_blocks = 0) :
         fdcache_(NULL),
+        read_cache_(NULL),
+        num_read_cache_blocks_(num_read_cache_blocks),
+        dir_cache_(NULL),
         node_(node)
     { }
 
     ~BasicFileSeverBackend()
     {
+        delete read_cache_;
+        read_cache_ = NULL;
+
+        delete dir_cache_;
+        dir_cache_ = NULL;
+
         if (fdcache_ != &fallback_)
         {
             delete fdcache_;
             fdcache_ = NULL;
         }
     }
+
+    /**
+     * Drops all cached blocks; use this after a served file has been modified.
+     */
+    void flushReadCache()
+    {
+        if (read_cache_ != NULL)
+        {
+            read_cache_->clear();
+        }
+    }
 };
 }
 
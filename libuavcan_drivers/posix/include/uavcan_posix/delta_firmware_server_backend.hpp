@@ -0,0 +1,304 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_DELTA_FIRMWARE_SERVER_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_DELTA_FIRMWARE_SERVER_BACKEND_HPP_INCLUDED
+
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <dirent.h>
+
+#include <uavcan_posix/firmware_image_cache.hpp>
+#include <uavcan_posix/firmware_delta.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * File server backend that serves firmware deltas (see @ref FirmwareDelta) through virtual paths, and everything
+ * else like @ref MappedFileServerBackend does.
+ *
+ * The virtual path of a delta is made by @ref FirmwareDelta::makePath() from the path of the new image and the CRC
+ * of the base image. The base image is looked up by its app descriptor among the *.bin files in the directory of
+ * the new image; this is the cache directory of @ref FirmwareVersionChecker, where previously served images are kept.
+ *
+ * A delta is computed on the first access and kept in memory while it is being read; unreferenced deltas are freed
+ * once they have not been accessed for MaxAgeSeconds.
+ */
+class DeltaFirmwareServerBackend : public MappedFileServerBackend, protected uavcan::TimerBase
+{
+    enum { MaxAgeSeconds = 30 };
+    enum { GarbageCollectionSeconds = 10 };
+    enum { MaxPathLength = uavcan::protocol::file::Path::FieldTypes::path::MaxSize };
+
+    struct Delta : uavcan::Noncopyable
+    {
+        Delta* next;
+        uint8_t* data;
+        uint32_t size;
+        uint64_t image_crc;
+        uint32_t base_crc32;
+        time_t last_access;
+        char image_path[MaxPathLength + 1];
+
+        Delta() :
+            next(NULL),
+            data(NULL),
+            size(0),
+            image_crc(0),
+            base_crc32(0),
+            last_access(0)
+        {
+            image_path[0] = '\0';
+        }
+
+        ~Delta() { delete[] data; }
+    };
+
+    FirmwareImageCache& image_cache_;
+    Delta* head_;
+
+    /**
+     * Finds the image with the given CRC in the directory of the new image. Returns NULL if there is none.
+     * The returned image must be released.
+     */
+    FirmwareImageCache::Image* acquireBaseImage(const char* image_path, uint32_t base_crc32)
+    {
+        char path[MaxPathLength + 1];
+        (void)std::strncpy(path, image_path, MaxPathLength);
+        path[MaxPathLength] = '\0';
+        char* const slash = std::strrchr(path, '/');
+        char* const name = (slash != NULL) ? slash + 1 : path;
+        const unsigned dir_length = unsigned(name - path);
+
+        *name = '\0';
+        DIR* const dir = ::opendir((dir_length > 0) ? path : ".");
+        if (dir == NULL)
+        {
+            return NULL;
+        }
+
+        FirmwareImageCache::Image* found = NULL;
+        struct dirent* ent = NULL;
+        while (found == NULL && (ent = ::readdir(dir)) != NULL)
+        {
+            const unsigned name_length = unsigned(std::strlen(ent->d_name));
+            if (name_length < 4 || 0 != std::strcmp(ent->d_name + name_length - 4, ".bin") ||
+                (dir_length + name_length) > MaxPathLength)
+            {
+                continue;
+            }
+            (void)std::strcpy(name, ent->d_name);
+            if (0 == std::strcmp(path, image_path))
+            {
+                continue;
+            }
+            FirmwareImageCache::Image* const image = image_cache_.acquire(path);
+            if (image == NULL)
+            {
+                continue;
+            }
+            uint64_t crc = 0;
+            if (FirmwareDelta::findImageCrc(image->getData(), image->getSize(), crc) && uint32_t(crc) == base_crc32)
+            {
+                found = image;
+            }
+            else
+            {
+                image_cache_.release(image);
+            }
+        }
+        (void)::closedir(dir);
+        return found;
+    }
+
+    /**
+     * Returns the delta for the virtual path, computing it if necessary, or NULL with errno set on failure.
+     */
+    const Delta* getDelta(const char* image_path, uint32_t base_crc32)
+    {
+        if (!isRunning())
+        {
+            startPeriodic(uavcan::MonotonicDuration::fromMSec(GarbageCollectionSeconds * 1000));
+        }
+
+        FirmwareImageCache::Image* const image = image_cache_.acquire(image_path);
+        if (image == NULL)
+        {
+            return NULL;
+        }
+        uint64_t image_crc = 0;
+        const bool valid = FirmwareDelta::findImageCrc(image->getData(), image->getSize(), image_crc);
+
+        Delta* delta = NULL;
+        for (delta = head_; valid && delta != NULL; delta = delta->next)
+        {
+            if (delta->image_crc == image_crc && delta->base_crc32 == base_crc32 &&
+                0 == std::strcmp(delta->image_path, image_path))
+            {
+                break;
+            }
+        }
+
+        if (valid && delta == NULL)
+        {
+            FirmwareImageCache::Image* const base = acquireBaseImage(image_path, base_crc32);
+            if (base != NULL)
+            {
+                uint64_t base_crc = 0;
+                (void)FirmwareDelta::findImageCrc(base->getData(), base->getSize(), base_crc);
+
+                delta = new Delta;
+                if (delta != NULL)
+                {
+                    delta->data = FirmwareDelta::encode(base->getData(), uint32_t(base->getSize()), base_crc,
+                                                        image->getData(), uint32_t(image->getSize()), image_crc,
+                                                        delta->size);
+                    if (delta->data == NULL)
+                    {
+                        delete delta;
+                        delta = NULL;
+                    }
+                }
+                image_cache_.release(base);
+
+                if (delta == NULL)
+                {
+                    errno = ENOMEM;
+                }
+                else
+                {
+                    delta->image_crc = image_crc;
+                    delta->base_crc32 = base_crc32;
+                    (void)std::strcpy(delta->image_path, image_path);
+                    delta->next = head_;
+                    head_ = delta;
+                    UAVCAN_TRACE("DeltaFirmwareServerBackend", "Delta for %s: %u of %u bytes", image_path,
+                                 unsigned(delta->size), unsigned(image->getSize()));
+                }
+            }
+            else
+            {
+                errno = ENOENT;
+            }
+        }
+        else if (!valid)
+        {
+            errno = EINVAL;
+        }
+
+        image_cache_.release(image);
+        if (delta != NULL)
+        {
+            delta->last_access = time(NULL);
+        }
+        return delta;
+    }
+
+    void removeUnused(bool expired_only)
+    {
+        const time_t now = time(NULL);
+        Delta** pd = &head_;
+        while (*pd)
+        {
+            Delta* const delta = *pd;
+            if (!expired_only || (now - delta->last_access) > MaxAgeSeconds)
+            {
+                *pd = delta->next;
+                delete delta;
+                continue;
+            }
+            pd = &delta->next;
+        }
+    }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent&)
+    {
+        removeUnused(true);
+    }
+
+protected:
+    virtual int16_t getInfo(const Path& path, uint64_t& out_size, EntryType& out_type)
+    {
+        char image_path[MaxPathLength + 1];
+        uint32_t base_crc32 = 0;
+        if (!FirmwareDelta::parsePath(path.c_str(), image_path, base_crc32))
+        {
+            return MappedFileServerBackend::getInfo(path, out_size, out_type);
+        }
+        const Delta* const delta = getDelta(image_path, base_crc32);
+        if (delta == NULL)
+        {
+            return int16_t(errno);
+        }
+        out_size = delta->size;
+        out_type.flags = uavcan::protocol::file::EntryType::FLAG_READABLE |
+                         uavcan::protocol::file::EntryType::FLAG_FILE;
+        return 0;
+    }
+
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        char image_path[MaxPathLength + 1];
+        uint32_t base_crc32 = 0;
+        if (!FirmwareDelta::parsePath(path.c_str(), image_path, base_crc32))
+        {
+            return MappedFileServerBackend::read(path, offset, out_buffer, inout_size);
+        }
+        const Delta* const delta = getDelta(image_path, base_crc32);
+        if (delta == NULL)
+        {
+            return int16_t(errno);
+        }
+        if (offset >= delta->size)
+        {
+            inout_size = 0;
+        }
+        else
+        {
+            inout_size = uint16_t(uavcan::min(uint64_t(inout_size), uint64_t(delta->size) - offset));
+            (void)std::memcpy(out_buffer, delta->data + offset, inout_size);
+        }
+        return 0;
+    }
+
+public:
+    DeltaFirmwareServerBackend(uavcan::INode& node, FirmwareImageCache& image_cache) :
+        MappedFileServerBackend(node, image_cache),
+        TimerBase(node),
+        image_cache_(image_cache),
+        head_(NULL)
+    { }
+
+    virtual ~DeltaFirmwareServerBackend()
+    {
+        stop();
+        removeUnused(false);
+    }
+
+    /**
+     * Frees all deltas.
+     */
+    void clear()
+    {
+        removeUnused(false);
+    }
+
+    unsigned getNumDeltas() const
+    {
+        unsigned cnt = 0;
+        for (const Delta* delta = head_; delta != NULL; delta = delta->next)
+        {
+            cnt++;
+        }
+        return cnt;
+    }
+};
+}
+
+#endif // Include guard
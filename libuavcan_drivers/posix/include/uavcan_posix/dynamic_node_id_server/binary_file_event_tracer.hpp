@@ -0,0 +1,294 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_BINARY_FILE_EVENT_TRACER_HPP_INCLUDED
+#define UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_BINARY_FILE_EVENT_TRACER_HPP_INCLUDED
+
+#include <uavcan/protocol/dynamic_node_id_server/event.hpp>
+#include <cstring>
+#include <cerrno>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace uavcan_posix
+{
+namespace dynamic_node_id_server
+{
+/**
+ * This interface implements a POSIX compliant file based IEventTracer interface that stores the events in a
+ * compact binary format instead of text, see @ref FileEventTracer.
+ *
+ * The events are accumulated in a ring buffer in RAM and appended to the file with a single write() once the buffer
+ * is half full, or once the flush interval has expired since the last flush, whichever comes first; the interval
+ * is only checked when a new event arrives, so the application may want to call @ref flush() periodically as well.
+ * If the file cannot be written, the buffer keeps the most recent events and the oldest ones are lost.
+ * The buffer is flushed when the object is destroyed.
+ *
+ * File format: a 16 byte header, see @ref encodeHeader(), followed by records of @ref RecordSize bytes.
+ * All integers are little endian. A record contains:
+ *  - UTC timestamp, microseconds, uint64;
+ *  - event argument, int64;
+ *  - event code, uint32.
+ * Use @ref decodeHeader() and @ref decodeRecord() to read the file, e.g. with the uavcan_decode_event_log tool.
+ * The encoding functions are public so that the applications that do their own I/O can produce the same format.
+ */
+class BinaryFileEventTracer : public uavcan::dynamic_node_id_server::IEventTracer
+{
+public:
+    enum { HeaderSize = 16 };
+    enum { RecordSize = 20 };
+    enum { FormatVersion = 1 };
+
+    struct Record
+    {
+        uavcan::uint64_t utc_usec;
+        uavcan::int64_t argument;
+        uavcan::dynamic_node_id_server::TraceCode code;
+
+        Record() :
+            utc_usec(0),
+            argument(0),
+            code(uavcan::dynamic_node_id_server::TraceCode(0))
+        { }
+    };
+
+private:
+    /**
+     * Maximum length of full path to log file
+     */
+    enum { MaxPathLength = 128 };
+
+    enum { FilePermissions = 438 };     ///< 0o666
+
+    enum { BufferCapacity = 256 };      ///< Records
+
+    enum { DefaultFlushIntervalMSec = 1000 };
+
+    /**
+     * This type is used for the path
+     */
+    typedef uavcan::MakeString<MaxPathLength>::Type PathString;
+
+    static const char* getMagic() { return "UCEVTLOG"; }
+
+    PathString path_;
+    int fd_;
+    uavcan::uint8_t buffer_[BufferCapacity][RecordSize];
+    unsigned buffer_head_;              ///< Index of the oldest record
+    unsigned buffer_len_;
+    uavcan::uint64_t last_flush_usec_;
+    uavcan::uint32_t flush_interval_msec_;
+    uavcan::uint32_t num_lost_events_;
+
+    static uavcan::uint64_t getUtcUSec()
+    {
+        timespec ts = timespec();               // If clock_gettime() fails, zero time will be used
+        (void)clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<uavcan::uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uavcan::uint64_t>(ts.tv_nsec / 1000L);
+    }
+
+    static void writeLE(uavcan::uint8_t* out, uavcan::uint64_t value, unsigned size)
+    {
+        for (unsigned i = 0; i < size; i++)
+        {
+            out[i] = static_cast<uavcan::uint8_t>(value >> (i * 8U));
+        }
+    }
+
+    static uavcan::uint64_t readLE(const uavcan::uint8_t* in, unsigned size)
+    {
+        uavcan::uint64_t value = 0;
+        for (unsigned i = 0; i < size; i++)
+        {
+            value |= static_cast<uavcan::uint64_t>(in[i]) << (i * 8U);
+        }
+        return value;
+    }
+
+    bool writeAll(const uavcan::uint8_t* data, unsigned size)
+    {
+        while (size > 0)
+        {
+            const ssize_t res = ::write(fd_, data, size);
+            if (res < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (res <= 0)
+            {
+                return false;
+            }
+            data += res;
+            size -= static_cast<unsigned>(res);
+        }
+        return true;
+    }
+
+protected:
+    virtual void onEvent(uavcan::dynamic_node_id_server::TraceCode code, uavcan::int64_t argument)
+    {
+        const uavcan::uint64_t ts = getUtcUSec();
+
+        if (buffer_len_ >= BufferCapacity)
+        {
+            buffer_head_ = (buffer_head_ + 1U) % BufferCapacity;        // Overwriting the oldest one
+            buffer_len_--;
+            num_lost_events_++;
+        }
+
+        Record record;
+        record.utc_usec = ts;
+        record.argument = argument;
+        record.code = code;
+        encodeRecord(record, buffer_[(buffer_head_ + buffer_len_) % BufferCapacity]);
+        buffer_len_++;
+
+        if ((buffer_len_ >= BufferCapacity / 2) ||
+            (ts - last_flush_usec_) >= (static_cast<uavcan::uint64_t>(flush_interval_msec_) * 1000U))
+        {
+            (void)flush();
+        }
+    }
+
+public:
+    BinaryFileEventTracer() :
+        fd_(-1),
+        buffer_head_(0),
+        buffer_len_(0),
+        last_flush_usec_(0),
+        flush_interval_msec_(DefaultFlushIntervalMSec),
+        num_lost_events_(0)
+    { }
+
+    virtual ~BinaryFileEventTracer()
+    {
+        (void)flush();
+        if (fd_ >= 0)
+        {
+            (void)close(fd_);
+        }
+    }
+
+    /**
+     * Initializes the tracer; the file is truncated and the header is written.
+     * @param path                  Path to the log file.
+     * @param flush_interval_msec   Maximum time the events are kept in RAM while new events keep coming.
+     * @return                      Zero on success, negative error code otherwise.
+     */
+    int init(const PathString& path, uavcan::uint32_t flush_interval_msec = DefaultFlushIntervalMSec)
+    {
+        using namespace std;
+
+        if (path.size() == 0)
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+
+        path_ = path.c_str();
+        flush_interval_msec_ = flush_interval_msec;
+        buffer_head_ = 0;
+        buffer_len_ = 0;
+        num_lost_events_ = 0;
+        last_flush_usec_ = getUtcUSec();
+
+        if (fd_ >= 0)
+        {
+            (void)close(fd_);
+        }
+        fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, FilePermissions);
+        if (fd_ < 0)
+        {
+            return -errno;
+        }
+
+        uavcan::uint8_t header[HeaderSize];
+        encodeHeader(header);
+        return writeAll(header, HeaderSize) ? 0 : -uavcan::ErrFailure;
+    }
+
+    /**
+     * Writes the buffered events to the file.
+     * @return Zero on success, negative error code otherwise; the events are kept in the buffer on failure.
+     */
+    int flush()
+    {
+        last_flush_usec_ = getUtcUSec();
+        if (buffer_len_ == 0)
+        {
+            return 0;
+        }
+        if (fd_ < 0)
+        {
+            return -uavcan::ErrNotInited;
+        }
+
+        // The contents of the ring buffer are in at most two contiguous chunks
+        const unsigned first_len = uavcan::min<unsigned>(buffer_len_, BufferCapacity - buffer_head_);
+        if (!writeAll(&buffer_[buffer_head_][0], first_len * RecordSize))
+        {
+            return -uavcan::ErrFailure;
+        }
+        buffer_head_ = (buffer_head_ + first_len) % BufferCapacity;
+        buffer_len_ -= first_len;
+
+        if (buffer_len_ > 0)
+        {
+            if (!writeAll(&buffer_[0][0], buffer_len_ * RecordSize))
+            {
+                return -uavcan::ErrFailure;
+            }
+            buffer_head_ = buffer_len_;
+            buffer_len_ = 0;
+        }
+        return 0;
+    }
+
+    /**
+     * Number of events that have been overwritten in the buffer because the file could not be written.
+     */
+    uavcan::uint32_t getNumLostEvents() const { return num_lost_events_; }
+
+    static void encodeHeader(uavcan::uint8_t (&out_header)[HeaderSize])
+    {
+        std::memcpy(out_header, getMagic(), 8);
+        writeLE(out_header + 8, FormatVersion, 4);
+        writeLE(out_header + 12, RecordSize, 4);
+    }
+
+    static void encodeRecord(const Record& record, uavcan::uint8_t (&out_record)[RecordSize])
+    {
+        writeLE(out_record, record.utc_usec, 8);
+        writeLE(out_record + 8, static_cast<uavcan::uint64_t>(record.argument), 8);
+        writeLE(out_record + 16, static_cast<uavcan::uint32_t>(record.code), 4);
+    }
+
+    /**
+     * Validates the file header; returns false if the data is not an event log of a supported version.
+     */
+    static bool decodeHeader(const uavcan::uint8_t (&header)[HeaderSize])
+    {
+        return (std::memcmp(header, getMagic(), 8) == 0) &&
+               (readLE(header + 8, 4) == FormatVersion) &&
+               (readLE(header + 12, 4) == RecordSize);
+    }
+
+    static Record decodeRecord(const uavcan::uint8_t (&record)[RecordSize])
+    {
+        Record out;
+        out.utc_usec = readLE(record, 8);
+        out.argument = static_cast<uavcan::int64_t>(readLE(record + 8, 8));
+        out.code = static_cast<uavcan::dynamic_node_id_server::TraceCode>(readLE(record + 16, 4));
+        return out;
+    }
+};
+
+}
+}
+
+#endif // Include guard
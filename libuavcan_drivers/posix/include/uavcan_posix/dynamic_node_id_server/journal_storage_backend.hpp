@@ -0,0 +1,461 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_JOURNAL_STORAGE_BACKEND_HPP_INCLUDED
+#define UAVCAN_POSIX_DYNAMIC_NODE_ID_SERVER_JOURNAL_STORAGE_BACKEND_HPP_INCLUDED
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan/protocol/dynamic_node_id_server/storage_backend.hpp>
+#include <uavcan/transport/crc.hpp>
+
+namespace uavcan_posix
+{
+namespace dynamic_node_id_server
+{
+/**
+ * This interface implements a POSIX compliant IStorageBackend interface that keeps all key/value pairs in memory
+ * and logs every update to a single append-only journal file, instead of rewriting one file per key.
+ *
+ * Updates made outside of a batch are written and fsync()'ed immediately, exactly like in @ref FileStorageBackend.
+ * Updates made inside a batch (see @ref uavcan::dynamic_node_id_server::StorageBatch) are buffered and committed
+ * with a single write and fsync() once the outermost batch ends, so that a Raft log entry costs one fsync()
+ * instead of four. The server does not act on the written values until the batch is finished, so the
+ * durability guarantees are preserved.
+ *
+ * Every journal record is protected with a CRC; upon initialization the journal is replayed up to the first
+ * incomplete or corrupted record (e.g. one torn by a power loss), which is then discarded together with
+ * everything after it. The journal is compacted once it contains too many obsolete records.
+ *
+ * The in-memory table takes about 35 KB of heap memory, allocated in init().
+ */
+class JournalStorageBackend : public uavcan::dynamic_node_id_server::IStorageBackend
+{
+public:
+    /**
+     * Key, space, value, space, 4 digits of CRC, new line.
+     */
+    enum { MaxRecordLength = MaxStringLength * 2 + 7 };
+
+    /**
+     * Records of a batch are accumulated in a buffer of this size; larger batches are written in several chunks.
+     */
+    enum { WriteBufferSize = MaxRecordLength * 8 };
+
+    /**
+     * The journal will be compacted once the number of obsolete records in it exceeds this value.
+     */
+    enum { MaxObsoleteRecords = MaxKeyValuePairs * 2 };
+
+private:
+    /**
+     * Maximum length of full path including / and the journal file name
+     */
+    enum { MaxPathLength = 128 };
+
+    enum { FilePermissions = 438 };     ///< 0o666
+
+    /**
+     * This type is used for the path
+     */
+    typedef uavcan::MakeString<MaxPathLength>::Type PathString;
+
+    struct KeyValue
+    {
+        String key;
+        String value;
+    };
+
+    PathString journal_path_;
+    KeyValue* table_;
+    unsigned table_size_;
+    unsigned num_journal_records_;
+    unsigned batch_depth_;
+    int fd_;
+    bool unsynced_;
+    unsigned write_buffer_len_;
+    char write_buffer_[WriteBufferSize];
+
+    static const char* getJournalFileName() { return "journal"; }
+
+    static uint16_t computeRecordCRC(const char* record, unsigned len)
+    {
+        uavcan::TransferCRC crc;
+        crc.add(reinterpret_cast<const uint8_t*>(record), len);
+        return crc.get();
+    }
+
+    KeyValue* find(const String& key) const
+    {
+        for (unsigned i = 0; i < table_size_; i++)
+        {
+            if (table_[i].key == key)
+            {
+                return &table_[i];
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * Updates the in-memory table only. Returns false if the table is full.
+     */
+    bool apply(const String& key, const String& value)
+    {
+        KeyValue* const kv = find(key);
+        if (value.empty())
+        {
+            if (kv != NULL)
+            {
+                *kv = table_[--table_size_];
+            }
+            return true;
+        }
+        if (kv != NULL)
+        {
+            kv->value = value;
+            return true;
+        }
+        if (table_size_ >= MaxKeyValuePairs)
+        {
+            return false;
+        }
+        table_[table_size_].key = key;
+        table_[table_size_].value = value;
+        table_size_++;
+        return true;
+    }
+
+    static int writeAll(int fd, const char* data, unsigned len)
+    {
+        while (len > 0)
+        {
+            const ssize_t res = ::write(fd, data, len);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return -errno;
+            }
+            data += res;
+            len -= unsigned(res);
+        }
+        return 0;
+    }
+
+    static unsigned formatRecord(char* out, const String& key, const String& value)
+    {
+        using namespace std;
+        int len = snprintf(out, MaxRecordLength + 1, "%s %s ", key.c_str(), value.c_str());
+        const uint16_t crc = computeRecordCRC(out, unsigned(len - 1));
+        len += snprintf(out + len, MaxRecordLength + 1 - unsigned(len), "%04x\n", unsigned(crc));
+        return unsigned(len);
+    }
+
+    /**
+     * Parses one record without the trailing new line. Returns false if the record is malformed.
+     */
+    static bool parseRecord(char* record, unsigned len, String& out_key, String& out_value)
+    {
+        using namespace std;
+        if (len < 7 || record[len - 5] != ' ')
+        {
+            return false;
+        }
+        record[len] = '\0';
+        record[len - 5] = '\0';
+        char* const value_sep = strchr(record, ' ');
+        if (value_sep == NULL || value_sep == record)
+        {
+            return false;
+        }
+        const unsigned long crc = strtoul(&record[len - 4], NULL, 16);
+        if (crc != computeRecordCRC(record, len - 5))
+        {
+            return false;
+        }
+        *value_sep = '\0';
+        if ((value_sep - record) > MaxStringLength || strlen(value_sep + 1) > MaxStringLength)
+        {
+            return false;
+        }
+        out_key = record;
+        out_value = value_sep + 1;
+        return true;
+    }
+
+    /**
+     * Loads the journal into the table and returns the length of its valid part.
+     */
+    off_t replay(int fd)
+    {
+        char line[MaxRecordLength + 1];
+        unsigned line_len = 0;
+        off_t valid_len = 0;
+        off_t pos = 0;
+        char chunk[512];
+
+        for (;;)
+        {
+            const ssize_t len = ::read(fd, chunk, sizeof(chunk));
+            if (len <= 0)
+            {
+                break;
+            }
+            for (ssize_t i = 0; i < len; i++)
+            {
+                pos++;
+                if (chunk[i] != '\n')
+                {
+                    if (line_len >= MaxRecordLength)
+                    {
+                        return valid_len;
+                    }
+                    line[line_len++] = chunk[i];
+                    continue;
+                }
+                String key;
+                String value;
+                if (!parseRecord(line, line_len, key, value) || !apply(key, value))
+                {
+                    return valid_len;
+                }
+                num_journal_records_++;
+                line_len = 0;
+                valid_len = pos;
+            }
+        }
+        return valid_len;
+    }
+
+    int flushWriteBuffer()
+    {
+        const int res = writeAll(fd_, write_buffer_, write_buffer_len_);
+        write_buffer_len_ = 0;
+        unsynced_ = true;
+        return res;
+    }
+
+    /**
+     * Rewrites the journal with the live records only, replacing the old one atomically.
+     */
+    int compact()
+    {
+        using namespace std;
+
+        PathString tmp_path = journal_path_;
+        tmp_path += ".tmp";
+
+        const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, FilePermissions);
+        if (fd < 0)
+        {
+            return -errno;
+        }
+
+        int res = 0;
+        for (unsigned i = 0; (i < table_size_) && (res >= 0); i++)
+        {
+            char record[MaxRecordLength + 1];
+            res = writeAll(fd, record, formatRecord(record, table_[i].key, table_[i].value));
+        }
+        if (res >= 0 && fsync(fd) < 0)
+        {
+            res = -errno;
+        }
+        (void)close(fd);
+
+        if (res >= 0 && rename(tmp_path.c_str(), journal_path_.c_str()) < 0)
+        {
+            res = -errno;
+        }
+        if (res < 0)
+        {
+            (void)unlink(tmp_path.c_str());
+            return res;
+        }
+
+        (void)close(fd_);
+        fd_ = open(journal_path_.c_str(), O_WRONLY | O_APPEND);
+        num_journal_records_ = table_size_;
+        return (fd_ < 0) ? -errno : 0;
+    }
+
+    void commit()
+    {
+        if (fd_ < 0 || (write_buffer_len_ == 0 && !unsynced_))
+        {
+            return;
+        }
+        if (flushWriteBuffer() >= 0)
+        {
+            (void)fsync(fd_);
+        }
+        unsynced_ = false;
+        if ((num_journal_records_ - table_size_) > MaxObsoleteRecords)
+        {
+            (void)compact();
+        }
+    }
+
+protected:
+    virtual String get(const String& key) const
+    {
+        const KeyValue* const kv = (table_ == NULL) ? NULL : find(key);
+        return (kv == NULL) ? String() : kv->value;
+    }
+
+    virtual void set(const String& key, const String& value)
+    {
+        if (fd_ < 0 || key.empty() || !apply(key, value))
+        {
+            return;
+        }
+
+        if ((write_buffer_len_ + MaxRecordLength + 1) > WriteBufferSize)
+        {
+            (void)flushWriteBuffer();   // The batch is too large, the data will be synced when it's finished
+        }
+        write_buffer_len_ += formatRecord(&write_buffer_[write_buffer_len_], key, value);
+        num_journal_records_++;
+
+        if (batch_depth_ == 0)
+        {
+            commit();
+        }
+    }
+
+    virtual void beginBatch()
+    {
+        batch_depth_++;
+    }
+
+    virtual void endBatch()
+    {
+        UAVCAN_ASSERT(batch_depth_ > 0);
+        if (batch_depth_ > 0)
+        {
+            batch_depth_--;
+        }
+        if (batch_depth_ == 0)
+        {
+            commit();
+        }
+    }
+
+public:
+    JournalStorageBackend() :
+        table_(NULL),
+        table_size_(0),
+        num_journal_records_(0),
+        batch_depth_(0),
+        fd_(-1),
+        unsynced_(false),
+        write_buffer_len_(0)
+    { }
+
+    virtual ~JournalStorageBackend()
+    {
+        commit();
+        if (fd_ >= 0)
+        {
+            (void)close(fd_);
+        }
+        delete [] table_;
+    }
+
+    /**
+     * Initializes the journal based backend storage by passing a path to the directory where the journal file
+     * will be stored. The existing journal, if any, is loaded into memory.
+     * Note that the storage format is not compatible with @ref FileStorageBackend.
+     * The return value should be 0 on success.
+     * If it is -ErrInvalidConfiguration then the the path name is too long.
+     */
+    int init(const PathString& path)
+    {
+        using namespace std;
+
+        if (path.size() == 0)
+        {
+            return -uavcan::ErrInvalidParam;
+        }
+
+        PathString dir_path = path.c_str();
+        if (dir_path.back() == '/')
+        {
+            dir_path.pop_back();
+        }
+
+        int rv = 0;
+        struct stat sb;
+        if (stat(dir_path.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode))
+        {
+            // coverity[toctou]
+            rv = mkdir(dir_path.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+        }
+        if (rv < 0)
+        {
+            return rv;
+        }
+
+        if ((dir_path.size() + 1 + std::strlen(getJournalFileName()) + 4) > MaxPathLength)
+        {
+            return -uavcan::ErrInvalidConfiguration;     // Leaving room for the temporary file suffix
+        }
+        journal_path_ = dir_path;
+        journal_path_.push_back('/');
+        journal_path_ += getJournalFileName();
+
+        if (table_ == NULL)
+        {
+            table_ = new KeyValue[MaxKeyValuePairs];
+            if (table_ == NULL)
+            {
+                return -uavcan::ErrMemory;
+            }
+        }
+        table_size_ = 0;
+        num_journal_records_ = 0;
+        unsynced_ = false;
+        write_buffer_len_ = 0;
+        if (fd_ >= 0)
+        {
+            (void)close(fd_);
+        }
+
+        fd_ = open(journal_path_.c_str(), O_RDWR | O_CREAT, FilePermissions);
+        if (fd_ < 0)
+        {
+            return -errno;
+        }
+
+        const off_t valid_len = replay(fd_);
+        if (lseek(fd_, 0, SEEK_END) != valid_len)
+        {
+            (void)ftruncate(fd_, valid_len);   // Dropping the torn tail so that new records are not appended after it
+            (void)fsync(fd_);
+        }
+        (void)close(fd_);
+
+        fd_ = open(journal_path_.c_str(), O_WRONLY | O_APPEND);
+        return (fd_ < 0) ? -errno : 0;
+    }
+};
+
+}
+}
+
+#endif // Include guard
@@ -0,0 +1,296 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_FIRMWARE_DELTA_HPP_INCLUDED
+#define UAVCAN_POSIX_FIRMWARE_DELTA_HPP_INCLUDED
+
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include <uavcan/build_config.hpp>
+#include <uavcan/std.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Binary delta between two firmware images, for nodes whose bootloader can patch the running image instead of
+ * downloading the new one in full.
+ *
+ * All integers are little endian. The delta starts with a header of HeaderSize bytes:
+ *    offset  size  field
+ *         0     8  "UAVCDLT1"
+ *         8     8  image_crc from the app descriptor of the base image; the bootloader must check it
+ *        16     8  image_crc from the app descriptor of the new image
+ *        24     4  size of the new image
+ *        28     4  size of the base image
+ * The header is followed by commands that produce the new image sequentially until its size is reached:
+ *    OpCopy  u32 base_offset, u32 length   - copy bytes from the base image
+ *    OpData  u32 length, bytes             - literal bytes
+ *
+ * The encoder finds the blocks of the base image (at BlockSize aligned offsets) in the new image with a rolling
+ * hash and extends every match in both directions, so that moved code and data are also copied. The size of
+ * a delta never exceeds the size of the new image by more than HeaderSize + 5 bytes.
+ */
+class FirmwareDelta
+{
+    enum { MaxCandidates = 16 };        ///< Hash chain entries compared per position, bounds the encoding time
+
+    static uint32_t getHashMultiplier() { return 0x01000193U; }
+
+    static uint32_t computeHash(const uint8_t* data)
+    {
+        uint32_t h = 0;
+        for (unsigned i = 0; i < BlockSize; i++)
+        {
+            h = h * getHashMultiplier() + data[i];
+        }
+        return h;
+    }
+
+    static uint32_t computeBucket(uint32_t hash, unsigned table_bits)
+    {
+        return (table_bits == 0) ? 0 : ((hash * 2654435761U) >> (32 - table_bits));
+    }
+
+    static uint8_t* putU32(uint8_t* p, uint32_t x)
+    {
+        for (unsigned i = 0; i < 4; i++)
+        {
+            *p++ = uint8_t(x >> (i * 8));
+        }
+        return p;
+    }
+
+    static uint8_t* putU64(uint8_t* p, uint64_t x)
+    {
+        p = putU32(p, uint32_t(x));
+        return putU32(p, uint32_t(x >> 32));
+    }
+
+    static uint8_t* putData(uint8_t* p, const uint8_t* data, uint32_t length)
+    {
+        if (length > 0)
+        {
+            *p++ = OpData;
+            p = putU32(p, length);
+            (void)std::memcpy(p, data, length);
+            p += length;
+        }
+        return p;
+    }
+
+    static uint8_t* putCopy(uint8_t* p, uint32_t base_offset, uint32_t length)
+    {
+        *p++ = OpCopy;
+        p = putU32(p, base_offset);
+        return putU32(p, length);
+    }
+
+public:
+    enum { BlockSize = 32 };
+    enum { HeaderSize = 32 };
+    enum OpCode { OpCopy = 1, OpData = 2 };
+    enum { PathSuffixLength = 13 };     ///< ".XXXXXXXX.dlt"
+
+    static const char* getMagic() { return "UAVCDLT1"; }
+
+    static uint32_t getMaxSize(uint32_t image_size) { return HeaderSize + 5 + image_size; }
+
+    /**
+     * Makes the virtual path of the delta from the base image with the given CRC to the image at the given path:
+     * the image path followed by ".XXXXXXXX.dlt", where XXXXXXXX are the lower 32 bits of the base CRC in hex.
+     * Returns false if the resulting path does not fit the output string.
+     */
+    template <typename String>
+    static bool makePath(const char* image_path, uint64_t base_crc, String& out_path)
+    {
+        char suffix[PathSuffixLength + 1];
+        (void)std::snprintf(suffix, sizeof(suffix), ".%08x.dlt", unsigned(uint32_t(base_crc)));
+        if ((std::strlen(image_path) + PathSuffixLength) > out_path.capacity())
+        {
+            return false;
+        }
+        out_path = image_path;
+        out_path += suffix;
+        return true;
+    }
+
+    /**
+     * Splits the virtual path made by @ref makePath() into the image path and the lower 32 bits of the base CRC.
+     * Returns false if this is not a delta path.
+     */
+    template <unsigned OutSize>
+    static bool parsePath(const char* path, char (&out_image_path)[OutSize], uint32_t& out_base_crc32)
+    {
+        const unsigned len = unsigned(std::strlen(path));
+        if (len <= PathSuffixLength || (len - PathSuffixLength) >= OutSize ||
+            0 != std::strcmp(path + len - 4, ".dlt") || path[len - PathSuffixLength] != '.')
+        {
+            return false;
+        }
+        char hex[9];
+        (void)std::memcpy(hex, path + len - PathSuffixLength + 1, 8);
+        hex[8] = '\0';
+        char* end = NULL;
+        out_base_crc32 = uint32_t(std::strtoul(hex, &end, 16));
+        if (end != &hex[8])
+        {
+            return false;
+        }
+        (void)std::memcpy(out_image_path, path, len - PathSuffixLength);
+        out_image_path[len - PathSuffixLength] = '\0';
+        return true;
+    }
+
+    /**
+     * Encodes the delta into a buffer allocated with new[], which must be freed with delete[] by the caller.
+     * Returns NULL if the memory could not be allocated.
+     */
+    static uint8_t* encode(const uint8_t* base, uint32_t base_size, uint64_t base_crc,
+                           const uint8_t* image, uint32_t image_size, uint64_t image_crc, uint32_t& out_size)
+    {
+        const uint32_t num_blocks = base_size / BlockSize;
+        unsigned table_bits = 0;
+        while ((1U << table_bits) < num_blocks)
+        {
+            table_bits++;
+        }
+        const uint32_t Empty = 0xFFFFFFFFU;
+
+        uint8_t* const out = new uint8_t[getMaxSize(image_size)];
+        uint32_t* const heads = new uint32_t[1U << table_bits];
+        uint32_t* const chain = new uint32_t[num_blocks + 1];
+        if (out == NULL || heads == NULL || chain == NULL)
+        {
+            delete[] out;
+            delete[] heads;
+            delete[] chain;
+            return NULL;
+        }
+
+        for (uint32_t i = 0; i < (1U << table_bits); i++)
+        {
+            heads[i] = Empty;
+        }
+        for (uint32_t blk = num_blocks; blk > 0; blk--)     // Lower offsets are tried first
+        {
+            const uint32_t bucket = computeBucket(computeHash(base + (blk - 1) * BlockSize), table_bits);
+            chain[blk - 1] = heads[bucket];
+            heads[bucket] = blk - 1;
+        }
+
+        uint8_t* p = out;
+        (void)std::memcpy(p, getMagic(), 8);
+        p = putU64(p + 8, base_crc);
+        p = putU64(p, image_crc);
+        p = putU32(p, image_size);
+        p = putU32(p, base_size);
+
+        uint32_t multiplier_pow = 1;                        // Weight of the outgoing byte
+        for (unsigned i = 1; i < BlockSize; i++)
+        {
+            multiplier_pow *= getHashMultiplier();
+        }
+
+        uint32_t literal_start = 0;
+        uint32_t pos = 0;
+        uint32_t hash = (image_size >= BlockSize) ? computeHash(image) : 0;
+
+        while (num_blocks > 0 && (pos + BlockSize) <= image_size)
+        {
+            uint32_t best_offset = 0;
+            uint32_t best_back = 0;
+            uint32_t best_length = 0;
+
+            unsigned num_candidates = 0;
+            for (uint32_t blk = heads[computeBucket(hash, table_bits)];
+                 blk != Empty && num_candidates < MaxCandidates;
+                 blk = chain[blk], num_candidates++)
+            {
+                const uint32_t offset = blk * BlockSize;
+                if (0 != std::memcmp(base + offset, image + pos, BlockSize))
+                {
+                    continue;
+                }
+                uint32_t length = BlockSize;
+                while ((pos + length) < image_size && (offset + length) < base_size &&
+                       image[pos + length] == base[offset + length])
+                {
+                    length++;
+                }
+                uint32_t back = 0;
+                while ((pos - back) > literal_start && (offset - back) > 0 &&
+                       image[pos - back - 1] == base[offset - back - 1])
+                {
+                    back++;
+                }
+                if ((length + back) > best_length)
+                {
+                    best_offset = offset;
+                    best_back = back;
+                    best_length = length + back;
+                }
+            }
+
+            if (best_length > 0)
+            {
+                p = putData(p, image + literal_start, pos - best_back - literal_start);
+                p = putCopy(p, best_offset - best_back, best_length);
+                pos = pos - best_back + best_length;
+                literal_start = pos;
+                if ((pos + BlockSize) <= image_size)
+                {
+                    hash = computeHash(image + pos);
+                }
+            }
+            else
+            {
+                if ((pos + BlockSize) < image_size)
+                {
+                    hash = (hash - image[pos] * multiplier_pow) * getHashMultiplier() + image[pos + BlockSize];
+                }
+                pos++;
+            }
+        }
+        p = putData(p, image + literal_start, image_size - literal_start);
+
+        delete[] heads;
+        delete[] chain;
+
+        out_size = uint32_t(p - out);
+        UAVCAN_ASSERT(out_size <= getMaxSize(image_size));
+        return out;
+    }
+
+    /**
+     * Finds the app descriptor in the image and returns its image_crc field.
+     * Returns false if the image has no descriptor.
+     */
+    static bool findImageCrc(const uint8_t* image, uint64_t image_size, uint64_t& out_crc)
+    {
+        const unsigned DescriptorSize = 32;
+        for (uint64_t offset = 0; (offset + DescriptorSize) <= image_size; offset += 8)
+        {
+            if (0 == std::memcmp(image + offset, "APDesc00", 8))
+            {
+                out_crc = 0;
+                for (unsigned i = 0; i < 8; i++)
+                {
+                    out_crc |= uint64_t(image[offset + 8 + i]) << (i * 8);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+};
+}
+
+#endif // Include guard
@@ -0,0 +1,350 @@
+/****************************************************************************
+*
+*   Copyright (c) 2015 PX4 Development Team. All rights reserved.
+*      Author: Pavel Kirienko <pavel.kirienko@gmail.com>
+*              David Sidrane <david_s5@usa.net>
+*
+****************************************************************************/
+
+#ifndef UAVCAN_POSIX_FIRMWARE_IMAGE_CACHE_HPP_INCLUDED
+#define UAVCAN_POSIX_FIRMWARE_IMAGE_CACHE_HPP_INCLUDED
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <uavcan/node/timer.hpp>
+#include <uavcan_posix/basic_file_server_backend.hpp>
+
+namespace uavcan_posix
+{
+/**
+ * Keeps read-only memory mappings of the files served by the file server, so that the same firmware image
+ * being read by many nodes at once (see @ref FirmwareUpdateTrigger) is loaded from the storage only once.
+ *
+ * Images are identified by their content rather than by path: device, inode, size and modification time.
+ * The path is re-validated with stat() at most once per ValidationIntervalSeconds; a changed file is mapped anew,
+ * and the old mapping is released as soon as the last reference to it is gone.
+ * Unreferenced images are unmapped once they have not been accessed for MaxAgeSeconds.
+ *
+ * Note that a file must not be truncated in place while it is mapped; firmware files are expected to be
+ * replaced (e.g. written to a temporary file and renamed), which creates a new inode.
+ *
+ * This class requires mmap() support for regular files, which is not available on all POSIX platforms.
+ */
+class FirmwareImageCache : protected uavcan::TimerBase
+{
+    /// Age in Seconds an unreferenced image will stay mapped if not accessed.
+    enum { MaxAgeSeconds = 7 };
+
+    /// Rate in Seconds that the cache will be flushed of stale entries.
+    enum { GarbageCollectionSeconds = 10 };
+
+    /// Interval in Seconds between checks whether the file at the given path has changed.
+    enum { ValidationIntervalSeconds = 1 };
+
+    enum { MaxPathLength = uavcan::protocol::file::Path::FieldTypes::path::MaxSize };
+
+public:
+    class Image : uavcan::Noncopyable
+    {
+        friend class FirmwareImageCache;
+
+        Image* next_;
+        const uint8_t* const data_;
+        const off_t size_;
+        const dev_t dev_;
+        const ino_t ino_;
+        const time_t mtime_;
+        time_t last_access_;
+        time_t validated_at_;
+        unsigned refcount_;
+        bool stale_;
+        char path_[MaxPathLength + 1];
+
+        Image(const char* path, const struct stat& sb, const uint8_t* data) :
+            next_(NULL),
+            data_(data),
+            size_(sb.st_size),
+            dev_(sb.st_dev),
+            ino_(sb.st_ino),
+            mtime_(sb.st_mtime),
+            last_access_(0),
+            validated_at_(0),
+            refcount_(0),
+            stale_(false)
+        {
+            setPath(path);
+        }
+
+        ~Image()
+        {
+            if (data_ != NULL)
+            {
+                (void)::munmap(const_cast<uint8_t*>(data_), size_t(size_));
+            }
+        }
+
+        void setPath(const char* path)
+        {
+            (void)::strncpy(path_, path, MaxPathLength);
+            path_[MaxPathLength] = '\0';
+        }
+
+        bool matches(const struct stat& sb) const
+        {
+            return sb.st_dev == dev_ && sb.st_ino == ino_ && sb.st_size == size_ && sb.st_mtime == mtime_;
+        }
+
+    public:
+        uint64_t getSize() const { return uint64_t(size_); }
+
+        const uint8_t* getData() const { return data_; }
+
+        /**
+         * Copies up to inout_size bytes starting at the offset; inout_size is set to the number of bytes copied,
+         * which is less than requested only if the end of the image is reached.
+         */
+        void read(const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size) const
+        {
+            if (offset >= getSize())
+            {
+                inout_size = 0;
+                return;
+            }
+            inout_size = uint16_t(uavcan::min(uint64_t(inout_size), getSize() - offset));
+            (void)::memcpy(out_buffer, data_ + offset, inout_size);
+        }
+    };
+
+private:
+    Image* head_;
+
+    static void destroy(Image* image)
+    {
+        delete image;
+    }
+
+    static Image* use(Image* image, time_t now)
+    {
+        image->last_access_ = now;
+        image->refcount_++;
+        return image;
+    }
+
+    /**
+     * Removes the unreferenced entries that are stale or expired, or all unreferenced entries if expired_only
+     * is false. Referenced entries are never removed; stale ones will be destroyed upon release.
+     */
+    void removeUnused(bool expired_only)
+    {
+        const time_t now = time(NULL);
+        Image** pi = &head_;
+        while (*pi)
+        {
+            Image* const image = *pi;
+            const bool expired = !expired_only || image->stale_ || (now - image->last_access_) > MaxAgeSeconds;
+            if (image->refcount_ == 0 && expired)
+            {
+                *pi = image->next_;
+                destroy(image);
+                continue;
+            }
+            pi = &image->next_;
+        }
+    }
+
+    Image* map(const char* path, const struct stat& sb)
+    {
+        const uint8_t* data = NULL;
+
+        if (sb.st_size > 0)
+        {
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+            {
+                return NULL;
+            }
+
+            void* const mapping = ::mmap(NULL, size_t(sb.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            (void)::close(fd);                  // The mapping stays valid
+            if (mapping == MAP_FAILED)
+            {
+                return NULL;
+            }
+            data = static_cast<const uint8_t*>(mapping);
+        }
+
+        Image* const image = new Image(path, sb, data);
+        if (image == NULL)
+        {
+            if (data != NULL)
+            {
+                (void)::munmap(const_cast<uint8_t*>(data), size_t(sb.st_size));
+            }
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        image->next_ = head_;
+        head_ = image;
+        return image;
+    }
+
+    virtual void handleTimerEvent(const uavcan::TimerEvent&)
+    {
+        removeUnused(true);
+    }
+
+public:
+    FirmwareImageCache(uavcan::INode& node) :
+        TimerBase(node),
+        head_(NULL)
+    { }
+
+    virtual ~FirmwareImageCache()
+    {
+        stop();
+        for (Image* image = head_; image != NULL;)
+        {
+            Image* const next = image->next_;
+            UAVCAN_ASSERT(image->refcount_ == 0);
+            destroy(image);
+            image = next;
+        }
+    }
+
+    /**
+     * Returns a reference to the image of the regular file at the given path, mapping it if necessary.
+     * Every successful call must be paired with @ref release().
+     * Returns NULL on failure, in which case errno indicates the reason.
+     */
+    Image* acquire(const char* path)
+    {
+        if (!isRunning())
+        {
+            startPeriodic(uavcan::MonotonicDuration::fromMSec(GarbageCollectionSeconds * 1000));
+        }
+
+        const time_t now = time(NULL);
+
+        for (Image* image = head_; image != NULL; image = image->next_)
+        {
+            if (!image->stale_ && (now - image->validated_at_) < ValidationIntervalSeconds &&
+                0 == ::strcmp(image->path_, path))
+            {
+                return use(image, now);
+            }
+        }
+
+        struct stat sb;
+        if (::stat(path, &sb) < 0)
+        {
+            return NULL;
+        }
+        if (!S_ISREG(sb.st_mode))
+        {
+            errno = EINVAL;
+            return NULL;
+        }
+
+        Image* found = NULL;
+        for (Image* image = head_; image != NULL; image = image->next_)
+        {
+            if (image->stale_)
+            {
+                continue;
+            }
+            if (image->matches(sb))
+            {
+                found = image;
+            }
+            else if (0 == ::strcmp(image->path_, path))
+            {
+                image->stale_ = true;           // The file has been modified or replaced
+            }
+        }
+
+        if (found == NULL)
+        {
+            found = map(path, sb);
+            if (found == NULL)
+            {
+                return NULL;
+            }
+        }
+
+        found->setPath(path);
+        found->validated_at_ = now;
+        return use(found, now);
+    }
+
+    /**
+     * Releases the reference obtained from @ref acquire().
+     */
+    void release(Image* image)
+    {
+        UAVCAN_ASSERT(image != NULL && image->refcount_ > 0);
+        image->refcount_--;
+        if (image->refcount_ == 0 && image->stale_)
+        {
+            removeUnused(true);
+        }
+    }
+
+    /**
+     * Unmaps all images that are not referenced at the moment.
+     */
+    void clear()
+    {
+        removeUnused(false);
+    }
+
+    unsigned getNumImages() const
+    {
+        unsigned cnt = 0;
+        for (const Image* image = head_; image != NULL; image = image->next_)
+        {
+            cnt++;
+        }
+        return cnt;
+    }
+};
+
+/**
+ * File server backend that serves regular files from a @ref FirmwareImageCache, which can be shared with other
+ * backends, and falls back to @ref BasicFileSeverBackend for everything else.
+ */
+class MappedFileServerBackend : public BasicFileSeverBackend
+{
+    FirmwareImageCache& image_cache_;
+
+protected:
+    virtual int16_t read(const Path& path, const uint64_t offset, uint8_t* out_buffer, uint16_t& inout_size)
+    {
+        if (path.size() > 0)
+        {
+            FirmwareImageCache::Image* const image = image_cache_.acquire(path.c_str());
+            if (image != NULL)
+            {
+                image->read(offset, out_buffer, inout_size);
+                image_cache_.release(image);
+                return 0;
+            }
+        }
+        return BasicFileSeverBackend::read(path, offset, out_buffer, inout_size);
+    }
+
+public:
+    MappedFileServerBackend(uavcan::INode& node, FirmwareImageCache& image_cache) :
+        BasicFileSeverBackend(node),
+        image_cache_(image_cache)
+    { }
+};
+}
+
+#endif // Include guard
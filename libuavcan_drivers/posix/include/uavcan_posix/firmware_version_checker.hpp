@@ -14,9 +14,13 @@
 #include <cstring>
 #include <fcntl.h>
 #include <cerrno>
+#include <ctime>
 #include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <uavcan/protocol/firmware_update_trigger.hpp>
+#include <uavcan_posix/firmware_delta.hpp>
 
 // TODO Get rid of the macro
 #if !defined(DIRENT_ISFILE) && defined(DT_REG)
@@ -206,24 +210,83 @@ class FirmwareVersionChecker : public uavcan::IFirmwareVersionChecker
         return rv;
     }
 
-protected:
+    typedef uavcan::protocol::GetNodeInfo::Response::FieldTypes::name NodeName;
+
+    /// Interval in Seconds between checks whether a scanned firmware directory has changed.
+    enum { IndexValidationIntervalSeconds = 1 };
+
+    enum { NumIndexBuckets = 16 };
+
     /**
-     * This method will be invoked when the class obtains a response to GetNodeInfo request.
-     *
-     * @param node_id                   Node ID that this GetNodeInfo response was received from.
-     *
-     * @param node_info                 Actual node info structure; refer to uavcan.protocol.GetNodeInfo for details.
-     *
-     * @param out_firmware_file_path    The implementation should return the firmware image path via this argument.
-     *                                  Note that this path must be reachable via uavcan.protocol.file.Read service.
-     *                                  Refer to @ref FileServer and @ref BasicFileServer for details.
-     *
-     * @return                          True - the class will begin sending update requests.
-     *                                  False - the node will be ignored, no request will be sent.
+     * Result of the firmware directory scan for one node name and hardware version, so that the directory is
+     * scanned and the images are parsed only once rather than for every node that comes online.
+     * An entry is re-validated by the modification time of the directory, which changes when files are added,
+     * removed or renamed there.
      */
-    virtual bool shouldRequestFirmwareUpdate(uavcan::NodeID,
-                                             const uavcan::protocol::GetNodeInfo::Response& node_info,
-                                             FirmwareFilePath& out_firmware_file_path)
+    struct FirmwareIndexEntry : uavcan::Noncopyable
+    {
+        FirmwareIndexEntry* next;
+        NodeName name;
+        uint8_t hw_major;
+        uint8_t hw_minor;
+        bool has_image;
+        time_t dir_mtime;
+        ino_t dir_ino;
+        time_t validated_at;
+        uint64_t image_crc;
+        FirmwareFilePath file_name;
+
+        FirmwareIndexEntry(const NodeName& arg_name, uint8_t arg_hw_major, uint8_t arg_hw_minor) :
+            next(NULL),
+            name(arg_name),
+            hw_major(arg_hw_major),
+            hw_minor(arg_hw_minor),
+            has_image(false),
+            dir_mtime(0),
+            dir_ino(0),
+            validated_at(0),
+            image_crc(0)
+        { }
+
+        bool equals(const NodeName& arg_name, uint8_t arg_hw_major, uint8_t arg_hw_minor) const
+        {
+            return hw_major == arg_hw_major && hw_minor == arg_hw_minor && name == arg_name;
+        }
+    };
+
+    FirmwareIndexEntry* index_[NumIndexBuckets];
+
+    static unsigned computeIndexBucket(const NodeName& name, uint8_t hw_major, uint8_t hw_minor)
+    {
+        uint32_t hash = 2166136261U;                // FNV-1a
+        for (unsigned i = 0; i < name.size(); i++)
+        {
+            hash = (hash ^ name[i]) * 16777619U;
+        }
+        hash = (hash ^ hw_major) * 16777619U;
+        hash = (hash ^ hw_minor) * 16777619U;
+        return hash % NumIndexBuckets;
+    }
+
+    /**
+     * Path to the firmware directory of the given node type, without the trailing separator.
+     * Returns the length of the path, or a negative value if it does not fit.
+     */
+    int makeFirmwareDirPath(char (&out_path)[MaxBasePathLength + 1], const FirmwareIndexEntry& entry) const
+    {
+        using namespace std;
+        const int n = snprintf(out_path, sizeof(out_path), "%s%s/%d.%d",
+                               getFirmwareBasePath().c_str(),
+                               entry.name.c_str(),
+                               entry.hw_major,
+                               entry.hw_minor);
+        return (n > 0 && n < (int) sizeof(out_path) - 2) ? n : -1;
+    }
+
+    /**
+     * Finds the first valid image in the firmware directory of the entry, copying it to the cache directory.
+     */
+    void scanFirmwareDirectory(FirmwareIndexEntry& entry)
     {
         using namespace std;
 
@@ -242,17 +305,22 @@ protected:
          *                                                   in the root fw folder, so if it does not exist
          *                                                   it is copied up
          */
-        bool rv = false;
+        entry.has_image = false;
+        entry.dir_mtime = 0;
+        entry.dir_ino = 0;
 
         char fname_root[MaxBasePathLength + 1];
-        int n = snprintf(fname_root, sizeof(fname_root), "%s%s/%d.%d",
-                         getFirmwareBasePath().c_str(),
-                         node_info.name.c_str(),
-                         node_info.hardware_version.major,
-                         node_info.hardware_version.minor);
+        int n = makeFirmwareDirPath(fname_root, entry);
 
-        if (n > 0 && n < (int) sizeof(fname_root) - 2)
+        if (n > 0)
         {
+            struct stat sb;
+            if (stat(fname_root, &sb) == 0)
+            {
+                entry.dir_mtime = sb.st_mtime;
+                entry.dir_ino = sb.st_ino;
+            }
+
             DIR* const fwdir = opendir(fname_root);
 
             fname_root[n++] = getPathSeparator();
@@ -284,16 +352,9 @@ protected:
 
                             if (cr == 0 && getFileInfo(full_dst_path.c_str(), descriptor) == 0)
                             {
-                                volatile AppDescriptor descriptorC = descriptor;
-                                descriptorC.reserved[1]++;
-
-                                if (node_info.software_version.image_crc == 0 ||
-                                    (node_info.software_version.major == 0 && node_info.software_version.minor == 0) ||
-                                    descriptor.image_crc != node_info.software_version.image_crc)
-                                {
-                                    rv = true;
-                                    out_firmware_file_path = pfile->d_name;
-                                }
+                                entry.has_image = true;
+                                entry.image_crc = descriptor.image_crc;
+                                entry.file_name = pfile->d_name;
                                 break;
                             }
                         }
@@ -302,6 +363,145 @@ protected:
                 (void)closedir(fwdir);
             }
         }
+    }
+
+    /**
+     * Returns the index entry for the given node type, scanning its firmware directory if the entry is missing
+     * or out of date. Returns NULL if the entry could not be allocated.
+     */
+    const FirmwareIndexEntry* getIndexEntry(const NodeName& name, uint8_t hw_major, uint8_t hw_minor)
+    {
+        using namespace std;
+
+        FirmwareIndexEntry*& bucket = index_[computeIndexBucket(name, hw_major, hw_minor)];
+
+        FirmwareIndexEntry* entry = bucket;
+        while (entry != NULL && !entry->equals(name, hw_major, hw_minor))
+        {
+            entry = entry->next;
+        }
+
+        const time_t now = time(NULL);
+
+        if (entry == NULL)
+        {
+            entry = new FirmwareIndexEntry(name, hw_major, hw_minor);
+            if (entry == NULL)
+            {
+                return NULL;
+            }
+            entry->next = bucket;
+            bucket = entry;
+        }
+        else if ((now - entry->validated_at) < IndexValidationIntervalSeconds)
+        {
+            return entry;
+        }
+        else
+        {
+            char dir_path[MaxBasePathLength + 1];
+            struct stat sb;
+            const bool exists = makeFirmwareDirPath(dir_path, *entry) > 0 && stat(dir_path, &sb) == 0;
+            if ((!exists && entry->dir_ino == 0) ||
+                (exists && sb.st_mtime == entry->dir_mtime && sb.st_ino == entry->dir_ino))
+            {
+                entry->validated_at = now;
+                return entry;
+            }
+        }
+
+        scanFirmwareDirectory(*entry);
+        entry->validated_at = now;
+        return entry;
+    }
+
+    /**
+     * Whether the cache directory contains an image with the given CRC, i.e. the image has been served before.
+     */
+    bool isImageCached(uint64_t image_crc) const
+    {
+        using namespace std;
+
+        DIR* const dir = opendir(getFirmwareCachePath().c_str());
+        if (dir == NULL)
+        {
+            return false;
+        }
+
+        bool found = false;
+        struct dirent* pfile = NULL;
+        while (!found && (pfile = readdir(dir)) != NULL)
+        {
+            if (DIRENT_ISFILE(pfile->d_type) && strstr(pfile->d_name, ".bin") != NULL)
+            {
+                PathString path = getFirmwareCachePath().c_str();
+                path += pfile->d_name;
+
+                AppDescriptor descriptor;
+                std::memset(&descriptor, 0, sizeof(descriptor));
+                found = getFileInfo(path.c_str(), descriptor) == 0 && descriptor.image_crc == image_crc;
+            }
+        }
+        (void)closedir(dir);
+        return found;
+    }
+
+    void clearIndex()
+    {
+        for (unsigned i = 0; i < NumIndexBuckets; i++)
+        {
+            while (index_[i] != NULL)
+            {
+                FirmwareIndexEntry* const next = index_[i]->next;
+                delete index_[i];
+                index_[i] = next;
+            }
+        }
+    }
+
+protected:
+    /**
+     * This method will be invoked when the class obtains a response to GetNodeInfo request.
+     *
+     * @param node_id                   Node ID that this GetNodeInfo response was received from.
+     *
+     * @param node_info                 Actual node info structure; refer to uavcan.protocol.GetNodeInfo for details.
+     *
+     * @param out_firmware_file_path    The implementation should return the firmware image path via this argument.
+     *                                  Note that this path must be reachable via uavcan.protocol.file.Read service.
+     *                                  Refer to @ref FileServer and @ref BasicFileServer for details.
+     *
+     * @return                          True - the class will begin sending update requests.
+     *                                  False - the node will be ignored, no request will be sent.
+     */
+    virtual bool shouldRequestFirmwareUpdate(uavcan::NodeID node_id,
+                                             const uavcan::protocol::GetNodeInfo::Response& node_info,
+                                             FirmwareFilePath& out_firmware_file_path)
+    {
+        const FirmwareIndexEntry* const entry = getIndexEntry(node_info.name, node_info.hardware_version.major,
+                                                              node_info.hardware_version.minor);
+        bool rv = false;
+
+        if (entry != NULL && entry->has_image)
+        {
+            if (node_info.software_version.image_crc == 0 ||
+                (node_info.software_version.major == 0 && node_info.software_version.minor == 0) ||
+                entry->image_crc != node_info.software_version.image_crc)
+            {
+                rv = true;
+                out_firmware_file_path = entry->file_name;
+
+                const uint64_t running_crc = node_info.software_version.image_crc;
+                if (running_crc != 0 && isDeltaUpdateSupported(node_id, node_info) && isImageCached(running_crc))
+                {
+                    FirmwareFilePath delta_path;
+                    if (FirmwareDelta::makePath(entry->file_name.c_str(), running_crc, delta_path))
+                    {
+                        out_firmware_file_path = delta_path;
+                    }
+                }
+            }
+        }
         return rv;
     }
 
@@ -326,13 +526,57 @@ protected:
      */
     virtual bool shouldRetryFirmwareUpdate(uavcan::NodeID,
                                            const uavcan::protocol::file::BeginFirmwareUpdate::Response&,
-                                           FirmwareFilePath&)
+                                           FirmwareFilePath& out_firmware_file_path)
     {
+        // The node failed with the delta, falling back to the full image
+        char image_path[FirmwareFilePath::MaxSize + 1];
+        uint32_t base_crc32 = 0;
+        if (FirmwareDelta::parsePath(out_firmware_file_path.c_str(), image_path, base_crc32))
+        {
+            out_firmware_file_path = image_path;
+        }
         // TODO: Limit the number of attempts per node
         return true;
     }
 
+    /**
+     * Whether the bootloader of the node can apply firmware deltas (see @ref FirmwareDelta). If it can, and the
+     * image the node is running has been served before (i.e. it is in the cache directory), the node will be given
+     * the virtual path of the delta instead of the image; the file server must use
+     * @ref DeltaFirmwareServerBackend then. If the node rejects the delta, the full image will be offered.
+     * The default implementation returns false.
+     */
+    virtual bool isDeltaUpdateSupported(uavcan::NodeID node_id,
+                                        const uavcan::protocol::GetNodeInfo::Response& node_info)
+    {
+        (void)node_id;
+        (void)node_info;
+        return false;
+    }
+
 public:
+    FirmwareVersionChecker()
+    {
+        for (unsigned i = 0; i < NumIndexBuckets; i++)
+        {
+            index_[i] = NULL;
+        }
+    }
+
+    virtual ~FirmwareVersionChecker()
+    {
+        clearIndex();
+    }
+
+    /**
+     * Forces the firmware directories to be scanned again on the next GetNodeInfo response. This is needed only if
+     * an image is modified in place; added, removed or renamed images are picked up automatically.
+     */
+    void invalidateFirmwareIndex()
+    {
+        clearIndex();
+    }
+
     const BasePathString& getFirmwareBasePath() const { return base_path_; }
 
     const BasePathString& getFirmwareCachePath() const { return cache_path_; }
@@ -363,6 +607,7 @@ public:
 
             if (len > 0 && len < base_path_.MaxSize)
             {
+                clearIndex();
                 setFirmwareBasePath(base_path);
                 removeSlash(base_path_);
                 const char* path = getFirmwareBasePath().c_str();
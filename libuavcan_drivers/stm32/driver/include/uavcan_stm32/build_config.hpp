@@ -30,3 +30,67 @@
 // In this case the clock driver should be implemented by the application
 # define UAVCAN_STM32_TIMER_NUMBER 0
 #endif
+
+/**
+ * Hardware CRC unit with programmable polynomial (STM32F0, F3, F7, L0, L4).
+ * If enabled, the application must also build libuavcan with UAVCAN_USE_EXTERNAL_CRC=1,
+ * and enable the clock of the CRC unit before the node is started.
+ * The CRC unit must not be used by other parts of the application concurrently with libuavcan.
+ */
+#ifndef UAVCAN_STM32_HARDWARE_CRC
+# define UAVCAN_STM32_HARDWARE_CRC 0
+#endif
+
+/**
+ * FDCAN peripheral instead of bxCAN. CAN FD frames are supported if libuavcan is built with UAVCAN_SUPPORT_CANFD;
+ * otherwise the controller operates in the classic CAN mode.
+ * The value selects the MCU series, because the register maps and the message RAM layouts are different:
+ *   -DUAVCAN_STM32_FDCAN=4     STM32G4
+ *   -DUAVCAN_STM32_FDCAN=7     STM32H7
+ * The kernel clock of FDCAN must be configured by the application (see UAVCAN_STM32_FDCAN_KERNEL_CLOCK).
+ */
+#ifndef UAVCAN_STM32_FDCAN
+# define UAVCAN_STM32_FDCAN 0
+#endif
+
+#if UAVCAN_STM32_FDCAN && (UAVCAN_STM32_FDCAN != 4) && (UAVCAN_STM32_FDCAN != 7)
+# error "UAVCAN_STM32_FDCAN must be set to either 4 (STM32G4) or 7 (STM32H7)"
+#endif
+
+/**
+ * Bit rate of the data phase of CAN FD frames, e.g. -DUAVCAN_STM32_FDCAN_DATA_BITRATE=4000000.
+ * Zero disables the bit rate switching, so that the data phase uses the nominal bit rate.
+ * Only applicable to FDCAN with UAVCAN_SUPPORT_CANFD.
+ */
+#ifndef UAVCAN_STM32_FDCAN_DATA_BITRATE
+# define UAVCAN_STM32_FDCAN_DATA_BITRATE 0
+#endif
+
+/**
+ * TX mailbox preemption.
+ * If all TX mailboxes are busy and the library wants to send a frame of higher priority than all of them,
+ * the lowest-priority mailbox is aborted and the new frame is loaded into it; the aborted frame is kept by
+ * the driver and reloaded as soon as another mailbox becomes free. This bounds the TX latency of high-priority
+ * frames at the cost of some extra work in the TX interrupt.
+ */
+#ifndef UAVCAN_STM32_TX_PREEMPTION
+# define UAVCAN_STM32_TX_PREEMPTION 0
+#endif
+
+#if UAVCAN_STM32_TX_PREEMPTION && UAVCAN_STM32_FDCAN
+// FDCAN transmits from its TX queue in the order of CAN ID priority, so the problem does not exist there
+# error "UAVCAN_STM32_TX_PREEMPTION is not applicable to FDCAN"
+#endif
+
+/**
+ * RX interrupt profiling with the DWT cycle counter, see @ref CanIface::getRxIsrProfile().
+ * The application must enable the cycle counter (DEMCR.TRCENA, DWT_CTRL.CYCCNTENA) before the ifaces are started.
+ * This is intended for benchmarking only, because every RX interrupt is slowed down by a few cycles.
+ */
+#ifndef UAVCAN_STM32_RX_ISR_PROFILING
+# define UAVCAN_STM32_RX_ISR_PROFILING 0
+#endif
+
+#if UAVCAN_STM32_RX_ISR_PROFILING && UAVCAN_STM32_FDCAN
+# error "UAVCAN_STM32_RX_ISR_PROFILING is supported for bxCAN only"
+#endif
@@ -7,7 +7,11 @@
 #include <uavcan_stm32/build_config.hpp>
 #include <uavcan_stm32/thread.hpp>
 #include <uavcan/driver/can.hpp>
-#include <uavcan_stm32/bxcan.hpp>
+#if UAVCAN_STM32_FDCAN
+# include <uavcan_stm32/fdcan.hpp>
+#else
+# include <uavcan_stm32/bxcan.hpp>
+#endif
 
 namespace uavcan_stm32
 {
@@ -32,35 +36,66 @@ struct CanRxItem
  */
 class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
 {
+    friend struct uavcan::DriverBinding;
+
+    /**
+     * Single-producer single-consumer lock-free ring buffer.
+     * The producer is the CAN ISR (all CAN IRQs have the same priority, so they never preempt each other),
+     * the consumer is the thread that calls receive(). Each index is modified by one side only, so neither side
+     * needs to disable interrupts.
+     * One slot is always kept free to tell a full queue from an empty one. When the queue is full, the new frame
+     * is dropped, because the producer must not touch the output index.
+     */
     class RxQueue
     {
         CanRxItem* const buf_;
         const uavcan::uint8_t capacity_;
-        uavcan::uint8_t in_;
-        uavcan::uint8_t out_;
-        uavcan::uint8_t len_;
-        uavcan::uint32_t overflow_cnt_;
+        volatile uavcan::uint8_t in_;           ///< Modified by the producer only
+        volatile uavcan::uint8_t out_;          ///< Modified by the consumer only
+        uavcan::uint32_t overflow_cnt_;         ///< Modified by the producer only
 
         void registerOverflow();
 
+        uavcan::uint8_t next(uavcan::uint8_t index) const
+        {
+            return uavcan::uint8_t(((index + 1U) >= capacity_) ? 0U : (index + 1U));
+        }
+
     public:
         RxQueue(CanRxItem* buf, uavcan::uint8_t capacity)
             : buf_(buf)
             , capacity_(capacity)
             , in_(0)
             , out_(0)
-            , len_(0)
             , overflow_cnt_(0)
         { }
 
+        /**
+         * Producer side, ISR context.
+         */
         void push(const uavcan::CanFrame& frame, const uint64_t& utc_usec, uavcan::CanIOFlags flags);
-        void pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags);
 
+        /**
+         * Consumer side, thread context.
+         * @return False if the queue is empty.
+         */
+        bool pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags);
+
+        /**
+         * Must not be called concurrently with push().
+         */
         void reset();
 
-        unsigned getLength() const { return len_; }
+        unsigned getLength() const
+        {
+            const unsigned in = in_;
+            const unsigned out = out_;
+            return (in >= out) ? (in - out) : (in + capacity_ - out);
+        }
 
         uavcan::uint32_t getOverflowCount() const { return overflow_cnt_; }
+
+        bool isAllocated() const { return capacity_ > 0; }
     };
 
     struct Timings
@@ -85,21 +120,35 @@ class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
         bool pending;
         bool loopback;
         bool abort_on_error;
+        bool preempted;         ///< Abort has been requested to free the mailbox for a higher-priority frame
 
         TxItem()
             : pending(false)
             , loopback(false)
             , abort_on_error(false)
+            , preempted(false)
         { }
     };
 
+#if UAVCAN_STM32_FDCAN
+    enum { NumTxMailboxes = fdcan::NumTxBuffers };  ///< FDCAN TX buffers operating in the queue mode
+    enum { NumFilters = 0 };                        ///< No filter elements are allocated in the message RAM
+#else
     enum { NumTxMailboxes = 3 };
     enum { NumFilters = 14 };
 
     static const uavcan::uint32_t TSR_ABRQx[NumTxMailboxes];
+    static const uavcan::uint32_t TSR_RQCPx[NumTxMailboxes];
+    static const uavcan::uint32_t TSR_TXOKx[NumTxMailboxes];
+#endif
 
     RxQueue rx_queue_;
+    RxQueue priority_rx_queue_;                 ///< Frames from the RX FIFO 1, if the priority split is enabled
+#if UAVCAN_STM32_FDCAN
+    fdcan::CanType* const can_;
+#else
     bxcan::CanType* const can_;
+#endif
     uavcan::uint64_t error_cnt_;
     uavcan::uint32_t served_aborts_cnt_;
     BusEvent& update_event_;
@@ -108,6 +157,18 @@ class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
     uavcan::uint8_t peak_tx_mailbox_index_;
     const uavcan::uint8_t self_index_;
     bool had_activity_;
+#if !UAVCAN_STM32_FDCAN
+    uavcan::uint32_t bit_time_nsec_;            ///< Resolution of the hardware SOF timestamps
+#endif
+#if UAVCAN_STM32_TX_PREEMPTION
+    TxItem preempted_tx_;                       ///< Aborted frame waiting to be reloaded, if pending
+    uavcan::uint8_t reserved_tx_mailbox_;       ///< Mailbox being freed for the preempting frame
+    uavcan::uint32_t tx_preemption_cnt_;
+    uavcan::uint32_t futile_tx_preemption_cnt_;
+
+    bool startTxPreemption(const uavcan::CanFrame& frame);
+    void reloadPreemptedTxFrame();
+#endif
 
     int computeTimings(uavcan::uint32_t target_bitrate, Timings& out_timings);
 
@@ -122,9 +183,31 @@ class CanIface : public uavcan::ICanIface, uavcan::Noncopyable
 
     virtual uavcan::uint16_t getNumFilters() const { return NumFilters; }
 
+#if UAVCAN_STM32_FDCAN
+    volatile uavcan::uint32_t* getRxFifo0Element(unsigned index) const;
+    volatile uavcan::uint32_t* getTxBufferElement(unsigned index) const;
+
+    void handleTxInterrupt(uavcan::uint64_t utc_usec);
+    void handleRxInterrupt(uavcan::uint64_t utc_usec);
+    void handleStatusChangeInterrupt();
+
+    bool waitCccrBitStateChange(uavcan::uint32_t bit, bool target_state);
+#else
+    void loadTxMailbox(uavcan::uint8_t mailbox_index, const TxItem& txi);
+
+    /**
+     * Returns the index of a free TX mailbox, or 0xFF if all are busy.
+     */
+    uavcan::uint8_t findFreeTxMailbox(uavcan::uint8_t except_index) const;
+
     void handleTxMailboxInterrupt(uavcan::uint8_t mailbox_index, bool txok, uavcan::uint64_t utc_usec);
 
+    uavcan::uint16_t getTxMailboxSofTime(uavcan::uint8_t mailbox_index) const;
+
+    static uavcan::uint32_t makeFilterRegisterValue(uavcan::uint32_t value, bool extended);
+
     bool waitMsrINakBitStateChange(bool target_state);
+#endif
 
 public:
     enum { MaxRxQueueCapacity = 254 };
@@ -135,9 +218,20 @@ public:
         SilentMode
     };
 
+    /**
+     * The priority RX queue is optional; see @ref configurePriorityRxFilters().
+     */
+#if UAVCAN_STM32_FDCAN
+    CanIface(fdcan::CanType* can, BusEvent& update_event, uavcan::uint8_t self_index,
+             CanRxItem* rx_queue_buffer, uavcan::uint8_t rx_queue_capacity,
+             CanRxItem* priority_rx_queue_buffer = NULL, uavcan::uint8_t priority_rx_queue_capacity = 0)
+#else
     CanIface(bxcan::CanType* can, BusEvent& update_event, uavcan::uint8_t self_index,
-             CanRxItem* rx_queue_buffer, uavcan::uint8_t rx_queue_capacity)
+             CanRxItem* rx_queue_buffer, uavcan::uint8_t rx_queue_capacity,
+             CanRxItem* priority_rx_queue_buffer = NULL, uavcan::uint8_t priority_rx_queue_capacity = 0)
+#endif
         : rx_queue_(rx_queue_buffer, rx_queue_capacity)
+        , priority_rx_queue_(priority_rx_queue_buffer, priority_rx_queue_capacity)
         , can_(can)
         , error_cnt_(0)
         , served_aborts_cnt_(0)
@@ -146,6 +240,14 @@ public:
         , peak_tx_mailbox_index_(0)
         , self_index_(self_index)
         , had_activity_(false)
+#if !UAVCAN_STM32_FDCAN
+        , bit_time_nsec_(0)
+#endif
+#if UAVCAN_STM32_TX_PREEMPTION
+        , reserved_tx_mailbox_(0xFF)
+        , tx_preemption_cnt_(0)
+        , futile_tx_preemption_cnt_(0)
+#endif
     {
         UAVCAN_ASSERT(self_index_ < UAVCAN_STM32_NUM_IFACES);
     }
@@ -159,10 +261,34 @@ public:
      */
     int init(const uavcan::uint32_t bitrate, const OperatingMode mode);
 
+#if UAVCAN_STM32_FDCAN
+    /**
+     * All FDCAN events of the iface are routed to the interrupt line 0, so there is only one handler.
+     */
+    void handleInterrupt(uavcan::uint64_t utc_usec);
+#else
     void handleTxInterrupt(uavcan::uint64_t utc_usec);
     void handleRxInterrupt(uavcan::uint8_t fifo_index, uavcan::uint64_t utc_usec);
     void handleStatusChangeInterrupt();
 
+    /**
+     * Splits the reception into two priority classes, so that under overload the low-priority traffic is shed
+     * first. The frames accepted by these filters are routed into the RX FIFO 1 and then into the priority RX
+     * queue, which receive() drains before the regular one; all other frames go through the RX FIFO 0 into the
+     * regular RX queue, as usual. Thus an overflow of the RX FIFO 0 or of the regular queue does not affect the
+     * critical traffic, e.g. the data type IDs of the control loops.
+     *
+     * The priority RX queue must have been allocated, see @ref CanInitHelper. Must be called after init(), which
+     * resets the filters. Reception is briefly suspended on all ifaces while the filters are being updated.
+     *
+     * @param filter_configs    Filters of the critical traffic; flags @ref uavcan::CanFrame::FlagEFF and
+     *                          @ref uavcan::CanFrame::FlagRTR are supported. Zero filters disable the split.
+     * @param num_configs       At most the number of hardware filters of the iface minus one.
+     * @return                  Negative value on error; non-negative on success.
+     */
+    int configurePriorityRxFilters(const uavcan::CanFilterConfig* filter_configs, uavcan::uint16_t num_configs);
+#endif
+
     void discardTimedOutTxMailboxes(uavcan::MonotonicTime current_time);
 
     bool canAcceptNewTxFrame(const uavcan::CanFrame& frame) const;
@@ -182,13 +308,19 @@ public:
     uavcan::uint32_t getVoluntaryTxAbortCount() const { return served_aborts_cnt_; }
 
     /**
-     * Returns number of frames pending in the RX queue.
+     * Returns number of frames pending in the RX queues.
      * This is intended for debug use only.
      */
     unsigned getRxQueueLength() const;
 
     /**
-     * Returns last hardware error code (LEC field in the register ESR).
+     * Number of frames lost because the priority RX queue was full; these are also included in the error count.
+     * This is an atomic read, it doesn't require a critical section.
+     */
+    uavcan::uint32_t getPriorityRxQueueOverflowCount() const { return priority_rx_queue_.getOverflowCount(); }
+
+    /**
+     * Returns last hardware error code (LEC field in the register ESR, or PSR for FDCAN).
      * The error code will be reset.
      */
     uavcan::uint8_t yieldLastHardwareErrorCode();
@@ -201,10 +333,55 @@ public:
 
     /**
      * Peak number of TX mailboxes used concurrently since initialization.
-     * Range is [1, 3].
-     * Value of 3 suggests that priority inversion could be taking place.
+     * Range is [1, 3], or [1, number of TX buffers] for FDCAN.
+     * Value of 3 suggests that priority inversion could be taking place (bxCAN only).
      */
     uavcan::uint8_t getPeakNumTxMailboxesUsed() const { return peak_tx_mailbox_index_ + 1; }
+
+#if UAVCAN_STM32_TX_PREEMPTION
+    /**
+     * Number of frames that were aborted to let a higher-priority frame through and then reloaded.
+     * This is an atomic read, it doesn't require a critical section.
+     */
+    uavcan::uint32_t getTxPreemptionCount() const { return tx_preemption_cnt_; }
+
+    /**
+     * Number of preemption attempts where the frame managed to get transmitted before the abort took effect.
+     * This is an atomic read, it doesn't require a critical section.
+     */
+    uavcan::uint32_t getFutileTxPreemptionCount() const { return futile_tx_preemption_cnt_; }
+#endif
+
+#if UAVCAN_STM32_RX_ISR_PROFILING
+    /**
+     * Execution time of the RX interrupt handlers of this iface, both FIFOs, in CPU cycles.
+     * The interrupt entry and exit overhead of the core is not included.
+     */
+    struct RxIsrProfile
+    {
+        uavcan::uint64_t total_cycles;
+        uavcan::uint32_t max_cycles;
+        uavcan::uint32_t num_calls;
+
+        RxIsrProfile()
+            : total_cycles(0)
+            , max_cycles(0)
+            , num_calls(0)
+        { }
+
+        void add(uavcan::uint32_t cycles)
+        {
+            total_cycles += cycles;
+            max_cycles = (cycles > max_cycles) ? cycles : max_cycles;
+            num_calls++;
+        }
+    };
+
+    /**
+     * Returns the accumulated profile; see UAVCAN_STM32_RX_ISR_PROFILING.
+     */
+    RxIsrProfile getRxIsrProfile() const;
+#endif
 };
 
 /**
@@ -213,6 +390,8 @@ public:
  */
 class CanDriver : public uavcan::ICanDriver, uavcan::Noncopyable
 {
+    friend struct uavcan::DriverBinding;
+
     BusEvent update_event_;
     CanIface if0_;
 #if UAVCAN_STM32_NUM_IFACES > 1
@@ -224,15 +403,36 @@ class CanDriver : public uavcan::ICanDriver, uavcan::Noncopyable
                                    uavcan::MonotonicTime blocking_deadline);
 
 public:
+    /**
+     * @param priority_rx_queue_storage     Optional storage of the priority RX queues, priority_rx_queue_capacity
+     *                                      items per iface; see @ref CanIface::configurePriorityRxFilters().
+     */
     template <unsigned RxQueueCapacity>
-    CanDriver(CanRxItem (&rx_queue_storage)[UAVCAN_STM32_NUM_IFACES][RxQueueCapacity])
+    CanDriver(CanRxItem (&rx_queue_storage)[UAVCAN_STM32_NUM_IFACES][RxQueueCapacity],
+              CanRxItem* priority_rx_queue_storage = NULL, uavcan::uint8_t priority_rx_queue_capacity = 0)
         : update_event_(*this)
-        , if0_(bxcan::Can[0], update_event_, 0, rx_queue_storage[0], RxQueueCapacity)
-#if UAVCAN_STM32_NUM_IFACES > 1
-        , if1_(bxcan::Can[1], update_event_, 1, rx_queue_storage[1], RxQueueCapacity)
+#if UAVCAN_STM32_FDCAN
+        , if0_(fdcan::Can[0], update_event_, 0, rx_queue_storage[0], RxQueueCapacity,
+               priority_rx_queue_storage, priority_rx_queue_capacity)
+# if UAVCAN_STM32_NUM_IFACES > 1
+        , if1_(fdcan::Can[1], update_event_, 1, rx_queue_storage[1], RxQueueCapacity,
+               (priority_rx_queue_storage == NULL) ? NULL : (priority_rx_queue_storage + priority_rx_queue_capacity),
+               priority_rx_queue_capacity)
+# endif
+#else
+        , if0_(bxcan::Can[0], update_event_, 0, rx_queue_storage[0], RxQueueCapacity,
+               priority_rx_queue_storage, priority_rx_queue_capacity)
+# if UAVCAN_STM32_NUM_IFACES > 1
+        , if1_(bxcan::Can[1], update_event_, 1, rx_queue_storage[1], RxQueueCapacity,
+               (priority_rx_queue_storage == NULL) ? NULL : (priority_rx_queue_storage + priority_rx_queue_capacity),
+               priority_rx_queue_capacity)
+# endif
 #endif
     {
         uavcan::StaticAssert<(RxQueueCapacity <= CanIface::MaxRxQueueCapacity)>::check();
+        uavcan::StaticAssert<(RxQueueCapacity >= 2)>::check();     // One slot is always kept free
+        UAVCAN_ASSERT((priority_rx_queue_storage == NULL) == (priority_rx_queue_capacity == 0));
+        UAVCAN_ASSERT(priority_rx_queue_capacity != 1);
     }
 
     /**
@@ -260,17 +460,55 @@ public:
      * This is designed for use with iface activity LEDs.
      */
     bool hadActivity();
+
+#if UAVCAN_STM32_CHIBIOS
+    /**
+     * Event source that is broadcast upon every bus event, for the applications that wait on their own events
+     * together with CAN. See @ref BusEvent::getEventSource().
+     */
+    chibios_rt::EvtSource& getBusEventSource() { return update_event_.getEventSource(); }
+#endif
+};
+
+/**
+ * Storage of the priority RX queues of all ifaces, see @ref CanInitHelper.
+ * The application shall not use this directly.
+ */
+template <unsigned Capacity>
+class PriorityRxQueueStorage
+{
+    CanRxItem items_[UAVCAN_STM32_NUM_IFACES * Capacity];
+
+public:
+    PriorityRxQueueStorage()
+    {
+        uavcan::StaticAssert<(Capacity <= CanIface::MaxRxQueueCapacity)>::check();
+        uavcan::StaticAssert<(Capacity >= 2)>::check();            // One slot is always kept free
+    }
+
+    CanRxItem* get() { return items_; }
+};
+
+template <>
+class PriorityRxQueueStorage<0>
+{
+public:
+    CanRxItem* get() { return NULL; }
 };
 
 /**
  * Helper class.
  * Normally only this class should be used by the application.
  * 145 usec per Extended CAN frame @ 1 Mbps, e.g. 32 RX slots * 145 usec --> 4.6 msec before RX queue overruns.
+ *
+ * @tparam PriorityRxQueueCapacity      Capacity of the priority RX queue of every iface; zero (default) disables
+ *                                      the feature. See @ref CanIface::configurePriorityRxFilters().
  */
-template <unsigned RxQueueCapacity = 32>
+template <unsigned RxQueueCapacity = 32, unsigned PriorityRxQueueCapacity = 0>
 class CanInitHelper
 {
     CanRxItem queue_storage_[UAVCAN_STM32_NUM_IFACES][RxQueueCapacity];
+    PriorityRxQueueStorage<PriorityRxQueueCapacity> priority_queue_storage_;
 
 public:
     enum { BitRateAutoDetect = 0 };
@@ -278,7 +516,7 @@ public:
     CanDriver driver;
 
     CanInitHelper() :
-        driver(queue_storage_)
+        driver(queue_storage_, priority_queue_storage_.get(), uavcan::uint8_t(PriorityRxQueueCapacity))
     { }
 
     /**
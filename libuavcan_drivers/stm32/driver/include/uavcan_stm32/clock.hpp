@@ -85,6 +85,8 @@ void setUtcSyncParams(const UtcSyncParams& params);
  */
 class SystemClock : public uavcan::ISystemClock, uavcan::Noncopyable
 {
+    friend struct uavcan::DriverBinding;
+
     SystemClock() { }
 
     virtual uavcan::MonotonicTime getMonotonic()     const { return clock::getMonotonic(); }
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ * Register layout and bit definitions are based on the Reference Manuals RM0433 (STM32H7) and RM0440 (STM32G4).
+ */
+
+#pragma once
+
+#include <uavcan_stm32/build_config.hpp>
+
+#include <uavcan/uavcan.hpp>
+#include <stdint.h>
+
+#ifndef UAVCAN_CPP_VERSION
+# error UAVCAN_CPP_VERSION
+#endif
+
+#if UAVCAN_CPP_VERSION < UAVCAN_CPP11
+// #undef'ed at the end of this file
+# define constexpr const
+#endif
+
+namespace uavcan_stm32
+{
+namespace fdcan
+{
+
+struct CanType
+{
+    volatile uint32_t  CREL;                /*!< FDCAN core release register,                Address offset: 0x000 */
+    volatile uint32_t  ENDN;                /*!< FDCAN endian register,                      Address offset: 0x004 */
+    uint32_t           RESERVED0;           /*!< Reserved,                                                  0x008 */
+    volatile uint32_t  DBTP;                /*!< FDCAN data bit timing and prescaler,        Address offset: 0x00C */
+    volatile uint32_t  TEST;                /*!< FDCAN test register,                        Address offset: 0x010 */
+    volatile uint32_t  RWD;                 /*!< FDCAN RAM watchdog register,                Address offset: 0x014 */
+    volatile uint32_t  CCCR;                /*!< FDCAN CC control register,                  Address offset: 0x018 */
+    volatile uint32_t  NBTP;                /*!< FDCAN nominal bit timing and prescaler,     Address offset: 0x01C */
+    volatile uint32_t  TSCC;                /*!< FDCAN timestamp counter configuration,      Address offset: 0x020 */
+    volatile uint32_t  TSCV;                /*!< FDCAN timestamp counter value,              Address offset: 0x024 */
+    volatile uint32_t  TOCC;                /*!< FDCAN timeout counter configuration,        Address offset: 0x028 */
+    volatile uint32_t  TOCV;                /*!< FDCAN timeout counter value,                Address offset: 0x02C */
+    uint32_t           RESERVED1[4];        /*!< Reserved,                                          0x030 - 0x03C */
+    volatile uint32_t  ECR;                 /*!< FDCAN error counter register,               Address offset: 0x040 */
+    volatile uint32_t  PSR;                 /*!< FDCAN protocol status register,             Address offset: 0x044 */
+    volatile uint32_t  TDCR;                /*!< FDCAN transmitter delay compensation,       Address offset: 0x048 */
+    uint32_t           RESERVED2;           /*!< Reserved,                                                  0x04C */
+    volatile uint32_t  IR;                  /*!< FDCAN interrupt register,                   Address offset: 0x050 */
+    volatile uint32_t  IE;                  /*!< FDCAN interrupt enable register,            Address offset: 0x054 */
+    volatile uint32_t  ILS;                 /*!< FDCAN interrupt line select register,       Address offset: 0x058 */
+    volatile uint32_t  ILE;                 /*!< FDCAN interrupt line enable register,       Address offset: 0x05C */
+    uint32_t           RESERVED3[8];        /*!< Reserved,                                          0x060 - 0x07C */
+#if UAVCAN_STM32_FDCAN == 7
+    volatile uint32_t  GFC;                 /*!< FDCAN global filter configuration,          Address offset: 0x080 */
+    volatile uint32_t  SIDFC;               /*!< FDCAN standard ID filter configuration,     Address offset: 0x084 */
+    volatile uint32_t  XIDFC;               /*!< FDCAN extended ID filter configuration,     Address offset: 0x088 */
+    uint32_t           RESERVED4;           /*!< Reserved,                                                  0x08C */
+    volatile uint32_t  XIDAM;               /*!< FDCAN extended ID and mask register,        Address offset: 0x090 */
+    volatile uint32_t  HPMS;                /*!< FDCAN high priority message status,         Address offset: 0x094 */
+    volatile uint32_t  NDAT1;               /*!< FDCAN new data 1 register,                  Address offset: 0x098 */
+    volatile uint32_t  NDAT2;               /*!< FDCAN new data 2 register,                  Address offset: 0x09C */
+    volatile uint32_t  RXF0C;               /*!< FDCAN Rx FIFO 0 configuration,              Address offset: 0x0A0 */
+    volatile uint32_t  RXF0S;               /*!< FDCAN Rx FIFO 0 status,                     Address offset: 0x0A4 */
+    volatile uint32_t  RXF0A;               /*!< FDCAN Rx FIFO 0 acknowledge,                Address offset: 0x0A8 */
+    volatile uint32_t  RXBC;                /*!< FDCAN Rx buffer configuration,              Address offset: 0x0AC */
+    volatile uint32_t  RXF1C;               /*!< FDCAN Rx FIFO 1 configuration,              Address offset: 0x0B0 */
+    volatile uint32_t  RXF1S;               /*!< FDCAN Rx FIFO 1 status,                     Address offset: 0x0B4 */
+    volatile uint32_t  RXF1A;               /*!< FDCAN Rx FIFO 1 acknowledge,                Address offset: 0x0B8 */
+    volatile uint32_t  RXESC;               /*!< FDCAN Rx buffer/FIFO element size config,   Address offset: 0x0BC */
+    volatile uint32_t  TXBC;                /*!< FDCAN Tx buffer configuration,              Address offset: 0x0C0 */
+    volatile uint32_t  TXFQS;               /*!< FDCAN Tx FIFO/queue status,                 Address offset: 0x0C4 */
+    volatile uint32_t  TXESC;               /*!< FDCAN Tx buffer element size config,        Address offset: 0x0C8 */
+    volatile uint32_t  TXBRP;               /*!< FDCAN Tx buffer request pending,            Address offset: 0x0CC */
+    volatile uint32_t  TXBAR;               /*!< FDCAN Tx buffer add request,                Address offset: 0x0D0 */
+    volatile uint32_t  TXBCR;               /*!< FDCAN Tx buffer cancellation request,       Address offset: 0x0D4 */
+    volatile uint32_t  TXBTO;               /*!< FDCAN Tx buffer transmission occurred,      Address offset: 0x0D8 */
+    volatile uint32_t  TXBCF;               /*!< FDCAN Tx buffer cancellation finished,      Address offset: 0x0DC */
+    volatile uint32_t  TXBTIE;              /*!< FDCAN Tx buffer transmission IRQ enable,    Address offset: 0x0E0 */
+    volatile uint32_t  TXBCIE;              /*!< FDCAN Tx buffer cancellation IRQ enable,    Address offset: 0x0E4 */
+    uint32_t           RESERVED5[2];        /*!< Reserved,                                          0x0E8 - 0x0EC */
+    volatile uint32_t  TXEFC;               /*!< FDCAN Tx event FIFO configuration,          Address offset: 0x0F0 */
+    volatile uint32_t  TXEFS;               /*!< FDCAN Tx event FIFO status,                 Address offset: 0x0F4 */
+    volatile uint32_t  TXEFA;               /*!< FDCAN Tx event FIFO acknowledge,            Address offset: 0x0F8 */
+#elif UAVCAN_STM32_FDCAN == 4
+    volatile uint32_t  RXGFC;               /*!< FDCAN global filter configuration,          Address offset: 0x080 */
+    volatile uint32_t  XIDAM;               /*!< FDCAN extended ID and mask register,        Address offset: 0x084 */
+    volatile uint32_t  HPMS;                /*!< FDCAN high priority message status,         Address offset: 0x088 */
+    uint32_t           RESERVED4;           /*!< Reserved,                                                  0x08C */
+    volatile uint32_t  RXF0S;               /*!< FDCAN Rx FIFO 0 status,                     Address offset: 0x090 */
+    volatile uint32_t  RXF0A;               /*!< FDCAN Rx FIFO 0 acknowledge,                Address offset: 0x094 */
+    volatile uint32_t  RXF1S;               /*!< FDCAN Rx FIFO 1 status,                     Address offset: 0x098 */
+    volatile uint32_t  RXF1A;               /*!< FDCAN Rx FIFO 1 acknowledge,                Address offset: 0x09C */
+    uint32_t           RESERVED5[8];        /*!< Reserved,                                          0x0A0 - 0x0BC */
+    volatile uint32_t  TXBC;                /*!< FDCAN Tx buffer configuration,              Address offset: 0x0C0 */
+    volatile uint32_t  TXFQS;               /*!< FDCAN Tx FIFO/queue status,                 Address offset: 0x0C4 */
+    volatile uint32_t  TXBRP;               /*!< FDCAN Tx buffer request pending,            Address offset: 0x0C8 */
+    volatile uint32_t  TXBAR;               /*!< FDCAN Tx buffer add request,                Address offset: 0x0CC */
+    volatile uint32_t  TXBCR;               /*!< FDCAN Tx buffer cancellation request,       Address offset: 0x0D0 */
+    volatile uint32_t  TXBTO;               /*!< FDCAN Tx buffer transmission occurred,      Address offset: 0x0D4 */
+    volatile uint32_t  TXBCF;               /*!< FDCAN Tx buffer cancellation finished,      Address offset: 0x0D8 */
+    volatile uint32_t  TXBTIE;              /*!< FDCAN Tx buffer transmission IRQ enable,    Address offset: 0x0DC */
+    volatile uint32_t  TXBCIE;              /*!< FDCAN Tx buffer cancellation IRQ enable,    Address offset: 0x0E0 */
+    volatile uint32_t  TXEFS;               /*!< FDCAN Tx event FIFO status,                 Address offset: 0x0E4 */
+    volatile uint32_t  TXEFA;               /*!< FDCAN Tx event FIFO acknowledge,            Address offset: 0x0E8 */
+#else
+# error "Unsupported FDCAN variant"
+#endif
+};
+
+/**
+ * FDCANx register sets and the message RAM.
+ *
+ * The message RAM of STM32G4 has a fixed layout: each FDCAN instance owns a block with 3 RX elements per FIFO and
+ * 3 TX buffers, all sized for 64 data bytes. The message RAM of STM32H7 is shared between the instances and is
+ * partitioned by the driver. With classic CAN, each iface gets an RX FIFO 0 of 64 elements and a TX queue of
+ * 32 buffers, sized for 8 data bytes. With CAN FD (UAVCAN_SUPPORT_CANFD), the elements are sized for 64 data bytes,
+ * so the FIFO and the queue are halved to fit two ifaces into the 10 KB of the message RAM.
+ */
+#if UAVCAN_STM32_FDCAN == 7
+
+CanType* const Can[UAVCAN_STM32_NUM_IFACES] =
+{
+    reinterpret_cast<CanType*>(0x4000A000)
+#if UAVCAN_STM32_NUM_IFACES > 1
+    ,
+    reinterpret_cast<CanType*>(0x4000A400)
+#endif
+};
+
+constexpr unsigned long MessageRamBase =           0x4000AC00U;
+# if UAVCAN_SUPPORT_CANFD
+constexpr unsigned long MessageRamSizePerIface =   0xD80U;   /* Bytes; 10 KB are available in total */
+constexpr unsigned long RxFifo0Offset =            0x000U;   /* Bytes, relative to the iface's block */
+constexpr unsigned long TxBufferOffset =           0x900U;
+constexpr unsigned long ElementSizeWords =         18U;      /* 2 header words and 64 data bytes */
+constexpr unsigned long ElementSizeCode =          7U;       /* For RXESC and TXESC, 64 data bytes */
+
+constexpr unsigned NumRxFifo0Elements =            32U;
+constexpr unsigned NumTxBuffers =                  16U;
+# else
+constexpr unsigned long MessageRamSizePerIface =   0x600U;   /* Bytes; 10 KB are available in total */
+constexpr unsigned long RxFifo0Offset =            0x000U;   /* Bytes, relative to the iface's block */
+constexpr unsigned long TxBufferOffset =           0x400U;
+constexpr unsigned long ElementSizeWords =         4U;       /* 2 header words and 8 data bytes */
+constexpr unsigned long ElementSizeCode =          0U;       /* For RXESC and TXESC, 8 data bytes */
+
+constexpr unsigned NumRxFifo0Elements =            64U;
+constexpr unsigned NumTxBuffers =                  32U;
+# endif
+
+#elif UAVCAN_STM32_FDCAN == 4
+
+CanType* const Can[UAVCAN_STM32_NUM_IFACES] =
+{
+    reinterpret_cast<CanType*>(0x40006400)
+#if UAVCAN_STM32_NUM_IFACES > 1
+    ,
+    reinterpret_cast<CanType*>(0x40006800)
+#endif
+};
+
+constexpr unsigned long MessageRamBase =           0x4000A400U;
+constexpr unsigned long MessageRamSizePerIface =   0x350U;
+constexpr unsigned long RxFifo0Offset =            0x0B0U;
+constexpr unsigned long TxBufferOffset =           0x278U;
+constexpr unsigned long ElementSizeWords =         18U;      /* Fixed, sized for 64 data bytes */
+
+constexpr unsigned NumRxFifo0Elements =            3U;
+constexpr unsigned NumTxBuffers =                  3U;
+
+#endif
+
+/* CC control register */
+
+constexpr unsigned long CCCR_INIT =           (1U << 0); /* Bit 0: Initialization */
+constexpr unsigned long CCCR_CCE =            (1U << 1); /* Bit 1: Configuration Change Enable */
+constexpr unsigned long CCCR_ASM =            (1U << 2); /* Bit 2: Restricted Operation Mode */
+constexpr unsigned long CCCR_CSA =            (1U << 3); /* Bit 3: Clock Stop Acknowledge */
+constexpr unsigned long CCCR_CSR =            (1U << 4); /* Bit 4: Clock Stop Request */
+constexpr unsigned long CCCR_MON =            (1U << 5); /* Bit 5: Bus Monitoring Mode */
+constexpr unsigned long CCCR_DAR =            (1U << 6); /* Bit 6: Disable Automatic Retransmission */
+constexpr unsigned long CCCR_TEST =           (1U << 7); /* Bit 7: Test Mode Enable */
+constexpr unsigned long CCCR_FDOE =           (1U << 8); /* Bit 8: FD Operation Enable */
+constexpr unsigned long CCCR_BRSE =           (1U << 9); /* Bit 9: Bit Rate Switch Enable */
+constexpr unsigned long CCCR_PXHD =           (1U << 12);/* Bit 12: Protocol Exception Handling Disable */
+constexpr unsigned long CCCR_EFBI =           (1U << 13);/* Bit 13: Edge Filtering during Bus Integration */
+constexpr unsigned long CCCR_TXP =            (1U << 14);/* Bit 14: Transmit Pause */
+constexpr unsigned long CCCR_NISO =           (1U << 15);/* Bit 15: Non ISO Operation */
+
+/* Nominal bit timing and prescaler register */
+
+constexpr unsigned long NBTP_NTSEG2_SHIFT =   (0U);      /* Bits 6-0: Nominal Time Segment After Sample Point */
+constexpr unsigned long NBTP_NTSEG2_MASK =    (0x7FU << NBTP_NTSEG2_SHIFT);
+constexpr unsigned long NBTP_NTSEG1_SHIFT =   (8U);      /* Bits 15-8: Nominal Time Segment Before Sample Point */
+constexpr unsigned long NBTP_NTSEG1_MASK =    (0xFFU << NBTP_NTSEG1_SHIFT);
+constexpr unsigned long NBTP_NBRP_SHIFT =     (16U);     /* Bits 24-16: Nominal Bit Rate Prescaler */
+constexpr unsigned long NBTP_NBRP_MASK =      (0x1FFU << NBTP_NBRP_SHIFT);
+constexpr unsigned long NBTP_NSJW_SHIFT =     (25U);     /* Bits 31-25: Nominal Resynchronization Jump Width */
+constexpr unsigned long NBTP_NSJW_MASK =      (0x7FU << NBTP_NSJW_SHIFT);
+
+/* Data bit timing and prescaler register */
+
+constexpr unsigned long DBTP_DSJW_SHIFT =     (0U);      /* Bits 3-0: Data Resynchronization Jump Width */
+constexpr unsigned long DBTP_DSJW_MASK =      (0x0FU << DBTP_DSJW_SHIFT);
+constexpr unsigned long DBTP_DTSEG2_SHIFT =   (4U);      /* Bits 7-4: Data Time Segment After Sample Point */
+constexpr unsigned long DBTP_DTSEG2_MASK =    (0x0FU << DBTP_DTSEG2_SHIFT);
+constexpr unsigned long DBTP_DTSEG1_SHIFT =   (8U);      /* Bits 12-8: Data Time Segment Before Sample Point */
+constexpr unsigned long DBTP_DTSEG1_MASK =    (0x1FU << DBTP_DTSEG1_SHIFT);
+constexpr unsigned long DBTP_DBRP_SHIFT =     (16U);     /* Bits 20-16: Data Bit Rate Prescaler */
+constexpr unsigned long DBTP_DBRP_MASK =      (0x1FU << DBTP_DBRP_SHIFT);
+constexpr unsigned long DBTP_TDC =            (1U << 23);/* Bit 23: Transceiver Delay Compensation */
+
+/* Transmitter delay compensation register */
+
+constexpr unsigned long TDCR_TDCF_SHIFT =     (0U);      /* Bits 6-0: Transmitter Delay Compensation Filter Window */
+constexpr unsigned long TDCR_TDCF_MASK =      (0x7FU << TDCR_TDCF_SHIFT);
+constexpr unsigned long TDCR_TDCO_SHIFT =     (8U);      /* Bits 14-8: Transmitter Delay Compensation Offset */
+constexpr unsigned long TDCR_TDCO_MASK =      (0x7FU << TDCR_TDCO_SHIFT);
+
+/* Protocol status register */
+
+constexpr unsigned long PSR_LEC_SHIFT =       (0U);      /* Bits 2-0: Last Error Code */
+constexpr unsigned long PSR_LEC_MASK =        (7U << PSR_LEC_SHIFT);
+constexpr unsigned long PSR_LEC_NO_CHANGE =   (7U);      /* Set by hardware on read */
+constexpr unsigned long PSR_ACT_SHIFT =       (3U);      /* Bits 4-3: Activity */
+constexpr unsigned long PSR_ACT_MASK =        (3U << PSR_ACT_SHIFT);
+constexpr unsigned long PSR_EP =              (1U << 5); /* Bit 5: Error Passive */
+constexpr unsigned long PSR_EW =              (1U << 6); /* Bit 6: Warning Status */
+constexpr unsigned long PSR_BO =              (1U << 7); /* Bit 7: Bus Off Status */
+
+/* Interrupt register, interrupt enable register */
+
+#if UAVCAN_STM32_FDCAN == 7
+constexpr unsigned long IR_RF0N =             (1U << 0); /* Bit 0: Rx FIFO 0 New Message */
+constexpr unsigned long IR_RF0F =             (1U << 2); /* Bit 2: Rx FIFO 0 Full */
+constexpr unsigned long IR_RF0L =             (1U << 3); /* Bit 3: Rx FIFO 0 Message Lost */
+constexpr unsigned long IR_TC =               (1U << 9); /* Bit 9: Transmission Completed */
+constexpr unsigned long IR_TCF =              (1U << 10);/* Bit 10: Transmission Cancellation Finished */
+constexpr unsigned long IR_ELO =              (1U << 22);/* Bit 22: Error Logging Overflow */
+constexpr unsigned long IR_EP =               (1U << 23);/* Bit 23: Error Passive */
+constexpr unsigned long IR_EW =               (1U << 24);/* Bit 24: Warning Status */
+constexpr unsigned long IR_BO =               (1U << 25);/* Bit 25: Bus Off Status */
+constexpr unsigned long IR_PEA =              (1U << 27);/* Bit 27: Protocol Error in Arbitration Phase */
+constexpr unsigned long IR_PED =              (1U << 28);/* Bit 28: Protocol Error in Data Phase */
+#elif UAVCAN_STM32_FDCAN == 4
+constexpr unsigned long IR_RF0N =             (1U << 0); /* Bit 0: Rx FIFO 0 New Message */
+constexpr unsigned long IR_RF0F =             (1U << 1); /* Bit 1: Rx FIFO 0 Full */
+constexpr unsigned long IR_RF0L =             (1U << 2); /* Bit 2: Rx FIFO 0 Message Lost */
+constexpr unsigned long IR_TC =               (1U << 7); /* Bit 7: Transmission Completed */
+constexpr unsigned long IR_TCF =              (1U << 8); /* Bit 8: Transmission Cancellation Finished */
+constexpr unsigned long IR_ELO =              (1U << 16);/* Bit 16: Error Logging Overflow */
+constexpr unsigned long IR_EP =               (1U << 17);/* Bit 17: Error Passive */
+constexpr unsigned long IR_EW =               (1U << 18);/* Bit 18: Warning Status */
+constexpr unsigned long IR_BO =               (1U << 19);/* Bit 19: Bus Off Status */
+constexpr unsigned long IR_PEA =              (1U << 21);/* Bit 21: Protocol Error in Arbitration Phase */
+constexpr unsigned long IR_PED =              (1U << 22);/* Bit 22: Protocol Error in Data Phase */
+#endif
+
+/* Interrupt line enable register */
+
+constexpr unsigned long ILE_EINT0 =           (1U << 0); /* Bit 0: Enable Interrupt Line 0 */
+constexpr unsigned long ILE_EINT1 =           (1U << 1); /* Bit 1: Enable Interrupt Line 1 */
+
+/* Rx FIFO 0 configuration register (STM32H7) */
+
+constexpr unsigned long RXF0C_F0SA_SHIFT =    (0U);      /* Bits 15-2: Start Address, in bytes */
+constexpr unsigned long RXF0C_F0SA_MASK =     (0xFFFCU << RXF0C_F0SA_SHIFT);
+constexpr unsigned long RXF0C_F0S_SHIFT =     (16U);     /* Bits 22-16: FIFO Size */
+constexpr unsigned long RXF0C_F0S_MASK =      (0x7FU << RXF0C_F0S_SHIFT);
+constexpr unsigned long RXF0C_F0OM =          (1U << 31);/* Bit 31: FIFO Operation Mode */
+
+/* Rx and Tx buffer element size configuration registers (STM32H7) */
+
+constexpr unsigned long RXESC_F0DS_SHIFT =    (0U);      /* Bits 2-0: Rx FIFO 0 Data Field Size */
+constexpr unsigned long TXESC_TBDS_SHIFT =    (0U);      /* Bits 2-0: Tx Buffer Data Field Size */
+
+/* Rx FIFO 0 status register */
+
+constexpr unsigned long RXF0S_F0FL_SHIFT =    (0U);      /* Bits 6-0: Fill Level */
+constexpr unsigned long RXF0S_F0FL_MASK =     (0x7FU << RXF0S_F0FL_SHIFT);
+constexpr unsigned long RXF0S_F0GI_SHIFT =    (8U);      /* Bits 13-8: Get Index */
+constexpr unsigned long RXF0S_F0GI_MASK =     (0x3FU << RXF0S_F0GI_SHIFT);
+constexpr unsigned long RXF0S_F0PI_SHIFT =    (16U);     /* Bits 21-16: Put Index */
+constexpr unsigned long RXF0S_F0PI_MASK =     (0x3FU << RXF0S_F0PI_SHIFT);
+constexpr unsigned long RXF0S_F0F =           (1U << 24);/* Bit 24: FIFO Full */
+constexpr unsigned long RXF0S_RF0L =          (1U << 25);/* Bit 25: Message Lost */
+
+/* Tx buffer configuration register */
+
+constexpr unsigned long TXBC_TBSA_SHIFT =     (0U);      /* Bits 15-2: Start Address, in bytes (STM32H7) */
+constexpr unsigned long TXBC_TBSA_MASK =      (0xFFFCU << TXBC_TBSA_SHIFT);
+constexpr unsigned long TXBC_NDTB_SHIFT =     (16U);     /* Bits 21-16: Number of Dedicated Buffers (STM32H7) */
+constexpr unsigned long TXBC_NDTB_MASK =      (0x3FU << TXBC_NDTB_SHIFT);
+constexpr unsigned long TXBC_TFQS_SHIFT =     (24U);     /* Bits 29-24: FIFO/Queue Size (STM32H7) */
+constexpr unsigned long TXBC_TFQS_MASK =      (0x3FU << TXBC_TFQS_SHIFT);
+#if UAVCAN_STM32_FDCAN == 7
+constexpr unsigned long TXBC_TFQM =           (1U << 30);/* Bit 30: Tx FIFO/Queue Mode */
+#elif UAVCAN_STM32_FDCAN == 4
+constexpr unsigned long TXBC_TFQM =           (1U << 24);/* Bit 24: Tx FIFO/Queue Mode */
+#endif
+
+/* Tx FIFO/queue status register */
+
+constexpr unsigned long TXFQS_TFFL_SHIFT =    (0U);      /* Bits 5-0: FIFO Free Level */
+constexpr unsigned long TXFQS_TFFL_MASK =     (0x3FU << TXFQS_TFFL_SHIFT);
+constexpr unsigned long TXFQS_TFGI_SHIFT =    (8U);      /* Bits 12-8: Get Index */
+constexpr unsigned long TXFQS_TFGI_MASK =     (0x1FU << TXFQS_TFGI_SHIFT);
+constexpr unsigned long TXFQS_TFQPI_SHIFT =   (16U);     /* Bits 20-16: Put Index */
+constexpr unsigned long TXFQS_TFQPI_MASK =    (0x1FU << TXFQS_TFQPI_SHIFT);
+constexpr unsigned long TXFQS_TFQF =          (1U << 21);/* Bit 21: FIFO/Queue Full */
+
+/* Rx and Tx buffer element header, word 0 */
+
+constexpr unsigned long E0_ESI =              (1U << 31);/* Bit 31: Error State Indicator */
+constexpr unsigned long E0_XTD =              (1U << 30);/* Bit 30: Extended Identifier */
+constexpr unsigned long E0_RTR =              (1U << 29);/* Bit 29: Remote Transmission Request */
+constexpr unsigned long E0_EXID_SHIFT =       (0U);      /* Bits 28-0: Extended Identifier */
+constexpr unsigned long E0_EXID_MASK =        (0x1FFFFFFFU << E0_EXID_SHIFT);
+constexpr unsigned long E0_STID_SHIFT =       (18U);     /* Bits 28-18: Standard Identifier */
+constexpr unsigned long E0_STID_MASK =        (0x07FFU << E0_STID_SHIFT);
+
+/* Rx and Tx buffer element header, word 1 */
+
+constexpr unsigned long E1_DLC_SHIFT =        (16U);     /* Bits 19-16: Data Length Code */
+constexpr unsigned long E1_DLC_MASK =         (0x0FU << E1_DLC_SHIFT);
+constexpr unsigned long E1_BRS =              (1U << 20);/* Bit 20: Bit Rate Switch */
+constexpr unsigned long E1_FDF =              (1U << 21);/* Bit 21: FD Format */
+constexpr unsigned long E1_EFC =              (1U << 23);/* Bit 23: Event FIFO Control (Tx only) */
+
+}
+}
+
+#if UAVCAN_CPP_VERSION < UAVCAN_CPP11
+# undef constexpr
+#endif
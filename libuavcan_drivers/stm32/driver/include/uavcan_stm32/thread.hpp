@@ -29,11 +29,21 @@ class CanDriver;
 
 #if UAVCAN_STM32_CHIBIOS
 
+/**
+ * Besides the semaphore that is used by select(), every bus event is broadcast via a ChibiOS event source,
+ * so that a task can wait for the CAN events together with its own events; see @ref getEventSource().
+ */
 class BusEvent
 {
     chibios_rt::CounterSemaphore sem_;
+    chibios_rt::EvtSource event_source_;
 
 public:
+    /**
+     * Flags broadcast with every bus event.
+     */
+    static const flagsmask_t EventFlags = 1;
+
     BusEvent(CanDriver& can_driver)
         : sem_(0)
     {
@@ -45,6 +55,20 @@ public:
     void signal();
 
     void signalFromInterrupt();
+
+    /**
+     * The application can register its listener with any event mask on this source, e.g.:
+     *     chibios_rt::EvtListener listener;
+     *     can.driver.getBusEventSource().registerMask(&listener, CanEventMask);
+     *     while (true) {
+     *         const eventmask_t events = chibios_rt::BaseThread::waitAnyEvent(CanEventMask | OtherEventMask);
+     *         if (events & CanEventMask) { node.spinOnce(); }
+     *         ...
+     *     }
+     * Keep in mind that the deadline handlers of the node need to be serviced too, so the wait must be limited
+     * with the earliest deadline of the scheduler, or the application must call spinOnce() periodically.
+     */
+    chibios_rt::EvtSource& getEventSource() { return event_source_; }
 };
 
 class Mutex
@@ -60,6 +84,8 @@ public:
 
 /**
  * All bus events are reported as POLLIN.
+ * The application can poll() the device @ref DevName together with its own file descriptors, so that a single
+ * task can service CAN and other I/O without polling the driver.
  */
 class BusEvent : uavcan::Noncopyable
 {
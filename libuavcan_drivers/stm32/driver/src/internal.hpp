@@ -54,6 +54,19 @@
 # endif
 #endif
 
+#if UAVCAN_STM32_FDCAN
+/**
+ * FDCAN kernel clock frequency in Hz, this is the input of the bit rate prescaler.
+ */
+# ifndef UAVCAN_STM32_FDCAN_KERNEL_CLOCK
+#  if UAVCAN_STM32_CHIBIOS
+#   define UAVCAN_STM32_FDCAN_KERNEL_CLOCK  STM32_FDCANCLK
+#  else
+#   error "UAVCAN_STM32_FDCAN_KERNEL_CLOCK must be defined"
+#  endif
+# endif
+#endif
+
 /**
  * Glue macros
  */
@@ -18,6 +18,8 @@
 # error "Unknown OS"
 #endif
 
+#if !UAVCAN_STM32_FDCAN    // See uc_stm32_fdcan.cpp
+
 #if !UAVCAN_STM32_NUTTX
 # if !(defined(STM32F10X_CL) || defined(STM32F2XX) || defined(STM32F4XX))
 // IRQ numbers
@@ -45,11 +47,15 @@ static int can2_irq(const int irq, void*);
 }
 #endif
 
+#endif // !UAVCAN_STM32_FDCAN
+
 namespace uavcan_stm32
 {
 namespace
 {
 
+#if !UAVCAN_STM32_FDCAN
+
 CanIface* ifaces[UAVCAN_STM32_NUM_IFACES] =
 {
     NULL
@@ -58,6 +64,15 @@ CanIface* ifaces[UAVCAN_STM32_NUM_IFACES] =
 #endif
 };
 
+#if UAVCAN_STM32_RX_ISR_PROFILING
+CanIface::RxIsrProfile rx_isr_profiles[UAVCAN_STM32_NUM_IFACES];
+
+inline uavcan::uint32_t readCycleCounter()
+{
+    return *reinterpret_cast<volatile uavcan::uint32_t*>(0xE0001004U);    // DWT_CYCCNT
+}
+#endif
+
 inline void handleTxInterrupt(uavcan::uint8_t iface_index)
 {
     UAVCAN_ASSERT(iface_index < UAVCAN_STM32_NUM_IFACES);
@@ -79,6 +94,9 @@ inline void handleTxInterrupt(uavcan::uint8_t iface_index)
 inline void handleRxInterrupt(uavcan::uint8_t iface_index, uavcan::uint8_t fifo_index)
 {
     UAVCAN_ASSERT(iface_index < UAVCAN_STM32_NUM_IFACES);
+#if UAVCAN_STM32_RX_ISR_PROFILING
+    const uavcan::uint32_t started_at = readCycleCounter();
+#endif
     uavcan::uint64_t utc_usec = clock::getUtcUSecFromCanInterrupt();
     if (utc_usec > 0)
     {
@@ -92,6 +110,9 @@ inline void handleRxInterrupt(uavcan::uint8_t iface_index, uavcan::uint8_t fifo_
     {
         UAVCAN_ASSERT(0);
     }
+#if UAVCAN_STM32_RX_ISR_PROFILING
+    rx_isr_profiles[iface_index].add(readCycleCounter() - started_at);
+#endif
 }
 
 inline void handleStatusChangeInterrupt(uavcan::uint8_t iface_index)
@@ -107,6 +128,17 @@ inline void handleStatusChangeInterrupt(uavcan::uint8_t iface_index)
     }
 }
 
+#endif // !UAVCAN_STM32_FDCAN
+
+/**
+ * Prevents the compiler from moving memory accesses across this point.
+ * This is enough to order the RX queue accesses, since the ISR and the thread run on the same core.
+ */
+inline void compilerMemoryBarrier()
+{
+    __asm__ __volatile__ ("" ::: "memory");
+}
+
 } // namespace
 
 /*
@@ -122,55 +154,47 @@ void CanIface::RxQueue::registerOverflow()
 
 void CanIface::RxQueue::push(const uavcan::CanFrame& frame, const uint64_t& utc_usec, uavcan::CanIOFlags flags)
 {
-    buf_[in_].frame    = frame;
-    buf_[in_].utc_usec = utc_usec;
-    buf_[in_].flags    = flags;
-    in_++;
-    if (in_ >= capacity_)
-    {
-        in_ = 0;
-    }
-    len_++;
-    if (len_ > capacity_)
+    const uavcan::uint8_t in = in_;
+    const uavcan::uint8_t new_in = next(in);
+    if (new_in == out_)
     {
-        len_ = capacity_;
         registerOverflow();
-        out_++;
-        if (out_ >= capacity_)
-        {
-            out_ = 0;
-        }
+        return;
     }
+    buf_[in].frame    = frame;
+    buf_[in].utc_usec = utc_usec;
+    buf_[in].flags    = flags;
+    compilerMemoryBarrier();    // The item must be complete before the consumer can see it
+    in_ = new_in;
 }
 
-void CanIface::RxQueue::pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags)
+bool CanIface::RxQueue::pop(uavcan::CanFrame& out_frame, uavcan::uint64_t& out_utc_usec, uavcan::CanIOFlags& out_flags)
 {
-    if (len_ > 0)
-    {
-        out_frame    = buf_[out_].frame;
-        out_utc_usec = buf_[out_].utc_usec;
-        out_flags    = buf_[out_].flags;
-        out_++;
-        if (out_ >= capacity_)
-        {
-            out_ = 0;
-        }
-        len_--;
-    }
-    else { UAVCAN_ASSERT(0); }
+    const uavcan::uint8_t out = out_;
+    if (out == in_)
+    {
+        return false;
+    }
+    compilerMemoryBarrier();    // The item must not be read before the index
+    out_frame    = buf_[out].frame;
+    out_utc_usec = buf_[out].utc_usec;
+    out_flags    = buf_[out].flags;
+    compilerMemoryBarrier();    // The item must be read out before it's released to the producer
+    out_ = next(out);
+    return true;
 }
 
 void CanIface::RxQueue::reset()
 {
     in_ = 0;
     out_ = 0;
-    len_ = 0;
     overflow_cnt_ = 0;
 }
 
 /*
  * CanIface
  */
+#if !UAVCAN_STM32_FDCAN
 const uavcan::uint32_t CanIface::TSR_ABRQx[CanIface::NumTxMailboxes] =
 {
     bxcan::TSR_ABRQ0,
@@ -178,6 +202,21 @@ const uavcan::uint32_t CanIface::TSR_ABRQx[CanIface::NumTxMailboxes] =
     bxcan::TSR_ABRQ2
 };
 
+const uavcan::uint32_t CanIface::TSR_RQCPx[CanIface::NumTxMailboxes] =
+{
+    bxcan::TSR_RQCP0,
+    bxcan::TSR_RQCP1,
+    bxcan::TSR_RQCP2
+};
+
+const uavcan::uint32_t CanIface::TSR_TXOKx[CanIface::NumTxMailboxes] =
+{
+    bxcan::TSR_TXOK0,
+    bxcan::TSR_TXOK1,
+    bxcan::TSR_TXOK2
+};
+#endif
+
 int CanIface::computeTimings(const uavcan::uint32_t target_bitrate, Timings& out_timings)
 {
     if (target_bitrate < 1)
@@ -188,16 +227,25 @@ int CanIface::computeTimings(const uavcan::uint32_t target_bitrate, Timings& out
     /*
      * Hardware configuration
      */
-#if UAVCAN_STM32_CHIBIOS
+#if UAVCAN_STM32_FDCAN
+    const uavcan::uint32_t pclk = UAVCAN_STM32_FDCAN_KERNEL_CLOCK;
+
+    static const int MaxBS1 = 256;
+    static const int MaxBS2 = 128;
+    static const uavcan::uint32_t MaxPrescaler = 512;
+#else
+# if UAVCAN_STM32_CHIBIOS
     const uavcan::uint32_t pclk = STM32_PCLK1;
-#elif UAVCAN_STM32_NUTTX
+# elif UAVCAN_STM32_NUTTX
     const uavcan::uint32_t pclk = STM32_PCLK1_FREQUENCY;
-#else
-# error "Unknown OS"
-#endif
+# else
+#  error "Unknown OS"
+# endif
 
     static const int MaxBS1 = 16;
     static const int MaxBS2 = 8;
+    static const uavcan::uint32_t MaxPrescaler = 1024;
+#endif
 
     /*
      * Ref. "Automatic Baudrate Detection in CANopen Networks", U. Koppe, MicroControl GmbH & Co. KG
@@ -243,7 +291,7 @@ int CanIface::computeTimings(const uavcan::uint32_t target_bitrate, Timings& out
     }
 
     const uavcan::uint32_t prescaler = prescaler_bs / (1 + bs1_bs2_sum);
-    if ((prescaler < 1U) || (prescaler > 1024U))
+    if ((prescaler < 1U) || (prescaler > MaxPrescaler))
     {
         return -1;              // No solution
     }
@@ -315,10 +363,12 @@ int CanIface::computeTimings(const uavcan::uint32_t target_bitrate, Timings& out
     return 0;
 }
 
+#if !UAVCAN_STM32_FDCAN
+
 uavcan::int16_t CanIface::send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
                                uavcan::CanIOFlags flags)
 {
-    if (frame.isErrorFrame() || frame.dlc > 8)
+    if (frame.isErrorFrame() || frame.dlc > 8 || frame.isCanFD())     // bxCAN can't transmit CAN FD frames
     {
         return -1;  // WTF man how to handle that
     }
@@ -343,30 +393,62 @@ uavcan::int16_t CanIface::send(const uavcan::CanFrame& frame, uavcan::MonotonicT
     /*
      * Seeking for an empty slot
      */
-    uavcan::uint8_t txmailbox = 0xFF;
-    if ((can_->TSR & bxcan::TSR_TME0) == bxcan::TSR_TME0)
+    const uavcan::uint8_t txmailbox = findFreeTxMailbox(0xFF);
+    if (txmailbox == 0xFF)
     {
-        txmailbox = 0;
-    }
-    else if ((can_->TSR & bxcan::TSR_TME1) == bxcan::TSR_TME1)
-    {
-        txmailbox = 1;
+#if UAVCAN_STM32_TX_PREEMPTION
+        (void)startTxPreemption(frame);     // The library will retry when the mailbox is freed
+#endif
+        return 0;       // No transmission for you.
     }
-    else if ((can_->TSR & bxcan::TSR_TME2) == bxcan::TSR_TME2)
+
+    peak_tx_mailbox_index_ = uavcan::max(peak_tx_mailbox_index_, txmailbox);    // Statistics
+
+    /*
+     * Registering the pending transmission so we can track its deadline and loopback it as needed
+     */
+    TxItem txi;
+    txi.deadline       = tx_deadline;
+    txi.frame          = frame;
+    txi.loopback       = (flags & uavcan::CanIOFlagLoopback) != 0;
+    txi.abort_on_error = (flags & uavcan::CanIOFlagAbortOnError) != 0;
+    loadTxMailbox(txmailbox, txi);
+
+#if UAVCAN_STM32_TX_PREEMPTION
+    reserved_tx_mailbox_ = 0xFF;            // The frame that needed the reserved mailbox is in a mailbox now
+    reloadPreemptedTxFrame();
+#endif
+    return 1;
+}
+
+uavcan::uint8_t CanIface::findFreeTxMailbox(uavcan::uint8_t except_index) const
+{
+    static const uavcan::uint32_t TSR_TMEx[NumTxMailboxes] =
     {
-        txmailbox = 2;
-    }
-    else
+        bxcan::TSR_TME0,
+        bxcan::TSR_TME1,
+        bxcan::TSR_TME2
+    };
+    const uavcan::uint32_t tsr = can_->TSR;
+    for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
     {
-        return 0;       // No transmission for you.
+        if ((i != except_index) && ((tsr & TSR_TMEx[i]) != 0))
+        {
+            return i;
+        }
     }
+    return 0xFF;
+}
 
-    peak_tx_mailbox_index_ = uavcan::max(peak_tx_mailbox_index_, txmailbox);    // Statistics
+void CanIface::loadTxMailbox(uavcan::uint8_t mailbox_index, const TxItem& txi)
+{
+    UAVCAN_ASSERT(mailbox_index < NumTxMailboxes);
+    const uavcan::CanFrame& frame = txi.frame;
 
     /*
      * Setting up the mailbox
      */
-    bxcan::TxMailboxType& mb = can_->TxMailbox[txmailbox];
+    bxcan::TxMailboxType& mb = can_->TxMailbox[mailbox_index];
     if (frame.isExtended())
     {
         mb.TIR = ((frame.id & uavcan::CanFrame::MaskExtID) << 3) | bxcan::TIR_IDE;
@@ -394,30 +476,71 @@ uavcan::int16_t CanIface::send(const uavcan::CanFrame& frame, uavcan::MonotonicT
 
     mb.TIR |= bxcan::TIR_TXRQ;  // Go.
 
+    pending_tx_[mailbox_index]           = txi;
+    pending_tx_[mailbox_index].pending   = true;
+    pending_tx_[mailbox_index].preempted = false;
+}
+
+#if UAVCAN_STM32_TX_PREEMPTION
+
+bool CanIface::startTxPreemption(const uavcan::CanFrame& frame)
+{
+    if (preempted_tx_.pending || (reserved_tx_mailbox_ != 0xFF))
+    {
+        return false;           // One preemption at a time
+    }
+
     /*
-     * Registering the pending transmission so we can track its deadline and loopback it as needed
+     * The new frame must have higher priority than all of the mailboxes, otherwise frames of the same
+     * transfer could be reordered. The victim is the mailbox with the lowest priority.
      */
-    TxItem& txi = pending_tx_[txmailbox];
-    txi.deadline       = tx_deadline;
-    txi.frame          = frame;
-    txi.loopback       = (flags & uavcan::CanIOFlagLoopback) != 0;
-    txi.abort_on_error = (flags & uavcan::CanIOFlagAbortOnError) != 0;
-    txi.pending        = true;
-    return 1;
+    uavcan::uint8_t victim = 0xFF;
+    for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
+    {
+        const TxItem& txi = pending_tx_[i];
+        if (!txi.pending || !frame.priorityHigherThan(txi.frame))
+        {
+            return false;
+        }
+        if ((victim == 0xFF) || pending_tx_[victim].frame.priorityHigherThan(txi.frame))
+        {
+            victim = i;
+        }
+    }
+
+    pending_tx_[victim].preempted = true;
+    reserved_tx_mailbox_ = victim;
+    can_->TSR = TSR_ABRQx[victim];      // The mailbox will be released from the TX interrupt
+    return true;
 }
 
+void CanIface::reloadPreemptedTxFrame()
+{
+    if (preempted_tx_.pending)
+    {
+        // The reserved mailbox is left for the frame that caused the preemption
+        const uavcan::uint8_t txmailbox = findFreeTxMailbox(reserved_tx_mailbox_);
+        if (txmailbox != 0xFF)
+        {
+            loadTxMailbox(txmailbox, preempted_tx_);
+            preempted_tx_.pending = false;
+        }
+    }
+}
+
+#endif
+
+#endif // !UAVCAN_STM32_FDCAN
+
 uavcan::int16_t CanIface::receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
                                   uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
 {
     out_ts_monotonic = clock::getMonotonic();  // High precision is not required for monotonic timestamps
     uavcan::uint64_t utc_usec = 0;
+    if (!priority_rx_queue_.pop(out_frame, utc_usec, out_flags) &&  // Lock-free, see RxQueue
+        !rx_queue_.pop(out_frame, utc_usec, out_flags))
     {
-        CriticalSectionLocker lock;
-        if (rx_queue_.getLength() == 0)
-        {
-            return 0;
-        }
-        rx_queue_.pop(out_frame, utc_usec, out_flags);
+        return 0;
     }
     out_ts_utc = uavcan::UtcTime::fromUSec(utc_usec);
     return 1;
@@ -433,6 +556,8 @@ uavcan::int16_t CanIface::configureFilters(const uavcan::CanFilterConfig* filter
     return -1;
 }
 
+#if !UAVCAN_STM32_FDCAN
+
 bool CanIface::waitMsrINakBitStateChange(bool target_state)
 {
 #if UAVCAN_STM32_NUTTX
@@ -462,12 +587,19 @@ int CanIface::init(const uavcan::uint32_t bitrate, const OperatingMode mode)
      * Object state
      */
     rx_queue_.reset();
+    priority_rx_queue_.reset();
     error_cnt_ = 0;
     served_aborts_cnt_ = 0;
     uavcan::fill_n(pending_tx_, NumTxMailboxes, TxItem());
     last_hw_error_code_ = 0;
     peak_tx_mailbox_index_ = 0;
     had_activity_ = false;
+#if UAVCAN_STM32_TX_PREEMPTION
+    preempted_tx_ = TxItem();
+    reserved_tx_mailbox_ = 0xFF;
+    tx_preemption_cnt_ = 0;
+    futile_tx_preemption_cnt_ = 0;
+#endif
 
     /*
      * CAN timings for this bitrate
@@ -481,6 +613,8 @@ int CanIface::init(const uavcan::uint32_t bitrate, const OperatingMode mode)
     UAVCAN_STM32_LOG("Timings: presc=%u sjw=%u bs1=%u bs2=%u",
                      unsigned(timings.prescaler), unsigned(timings.sjw), unsigned(timings.bs1), unsigned(timings.bs2));
 
+    bit_time_nsec_ = 1000000000U / bitrate;     // The bit rate is exact, see computeTimings()
+
     /*
      * Hardware initialization
      */
@@ -494,7 +628,11 @@ int CanIface::init(const uavcan::uint32_t bitrate, const OperatingMode mode)
         goto leave;
     }
 
-    can_->MCR = bxcan::MCR_ABOM | bxcan::MCR_AWUM | bxcan::MCR_INRQ;  // RM page 648
+    /*
+     * The time triggered communication mode only makes the hardware capture the SOF timestamps of the frames,
+     * see handleTxInterrupt(). Global time transmission is never requested (TGT is always zero).
+     */
+    can_->MCR = bxcan::MCR_ABOM | bxcan::MCR_AWUM | bxcan::MCR_INRQ | bxcan::MCR_TTCM;  // RM page 648
 
     can_->BTR = ((timings.sjw & 3U)  << 24) |
                 ((timings.bs1 & 15U) << 16) |
@@ -551,6 +689,82 @@ leave:
     return res;
 }
 
+uavcan::uint32_t CanIface::makeFilterRegisterValue(uavcan::uint32_t value, bool extended)
+{
+    uavcan::uint32_t reg = 0;
+    if (extended)
+    {
+        reg = (value & uavcan::CanFrame::MaskExtID) << 3;
+    }
+    else
+    {
+        reg = (value & uavcan::CanFrame::MaskStdID) << 21;
+    }
+    if ((value & uavcan::CanFrame::FlagEFF) != 0)
+    {
+        reg |= bxcan::RIR_IDE;
+    }
+    if ((value & uavcan::CanFrame::FlagRTR) != 0)
+    {
+        reg |= bxcan::RIR_RTR;
+    }
+    return reg;
+}
+
+int CanIface::configurePriorityRxFilters(const uavcan::CanFilterConfig* filter_configs, uavcan::uint16_t num_configs)
+{
+    if ((num_configs > 0 && (filter_configs == NULL || !priority_rx_queue_.isAllocated())) ||
+        num_configs >= NumFilters)
+    {
+        return -1;
+    }
+
+    /*
+     * The filter banks belong to CAN1. When a frame matches several filters of the same scale and mode, the one
+     * with the lowest number takes precedence, so the critical filters are placed before the catch-all one.
+     */
+    bxcan::CanType* const master = bxcan::Can[0];
+    const unsigned first_bank = unsigned(self_index_) * NumFilters;
+    const unsigned catch_all_bank = first_bank + num_configs;
+
+    CriticalSectionLocker lock;
+
+    master->FMR |= bxcan::FMR_FINIT;
+
+    for (unsigned i = 0; i < NumFilters; i++)
+    {
+        const unsigned bank = first_bank + i;
+        const uavcan::uint32_t bit = 1UL << bank;
+
+        if (bank < catch_all_bank)
+        {
+            const uavcan::CanFilterConfig& fc = filter_configs[i];
+            const bool extended = (fc.id & uavcan::CanFrame::FlagEFF) != 0;
+            master->FilterRegister[bank].FR1 = makeFilterRegisterValue(fc.id, extended);
+            master->FilterRegister[bank].FR2 = makeFilterRegisterValue(fc.mask, extended);
+            master->FS1R  |= bit;                   // Single 32-bit
+            master->FFA1R |= bit;                   // FIFO 1
+            master->FA1R  |= bit;
+        }
+        else if (bank == catch_all_bank)
+        {
+            master->FilterRegister[bank].FR1 = 0;
+            master->FilterRegister[bank].FR2 = 0;
+            master->FS1R  |= bit;
+            master->FFA1R &= ~bit;                  // FIFO 0
+            master->FA1R  |= bit;
+        }
+        else
+        {
+            master->FA1R &= ~bit;
+        }
+    }
+
+    master->FMR &= ~bxcan::FMR_FINIT;
+
+    return 0;
+}
+
 void CanIface::handleTxMailboxInterrupt(uavcan::uint8_t mailbox_index, bool txok, const uavcan::uint64_t utc_usec)
 {
     UAVCAN_ASSERT(mailbox_index < NumTxMailboxes);
@@ -564,30 +778,82 @@ void CanIface::handleTxMailboxInterrupt(uavcan::uint8_t mailbox_index, bool txok
         rx_queue_.push(txi.frame, utc_usec, uavcan::CanIOFlagLoopback);
     }
 
+#if UAVCAN_STM32_TX_PREEMPTION
+    if (txi.preempted && txi.pending)
+    {
+        if (txok)
+        {
+            futile_tx_preemption_cnt_++;    // Too late, it has been transmitted anyway
+        }
+        else
+        {
+            preempted_tx_ = txi;            // Will be reloaded, see reloadPreemptedTxFrame()
+            preempted_tx_.preempted = false;
+            tx_preemption_cnt_++;
+        }
+    }
+    txi.preempted = false;
+#endif
+
     txi.pending = false;
 }
 
+uavcan::uint16_t CanIface::getTxMailboxSofTime(uavcan::uint8_t mailbox_index) const
+{
+    UAVCAN_ASSERT(mailbox_index < NumTxMailboxes);
+    return uavcan::uint16_t((can_->TxMailbox[mailbox_index].TDTR & bxcan::TDTR_TIME_MASK) >> bxcan::TDTR_TIME_SHIFT);
+}
+
 void CanIface::handleTxInterrupt(const uavcan::uint64_t utc_usec)
 {
-    // TXOK == false means that there was a hardware failure
-    if (can_->TSR & bxcan::TSR_RQCP0)
-    {
-        const bool txok = can_->TSR & bxcan::TSR_TXOK0;
-        can_->TSR = bxcan::TSR_RQCP0;
-        handleTxMailboxInterrupt(0, txok, utc_usec);
-    }
-    if (can_->TSR & bxcan::TSR_RQCP1)
+    /*
+     * The interrupt timestamp belongs to the transmission that has been completed last. If the interrupt was
+     * delayed so much that several mailboxes have been completed, the earlier transmissions are dated back by
+     * the difference of the SOF timestamps captured by the hardware, which are counted in bit times.
+     */
+    uavcan::uint16_t last_sof_time = 0;
+    bool last_sof_time_valid = false;
     {
-        const bool txok = can_->TSR & bxcan::TSR_TXOK1;
-        can_->TSR = bxcan::TSR_RQCP1;
-        handleTxMailboxInterrupt(1, txok, utc_usec);
+        const uavcan::uint32_t tsr = can_->TSR;
+        for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
+        {
+            if ((tsr & TSR_RQCPx[i]) != 0 && (tsr & TSR_TXOKx[i]) != 0)
+            {
+                const uavcan::uint16_t sof_time = getTxMailboxSofTime(i);
+                if (!last_sof_time_valid || uavcan::int16_t(sof_time - last_sof_time) > 0)
+                {
+                    last_sof_time = sof_time;
+                    last_sof_time_valid = true;
+                }
+            }
+        }
     }
-    if (can_->TSR & bxcan::TSR_RQCP2)
+
+    // TXOK == false means that there was a hardware failure
+    for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
     {
-        const bool txok = can_->TSR & bxcan::TSR_TXOK2;
-        can_->TSR = bxcan::TSR_RQCP2;
-        handleTxMailboxInterrupt(2, txok, utc_usec);
+        if ((can_->TSR & TSR_RQCPx[i]) == 0)
+        {
+            continue;
+        }
+        const bool txok = (can_->TSR & TSR_TXOKx[i]) != 0;
+        can_->TSR = TSR_RQCPx[i];
+
+        uavcan::uint64_t tx_utc_usec = utc_usec;
+        if (txok && last_sof_time_valid && (utc_usec > 0))
+        {
+            const uavcan::int16_t age_bits = uavcan::int16_t(last_sof_time - getTxMailboxSofTime(i));
+            if (age_bits > 0)
+            {
+                const uavcan::uint64_t age_usec = (uavcan::uint64_t(age_bits) * bit_time_nsec_) / 1000U;
+                tx_utc_usec = (age_usec < utc_usec) ? (utc_usec - age_usec) : 0;
+            }
+        }
+        handleTxMailboxInterrupt(i, txok, tx_utc_usec);
     }
+#if UAVCAN_STM32_TX_PREEMPTION
+    reloadPreemptedTxFrame();
+#endif
     update_event_.signalFromInterrupt();
 }
 
@@ -647,7 +913,8 @@ void CanIface::handleRxInterrupt(uavcan::uint8_t fifo_index, uavcan::uint64_t ut
     /*
      * Store with timeout into the FIFO buffer and signal update event
      */
-    rx_queue_.push(frame, utc_usec, 0);
+    RxQueue& queue = (fifo_index == 1 && priority_rx_queue_.isAllocated()) ? priority_rx_queue_ : rx_queue_;
+    queue.push(frame, utc_usec, 0);
     had_activity_ = true;
     update_event_.signalFromInterrupt();
 }
@@ -674,6 +941,13 @@ void CanIface::handleStatusChangeInterrupt()
                 served_aborts_cnt_++;
             }
         }
+#if UAVCAN_STM32_TX_PREEMPTION
+        if (preempted_tx_.pending && preempted_tx_.abort_on_error)
+        {
+            preempted_tx_.pending = false;
+            served_aborts_cnt_++;
+        }
+#endif
     }
 }
 
@@ -690,6 +964,13 @@ void CanIface::discardTimedOutTxMailboxes(uavcan::MonotonicTime current_time)
             error_cnt_++;
         }
     }
+#if UAVCAN_STM32_TX_PREEMPTION
+    if (preempted_tx_.pending && preempted_tx_.deadline < current_time)
+    {
+        preempted_tx_.pending = false;
+        error_cnt_++;
+    }
+#endif
 }
 
 bool CanIface::canAcceptNewTxFrame(const uavcan::CanFrame& frame) const
@@ -699,26 +980,51 @@ bool CanIface::canAcceptNewTxFrame(const uavcan::CanFrame& frame) const
      *  - There is at least one TX mailbox free (obvious enough);
      *  - The priority of the new frame is higher than priority of all TX mailboxes.
      */
-    {
-        static const uavcan::uint32_t TME = bxcan::TSR_TME0 | bxcan::TSR_TME1 | bxcan::TSR_TME2;
-        const uavcan::uint32_t tme = can_->TSR & TME;
+    static const uavcan::uint32_t TME = bxcan::TSR_TME0 | bxcan::TSR_TME1 | bxcan::TSR_TME2;
+    const uavcan::uint32_t tme = can_->TSR & TME;
 
-        if (tme == TME)     // All TX mailboxes are free (as in freedom).
-        {
-            return true;
-        }
+#if !UAVCAN_STM32_TX_PREEMPTION
+    if (tme == TME)     // All TX mailboxes are free (as in freedom).
+    {
+        return true;
+    }
 
-        if (tme == 0)       // All TX mailboxes are busy transmitting.
-        {
-            return false;
-        }
+    if (tme == 0)       // All TX mailboxes are busy transmitting.
+    {
+        return false;
     }
+#endif
 
     /*
      * The second condition requires a critical section.
      */
     CriticalSectionLocker lock;
 
+#if UAVCAN_STM32_TX_PREEMPTION
+    /*
+     * With preemption enabled, a frame can be accepted even if all mailboxes are busy - send() will free one up.
+     * The preempted frame counts as pending as well, otherwise frames of equal priority could overtake it.
+     */
+    if (tme == 0)
+    {
+        if (preempted_tx_.pending || (reserved_tx_mailbox_ != 0xFF))
+        {
+            return false;   // Preemption is already in progress
+        }
+        for (int mbx = 0; mbx < NumTxMailboxes; mbx++)
+        {
+            if (!pending_tx_[mbx].pending)
+            {
+                return false;   // Being aborted, will be free soon
+            }
+        }
+    }
+    if (preempted_tx_.pending && !frame.priorityHigherThan(preempted_tx_.frame))
+    {
+        return false;
+    }
+#endif
+
     for (int mbx = 0; mbx < NumTxMailboxes; mbx++)
     {
         if (pending_tx_[mbx].pending && !frame.priorityHigherThan(pending_tx_[mbx].frame))
@@ -730,23 +1036,31 @@ bool CanIface::canAcceptNewTxFrame(const uavcan::CanFrame& frame) const
     return true;                // This new frame will be added to a free TX mailbox in the next @ref send().
 }
 
+#endif // !UAVCAN_STM32_FDCAN
+
 bool CanIface::isRxBufferEmpty() const
 {
-    CriticalSectionLocker lock;
-    return rx_queue_.getLength() == 0;
+    return rx_queue_.getLength() == 0 && priority_rx_queue_.getLength() == 0;
 }
 
 uavcan::uint64_t CanIface::getErrorCount() const
 {
     CriticalSectionLocker lock;
-    return error_cnt_ + rx_queue_.getOverflowCount();
+    return error_cnt_ + rx_queue_.getOverflowCount() + priority_rx_queue_.getOverflowCount();
 }
 
 unsigned CanIface::getRxQueueLength() const
+{
+    return rx_queue_.getLength() + priority_rx_queue_.getLength();
+}
+
+#if UAVCAN_STM32_RX_ISR_PROFILING
+CanIface::RxIsrProfile CanIface::getRxIsrProfile() const
 {
     CriticalSectionLocker lock;
-    return rx_queue_.getLength();
+    return rx_isr_profiles[self_index_];
 }
+#endif
 
 uavcan::uint8_t CanIface::yieldLastHardwareErrorCode()
 {
@@ -832,6 +1146,8 @@ uavcan::int16_t CanDriver::select(uavcan::CanSelectMasks& inout_masks,
     return 1;                                   // Return value doesn't matter as long as it is non-negative
 }
 
+#if !UAVCAN_STM32_FDCAN
+
 int CanDriver::init(const uavcan::uint32_t bitrate, const CanIface::OperatingMode mode)
 {
     int res = 0;
@@ -965,6 +1281,8 @@ CanIface* CanDriver::getIface(uavcan::uint8_t iface_index)
     return NULL;
 }
 
+#endif // !UAVCAN_STM32_FDCAN
+
 bool CanDriver::hadActivity()
 {
     bool ret = if0_.hadActivity();
@@ -979,6 +1297,8 @@ bool CanDriver::hadActivity()
 /*
  * Interrupt handlers
  */
+#if !UAVCAN_STM32_FDCAN
+
 extern "C"
 {
 
@@ -1101,3 +1421,5 @@ UAVCAN_STM32_IRQ_HANDLER(CAN2_SCE_IRQHandler)
 #endif // UAVCAN_STM32_NUTTX
 
 } // extern "C"
+
+#endif // !UAVCAN_STM32_FDCAN
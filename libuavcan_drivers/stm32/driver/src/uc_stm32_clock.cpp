@@ -55,6 +55,23 @@ uavcan::MonotonicTime prev_utc_adj_at;
 uavcan::uint64_t time_mono = 0;
 uavcan::uint64_t time_utc = 0;
 
+/**
+ * Incremented whenever the overflow ISR or adjustUtc() modify the time base. The readers sample the time base
+ * without disabling interrupts and retry if this has changed meanwhile.
+ * The writers can't be preempted by the readers: the ISR has a higher priority than any thread and the same
+ * priority as the CAN ISR, and adjustUtc() modifies the time base in a critical section.
+ */
+volatile uavcan::uint32_t time_generation = 0;
+
+/**
+ * Prevents the compiler from moving the accesses to the time base out of the generation checks.
+ * This is enough since the ISR and the threads run on the same core.
+ */
+inline void compilerMemoryBarrier()
+{
+    __asm__ __volatile__ ("" ::: "memory");
+}
+
 }
 
 void init()
@@ -88,63 +105,79 @@ void init()
     TIMX->CR1  = TIM_CR1_CEN;    // Start
 }
 
-static uavcan::uint64_t sampleUtcFromCriticalSection()
+/*
+ * The samplers below can be invoked from any context. An overflow that has not been handled by the ISR yet (which
+ * happens if the caller runs with interrupts disabled or from an ISR) is accounted for via the UIF flag.
+ */
+static uavcan::uint64_t sampleMonotonic()
 {
     UAVCAN_ASSERT(initialized);
     UAVCAN_ASSERT(TIMX->DIER & TIM_DIER_UIE);
 
-    volatile uavcan::uint64_t time = time_utc;
-    volatile uavcan::uint32_t cnt = TIMX->CNT;
-
-    if (TIMX->SR & TIM_SR_UIF)
+    while (true)
     {
-        cnt = TIMX->CNT;
-        const uavcan::int32_t add = uavcan::int32_t(USecPerOverflow) +
-                                    (utc_accumulated_correction_nsec + utc_correction_nsec_per_overflow) / 1000;
-        time = uavcan::uint64_t(uavcan::int64_t(time) + add);
+        const uavcan::uint32_t generation = time_generation;
+        compilerMemoryBarrier();
+
+        uavcan::uint64_t time = time_mono;
+        uavcan::uint32_t cnt = TIMX->CNT;
+        if (TIMX->SR & TIM_SR_UIF)
+        {
+            cnt = TIMX->CNT;
+            time += USecPerOverflow;
+        }
+
+        compilerMemoryBarrier();
+        if (generation == time_generation)
+        {
+            return time + cnt;
+        }
     }
-    return time + cnt;
 }
 
-uavcan::uint64_t getUtcUSecFromCanInterrupt()
+static uavcan::uint64_t sampleUtc()
 {
-    return utc_set ? sampleUtcFromCriticalSection() : 0;
-}
+    UAVCAN_ASSERT(initialized);
+    UAVCAN_ASSERT(TIMX->DIER & TIM_DIER_UIE);
 
-uavcan::MonotonicTime getMonotonic()
-{
-    uavcan::uint64_t usec = 0;
+    while (true)
     {
-        CriticalSectionLocker locker;
+        const uavcan::uint32_t generation = time_generation;
+        compilerMemoryBarrier();
 
-        volatile uavcan::uint64_t time = time_mono;
-        volatile uavcan::uint32_t cnt = TIMX->CNT;
+        uavcan::uint64_t time = time_utc;
+        uavcan::uint32_t cnt = TIMX->CNT;
         if (TIMX->SR & TIM_SR_UIF)
         {
             cnt = TIMX->CNT;
-            time += USecPerOverflow;
+            const uavcan::int32_t add = uavcan::int32_t(USecPerOverflow) +
+                                        (utc_accumulated_correction_nsec + utc_correction_nsec_per_overflow) / 1000;
+            time = uavcan::uint64_t(uavcan::int64_t(time) + add);
         }
-        usec = time + cnt;
 
-#ifndef NDEBUG
-        static uavcan::uint64_t prev_usec = 0;  // Self-test
-        UAVCAN_ASSERT(prev_usec <= usec);
-        prev_usec = usec;
-#endif
+        compilerMemoryBarrier();
+        if (generation == time_generation)
+        {
+            return time + cnt;
+        }
     }
-    return uavcan::MonotonicTime::fromUSec(usec);
+}
+
+uavcan::uint64_t getUtcUSecFromCanInterrupt()
+{
+    return utc_set ? sampleUtc() : 0;
+}
+
+uavcan::MonotonicTime getMonotonic()
+{
+    return uavcan::MonotonicTime::fromUSec(sampleMonotonic());
 }
 
 uavcan::UtcTime getUtc()
 {
     if (utc_set)
     {
-        uavcan::uint64_t usec = 0;
-        {
-            CriticalSectionLocker locker;
-            usec = sampleUtcFromCriticalSection();
-        }
-        return uavcan::UtcTime::fromUSec(usec);
+        return uavcan::UtcTime::fromUSec(sampleUtc());
     }
     return uavcan::UtcTime();
 }
@@ -223,6 +256,7 @@ void adjustUtc(uavcan::UtcDuration adjustment)
             {
                 time_utc = uavcan::uint64_t(uavcan::int64_t(time_utc) + adj_usec);
             }
+            time_generation++;
         }
 
         utc_set = true;
@@ -341,6 +375,8 @@ UAVCAN_STM32_IRQ_HANDLER(TIMX_IRQHandler)
         }
     }
 
+    time_generation++;          // The readers that have been preempted by this ISR will retry
+
     UAVCAN_STM32_IRQ_EPILOGUE();
 }
 
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan/transport/crc.hpp>
+#include "internal.hpp"
+
+#if UAVCAN_STM32_HARDWARE_CRC
+
+#if !UAVCAN_USE_EXTERNAL_CRC
+# error "UAVCAN_STM32_HARDWARE_CRC requires UAVCAN_USE_EXTERNAL_CRC=1"
+#endif
+
+#if !UAVCAN_STM32_CHIBIOS
+# error "UAVCAN_STM32_HARDWARE_CRC is supported only with ChibiOS"
+#endif
+
+#if !defined(CRC_CR_POLYSIZE_0)
+# error "This MCU does not support programmable CRC polynomial"
+#endif
+
+namespace uavcan
+{
+/**
+ * CRC-16-CCITT on the hardware CRC unit, see uavcan::TransferCRC.
+ * The unit is reconfigured on every call, so the intermediate value is always kept by the caller.
+ */
+uint16_t computeTransferCrcExternally(uint16_t crc, const uint8_t* bytes, unsigned len)
+{
+    CRC->POL = 0x1021U;
+    CRC->INIT = crc;
+    CRC->CR = CRC_CR_POLYSIZE_0 | CRC_CR_RESET;        // 16-bit polynomial, no reversal; loads INIT into DR
+
+    // Byte access to the data register makes the unit process exactly 8 bits per write
+    volatile uint8_t* const dr8 = reinterpret_cast<volatile uint8_t*>(&CRC->DR);
+    while (len--)
+    {
+        *dr8 = *bytes++;
+    }
+
+    return uint16_t(CRC->DR);
+}
+
+}
+
+#endif
@@ -0,0 +1,782 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ */
+
+#include <uavcan_stm32/build_config.hpp>
+
+#if UAVCAN_STM32_FDCAN    // Otherwise see uc_stm32_can.cpp
+
+#include <uavcan_stm32/can.hpp>
+#include <uavcan_stm32/clock.hpp>
+#include "internal.hpp"
+
+#if UAVCAN_STM32_CHIBIOS
+# include <hal.h>
+#elif UAVCAN_STM32_NUTTX
+# include <nuttx/arch.h>
+# include <nuttx/irq.h>
+# include <arch/board/board.h>
+#else
+# error "Unknown OS"
+#endif
+
+#if UAVCAN_STM32_CHIBIOS
+// Newer versions of ChibiOS define only the vector names
+# if !defined(FDCAN1_IT0_IRQHandler) && defined(STM32_FDCAN1_IT0_HANDLER)
+#  define FDCAN1_IT0_IRQHandler STM32_FDCAN1_IT0_HANDLER
+# endif
+# if !defined(FDCAN2_IT0_IRQHandler) && defined(STM32_FDCAN2_IT0_HANDLER)
+#  define FDCAN2_IT0_IRQHandler STM32_FDCAN2_IT0_HANDLER
+# endif
+#endif
+
+#if UAVCAN_STM32_NUTTX
+extern "C"
+{
+static int can1_irq(const int irq, void*);
+#if UAVCAN_STM32_NUM_IFACES > 1
+static int can2_irq(const int irq, void*);
+#endif
+}
+#endif
+
+namespace uavcan_stm32
+{
+namespace
+{
+
+CanIface* ifaces[UAVCAN_STM32_NUM_IFACES] =
+{
+    NULL
+#if UAVCAN_STM32_NUM_IFACES > 1
+    , NULL
+#endif
+};
+
+const uavcan::uint32_t AllTxBuffersMask = uavcan::uint32_t(0xFFFFFFFFULL >> (32U - fdcan::NumTxBuffers));
+
+inline void handleInterrupt(uavcan::uint8_t iface_index)
+{
+    UAVCAN_ASSERT(iface_index < UAVCAN_STM32_NUM_IFACES);
+    uavcan::uint64_t utc_usec = clock::getUtcUSecFromCanInterrupt();
+    if (utc_usec > 0)
+    {
+        utc_usec--;
+    }
+    if (ifaces[iface_index] != NULL)
+    {
+        ifaces[iface_index]->handleInterrupt(utc_usec);
+    }
+    else
+    {
+        UAVCAN_ASSERT(0);
+    }
+}
+
+volatile uavcan::uint32_t* getMessageRamBlock(uavcan::uint8_t iface_index)
+{
+    return reinterpret_cast<volatile uavcan::uint32_t*>(fdcan::MessageRamBase +
+                                                       fdcan::MessageRamSizePerIface * iface_index);
+}
+
+/**
+ * Returns the 4-bit DLC of the frame, or a negative value if the frame cannot be transmitted by this driver.
+ */
+int encodeDlc(const uavcan::CanFrame& frame)
+{
+    if (frame.isErrorFrame())
+    {
+        return -1;
+    }
+    if (!frame.isCanFD())
+    {
+        return (frame.dlc <= uavcan::CanFrame::MaxClassicDataLen) ? int(frame.dlc) : -1;
+    }
+    if (frame.dlc > uavcan::CanFrame::MaxDataLen)
+    {
+        return -1;
+    }
+    const uavcan::uint8_t dlc = uavcan::CanFrame::dataLengthToDlc(frame.dlc);
+    return (uavcan::CanFrame::dlcToDataLength(dlc) == frame.dlc) ? int(dlc) : -1;   // Only the exact lengths
+}
+
+} // namespace
+
+/*
+ * CanIface
+ */
+volatile uavcan::uint32_t* CanIface::getRxFifo0Element(unsigned index) const
+{
+    UAVCAN_ASSERT(index < fdcan::NumRxFifo0Elements);
+    return getMessageRamBlock(self_index_) + fdcan::RxFifo0Offset / 4U + index * fdcan::ElementSizeWords;
+}
+
+volatile uavcan::uint32_t* CanIface::getTxBufferElement(unsigned index) const
+{
+    UAVCAN_ASSERT(index < fdcan::NumTxBuffers);
+    return getMessageRamBlock(self_index_) + fdcan::TxBufferOffset / 4U + index * fdcan::ElementSizeWords;
+}
+
+uavcan::int16_t CanIface::send(const uavcan::CanFrame& frame, uavcan::MonotonicTime tx_deadline,
+                               uavcan::CanIOFlags flags)
+{
+    const int dlc = encodeDlc(frame);
+    if (dlc < 0)
+    {
+        return -1;
+    }
+
+    /*
+     * The check performed in @ref canAcceptNewTxFrame() is not repeated here, see the bxCAN driver for reasoning.
+     */
+    CriticalSectionLocker lock;
+
+    /*
+     * The buffer is chosen by the hardware. In the queue mode the put index points to the free buffer with
+     * the lowest index.
+     */
+    const uavcan::uint32_t txfqs = can_->TXFQS;
+    if ((txfqs & fdcan::TXFQS_TFQF) != 0)
+    {
+        return 0;       // No transmission for you.
+    }
+
+    const uavcan::uint8_t index = uavcan::uint8_t((txfqs & fdcan::TXFQS_TFQPI_MASK) >> fdcan::TXFQS_TFQPI_SHIFT);
+    if (index >= NumTxMailboxes)
+    {
+        UAVCAN_ASSERT(0);
+        return -1;
+    }
+
+    peak_tx_mailbox_index_ = uavcan::max(peak_tx_mailbox_index_, index);    // Statistics
+
+    /*
+     * Setting up the buffer element
+     */
+    volatile uavcan::uint32_t* const element = getTxBufferElement(index);
+
+    uavcan::uint32_t e0 = 0;
+    if (frame.isExtended())
+    {
+        e0 = ((frame.id & uavcan::CanFrame::MaskExtID) << fdcan::E0_EXID_SHIFT) | fdcan::E0_XTD;
+    }
+    else
+    {
+        e0 = ((frame.id & uavcan::CanFrame::MaskStdID) << fdcan::E0_STID_SHIFT);
+    }
+
+    if (frame.isRemoteTransmissionRequest())
+    {
+        e0 |= fdcan::E0_RTR;
+    }
+
+    uavcan::uint32_t e1 = uavcan::uint32_t(dlc) << fdcan::E1_DLC_SHIFT;  // No TX event
+    if (frame.isCanFD())
+    {
+        e1 |= fdcan::E1_FDF | ((UAVCAN_STM32_FDCAN_DATA_BITRATE > 0) ? fdcan::E1_BRS : 0);
+    }
+
+    element[0] = e0;
+    element[1] = e1;
+
+    // The data array is padded to a multiple of 4 bytes, so the last word is never read past its end
+    const unsigned num_words = (unsigned(frame.dlc) + 3U) / 4U;
+    for (unsigned i = 0; i < num_words; i++)
+    {
+        element[2 + i] = (uavcan::uint32_t(frame.data[i * 4U + 3U]) << 24) |
+                         (uavcan::uint32_t(frame.data[i * 4U + 2U]) << 16) |
+                         (uavcan::uint32_t(frame.data[i * 4U + 1U]) << 8)  |
+                         (uavcan::uint32_t(frame.data[i * 4U + 0U]) << 0);
+    }
+
+    /*
+     * Registering the pending transmission so we can track its deadline and loopback it as needed
+     */
+    TxItem& txi = pending_tx_[index];
+    txi.deadline       = tx_deadline;
+    txi.frame          = frame;
+    txi.loopback       = (flags & uavcan::CanIOFlagLoopback) != 0;
+    txi.abort_on_error = (flags & uavcan::CanIOFlagAbortOnError) != 0;
+    txi.pending        = true;
+
+    can_->TXBAR = uavcan::uint32_t(1) << index;   // Go.
+    return 1;
+}
+
+bool CanIface::waitCccrBitStateChange(uavcan::uint32_t bit, bool target_state)
+{
+#if UAVCAN_STM32_NUTTX
+    const unsigned Timeout = 500;
+#else
+    const unsigned Timeout = 2000000;
+#endif
+    for (unsigned wait_ack = 0; wait_ack < Timeout; wait_ack++)
+    {
+        const bool state = (can_->CCCR & bit) != 0;
+        if (state == target_state)
+        {
+            return true;
+        }
+#if UAVCAN_STM32_NUTTX
+        ::usleep(2000);
+#endif
+    }
+    return false;
+}
+
+int CanIface::init(const uavcan::uint32_t bitrate, const OperatingMode mode)
+{
+    int res = 0;
+
+    /*
+     * Object state
+     */
+    rx_queue_.reset();
+    error_cnt_ = 0;
+    served_aborts_cnt_ = 0;
+    uavcan::fill_n(pending_tx_, NumTxMailboxes, TxItem());
+    last_hw_error_code_ = 0;
+    peak_tx_mailbox_index_ = 0;
+    had_activity_ = false;
+
+    /*
+     * CAN timings for this bitrate
+     */
+    Timings timings;
+#if UAVCAN_SUPPORT_CANFD && (UAVCAN_STM32_FDCAN_DATA_BITRATE > 0)
+    Timings data_timings;
+#endif
+    res = computeTimings(bitrate, timings);
+    if (res < 0)
+    {
+        goto leave;
+    }
+    UAVCAN_STM32_LOG("Timings: presc=%u sjw=%u bs1=%u bs2=%u",
+                     unsigned(timings.prescaler), unsigned(timings.sjw), unsigned(timings.bs1), unsigned(timings.bs2));
+
+#if UAVCAN_SUPPORT_CANFD && (UAVCAN_STM32_FDCAN_DATA_BITRATE > 0)
+    /*
+     * Data phase timings; the data bit timing register has narrower fields than the nominal one
+     */
+    res = computeTimings(UAVCAN_STM32_FDCAN_DATA_BITRATE, data_timings);
+    if (res < 0)
+    {
+        goto leave;
+    }
+    if ((data_timings.prescaler > 0x1FU) || (data_timings.bs1 > 0x1FU) || (data_timings.bs2 > 0x0FU))
+    {
+        UAVCAN_STM32_LOG("Data phase timings out of range");
+        res = -1;
+        goto leave;
+    }
+    UAVCAN_STM32_LOG("Data timings: presc=%u sjw=%u bs1=%u bs2=%u", unsigned(data_timings.prescaler),
+                     unsigned(data_timings.sjw), unsigned(data_timings.bs1), unsigned(data_timings.bs2));
+#endif
+
+    /*
+     * Hardware initialization
+     */
+    can_->CCCR &= ~fdcan::CCCR_CSR;     // Exit sleep mode
+
+    if (!waitCccrBitStateChange(fdcan::CCCR_CSA, false))
+    {
+        UAVCAN_STM32_LOG("CCCR CSA not cleared");
+        res = -1;
+        goto leave;
+    }
+
+    can_->CCCR |= fdcan::CCCR_INIT;     // Request init
+
+    if (!waitCccrBitStateChange(fdcan::CCCR_INIT, true))
+    {
+        UAVCAN_STM32_LOG("CCCR INIT not set");
+        res = -1;
+        goto leave;
+    }
+
+    /*
+     * Setting CCE resets the TX and RX FIFO state.
+     * Automatic retransmission is enabled; bus monitoring mode is the same as silent mode of bxCAN.
+     * With CAN FD, both frame formats are accepted, and the bit rate is switched only if the data phase bit rate
+     * is configured.
+     */
+    can_->CCCR = fdcan::CCCR_INIT | fdcan::CCCR_CCE | ((mode == SilentMode) ? fdcan::CCCR_MON : 0);
+#if UAVCAN_SUPPORT_CANFD
+    can_->CCCR |= fdcan::CCCR_FDOE | ((UAVCAN_STM32_FDCAN_DATA_BITRATE > 0) ? fdcan::CCCR_BRSE : 0);
+#endif
+
+    can_->NBTP = ((uavcan::uint32_t(timings.sjw)       << fdcan::NBTP_NSJW_SHIFT)   & fdcan::NBTP_NSJW_MASK)   |
+                 ((uavcan::uint32_t(timings.bs1)       << fdcan::NBTP_NTSEG1_SHIFT) & fdcan::NBTP_NTSEG1_MASK) |
+                 ((uavcan::uint32_t(timings.bs2)       << fdcan::NBTP_NTSEG2_SHIFT) & fdcan::NBTP_NTSEG2_MASK) |
+                 ((uavcan::uint32_t(timings.prescaler) << fdcan::NBTP_NBRP_SHIFT)   & fdcan::NBTP_NBRP_MASK);
+
+#if UAVCAN_SUPPORT_CANFD && (UAVCAN_STM32_FDCAN_DATA_BITRATE > 0)
+    {
+        /*
+         * The transceiver loop delay is compensated by sampling the own data bits at the secondary sample point,
+         * which is placed at the regular sample point past the measured delay; the offset is in the kernel clocks.
+         */
+        const Timings& dt = data_timings;
+        const unsigned tdco = uavcan::min(0x7FU, (unsigned(dt.prescaler) + 1U) * (unsigned(dt.bs1) + 2U));
+        can_->DBTP = ((uavcan::uint32_t(dt.sjw)       << fdcan::DBTP_DSJW_SHIFT)   & fdcan::DBTP_DSJW_MASK)   |
+                     ((uavcan::uint32_t(dt.bs1)       << fdcan::DBTP_DTSEG1_SHIFT) & fdcan::DBTP_DTSEG1_MASK) |
+                     ((uavcan::uint32_t(dt.bs2)       << fdcan::DBTP_DTSEG2_SHIFT) & fdcan::DBTP_DTSEG2_MASK) |
+                     ((uavcan::uint32_t(dt.prescaler) << fdcan::DBTP_DBRP_SHIFT)   & fdcan::DBTP_DBRP_MASK)   |
+                     fdcan::DBTP_TDC;
+        can_->TDCR = (uavcan::uint32_t(tdco) << fdcan::TDCR_TDCO_SHIFT) & fdcan::TDCR_TDCO_MASK;
+    }
+#endif
+
+    /*
+     * Message RAM.
+     * There are no filter elements, so all frames are accepted into FIFO 0 by the global filter.
+     * FIFO 0 operates in the blocking mode, so the oldest frames are kept when it overflows, same as in bxCAN.
+     * TX buffers operate in the queue mode, see canAcceptNewTxFrame().
+     */
+    {
+        volatile uavcan::uint32_t* const ram = getMessageRamBlock(self_index_);
+        for (unsigned i = 0; i < fdcan::MessageRamSizePerIface / 4U; i++)
+        {
+            ram[i] = 0;
+        }
+    }
+
+#if UAVCAN_STM32_FDCAN == 7
+    {
+        const uavcan::uint32_t ram_offset = fdcan::MessageRamSizePerIface * self_index_;
+
+        can_->GFC   = 0;                // Accept non-matching frames into FIFO 0
+        can_->SIDFC = 0;
+        can_->XIDFC = 0;
+        can_->RXF0C = ((ram_offset + fdcan::RxFifo0Offset) & fdcan::RXF0C_F0SA_MASK) |
+                      (fdcan::NumRxFifo0Elements << fdcan::RXF0C_F0S_SHIFT);
+        can_->RXF1C = 0;
+        can_->RXBC  = 0;
+        can_->RXESC = fdcan::ElementSizeCode << fdcan::RXESC_F0DS_SHIFT;
+        can_->TXESC = fdcan::ElementSizeCode << fdcan::TXESC_TBDS_SHIFT;
+        can_->TXEFC = 0;
+        can_->TXBC  = ((ram_offset + fdcan::TxBufferOffset) & fdcan::TXBC_TBSA_MASK) |
+                      (fdcan::NumTxBuffers << fdcan::TXBC_TFQS_SHIFT) |
+                      fdcan::TXBC_TFQM;
+    }
+#else
+    can_->RXGFC = 0;                    // Accept non-matching frames into FIFO 0
+    can_->TXBC  = fdcan::TXBC_TFQM;
+#endif
+
+    can_->IE = fdcan::IR_RF0N |         // RX FIFO 0 new message
+               fdcan::IR_RF0L |         // RX FIFO 0 message lost
+               fdcan::IR_TC |           // Transmission completed
+               fdcan::IR_TCF |          // Transmission cancellation finished
+               fdcan::IR_PEA |          // Protocol error, LEC has been updated
+               fdcan::IR_BO;            // Bus off
+    can_->ILS = 0;                      // Everything goes to the line 0
+    can_->TXBTIE = AllTxBuffersMask;
+    can_->TXBCIE = AllTxBuffersMask;
+    can_->ILE = fdcan::ILE_EINT0;
+
+    can_->CCCR &= ~fdcan::CCCR_INIT;    // Leave init mode
+
+    if (!waitCccrBitStateChange(fdcan::CCCR_INIT, false))
+    {
+        UAVCAN_STM32_LOG("CCCR INIT not cleared");
+        res = -1;
+        goto leave;
+    }
+
+leave:
+    return res;
+}
+
+void CanIface::handleTxInterrupt(const uavcan::uint64_t utc_usec)
+{
+    // The flags are reset by the hardware when the buffer is requested again, so only pending buffers are checked
+    const uavcan::uint32_t txbto = can_->TXBTO;
+    const uavcan::uint32_t txbcf = can_->TXBCF;
+
+    for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
+    {
+        TxItem& txi = pending_tx_[i];
+        if (!txi.pending)
+        {
+            continue;
+        }
+
+        const uavcan::uint32_t bit = uavcan::uint32_t(1) << i;
+        if ((txbto & bit) != 0)
+        {
+            had_activity_ = true;
+            if (txi.loopback)
+            {
+                rx_queue_.push(txi.frame, utc_usec, uavcan::CanIOFlagLoopback);
+            }
+            txi.pending = false;
+        }
+        else if ((txbcf & bit) != 0)
+        {
+            txi.pending = false;
+        }
+    }
+}
+
+void CanIface::handleRxInterrupt(const uavcan::uint64_t utc_usec)
+{
+    /*
+     * The hardware FIFO is drained completely, so a burst of frames is served with one interrupt
+     */
+    for (;;)
+    {
+        const uavcan::uint32_t rxf0s = can_->RXF0S;
+        if ((rxf0s & fdcan::RXF0S_F0FL_MASK) == 0)
+        {
+            break;
+        }
+
+        const uavcan::uint32_t index = (rxf0s & fdcan::RXF0S_F0GI_MASK) >> fdcan::RXF0S_F0GI_SHIFT;
+        if (index >= fdcan::NumRxFifo0Elements)
+        {
+            UAVCAN_ASSERT(0);
+            break;
+        }
+
+        /*
+         * Read the frame contents
+         */
+        const volatile uavcan::uint32_t* const element = getRxFifo0Element(index);
+        const uavcan::uint32_t e0 = element[0];
+        const uavcan::uint32_t e1 = element[1];
+
+        uavcan::CanFrame frame;
+
+        if ((e0 & fdcan::E0_XTD) == 0)
+        {
+            frame.id = uavcan::CanFrame::MaskStdID & (e0 >> fdcan::E0_STID_SHIFT);
+        }
+        else
+        {
+            frame.id = uavcan::CanFrame::MaskExtID & (e0 >> fdcan::E0_EXID_SHIFT);
+            frame.id |= uavcan::CanFrame::FlagEFF;
+        }
+
+        if ((e0 & fdcan::E0_RTR) != 0)
+        {
+            frame.id |= uavcan::CanFrame::FlagRTR;
+        }
+
+        const uavcan::uint8_t dlc = uavcan::uint8_t((e1 & fdcan::E1_DLC_MASK) >> fdcan::E1_DLC_SHIFT);
+#if UAVCAN_SUPPORT_CANFD
+        if ((e1 & fdcan::E1_FDF) != 0)
+        {
+            frame.canfd = true;
+            frame.dlc = uavcan::CanFrame::dlcToDataLength(dlc);
+        }
+        else
+#endif
+        {
+            frame.dlc = uavcan::uint8_t(uavcan::min(8U, unsigned(dlc)));
+        }
+
+        const unsigned num_words = (unsigned(frame.dlc) + 3U) / 4U;
+        for (unsigned i = 0; i < num_words; i++)
+        {
+            const uavcan::uint32_t word = element[2 + i];
+            frame.data[i * 4U + 0U] = uavcan::uint8_t(0xFF & (word >> 0));
+            frame.data[i * 4U + 1U] = uavcan::uint8_t(0xFF & (word >> 8));
+            frame.data[i * 4U + 2U] = uavcan::uint8_t(0xFF & (word >> 16));
+            frame.data[i * 4U + 3U] = uavcan::uint8_t(0xFF & (word >> 24));
+        }
+
+        can_->RXF0A = index;            // Release the element we just read
+
+        rx_queue_.push(frame, utc_usec, 0);
+        had_activity_ = true;
+    }
+}
+
+void CanIface::handleStatusChangeInterrupt()
+{
+    const uavcan::uint32_t psr = can_->PSR;     // LEC is reset on read
+
+    const uavcan::uint8_t lec = uavcan::uint8_t((psr & fdcan::PSR_LEC_MASK) >> fdcan::PSR_LEC_SHIFT);
+    if ((lec != 0) && (lec != fdcan::PSR_LEC_NO_CHANGE))
+    {
+        last_hw_error_code_ = lec;              // Same encoding as in bxCAN
+        error_cnt_++;
+
+        // Serving abort requests
+        uavcan::uint32_t cancel_mask = 0;
+        for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
+        {
+            TxItem& txi = pending_tx_[i];
+            if (txi.pending && txi.abort_on_error)
+            {
+                cancel_mask |= uavcan::uint32_t(1) << i;
+                txi.pending = false;
+                served_aborts_cnt_++;
+            }
+        }
+        if (cancel_mask != 0)
+        {
+            can_->TXBCR = cancel_mask;
+        }
+    }
+
+    /*
+     * Unlike bxCAN, FDCAN cannot leave the bus off state automatically - it enters the init mode instead.
+     * Leaving the init mode starts the recovery sequence, which is what the automatic bus-off management does.
+     */
+    if (((psr & fdcan::PSR_BO) != 0) && ((can_->CCCR & fdcan::CCCR_INIT) != 0))
+    {
+        error_cnt_++;
+        can_->CCCR &= ~fdcan::CCCR_INIT;
+    }
+}
+
+void CanIface::handleInterrupt(const uavcan::uint64_t utc_usec)
+{
+    const uavcan::uint32_t ir = can_->IR;
+    can_->IR = ir;                      // Write 1 to clear; events that occur later will trigger the IRQ again
+
+    if ((ir & fdcan::IR_RF0L) != 0)
+    {
+        error_cnt_++;                   // Register overflow as a hardware error
+    }
+
+    if ((ir & (fdcan::IR_RF0N | fdcan::IR_RF0L)) != 0)
+    {
+        handleRxInterrupt(utc_usec);
+    }
+
+    if ((ir & (fdcan::IR_TC | fdcan::IR_TCF)) != 0)
+    {
+        handleTxInterrupt(utc_usec);
+    }
+
+    if ((ir & (fdcan::IR_PEA | fdcan::IR_BO)) != 0)
+    {
+        handleStatusChangeInterrupt();
+    }
+
+    update_event_.signalFromInterrupt();
+}
+
+void CanIface::discardTimedOutTxMailboxes(uavcan::MonotonicTime current_time)
+{
+    CriticalSectionLocker lock;
+    uavcan::uint32_t cancel_mask = 0;
+    for (uavcan::uint8_t i = 0; i < NumTxMailboxes; i++)
+    {
+        TxItem& txi = pending_tx_[i];
+        if (txi.pending && txi.deadline < current_time)
+        {
+            cancel_mask |= uavcan::uint32_t(1) << i;
+            txi.pending = false;
+            error_cnt_++;
+        }
+    }
+    if (cancel_mask != 0)
+    {
+        can_->TXBCR = cancel_mask;      // Goodnight sweet transmissions
+    }
+}
+
+bool CanIface::canAcceptNewTxFrame(const uavcan::CanFrame& frame) const
+{
+    /*
+     * In the queue mode the hardware always transmits the highest-priority pending frame first, hence there is
+     * no priority inversion and all TX buffers can be used. The only remaining constraint is that frames of equal
+     * priority must not be queued together, because the hardware would transmit them in the order of buffer
+     * indices rather than in the order of submission.
+     */
+    if ((can_->TXFQS & fdcan::TXFQS_TFQF) != 0)
+    {
+        return false;           // All TX buffers are busy transmitting.
+    }
+
+    CriticalSectionLocker lock;
+
+    for (int mbx = 0; mbx < NumTxMailboxes; mbx++)
+    {
+        const TxItem& txi = pending_tx_[mbx];
+        if (txi.pending && !frame.priorityHigherThan(txi.frame) && !txi.frame.priorityHigherThan(frame))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * CanDriver
+ */
+int CanDriver::init(const uavcan::uint32_t bitrate, const CanIface::OperatingMode mode)
+{
+    int res = 0;
+
+    UAVCAN_STM32_LOG("Bitrate %lu", static_cast<unsigned long>(bitrate));
+
+    /*
+     * All FDCAN instances share the same clock and reset line
+     */
+    {
+        CriticalSectionLocker lock;
+#if UAVCAN_STM32_NUTTX
+# if UAVCAN_STM32_FDCAN == 7
+        modifyreg32(STM32_RCC_APB1HENR, 0, RCC_APB1HENR_FDCANEN);
+        modifyreg32(STM32_RCC_APB1HRSTR, 0, RCC_APB1HRSTR_FDCANRST);
+        modifyreg32(STM32_RCC_APB1HRSTR, RCC_APB1HRSTR_FDCANRST, 0);
+# else
+        modifyreg32(STM32_RCC_APB1ENR1, 0, RCC_APB1ENR1_FDCANEN);
+        modifyreg32(STM32_RCC_APB1RSTR1, 0, RCC_APB1RSTR1_FDCANRST);
+        modifyreg32(STM32_RCC_APB1RSTR1, RCC_APB1RSTR1_FDCANRST, 0);
+# endif
+#else
+# if UAVCAN_STM32_FDCAN == 7
+        RCC->APB1HENR  |=  RCC_APB1HENR_FDCANEN;
+        RCC->APB1HRSTR |=  RCC_APB1HRSTR_FDCANRST;
+        RCC->APB1HRSTR &= ~RCC_APB1HRSTR_FDCANRST;
+# else
+        RCC->APB1ENR1  |=  RCC_APB1ENR1_FDCANEN;
+        RCC->APB1RSTR1 |=  RCC_APB1RSTR1_FDCANRST;
+        RCC->APB1RSTR1 &= ~RCC_APB1RSTR1_FDCANRST;
+# endif
+#endif
+    }
+
+    UAVCAN_STM32_LOG("Initing iface 0...");
+    res = if0_.init(bitrate, mode);
+    if (res < 0)
+    {
+        UAVCAN_STM32_LOG("Iface 0 init failed %i", res);
+        goto fail;
+    }
+    ifaces[0] = &if0_;
+
+#if UAVCAN_STM32_NUM_IFACES > 1
+    UAVCAN_STM32_LOG("Initing iface 1...");
+    res = if1_.init(bitrate, mode);
+    if (res < 0)
+    {
+        UAVCAN_STM32_LOG("Iface 1 init failed %i", res);
+        goto fail;
+    }
+    ifaces[1] = &if1_;
+#endif
+
+    /*
+     * IRQ
+     */
+#if UAVCAN_STM32_NUTTX
+# define IRQ_ATTACH(irq, handler)                          \
+    {                                                      \
+        res = irq_attach(irq, handler);                    \
+        if (res < 0)                                       \
+        {                                                  \
+            UAVCAN_STM32_LOG("IRQ attach failed %i", irq); \
+            goto fail;                                     \
+        }                                                  \
+        up_enable_irq(irq);                                \
+    }
+    IRQ_ATTACH(STM32_IRQ_FDCAN1_0, can1_irq);
+# if UAVCAN_STM32_NUM_IFACES > 1
+    IRQ_ATTACH(STM32_IRQ_FDCAN2_0, can2_irq);
+# endif
+# undef IRQ_ATTACH
+#else
+    {
+        CriticalSectionLocker lock;
+        nvicEnableVector(FDCAN1_IT0_IRQn, UAVCAN_STM32_IRQ_PRIORITY_MASK);
+# if UAVCAN_STM32_NUM_IFACES > 1
+        nvicEnableVector(FDCAN2_IT0_IRQn, UAVCAN_STM32_IRQ_PRIORITY_MASK);
+# endif
+    }
+#endif
+
+    UAVCAN_STM32_LOG("CAN drv init OK");
+    UAVCAN_ASSERT(res >= 0);
+    return res;
+
+fail:
+    UAVCAN_STM32_LOG("CAN drv init failed %i", res);
+    UAVCAN_ASSERT(res < 0);
+
+    CriticalSectionLocker lock;
+
+#if UAVCAN_STM32_NUTTX
+    // TODO: Unattach and disable all IRQs
+# if UAVCAN_STM32_FDCAN == 7
+    modifyreg32(STM32_RCC_APB1HENR, RCC_APB1HENR_FDCANEN, 0);
+# else
+    modifyreg32(STM32_RCC_APB1ENR1, RCC_APB1ENR1_FDCANEN, 0);
+# endif
+#else
+# if UAVCAN_STM32_FDCAN == 7
+    RCC->APB1HENR &= ~RCC_APB1HENR_FDCANEN;
+# else
+    RCC->APB1ENR1 &= ~RCC_APB1ENR1_FDCANEN;
+# endif
+#endif
+    return res;
+}
+
+CanIface* CanDriver::getIface(uavcan::uint8_t iface_index)
+{
+    if (iface_index < UAVCAN_STM32_NUM_IFACES)
+    {
+        return ifaces[iface_index];
+    }
+    return NULL;
+}
+
+} // namespace uavcan_stm32
+
+/*
+ * Interrupt handlers
+ */
+extern "C"
+{
+
+#if UAVCAN_STM32_NUTTX
+
+static int can1_irq(const int irq, void*)
+{
+    (void)irq;
+    uavcan_stm32::handleInterrupt(0);
+    return 0;
+}
+
+# if UAVCAN_STM32_NUM_IFACES > 1
+
+static int can2_irq(const int irq, void*)
+{
+    (void)irq;
+    uavcan_stm32::handleInterrupt(1);
+    return 0;
+}
+
+# endif
+#else // UAVCAN_STM32_NUTTX
+
+UAVCAN_STM32_IRQ_HANDLER(FDCAN1_IT0_IRQHandler)
+{
+    UAVCAN_STM32_IRQ_PROLOGUE();
+    uavcan_stm32::handleInterrupt(0);
+    UAVCAN_STM32_IRQ_EPILOGUE();
+}
+
+# if UAVCAN_STM32_NUM_IFACES > 1
+
+UAVCAN_STM32_IRQ_HANDLER(FDCAN2_IT0_IRQHandler)
+{
+    UAVCAN_STM32_IRQ_PROLOGUE();
+    uavcan_stm32::handleInterrupt(1);
+    UAVCAN_STM32_IRQ_EPILOGUE();
+}
+
+# endif
+#endif // UAVCAN_STM32_NUTTX
+
+} // extern "C"
+
+#endif // UAVCAN_STM32_FDCAN
@@ -32,15 +32,19 @@ bool BusEvent::wait(uavcan::MonotonicDuration duration)
     return ret == RDY_OK;
 }
 
+const flagsmask_t BusEvent::EventFlags;
+
 void BusEvent::signal()
 {
     sem_.signal();
+    event_source_.broadcastFlags(EventFlags);
 }
 
 void BusEvent::signalFromInterrupt()
 {
     chSysLockFromIsr();
     sem_.signalI();
+    event_source_.broadcastFlagsI(EventFlags);
     chSysUnlockFromIsr();
 }
 
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2015 Pavel Kirienko <pavel.kirienko@gmail.com>
+ *
+ * On-target benchmark; build with:
+ *   make MAIN=main_benchmark.cpp
+ * The report is printed to the serial CLI port periodically. All figures are CPU cycles.
+ * The RX ISR figures are collected from the real bus traffic, so the board should be connected to a loaded bus;
+ * all other figures are synthetic and do not depend on the bus.
+ */
+
+#include <algorithm>
+#include <unistd.h>
+#include <zubax_chibios/sys/sys.h>
+#include <uavcan_stm32/uavcan_stm32.hpp>
+#include <uavcan/protocol/NodeStatus.hpp>
+#include <uavcan/protocol/GetNodeInfo.hpp>
+
+namespace app
+{
+namespace
+{
+
+uavcan_stm32::CanInitHelper<128> can;
+
+void ledSet(bool state)
+{
+    palWritePad(GPIO_PORT_LED, GPIO_PIN_LED, state);
+}
+
+void initCycleCounter()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+inline uavcan::uint32_t getCycles()
+{
+    return DWT->CYCCNT;
+}
+
+int init()
+{
+    halInit();
+    chibios_rt::System::init();
+    sdStart(&STDOUT_SD, NULL);
+
+    initCycleCounter();             // Must be running before the RX interrupts are enabled
+
+    return can.init(1000000);
+}
+
+#if __GNUC__
+__attribute__((noreturn))
+#endif
+void die(int status)
+{
+    lowsyslog("Now I am dead x_x %i\n", status);
+    while (1)
+    {
+        ledSet(false);
+        sleep(1);
+        ledSet(true);
+        sleep(1);
+    }
+}
+
+struct Measurement
+{
+    uavcan::uint64_t total_cycles = 0;
+    uavcan::uint32_t max_cycles = 0;
+    uavcan::uint32_t num_samples = 0;
+
+    void add(uavcan::uint32_t cycles)
+    {
+        total_cycles += cycles;
+        max_cycles = std::max(max_cycles, cycles);
+        num_samples++;
+    }
+
+    void print(const char* name) const
+    {
+        const unsigned avg = (num_samples > 0) ? unsigned(total_cycles / num_samples) : 0U;
+        lowsyslog("%-20s avg %-7u max %-7u n %u\n", name, avg, unsigned(max_cycles), unsigned(num_samples));
+    }
+};
+
+/*
+ * Pool allocator
+ */
+void benchmarkPoolAllocator()
+{
+    static const unsigned NumBlocks = 32;
+    static uavcan::PoolAllocator<uavcan::MemPoolBlockSize * NumBlocks, uavcan::MemPoolBlockSize> pool;
+
+    Measurement alloc;
+    Measurement dealloc;
+    void* blocks[NumBlocks] = {};
+
+    for (int round = 0; round < 16; round++)
+    {
+        for (unsigned i = 0; i < NumBlocks; i++)
+        {
+            const auto started_at = getCycles();
+            blocks[i] = pool.allocate(uavcan::MemPoolBlockSize);
+            alloc.add(getCycles() - started_at);
+            if (blocks[i] == nullptr)
+            {
+                die(-uavcan::ErrMemory);
+            }
+        }
+        // Freed in the interleaved order, so that the free list gets fragmented like in the real life
+        for (unsigned step = 0; step < 2; step++)
+        {
+            for (unsigned i = step; i < NumBlocks; i += 2)
+            {
+                const auto started_at = getCycles();
+                pool.deallocate(blocks[i]);
+                dealloc.add(getCycles() - started_at);
+            }
+        }
+    }
+
+    alloc.print("pool allocate");
+    dealloc.print("pool deallocate");
+}
+
+/*
+ * DSDL codec
+ */
+template <typename T>
+void benchmarkCodec(const char* encode_name, const char* decode_name, const T& sample)
+{
+    static uavcan::StaticTransferBuffer<(T::MaxBitLen + 7) / 8> buf;
+
+    Measurement encode;
+    Measurement decode;
+
+    for (int i = 0; i < 100; i++)
+    {
+        buf.reset();
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+
+        const auto started_at = getCycles();
+        const int res = T::encode(sample, codec);
+        encode.add(getCycles() - started_at);
+        if (res <= 0)
+        {
+            die(res);
+        }
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        uavcan::BitStream bitstream(buf);
+        uavcan::ScalarCodec codec(bitstream);
+        T decoded;
+
+        const auto started_at = getCycles();
+        const int res = T::decode(decoded, codec);
+        decode.add(getCycles() - started_at);
+        if ((res <= 0) || (decoded != sample))
+        {
+            die(res);
+        }
+    }
+
+    encode.print(encode_name);
+    decode.print(decode_name);
+}
+
+void benchmarkCodecs()
+{
+    uavcan::protocol::NodeStatus status;
+    status.uptime_sec = 123456;
+    status.health = status.HEALTH_WARNING;
+    status.mode = status.MODE_OPERATIONAL;
+    status.vendor_specific_status_code = 0xBEEF;
+    benchmarkCodec("NodeStatus encode", "NodeStatus decode", status);
+
+    uavcan::protocol::GetNodeInfo::Response info;
+    info.status = status;
+    info.software_version.major = 1;
+    info.software_version.minor = 2;
+    info.software_version.vcs_commit = 0xDEADBEEF;
+    for (uavcan::uint8_t i = 0; i < info.hardware_version.unique_id.size(); i++)
+    {
+        info.hardware_version.unique_id[i] = i;
+    }
+    info.name = "org.uavcan.stm32_test_stm32f107";
+    benchmarkCodec("GetNodeInfo encode", "GetNodeInfo decode", info);
+}
+
+/*
+ * Dispatcher
+ */
+/**
+ * Delivers the loaded frames to the library as if they were received from the bus, and discards the transmitted
+ * frames. This way the cost of the library can be measured without the driver and the bus.
+ */
+class ReplayCanDriver : public uavcan::ICanDriver, public uavcan::ICanIface, uavcan::Noncopyable
+{
+    uavcan::ISystemClock& clock_;
+    const uavcan::CanFrame* frames_ = nullptr;
+    unsigned num_frames_ = 0;
+    unsigned next_frame_ = 0;
+
+public:
+    explicit ReplayCanDriver(uavcan::ISystemClock& clock) : clock_(clock) { }
+
+    void load(const uavcan::CanFrame* frames, unsigned num_frames)
+    {
+        frames_ = frames;
+        num_frames_ = num_frames;
+        next_frame_ = 0;
+    }
+
+    virtual uavcan::int16_t send(const uavcan::CanFrame&, uavcan::MonotonicTime, uavcan::CanIOFlags)
+    {
+        return 1;
+    }
+
+    virtual uavcan::int16_t receive(uavcan::CanFrame& out_frame, uavcan::MonotonicTime& out_ts_monotonic,
+                                    uavcan::UtcTime& out_ts_utc, uavcan::CanIOFlags& out_flags)
+    {
+        if (next_frame_ >= num_frames_)
+        {
+            return 0;
+        }
+        out_frame = frames_[next_frame_++];
+        out_ts_monotonic = clock_.getMonotonic();
+        out_ts_utc = uavcan::UtcTime();
+        out_flags = 0;
+        return 1;
+    }
+
+    virtual uavcan::int16_t select(uavcan::CanSelectMasks& inout_masks,
+                                   const uavcan::CanFrame* (&)[uavcan::MaxCanIfaces],
+                                   uavcan::MonotonicTime)
+    {
+        inout_masks.read = uavcan::uint8_t((next_frame_ < num_frames_) ? 1 : 0);
+        inout_masks.write = 1;
+        return 1;
+    }
+
+    virtual uavcan::int16_t configureFilters(const uavcan::CanFilterConfig*, uavcan::uint16_t) { return 0; }
+    virtual uavcan::uint16_t getNumFilters() const { return 0; }
+    virtual uavcan::uint64_t getErrorCount() const { return 0; }
+
+    virtual uavcan::ICanIface* getIface(uavcan::uint8_t iface_index) { return (iface_index == 0) ? this : nullptr; }
+    virtual uavcan::uint8_t getNumIfaces() const { return 1; }
+};
+
+unsigned num_node_status_received = 0;
+
+void handleNodeStatus(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>&)
+{
+    num_node_status_received++;
+}
+
+/**
+ * NodeStatus messages from a number of nodes, which is the most common traffic on a real bus.
+ * The cost includes the reception, the transfer reassembly, decoding and the subscriber callback.
+ */
+void benchmarkDispatcher()
+{
+    static const unsigned NumSourceNodes = 16;
+
+    static ReplayCanDriver driver(uavcan_stm32::SystemClock::instance());
+    static uavcan::Node<4096> node(driver, uavcan_stm32::SystemClock::instance());
+    static uavcan::Subscriber<uavcan::protocol::NodeStatus,
+                              void (*)(const uavcan::ReceivedDataStructure<uavcan::protocol::NodeStatus>&)> sub(node);
+    static bool initialized = false;
+    if (!initialized)
+    {
+        initialized = true;
+        const int res = sub.start(&handleNodeStatus);
+        if (res < 0)
+        {
+            die(res);
+        }
+    }
+
+    static uavcan::uint8_t transfer_id = 0;
+
+    Measurement per_frame;
+    num_node_status_received = 0;
+
+    for (int round = 0; round < 32; round++)
+    {
+        uavcan::CanFrame frames[NumSourceNodes];
+        for (unsigned i = 0; i < NumSourceNodes; i++)
+        {
+            uavcan::protocol::NodeStatus msg;
+            msg.uptime_sec = transfer_id;
+
+            uavcan::StaticTransferBuffer<(uavcan::protocol::NodeStatus::MaxBitLen + 7) / 8> buf;
+            uavcan::BitStream bitstream(buf);
+            uavcan::ScalarCodec codec(bitstream);
+            (void)uavcan::protocol::NodeStatus::encode(msg, codec);
+
+            uavcan::Frame frame(uavcan::protocol::NodeStatus::DefaultDataTypeID, uavcan::TransferTypeMessageBroadcast,
+                                uavcan::NodeID(uavcan::uint8_t(i + 1)), uavcan::NodeID::Broadcast, transfer_id);
+            frame.setStartOfTransfer(true);
+            frame.setEndOfTransfer(true);
+            (void)frame.setPayload(buf.getRawPtr(), buf.getMaxWritePos());
+            (void)frame.compile(frames[i]);
+        }
+        transfer_id++;
+
+        driver.load(frames, NumSourceNodes);
+
+        const auto started_at = getCycles();
+        const int res = node.getDispatcher().spinOnce();
+        const auto cycles = getCycles() - started_at;
+        if (res < 0)
+        {
+            die(res);
+        }
+        per_frame.add(cycles / NumSourceNodes);
+    }
+
+    per_frame.print("dispatcher per frame");
+    if (num_node_status_received != (32 * NumSourceNodes))
+    {
+        lowsyslog("dispatcher: %u of %u messages received\n", num_node_status_received, 32 * NumSourceNodes);
+    }
+}
+
+/*
+ * RX ISR
+ */
+void printRxIsrProfile(const char* name, const uavcan_stm32::CanIface& iface)
+{
+    const auto profile = iface.getRxIsrProfile();
+    Measurement m;
+    m.total_cycles = profile.total_cycles;
+    m.max_cycles = profile.max_cycles;
+    m.num_samples = profile.num_calls;
+    m.print(name);
+}
+
+void drainRxQueues()
+{
+    for (uavcan::uint8_t i = 0; i < can.driver.getNumIfaces(); i++)
+    {
+        uavcan::CanFrame frame;
+        uavcan::MonotonicTime ts_mono;
+        uavcan::UtcTime ts_utc;
+        uavcan::CanIOFlags flags = 0;
+        while (static_cast<uavcan::ICanIface*>(can.driver.getIface(i))->receive(frame, ts_mono, ts_utc, flags) > 0)
+        {
+        }
+    }
+}
+
+}
+}
+
+int main()
+{
+    const int init_res = app::init();
+    if (init_res != 0)
+    {
+        app::die(init_res);
+    }
+
+    lowsyslog("Benchmark; SYSCLK %u Hz\n", unsigned(STM32_SYSCLK));
+
+    unsigned report_cnt = 0;
+
+    while (true)
+    {
+        // The bus traffic keeps coming in meanwhile, it is only needed to exercise the RX ISR
+        for (int i = 0; i < 5000; i++)
+        {
+            ::usleep(1000);
+            app::drainRxQueues();
+        }
+
+        app::ledSet(app::can.driver.hadActivity());
+
+        lowsyslog("\nreport #%u\n", report_cnt++);
+        app::printRxIsrProfile("rx isr if0", *app::can.driver.getIface(0));
+        app::printRxIsrProfile("rx isr if1", *app::can.driver.getIface(1));
+        app::benchmarkPoolAllocator();
+        app::benchmarkCodecs();
+        app::benchmarkDispatcher();
+    }
+}